@@ -38,6 +38,23 @@
 
 #define BLOCK_SIZE 10240
 
+/* Bytes read from the start of an image to find its size. JPEG
+ * files can have big metadata blocks before the start of frame. */
+#define SNIFF_SIZE (256 * 1024)
+
+#define MAX_PROBE_THREADS 8
+
+/* Pages kept extracted around the last rendered one, so that page
+ * turns don't wait for the archive */
+#define READ_AHEAD_PAGES_BEHIND 1
+#define READ_AHEAD_PAGES_AHEAD 3
+#define READ_AHEAD_MAX_BYTES (64 * 1024 * 1024)
+
+typedef struct {
+	int width;
+	int height;
+} PageSize;
+
 typedef struct _ComicsDocumentClass ComicsDocumentClass;
 
 struct _ComicsDocumentClass
@@ -52,9 +69,28 @@ struct _ComicsDocument
 	gchar         *archive_path;
 	gchar         *archive_uri;
 	GPtrArray     *page_names;
+	PageSize      *page_sizes;
+
+	/* Read-ahead of the compressed pages, filled from its own
+	 * archive handle by a single worker thread */
+	GMutex         read_ahead_mutex;
+	GHashTable    *read_ahead;         /* page index → GBytes */
+	GHashTable    *read_ahead_pending; /* page indexes queued */
+	gsize          read_ahead_size;
+	gint           read_ahead_page;
+	GThreadPool   *read_ahead_pool;
+	EvArchive     *read_ahead_archive;
+
+	/* Render archives, see comics_document_setup_archives() */
+	GAsyncQueue   *archives;
+	guint          n_archives;
+	guint          max_archives;
+	GMutex         archives_mutex;
 };
 
 static GSList* get_supported_image_extensions (void);
+static gboolean comics_document_probe_page_sizes (ComicsDocument *comics_document);
+static void    comics_document_setup_archives (ComicsDocument *comics_document);
 
 EV_BACKEND_REGISTER (ComicsDocument, comics_document)
 
@@ -127,6 +163,13 @@ comics_document_list (ComicsDocument  *comics_document,
 	while (1) {
 		const char *name;
 
+		if (g_cancellable_set_error_if_cancelled (ev_document_get_load_cancellable (EV_DOCUMENT (comics_document)),
+							  error)) {
+			g_ptr_array_free (array, TRUE);
+			array = NULL;
+			goto out;
+		}
+
 		if (!ev_archive_read_next_header (comics_document->archive, error)) {
 			if (*error != NULL) {
 				g_debug ("Fatal error handling archive: %s", (*error)->message);
@@ -285,6 +328,13 @@ comics_document_load (EvDocument *document,
         /* Now sort the pages */
         g_ptr_array_sort (comics_document->page_names, sort_page_names);
 
+	if (!comics_document_probe_page_sizes (comics_document)) {
+		g_cancellable_set_error_if_cancelled (ev_document_get_load_cancellable (document),
+						      error);
+		return FALSE;
+	}
+	comics_document_setup_archives (comics_document);
+
 	return TRUE;
 }
 
@@ -295,7 +345,7 @@ comics_document_save (EvDocument *document,
 {
 	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
 
-	return ev_xfer_uri_simple (comics_document->archive_uri, uri, error);
+	return ev_file_clone_uri (comics_document->archive_uri, uri, error);
 }
 
 static int
@@ -326,37 +376,465 @@ get_page_size_prepared_cb (GdkPixbufLoader *loader,
 	info->width = width;
 }
 
-static void
-comics_document_get_page_size (EvDocument *document,
-			       EvPage     *page,
-			       double     *width,
-			       double     *height)
+static guint32
+read_be32 (const guchar *data)
 {
-	GdkPixbufLoader *loader;
-	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
-	const char *page_path;
-	PixbufInfo info;
+	return ((guint32) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static guint16
+read_be16 (const guchar *data)
+{
+	return (data[0] << 8) | data[1];
+}
+
+static guint16
+read_le16 (const guchar *data)
+{
+	return data[0] | (data[1] << 8);
+}
+
+static guint32
+read_le24 (const guchar *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16);
+}
+
+static guint32
+read_le32 (const guchar *data)
+{
+	return read_le24 (data) | ((guint32) data[3] << 24);
+}
+
+/* Finds the size of an image from its header, without decoding it.
+ * Returns FALSE if the format isn't known or more data is needed.
+ */
+static gboolean
+sniff_image_size (const guchar *data,
+		  gsize         len,
+		  int          *width,
+		  int          *height)
+{
+	gsize pos;
+
+	/* PNG, IHDR is always the first chunk */
+	if (len >= 24 && memcmp (data, "\x89PNG\r\n\x1a\n", 8) == 0 &&
+	    memcmp (data + 12, "IHDR", 4) == 0) {
+		*width = read_be32 (data + 16);
+		*height = read_be32 (data + 20);
+		return TRUE;
+	}
+
+	/* GIF, logical screen descriptor */
+	if (len >= 10 && memcmp (data, "GIF8", 4) == 0) {
+		*width = read_le16 (data + 6);
+		*height = read_le16 (data + 8);
+		return TRUE;
+	}
+
+	/* WebP, lossy, lossless or extended */
+	if (len >= 30 && memcmp (data, "RIFF", 4) == 0 && memcmp (data + 8, "WEBP", 4) == 0) {
+		if (memcmp (data + 12, "VP8 ", 4) == 0 &&
+		    data[23] == 0x9d && data[24] == 0x01 && data[25] == 0x2a) {
+			*width = read_le16 (data + 26) & 0x3fff;
+			*height = read_le16 (data + 28) & 0x3fff;
+			return TRUE;
+		}
+		if (memcmp (data + 12, "VP8L", 4) == 0 && data[20] == 0x2f) {
+			guint32 bits = read_le32 (data + 21);
+
+			*width = (bits & 0x3fff) + 1;
+			*height = ((bits >> 14) & 0x3fff) + 1;
+			return TRUE;
+		}
+		if (memcmp (data + 12, "VP8X", 4) == 0) {
+			*width = read_le24 (data + 24) + 1;
+			*height = read_le24 (data + 27) + 1;
+			return TRUE;
+		}
+		return FALSE;
+	}
+
+	/* JPEG, walk the markers up to the start of frame */
+	if (len < 4 || data[0] != 0xff || data[1] != 0xd8)
+		return FALSE;
+
+	pos = 2;
+	while (pos + 4 <= len) {
+		guchar marker;
+
+		if (data[pos] != 0xff)
+			return FALSE;
+		marker = data[pos + 1];
+		if (marker == 0xff) {
+			/* Fill byte */
+			pos++;
+			continue;
+		}
+
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+			/* Markers without a payload */
+			pos += 2;
+			continue;
+		}
+
+		if (marker >= 0xc0 && marker <= 0xcf &&
+		    marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+			if (pos + 9 > len)
+				return FALSE;
+			*height = read_be16 (data + pos + 5);
+			*width = read_be16 (data + pos + 7);
+			return *width > 0 && *height > 0;
+		}
+
+		if (marker == 0xd9 || marker == 0xda)
+			return FALSE;
+
+		pos += 2 + read_be16 (data + pos + 2);
+	}
+
+	return FALSE;
+}
+
+/* Reads the size of the image at the current entry of the archive.
+ * The header is sniffed while the data comes in, and images we don't
+ * know about are handed to gdk-pixbuf until their size is known.
+ */
+static gboolean
+comics_archive_get_entry_image_size (EvArchive  *archive,
+				     const char *name,
+				     int        *width,
+				     int        *height)
+{
+	GdkPixbufLoader *loader = NULL;
+	PixbufInfo info = { FALSE, 0, 0 };
+	guchar *header;
+	gsize header_len = 0;
+	gint64 left;
+	gssize read = 0;
 	GError *error = NULL;
 
-	if (!ev_archive_open_filename (comics_document->archive, comics_document->archive_path, &error)) {
+	header = g_malloc (SNIFF_SIZE);
+	left = ev_archive_get_entry_size (archive);
+
+	while (left > 0 && !info.got_info) {
+		guchar buf[BLOCK_SIZE];
+		gboolean in_header = FALSE;
+
+		read = ev_archive_read_data (archive, buf, MIN (BLOCK_SIZE, left), &error);
+		if (read <= 0)
+			break;
+		left -= read;
+
+		if (loader) {
+			if (!gdk_pixbuf_loader_write (loader, buf, read, &error)) {
+				read = -1;
+				break;
+			}
+			continue;
+		}
+
+		if (header_len + read <= SNIFF_SIZE) {
+			memcpy (header + header_len, buf, read);
+			header_len += read;
+			in_header = TRUE;
+			if (sniff_image_size (header, header_len, &info.width, &info.height)) {
+				info.got_info = TRUE;
+				break;
+			}
+			if (header_len < SNIFF_SIZE && left > 0)
+				continue;
+		}
+
+		/* Unknown format, or a header too big to sniff */
+		loader = gdk_pixbuf_loader_new ();
+		g_signal_connect (loader, "size-prepared",
+				  G_CALLBACK (get_page_size_prepared_cb),
+				  &info);
+		if (!gdk_pixbuf_loader_write (loader, header, header_len, &error) ||
+		    (!in_header && !gdk_pixbuf_loader_write (loader, buf, read, &error))) {
+			read = -1;
+			break;
+		}
+	}
+
+	if (read < 0) {
+		g_warning ("Fatal error reading '%s' in archive: %s", name,
+			   error ? error->message : "unknown error");
+		g_clear_error (&error);
+	}
+
+	if (loader) {
+		gdk_pixbuf_loader_close (loader, NULL);
+		g_object_unref (loader);
+	}
+	g_free (header);
+
+	if (info.got_info) {
+		*width = info.width;
+		*height = info.height;
+	}
+
+	return info.got_info;
+}
+
+/* Page sizes are cached, indexed by the archive URI, and checked
+ * against the modification time and size of the archive.
+ */
+static gchar *
+comics_document_get_sizes_cache_path (ComicsDocument *comics_document)
+{
+	gchar *checksum;
+	gchar *filename;
+	gchar *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, comics_document->archive_uri, -1);
+	filename = g_strconcat (checksum, ".sizes", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "evince", "comics", filename, NULL);
+	g_free (filename);
+	g_free (checksum);
+
+	return path;
+}
+
+static gboolean
+comics_document_get_archive_stamp (ComicsDocument *comics_document,
+				   guint64        *mtime,
+				   guint64        *size)
+{
+	GFile     *file;
+	GFileInfo *info;
+
+	file = g_file_new_for_path (comics_document->archive_path);
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref (file);
+	if (!info)
+		return FALSE;
+
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	*size = g_file_info_get_size (info);
+	g_object_unref (info);
+
+	return TRUE;
+}
+
+static gboolean
+comics_document_load_cached_sizes (ComicsDocument *comics_document)
+{
+	GKeyFile *key_file;
+	gchar    *path;
+	guint64   mtime, size;
+	gint     *widths = NULL, *heights = NULL;
+	gsize     n_widths = 0, n_heights = 0;
+	gboolean  retval = FALSE;
+	guint     i;
+
+	if (!comics_document_get_archive_stamp (comics_document, &mtime, &size))
+		return FALSE;
+
+	key_file = g_key_file_new ();
+	path = comics_document_get_sizes_cache_path (comics_document);
+	if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL))
+		goto out;
+
+	if (g_key_file_get_uint64 (key_file, "Archive", "mtime", NULL) != mtime ||
+	    g_key_file_get_uint64 (key_file, "Archive", "size", NULL) != size)
+		goto out;
+
+	widths = g_key_file_get_integer_list (key_file, "Pages", "widths", &n_widths, NULL);
+	heights = g_key_file_get_integer_list (key_file, "Pages", "heights", &n_heights, NULL);
+	if (!widths || !heights ||
+	    n_widths != comics_document->page_names->len || n_heights != n_widths)
+		goto out;
+
+	for (i = 0; i < n_widths; i++) {
+		comics_document->page_sizes[i].width = widths[i];
+		comics_document->page_sizes[i].height = heights[i];
+	}
+	retval = TRUE;
+out:
+	g_free (widths);
+	g_free (heights);
+	g_free (path);
+	g_key_file_free (key_file);
+
+	return retval;
+}
+
+static void
+comics_document_save_cached_sizes (ComicsDocument *comics_document)
+{
+	GKeyFile *key_file;
+	gchar    *path;
+	gchar    *dir;
+	guint64   mtime, size;
+	gint     *widths, *heights;
+	guint     n_pages = comics_document->page_names->len;
+	guint     i;
+
+	if (!comics_document_get_archive_stamp (comics_document, &mtime, &size))
+		return;
+
+	widths = g_new (gint, n_pages);
+	heights = g_new (gint, n_pages);
+	for (i = 0; i < n_pages; i++) {
+		widths[i] = comics_document->page_sizes[i].width;
+		heights[i] = comics_document->page_sizes[i].height;
+	}
+
+	key_file = g_key_file_new ();
+	g_key_file_set_uint64 (key_file, "Archive", "mtime", mtime);
+	g_key_file_set_uint64 (key_file, "Archive", "size", size);
+	g_key_file_set_integer_list (key_file, "Pages", "widths", widths, n_pages);
+	g_key_file_set_integer_list (key_file, "Pages", "heights", heights, n_pages);
+
+	path = comics_document_get_sizes_cache_path (comics_document);
+	dir = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dir, 0700) == 0)
+		g_key_file_save_to_file (key_file, path, NULL);
+
+	g_free (dir);
+	g_free (path);
+	g_key_file_free (key_file);
+	g_free (widths);
+	g_free (heights);
+}
+
+/* The size of a page that couldn't be read is stored as 0, and it is
+ * probed again on the next load rather than trusted */
+static gboolean
+page_size_is_probed (PageSize *page_size)
+{
+	return page_size->width > 0 && page_size->height > 0;
+}
+
+static guint
+comics_document_count_unprobed_pages (ComicsDocument *comics_document)
+{
+	guint n_unprobed = 0;
+	guint i;
+
+	for (i = 0; i < comics_document->page_names->len; i++) {
+		if (!page_size_is_probed (&comics_document->page_sizes[i]))
+			n_unprobed++;
+	}
+
+	return n_unprobed;
+}
+
+typedef struct {
+	ComicsDocument *comics_document;
+	guint           first_page;
+	guint           last_page;
+} ProbeRange;
+
+static EvArchive *
+comics_document_open_archive (ComicsDocument *comics_document)
+{
+	EvArchive *archive;
+	GError    *error = NULL;
+
+	/* Shares the entry index built while listing the archive */
+	archive = ev_archive_dup (comics_document->archive);
+	if (!ev_archive_open_filename (archive, comics_document->archive_path, &error)) {
 		g_warning ("Fatal error opening archive: %s", error->message);
 		g_error_free (error);
-		goto out;
+		g_object_unref (archive);
+		return NULL;
 	}
 
-	loader = gdk_pixbuf_loader_new ();
-	info.got_info = FALSE;
-	g_signal_connect (loader, "size-prepared",
-			  G_CALLBACK (get_page_size_prepared_cb),
-			  &info);
+	return archive;
+}
 
-	page_path = g_ptr_array_index (comics_document->page_names, page->index);
+/* Probes the pages of a range not probed yet on its own archive
+ * handle, seeking to each page. Used for the formats with random
+ * access.
+ */
+static void
+probe_page_range (ProbeRange *range,
+		  gpointer    user_data)
+{
+	ComicsDocument *comics_document = range->comics_document;
+	GCancellable   *cancellable;
+	EvArchive      *archive;
+	guint           i;
 
-	while (1) {
+	cancellable = ev_document_get_load_cancellable (EV_DOCUMENT (comics_document));
+
+	archive = comics_document_open_archive (comics_document);
+	if (!archive)
+		return;
+
+	for (i = range->first_page; i <= range->last_page; i++) {
+		const char *page_path = g_ptr_array_index (comics_document->page_names, i);
+		PageSize   *page_size = &comics_document->page_sizes[i];
+		GError     *error = NULL;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		if (page_size_is_probed (page_size))
+			continue;
+
+		if (ev_archive_seek_entry (archive, page_path, &error)) {
+			comics_archive_get_entry_image_size (archive, page_path,
+							     &page_size->width, &page_size->height);
+		} else if (error) {
+			g_warning ("Fatal error handling archive: %s", error->message);
+			g_error_free (error);
+		}
+
+		ev_archive_reset (archive);
+		if (i < range->last_page &&
+		    !ev_archive_open_filename (archive, comics_document->archive_path, NULL))
+			break;
+	}
+
+	g_object_unref (archive);
+}
+
+/* Probes the pages not probed yet in a single pass over the archive,
+ * for the formats that can only be read sequentially, and for solid
+ * RAR archives, where seeking to a page decompresses all the ones
+ * before it.
+ */
+static void
+probe_pages_sequentially (ComicsDocument *comics_document)
+{
+	EvDocument   *document = EV_DOCUMENT (comics_document);
+	GCancellable *cancellable = ev_document_get_load_cancellable (document);
+	EvArchive    *archive;
+	GHashTable   *pages;
+	guint         n_pages;
+	guint         n_left = 0;
+	guint         i;
+
+	archive = comics_document_open_archive (comics_document);
+	if (!archive)
+		return;
+
+	pages = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < comics_document->page_names->len; i++) {
+		if (page_size_is_probed (&comics_document->page_sizes[i]))
+			continue;
+
+		g_hash_table_insert (pages, g_ptr_array_index (comics_document->page_names, i), GUINT_TO_POINTER (i + 1));
+		n_left++;
+	}
+	n_pages = n_left;
+
+	while (n_left > 0) {
 		const char *name;
-		GError *error = NULL;
+		GError     *error = NULL;
+		guint       page;
 
-		if (!ev_archive_read_next_header (comics_document->archive, &error)) {
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		if (!ev_archive_read_next_header (archive, &error)) {
 			if (error != NULL) {
 				g_warning ("Fatal error handling archive: %s", error->message);
 				g_error_free (error);
@@ -364,44 +842,88 @@ comics_document_get_page_size (EvDocument *document,
 			break;
 		}
 
-		name = ev_archive_get_entry_pathname (comics_document->archive);
-		if (g_strcmp0 (name, page_path) == 0) {
-			char buf[BLOCK_SIZE];
-			gssize read;
-			gint64 left;
-
-			left = ev_archive_get_entry_size (comics_document->archive);
-			read = ev_archive_read_data (comics_document->archive, buf,
-						     MIN(BLOCK_SIZE, left), &error);
-			while (read > 0 && !info.got_info) {
-				if (!gdk_pixbuf_loader_write (loader, (guchar *) buf, read, &error)) {
-					read = -1;
-					break;
-				}
-				left -= read;
-				read = ev_archive_read_data (comics_document->archive, buf,
-							     MIN(BLOCK_SIZE, left), &error);
-			}
-			if (read < 0) {
-				g_warning ("Fatal error reading '%s' in archive: %s", name, error->message);
-				g_error_free (error);
-			}
-			break;
-		}
+		name = ev_archive_get_entry_pathname (archive);
+		page = GPOINTER_TO_UINT (g_hash_table_lookup (pages, name));
+		if (page == 0)
+			continue;
+
+		comics_archive_get_entry_image_size (archive, name,
+						     &comics_document->page_sizes[page - 1].width,
+						     &comics_document->page_sizes[page - 1].height);
+		g_hash_table_remove (pages, name);
+		n_left--;
+		ev_document_set_load_progress (document, (gdouble) (n_pages - n_left) / n_pages);
 	}
 
-	gdk_pixbuf_loader_close (loader, NULL);
-	g_object_unref (loader);
+	g_hash_table_destroy (pages);
+	ev_archive_reset (archive);
+	g_object_unref (archive);
+}
 
-	if (info.got_info) {
-		if (width)
-			*width = info.width;
-		if (height)
-			*height = info.height;
+/* Returns FALSE when the load was cancelled before all the pages were
+ * probed */
+static gboolean
+comics_document_probe_page_sizes (ComicsDocument *comics_document)
+{
+	EvArchiveType type = ev_archive_get_archive_type (comics_document->archive);
+	guint         n_pages = comics_document->page_names->len;
+
+	comics_document->page_sizes = g_new0 (PageSize, n_pages);
+
+	if (comics_document_load_cached_sizes (comics_document) &&
+	    comics_document_count_unprobed_pages (comics_document) == 0)
+		return TRUE;
+
+	if (type == EV_ARCHIVE_TYPE_ZIP ||
+	    (type == EV_ARCHIVE_TYPE_RAR && !ev_archive_is_solid (comics_document->archive))) {
+		ProbeRange  *ranges;
+		GThreadPool *pool;
+		guint        n_threads;
+		guint        i;
+
+		n_threads = CLAMP (g_get_num_processors (), 1, MAX_PROBE_THREADS);
+		n_threads = MIN (n_threads, n_pages);
+		ranges = g_new (ProbeRange, n_threads);
+
+		pool = g_thread_pool_new ((GFunc) probe_page_range, NULL, n_threads, TRUE, NULL);
+		for (i = 0; i < n_threads; i++) {
+			ranges[i].comics_document = comics_document;
+			ranges[i].first_page = i * n_pages / n_threads;
+			ranges[i].last_page = (i + 1) * n_pages / n_threads - 1;
+			g_thread_pool_push (pool, &ranges[i], NULL);
+		}
+		/* Waits for all the ranges to be probed */
+		g_thread_pool_free (pool, FALSE, TRUE);
+		g_free (ranges);
+	} else {
+		probe_pages_sequentially (comics_document);
 	}
 
-out:
-	ev_archive_reset (comics_document->archive);
+	/* Don't store the sizes of the pages left unprobed */
+	if (g_cancellable_is_cancelled (ev_document_get_load_cancellable (EV_DOCUMENT (comics_document))))
+		return FALSE;
+
+	comics_document_save_cached_sizes (comics_document);
+
+	return TRUE;
+}
+
+static void
+comics_document_get_page_size (EvDocument *document,
+			       EvPage     *page,
+			       double     *width,
+			       double     *height)
+{
+	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
+	PageSize *page_size = &comics_document->page_sizes[page->index];
+
+	if (page_size->width <= 0 || page_size->height <= 0)
+		return;
+
+	if (width)
+		*width = page_size->width;
+	if (height)
+		*height = page_size->height;
 }
 
 static void
@@ -416,66 +938,296 @@ render_pixbuf_size_prepared_cb (GdkPixbufLoader *loader,
 	gdk_pixbuf_loader_set_size (loader, scaled_width, scaled_height);
 }
 
-static GdkPixbuf *
-comics_document_render_pixbuf (EvDocument      *document,
-			       EvRenderContext *rc)
+static void
+comics_document_load_page (ComicsDocument  *comics_document,
+			   EvArchive       *archive,
+			   EvRenderContext *rc,
+			   GdkPixbufLoader *loader)
 {
-	GdkPixbufLoader *loader;
-	GdkPixbuf *tmp_pixbuf;
-	GdkPixbuf *rotated_pixbuf = NULL;
-	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
 	const char *page_path;
 	GError *error = NULL;
 
-	if (!ev_archive_open_filename (comics_document->archive, comics_document->archive_path, &error)) {
+	if (!ev_archive_open_filename (archive, comics_document->archive_path, &error)) {
 		g_warning ("Fatal error opening archive: %s", error->message);
 		g_error_free (error);
 		goto out;
 	}
 
-	loader = gdk_pixbuf_loader_new ();
-	g_signal_connect (loader, "size-prepared",
-			  G_CALLBACK (render_pixbuf_size_prepared_cb),
-			  rc);
-
 	page_path = g_ptr_array_index (comics_document->page_names, rc->page->index);
 
-	while (1) {
-		const char *name;
-
-		if (!ev_archive_read_next_header (comics_document->archive, &error)) {
-			if (error != NULL) {
-				g_warning ("Fatal error handling archive: %s", error->message);
-				g_error_free (error);
+	if (ev_archive_seek_entry (archive, page_path, &error)) {
+		gint64 size = ev_archive_get_entry_size (archive);
+		gint64 left = size;
+		guchar buf[BLOCK_SIZE];
+		gssize read = 0;
+
+		/* The page is fed to the loader as it's extracted, so the
+		 * size is set as soon as the header is parsed. The JPEG
+		 * loader then picks the DCT scaling (1/2, 1/4 or 1/8) that
+		 * decodes closest to, but not below, the requested size.
+		 */
+		while (left > 0) {
+			if (ev_render_context_is_cancelled (rc)) {
+				read = 0;
+				break;
 			}
-			break;
+
+			read = ev_archive_read_data (archive, buf,
+						     MIN (BLOCK_SIZE, left), &error);
+			if (read <= 0)
+				break;
+			left -= read;
+
+			if (!gdk_pixbuf_loader_write (loader, buf, read, NULL))
+				break;
 		}
 
-		name = ev_archive_get_entry_pathname (comics_document->archive);
-		if (g_strcmp0 (name, page_path) == 0) {
-			size_t size = ev_archive_get_entry_size (comics_document->archive);
-			char *buf;
-			ssize_t read;
+		if (read < 0) {
+			g_warning ("Fatal error reading '%s' in archive: %s", page_path, error->message);
+			g_error_free (error);
+		} else if (size == 0) {
+			g_warning ("Read an empty file from the archive");
+		}
+		gdk_pixbuf_loader_close (loader, NULL);
+	} else if (error != NULL) {
+		g_warning ("Fatal error handling archive: %s", error->message);
+		g_error_free (error);
+	}
+
+out:
+	gdk_pixbuf_loader_close (loader, NULL);
+	ev_archive_reset (archive);
+}
+
+/* Render archives are extra EvArchives on the same file, sharing the
+ * entry index, so that different pages can be extracted and decoded
+ * at the same time. ZIP entries are compressed independently, and RAR
+ * ones are seeked to, so they don't depend on each other. This is
+ * opt-in, by setting EV_COMICS_RENDER_ARCHIVES to the maximum number
+ * of archives.
+ */
+static void
+comics_document_setup_archives (ComicsDocument *comics_document)
+{
+	EvArchiveType  type = ev_archive_get_archive_type (comics_document->archive);
+	const gchar   *env;
+	gint           n;
+
+	if (type != EV_ARCHIVE_TYPE_ZIP && type != EV_ARCHIVE_TYPE_RAR)
+		return;
+
+	env = g_getenv ("EV_COMICS_RENDER_ARCHIVES");
+	if (!env)
+		return;
+
+	n = MIN (atoi (env), (gint) g_get_num_processors ());
+	if (n <= 0)
+		return;
+
+	comics_document->archives = g_async_queue_new_full ((GDestroyNotify) g_object_unref);
+	g_async_queue_push (comics_document->archives,
+			    ev_archive_dup (comics_document->archive));
+	comics_document->n_archives = 1;
+	comics_document->max_archives = n;
+}
+
+static EvArchive *
+comics_document_acquire_archive (ComicsDocument *comics_document)
+{
+	EvArchive *archive;
 
+	archive = g_async_queue_try_pop (comics_document->archives);
+	if (archive)
+		return archive;
+
+	g_mutex_lock (&comics_document->archives_mutex);
+	if (comics_document->n_archives < comics_document->max_archives) {
+		/* The main archive is left alone once loaded */
+		archive = ev_archive_dup (comics_document->archive);
+		comics_document->n_archives++;
+	}
+	g_mutex_unlock (&comics_document->archives_mutex);
+
+	if (archive)
+		return archive;
+
+	/* All archives are busy, wait for one to be released */
+	return g_async_queue_pop (comics_document->archives);
+}
+
+static void
+comics_document_release_archive (ComicsDocument *comics_document,
+				 EvArchive      *archive)
+{
+	g_async_queue_push (comics_document->archives, archive);
+}
+
+static gboolean
+page_in_read_ahead_window (ComicsDocument *comics_document,
+			   gint            page)
+{
+	return page >= comics_document->read_ahead_page - READ_AHEAD_PAGES_BEHIND &&
+		page <= comics_document->read_ahead_page + READ_AHEAD_PAGES_AHEAD;
+}
+
+static void
+read_ahead_page (gpointer data,
+		 gpointer user_data)
+{
+	ComicsDocument *comics_document = COMICS_DOCUMENT (user_data);
+	gint            page = GPOINTER_TO_INT (data) - 1;
+	const char     *page_path;
+	gboolean        wanted;
+	GBytes         *bytes = NULL;
+	GError         *error = NULL;
+
+	g_mutex_lock (&comics_document->read_ahead_mutex);
+	g_hash_table_remove (comics_document->read_ahead_pending, data);
+	wanted = page_in_read_ahead_window (comics_document, page) &&
+		comics_document->read_ahead_size < READ_AHEAD_MAX_BYTES;
+	g_mutex_unlock (&comics_document->read_ahead_mutex);
+
+	/* The reader moved on while this page was queued */
+	if (!wanted)
+		return;
+
+	if (!ev_archive_open_filename (comics_document->read_ahead_archive,
+				       comics_document->archive_path, &error)) {
+		g_debug ("Failed to open archive for read-ahead: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	page_path = g_ptr_array_index (comics_document->page_names, page);
+	if (ev_archive_seek_entry (comics_document->read_ahead_archive, page_path, NULL)) {
+		gint64 size = ev_archive_get_entry_size (comics_document->read_ahead_archive);
+		guchar *buf;
+
+		if (size > 0 && size < READ_AHEAD_MAX_BYTES / 4) {
 			buf = g_malloc (size);
-			read = ev_archive_read_data (comics_document->archive, buf, size, &error);
-			if (read <= 0) {
-				if (read < 0) {
-					g_warning ("Fatal error reading '%s' in archive: %s", name, error->message);
-					g_error_free (error);
-				} else {
-					g_warning ("Read an empty file from the archive");
-				}
-			} else {
-				gdk_pixbuf_loader_write (loader, (guchar *) buf, size, NULL);
-			}
-			g_free (buf);
-			gdk_pixbuf_loader_close (loader, NULL);
-			break;
+			if (ev_archive_read_data (comics_document->read_ahead_archive, buf, size, NULL) == size)
+				bytes = g_bytes_new_take (buf, size);
+			else
+				g_free (buf);
 		}
 	}
+	ev_archive_reset (comics_document->read_ahead_archive);
+
+	if (!bytes)
+		return;
+
+	g_mutex_lock (&comics_document->read_ahead_mutex);
+	if (page_in_read_ahead_window (comics_document, page) &&
+	    !g_hash_table_contains (comics_document->read_ahead, data)) {
+		comics_document->read_ahead_size += g_bytes_get_size (bytes);
+		g_hash_table_insert (comics_document->read_ahead, data, bytes);
+		bytes = NULL;
+	}
+	g_mutex_unlock (&comics_document->read_ahead_mutex);
+
+	if (bytes)
+		g_bytes_unref (bytes);
+}
+
+/* Moves the read-ahead window around page, dropping the pages that
+ * left it and queuing the missing ones, nearest first.
+ */
+static void
+comics_document_update_read_ahead (ComicsDocument *comics_document,
+				   gint            page)
+{
+	GHashTableIter iter;
+	gpointer       key, value;
+	gint           n_pages = comics_document->page_names->len;
+	gint           i;
+
+	g_mutex_lock (&comics_document->read_ahead_mutex);
+
+	comics_document->read_ahead_page = page;
+
+	g_hash_table_iter_init (&iter, comics_document->read_ahead);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (page_in_read_ahead_window (comics_document, GPOINTER_TO_INT (key) - 1))
+			continue;
+
+		comics_document->read_ahead_size -= g_bytes_get_size ((GBytes *) value);
+		g_hash_table_iter_remove (&iter);
+	}
+
+	if (!comics_document->read_ahead_pool) {
+		comics_document->read_ahead_archive = ev_archive_dup (comics_document->archive);
+		comics_document->read_ahead_pool = g_thread_pool_new (read_ahead_page,
+								      comics_document,
+								      1, FALSE, NULL);
+	}
+
+	for (i = 1; i <= READ_AHEAD_PAGES_AHEAD; i++) {
+		gint pages[2] = { page + i, i <= READ_AHEAD_PAGES_BEHIND ? page - i : -1 };
+		gint j;
+
+		for (j = 0; j < 2; j++) {
+			gpointer key = GINT_TO_POINTER (pages[j] + 1);
 
-	tmp_pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+			if (pages[j] < 0 || pages[j] >= n_pages ||
+			    g_hash_table_contains (comics_document->read_ahead, key) ||
+			    g_hash_table_contains (comics_document->read_ahead_pending, key))
+				continue;
+
+			g_hash_table_add (comics_document->read_ahead_pending, key);
+			g_thread_pool_push (comics_document->read_ahead_pool, key, NULL);
+		}
+	}
+
+	g_mutex_unlock (&comics_document->read_ahead_mutex);
+}
+
+static GBytes *
+comics_document_lookup_read_ahead (ComicsDocument *comics_document,
+				   gint            page)
+{
+	GBytes *bytes;
+
+	g_mutex_lock (&comics_document->read_ahead_mutex);
+	bytes = g_hash_table_lookup (comics_document->read_ahead, GINT_TO_POINTER (page + 1));
+	if (bytes)
+		g_bytes_ref (bytes);
+	g_mutex_unlock (&comics_document->read_ahead_mutex);
+
+	return bytes;
+}
+
+static GdkPixbuf *
+comics_document_render_pixbuf (EvDocument      *document,
+			       EvRenderContext *rc)
+{
+	GdkPixbufLoader *loader;
+	GdkPixbuf *tmp_pixbuf;
+	GdkPixbuf *rotated_pixbuf = NULL;
+	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
+	GBytes *bytes;
+
+	loader = gdk_pixbuf_loader_new ();
+	g_signal_connect (loader, "size-prepared",
+			  G_CALLBACK (render_pixbuf_size_prepared_cb),
+			  rc);
+
+	bytes = comics_document_lookup_read_ahead (comics_document, rc->page->index);
+	if (bytes) {
+		gdk_pixbuf_loader_write_bytes (loader, bytes, NULL);
+		gdk_pixbuf_loader_close (loader, NULL);
+		g_bytes_unref (bytes);
+	} else if (comics_document->archives) {
+		EvArchive *archive = comics_document_acquire_archive (comics_document);
+
+		comics_document_load_page (comics_document, archive, rc, loader);
+		comics_document_release_archive (comics_document, archive);
+	} else {
+		comics_document_load_page (comics_document, comics_document->archive, rc, loader);
+	}
+
+	comics_document_update_read_ahead (comics_document, rc->page->index);
+
+	tmp_pixbuf = ev_render_context_is_cancelled (rc) ? NULL : gdk_pixbuf_loader_get_pixbuf (loader);
 	if (tmp_pixbuf) {
 		if ((rc->rotation % 360) == 0)
 			rotated_pixbuf = g_object_ref (tmp_pixbuf);
@@ -485,8 +1237,6 @@ comics_document_render_pixbuf (EvDocument      *document,
 	}
 	g_object_unref (loader);
 
-out:
-	ev_archive_reset (comics_document->archive);
 	return rotated_pixbuf;
 }
 
@@ -498,22 +1248,44 @@ comics_document_render (EvDocument      *document,
 	cairo_surface_t *surface;
 
 	pixbuf = comics_document_render_pixbuf (document, rc);
+	if (!pixbuf)
+		return NULL;
 	surface = ev_document_misc_surface_from_pixbuf (pixbuf);
 	g_object_unref (pixbuf);
 
 	return surface;
 }
 
+static gboolean
+comics_document_is_thread_safe (EvDocument *document)
+{
+	return COMICS_DOCUMENT (document)->archives != NULL;
+}
+
 static void
 comics_document_finalize (GObject *object)
 {
 	ComicsDocument *comics_document = COMICS_DOCUMENT (object);
 
+	/* Waits for the page being read ahead, if any, which
+	 * uses the page names */
+	if (comics_document->read_ahead_pool)
+		g_thread_pool_free (comics_document->read_ahead_pool, TRUE, TRUE);
+	g_clear_object (&comics_document->read_ahead_archive);
+
 	if (comics_document->page_names) {
                 g_ptr_array_foreach (comics_document->page_names, (GFunc) g_free, NULL);
                 g_ptr_array_free (comics_document->page_names, TRUE);
 	}
 
+	g_hash_table_destroy (comics_document->read_ahead);
+	g_hash_table_destroy (comics_document->read_ahead_pending);
+	g_mutex_clear (&comics_document->read_ahead_mutex);
+
+	g_clear_pointer (&comics_document->archives, g_async_queue_unref);
+	g_mutex_clear (&comics_document->archives_mutex);
+
+	g_free (comics_document->page_sizes);
 	g_clear_object (&comics_document->archive);
 	g_free (comics_document->archive_path);
 	g_free (comics_document->archive_uri);
@@ -534,12 +1306,19 @@ comics_document_class_init (ComicsDocumentClass *klass)
 	ev_document_class->get_n_pages = comics_document_get_n_pages;
 	ev_document_class->get_page_size = comics_document_get_page_size;
 	ev_document_class->render = comics_document_render;
+	ev_document_class->is_thread_safe = comics_document_is_thread_safe;
 }
 
 static void
 comics_document_init (ComicsDocument *comics_document)
 {
 	comics_document->archive = ev_archive_new ();
+
+	g_mutex_init (&comics_document->read_ahead_mutex);
+	g_mutex_init (&comics_document->archives_mutex);
+	comics_document->read_ahead = g_hash_table_new_full (NULL, NULL, NULL,
+							     (GDestroyNotify) g_bytes_unref);
+	comics_document->read_ahead_pending = g_hash_table_new (NULL, NULL);
 }
 
 /* Returns a list of file extensions supported by gdk-pixbuf */
@@ -24,24 +24,55 @@
 #include <archive_entry.h>
 #include <unarr/unarr.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 #define BUFFER_SIZE (64 * 1024)
 
+/* RAR 1.5 to 4 marker and main header, see ev_archive_is_solid() */
+#define RAR_MARKER "Rar!\x1a\x07\x00"
+#define RAR_MARKER_SIZE 7
+#define RAR_MAIN_HEAD_TYPE 0x73
+#define RAR_MAIN_HEAD_SOLID 0x0008
+
+/* ZIP central directory records */
+#define ZIP_EOCD_SIGNATURE 0x06054b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP_EOCD_MAX_COMMENT 0xffff
+#define ZIP_CDIR_SIGNATURE 0x02014b50
+#define ZIP_CDIR_SIZE 46
+
 struct _EvArchive {
 	GObject parent_instance;
 	EvArchiveType type;
+	gchar *path;
+
+	/* Offsets of the entries in the archive, indexed by name.
+	 * They don't depend on the reading state, so they are kept
+	 * across resets. */
+	GHashTable *entry_offsets;
+	gboolean zip_index_built;
 
 	/* libarchive */
 	struct archive *libar;
 	struct archive_entry *libar_entry;
+	int libar_fd;
 
 	/* unarr */
 	ar_stream *unarr_stream;
 	ar_archive *unarr;
+	gboolean unarr_rewind;
 };
 
 G_DEFINE_TYPE(EvArchive, ev_archive, G_TYPE_OBJECT);
 
+static void ev_archive_add_entry_offset (EvArchive  *archive,
+					 const char *name,
+					 gint64      offset);
+
 static void
 ev_archive_finalize (GObject *object)
 {
@@ -61,6 +92,11 @@ ev_archive_finalize (GObject *object)
 		break;
 	}
 
+	if (archive->libar_fd != -1)
+		close (archive->libar_fd);
+	g_clear_pointer (&archive->entry_offsets, g_hash_table_destroy);
+	g_free (archive->path);
+
 	G_OBJECT_CLASS (ev_archive_parent_class)->finalize (object);
 }
 
@@ -78,6 +114,38 @@ ev_archive_new (void)
 	return g_object_new (EV_TYPE_ARCHIVE, NULL);
 }
 
+/**
+ * ev_archive_dup:
+ * @archive: an #EvArchive
+ *
+ * Creates a new #EvArchive of the same type as @archive, with a copy of
+ * its entry index, so that the same archive file can be read from
+ * another thread. It still has to be opened.
+ *
+ * Returns: (transfer full): a new #EvArchive
+ */
+EvArchive *
+ev_archive_dup (EvArchive *archive)
+{
+	EvArchive      *copy;
+	GHashTableIter  iter;
+	gpointer        key, value;
+
+	g_return_val_if_fail (EV_IS_ARCHIVE (archive), NULL);
+
+	copy = ev_archive_new ();
+	if (archive->type != EV_ARCHIVE_TYPE_NONE)
+		ev_archive_set_archive_type (copy, archive->type);
+	copy->path = g_strdup (archive->path);
+	copy->zip_index_built = archive->zip_index_built;
+
+	g_hash_table_iter_init (&iter, archive->entry_offsets);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		ev_archive_add_entry_offset (copy, key, *(gint64 *) value);
+
+	return copy;
+}
+
 static void
 libarchive_set_archive_type (EvArchive *archive,
 			     EvArchiveType archive_type)
@@ -135,10 +203,24 @@ ev_archive_open_filename (EvArchive   *archive,
 	g_return_val_if_fail (archive->type != EV_ARCHIVE_TYPE_NONE, FALSE);
 	g_return_val_if_fail (path != NULL, FALSE);
 
+	if (g_strcmp0 (archive->path, path) != 0) {
+		g_hash_table_remove_all (archive->entry_offsets);
+		archive->zip_index_built = FALSE;
+		g_free (archive->path);
+		archive->path = g_strdup (path);
+
+		g_clear_pointer (&archive->unarr, ar_close_archive);
+		g_clear_pointer (&archive->unarr_stream, ar_close);
+	}
+
 	switch (archive->type) {
 	case EV_ARCHIVE_TYPE_NONE:
 		g_assert_not_reached ();
 	case EV_ARCHIVE_TYPE_RAR:
+		/* Kept open by ev_archive_reset() */
+		if (archive->unarr != NULL)
+			return TRUE;
+		archive->unarr_rewind = FALSE;
 		archive->unarr_stream = ar_open_file (path);
 		if (archive->unarr_stream == NULL) {
 			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -196,6 +278,41 @@ libarchive_read_next_header (EvArchive *archive,
 	return TRUE;
 }
 
+static void
+ev_archive_add_entry_offset (EvArchive  *archive,
+			     const char *name,
+			     gint64      offset)
+{
+	gint64 *value;
+
+	if (name == NULL || g_hash_table_contains (archive->entry_offsets, name))
+		return;
+
+	value = g_new (gint64, 1);
+	*value = offset;
+	g_hash_table_insert (archive->entry_offsets, g_strdup (name), value);
+}
+
+static gboolean
+unarr_read_next_header (EvArchive *archive)
+{
+	gboolean ok;
+
+	if (archive->unarr_rewind) {
+		archive->unarr_rewind = FALSE;
+		ok = ar_parse_entry_at (archive->unarr, 0);
+	} else {
+		ok = ar_parse_entry (archive->unarr);
+	}
+	if (!ok)
+		return FALSE;
+
+	ev_archive_add_entry_offset (archive,
+				     ar_entry_get_name (archive->unarr),
+				     ar_entry_get_offset (archive->unarr));
+	return TRUE;
+}
+
 gboolean
 ev_archive_read_next_header (EvArchive *archive,
 			     GError   **error)
@@ -207,7 +324,7 @@ ev_archive_read_next_header (EvArchive *archive,
 	case EV_ARCHIVE_TYPE_NONE:
 		g_assert_not_reached ();
 	case EV_ARCHIVE_TYPE_RAR:
-		return ar_parse_entry (archive->unarr);
+		return unarr_read_next_header (archive);
 	case EV_ARCHIVE_TYPE_ZIP:
 	case EV_ARCHIVE_TYPE_7Z:
 	case EV_ARCHIVE_TYPE_TAR:
@@ -330,13 +447,20 @@ ev_archive_reset (EvArchive *archive)
 
 	switch (archive->type) {
 	case EV_ARCHIVE_TYPE_RAR:
-		g_clear_pointer (&archive->unarr, ar_close_archive);
-		g_clear_pointer (&archive->unarr_stream, ar_close);
+		/* Keep the handle, and the solid decompression state with
+		 * it, so that reading a later entry of the same archive
+		 * doesn't decompress everything before it again */
+		archive->unarr_rewind = TRUE;
 		break;
 	case EV_ARCHIVE_TYPE_ZIP:
 	case EV_ARCHIVE_TYPE_7Z:
 	case EV_ARCHIVE_TYPE_TAR:
 		g_clear_pointer (&archive->libar, archive_free);
+		archive->libar_entry = NULL;
+		if (archive->libar_fd != -1) {
+			close (archive->libar_fd);
+			archive->libar_fd = -1;
+		}
 		libarchive_set_archive_type (archive, archive->type);
 		break;
 	default:
@@ -344,7 +468,266 @@ ev_archive_reset (EvArchive *archive)
 	}
 }
 
+static guint32
+read_le32 (const guchar *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((guint32) data[3] << 24);
+}
+
+static guint16
+read_le16 (const guchar *data)
+{
+	return data[0] | (data[1] << 8);
+}
+
+/* Reads the offsets of the local headers from the central directory.
+ * ZIP64 archives and entries are left out of the index, they are
+ * found by walking the archive instead.
+ */
+static void
+zip_build_index (EvArchive *archive)
+{
+	FILE    *file;
+	guchar  *tail = NULL;
+	guchar  *cdir = NULL;
+	gint64   file_size;
+	gsize    tail_size;
+	gssize   i;
+	guint32  cdir_size, cdir_offset;
+	guint16  n_entries;
+	gsize    pos;
+	guint    n;
+
+	archive->zip_index_built = TRUE;
+
+	file = g_fopen (archive->path, "rb");
+	if (!file)
+		return;
+
+	if (fseeko (file, 0, SEEK_END) != 0)
+		goto out;
+	file_size = ftello (file);
+	if (file_size < ZIP_EOCD_SIZE)
+		goto out;
+
+	/* The end of central directory record is followed by a comment */
+	tail_size = MIN (file_size, ZIP_EOCD_SIZE + ZIP_EOCD_MAX_COMMENT);
+	tail = g_malloc (tail_size);
+	if (fseeko (file, file_size - tail_size, SEEK_SET) != 0 ||
+	    fread (tail, 1, tail_size, file) != tail_size)
+		goto out;
+
+	for (i = (gssize) tail_size - ZIP_EOCD_SIZE; i >= 0; i--) {
+		if (read_le32 (tail + i) == ZIP_EOCD_SIGNATURE)
+			break;
+	}
+	if (i < 0)
+		goto out;
+
+	n_entries = read_le16 (tail + i + 10);
+	cdir_size = read_le32 (tail + i + 12);
+	cdir_offset = read_le32 (tail + i + 16);
+	if (cdir_offset == 0xffffffff || (gint64) cdir_offset + cdir_size > file_size)
+		goto out;
+
+	cdir = g_malloc (cdir_size);
+	if (fseeko (file, cdir_offset, SEEK_SET) != 0 ||
+	    fread (cdir, 1, cdir_size, file) != cdir_size)
+		goto out;
+
+	for (n = 0, pos = 0; n < n_entries && pos + ZIP_CDIR_SIZE <= cdir_size; n++) {
+		guint16  name_len, extra_len, comment_len;
+		guint32  offset;
+		gchar   *name;
+
+		if (read_le32 (cdir + pos) != ZIP_CDIR_SIGNATURE)
+			break;
+
+		name_len = read_le16 (cdir + pos + 28);
+		extra_len = read_le16 (cdir + pos + 30);
+		comment_len = read_le16 (cdir + pos + 32);
+		offset = read_le32 (cdir + pos + 42);
+		if (pos + ZIP_CDIR_SIZE + name_len > cdir_size)
+			break;
+
+		if (offset != 0xffffffff) {
+			name = g_strndup ((const gchar *) cdir + pos + ZIP_CDIR_SIZE, name_len);
+			ev_archive_add_entry_offset (archive, name, offset);
+			g_free (name);
+		}
+
+		pos += ZIP_CDIR_SIZE + name_len + extra_len + comment_len;
+	}
+
+	g_debug ("Indexed %u entries of '%s'", g_hash_table_size (archive->entry_offsets), archive->path);
+
+out:
+	g_free (cdir);
+	g_free (tail);
+	fclose (file);
+}
+
+/* Reads the archive from the local header of the entry, which the
+ * streaming ZIP reader takes as the first entry.
+ */
+static gboolean
+zip_seek_entry (EvArchive  *archive,
+		const char *name,
+		gint64      offset)
+{
+	int fd;
+
+	fd = g_open (archive->path, O_RDONLY, 0);
+	if (fd == -1)
+		return FALSE;
+
+	if (lseek (fd, offset, SEEK_SET) != offset) {
+		close (fd);
+		return FALSE;
+	}
+
+	g_clear_pointer (&archive->libar, archive_free);
+	archive->libar_entry = NULL;
+	if (archive->libar_fd != -1)
+		close (archive->libar_fd);
+	archive->libar_fd = fd;
+
+	archive->libar = archive_read_new ();
+	archive_read_support_format_zip_streamable (archive->libar);
+	if (archive_read_open_fd (archive->libar, fd, BUFFER_SIZE) != ARCHIVE_OK)
+		return FALSE;
+
+	if (!libarchive_read_next_header (archive, NULL))
+		return FALSE;
+
+	return g_strcmp0 (archive_entry_pathname (archive->libar_entry), name) == 0;
+}
+
+static gboolean
+ev_archive_walk_to_entry (EvArchive  *archive,
+			  const char *name,
+			  GError    **error)
+{
+	while (ev_archive_read_next_header (archive, error)) {
+		if (g_strcmp0 (ev_archive_get_entry_pathname (archive), name) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * ev_archive_seek_entry:
+ * @archive: an opened #EvArchive
+ * @name: the path name of the entry
+ * @error: return location for an error
+ *
+ * Moves to the header of the entry @name, so that its data can be read
+ * with ev_archive_read_data(). Entries of RAR archives and of ZIP
+ * archives, through their central directory, are reached directly.
+ * For the others the following headers are read until @name is found,
+ * so the archive should have just been opened.
+ *
+ * Returns: %TRUE if the entry was found
+ */
+gboolean
+ev_archive_seek_entry (EvArchive   *archive,
+		       const char  *name,
+		       GError     **error)
+{
+	gint64 *offset;
+
+	g_return_val_if_fail (EV_IS_ARCHIVE (archive), FALSE);
+	g_return_val_if_fail (archive->type != EV_ARCHIVE_TYPE_NONE, FALSE);
+	g_return_val_if_fail (archive->path != NULL, FALSE);
+	g_return_val_if_fail (name != NULL, FALSE);
+
+	if (archive->type == EV_ARCHIVE_TYPE_ZIP && !archive->zip_index_built)
+		zip_build_index (archive);
+
+	offset = g_hash_table_lookup (archive->entry_offsets, name);
+
+	switch (archive->type) {
+	case EV_ARCHIVE_TYPE_NONE:
+		g_assert_not_reached ();
+	case EV_ARCHIVE_TYPE_RAR:
+		g_return_val_if_fail (archive->unarr != NULL, FALSE);
+		archive->unarr_rewind = FALSE;
+		if (offset && ar_parse_entry_at (archive->unarr, *offset) &&
+		    g_strcmp0 (ar_entry_get_name (archive->unarr), name) == 0)
+			return TRUE;
+		if (!ar_parse_entry_at (archive->unarr, 0))
+			return FALSE;
+		ev_archive_add_entry_offset (archive,
+					     ar_entry_get_name (archive->unarr),
+					     ar_entry_get_offset (archive->unarr));
+		if (g_strcmp0 (ar_entry_get_name (archive->unarr), name) == 0)
+			return TRUE;
+		return ev_archive_walk_to_entry (archive, name, error);
+	case EV_ARCHIVE_TYPE_ZIP:
+		if (offset && zip_seek_entry (archive, name, *offset))
+			return TRUE;
+		if (offset) {
+			/* Stored entries with a data descriptor can't be read
+			 * in streaming mode, read the archive normally */
+			g_debug ("Can't read '%s' from its local header", name);
+			ev_archive_reset (archive);
+			if (!ev_archive_open_filename (archive, archive->path, error))
+				return FALSE;
+		}
+		/* fall through */
+	case EV_ARCHIVE_TYPE_7Z:
+	case EV_ARCHIVE_TYPE_TAR:
+		return ev_archive_walk_to_entry (archive, name, error);
+	}
+
+	return FALSE;
+}
+
+/**
+ * ev_archive_is_solid:
+ * @archive: an #EvArchive with a path, see ev_archive_open_filename()
+ *
+ * Whether the entries of @archive are compressed together, so that
+ * reading one decompresses all the ones before it. Only RAR archives
+ * are solid. Archives that can't be told, like self-extracting ones,
+ * are assumed to be solid.
+ *
+ * Returns: %TRUE if seeking to an entry is as slow as reading the
+ *   archive up to it
+ */
+gboolean
+ev_archive_is_solid (EvArchive *archive)
+{
+	guchar  header[RAR_MARKER_SIZE + 5];
+	gssize  n_read = -1;
+	int     fd;
+
+	g_return_val_if_fail (EV_IS_ARCHIVE (archive), FALSE);
+	g_return_val_if_fail (archive->path != NULL, FALSE);
+
+	if (archive->type != EV_ARCHIVE_TYPE_RAR)
+		return FALSE;
+
+	/* The marker block, then the main header: its CRC, type
+	 * and flags */
+	fd = g_open (archive->path, O_RDONLY, 0);
+	if (fd != -1) {
+		n_read = read (fd, header, sizeof (header));
+		close (fd);
+	}
+
+	if (n_read != sizeof (header) ||
+	    memcmp (header, RAR_MARKER, RAR_MARKER_SIZE) != 0 ||
+	    header[RAR_MARKER_SIZE + 2] != RAR_MAIN_HEAD_TYPE)
+		return TRUE;
+
+	return ((header[RAR_MARKER_SIZE + 3] | header[RAR_MARKER_SIZE + 4] << 8) & RAR_MAIN_HEAD_SOLID) != 0;
+}
+
 static void
 ev_archive_init (EvArchive *archive)
 {
+	archive->libar_fd = -1;
+	archive->entry_offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
@@ -36,6 +36,7 @@ typedef enum {
 } EvArchiveType;
 
 EvArchive     *ev_archive_new                (void);
+EvArchive     *ev_archive_dup                (EvArchive     *archive);
 gboolean       ev_archive_set_archive_type   (EvArchive     *archive,
 					      EvArchiveType  archive_type);
 EvArchiveType  ev_archive_get_archive_type   (EvArchive     *archive);
@@ -44,6 +45,9 @@ gboolean       ev_archive_open_filename      (EvArchive     *archive,
 					      GError       **error);
 gboolean       ev_archive_read_next_header   (EvArchive     *archive,
 					      GError       **error);
+gboolean       ev_archive_seek_entry         (EvArchive     *archive,
+					      const char    *name,
+					      GError       **error);
 const char    *ev_archive_get_entry_pathname (EvArchive     *archive);
 gint64         ev_archive_get_entry_size     (EvArchive     *archive);
 gboolean       ev_archive_get_entry_is_encrypted (EvArchive *archive);
@@ -52,6 +56,7 @@ gssize         ev_archive_read_data          (EvArchive     *archive,
 					      gsize          count,
 					      GError       **error);
 void           ev_archive_reset              (EvArchive     *archive);
+gboolean       ev_archive_is_solid           (EvArchive     *archive);
 
 G_END_DECLS
 
@@ -22,9 +22,18 @@
 #define __DJVU_DOCUMENT_INTERNAL_H__
 
 #include "djvu-document.h"
+#include "djvu-text-page.h"
 
 #include <libdjvu/ddjvuapi.h>
 
+/* Pages kept decoded, the requested one and its neighbours */
+#define DJVU_PAGE_CACHE_SIZE 4
+
+typedef struct {
+	gint          index;
+	ddjvu_page_t *d_page;
+} DjvuCachedPage;
+
 struct _DjvuDocument {
 	EvDocument        parent_instance;
 
@@ -33,14 +42,29 @@ struct _DjvuDocument {
 	ddjvu_format_t   *d_format;
 	ddjvu_format_t   *thumbs_format;
 
+	/* Most recently requested first */
+	DjvuCachedPage    page_cache[DJVU_PAGE_CACHE_SIZE];
+
+	/* Signalled by ddjvuapi threads when a message is posted */
+	GMutex            message_mutex;
+	GCond             message_cond;
+	guint             message_serial;
+
 	gchar            *uri;
 
         /* PS exporter */
         gchar		 *ps_filename;
         GString 	 *opts;
+	GArray           *export_pages;
 	ddjvu_fileinfo_t *fileinfo_pages;
 	gint		  n_pages;
 	GHashTable	 *file_ids;
+
+	/* Text of the pages, built on demand and in the background.
+	 * Accessed with the document lock held. */
+	DjvuTextPage    **text_pages;
+	GThreadPool      *text_pool;
+	gint              text_pool_stop;
 };
 
 int  djvu_document_get_n_pages (EvDocument   *document);
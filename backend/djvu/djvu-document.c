@@ -29,6 +29,7 @@
 #include "ev-document-find.h"
 #include "ev-document-links.h"
 #include "ev-selection.h"
+#include "ev-surface-pool.h"
 #include "ev-file-helpers.h"
 #include "ev-document-text.h"
 
@@ -67,6 +68,19 @@ EV_BACKEND_REGISTER_WITH_CODE (DjvuDocument, djvu_document,
 
 #define EV_DJVU_ERROR ev_djvu_error_quark ()
 
+/* Rows rendered between checks for cancellation */
+#define DJVU_RENDER_BAND_HEIGHT 256
+
+/* Time waited for a message between checks for cancellation */
+#define DJVU_MESSAGE_TIMEOUT (G_USEC_PER_SEC / 20)
+
+/* Pages whose thumbnails are generated in the background after the
+ * requested one, when the document doesn't store them */
+#define DJVU_THUMBNAIL_PREFETCH 4
+
+/* Pages decoded ahead of the printed one, per processor, while exporting */
+#define DJVU_EXPORT_PAGES_AHEAD 2
+
 static GQuark
 ev_djvu_error_quark (void)
 {
@@ -128,6 +142,110 @@ djvu_handle_events (DjvuDocument *djvu_document, int wait, GError **error)
 	}
 }
 
+/* Called from ddjvuapi threads, it must not peek nor pop messages */
+static void
+djvu_message_callback (ddjvu_context_t *context,
+		       void            *closure)
+{
+	DjvuDocument *djvu_document = (DjvuDocument *)closure;
+
+	g_mutex_lock (&djvu_document->message_mutex);
+	djvu_document->message_serial++;
+	g_cond_broadcast (&djvu_document->message_cond);
+	g_mutex_unlock (&djvu_document->message_mutex);
+}
+
+/* Returns the decoded page @index, creating it if it's not in the
+ * cache, which starts decoding it in the background. The cache owns
+ * the returned page. */
+static ddjvu_page_t *
+djvu_document_get_cached_page (DjvuDocument *djvu_document,
+			       gint          index)
+{
+	DjvuCachedPage *cache = djvu_document->page_cache;
+	DjvuCachedPage  cached;
+	gint            i;
+
+	for (i = 0; i < DJVU_PAGE_CACHE_SIZE - 1; i++) {
+		if (cache[i].d_page && cache[i].index == index)
+			break;
+	}
+
+	if (cache[i].d_page && cache[i].index == index) {
+		cached = cache[i];
+	} else {
+		if (cache[i].d_page)
+			ddjvu_page_release (cache[i].d_page);
+		cached.index = index;
+		cached.d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, index);
+	}
+
+	memmove (cache + 1, cache, i * sizeof (DjvuCachedPage));
+	cache[0] = cached;
+
+	return cached.d_page;
+}
+
+static void
+djvu_document_clear_page_cache (DjvuDocument *djvu_document)
+{
+	gint i;
+
+	for (i = 0; i < DJVU_PAGE_CACHE_SIZE; i++) {
+		if (djvu_document->page_cache[i].d_page)
+			ddjvu_page_release (djvu_document->page_cache[i].d_page);
+		djvu_document->page_cache[i].d_page = NULL;
+	}
+}
+
+/* Waits until ddjvuapi posts a new message after @serial, or until
+ * the timeout, and returns the current serial */
+static guint
+djvu_wait_for_serial (DjvuDocument *djvu_document,
+		      guint         serial)
+{
+	gint64 end_time;
+
+	end_time = g_get_monotonic_time () + DJVU_MESSAGE_TIMEOUT;
+	g_mutex_lock (&djvu_document->message_mutex);
+	while (djvu_document->message_serial == serial) {
+		if (!g_cond_wait_until (&djvu_document->message_cond,
+					&djvu_document->message_mutex,
+					end_time))
+			break;
+	}
+	serial = djvu_document->message_serial;
+	g_mutex_unlock (&djvu_document->message_mutex);
+
+	return serial;
+}
+
+/* Waits until @d_page is decoded, or until @rc is cancelled */
+static gboolean
+djvu_wait_for_page (DjvuDocument    *djvu_document,
+		    ddjvu_page_t    *d_page,
+		    EvRenderContext *rc)
+{
+	guint serial;
+
+	g_mutex_lock (&djvu_document->message_mutex);
+	serial = djvu_document->message_serial;
+	g_mutex_unlock (&djvu_document->message_mutex);
+
+	while (TRUE) {
+		djvu_handle_events (djvu_document, FALSE, NULL);
+		if (ddjvu_page_decoding_done (d_page))
+			return TRUE;
+
+		/* Decoding goes on in the background, and the
+		 * page is ready when it's requested again */
+		if (ev_render_context_is_cancelled (rc))
+			return FALSE;
+
+		serial = djvu_wait_for_serial (djvu_document, serial);
+	}
+}
+
 static void
 djvu_wait_for_message (DjvuDocument *djvu_document, ddjvu_message_tag_t message, GError **error)
 {
@@ -223,6 +341,7 @@ djvu_document_load (EvDocument  *document,
 	if (djvu_document->n_pages > 0) {
 		djvu_document->fileinfo_pages = g_new0 (ddjvu_fileinfo_t, djvu_document->n_pages);
 		djvu_document->file_ids = g_hash_table_new (g_str_hash, g_str_equal);
+		djvu_document->text_pages = g_new0 (DjvuTextPage *, djvu_document->n_pages);
 	}
 	if (ddjvu_document_get_type (djvu_document->d_document) == DDJVU_DOCTYPE_INDIRECT)
 		check_for_missing_files = TRUE;
@@ -280,7 +399,7 @@ djvu_document_save (EvDocument  *document,
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
 
-	return ev_xfer_uri_simple (djvu_document->uri, uri, error);
+	return ev_file_clone_uri (djvu_document->uri, uri, error);
 }
 
 int
@@ -341,16 +460,23 @@ djvu_document_render (EvDocument      *document,
 	gint   rowstride;
     	ddjvu_rect_t rrect;
 	ddjvu_rect_t prect;
+	ddjvu_rect_t band;
+	cairo_rectangle_int_t area;
 	ddjvu_page_t *d_page;
 	ddjvu_page_rotation_t rotation;
 	gint buffer_modified;
 	double page_width, page_height;
 	gint transformed_width, transformed_height;
 
-	d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, rc->page->index);
-	
-	while (!ddjvu_page_decoding_done (d_page))
-		djvu_handle_events(djvu_document, TRUE, NULL);
+	/* Start decoding the neighbours too, they are likely next */
+	if (rc->page->index + 1 < djvu_document->n_pages)
+		djvu_document_get_cached_page (djvu_document, rc->page->index + 1);
+	if (rc->page->index > 0)
+		djvu_document_get_cached_page (djvu_document, rc->page->index - 1);
+	d_page = djvu_document_get_cached_page (djvu_document, rc->page->index);
+
+	if (!djvu_wait_for_page (djvu_document, d_page, rc))
+		return NULL;
 
 	document_get_page_size (djvu_document, rc->page->index, &page_width, &page_height, NULL);
 	rotation = ddjvu_page_get_initial_rotation (d_page);
@@ -380,26 +506,46 @@ djvu_document_render (EvDocument      *document,
 	}
 	rotation = rotation % 4;
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
-					      transformed_width, transformed_height);
-
-	rowstride = cairo_image_surface_get_stride (surface);
-	pixels = (gchar *)cairo_image_surface_get_data (surface);
-
 	prect.x = 0;
 	prect.y = 0;
 	prect.w = transformed_width;
 	prect.h = transformed_height;
-	rrect = prect;
+
+	/* Only the requested area of the scaled page is rasterized */
+	if (ev_render_context_get_area (rc, &area)) {
+		rrect.x = area.x;
+		rrect.y = area.y;
+		rrect.w = area.width;
+		rrect.h = area.height;
+	} else {
+		rrect = prect;
+	}
+
+	surface = ev_surface_pool_create_surface (CAIRO_FORMAT_RGB24,
+						  rrect.w, rrect.h);
+
+	rowstride = cairo_image_surface_get_stride (surface);
+	pixels = (gchar *)cairo_image_surface_get_data (surface);
 
 	ddjvu_page_set_rotation (d_page, rotation);
-	
-	buffer_modified = ddjvu_page_render (d_page, DDJVU_RENDER_COLOR,
-					     &prect,
-					     &rrect,
-					     djvu_document->d_format,
-					     rowstride,
-					     pixels);
+
+	/* Render in bands, so that cancelled renders stop early */
+	buffer_modified = FALSE;
+	band = rrect;
+	for (band.y = rrect.y; band.y < rrect.y + rrect.h; band.y += DJVU_RENDER_BAND_HEIGHT) {
+		if (ev_render_context_is_cancelled (rc)) {
+			cairo_surface_destroy (surface);
+			return NULL;
+		}
+
+		band.h = MIN (DJVU_RENDER_BAND_HEIGHT, rrect.y + rrect.h - band.y);
+		buffer_modified |= ddjvu_page_render (d_page, DDJVU_RENDER_COLOR,
+						      &prect,
+						      &band,
+						      djvu_document->d_format,
+						      rowstride,
+						      pixels + (band.y - rrect.y) * rowstride);
+	}
 
 	if (!buffer_modified) {
 		cairo_t *cr = cairo_create (surface);
@@ -414,6 +560,12 @@ djvu_document_render (EvDocument      *document,
 	return surface;
 }
 
+static gboolean
+djvu_document_can_render_area (EvDocument *document)
+{
+	return TRUE;
+}
+
 static char *
 djvu_document_get_page_label (EvDocument *document,
                               EvPage     *page)
@@ -435,6 +587,68 @@ djvu_document_get_page_label (EvDocument *document,
 	return label;
 }
 
+/* Returns whether @index is decoded in the page cache already, which
+ * makes rendering it faster than computing its thumbnail */
+static gboolean
+djvu_document_page_is_decoded (DjvuDocument *djvu_document,
+			       gint          index)
+{
+	gint i;
+
+	for (i = 0; i < DJVU_PAGE_CACHE_SIZE; i++) {
+		DjvuCachedPage *cached = &djvu_document->page_cache[i];
+
+		if (cached->d_page && cached->index == index)
+			return ddjvu_page_decoding_done (cached->d_page);
+	}
+
+	return FALSE;
+}
+
+/* Returns TRUE when the thumbnail of the page of @rc can be rendered by
+ * ddjvuapi, and FALSE when the page should be rendered instead.
+ * Thumbnails stored in the document are used right away. Otherwise the
+ * thumbnail is computed by decoding the page, and the following ones are
+ * computed in the background, so that they are ready when the sidebar
+ * requests them. */
+static gboolean
+djvu_document_wait_for_thumbnail (DjvuDocument    *djvu_document,
+				  EvRenderContext *rc)
+{
+	ddjvu_document_t *d_document = djvu_document->d_document;
+	gint              index = rc->page->index;
+	ddjvu_status_t    status;
+	guint             serial;
+	gint              i;
+
+	status = ddjvu_thumbnail_status (d_document, index, 0);
+	if (status == DDJVU_JOB_OK)
+		return TRUE;
+
+	if (djvu_document_page_is_decoded (djvu_document, index))
+		return FALSE;
+
+	for (i = 1; i <= DJVU_THUMBNAIL_PREFETCH && index + i < djvu_document->n_pages; i++)
+		ddjvu_thumbnail_status (d_document, index + i, 1);
+
+	g_mutex_lock (&djvu_document->message_mutex);
+	serial = djvu_document->message_serial;
+	g_mutex_unlock (&djvu_document->message_mutex);
+
+	while (TRUE) {
+		djvu_handle_events (djvu_document, FALSE, NULL);
+		status = ddjvu_thumbnail_status (d_document, index, 1);
+		if (status >= DDJVU_JOB_OK)
+			return status == DDJVU_JOB_OK;
+
+		/* The thumbnail job goes on in the background */
+		if (ev_render_context_is_cancelled (rc))
+			return FALSE;
+
+		serial = djvu_wait_for_serial (djvu_document, serial);
+	}
+}
+
 static GdkPixbuf *
 djvu_document_get_thumbnail (EvDocument      *document,
 			     EvRenderContext *rc)
@@ -453,14 +667,24 @@ djvu_document_get_thumbnail (EvDocument      *document,
 	ev_render_context_compute_scaled_size (rc, page_width, page_height,
 					       &thumb_width, &thumb_height);
 
+	if (!djvu_document_wait_for_thumbnail (djvu_document, rc)) {
+		cairo_surface_t *surface;
+
+		surface = djvu_document_render (document, rc);
+		if (!surface)
+			return NULL;
+
+		pixbuf = ev_document_misc_pixbuf_from_surface (surface);
+		cairo_surface_destroy (surface);
+
+		return pixbuf;
+	}
+
 	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
 				 thumb_width, thumb_height);
 	gdk_pixbuf_fill (pixbuf, 0xffffffff);
 	pixels = gdk_pixbuf_get_pixels (pixbuf);
 	
-	while (ddjvu_thumbnail_status (djvu_document->d_document, rc->page->index, 1) < DDJVU_JOB_OK)
-		djvu_handle_events(djvu_document, TRUE, NULL);
-		    
 	ddjvu_thumbnail_render (djvu_document->d_document, rc->page->index, 
 				&thumb_width, &thumb_height,
 				djvu_document->thumbs_format,
@@ -492,13 +716,13 @@ djvu_document_get_thumbnail_surface (EvDocument      *document,
 	ev_render_context_compute_scaled_size (rc, page_width, page_height,
 					       &thumb_width, &thumb_height);
 
+	if (!djvu_document_wait_for_thumbnail (djvu_document, rc))
+		return djvu_document_render (document, rc);
+
 	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
 					      thumb_width, thumb_height);
 	pixels = (gchar *)cairo_image_surface_get_data (surface);
 
-	while (ddjvu_thumbnail_status (djvu_document->d_document, rc->page->index, 1) < DDJVU_JOB_OK)
-		djvu_handle_events(djvu_document, TRUE, NULL);
-
 	thumbnail_rendered = ddjvu_thumbnail_render (djvu_document->d_document,
 						     rc->page->index,
 						     &thumb_width, &thumb_height,
@@ -527,12 +751,31 @@ djvu_document_finalize (GObject *object)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (object);
 
+	if (djvu_document->text_pool) {
+		g_atomic_int_set (&djvu_document->text_pool_stop, TRUE);
+		g_thread_pool_free (djvu_document->text_pool, TRUE, TRUE);
+	}
+
+	if (djvu_document->text_pages) {
+		gint i;
+
+		for (i = 0; i < djvu_document->n_pages; i++) {
+			if (djvu_document->text_pages[i])
+				djvu_text_page_free (djvu_document->text_pages[i]);
+		}
+		g_free (djvu_document->text_pages);
+	}
+
+	djvu_document_clear_page_cache (djvu_document);
+
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 	    
 	if (djvu_document->opts)
 	    g_string_free (djvu_document->opts, TRUE);
 
+	g_array_free (djvu_document->export_pages, TRUE);
+
 	if (djvu_document->ps_filename)
 	    g_free (djvu_document->ps_filename);
 	    
@@ -542,7 +785,10 @@ djvu_document_finalize (GObject *object)
 	if (djvu_document->file_ids)
 	    g_hash_table_destroy (djvu_document->file_ids);
 
+	ddjvu_message_set_callback (djvu_document->d_context, NULL, NULL);
 	ddjvu_context_release (djvu_document->d_context);
+	g_mutex_clear (&djvu_document->message_mutex);
+	g_cond_clear (&djvu_document->message_cond);
 	ddjvu_format_release (djvu_document->d_format);
 	ddjvu_format_release (djvu_document->thumbs_format);
 	g_free (djvu_document->uri);
@@ -564,32 +810,83 @@ djvu_document_class_init (DjvuDocumentClass *klass)
 	ev_document_class->get_page_label = djvu_document_get_page_label;
 	ev_document_class->get_page_size = djvu_document_get_page_size;
 	ev_document_class->render = djvu_document_render;
+	ev_document_class->can_render_area = djvu_document_can_render_area;
 	ev_document_class->get_thumbnail = djvu_document_get_thumbnail;
 	ev_document_class->get_thumbnail_surface = djvu_document_get_thumbnail_surface;
 }
 
-static gchar *
-djvu_text_copy (DjvuDocument *djvu_document,
-		gint           page_num,
-		EvRectangle  *rectangle)
+static DjvuTextPage *
+djvu_document_build_text_page (DjvuDocument *djvu_document,
+			       gint          page)
 {
-	miniexp_t page_text;
-	gchar    *text = NULL;
+	DjvuTextPage *tpage;
+	miniexp_t     page_text;
 
-	while ((page_text =
-		ddjvu_document_get_pagetext (djvu_document->d_document,
-					     page_num, "char")) == miniexp_dummy)
+	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
+							 page, "char")) == miniexp_dummy)
 		djvu_handle_events (djvu_document, TRUE, NULL);
 
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *page = djvu_text_page_new (page_text);
-		
-		text = djvu_text_page_copy (page, rectangle);
-		djvu_text_page_free (page);
+	tpage = djvu_text_page_new (page_text);
+	if (page_text != miniexp_nil)
 		ddjvu_miniexp_release (djvu_document->d_document, page_text);
+
+	return tpage;
+}
+
+/* Builds the text of the pages that haven't been requested yet, so that
+ * searches find them ready. The document lock is taken for each page,
+ * jobs run in between. */
+static void
+djvu_document_build_text_pages (gpointer data,
+				gpointer user_data)
+{
+	DjvuDocument *djvu_document = DJVU_DOCUMENT (user_data);
+	gint          first = GPOINTER_TO_INT (data);
+	gint          i;
+
+	for (i = 0; i < djvu_document->n_pages; i++) {
+		gint page = (first + i) % djvu_document->n_pages;
+
+		if (g_atomic_int_get (&djvu_document->text_pool_stop))
+			return;
+
+		ev_document_lock (EV_DOCUMENT (djvu_document));
+		if (!djvu_document->text_pages[page])
+			djvu_document->text_pages[page] = djvu_document_build_text_page (djvu_document, page);
+		ev_document_unlock (EV_DOCUMENT (djvu_document));
+	}
+}
+
+/* Must be called with the document lock held. The document owns the
+ * returned page. */
+static DjvuTextPage *
+djvu_document_get_text_page (DjvuDocument *djvu_document,
+			     gint          page)
+{
+	if (djvu_document->text_pages[page])
+		return djvu_document->text_pages[page];
+
+	djvu_document->text_pages[page] = djvu_document_build_text_page (djvu_document, page);
+
+	if (!djvu_document->text_pool) {
+		djvu_document->text_pool = g_thread_pool_new (djvu_document_build_text_pages,
+							      djvu_document,
+							      1, FALSE, NULL);
+		g_thread_pool_push (djvu_document->text_pool,
+				    GINT_TO_POINTER (page + 1), NULL);
 	}
 
-	return text;
+	return djvu_document->text_pages[page];
+}
+
+static gchar *
+djvu_text_copy (DjvuDocument *djvu_document,
+		gint           page_num,
+		EvRectangle  *rectangle)
+{
+	DjvuTextPage *tpage = djvu_document_get_text_page (djvu_document, page_num);
+
+	return djvu_text_page_copy (tpage, rectangle);
 }
 
 static void
@@ -611,25 +908,14 @@ djvu_selection_get_selection_rects (DjvuDocument    *djvu_document,
 				    gdouble          height,
 				    gdouble          dpi)
 {
-	miniexp_t   page_text;
-	EvRectangle rectangle;
-	GList      *rects = NULL;
+	DjvuTextPage *tpage;
+	EvRectangle   rectangle;
 
 	djvu_convert_to_doc_rect (&rectangle, points, height, dpi);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page, "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-
-		rects = djvu_text_page_get_selection_region (tpage, &rectangle);
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
-	}
+	tpage = djvu_document_get_text_page (djvu_document, page);
 
-	return rects;
+	return djvu_text_page_get_selection_region (tpage, &rectangle);
 }
 
 static cairo_region_t *
@@ -737,24 +1023,13 @@ djvu_document_text_get_text (EvDocumentText  *selection,
                              EvPage          *page)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (selection);
-	miniexp_t     page_text;
-	gchar        *text = NULL;
+	DjvuTextPage *tpage;
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
+	tpage = djvu_document_get_text_page (djvu_document, page->index);
+	if (tpage->tokens->len == 0)
+		return NULL;
 
-		djvu_text_page_index_text (tpage, TRUE);
-		text = tpage->text;
-		tpage->text = NULL;
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
-	}
-	return text;
+	return g_strdup (tpage->text);
 }
 
 static void
@@ -776,6 +1051,7 @@ djvu_document_file_exporter_begin (EvFileExporter        *exporter,
 	djvu_document->ps_filename = g_strdup (fc->filename);
 
 	g_string_assign (djvu_document->opts, "-page=");
+	g_array_set_size (djvu_document->export_pages, 0);
 }
 
 static void
@@ -785,6 +1061,38 @@ djvu_document_file_exporter_do_page (EvFileExporter  *exporter,
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (exporter);
 	
 	g_string_append_printf (djvu_document->opts, "%d,", (rc->page->index) + 1); 
+	g_array_append_val (djvu_document->export_pages, rc->page->index);
+}
+
+/* The print job decodes the pages one after the other. Pages after the
+ * one being printed are decoded concurrently by ddjvuapi threads, so
+ * that they're ready when the job gets to them. The job reports how far
+ * it got with progress messages. */
+static void
+djvu_document_file_exporter_decode_ahead (DjvuDocument *djvu_document,
+					  GQueue       *decoding,
+					  gint         *next,
+					  gint          printed)
+{
+	GArray *pages = djvu_document->export_pages;
+	guint   max_ahead = DJVU_EXPORT_PAGES_AHEAD * g_get_num_processors ();
+
+	/* Pages before the printed one aren't needed anymore, the queue
+	 * holds the ones from *next - length to *next */
+	while (!g_queue_is_empty (decoding) &&
+	       *next - (gint)g_queue_get_length (decoding) < printed)
+		ddjvu_page_release (g_queue_pop_head (decoding));
+
+	if (*next < printed)
+		*next = printed;
+
+	while (*next < (gint)pages->len && g_queue_get_length (decoding) < max_ahead) {
+		gint index = g_array_index (pages, gint, *next);
+
+		g_queue_push_tail (decoding,
+				   ddjvu_page_create_by_pageno (djvu_document->d_document, index));
+		(*next)++;
+	}
 }
 
 static void
@@ -793,6 +1101,9 @@ djvu_document_file_exporter_end (EvFileExporter *exporter)
 	int d_optc = 1; 
 	const char *d_optv[d_optc];
 	ddjvu_job_t *job;
+	GQueue decoding = G_QUEUE_INIT;
+	gint next = 0;
+	gint printed = 0;
 
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (exporter);
 
@@ -805,10 +1116,24 @@ djvu_document_file_exporter_end (EvFileExporter *exporter)
 	d_optv[0] = djvu_document->opts->str; 
 
 	job = ddjvu_document_print(djvu_document->d_document, fn, d_optc, d_optv);
+	djvu_document_file_exporter_decode_ahead (djvu_document, &decoding, &next, printed);
 	while (!ddjvu_job_done(job)) {	
-		djvu_handle_events (djvu_document, TRUE, NULL);
+		const ddjvu_message_t *msg;
+
+		ddjvu_message_wait (djvu_document->d_context);
+		while ((msg = ddjvu_message_peek (djvu_document->d_context))) {
+			if (msg->m_any.tag == DDJVU_PROGRESS && msg->m_any.job == job)
+				printed = msg->m_progress.percent * (gint)djvu_document->export_pages->len / 100;
+			handle_message (msg, NULL);
+			ddjvu_message_pop (djvu_document->d_context);
+		}
+		djvu_document_file_exporter_decode_ahead (djvu_document, &decoding, &next, printed);
 	}
 
+	while (!g_queue_is_empty (&decoding))
+		ddjvu_page_release (g_queue_pop_head (&decoding));
+	ddjvu_job_release (job);
+
 	fclose(fn); 
 }
 
@@ -837,6 +1162,10 @@ djvu_document_init (DjvuDocument *djvu_document)
 	guint masks[4] = { 0xff0000, 0xff00, 0xff, 0xff000000 };
 	
 	djvu_document->d_context = ddjvu_context_create ("Evince");
+	g_mutex_init (&djvu_document->message_mutex);
+	g_cond_init (&djvu_document->message_cond);
+	ddjvu_message_set_callback (djvu_document->d_context,
+				    djvu_message_callback, djvu_document);
 	djvu_document->d_format = ddjvu_format_create (DDJVU_FORMAT_RGBMASK32, 4, masks);
 	ddjvu_format_set_row_order (djvu_document->d_format, 1);
 
@@ -845,6 +1174,7 @@ djvu_document_init (DjvuDocument *djvu_document)
 
 	djvu_document->ps_filename = NULL;
 	djvu_document->opts = g_string_new ("");
+	djvu_document->export_pages = g_array_new (FALSE, FALSE, sizeof (gint));
 	
 	djvu_document->d_document = NULL;
 }
@@ -856,28 +1186,14 @@ djvu_document_find_find_text (EvDocumentFind   *document,
 			      gboolean          case_sensitive)
 {
         DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
-	miniexp_t page_text;
+	DjvuTextPage *tpage;
 	gdouble width, height, dpi;
-	GList *matches = NULL, *l;
+	GList *matches, *l;
 
 	g_return_val_if_fail (text != NULL, NULL);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-		
-		djvu_text_page_index_text (tpage, case_sensitive);
-		if (tpage->links->len > 0) {
-			djvu_text_page_search (tpage, text);
-			matches = tpage->results;
-		}
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
-	}
+	tpage = djvu_document_get_text_page (djvu_document, page->index);
+	matches = djvu_text_page_search (tpage, text, case_sensitive);
 	if (!matches)
 		return NULL;
 
@@ -23,188 +23,104 @@
 #include <libdjvu/miniexp.h>
 #include "djvu-text-page.h"
 
+/* Set in the delimit field of tokens preceded by a space in the text */
+#define DJVU_TEXT_TOKEN_SEPARATED 4
 
 /**
  * djvu_text_page_union:
  * @target: first rectangle and result
- * @source: second rectangle
+ * @token: token to add
  *
- * Calculates the bounding box of two rectangles and stores the result
- * in the first.
+ * Calculates the bounding box of a rectangle and a token and stores the
+ * result in the rectangle.
  */
 static void
-djvu_text_page_union (EvRectangle *target,
-		      EvRectangle *source)
+djvu_text_page_union (EvRectangle   *target,
+		      DjvuTextToken *token)
 {
-	if (source->x1 < target->x1)
-		target->x1 = source->x1;
-	if (source->x2 > target->x2)
-		target->x2 = source->x2;
-	if (source->y1 < target->y1)
-		target->y1 = source->y1;
-	if (source->y2 > target->y2)
-		target->y2 = source->y2;
+	if (token->x1 < target->x1)
+		target->x1 = token->x1;
+	if (token->x2 > target->x2)
+		target->x2 = token->x2;
+	if (token->y1 < target->y1)
+		target->y1 = token->y1;
+	if (token->y2 > target->y2)
+		target->y2 = token->y2;
 }
 
-/**
- * djvu_text_page_selection_process_box:
- * @page: #DjvuTextPage instance
- * @p: s-expression to append bounding box of
- * @delimit: character/word/... delimiter
- *
- * Appends bounding box of the line containing miniexp_t to page->results
- *
- * Returns: whether the end was not reached in this s-expression
- */
-static gboolean
-djvu_text_page_selection_process_box (DjvuTextPage *page,
-				      miniexp_t     p,
-				      int           delimit)
+static EvRectangle *
+djvu_text_page_token_box (DjvuTextToken *token)
 {
-	if (page->results || p == page->start) {
-		EvRectangle box;
+	EvRectangle *box = ev_rectangle_new ();
 
-		box.x1 = miniexp_to_int (miniexp_nth (1, p));
-		box.y1 = miniexp_to_int (miniexp_nth (2, p));
-		box.x2 = miniexp_to_int (miniexp_nth (3, p));
-		box.y2 = miniexp_to_int (miniexp_nth (4, p));
+	box->x1 = token->x1;
+	box->y1 = token->y1;
+	box->x2 = token->x2;
+	box->y2 = token->y2;
 
-		if (!(delimit & 2) && page->results != NULL) {
-			EvRectangle *union_box = (EvRectangle *)page->results->data;
-
-                        /* If still on the same line, add box to union */
-			djvu_text_page_union (union_box, &box);
-		} else {
-			/* A new line, a new box */
-			page->results = g_list_prepend (page->results, ev_rectangle_copy (&box));
-		}
-
-		if (p == page->end)
-			return FALSE;
-	}
-	return TRUE;
+	return box;
 }
 
 /**
- * djvu_text_page_selection_process_text:
+ * djvu_text_page_token_text:
  * @page: #DjvuTextPage instance
- * @p: s-expression to append
- * @delimit: character/word/... delimiter
- * 
- * Appends the string in @p to the page text.
- * 
- * Returns: whether the end was not reached in this s-expression
+ * @index: index of the token
+ * @length: return location for the length of the token text
+ *
+ * Returns: the text of the token, without the separator
  */
-static gboolean
-djvu_text_page_selection_process_text (DjvuTextPage *page,
-                                       miniexp_t     p,
-                                       int           delimit)
+static const char *
+djvu_text_page_token_text (DjvuTextPage *page,
+			   guint         index,
+			   gsize        *length)
 {
-	if (page->text || p == page->start) {
-		char *token_text = (char *) miniexp_to_str (miniexp_nth (5, p));
-		if (page->text) {
-			char *new_text =
-			    g_strjoin (delimit & 2 ? "\n" : 
-			    	       delimit & 1 ? " " : NULL,
-				       page->text, token_text,
-				       NULL);
-			g_free (page->text);
-			page->text = new_text;
-		} else
-			page->text = g_strdup (token_text);
-		if (p == page->end) 
-			return FALSE;
-	}
-	return TRUE;
+	DjvuTextToken *token = &g_array_index (page->tokens, DjvuTextToken, index);
+	guint start = token->offset;
+	guint end;
+
+	if (index + 1 < page->tokens->len)
+		end = g_array_index (page->tokens, DjvuTextToken, index + 1).offset;
+	else
+		end = strlen (page->text);
+
+	if (token->delimit & DJVU_TEXT_TOKEN_SEPARATED)
+		start++;
+
+	*length = end - start;
+	return page->text + start;
 }
 
 /**
- * djvu_text_page_selection:
+ * djvu_text_page_limits:
  * @page: #DjvuTextPage instance
- * @p: tree to append
- * @delimit: character/word/... delimiter
- * 
- * Walks the tree in @p and appends the text or bounding boxes with
- * djvu_text_page_selection_process_{text|box}() for all s-expressions
- * between the start and end fields.
- * 
- * Returns: whether the end was not reached in this subtree
+ * @rect: #EvRectangle of the selection
+ * @start: return location for the first token in @rect
+ * @end: return location for the last token in @rect
+ *
+ * Returns: whether any token is in @rect
  */
 static gboolean
-djvu_text_page_selection (DjvuSelectionType type,
-			  DjvuTextPage *page,
-			  miniexp_t     p,
-			  int           delimit)
+djvu_text_page_limits (DjvuTextPage *page,
+		       EvRectangle  *rect,
+		       guint        *start,
+		       guint        *end)
 {
-        miniexp_t deeper;
-
-	g_return_val_if_fail (miniexp_consp (p) && miniexp_symbolp
-			      (miniexp_car (p)), FALSE);
-
-	if (miniexp_car (p) != page->char_symbol) 
-		delimit |= miniexp_car (p) == page->word_symbol ? 1 : 2;
-		
-	deeper = miniexp_cddr (miniexp_cdddr (p));
-	while (deeper != miniexp_nil) {
-		miniexp_t str = miniexp_car (deeper);
-		if (miniexp_stringp (str)) {
-			if (type == DJVU_SELECTION_TEXT) {
-				if (!djvu_text_page_selection_process_text (page, p, delimit))
-					return FALSE;
-			} else {
-				if (!djvu_text_page_selection_process_box (page, p, delimit))
-					return FALSE;
-			}
-		} else {
-			if (!djvu_text_page_selection (type, page, str, delimit))
-				return FALSE;
+	gboolean found = FALSE;
+	guint i;
+
+	for (i = 0; i < page->tokens->len; i++) {
+		DjvuTextToken *token = &g_array_index (page->tokens, DjvuTextToken, i);
+
+		if (token->x2 >= rect->x1 && token->y1 <= rect->y2 &&
+		    token->x1 <= rect->x2 && token->y2 >= rect->y1) {
+			if (!found)
+				*start = i;
+			*end = i;
+			found = TRUE;
 		}
-		delimit = 0;
-		deeper = miniexp_cdr (deeper);
 	}
-	return TRUE;
-}
-
-static void
-djvu_text_page_limits_process (DjvuTextPage *page,
-			       miniexp_t     p, 
-			       EvRectangle  *rect)
-{
-	EvRectangle current;
-	
-	current.x1 = miniexp_to_int (miniexp_nth (1, p));
-	current.y1 = miniexp_to_int (miniexp_nth (2, p));
-	current.x2 = miniexp_to_int (miniexp_nth (3, p));
-	current.y2 = miniexp_to_int (miniexp_nth (4, p));
-	if (current.x2 >= rect->x1 && current.y1 <= rect->y2 &&
-	    current.x1 <= rect->x2 && current.y2 >= rect->y1) {
-	    	if (page->start == miniexp_nil)
-	    		page->start = p;
-	    	page->end = p;
-	}
-}
-
 
-static void
-djvu_text_page_limits (DjvuTextPage *page,
-			  miniexp_t     p, 
-			  EvRectangle  *rect)
-{
-        miniexp_t deeper;
-
-	g_return_if_fail (miniexp_consp (p) && 
-			  miniexp_symbolp (miniexp_car (p)));
-
-	deeper = miniexp_cddr (miniexp_cdddr (p));
-	while (deeper != miniexp_nil) {
-		miniexp_t str = miniexp_car (deeper);
-		if (miniexp_stringp (str))
-			djvu_text_page_limits_process (page, p, rect);
-		else
-			djvu_text_page_limits (page, str, rect);
-
-		deeper = miniexp_cdr (deeper);
-	}
+	return found;
 }
 
 /**
@@ -212,297 +128,234 @@ djvu_text_page_limits (DjvuTextPage *page,
  * @page: #DjvuTextPage instance
  * @rectangle: #EvRectangle of the selection
  *
- * Returns: The bounding boxes of the selection
+ * Returns: The bounding boxes of the selection, one per line
  */
 GList *
 djvu_text_page_get_selection_region (DjvuTextPage *page,
                                      EvRectangle  *rectangle)
 {
-	page->start = miniexp_nil;
-	page->end = miniexp_nil;
+	GList *results = NULL;
+	guint start, end, i;
 
-	/* Get page->start and page->end filled from selection rectangle */
-	djvu_text_page_limits (page, page->text_structure, rectangle);
-	/* Fills page->results with the bouding boxes */
-	djvu_text_page_selection (DJVU_SELECTION_BOX,
-	                          page, page->text_structure, 0);
+	if (!djvu_text_page_limits (page, rectangle, &start, &end))
+		return NULL;
 
-	return g_list_reverse (page->results);
+	for (i = start; i <= end; i++) {
+		DjvuTextToken *token = &g_array_index (page->tokens, DjvuTextToken, i);
+
+		if (!(token->delimit & 2) && results != NULL) {
+			/* If still on the same line, add box to union */
+			djvu_text_page_union ((EvRectangle *)results->data, token);
+		} else {
+			/* A new line, a new box */
+			results = g_list_prepend (results, djvu_text_page_token_box (token));
+		}
+	}
+
+	return g_list_reverse (results);
 }
 
 char *
 djvu_text_page_copy (DjvuTextPage *page, 
 		     EvRectangle  *rectangle)
 {
-	char* text;
-	
-	page->start = miniexp_nil;
-	page->end = miniexp_nil;
-	djvu_text_page_limits (page, page->text_structure, rectangle);
-	djvu_text_page_selection (DJVU_SELECTION_TEXT, page,
-	                          page->text_structure, 0);
-	
-	/* Do not free the string */	  
-	text = page->text;
-	page->text = NULL;
-	
-	return text;
+	GString *text;
+	guint start, end, i;
+
+	if (!djvu_text_page_limits (page, rectangle, &start, &end))
+		return NULL;
+
+	text = g_string_new (NULL);
+	for (i = start; i <= end; i++) {
+		DjvuTextToken *token = &g_array_index (page->tokens, DjvuTextToken, i);
+		const char *token_text;
+		gsize length;
+
+		if (i > start) {
+			if (token->delimit & 2)
+				g_string_append_c (text, '\n');
+			else if (token->delimit & 1)
+				g_string_append_c (text, ' ');
+		}
+
+		token_text = djvu_text_page_token_text (page, i, &length);
+		g_string_append_len (text, token_text, length);
+	}
+
+	return g_string_free (text, FALSE);
 }
 
 /**
  * djvu_text_page_position:
  * @page: #DjvuTextPage instance
  * @position: index in the page text
+ * @case_sensitive: whether @position is in the text or the folded text
  * 
- * Returns the closest s-expression that contains the given position in 
- * the page text.
- * 
- * Returns: closest s-expression
+ * Returns: the index of the token containing the given position in
+ *   the page text
  */
-static miniexp_t
+static guint
 djvu_text_page_position (DjvuTextPage *page, 
-			 int           position)
+			 guint         position,
+			 gboolean      case_sensitive)
 {
-	GArray *links = page->links;
-	int low = 0;
-	int hi = links->len - 1;
-	int mid = 0;
-
-	g_return_val_if_fail (hi >= 0, miniexp_nil);
-
-	/* Shamelessly copied from GNU classpath */
-	while (low <= hi) {
-                DjvuTextLink *link;
-
-		mid = (low + hi) >> 1;
-		link = &g_array_index (links, DjvuTextLink, mid);
-		if (link->position == position)
-			break;
-		else if (link->position > position)
-			hi = --mid;
+	guint low = 0;
+	guint hi = page->tokens->len;
+
+	/* Last token starting at or before position */
+	while (hi - low > 1) {
+		guint mid = (low + hi) / 2;
+		DjvuTextToken *token = &g_array_index (page->tokens, DjvuTextToken, mid);
+		guint offset = case_sensitive ? token->offset : token->folded_offset;
+
+		if (offset <= position)
+			low = mid;
 		else
-			low = mid + 1;
+			hi = mid;
 	}
 
-	return g_array_index (page->links, DjvuTextLink, mid).pair;
+	return low;
 }
 
 /**
- * djvu_text_page_sexpr_process:
+ * djvu_text_page_search:
  * @page: #DjvuTextPage instance
- * @p: s-expression to append
- * @start: first s-expression in the selection
- * @end: last s-expression in the selection
- * 
- * Appends the rectangle defined by @p to the internal bounding box rectangle.
+ * @text: text to search
+ * @case_sensitive: do not ignore case
  * 
- * Returns: whether the end was not reached in this s-expression
+ * Searches the page for the given text.
+ *
+ * Returns: the bounding boxes of the matches, to be freed by the caller
  */
-static gboolean
-djvu_text_page_sexpr_process (DjvuTextPage *page, 
-                              miniexp_t     p,
-                              miniexp_t     start, 
-                              miniexp_t     end)
+GList *
+djvu_text_page_search (DjvuTextPage *page, 
+		       const char   *text,
+		       gboolean      case_sensitive)
 {
-	if (page->bounding_box || p == start) {
-		EvRectangle *new_rectangle = ev_rectangle_new ();
-		new_rectangle->x1 = miniexp_to_int (miniexp_nth (1, p));
-		new_rectangle->y1 = miniexp_to_int (miniexp_nth (2, p));
-		new_rectangle->x2 = miniexp_to_int (miniexp_nth (3, p));
-		new_rectangle->y2 = miniexp_to_int (miniexp_nth (4, p));
-		if (page->bounding_box) {
-			djvu_text_page_union (page->bounding_box,
-					      new_rectangle);
-			g_free (new_rectangle);
-		} else
-			page->bounding_box = new_rectangle;
-		if (p == end)
-			return FALSE;
-	}
-	return TRUE;
-}
+	const char *page_text = case_sensitive ? page->text : page->folded_text;
+	const char *haystack = page_text;
+	GList *results = NULL;
+	gsize search_len;
 
-/**
- * djvu_text_page_sexpr:
- * @page: #DjvuTextPage instance
- * @p: tree to append
- * @start: first s-expression in the selection
- * @end: last s-expression in the selection
- * 
- * Walks the tree in @p and extends the rectangle with 
- * djvu_text_page_process() for all s-expressions between @start and @end.
- * 
- * Returns: whether the end was not reached in this subtree
- */
-static gboolean
-djvu_text_page_sexpr (DjvuTextPage *page, 
-		      miniexp_t p,
-		      miniexp_t start, 
-		      miniexp_t end)
-{
-        miniexp_t deeper;
+	if (page->tokens->len == 0)
+		return NULL;
 
-	g_return_val_if_fail (miniexp_consp (p) && miniexp_symbolp
-			      (miniexp_car (p)), FALSE);
+	search_len = strlen (text);
+	if (search_len == 0)
+		return NULL;
 
-	deeper = miniexp_cddr (miniexp_cdddr (p));
-	while (deeper != miniexp_nil) {
-		miniexp_t str = miniexp_car (deeper);
-		if (miniexp_stringp (str)) {
-			if (!djvu_text_page_sexpr_process
-			    (page, p, start, end))
-				return FALSE;
-		} else {
-			if (!djvu_text_page_sexpr
-			    (page, str, start, end))
-				return FALSE;
-		}
-		deeper = miniexp_cdr (deeper);
+	while ((haystack = strstr (haystack, text)) != NULL) {
+		guint start_p = haystack - page_text;
+		guint start = djvu_text_page_position (page, start_p, case_sensitive);
+		guint end = djvu_text_page_position (page, start_p + search_len - 1, case_sensitive);
+		EvRectangle *result;
+		guint i;
+
+		result = djvu_text_page_token_box (&g_array_index (page->tokens, DjvuTextToken, start));
+		for (i = start + 1; i <= end; i++)
+			djvu_text_page_union (result, &g_array_index (page->tokens, DjvuTextToken, i));
+
+		results = g_list_prepend (results, result);
+		haystack = haystack + search_len;
 	}
-	return TRUE;
-}
 
-/**
- * djvu_text_page_box:
- * @page: #DjvuTextPage instance
- * @start: first s-expression in the selection
- * @end: last s-expression in the selection
- * 
- * Builds a rectangle that contains all s-expressions in the given range.
- */
-static EvRectangle *
-djvu_text_page_box (DjvuTextPage *page,
-		    miniexp_t     start, 
-		    miniexp_t     end)
-{
-	page->bounding_box = NULL;
-	djvu_text_page_sexpr (page, page->text_structure, start, end);
-	return page->bounding_box;
+	return g_list_reverse (results);
 }
 
+typedef struct {
+	DjvuTextPage *page;
+	GString *text;
+	GString *folded_text;
+	miniexp_t char_symbol;
+	miniexp_t word_symbol;
+} DjvuTextPageBuilder;
+
 /**
- * djvu_text_page_append_search:
- * @page: #DjvuTextPage instance
+ * djvu_text_page_append:
+ * @builder: the page being built
  * @p: tree to append
- * @case_sensitive: do not ignore case
- * @delimit: insert spaces because of higher (sentence/paragraph/...) break
- * 
- * Appends the tree in @p to the internal text string. 
+ * @delimit: character/word/... delimiter
+ *
+ * Walks the tree in @p and appends its leaves to the page text and to
+ * the tokens.
  */
 static void
-djvu_text_page_append_text (DjvuTextPage *page,
-			    miniexp_t     p, 
-			    gboolean      case_sensitive, 
-			    gboolean      delimit)
+djvu_text_page_append (DjvuTextPageBuilder *builder,
+		       miniexp_t            p,
+		       int                  delimit)
 {
-	char *token_text;
 	miniexp_t deeper;
-	
-	g_return_if_fail (miniexp_consp (p) && 
+
+	g_return_if_fail (miniexp_consp (p) &&
 			  miniexp_symbolp (miniexp_car (p)));
 
-	delimit |= page->char_symbol != miniexp_car (p);
-	
+	if (miniexp_car (p) != builder->char_symbol)
+		delimit |= miniexp_car (p) == builder->word_symbol ? 1 : 2;
+
 	deeper = miniexp_cddr (miniexp_cdddr (p));
 	while (deeper != miniexp_nil) {
 		miniexp_t data = miniexp_car (deeper);
+
 		if (miniexp_stringp (data)) {
-			DjvuTextLink link;
-			link.position = page->text == NULL ? 0 :
-			    strlen (page->text);
-			link.pair = p;
-			g_array_append_val (page->links, link);
-
-			token_text = (char *) miniexp_to_str (data);
-			if (!case_sensitive)
-				token_text = g_utf8_casefold (token_text, -1);
-			if (page->text == NULL)
-				page->text = g_strdup (token_text);
-			else {
-				char *new_text =
-				    g_strjoin (delimit ? " " : NULL,
-					       page->text, token_text,
-					       NULL);
-				g_free (page->text);
-				page->text = new_text;
+			const char *token_text = miniexp_to_str (data);
+			char *folded;
+			DjvuTextToken token;
+
+			token.x1 = miniexp_to_int (miniexp_nth (1, p));
+			token.y1 = miniexp_to_int (miniexp_nth (2, p));
+			token.x2 = miniexp_to_int (miniexp_nth (3, p));
+			token.y2 = miniexp_to_int (miniexp_nth (4, p));
+			token.offset = builder->text->len;
+			token.folded_offset = builder->folded_text->len;
+			token.delimit = delimit;
+
+			if (delimit && builder->text->len > 0) {
+				g_string_append_c (builder->text, ' ');
+				g_string_append_c (builder->folded_text, ' ');
+				token.delimit |= DJVU_TEXT_TOKEN_SEPARATED;
 			}
-			if (!case_sensitive)
-				g_free (token_text);
-		} else
-			djvu_text_page_append_text (page, data, 
-						    case_sensitive, delimit);
-		delimit = FALSE;
-		deeper = miniexp_cdr (deeper);
-	}
-}
-
-/**
- * djvu_text_page_search:
- * @page: #DjvuTextPage instance
- * @text: text to search
- * 
- * Searches the page for the given text. The results list has to be 
- * externally freed afterwards.
- */
-void 
-djvu_text_page_search (DjvuTextPage *page, 
-		       const char   *text)
-{
-	char *haystack = page->text;
-	int search_len;
-	EvRectangle *result;
-	if (page->links->len == 0)
-		return;
+			g_array_append_val (builder->page->tokens, token);
 
-	search_len = strlen (text);
-	while ((haystack = strstr (haystack, text)) != NULL) {
-		int start_p = haystack - page->text;
-		miniexp_t start = djvu_text_page_position (page, start_p);
-		int end_p = start_p + search_len - 1;
-		miniexp_t end = djvu_text_page_position (page, end_p);
-		result = djvu_text_page_box (page, start, end);
-		g_assert (result);
-		page->results = g_list_prepend (page->results, result);
-		haystack = haystack + search_len;
+			folded = g_utf8_casefold (token_text, -1);
+			g_string_append (builder->text, token_text);
+			g_string_append (builder->folded_text, folded);
+			g_free (folded);
+		} else {
+			djvu_text_page_append (builder, data, delimit);
+		}
+		delimit = 0;
+		deeper = miniexp_cdr (deeper);
 	}
-	page->results = g_list_reverse (page->results);
-}
-
-
-/**
- * djvu_text_page_index_text:
- * @page: #DjvuTextPage instance
- * @case_sensitive: do not ignore case
- * 
- * Indexes the page text and prepares the page for subsequent searches.
- */
-void
-djvu_text_page_index_text (DjvuTextPage *page,
-	       		       gboolean      case_sensitive)
-{
-	djvu_text_page_append_text (page, page->text_structure, 
-				    case_sensitive, FALSE);	
 }
 
 /**
  * djvu_text_page_new:
- * @text: S-expression of the page text
+ * @text: S-expression of the page text, or miniexp_nil
  * 
- * Creates a new page to search. 
+ * Creates a new page to search and select from. @text is not used
+ * afterwards and can be released.
  * 
  * Returns: new #DjvuTextPage instance
  */
 DjvuTextPage *
 djvu_text_page_new (miniexp_t text)
 {
-	DjvuTextPage *page;
+	DjvuTextPageBuilder builder;
+
+	builder.page = g_new0 (DjvuTextPage, 1);
+	builder.page->tokens = g_array_new (FALSE, FALSE, sizeof (DjvuTextToken));
+	builder.text = g_string_new (NULL);
+	builder.folded_text = g_string_new (NULL);
+	builder.char_symbol = miniexp_symbol ("char");
+	builder.word_symbol = miniexp_symbol ("word");
+
+	if (miniexp_consp (text))
+		djvu_text_page_append (&builder, text, 0);
+
+	builder.page->text = g_string_free (builder.text, FALSE);
+	builder.page->folded_text = g_string_free (builder.folded_text, FALSE);
 
-	page = g_new0 (DjvuTextPage, 1);
-	page->links = g_array_new (FALSE, FALSE, sizeof (DjvuTextLink));
-	page->char_symbol = miniexp_symbol ("char");
-	page->word_symbol = miniexp_symbol ("word");
-	page->text_structure = text;
-	return page;
+	return builder.page;
 }
 
 /**
@@ -515,6 +368,7 @@ void
 djvu_text_page_free (DjvuTextPage *page)
 {
 	g_free (page->text);
-	g_array_free (page->links, TRUE);
+	g_free (page->folded_text);
+	g_array_free (page->tokens, TRUE);
 	g_free (page);
 }
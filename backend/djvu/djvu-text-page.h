@@ -27,38 +27,33 @@
 
 
 typedef struct _DjvuTextPage DjvuTextPage;
-typedef struct _DjvuTextLink DjvuTextLink;
+typedef struct _DjvuTextToken DjvuTextToken;
 
+/* The hidden text of a page, flattened once into the strings of its
+ * leaves and their bounding boxes, in DjVu coordinates. */
 struct _DjvuTextPage {
+	/* Leaves separated by spaces, and the same casefolded */
 	char *text;
-	GArray *links;
-	GList *results;
-	miniexp_t char_symbol;
-	miniexp_t word_symbol;
-	EvRectangle *bounding_box;
-	miniexp_t text_structure;
-	miniexp_t start;
-	miniexp_t end;
+	char *folded_text;
+	GArray *tokens;
 };
 
-struct _DjvuTextLink {
-	int position;
-	miniexp_t pair;
+struct _DjvuTextToken {
+	int x1, y1, x2, y2;
+	/* Start in text and folded_text, including the separator */
+	guint offset;
+	guint folded_offset;
+	/* 1 for a new word, 2 for a new line or a higher level break */
+	guint8 delimit;
 };
 
-typedef enum {
-	DJVU_SELECTION_TEXT,
-	DJVU_SELECTION_BOX,
-} DjvuSelectionType;
-
 GList        *djvu_text_page_get_selection_region (DjvuTextPage *page,
                                                    EvRectangle  *rectangle);
 char         *djvu_text_page_copy                 (DjvuTextPage *page,
                                                    EvRectangle  *rectangle);
-void          djvu_text_page_index_text           (DjvuTextPage *page,
+GList        *djvu_text_page_search               (DjvuTextPage *page,
+                                                   const char   *text,
                                                    gboolean      case_sensitive);
-void          djvu_text_page_search               (DjvuTextPage *page,
-                                                   const char   *text);
 DjvuTextPage *djvu_text_page_new                  (miniexp_t     text);
 void          djvu_text_page_free                 (DjvuTextPage *page);
 
@@ -20,11 +20,14 @@
 
 #include <stdlib.h>
 #include <gdk/gdk.h>
+#include <glib/gstdio.h>
 #ifdef HAVE_SPECTRE
 #include <libspectre/spectre.h>
 #endif
 
 #include "cairo-device.h"
+#include "ev-memory-stats.h"
+#include "ev-surface-pool.h"
 
 typedef struct {
 	cairo_t *cr;
@@ -126,30 +129,150 @@ dvi_cairo_draw_rule (DviContext *dvi,
 }
 
 #ifdef HAVE_SPECTRE
+/* Rasterized EPS figures, shared by the contexts of all documents like
+ * the fonts. A figure is only rasterized again by ghostscript when it
+ * has changed or when it would be drawn scaled up, or scaled down
+ * more than DVI_FIGURE_MAX_DOWNSCALE. Figures rasterized again while
+ * zooming in get some headroom, so that the next zoom steps reuse it.
+ */
+#define DVI_FIGURES_MAX_SIZE      (32 * 1024 * 1024)
+#define DVI_FIGURE_MAX_DOWNSCALE  2.0
+#define DVI_FIGURE_ZOOM_HEADROOM  1.5
+
+typedef struct {
+	gchar           *filename;
+	gint64           mtime;
+	cairo_surface_t *image;
+} DviFigure;
+
+static GMutex      dvi_figures_mutex;
+static GHashTable *dvi_figures;
+static GQueue      dvi_figures_lru = G_QUEUE_INIT;
+static gsize       dvi_figures_size;
+
+static const cairo_user_data_key_t dvi_figure_data_key;
+
+static gsize
+dvi_figure_get_size (DviFigure *figure)
+{
+	return cairo_image_surface_get_stride (figure->image) *
+		cairo_image_surface_get_height (figure->image);
+}
+
 static void
-dvi_cairo_draw_ps (DviContext *dvi,
-		   const char *filename,
-		   int         x,
-		   int         y,
-		   Uint        width,
-		   Uint        height)
+dvi_figure_free (DviFigure *figure)
+{
+	cairo_surface_destroy (figure->image);
+	g_free (figure->filename);
+	g_slice_free (DviFigure, figure);
+}
+
+static void
+dvi_figures_remove_link (GList *link)
+{
+	DviFigure *figure = (DviFigure *) link->data;
+
+	g_hash_table_remove (dvi_figures, figure->filename);
+	g_queue_delete_link (&dvi_figures_lru, link);
+	dvi_figures_size -= dvi_figure_get_size (figure);
+	dvi_figure_free (figure);
+}
+
+static void
+dvi_figures_get_memory_stats (gpointer  user_data,
+			      guint64  *bytes,
+			      guint    *n_entries)
+{
+	g_mutex_lock (&dvi_figures_mutex);
+	*bytes += dvi_figures_size;
+	*n_entries += dvi_figures_lru.length;
+	g_mutex_unlock (&dvi_figures_mutex);
+}
+
+/* Returns the cached figure of @filename, moved to the head of the
+ * LRU, or NULL. Figures of an older version of the file are dropped.
+ * Must be called with dvi_figures_mutex held. */
+static DviFigure *
+dvi_figures_lookup (const gchar *filename,
+		    gint64       mtime)
+{
+	GList     *link;
+	DviFigure *figure;
+
+	if (!dvi_figures) {
+		dvi_figures = g_hash_table_new (g_str_hash, g_str_equal);
+		ev_memory_stats_register ("dvi-figures",
+					  dvi_figures_get_memory_stats,
+					  NULL);
+	}
+
+	link = (GList *) g_hash_table_lookup (dvi_figures, filename);
+	if (!link)
+		return NULL;
+
+	figure = (DviFigure *) link->data;
+	if (figure->mtime != mtime) {
+		dvi_figures_remove_link (link);
+		return NULL;
+	}
+
+	g_queue_unlink (&dvi_figures_lru, link);
+	g_queue_push_head_link (&dvi_figures_lru, link);
+
+	return figure;
+}
+
+/* Takes ownership of @figure. Must be called with dvi_figures_mutex held. */
+static void
+dvi_figures_insert (DviFigure *figure)
+{
+	GList *link;
+
+	link = (GList *) g_hash_table_lookup (dvi_figures, figure->filename);
+	if (link)
+		dvi_figures_remove_link (link);
+
+	g_queue_push_head (&dvi_figures_lru, figure);
+	g_hash_table_insert (dvi_figures, figure->filename, dvi_figures_lru.head);
+	dvi_figures_size += dvi_figure_get_size (figure);
+
+	/* Keep the figure just inserted, even if it's too big */
+	while (dvi_figures_size > DVI_FIGURES_MAX_SIZE &&
+	       dvi_figures_lru.tail != dvi_figures_lru.head)
+		dvi_figures_remove_link (dvi_figures_lru.tail);
+}
+
+static gboolean
+dvi_figure_fits (DviFigure *figure,
+		 Uint       width,
+		 Uint       height)
+{
+	gint w = cairo_image_surface_get_width (figure->image);
+	gint h = cairo_image_surface_get_height (figure->image);
+
+	return w >= (gint)width && h >= (gint)height &&
+		w <= width * DVI_FIGURE_MAX_DOWNSCALE &&
+		h <= height * DVI_FIGURE_MAX_DOWNSCALE;
+}
+
+static cairo_surface_t *
+dvi_figure_rasterize (const gchar *filename,
+		      gint         width,
+		      gint         height)
 {
-	DviCairoDevice       *cairo_device;
 	unsigned char        *data = NULL;
 	int                   row_length;
 	SpectreDocument      *psdoc;
 	SpectreRenderContext *rc;
-	int                   w, h;
 	SpectreStatus         status;
 	cairo_surface_t      *image;
-
-	cairo_device = (DviCairoDevice *) dvi->device.device_data;
+	int                   w, h;
 
 	psdoc = spectre_document_new ();
 	spectre_document_load (psdoc, filename);
 	if (spectre_document_status (psdoc)) {
 		spectre_document_free (psdoc);
-		return;
+		return NULL;
 	}
 
 	spectre_document_get_page_size (psdoc, &w, &h);
@@ -158,7 +281,7 @@ dvi_cairo_draw_ps (DviContext *dvi,
 	spectre_render_context_set_scale (rc,
 					  (double)width / w,
 					  (double)height / h);
-	spectre_document_render_full (psdoc, rc, &data, &row_length);	
+	spectre_document_render_full (psdoc, rc, &data, &row_length);
 	status = spectre_document_status (psdoc);
 
 	spectre_render_context_free (rc);
@@ -168,27 +291,85 @@ dvi_cairo_draw_ps (DviContext *dvi,
 		g_warning ("Error rendering PS document %s: %s\n",
 			   filename, spectre_status_to_string (status));
 		free (data);
-		
-		return;
+
+		return NULL;
 	}
 
 	image = cairo_image_surface_create_for_data ((unsigned char *)data,
 						     CAIRO_FORMAT_RGB24,
 						     width, height,
 						     row_length);
+	cairo_surface_set_user_data (image, &dvi_figure_data_key, data, free);
+
+	return image;
+}
+
+static void
+dvi_cairo_draw_ps (DviContext *dvi,
+		   const char *filename,
+		   int         x,
+		   int         y,
+		   Uint        width,
+		   Uint        height)
+{
+	DviCairoDevice  *cairo_device;
+	DviFigure       *figure;
+	GStatBuf         st;
+	gint64           mtime;
+	gint             w, h;
+	cairo_surface_t *image = NULL;
+
+	cairo_device = (DviCairoDevice *) dvi->device.device_data;
+
+	if (width == 0 || height == 0 || g_stat (filename, &st) != 0)
+		return;
+	mtime = st.st_mtime;
+
+	w = width;
+	h = height;
+
+	g_mutex_lock (&dvi_figures_mutex);
+	figure = dvi_figures_lookup (filename, mtime);
+	if (figure) {
+		if (dvi_figure_fits (figure, width, height)) {
+			image = cairo_surface_reference (figure->image);
+		} else if (cairo_image_surface_get_width (figure->image) < (gint)width) {
+			w = width * DVI_FIGURE_ZOOM_HEADROOM;
+			h = height * DVI_FIGURE_ZOOM_HEADROOM;
+		}
+	}
+	g_mutex_unlock (&dvi_figures_mutex);
+
+	/* Ghostscript runs without the cache locked */
+	if (!image) {
+		image = dvi_figure_rasterize (filename, w, h);
+		if (!image)
+			return;
+
+		figure = g_slice_new (DviFigure);
+		figure->filename = g_strdup (filename);
+		figure->mtime = mtime;
+		figure->image = cairo_surface_reference (image);
+
+		g_mutex_lock (&dvi_figures_mutex);
+		dvi_figures_insert (figure);
+		g_mutex_unlock (&dvi_figures_mutex);
+	}
 
 	cairo_save (cairo_device->cr);
 
 	cairo_translate (cairo_device->cr,
 			 x + cairo_device->xmargin,
 			 y + cairo_device->ymargin);
-	cairo_set_source_surface (cairo_device->cr, image, 0, 0); 
+	cairo_scale (cairo_device->cr,
+		     (double)width / cairo_image_surface_get_width (image),
+		     (double)height / cairo_image_surface_get_height (image));
+	cairo_set_source_surface (cairo_device->cr, image, 0, 0);
 	cairo_paint (cairo_device->cr);
 
 	cairo_restore (cairo_device->cr);
 
 	cairo_surface_destroy (image);
-	free (data);
 }
 #endif /* HAVE_SPECTRE */
 
@@ -259,6 +440,24 @@ dvi_cairo_put_pixel (void *image, int x, int y, Ulong color)
 	*p = color;
 }
 
+static void
+dvi_cairo_put_row (void *image, int y, const Ulong *colors, int n)
+{
+	cairo_surface_t *surface;
+	guint32         *p;
+	int              x;
+
+	surface = (cairo_surface_t *) image;
+
+	cairo_surface_flush (surface);
+	p = (guint32*) (cairo_image_surface_get_data (surface) +
+			y * cairo_image_surface_get_stride (surface));
+
+	/* plain loop the compiler can vectorize */
+	for (x = 0; x < n; x++)
+		p[x] = (guint32) colors[x];
+}
+
 static void
 dvi_cairo_image_done (void *ptr)
 {
@@ -286,6 +485,7 @@ mdvi_cairo_device_init (DviDevice *device)
 	device->create_image = dvi_cairo_create_image;
 	device->free_image = dvi_cairo_free_image;
 	device->put_pixel = dvi_cairo_put_pixel;
+	device->put_row = dvi_cairo_put_row;
         device->image_done = dvi_cairo_image_done;
 	device->set_color = dvi_cairo_set_color;
 #ifdef HAVE_SPECTRE
@@ -335,8 +535,8 @@ mdvi_cairo_device_render (DviContext* dvi)
 	page_width = dvi->dvi_page_w * dvi->params.conv + 2 * cairo_device->xmargin;
 	page_height = dvi->dvi_page_h * dvi->params.vconv + 2 * cairo_device->ymargin;
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                              page_width, page_height);
+	surface = ev_surface_pool_create_surface (CAIRO_FORMAT_ARGB32,
+						  page_width, page_height);
 
 	cairo_device->cr = cairo_create (surface);
         cairo_surface_destroy (surface);
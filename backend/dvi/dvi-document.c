@@ -41,6 +41,8 @@
 #include <stdlib.h>
 
 static GMutex dvi_context_mutex;
+/* Fonts are shared by the contexts of all documents, see mdvi_set_font_lock() */
+static GRecMutex dvi_font_mutex;
 
 enum {
 	PROP_0,
@@ -66,6 +68,13 @@ struct _DviDocument
 	
 	gchar *uri;
 
+	/* Render contexts, see dvi_document_setup_contexts() */
+	gchar *contexts_filename;
+	GAsyncQueue *contexts;
+	guint n_contexts;
+	guint max_contexts;
+	GMutex contexts_mutex;
+
 	/* PDF exporter */
 	gchar		 *exporter_filename;
 	GString 	 *exporter_opts;
@@ -83,6 +92,117 @@ EV_BACKEND_REGISTER_WITH_CODE (DviDocument, dvi_document,
       EV_BACKEND_IMPLEMENT_INTERFACE (EV_TYPE_FILE_EXPORTER, dvi_document_file_exporter_iface_init);
      });
 
+static void
+dvi_font_lock (void)
+{
+	g_rec_mutex_lock (&dvi_font_mutex);
+}
+
+static void
+dvi_font_unlock (void)
+{
+	g_rec_mutex_unlock (&dvi_font_mutex);
+}
+
+static DviContext *
+dvi_document_new_context (DviDocument *dvi_document,
+			  const gchar *filename)
+{
+	DviContext *context;
+
+	g_rec_mutex_lock (&dvi_font_mutex);
+	context = mdvi_init_context (dvi_document->params, dvi_document->spec, filename);
+	/* Keep the font lookups done while loading for the next time */
+	mdvi_save_lookup_cache ();
+	g_rec_mutex_unlock (&dvi_font_mutex);
+
+	if (context)
+		mdvi_cairo_device_init (&context->device);
+
+	return context;
+}
+
+static void
+dvi_document_free_context (DviContext *context)
+{
+	g_rec_mutex_lock (&dvi_font_mutex);
+	mdvi_cairo_device_free (&context->device);
+	mdvi_destroy_context (context);
+	g_rec_mutex_unlock (&dvi_font_mutex);
+}
+
+/* Render contexts are extra DviContexts opened from the same file, so
+ * that different pages can be rendered at the same time. They share
+ * the fonts, whose glyphs are loaded and drawn with dvi_font_mutex
+ * held. This is opt-in, by setting EV_DVI_RENDER_CONTEXTS to the
+ * maximum number of contexts.
+ */
+static void
+dvi_document_setup_contexts (DviDocument *dvi_document,
+			     const gchar *filename)
+{
+	DviContext  *context;
+	const gchar *env;
+	gint         n;
+
+	g_clear_pointer (&dvi_document->contexts, g_async_queue_unref);
+	g_clear_pointer (&dvi_document->contexts_filename, g_free);
+
+	env = g_getenv ("EV_DVI_RENDER_CONTEXTS");
+	if (!env)
+		return;
+
+	n = MIN (atoi (env), (gint) g_get_num_processors ());
+	if (n <= 0)
+		return;
+
+	/* Open the first context right away, so that there is
+	 * always one to wait for once rendering is done unlocked */
+	context = dvi_document_new_context (dvi_document, filename);
+	if (!context)
+		return;
+
+	dvi_document->contexts_filename = g_strdup (filename);
+	dvi_document->contexts = g_async_queue_new_full ((GDestroyNotify)dvi_document_free_context);
+	g_async_queue_push (dvi_document->contexts, context);
+	dvi_document->n_contexts = 1;
+	dvi_document->max_contexts = n;
+}
+
+static DviContext *
+dvi_document_acquire_context (DviDocument *dvi_document)
+{
+	DviContext *context;
+
+	context = g_async_queue_try_pop (dvi_document->contexts);
+	if (context)
+		return context;
+
+	g_mutex_lock (&dvi_document->contexts_mutex);
+	if (dvi_document->n_contexts < dvi_document->max_contexts) {
+		context = dvi_document_new_context (dvi_document,
+						    dvi_document->contexts_filename);
+		if (context)
+			dvi_document->n_contexts++;
+		else /* Don't try again, make do with the existing ones */
+			dvi_document->max_contexts = dvi_document->n_contexts;
+	}
+	g_mutex_unlock (&dvi_document->contexts_mutex);
+
+	if (context)
+		return context;
+
+	/* All contexts are busy, wait for one to be released */
+	return g_async_queue_pop (dvi_document->contexts);
+}
+
+static void
+dvi_document_release_context (DviDocument *dvi_document,
+			      DviContext  *context)
+{
+	g_async_queue_push (dvi_document->contexts, context);
+}
+
 static gboolean
 dvi_document_load (EvDocument  *document,
 		   const char  *uri,
@@ -97,21 +217,22 @@ dvi_document_load (EvDocument  *document,
 	
 	g_mutex_lock (&dvi_context_mutex);
 	if (dvi_document->context)
-		mdvi_destroy_context (dvi_document->context);
+		dvi_document_free_context (dvi_document->context);
 
-	dvi_document->context = mdvi_init_context(dvi_document->params, dvi_document->spec, filename);
+	dvi_document->context = dvi_document_new_context (dvi_document, filename);
 	g_mutex_unlock (&dvi_context_mutex);
-	g_free (filename);
 	
 	if (!dvi_document->context) {
+		g_free (filename);
     		g_set_error_literal (error,
                                      EV_DOCUMENT_ERROR,
                                      EV_DOCUMENT_ERROR_INVALID,
                                      _("DVI document has incorrect format"));
         	return FALSE;
 	}
-	
-	mdvi_cairo_device_init (&dvi_document->context->device);
+
+	dvi_document_setup_contexts (dvi_document, filename);
+	g_free (filename);
 	
 	
 	dvi_document->base_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv 
@@ -134,7 +255,7 @@ dvi_document_save (EvDocument  *document,
 {
 	DviDocument *dvi_document = DVI_DOCUMENT (document);
 
-	return ev_xfer_uri_simple (dvi_document->uri, uri, error);
+	return ev_file_clone_uri (dvi_document->uri, uri, error);
 }
 
 static int
@@ -164,41 +285,50 @@ dvi_document_render (EvDocument      *document,
 	cairo_surface_t *surface;
 	cairo_surface_t *rotated_surface;
 	DviDocument *dvi_document = DVI_DOCUMENT(document);
+	DviContext *context;
 	gdouble xscale, yscale;
 	gint required_width, required_height;
 	gint proposed_width, proposed_height;
 	gint xmargin = 0, ymargin = 0;
 
-	/* We should protect our context since it's not 
-	 * thread safe. The work to the future - 
-	 * let context render page independently
+	/* The context is not thread safe, render contexts are used
+	 * one at a time, and the document context with the global
+	 * mutex held
 	 */
-	g_mutex_lock (&dvi_context_mutex);
+	if (dvi_document->contexts) {
+		context = dvi_document_acquire_context (dvi_document);
+	} else {
+		g_mutex_lock (&dvi_context_mutex);
+		context = dvi_document->context;
+	}
 	
-	mdvi_setpage (dvi_document->context, rc->page->index);
+	mdvi_setpage (context, rc->page->index);
 	
 	ev_render_context_compute_scales (rc, dvi_document->base_width, dvi_document->base_height,
 					  &xscale, &yscale);
-	mdvi_set_shrink (dvi_document->context, 
+	mdvi_set_shrink (context, 
 			 (int)((dvi_document->params->hshrink - 1) / xscale) + 1,
 			 (int)((dvi_document->params->vshrink - 1) / yscale) + 1);
 
 	ev_render_context_compute_scaled_size (rc, dvi_document->base_width, dvi_document->base_height,
 					       &required_width, &required_height);
-	proposed_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv;
-	proposed_height = dvi_document->context->dvi_page_h * dvi_document->context->params.vconv;
+	proposed_width = context->dvi_page_w * context->params.conv;
+	proposed_height = context->dvi_page_h * context->params.vconv;
 	
 	if (required_width >= proposed_width)
 	    xmargin = (required_width - proposed_width) / 2;
 	if (required_height >= proposed_height)
 	    ymargin = (required_height - proposed_height) / 2;
 	    
-	mdvi_cairo_device_set_margins (&dvi_document->context->device, xmargin, ymargin);
-	mdvi_cairo_device_set_scale (&dvi_document->context->device, xscale, yscale);
-	mdvi_cairo_device_render (dvi_document->context);
-	surface = mdvi_cairo_device_get_surface (&dvi_document->context->device);
+	mdvi_cairo_device_set_margins (&context->device, xmargin, ymargin);
+	mdvi_cairo_device_set_scale (&context->device, xscale, yscale);
+	mdvi_cairo_device_render (context);
+	surface = mdvi_cairo_device_get_surface (&context->device);
 
-	g_mutex_unlock (&dvi_context_mutex);
+	if (dvi_document->contexts)
+		dvi_document_release_context (dvi_document, context);
+	else
+		g_mutex_unlock (&dvi_context_mutex);
 
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     required_width,
@@ -214,11 +344,13 @@ dvi_document_finalize (GObject *object)
 {	
 	DviDocument *dvi_document = DVI_DOCUMENT(object);
 	
+	g_clear_pointer (&dvi_document->contexts, g_async_queue_unref);
+	g_free (dvi_document->contexts_filename);
+	g_mutex_clear (&dvi_document->contexts_mutex);
+
 	g_mutex_lock (&dvi_context_mutex);
-	if (dvi_document->context) {
-		mdvi_cairo_device_free (&dvi_document->context->device);
-		mdvi_destroy_context (dvi_document->context);
-	}
+	if (dvi_document->context)
+		dvi_document_free_context (dvi_document->context);
 	g_mutex_unlock (&dvi_context_mutex);
 
 	if (dvi_document->params)
@@ -241,12 +373,20 @@ dvi_document_support_synctex (EvDocument *document)
 	return TRUE;
 }
 
+static gboolean
+dvi_document_is_thread_safe (EvDocument *document)
+{
+	return DVI_DOCUMENT (document)->contexts != NULL;
+}
+
 static void
 dvi_document_class_init (DviDocumentClass *klass)
 {
 	GObjectClass    *gobject_class = G_OBJECT_CLASS (klass);
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 	gchar *texmfcnf;
+	gchar *cache_dir;
+	gchar *cache_file;
 
 	gobject_class->finalize = dvi_document_finalize;
 
@@ -254,8 +394,17 @@ dvi_document_class_init (DviDocumentClass *klass)
 	mdvi_init_kpathsea ("evince", MDVI_MFMODE, MDVI_FALLBACK_FONT, MDVI_DPI, texmfcnf);
 	g_free(texmfcnf);
 
+	cache_dir = g_build_filename (g_get_user_cache_dir (), "evince", NULL);
+	if (g_mkdir_with_parents (cache_dir, 0700) == 0) {
+		cache_file = g_build_filename (cache_dir, "dvi-lookups", NULL);
+		mdvi_set_lookup_cache (cache_file);
+		g_free (cache_file);
+	}
+	g_free (cache_dir);
+
 	mdvi_register_special ("Color", "color", NULL, dvi_document_do_color_special, 1);
 	mdvi_register_fonts ();
+	mdvi_set_font_lock (dvi_font_lock, dvi_font_unlock);
 
 	ev_document_class->load = dvi_document_load;
 	ev_document_class->save = dvi_document_save;
@@ -263,6 +412,7 @@ dvi_document_class_init (DviDocumentClass *klass)
 	ev_document_class->get_page_size = dvi_document_get_page_size;
 	ev_document_class->render = dvi_document_render;
 	ev_document_class->support_synctex = dvi_document_support_synctex;
+	ev_document_class->is_thread_safe = dvi_document_is_thread_safe;
 }
 
 /* EvFileExporterIface */
@@ -522,6 +672,7 @@ dvi_document_init (DviDocument *dvi_document)
 {
 	dvi_document->context = NULL;
 	dvi_document_init_params (dvi_document);
+	g_mutex_init (&dvi_document->contexts_mutex);
 
 	dvi_document->exporter_filename = NULL;
 	dvi_document->exporter_opts = NULL;
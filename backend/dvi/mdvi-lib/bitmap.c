@@ -918,6 +918,18 @@ void	mdvi_shrink_glyph(DviContext *dvi, DviFont *font,
 		bitmap_print(stderr, newmap);
 }
 
+static void put_glyph_row(DviDevice *dev, void *image, int y, const Ulong *row, int w)
+{
+	int	x;
+
+	if(dev->put_row) {
+		dev->put_row(image, y, row, w);
+		return;
+	}
+	for(x = 0; x < w; x++)
+		dev->put_pixel(image, x, y, row[x]);
+}
+
 void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	DviFontChar *pk, DviGlyph *dest)
 {
@@ -933,6 +945,7 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	Ulong	*pixels;
 	int	npixels;
 	Ulong	colortab[2];
+	Ulong	*row;
 	int	hs, vs;
 	DviDevice *dev;
 
@@ -990,6 +1003,11 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	dest->w = w;
 	dest->h = h;
 
+	/* 
+	 * Each row is sampled into `row' and handed to the device at
+	 * once when it can take it, instead of a call per pixel.
+	 */
+	row = xnalloc(Ulong, w);
 	y = 0;
 	old_ptr = map->data;
 	rows_left = glyph->h;
@@ -1009,23 +1027,27 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 			if(npixels - 1 != samplemax)
 				sampleval = ((npixels-1) * sampleval) / samplemax;
 			ASSERT(sampleval < npixels);
-			dev->put_pixel(image, x, y, pixels[sampleval]);
+			row[x] = pixels[sampleval];
 			cols_left -= cols;
 			cols = hs;
 			x++;
 		}
 		for(; x < w; x++)
-			dev->put_pixel(image, x, y, pixels[0]);
+			row[x] = pixels[0];
+		put_glyph_row(dev, image, y, row, w);
 		old_ptr = bm_offset(old_ptr, rows * map->stride);
 		rows_left -= rows;
 		rows = vs;
 		y++;
 	}
 	
-	for(; y < h; y++) {
+	if(y < h) {
 		for(x = 0; x < w; x++)
-			dev->put_pixel(image, x, y, pixels[0]);
+			row[x] = pixels[0];
+		for(; y < h; y++)
+			put_glyph_row(dev, image, y, row, w);
 	}
+	mdvi_free(row);
 
         dev->image_done(image);
 	DEBUG((DBG_BITMAPS, "shrink_glyph_grey: (%dw,%dh,%dx,%dy) -> (%dw,%dh,%dx,%dy)\n",
@@ -562,17 +562,16 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 		case MDVI_SET_YDPI:
 			np.vdpi = va_arg(ap, Uint);
 			break;
+		/* glyphs remember the shrink factors they were made
+		 * for, and font_get_glyph() picks the right ones */
 		case MDVI_SET_SHRINK:
 			np.hshrink = np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_XSHRINK:
 			np.hshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_YSHRINK:
 			np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_ORIENTATION:
 			np.orientation = va_arg(ap, DviOrientation);
@@ -648,7 +647,9 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 	}
 
 	if(reset_font) {
+		font_lock();
 		font_reset_chain_glyphs(&dvi->device, dvi->fonts, reset_font);
+		font_unlock();
 	}
 	dvi->params = np;	
 	if((reset_font & MDVI_FONTSEL_GLYPH) && dvi->device.refresh) {
@@ -893,6 +894,7 @@ DviContext *mdvi_init_context(DviParams *par, DviPageSpec *spec, const char *fil
 	dvi->device.free_image   = dummy_free_image;
 	dvi->device.dev_destroy  = dummy_dev_destroy;
 	dvi->device.put_pixel    = dummy_dev_putpixel;
+	dvi->device.put_row      = NULL;
 	dvi->device.refresh      = dummy_dev_refresh;
 	dvi->device.set_color    = dummy_dev_set_color;
 	dvi->device.device_data  = NULL;
@@ -1258,11 +1260,13 @@ int	set_char(DviContext *dvi, int opcode)
 		return -1;
 	}
 	font = dvi->currfont->ref;
+	font_lock();
 	ch = font_get_glyph(dvi, font, num);
 	if(ch == NULL || ch->missing) {
 		/* try to display something anyway */
 		ch = FONTCHAR(font, num);
 		if(!glyph_present(ch)) {
+			font_unlock();
 			dviwarn(dvi, 
 			_("requested character %d does not exist in `%s'\n"), 
 				num, font->fontname);
@@ -1277,6 +1281,7 @@ int	set_char(DviContext *dvi, int opcode)
 			dvi->device.draw_glyph(dvi, ch, 
 				dvi->pos.hh, dvi->pos.vv);
 	}
+	font_unlock();
 	if(opcode >= DVI_PUT1 && opcode <= DVI_PUT4) {
 		SHOWCMD((dvi, "putchar", opcode - DVI_PUT1 + 1,
 			"char %d (%s)\n",
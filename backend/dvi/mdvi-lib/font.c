@@ -24,6 +24,9 @@
 
 static ListHead fontlist;
 
+static void (*font_lock_func) __PROTO((void)) = NULL;
+static void (*font_unlock_func) __PROTO((void)) = NULL;
+
 extern char *_mdvi_fallback_font;
 
 extern void vf_free_macros(DviFont *);
@@ -32,6 +35,207 @@ extern void vf_free_macros(DviFont *);
 #define TYPENAME(font)	\
 	((font)->finfo ? (font)->finfo->name : "none")
 
+void	mdvi_set_font_lock(void (*lock)(void), void (*unlock)(void))
+{
+	font_lock_func = lock;
+	font_unlock_func = unlock;
+}
+
+void	font_lock(void)
+{
+	if(font_lock_func)
+		font_lock_func();
+}
+
+void	font_unlock(void)
+{
+	if(font_unlock_func)
+		font_unlock_func();
+}
+
+/* 
+ * Glyph cache. A character only holds the shrunk and grey glyphs for
+ * one pair of shrink factors; when a different pair is requested, the
+ * current glyphs are moved here, so that going back to a previous zoom
+ * level doesn't need to shrink them again. Entries are shared by all
+ * the contexts and evicted, least recently stored first, once they take
+ * more than GLYPH_CACHE_BUDGET bytes. Accessed with the font lock held.
+ */
+#define GLYPH_CACHE_BUDGET	(32 * 1024 * 1024)
+#define GLYPH_CACHE_BUCKETS	1021
+
+typedef struct _GlyphCacheKey {
+	DviFont	*font;
+	int	code;
+	Ushort	hshrink;
+	Ushort	vshrink;
+} GlyphCacheKey;
+
+typedef struct _GlyphCacheEntry GlyphCacheEntry;
+
+struct _GlyphCacheEntry {
+	GlyphCacheEntry *next;
+	GlyphCacheEntry *prev;
+	GlyphCacheKey key;
+	DviGlyph shrunk;
+	DviGlyph grey;
+	Ulong	fg;
+	Ulong	bg;
+	DviFreeImage free_image;
+	size_t	size;
+};
+
+static DviHashTable glyph_cache = MDVI_EMPTY_HASH_TABLE;
+static ListHead glyph_cache_lru; /* most recently stored first */
+static size_t glyph_cache_size = 0;
+
+static Ulong glyph_cache_hash(DviHashKey key)
+{
+	GlyphCacheKey *k = (GlyphCacheKey *)key;
+
+	return ((Ulong)k->font >> 4) ^ ((Ulong)k->code << 8) ^
+		((Ulong)k->hshrink << 4) ^ (Ulong)k->vshrink;
+}
+
+static int glyph_cache_compare(DviHashKey key1, DviHashKey key2)
+{
+	GlyphCacheKey *k1 = (GlyphCacheKey *)key1;
+	GlyphCacheKey *k2 = (GlyphCacheKey *)key2;
+
+	return !(k1->font == k2->font && k1->code == k2->code &&
+		 k1->hshrink == k2->hshrink && k1->vshrink == k2->vshrink);
+}
+
+static void glyph_cache_free_entry(GlyphCacheEntry *entry)
+{
+	if(MDVI_GLYPH_NONEMPTY(entry->shrunk.data))
+		bitmap_destroy((BITMAP *)entry->shrunk.data);
+	if(MDVI_GLYPH_NONEMPTY(entry->grey.data) && entry->free_image)
+		entry->free_image(entry->grey.data);
+	mdvi_free(entry);
+}
+
+static void glyph_cache_remove(GlyphCacheEntry *entry)
+{
+	mdvi_hash_remove_ptr(&glyph_cache, MDVI_KEY(&entry->key));
+	listh_remove(&glyph_cache_lru, LIST(entry));
+	glyph_cache_size -= entry->size;
+}
+
+/* move the shrunk glyphs of `ch' to the cache */
+static void glyph_cache_store(DviDevice *dev, DviFont *font, int code, DviFontChar *ch)
+{
+	GlyphCacheEntry *entry;
+	GlyphCacheEntry *old;
+
+	if(MDVI_GLYPH_UNSET(ch->shrunk.data) && MDVI_GLYPH_UNSET(ch->grey.data))
+		return;
+
+	if(glyph_cache.buckets == NULL) {
+		mdvi_hash_create(&glyph_cache, GLYPH_CACHE_BUCKETS);
+		glyph_cache.hash_func = glyph_cache_hash;
+		glyph_cache.hash_comp = glyph_cache_compare;
+		listh_init(&glyph_cache_lru);
+	}
+
+	entry = xalloc(GlyphCacheEntry);
+	entry->key.font = font;
+	entry->key.code = code;
+	entry->key.hshrink = ch->hshrink;
+	entry->key.vshrink = ch->vshrink;
+	entry->shrunk = ch->shrunk;
+	entry->grey = ch->grey;
+	entry->fg = ch->fg;
+	entry->bg = ch->bg;
+	entry->free_image = dev->free_image;
+	entry->size = sizeof(GlyphCacheEntry);
+	if(MDVI_GLYPH_NONEMPTY(ch->shrunk.data)) {
+		BITMAP *bm = (BITMAP *)ch->shrunk.data;
+		entry->size += (size_t)bm->stride * bm->height;
+	}
+	if(MDVI_GLYPH_NONEMPTY(ch->grey.data))
+		entry->size += (size_t)ch->grey.w * ch->grey.h * 4;
+	ch->shrunk.data = NULL;
+	ch->grey.data = NULL;
+
+	old = (GlyphCacheEntry *)mdvi_hash_lookup(&glyph_cache, MDVI_KEY(&entry->key));
+	if(old) {
+		glyph_cache_remove(old);
+		glyph_cache_free_entry(old);
+	}
+	mdvi_hash_add(&glyph_cache, MDVI_KEY(&entry->key), entry, MDVI_HASH_UNCHECKED);
+	listh_prepend(&glyph_cache_lru, LIST(entry));
+	glyph_cache_size += entry->size;
+
+	while(glyph_cache_size > GLYPH_CACHE_BUDGET && glyph_cache_lru.tail) {
+		GlyphCacheEntry *lru = (GlyphCacheEntry *)glyph_cache_lru.tail;
+
+		glyph_cache_remove(lru);
+		glyph_cache_free_entry(lru);
+	}
+}
+
+/* move the glyphs of `ch' for the given shrink factors from the cache */
+static void glyph_cache_restore(DviFont *font, int code, DviFontChar *ch, int hshrink, int vshrink)
+{
+	GlyphCacheEntry *entry;
+	GlyphCacheKey key;
+
+	if(glyph_cache.buckets == NULL)
+		return;
+
+	key.font = font;
+	key.code = code;
+	key.hshrink = hshrink;
+	key.vshrink = vshrink;
+	entry = (GlyphCacheEntry *)mdvi_hash_lookup(&glyph_cache, MDVI_KEY(&key));
+	if(entry == NULL)
+		return;
+
+	glyph_cache_remove(entry);
+	ch->shrunk = entry->shrunk;
+	ch->grey = entry->grey;
+	ch->fg = entry->fg;
+	ch->bg = entry->bg;
+	mdvi_free(entry);
+}
+
+/* drop the cached glyphs of `font', called when they become invalid */
+static void glyph_cache_flush_font(DviFont *font)
+{
+	GlyphCacheEntry *entry, *next;
+
+	if(glyph_cache.buckets == NULL)
+		return;
+
+	for(entry = (GlyphCacheEntry *)glyph_cache_lru.head; entry; entry = next) {
+		next = entry->next;
+		if(entry->key.font == font) {
+			glyph_cache_remove(entry);
+			glyph_cache_free_entry(entry);
+		}
+	}
+}
+
+/*
+ * Outline fonts (Type1 and TrueType) are rasterized by us, glyph by
+ * glyph, which is much slower than reading PK glyphs. When the last
+ * context using them is gone, up to UNUSED_OUTLINE_FONTS_MAX of them are
+ * kept with their glyphs, and the glyph cache entries of every shrink
+ * factor, since fonts are looked up by file, size and resolution: a new
+ * context, for instance of another document using the same fonts, gets
+ * them without rasterizing anything again. The least recently dropped
+ * are destroyed first.
+ */
+#define UNUSED_OUTLINE_FONTS_MAX	32
+
+static int font_is_outline(DviFont *font)
+{
+	return font->finfo &&
+		(font->finfo->kpse_type == kpse_type1_format ||
+		 font->finfo->kpse_type == kpse_truetype_format);
+}
+
 int	font_reopen(DviFont *font)
 {
 	if(font->in)
@@ -115,6 +319,14 @@ int	font_free_unused(DviDevice *dev)
 {
 	DviFont	*font, *next;
 	int	count = 0;
+	int	outline = 0;
+
+	/* unused fonts are kept at the end of the list, in the order
+	 * they were dropped in */
+	for(font = (DviFont *)fontlist.head; font; font = font->next) {
+		if(!font->links && font_is_outline(font))
+			outline++;
+	}
 
 	DEBUG((DBG_FONTS, "destroying unused fonts\n"));	
 	for(font = (DviFont *)fontlist.head; font; font = next) {
@@ -123,6 +335,11 @@ int	font_free_unused(DviDevice *dev)
 		next = font->next;
 		if(font->links)
 			continue;
+		if(font_is_outline(font)) {
+			if(outline <= UNUSED_OUTLINE_FONTS_MAX)
+				continue;
+			outline--;
+		}
 		count++;
 		DEBUG((DBG_FONTS, "removing unused %s font `%s'\n", 
 			TYPENAME(font), font->fontname));
@@ -371,6 +588,18 @@ again:
 	   font->finfo->getglyph == NULL ||
 	   (dvi->params.hshrink == 1 && dvi->params.vshrink == 1))
 		return ch;
+
+	/* Shrunk for other factors, by a previous zoom level or by
+	 * another context: keep those, and reuse the ones we need if
+	 * we made them before */
+	if(ch->hshrink != dvi->params.hshrink ||
+	   ch->vshrink != dvi->params.vshrink) {
+		glyph_cache_store(&dvi->device, font, code, ch);
+		glyph_cache_restore(font, code, ch,
+			dvi->params.hshrink, dvi->params.vshrink);
+		ch->hshrink = dvi->params.hshrink;
+		ch->vshrink = dvi->params.vshrink;
+	}
 	
 	/* If the glyph is empty, we just need to shrink the box */
 	if(ch->missing || MDVI_GLYPH_ISEMPTY(ch->glyph.data)) {
@@ -440,6 +669,7 @@ void	font_reset_font_glyphs(DviDevice *dev, DviFont *font, int what)
 	}
 	if(font->finfo->getglyph == NULL)
 		return;
+	glyph_cache_flush_font(font);
 	DEBUG((DBG_FONTS, "resetting glyphs in font `%s'\n", font->fontname));
 	for(ch = font->chars, i = font->loc; i <= font->hic; ch++, i++) {
 		if(glyph_present(ch))
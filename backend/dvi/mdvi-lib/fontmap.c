@@ -252,15 +252,15 @@ static DviEncoding *register_encoding(const char *basefile, int replace)
 	} 
 
 	/* try our own files first */
-	filename = kpse_find_file(basefile, 
+	filename = mdvi_find_file(basefile, 
 		kpse_program_text_format, 0);
 
 	/* then try the system-wide ones */
 	if(filename == NULL)
-		filename = kpse_find_file(basefile, 
+		filename = mdvi_find_file(basefile, 
 			kpse_tex_ps_header_format, 0);
 	if(filename == NULL)
-		filename = kpse_find_file(basefile,
+		filename = mdvi_find_file(basefile,
 			kpse_dvips_config_format, 0);
 
 	/* finally try the given name */
@@ -472,11 +472,11 @@ DviFontMapEnt	*mdvi_load_fontmap(const char *file)
 	DviEncoding	*last_encoding;
 	char	*last_encfile;
 
-	ptr = kpse_find_file(file, kpse_program_text_format, 0);
+	ptr = mdvi_find_file(file, kpse_program_text_format, 0);
 	if(ptr == NULL)
-		ptr = kpse_find_file(file, kpse_tex_ps_header_format, 0);
+		ptr = mdvi_find_file(file, kpse_tex_ps_header_format, 0);
 	if(ptr == NULL)
-		ptr = kpse_find_file(file, kpse_dvips_config_format, 0);
+		ptr = mdvi_find_file(file, kpse_dvips_config_format, 0);
 	if(ptr == NULL)
 		in = fopen(file, "rb");
 	else {
@@ -726,7 +726,7 @@ static int	mdvi_init_fontmaps(void)
 	if(config == NULL)
 		config = MDVI_DEFAULT_CONFIG;
 	/* let's ask kpathsea for the file first */
-	file = kpse_find_file(config, kpse_program_text_format, 0);
+	file = mdvi_find_file(config, kpse_program_text_format, 0);
 	if(file == NULL)
 		in = fopen(config, "rb");
 	else {
@@ -749,7 +749,7 @@ static int	mdvi_init_fontmaps(void)
 			DEBUG((DBG_FMAP, "%s: loading fontmap\n", arg));
 			ent = mdvi_load_fontmap(arg);
 			if(ent == NULL) {
-				map_file = kpse_find_file(arg, kpse_fontmap_format, 0);
+				map_file = mdvi_find_file(arg, kpse_fontmap_format, 0);
 				if (map_file)
 					ent = mdvi_load_fontmap(map_file);
 			}
@@ -0,0 +1,279 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Persistent cache for kpathsea lookups. Searching the TeX trees for
+ * fontmaps, encodings and fonts can take seconds when they are on a
+ * network filesystem, so the paths found are kept in a file and used
+ * by later sessions while the file they point to has the same mtime.
+ * Failed lookups are not kept, since the file may be generated later.
+ *
+ * The cache file is a line with the version and the kpathsea setup,
+ * followed by one line per lookup:
+ *
+ *	<mtime> TAB <dpi> TAB <key> TAB <path>
+ *
+ * Lookups happen with the font lock held, see mdvi_set_font_lock().
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "mdvi.h"
+#include "private.h"
+
+#define LOOKUP_CACHE_VERSION	"mdvi-lookups-1"
+#define LOOKUP_HASH_SIZE	257
+
+typedef struct _LookupEnt LookupEnt;
+
+struct _LookupEnt {
+	LookupEnt *next;
+	LookupEnt *prev;
+	char	*key;
+	char	*path;
+	long	mtime;
+	int	dpi;
+};
+
+static char	*cache_file = NULL;
+static char	*cache_tag = NULL;
+static int	cache_loaded = 0;
+static int	cache_dirty = 0;
+static ListHead	lookups = MDVI_EMPTY_LIST_HEAD;
+static DviHashTable lookuptable = MDVI_EMPTY_HASH_TABLE;
+
+static long file_mtime(const char *path)
+{
+	struct stat st;
+
+	if(stat(path, &st) < 0)
+		return -1;
+	return (long)st.st_mtime;
+}
+
+static void free_lookup(LookupEnt *ent)
+{
+	mdvi_free(ent->key);
+	mdvi_free(ent->path);
+	mdvi_free(ent);
+}
+
+static void add_lookup(const char *key, const char *path, long mtime, int dpi)
+{
+	LookupEnt *ent;
+
+	/* these would break the file format */
+	if(strpbrk(key, "\t\n") || strpbrk(path, "\t\n"))
+		return;
+
+	ent = (LookupEnt *)mdvi_hash_lookup(&lookuptable, MDVI_KEY(key));
+	if(ent) {
+		mdvi_hash_remove_ptr(&lookuptable, MDVI_KEY(ent->key));
+		listh_remove(&lookups, LIST(ent));
+		free_lookup(ent);
+	}
+	ent = xalloc(LookupEnt);
+	ent->key = mdvi_strdup(key);
+	ent->path = mdvi_strdup(path);
+	ent->mtime = mtime;
+	ent->dpi = dpi;
+	mdvi_hash_add(&lookuptable, MDVI_KEY(ent->key), ent, MDVI_HASH_UNCHECKED);
+	listh_append(&lookups, LIST(ent));
+}
+
+static void load_lookups(void)
+{
+	FILE	*in;
+	Dstring	input;
+	char	*line;
+
+	cache_loaded = 1;
+	mdvi_hash_create(&lookuptable, LOOKUP_HASH_SIZE);
+	if(cache_file == NULL || cache_tag == NULL)
+		return;
+	in = fopen(cache_file, "rb");
+	if(in == NULL)
+		return;
+
+	dstring_init(&input);
+	/* a different setup may find different files */
+	line = dgets(&input, in);
+	if(line == NULL || !STREQ(line, cache_tag)) {
+		DEBUG((DBG_FILES, "%s: ignoring stale lookup cache\n", cache_file));
+		cache_dirty = 1;
+		goto done;
+	}
+	while((line = dgets(&input, in)) != NULL) {
+		char	*dpi, *key, *path;
+		long	mtime;
+
+		mtime = strtol(line, &dpi, 10);
+		if(*dpi++ != '\t')
+			continue;
+		key = strchr(dpi, '\t');
+		if(key == NULL)
+			continue;
+		*key++ = 0;
+		path = strchr(key, '\t');
+		if(path == NULL)
+			continue;
+		*path++ = 0;
+		add_lookup(key, path, mtime, atoi(dpi));
+	}
+	DEBUG((DBG_FILES, "%s: %d lookups\n", cache_file, lookups.count));
+done:
+	dstring_reset(&input);
+	fclose(in);
+}
+
+/* returns the cached path for `key', if it's still valid */
+static LookupEnt *find_lookup(const char *key)
+{
+	LookupEnt *ent;
+
+	if(!cache_loaded)
+		load_lookups();
+	ent = (LookupEnt *)mdvi_hash_lookup(&lookuptable, MDVI_KEY(key));
+	if(ent == NULL)
+		return NULL;
+	if(file_mtime(ent->path) == ent->mtime)
+		return ent;
+	DEBUG((DBG_FILES, "%s: cached path `%s' is stale\n", key, ent->path));
+	mdvi_hash_remove_ptr(&lookuptable, MDVI_KEY(ent->key));
+	listh_remove(&lookups, LIST(ent));
+	free_lookup(ent);
+	cache_dirty = 1;
+	return NULL;
+}
+
+static void store_lookup(const char *key, const char *path, int dpi)
+{
+	long	mtime = file_mtime(path);
+
+	if(mtime < 0)
+		return;
+	add_lookup(key, path, mtime, dpi);
+	cache_dirty = 1;
+}
+
+void	mdvi_set_lookup_tag(const char *program, const char *mfmode,
+	int dpi, const char *texmfcnf)
+{
+	char	*tag;
+
+	tag = mdvi_malloc(strlen(LOOKUP_CACHE_VERSION) + strlen(program) +
+		strlen(mfmode) + (texmfcnf ? strlen(texmfcnf) : 0) + 32);
+	sprintf(tag, "%s %s %s %d %s", LOOKUP_CACHE_VERSION,
+		program, mfmode, dpi, texmfcnf ? texmfcnf : "");
+	if(cache_tag)
+		mdvi_free(cache_tag);
+	cache_tag = tag;
+}
+
+void	mdvi_set_lookup_cache(const char *filename)
+{
+	if(cache_file)
+		mdvi_free(cache_file);
+	cache_file = filename ? mdvi_strdup(filename) : NULL;
+}
+
+int	mdvi_save_lookup_cache(void)
+{
+	LookupEnt *ent;
+	char	*tmpfile;
+	FILE	*out;
+	int	ok;
+
+	if(!cache_dirty || cache_file == NULL || cache_tag == NULL)
+		return 0;
+
+	/* write a new file and rename it, so that concurrent readers
+	 * never see a partial cache */
+	tmpfile = mdvi_malloc(strlen(cache_file) + 32);
+	sprintf(tmpfile, "%s.%ld", cache_file, (long)getpid());
+	out = fopen(tmpfile, "wb");
+	if(out == NULL) {
+		mdvi_free(tmpfile);
+		return -1;
+	}
+	fprintf(out, "%s\n", cache_tag);
+	for(ent = (LookupEnt *)lookups.head; ent; ent = ent->next)
+		fprintf(out, "%ld\t%d\t%s\t%s\n",
+			ent->mtime, ent->dpi, ent->key, ent->path);
+	ok = !ferror(out);
+	ok = (fclose(out) == 0) && ok;
+	if(ok && rename(tmpfile, cache_file) == 0)
+		cache_dirty = 0;
+	else {
+		unlink(tmpfile);
+		ok = 0;
+	}
+	mdvi_free(tmpfile);
+	DEBUG((DBG_FILES, "%s: saved %d lookups\n", cache_file, lookups.count));
+	return ok ? 0 : -1;
+}
+
+char	*mdvi_find_file(const char *name, kpse_file_format_type format, int must_exist)
+{
+	LookupEnt *ent;
+	char	*key;
+	char	*path;
+
+	key = mdvi_malloc(strlen(name) + 16);
+	sprintf(key, "f%d:%s", (int)format, name);
+	ent = find_lookup(key);
+	if(ent != NULL) {
+		mdvi_free(key);
+		return mdvi_strdup(ent->path);
+	}
+	path = kpse_find_file(name, format, must_exist);
+	if(path != NULL)
+		store_lookup(key, path, 0);
+	mdvi_free(key);
+	return path;
+}
+
+char	*mdvi_find_glyph(const char *name, unsigned dpi,
+	kpse_file_format_type format, kpse_glyph_file_type *type)
+{
+	LookupEnt *ent;
+	char	*key;
+	char	*path;
+
+	key = mdvi_malloc(strlen(name) + 32);
+	sprintf(key, "g%d:%u:%s", (int)format, dpi, name);
+	ent = find_lookup(key);
+	if(ent != NULL) {
+		mdvi_free(key);
+		type->name = name;
+		type->dpi = ent->dpi;
+		type->format = format;
+		type->source = kpse_glyph_source_normal;
+		return mdvi_strdup(ent->path);
+	}
+	path = kpse_find_glyph(name, dpi, format, type);
+	/* the fallback font depends on what's missing, look it up again */
+	if(path != NULL && type->source != kpse_glyph_source_fallback)
+		store_lookup(key, path, type->dpi);
+	mdvi_free(key);
+	return path;
+}
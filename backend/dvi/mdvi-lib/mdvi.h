@@ -99,6 +99,7 @@ typedef void *(*DviCreateImage)	__PROTO((void *device_data,
 				         Uint bpp));
 typedef void (*DviFreeImage)	__PROTO((void *image));
 typedef void (*DviPutPixel)	__PROTO((void *image, int x, int y, Ulong color));
+typedef void (*DviPutRow)	__PROTO((void *image, int y, const Ulong *colors, int n));
 typedef void (*DviImageDone)    __PROTO((void *image));
 typedef void (*DviDevDestroy)   __PROTO((void *data));
 typedef void (*DviRefresh)      __PROTO((DviContext *dvi, void *device_data));
@@ -115,6 +116,7 @@ struct _DviDevice {
 	DviCreateImage	create_image;
 	DviFreeImage	free_image;
 	DviPutPixel	put_pixel;
+	DviPutRow	put_row;	/* optional, a row at once */
         DviImageDone    image_done;
 	DviDevDestroy	dev_destroy;
 	DviRefresh	refresh;
@@ -201,6 +203,9 @@ struct _DviFontChar {
 	DviGlyph glyph;
 	DviGlyph shrunk;
 	DviGlyph grey;
+	/* shrink factors the shrunk and grey glyphs were made for */
+	Ushort	hshrink;
+	Ushort	vshrink;
 };
 
 struct _DviFontRef {
@@ -493,6 +498,8 @@ extern void	flush_font_metrics __PROTO((void));
 extern void	mdvi_sort_pages __PROTO((DviContext *, DviPageSort));
 
 extern void mdvi_init_kpathsea __PROTO((const char *, const char *, const char *, int, const char *));
+extern void mdvi_set_lookup_cache __PROTO((const char *));
+extern int  mdvi_save_lookup_cache __PROTO((void));
 
 extern DviContext* mdvi_init_context __PROTO((DviParams *, DviPageSpec *, const char *));
 extern void 	mdvi_destroy_context __PROTO((DviContext *));
@@ -594,6 +601,16 @@ extern void font_transform_glyph __PROTO((DviOrientation, DviGlyph *));
 /* destroy all fonts that are not being used, returns number of fonts freed */
 extern int font_free_unused __PROTO((DviDevice *));
 
+/* 
+ * Fonts and their glyphs are shared by all the contexts. Applications
+ * rendering from several threads, each with its own context, set
+ * functions locking a recursive mutex, held while glyphs are loaded
+ * and drawn.
+ */
+extern void mdvi_set_font_lock __PROTO((void (*)(void), void (*)(void)));
+extern void font_lock __PROTO((void));
+extern void font_unlock __PROTO((void));
+
 #define font_free_glyph(dev, font, code) \
 	font_reset_one_glyph((dev), \
 	FONTCHAR((font), (code)), MDVI_FONTSEL_GLYPH)
@@ -104,7 +104,7 @@ static char *pk_lookup(const char *name, Ushort *hdpi, Ushort *vdpi)
 		kpse_set_program_enabled(kpse_pk_format, 1, kpse_src_cmdline);
 		pk_auto_generate = 1;
 	}
-	filename = kpse_find_glyph(name, Max(*hdpi, *vdpi),
+	filename = mdvi_find_glyph(name, Max(*hdpi, *vdpi),
 		kpse_pk_format, &type);
 	if(filename && type.source == kpse_glyph_source_fallback) {
 		mdvi_free(filename);
@@ -124,7 +124,7 @@ static char *pk_lookupn(const char *name, Ushort *hdpi, Ushort *vdpi)
 		kpse_set_program_enabled(kpse_pk_format, 0, kpse_src_cmdline);
 		pk_auto_generate = 0;
 	}
-	filename = kpse_find_glyph(name, Max(*hdpi, *vdpi),
+	filename = mdvi_find_glyph(name, Max(*hdpi, *vdpi),
 		kpse_pk_format, &type);
 	if(filename && type.source == kpse_glyph_source_fallback) {
 		mdvi_free(filename);
@@ -41,6 +41,12 @@
 #include <kpathsea/tex-make.h>
 #include <kpathsea/lib.h>
 
+/* kpathsea lookups, through the cache in kpsecache.c */
+extern char *mdvi_find_file __PROTO((const char *, kpse_file_format_type, int));
+extern char *mdvi_find_glyph __PROTO((const char *, unsigned,
+	kpse_file_format_type, kpse_glyph_file_type *));
+extern void mdvi_set_lookup_tag __PROTO((const char *, const char *, int, const char *));
+
 #define ISSP(p)		(*(p) == ' ' || *(p) == '\t')
 #define SKIPSP(p)	while(ISSP(p)) p++
 #define SKIPNSP(p)	while(*(p) && !ISSP(p)) p++
@@ -44,5 +44,6 @@ void	mdvi_init_kpathsea(const char *program,
 	kpse_set_program_enabled(kpse_ofm_format, 1, kpse_src_compile);
 	if (texmfcnf != NULL)
 		xputenv("TEXMFCNF", texmfcnf);
+	mdvi_set_lookup_tag(p, mfmode, dpi, texmfcnf);
 }
 
@@ -106,7 +106,7 @@ char	*t1_lookup_font(const char *name, Ushort *hdpi, Ushort *vdpi)
 	DEBUG((DBG_TYPE1, "(t1) looking for `%s'\n", name));
 
 	/* first let's try the font we were asked for */
-	filename = kpse_find_file(name, kpse_type1_format, 1);
+	filename = mdvi_find_file(name, kpse_type1_format, 1);
 	if(filename != NULL) {
 		/* we got it */
 		return filename;
@@ -151,7 +151,7 @@ char	*t1_lookup_font(const char *name, Ushort *hdpi, Ushort *vdpi)
 	/* look it up */
 	DEBUG((DBG_TYPE1, "(t1) looking for `%s' on behalf of `%s'\n",
 		newname, name));
-	filename = kpse_find_file(newname, kpse_type1_format, 1);
+	filename = mdvi_find_file(newname, kpse_type1_format, 1);
 
 	/* we don't need this anymore */
 	if(newname != name)
@@ -601,11 +601,11 @@ char	*lookup_font_metrics(const char *name, int *type)
 		case DviFontAny:
 #endif
 		case DviFontTFM:
-			file = kpse_find_tfm(name);
+			file = mdvi_find_file(name, kpse_tfm_format, 1);
                         *type = DviFontTFM;
 			break;
 		case DviFontOFM: {
-			file = kpse_find_ofm(name);
+			file = mdvi_find_file(name, kpse_ofm_format, 1);
 			/* we may have gotten a TFM back */
 			if(file != NULL) {
 				const char *ext = file_extension(file);
@@ -616,13 +616,13 @@ char	*lookup_font_metrics(const char *name, int *type)
 		}
 #ifdef WITH_AFM_FILES
 		case DviFontAFM:
-			file = kpse_find_file(name, kpse_afm_format, 0);
+			file = mdvi_find_file(name, kpse_afm_format, 0);
 			break;	
 		case DviFontAny:
-			file = kpse_find_file(name, kpse_afm_format, 0);
+			file = mdvi_find_file(name, kpse_afm_format, 0);
 			*type = DviFontAFM;
 			if(file == NULL) {
-				file = kpse_find_tfm(name);
+				file = mdvi_find_file(name, kpse_tfm_format, 1);
 				*type = DviFontTFM;
 			}
 			break;
@@ -22,7 +22,12 @@
 #include "config.h"
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <poppler.h>
 #include <poppler-document.h>
@@ -51,12 +56,17 @@
 #include "ev-document-annotations.h"
 #include "ev-document-attachments.h"
 #include "ev-document-text.h"
+#include "ev-memory-stats.h"
 #include "ev-selection.h"
+#include "ev-surface-pool.h"
+#include "pdf-image-data.h"
+#include "pdf-objects.h"
 #include "ev-transition-effect.h"
 #include "ev-attachment.h"
 #include "ev-image.h"
 #include "ev-media.h"
 #include "ev-file-helpers.h"
+#include "pdf-layers-scan.h"
 
 #include <libxml/tree.h>
 #include <libxml/parser.h>
@@ -103,6 +113,7 @@ struct _PdfDocument
 
 	PopplerDocument *document;
 	gchar *password;
+	/* Atomic, read by renders running without the document lock */
 	gboolean forms_modified;
 	gboolean annots_modified;
 
@@ -114,6 +125,35 @@ struct _PdfDocument
 	PdfPrintContext *print_ctx;
 
 	GHashTable *annots;
+
+	/* Contents of the file, see pdf_document_map_file() */
+	GMappedFile *mapped_file;
+
+	/* Pages of every layer, see pdf_document_layers_get_layers() */
+	PdfLayersScan *layers_scan;
+
+	/* Objects of the mapped file, see pdf_document_get_objects() */
+	PdfObjects *objects;
+
+	/* Stamp of the file as poppler read it, see
+	 * pdf_document_save_incremental() */
+	goffset file_size;
+	gint64 file_mtime;
+
+	/* Render replicas, see pdf_document_setup_replicas() */
+	gchar *replicas_uri;
+	GAsyncQueue *replicas;
+	guint n_replicas;
+	guint max_replicas;
+	gboolean replicas_stale; /* Atomic */
+	/* Also protects mapped_file, read by the memory stats */
+	GMutex replicas_mutex;
+
+	/* Named destinations and page heights already resolved for
+	 * links, see pdf_document_find_dest() */
+	GHashTable *dests;
+	gdouble *page_heights;
+	GMutex dests_mutex;
 };
 
 static void pdf_document_security_iface_init             (EvDocumentSecurityInterface    *iface);
@@ -138,10 +178,10 @@ static EvLinkDest *ev_link_dest_from_dest    (PdfDocument       *pdf_document,
 static EvLink     *ev_link_from_action       (PdfDocument       *pdf_document,
 					      PopplerAction     *action);
 static void        pdf_print_context_free    (PdfPrintContext   *ctx);
-static gboolean    attachment_save_to_buffer (PopplerAttachment *attachment,
-					      gchar            **buffer,
-					      gsize             *buffer_size,
-					      GError           **error);
+static EvAttachment *pdf_document_new_attachment (PdfDocument       *pdf_document,
+						  PopplerAttachment *attachment);
+static PdfObjects *pdf_document_get_objects  (PdfDocument       *pdf_document,
+					      gboolean          *owned);
 
 EV_BACKEND_REGISTER_WITH_CODE (PdfDocument, pdf_document,
 			 {
@@ -182,6 +222,9 @@ pdf_document_dispose (GObject *object)
 {
 	PdfDocument *pdf_document = PDF_DOCUMENT(object);
 
+	ev_memory_stats_unregister ("pdf-mapped-file", pdf_document);
+	ev_memory_stats_unregister ("pdf-render-replicas", pdf_document);
+
 	if (pdf_document->print_ctx) {
 		pdf_print_context_free (pdf_document->print_ctx);
 		pdf_document->print_ctx = NULL;
@@ -204,13 +247,282 @@ pdf_document_dispose (GObject *object)
 		poppler_fonts_iter_free (pdf_document->fonts_iter);
 	}
 
+	if (pdf_document->replicas) {
+		g_async_queue_unref (pdf_document->replicas);
+		pdf_document->replicas = NULL;
+	}
+
+	g_clear_pointer (&pdf_document->replicas_uri, g_free);
+	g_clear_pointer (&pdf_document->mapped_file, g_mapped_file_unref);
+	g_clear_pointer (&pdf_document->layers_scan, pdf_layers_scan_free);
+	g_clear_pointer (&pdf_document->objects, pdf_objects_free);
+
+	g_clear_pointer (&pdf_document->dests, g_hash_table_destroy);
+	g_clear_pointer (&pdf_document->page_heights, g_free);
+
 	G_OBJECT_CLASS (pdf_document_parent_class)->dispose (object);
 }
 
+static void
+pdf_document_finalize (GObject *object)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (object);
+
+	g_mutex_clear (&pdf_document->replicas_mutex);
+	g_mutex_clear (&pdf_document->dests_mutex);
+
+	G_OBJECT_CLASS (pdf_document_parent_class)->finalize (object);
+}
+
+/* Poppler doesn't tell how much memory its caches use, the replicas
+ * are counted without their bytes, each one has its own caches */
+static void
+pdf_document_get_mapped_file_memory_stats (gpointer  user_data,
+					   guint64  *bytes,
+					   guint    *n_entries)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (user_data);
+
+	g_mutex_lock (&pdf_document->replicas_mutex);
+	if (pdf_document->mapped_file) {
+		*bytes += g_mapped_file_get_length (pdf_document->mapped_file);
+		*n_entries += 1;
+	}
+	g_mutex_unlock (&pdf_document->replicas_mutex);
+}
+
+static void
+pdf_document_get_replicas_memory_stats (gpointer  user_data,
+					guint64  *bytes,
+					guint    *n_entries)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (user_data);
+
+	g_mutex_lock (&pdf_document->replicas_mutex);
+	if (pdf_document->replicas)
+		*n_entries += pdf_document->n_replicas;
+	g_mutex_unlock (&pdf_document->replicas_mutex);
+}
+
 static void
 pdf_document_init (PdfDocument *pdf_document)
 {
 	pdf_document->password = NULL;
+	g_mutex_init (&pdf_document->replicas_mutex);
+	g_mutex_init (&pdf_document->dests_mutex);
+
+	ev_memory_stats_register ("pdf-mapped-file",
+				  pdf_document_get_mapped_file_memory_stats,
+				  pdf_document);
+	ev_memory_stats_register ("pdf-render-replicas",
+				  pdf_document_get_replicas_memory_stats,
+				  pdf_document);
+}
+
+/* Local files can be mapped in memory and loaded from there, instead
+ * of being read by poppler, so that the main document and its replicas
+ * share the same pages of the page cache. This is opt-in, by setting
+ * EV_PDF_MAP_FILES, since a file truncated while it's mapped, when it's
+ * being rewritten for instance, makes the process crash.
+ */
+static void
+pdf_document_map_file (PdfDocument *pdf_document,
+		       const gchar *uri)
+{
+	GMappedFile *mapped_file;
+	gchar       *filename;
+
+	g_mutex_lock (&pdf_document->replicas_mutex);
+	g_clear_pointer (&pdf_document->mapped_file, g_mapped_file_unref);
+	g_mutex_unlock (&pdf_document->replicas_mutex);
+	g_clear_pointer (&pdf_document->objects, pdf_objects_free);
+
+	if (!g_getenv ("EV_PDF_MAP_FILES"))
+		return;
+
+	filename = g_filename_from_uri (uri, NULL, NULL);
+	if (!filename)
+		return;
+
+	mapped_file = g_mapped_file_new (filename, FALSE, NULL);
+	g_free (filename);
+	if (!mapped_file)
+		return;
+
+	/* Poppler takes the length as an int */
+	if (g_mapped_file_get_length (mapped_file) == 0 ||
+	    g_mapped_file_get_length (mapped_file) > G_MAXINT) {
+		g_mapped_file_unref (mapped_file);
+		return;
+	}
+
+	g_mutex_lock (&pdf_document->replicas_mutex);
+	pdf_document->mapped_file = mapped_file;
+	g_mutex_unlock (&pdf_document->replicas_mutex);
+}
+
+static PopplerDocument *
+pdf_document_open (PdfDocument *pdf_document,
+		   const gchar *uri,
+		   GError     **error)
+{
+	if (pdf_document->mapped_file) {
+		return poppler_document_new_from_data (g_mapped_file_get_contents (pdf_document->mapped_file),
+						       (int) g_mapped_file_get_length (pdf_document->mapped_file),
+						       pdf_document->password, error);
+	}
+
+	return poppler_document_new_from_file (uri, pdf_document->password, error);
+}
+
+/* Replicas are extra PopplerDocuments opened from the same file, so
+ * that different pages can be rendered at the same time. PopplerDocument
+ * itself is not safe to use from several threads. This is opt-in, by
+ * setting EV_PDF_RENDER_REPLICAS to the maximum number of replicas.
+ * Only documents loaded from local files can be replicated.
+ */
+static void
+pdf_document_setup_replicas (PdfDocument *pdf_document,
+			     const gchar *uri)
+{
+	PopplerDocument *replica;
+	const gchar     *env;
+	gchar           *filename;
+	gint             n;
+
+	env = g_getenv ("EV_PDF_RENDER_REPLICAS");
+	if (!env)
+		return;
+
+	n = MIN (atoi (env), (gint) g_get_num_processors ());
+	if (n <= 0)
+		return;
+
+	filename = g_filename_from_uri (uri, NULL, NULL);
+	if (!filename)
+		return;
+	g_free (filename);
+
+	if (pdf_document->replicas)
+		g_async_queue_unref (pdf_document->replicas);
+	pdf_document->replicas = NULL;
+	g_free (pdf_document->replicas_uri);
+	pdf_document->replicas_uri = NULL;
+
+	/* Open the first replica right away, so that there is
+	 * always one to wait for once rendering is done unlocked */
+	replica = pdf_document_open (pdf_document, uri, NULL);
+	if (!replica)
+		return;
+
+	pdf_document->replicas_uri = g_strdup (uri);
+	pdf_document->replicas = g_async_queue_new_full ((GDestroyNotify)g_object_unref);
+	g_async_queue_push (pdf_document->replicas, replica);
+	pdf_document->n_replicas = 1;
+	pdf_document->max_replicas = n;
+	g_atomic_int_set (&pdf_document->replicas_stale, FALSE);
+}
+
+/* Replicas don't see changes made to the main document,
+ * so they are not used anymore once it has been modified.
+ */
+static gboolean
+pdf_document_replicas_usable (PdfDocument *pdf_document)
+{
+	return pdf_document->replicas != NULL &&
+		!g_atomic_int_get (&pdf_document->replicas_stale) &&
+		!g_atomic_int_get (&pdf_document->forms_modified) &&
+		!g_atomic_int_get (&pdf_document->annots_modified);
+}
+
+static PopplerDocument *
+pdf_document_acquire_replica (PdfDocument *pdf_document)
+{
+	PopplerDocument *replica;
+
+	replica = POPPLER_DOCUMENT (g_async_queue_try_pop (pdf_document->replicas));
+	if (replica)
+		return replica;
+
+	g_mutex_lock (&pdf_document->replicas_mutex);
+	if (pdf_document->n_replicas < pdf_document->max_replicas) {
+		replica = pdf_document_open (pdf_document,
+					     pdf_document->replicas_uri,
+					     NULL);
+		if (replica)
+			pdf_document->n_replicas++;
+		else /* Don't try again, make do with the existing ones */
+			pdf_document->max_replicas = pdf_document->n_replicas;
+	}
+	g_mutex_unlock (&pdf_document->replicas_mutex);
+
+	if (replica)
+		return replica;
+
+	/* All replicas are busy, wait for one to be released */
+	return POPPLER_DOCUMENT (g_async_queue_pop (pdf_document->replicas));
+}
+
+static void
+pdf_document_release_replica (PdfDocument     *pdf_document,
+			      PopplerDocument *replica)
+{
+	g_async_queue_push (pdf_document->replicas, replica);
+}
+
+/* Returns the page to render or search, of a replica when they are
+ * usable and of the main document otherwise. Renders and searches of
+ * thread-safe documents run without the document lock, while the
+ * main thread edits forms and annotations of the main document with
+ * it held, so the choice is made under the lock, which is kept, with
+ * the document mutex, for as long as the main document page is used.
+ * The page is released with pdf_document_release_page().
+ */
+static PopplerPage *
+pdf_document_acquire_page (PdfDocument      *pdf_document,
+			   EvPage           *page,
+			   PopplerDocument **replica,
+			   gboolean         *locked)
+{
+	EvDocument *document = EV_DOCUMENT (pdf_document);
+
+	*replica = NULL;
+	*locked = !ev_document_is_locked (document);
+	if (*locked)
+		ev_document_lock (document);
+
+	if (pdf_document_replicas_usable (pdf_document)) {
+		if (*locked)
+			ev_document_unlock (document);
+		*locked = FALSE;
+
+		*replica = pdf_document_acquire_replica (pdf_document);
+
+		return poppler_document_get_page (*replica, page->index);
+	}
+
+	if (*locked)
+		ev_document_doc_mutex_lock ();
+
+	return POPPLER_PAGE (g_object_ref (page->backend_page));
+}
+
+static void
+pdf_document_release_page (PdfDocument     *pdf_document,
+			   PopplerPage     *poppler_page,
+			   PopplerDocument *replica,
+			   gboolean         locked)
+{
+	if (poppler_page)
+		g_object_unref (poppler_page);
+
+	if (replica)
+		pdf_document_release_replica (pdf_document, replica);
+
+	if (locked) {
+		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (EV_DOCUMENT (pdf_document));
+	}
 }
 
 static void
@@ -240,6 +552,181 @@ convert_error (GError  *poppler_error,
 }
 
 
+static gboolean
+pdf_document_get_file_stamp (const gchar *filename,
+			     goffset     *size,
+			     gint64      *mtime)
+{
+	GStatBuf statbuf;
+
+	if (g_stat (filename, &statbuf) != 0)
+		return FALSE;
+
+	*size = statbuf.st_size;
+	*mtime = statbuf.st_mtime;
+
+	return TRUE;
+}
+
+static void
+pdf_document_stamp_file (PdfDocument *pdf_document,
+			 const gchar *uri)
+{
+	gchar *filename;
+
+	pdf_document->file_size = 0;
+	pdf_document->file_mtime = 0;
+
+	filename = g_filename_from_uri (uri, NULL, NULL);
+	if (!filename)
+		return;
+
+	if (!pdf_document_get_file_stamp (filename,
+					  &pdf_document->file_size,
+					  &pdf_document->file_mtime))
+		pdf_document->file_size = 0;
+	g_free (filename);
+}
+
+static gboolean
+pdf_read_block (gint    fd,
+		goffset offset,
+		guchar *buffer,
+		gsize   size)
+{
+	gsize done = 0;
+
+	while (done < size) {
+		gssize n = pread (fd, buffer + done, size - done, offset + done);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return FALSE;
+		done += n;
+	}
+
+	return TRUE;
+}
+
+#define PDF_INCREMENTAL_BLOCK_SIZE 65536
+
+/* Poppler writes the original file followed by the update, unless it
+ * has to rewrite the whole document. Compare the start and the end of
+ * the original contents to tell both cases apart.
+ */
+static gboolean
+pdf_update_follows_file (gint    file_fd,
+			 gint    update_fd,
+			 goffset file_size)
+{
+	guchar  *file_block, *update_block;
+	gsize    size;
+	goffset  offsets[2];
+	gboolean retval = TRUE;
+	guint    i;
+
+	size = MIN (file_size, PDF_INCREMENTAL_BLOCK_SIZE);
+	offsets[0] = 0;
+	offsets[1] = file_size - size;
+
+	file_block = (guchar *) g_malloc (size);
+	update_block = (guchar *) g_malloc (size);
+	for (i = 0; i < G_N_ELEMENTS (offsets) && retval; i++) {
+		retval = pdf_read_block (file_fd, offsets[i], file_block, size) &&
+			pdf_read_block (update_fd, offsets[i], update_block, size) &&
+			memcmp (file_block, update_block, size) == 0;
+	}
+	g_free (file_block);
+	g_free (update_block);
+
+	return retval;
+}
+
+static gboolean
+pdf_append_update (gint     file_fd,
+		   gint     update_fd,
+		   goffset  file_size,
+		   goffset  update_size)
+{
+	guchar *buffer;
+	goffset offset = file_size;
+
+	buffer = (guchar *) g_malloc (PDF_INCREMENTAL_BLOCK_SIZE);
+	while (offset < update_size) {
+		gsize  size = MIN (update_size - offset, PDF_INCREMENTAL_BLOCK_SIZE);
+		gsize  done = 0;
+
+		if (!pdf_read_block (update_fd, offset, buffer, size))
+			break;
+
+		while (done < size) {
+			gssize n = pwrite (file_fd, buffer + done, size - done, offset + done);
+
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			done += n;
+		}
+		if (done < size)
+			break;
+
+		offset += size;
+	}
+	g_free (buffer);
+
+	if (offset < update_size || fsync (file_fd) != 0) {
+		/* Leave the file as it was */
+		if (ftruncate (file_fd, file_size) != 0)
+			g_warning ("Failed to truncate the document back to its size");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Whether saving the document would write again the file it was read
+ * from: nothing was changed or saved since, and nobody else modified
+ * the file */
+static gboolean
+pdf_document_matches_file (PdfDocument *pdf_document)
+{
+	gchar    *filename;
+	goffset   size;
+	gint64    mtime;
+	gboolean  retval;
+
+	if (g_atomic_int_get (&pdf_document->forms_modified) ||
+	    g_atomic_int_get (&pdf_document->annots_modified) ||
+	    g_atomic_int_get (&pdf_document->replicas_stale) ||
+	    pdf_document->file_size == 0)
+		return FALSE;
+
+	filename = g_filename_from_uri (ev_document_get_uri (EV_DOCUMENT (pdf_document)), NULL, NULL);
+	if (!filename)
+		return FALSE;
+
+	retval = pdf_document_get_file_stamp (filename, &size, &mtime) &&
+		size == pdf_document->file_size &&
+		mtime == pdf_document->file_mtime;
+	g_free (filename);
+
+	return retval;
+}
+
+/* The replicas stay stale after a save, they don't have the changes
+ * that were saved either */
+static void
+pdf_document_mark_saved (PdfDocument *pdf_document)
+{
+	if (g_atomic_int_get (&pdf_document->forms_modified) ||
+	    g_atomic_int_get (&pdf_document->annots_modified))
+		g_atomic_int_set (&pdf_document->replicas_stale, TRUE);
+	g_atomic_int_set (&pdf_document->forms_modified, FALSE);
+	g_atomic_int_set (&pdf_document->annots_modified, FALSE);
+}
+
 /* EvDocument */
 static gboolean
 pdf_document_save (EvDocument  *document,
@@ -250,11 +737,15 @@ pdf_document_save (EvDocument  *document,
 	gboolean retval;
 	GError *poppler_error = NULL;
 
+	/* Poppler would write the same bytes, share the blocks of the
+	 * file instead where the file system can */
+	if (pdf_document_matches_file (pdf_document))
+		return ev_file_clone_uri (ev_document_get_uri (document), uri, error);
+
 	retval = poppler_document_save (pdf_document->document,
 					uri, &poppler_error);
 	if (retval) {
-		pdf_document->forms_modified = FALSE;
-		pdf_document->annots_modified = FALSE;
+		pdf_document_mark_saved (pdf_document);
 		ev_document_set_modified (EV_DOCUMENT (document), FALSE);
 	} else {
 		convert_error (poppler_error, error);
@@ -263,6 +754,93 @@ pdf_document_save (EvDocument  *document,
 	return retval;
 }
 
+/* The update poppler writes is appended to the file the document was
+ * loaded from, so only the changed objects and a new xref hit the disk.
+ * Anything else, such as a file changed by someone else in the meantime
+ * or a document poppler has to rewrite, is left to pdf_document_save().
+ */
+static gboolean
+pdf_document_save_incremental (EvDocument  *document,
+			       const char  *uri,
+			       GError     **error)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (document);
+	GError      *poppler_error = NULL;
+	gchar       *filename;
+	gchar       *tmp_filename = NULL;
+	gchar       *tmp_uri;
+	goffset      size, update_size;
+	gint64       mtime;
+	gint         fd, tmp_fd;
+	gboolean     retval = FALSE;
+
+	filename = g_filename_from_uri (uri, NULL, NULL);
+	if (!filename ||
+	    pdf_document->file_size == 0 ||
+	    g_strcmp0 (uri, ev_document_get_uri (document)) != 0 ||
+	    !pdf_document_get_file_stamp (filename, &size, &mtime) ||
+	    size != pdf_document->file_size ||
+	    mtime != pdf_document->file_mtime) {
+		g_free (filename);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "The document can't be updated in place");
+		return FALSE;
+	}
+
+	tmp_fd = ev_mkstemp ("saveupdate.XXXXXX", &tmp_filename, error);
+	if (tmp_fd == -1) {
+		g_free (filename);
+		return FALSE;
+	}
+
+	tmp_uri = g_filename_to_uri (tmp_filename, NULL, error);
+	if (!tmp_uri)
+		goto out;
+
+	if (!poppler_document_save (pdf_document->document, tmp_uri, &poppler_error)) {
+		convert_error (poppler_error, error);
+		goto out;
+	}
+
+	update_size = lseek (tmp_fd, 0, SEEK_END);
+	fd = g_open (filename, O_RDWR | O_CLOEXEC, 0);
+	if (fd == -1) {
+		int errsv = errno;
+
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "%s", g_strerror (errsv));
+		goto out;
+	}
+
+	if (update_size <= size || !pdf_update_follows_file (fd, tmp_fd, size)) {
+		close (fd);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "The document has to be rewritten");
+		goto out;
+	}
+
+	retval = pdf_append_update (fd, tmp_fd, size, update_size);
+	close (fd);
+	if (!retval) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     _("Failed to save document “%s”"), filename);
+		goto out;
+	}
+
+	pdf_document_mark_saved (pdf_document);
+	ev_document_set_modified (document, FALSE);
+	pdf_document_stamp_file (pdf_document, uri);
+
+ out:
+	close (tmp_fd);
+	g_unlink (tmp_filename);
+	g_free (tmp_filename);
+	g_free (tmp_uri);
+	g_free (filename);
+
+	return retval;
+}
+
 static gboolean
 pdf_document_load (EvDocument   *document,
 		   const char   *uri,
@@ -271,14 +849,18 @@ pdf_document_load (EvDocument   *document,
 	GError *poppler_error = NULL;
 	PdfDocument *pdf_document = PDF_DOCUMENT (document);
 
-	pdf_document->document =
-		poppler_document_new_from_file (uri, pdf_document->password, &poppler_error);
+	pdf_document_map_file (pdf_document, uri);
+	pdf_document->document = pdf_document_open (pdf_document, uri, &poppler_error);
 
 	if (pdf_document->document == NULL) {
+		g_clear_pointer (&pdf_document->mapped_file, g_mapped_file_unref);
 		convert_error (poppler_error, error);
 		return FALSE;
 	}
 
+	pdf_document_setup_replicas (pdf_document, uri);
+	pdf_document_stamp_file (pdf_document, uri);
+
 	return TRUE;
 }
 
@@ -292,6 +874,7 @@ pdf_document_load_stream (EvDocument          *document,
         GError *err = NULL;
         PdfDocument *pdf_document = PDF_DOCUMENT (document);
 
+        g_clear_pointer (&pdf_document->mapped_file, g_mapped_file_unref);
         pdf_document->document =
                 poppler_document_new_from_stream (stream, -1,
                                                   pdf_document->password,
@@ -315,18 +898,36 @@ pdf_document_load_gfile (EvDocument          *document,
 {
         GError *err = NULL;
         PdfDocument *pdf_document = PDF_DOCUMENT (document);
-
-        pdf_document->document =
-                poppler_document_new_from_gfile (file,
-                                                 pdf_document->password,
-                                                 cancellable,
-                                                 &err);
+        gchar *uri = g_file_get_uri (file);
+
+        if (g_file_is_native (file))
+                pdf_document_map_file (pdf_document, uri);
+        else
+                g_clear_pointer (&pdf_document->mapped_file, g_mapped_file_unref);
+        g_free (uri);
+
+        if (pdf_document->mapped_file)
+                pdf_document->document = pdf_document_open (pdf_document, NULL, &err);
+        else
+                pdf_document->document =
+                        poppler_document_new_from_gfile (file,
+                                                         pdf_document->password,
+                                                         cancellable,
+                                                         &err);
 
         if (pdf_document->document == NULL) {
+                g_clear_pointer (&pdf_document->mapped_file, g_mapped_file_unref);
                 convert_error (err, error);
                 return FALSE;
         }
 
+        if (g_file_is_native (file)) {
+                gchar *uri = g_file_get_uri (file);
+
+                pdf_document_setup_replicas (pdf_document, uri);
+                g_free (uri);
+        }
+
         return TRUE;
 }
 
@@ -378,6 +979,42 @@ pdf_document_get_page_label (EvDocument *document,
 	return label;
 }
 
+/* Clips @cr, in points of the page, to the areas of the annotations
+ * and form fields of @page. Returns FALSE if it has none.
+ */
+static gboolean
+pdf_page_clip_annots (PopplerPage *page,
+		      cairo_t     *cr)
+{
+	GList  *annots, *l;
+	double  height;
+
+	annots = poppler_page_get_annot_mapping (page);
+	if (!annots)
+		return FALSE;
+
+	poppler_page_get_size (page, NULL, &height);
+	for (l = annots; l; l = l->next) {
+		PopplerAnnotMapping *mapping = (PopplerAnnotMapping *) l->data;
+		PopplerRectangle    *area = &mapping->area;
+
+		/* With a point of margin for antialiased borders */
+		cairo_rectangle (cr,
+				 area->x1 - 1, height - area->y2 - 1,
+				 area->x2 - area->x1 + 2, area->y2 - area->y1 + 2);
+
+		/* Text annotations are drawn as 24x24 icons */
+		if (poppler_annot_get_annot_type (mapping->annot) == POPPLER_ANNOT_TEXT)
+			cairo_rectangle (cr, area->x1, height - area->y2, 24, 24);
+	}
+	poppler_page_free_annot_mapping (annots);
+
+	cairo_set_fill_rule (cr, CAIRO_FILL_RULE_WINDING);
+	cairo_clip (cr);
+
+	return TRUE;
+}
+
 static cairo_surface_t *
 pdf_page_render (PopplerPage     *page,
 		 gint             width,
@@ -386,12 +1023,29 @@ pdf_page_render (PopplerPage     *page,
 {
 	cairo_surface_t *surface;
 	cairo_t *cr;
+	cairo_rectangle_int_t area;
 	double page_width, page_height;
 	double xscale, yscale;
-
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-					      width, height);
-	cr = cairo_create (surface);
+	EvRenderLayer layer = ev_render_context_get_layer (rc);
+	cairo_format_t format;
+
+	/* Pages are rendered on white paper to an opaque surface,
+	 * which cairo can copy instead of blending when it's drawn.
+	 * Annotations are drawn on patches of paper elsewhere
+	 * transparent, to go over the content. */
+	format = layer == EV_RENDER_LAYER_ANNOTATIONS ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+	if (ev_render_context_get_area (rc, &area)) {
+		surface = ev_surface_pool_create_surface (format, area.width, area.height);
+		cr = cairo_create (surface);
+		cairo_translate (cr, -area.x, -area.y);
+	} else {
+		surface = ev_surface_pool_create_surface (format, width, height);
+		cr = cairo_create (surface);
+	}
+	if (layer != EV_RENDER_LAYER_ANNOTATIONS) {
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_paint (cr);
+	}
 
 	switch (rc->rotation) {
 	        case 90:
@@ -413,11 +1067,31 @@ pdf_page_render (PopplerPage     *page,
 	ev_render_context_compute_scales (rc, page_width, page_height, &xscale, &yscale);
 	cairo_scale (cr, xscale, yscale);
 	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
-	poppler_page_render (page, cr);
+	if (layer == EV_RENDER_LAYER_ANNOTATIONS) {
+		/* Poppler can't render the annotations alone, the
+		 * content under them is rendered again with them */
+		if (!pdf_page_clip_annots (page, cr)) {
+			cairo_destroy (cr);
+			ev_surface_pool_recycle (surface);
 
-	cairo_set_operator (cr, CAIRO_OPERATOR_DEST_OVER);
-	cairo_set_source_rgb (cr, 1., 1., 1.);
-	cairo_paint (cr);
+			return NULL;
+		}
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_paint (cr);
+		poppler_page_render (page, cr);
+	} else {
+		/* Drafts are rendered as the page is shown, only
+		 * with a faster antialiasing */
+		if (ev_render_context_get_draft (rc))
+			cairo_set_antialias (cr, CAIRO_ANTIALIAS_FAST);
+
+		/* Rendering for printing the document only
+		 * leaves the annotations and forms out */
+		if (layer == EV_RENDER_LAYER_CONTENT)
+			poppler_page_render_for_printing_with_options (page, cr, POPPLER_PRINT_DOCUMENT);
+		else
+			poppler_page_render (page, cr);
+	}
 
 	cairo_destroy (cr);
 
@@ -428,87 +1102,37 @@ static cairo_surface_t *
 pdf_document_render (EvDocument      *document,
 		     EvRenderContext *rc)
 {
+	PdfDocument *pdf_document = PDF_DOCUMENT (document);
+	PopplerDocument *replica;
 	PopplerPage *poppler_page;
+	cairo_surface_t *surface;
 	double width_points, height_points;
 	gint width, height;
+	gboolean locked;
 
-	poppler_page = POPPLER_PAGE (rc->page->backend_page);
+	poppler_page = pdf_document_acquire_page (pdf_document, rc->page,
+						  &replica, &locked);
+
+	/* Poppler can't interrupt a page render, so give up
+	 * before it starts if we were cancelled while waiting
+	 * for a replica or the lock */
+	if (ev_render_context_is_cancelled (rc)) {
+		pdf_document_release_page (pdf_document, poppler_page,
+					   replica, locked);
+		return NULL;
+	}
 
 	poppler_page_get_size (poppler_page,
 			       &width_points, &height_points);
 
 	ev_render_context_compute_transformed_size (rc, width_points, height_points,
 						    &width, &height);
-	return pdf_page_render (poppler_page,
-				width, height, rc);
-}
-
-static GdkPixbuf *
-make_thumbnail_for_page (PopplerPage     *poppler_page,
-			 EvRenderContext *rc,
-			 gint             width,
-			 gint             height)
-{
-	GdkPixbuf *pixbuf;
-	cairo_surface_t *surface;
-
-	ev_document_fc_mutex_lock ();
-	surface = pdf_page_render (poppler_page, width, height, rc);
-	ev_document_fc_mutex_unlock ();
-	
-	pixbuf = ev_document_misc_pixbuf_from_surface (surface);
-	cairo_surface_destroy (surface);
-
-	return pixbuf;
-}
+	surface = pdf_page_render (poppler_page,
+				   width, height, rc);
+	pdf_document_release_page (pdf_document, poppler_page,
+				   replica, locked);
 
-static GdkPixbuf *
-pdf_document_get_thumbnail (EvDocument      *document,
-			    EvRenderContext *rc)
-{
-	PopplerPage *poppler_page;
-	cairo_surface_t *surface;
-	GdkPixbuf *pixbuf = NULL;
-	double page_width, page_height;
-	gint width, height;
-
-	poppler_page = POPPLER_PAGE (rc->page->backend_page);
-
-	poppler_page_get_size (poppler_page,
-			       &page_width, &page_height);
-
-	ev_render_context_compute_transformed_size (rc, page_width, page_height,
-						    &width, &height);
-
-	surface = poppler_page_get_thumbnail (poppler_page);
-	if (surface) {
-		pixbuf = ev_document_misc_pixbuf_from_surface (surface);
-		cairo_surface_destroy (surface);
-	}
-
-	if (pixbuf != NULL) {
-		int thumb_width = (rc->rotation == 90 || rc->rotation == 270) ?
-			gdk_pixbuf_get_height (pixbuf) :
-			gdk_pixbuf_get_width (pixbuf);
-
-		if (thumb_width == width) {
-			GdkPixbuf *rotated_pixbuf;
-
-			rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf,
-								   (GdkPixbufRotation) (360 - rc->rotation));
-			g_object_unref (pixbuf);
-			pixbuf = rotated_pixbuf;
-		} else {
-			/* The provided thumbnail has a different size */
-			g_object_unref (pixbuf);
-			pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
-		}
-	} else {
-		/* There is no provided thumbnail. We need to make one. */
-		pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
-	}
-
-	return pixbuf;
+	return surface;
 }
 
 static cairo_surface_t *
@@ -536,7 +1160,9 @@ pdf_document_get_thumbnail_surface (EvDocument      *document,
 			cairo_image_surface_get_height (surface) :
 			cairo_image_surface_get_width (surface);
 
-		if (surface_width == width) {
+		/* Scaling an embedded thumbnail of about the same
+		 * size is much cheaper than rendering the page */
+		if (ABS (surface_width - width) <= width / 4) {
 			cairo_surface_t *rotated_surface;
 
 			rotated_surface = ev_document_misc_surface_rotate_and_scale (surface, width, height, rc->rotation);
@@ -907,62 +1533,287 @@ pdf_document_get_info (EvDocument *document)
 	if (view_prefs & POPPLER_VIEWER_PREFERENCES_DISPLAY_DOC_TITLE) {
 		info->ui_hints |= EV_DOCUMENT_UI_HINT_DISPLAY_DOC_TITLE;
 	}
-	if (view_prefs & POPPLER_VIEWER_PREFERENCES_DIRECTION_RTL) {
-		info->ui_hints |=  EV_DOCUMENT_UI_HINT_DIRECTION_RTL;
+	if (view_prefs & POPPLER_VIEWER_PREFERENCES_DIRECTION_RTL) {
+		info->ui_hints |=  EV_DOCUMENT_UI_HINT_DIRECTION_RTL;
+	}
+
+	info->permissions = 0;
+	if (permissions & POPPLER_PERMISSIONS_OK_TO_PRINT) {
+		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_PRINT;
+	}
+	if (permissions & POPPLER_PERMISSIONS_OK_TO_MODIFY) {
+		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_MODIFY;
+	}
+	if (permissions & POPPLER_PERMISSIONS_OK_TO_COPY) {
+		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_COPY;
+	}
+	if (permissions & POPPLER_PERMISSIONS_OK_TO_ADD_NOTES) {
+		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_ADD_NOTES;
+	}
+
+	if (ev_document_security_has_document_security (EV_DOCUMENT_SECURITY (document))) {
+		/* translators: this is the document security state */
+		info->security = g_strdup (_("Yes"));
+	} else {
+		/* translators: this is the document security state */
+		info->security = g_strdup (_("No"));
+	}
+
+	info->linearized = linearized ? g_strdup (_("Yes")) : g_strdup (_("No"));
+
+	return info;
+}
+
+static gboolean
+pdf_document_get_backend_info (EvDocument *document, EvDocumentBackendInfo *info)
+{
+	PopplerBackend backend;
+
+	backend = poppler_get_backend ();
+	switch (backend) {
+		case POPPLER_BACKEND_CAIRO:
+			info->name = "poppler/cairo";
+			break;
+		case POPPLER_BACKEND_SPLASH:
+			info->name = "poppler/splash";
+			break;
+		default:
+			info->name = "poppler/unknown";
+			break;
+	}
+
+	info->version = poppler_get_version ();
+
+	return TRUE;
+}
+
+/* The ID of the trailer, its second part changes when the document
+ * is modified. Documents that don't have one are identified by their
+ * contents.
+ */
+static gchar *
+pdf_document_get_fingerprint (EvDocument *document)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (document);
+	gchar       *permanent_id = NULL;
+	gchar       *update_id = NULL;
+	GString     *fingerprint;
+	gint         i;
+
+	if (!poppler_document_get_id (pdf_document->document, &permanent_id, &update_id))
+		return NULL;
+
+	/* IDs are 32 bytes, not nul terminated */
+	fingerprint = g_string_sized_new (129);
+	for (i = 0; i < 32; i++)
+		g_string_append_printf (fingerprint, "%02x", (guchar) permanent_id[i]);
+	for (i = 0; i < 32; i++)
+		g_string_append_printf (fingerprint, "%02x", (guchar) update_id[i]);
+	g_string_append_printf (fingerprint, "-%d",
+				poppler_document_get_n_pages (pdf_document->document));
+
+	g_free (permanent_id);
+	g_free (update_id);
+
+	return g_string_free (fingerprint, FALSE);
+}
+
+static void
+checksum_update_rectangle (GChecksum        *sum,
+			   PopplerRectangle *area)
+{
+	g_checksum_update (sum, (const guchar *) area, sizeof (PopplerRectangle));
+}
+
+/* Pages drawing with more objects than this are not compared */
+#define PDF_DIGEST_MAX_OBJECTS 4096
+
+/* Adds the bytes of the file for the objects of @page to @sum: the page
+ * object, its resources, which may be inherited, and every object they
+ * refer to, content streams, fonts, images, forms and annotations
+ * included. The page tree is left out, so the other pages are too.
+ */
+static gboolean
+pdf_checksum_update_page_objects (GChecksum  *sum,
+				  PdfObjects *objects,
+				  guint       page)
+{
+	PdfObject    *page_object;
+	const guchar *value, *value_end;
+	GArray       *pending;
+	GHashTable   *visited;
+	gboolean      retval;
+
+	page_object = pdf_objects_get_page (objects, page);
+	if (!page_object)
+		return FALSE;
+
+	g_checksum_update (sum, page_object->start, page_object->end - page_object->start);
+	pending = g_array_new (FALSE, FALSE, sizeof (guint));
+	retval = pdf_value_collect_refs (page_object->start, page_object->end, pending);
+	if (retval && pdf_objects_get_page_attribute (objects, page, "Resources", &value, &value_end)) {
+		g_checksum_update (sum, value, value_end - value);
+		retval = pdf_value_collect_refs (value, value_end, pending);
+	}
+
+	visited = g_hash_table_new (NULL, NULL);
+	while (retval && pending->len > 0) {
+		PdfObject *object;
+		guint      number;
+
+		number = g_array_index (pending, guint, pending->len - 1);
+		g_array_set_size (pending, pending->len - 1);
+		if (g_hash_table_contains (visited, GUINT_TO_POINTER (number)))
+			continue;
+
+		if (g_hash_table_size (visited) >= PDF_DIGEST_MAX_OBJECTS) {
+			retval = FALSE;
+			break;
+		}
+		g_hash_table_add (visited, GUINT_TO_POINTER (number));
+
+		object = pdf_objects_get_object (objects, number);
+		if (!object || object->page_node)
+			continue;
+
+		g_checksum_update (sum, (const guchar *) &number, sizeof (guint));
+		g_checksum_update (sum, object->start, object->end - object->start);
+		if (object->stream)
+			g_checksum_update (sum, object->stream, object->stream_length);
+		retval = pdf_value_collect_refs (object->start, object->end, pending);
+	}
+	g_hash_table_destroy (visited);
+	g_array_free (pending, TRUE);
+
+	return retval;
+}
+
+/* Poppler doesn't give access to the content streams of the page, they
+ * are read from the file, with the objects they use, see
+ * pdf_checksum_update_page_objects(). There is no digest when the file
+ * can't be read that way, or changed since poppler read it, so that
+ * the page is rendered again. What poppler tells about what's drawn in
+ * the page is added too: its size, text, images, links, forms and
+ * annotations, which may have been changed without being saved.
+ */
+static gchar *
+pdf_document_get_page_digest (EvDocument *document,
+			      EvPage     *page)
+{
+	PdfDocument      *pdf_document = PDF_DOCUMENT (document);
+	PopplerPage      *poppler_page = POPPLER_PAGE (page->backend_page);
+	PdfObjects       *objects;
+	GChecksum        *sum;
+	gdouble           size[2];
+	gchar            *text;
+	PopplerRectangle *areas = NULL;
+	guint             n_areas = 0;
+	GList            *list, *l;
+	gchar            *digest;
+	gboolean          owned;
+	gboolean          hashed;
+
+	objects = pdf_document_get_objects (pdf_document, &owned);
+	if (!objects)
+		return NULL;
+
+	sum = g_checksum_new (G_CHECKSUM_SHA1);
+	hashed = pdf_checksum_update_page_objects (sum, objects, page->index);
+	if (owned)
+		pdf_objects_free (objects);
+	if (!hashed) {
+		g_checksum_free (sum);
+		return NULL;
+	}
+
+	poppler_page_get_size (poppler_page, &size[0], &size[1]);
+	g_checksum_update (sum, (const guchar *) size, sizeof (size));
+
+	text = poppler_page_get_text (poppler_page);
+	if (text) {
+		g_checksum_update (sum, (const guchar *) text, -1);
+		g_free (text);
 	}
 
-	info->permissions = 0;
-	if (permissions & POPPLER_PERMISSIONS_OK_TO_PRINT) {
-		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_PRINT;
+	if (poppler_page_get_text_layout (poppler_page, &areas, &n_areas)) {
+		g_checksum_update (sum, (const guchar *) areas, n_areas * sizeof (PopplerRectangle));
+		g_free (areas);
 	}
-	if (permissions & POPPLER_PERMISSIONS_OK_TO_MODIFY) {
-		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_MODIFY;
+
+	list = poppler_page_get_image_mapping (poppler_page);
+	for (l = list; l; l = g_list_next (l)) {
+		PopplerImageMapping *mapping = (PopplerImageMapping *) l->data;
+
+		checksum_update_rectangle (sum, &mapping->area);
+		g_checksum_update (sum, (const guchar *) &mapping->image_id, sizeof (gint));
 	}
-	if (permissions & POPPLER_PERMISSIONS_OK_TO_COPY) {
-		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_COPY;
+	poppler_page_free_image_mapping (list);
+
+	list = poppler_page_get_link_mapping (poppler_page);
+	for (l = list; l; l = g_list_next (l)) {
+		PopplerLinkMapping *mapping = (PopplerLinkMapping *) l->data;
+
+		checksum_update_rectangle (sum, &mapping->area);
+		if (mapping->action)
+			g_checksum_update (sum, (const guchar *) &mapping->action->type,
+					   sizeof (PopplerActionType));
 	}
-	if (permissions & POPPLER_PERMISSIONS_OK_TO_ADD_NOTES) {
-		info->permissions |= EV_DOCUMENT_PERMISSIONS_OK_TO_ADD_NOTES;
+	poppler_page_free_link_mapping (list);
+
+	list = poppler_page_get_form_field_mapping (poppler_page);
+	for (l = list; l; l = g_list_next (l)) {
+		PopplerFormFieldMapping *mapping = (PopplerFormFieldMapping *) l->data;
+		gint id = poppler_form_field_get_id (mapping->field);
+
+		checksum_update_rectangle (sum, &mapping->area);
+		g_checksum_update (sum, (const guchar *) &id, sizeof (gint));
 	}
+	poppler_page_free_form_field_mapping (list);
 
-	if (ev_document_security_has_document_security (EV_DOCUMENT_SECURITY (document))) {
-		/* translators: this is the document security state */
-		info->security = g_strdup (_("Yes"));
-	} else {
-		/* translators: this is the document security state */
-		info->security = g_strdup (_("No"));
+	list = poppler_page_get_annot_mapping (poppler_page);
+	for (l = list; l; l = g_list_next (l)) {
+		PopplerAnnotMapping *mapping = (PopplerAnnotMapping *) l->data;
+		PopplerAnnotType type = poppler_annot_get_annot_type (mapping->annot);
+		gchar *contents;
+
+		checksum_update_rectangle (sum, &mapping->area);
+		g_checksum_update (sum, (const guchar *) &type, sizeof (PopplerAnnotType));
+		contents = poppler_annot_get_contents (mapping->annot);
+		if (contents) {
+			g_checksum_update (sum, (const guchar *) contents, -1);
+			g_free (contents);
+		}
 	}
+	poppler_page_free_annot_mapping (list);
 
-	info->linearized = linearized ? g_strdup (_("Yes")) : g_strdup (_("No"));
+	digest = g_strdup (g_checksum_get_string (sum));
+	g_checksum_free (sum);
 
-	return info;
+	return digest;
 }
 
 static gboolean
-pdf_document_get_backend_info (EvDocument *document, EvDocumentBackendInfo *info)
+pdf_document_support_synctex (EvDocument *document)
 {
-	PopplerBackend backend;
-
-	backend = poppler_get_backend ();
-	switch (backend) {
-		case POPPLER_BACKEND_CAIRO:
-			info->name = "poppler/cairo";
-			break;
-		case POPPLER_BACKEND_SPLASH:
-			info->name = "poppler/splash";
-			break;
-		default:
-			info->name = "poppler/unknown";
-			break;
-	}
+	return TRUE;
+}
 
-	info->version = poppler_get_version ();
+static gboolean
+pdf_document_is_thread_safe (EvDocument *document)
+{
+	/* Only rendering and searching are done on replicas,
+	 * everything else still requires the document lock */
+	return pdf_document_replicas_usable (PDF_DOCUMENT (document));
+}
 
+static gboolean
+pdf_document_can_render_area (EvDocument *document)
+{
 	return TRUE;
 }
 
 static gboolean
-pdf_document_support_synctex (EvDocument *document)
+pdf_document_can_render_layers (EvDocument *document)
 {
 	return TRUE;
 }
@@ -974,8 +1825,10 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 
 	g_object_class->dispose = pdf_document_dispose;
+	g_object_class->finalize = pdf_document_finalize;
 
 	ev_document_class->save = pdf_document_save;
+	ev_document_class->save_incremental = pdf_document_save_incremental;
 	ev_document_class->load = pdf_document_load;
         ev_document_class->load_stream = pdf_document_load_stream;
         ev_document_class->load_gfile = pdf_document_load_gfile;
@@ -984,11 +1837,15 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	ev_document_class->get_page_size = pdf_document_get_page_size;
 	ev_document_class->get_page_label = pdf_document_get_page_label;
 	ev_document_class->render = pdf_document_render;
-	ev_document_class->get_thumbnail = pdf_document_get_thumbnail;
 	ev_document_class->get_thumbnail_surface = pdf_document_get_thumbnail_surface;
 	ev_document_class->get_info = pdf_document_get_info;
 	ev_document_class->get_backend_info = pdf_document_get_backend_info;
+	ev_document_class->get_fingerprint = pdf_document_get_fingerprint;
+	ev_document_class->get_page_digest = pdf_document_get_page_digest;
 	ev_document_class->support_synctex = pdf_document_support_synctex;
+	ev_document_class->is_thread_safe = pdf_document_is_thread_safe;
+	ev_document_class->can_render_area = pdf_document_can_render_area;
+	ev_document_class->can_render_layers = pdf_document_can_render_layers;
 }
 
 /* EvDocumentSecurity */
@@ -1249,6 +2106,80 @@ pdf_document_links_has_document_links (EvDocumentLinks *document_links)
 	return TRUE;
 }
 
+static void
+pdf_document_dest_free (gpointer dest)
+{
+	if (dest)
+		poppler_dest_free ((PopplerDest *)dest);
+}
+
+/* Looking up a named destination walks the name tree of the document,
+ * and documents generated by hyperref can have a destination for every
+ * section, figure and equation that are looked up again and again when
+ * building the outline or following links. Lookups are cached, the
+ * missing destinations too. Returns a copy of the destination.
+ */
+static PopplerDest *
+pdf_document_find_dest (PdfDocument *pdf_document,
+			const gchar *name)
+{
+	PopplerDest *dest;
+	gpointer     value;
+
+	g_mutex_lock (&pdf_document->dests_mutex);
+
+	if (!pdf_document->dests)
+		pdf_document->dests = g_hash_table_new_full (g_str_hash, g_str_equal,
+							     g_free, pdf_document_dest_free);
+
+	if (!g_hash_table_lookup_extended (pdf_document->dests, name, NULL, &value)) {
+		value = poppler_document_find_dest (pdf_document->document, name);
+		g_hash_table_insert (pdf_document->dests, g_strdup (name), value);
+	}
+	dest = value ? poppler_dest_copy ((PopplerDest *)value) : NULL;
+
+	g_mutex_unlock (&pdf_document->dests_mutex);
+
+	return dest;
+}
+
+/* Destinations are relative to the bottom of the page */
+static gdouble
+pdf_document_get_page_height (PdfDocument *pdf_document,
+			      gint         page_index)
+{
+	PopplerPage *poppler_page;
+	gint         n_pages;
+	gdouble      height = 0;
+
+	n_pages = poppler_document_get_n_pages (pdf_document->document);
+	if (n_pages <= 0)
+		return 0;
+	page_index = CLAMP (page_index, 0, n_pages - 1);
+
+	g_mutex_lock (&pdf_document->dests_mutex);
+
+	if (!pdf_document->page_heights) {
+		gint i;
+
+		pdf_document->page_heights = g_new (gdouble, n_pages);
+		for (i = 0; i < n_pages; i++)
+			pdf_document->page_heights[i] = -1;
+	}
+
+	if (pdf_document->page_heights[page_index] < 0) {
+		poppler_page = poppler_document_get_page (pdf_document->document, page_index);
+		poppler_page_get_size (poppler_page, NULL, &height);
+		g_object_unref (poppler_page);
+		pdf_document->page_heights[page_index] = height;
+	}
+	height = pdf_document->page_heights[page_index];
+
+	g_mutex_unlock (&pdf_document->dests_mutex);
+
+	return height;
+}
+
 static EvLinkDest *
 ev_link_dest_from_dest (PdfDocument *pdf_document,
 			PopplerDest *dest)
@@ -1260,12 +2191,9 @@ ev_link_dest_from_dest (PdfDocument *pdf_document,
 
 	switch (dest->type) {
 	        case POPPLER_DEST_XYZ: {
-			PopplerPage *poppler_page;
 			double height;
 
-			poppler_page = poppler_document_get_page (pdf_document->document,
-								  MAX (0, dest->page_num - 1));
-			poppler_page_get_size (poppler_page, NULL, &height);
+			height = pdf_document_get_page_height (pdf_document, dest->page_num - 1);
 			ev_dest = ev_link_dest_new_xyz (dest->page_num - 1,
 							dest->left,
 							height - MIN (height, dest->top),
@@ -1273,7 +2201,6 @@ ev_link_dest_from_dest (PdfDocument *pdf_document,
 							dest->change_left,
 							dest->change_top,
 							dest->change_zoom);
-			g_object_unref (poppler_page);
 		}
 			break;
 	        case POPPLER_DEST_FITB:
@@ -1282,16 +2209,12 @@ ev_link_dest_from_dest (PdfDocument *pdf_document,
 			break;
 		case POPPLER_DEST_FITBH:
 	        case POPPLER_DEST_FITH: {
-			PopplerPage *poppler_page;
 			double height;
 
-			poppler_page = poppler_document_get_page (pdf_document->document,
-								  MAX (0, dest->page_num - 1));
-			poppler_page_get_size (poppler_page, NULL, &height);
+			height = pdf_document_get_page_height (pdf_document, dest->page_num - 1);
 			ev_dest = ev_link_dest_new_fith (dest->page_num - 1,
 							 height - MIN (height, dest->top),
 							 dest->change_top);
-			g_object_unref (poppler_page);
 		}
 			break;
 		case POPPLER_DEST_FITBV:
@@ -1301,12 +2224,9 @@ ev_link_dest_from_dest (PdfDocument *pdf_document,
 							 dest->change_left);
 			break;
 	        case POPPLER_DEST_FITR: {
-			PopplerPage *poppler_page;
 			double height;
 
-			poppler_page = poppler_document_get_page (pdf_document->document,
-								  MAX (0, dest->page_num - 1));
-			poppler_page_get_size (poppler_page, NULL, &height);
+			height = pdf_document_get_page_height (pdf_document, dest->page_num - 1);
 			/* for evince we ensure that bottom <= top and left <= right */
 			/* also evince has its origin in the top left, so we invert the y axis. */
 			ev_dest = ev_link_dest_new_fitr (dest->page_num - 1,
@@ -1314,7 +2234,6 @@ ev_link_dest_from_dest (PdfDocument *pdf_document,
 							 height - MIN (height, MIN (dest->bottom, dest->top)),
 							 MAX (dest->left, dest->right),
 							 height - MIN (height, MAX (dest->bottom, dest->top)));
-			g_object_unref (poppler_page);
 		}
 			break;
 	        case POPPLER_DEST_NAMED:
@@ -1445,6 +2364,35 @@ ev_link_from_action (PdfDocument   *pdf_document,
 	return link;	
 }
 
+/* The children of closed items are only added to the links model when
+ * the item is expanded, in the meantime there's a child without a link
+ * and the index iter of the children is kept in a table, by path. The
+ * paths of the other items don't change when the children are added.
+ */
+#define PDF_LINKS_CHILDREN_KEY "pdf-document-links-children"
+
+static void
+add_links_children_placeholder (GtkTreeModel     *model,
+				GtkTreeIter      *parent,
+				PopplerIndexIter *children)
+{
+	GHashTable *table;
+	GtkTreeIter placeholder;
+
+	table = (GHashTable *) g_object_get_data (G_OBJECT (model), PDF_LINKS_CHILDREN_KEY);
+	if (!table) {
+		table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					       (GDestroyNotify) poppler_index_iter_free);
+		g_object_set_data_full (G_OBJECT (model), PDF_LINKS_CHILDREN_KEY, table,
+					(GDestroyNotify) g_hash_table_destroy);
+	}
+
+	gtk_tree_store_append (GTK_TREE_STORE (model), &placeholder, parent);
+	g_hash_table_insert (table,
+			     gtk_tree_model_get_string_from_iter (model, parent),
+			     children);
+}
+
 static void
 build_tree (PdfDocument      *pdf_document,
 	    GtkTreeModel     *model,
@@ -1488,9 +2436,12 @@ build_tree (PdfDocument      *pdf_document,
 		g_object_unref (link);
 		
 		child = poppler_index_iter_get_child (iter);
-		if (child)
+		if (child && !expand) {
+			add_links_children_placeholder (model, &tree_iter, child);
+		} else if (child) {
 			build_tree (pdf_document, model, &tree_iter, child);
-		poppler_index_iter_free (child);
+			poppler_index_iter_free (child);
+		}
 		poppler_action_free (action);
 		
 	} while (poppler_index_iter_next (iter));
@@ -1567,8 +2518,7 @@ pdf_document_links_find_link_dest (EvDocumentLinks  *document_links,
 	EvLinkDest *ev_dest = NULL;
 
 	pdf_document = PDF_DOCUMENT (document_links);
-	dest = poppler_document_find_dest (pdf_document->document,
-					   link_name);
+	dest = pdf_document_find_dest (pdf_document, link_name);
 	if (dest) {
 		ev_dest = ev_link_dest_from_dest (pdf_document, dest);
 		poppler_dest_free (dest);
@@ -1586,8 +2536,7 @@ pdf_document_links_find_link_page (EvDocumentLinks  *document_links,
 	gint         retval = -1;
 
 	pdf_document = PDF_DOCUMENT (document_links);
-	dest = poppler_document_find_dest (pdf_document->document,
-					   link_name);
+	dest = pdf_document_find_dest (pdf_document, link_name);
 	if (dest) {
 		retval = dest->page_num - 1;
 		poppler_dest_free (dest);
@@ -1596,6 +2545,36 @@ pdf_document_links_find_link_page (EvDocumentLinks  *document_links,
 	return retval;
 }
 
+static void
+pdf_document_links_load_links_children (EvDocumentLinks *document_links,
+					GtkTreeModel    *model,
+					GtkTreeIter     *parent)
+{
+	PdfDocument      *pdf_document = PDF_DOCUMENT (document_links);
+	GHashTable       *table;
+	PopplerIndexIter *children;
+	GtkTreeIter       placeholder;
+	gchar            *path;
+
+	table = (GHashTable *) g_object_get_data (G_OBJECT (model), PDF_LINKS_CHILDREN_KEY);
+	if (!table)
+		return;
+
+	path = gtk_tree_model_get_string_from_iter (model, parent);
+	children = (PopplerIndexIter *) g_hash_table_lookup (table, path);
+	if (!children) {
+		g_free (path);
+		return;
+	}
+
+	if (gtk_tree_model_iter_children (model, &placeholder, parent))
+		gtk_tree_store_remove (GTK_TREE_STORE (model), &placeholder);
+	build_tree (pdf_document, model, parent, children);
+
+	g_hash_table_remove (table, path);
+	g_free (path);
+}
+
 static void
 pdf_document_document_links_iface_init (EvDocumentLinksInterface *iface)
 {
@@ -1604,6 +2583,7 @@ pdf_document_document_links_iface_init (EvDocumentLinksInterface *iface)
 	iface->get_links = pdf_document_links_get_links;
 	iface->find_link_dest = pdf_document_links_find_link_dest;
 	iface->find_link_page = pdf_document_links_find_link_page;
+	iface->load_links_children = pdf_document_links_load_links_children;
 }
 
 static EvMappingList *
@@ -1664,11 +2644,150 @@ pdf_document_images_get_image (EvDocumentImages *document_images,
 	return retval;
 }
 
+/* Maps the file for a while, when it hasn't changed since poppler read
+ * it, for the documents whose file isn't kept mapped */
+static GMappedFile *
+pdf_document_map_unchanged_file (PdfDocument *pdf_document)
+{
+	GMappedFile *mapped_file;
+	gchar       *filename;
+	goffset      size;
+	gint64       mtime;
+
+	if (pdf_document->file_size == 0)
+		return NULL;
+
+	filename = g_filename_from_uri (ev_document_get_uri (EV_DOCUMENT (pdf_document)), NULL, NULL);
+	if (!filename)
+		return NULL;
+
+	if (!pdf_document_get_file_stamp (filename, &size, &mtime) ||
+	    size != pdf_document->file_size ||
+	    mtime != pdf_document->file_mtime) {
+		g_free (filename);
+		return NULL;
+	}
+
+	mapped_file = g_mapped_file_new (filename, FALSE, NULL);
+	g_free (filename);
+
+	return mapped_file;
+}
+
+/* The objects of the file, read from the mapped file, which is kept, or
+ * from the file mapped only for the caller when it hasn't changed since
+ * poppler read it. Free them with pdf_objects_free() if *owned is TRUE.
+ */
+static PdfObjects *
+pdf_document_get_objects (PdfDocument *pdf_document,
+			  gboolean    *owned)
+{
+	GMappedFile *mapped_file;
+	PdfObjects  *objects;
+
+	*owned = FALSE;
+	if (pdf_document->objects)
+		return pdf_document->objects;
+
+	if (pdf_document->mapped_file) {
+		pdf_document->objects = pdf_objects_new (pdf_document->mapped_file, NULL);
+		return pdf_document->objects;
+	}
+
+	mapped_file = pdf_document_map_unchanged_file (pdf_document);
+	if (!mapped_file)
+		return NULL;
+
+	objects = pdf_objects_new (mapped_file, NULL);
+	g_mapped_file_unref (mapped_file);
+	if (objects &&
+	    pdf_objects_get_n_pages (objects) != (guint) poppler_document_get_n_pages (pdf_document->document)) {
+		pdf_objects_free (objects);
+		return NULL;
+	}
+
+	*owned = TRUE;
+
+	return objects;
+}
+
+static GBytes *
+pdf_document_images_get_image_data (EvDocumentImages *document_images,
+				    EvImage          *image,
+				    gchar           **mime_type)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (document_images);
+	PopplerPage *poppler_page;
+	PdfObjects  *objects;
+	GList       *mapping_list, *list;
+	GArray      *sizes;
+	GBytes      *retval = NULL;
+	const gchar *type = NULL;
+	gboolean     owned;
+
+	poppler_page = poppler_document_get_page (pdf_document->document,
+						  ev_image_get_page (image));
+	if (!poppler_page)
+		return NULL;
+
+	/* The sizes poppler found for the images, to tell them apart */
+	sizes = g_array_new (FALSE, TRUE, sizeof (gdouble));
+	mapping_list = poppler_page_get_image_mapping (poppler_page);
+	for (list = mapping_list; list; list = list->next) {
+		PopplerImageMapping *image_mapping = (PopplerImageMapping *) list->data;
+		guint                index;
+
+		if (image_mapping->image_id < 0)
+			continue;
+
+		index = (guint) image_mapping->image_id * 2;
+		if (sizes->len < index + 2)
+			g_array_set_size (sizes, index + 2);
+		g_array_index (sizes, gdouble, index) = image_mapping->area.x2 - image_mapping->area.x1;
+		g_array_index (sizes, gdouble, index + 1) = image_mapping->area.y2 - image_mapping->area.y1;
+	}
+	poppler_page_free_image_mapping (mapping_list);
+	g_object_unref (poppler_page);
+
+	objects = pdf_document_get_objects (pdf_document, &owned);
+	if (objects) {
+		retval = pdf_image_data_get (objects,
+					     ev_image_get_page (image),
+					     ev_image_get_id (image),
+					     (const gdouble *) sizes->data,
+					     sizes->len / 2,
+					     &type);
+		/* The data keeps the file mapped, which is only safe
+		 * for as long as the document keeps it mapped anyway,
+		 * otherwise the file could be truncated while the data
+		 * is still used, like in the clipboard */
+		if (owned) {
+			if (retval) {
+				GBytes        *data = retval;
+				gconstpointer  bytes;
+				gsize          length;
+
+				bytes = g_bytes_get_data (data, &length);
+				retval = g_bytes_new (bytes, length);
+				g_bytes_unref (data);
+			}
+			pdf_objects_free (objects);
+		}
+	}
+	g_array_free (sizes, TRUE);
+
+	if (retval)
+		*mime_type = g_strdup (type);
+
+	return retval;
+}
+
 static void
 pdf_document_document_images_iface_init (EvDocumentImagesInterface *iface)
 {
 	iface->get_image_mapping = pdf_document_images_get_image_mapping;
 	iface->get_image = pdf_document_images_get_image;
+	iface->get_image_data = pdf_document_images_get_image_data;
 }
 
 static GList *
@@ -1677,26 +2796,34 @@ pdf_document_find_find_text_with_options (EvDocumentFind *document_find,
 					  const gchar    *text,
 					  EvFindOptions   options)
 {
+	PdfDocument *pdf_document = PDF_DOCUMENT (document_find);
+	PopplerDocument *replica;
 	GList *matches, *l;
 	PopplerPage *poppler_page;
 	gdouble height;
 	GList *retval = NULL;
 	guint find_flags = 0;
+	gboolean locked;
 
 	g_return_val_if_fail (POPPLER_IS_PAGE (page->backend_page), NULL);
 	g_return_val_if_fail (text != NULL, NULL);
 
-	poppler_page = POPPLER_PAGE (page->backend_page);
+	/* Searches run in parallel on replicas too, like renders */
+	poppler_page = pdf_document_acquire_page (pdf_document, page,
+						  &replica, &locked);
 
 	if (options & EV_FIND_CASE_SENSITIVE)
 		find_flags |= POPPLER_FIND_CASE_SENSITIVE;
 	if (options & EV_FIND_WHOLE_WORDS_ONLY)
 		find_flags |= POPPLER_FIND_WHOLE_WORDS_ONLY;
 	matches = poppler_page_find_text_with_options (poppler_page, text, (PopplerFindFlags)find_flags);
+	poppler_page_get_size (poppler_page, NULL, &height);
+	pdf_document_release_page (pdf_document, poppler_page,
+				   replica, locked);
+
 	if (!matches)
 		return NULL;
 
-	poppler_page_get_size (poppler_page, NULL, &height);
 	for (l = matches; l && l->data; l = g_list_next (l)) {
 		PopplerRectangle *rect = (PopplerRectangle *)l->data;
 		EvRectangle      *ev_rect;
@@ -1871,30 +2998,23 @@ pdf_document_file_exporter_begin_page (EvFileExporter *exporter)
 #endif /* HAVE_CAIRO_PRINT */
 }
 
+#ifdef HAVE_CAIRO_PRINT
+/* Sets up ctx->cr to draw a page of the given size in the next
+ * slot of the sheet. The caller must restore ctx->cr afterwards.
+ */
 static void
-pdf_document_file_exporter_do_page (EvFileExporter  *exporter,
-				    EvRenderContext *rc)
+pdf_print_context_place_page (PdfPrintContext *ctx,
+			      gdouble          page_width,
+			      gdouble          page_height)
 {
-	PdfDocument *pdf_document = PDF_DOCUMENT (exporter);
-	PdfPrintContext *ctx = pdf_document->print_ctx;
-	PopplerPage *poppler_page;
-#ifdef HAVE_CAIRO_PRINT
-	gdouble  page_width, page_height;
 	gint     x, y;
 	gboolean rotate;
 	gdouble  width, height;
 	gdouble  pwidth, pheight;
 	gdouble  xscale, yscale;
-#endif
 
-	g_return_if_fail (pdf_document->print_ctx != NULL);
-
-	poppler_page = POPPLER_PAGE (rc->page->backend_page);
-	
-#ifdef HAVE_CAIRO_PRINT
 	x = (ctx->pages_printed % ctx->pages_per_sheet) % ctx->pages_x;
 	y = (ctx->pages_printed % ctx->pages_per_sheet) / ctx->pages_x;
-	poppler_page_get_size (poppler_page, &page_width, &page_height);
 
 	if (page_width > page_height && page_width > ctx->paper_width) {
 		rotate = TRUE;
@@ -1947,35 +3067,124 @@ pdf_document_file_exporter_do_page (EvFileExporter  *exporter,
 		xscale = yscale = 1;
 	}
 
-	/* TODO: center */
+	/* TODO: center */
+
+	cairo_save (ctx->cr);
+	if (rotate) {
+		cairo_matrix_t matrix;
+		
+		cairo_translate (ctx->cr, (2 * y + 1) * pwidth, 0);
+		cairo_matrix_init (&matrix,
+				   0,  1,
+				   -1,  0,
+				   0,  0);
+		cairo_transform (ctx->cr, &matrix);
+	}
+	
+	cairo_translate (ctx->cr,
+			 x * (rotate ? pheight : pwidth),
+			 y * (rotate ? pwidth : pheight));
+	cairo_scale (ctx->cr, xscale, yscale);
+}
+#endif /* HAVE_CAIRO_PRINT */
+
+static void
+pdf_document_file_exporter_do_page (EvFileExporter  *exporter,
+				    EvRenderContext *rc)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (exporter);
+	PdfPrintContext *ctx = pdf_document->print_ctx;
+	PopplerPage *poppler_page;
+#ifdef HAVE_CAIRO_PRINT
+	gdouble  page_width, page_height;
+#endif
+
+	g_return_if_fail (pdf_document->print_ctx != NULL);
+
+	poppler_page = POPPLER_PAGE (rc->page->backend_page);
+	
+#ifdef HAVE_CAIRO_PRINT
+	poppler_page_get_size (poppler_page, &page_width, &page_height);
+	pdf_print_context_place_page (ctx, page_width, page_height);
+
+	poppler_page_render_for_printing (poppler_page, ctx->cr);
+
+	ctx->pages_printed++;
+			
+	cairo_restore (ctx->cr);
+#else /* HAVE_CAIRO_PRINT */
+	if (ctx->format == EV_FILE_FORMAT_PS)
+		poppler_page_render_to_ps (poppler_page, ctx->ps_file);
+#endif /* HAVE_CAIRO_PRINT */
+}
+
+#ifdef HAVE_CAIRO_PRINT
+/* Pages are recorded on a replica, so that several of them can be
+ * rendered at the same time while the export is going on, and then
+ * replayed in order into the export surface, which keeps them as
+ * vector output.
+ */
+static cairo_surface_t *
+pdf_document_file_exporter_render_page (EvFileExporter  *exporter,
+					EvRenderContext *rc)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (exporter);
+	PopplerDocument *replica;
+	PopplerPage *poppler_page;
+	cairo_surface_t *surface;
+	cairo_rectangle_t extents;
+	cairo_t *cr;
+
+	if (!pdf_document_replicas_usable (pdf_document))
+		return NULL;
+
+	replica = pdf_document_acquire_replica (pdf_document);
+	poppler_page = poppler_document_get_page (replica, rc->page->index);
+	if (!poppler_page) {
+		pdf_document_release_replica (pdf_document, replica);
+		return NULL;
+	}
+
+	extents.x = 0;
+	extents.y = 0;
+	poppler_page_get_size (poppler_page, &extents.width, &extents.height);
+
+	surface = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, &extents);
+	cr = cairo_create (surface);
+	poppler_page_render_for_printing (poppler_page, cr);
+	cairo_destroy (cr);
+
+	g_object_unref (poppler_page);
+	pdf_document_release_replica (pdf_document, replica);
+
+	return surface;
+}
+
+static void
+pdf_document_file_exporter_do_rendered_page (EvFileExporter  *exporter,
+					     EvRenderContext *rc,
+					     cairo_surface_t *page)
+{
+	PdfDocument *pdf_document = PDF_DOCUMENT (exporter);
+	PdfPrintContext *ctx = pdf_document->print_ctx;
+	gdouble page_width, page_height;
+
+	g_return_if_fail (pdf_document->print_ctx != NULL);
 
-	cairo_save (ctx->cr);
-	if (rotate) {
-		cairo_matrix_t matrix;
-		
-		cairo_translate (ctx->cr, (2 * y + 1) * pwidth, 0);
-		cairo_matrix_init (&matrix,
-				   0,  1,
-				   -1,  0,
-				   0,  0);
-		cairo_transform (ctx->cr, &matrix);
-	}
-	
-	cairo_translate (ctx->cr,
-			 x * (rotate ? pheight : pwidth),
-			 y * (rotate ? pwidth : pheight));
-	cairo_scale (ctx->cr, xscale, yscale);
+	poppler_page_get_size (POPPLER_PAGE (rc->page->backend_page),
+			       &page_width, &page_height);
+	pdf_print_context_place_page (ctx, page_width, page_height);
 
-	poppler_page_render_for_printing (poppler_page, ctx->cr);
+	cairo_rectangle (ctx->cr, 0, 0, page_width, page_height);
+	cairo_clip (ctx->cr);
+	cairo_set_source_surface (ctx->cr, page, 0, 0);
+	cairo_paint (ctx->cr);
 
 	ctx->pages_printed++;
-			
+
 	cairo_restore (ctx->cr);
-#else /* HAVE_CAIRO_PRINT */
-	if (ctx->format == EV_FILE_FORMAT_PS)
-		poppler_page_render_to_ps (poppler_page, ctx->ps_file);
-#endif /* HAVE_CAIRO_PRINT */
 }
+#endif /* HAVE_CAIRO_PRINT */
 
 static void
 pdf_document_file_exporter_end_page (EvFileExporter *exporter)
@@ -2002,7 +3211,14 @@ pdf_document_file_exporter_end (EvFileExporter *exporter)
 static EvFileExporterCapabilities
 pdf_document_file_exporter_get_capabilities (EvFileExporter *exporter)
 {
-	return  (EvFileExporterCapabilities) (
+	EvFileExporterCapabilities caps = (EvFileExporterCapabilities) 0;
+
+#ifdef HAVE_CAIRO_PRINT
+	if (pdf_document_replicas_usable (PDF_DOCUMENT (exporter)))
+		caps = EV_FILE_EXPORTER_CAN_RENDER_PAGES;
+#endif
+
+	return  (EvFileExporterCapabilities) (caps |
 		EV_FILE_EXPORTER_CAN_PAGE_SET |
 		EV_FILE_EXPORTER_CAN_COPIES |
 		EV_FILE_EXPORTER_CAN_COLLATE |
@@ -2027,6 +3243,10 @@ pdf_document_file_exporter_iface_init (EvFileExporterInterface *iface)
 	iface->end_page = pdf_document_file_exporter_end_page;
         iface->end = pdf_document_file_exporter_end;
 	iface->get_capabilities = pdf_document_file_exporter_get_capabilities;
+#ifdef HAVE_CAIRO_PRINT
+	iface->render_page = pdf_document_file_exporter_render_page;
+	iface->do_rendered_page = pdf_document_file_exporter_do_rendered_page;
+#endif
 }
 
 /* EvDocumentPrint */
@@ -2221,18 +3441,11 @@ pdf_document_text_get_text_layout (EvDocumentText  *selection,
 }
 
 static PangoAttrList *
-pdf_document_text_get_text_attrs (EvDocumentText *document_text,
-				  EvPage         *page)
+pdf_document_text_attrs_from_poppler (GList *backend_attrs_list)
 {
-	GList         *backend_attrs_list,  *l;
+	GList         *l;
 	PangoAttrList *attrs_list;
 
-	g_return_val_if_fail (POPPLER_IS_PAGE (page->backend_page), NULL);
-
-	backend_attrs_list = poppler_page_get_text_attributes (POPPLER_PAGE (page->backend_page));
-	if (!backend_attrs_list)
-		return NULL;
-
 	attrs_list = pango_attr_list_new ();
         for (l = backend_attrs_list; l; l = g_list_next (l)) {
                 PopplerTextAttributes *backend_attrs = (PopplerTextAttributes *)l->data;
@@ -2267,11 +3480,104 @@ pdf_document_text_get_text_attrs (EvDocumentText *document_text,
 		}
 	}
 
+	return attrs_list;
+}
+
+static PangoAttrList *
+pdf_document_text_get_text_attrs (EvDocumentText *document_text,
+				  EvPage         *page)
+{
+	GList         *backend_attrs_list;
+	PangoAttrList *attrs_list;
+
+	g_return_val_if_fail (POPPLER_IS_PAGE (page->backend_page), NULL);
+
+	backend_attrs_list = poppler_page_get_text_attributes (POPPLER_PAGE (page->backend_page));
+	if (!backend_attrs_list)
+		return NULL;
+
+	attrs_list = pdf_document_text_attrs_from_poppler (backend_attrs_list);
 	poppler_page_free_text_attributes (backend_attrs_list);
 
 	return attrs_list;
 }
 
+/* The glyph selection region of the whole page is the union of the
+ * boxes of its characters, spaces included, which the text layout
+ * already has, so the mapping doesn't need a further pass over the
+ * text of the page.
+ */
+static cairo_region_t *
+create_region_from_text_layout (PopplerRectangle *areas,
+				guint             n_areas)
+{
+	cairo_region_t *retval;
+	guint           i;
+
+	retval = cairo_region_create ();
+
+	for (i = 0; i < n_areas; i++) {
+		cairo_rectangle_int_t rect;
+
+		rect.x = (gint) (areas[i].x1 + 0.5);
+		rect.y = (gint) (areas[i].y1 + 0.5);
+		rect.width  = (gint) (areas[i].x2 + 0.5) - rect.x;
+		rect.height = (gint) (areas[i].y2 + 0.5) - rect.y;
+		if (rect.width > 0 && rect.height > 0)
+			cairo_region_union_rectangle (retval, &rect);
+	}
+
+	return retval;
+}
+
+static void
+pdf_document_text_get_text_data (EvDocumentText         *document_text,
+				 EvPage                 *page,
+				 EvDocumentTextDataFlags flags,
+				 gchar                 **text,
+				 EvRectangle           **areas,
+				 guint                  *n_areas,
+				 cairo_region_t        **mapping,
+				 PangoAttrList         **attrs)
+{
+	PopplerPage      *poppler_page;
+	PopplerRectangle *layout = NULL;
+	guint             n_layout = 0;
+
+	g_return_if_fail (POPPLER_IS_PAGE (page->backend_page));
+
+	poppler_page = POPPLER_PAGE (page->backend_page);
+
+	/* All of these work on the text page poppler keeps for
+	 * poppler_page, so it's only extracted once
+	 */
+	if (flags & EV_DOCUMENT_TEXT_DATA_TEXT)
+		*text = poppler_page_get_text (poppler_page);
+
+	if (flags & (EV_DOCUMENT_TEXT_DATA_LAYOUT | EV_DOCUMENT_TEXT_DATA_MAPPING))
+		poppler_page_get_text_layout (poppler_page, &layout, &n_layout);
+
+	if (flags & EV_DOCUMENT_TEXT_DATA_MAPPING)
+		*mapping = create_region_from_text_layout (layout, n_layout);
+
+	if (flags & EV_DOCUMENT_TEXT_DATA_LAYOUT) {
+		*areas = (EvRectangle *)layout;
+		*n_areas = n_layout;
+	} else {
+		g_free (layout);
+	}
+
+	if (flags & EV_DOCUMENT_TEXT_DATA_ATTRS) {
+		GList *backend_attrs_list;
+
+		backend_attrs_list = poppler_page_get_text_attributes (poppler_page);
+		if (backend_attrs_list) {
+			*attrs = pdf_document_text_attrs_from_poppler (backend_attrs_list);
+			poppler_page_free_text_attributes (backend_attrs_list);
+		}
+	}
+}
+
 static void
 pdf_document_text_iface_init (EvDocumentTextInterface *iface)
 {
@@ -2279,6 +3585,7 @@ pdf_document_text_iface_init (EvDocumentTextInterface *iface)
         iface->get_text = pdf_document_text_get_text;
         iface->get_text_layout = pdf_document_text_get_text_layout;
 	iface->get_text_attrs = pdf_document_text_get_text_attrs;
+	iface->get_text_data = pdf_document_text_get_text_data;
 }
 
 /* Page Transitions */
@@ -2530,7 +3837,7 @@ pdf_document_forms_get_form_fields (EvDocumentForms *document,
 static gboolean
 pdf_document_forms_document_is_modified (EvDocumentForms *document)
 {
-	return PDF_DOCUMENT (document)->forms_modified;
+	return g_atomic_int_get (&PDF_DOCUMENT (document)->forms_modified);
 }
 
 static gchar *
@@ -2562,7 +3869,7 @@ pdf_document_forms_form_field_text_set_text (EvDocumentForms *document,
 		return;
 	
 	poppler_form_field_text_set_text (poppler_field, text);
-	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	g_atomic_int_set (&PDF_DOCUMENT (document)->forms_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document), TRUE);
 }
 
@@ -2578,7 +3885,7 @@ pdf_document_forms_form_field_button_set_state (EvDocumentForms *document,
 		return;
 	
 	poppler_form_field_button_set_state (poppler_field, state);
-	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	g_atomic_int_set (&PDF_DOCUMENT (document)->forms_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document), TRUE);
 }
 
@@ -2660,7 +3967,7 @@ pdf_document_forms_form_field_choice_select_item (EvDocumentForms *document,
 		return;
 
 	poppler_form_field_choice_select_item (poppler_field, index);
-	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	g_atomic_int_set (&PDF_DOCUMENT (document)->forms_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document), TRUE);
 }
 
@@ -2676,7 +3983,7 @@ pdf_document_forms_form_field_choice_toggle_item (EvDocumentForms *document,
 		return;
 
 	poppler_form_field_choice_toggle_item (poppler_field, index);
-	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	g_atomic_int_set (&PDF_DOCUMENT (document)->forms_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document), TRUE);
 }
 
@@ -2691,7 +3998,7 @@ pdf_document_forms_form_field_choice_unselect_all (EvDocumentForms *document,
 		return;
 	
 	poppler_form_field_choice_unselect_all (poppler_field);
-	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	g_atomic_int_set (&PDF_DOCUMENT (document)->forms_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document), TRUE);
 }
 
@@ -2707,7 +4014,7 @@ pdf_document_forms_form_field_choice_set_text (EvDocumentForms *document,
 		return;
 	
 	poppler_form_field_choice_set_text (poppler_field, text);
-	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	g_atomic_int_set (&PDF_DOCUMENT (document)->forms_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document), TRUE);
 }
 
@@ -2851,7 +4158,8 @@ poppler_annot_can_have_popup_window (PopplerAnnot *poppler_annot)
 }
 
 static EvAnnotation *
-ev_annot_from_poppler_annot (PopplerAnnot *poppler_annot,
+ev_annot_from_poppler_annot (PdfDocument  *pdf_document,
+			     PopplerAnnot *poppler_annot,
 			     EvPage       *page)
 {
 	EvAnnotation *ev_annot = NULL;
@@ -2876,31 +4184,19 @@ ev_annot_from_poppler_annot (PopplerAnnot *poppler_annot,
 	        case POPPLER_ANNOT_FILE_ATTACHMENT: {
 			PopplerAnnotFileAttachment *poppler_annot_attachment;
 			PopplerAttachment          *poppler_attachment;
-			gchar                      *data = NULL;
-			gsize                       size;
-			GError                     *error = NULL;
 
 			poppler_annot_attachment = POPPLER_ANNOT_FILE_ATTACHMENT (poppler_annot);
 			poppler_attachment = poppler_annot_file_attachment_get_attachment (poppler_annot_attachment);
 
-			if (poppler_attachment &&
-			    attachment_save_to_buffer (poppler_attachment, &data, &size, &error)) {
+			if (poppler_attachment) {
 				EvAttachment *ev_attachment;
 
-				ev_attachment = ev_attachment_new (poppler_attachment->name,
-								   poppler_attachment->description,
-								   poppler_attachment->mtime,
-								   poppler_attachment->ctime,
-								   size, data);
+				ev_attachment = pdf_document_new_attachment (pdf_document,
+									     poppler_attachment);
 				ev_annot = ev_annotation_attachment_new (page, ev_attachment);
 				g_object_unref (ev_attachment);
-			} else if (error) {
-				g_warning ("%s", error->message);
-				g_error_free (error);
-			}
-
-			if (poppler_attachment)
 				g_object_unref (poppler_attachment);
+			}
 		}
 			break;
 		case POPPLER_ANNOT_HIGHLIGHT:
@@ -3102,7 +4398,7 @@ pdf_document_annotations_get_annotations (EvDocumentAnnotations *document_annota
 
 		mapping = (PopplerAnnotMapping *)list->data;
 
-		ev_annot = ev_annot_from_poppler_annot (mapping->annot, page);
+		ev_annot = ev_annot_from_poppler_annot (pdf_document, mapping->annot, page);
 		if (!ev_annot)
 			continue;
 
@@ -3162,7 +4458,7 @@ pdf_document_annotations_get_annotations (EvDocumentAnnotations *document_annota
 static gboolean
 pdf_document_annotations_document_is_modified (EvDocumentAnnotations *document_annotations)
 {
-	return PDF_DOCUMENT (document_annotations)->annots_modified;
+	return g_atomic_int_get (&PDF_DOCUMENT (document_annotations)->annots_modified);
 }
 
 static void
@@ -3194,22 +4490,119 @@ pdf_document_annotations_remove_annotation (EvDocumentAnnotations *document_anno
 			g_hash_table_remove (pdf_document->annots, GINT_TO_POINTER (page->index));
         }
 
-        pdf_document->annots_modified = TRUE;
+        g_atomic_int_set (&pdf_document->annots_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document_annotations), TRUE);
 }
 
-/* FIXME: this could be moved to poppler */
-static GArray *
-get_quads_for_area (PopplerPage      *page,
-		    EvRectangle      *area,
-		    PopplerRectangle *bbox)
+/* Index of the glyph of the layout closest to (x, y), looking at the
+ * vertical distance first so that points in the margins pick the
+ * glyphs of their line. When the point is on the line of the glyph,
+ * the glyph is only included if the point is on its leading half for
+ * the start of the area, or on its trailing half for the end.
+ */
+static gint
+find_glyph_at_point (const EvRectangle *layout,
+		     guint              n_layout,
+		     gdouble            x,
+		     gdouble            y,
+		     gboolean           is_end)
 {
-	GList  *rects, *l;
-	guint   n_rects;
+	gdouble best_dx = G_MAXDOUBLE, best_dy = G_MAXDOUBLE;
+	gint    best = -1;
 	guint   i;
-	GArray *quads;
-	gdouble height;
-	gdouble max_x, max_y, min_x, min_y;
+
+	for (i = 0; i < n_layout; i++) {
+		const EvRectangle *r = layout + i;
+		gdouble            dx, dy;
+
+		if (r->x2 <= r->x1 || r->y2 <= r->y1)
+			continue;
+
+		dx = MAX (MAX (r->x1 - x, x - r->x2), 0);
+		dy = MAX (MAX (r->y1 - y, y - r->y2), 0);
+		if (dy < best_dy || (dy == best_dy && dx < best_dx)) {
+			best = i;
+			best_dx = dx;
+			best_dy = dy;
+			if (dx == 0 && dy == 0)
+				break;
+		}
+	}
+
+	if (best == -1 || best_dy > 0)
+		return best;
+
+	if (!is_end && x > (layout[best].x1 + layout[best].x2) / 2)
+		return best + 1;
+	if (is_end && x < (layout[best].x1 + layout[best].x2) / 2)
+		return best - 1;
+
+	return best;
+}
+
+/* The glyphs between the start and the end points of @area in reading
+ * order, merged into one rectangle per line.
+ */
+static GArray *
+get_glyph_rects_for_area (const EvRectangle *layout,
+			  guint              n_layout,
+			  const EvRectangle *area)
+{
+	GArray      *rects;
+	EvRectangle *line = NULL;
+	gint         start, end, i;
+
+	rects = g_array_new (FALSE, FALSE, sizeof (EvRectangle));
+
+	start = find_glyph_at_point (layout, n_layout, area->x1, area->y1, FALSE);
+	end = find_glyph_at_point (layout, n_layout, area->x2, area->y2, TRUE);
+	if (start > end) {
+		start = find_glyph_at_point (layout, n_layout, area->x2, area->y2, FALSE);
+		end = find_glyph_at_point (layout, n_layout, area->x1, area->y1, TRUE);
+	}
+
+	start = MAX (start, 0);
+	end = MIN (end, (gint)n_layout - 1);
+	for (i = start; i <= end; i++) {
+		const EvRectangle *r = layout + i;
+
+		if (r->x2 <= r->x1 || r->y2 <= r->y1)
+			continue;
+
+		if (line && r->y1 < line->y2 && r->y2 > line->y1) {
+			line->x1 = MIN (line->x1, r->x1);
+			line->y1 = MIN (line->y1, r->y1);
+			line->x2 = MAX (line->x2, r->x2);
+			line->y2 = MAX (line->y2, r->y2);
+			continue;
+		}
+
+		g_array_append_vals (rects, r, 1);
+		line = &g_array_index (rects, EvRectangle, rects->len - 1);
+	}
+
+	return rects;
+}
+
+/* The text layout is taken from the text cache of the document, so
+ * creating or moving several text markup annotations on a page only
+ * computes the glyph boxes of the page once.
+ */
+static GArray *
+get_quads_for_area (PdfDocument       *pdf_document,
+		    EvPage            *page,
+		    const EvRectangle *layout,
+		    guint              n_layout,
+		    EvRectangle       *area,
+		    PopplerRectangle  *bbox)
+{
+	EvRectangle *page_layout = NULL;
+	GArray  *rects;
+	guint    n_rects;
+	guint    i;
+	GArray  *quads;
+	gdouble  height;
+	gdouble  max_x, max_y, min_x, min_y;
 
 	if (bbox) {
 		bbox->x1 = G_MAXDOUBLE;
@@ -3218,19 +4611,26 @@ get_quads_for_area (PopplerPage      *page,
 		bbox->y2 = G_MINDOUBLE;
 	}
 
-	poppler_page_get_size (page, NULL, &height);
+	poppler_page_get_size (POPPLER_PAGE (page->backend_page), NULL, &height);
 
-	rects = poppler_page_get_selection_region (page, 1.0, POPPLER_SELECTION_GLYPH,
-						   (PopplerRectangle *)area);
-	n_rects = g_list_length (rects);
+	if (!layout &&
+	    ev_document_text_get_text_layout (EV_DOCUMENT_TEXT (pdf_document), page,
+					      &page_layout, &n_layout))
+		layout = page_layout;
+	if (!layout)
+		n_layout = 0;
+
+	rects = get_glyph_rects_for_area (layout, n_layout, area);
+	n_rects = rects->len;
+	g_free (page_layout);
 
 	quads = g_array_sized_new (TRUE, TRUE,
 				   sizeof (PopplerQuadrilateral),
 				   n_rects);
 	g_array_set_size (quads, MAX (1, n_rects));
 
-	for (l = rects, i = 0; i < n_rects; i++, l = l->next) {
-		PopplerRectangle     *r = (PopplerRectangle *) l->data;
+	for (i = 0; i < n_rects; i++) {
+		EvRectangle          *r = &g_array_index (rects, EvRectangle, i);
 		PopplerQuadrilateral *quad = &g_array_index (quads, PopplerQuadrilateral, i);
 
 		quad->p1.x = r->x1;
@@ -3241,7 +4641,6 @@ get_quads_for_area (PopplerPage      *page,
 		quad->p3.y = height - r->y2;
 		quad->p4.x = r->x2;
 		quad->p4.y = height - r->y2;
-		poppler_rectangle_free (r);
 
 		if (!bbox)
 			continue;
@@ -3260,7 +4659,7 @@ get_quads_for_area (PopplerPage      *page,
 		if (max_y > bbox->y2)
 			bbox->y2 = max_y;
 	}
-	g_list_free (rects);
+	g_array_free (rects, TRUE);
 
 	if (n_rects == 0 && bbox) {
 		bbox->x1 = 0;
@@ -3273,9 +4672,10 @@ get_quads_for_area (PopplerPage      *page,
 }
 
 static void
-pdf_document_annotations_add_annotation (EvDocumentAnnotations *document_annotations,
-					 EvAnnotation          *annot,
-					 EvRectangle           *rect_deprecated)
+pdf_document_annotations_add_annotation_with_layout (EvDocumentAnnotations *document_annotations,
+						     EvAnnotation          *annot,
+						     const EvRectangle     *layout,
+						     guint                  n_layout)
 {
 	PopplerAnnot    *poppler_annot;
 	PdfDocument     *pdf_document;
@@ -3318,7 +4718,7 @@ pdf_document_annotations_add_annotation (EvDocumentAnnotations *document_annotat
 			GArray *quads;
 			PopplerRectangle bbox;
 
-			quads = get_quads_for_area (poppler_page, &rect, &bbox);
+			quads = get_quads_for_area (pdf_document, page, layout, n_layout, &rect, &bbox);
 
 			if (bbox.x1 != 0 && bbox.y1 != 0 && bbox.x2 != 0 && bbox.y2 != 0) {
 				poppler_rect.x1 = rect.x1 = bbox.x1;
@@ -3398,20 +4798,59 @@ pdf_document_annotations_add_annotation (EvDocumentAnnotations *document_annotat
 	annot_set_unique_name (annot);
 
 	if (mapping_list) {
-		list = ev_mapping_list_get_list (mapping_list);
-		list = g_list_append (list, annot_mapping);
+		ev_mapping_list_add (mapping_list, annot_mapping);
 	} else {
-		list = g_list_append (list, annot_mapping);
+		list = g_list_append (NULL, annot_mapping);
 		mapping_list = ev_mapping_list_new (page->index, list, (GDestroyNotify)g_object_unref);
 		g_hash_table_insert (pdf_document->annots,
 				     GINT_TO_POINTER (page->index),
-				     ev_mapping_list_ref (mapping_list));
+				     mapping_list);
 	}
 
-	pdf_document->annots_modified = TRUE;
+	g_atomic_int_set (&pdf_document->annots_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document_annotations), TRUE);
 }
 
+static void
+pdf_document_annotations_add_annotation (EvDocumentAnnotations *document_annotations,
+					 EvAnnotation          *annot,
+					 EvRectangle           *rect_deprecated)
+{
+	pdf_document_annotations_add_annotation_with_layout (document_annotations,
+							     annot, NULL, 0);
+}
+
+static void
+pdf_document_annotations_add_annotations (EvDocumentAnnotations *document_annotations,
+					  GList                 *annots)
+{
+	EvRectangle *layout = NULL;
+	guint        n_layout = 0;
+	gint         layout_page = -1;
+	GList       *l;
+
+	for (l = annots; l; l = g_list_next (l)) {
+		EvAnnotation *annot = EV_ANNOTATION (l->data);
+		EvPage       *page = ev_annotation_get_page (annot);
+
+		/* Get the text layout once for every page */
+		if (EV_IS_ANNOTATION_TEXT_MARKUP (annot) && page->index != layout_page) {
+			g_free (layout);
+			layout = NULL;
+			n_layout = 0;
+			layout_page = page->index;
+			ev_document_text_get_text_layout (EV_DOCUMENT_TEXT (document_annotations),
+							  page, &layout, &n_layout);
+		}
+
+		pdf_document_annotations_add_annotation_with_layout (document_annotations, annot,
+								     page->index == layout_page ? layout : NULL,
+								     n_layout);
+	}
+
+	g_free (layout);
+}
+
 /* FIXME: We could probably add this to poppler */
 static void
 copy_poppler_annot (PopplerAnnot* src_annot,
@@ -3604,7 +5043,8 @@ pdf_document_annotations_save_annotation (EvDocumentAnnotations *document_annota
 			poppler_page = POPPLER_PAGE (page->backend_page);
 
 			ev_annotation_get_area (annot, &area);
-			quads = get_quads_for_area (poppler_page, &area, &bbox);
+			quads = get_quads_for_area (PDF_DOCUMENT (document_annotations), page,
+						    NULL, 0, &area, &bbox);
 			poppler_annot_text_markup_set_quadrilaterals (text_markup, quads);
 			poppler_annot_set_rectangle (poppler_annot, &bbox);
 			g_array_unref (quads);
@@ -3627,7 +5067,21 @@ pdf_document_annotations_save_annotation (EvDocumentAnnotations *document_annota
 		}
 	}
 
-	PDF_DOCUMENT (document_annotations)->annots_modified = TRUE;
+	/* The mapping area follows the annotation, the list has to
+	 * index it again */
+	if (mask & EV_ANNOTATIONS_SAVE_AREA) {
+		PdfDocument   *pdf_document = PDF_DOCUMENT (document_annotations);
+		EvMappingList *mapping_list = NULL;
+
+		if (pdf_document->annots)
+			mapping_list = (EvMappingList *)g_hash_table_lookup (pdf_document->annots,
+									     GINT_TO_POINTER (ev_annotation_get_page_index (annot)));
+		if (mapping_list)
+			ev_mapping_list_update (mapping_list,
+						ev_mapping_list_find (mapping_list, annot));
+	}
+
+	g_atomic_int_set (&PDF_DOCUMENT (document_annotations)->annots_modified, TRUE);
 	ev_document_set_modified (EV_DOCUMENT (document_annotations), TRUE);
 }
 
@@ -3637,6 +5091,7 @@ pdf_document_document_annotations_iface_init (EvDocumentAnnotationsInterface *if
 	iface->get_annotations = pdf_document_annotations_get_annotations;
 	iface->document_is_modified = pdf_document_annotations_document_is_modified;
 	iface->add_annotation = pdf_document_annotations_add_annotation;
+	iface->add_annotations = pdf_document_annotations_add_annotations;
 	iface->save_annotation = pdf_document_annotations_save_annotation;
 	iface->remove_annotation = pdf_document_annotations_remove_annotation;
 }
@@ -3691,70 +5146,184 @@ ev_media_from_poppler_movie (EvDocument   *document,
 	return media;
 }
 
+typedef struct {
+	/* Weak, media mappings are cached by the view */
+	GWeakRef      document;
+	PopplerMedia *media;
+	gint          page;
+	gint          annot;
+} PdfMediaSource;
+
 static void
-delete_temp_file (GFile *file)
+pdf_media_source_free (PdfMediaSource *source)
 {
-	g_file_delete (file, NULL, NULL);
-	g_object_unref (file);
+	g_weak_ref_clear (&source->document);
+	g_object_unref (source->media);
+	g_slice_free (PdfMediaSource, source);
+}
+
+/* Finds the embedded media of the screen annotation at position @annot
+ * in the annotation mapping of @page, in a document of the same file */
+static PopplerMedia *
+pdf_media_source_find_media (PdfMediaSource  *source,
+			     PopplerDocument *document)
+{
+	PopplerPage  *poppler_page;
+	PopplerMedia *media = NULL;
+	GList        *annots;
+	GList        *l;
+
+	poppler_page = poppler_document_get_page (document, source->page);
+	if (!poppler_page)
+		return NULL;
+
+	annots = poppler_page_get_annot_mapping (poppler_page);
+	l = g_list_nth (annots, source->annot);
+	if (l) {
+		PopplerAnnotMapping *mapping = (PopplerAnnotMapping *) l->data;
+
+		if (poppler_annot_get_annot_type (mapping->annot) == POPPLER_ANNOT_SCREEN) {
+			PopplerAction *action;
+
+			action = poppler_annot_screen_get_action (POPPLER_ANNOT_SCREEN (mapping->annot));
+			if (action && action->type == POPPLER_ACTION_RENDITION &&
+			    action->rendition.media &&
+			    poppler_media_is_embedded (action->rendition.media))
+				media = POPPLER_MEDIA (g_object_ref (action->rendition.media));
+		}
+	}
+	poppler_page_free_annot_mapping (annots);
+	g_object_unref (poppler_page);
+
+	return media;
 }
 
 static gboolean
-media_save_to_file_callback (const gchar *buffer,
-			     gsize        count,
-			     gpointer     data,
-			     GError     **error)
+media_save_to_stream_callback (const gchar  *buf,
+			       gsize         count,
+			       gpointer      user_data,
+			       GError      **error)
 {
-	gint fd = GPOINTER_TO_INT (data);
+	return g_output_stream_write_all (G_OUTPUT_STREAM (user_data),
+					  buf, count, NULL, NULL, error);
+}
+
+/* The stream blocks while the player is behind, so the contents are
+ * read from a document of their own instead of holding the document
+ * lock meanwhile. Once the document has been modified, or when it
+ * can't be opened again, they are copied in memory under the lock. */
+static gboolean
+media_save_to_stream (EvMedia       *ev_media,
+		      GOutputStream *stream,
+		      gpointer       user_data,
+		      GError       **error)
+{
+	PdfMediaSource  *source = (PdfMediaSource *) user_data;
+	PdfDocument     *pdf_document;
+	PopplerDocument *document = NULL;
+	PopplerMedia    *media = NULL;
+	GOutputStream   *memory;
+	gchar           *filename;
+	gboolean         retval;
+
+	pdf_document = PDF_DOCUMENT (g_weak_ref_get (&source->document));
+	if (!pdf_document) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+				     _("The document has been closed"));
+		return FALSE;
+	}
+
+	ev_document_lock (EV_DOCUMENT (pdf_document));
+	filename = g_filename_from_uri (ev_document_get_uri (EV_DOCUMENT (pdf_document)), NULL, NULL);
+	if (filename && !g_atomic_int_get (&pdf_document->annots_modified)) {
+		g_mutex_lock (&pdf_document->replicas_mutex);
+		document = pdf_document_open (pdf_document,
+					      ev_document_get_uri (EV_DOCUMENT (pdf_document)),
+					      NULL);
+		g_mutex_unlock (&pdf_document->replicas_mutex);
+	}
+	g_free (filename);
+
+	if (document) {
+		ev_document_unlock (EV_DOCUMENT (pdf_document));
+
+		media = pdf_media_source_find_media (source, document);
+		if (media) {
+			retval = poppler_media_save_to_callback (media,
+								 media_save_to_stream_callback,
+								 stream, error);
+			g_object_unref (media);
+			g_object_unref (document);
+			g_object_unref (pdf_document);
+
+			return retval;
+		}
+		g_object_unref (document);
+
+		ev_document_lock (EV_DOCUMENT (pdf_document));
+	}
 
-	return write (fd, buffer, count) == (gssize)count;
+	memory = g_memory_output_stream_new_resizable ();
+	retval = poppler_media_save_to_callback (source->media,
+						 media_save_to_stream_callback,
+						 memory, error);
+	ev_document_unlock (EV_DOCUMENT (pdf_document));
+	g_object_unref (pdf_document);
+
+	if (retval && g_output_stream_close (memory, NULL, error)) {
+		GMemoryOutputStream *mem = G_MEMORY_OUTPUT_STREAM (memory);
+
+		retval = g_output_stream_write_all (stream,
+						    g_memory_output_stream_get_data (mem),
+						    g_memory_output_stream_get_data_size (mem),
+						    NULL, NULL, error);
+	} else {
+		retval = FALSE;
+	}
+	g_object_unref (memory);
+
+	return retval;
 }
 
 static EvMedia *
 ev_media_from_poppler_rendition (EvDocument   *document,
 				 EvPage       *page,
+				 gint          annot,
 				 PopplerMedia *poppler_media)
 {
 	EvMedia *media;
-	GFile   *file = NULL;
+	GFile   *file;
 	gchar   *uri;
-	gboolean is_temp_file = FALSE;
 
 	if (!poppler_media)
 		return NULL;
 
+	/* Embedded media are only extracted once they are played */
 	if (poppler_media_is_embedded (poppler_media)) {
-		gint   fd;
-		gchar *filename;
+		PdfMediaSource *source;
 
-		fd = ev_mkstemp ("evmedia.XXXXXX", &filename, NULL);
-		if (fd == -1)
-			return NULL;
+		source = g_slice_new (PdfMediaSource);
+		g_weak_ref_init (&source->document, document);
+		source->media = POPPLER_MEDIA (g_object_ref (poppler_media));
+		source->page = page->index;
+		source->annot = annot;
 
-		if (poppler_media_save_to_callback (poppler_media,
-						    media_save_to_file_callback,
-						    GINT_TO_POINTER (fd), NULL)) {
-			file = g_file_new_for_path (filename);
-			is_temp_file = TRUE;
-		}
-		close (fd);
-		g_free (filename);
-	} else {
-		file = get_media_file (poppler_media_get_filename (poppler_media), document);
-	}
+		media = ev_media_new_with_save_func (page, media_save_to_stream,
+						     source,
+						     (GDestroyNotify) pdf_media_source_free);
+		ev_media_set_show_controls (media, TRUE);
 
-	if (!file)
-		return NULL;
+		return media;
+	}
 
+	file = get_media_file (poppler_media_get_filename (poppler_media), document);
 	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
 	media = ev_media_new_for_uri (page, uri);
 	ev_media_set_show_controls (media, TRUE);
 	g_free (uri);
 
-	if (is_temp_file)
-		g_object_set_data_full (G_OBJECT (media), "poppler-media-temp-file", file, (GDestroyNotify)delete_temp_file);
-	else
-		g_object_unref (file);
-
 	return media;
 }
 
@@ -3769,7 +5338,7 @@ pdf_document_media_get_media_mapping (EvDocumentMedia *document_media,
 	GList *annots;
 	GList *list;
 	gdouble height;
-	gint i = 0;
+	gint i;
 
 	pdf_document = PDF_DOCUMENT (document_media);
 	poppler_page = POPPLER_PAGE (page->backend_page);
@@ -3777,7 +5346,7 @@ pdf_document_media_get_media_mapping (EvDocumentMedia *document_media,
 	annots = poppler_page_get_annot_mapping (poppler_page);
 	poppler_page_get_size (poppler_page, NULL, &height);
 
-	for (list = annots; list; list = list->next) {
+	for (list = annots, i = 0; list; list = list->next, i++) {
 		PopplerAnnotMapping *mapping;
 		EvMapping           *media_mapping;
 		EvMedia             *media = NULL;
@@ -3798,7 +5367,7 @@ pdf_document_media_get_media_mapping (EvDocumentMedia *document_media,
 
 			action = poppler_annot_screen_get_action (POPPLER_ANNOT_SCREEN (mapping->annot));
 			if (action && action->type == POPPLER_ACTION_RENDITION) {
-				media = ev_media_from_poppler_rendition (EV_DOCUMENT (pdf_document), page,
+				media = ev_media_from_poppler_rendition (EV_DOCUMENT (pdf_document), page, i,
 									 action->rendition.media);
 			}
 		}
@@ -3836,63 +5405,79 @@ pdf_document_document_media_iface_init (EvDocumentMediaInterface *iface)
 }
 
 /* Attachments */
-struct SaveToBufferData {
-	gchar *buffer;
-	gsize len, max;
-};
+typedef struct {
+	/* Weak, annotations are cached by the document */
+	GWeakRef           document;
+	PopplerAttachment *attachment;
+} PdfAttachmentSource;
+
+static void
+pdf_attachment_source_free (PdfAttachmentSource *source)
+{
+	g_weak_ref_clear (&source->document);
+	g_object_unref (source->attachment);
+	g_slice_free (PdfAttachmentSource, source);
+}
 
 static gboolean
-attachment_save_to_buffer_callback (const gchar  *buf,
+attachment_save_to_stream_callback (const gchar  *buf,
 				    gsize         count,
 				    gpointer      user_data,
 				    GError      **error)
 {
-	struct SaveToBufferData *sdata = (SaveToBufferData *)user_data;
-	gchar *new_buffer;
-	gsize new_max;
-
-	if (sdata->len + count > sdata->max) {
-		new_max = MAX (sdata->max * 2, sdata->len + count);
-		new_buffer = (gchar *)g_realloc (sdata->buffer, new_max);
-
-		sdata->buffer = new_buffer;
-		sdata->max = new_max;
-	}
-
-	memcpy (sdata->buffer + sdata->len, buf, count);
-	sdata->len += count;
-
-	return TRUE;
+	return g_output_stream_write_all (G_OUTPUT_STREAM (user_data),
+					  buf, count, NULL, NULL, error);
 }
 
+/* Contents are streamed from the document to their destination,
+ * without keeping them in memory */
 static gboolean
-attachment_save_to_buffer (PopplerAttachment  *attachment,
-			   gchar             **buffer,
-			   gsize              *buffer_size,
-			   GError            **error)
-{
-	static const gint initial_max = 1024;
-	struct SaveToBufferData sdata;
-
-	*buffer = NULL;
-	*buffer_size = 0;
-
-	sdata.buffer = (gchar *) g_malloc (initial_max);
-	sdata.max = initial_max;
-	sdata.len = 0;
-
-	if (! poppler_attachment_save_to_callback (attachment,
-						   attachment_save_to_buffer_callback,
-						   &sdata,
-						   error)) {
-		g_free (sdata.buffer);
+attachment_save_to_stream (EvAttachment  *ev_attachment,
+			   GOutputStream *stream,
+			   gpointer       user_data,
+			   GError       **error)
+{
+	PdfAttachmentSource *source = (PdfAttachmentSource *) user_data;
+	EvDocument          *document;
+	gboolean             retval;
+
+	/* The contents are read from the file of the document */
+	document = EV_DOCUMENT (g_weak_ref_get (&source->document));
+	if (!document) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+				     _("The document has been closed"));
 		return FALSE;
 	}
 
-	*buffer = sdata.buffer;
-	*buffer_size = sdata.len;
+	ev_document_lock (document);
+	retval = poppler_attachment_save_to_callback (source->attachment,
+						      attachment_save_to_stream_callback,
+						      stream,
+						      error);
+	ev_document_unlock (document);
+	g_object_unref (document);
 
-	return TRUE;
+	return retval;
+}
+
+static EvAttachment *
+pdf_document_new_attachment (PdfDocument       *pdf_document,
+			     PopplerAttachment *attachment)
+{
+	PdfAttachmentSource *source;
+
+	source = g_slice_new (PdfAttachmentSource);
+	g_weak_ref_init (&source->document, pdf_document);
+	source->attachment = POPPLER_ATTACHMENT (g_object_ref (attachment));
+
+	return ev_attachment_new_with_save_func (attachment->name,
+						 attachment->description,
+						 attachment->mtime,
+						 attachment->ctime,
+						 attachment->size,
+						 attachment_save_to_stream,
+						 source,
+						 (GDestroyNotify) pdf_attachment_source_free);
 }
 
 static GList *
@@ -3907,30 +5492,10 @@ pdf_document_attachments_get_attachments (EvDocumentAttachments *document)
 
 	for (list = attachments; list; list = list->next) {
 		PopplerAttachment *attachment;
-		EvAttachment *ev_attachment;
-		gchar *data = NULL;
-		gsize size;
-		GError *error = NULL;
 
 		attachment = (PopplerAttachment *) list->data;
-
-		if (attachment_save_to_buffer (attachment, &data, &size, &error)) {
-			ev_attachment = ev_attachment_new (attachment->name,
-							   attachment->description,
-							   attachment->mtime,
-							   attachment->ctime,
-							   size, data);
-
-			retval = g_list_prepend (retval, ev_attachment);
-		} else {
-			if (error) {
-				g_warning ("%s", error->message);
-				g_error_free (error);
-
-				g_free (data);
-			}
-		}
-
+		retval = g_list_prepend (retval,
+					 pdf_document_new_attachment (pdf_document, attachment));
 		g_object_unref (attachment);
 	}
 
@@ -3993,6 +5558,10 @@ build_layers_tree (PdfDocument       *pdf_document,
 						"poppler-layer",
 						g_object_ref (layer),
 						(GDestroyNotify) g_object_unref);
+			if (pdf_document->layers_scan)
+				pdf_layers_scan_add_layer (pdf_document->layers_scan,
+							   poppler_layer_get_title (layer),
+							   rb_group);
 		} else {
 			gchar *title;
 
@@ -4030,6 +5599,7 @@ pdf_document_layers_get_layers (EvDocumentLayers *document)
 	GtkTreeModel *model = NULL;
 	PdfDocument *pdf_document = PDF_DOCUMENT (document);
 	PopplerLayersIter *iter;
+	gboolean scan_started = FALSE;
 
 	iter = poppler_layers_iter_new (pdf_document->document);
 	if (iter) {
@@ -4040,8 +5610,33 @@ pdf_document_layers_get_layers (EvDocumentLayers *document)
 							     G_TYPE_BOOLEAN, /* ENABLED */
 							     G_TYPE_BOOLEAN, /* SHOWTOGGLE */
 							     G_TYPE_INT);    /* RBGROUP */
+
+		/* The pages of the layers are found in the background,
+		 * see pdf_document_layers_get_layer_pages() */
+		if (!pdf_document->layers_scan) {
+			GMappedFile *mapped_file;
+
+			/* The file is only mapped until the scan is done
+			 * when it's not kept mapped */
+			if (pdf_document->mapped_file)
+				mapped_file = g_mapped_file_ref (pdf_document->mapped_file);
+			else
+				mapped_file = pdf_document_map_unchanged_file (pdf_document);
+
+			if (mapped_file) {
+				pdf_document->layers_scan = pdf_layers_scan_new (mapped_file,
+										 poppler_document_get_n_pages (pdf_document->document));
+				g_mapped_file_unref (mapped_file);
+			}
+		} else {
+			scan_started = TRUE;
+		}
+
 		build_layers_tree (pdf_document, model, NULL, iter);
 		poppler_layers_iter_free (iter);
+
+		if (pdf_document->layers_scan && !scan_started)
+			pdf_layers_scan_start (pdf_document->layers_scan);
 	}
 	return model;
 }
@@ -4054,6 +5649,7 @@ pdf_document_layers_show_layer (EvDocumentLayers *document,
 
 	poppler_layer = POPPLER_LAYER (g_object_get_data (G_OBJECT (layer), "poppler-layer"));
 	poppler_layer_show (poppler_layer);
+	g_atomic_int_set (&PDF_DOCUMENT (document)->replicas_stale, TRUE);
 }
 
 static void
@@ -4064,6 +5660,7 @@ pdf_document_layers_hide_layer (EvDocumentLayers *document,
 
 	poppler_layer = POPPLER_LAYER (g_object_get_data (G_OBJECT (layer), "poppler-layer"));
 	poppler_layer_hide (poppler_layer);
+	g_atomic_int_set (&PDF_DOCUMENT (document)->replicas_stale, TRUE);
 }
 
 static gboolean
@@ -4076,6 +5673,25 @@ pdf_document_layers_layer_is_visible (EvDocumentLayers *document,
 	return poppler_layer_is_visible (poppler_layer);
 }
 
+static gboolean
+pdf_document_layers_get_layer_pages (EvDocumentLayers *document,
+				     EvLayer          *layer,
+				     GArray           *pages)
+{
+	PdfDocument  *pdf_document = PDF_DOCUMENT (document);
+	PopplerLayer *poppler_layer;
+
+	if (!pdf_document->layers_scan)
+		return FALSE;
+
+	poppler_layer = POPPLER_LAYER (g_object_get_data (G_OBJECT (layer), "poppler-layer"));
+
+	return pdf_layers_scan_get_pages (pdf_document->layers_scan,
+					  poppler_layer_get_title (poppler_layer),
+					  ev_layer_get_rb_group (layer),
+					  pages);
+}
+
 static void
 pdf_document_document_layers_iface_init (EvDocumentLayersInterface *iface)
 {
@@ -4084,4 +5700,5 @@ pdf_document_document_layers_iface_init (EvDocumentLayersInterface *iface)
 	iface->show_layer = pdf_document_layers_show_layer;
 	iface->hide_layer = pdf_document_layers_hide_layer;
 	iface->layer_is_visible = pdf_document_layers_layer_is_visible;
+	iface->get_layer_pages = pdf_document_layers_get_layer_pages;
 }
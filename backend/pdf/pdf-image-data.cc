@@ -0,0 +1,514 @@
+/* pdf-image-data.cc
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The encoded data of the images of a page, so that they can be saved
+ * and copied without decoding them. Poppler numbers the images of a
+ * page in the order they are drawn, but doesn't tell which object they
+ * are. The contents of the page are followed the same way to find it:
+ * every image drawn must have the size poppler found for the image with
+ * the same number, and anything that could make the order differ, like
+ * inline images, optional content or soft masks, makes it give up.
+ * Only images stored in a format that's a file on its own, JPEG and
+ * JPEG 2000, and that don't need anything else from the document to be
+ * shown right, are returned.
+ */
+
+#include <config.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "pdf-image-data.h"
+
+#define PDF_MAX_FORM_DEPTH  16
+#define PDF_MAX_STATE_DEPTH 256
+
+/* Poppler rounds the sizes of the images to pixels */
+#define PDF_IMAGE_SIZE_TOLERANCE 2.0
+
+typedef struct {
+	PdfObjects    *objects;
+	gint           target;
+	gint           n_drawn;
+	const gdouble *sizes;    /* Width and height of every image */
+	guint          n_images;
+	gboolean       rotated;  /* Page rotated by 90 or 270 degrees */
+	PdfObject     *image;
+} PdfImageFinder;
+
+static void
+pdf_matrix_multiply (const gdouble *m,
+		     gdouble       *ctm)
+{
+	gdouble r[6];
+
+	r[0] = m[0] * ctm[0] + m[1] * ctm[2];
+	r[1] = m[0] * ctm[1] + m[1] * ctm[3];
+	r[2] = m[2] * ctm[0] + m[3] * ctm[2];
+	r[3] = m[2] * ctm[1] + m[3] * ctm[3];
+	r[4] = m[4] * ctm[0] + m[5] * ctm[2] + ctm[4];
+	r[5] = m[4] * ctm[1] + m[5] * ctm[3] + ctm[5];
+	memcpy (ctm, r, sizeof (r));
+}
+
+/* The resource called name in the category of the resources */
+static PdfObject *
+pdf_image_finder_get_resource (PdfImageFinder *finder,
+			       const guchar   *resources,
+			       const guchar   *resources_end,
+			       const gchar    *category,
+			       const guchar   *name,
+			       const guchar   *name_end)
+{
+	const guchar *value, *value_end;
+	gchar        *key;
+	guint         number;
+	gboolean      found;
+
+	if (!resources ||
+	    !pdf_dict_get (resources, resources_end, category, &value, &value_end) ||
+	    !pdf_objects_resolve (finder->objects, &value, &value_end))
+		return NULL;
+
+	key = g_strndup ((const gchar *) name, name_end - name);
+	found = pdf_dict_get (value, value_end, key, &value, &value_end);
+	g_free (key);
+
+	if (!found || !pdf_value_get_ref (value, value_end, &number))
+		return NULL;
+
+	return pdf_objects_get_object (finder->objects, number);
+}
+
+static gboolean
+pdf_object_is_name (PdfObjects  *objects,
+		    PdfObject   *object,
+		    const gchar *key,
+		    const gchar *name)
+{
+	const guchar *value, *value_end;
+
+	return pdf_objects_dict_get (objects, object, key, &value, &value_end) &&
+		pdf_value_is_name (value, value_end, name);
+}
+
+static gboolean
+pdf_object_has_key (PdfObject   *object,
+		    const gchar *key)
+{
+	const guchar *value, *value_end;
+
+	return pdf_dict_get (object->start, object->end, key, &value, &value_end);
+}
+
+/* Checks that the image has the size poppler found for it */
+static gboolean
+pdf_image_finder_check_size (PdfImageFinder *finder,
+			     const gdouble  *ctm)
+{
+	gdouble width, height;
+
+	if (finder->n_drawn >= (gint) finder->n_images)
+		return FALSE;
+
+	/* Only images that aren't rotated or skewed, the size of the
+	 * others depends on how poppler computes their bounding box */
+	if (fabs (ctm[1]) < 1e-6 && fabs (ctm[2]) < 1e-6) {
+		width = fabs (ctm[0]);
+		height = fabs (ctm[3]);
+	} else if (fabs (ctm[0]) < 1e-6 && fabs (ctm[3]) < 1e-6) {
+		width = fabs (ctm[2]);
+		height = fabs (ctm[1]);
+	} else {
+		return FALSE;
+	}
+
+	if (finder->rotated) {
+		gdouble tmp = width;
+
+		width = height;
+		height = tmp;
+	}
+
+	return fabs (width - finder->sizes[finder->n_drawn * 2]) <= PDF_IMAGE_SIZE_TOLERANCE &&
+		fabs (height - finder->sizes[finder->n_drawn * 2 + 1]) <= PDF_IMAGE_SIZE_TOLERANCE;
+}
+
+static gboolean pdf_image_finder_run (PdfImageFinder *finder,
+				      const guchar   *p,
+				      const guchar   *end,
+				      const guchar   *resources,
+				      const guchar   *resources_end,
+				      const gdouble  *ctm,
+				      guint           depth);
+
+static gboolean
+pdf_image_finder_draw_xobject (PdfImageFinder *finder,
+			       PdfObject      *xobject,
+			       const guchar   *resources,
+			       const guchar   *resources_end,
+			       const gdouble  *ctm,
+			       guint           depth)
+{
+	const guchar *value, *value_end;
+	GBytes       *data;
+	gdouble       form_ctm[6];
+	gboolean      retval;
+
+	/* Hidden optional content isn't drawn */
+	if (pdf_object_has_key (xobject, "OC"))
+		return FALSE;
+
+	if (pdf_object_is_name (finder->objects, xobject, "Subtype", "Image")) {
+		if (!pdf_image_finder_check_size (finder, ctm))
+			return FALSE;
+		if (finder->n_drawn == finder->target)
+			finder->image = xobject;
+		finder->n_drawn++;
+
+		return TRUE;
+	}
+
+	if (pdf_object_is_name (finder->objects, xobject, "Subtype", "PS"))
+		return TRUE;
+
+	if (!pdf_object_is_name (finder->objects, xobject, "Subtype", "Form") ||
+	    depth >= PDF_MAX_FORM_DEPTH)
+		return FALSE;
+
+	memcpy (form_ctm, ctm, sizeof (form_ctm));
+	if (pdf_objects_dict_get (finder->objects, xobject, "Matrix", &value, &value_end)) {
+		gdouble       matrix[6];
+		const guchar *start;
+		gint          i;
+
+		if (pdf_next_token (&value, value_end, NULL) != PDF_TOKEN_ARRAY_START)
+			return FALSE;
+		for (i = 0; i < 6; i++) {
+			if (pdf_next_token (&value, value_end, &start) != PDF_TOKEN_OTHER ||
+			    !pdf_parse_number (start, value, &matrix[i]))
+				return FALSE;
+		}
+		pdf_matrix_multiply (matrix, form_ctm);
+	}
+
+	/* Forms without resources use the ones of the page */
+	if (pdf_objects_dict_get (finder->objects, xobject, "Resources", &value, &value_end)) {
+		resources = value;
+		resources_end = value_end;
+	}
+
+	data = pdf_objects_get_stream_data (finder->objects, xobject);
+	if (!data)
+		return FALSE;
+
+	retval = pdf_image_finder_run (finder,
+				       (const guchar *) g_bytes_get_data (data, NULL),
+				       (const guchar *) g_bytes_get_data (data, NULL) + g_bytes_get_size (data),
+				       resources, resources_end, form_ctm, depth + 1);
+	g_bytes_unref (data);
+
+	return retval;
+}
+
+/* Follows the content stream until the image is found, FALSE if it
+ * finds anything it can't follow */
+static gboolean
+pdf_image_finder_run (PdfImageFinder *finder,
+		      const guchar   *p,
+		      const guchar   *end,
+		      const guchar   *resources,
+		      const guchar   *resources_end,
+		      const gdouble  *ctm,
+		      guint           depth)
+{
+	GArray       *states;
+	gdouble       state[6];
+	gdouble       numbers[6];
+	guint         n_numbers = 0;
+	const guchar *first_name = NULL, *first_name_end = NULL;
+	const guchar *name = NULL, *name_end = NULL;
+	const guchar *start;
+	PdfToken      token;
+	gboolean      retval = TRUE;
+
+	states = g_array_new (FALSE, FALSE, sizeof (state));
+	memcpy (state, ctm, sizeof (state));
+
+	while (retval && !finder->image &&
+	       (token = pdf_next_token (&p, end, &start)) != PDF_TOKEN_END) {
+		gdouble number;
+
+		if (token == PDF_TOKEN_ERROR) {
+			retval = FALSE;
+			break;
+		}
+
+		if (token == PDF_TOKEN_NAME) {
+			name = start + 1;
+			name_end = p;
+			if (!first_name) {
+				first_name = name;
+				first_name_end = name_end;
+			}
+			continue;
+		}
+
+		if (token != PDF_TOKEN_OTHER)
+			continue;
+
+		if (pdf_parse_number (start, p, &number)) {
+			if (n_numbers == G_N_ELEMENTS (numbers)) {
+				memmove (numbers, numbers + 1, sizeof (numbers) - sizeof (gdouble));
+				n_numbers--;
+			}
+			numbers[n_numbers++] = number;
+			continue;
+		}
+
+		/* An operator */
+		if (pdf_token_equal (start, p, "q")) {
+			if (states->len >= PDF_MAX_STATE_DEPTH)
+				retval = FALSE;
+			else
+				g_array_append_val (states, state);
+		} else if (pdf_token_equal (start, p, "Q")) {
+			if (states->len > 0) {
+				memcpy (state, (gdouble *) states->data + (states->len - 1) * 6,
+					sizeof (state));
+				g_array_set_size (states, states->len - 1);
+			}
+		} else if (pdf_token_equal (start, p, "cm")) {
+			if (n_numbers == 6)
+				pdf_matrix_multiply (numbers, state);
+			else
+				retval = FALSE;
+		} else if (pdf_token_equal (start, p, "Do")) {
+			PdfObject *xobject;
+
+			xobject = name ? pdf_image_finder_get_resource (finder, resources, resources_end,
+									"XObject", name, name_end) : NULL;
+			retval = xobject &&
+				pdf_image_finder_draw_xobject (finder, xobject, resources, resources_end,
+							       state, depth);
+		} else if (pdf_token_equal (start, p, "BI")) {
+			/* Inline images can't be skipped reliably */
+			retval = FALSE;
+		} else if (pdf_token_equal (start, p, "BDC")) {
+			retval = !first_name || !pdf_token_equal (first_name, first_name_end, "OC");
+		} else if (pdf_token_equal (start, p, "gs")) {
+			PdfObject *ext_gstate;
+
+			/* Soft masks draw their own contents */
+			ext_gstate = name ? pdf_image_finder_get_resource (finder, resources, resources_end,
+									   "ExtGState", name, name_end) : NULL;
+			retval = ext_gstate &&
+				(!pdf_object_has_key (ext_gstate, "SMask") ||
+				 pdf_object_is_name (finder->objects, ext_gstate, "SMask", "None"));
+		} else if (pdf_token_equal (start, p, "Tf")) {
+			PdfObject *font;
+
+			/* Type 3 glyphs can draw images */
+			font = name ? pdf_image_finder_get_resource (finder, resources, resources_end,
+								     "Font", name, name_end) : NULL;
+			retval = font && !pdf_object_is_name (finder->objects, font, "Subtype", "Type3");
+		} else if (pdf_token_equal (start, p, "scn") || pdf_token_equal (start, p, "SCN")) {
+			/* Patterns can draw images */
+			retval = name == NULL;
+		}
+
+		n_numbers = 0;
+		name = first_name = NULL;
+	}
+
+	g_array_free (states, TRUE);
+
+	return retval;
+}
+
+/* The type of the data of the image, if it's a file that shows the
+ * image like poppler does */
+static const gchar *
+pdf_image_get_mime_type (PdfObjects *objects,
+			 PdfObject  *image)
+{
+	const guchar *value, *value_end, *start;
+	const guchar *filter, *filter_end;
+	const gchar  *mime_type = NULL;
+
+	/* Masks and decode arrays change what's shown, decode parameters
+	 * can change how the data is read */
+	if (!image->stream ||
+	    pdf_object_has_key (image, "DecodeParms") ||
+	    pdf_object_has_key (image, "Decode") ||
+	    pdf_object_has_key (image, "SMask") ||
+	    pdf_object_has_key (image, "Mask") ||
+	    pdf_object_has_key (image, "SMaskInData") ||
+	    pdf_object_has_key (image, "ImageMask"))
+		return NULL;
+
+	/* A filter alone, or in an array */
+	if (!pdf_objects_dict_get (objects, image, "Filter", &value, &value_end))
+		return NULL;
+	filter = value;
+	filter_end = value_end;
+	if (pdf_next_token (&value, value_end, NULL) == PDF_TOKEN_ARRAY_START) {
+		if (pdf_next_token (&value, value_end, &start) != PDF_TOKEN_NAME)
+			return NULL;
+		filter = start;
+		filter_end = value;
+		if (pdf_next_token (&value, value_end, NULL) != PDF_TOKEN_ARRAY_END)
+			return NULL;
+	}
+
+	if (pdf_value_is_name (filter, filter_end, "DCTDecode"))
+		mime_type = "image/jpeg";
+	else if (pdf_value_is_name (filter, filter_end, "JPXDecode"))
+		mime_type = "image/jp2";
+	else
+		return NULL;
+
+	/* JPEG 2000 images can leave the color space to the data */
+	if (!pdf_objects_dict_get (objects, image, "ColorSpace", &value, &value_end))
+		return mime_type;
+
+	if (pdf_value_is_name (value, value_end, "DeviceGray") ||
+	    pdf_value_is_name (value, value_end, "DeviceRGB") ||
+	    pdf_value_is_name (value, value_end, "DeviceCMYK"))
+		return mime_type;
+
+	if (pdf_next_token (&value, value_end, NULL) == PDF_TOKEN_ARRAY_START &&
+	    pdf_value_is_name (value, value_end, "ICCBased"))
+		return mime_type;
+
+	return NULL;
+}
+
+static gboolean
+pdf_image_finder_run_page (PdfImageFinder *finder,
+			   guint           page)
+{
+	const guchar *value, *value_end;
+	const guchar *resources = NULL, *resources_end = NULL;
+	GByteArray   *contents;
+	GArray       *streams;
+	PdfObject    *page_object;
+	gdouble       ctm[6] = { 1, 0, 0, 1, 0, 0 };
+	guint         rotate = 0, number, i;
+	gboolean      retval = TRUE;
+
+	if (pdf_objects_get_page_attribute (finder->objects, page, "Rotate", &value, &value_end)) {
+		const guchar *start;
+		gdouble       angle;
+
+		if (pdf_next_token (&value, value_end, &start) != PDF_TOKEN_OTHER ||
+		    !pdf_parse_number (start, value, &angle))
+			return FALSE;
+		rotate = ((gint) angle % 360 + 360) % 360;
+	}
+	finder->rotated = rotate == 90 || rotate == 270;
+
+	if (pdf_objects_get_page_attribute (finder->objects, page, "Resources", &value, &value_end)) {
+		resources = value;
+		resources_end = value_end;
+	}
+
+	/* A stream or an array of streams, drawn as if concatenated */
+	page_object = pdf_objects_get_page (finder->objects, page);
+	if (!pdf_dict_get (page_object->start, page_object->end, "Contents", &value, &value_end))
+		return FALSE;
+
+	streams = g_array_new (FALSE, FALSE, sizeof (guint));
+	if (pdf_value_get_ref (value, value_end, &number)) {
+		PdfObject *object = pdf_objects_get_object (finder->objects, number);
+
+		if (object && object->stream)
+			g_array_append_val (streams, number);
+		else if (object)
+			retval = pdf_value_collect_refs (object->start, object->end, streams);
+	} else {
+		retval = pdf_value_collect_refs (value, value_end, streams);
+	}
+
+	contents = g_byte_array_new ();
+	for (i = 0; retval && i < streams->len; i++) {
+		PdfObject *stream;
+		GBytes    *data;
+
+		stream = pdf_objects_get_object (finder->objects, g_array_index (streams, guint, i));
+		data = stream ? pdf_objects_get_stream_data (finder->objects, stream) : NULL;
+		if (!data) {
+			retval = FALSE;
+			break;
+		}
+		g_byte_array_append (contents,
+				     (const guint8 *) g_bytes_get_data (data, NULL),
+				     g_bytes_get_size (data));
+		g_byte_array_append (contents, (const guint8 *) "\n", 1);
+		g_bytes_unref (data);
+	}
+	g_array_free (streams, TRUE);
+
+	if (retval)
+		retval = pdf_image_finder_run (finder, contents->data, contents->data + contents->len,
+					       resources, resources_end, ctm, 0);
+	g_byte_array_free (contents, TRUE);
+
+	return retval;
+}
+
+/* The data of the image image_id of the page, without copying it,
+ * given the sizes poppler found for the images of the page. NULL if it
+ * can't be found or it has to be decoded to be shown right. */
+GBytes *
+pdf_image_data_get (PdfObjects    *objects,
+		    guint          page,
+		    gint           image_id,
+		    const gdouble *sizes,
+		    guint          n_images,
+		    const gchar  **mime_type)
+{
+	PdfImageFinder finder;
+	const gchar   *type;
+	GBytes        *data;
+
+	if (pdf_objects_is_encrypted (objects) ||
+	    page >= pdf_objects_get_n_pages (objects) ||
+	    image_id < 0 || (guint) image_id >= n_images)
+		return NULL;
+
+	memset (&finder, 0, sizeof (PdfImageFinder));
+	finder.objects = objects;
+	finder.target = image_id;
+	finder.sizes = sizes;
+	finder.n_images = n_images;
+
+	if (!pdf_image_finder_run_page (&finder, page) || !finder.image)
+		return NULL;
+
+	type = pdf_image_get_mime_type (objects, finder.image);
+	if (!type)
+		return NULL;
+
+	data = pdf_objects_get_raw_stream (objects, finder.image);
+	if (data && mime_type)
+		*mime_type = type;
+
+	return data;
+}
@@ -0,0 +1,37 @@
+/* pdf-image-data.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PDF_IMAGE_DATA_H__
+#define __PDF_IMAGE_DATA_H__
+
+#include <glib.h>
+
+#include "pdf-objects.h"
+
+G_BEGIN_DECLS
+
+GBytes *pdf_image_data_get (PdfObjects    *objects,
+			    guint          page,
+			    gint           image_id,
+			    const gdouble *sizes,
+			    guint          n_images,
+			    const gchar  **mime_type);
+
+G_END_DECLS
+
+#endif /* __PDF_IMAGE_DATA_H__ */
@@ -0,0 +1,468 @@
+/* pdf-layers-scan.cc
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Pages using every optional content group, so that showing or hiding
+ * a layer only renders those pages again. Poppler doesn't expose the
+ * resources of the pages, the file is scanned instead, once, in a
+ * thread. A page uses the groups reachable from it, through its own
+ * and inherited resources, its annotations and its contents, without
+ * going through other pages. That's a superset of the groups it uses,
+ * marked content and XObjects only refer to them from the resources.
+ *
+ * Anything that isn't understood fails the whole scan, the layers are
+ * then assumed to be on every page.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "pdf-layers-scan.h"
+#include "pdf-objects.h"
+
+typedef struct {
+	PdfLayersScan *scan;
+	PdfObjects    *objects;
+	guint8        *groups;  /* Whether every object is a group */
+	guint         *marks;
+} PdfScanner;
+
+struct _PdfLayersScan {
+	volatile gint ref_count;
+	volatile gint cancelled;
+
+	GMappedFile  *file;
+	gint          n_pages;
+	GPtrArray    *titles;
+	GArray       *rb_groups;
+
+	GMutex        mutex;
+	gboolean      started;
+	gboolean      done;
+	GHashTable   *title_pages; /* Sorted pages by title, NULL if failed */
+};
+
+/* Objects reachable from the page are marked with mark */
+static gboolean
+pdf_scanner_add_page_groups (PdfScanner *scanner,
+			     guint       page,
+			     GHashTable *group_pages)
+{
+	PdfObject    *page_object, *object;
+	const guchar *p, *end, *value, *value_end;
+	GArray       *stack;
+	guint         mark = page + 1;
+	guint         number;
+
+	page_object = pdf_objects_get_page (scanner->objects, page);
+	stack = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	/* Everything in the page but its parent */
+	p = page_object->start;
+	end = page_object->end;
+	pdf_next_token (&p, end, NULL);
+	for (;;) {
+		const guchar *key, *key_end;
+
+		if (pdf_next_token (&p, end, &key) != PDF_TOKEN_NAME)
+			break;
+		key_end = p;
+		value = p;
+		p = pdf_skip_value (p, end);
+		if (!p) {
+			g_array_free (stack, TRUE);
+			return FALSE;
+		}
+		if (!pdf_token_equal (key + 1, key_end, "Parent") &&
+		    !pdf_value_collect_refs (value, p, stack)) {
+			g_array_free (stack, TRUE);
+			return FALSE;
+		}
+	}
+
+	/* And the inherited resources, the root has no parent */
+	for (object = pdf_objects_get_object (scanner->objects, page_object->parent);
+	     object && object->page_node;
+	     object = pdf_objects_get_object (scanner->objects, object->parent)) {
+		if (pdf_dict_get (object->start, object->end, "Resources", &value, &value_end) &&
+		    !pdf_value_collect_refs (value, value_end, stack)) {
+			g_array_free (stack, TRUE);
+			return FALSE;
+		}
+	}
+
+	while (stack->len > 0) {
+		number = g_array_index (stack, guint, stack->len - 1);
+		g_array_set_size (stack, stack->len - 1);
+
+		object = pdf_objects_get_object (scanner->objects, number);
+		if (!object || scanner->marks[number] == mark)
+			continue;
+		scanner->marks[number] = mark;
+
+		if (object->page_node || object->type == PDF_OBJECT_CATALOG)
+			continue;
+
+		if (scanner->groups[number]) {
+			GArray *pages = (GArray *) g_hash_table_lookup (group_pages, GUINT_TO_POINTER (number));
+
+			if (!pages) {
+				pages = g_array_new (FALSE, FALSE, sizeof (gint));
+				g_hash_table_insert (group_pages, GUINT_TO_POINTER (number), pages);
+			}
+			g_array_append_val (pages, page);
+			continue;
+		}
+
+		if (!pdf_value_collect_refs (object->start, object->end, stack)) {
+			g_array_free (stack, TRUE);
+			return FALSE;
+		}
+	}
+	g_array_free (stack, TRUE);
+
+	return TRUE;
+}
+
+/* Text string to UTF-8 like poppler does, NULL if the result could
+ * differ, for PDFDocEncoding characters not in Latin-1 */
+static gchar *
+pdf_decode_text_string (const guchar *p,
+			const guchar *end)
+{
+	GByteArray *bytes;
+	gchar      *retval = NULL;
+	gsize       i;
+
+	bytes = g_byte_array_new ();
+	p = pdf_skip_space (p, end);
+	if (p < end && *p == '(') {
+		for (p++; p < end - 1; p++) {
+			guchar c = *p;
+
+			if (c == '\\') {
+				if (++p >= end - 1)
+					break;
+				c = *p;
+				switch (c) {
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case '\r':
+					if (p + 1 < end - 1 && p[1] == '\n')
+						p++;
+					continue;
+				case '\n':
+					continue;
+				default:
+					if (c >= '0' && c <= '7') {
+						guint v = c - '0', n;
+
+						for (n = 1; n < 3 && p + 1 < end - 1 && p[1] >= '0' && p[1] <= '7'; n++)
+							v = v * 8 + (*++p - '0');
+						c = (guchar) v;
+					}
+					break;
+				}
+			} else if (c == '\r') {
+				if (p + 1 < end - 1 && p[1] == '\n')
+					p++;
+				c = '\n';
+			}
+			g_byte_array_append (bytes, &c, 1);
+		}
+	} else if (p < end && *p == '<') {
+		gint high = -1;
+
+		for (p++; p < end && *p != '>'; p++) {
+			gint v = g_ascii_xdigit_value (*p);
+
+			if (v == -1)
+				continue;
+			if (high == -1) {
+				high = v;
+			} else {
+				guchar c = (guchar) (high << 4 | v);
+
+				g_byte_array_append (bytes, &c, 1);
+				high = -1;
+			}
+		}
+		if (high != -1) {
+			guchar c = (guchar) (high << 4);
+
+			g_byte_array_append (bytes, &c, 1);
+		}
+	} else {
+		g_byte_array_free (bytes, TRUE);
+		return NULL;
+	}
+
+	if (bytes->len >= 2 && bytes->data[0] == 0xfe && bytes->data[1] == 0xff) {
+		retval = g_convert ((const gchar *) bytes->data + 2, bytes->len - 2,
+				    "UTF-8", "UTF-16BE", NULL, NULL, NULL);
+	} else {
+		for (i = 0; i < bytes->len; i++) {
+			guchar c = bytes->data[i];
+
+			if ((c >= 0x18 && c <= 0x1f) || (c >= 0x7f && c <= 0xa0) || c == 0xad)
+				break;
+		}
+		if (i == bytes->len)
+			retval = g_convert ((const gchar *) bytes->data, bytes->len,
+					    "UTF-8", "ISO-8859-1", NULL, NULL, NULL);
+	}
+	g_byte_array_free (bytes, TRUE);
+
+	return retval;
+}
+
+static gint
+compare_pages (gconstpointer a,
+	       gconstpointer b)
+{
+	return *(const gint *) a - *(const gint *) b;
+}
+
+static void
+pdf_sort_pages (GArray *pages)
+{
+	guint i, n = 0;
+
+	g_array_sort (pages, compare_pages);
+	for (i = 0; i < pages->len; i++) {
+		if (n == 0 || g_array_index (pages, gint, i) != g_array_index (pages, gint, n - 1))
+			g_array_index (pages, gint, n++) = g_array_index (pages, gint, i);
+	}
+	g_array_set_size (pages, n);
+}
+
+static GHashTable *
+pdf_scanner_run (PdfScanner *scanner)
+{
+	GHashTable    *group_pages;
+	GHashTable    *title_pages;
+	const guchar  *value, *value_end;
+	guint          number, n_objects;
+	gint           page;
+
+	scanner->objects = pdf_objects_new (scanner->scan->file, &scanner->scan->cancelled);
+	if (!scanner->objects ||
+	    pdf_objects_get_n_pages (scanner->objects) != (guint) scanner->scan->n_pages)
+		return NULL;
+
+	n_objects = pdf_objects_get_n_objects (scanner->objects);
+	scanner->groups = g_new0 (guint8, n_objects);
+	for (number = 0; number < n_objects; number++) {
+		PdfObject *object = pdf_objects_get_object (scanner->objects, number);
+
+		scanner->groups[number] = object &&
+			pdf_dict_get (object->start, object->end, "Type", &value, &value_end) &&
+			pdf_value_is_name (value, value_end, "OCG");
+	}
+
+	group_pages = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+					     (GDestroyNotify) g_array_unref);
+	scanner->marks = g_new0 (guint, n_objects);
+	for (page = 0; page < scanner->scan->n_pages; page++) {
+		if (g_atomic_int_get (&scanner->scan->cancelled) ||
+		    !pdf_scanner_add_page_groups (scanner, page, group_pages)) {
+			g_hash_table_destroy (group_pages);
+			return NULL;
+		}
+	}
+
+	/* Layers are known by title, groups with the same one are merged */
+	title_pages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					     (GDestroyNotify) g_array_unref);
+	for (number = 0; number < n_objects; number++) {
+		PdfObject *object = pdf_objects_get_object (scanner->objects, number);
+		GArray    *pages, *title_array;
+		gchar     *title;
+
+		if (!scanner->groups[number] ||
+		    !pdf_objects_dict_get (scanner->objects, object, "Name", &value, &value_end))
+			continue;
+
+		title = pdf_decode_text_string (value, value_end);
+		if (!title)
+			continue;
+
+		title_array = (GArray *) g_hash_table_lookup (title_pages, title);
+		if (!title_array) {
+			title_array = g_array_new (FALSE, FALSE, sizeof (gint));
+			g_hash_table_insert (title_pages, title, title_array);
+		} else {
+			g_free (title);
+		}
+
+		pages = (GArray *) g_hash_table_lookup (group_pages, GUINT_TO_POINTER (number));
+		if (pages)
+			g_array_append_vals (title_array, pages->data, pages->len);
+	}
+	g_hash_table_destroy (group_pages);
+
+	return title_pages;
+}
+
+static void
+pdf_layers_scan_unref (PdfLayersScan *scan)
+{
+	if (!g_atomic_int_dec_and_test (&scan->ref_count))
+		return;
+
+	if (scan->file)
+		g_mapped_file_unref (scan->file);
+	g_ptr_array_free (scan->titles, TRUE);
+	g_array_free (scan->rb_groups, TRUE);
+	if (scan->title_pages)
+		g_hash_table_destroy (scan->title_pages);
+	g_mutex_clear (&scan->mutex);
+	g_slice_free (PdfLayersScan, scan);
+}
+
+static gpointer
+pdf_layers_scan_thread (PdfLayersScan *scan)
+{
+	PdfScanner  scanner;
+	GHashTable *title_pages;
+
+	memset (&scanner, 0, sizeof (PdfScanner));
+	scanner.scan = scan;
+
+	title_pages = pdf_scanner_run (&scanner);
+	if (title_pages) {
+		GHashTableIter iter;
+		gpointer       value;
+
+		g_hash_table_iter_init (&iter, title_pages);
+		while (g_hash_table_iter_next (&iter, NULL, &value))
+			pdf_sort_pages ((GArray *) value);
+	}
+
+	g_free (scanner.marks);
+	g_free (scanner.groups);
+	if (scanner.objects)
+		pdf_objects_free (scanner.objects);
+
+	/* The file may only be mapped for the scan */
+	g_mapped_file_unref (scan->file);
+	scan->file = NULL;
+
+	g_mutex_lock (&scan->mutex);
+	scan->title_pages = title_pages;
+	scan->done = TRUE;
+	g_mutex_unlock (&scan->mutex);
+
+	pdf_layers_scan_unref (scan);
+
+	return NULL;
+}
+
+PdfLayersScan *
+pdf_layers_scan_new (GMappedFile *file,
+		     gint         n_pages)
+{
+	PdfLayersScan *scan;
+
+	scan = g_slice_new0 (PdfLayersScan);
+	scan->ref_count = 1;
+	scan->file = g_mapped_file_ref (file);
+	scan->n_pages = n_pages;
+	scan->titles = g_ptr_array_new_with_free_func (g_free);
+	scan->rb_groups = g_array_new (FALSE, FALSE, sizeof (gint));
+	g_mutex_init (&scan->mutex);
+
+	return scan;
+}
+
+/* Layers are added before the scan starts */
+void
+pdf_layers_scan_add_layer (PdfLayersScan *scan,
+			   const gchar   *title,
+			   gint           rb_group)
+{
+	g_return_if_fail (!scan->started);
+
+	g_ptr_array_add (scan->titles, g_strdup (title));
+	g_array_append_val (scan->rb_groups, rb_group);
+}
+
+void
+pdf_layers_scan_start (PdfLayersScan *scan)
+{
+	g_return_if_fail (!scan->started);
+
+	scan->started = TRUE;
+	g_atomic_int_inc (&scan->ref_count);
+	g_thread_unref (g_thread_new ("EvPdfLayersScan",
+				      (GThreadFunc) pdf_layers_scan_thread,
+				      scan));
+}
+
+void
+pdf_layers_scan_free (PdfLayersScan *scan)
+{
+	g_atomic_int_set (&scan->cancelled, 1);
+	pdf_layers_scan_unref (scan);
+}
+
+static gboolean
+pdf_layers_scan_add_title_pages (PdfLayersScan *scan,
+				 const gchar   *title,
+				 GArray        *pages)
+{
+	GArray *title_pages;
+
+	title_pages = (GArray *) g_hash_table_lookup (scan->title_pages, title);
+	if (!title_pages)
+		return FALSE;
+
+	g_array_append_vals (pages, title_pages->data, title_pages->len);
+
+	return TRUE;
+}
+
+/* Adds to pages the pages whose rendering can change when the layer
+ * is shown or hidden, the ones of every layer of its radio button
+ * group as showing it hides them. Returns FALSE if they aren't known.
+ */
+gboolean
+pdf_layers_scan_get_pages (PdfLayersScan *scan,
+			   const gchar   *title,
+			   gint           rb_group,
+			   GArray        *pages)
+{
+	gboolean retval;
+	guint    i;
+
+	g_mutex_lock (&scan->mutex);
+	retval = scan->done && scan->title_pages &&
+		pdf_layers_scan_add_title_pages (scan, title, pages);
+	for (i = 0; retval && rb_group != 0 && i < scan->titles->len; i++) {
+		if (g_array_index (scan->rb_groups, gint, i) == rb_group)
+			retval = pdf_layers_scan_add_title_pages (scan, (const gchar *) g_ptr_array_index (scan->titles, i), pages);
+	}
+	g_mutex_unlock (&scan->mutex);
+
+	return retval;
+}
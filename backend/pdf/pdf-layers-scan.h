@@ -0,0 +1,42 @@
+/* pdf-layers-scan.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PDF_LAYERS_SCAN_H__
+#define __PDF_LAYERS_SCAN_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _PdfLayersScan PdfLayersScan;
+
+PdfLayersScan *pdf_layers_scan_new       (GMappedFile   *file,
+					  gint           n_pages);
+void           pdf_layers_scan_add_layer (PdfLayersScan *scan,
+					  const gchar   *title,
+					  gint           rb_group);
+void           pdf_layers_scan_start     (PdfLayersScan *scan);
+void           pdf_layers_scan_free      (PdfLayersScan *scan);
+gboolean       pdf_layers_scan_get_pages (PdfLayersScan *scan,
+					  const gchar   *title,
+					  gint           rb_group,
+					  GArray        *pages);
+
+G_END_DECLS
+
+#endif /* __PDF_LAYERS_SCAN_H__ */
@@ -0,0 +1,878 @@
+/* pdf-objects.cc
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The objects of a PDF file, for the little poppler-glib doesn't
+ * expose, such as the resources of the pages or the encoded data of
+ * the images.
+ *
+ * Objects are found like when a broken file is reconstructed, looking
+ * for "N G obj" and skipping the stream data, the last definition of
+ * an object wins. The values are left where they are in the file, or
+ * in the inflated object streams, and parsed when they are needed.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "pdf-objects.h"
+
+#define PDF_MAX_OBJECTS         (4 * 1024 * 1024)
+#define PDF_MAX_TREE_DEPTH      64
+#define PDF_MAX_INFLATED_LENGTH (64 * 1024 * 1024)
+
+struct _PdfObjects {
+	GMappedFile   *file;
+	volatile gint *cancelled;
+
+	GArray        *objects;
+	GPtrArray     *buffers; /* Contents of the object streams */
+	guint          catalog;
+	GArray        *pages;   /* Object numbers of the pages in order */
+	gboolean       encrypted;
+};
+
+const guchar *
+pdf_skip_space (const guchar *p,
+		const guchar *end)
+{
+	while (p < end) {
+		if (*p == '%') {
+			while (p < end && *p != '\n' && *p != '\r')
+				p++;
+		} else if (pdf_is_space (*p)) {
+			p++;
+		} else {
+			break;
+		}
+	}
+
+	return p;
+}
+
+static const guchar *
+pdf_skip_regular (const guchar *p,
+		  const guchar *end)
+{
+	while (p < end && !pdf_is_space (*p) && !pdf_is_delimiter (*p))
+		p++;
+
+	return p;
+}
+
+PdfToken
+pdf_next_token (const guchar **p_inout,
+		const guchar  *end,
+		const guchar **start)
+{
+	const guchar *p = pdf_skip_space (*p_inout, end);
+	PdfToken      token;
+
+	if (start)
+		*start = p;
+	if (p >= end)
+		return PDF_TOKEN_END;
+
+	switch (*p) {
+	case '<':
+		if (p + 1 < end && p[1] == '<') {
+			p += 2;
+			token = PDF_TOKEN_DICT_START;
+		} else {
+			p = (const guchar *) memchr (p, '>', end - p);
+			if (!p)
+				return PDF_TOKEN_ERROR;
+			p++;
+			token = PDF_TOKEN_STRING;
+		}
+		break;
+	case '>':
+		if (p + 1 >= end || p[1] != '>')
+			return PDF_TOKEN_ERROR;
+		p += 2;
+		token = PDF_TOKEN_DICT_END;
+		break;
+	case '[':
+		p++;
+		token = PDF_TOKEN_ARRAY_START;
+		break;
+	case ']':
+		p++;
+		token = PDF_TOKEN_ARRAY_END;
+		break;
+	case '(': {
+		guint depth = 0;
+
+		for (; p < end; p++) {
+			if (*p == '\\')
+				p++;
+			else if (*p == '(')
+				depth++;
+			else if (*p == ')' && --depth == 0)
+				break;
+		}
+		if (p >= end)
+			return PDF_TOKEN_ERROR;
+		p++;
+		token = PDF_TOKEN_STRING;
+	}
+		break;
+	case '/':
+		p = pdf_skip_regular (p + 1, end);
+		token = PDF_TOKEN_NAME;
+		break;
+	case ')':
+	case '{':
+	case '}':
+		return PDF_TOKEN_ERROR;
+	default:
+		p = pdf_skip_regular (p, end);
+		token = PDF_TOKEN_OTHER;
+		break;
+	}
+
+	*p_inout = p;
+
+	return token;
+}
+
+gboolean
+pdf_parse_uint (const guchar *p,
+		const guchar *end,
+		guint        *value)
+{
+	guint64 v = 0;
+
+	if (p >= end)
+		return FALSE;
+
+	for (; p < end; p++) {
+		if (*p < '0' || *p > '9')
+			return FALSE;
+		v = v * 10 + (*p - '0');
+		if (v > G_MAXUINT)
+			return FALSE;
+	}
+	*value = (guint) v;
+
+	return TRUE;
+}
+
+gboolean
+pdf_parse_number (const guchar *p,
+		  const guchar *end,
+		  gdouble      *value)
+{
+	gchar  buffer[G_ASCII_DTOSTR_BUF_SIZE];
+	gchar *number_end;
+	gsize  len = end - p;
+
+	if (len == 0 || len >= sizeof (buffer))
+		return FALSE;
+
+	memcpy (buffer, p, len);
+	buffer[len] = '\0';
+	*value = g_ascii_strtod (buffer, &number_end);
+
+	return number_end == buffer + len;
+}
+
+gboolean
+pdf_token_equal (const guchar *start,
+		 const guchar *end,
+		 const gchar  *str)
+{
+	gsize len = strlen (str);
+
+	return (gsize) (end - start) == len && memcmp (start, str, len) == 0;
+}
+
+/* Returns the end of the value at p, references included, NULL if
+ * it's broken */
+const guchar *
+pdf_skip_value (const guchar *p,
+		const guchar *end)
+{
+	const guchar *start;
+	const guchar *q;
+	PdfToken      token;
+	guint         depth;
+	guint         number;
+
+	token = pdf_next_token (&p, end, &start);
+	switch (token) {
+	case PDF_TOKEN_DICT_START:
+	case PDF_TOKEN_ARRAY_START:
+		for (depth = 1; depth > 0;) {
+			token = pdf_next_token (&p, end, NULL);
+			if (token == PDF_TOKEN_DICT_START || token == PDF_TOKEN_ARRAY_START)
+				depth++;
+			else if (token == PDF_TOKEN_DICT_END || token == PDF_TOKEN_ARRAY_END)
+				depth--;
+			else if (token == PDF_TOKEN_END || token == PDF_TOKEN_ERROR)
+				return NULL;
+		}
+		return p;
+	case PDF_TOKEN_NAME:
+	case PDF_TOKEN_STRING:
+		return p;
+	case PDF_TOKEN_OTHER:
+		if (!pdf_parse_uint (start, p, &number))
+			return p;
+
+		/* N G R */
+		q = p;
+		if (pdf_next_token (&q, end, &start) != PDF_TOKEN_OTHER ||
+		    !pdf_parse_uint (start, q, &number))
+			return p;
+		if (pdf_next_token (&q, end, &start) != PDF_TOKEN_OTHER ||
+		    !pdf_token_equal (start, q, "R"))
+			return p;
+		return q;
+	default:
+		return NULL;
+	}
+}
+
+gboolean
+pdf_dict_get (const guchar  *p,
+	      const guchar  *end,
+	      const gchar   *key,
+	      const guchar **value,
+	      const guchar **value_end)
+{
+	const guchar *start;
+	PdfToken      token;
+
+	if (pdf_next_token (&p, end, NULL) != PDF_TOKEN_DICT_START)
+		return FALSE;
+
+	for (;;) {
+		const guchar *name_end;
+
+		token = pdf_next_token (&p, end, &start);
+		if (token != PDF_TOKEN_NAME)
+			return FALSE;
+		name_end = p;
+
+		*value = pdf_skip_space (p, end);
+		p = pdf_skip_value (p, end);
+		if (!p)
+			return FALSE;
+		*value_end = p;
+
+		if (pdf_token_equal (start + 1, name_end, key))
+			return TRUE;
+	}
+}
+
+gboolean
+pdf_value_get_ref (const guchar *p,
+		   const guchar *end,
+		   guint        *number)
+{
+	const guchar *start;
+	guint         generation;
+
+	if (pdf_next_token (&p, end, &start) != PDF_TOKEN_OTHER ||
+	    !pdf_parse_uint (start, p, number))
+		return FALSE;
+	if (pdf_next_token (&p, end, &start) != PDF_TOKEN_OTHER ||
+	    !pdf_parse_uint (start, p, &generation))
+		return FALSE;
+
+	return pdf_next_token (&p, end, &start) == PDF_TOKEN_OTHER &&
+		pdf_token_equal (start, p, "R");
+}
+
+gboolean
+pdf_value_get_uint (const guchar *p,
+		    const guchar *end,
+		    guint        *value)
+{
+	const guchar *start;
+
+	return pdf_next_token (&p, end, &start) == PDF_TOKEN_OTHER &&
+		pdf_parse_uint (start, p, value);
+}
+
+gboolean
+pdf_value_is_name (const guchar *p,
+		   const guchar *end,
+		   const gchar  *name)
+{
+	const guchar *start;
+
+	return pdf_next_token (&p, end, &start) == PDF_TOKEN_NAME &&
+		pdf_token_equal (start + 1, p, name);
+}
+
+/* Adds the numbers of the objects referenced by the value to refs */
+gboolean
+pdf_value_collect_refs (const guchar *p,
+			const guchar *end,
+			GArray       *refs)
+{
+	const guchar *start;
+	PdfToken      token;
+	guint         numbers[2];
+	guint         n_numbers = 0;
+
+	while ((token = pdf_next_token (&p, end, &start)) != PDF_TOKEN_END) {
+		guint number;
+
+		if (token == PDF_TOKEN_ERROR)
+			return FALSE;
+
+		if (token != PDF_TOKEN_OTHER) {
+			n_numbers = 0;
+		} else if (pdf_parse_uint (start, p, &number)) {
+			if (n_numbers == 2)
+				numbers[0] = numbers[1];
+			numbers[MIN (n_numbers, 1)] = number;
+			n_numbers = MIN (n_numbers + 1, 2);
+		} else {
+			if (n_numbers == 2 && pdf_token_equal (start, p, "R"))
+				g_array_append_val (refs, numbers[0]);
+			n_numbers = 0;
+		}
+	}
+
+	return TRUE;
+}
+
+PdfObject *
+pdf_objects_get_object (PdfObjects *objects,
+			guint       number)
+{
+	PdfObject *object;
+
+	if (number >= objects->objects->len)
+		return NULL;
+
+	object = &g_array_index (objects->objects, PdfObject, number);
+
+	return object->start ? object : NULL;
+}
+
+guint
+pdf_objects_get_n_objects (PdfObjects *objects)
+{
+	return objects->objects->len;
+}
+
+/* The value, following the reference if it's one */
+gboolean
+pdf_objects_resolve (PdfObjects    *objects,
+		     const guchar **p,
+		     const guchar **end)
+{
+	PdfObject *object;
+	guint      number;
+
+	if (!pdf_value_get_ref (*p, *end, &number))
+		return TRUE;
+
+	object = pdf_objects_get_object (objects, number);
+	if (!object)
+		return FALSE;
+
+	*p = object->start;
+	*end = object->end;
+
+	return TRUE;
+}
+
+/* The value of key in the dictionary of the object, resolved */
+gboolean
+pdf_objects_dict_get (PdfObjects    *objects,
+		      PdfObject     *object,
+		      const gchar   *key,
+		      const guchar **value,
+		      const guchar **value_end)
+{
+	return pdf_dict_get (object->start, object->end, key, value, value_end) &&
+		pdf_objects_resolve (objects, value, value_end);
+}
+
+static gboolean pdf_objects_add_object_stream (PdfObjects *objects,
+					       PdfObject  *object);
+
+static gboolean
+pdf_objects_add_object (PdfObjects *objects,
+			guint       number,
+			PdfObject  *object)
+{
+	const guchar *value, *value_end;
+
+	if (number >= PDF_MAX_OBJECTS)
+		return FALSE;
+
+	if (pdf_dict_get (object->start, object->end, "Type", &value, &value_end)) {
+		if (pdf_value_is_name (value, value_end, "Catalog"))
+			object->type = PDF_OBJECT_CATALOG;
+		else if (pdf_value_is_name (value, value_end, "ObjStm") && object->stream)
+			object->type = PDF_OBJECT_OBJECT_STREAM;
+		else if (pdf_value_is_name (value, value_end, "XRef") &&
+			 pdf_dict_get (object->start, object->end, "Encrypt", &value, &value_end))
+			objects->encrypted = TRUE;
+	}
+
+	if (number >= objects->objects->len)
+		g_array_set_size (objects->objects, number + 1);
+	g_array_index (objects->objects, PdfObject, number) = *object;
+
+	if (object->type == PDF_OBJECT_CATALOG)
+		objects->catalog = number;
+	else if (object->type == PDF_OBJECT_OBJECT_STREAM)
+		return pdf_objects_add_object_stream (objects, object);
+
+	return TRUE;
+}
+
+guchar *
+pdf_inflate (const guchar *data,
+	     gsize         length,
+	     gsize        *inflated_length)
+{
+	GConverter *decompressor;
+	GByteArray *buffer;
+	gsize       read, written;
+	gboolean    result = FALSE;
+
+	decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+	buffer = g_byte_array_sized_new (MIN (length * 4, PDF_MAX_INFLATED_LENGTH));
+
+	for (;;) {
+		GConverterResult status;
+		guint            old_len = buffer->len;
+
+		if (buffer->len >= PDF_MAX_INFLATED_LENGTH)
+			break;
+		g_byte_array_set_size (buffer, MIN (MAX (old_len * 2, 4096), PDF_MAX_INFLATED_LENGTH));
+
+		status = g_converter_convert (decompressor,
+					      data, length,
+					      buffer->data + old_len, buffer->len - old_len,
+					      G_CONVERTER_INPUT_AT_END,
+					      &read, &written, NULL);
+		g_byte_array_set_size (buffer, old_len + written);
+		if (status == G_CONVERTER_ERROR)
+			break;
+
+		data += read;
+		length -= read;
+		if (status == G_CONVERTER_FINISHED) {
+			result = TRUE;
+			break;
+		}
+	}
+	g_object_unref (decompressor);
+
+	if (!result) {
+		g_byte_array_free (buffer, TRUE);
+		return NULL;
+	}
+
+	*inflated_length = buffer->len;
+
+	return g_byte_array_free (buffer, FALSE);
+}
+
+/* The filter is FlateDecode, alone or in an array, without parameters */
+static gboolean
+pdf_object_is_flate (PdfObject *object)
+{
+	const guchar *value, *value_end, *start;
+
+	/* Predictors aren't supported */
+	if (pdf_dict_get (object->start, object->end, "DecodeParms", &value, &value_end))
+		return FALSE;
+	if (!pdf_dict_get (object->start, object->end, "Filter", &value, &value_end))
+		return FALSE;
+	if (pdf_value_is_name (value, value_end, "FlateDecode"))
+		return TRUE;
+
+	return pdf_next_token (&value, value_end, NULL) == PDF_TOKEN_ARRAY_START &&
+		pdf_next_token (&value, value_end, &start) == PDF_TOKEN_NAME &&
+		pdf_token_equal (start + 1, value, "FlateDecode") &&
+		pdf_next_token (&value, value_end, NULL) == PDF_TOKEN_ARRAY_END;
+}
+
+static gboolean
+pdf_objects_add_object_stream (PdfObjects *objects,
+			       PdfObject  *object)
+{
+	const guchar *value, *value_end;
+	const guchar *p, *end;
+	guchar       *data;
+	gsize         length;
+	guint         n_objects, first, i;
+
+	if (!pdf_object_is_flate (object))
+		return FALSE;
+	if (!pdf_dict_get (object->start, object->end, "N", &value, &value_end) ||
+	    !pdf_value_get_uint (value, value_end, &n_objects))
+		return FALSE;
+	if (!pdf_dict_get (object->start, object->end, "First", &value, &value_end) ||
+	    !pdf_value_get_uint (value, value_end, &first))
+		return FALSE;
+
+	data = pdf_inflate (object->stream, object->stream_length, &length);
+	if (!data || first > length) {
+		g_free (data);
+		return FALSE;
+	}
+	g_ptr_array_add (objects->buffers, data);
+
+	p = data;
+	end = data + first;
+	for (i = 0; i < n_objects; i++) {
+		PdfObject     stream_object;
+		const guchar *start;
+		guint         number, offset;
+
+		if (pdf_next_token (&p, end, &start) != PDF_TOKEN_OTHER ||
+		    !pdf_parse_uint (start, p, &number))
+			return FALSE;
+		if (pdf_next_token (&p, end, &start) != PDF_TOKEN_OTHER ||
+		    !pdf_parse_uint (start, p, &offset) ||
+		    offset > length - first)
+			return FALSE;
+
+		memset (&stream_object, 0, sizeof (PdfObject));
+		stream_object.start = data + first + offset;
+		stream_object.end = pdf_skip_value (stream_object.start, data + length);
+		if (!stream_object.end)
+			return FALSE;
+
+		if (!pdf_objects_add_object (objects, number, &stream_object))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* The decoded data of the stream of the object, pointing to the file
+ * when it isn't compressed, NULL if it isn't a stream or its filters
+ * aren't supported */
+GBytes *
+pdf_objects_get_stream_data (PdfObjects *objects,
+			     PdfObject  *object)
+{
+	const guchar *value, *value_end;
+	guchar       *data;
+	gsize         length;
+
+	if (!object->stream)
+		return NULL;
+
+	if (!pdf_dict_get (object->start, object->end, "Filter", &value, &value_end))
+		return g_bytes_new_static (object->stream, object->stream_length);
+
+	if (!pdf_object_is_flate (object))
+		return NULL;
+
+	data = pdf_inflate (object->stream, object->stream_length, &length);
+
+	return data ? g_bytes_new_take (data, length) : NULL;
+}
+
+/* The data of the stream of the object as it's in the file, still
+ * encoded, without copying it. The file stays mapped while it's used. */
+GBytes *
+pdf_objects_get_raw_stream (PdfObjects *objects,
+			    PdfObject  *object)
+{
+	const guchar *data = (const guchar *) g_mapped_file_get_contents (objects->file);
+
+	/* The ones of objects in object streams aren't in the file */
+	if (!object->stream ||
+	    object->stream < data ||
+	    object->stream + object->stream_length > data + g_mapped_file_get_length (objects->file))
+		return NULL;
+
+	return g_bytes_new_with_free_func (object->stream, object->stream_length,
+					   (GDestroyNotify) g_mapped_file_unref,
+					   g_mapped_file_ref (objects->file));
+}
+
+static const guchar *
+pdf_find (const guchar *p,
+	  const guchar *end,
+	  const gchar  *str)
+{
+	gsize len = strlen (str);
+
+	while (p + len <= end) {
+		p = (const guchar *) memchr (p, str[0], end - p - len + 1);
+		if (!p)
+			return NULL;
+		if (memcmp (p, str, len) == 0)
+			return p;
+		p++;
+	}
+
+	return NULL;
+}
+
+/* Checks that "obj" at p follows "N G", returns N */
+static gboolean
+pdf_get_object_header (const guchar *data,
+		       const guchar *p,
+		       guint        *number)
+{
+	const guchar *digits_end;
+	guint         generation;
+	gint          i;
+
+	for (i = 0; i < 2; i++) {
+		if (p == data || !pdf_is_space (p[-1]))
+			return FALSE;
+		while (p > data && pdf_is_space (p[-1]))
+			p--;
+		digits_end = p;
+		while (p > data && p[-1] >= '0' && p[-1] <= '9')
+			p--;
+		if (!pdf_parse_uint (p, digits_end, i == 0 ? &generation : number))
+			return FALSE;
+	}
+
+	return p == data || pdf_is_space (p[-1]) || pdf_is_delimiter (p[-1]);
+}
+
+static gboolean
+pdf_objects_scan_file (PdfObjects   *objects,
+		       const guchar *data,
+		       gsize         length)
+{
+	const guchar *end = data + length;
+	const guchar *p = data;
+
+	while ((p = pdf_find (p, end, "obj"))) {
+		PdfObject     object;
+		const guchar *value, *value_end;
+		const guchar *start, *q;
+		guint         number, stream_length;
+
+		q = p + 3;
+		if ((q < end && !pdf_is_space (*q) && !pdf_is_delimiter (*q)) ||
+		    !pdf_get_object_header (data, p, &number)) {
+			p = q;
+			continue;
+		}
+
+		memset (&object, 0, sizeof (PdfObject));
+		object.start = pdf_skip_space (q, end);
+		object.end = pdf_skip_value (q, end);
+		if (!object.end) {
+			p = q;
+			continue;
+		}
+		p = object.end;
+
+		q = p;
+		if (pdf_next_token (&q, end, &start) == PDF_TOKEN_OTHER &&
+		    pdf_token_equal (start, q, "stream")) {
+			if (q < end && *q == '\r')
+				q++;
+			if (q < end && *q == '\n')
+				q++;
+			object.stream = q;
+
+			/* The length can be wrong, or in an object not found yet */
+			if (pdf_dict_get (object.start, object.end, "Length", &value, &value_end) &&
+			    pdf_objects_resolve (objects, &value, &value_end) &&
+			    pdf_value_get_uint (value, value_end, &stream_length) &&
+			    stream_length <= (gsize) (end - q)) {
+				q += stream_length;
+				if (pdf_next_token (&q, end, &start) != PDF_TOKEN_OTHER ||
+				    !pdf_token_equal (start, q, "endstream"))
+					q = NULL;
+			} else {
+				q = NULL;
+			}
+
+			if (q) {
+				object.stream_length = stream_length;
+				p = q;
+			} else {
+				q = pdf_find (object.stream, end, "endstream");
+				if (!q)
+					return FALSE;
+				object.stream_length = q - object.stream;
+				p = q + strlen ("endstream");
+			}
+		}
+
+		if (!pdf_objects_add_object (objects, number, &object))
+			return FALSE;
+
+		if (objects->cancelled && g_atomic_int_get (objects->cancelled))
+			return FALSE;
+	}
+
+	/* The trailers of files without xref streams */
+	for (p = data; (p = pdf_find (p, end, "trailer")); p += strlen ("trailer")) {
+		const guchar *value, *value_end;
+
+		if (pdf_dict_get (p + strlen ("trailer"), end, "Encrypt", &value, &value_end))
+			objects->encrypted = TRUE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+pdf_objects_walk_page_tree (PdfObjects *objects,
+			    guint       number,
+			    guint       parent,
+			    guint       depth)
+{
+	PdfObject    *object;
+	const guchar *value, *value_end;
+	GArray       *kids;
+	gboolean      retval = TRUE;
+	guint         i;
+
+	object = pdf_objects_get_object (objects, number);
+	if (!object || object->page_node || depth > PDF_MAX_TREE_DEPTH)
+		return FALSE;
+
+	object->page_node = TRUE;
+	object->parent = parent;
+
+	if (!pdf_dict_get (object->start, object->end, "Kids", &value, &value_end)) {
+		g_array_append_val (objects->pages, number);
+		return TRUE;
+	}
+
+	if (!pdf_objects_resolve (objects, &value, &value_end))
+		return FALSE;
+
+	kids = g_array_new (FALSE, FALSE, sizeof (guint));
+	if (!pdf_value_collect_refs (value, value_end, kids))
+		retval = FALSE;
+	for (i = 0; retval && i < kids->len; i++)
+		retval = pdf_objects_walk_page_tree (objects, g_array_index (kids, guint, i),
+						     number, depth + 1);
+	g_array_free (kids, TRUE);
+
+	return retval;
+}
+
+/* Finds the objects and the pages of the file, NULL if it isn't
+ * understood. cancelled, if given, can be set from another thread to
+ * give up. */
+PdfObjects *
+pdf_objects_new (GMappedFile   *file,
+		 volatile gint *cancelled)
+{
+	PdfObjects   *objects;
+	PdfObject    *catalog;
+	const guchar *value, *value_end;
+	guint         pages_root;
+
+	objects = g_slice_new0 (PdfObjects);
+	objects->file = g_mapped_file_ref (file);
+	objects->cancelled = cancelled;
+	objects->objects = g_array_new (FALSE, TRUE, sizeof (PdfObject));
+	objects->buffers = g_ptr_array_new_with_free_func (g_free);
+	objects->pages = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	if (!pdf_objects_scan_file (objects,
+				    (const guchar *) g_mapped_file_get_contents (file),
+				    g_mapped_file_get_length (file))) {
+		pdf_objects_free (objects);
+		return NULL;
+	}
+
+	catalog = pdf_objects_get_object (objects, objects->catalog);
+	if (!catalog || catalog->type != PDF_OBJECT_CATALOG ||
+	    !pdf_dict_get (catalog->start, catalog->end, "Pages", &value, &value_end) ||
+	    !pdf_value_get_ref (value, value_end, &pages_root) ||
+	    !pdf_objects_walk_page_tree (objects, pages_root, 0, 0)) {
+		pdf_objects_free (objects);
+		return NULL;
+	}
+
+	return objects;
+}
+
+void
+pdf_objects_free (PdfObjects *objects)
+{
+	g_array_free (objects->pages, TRUE);
+	g_ptr_array_free (objects->buffers, TRUE);
+	g_array_free (objects->objects, TRUE);
+	g_mapped_file_unref (objects->file);
+	g_slice_free (PdfObjects, objects);
+}
+
+/* Strings and streams of encrypted files can't be read */
+gboolean
+pdf_objects_is_encrypted (PdfObjects *objects)
+{
+	return objects->encrypted;
+}
+
+guint
+pdf_objects_get_n_pages (PdfObjects *objects)
+{
+	return objects->pages->len;
+}
+
+guint
+pdf_objects_get_page_number (PdfObjects *objects,
+			     guint       index)
+{
+	g_return_val_if_fail (index < objects->pages->len, 0);
+
+	return g_array_index (objects->pages, guint, index);
+}
+
+PdfObject *
+pdf_objects_get_page (PdfObjects *objects,
+		      guint       index)
+{
+	return pdf_objects_get_object (objects, pdf_objects_get_page_number (objects, index));
+}
+
+/* The value of an attribute of the page, inherited from its ancestors
+ * if it doesn't have it, resolved */
+gboolean
+pdf_objects_get_page_attribute (PdfObjects    *objects,
+				guint          index,
+				const gchar   *key,
+				const guchar **value,
+				const guchar **value_end)
+{
+	PdfObject *object;
+
+	for (object = pdf_objects_get_page (objects, index);
+	     object && object->page_node;
+	     object = pdf_objects_get_object (objects, object->parent)) {
+		if (pdf_objects_dict_get (objects, object, key, value, value_end))
+			return TRUE;
+	}
+
+	return FALSE;
+}
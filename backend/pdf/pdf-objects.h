@@ -0,0 +1,138 @@
+/* pdf-objects.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PDF_OBJECTS_H__
+#define __PDF_OBJECTS_H__
+
+#include <string.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _PdfObjects PdfObjects;
+
+typedef enum {
+	PDF_OBJECT_OTHER,
+	PDF_OBJECT_CATALOG,
+	PDF_OBJECT_OBJECT_STREAM
+} PdfObjectType;
+
+typedef struct {
+	const guchar *start; /* The value, without the stream data */
+	const guchar *end;
+	const guchar *stream;
+	gsize         stream_length;
+	guint8        type;
+	guint8        page_node : 1;
+	guint         parent;
+} PdfObject;
+
+typedef enum {
+	PDF_TOKEN_END,
+	PDF_TOKEN_ERROR,
+	PDF_TOKEN_OTHER, /* Numbers and keywords */
+	PDF_TOKEN_NAME,
+	PDF_TOKEN_STRING,
+	PDF_TOKEN_DICT_START,
+	PDF_TOKEN_DICT_END,
+	PDF_TOKEN_ARRAY_START,
+	PDF_TOKEN_ARRAY_END
+} PdfToken;
+
+static inline gboolean
+pdf_is_space (guchar c)
+{
+	return c == '\0' || c == '\t' || c == '\n' || c == '\f' || c == '\r' || c == ' ';
+}
+
+static inline gboolean
+pdf_is_delimiter (guchar c)
+{
+	return c != '\0' && strchr ("()<>[]{}/%", c) != NULL;
+}
+
+const guchar *pdf_skip_space         (const guchar  *p,
+				      const guchar  *end);
+PdfToken      pdf_next_token         (const guchar **p_inout,
+				      const guchar  *end,
+				      const guchar **start);
+gboolean      pdf_parse_uint         (const guchar  *p,
+				      const guchar  *end,
+				      guint         *value);
+gboolean      pdf_parse_number       (const guchar  *p,
+				      const guchar  *end,
+				      gdouble       *value);
+gboolean      pdf_token_equal        (const guchar  *start,
+				      const guchar  *end,
+				      const gchar   *str);
+const guchar *pdf_skip_value         (const guchar  *p,
+				      const guchar  *end);
+gboolean      pdf_dict_get           (const guchar  *p,
+				      const guchar  *end,
+				      const gchar   *key,
+				      const guchar **value,
+				      const guchar **value_end);
+gboolean      pdf_value_get_ref      (const guchar  *p,
+				      const guchar  *end,
+				      guint         *number);
+gboolean      pdf_value_get_uint     (const guchar  *p,
+				      const guchar  *end,
+				      guint         *value);
+gboolean      pdf_value_is_name      (const guchar  *p,
+				      const guchar  *end,
+				      const gchar   *name);
+gboolean      pdf_value_collect_refs (const guchar  *p,
+				      const guchar  *end,
+				      GArray        *refs);
+guchar       *pdf_inflate            (const guchar  *data,
+				      gsize          length,
+				      gsize         *inflated_length);
+
+PdfObjects   *pdf_objects_new          (GMappedFile   *file,
+					volatile gint *cancelled);
+void          pdf_objects_free         (PdfObjects    *objects);
+guint         pdf_objects_get_n_objects (PdfObjects   *objects);
+PdfObject    *pdf_objects_get_object   (PdfObjects    *objects,
+					guint          number);
+gboolean      pdf_objects_resolve      (PdfObjects    *objects,
+					const guchar **p,
+					const guchar **end);
+gboolean      pdf_objects_dict_get     (PdfObjects    *objects,
+					PdfObject     *object,
+					const gchar   *key,
+					const guchar **value,
+					const guchar **value_end);
+GBytes       *pdf_objects_get_stream_data (PdfObjects   *objects,
+					   PdfObject    *object);
+GBytes       *pdf_objects_get_raw_stream  (PdfObjects   *objects,
+					   PdfObject    *object);
+gboolean      pdf_objects_is_encrypted (PdfObjects    *objects);
+guint         pdf_objects_get_n_pages  (PdfObjects    *objects);
+PdfObject    *pdf_objects_get_page     (PdfObjects    *objects,
+					guint          index);
+guint         pdf_objects_get_page_number (PdfObjects   *objects,
+					   guint         index);
+gboolean      pdf_objects_get_page_attribute (PdfObjects    *objects,
+					      guint          index,
+					      const gchar   *key,
+					      const guchar **value,
+					      const guchar **value_end);
+
+G_END_DECLS
+
+#endif /* __PDF_OBJECTS_H__ */
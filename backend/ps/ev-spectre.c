@@ -22,6 +22,11 @@
 #include <config.h>
 #include <glib/gi18n-lib.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <glib/gstdio.h>
 #include <libspectre/spectre.h>
 
 #include "ev-spectre.h"
@@ -29,11 +34,42 @@
 #include "ev-file-exporter.h"
 #include "ev-document-misc.h"
 
+#define PS_INDEX_VERSION          1
+#define PS_INDEX_FORMAT           "(uttba(iiis)msmsms)"
+#define PS_INDEX_PERSIST_MIN_SIZE (1024 * 1024)
+
+typedef struct {
+	gint   width;
+	gint   height;
+	gint   rotation;
+	gchar *label;
+} PSPage;
+
 struct _PSDocument {
 	EvDocument object;
 
+	/* Scanned on demand when the page table comes from the
+	 * index, see ps_document_get_doc() */
 	SpectreDocument *doc;
 	SpectreExporter *exporter;
+	gchar *filename;
+	gboolean scan_failed;
+	GMutex doc_mutex;
+
+	/* Page table and document info, see ps_document_load_index() */
+	PSPage *pages;
+	gint n_pages;
+	gboolean is_eps;
+	gchar *title;
+	gchar *format;
+	gchar *creator;
+
+	/* Render processes, see ps_document_setup_processes() */
+	gchar *gs_path;
+	guint n_processes;
+	guint max_processes;
+	GMutex processes_mutex;
+	GCond processes_cond;
 };
 
 struct _PSDocumentClass {
@@ -52,6 +88,61 @@ EV_BACKEND_REGISTER_WITH_CODE (PSDocument, ps_document,
 static void
 ps_document_init (PSDocument *ps_document)
 {
+	g_mutex_init (&ps_document->doc_mutex);
+	g_mutex_init (&ps_document->processes_mutex);
+	g_cond_init (&ps_document->processes_cond);
+}
+
+static void
+ps_document_finalize (GObject *object)
+{
+	PSDocument *ps = PS_DOCUMENT (object);
+	gint        i;
+
+	for (i = 0; i < ps->n_pages; i++)
+		g_free (ps->pages[i].label);
+	g_free (ps->pages);
+	g_free (ps->title);
+	g_free (ps->format);
+	g_free (ps->creator);
+	g_free (ps->filename);
+	g_free (ps->gs_path);
+	g_mutex_clear (&ps->doc_mutex);
+	g_mutex_clear (&ps->processes_mutex);
+	g_cond_clear (&ps->processes_cond);
+
+	G_OBJECT_CLASS (ps_document_parent_class)->finalize (object);
+}
+
+/* Ghostscript instances are process-wide, so render processes run
+ * Ghostscript in processes of their own, so that different pages can be
+ * rendered at the same time. Every render gets a document with only its
+ * page, made from the DSC structure, like libspectre sends the prolog,
+ * the setup and the page to a new instance for every render. This is
+ * opt-in, by setting EV_PS_RENDER_PROCESSES to the maximum number of
+ * processes. EPS files are always rendered in process, since their
+ * bounding box needn't be at the origin.
+ */
+static void
+ps_document_setup_processes (PSDocument *ps)
+{
+	const gchar *env;
+	gint         n;
+
+	g_clear_pointer (&ps->gs_path, g_free);
+	ps->max_processes = 0;
+
+	env = g_getenv ("EV_PS_RENDER_PROCESSES");
+	if (!env)
+		return;
+
+	n = MIN (atoi (env), (gint) g_get_num_processors ());
+	if (n <= 0 || ps->is_eps)
+		return;
+
+	ps->gs_path = g_find_program_in_path ("gs");
+	if (ps->gs_path)
+		ps->max_processes = n;
 }
 
 static void
@@ -72,6 +163,246 @@ ps_document_dispose (GObject *object)
 	G_OBJECT_CLASS (ps_document_parent_class)->dispose (object);
 }
 
+static gchar *
+ps_document_to_utf8 (const gchar *str)
+{
+        gchar *utf8;
+
+        if (!str)
+                return NULL;
+
+        if (g_utf8_validate (str, -1, NULL))
+                return g_strdup (str);
+
+        /* Try with latin1 and ASCII encondings */
+        utf8 = g_convert (str, -1, "utf-8", "latin1", NULL, NULL, NULL);
+        if (!utf8)
+                utf8 = g_convert (str, -1, "utf-8", "ASCII", NULL, NULL, NULL);
+
+        return utf8;
+}
+
+static gint
+get_page_rotation (SpectrePage *page)
+{
+	switch (spectre_page_get_orientation (page)) {
+	        default:
+	        case SPECTRE_ORIENTATION_PORTRAIT:
+			return 0;
+	        case SPECTRE_ORIENTATION_LANDSCAPE:
+			return 90;
+	        case SPECTRE_ORIENTATION_REVERSE_PORTRAIT:
+			return 180;
+	        case SPECTRE_ORIENTATION_REVERSE_LANDSCAPE:
+			return 270;
+	}
+
+	return 0;
+}
+
+/* Scanning the DSC comments reads the whole file, so it's skipped when
+ * the page table of the file is in the user cache: the document is then
+ * only scanned when it's needed to render, save or export.
+ */
+static SpectreDocument *
+ps_document_scan (const gchar *filename)
+{
+	SpectreDocument *doc;
+
+	doc = spectre_document_new ();
+	spectre_document_load (doc, filename);
+	if (spectre_document_status (doc)) {
+		spectre_document_free (doc);
+		return NULL;
+	}
+
+	return doc;
+}
+
+static SpectreDocument *
+ps_document_get_doc (PSDocument *ps)
+{
+	SpectreDocument *doc;
+
+	g_mutex_lock (&ps->doc_mutex);
+	if (!ps->doc && !ps->scan_failed) {
+		ps->doc = ps_document_scan (ps->filename);
+		/* The file changed since it was indexed */
+		if (ps->doc && spectre_document_get_n_pages (ps->doc) != ps->n_pages)
+			g_clear_pointer (&ps->doc, spectre_document_free);
+		ps->scan_failed = ps->doc == NULL;
+	}
+	doc = ps->doc;
+	g_mutex_unlock (&ps->doc_mutex);
+
+	return doc;
+}
+
+static void
+ps_document_build_pages (PSDocument *ps)
+{
+	const gchar *creator;
+	gint         i;
+
+	ps->n_pages = spectre_document_get_n_pages (ps->doc);
+	ps->pages = g_new0 (PSPage, ps->n_pages);
+	for (i = 0; i < ps->n_pages; i++) {
+		SpectrePage *ps_page = spectre_document_get_page (ps->doc, i);
+
+		spectre_page_get_size (ps_page, &ps->pages[i].width, &ps->pages[i].height);
+		ps->pages[i].rotation = get_page_rotation (ps_page);
+		ps->pages[i].label = ps_document_to_utf8 (spectre_page_get_label (ps_page));
+		spectre_page_free (ps_page);
+	}
+
+	creator = spectre_document_get_creator (ps->doc);
+	ps->is_eps = spectre_document_is_eps (ps->doc);
+	ps->title = ps_document_to_utf8 (spectre_document_get_title (ps->doc));
+	ps->format = ps_document_to_utf8 (spectre_document_get_format (ps->doc));
+	ps->creator = ps_document_to_utf8 (creator ? creator : spectre_document_get_for (ps->doc));
+}
+
+static gchar *
+ps_document_get_index_path (const gchar *filename)
+{
+	gchar *checksum;
+	gchar *basename;
+	gchar *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, filename, -1);
+	basename = g_strconcat (checksum, ".index", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "evince", "ps", basename, NULL);
+	g_free (basename);
+	g_free (checksum);
+
+	return path;
+}
+
+static gboolean
+ps_document_get_file_stamp (const gchar *filename,
+			    guint64     *mtime,
+			    guint64     *size)
+{
+	GStatBuf statbuf;
+
+	if (g_stat (filename, &statbuf) != 0)
+		return FALSE;
+
+	*mtime = statbuf.st_mtime;
+	*size = statbuf.st_size;
+
+	return TRUE;
+}
+
+/* Loads the page table of the file from the user cache, if it's there
+ * and the file didn't change since. The index is not trusted.
+ */
+static gboolean
+ps_document_load_index (PSDocument *ps)
+{
+	GVariant    *variant;
+	GVariant    *pages;
+	GBytes      *bytes;
+	gchar       *path;
+	gchar       *contents;
+	gsize        length;
+	guint64      mtime, size;
+	guint64      saved_mtime, saved_size;
+	guint32      version;
+	gboolean     is_eps;
+	const gchar *title, *format, *creator;
+	gint         i;
+
+	if (!ps_document_get_file_stamp (ps->filename, &mtime, &size))
+		return FALSE;
+
+	path = ps_document_get_index_path (ps->filename);
+	if (!g_file_get_contents (path, &contents, &length, NULL)) {
+		g_free (path);
+		return FALSE;
+	}
+	g_free (path);
+
+	bytes = g_bytes_new_take (contents, length);
+	variant = g_variant_new_from_bytes (G_VARIANT_TYPE (PS_INDEX_FORMAT), bytes, FALSE);
+	g_bytes_unref (bytes);
+
+	g_variant_get (variant, "(uttb@a(iiis)m&sm&sm&s)",
+		       &version, &saved_mtime, &saved_size, &is_eps,
+		       &pages, &title, &format, &creator);
+
+	if (version != PS_INDEX_VERSION ||
+	    saved_mtime != mtime || saved_size != size ||
+	    g_variant_n_children (pages) == 0) {
+		g_variant_unref (pages);
+		g_variant_unref (variant);
+
+		return FALSE;
+	}
+
+	ps->n_pages = g_variant_n_children (pages);
+	ps->pages = g_new0 (PSPage, ps->n_pages);
+	for (i = 0; i < ps->n_pages; i++) {
+		const gchar *label;
+
+		g_variant_get_child (pages, i, "(iii&s)",
+				     &ps->pages[i].width,
+				     &ps->pages[i].height,
+				     &ps->pages[i].rotation,
+				     &label);
+		ps->pages[i].label = *label ? g_strdup (label) : NULL;
+	}
+
+	ps->is_eps = is_eps;
+	ps->title = g_strdup (title);
+	ps->format = g_strdup (format);
+	ps->creator = g_strdup (creator);
+
+	g_variant_unref (pages);
+	g_variant_unref (variant);
+
+	return TRUE;
+}
+
+static void
+ps_document_save_index (PSDocument *ps)
+{
+	GVariantBuilder pages;
+	GVariant       *variant;
+	guint64         mtime, size;
+	gchar          *path;
+	gchar          *dir;
+	gint            i;
+
+	if (!ps_document_get_file_stamp (ps->filename, &mtime, &size) ||
+	    size < PS_INDEX_PERSIST_MIN_SIZE)
+		return;
+
+	g_variant_builder_init (&pages, G_VARIANT_TYPE ("a(iiis)"));
+	for (i = 0; i < ps->n_pages; i++) {
+		g_variant_builder_add (&pages, "(iiis)",
+				       ps->pages[i].width,
+				       ps->pages[i].height,
+				       ps->pages[i].rotation,
+				       ps->pages[i].label ? ps->pages[i].label : "");
+	}
+
+	variant = g_variant_new (PS_INDEX_FORMAT,
+				 PS_INDEX_VERSION, mtime, size, ps->is_eps,
+				 &pages, ps->title, ps->format, ps->creator);
+	g_variant_ref_sink (variant);
+
+	path = ps_document_get_index_path (ps->filename);
+	dir = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dir, 0700) == 0)
+		g_file_set_contents (path, g_variant_get_data (variant),
+				     g_variant_get_size (variant), NULL);
+
+	g_free (dir);
+	g_free (path);
+	g_variant_unref (variant);
+}
+
 /* EvDocumentIface */
 static gboolean
 ps_document_load (EvDocument *document,
@@ -84,11 +415,15 @@ ps_document_load (EvDocument *document,
 	filename = g_filename_from_uri (uri, NULL, error);
 	if (!filename)
 		return FALSE;
-	
-	ps->doc = spectre_document_new ();
 
-	spectre_document_load (ps->doc, filename);
-	if (spectre_document_status (ps->doc)) {
+	ps->filename = filename;
+	if (ps_document_load_index (ps)) {
+		ps_document_setup_processes (ps);
+		return TRUE;
+	}
+
+	ps->doc = ps_document_scan (filename);
+	if (!ps->doc) {
 		gchar *filename_dsp;
 		
 		filename_dsp = g_filename_display_name (filename);
@@ -98,12 +433,13 @@ ps_document_load (EvDocument *document,
 			     _("Failed to load document “%s”"),
 			     filename_dsp);
 		g_free (filename_dsp);
-		g_free (filename);
 
 		return FALSE;
 	}
 
-	g_free (filename);
+	ps_document_build_pages (ps);
+	ps_document_save_index (ps);
+	ps_document_setup_processes (ps);
 
 	return TRUE;
 }
@@ -113,15 +449,18 @@ ps_document_save (EvDocument *document,
 		  const char *uri,
 		  GError    **error)
 {
-	PSDocument *ps = PS_DOCUMENT (document);
-	gchar      *filename;
+	PSDocument      *ps = PS_DOCUMENT (document);
+	SpectreDocument *doc;
+	gchar           *filename;
 
 	filename = g_filename_from_uri (uri, NULL, error);
 	if (!filename)
 		return FALSE;
 
-	spectre_document_save (ps->doc, filename);
-	if (spectre_document_status (ps->doc)) {
+	doc = ps_document_get_doc (ps);
+	if (doc)
+		spectre_document_save (doc, filename);
+	if (!doc || spectre_document_status (doc)) {
 		gchar *filename_dsp;
 
 		filename_dsp = g_filename_display_name (filename);
@@ -146,41 +485,7 @@ ps_document_get_n_pages (EvDocument *document)
 {
 	PSDocument *ps = PS_DOCUMENT (document);
 
-	return spectre_document_get_n_pages (ps->doc);
-}
-
-static EvPage *
-ps_document_get_page (EvDocument *document,
-		      gint        index)
-{
-	PSDocument  *ps = PS_DOCUMENT (document);
-	SpectrePage *ps_page;
-	EvPage      *page;
-
-	ps_page = spectre_document_get_page (ps->doc, index);
-	page = ev_page_new (index);
-	page->backend_page = (EvBackendPage)ps_page;
-	page->backend_destroy_func = (EvBackendPageDestroyFunc)spectre_page_free;
-
-	return page;
-}
-
-static gint
-get_page_rotation (SpectrePage *page)
-{
-	switch (spectre_page_get_orientation (page)) {
-	        default:
-	        case SPECTRE_ORIENTATION_PORTRAIT:
-			return 0;
-	        case SPECTRE_ORIENTATION_LANDSCAPE:
-			return 90;
-	        case SPECTRE_ORIENTATION_REVERSE_PORTRAIT:
-			return 180;
-	        case SPECTRE_ORIENTATION_REVERSE_LANDSCAPE:
-			return 270;
-	}
-
-	return 0;
+	return ps->n_pages;
 }
 
 static void
@@ -189,22 +494,15 @@ ps_document_get_page_size (EvDocument *document,
 			   double     *width,
 			   double     *height)
 {
-	SpectrePage *ps_page;
-	gdouble      page_width, page_height;
-	gint         pwidth, pheight;
-	gint         rotate;
-
-	ps_page = (SpectrePage *)page->backend_page;
-
-	spectre_page_get_size (ps_page, &pwidth, &pheight);
+	PSPage  *ps_page = &PS_DOCUMENT (document)->pages[page->index];
+	gdouble  page_width, page_height;
 
-	rotate = get_page_rotation (ps_page);
-	if (rotate == 90 || rotate == 270) {
-		page_height = pwidth;
-		page_width = pheight;
+	if (ps_page->rotation == 90 || ps_page->rotation == 270) {
+		page_height = ps_page->width;
+		page_width = ps_page->height;
 	} else {
-		page_width = pwidth;
-		page_height = pheight;
+		page_width = ps_page->width;
+		page_height = ps_page->height;
 	}
 
 	if (width) {
@@ -220,21 +518,7 @@ static char *
 ps_document_get_page_label (EvDocument *document,
 			    EvPage     *page)
 {
-        const gchar *label = spectre_page_get_label ((SpectrePage *)page->backend_page);
-        gchar       *utf8;
-
-        if (!label)
-                return NULL;
-
-        if (g_utf8_validate (label, -1, NULL))
-                return g_strdup (label);
-
-        /* Try with latin1 and ASCII encondings */
-        utf8 = g_convert (label, -1, "utf-8", "latin1", NULL, NULL, NULL);
-        if (!utf8)
-                utf8 = g_convert (label, -1, "utf-8", "ASCII", NULL, NULL, NULL);
-
-        return utf8;
+	return g_strdup (PS_DOCUMENT (document)->pages[page->index].label);
 }
 
 static EvDocumentInfo *
@@ -242,29 +526,22 @@ ps_document_get_info (EvDocument *document)
 {
 	PSDocument     *ps = PS_DOCUMENT (document);
 	EvDocumentInfo *info;
-	const gchar    *creator;
-	SpectrePage    *ps_page;
-	gint            width, height;
 
 	info = g_new0 (EvDocumentInfo, 1);
 	info->fields_mask = EV_DOCUMENT_INFO_TITLE |
 	                    EV_DOCUMENT_INFO_FORMAT |
 			    EV_DOCUMENT_INFO_CREATOR |
-			    EV_DOCUMENT_INFO_N_PAGES |
-	                    EV_DOCUMENT_INFO_PAPER_SIZE;
-
-	creator = spectre_document_get_creator (ps->doc);
-
-	ps_page = spectre_document_get_page (ps->doc, 0);
-	spectre_page_get_size (ps_page, &width, &height);
-	spectre_page_free (ps_page);
-	
-	info->title = g_strdup (spectre_document_get_title (ps->doc));
-	info->format = g_strdup (spectre_document_get_format (ps->doc));
-	info->creator = g_strdup (creator ? creator : spectre_document_get_for (ps->doc));
-	info->n_pages = spectre_document_get_n_pages (ps->doc);
-	info->paper_width  = width / 72.0f * 25.4f;
-	info->paper_height = height / 72.0f * 25.4f;
+			    EV_DOCUMENT_INFO_N_PAGES;
+
+	info->title = g_strdup (ps->title);
+	info->format = g_strdup (ps->format);
+	info->creator = g_strdup (ps->creator);
+	info->n_pages = ps->n_pages;
+	if (ps->n_pages > 0) {
+		info->fields_mask |= EV_DOCUMENT_INFO_PAPER_SIZE;
+		info->paper_width  = ps->pages[0].width / 72.0f * 25.4f;
+		info->paper_height = ps->pages[0].height / 72.0f * 25.4f;
+	}
 
 	return info;
 }
@@ -279,10 +556,265 @@ ps_document_get_backend_info (EvDocument            *document,
 	return TRUE;
 }
 
+static gboolean
+read_ppm_token (const guchar *data,
+		gsize         length,
+		gsize        *offset,
+		gint         *value)
+{
+	gsize i = *offset;
+	gint  n = 0;
+
+	for (;;) {
+		if (i >= length)
+			return FALSE;
+		if (data[i] == '#') {
+			while (i < length && data[i] != '\n')
+				i++;
+		} else if (g_ascii_isspace (data[i])) {
+			i++;
+		} else {
+			break;
+		}
+	}
+
+	if (!g_ascii_isdigit (data[i]))
+		return FALSE;
+	while (i < length && g_ascii_isdigit (data[i]) && n < G_MAXINT / 10)
+		n = n * 10 + data[i++] - '0';
+
+	*value = n;
+	*offset = i;
+
+	return TRUE;
+}
+
+/* Converts the binary PPM written by Ghostscript to RGB24 */
+static guchar *
+ps_document_convert_ppm (const guchar *data,
+			 gsize         length,
+			 gint          width,
+			 gint          height,
+			 gint         *stride)
+{
+	guchar *pixels;
+	gsize   offset = 2;
+	gint    ppm_width, ppm_height, maxval;
+	gint    x, y;
+
+	if (length < 2 || data[0] != 'P' || data[1] != '6' ||
+	    !read_ppm_token (data, length, &offset, &ppm_width) ||
+	    !read_ppm_token (data, length, &offset, &ppm_height) ||
+	    !read_ppm_token (data, length, &offset, &maxval) ||
+	    ppm_width != width || ppm_height != height || maxval != 255)
+		return NULL;
+
+	/* A single whitespace separates the header from the samples */
+	offset++;
+	if (length < offset || (length - offset) / 3 / width < (gsize) height)
+		return NULL;
+
+	*stride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
+	pixels = g_malloc ((gsize) *stride * height);
+
+	for (y = 0; y < height; y++) {
+		const guchar *src = data + offset + (gsize) y * width * 3;
+		guint32      *dest = (guint32 *) (pixels + (gsize) y * *stride);
+
+		for (x = 0; x < width; x++, src += 3)
+			dest[x] = (src[0] << 16) | (src[1] << 8) | src[2];
+	}
+
+	return pixels;
+}
+
+static void
+kill_process (GCancellable *cancellable,
+	      gpointer      user_data)
+{
+	kill ((GPid) GPOINTER_TO_INT (user_data), SIGTERM);
+}
+
+/* Renders the page @index at @width x @height, without rotating it, in a
+ * Ghostscript process, see ps_document_setup_processes(). The process is
+ * killed when @cancellable is cancelled.
+ */
+static guchar *
+ps_document_render_in_process (PSDocument   *ps,
+			       gint          index,
+			       gint          width,
+			       gint          height,
+			       gdouble       xscale,
+			       gdouble       yscale,
+			       gboolean      draft,
+			       GCancellable *cancellable,
+			       gint         *stride)
+{
+	SpectreDocument *doc;
+	SpectreExporter *exporter;
+	SpectreStatus    status;
+	GByteArray      *output;
+	GPid             pid;
+	gchar           *filename;
+	gchar           *argv[14];
+	gchar            xres[G_ASCII_DTOSTR_BUF_SIZE];
+	gchar            yres[G_ASCII_DTOSTR_BUF_SIZE];
+	guchar          *pixels = NULL;
+	guchar           buffer[65536];
+	gulong           handler = 0;
+	gssize           n_read;
+	gint             fd, out_fd;
+	gint             i;
+
+	doc = ps_document_get_doc (ps);
+	if (!doc)
+		return NULL;
+
+	fd = g_file_open_tmp ("evince-ps-XXXXXX.ps", &filename, NULL);
+	if (fd == -1)
+		return NULL;
+	close (fd);
+
+	g_mutex_lock (&ps->processes_mutex);
+	while (ps->n_processes >= ps->max_processes)
+		g_cond_wait (&ps->processes_cond, &ps->processes_mutex);
+	ps->n_processes++;
+
+	exporter = spectre_exporter_new (doc, SPECTRE_EXPORTER_FORMAT_PS);
+	status = spectre_exporter_begin (exporter, filename);
+	if (status == SPECTRE_STATUS_SUCCESS)
+		status = spectre_exporter_do_page (exporter, index);
+	if (status == SPECTRE_STATUS_SUCCESS)
+		status = spectre_exporter_end (exporter);
+	spectre_exporter_free (exporter);
+	g_mutex_unlock (&ps->processes_mutex);
+
+	i = 0;
+	argv[i++] = g_strdup (ps->gs_path);
+	argv[i++] = g_strdup ("-q");
+	argv[i++] = g_strdup ("-dSAFER");
+	argv[i++] = g_strdup ("-dBATCH");
+	argv[i++] = g_strdup ("-dNOPAUSE");
+	argv[i++] = g_strdup ("-dFIXEDMEDIA");
+	argv[i++] = g_strdup ("-sDEVICE=ppmraw");
+	argv[i++] = g_strdup ("-sstdout=%stderr");
+	argv[i++] = g_strdup_printf ("-r%sx%s",
+				     g_ascii_formatd (xres, sizeof (xres), "%.4f", 72.0 * xscale),
+				     g_ascii_formatd (yres, sizeof (yres), "%.4f", 72.0 * yscale));
+	argv[i++] = g_strdup_printf ("-g%dx%d", width, height);
+	argv[i++] = g_strdup_printf ("-dTextAlphaBits=%d", draft ? 1 : 4);
+	argv[i++] = g_strdup_printf ("-dGraphicsAlphaBits=%d", draft ? 1 : 2);
+	argv[i++] = g_strdup ("-sOutputFile=-");
+	argv[i++] = g_strdup (filename);
+	argv[i] = NULL;
+
+	output = g_byte_array_new ();
+	if (status == SPECTRE_STATUS_SUCCESS &&
+	    !g_cancellable_is_cancelled (cancellable) &&
+	    g_spawn_async_with_pipes (NULL, argv, NULL,
+				      G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL,
+				      NULL, NULL, &pid, NULL, &out_fd, NULL, NULL)) {
+		if (cancellable)
+			handler = g_cancellable_connect (cancellable, G_CALLBACK (kill_process),
+							 GINT_TO_POINTER (pid), NULL);
+
+		while ((n_read = read (out_fd, buffer, sizeof (buffer))) != 0) {
+			if (n_read > 0)
+				g_byte_array_append (output, buffer, n_read);
+			else if (errno != EINTR)
+				break;
+		}
+		close (out_fd);
+
+		/* Disconnected before reaping, the pid can't be reused yet */
+		if (cancellable)
+			g_cancellable_disconnect (cancellable, handler);
+		waitpid (pid, NULL, 0);
+		g_spawn_close_pid (pid);
+
+		if (!g_cancellable_is_cancelled (cancellable))
+			pixels = ps_document_convert_ppm (output->data, output->len,
+							  width, height, stride);
+	}
+	g_byte_array_free (output, TRUE);
+
+	for (i = 0; argv[i]; i++)
+		g_free (argv[i]);
+
+	g_mutex_lock (&ps->processes_mutex);
+	ps->n_processes--;
+	g_cond_signal (&ps->processes_cond);
+	g_mutex_unlock (&ps->processes_mutex);
+
+	g_unlink (filename);
+	g_free (filename);
+
+	return pixels;
+}
+
+static cairo_surface_t *
+ps_document_render_with_processes (PSDocument      *ps,
+				   EvRenderContext *rc)
+{
+	PSPage          *ps_page = &ps->pages[rc->page->index];
+	cairo_surface_t *surface;
+	cairo_surface_t *rotated_surface;
+	gint             width_points, height_points;
+	gint             width, height;
+	gint             swidth, sheight;
+	gint             rotation;
+	gint             stride;
+	guchar          *data;
+	static const cairo_user_data_key_t key;
+
+	width_points = ps_page->width;
+	height_points = ps_page->height;
+
+	ev_render_context_compute_transformed_size (rc, width_points, height_points,
+					            &width, &height);
+
+	rotation = (rc->rotation + ps_page->rotation) % 360;
+
+	if (rotation == 90 || rotation == 270) {
+		swidth = height;
+		sheight = width;
+	} else {
+		swidth = width;
+		sheight = height;
+	}
+
+	data = ps_document_render_in_process (ps, rc->page->index, swidth, sheight,
+					      (gdouble)swidth / width_points,
+					      (gdouble)sheight / height_points,
+					      ev_render_context_get_draft (rc),
+					      rc->cancellable, &stride);
+	if (!data)
+		return NULL;
+
+	surface = cairo_image_surface_create_for_data (data,
+						       CAIRO_FORMAT_RGB24,
+						       swidth, sheight,
+						       stride);
+	cairo_surface_set_user_data (surface, &key,
+				     data, (cairo_destroy_func_t)g_free);
+
+	/* Ghostscript doesn't follow the DSC orientation, libspectre does */
+	if (rotation == 0)
+		return surface;
+
+	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface, swidth, sheight,
+								    rotation);
+	cairo_surface_destroy (surface);
+
+	return rotated_surface;
+}
+
 static cairo_surface_t *
 ps_document_render (EvDocument      *document,
 		    EvRenderContext *rc)
 {
+	PSDocument           *ps = PS_DOCUMENT (document);
+	SpectreDocument      *doc;
 	SpectrePage          *ps_page;
 	SpectreRenderContext *src;
 	gint                  width_points;
@@ -292,17 +824,25 @@ ps_document_render (EvDocument      *document,
 	guchar               *data = NULL;
 	gint                  stride;
 	gint                  rotation;
+	cairo_rectangle_int_t area;
+	gboolean              has_area;
 	cairo_surface_t      *surface;
 	static const cairo_user_data_key_t key;
 
-	ps_page = (SpectrePage *)rc->page->backend_page;
-	
-	spectre_page_get_size (ps_page, &width_points, &height_points);
+	if (ps->max_processes > 0)
+		return ps_document_render_with_processes (ps, rc);
+
+	doc = ps_document_get_doc (ps);
+	if (!doc)
+		return NULL;
+
+	width_points = ps->pages[rc->page->index].width;
+	height_points = ps->pages[rc->page->index].height;
 
 	ev_render_context_compute_transformed_size (rc, width_points, height_points,
 					            &width, &height);
 
-	rotation = (rc->rotation + get_page_rotation (ps_page)) % 360;
+	rotation = (rc->rotation + ps->pages[rc->page->index].rotation) % 360;
 
 	if (rotation == 90 || rotation == 270) {
 		swidth = height;
@@ -317,29 +857,61 @@ ps_document_render (EvDocument      *document,
 					  (gdouble)swidth / width_points,
 					  (gdouble)sheight / height_points);
 	spectre_render_context_set_rotation (src, rotation);
-	spectre_page_render (ps_page, src, &data, &stride);
+	if (ev_render_context_get_draft (rc))
+		spectre_render_context_set_antialias_bits (src, 1, 1);
+	/* Ghostscript instances are process-wide, so rendering must
+	 * be serialized across documents, not only per document */
+	ev_document_doc_mutex_lock ();
+	/* Renders of other documents might have kept us waiting */
+	ps_page = spectre_document_get_page (doc, rc->page->index);
+	has_area = ev_render_context_get_area (rc, &area);
+	if (!ev_render_context_is_cancelled (rc)) {
+		if (has_area)
+			spectre_page_render_slice (ps_page, src, area.x, area.y,
+						   area.width, area.height, &data, &stride);
+		else
+			spectre_page_render (ps_page, src, &data, &stride);
+	}
+	ev_document_doc_mutex_unlock ();
 	spectre_render_context_free (src);
 
 	if (!data) {
+		spectre_page_free (ps_page);
 		return NULL;
 	}
 
 	if (spectre_page_status (ps_page)) {
 		g_warning ("%s", spectre_status_to_string (spectre_page_status (ps_page)));
+		spectre_page_free (ps_page);
 		g_free (data);
 		
 		return NULL;
 	}
+	spectre_page_free (ps_page);
 
 	surface = cairo_image_surface_create_for_data (data,
 						       CAIRO_FORMAT_RGB24,
-						       width, height,
+						       has_area ? area.width : width,
+						       has_area ? area.height : height,
 						       stride);
 	cairo_surface_set_user_data (surface, &key,
 				     data, (cairo_destroy_func_t)g_free);
 	return surface;
 }
 
+static gboolean
+ps_document_is_thread_safe (EvDocument *document)
+{
+	return PS_DOCUMENT (document)->max_processes > 0;
+}
+
+/* Render processes always render whole pages */
+static gboolean
+ps_document_can_render_area (EvDocument *document)
+{
+	return PS_DOCUMENT (document)->max_processes == 0;
+}
+
 static void
 ps_document_class_init (PSDocumentClass *klass)
 {
@@ -347,16 +919,18 @@ ps_document_class_init (PSDocumentClass *klass)
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 
 	object_class->dispose = ps_document_dispose;
+	object_class->finalize = ps_document_finalize;
 
 	ev_document_class->load = ps_document_load;
 	ev_document_class->save = ps_document_save;
 	ev_document_class->get_n_pages = ps_document_get_n_pages;
-	ev_document_class->get_page = ps_document_get_page;
 	ev_document_class->get_page_size = ps_document_get_page_size;
 	ev_document_class->get_page_label = ps_document_get_page_label;
 	ev_document_class->get_info = ps_document_get_info;
 	ev_document_class->get_backend_info = ps_document_get_backend_info;
 	ev_document_class->render = ps_document_render;
+	ev_document_class->is_thread_safe = ps_document_is_thread_safe;
+	ev_document_class->can_render_area = ps_document_can_render_area;
 }
 
 /* EvFileExporterIface */
@@ -364,27 +938,33 @@ static void
 ps_document_file_exporter_begin (EvFileExporter        *exporter,
 				 EvFileExporterContext *fc)
 {
-	PSDocument *ps = PS_DOCUMENT (exporter);
+	PSDocument      *ps = PS_DOCUMENT (exporter);
+	SpectreDocument *doc;
 
-	if (ps->exporter)
-		spectre_exporter_free (ps->exporter);
+	g_clear_pointer (&ps->exporter, spectre_exporter_free);
+
+	doc = ps_document_get_doc (ps);
+	if (!doc)
+		return;
 
 	switch (fc->format) {
 	        case EV_FILE_FORMAT_PS:
 			ps->exporter =
-				spectre_exporter_new (ps->doc,
+				spectre_exporter_new (doc,
 						      SPECTRE_EXPORTER_FORMAT_PS);
 			break;
 	        case EV_FILE_FORMAT_PDF:
 			ps->exporter =
-				spectre_exporter_new (ps->doc,
+				spectre_exporter_new (doc,
 						      SPECTRE_EXPORTER_FORMAT_PDF);
 			break;
 	        default:
 			g_assert_not_reached ();
 	}
 
+	ev_document_doc_mutex_lock ();
 	spectre_exporter_begin (ps->exporter, fc->filename);
+	ev_document_doc_mutex_unlock ();
 }
 
 static void
@@ -393,7 +973,12 @@ ps_document_file_exporter_do_page (EvFileExporter  *exporter,
 {
 	PSDocument *ps = PS_DOCUMENT (exporter);
 
+	if (!ps->exporter)
+		return;
+
+	ev_document_doc_mutex_lock ();
 	spectre_exporter_do_page (ps->exporter, rc->page->index);
+	ev_document_doc_mutex_unlock ();
 }
 
 static void
@@ -401,7 +986,12 @@ ps_document_file_exporter_end (EvFileExporter *exporter)
 {
 	PSDocument *ps = PS_DOCUMENT (exporter);
 
+	if (!ps->exporter)
+		return;
+
+	ev_document_doc_mutex_lock ();
 	spectre_exporter_end (ps->exporter);
+	ev_document_doc_mutex_unlock ();
 }
 
 static EvFileExporterCapabilities
@@ -24,6 +24,7 @@
 
 #include <config.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -39,12 +40,36 @@ struct _TiffDocumentClass
   EvDocumentClass parent_class;
 };
 
+/* A reduced-resolution version of a page, either a SubIFD of the
+ * page or a FILETYPE_REDUCEDIMAGE directory following it */
+typedef struct
+{
+  toff_t  offset;
+  guint32 width;
+  guint32 height;
+} TiffLevel;
+
+/* Directories are selected by offset, TIFFSetDirectory() walks the
+ * chain from the first one every time */
+typedef struct
+{
+  toff_t  offset;
+  guint32 width;
+  guint32 height;
+  gfloat  x_res;
+  gfloat  y_res;
+  guint16 orientation;
+  EvPageColorMode color_mode;
+  GArray *levels; /* TiffLevel, from the largest to the smallest */
+} TiffPage;
+
 struct _TiffDocument
 {
   EvDocument parent_instance;
 
   TIFF *tiff;
   gint n_pages;
+  GArray *pages; /* TiffPage */
   TIFF2PSContext *ps_export_ctx;
   
   gchar *uri;
@@ -142,7 +167,138 @@ tiff_document_save (EvDocument  *document,
 {		
 	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
 
-	return ev_xfer_uri_simple (tiff_document->uri, uri, error); 
+	return ev_file_clone_uri (tiff_document->uri, uri, error); 
+}
+
+static void
+tiff_document_get_resolution (TIFF   *tiff,
+			      gfloat *x_res,
+			      gfloat *y_res)
+{
+	gfloat x = 0.0;
+	gfloat y = 0.0;
+	gushort unit;
+
+	if (TIFFGetField (tiff, TIFFTAG_XRESOLUTION, &x) &&
+	    TIFFGetField (tiff, TIFFTAG_YRESOLUTION, &y)) {
+		if (TIFFGetFieldDefaulted (tiff, TIFFTAG_RESOLUTIONUNIT, &unit)) {
+			if (unit == RESUNIT_CENTIMETER) {
+				x *= 2.54;
+				y *= 2.54;
+			}
+		}
+	}
+
+	/* Handle 0 values: some software set TIFF resolution as `0 , 0` see bug #646414 */
+	*x_res = x > 0 ? x : 72.0;
+	*y_res = y > 0 ? y : 72.0;
+}
+
+static EvPageColorMode
+tiff_document_get_color_mode (TIFF *tiff)
+{
+	guint16 photometric;
+	guint16 bits_per_sample = 1;
+	guint16 samples_per_pixel = 1;
+
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	if (!TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric) ||
+	    samples_per_pixel != 1 ||
+	    (photometric != PHOTOMETRIC_MINISWHITE && photometric != PHOTOMETRIC_MINISBLACK))
+		return EV_PAGE_COLOR_MODE_COLOR;
+
+	return bits_per_sample == 1 ? EV_PAGE_COLOR_MODE_MONOCHROME : EV_PAGE_COLOR_MODE_GRAYSCALE;
+}
+
+static gint
+tiff_level_compare (gconstpointer a,
+		    gconstpointer b)
+{
+	const TiffLevel *level_a = a;
+	const TiffLevel *level_b = b;
+
+	return (level_a->width < level_b->width) - (level_a->width > level_b->width);
+}
+
+static void
+tiff_document_add_level (TiffPage *page,
+			 TIFF     *tiff,
+			 toff_t    offset)
+{
+	TiffLevel level;
+
+	level.offset = offset;
+	if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &level.width) ||
+	    !TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &level.height) ||
+	    level.width == 0 || level.height == 0)
+		return;
+
+	g_array_append_val (page->levels, level);
+}
+
+/* Reads the directories of the file once, grouping the reduced-resolution
+ * ones with the page they belong to, and recording where each of them
+ * starts along with the geometry of the pages */
+static void
+tiff_document_scan_pages (TiffDocument *tiff_document)
+{
+	TIFF *tiff = tiff_document->tiff;
+	guint i;
+
+	push_handlers ();
+
+	tiff_document->pages = g_array_new (FALSE, FALSE, sizeof (TiffPage));
+	if (TIFFSetDirectory (tiff, 0) != 1) {
+		pop_handlers ();
+		return;
+	}
+
+	do {
+		guint32  subfile_type = 0;
+		guint16  n_subifds = 0;
+		toff_t  *subifds = NULL;
+		TiffPage page;
+
+		TIFFGetField (tiff, TIFFTAG_SUBFILETYPE, &subfile_type);
+		if ((subfile_type & FILETYPE_REDUCEDIMAGE) && tiff_document->pages->len > 0) {
+			tiff_document_add_level (&g_array_index (tiff_document->pages, TiffPage,
+								 tiff_document->pages->len - 1),
+						 tiff, TIFFCurrentDirOffset (tiff));
+			continue;
+		}
+
+		page.offset = TIFFCurrentDirOffset (tiff);
+		page.width = page.height = 0;
+		TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &page.width);
+		TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &page.height);
+		if (!TIFFGetField (tiff, TIFFTAG_ORIENTATION, &page.orientation))
+			page.orientation = ORIENTATION_TOPLEFT;
+		tiff_document_get_resolution (tiff, &page.x_res, &page.y_res);
+		page.color_mode = tiff_document_get_color_mode (tiff);
+		page.levels = g_array_new (FALSE, FALSE, sizeof (TiffLevel));
+
+		if (TIFFGetField (tiff, TIFFTAG_SUBIFD, &n_subifds, &subifds) && n_subifds > 0) {
+			/* The offsets belong to the directory we are leaving */
+			subifds = g_memdup (subifds, n_subifds * sizeof (toff_t));
+			for (i = 0; i < n_subifds; i++) {
+				if (TIFFSetSubDirectory (tiff, subifds[i]))
+					tiff_document_add_level (&page, tiff, subifds[i]);
+			}
+			g_free (subifds);
+			/* Going back by offset keeps the chain position for
+			 * TIFFReadDirectory() */
+			TIFFSetSubDirectory (tiff, page.offset);
+		}
+
+		g_array_append_val (tiff_document->pages, page);
+	} while (TIFFReadDirectory (tiff));
+
+	for (i = 0; i < tiff_document->pages->len; i++)
+		g_array_sort (g_array_index (tiff_document->pages, TiffPage, i).levels,
+			      tiff_level_compare);
+
+	pop_handlers ();
 }
 
 static int
@@ -154,41 +310,80 @@ tiff_document_get_n_pages (EvDocument  *document)
 	g_return_val_if_fail (tiff_document->tiff != NULL, 0);
 	
 	if (tiff_document->n_pages == -1) {
-		push_handlers ();
-		tiff_document->n_pages = 0;
-		
-		do {
-			tiff_document->n_pages ++;
-		}
-		while (TIFFReadDirectory (tiff_document->tiff));
-		pop_handlers ();
+		tiff_document_scan_pages (tiff_document);
+		tiff_document->n_pages = tiff_document->pages->len;
 	}
 
 	return tiff_document->n_pages;
 }
 
-static void
-tiff_document_get_resolution (TiffDocument *tiff_document,
-			      gfloat       *x_res,
-			      gfloat       *y_res)
+static TiffPage *
+tiff_document_get_page (TiffDocument *tiff_document,
+			gint          index)
 {
-	gfloat x = 0.0;
-	gfloat y = 0.0;
-	gushort unit;
+	if (!tiff_document->pages)
+		tiff_document_get_n_pages (EV_DOCUMENT (tiff_document));
+	if (index < 0 || index >= (gint) tiff_document->pages->len)
+		return NULL;
 
-	if (TIFFGetField (tiff_document->tiff, TIFFTAG_XRESOLUTION, &x) &&
-	    TIFFGetField (tiff_document->tiff, TIFFTAG_YRESOLUTION, &y)) {
-		if (TIFFGetFieldDefaulted (tiff_document->tiff, TIFFTAG_RESOLUTIONUNIT, &unit)) {
-			if (unit == RESUNIT_CENTIMETER) {
-				x *= 2.54;
-				y *= 2.54;
-			}
-		}
+	return &g_array_index (tiff_document->pages, TiffPage, index);
+}
+
+/* Makes the full-resolution directory of the page the current one */
+static gboolean
+tiff_document_set_page (TiffDocument *tiff_document,
+			gint          index)
+{
+	TiffPage *page;
+
+	page = tiff_document_get_page (tiff_document, index);
+	if (!page)
+		return FALSE;
+
+	if (TIFFCurrentDirOffset (tiff_document->tiff) == page->offset)
+		return TRUE;
+
+	return TIFFSetSubDirectory (tiff_document->tiff, page->offset) == 1;
+}
+
+/* Makes the smallest version of the page that has at least
+ * min_width x min_height pixels the current directory. Returns
+ * FALSE, leaving the current directory alone, if the full
+ * resolution image is needed. */
+static gboolean
+tiff_document_set_page_level (TiffDocument *tiff_document,
+			      gint          index,
+			      gdouble       min_width,
+			      gdouble       min_height,
+			      int          *width,
+			      int          *height)
+{
+	TiffPage  *page;
+	TiffLevel *level = NULL;
+	guint      i;
+
+	page = &g_array_index (tiff_document->pages, TiffPage, index);
+	for (i = 0; i < page->levels->len; i++) {
+		TiffLevel *l = &g_array_index (page->levels, TiffLevel, i);
+
+		if (l->width < min_width || l->height < min_height)
+			break;
+		level = l;
 	}
 
-	/* Handle 0 values: some software set TIFF resolution as `0 , 0` see bug #646414 */
-	*x_res = x > 0 ? x : 72.0;
-	*y_res = y > 0 ? y : 72.0;
+	if (!level)
+		return FALSE;
+
+	if (TIFFCurrentDirOffset (tiff_document->tiff) != level->offset &&
+	    TIFFSetSubDirectory (tiff_document->tiff, level->offset) != 1) {
+		tiff_document_set_page (tiff_document, index);
+		return FALSE;
+	}
+
+	*width = level->width;
+	*height = level->height;
+
+	return TRUE;
 }
 
 static void
@@ -197,81 +392,31 @@ tiff_document_get_page_size (EvDocument *document,
 			     double     *width,
 			     double     *height)
 {
-	guint32 w, h;
-	gfloat x_res, y_res;
 	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
+	TiffPage *tiff_page;
 	
 	g_return_if_fail (TIFF_IS_DOCUMENT (document));
 	g_return_if_fail (tiff_document->tiff != NULL);
 	
-	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, page->index) != 1) {
-		pop_handlers ();
+	tiff_page = tiff_document_get_page (tiff_document, page->index);
+	if (!tiff_page)
 		return;
-	}
-	
-	TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &w);
-	TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &h);
-	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
-	h = h * (x_res / y_res);
-	
-	*width = w;
-	*height = h;
 	
-	pop_handlers ();
+	*width = tiff_page->width;
+	*height = (guint32) (tiff_page->height * (tiff_page->x_res / tiff_page->y_res));
 }
 
+/* Reads the whole image of the current directory at full size */
 static cairo_surface_t *
-tiff_document_render (EvDocument      *document,
-		      EvRenderContext *rc)
+tiff_document_read_full (TiffDocument *tiff_document,
+			 int           width,
+			 int           height,
+			 int           orientation)
 {
-	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
-	int width, height;
-	int scaled_width, scaled_height;
-	float x_res, y_res;
 	gint rowstride, bytes;
 	guchar *pixels = NULL;
-	guchar *p;
-	int orientation;
 	cairo_surface_t *surface;
-	cairo_surface_t *rotated_surface;
 	static const cairo_user_data_key_t key;
-	
-	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
-	g_return_val_if_fail (tiff_document->tiff != NULL, NULL);
-  
-	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, rc->page->index) != 1) {
-		pop_handlers ();
-		g_warning("Failed to select page %d", rc->page->index);
-		return NULL;
-	}
-
-	if (!TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &width)) {
-		pop_handlers ();
-		g_warning("Failed to read image width");
-		return NULL;
-	}
-
-	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &height)) {
-		pop_handlers ();
-		g_warning("Failed to read image height");
-		return NULL;
-	}
-
-	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_ORIENTATION, &orientation)) {
-		orientation = ORIENTATION_TOPLEFT;
-	}
-
-	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
-	
-	pop_handlers ();
-  
-	/* Sanity check the doc */
-	if (width <= 0 || height <= 0) {
-		g_warning("Invalid width or height.");
-		return NULL;
-	}
 
 	rowstride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
 	if (rowstride / 4 != width) {
@@ -300,6 +445,7 @@ tiff_document_render (EvDocument      *document,
 	cairo_surface_set_user_data (surface, &key,
 				     pixels, (cairo_destroy_func_t)g_free);
 
+	push_handlers ();
 	TIFFReadRGBAImageOriented (tiff_document->tiff,
 				   width, height,
 				   (uint32 *)pixels,
@@ -309,21 +455,235 @@ tiff_document_render (EvDocument      *document,
 	/* Convert the format returned by libtiff to
 	* what cairo expects
 	*/
-	p = pixels;
-	while (p < pixels + bytes) {
-		guint32 *pixel = (guint32*)p;
-		guint8 r = TIFFGetR(*pixel);
-		guint8 g = TIFFGetG(*pixel);
-		guint8 b = TIFFGetB(*pixel);
-		guint8 a = TIFFGetA(*pixel);
+	ev_document_misc_convert_abgr_to_argb ((guint32 *) pixels,
+					       (const guint32 *) pixels,
+					       bytes / 4);
+
+	return surface;
+}
 
-		*pixel = (a << 24) | (r << 16) | (g << 8) | b;
+/* Number of rows read at once by tiff_document_read_scaled(), at least
+ * a strip or a tile when they are smaller than the maximum */
+#define TIFF_BAND_MIN_ROWS 16
+#define TIFF_BAND_MAX_ROWS 256
+
+/* Reads the image of the current directory shrunk to scaled_width x
+ * scaled_height. The image is decoded in bands of a few strips or tiles,
+ * and each band is averaged into the destination right away, so that
+ * the memory used doesn't depend on the size of the image. Strips
+ * taller than a band, up to the whole image in a single strip, are
+ * read a scanline at a time, since libtiff decodes full strips.
+ */
+static cairo_surface_t *
+tiff_document_read_scaled (TiffDocument *tiff_document,
+			   int           width,
+			   int           height,
+			   int           scaled_width,
+			   int           scaled_height)
+{
+	TIFFRGBAImage img;
+	char emsg[1024];
+	cairo_surface_t *surface;
+	guchar *data;
+	gint stride;
+	guint32 *band;
+	guint64 *sums;
+	guint *columns;
+	guint *column_counts;
+	guint32 band_rows = 0;
+	guchar *scanlines = NULL;
+	gsize scanline_size = 0;
+	guint32 row;
+	int dest_y = 0;
+	guint row_count = 0;
+	int x;
 
-		p += 4;
+	push_handlers ();
+	if (TIFFIsTiled (tiff_document->tiff))
+		TIFFGetField (tiff_document->tiff, TIFFTAG_TILELENGTH, &band_rows);
+	else
+		TIFFGetFieldDefaulted (tiff_document->tiff, TIFFTAG_ROWSPERSTRIP, &band_rows);
+
+	if (!TIFFRGBAImageOK (tiff_document->tiff, emsg) ||
+	    !TIFFRGBAImageBegin (&img, tiff_document->tiff, 0, emsg)) {
+		pop_handlers ();
+		return NULL;
+	}
+	img.req_orientation = ORIENTATION_TOPLEFT;
+
+	/* The scanlines are converted like libtiff does for the
+	 * strips, which needs them in the order they are shown */
+	if (band_rows > TIFF_BAND_MAX_ROWS && (guint32) height > TIFF_BAND_MAX_ROWS &&
+	    !TIFFIsTiled (tiff_document->tiff) &&
+	    img.isContig && img.put.contig != NULL &&
+	    img.orientation == ORIENTATION_TOPLEFT &&
+	    img.photometric != PHOTOMETRIC_YCBCR) {
+		scanline_size = TIFFScanlineSize (tiff_document->tiff);
+		scanlines = g_try_malloc (scanline_size * TIFF_BAND_MAX_ROWS);
+	}
+	band_rows = CLAMP (band_rows, TIFF_BAND_MIN_ROWS, TIFF_BAND_MAX_ROWS);
+	band_rows = MIN (band_rows, (guint32) height);
+
+	band = g_try_malloc ((gsize) width * band_rows * 4);
+	if (!band) {
+		g_free (scanlines);
+		TIFFRGBAImageEnd (&img);
+		pop_handlers ();
+		g_warning("Failed to allocate memory for rendering.");
+		return NULL;
+	}
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					      scaled_width, scaled_height);
+	cairo_surface_flush (surface);
+	data = cairo_image_surface_get_data (surface);
+	stride = cairo_image_surface_get_stride (surface);
+
+	/* The destination column of every source column */
+	columns = g_new (guint, width);
+	column_counts = g_new0 (guint, scaled_width);
+	for (x = 0; x < width; x++) {
+		columns[x] = (guint64) x * scaled_width / width;
+		column_counts[columns[x]]++;
+	}
+	sums = g_new0 (guint64, (gsize) scaled_width * 3);
+
+	for (row = 0; row < (guint32) height; row += band_rows) {
+		guint32 rows = MIN (band_rows, (guint32) height - row);
+		guint32 y;
+
+		if (scanlines) {
+			for (y = 0; y < rows; y++) {
+				if (TIFFReadScanline (tiff_document->tiff,
+						      scanlines + y * scanline_size,
+						      row + y, 0) < 0)
+					break;
+			}
+
+			if (y == rows)
+				img.put.contig (&img, band, 0, row, width, rows, 0, 0, scanlines);
+			else
+				memset (band, 0xff, (gsize) width * rows * 4);
+		} else {
+			img.row_offset = row;
+			img.col_offset = 0;
+			if (!TIFFRGBAImageGet (&img, band, width, rows))
+				memset (band, 0xff, (gsize) width * rows * 4);
+		}
+
+		for (y = 0; y < rows; y++) {
+			guint32 *src = band + (gsize) y * width;
+			int      next_row;
+
+			for (x = 0; x < width; x++) {
+				guint64 *sum = sums + columns[x] * 3;
+
+				sum[0] += TIFFGetR (src[x]);
+				sum[1] += TIFFGetG (src[x]);
+				sum[2] += TIFFGetB (src[x]);
+			}
+			row_count++;
+
+			/* Flush the destination row once all of its source rows are in */
+			next_row = (guint64) (row + y + 1) * scaled_height / height;
+			if (next_row == dest_y)
+				continue;
+
+			for (; dest_y < next_row; dest_y++) {
+				guint32 *dest = (guint32 *) (data + (gsize) dest_y * stride);
+
+				for (x = 0; x < scaled_width; x++) {
+					guint64 *sum = sums + x * 3;
+					guint64  n = (guint64) column_counts[x] * row_count;
+
+					dest[x] = 0xff000000 |
+						(guint32) (sum[0] / n) << 16 |
+						(guint32) (sum[1] / n) << 8 |
+						(guint32) (sum[2] / n);
+				}
+			}
+			memset (sums, 0, (gsize) scaled_width * 3 * sizeof (guint64));
+			row_count = 0;
+		}
+	}
+
+	TIFFRGBAImageEnd (&img);
+	pop_handlers ();
+
+	g_free (sums);
+	g_free (column_counts);
+	g_free (columns);
+	g_free (band);
+	g_free (scanlines);
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+static cairo_surface_t *
+tiff_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
+{
+	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
+	TiffPage *page;
+	int width, height;
+	int scaled_width, scaled_height;
+	float x_res, y_res;
+	int orientation;
+	cairo_surface_t *surface = NULL;
+	cairo_surface_t *rotated_surface;
+	
+	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
+	g_return_val_if_fail (tiff_document->tiff != NULL, NULL);
+  
+	push_handlers ();
+	if (!tiff_document_set_page (tiff_document, rc->page->index)) {
+		pop_handlers ();
+		g_warning("Failed to select page %d", rc->page->index);
+		return NULL;
+	}
+	pop_handlers ();
+
+	page = tiff_document_get_page (tiff_document, rc->page->index);
+	width = page->width;
+	height = page->height;
+	orientation = page->orientation;
+	x_res = page->x_res;
+	y_res = page->y_res;
+  
+	/* Sanity check the doc */
+	if (width <= 0 || height <= 0) {
+		g_warning("Invalid width or height.");
+		return NULL;
 	}
 
 	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
 					       &scaled_width, &scaled_height);
+
+	/* Use a reduced-resolution version of the page if there's one
+	 * large enough */
+	push_handlers ();
+	tiff_document_set_page_level (tiff_document, rc->page->index,
+				      scaled_width, scaled_height * (y_res / x_res),
+				      &width, &height);
+	pop_handlers ();
+
+	/* Shrink the image while reading it, unless it has to be
+	 * flipped, which libtiff only does for whole images */
+	if (orientation == ORIENTATION_TOPLEFT &&
+	    scaled_width > 0 && scaled_height > 0 &&
+	    scaled_width <= width && scaled_height <= height &&
+	    (scaled_width < width || scaled_height < height)) {
+		surface = tiff_document_read_scaled (tiff_document,
+						     width, height,
+						     scaled_width, scaled_height);
+	}
+
+	if (!surface)
+		surface = tiff_document_read_full (tiff_document, width, height, orientation);
+	if (!surface)
+		return NULL;
+
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     scaled_width, scaled_height,
 								     rc->rotation);
@@ -337,6 +697,7 @@ tiff_document_get_thumbnail (EvDocument      *document,
 			     EvRenderContext *rc)
 {
 	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
+	TiffPage *page;
 	int width, height;
 	int scaled_width, scaled_height;
 	float x_res, y_res;
@@ -347,29 +708,33 @@ tiff_document_get_thumbnail (EvDocument      *document,
 	GdkPixbuf *rotated_pixbuf;
 	
 	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, rc->page->index) != 1) {
-		pop_handlers ();
-		return NULL;
-	}
-
-	if (!TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &width)) {
+	if (!tiff_document_set_page (tiff_document, rc->page->index)) {
 		pop_handlers ();
 		return NULL;
 	}
-
-	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &height)) {
-		pop_handlers ();
-		return NULL;
-	}
-
-	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
-	
 	pop_handlers ();
+
+	page = tiff_document_get_page (tiff_document, rc->page->index);
+	width = page->width;
+	height = page->height;
+	x_res = page->x_res;
+	y_res = page->y_res;
   
 	/* Sanity check the doc */
 	if (width <= 0 || height <= 0)
 		return NULL;                
 
+	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
+					       &scaled_width, &scaled_height);
+
+	/* Thumbnails are small, a reduced-resolution version of the
+	 * page is usually enough */
+	push_handlers ();
+	tiff_document_set_page_level (tiff_document, rc->page->index,
+				      scaled_width, scaled_height * (y_res / x_res),
+				      &width, &height);
+	pop_handlers ();
+
 	if (width >= INT_MAX / 4)
 		/* overflow */
 		return NULL;                
@@ -387,17 +752,17 @@ tiff_document_get_thumbnail (EvDocument      *document,
 	pixbuf = gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB, TRUE, 8, 
 					   width, height, rowstride,
 					   (GdkPixbufDestroyNotify) g_free, NULL);
+	push_handlers ();
 	TIFFReadRGBAImageOriented (tiff_document->tiff,
 				   width, height,
 				   (uint32 *)pixels,
 				   ORIENTATION_TOPLEFT, 0);
 	pop_handlers ();
 
-	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
-					       &scaled_width, &scaled_height);
 	scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
 						 scaled_width, scaled_height,
-						 GDK_INTERP_BILINEAR);
+						 ev_render_context_get_draft (rc) ?
+						 GDK_INTERP_TILES : GDK_INTERP_BILINEAR);
 	g_object_unref (pixbuf);
 	
 	rotated_pixbuf = gdk_pixbuf_rotate_simple (scaled_pixbuf, 360 - rc->rotation);
@@ -406,6 +771,17 @@ tiff_document_get_thumbnail (EvDocument      *document,
 	return rotated_pixbuf;
 }
 
+static EvPageColorMode
+tiff_document_get_page_color_mode (EvDocument *document,
+				   EvPage     *page)
+{
+	TiffPage *tiff_page;
+
+	tiff_page = tiff_document_get_page (TIFF_DOCUMENT (document), page->index);
+
+	return tiff_page ? tiff_page->color_mode : EV_PAGE_COLOR_MODE_COLOR;
+}
+
 static gchar *
 tiff_document_get_page_label (EvDocument *document,
 			      EvPage     *page)
@@ -430,6 +806,13 @@ tiff_document_finalize (GObject *object)
 		TIFFClose (tiff_document->tiff);
 	if (tiff_document->uri)
 		g_free (tiff_document->uri);
+	if (tiff_document->pages) {
+		guint i;
+
+		for (i = 0; i < tiff_document->pages->len; i++)
+			g_array_free (g_array_index (tiff_document->pages, TiffPage, i).levels, TRUE);
+		g_array_free (tiff_document->pages, TRUE);
+	}
 
 	G_OBJECT_CLASS (tiff_document_parent_class)->finalize (object);
 }
@@ -449,6 +832,7 @@ tiff_document_class_init (TiffDocumentClass *klass)
 	ev_document_class->render = tiff_document_render;
 	ev_document_class->get_thumbnail = tiff_document_get_thumbnail;
 	ev_document_class->get_page_label = tiff_document_get_page_label;
+	ev_document_class->get_page_color_mode = tiff_document_get_page_color_mode;
 }
 
 /* postscript exporter implementation */
@@ -468,7 +852,7 @@ tiff_document_file_exporter_do_page (EvFileExporter *exporter, EvRenderContext *
 
 	if (document->ps_export_ctx == NULL)
 		return;
-	if (TIFFSetDirectory (document->tiff, rc->page->index) != 1)
+	if (!tiff_document_set_page (document, rc->page->index))
 		return;
 	tiff2ps_process_page (document->ps_export_ctx, document->tiff,
 			      0, 0, 0, 0, 0);
@@ -165,6 +165,8 @@ static void PSTail(TIFF2PSContext*);
 #if defined( EXP_ASCII85ENCODER )
 static int Ascii85EncodeBlock(TIFF2PSContext*, uint8 * ascii85_p,
 			      unsigned f_eod, const uint8 * raw_p, int raw_l);
+static void Ascii85Write(TIFF2PSContext*, const uint8 *, tsize_t);
+static void Ascii85End(TIFF2PSContext*);
 #endif
 
 #define IMAGEOP(ctx) ((ctx)->useImagemask && ((ctx)->bitspersample == 1)) ? "imagemask" : "image"
@@ -182,6 +184,11 @@ TIFF2PSContext* tiff2ps_context_new(const gchar *filename) {
 	}
 	ctx->interpolate = TRUE;     /* interpolate level2 image */
 	ctx->PSavoiddeadzone = TRUE; /* enable avoiding printer deadzone */
+	/* Level 2 and 3 output streams each strip, compressed strips
+	 * are copied as they are and decoded by the printer */
+	ctx->level2 = TRUE;
+	ctx->level3 = TRUE;
+	ctx->ascii85 = TRUE;
 	return ctx;
 }
 
@@ -444,7 +451,7 @@ PlaceImage(TIFF2PSContext *ctx, double pagewidth, double pageheight,
 		g_ascii_dtostr(buf[0], sizeof(buf[0]), xscale),
 		g_ascii_dtostr(buf[1], sizeof(buf[1]), yscale));
 	if (ctx->rotate)
-		fputs ("1 1 translate 180 ctx->rotate\n", ctx->fd);
+		fputs ("1 1 translate 180 rotate\n", ctx->fd);
 
 	return splitpage;
 }
@@ -576,14 +583,14 @@ tiff2ps_process_page(TIFF2PSContext* ctx, TIFF* tif, double pw, double ph,
 					g_ascii_dtostr(buf[0], sizeof(buf[0]), prw * scale),
 					g_ascii_dtostr(buf[1], sizeof(buf[1]), prh * scale));
 				if (ctx->rotate)
-					fputs ("1 1 translate 180 ctx->rotate\n", ctx->fd);
+					fputs ("1 1 translate 180 rotate\n", ctx->fd);
 			}
 		} else {
 			fprintf(ctx->fd, "%s %s scale\n",
 				g_ascii_dtostr(buf[0], sizeof(buf[0]), prw),
 				g_ascii_dtostr(buf[1], sizeof(buf[1]), prh));
 			if (ctx->rotate)
-				fputs ("1 1 translate 180 ctx->rotate\n", ctx->fd);
+				fputs ("1 1 translate 180 rotate\n", ctx->fd);
 		}
 		PSpage(ctx, tif, w, h);
 		fprintf(ctx->fd, "end\n");
@@ -843,7 +850,7 @@ PS_Lvl2ImageDict(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 	fprintf(ctx->fd, "  /ImageMatrix [ %lu 0 0 %ld %s %s ]\n",
 	    (unsigned long) w, - (long)h, im_x, im_y);
 	fprintf(ctx->fd, "  /BitsPerComponent %d\n", ctx->bitspersample);
-	fprintf(ctx->fd, "  /Ctx->Interpolate %s\n", ctx->interpolate ? "true" : "false");
+	fprintf(ctx->fd, "  /Interpolate %s\n", ctx->interpolate ? "true" : "false");
 
 	switch (ctx->samplesperpixel - ctx->extrasamples) {
 	case 1:
@@ -1094,11 +1101,6 @@ PS_Lvl2page(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 	unsigned char *buf_data, *cp;
 	tsize_t chunk_size, byte_count;
 
-#if defined( EXP_ASCII85ENCODER )
-	int			ascii85_l;	/* Length, in bytes, of ascii85_p[] data */
-	uint8		*	ascii85_p = 0;	/* Holds ASCII85 encoded data */
-#endif
-
 	PS_Lvl2colorspace(ctx, tif);
 	use_rawdata = PS_Lvl2ImageDict(ctx, tif, w, h);
 
@@ -1135,29 +1137,6 @@ PS_Lvl2page(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 		return(FALSE);
 	}
 
-#if defined( EXP_ASCII85ENCODER )
-	if ( ctx->ascii85 ) {
-	    /*
-	     * Allocate a buffer to hold the ASCII85 encoded data.  Note
-	     * that it is allocated with sufficient room to hold the
-	     * encoded data (5*chunk_size/4) plus the EOD marker (+8)
-	     * and formatting line breaks.  The line breaks are more
-	     * than taken care of by using 6*chunk_size/4 rather than
-	     * 5*chunk_size/4.
-	     */
-
-	    ascii85_p = _TIFFmalloc( (chunk_size+(chunk_size/2)) + 8 );
-
-	    if ( !ascii85_p ) {
-		_TIFFfree( buf_data );
-
-		TIFFError( ctx->filename,
-			   "Cannot allocate ASCII85 encoding buffer." );
-		return ( FALSE );
-	    }
-	}
-#endif
-
 	TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &fillorder);
 	for (chunk_no = 0; chunk_no < num_chunks; chunk_no++) {
 		if (ctx->ascii85)
@@ -1221,11 +1200,9 @@ PS_Lvl2page(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 
 		if (ctx->ascii85) {
 #if defined( EXP_ASCII85ENCODER )
-			ascii85_l = Ascii85EncodeBlock(ctx, ascii85_p, 1,
-						       buf_data, byte_count);
-
-			if ( ascii85_l > 0 )
-				fwrite( ascii85_p, ascii85_l, 1, ctx->fd );
+			if (byte_count > 0)
+				Ascii85Write(ctx, buf_data, byte_count);
+			Ascii85End(ctx);
 #else
 			for (cp = buf_data; byte_count > 0; byte_count--)
 				Ascii85Put(ctx, *cp++);
@@ -1256,10 +1233,6 @@ PS_Lvl2page(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 #endif
 	}
 
-#if defined( EXP_ASCII85ENCODER )
-	if ( ascii85_p )
-	    _TIFFfree( ascii85_p );
-#endif
 	_TIFFfree(buf_data);
 #ifdef ENABLE_BROKEN_BEGINENDDATA
 	fputs("%%EndData\n", ctx->fd);
@@ -1535,41 +1508,13 @@ PSDataBW(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 	tsize_t stripsize = TIFFStripSize(tif);
 	tstrip_t s;
 
-#if defined( EXP_ASCII85ENCODER )
-	int	ascii85_l;		/* Length, in bytes, of ascii85_p[] data */
-	uint8	*ascii85_p = 0;		/* Holds ASCII85 encoded data */
-#endif
-
 	(void) w; (void) h;
 	tf_buf = (unsigned char *) _TIFFmalloc(stripsize);
-        memset(tf_buf, 0, stripsize);
 	if (tf_buf == NULL) {
 		TIFFError(ctx->filename, "No space for scanline buffer");
 		return;
 	}
-
-#if defined( EXP_ASCII85ENCODER )
-	if ( ctx->ascii85 ) {
-	    /*
-	     * Allocate a buffer to hold the ASCII85 encoded data.  Note
-	     * that it is allocated with sufficient room to hold the
-	     * encoded data (5*stripsize/4) plus the EOD marker (+8)
-	     * and formatting line breaks.  The line breaks are more
-	     * than taken care of by using 6*stripsize/4 rather than
-	     * 5*stripsize/4.
-	     */
-
-	    ascii85_p = _TIFFmalloc( (stripsize+(stripsize/2)) + 8 );
-
-	    if ( !ascii85_p ) {
-		_TIFFfree( tf_buf );
-
-		TIFFError( ctx->filename,
-			   "Cannot allocate ASCII85 encoding buffer." );
-		return;
-	    }
-	}
-#endif
+        memset(tf_buf, 0, stripsize);
 
 	if (ctx->ascii85)
 		Ascii85Init(ctx);
@@ -1597,11 +1542,7 @@ PSDataBW(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 				cc /= 2;
 			}
 
-			ascii85_l = Ascii85EncodeBlock(ctx, ascii85_p, 1, cp,
-						       cc);
-
-			if ( ascii85_l > 0 )
-			    fwrite( ascii85_p, ascii85_l, 1, ctx->fd );
+			Ascii85Write(ctx, cp, cc);
 #else
 			while (cc-- > 0)
 				Ascii85Put(ctx, *cp++);
@@ -1642,8 +1583,8 @@ PSDataBW(TIFF2PSContext* ctx, TIFF* tif, uint32 w, uint32 h)
 	else
 	    Ascii85Flush(ctx);
 #else
-	if ( ascii85_p )
-	    _TIFFfree( ascii85_p );
+	else
+	    Ascii85End(ctx);
 #endif
 
 	_TIFFfree(tf_buf);
@@ -1865,6 +1806,60 @@ int Ascii85EncodeBlock( TIFF2PSContext *ctx, uint8 * ascii85_p,
 
 }   /* Ascii85EncodeBlock() */
 
+/* Bytes encoded at a time by Ascii85Write(), a multiple of 4 */
+#define A85CHUNKLEN     4096
+
+/*
+ * Encodes raw_l bytes of raw_p through a fixed size buffer, so that
+ * memory use doesn't grow with the size of the strips.  Up to 3 bytes
+ * are kept in ctx->ascii85buf until more data or Ascii85End().
+ */
+static void
+Ascii85Write(TIFF2PSContext *ctx, const uint8 *raw_p, tsize_t raw_l)
+{
+	uint8 ascii85_p[6 * (A85CHUNKLEN / 4) + 8];
+	int ascii85_l;
+
+	while (ctx->ascii85count > 0 && ctx->ascii85count < 4 && raw_l > 0) {
+		ctx->ascii85buf[ctx->ascii85count++] = *raw_p++;
+		raw_l--;
+	}
+	if (ctx->ascii85count == 4) {
+		ascii85_l = Ascii85EncodeBlock(ctx, ascii85_p, 0,
+					       ctx->ascii85buf, 4);
+		fwrite(ascii85_p, ascii85_l, 1, ctx->fd);
+		ctx->ascii85count = 0;
+	}
+
+	while (raw_l >= 4) {
+		int len = raw_l > A85CHUNKLEN ? A85CHUNKLEN : (int) (raw_l & ~3);
+
+		ascii85_l = Ascii85EncodeBlock(ctx, ascii85_p, 0, raw_p, len);
+		fwrite(ascii85_p, ascii85_l, 1, ctx->fd);
+		raw_p += len;
+		raw_l -= len;
+	}
+
+	while (raw_l-- > 0)
+		ctx->ascii85buf[ctx->ascii85count++] = *raw_p++;
+}
+
+/*
+ * Encodes the bytes left by Ascii85Write() and ends the data with an
+ * End-Of-Data marker.
+ */
+static void
+Ascii85End(TIFF2PSContext *ctx)
+{
+	uint8 ascii85_p[16];
+	int ascii85_l;
+
+	ascii85_l = Ascii85EncodeBlock(ctx, ascii85_p, 1,
+				       ctx->ascii85buf, ctx->ascii85count);
+	fwrite(ascii85_p, ascii85_l, 1, ctx->fd);
+	ctx->ascii85count = 0;
+}
+
 #endif	/* EXP_ASCII85ENCODER */
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
@@ -26,6 +26,7 @@
 #include "ev-document-links.h"
 #include "ev-document-print.h"
 #include "ev-document-misc.h"
+#include "ev-surface-pool.h"
 
 struct _XPSDocument {
 	EvDocument    object;
@@ -33,6 +34,13 @@ struct _XPSDocument {
 	GFile        *file;
 	GXPSFile     *xps;
 	GXPSDocument *doc;
+
+	/* Parsed once, see xps_document_get_structure() */
+	GXPSDocumentStructure *structure;
+	gboolean               structure_loaded;
+
+	/* Links of the pages, by page index */
+	GHashTable   *links;
 };
 
 struct _XPSDocumentClass {
@@ -76,6 +84,9 @@ xps_document_dispose (GObject *object)
 		xps->doc = NULL;
 	}
 
+	g_clear_object (&xps->structure);
+	g_clear_pointer (&xps->links, g_hash_table_destroy);
+
 	G_OBJECT_CLASS (xps_document_parent_class)->dispose (object);
 }
 
@@ -204,6 +215,7 @@ xps_document_render (EvDocument      *document,
 	gdouble          page_width, page_height;
 	gint             width, height;
 	double           scale_x, scale_y;
+	cairo_rectangle_int_t area;
 	cairo_surface_t *surface;
 	cairo_t         *cr;
 	GError          *error = NULL;
@@ -214,12 +226,21 @@ xps_document_render (EvDocument      *document,
 	ev_render_context_compute_transformed_size (rc, page_width, page_height,
                                                     &width, &height);
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-					      width, height);
-	cr = cairo_create (surface);
-
-	cairo_set_source_rgb (cr, 1., 1., 1.);
-	cairo_paint (cr);
+	/* Only the area is drawn, the surface clips the rest */
+	if (ev_render_context_get_area (rc, &area)) {
+		surface = ev_surface_pool_create_surface (CAIRO_FORMAT_ARGB32,
+							  area.width, area.height);
+		cr = cairo_create (surface);
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_paint (cr);
+		cairo_translate (cr, -area.x, -area.y);
+	} else {
+		surface = ev_surface_pool_create_surface (CAIRO_FORMAT_ARGB32,
+							  width, height);
+		cr = cairo_create (surface);
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_paint (cr);
+	}
 
 	switch (rc->rotation) {
 	case 90:
@@ -240,6 +261,8 @@ xps_document_render (EvDocument      *document,
 	cairo_scale (cr, scale_x, scale_y);
 
 	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
+	if (ev_render_context_get_draft (rc))
+		cairo_set_antialias (cr, CAIRO_ANTIALIAS_FAST);
 	gxps_page_render (xps_page, cr, &error);
 	cairo_destroy (cr);
 
@@ -252,6 +275,12 @@ xps_document_render (EvDocument      *document,
 	return surface;
 }
 
+static gboolean
+xps_document_can_render_area (EvDocument *document)
+{
+	return TRUE;
+}
+
 static void
 xps_document_class_init (XPSDocumentClass *klass)
 {
@@ -268,24 +297,35 @@ xps_document_class_init (XPSDocumentClass *klass)
 	ev_document_class->get_info = xps_document_get_info;
 	ev_document_class->get_backend_info = xps_document_get_backend_info;
 	ev_document_class->render = xps_document_render;
+	ev_document_class->can_render_area = xps_document_can_render_area;
 }
 
 /* EvDocumentLinks */
+
+/* The document structure is parsed from its part every time it's
+ * asked for, so it's kept once parsed */
+static GXPSDocumentStructure *
+xps_document_get_structure (XPSDocument *xps_document)
+{
+	if (!xps_document->structure_loaded) {
+		xps_document->structure = gxps_document_get_structure (xps_document->doc);
+		xps_document->structure_loaded = TRUE;
+	}
+
+	return xps_document->structure;
+}
+
 static gboolean
 xps_document_links_has_document_links (EvDocumentLinks *document_links)
 {
 	XPSDocument           *xps_document = XPS_DOCUMENT (document_links);
 	GXPSDocumentStructure *structure;
-	gboolean               retval;
 
-	structure = gxps_document_get_structure (xps_document->doc);
+	structure = xps_document_get_structure (xps_document);
 	if (!structure)
 		return FALSE;
 
-	retval = gxps_document_structure_has_outline (structure);
-	g_object_unref (structure);
-
-	return retval;
+	return gxps_document_structure_has_outline (structure);
 }
 
 static EvLinkAction *
@@ -340,6 +380,42 @@ link_action_from_target (XPSDocument    *xps_document,
         return ev_action;
 }
 
+/* XPS outlines have no open items, so only the top level items are
+ * added to the links model at first. Every item with children gets a
+ * child without a link instead, and the outline iter of its children is
+ * kept in a table, by path, until it's expanded. The iters point into
+ * the document structure, so the model keeps a reference to it.
+ */
+#define XPS_LINKS_CHILDREN_KEY "xps-document-links-children"
+
+static void
+free_outline_iter (GXPSOutlineIter *iter)
+{
+	g_slice_free (GXPSOutlineIter, iter);
+}
+
+static void
+add_links_children_placeholder (GtkTreeModel    *model,
+				GtkTreeIter     *parent,
+				GXPSOutlineIter *children)
+{
+	GHashTable *table;
+	GtkTreeIter placeholder;
+
+	table = g_object_get_data (G_OBJECT (model), XPS_LINKS_CHILDREN_KEY);
+	if (!table) {
+		table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					       (GDestroyNotify) free_outline_iter);
+		g_object_set_data_full (G_OBJECT (model), XPS_LINKS_CHILDREN_KEY, table,
+					(GDestroyNotify) g_hash_table_destroy);
+	}
+
+	gtk_tree_store_append (GTK_TREE_STORE (model), &placeholder, parent);
+	g_hash_table_insert (table,
+			     gtk_tree_model_get_string_from_iter (model, parent),
+			     g_slice_dup (GXPSOutlineIter, children));
+}
+
 static void
 build_tree (XPSDocument     *xps_document,
 	    GtkTreeModel    *model,
@@ -371,7 +447,7 @@ build_tree (XPSDocument     *xps_document,
 		g_free (title);
 
 		if (gxps_outline_iter_children (&child_iter, iter))
-			build_tree (xps_document, model, &tree_iter, &child_iter);
+			add_links_children_placeholder (model, &tree_iter, &child_iter);
 	} while (gxps_outline_iter_next (iter));
 }
 
@@ -383,7 +459,7 @@ xps_document_links_get_links_model (EvDocumentLinks *document_links)
 	GXPSOutlineIter        iter;
 	GtkTreeModel          *model = NULL;
 
-	structure = gxps_document_get_structure (xps_document->doc);
+	structure = xps_document_get_structure (xps_document);
 	if (!structure)
 		return NULL;
 
@@ -393,11 +469,11 @@ xps_document_links_get_links_model (EvDocumentLinks *document_links)
 							     G_TYPE_OBJECT,
 							     G_TYPE_BOOLEAN,
 							     G_TYPE_STRING);
+		g_object_set_data_full (G_OBJECT (model), "xps-document-structure",
+					g_object_ref (structure), g_object_unref);
 		build_tree (xps_document, model, NULL, &iter);
 	}
 
-	g_object_unref (structure);
-
 	return model;
 }
 
@@ -405,11 +481,19 @@ static EvMappingList *
 xps_document_links_get_links (EvDocumentLinks *document_links,
 			      EvPage          *page)
 {
-	XPSDocument *xps_document = XPS_DOCUMENT (document_links);
-	GXPSPage    *xps_page;
-	GList       *retval = NULL;
-	GList       *mapping_list;
-	GList       *list;
+	XPSDocument   *xps_document = XPS_DOCUMENT (document_links);
+	GXPSPage      *xps_page;
+	EvMappingList *links;
+	GList         *retval = NULL;
+	GList         *mapping_list;
+	GList         *list;
+
+	if (xps_document->links) {
+		links = g_hash_table_lookup (xps_document->links,
+					     GINT_TO_POINTER (page->index));
+		if (links)
+			return ev_mapping_list_ref (links);
+	}
 
 	xps_page = GXPS_PAGE (page->backend_page);
 	mapping_list = gxps_page_get_links (xps_page, NULL);
@@ -440,7 +524,19 @@ xps_document_links_get_links (EvDocumentLinks *document_links,
 
 	g_list_free (mapping_list);
 
-	return ev_mapping_list_new (page->index, g_list_reverse (retval), (GDestroyNotify)g_object_unref);
+	if (!xps_document->links) {
+		xps_document->links = g_hash_table_new_full (g_direct_hash,
+							     g_direct_equal,
+							     NULL,
+							     (GDestroyNotify)ev_mapping_list_unref);
+	}
+
+	links = ev_mapping_list_new (page->index, g_list_reverse (retval), (GDestroyNotify)g_object_unref);
+	g_hash_table_insert (xps_document->links,
+			     GINT_TO_POINTER (page->index),
+			     ev_mapping_list_ref (links));
+
+	return links;
 }
 
 static EvLinkDest *
@@ -478,6 +574,36 @@ xps_document_links_find_link_page (EvDocumentLinks *document_links,
 	return gxps_document_get_page_for_anchor (xps_document->doc, link_name);
 }
 
+static void
+xps_document_links_load_links_children (EvDocumentLinks *document_links,
+					GtkTreeModel    *model,
+					GtkTreeIter     *parent)
+{
+	XPSDocument     *xps_document = XPS_DOCUMENT (document_links);
+	GHashTable      *table;
+	GXPSOutlineIter *children;
+	GtkTreeIter      placeholder;
+	gchar           *path;
+
+	table = g_object_get_data (G_OBJECT (model), XPS_LINKS_CHILDREN_KEY);
+	if (!table)
+		return;
+
+	path = gtk_tree_model_get_string_from_iter (model, parent);
+	children = g_hash_table_lookup (table, path);
+	if (!children) {
+		g_free (path);
+		return;
+	}
+
+	if (gtk_tree_model_iter_children (model, &placeholder, parent))
+		gtk_tree_store_remove (GTK_TREE_STORE (model), &placeholder);
+	build_tree (xps_document, model, parent, children);
+
+	g_hash_table_remove (table, path);
+	g_free (path);
+}
+
 static void
 xps_document_document_links_iface_init (EvDocumentLinksInterface *iface)
 {
@@ -486,6 +612,7 @@ xps_document_document_links_iface_init (EvDocumentLinksInterface *iface)
 	iface->get_links = xps_document_links_get_links;
 	iface->find_link_dest = xps_document_links_find_link_dest;
 	iface->find_link_page = xps_document_links_find_link_page;
+	iface->load_links_children = xps_document_links_load_links_children;
 }
 
 /* EvDocumentPrint */
@@ -71,6 +71,12 @@ struct EvBrowserPluginClass {
         NPIdentifier propertyIdentifiers[NumPropertyIdentifiers];
 };
 
+// Share of the worker threads given to the instances shown in the
+// viewport, and the pages kept rendered by the hidden ones. Instances
+// in the same page share the worker threads and the surface budget.
+static const guint visibleJobWeight = 4;
+static const gsize hiddenPageCacheLimit = 2 * 1024 * 1024;
+
 EvBrowserPlugin *EvBrowserPlugin::create(NPP instance)
 {
         return s_pluginClass.createObject(instance);
@@ -92,12 +98,20 @@ EvBrowserPlugin::EvBrowserPlugin(NPP instance)
         , m_model(nullptr)
         , m_view(nullptr)
         , m_toolbar(nullptr)
+        , m_stream(nullptr)
+        , m_documentStream(nullptr)
+        , m_requestedDocument(false)
+        , m_loadJob(nullptr)
+        , m_visible(true)
 {
         m_NPP->pdata = this;
 }
 
 EvBrowserPlugin::~EvBrowserPlugin()
 {
+        cancelLoad();
+        if (m_view)
+                ev_job_scheduler_set_client_weight(m_view, 0);
         if (m_window)
                 gtk_widget_destroy(m_window);
         g_clear_object(&m_model);
@@ -203,6 +217,7 @@ NPError EvBrowserPlugin::initialize(NPMIMEType, uint16_t mode, int16_t argc, cha
 
         m_view = EV_VIEW(ev_view_new());
         ev_view_set_model(m_view, m_model);
+        ev_job_scheduler_set_client_weight(m_view, visibleJobWeight);
 
         m_toolbar = ev_browser_plugin_toolbar_new(this);
         if (toolbarVisible)
@@ -234,50 +249,141 @@ NPError EvBrowserPlugin::setWindow(NPWindow *window)
         gtk_widget_set_size_request(m_window, window->width, window->height);
         gtk_widget_show(m_window);
 
+        // The browser clips the window to the part shown in the viewport.
+        setVisible(window->clipRect.right > window->clipRect.left && window->clipRect.bottom > window->clipRect.top);
+
         return NPERR_NO_ERROR;
 }
 
-NPError EvBrowserPlugin::newStream(NPMIMEType, NPStream *stream, NPBool seekable, uint16_t *stype)
+void EvBrowserPlugin::setVisible(bool visible)
 {
-        m_url.reset(g_strdup(stream->url));
-        *stype = NP_ASFILEONLY;
-        return NPERR_NO_ERROR;
+        if (m_visible == visible)
+                return;
+
+        m_visible = visible;
+        ev_job_scheduler_set_client_weight(m_view, visible ? visibleJobWeight : 0);
+        ev_view_set_page_cache_limit(m_view, visible ? 0 : hiddenPageCacheLimit);
+}
+
+// Size of the byte range requested when the document reads data that
+// hasn't been downloaded yet.
+static const uint32_t rangeRequestSize = 256 * 1024;
+
+void EvBrowserPlugin::cancelLoad()
+{
+        if (m_loadJob) {
+                g_signal_handlers_disconnect_by_data(m_loadJob, this);
+                ev_job_cancel(m_loadJob);
+                g_clear_object(&m_loadJob);
+                if (m_view)
+                        ev_view_set_loading(m_view, FALSE);
+        }
+
+        if (m_documentStream) {
+                g_signal_handlers_disconnect_by_data(m_documentStream, this);
+                // Wake up the document if it's waiting for data, the
+                // browser won't send anything else.
+                ev_browser_plugin_stream_finish(m_documentStream, nullptr);
+                g_clear_object(&m_documentStream);
+        }
+
+        m_stream = nullptr;
+        m_requestedDocument = false;
+}
+
+void EvBrowserPlugin::dataNeeded(EvBrowserPluginStream *, gint64 offset, EvBrowserPlugin *plugin)
+{
+        NPStream *stream = plugin->m_stream;
+        if (!stream || offset < 0 || offset >= stream->end)
+                return;
+
+        // Ask first for the data the document is waiting for, then for
+        // the whole document, so that it's all there eventually.
+        NPByteRange documentRange = { 0, stream->end, nullptr };
+        NPByteRange range = { static_cast<int32_t>(offset),
+                              MIN(rangeRequestSize, static_cast<uint32_t>(stream->end - offset)),
+                              plugin->m_requestedDocument ? nullptr : &documentRange };
+        if (NPN_RequestRead(stream, &range) == NPERR_NO_ERROR)
+                plugin->m_requestedDocument = true;
+}
+
+void EvBrowserPlugin::loadJobFinished(EvJob *job, EvBrowserPlugin *plugin)
+{
+        if (ev_job_is_failed(job))
+                g_printerr("Error loading document %s: %s\n", plugin->m_url.get(), job->error->message);
+        else
+                ev_document_model_set_document(plugin->m_model, job->document);
+        ev_view_set_loading(plugin->m_view, FALSE);
+
+        g_signal_handlers_disconnect_by_data(job, plugin);
+        g_clear_object(&plugin->m_loadJob);
 }
 
-NPError EvBrowserPlugin::destroyStream(NPStream *, NPReason)
+NPError EvBrowserPlugin::newStream(NPMIMEType mimeType, NPStream *stream, NPBool seekable, uint16_t *stype)
 {
+        cancelLoad();
+
+        m_url.reset(g_strdup(stream->url));
+        m_stream = stream;
+
+        // The document is loaded while it's downloaded, from a stream that
+        // waits for the data it reads. When the server supports byte range
+        // requests the document asks for the parts it needs first, so that,
+        // for linearized documents, the first page is shown right away.
+        m_documentStream = EV_BROWSER_PLUGIN_STREAM(ev_browser_plugin_stream_new(stream->end));
+        if (seekable && stream->end > 0) {
+                g_signal_connect(m_documentStream, "data-needed", G_CALLBACK(dataNeeded), this);
+                *stype = NP_SEEK;
+        } else
+                *stype = NP_NORMAL;
+
+        m_loadJob = ev_job_load_stream_new(G_INPUT_STREAM(m_documentStream), EV_DOCUMENT_LOAD_FLAG_NONE);
+        ev_job_load_stream_set_mime_type(EV_JOB_LOAD_STREAM(m_loadJob), mimeType);
+        g_signal_connect(m_loadJob, "finished", G_CALLBACK(loadJobFinished), this);
+        ev_job_scheduler_push_job(m_loadJob, EV_JOB_PRIORITY_NONE);
+
+        // Nothing is blocked meanwhile, show that the document is coming.
+        ev_view_set_loading(m_view, TRUE);
+
         return NPERR_NO_ERROR;
 }
 
-void EvBrowserPlugin::streamAsFile(NPStream *, const char *fname)
+NPError EvBrowserPlugin::destroyStream(NPStream *stream, NPReason reason)
 {
-        GFile *file = g_file_new_for_commandline_arg(fname);
-        unique_gptr<char> uri(g_file_get_uri(file));
-        g_object_unref(file);
+        if (stream != m_stream)
+                return NPERR_NO_ERROR;
 
-        // Load the document synchronously here because the temporary file created by the browser
-        // is deleted when this function returns.
         GError *error = nullptr;
-        EvDocument *document = ev_document_factory_get_document(uri.get(), &error);
-        if (!document) {
-                g_printerr("Error loading document %s: %s\n", uri.get(), error->message);
+        if (reason != NPRES_DONE)
+                g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_FAILED, "The document could not be downloaded");
+        ev_browser_plugin_stream_finish(m_documentStream, error);
+        if (error)
                 g_error_free(error);
-        } else {
-                ev_document_model_set_document(m_model, document);
-                g_object_unref(document);
 
-                ev_view_set_loading(EV_VIEW(m_view), FALSE);
-        }
+        m_stream = nullptr;
+
+        return NPERR_NO_ERROR;
 }
 
-int32_t EvBrowserPlugin::writeReady(NPStream *)
+void EvBrowserPlugin::streamAsFile(NPStream *, const char *)
 {
-        return 0;
+        // Documents are streamed, see newStream().
 }
 
-int32_t EvBrowserPlugin::write(NPStream *, int32_t /*offset*/, int32_t /*len*/, void */*buffer*/)
+int32_t EvBrowserPlugin::writeReady(NPStream *stream)
 {
-        return 0;
+        // The whole document is kept in memory, any amount of data can be taken.
+        return stream == m_stream ? std::numeric_limits<int32_t>::max() : -1;
+}
+
+int32_t EvBrowserPlugin::write(NPStream *stream, int32_t offset, int32_t len, void *buffer)
+{
+        if (stream != m_stream)
+                return -1;
+
+        ev_browser_plugin_stream_write(m_documentStream, offset, buffer, len);
+
+        return len;
 }
 
 void EvBrowserPlugin::print(NPPrint *)
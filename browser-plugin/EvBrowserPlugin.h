@@ -21,6 +21,7 @@
 
 #include <evince-document.h>
 #include <evince-view.h>
+#include "EvBrowserPluginStream.h"
 #include "EvMemoryUtils.h"
 #include "npapi.h"
 #include "npruntime.h"
@@ -96,12 +97,24 @@ private:
         static bool getProperty(NPObject *, NPIdentifier name, NPVariant *);
         static bool setProperty(NPObject *, NPIdentifier name, const NPVariant *);
 
+        // Document loading
+        static void dataNeeded(EvBrowserPluginStream *, gint64 offset, EvBrowserPlugin *);
+        static void loadJobFinished(EvJob *, EvBrowserPlugin *);
+        void cancelLoad();
+
+        void setVisible(bool);
+
         NPP m_NPP;
         GtkWidget *m_window;
         EvDocumentModel *m_model;
         EvView *m_view;
         GtkWidget *m_toolbar;
         unique_gptr<char> m_url;
+        NPStream *m_stream;
+        EvBrowserPluginStream *m_documentStream;
+        bool m_requestedDocument;
+        EvJob *m_loadJob;
+        bool m_visible;
 
         static EvBrowserPluginClass s_pluginClass;
 };
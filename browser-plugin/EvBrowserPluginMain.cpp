@@ -335,6 +335,11 @@ NPError NPN_GetURL(NPP instance, const char* url, const char* target)
         return browser->geturl(instance, url, target);
 }
 
+NPError NPN_RequestRead(NPStream *stream, NPByteRange *rangeList)
+{
+        return browser->requestread(stream, rangeList);
+}
+
 const char *NPN_UserAgent(NPP instance)
 {
         return browser->uagent(instance);
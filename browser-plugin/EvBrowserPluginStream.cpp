@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2014 Igalia S.L.
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+#include "EvBrowserPluginStream.h"
+
+#include <string.h>
+
+// A stream of the document as the browser downloads it. Reads, done by
+// the document in a thread, wait for the data to be written by the
+// browser in the main thread. When the length is known the data can
+// arrive in any order, from byte range requests, and reads of data not
+// received yet emit data-needed so that it's requested.
+
+enum {
+        DATA_NEEDED,
+
+        N_SIGNALS
+};
+
+struct Range {
+        goffset start;
+        goffset end;
+};
+
+struct _EvBrowserPluginStreamPrivate {
+        GMutex mutex;
+        GCond cond;
+
+        GByteArray *data;
+        GArray *ranges;
+        goffset length;
+        goffset position;
+
+        bool finished;
+        GError *error;
+
+        goffset requestedOffset;
+        guint dataNeededSourceID;
+};
+
+static guint signals[N_SIGNALS];
+
+static void ev_browser_plugin_stream_seekable_iface_init(GSeekableIface *);
+
+G_DEFINE_TYPE_WITH_CODE(EvBrowserPluginStream, ev_browser_plugin_stream, G_TYPE_INPUT_STREAM,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_SEEKABLE, ev_browser_plugin_stream_seekable_iface_init))
+
+static gboolean emitDataNeeded(EvBrowserPluginStream *stream)
+{
+        g_mutex_lock(&stream->priv->mutex);
+        goffset offset = stream->priv->requestedOffset;
+        stream->priv->dataNeededSourceID = 0;
+        g_mutex_unlock(&stream->priv->mutex);
+
+        g_signal_emit(stream, signals[DATA_NEEDED], 0, static_cast<gint64>(offset));
+
+        return FALSE;
+}
+
+// Must be called with the mutex held.
+static void requestData(EvBrowserPluginStream *stream, goffset offset)
+{
+        EvBrowserPluginStreamPrivate *priv = stream->priv;
+
+        if (priv->length < 0 || offset == priv->requestedOffset)
+                return;
+
+        priv->requestedOffset = offset;
+        if (!priv->dataNeededSourceID) {
+                priv->dataNeededSourceID = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                                           reinterpret_cast<GSourceFunc>(emitDataNeeded),
+                                                           g_object_ref(stream),
+                                                           g_object_unref);
+        }
+}
+
+// Must be called with the mutex held.
+static gsize availableAt(EvBrowserPluginStreamPrivate *priv, goffset offset)
+{
+        for (guint i = 0; i < priv->ranges->len; ++i) {
+                const Range &range = g_array_index(priv->ranges, Range, i);
+                if (offset < range.start)
+                        break;
+                if (offset < range.end)
+                        return range.end - offset;
+        }
+
+        return 0;
+}
+
+static void addRange(EvBrowserPluginStreamPrivate *priv, goffset start, goffset end)
+{
+        guint i = 0;
+
+        // Merge the ranges it touches, keeping them sorted.
+        while (i < priv->ranges->len) {
+                Range &range = g_array_index(priv->ranges, Range, i);
+                if (range.end < start) {
+                        ++i;
+                        continue;
+                }
+                if (range.start > end)
+                        break;
+
+                start = MIN(start, range.start);
+                end = MAX(end, range.end);
+                g_array_remove_index(priv->ranges, i);
+        }
+
+        Range range = { start, end };
+        g_array_insert_val(priv->ranges, i, range);
+}
+
+static void cancelled(GCancellable *, EvBrowserPluginStream *stream)
+{
+        g_mutex_lock(&stream->priv->mutex);
+        g_cond_broadcast(&stream->priv->cond);
+        g_mutex_unlock(&stream->priv->mutex);
+}
+
+// Waits until the data at the position, or the end of the stream, if
+// offset is -1, is there. Must be called with the mutex held.
+static bool waitForData(EvBrowserPluginStream *stream, goffset offset, GCancellable *cancellable, GError **error)
+{
+        EvBrowserPluginStreamPrivate *priv = stream->priv;
+
+        while (true) {
+                if (g_cancellable_set_error_if_cancelled(cancellable, error))
+                        return false;
+
+                if (offset == -1 ? priv->length >= 0 : availableAt(priv, offset) > 0)
+                        return true;
+
+                if (priv->finished) {
+                        if (offset == -1 || (priv->length >= 0 && offset >= priv->length) ||
+                            (priv->length < 0 && offset >= static_cast<goffset>(priv->data->len)))
+                                return true;
+
+                        if (priv->error)
+                                g_propagate_error(error, g_error_copy(priv->error));
+                        else
+                                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                                    "The document was not completely downloaded");
+                        return false;
+                }
+
+                if (offset != -1)
+                        requestData(stream, offset);
+                g_cond_wait(&priv->cond, &priv->mutex);
+        }
+}
+
+static gssize readFn(GInputStream *inputStream, void *buffer, gsize count, GCancellable *cancellable, GError **error)
+{
+        EvBrowserPluginStream *stream = EV_BROWSER_PLUGIN_STREAM(inputStream);
+        EvBrowserPluginStreamPrivate *priv = stream->priv;
+        gulong cancelledID = 0;
+        gssize retval = -1;
+
+        if (cancellable)
+                cancelledID = g_cancellable_connect(cancellable, G_CALLBACK(cancelled), stream, nullptr);
+
+        g_mutex_lock(&priv->mutex);
+        if (waitForData(stream, priv->position, cancellable, error)) {
+                gsize available = availableAt(priv, priv->position);
+
+                retval = MIN(count, available);
+                memcpy(buffer, priv->data->data + priv->position, retval);
+                priv->position += retval;
+        }
+        g_mutex_unlock(&priv->mutex);
+
+        if (cancellable)
+                g_cancellable_disconnect(cancellable, cancelledID);
+
+        return retval;
+}
+
+static gboolean closeFn(GInputStream *, GCancellable *, GError **)
+{
+        return TRUE;
+}
+
+static goffset tell(GSeekable *seekable)
+{
+        EvBrowserPluginStreamPrivate *priv = EV_BROWSER_PLUGIN_STREAM(seekable)->priv;
+
+        g_mutex_lock(&priv->mutex);
+        goffset position = priv->position;
+        g_mutex_unlock(&priv->mutex);
+
+        return position;
+}
+
+static gboolean canSeek(GSeekable *)
+{
+        return TRUE;
+}
+
+static gboolean seek(GSeekable *seekable, goffset offset, GSeekType type, GCancellable *cancellable, GError **error)
+{
+        EvBrowserPluginStream *stream = EV_BROWSER_PLUGIN_STREAM(seekable);
+        EvBrowserPluginStreamPrivate *priv = stream->priv;
+        gulong cancelledID = 0;
+        bool retval = true;
+
+        if (cancellable)
+                cancelledID = g_cancellable_connect(cancellable, G_CALLBACK(cancelled), stream, nullptr);
+
+        g_mutex_lock(&priv->mutex);
+        switch (type) {
+        case G_SEEK_CUR:
+                offset += priv->position;
+                break;
+        case G_SEEK_END:
+                // The length isn't known until the whole document is there
+                // when the server didn't send it.
+                retval = waitForData(stream, -1, cancellable, error);
+                offset += priv->length >= 0 ? priv->length : static_cast<goffset>(priv->data->len);
+                break;
+        case G_SEEK_SET:
+                break;
+        }
+
+        if (retval && offset < 0) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                    "Invalid seek request");
+                retval = false;
+        }
+        if (retval)
+                priv->position = offset;
+        g_mutex_unlock(&priv->mutex);
+
+        if (cancellable)
+                g_cancellable_disconnect(cancellable, cancelledID);
+
+        return retval;
+}
+
+static gboolean canTruncate(GSeekable *)
+{
+        return FALSE;
+}
+
+static gboolean truncateFn(GSeekable *, goffset, GCancellable *, GError **error)
+{
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                            "Cannot truncate the document stream");
+        return FALSE;
+}
+
+static void ev_browser_plugin_stream_seekable_iface_init(GSeekableIface *iface)
+{
+        iface->tell = tell;
+        iface->can_seek = canSeek;
+        iface->seek = seek;
+        iface->can_truncate = canTruncate;
+        iface->truncate_fn = truncateFn;
+}
+
+static void ev_browser_plugin_stream_init(EvBrowserPluginStream *stream)
+{
+        stream->priv = G_TYPE_INSTANCE_GET_PRIVATE(stream, EV_TYPE_BROWSER_PLUGIN_STREAM, EvBrowserPluginStreamPrivate);
+        g_mutex_init(&stream->priv->mutex);
+        g_cond_init(&stream->priv->cond);
+        stream->priv->data = g_byte_array_new();
+        stream->priv->ranges = g_array_new(FALSE, FALSE, sizeof(Range));
+        stream->priv->length = -1;
+        stream->priv->requestedOffset = -1;
+}
+
+static void ev_browser_plugin_stream_finalize(GObject *object)
+{
+        EvBrowserPluginStreamPrivate *priv = EV_BROWSER_PLUGIN_STREAM(object)->priv;
+
+        g_byte_array_unref(priv->data);
+        g_array_free(priv->ranges, TRUE);
+        g_clear_error(&priv->error);
+        g_mutex_clear(&priv->mutex);
+        g_cond_clear(&priv->cond);
+
+        G_OBJECT_CLASS(ev_browser_plugin_stream_parent_class)->finalize(object);
+}
+
+static void ev_browser_plugin_stream_class_init(EvBrowserPluginStreamClass *klass)
+{
+        GObjectClass *gObjectClass = G_OBJECT_CLASS(klass);
+        gObjectClass->finalize = ev_browser_plugin_stream_finalize;
+
+        GInputStreamClass *inputStreamClass = G_INPUT_STREAM_CLASS(klass);
+        inputStreamClass->read_fn = readFn;
+        inputStreamClass->close_fn = closeFn;
+
+        signals[DATA_NEEDED] =
+                g_signal_new("data-needed",
+                             G_TYPE_FROM_CLASS(klass),
+                             G_SIGNAL_RUN_LAST,
+                             0, nullptr, nullptr,
+                             g_cclosure_marshal_generic,
+                             G_TYPE_NONE, 1,
+                             G_TYPE_INT64);
+
+        g_type_class_add_private(gObjectClass, sizeof(EvBrowserPluginStreamPrivate));
+}
+
+GInputStream *ev_browser_plugin_stream_new(goffset length)
+{
+        EvBrowserPluginStream *stream = EV_BROWSER_PLUGIN_STREAM(g_object_new(EV_TYPE_BROWSER_PLUGIN_STREAM, nullptr));
+
+        if (length > 0 && length <= G_MAXUINT) {
+                stream->priv->length = length;
+                g_byte_array_set_size(stream->priv->data, length);
+        }
+
+        return G_INPUT_STREAM(stream);
+}
+
+void ev_browser_plugin_stream_write(EvBrowserPluginStream *stream, goffset offset, const void *buffer, gsize length)
+{
+        g_return_if_fail(EV_IS_BROWSER_PLUGIN_STREAM(stream));
+
+        EvBrowserPluginStreamPrivate *priv = stream->priv;
+
+        if (offset < 0 || length == 0)
+                return;
+
+        g_mutex_lock(&priv->mutex);
+        if (priv->length >= 0) {
+                if (offset < priv->length) {
+                        length = MIN(length, static_cast<gsize>(priv->length - offset));
+                        memcpy(priv->data->data + offset, buffer, length);
+                        addRange(priv, offset, offset + length);
+                }
+        } else if (offset == static_cast<goffset>(priv->data->len)) {
+                g_byte_array_append(priv->data, static_cast<const guint8 *>(buffer), length);
+                addRange(priv, 0, priv->data->len);
+        }
+        g_cond_broadcast(&priv->cond);
+        g_mutex_unlock(&priv->mutex);
+}
+
+void ev_browser_plugin_stream_finish(EvBrowserPluginStream *stream, const GError *error)
+{
+        g_return_if_fail(EV_IS_BROWSER_PLUGIN_STREAM(stream));
+
+        EvBrowserPluginStreamPrivate *priv = stream->priv;
+
+        g_mutex_lock(&priv->mutex);
+        priv->finished = true;
+        if (error && !priv->error)
+                priv->error = g_error_copy(error);
+        g_cond_broadcast(&priv->cond);
+        g_mutex_unlock(&priv->mutex);
+}
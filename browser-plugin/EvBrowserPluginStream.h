@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2014 Igalia S.L.
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EvBrowserPluginStream_h
+#define EvBrowserPluginStream_h
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_BROWSER_PLUGIN_STREAM              (ev_browser_plugin_stream_get_type())
+#define EV_BROWSER_PLUGIN_STREAM(object)           (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_BROWSER_PLUGIN_STREAM, EvBrowserPluginStream))
+#define EV_IS_BROWSER_PLUGIN_STREAM(object)        (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_BROWSER_PLUGIN_STREAM))
+#define EV_BROWSER_PLUGIN_STREAM_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_BROWSER_PLUGIN_STREAM, EvBrowserPluginStreamClass))
+#define EV_IS_BROWSER_PLUGIN_STREAM_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE((klass), EV_TYPE_BROWSER_PLUGIN_STREAM))
+#define EV_BROWSER_PLUGIN_STREAM_GET_CLASS(object) (G_TYPE_INSTANCE_GET_CLASS((object), EV_TYPE_BROWSER_PLUGIN_STREAM, EvBrowserPluginStreamClass))
+
+typedef struct _EvBrowserPluginStream        EvBrowserPluginStream;
+typedef struct _EvBrowserPluginStreamClass   EvBrowserPluginStreamClass;
+typedef struct _EvBrowserPluginStreamPrivate EvBrowserPluginStreamPrivate;
+
+struct _EvBrowserPluginStream {
+        GInputStream base_instance;
+
+        EvBrowserPluginStreamPrivate *priv;
+};
+
+struct _EvBrowserPluginStreamClass {
+        GInputStreamClass base_class;
+};
+
+GType         ev_browser_plugin_stream_get_type (void);
+GInputStream *ev_browser_plugin_stream_new      (goffset                length);
+void          ev_browser_plugin_stream_write    (EvBrowserPluginStream *stream,
+                                                 goffset                offset,
+                                                 const void            *buffer,
+                                                 gsize                  length);
+void          ev_browser_plugin_stream_finish   (EvBrowserPluginStream *stream,
+                                                 const GError          *error);
+
+G_END_DECLS
+
+#endif // EvBrowserPluginStream_h
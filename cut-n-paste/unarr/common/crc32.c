@@ -3,31 +3,62 @@
 
 #include "unarr-imp.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_CRC32_PCLMUL
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_CRC32) && !defined(__ARM_BIG_ENDIAN)
+#define HAVE_CRC32_ARM
+#include <arm_acle.h>
+#endif
+
 #ifndef HAVE_ZLIB
 
-/* code adapted from https://gnunet.org/svn/gnunet/src/util/crypto_crc.c (public domain) */
+/* code adapted from https://gnunet.org/svn/gnunet/src/util/crypto_crc.c (public domain),
+   extended to slicing-by-8 (the table for slice n gives the crc of a byte followed by n zero bytes) */
 
 static bool crc_table_ready = false;
-static uint32_t crc_table[256];
-
-uint32_t ar_crc32(uint32_t crc32, const unsigned char *data, size_t data_len)
-{
-    if (!crc_table_ready) {
-        uint32_t i, j;
-        uint32_t h = 1;
-        crc_table[0] = 0;
-        for (i = 128; i; i >>= 1) {
-            h = (h >> 1) ^ ((h & 1) ? 0xEDB88320 : 0);
-            for (j = 0; j < 256; j += 2 * i) {
-                crc_table[i + j] = crc_table[j] ^ h;
-            }
+static uint32_t crc_table[8][256];
+
+static void crc32_init_table(void)
+{
+    uint32_t i, j;
+    uint32_t h = 1;
+    crc_table[0][0] = 0;
+    for (i = 128; i; i >>= 1) {
+        h = (h >> 1) ^ ((h & 1) ? 0xEDB88320 : 0);
+        for (j = 0; j < 256; j += 2 * i) {
+            crc_table[0][i + j] = crc_table[0][j] ^ h;
         }
-        crc_table_ready = true;
     }
+    for (i = 0; i < 256; i++) {
+        for (j = 1; j < 8; j++)
+            crc_table[j][i] = (crc_table[j - 1][i] >> 8) ^ crc_table[0][crc_table[j - 1][i] & 0xFF];
+    }
+    crc_table_ready = true;
+}
+
+static uint32_t crc32_software(uint32_t crc32, const unsigned char *data, size_t data_len)
+{
+    if (!crc_table_ready)
+        crc32_init_table();
 
     crc32 = crc32 ^ 0xFFFFFFFF;
+    while (data_len > 0 && ((uintptr_t)data & 7) != 0) {
+        crc32 = (crc32 >> 8) ^ crc_table[0][(crc32 ^ *data++) & 0xFF];
+        data_len--;
+    }
+    while (data_len >= 8) {
+        uint32_t lo = crc32 ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+        uint32_t hi = (uint32_t)data[4] | (uint32_t)data[5] << 8 | (uint32_t)data[6] << 16 | (uint32_t)data[7] << 24;
+        crc32 = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+                crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+                crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+                crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+        data += 8;
+        data_len -= 8;
+    }
     while (data_len-- > 0) {
-        crc32 = (crc32 >> 8) ^ crc_table[(crc32 ^ *data++) & 0xFF];
+        crc32 = (crc32 >> 8) ^ crc_table[0][(crc32 ^ *data++) & 0xFF];
     }
     return crc32 ^ 0xFFFFFFFF;
 }
@@ -36,7 +67,7 @@ uint32_t ar_crc32(uint32_t crc32, const unsigned char *data, size_t data_len)
 
 #include <zlib.h>
 
-uint32_t ar_crc32(uint32_t crc, const unsigned char *data, size_t data_len)
+static uint32_t crc32_software(uint32_t crc, const unsigned char *data, size_t data_len)
 {
 #if SIZE_MAX > UINT32_MAX
     while (data_len > UINT32_MAX) {
@@ -49,3 +80,150 @@ uint32_t ar_crc32(uint32_t crc, const unsigned char *data, size_t data_len)
 }
 
 #endif
+
+#ifdef HAVE_CRC32_PCLMUL
+
+/* folding with carry-less multiplications, as described in Intel's "Fast CRC Computation for
+   Generic Polynomials Using PCLMULQDQ Instruction"; the constants are those of the Linux kernel */
+
+#define CRC32_PCLMUL_MIN_LENGTH 64
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_fold(uint32_t crc, const unsigned char *data, size_t data_len)
+{
+    static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    data += 64;
+    data_len -= 64;
+
+    while (data_len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        data += 64;
+        data_len -= 64;
+    }
+
+    /* fold the four lanes into one */
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (data_len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        data_len -= 16;
+    }
+
+    /* fold 128 bits to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const unsigned char *data, size_t data_len)
+{
+    if (data_len >= CRC32_PCLMUL_MIN_LENGTH) {
+        size_t chunk_len = data_len & ~(size_t)15;
+        crc = ~crc32_pclmul_fold(~crc, data, chunk_len);
+        data += chunk_len;
+        data_len -= chunk_len;
+    }
+    return data_len ? crc32_software(crc, data, data_len) : crc;
+}
+
+#endif
+
+#ifdef HAVE_CRC32_ARM
+
+static uint32_t crc32_arm(uint32_t crc, const unsigned char *data, size_t data_len)
+{
+    crc = ~crc;
+    while (data_len > 0 && ((uintptr_t)data & 7) != 0) {
+        crc = __crc32b(crc, *data++);
+        data_len--;
+    }
+    while (data_len >= 8) {
+        crc = __crc32d(crc, *(const uint64_t *)data);
+        data += 8;
+        data_len -= 8;
+    }
+    while (data_len-- > 0) {
+        crc = __crc32b(crc, *data++);
+    }
+    return ~crc;
+}
+
+#endif
+
+typedef uint32_t (* crc32_func)(uint32_t crc, const unsigned char *data, size_t data_len);
+
+static crc32_func crc32_select(void)
+{
+#if defined(HAVE_CRC32_PCLMUL)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        return crc32_pclmul;
+#elif defined(HAVE_CRC32_ARM)
+    return crc32_arm;
+#endif
+    return crc32_software;
+}
+
+uint32_t ar_crc32(uint32_t crc, const unsigned char *data, size_t data_len)
+{
+    /* selecting twice from concurrent threads is harmless */
+    static crc32_func crc32_impl = NULL;
+    if (!crc32_impl)
+        crc32_impl = crc32_select();
+    return crc32_impl(crc, data, data_len);
+}
@@ -4,6 +4,17 @@
 #include "rar.h"
 #include "rarvm.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_FIND_E8_AVX2
+#include <immintrin.h>
+#endif
+
 /* adapted from https://code.google.com/p/theunarchiver/source/browse/XADMaster/XADRARVirtualMachine.m */
 /* adapted from https://code.google.com/p/theunarchiver/source/browse/XADMaster/XADRAR30Filter.m */
 
@@ -295,22 +306,165 @@ static void rar_delete_filter(struct RARFilter *filter)
     }
 }
 
+/* The standard filters spend most of their time in two loops: the
+   delta filter is a running difference over each channel, and the
+   x86 filters look for call and jump opcodes. Both have vector versions,
+   the scalar ones being the reference. */
+
+static void rar_delta_decode_scalar(uint8_t *dst, uint32_t stride, const uint8_t *src, uint32_t count, uint8_t lastbyte)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++, dst += stride)
+        lastbyte = *dst = lastbyte - src[i];
+}
+
+#if defined(__SSE2__)
+static void rar_delta_decode(uint8_t *dst, uint32_t stride, const uint8_t *src, uint32_t count)
+{
+    __m128i last = _mm_setzero_si128();
+    uint8_t bytes[16];
+    uint32_t i, j;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        /* prefix sums of the 16 bytes, subtracted from the last output */
+        __m128i sum = _mm_loadu_si128((const __m128i *)(src + i));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+        sum = _mm_sub_epi8(last, sum);
+        if (stride == 1) {
+            _mm_storeu_si128((__m128i *)(dst + i), sum);
+        }
+        else {
+            _mm_storeu_si128((__m128i *)bytes, sum);
+            for (j = 0; j < 16; j++)
+                dst[(i + j) * stride] = bytes[j];
+        }
+        last = _mm_set1_epi8((char)(_mm_extract_epi16(sum, 7) >> 8));
+    }
+    rar_delta_decode_scalar(dst + i * stride, stride, src + i, count - i, (uint8_t)_mm_cvtsi128_si32(last));
+}
+#elif defined(__ARM_NEON)
+static void rar_delta_decode(uint8_t *dst, uint32_t stride, const uint8_t *src, uint32_t count)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    uint8x16_t last = zero;
+    uint8_t bytes[16];
+    uint32_t i, j;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        /* prefix sums of the 16 bytes, subtracted from the last output */
+        uint8x16_t sum = vld1q_u8(src + i);
+        sum = vaddq_u8(sum, vextq_u8(zero, sum, 15));
+        sum = vaddq_u8(sum, vextq_u8(zero, sum, 14));
+        sum = vaddq_u8(sum, vextq_u8(zero, sum, 12));
+        sum = vaddq_u8(sum, vextq_u8(zero, sum, 8));
+        sum = vsubq_u8(last, sum);
+        if (stride == 1) {
+            vst1q_u8(dst + i, sum);
+        }
+        else {
+            vst1q_u8(bytes, sum);
+            for (j = 0; j < 16; j++)
+                dst[(i + j) * stride] = bytes[j];
+        }
+        last = vdupq_n_u8(vgetq_lane_u8(sum, 15));
+    }
+    rar_delta_decode_scalar(dst + i * stride, stride, src + i, count - i, vgetq_lane_u8(last, 0));
+}
+#else
+static void rar_delta_decode(uint8_t *dst, uint32_t stride, const uint8_t *src, uint32_t count)
+{
+    rar_delta_decode_scalar(dst, stride, src, count, 0);
+}
+#endif
+
+/* returns the position of the first E8 (or E9) byte in [start, end), or end */
+static uint32_t rar_find_e8_scalar(const uint8_t *mem, uint32_t start, uint32_t end, bool e9also)
+{
+    uint8_t mask = e9also ? 0xFE : 0xFF;
+    for (; start < end; start++) {
+        if ((mem[start] & mask) == 0xE8)
+            break;
+    }
+    return start;
+}
+
+#if defined(__SSE2__)
+static uint32_t rar_find_e8_sse2(const uint8_t *mem, uint32_t start, uint32_t end, bool e9also)
+{
+    const __m128i mask = _mm_set1_epi8(e9also ? (char)0xFE : (char)0xFF);
+    const __m128i opcode = _mm_set1_epi8((char)0xE8);
+
+    for (; start + 16 <= end; start += 16) {
+        __m128i bytes = _mm_and_si128(_mm_loadu_si128((const __m128i *)(mem + start)), mask);
+        int found = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, opcode));
+        if (found)
+            return start + __builtin_ctz(found);
+    }
+    return rar_find_e8_scalar(mem, start, end, e9also);
+}
+#endif
+
+#ifdef HAVE_FIND_E8_AVX2
+__attribute__((target("avx2")))
+static uint32_t rar_find_e8_avx2(const uint8_t *mem, uint32_t start, uint32_t end, bool e9also)
+{
+    const __m256i mask = _mm256_set1_epi8(e9also ? (char)0xFE : (char)0xFF);
+    const __m256i opcode = _mm256_set1_epi8((char)0xE8);
+
+    for (; start + 32 <= end; start += 32) {
+        __m256i bytes = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(mem + start)), mask);
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, opcode));
+        if (found)
+            return start + __builtin_ctz(found);
+    }
+    return rar_find_e8_scalar(mem, start, end, e9also);
+}
+#endif
+
+typedef uint32_t (* RARFindE8Func)(const uint8_t *mem, uint32_t start, uint32_t end, bool e9also);
+
+static RARFindE8Func rar_find_e8_select(void)
+{
+#ifdef HAVE_FIND_E8_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return rar_find_e8_avx2;
+#endif
+#if defined(__SSE2__)
+    return rar_find_e8_sse2;
+#else
+    return rar_find_e8_scalar;
+#endif
+}
+
+static uint32_t rar_find_e8(const uint8_t *mem, uint32_t start, uint32_t end, bool e9also)
+{
+    static RARFindE8Func find_e8 = NULL;
+
+    if (!find_e8)
+        find_e8 = rar_find_e8_select();
+    return find_e8(mem, start, end, e9also);
+}
+
 static bool rar_execute_filter_delta(struct RARFilter *filter, RARVirtualMachine *vm)
 {
     uint32_t length = filter->initialregisters[4];
     uint32_t numchannels = filter->initialregisters[0];
     uint8_t *src, *dst;
-    uint32_t i, idx;
+    uint32_t i, count;
 
     if (length > RARProgramWorkSize / 2)
         return false;
 
     src = &vm->memory[0];
     dst = &vm->memory[length];
-    for (i = 0; i < numchannels; i++) {
-        uint8_t lastbyte = 0;
-        for (idx = i; idx < length; idx += numchannels)
-            lastbyte = dst[idx] = lastbyte - *src++;
+    for (i = 0; i < numchannels && i < length; i++) {
+        count = (length - i + numchannels - 1) / numchannels;
+        rar_delta_decode(dst + i, numchannels, src, count);
+        src += count;
     }
 
     filter->filteredblockaddress = length;
@@ -328,8 +482,9 @@ static bool rar_execute_filter_e8(struct RARFilter *filter, RARVirtualMachine *v
     if (length > RARProgramWorkSize || length < 4)
         return false;
 
-    for (i = 0; i <= length - 5; i++) {
-        if (vm->memory[i] == 0xE8 || (e9also && vm->memory[i] == 0xE9)) {
+    for (i = 0; i + 5 <= length; i++) {
+        i = rar_find_e8(vm->memory, i, length - 4, e9also);
+        if (i + 5 <= length) {
             uint32_t currpos = (uint32_t)pos + i + 1;
             int32_t address = (int32_t)RARVirtualMachineRead32(vm, i + 1);
             if (address < 0 && currpos >= (uint32_t)-address)
@@ -118,20 +118,60 @@ static bool rar_make_table_rec(struct huffman_code *code, int node, int offset,
     return true;
 }
 
+/* Codes longer than the first level table are looked up in a second
+   level table holding their remaining bits, so that any symbol is
+   decoded with at most two lookups instead of walking the tree */
 bool rar_make_table(struct huffman_code *code)
 {
-    if (code->minlength <= code->maxlength && code->maxlength <= 10)
+    int size, subbits, count, used, i;
+    void *new_table;
+
+    if (code->minlength <= code->maxlength && code->maxlength <= RAR_HUFFMAN_TABLE_BITS)
         code->tablesize = code->maxlength;
     else
-        code->tablesize = 10;
+        code->tablesize = RAR_HUFFMAN_TABLE_BITS;
 
-    code->table = calloc(1ULL << code->tablesize, sizeof(*code->table));
+    size = 1 << code->tablesize;
+    code->table = calloc(size, sizeof(*code->table));
     if (!code->table) {
         warn("OOM during decompression");
         return false;
     }
 
-    return rar_make_table_rec(code, 0, 0, 0, code->tablesize);
+    if (!rar_make_table_rec(code, 0, 0, 0, code->tablesize))
+        return false;
+
+    subbits = code->maxlength - code->tablesize;
+    if (subbits <= 0)
+        return true;
+
+    /* entries left pointing at a node of the tree need a subtable */
+    count = 0;
+    for (i = 0; i < size; i++) {
+        if (code->table[i].length > code->tablesize)
+            count++;
+    }
+    if (!count)
+        return true;
+
+    new_table = realloc(code->table, (size + ((size_t)count << subbits)) * sizeof(*code->table));
+    if (!new_table) {
+        warn("OOM during decompression");
+        return false;
+    }
+    code->table = new_table;
+
+    used = size;
+    for (i = 0; i < size; i++) {
+        if (code->table[i].length <= code->tablesize)
+            continue;
+        if (!rar_make_table_rec(code, code->table[i].value, used, 0, subbits))
+            return false;
+        code->table[i].length = code->tablesize + subbits;
+        code->table[i].value = used;
+        used += 1 << subbits;
+    }
+    return true;
 }
 
 void rar_free_code(struct huffman_code *code)
@@ -71,11 +71,13 @@ static bool rar_parse_entry(ar_archive *ar, off64_t offset)
                 warn("Splitting files isn't really supported");
             ar->entry_size_uncompressed = (size_t)entry.size;
             ar->entry_filetime = ar_conv_dosdate_to_filetime(entry.dosdate);
-            if (!rar->entry.solid || rar->entry.method == METHOD_STORE || out_of_order) {
+            if (!rar->entry.solid || rar->entry.method == METHOD_STORE ||
+                (out_of_order && !(rar->solid.checkpoint && rar->solid.checkpoint <= ar->entry_offset))) {
                 rar_clear_uncompress(&rar->uncomp);
                 memset(&rar->solid, 0, sizeof(rar->solid));
             }
             else {
+                /* the decoder state is kept for seeking forward, from the checkpoint */
                 br_clear_leftover_bits(&rar->uncomp);
             }
 
@@ -136,8 +138,14 @@ static bool rar_restart_solid(ar_archive *ar)
 {
     ar_archive_rar *rar = (ar_archive_rar *)ar;
     off64_t current_offset = ar->entry_offset;
-    log("Restarting decompression for solid entry");
-    if (!ar_parse_entry_at(ar, ar->entry_offset_first)) {
+    off64_t restart_offset = ar->entry_offset_first;
+    if (rar->solid.checkpoint && rar->solid.checkpoint <= current_offset) {
+        log("Resuming decompression for solid entry @%" PRIi64, rar->solid.checkpoint);
+        restart_offset = rar->solid.checkpoint;
+    }
+    else
+        log("Restarting decompression for solid entry");
+    if (!ar_parse_entry_at(ar, restart_offset)) {
         ar_parse_entry_at(ar, current_offset);
         return false;
     }
@@ -180,6 +188,8 @@ static bool rar_uncompress(ar_archive *ar, void *buffer, size_t count)
             warn("Failed to produce the required solid decompression state");
             return false;
         }
+        /* the decoder state is about to move past the checkpoint */
+        rar->solid.checkpoint = 0;
         if (!rar_uncompress_part(rar, buffer, count))
             return false;
     }
@@ -195,6 +205,8 @@ static bool rar_uncompress(ar_archive *ar, void *buffer, size_t count)
         log("Compressed block has more data than required");
     rar->solid.part_done = true;
     rar->solid.size_total += rar->progress.bytes_done;
+    if (rar->entry.method != METHOD_STORE)
+        rar->solid.checkpoint = ar->entry_offset_next;
     if (rar->progress.crc != rar->entry.crc) {
         warn("Checksum of extracted data doesn't match");
         return false;
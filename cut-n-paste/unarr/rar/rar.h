@@ -102,6 +102,9 @@ void rar_clear_filters(struct ar_archive_rar_filters *filters);
 
 /***** huffman-rar *****/
 
+/* bits decoded by the first level lookup table, see rar_make_table */
+#define RAR_HUFFMAN_TABLE_BITS 10
+
 struct huffman_code {
     struct {
         int branches[2];
@@ -238,6 +241,9 @@ struct ar_archive_rar_solid {
     size_t size_total;
     bool part_done;
     bool restart;
+    /* offset of the entry following the last one uncompressed to its end,
+       while the decoder state hasn't moved on from there (or 0) */
+    off64_t checkpoint;
 };
 
 struct ar_archive_rar_s {
@@ -10,22 +10,19 @@ static void *gSzAlloc_Alloc(ISzAllocPtr p, size_t size) { return malloc(size); }
 static void gSzAlloc_Free(ISzAllocPtr p, void *ptr) { free(ptr); }
 static ISzAlloc gSzAlloc = { gSzAlloc_Alloc, gSzAlloc_Free };
 
-static bool br_fill(ar_archive_rar *rar, int bits)
+/* reads as many bits as fit in the buffer, if there are any left */
+static bool br_refill(ar_archive_rar *rar)
 {
     uint8_t bytes[8];
     int count, i;
-    /* read as many bits as possible */
     count = (64 - rar->uncomp.br.available) / 8;
     if (rar->progress.data_left < (size_t)count)
         count = (int)rar->progress.data_left;
+    if (count == 0)
+        return true;
 
-    if (bits > rar->uncomp.br.available + 8 * count || ar_read(rar->super.stream, bytes, count) != (size_t)count) {
-        if (!rar->uncomp.br.at_eof) {
-            warn("Unexpected EOF during decompression (truncated file?)");
-            rar->uncomp.br.at_eof = true;
-        }
+    if (ar_read(rar->super.stream, bytes, count) != (size_t)count)
         return false;
-    }
     rar->progress.data_left -= count;
     for (i = 0; i < count; i++) {
         rar->uncomp.br.bits = (rar->uncomp.br.bits << 8) | bytes[i];
@@ -34,6 +31,18 @@ static bool br_fill(ar_archive_rar *rar, int bits)
     return true;
 }
 
+static bool br_fill(ar_archive_rar *rar, int bits)
+{
+    if (!br_refill(rar) || bits > rar->uncomp.br.available) {
+        if (!rar->uncomp.br.at_eof) {
+            warn("Unexpected EOF during decompression (truncated file?)");
+            rar->uncomp.br.at_eof = true;
+        }
+        return false;
+    }
+    return true;
+}
+
 static inline bool br_check(ar_archive_rar *rar, int bits)
 {
     return bits <= rar->uncomp.br.available || br_fill(rar, bits);
@@ -44,6 +53,17 @@ static inline uint64_t br_bits(ar_archive_rar *rar, int bits)
     return (rar->uncomp.br.bits >> (rar->uncomp.br.available -= bits)) & (((uint64_t)1 << bits) - 1);
 }
 
+/* returns the next bits without consuming them, padded with zeros when
+   fewer are available: at the end of the data a prefix code can be
+   shorter than the bits looked up for it */
+static inline uint32_t br_peek(ar_archive_rar *rar, int bits)
+{
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    if (bits <= rar->uncomp.br.available)
+        return (uint32_t)((rar->uncomp.br.bits >> (rar->uncomp.br.available - bits)) & mask);
+    return (uint32_t)((rar->uncomp.br.bits << (bits - rar->uncomp.br.available)) & mask);
+}
+
 static Byte ByteIn_Read(const IByteIn *p)
 {
     struct ByteReader *self = (struct ByteReader *) p;
@@ -160,43 +180,46 @@ void rar_clear_uncompress(struct ar_archive_rar_uncomp *uncomp)
 
 static int rar_read_next_symbol(ar_archive_rar *rar, struct huffman_code *code)
 {
-    int node = 0;
+    uint32_t bits;
+    int length, value, subbits;
 
     if (!code->table && !rar_make_table(code))
         return -1;
 
-    /* performance optimization */
-    if (code->tablesize <= rar->uncomp.br.available) {
-        uint16_t bits = (uint16_t)br_bits(rar, code->tablesize);
-        int length = code->table[bits].length;
-        int value = code->table[bits].value;
-
-        if (length < 0) {
-            warn("Invalid data in bitstream"); /* invalid prefix code in bitstream */
-            return -1;
-        }
-        if (length <= code->tablesize) {
-            /* Skip only length bits */
-            rar->uncomp.br.available += code->tablesize - length;
-            return value;
-        }
-
-        node = value;
-    }
-
-    while (!rar_is_leaf_node(code, node)) {
-        uint8_t bit;
-        if (!br_check(rar, 1))
+    /* refilling 64 bits at a time, most symbols need a single lookup;
+       running out of data is reported by br_check below, once it's
+       known how many bits the code really takes */
+    if (code->tablesize > rar->uncomp.br.available)
+        br_refill(rar);
+    bits = br_peek(rar, code->tablesize);
+    length = code->table[bits].length;
+    value = code->table[bits].value;
+
+    if (length > code->tablesize) {
+        /* the code continues in a second level table */
+        if (!br_check(rar, code->tablesize))
             return -1;
-        bit = (uint8_t)br_bits(rar, 1);
-        if (code->tree[node].branches[bit] < 0) {
+        rar->uncomp.br.available -= code->tablesize;
+        subbits = length - code->tablesize;
+        if (subbits > rar->uncomp.br.available)
+            br_refill(rar);
+        bits = br_peek(rar, subbits);
+        length = code->table[value + bits].length;
+        value = code->table[value + bits].value;
+        if (length > subbits) {
             warn("Invalid data in bitstream"); /* invalid prefix code in bitstream */
             return -1;
         }
-        node = code->tree[node].branches[bit];
     }
 
-    return code->tree[node].branches[0];
+    if (length < 0) {
+        warn("Invalid data in bitstream"); /* invalid prefix code in bitstream */
+        return -1;
+    }
+    if (!br_check(rar, length))
+        return -1;
+    rar->uncomp.br.available -= length;
+    return value;
 }
 
 /***** RAR version 2 decompression *****/
@@ -43,6 +43,7 @@
 #include <libdocument/ev-document-type-builtins.h>
 #include <libdocument/ev-file-exporter.h>
 #include <libdocument/ev-file-helpers.h>
+#include <libdocument/ev-folded-text.h>
 #include <libdocument/ev-form-field.h>
 #include <libdocument/ev-image.h>
 #include <libdocument/ev-init.h>
@@ -51,9 +52,12 @@
 #include <libdocument/ev-link-dest.h>
 #include <libdocument/ev-link.h>
 #include <libdocument/ev-mapping-list.h>
+#include <libdocument/ev-memory-stats.h>
+#include <libdocument/ev-open-timings.h>
 #include <libdocument/ev-page.h>
 #include <libdocument/ev-render-context.h>
 #include <libdocument/ev-selection.h>
+#include <libdocument/ev-surface-pool.h>
 #include <libdocument/ev-transition-effect.h>
 #include <libdocument/ev-version.h>
 #include <libdocument/ev-macros.h>
@@ -22,12 +22,15 @@
 #define __EV_EVINCE_VIEW_H_INSIDE__
 
 #include <libview/ev-job-scheduler.h>
+#include <libview/ev-find-index.h>
 #include <libview/ev-jobs.h>
 #include <libview/ev-document-model.h>
 #include <libview/ev-print-operation.h>
 #include <libview/ev-view.h>
 #include <libview/ev-view-type-builtins.h>
 #include <libview/ev-stock-icons.h>
+#include <libview/ev-render-stats.h>
+#include <libview/ev-surface-budget.h>
 
 #undef __EV_EVINCE_VIEW_H_INSIDE__
 
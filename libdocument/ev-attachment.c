@@ -23,6 +23,7 @@
 #include <gtk/gtk.h>
 #include "ev-file-helpers.h"
 #include "ev-attachment.h"
+#include "ev-memory-stats.h"
 
 enum
 {
@@ -42,7 +43,15 @@ struct _EvAttachmentPrivate {
 	GTime                    ctime;
 	gsize                    size;
 	gchar                   *data;
+	gsize                    data_size;
 	gchar                   *mime_type;
+	gboolean                 mime_type_uncertain;
+
+	/* Writes the contents when there's no data, so that they
+	 * are only read from the document when needed */
+	EvAttachmentSaveFunc     save_func;
+	gpointer                 save_data;
+	GDestroyNotify           save_data_destroy;
 
 	GAppInfo                *app;
 	GFile                   *tmp_file;
@@ -53,6 +62,20 @@ struct _EvAttachmentPrivate {
 
 G_DEFINE_TYPE (EvAttachment, ev_attachment, G_TYPE_OBJECT)
 
+/* Contents of the attachments kept in memory. Attachments are created
+ * in the job threads, so they are updated atomically. */
+static volatile gsize attachments_size = 0;
+static volatile gint  n_attachments = 0;
+
+static void
+ev_attachment_get_memory_stats (gpointer  user_data,
+				guint64  *bytes,
+				guint    *n_entries)
+{
+	*bytes += (gsize) g_atomic_pointer_get (&attachments_size);
+	*n_entries += g_atomic_int_get (&n_attachments);
+}
+
 GQuark
 ev_attachment_error_quark (void)
 {
@@ -83,6 +106,9 @@ ev_attachment_finalize (GObject *object)
 	if (attachment->priv->data) {
 		g_free (attachment->priv->data);
 		attachment->priv->data = NULL;
+
+		g_atomic_pointer_add (&attachments_size, -(gssize) attachment->priv->data_size);
+		g_atomic_int_add (&n_attachments, -1);
 	}
 
 	if (attachment->priv->mime_type) {
@@ -90,6 +116,12 @@ ev_attachment_finalize (GObject *object)
 		attachment->priv->mime_type = NULL;
 	}
 
+	if (attachment->priv->save_data_destroy) {
+		attachment->priv->save_data_destroy (attachment->priv->save_data);
+		attachment->priv->save_data_destroy = NULL;
+	}
+	attachment->priv->save_data = NULL;
+
 	if (attachment->priv->app) {
 		g_object_unref (attachment->priv->app);
 		attachment->priv->app = NULL;
@@ -132,8 +164,8 @@ ev_attachment_set_property (GObject      *object,
 		attachment->priv->data = g_value_get_pointer (value);
 		attachment->priv->mime_type = g_content_type_guess (attachment->priv->name,
 								    (guchar *) attachment->priv->data,
-								    attachment->priv->size,
-								    NULL);
+								    attachment->priv->data ? attachment->priv->size : 0,
+								    &attachment->priv->mime_type_uncertain);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object,
@@ -143,6 +175,21 @@ ev_attachment_set_property (GObject      *object,
 	}
 }
 
+static void
+ev_attachment_constructed (GObject *object)
+{
+	EvAttachment *attachment = EV_ATTACHMENT (object);
+
+	G_OBJECT_CLASS (ev_attachment_parent_class)->constructed (object);
+
+	/* Accounted once constructed, "size" may be set after "data" */
+	if (attachment->priv->data) {
+		attachment->priv->data_size = attachment->priv->size;
+		g_atomic_pointer_add (&attachments_size, attachment->priv->data_size);
+		g_atomic_int_inc (&n_attachments);
+	}
+}
+
 static void
 ev_attachment_class_init (EvAttachmentClass *klass)
 {
@@ -151,6 +198,7 @@ ev_attachment_class_init (EvAttachmentClass *klass)
 	g_object_class = G_OBJECT_CLASS (klass);
 
 	g_object_class->set_property = ev_attachment_set_property;
+	g_object_class->constructed = ev_attachment_constructed;
 
 	g_type_class_add_private (g_object_class, sizeof (EvAttachmentPrivate));
 
@@ -210,6 +258,8 @@ ev_attachment_class_init (EvAttachmentClass *klass)
                                                                G_PARAM_STATIC_STRINGS));
 	
 	g_object_class->finalize = ev_attachment_finalize;
+
+	ev_memory_stats_register ("attachments", ev_attachment_get_memory_stats, NULL);
 }
 
 static void
@@ -247,6 +297,49 @@ ev_attachment_new (const gchar *name,
 	return attachment;
 }
 
+/**
+ * ev_attachment_new_with_save_func:
+ * @name: the name of the attachment
+ * @description: the description of the attachment
+ * @mtime: the modification date of the attachment
+ * @ctime: the creation date of the attachment
+ * @size: the size of the contents of the attachment
+ * @save_func: (scope notified): the function that writes the contents
+ * @user_data: data to pass to @save_func
+ * @destroy_func: function to free @user_data when the attachment is
+ *   destroyed, or %NULL
+ *
+ * Creates an attachment whose contents are not kept in memory. They are
+ * written by @save_func straight to their destination every time the
+ * attachment is saved or opened. The MIME type is guessed from @name
+ * until the contents are read.
+ *
+ * Returns: (transfer full): a new #EvAttachment
+ *
+ * Since: 3.30
+ */
+EvAttachment *
+ev_attachment_new_with_save_func (const gchar         *name,
+				  const gchar         *description,
+				  GTime                mtime,
+				  GTime                ctime,
+				  gsize                size,
+				  EvAttachmentSaveFunc save_func,
+				  gpointer             user_data,
+				  GDestroyNotify       destroy_func)
+{
+	EvAttachment *attachment;
+
+	g_return_val_if_fail (save_func != NULL, NULL);
+
+	attachment = ev_attachment_new (name, description, mtime, ctime, size, NULL);
+	attachment->priv->save_func = save_func;
+	attachment->priv->save_data = user_data;
+	attachment->priv->save_data_destroy = destroy_func;
+
+	return attachment;
+}
+
 const gchar *
 ev_attachment_get_name (EvAttachment *attachment)
 {
@@ -287,6 +380,37 @@ ev_attachment_get_mime_type (EvAttachment *attachment)
 	return attachment->priv->mime_type;
 }
 
+/**
+ * ev_attachment_save_to_stream:
+ * @attachment: an #EvAttachment
+ * @stream: a #GOutputStream
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the contents of @attachment to @stream, without closing it.
+ *
+ * Returns: %TRUE on success, %FALSE setting @error otherwise
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_attachment_save_to_stream (EvAttachment  *attachment,
+			      GOutputStream *stream,
+			      GError       **error)
+{
+	g_return_val_if_fail (EV_IS_ATTACHMENT (attachment), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+
+	if (attachment->priv->save_func)
+		return attachment->priv->save_func (attachment, stream,
+						    attachment->priv->save_data,
+						    error);
+
+	return g_output_stream_write_all (stream,
+					  attachment->priv->data,
+					  attachment->priv->size,
+					  NULL, NULL, error);
+}
+
 gboolean
 ev_attachment_save (EvAttachment *attachment,
 		    GFile        *file,
@@ -294,7 +418,6 @@ ev_attachment_save (EvAttachment *attachment,
 {
 	GFileOutputStream *output_stream;
 	GError *ioerror = NULL;
-	gssize  written_bytes;
 
 	g_return_val_if_fail (EV_IS_ATTACHMENT (attachment), FALSE);
 	g_return_val_if_fail (G_IS_FILE (file), FALSE);
@@ -317,11 +440,9 @@ ev_attachment_save (EvAttachment *attachment,
 		return FALSE;
 	}
 	
-	written_bytes = g_output_stream_write (G_OUTPUT_STREAM (output_stream),
-					       attachment->priv->data,
-					       attachment->priv->size,
-					       NULL, &ioerror);
-	if (written_bytes == -1) {
+	if (!ev_attachment_save_to_stream (attachment,
+					   G_OUTPUT_STREAM (output_stream),
+					   &ioerror)) {
 		char *uri;
 		
 		uri = g_file_get_uri (file);
@@ -333,6 +454,7 @@ ev_attachment_save (EvAttachment *attachment,
 			     ioerror->message);
 		
 		g_output_stream_close (G_OUTPUT_STREAM (output_stream), NULL, NULL);
+		g_object_unref (output_stream);
 		g_error_free (ioerror);
 		g_free (uri);
 
@@ -340,6 +462,7 @@ ev_attachment_save (EvAttachment *attachment,
 	}
 
 	g_output_stream_close (G_OUTPUT_STREAM (output_stream), NULL, NULL);
+	g_object_unref (output_stream);
 
 	return TRUE;
 	
@@ -391,36 +514,39 @@ ev_attachment_launch_app (EvAttachment *attachment,
 	return TRUE;
 }
 
+/* The contents of attachments without data are only sniffed
+ * once they have been saved to a file */
+static void
+ev_attachment_update_mime_type (EvAttachment *attachment,
+				GFile        *file)
+{
+	GFileInfo *info;
+
+	if (!attachment->priv->mime_type_uncertain)
+		return;
+
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (!info)
+		return;
+
+	if (g_file_info_get_content_type (info)) {
+		g_free (attachment->priv->mime_type);
+		attachment->priv->mime_type = g_strdup (g_file_info_get_content_type (info));
+		attachment->priv->mime_type_uncertain = FALSE;
+	}
+	g_object_unref (info);
+}
+
 gboolean
 ev_attachment_open (EvAttachment *attachment,
 		    GdkScreen    *screen,
 		    guint32       timestamp,
 		    GError      **error)
 {
-	GAppInfo *app_info;
-	gboolean  retval = FALSE;
-
 	g_return_val_if_fail (EV_IS_ATTACHMENT (attachment), FALSE);
-	
-	if (!attachment->priv->app) {
-		app_info = g_app_info_get_default_for_type (attachment->priv->mime_type, FALSE);
-		attachment->priv->app = app_info;
-	}
 
-	if (!attachment->priv->app) {
-		g_set_error (error,
-			     EV_ATTACHMENT_ERROR,
-			     0,
-			     _("Couldn’t open attachment “%s”"),
-			     attachment->priv->name);
-		
-		return FALSE;
-	}
-
-	if (attachment->priv->tmp_file) {
-		retval = ev_attachment_launch_app (attachment, screen,
-						   timestamp, error);
-	} else {
+	if (!attachment->priv->tmp_file) {
                 char *basename;
                 char *template;
 		GFile *file;
@@ -432,18 +558,35 @@ ev_attachment_open (EvAttachment *attachment,
                 g_free (template);
                 g_free (basename);
 
-		if (file != NULL && ev_attachment_save (attachment, file, error)) {
-			if (attachment->priv->tmp_file)
-				g_object_unref (attachment->priv->tmp_file);
-			attachment->priv->tmp_file = g_object_ref (file);
+		if (file == NULL)
+			return FALSE;
 
-			retval = ev_attachment_launch_app (attachment, screen,
-							   timestamp, error);
+		if (!ev_attachment_save (attachment, file, error)) {
+			ev_tmp_file_unlink (file);
+			g_object_unref (file);
+
+			return FALSE;
 		}
 
-		g_object_unref (file);
+		attachment->priv->tmp_file = file;
+		ev_attachment_update_mime_type (attachment, file);
 	}
 
-	return retval;
-}
+	if (!attachment->priv->app) {
+		attachment->priv->app = g_app_info_get_default_for_type (attachment->priv->mime_type,
+									 FALSE);
+	}
+
+	if (!attachment->priv->app) {
+		g_set_error (error,
+			     EV_ATTACHMENT_ERROR,
+			     0,
+			     _("Couldn’t open attachment “%s”"),
+			     attachment->priv->name);
+		
+		return FALSE;
+	}
 
+	return ev_attachment_launch_app (attachment, screen,
+					 timestamp, error);
+}
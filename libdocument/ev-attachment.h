@@ -52,6 +52,24 @@ struct _EvAttachmentClass {
 	GObjectClass base_class;
 };
 
+/**
+ * EvAttachmentSaveFunc:
+ * @attachment: an #EvAttachment
+ * @stream: the #GOutputStream to write the contents of @attachment to
+ * @user_data: the data passed to ev_attachment_new_with_save_func()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the contents of @attachment to @stream.
+ *
+ * Returns: %TRUE on success, %FALSE setting @error otherwise
+ *
+ * Since: 3.30
+ */
+typedef gboolean (* EvAttachmentSaveFunc) (EvAttachment  *attachment,
+					   GOutputStream *stream,
+					   gpointer       user_data,
+					   GError       **error);
+
 GType         ev_attachment_get_type             (void) G_GNUC_CONST;
 GQuark        ev_attachment_error_quark          (void) G_GNUC_CONST;
 EvAttachment *ev_attachment_new                  (const gchar  *name,
@@ -60,6 +78,14 @@ EvAttachment *ev_attachment_new                  (const gchar  *name,
 						  GTime         ctime,
 						  gsize         size,
 						  gpointer      data);
+EvAttachment *ev_attachment_new_with_save_func   (const gchar         *name,
+						  const gchar         *description,
+						  GTime                mtime,
+						  GTime                ctime,
+						  gsize                size,
+						  EvAttachmentSaveFunc save_func,
+						  gpointer             user_data,
+						  GDestroyNotify       destroy_func);
 
 const gchar *ev_attachment_get_name              (EvAttachment *attachment);
 const gchar *ev_attachment_get_description       (EvAttachment *attachment);
@@ -69,6 +95,9 @@ const gchar *ev_attachment_get_mime_type         (EvAttachment *attachment);
 gboolean     ev_attachment_save                  (EvAttachment *attachment,
 						  GFile        *file,
 						  GError      **error);
+gboolean     ev_attachment_save_to_stream        (EvAttachment  *attachment,
+						  GOutputStream *stream,
+						  GError       **error);
 gboolean     ev_attachment_open                  (EvAttachment *attachment,
 						  GdkScreen    *screen,
 						  guint32       timestamp,
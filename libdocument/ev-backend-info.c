@@ -19,11 +19,22 @@
 
 #include <config.h>
 
+#include <glib/gstdio.h>
+
 #include "ev-backend-info.h"
 
 #define EV_BACKENDS_GROUP     "Evince Backend"
 #define EV_BACKENDS_EXTENSION ".evince-backend"
 
+/* The backend files found in a directory are kept in a registry file
+ * in the user cache, used while the directory isn't modified. Backends
+ * are installed and removed by creating and renaming files in it,
+ * which updates its mtime.
+ */
+#define EV_REGISTRY_GROUP     "Registry"
+#define EV_REGISTRY_VERSION   1
+#define EV_REGISTRY_BACKEND   "Backend "
+
 /*
  * _ev_backend_info_free:
  * @info:
@@ -114,17 +125,133 @@ _ev_backend_info_new_from_file (const char *file,
         return NULL;
 }
 
-/*
- * _ev_backend_info_load_from_dir:
- * @path: a directory name
- *
- * Load all backend infos from @path.
- *
- * Returns: a newly allocated #GList containing newly allocated
- *   #EvBackendInfo objects
- */
-GList
-*_ev_backend_info_load_from_dir (const char *path)
+static gchar *
+ev_backend_info_get_registry_path (const char *path)
+{
+        gchar *checksum;
+        gchar *filename;
+        gchar *registry_path;
+
+        checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, path, -1);
+        filename = g_strconcat (checksum, ".registry", NULL);
+        registry_path = g_build_filename (g_get_user_cache_dir (), "evince",
+                                          "backends", filename, NULL);
+        g_free (filename);
+        g_free (checksum);
+
+        return registry_path;
+}
+
+/* Type descriptions are translated, so the registry is only valid
+ * for the language it was made for */
+static const gchar *
+ev_backend_info_get_language (void)
+{
+        return g_get_language_names ()[0];
+}
+
+static GList *
+ev_backend_info_load_registry (const char *path,
+                               gint64      mtime)
+{
+        GKeyFile *registry;
+        gchar    *registry_path;
+        gchar    *language = NULL;
+        gchar   **groups = NULL;
+        GList    *list = NULL;
+        gboolean  valid;
+        guint     i;
+
+        registry = g_key_file_new ();
+        registry_path = ev_backend_info_get_registry_path (path);
+        valid = g_key_file_load_from_file (registry, registry_path, G_KEY_FILE_NONE, NULL) &&
+                g_key_file_get_integer (registry, EV_REGISTRY_GROUP, "Version", NULL) == EV_REGISTRY_VERSION &&
+                g_key_file_get_int64 (registry, EV_REGISTRY_GROUP, "Mtime", NULL) == mtime;
+        g_free (registry_path);
+
+        if (valid) {
+                language = g_key_file_get_string (registry, EV_REGISTRY_GROUP, "Language", NULL);
+                valid = g_strcmp0 (language, ev_backend_info_get_language ()) == 0;
+                g_free (language);
+        }
+
+        if (valid)
+                groups = g_key_file_get_groups (registry, NULL);
+
+        for (i = 0; groups && groups[i]; i++) {
+                EvBackendInfo *info;
+
+                if (!g_str_has_prefix (groups[i], EV_REGISTRY_BACKEND))
+                        continue;
+
+                info = g_slice_new0 (EvBackendInfo);
+                info->ref_count = 1;
+                info->module_name = g_key_file_get_string (registry, groups[i], "Module", NULL);
+                info->resident = g_key_file_get_boolean (registry, groups[i], "Resident", NULL);
+                info->type_desc = g_key_file_get_string (registry, groups[i], "TypeDescription", NULL);
+                info->mime_types = g_key_file_get_string_list (registry, groups[i], "MimeType", NULL, NULL);
+
+                if (!info->module_name || !info->type_desc || !info->mime_types) {
+                        _ev_backend_info_unref (info);
+                        continue;
+                }
+
+                list = g_list_prepend (list, info);
+        }
+
+        g_strfreev (groups);
+        g_key_file_free (registry);
+
+        return g_list_reverse (list);
+}
+
+static void
+ev_backend_info_save_registry (const char *path,
+                               gint64      mtime,
+                               GList      *list)
+{
+        GKeyFile *registry;
+        gchar    *registry_path;
+        gchar    *registry_dir;
+        gchar    *data;
+        gsize     length;
+        GList    *l;
+
+        registry = g_key_file_new ();
+        g_key_file_set_integer (registry, EV_REGISTRY_GROUP, "Version", EV_REGISTRY_VERSION);
+        g_key_file_set_int64 (registry, EV_REGISTRY_GROUP, "Mtime", mtime);
+        g_key_file_set_string (registry, EV_REGISTRY_GROUP, "Language",
+                               ev_backend_info_get_language ());
+
+        for (l = list; l; l = g_list_next (l)) {
+                EvBackendInfo *info = (EvBackendInfo *) l->data;
+                gchar         *group;
+
+                group = g_strconcat (EV_REGISTRY_BACKEND, info->module_name, NULL);
+                g_key_file_set_string (registry, group, "Module", info->module_name);
+                g_key_file_set_boolean (registry, group, "Resident", info->resident);
+                g_key_file_set_string (registry, group, "TypeDescription", info->type_desc);
+                g_key_file_set_string_list (registry, group, "MimeType",
+                                            (const gchar * const *) info->mime_types,
+                                            g_strv_length (info->mime_types));
+                g_free (group);
+        }
+
+        data = g_key_file_to_data (registry, &length, NULL);
+        g_key_file_free (registry);
+
+        registry_path = ev_backend_info_get_registry_path (path);
+        registry_dir = g_path_get_dirname (registry_path);
+        if (g_mkdir_with_parents (registry_dir, 0700) == 0)
+                g_file_set_contents (registry_path, data, length, NULL);
+        g_free (registry_dir);
+        g_free (registry_path);
+        g_free (data);
+}
+
+/* Loads the backend files in @path */
+static GList *
+ev_backend_info_scan_dir (const char *path)
 {
         GList       *list = NULL;
         GDir        *dir;
@@ -165,3 +292,33 @@ GList
 
         return list;
 }
+
+/*
+ * _ev_backend_info_load_from_dir:
+ * @path: a directory name
+ *
+ * Load all backend infos from @path, or from the registry made the
+ * last time @path was read if it hasn't been modified since then.
+ *
+ * Returns: a newly allocated #GList containing newly allocated
+ *   #EvBackendInfo objects
+ */
+GList
+*_ev_backend_info_load_from_dir (const char *path)
+{
+        GStatBuf st;
+        GList   *list;
+
+        if (g_stat (path, &st) != 0)
+                return ev_backend_info_scan_dir (path);
+
+        list = ev_backend_info_load_registry (path, st.st_mtime);
+        if (list)
+                return list;
+
+        list = ev_backend_info_scan_dir (path);
+        if (list)
+                ev_backend_info_save_registry (path, st.st_mtime, list);
+
+        return list;
+}
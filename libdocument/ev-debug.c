@@ -38,9 +38,123 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "ev-debug.h"
 
+/* Trace points record how long the hot paths take, always, so that they
+ * can be looked at in release builds. When EV_TRACE is set to a file
+ * name, they are written there in the JSON format of the Trace Event
+ * Profiling Tool, that Perfetto and chrome://tracing load, as complete
+ * events of the given category and name with the page as argument.
+ * Otherwise ev_trace_begin() returns 0 and ev_trace_end() does nothing.
+ */
+static FILE    *trace_file = NULL;
+static GMutex   trace_mutex;
+static gboolean trace_first_event = TRUE;
+static gint     trace_pid;
+static volatile gint n_trace_threads = 0;
+static GPrivate trace_thread_id;
+
+static void
+trace_init (void)
+{
+	const gchar *path = g_getenv ("EV_TRACE");
+
+	if (!path || !*path)
+		return;
+
+	trace_file = fopen (path, "w");
+	if (!trace_file) {
+		g_warning ("Could not open trace file %s", path);
+		return;
+	}
+
+	trace_pid = getpid ();
+	fputs ("[", trace_file);
+}
+
+static void
+trace_shutdown (void)
+{
+	g_mutex_lock (&trace_mutex);
+	if (trace_file) {
+		fputs ("\n]\n", trace_file);
+		fclose (trace_file);
+		trace_file = NULL;
+	}
+	g_mutex_unlock (&trace_mutex);
+}
+
+/* Small ids are easier to follow than thread addresses */
+static gint
+trace_get_thread_id (void)
+{
+	gint id = GPOINTER_TO_INT (g_private_get (&trace_thread_id));
+
+	if (id == 0) {
+		id = g_atomic_int_add (&n_trace_threads, 1) + 1;
+		g_private_set (&trace_thread_id, GINT_TO_POINTER (id));
+	}
+
+	return id;
+}
+
+/*
+ * ev_trace_begin:
+ *
+ * Returns: the time a trace point starts, or 0 if tracing is disabled,
+ *   to be passed to ev_trace_end()
+ */
+gint64
+ev_trace_begin (void)
+{
+	if (G_LIKELY (trace_file == NULL))
+		return 0;
+
+	return g_get_monotonic_time ();
+}
+
+/*
+ * ev_trace_end:
+ * @begin: the value returned by ev_trace_begin()
+ * @category: the category of the trace point
+ * @name: the name of the trace point
+ * @page: the page index, or -1
+ *
+ * Records a trace point from @begin until now.
+ */
+void
+ev_trace_end (gint64       begin,
+	      const gchar *category,
+	      const gchar *name,
+	      gint         page)
+{
+	gint64 end;
+	gchar  args[32] = "";
+
+	if (begin == 0)
+		return;
+
+	end = g_get_monotonic_time ();
+	if (page >= 0)
+		g_snprintf (args, sizeof (args), ", \"args\": {\"page\": %d}", page);
+
+	/* Names are type names and literals, they need no escaping */
+	g_mutex_lock (&trace_mutex);
+	if (trace_file) {
+		fprintf (trace_file,
+			 "%s\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+			 "\"ts\": %" G_GINT64_FORMAT ", \"dur\": %" G_GINT64_FORMAT ", "
+			 "\"pid\": %d, \"tid\": %d%s}",
+			 trace_first_event ? "" : ",",
+			 name, category, begin, end - begin,
+			 trace_pid, trace_get_thread_id (), args);
+		trace_first_event = FALSE;
+	}
+	g_mutex_unlock (&trace_mutex);
+}
+
 #ifdef EV_ENABLE_DEBUG
 static EvDebugSection ev_debug = EV_NO_DEBUG;
 static EvProfileSection ev_profile = EV_NO_PROFILE;
@@ -90,21 +204,6 @@ profile_init (void)
 	}
 }
 
-void
-_ev_debug_init (void)
-{
-	debug_init ();
-	profile_init ();
-}
-
-void
-_ev_debug_shutdown (void)
-{
-	if (timers) {
-		g_hash_table_destroy (timers);
-		timers = NULL;
-	}
-}
 
 void
 ev_debug_message (EvDebugSection  section,
@@ -193,3 +292,25 @@ ev_debug_get_debug_borders (void)
 }
 
 #endif /* EV_ENABLE_DEBUG */
+
+void
+_ev_debug_init (void)
+{
+#ifdef EV_ENABLE_DEBUG
+	debug_init ();
+	profile_init ();
+#endif
+	trace_init ();
+}
+
+void
+_ev_debug_shutdown (void)
+{
+#ifdef EV_ENABLE_DEBUG
+	if (timers) {
+		g_hash_table_destroy (timers);
+		timers = NULL;
+	}
+#endif
+	trace_shutdown ();
+}
@@ -43,10 +43,22 @@
 
 #define EV_GET_TYPE_NAME(instance) g_type_name_from_instance ((gpointer)instance)
 
+G_BEGIN_DECLS
+
+void   _ev_debug_init     (void);
+void   _ev_debug_shutdown (void);
+
+/* Trace points, always available, see ev-debug.c */
+gint64 ev_trace_begin     (void);
+void   ev_trace_end       (gint64       begin,
+			   const gchar *category,
+			   const gchar *name,
+			   gint         page);
+
+G_END_DECLS
+
 #ifndef EV_ENABLE_DEBUG
 
-#define _ev_debug_init()
-#define _ev_debug_shutdown()
 #if defined(G_HAVE_GNUC_VARARGS)
 #define ev_debug_message(section, format, args...) G_STMT_START { } G_STMT_END
 #define ev_profiler_start(format, args...) G_STMT_START { } G_STMT_END
@@ -100,9 +112,6 @@ typedef enum {
 	EV_PROFILE_JOBS = 1 << 0
 } EvProfileSection;
 
-void _ev_debug_init     (void);
-void _ev_debug_shutdown (void);
-
 void ev_debug_message  (EvDebugSection   section,
 			const gchar     *file,
 			gint             line,
@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include "ev-debug.h"
 #include "ev-document-annotations.h"
 
 G_DEFINE_INTERFACE (EvDocumentAnnotations, ev_document_annotations, 0)
@@ -33,8 +34,13 @@ ev_document_annotations_get_annotations (EvDocumentAnnotations *document_annots,
 					 EvPage                *page)
 {
 	EvDocumentAnnotationsInterface *iface = EV_DOCUMENT_ANNOTATIONS_GET_IFACE (document_annots);
+	EvMappingList                  *annots;
+	gint64                          trace = ev_trace_begin ();
 
-	return iface->get_annotations (document_annots, page);
+	annots = iface->get_annotations (document_annots, page);
+	ev_trace_end (trace, "annotations", G_OBJECT_TYPE_NAME (document_annots), page->index);
+
+	return annots;
 }
 
 gboolean
@@ -66,6 +72,42 @@ ev_document_annotations_add_annotation (EvDocumentAnnotations *document_annots,
 		iface->add_annotation (document_annots, annot, rect);
 }
 
+/**
+ * ev_document_annotations_add_annotations:
+ * @document_annots: a #EvDocumentAnnotations
+ * @annots: (element-type EvAnnotation): a #GList of #EvAnnotation<!-- -->s
+ *
+ * Adds all the annotations in @annots to the document, like calling
+ * ev_document_annotations_add_annotation() for each of them, but
+ * letting the backend share the work done for annotations of the same
+ * page. Importing or bulk highlighting should use this with the
+ * document lock held once for the whole list.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_annotations_add_annotations (EvDocumentAnnotations *document_annots,
+					 GList                 *annots)
+{
+	EvDocumentAnnotationsInterface *iface = EV_DOCUMENT_ANNOTATIONS_GET_IFACE (document_annots);
+	GList                          *l;
+
+	if (iface->add_annotations) {
+		iface->add_annotations (document_annots, annots);
+		return;
+	}
+
+	if (!iface->add_annotation)
+		return;
+
+	for (l = annots; l; l = g_list_next (l)) {
+		EvRectangle area;
+
+		ev_annotation_get_area (EV_ANNOTATION (l->data), &area);
+		iface->add_annotation (document_annots, EV_ANNOTATION (l->data), &area);
+	}
+}
+
 gboolean
 ev_document_annotations_can_add_annotation (EvDocumentAnnotations *document_annots)
 {
@@ -85,6 +85,8 @@ struct _EvDocumentAnnotationsInterface
 						 EvAnnotationsSaveMask  mask);
 	void	       (* remove_annotation)    (EvDocumentAnnotations *document_annots,
 						 EvAnnotation          *annot);
+	void           (* add_annotations)      (EvDocumentAnnotations *document_annots,
+						 GList                 *annots);
 };
 
 GType          ev_document_annotations_get_type             (void) G_GNUC_CONST;
@@ -94,6 +96,8 @@ gboolean       ev_document_annotations_document_is_modified (EvDocumentAnnotatio
 void           ev_document_annotations_add_annotation       (EvDocumentAnnotations *document_annots,
 							     EvAnnotation          *annot,
 							     EvRectangle           *rect);
+void           ev_document_annotations_add_annotations      (EvDocumentAnnotations *document_annots,
+							     GList                 *annots);
 void           ev_document_annotations_remove_annotation    (EvDocumentAnnotations *document_annots,
                                                              EvAnnotation          *annot);
 
@@ -33,6 +33,7 @@
 #include "ev-document-factory.h"
 #include "ev-file-helpers.h"
 #include "ev-module.h"
+#include "ev-open-timings.h"
 
 #include "ev-backends-manager.h"
 
@@ -41,29 +42,54 @@
 #define BACKEND_DATA_KEY "ev-backend-info"
 
 static GList *ev_backends_list = NULL;
+static GHashTable *ev_backends_by_mime_type = NULL;
 static GHashTable *ev_module_hash = NULL;
 static gchar *ev_backends_dir = NULL;
 
 static EvDocument* ev_document_factory_new_document_for_mime_type (const char *mime_type,
                                                                    GError **error);
 
-static EvBackendInfo *
-get_backend_info_for_mime_type (const gchar *mime_type)
+/* MIME types are looked up in lowercase, and the first backend
+ * listed for a MIME type is used */
+static GHashTable *
+build_backends_by_mime_type (GList *backends)
 {
-        GList *l;
+        GHashTable *table;
+        GList      *l;
 
-        for (l = ev_backends_list; l; l = l->next) {
+        table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        for (l = backends; l; l = l->next) {
                 EvBackendInfo *info = (EvBackendInfo *) l->data;
                 char **mime_types = info->mime_types;
                 guint i;
 
                 for (i = 0; mime_types[i] != NULL; ++i) {
-                        if (g_ascii_strcasecmp (mime_type, mime_types[i]) == 0)
-                                return info;
+                        gchar *key = g_ascii_strdown (mime_types[i], -1);
+
+                        if (g_hash_table_contains (table, key))
+                                g_free (key);
+                        else
+                                g_hash_table_insert (table, key, info);
                 }
         }
 
-        return NULL;
+        return table;
+}
+
+static EvBackendInfo *
+get_backend_info_for_mime_type (const gchar *mime_type)
+{
+        EvBackendInfo *info;
+        gchar         *key;
+
+        if (ev_backends_by_mime_type == NULL)
+                return NULL;
+
+        key = g_ascii_strdown (mime_type, -1);
+        info = g_hash_table_lookup (ev_backends_by_mime_type, key);
+        g_free (key);
+
+        return info;
 }
 
 static EvBackendInfo *
@@ -133,6 +159,7 @@ ev_document_factory_new_document_for_mime_type (const gchar *mime_type,
                              mime_type, err ? err : "unknown error");
                 return NULL;
         }
+        ev_open_timings_mark ("backend-module");
 
         document = EV_DOCUMENT (_ev_module_new_object (EV_MODULE (module)));
         g_type_module_unuse (module);
@@ -194,6 +221,7 @@ new_document_for_uri (const char        *uri,
 	mime_type = ev_file_get_mime_type (uri, fast, error);
 	if (mime_type == NULL)
 		return NULL;
+	ev_open_timings_mark ("mime-type");
 
 	document = ev_document_factory_new_document_for_mime_type (mime_type, error);
 	if (document == NULL)
@@ -244,8 +272,12 @@ _ev_document_factory_init (void)
 #endif
 
         ev_backends_list = _ev_backend_info_load_from_dir (ev_backends_dir);
+        if (ev_backends_list == NULL)
+                return FALSE;
+
+        ev_backends_by_mime_type = build_backends_by_mime_type (ev_backends_list);
 
-        return ev_backends_list != NULL;
+        return TRUE;
 }
 
 /*
@@ -256,6 +288,7 @@ _ev_document_factory_init (void)
 void
 _ev_document_factory_shutdown (void)
 {
+	g_clear_pointer (&ev_backends_by_mime_type, g_hash_table_unref);
 	g_list_foreach (ev_backends_list, (GFunc) _ev_backend_info_unref, NULL);
 	g_list_free (ev_backends_list);
 	ev_backends_list = NULL;
@@ -270,23 +303,31 @@ _ev_document_factory_shutdown (void)
 }
 
 /**
- * ev_document_factory_get_document_full:
+ * ev_document_factory_get_document_with_progress:
  * @uri: an URI
  * @flags: flags from #EvDocumentLoadFlags
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @progress_func: (scope call) (allow-none): function called with the
+ *   fraction of the load that has been done, or %NULL
+ * @user_data: data to pass to @progress_func
  * @error: a #GError location to store an error, or %NULL
  *
- * Creates a #EvDocument for the document at @uri; or, if no backend handling
- * the document's type is found, or an error occurred on opening the document,
- * returns %NULL and fills in @error.
- * If the document is encrypted, it is returned but also @error is set to
- * %EV_DOCUMENT_ERROR_ENCRYPTED.
+ * Creates a #EvDocument for the document at @uri like
+ * ev_document_factory_get_document_full(), loading it with
+ * ev_document_load_with_progress(). When @cancellable is cancelled,
+ * %NULL is returned and @error is set to %G_IO_ERROR_CANCELLED.
  *
  * Returns: (transfer full): a new #EvDocument, or %NULL
+ *
+ * Since: 3.30
  */
 EvDocument *
-ev_document_factory_get_document_full (const char           *uri,
-				       EvDocumentLoadFlags   flags,
-				       GError              **error)
+ev_document_factory_get_document_with_progress (const char                 *uri,
+						EvDocumentLoadFlags         flags,
+						GCancellable               *cancellable,
+						EvDocumentLoadProgressFunc  progress_func,
+						gpointer                    user_data,
+						GError                    **error)
 {
 	EvDocument *document;
 	int result;
@@ -313,7 +354,9 @@ ev_document_factory_get_document_full (const char           *uri,
 			return NULL;
 		}
 
-		result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
+		result = ev_document_load_with_progress (document, uri_unc ? uri_unc : uri, flags,
+							 cancellable, progress_func, user_data,
+							 &err);
 
 		if (result == FALSE || err) {
 			if (err &&
@@ -321,6 +364,12 @@ ev_document_factory_get_document_full (const char           *uri,
 				g_propagate_error (error, err);
 				return document;
 			    }
+			if (err &&
+			    g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+				g_object_unref (document);
+				g_propagate_error (error, err);
+				return NULL;
+			}
 			/* else fall through to slow mime code section below */
 		} else {
 			return document;
@@ -332,6 +381,8 @@ ev_document_factory_get_document_full (const char           *uri,
 
 	/* Try again with slow mime detection */
 	g_clear_error (&err);
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return NULL;
 	uri_unc = NULL;
 
 	document = new_document_for_uri (uri, FALSE, &compression, &err);
@@ -355,8 +406,10 @@ ev_document_factory_get_document_full (const char           *uri,
 		return NULL;
 	}
 
-	result = ev_document_load_full (document, uri_unc ? uri_unc : uri,
-					EV_DOCUMENT_LOAD_FLAG_NONE, &err);
+	result = ev_document_load_with_progress (document, uri_unc ? uri_unc : uri,
+						 EV_DOCUMENT_LOAD_FLAG_NONE,
+						 cancellable, progress_func, user_data,
+						 &err);
 	if (result == FALSE) {
 		if (err == NULL) {
 			/* FIXME: this really should not happen; the backend should
@@ -380,6 +433,30 @@ ev_document_factory_get_document_full (const char           *uri,
 	return document;
 }
 
+/**
+ * ev_document_factory_get_document_full:
+ * @uri: an URI
+ * @flags: flags from #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Creates a #EvDocument for the document at @uri; or, if no backend handling
+ * the document's type is found, or an error occurred on opening the document,
+ * returns %NULL and fills in @error.
+ * If the document is encrypted, it is returned but also @error is set to
+ * %EV_DOCUMENT_ERROR_ENCRYPTED.
+ *
+ * Returns: (transfer full): a new #EvDocument, or %NULL
+ */
+EvDocument *
+ev_document_factory_get_document_full (const char           *uri,
+				       EvDocumentLoadFlags   flags,
+				       GError              **error)
+{
+	return ev_document_factory_get_document_with_progress (uri, flags,
+							       NULL, NULL, NULL,
+							       error);
+}
+
 /**
  * ev_document_factory_get_document:
  * @uri: an URI
@@ -38,6 +38,12 @@ EvDocument* ev_document_factory_get_document (const char *uri, GError **error);
 EvDocument *ev_document_factory_get_document_full (const char           *uri,
 						   EvDocumentLoadFlags   flags,
 						   GError              **error);
+EvDocument *ev_document_factory_get_document_with_progress (const char                 *uri,
+							    EvDocumentLoadFlags         flags,
+							    GCancellable               *cancellable,
+							    EvDocumentLoadProgressFunc  progress_func,
+							    gpointer                    user_data,
+							    GError                    **error);
 EvDocument* ev_document_factory_get_document_for_gfile (GFile *file,
                                                         EvDocumentLoadFlags flags,
                                                         GCancellable *cancellable,
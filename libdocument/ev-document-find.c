@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include "ev-debug.h"
 #include "ev-document-find.h"
 
 G_DEFINE_INTERFACE (EvDocumentFind, ev_document_find, 0)
@@ -65,11 +66,16 @@ ev_document_find_find_text_with_options (EvDocumentFind *document_find,
 					 EvFindOptions   options)
 {
 	EvDocumentFindInterface *iface = EV_DOCUMENT_FIND_GET_IFACE (document_find);
+	GList                   *matches;
+	gint64                   trace = ev_trace_begin ();
 
 	if (iface->find_text_with_options)
-		return iface->find_text_with_options (document_find, page, text, options);
+		matches = iface->find_text_with_options (document_find, page, text, options);
+	else
+		matches = ev_document_find_find_text (document_find, page, text, options & EV_FIND_CASE_SENSITIVE);
+	ev_trace_end (trace, "find", G_OBJECT_TYPE_NAME (document_find), page->index);
 
-	return ev_document_find_find_text (document_find, page, text, options & EV_FIND_CASE_SENSITIVE);
+	return matches;
 }
 
 EvFindOptions
@@ -43,10 +43,25 @@ G_BEGIN_DECLS
 typedef struct _EvDocumentFind	        EvDocumentFind;
 typedef struct _EvDocumentFindInterface EvDocumentFindInterface;
 
+/**
+ * EvFindOptions:
+ * @EV_FIND_DEFAULT: no options
+ * @EV_FIND_CASE_SENSITIVE: match the case of the text
+ * @EV_FIND_WHOLE_WORDS_ONLY: only match whole words
+ * @EV_FIND_REGEX: the text is a regular expression. Since: 3.30
+ * @EV_FIND_ANY_TERM: the text is a list of terms separated by "|",
+ *   any of which is matched. Since: 3.30
+ *
+ * %EV_FIND_REGEX and %EV_FIND_ANY_TERM are not implemented by the
+ * backends, #EvJobFind matches them on the text of the pages of
+ * documents implementing #EvDocumentText.
+ */
 typedef enum {
 	EV_FIND_DEFAULT          = 0,
 	EV_FIND_CASE_SENSITIVE   = 1 << 0,
-	EV_FIND_WHOLE_WORDS_ONLY = 1 << 1
+	EV_FIND_WHOLE_WORDS_ONLY = 1 << 1,
+	EV_FIND_REGEX            = 1 << 2,
+	EV_FIND_ANY_TERM         = 1 << 3
 } EvFindOptions;
 
 struct _EvDocumentFindInterface
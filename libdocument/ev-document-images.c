@@ -52,3 +52,34 @@ ev_document_images_get_image (EvDocumentImages *document_images,
 
 	return iface->get_image (document_images, image);
 }
+
+/**
+ * ev_document_images_get_image_data:
+ * @document_images: an #EvDocumentImages
+ * @image: an #EvImage
+ * @mime_type: (out): return location for the MIME type of the data
+ *
+ * Gets the image as it's stored in the document, when it's a file on its
+ * own, like a JPEG image, so that it can be saved or copied without being
+ * decoded and encoded again.
+ *
+ * Returns: (transfer full) (nullable): the data of @image, or %NULL if
+ *   the image has to be decoded with ev_document_images_get_image()
+ *
+ * Since: 3.30
+ */
+GBytes *
+ev_document_images_get_image_data (EvDocumentImages *document_images,
+				   EvImage          *image,
+				   gchar           **mime_type)
+{
+	EvDocumentImagesInterface *iface = EV_DOCUMENT_IMAGES_GET_IFACE (document_images);
+
+	g_return_val_if_fail (mime_type != NULL, NULL);
+
+	*mime_type = NULL;
+	if (!iface->get_image_data)
+		return NULL;
+
+	return iface->get_image_data (document_images, image, mime_type);
+}
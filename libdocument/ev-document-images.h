@@ -52,6 +52,9 @@ struct _EvDocumentImagesInterface {
 					      EvPage           *page);
 	GdkPixbuf     *(* get_image)         (EvDocumentImages *document_images,
 					      EvImage          *image);
+	GBytes        *(* get_image_data)    (EvDocumentImages *document_images,
+					      EvImage          *image,
+					      gchar           **mime_type);
 };
 
 GType          ev_document_images_get_type          (void) G_GNUC_CONST;
@@ -59,6 +62,9 @@ EvMappingList *ev_document_images_get_image_mapping (EvDocumentImages *document_
 						     EvPage           *page);
 GdkPixbuf     *ev_document_images_get_image         (EvDocumentImages *document_images,
 						     EvImage          *image);
+GBytes        *ev_document_images_get_image_data    (EvDocumentImages *document_images,
+						     EvImage          *image,
+						     gchar           **mime_type);
 
 G_END_DECLS
 
@@ -78,3 +78,54 @@ ev_document_layers_layer_is_visible (EvDocumentLayers *document_layers,
 
 	return iface->layer_is_visible (document_layers, layer);
 }
+
+static gint
+compare_pages (gconstpointer a,
+	       gconstpointer b)
+{
+	return *(const gint *)a - *(const gint *)b;
+}
+
+/**
+ * ev_document_layers_get_pages:
+ * @document_layers: an #EvDocumentLayers
+ * @layers: (element-type EvLayer): the layers shown or hidden
+ *
+ * Gets the pages whose rendering can change when @layers are shown or
+ * hidden, so that only those are rendered again.
+ *
+ * Returns: (transfer full) (element-type gint) (nullable): the sorted
+ *   indices of the pages, or %NULL if they aren't known, when any page
+ *   can change
+ *
+ * Since: 3.30
+ */
+GArray *
+ev_document_layers_get_pages (EvDocumentLayers *document_layers,
+			      GList            *layers)
+{
+	EvDocumentLayersInterface *iface = EV_DOCUMENT_LAYERS_GET_IFACE (document_layers);
+	GArray                    *pages;
+	GList                     *l;
+	guint                      i, n = 0;
+
+	if (!iface->get_layer_pages)
+		return NULL;
+
+	pages = g_array_new (FALSE, FALSE, sizeof (gint));
+	for (l = layers; l; l = g_list_next (l)) {
+		if (!iface->get_layer_pages (document_layers, EV_LAYER (l->data), pages)) {
+			g_array_free (pages, TRUE);
+			return NULL;
+		}
+	}
+
+	g_array_sort (pages, compare_pages);
+	for (i = 0; i < pages->len; i++) {
+		if (n == 0 || g_array_index (pages, gint, i) != g_array_index (pages, gint, n - 1))
+			g_array_index (pages, gint, n++) = g_array_index (pages, gint, i);
+	}
+	g_array_set_size (pages, n);
+
+	return pages;
+}
@@ -67,6 +67,9 @@ struct _EvDocumentLayersInterface
 					    EvLayer          *layer);
 	gboolean      (* layer_is_visible) (EvDocumentLayers *document_layers,
 					    EvLayer          *layer);
+	gboolean      (* get_layer_pages)  (EvDocumentLayers *document_layers,
+					    EvLayer          *layer,
+					    GArray           *pages);
 };
 
 GType         ev_document_layers_get_type         (void) G_GNUC_CONST;
@@ -79,6 +82,8 @@ void          ev_document_layers_hide_layer       (EvDocumentLayers *document_la
 						   EvLayer          *layer);
 gboolean      ev_document_layers_layer_is_visible (EvDocumentLayers *document_layers,
 						   EvLayer          *layer);
+GArray       *ev_document_layers_get_pages        (EvDocumentLayers *document_layers,
+						   GList            *layers);
 
 G_END_DECLS
 
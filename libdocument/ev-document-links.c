@@ -83,9 +83,9 @@ ev_document_links_find_link_dest (EvDocumentLinks *document_links,
 	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
 	EvLinkDest *retval;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (EV_DOCUMENT (document_links));
 	retval = iface->find_link_dest (document_links, link_name);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (EV_DOCUMENT (document_links));
 
 	return retval;
 }
@@ -97,13 +97,57 @@ ev_document_links_find_link_page (EvDocumentLinks *document_links,
 	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
 	gint retval;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (EV_DOCUMENT (document_links));
 	retval = iface->find_link_page (document_links, link_name);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (EV_DOCUMENT (document_links));
 
 	return retval;
 }
 
+/**
+ * ev_document_links_load_links_children:
+ * @document_links: an #EvDocumentLinks
+ * @model: a #GtkTreeModel returned by ev_document_links_get_links_model()
+ * @parent: a #GtkTreeIter of @model
+ *
+ * Backends can leave out the children of closed items of large outlines
+ * from the links model, adding a child without a link instead. This
+ * replaces it with the actual children of @parent, before expanding it.
+ *
+ * Returns: %TRUE if children were loaded
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_links_load_links_children (EvDocumentLinks *document_links,
+				       GtkTreeModel    *model,
+				       GtkTreeIter     *parent)
+{
+	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
+	GtkTreeIter child;
+	EvLink     *link;
+
+	if (!iface->load_links_children)
+		return FALSE;
+
+	if (!gtk_tree_model_iter_children (model, &child, parent))
+		return FALSE;
+
+	gtk_tree_model_get (model, &child,
+			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+			    -1);
+	if (link) {
+		g_object_unref (link);
+		return FALSE;
+	}
+
+	ev_document_lock (EV_DOCUMENT (document_links));
+	iface->load_links_children (document_links, model, parent);
+	ev_document_unlock (EV_DOCUMENT (document_links));
+
+	return TRUE;
+}
+
 /* Helper functions */
 gint
 ev_document_links_get_dest_page (EvDocumentLinks *document_links,
@@ -69,6 +69,9 @@ struct _EvDocumentLinksInterface
 					       const gchar     *link_name);
 	gint           (* find_link_page)     (EvDocumentLinks *document_links,
 					       const gchar     *link_name);
+	void           (* load_links_children) (EvDocumentLinks *document_links,
+					       GtkTreeModel    *model,
+					       GtkTreeIter     *parent);
 };
 
 GType          ev_document_links_get_type            (void) G_GNUC_CONST;
@@ -81,6 +84,9 @@ EvLinkDest    *ev_document_links_find_link_dest      (EvDocumentLinks *document_
 						      const gchar     *link_name);
 gint           ev_document_links_find_link_page      (EvDocumentLinks *document_links,
 						      const gchar     *link_name);
+gboolean       ev_document_links_load_links_children (EvDocumentLinks *document_links,
+						      GtkTreeModel    *model,
+						      GtkTreeIter     *parent);
 gint           ev_document_links_get_dest_page       (EvDocumentLinks *document_links,
 						      EvLinkDest      *dest);
 gchar         *ev_document_links_get_dest_page_label (EvDocumentLinks *document_links,
@@ -25,6 +25,19 @@
 
 #include <gtk/gtk.h>
 
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__)) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define HAVE_SWAP_RED_BLUE_SSSE3
+#include <immintrin.h>
+#elif defined (__ARM_NEON) && defined (__aarch64__) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define HAVE_SWAP_RED_BLUE_NEON
+#endif
+
 #include "ev-document-misc.h"
 
 /* Returns a new GdkPixbuf that is suitable for placing in the thumbnail view.
@@ -366,22 +379,61 @@ ev_document_misc_paint_one_page (cairo_t      *cr,
 	cairo_fill (cr);
 }
 
+/* c * a / 255, rounded */
+static inline guint
+premultiply (guint c,
+	     guint a)
+{
+	guint t = c * a + 0x80;
+
+	return ((t >> 8) + t) >> 8;
+}
+
 cairo_surface_t *
 ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
 {
 	cairo_surface_t *surface;
-	cairo_t         *cr;
+	const guchar    *src;
+	guchar          *dest;
+	gint             width, height, n_channels;
+	gint             src_stride, dest_stride;
+	gint             x, y;
 
 	g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
 
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
 	surface = cairo_image_surface_create (gdk_pixbuf_get_has_alpha (pixbuf) ?
 					      CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
-					      gdk_pixbuf_get_width (pixbuf),
-					      gdk_pixbuf_get_height (pixbuf));
-	cr = cairo_create (surface);
-	gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
-	cairo_paint (cr);
-	cairo_destroy (cr);
+					      width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+		return surface;
+
+	/* Convert straight into the surface, instead of painting from
+	 * the temporary surface gdk_cairo_set_source_pixbuf() makes */
+	src = gdk_pixbuf_read_pixels (pixbuf);
+	src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	dest = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+
+	for (y = 0; y < height; y++) {
+		const guchar *s = src + (gsize) y * src_stride;
+		guint32      *d = (guint32 *) (dest + (gsize) y * dest_stride);
+
+		if (n_channels == 3) {
+			for (x = 0; x < width; x++, s += 3)
+				d[x] = 0xff000000 | s[0] << 16 | s[1] << 8 | s[2];
+		} else {
+			for (x = 0; x < width; x++, s += 4) {
+				guint a = s[3];
+
+				d[x] = a << 24 | premultiply (s[0], a) << 16 |
+					premultiply (s[1], a) << 8 | premultiply (s[2], a);
+			}
+		}
+	}
+	cairo_surface_mark_dirty (surface);
 	
 	return surface;
 }
@@ -403,6 +455,182 @@ ev_document_misc_pixbuf_from_surface (cairo_surface_t *surface)
                                             cairo_image_surface_get_height (surface));
 }
 
+/* Blocks below this number of pixels are rotated pixel by pixel */
+#define ROTATE_BLOCK_PIXELS 256
+
+/* Rotates the w x h block at x, y of src into dest, splitting it in
+ * halves until it fits in the cache whatever its size */
+static void
+rotate_block (const guchar *src,
+	      gint          src_stride,
+	      guchar       *dest,
+	      gint          dest_stride,
+	      gint          width,
+	      gint          height,
+	      gint          x,
+	      gint          y,
+	      gint          w,
+	      gint          h,
+	      gint          rotation)
+{
+	gint i, j;
+
+	if (w * h > ROTATE_BLOCK_PIXELS) {
+		if (w >= h) {
+			rotate_block (src, src_stride, dest, dest_stride, width, height,
+				      x, y, w / 2, h, rotation);
+			rotate_block (src, src_stride, dest, dest_stride, width, height,
+				      x + w / 2, y, w - w / 2, h, rotation);
+		} else {
+			rotate_block (src, src_stride, dest, dest_stride, width, height,
+				      x, y, w, h / 2, rotation);
+			rotate_block (src, src_stride, dest, dest_stride, width, height,
+				      x, y + h / 2, w, h - h / 2, rotation);
+		}
+		return;
+	}
+
+	for (j = y; j < y + h; j++) {
+		const guint32 *s = (const guint32 *) (src + (gsize) j * src_stride);
+
+		for (i = x; i < x + w; i++) {
+			gint dx, dy;
+
+			/* Same mapping as the cairo matrices below */
+			switch (rotation) {
+			case 90:
+				dx = height - 1 - j;
+				dy = i;
+				break;
+			case 180:
+				dx = width - 1 - i;
+				dy = height - 1 - j;
+				break;
+			default: /* 270 */
+				dx = j;
+				dy = width - 1 - i;
+				break;
+			}
+			((guint32 *) (dest + (gsize) dy * dest_stride))[dx] = s[i];
+		}
+	}
+}
+
+static gboolean
+surface_is_xrgb (cairo_surface_t *surface)
+{
+	return cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE &&
+		(cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32 ||
+		 cairo_image_surface_get_format (surface) == CAIRO_FORMAT_RGB24);
+}
+
+static cairo_surface_t *
+rotate_surface (cairo_surface_t *surface,
+		gint             rotation)
+{
+	cairo_surface_t *new_surface;
+	gint             width, height;
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+
+	new_surface = cairo_image_surface_create (cairo_image_surface_get_format (surface),
+						  rotation == 180 ? width : height,
+						  rotation == 180 ? height : width);
+	if (cairo_surface_status (new_surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (new_surface);
+		return NULL;
+	}
+
+	cairo_surface_flush (surface);
+	rotate_block (cairo_image_surface_get_data (surface),
+		      cairo_image_surface_get_stride (surface),
+		      cairo_image_surface_get_data (new_surface),
+		      cairo_image_surface_get_stride (new_surface),
+		      width, height, 0, 0, width, height, rotation);
+	cairo_surface_mark_dirty (new_surface);
+
+	return new_surface;
+}
+
+/* Shrinks surface averaging the source pixels that fall in every
+ * destination pixel, first along the rows and then down the columns */
+static cairo_surface_t *
+downscale_surface (cairo_surface_t *surface,
+		   gint             dest_width,
+		   gint             dest_height)
+{
+	cairo_surface_t *new_surface;
+	const guchar    *src;
+	guchar          *dest;
+	gint             width, height;
+	gint             src_stride, dest_stride;
+	guint           *columns;
+	guint           *column_counts;
+	guint64         *sums;
+	guint            row_count = 0;
+	gint             x, y, dest_y = 0;
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+
+	new_surface = cairo_image_surface_create (cairo_image_surface_get_format (surface),
+						  dest_width, dest_height);
+	if (cairo_surface_status (new_surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (new_surface);
+		return NULL;
+	}
+
+	cairo_surface_flush (surface);
+	src = cairo_image_surface_get_data (surface);
+	src_stride = cairo_image_surface_get_stride (surface);
+	dest = cairo_image_surface_get_data (new_surface);
+	dest_stride = cairo_image_surface_get_stride (new_surface);
+
+	columns = g_new (guint, width);
+	column_counts = g_new0 (guint, dest_width);
+	for (x = 0; x < width; x++) {
+		columns[x] = (guint64) x * dest_width / width;
+		column_counts[columns[x]]++;
+	}
+	sums = g_new0 (guint64, (gsize) dest_width * 4);
+
+	for (y = 0; y < height; y++) {
+		const guchar *s = src + (gsize) y * src_stride;
+		gint          next_row;
+
+		for (x = 0; x < width; x++) {
+			guint64 *sum = sums + columns[x] * 4;
+
+			sum[0] += s[4 * x];
+			sum[1] += s[4 * x + 1];
+			sum[2] += s[4 * x + 2];
+			sum[3] += s[4 * x + 3];
+		}
+		row_count++;
+
+		next_row = (guint64) (y + 1) * dest_height / height;
+		if (next_row == dest_y)
+			continue;
+
+		for (; dest_y < next_row; dest_y++) {
+			guchar *d = dest + (gsize) dest_y * dest_stride;
+
+			for (x = 0; x < 4 * dest_width; x++)
+				d[x] = sums[x] / ((guint64) column_counts[x / 4] * row_count);
+		}
+		memset (sums, 0, (gsize) dest_width * 4 * sizeof (guint64));
+		row_count = 0;
+	}
+
+	g_free (sums);
+	g_free (column_counts);
+	g_free (columns);
+	cairo_surface_mark_dirty (new_surface);
+
+	return new_surface;
+}
+
 cairo_surface_t *
 ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 					   gint             dest_width,
@@ -424,6 +652,30 @@ ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 		return cairo_surface_reference (surface);
 	}
 
+	/* Shrinking and rotating by multiples of 90 degrees move whole
+	 * pixels, do it without going through cairo when possible */
+	if (surface_is_xrgb (surface) && dest_width > 0 && dest_height > 0 &&
+	    dest_width <= width && dest_height <= height &&
+	    (dest_rotation == 0 || dest_rotation == 90 ||
+	     dest_rotation == 180 || dest_rotation == 270)) {
+		cairo_surface_t *scaled_surface;
+
+		if (dest_width != width || dest_height != height)
+			scaled_surface = downscale_surface (surface, dest_width, dest_height);
+		else
+			scaled_surface = cairo_surface_reference (surface);
+
+		if (scaled_surface && dest_rotation != 0) {
+			new_surface = rotate_surface (scaled_surface, dest_rotation);
+			cairo_surface_destroy (scaled_surface);
+		} else {
+			new_surface = scaled_surface;
+		}
+
+		if (new_surface)
+			return new_surface;
+	}
+
 	if (dest_rotation == 90 || dest_rotation == 270) {
 		new_width = dest_height;
 		new_height = dest_width;
@@ -463,10 +715,85 @@ ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 	return new_surface;
 }
 
+/* XORs len bytes of data with the 4 bytes of mask, as laid out in memory */
+static void
+xor_bytes (guint8  *data,
+	   gsize    len,
+	   guint32  mask)
+{
+	const guint8 *mask_bytes = (const guint8 *) &mask;
+	gsize         i = 0;
+
+#if defined (__SSE2__)
+	const __m128i m = _mm_set1_epi32 ((gint) mask);
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+
+		_mm_storeu_si128 ((__m128i *) (data + i), _mm_xor_si128 (v, m));
+	}
+#elif defined (__ARM_NEON)
+	const uint8x16_t m = vreinterpretq_u8_u32 (vdupq_n_u32 (mask));
+
+	for (; i + 16 <= len; i += 16)
+		vst1q_u8 (data + i, veorq_u8 (vld1q_u8 (data + i), m));
+#endif
+	for (; i < len; i++)
+		data[i] ^= mask_bytes[i % 4];
+}
+
+/* Inverts the colors of n native-endian xRGB pixels, making them opaque */
+static void
+invert_xrgb (guint32 *pixels,
+	     gsize    n)
+{
+	gsize i = 0;
+
+#if defined (__SSE2__)
+	const __m128i alpha = _mm_set1_epi32 ((gint) 0xff000000);
+	const __m128i ones = _mm_set1_epi32 (-1);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (pixels + i));
+
+		v = _mm_or_si128 (_mm_xor_si128 (v, ones), alpha);
+		_mm_storeu_si128 ((__m128i *) (pixels + i), v);
+	}
+#elif defined (__ARM_NEON)
+	const uint32x4_t alpha = vdupq_n_u32 (0xff000000);
+
+	for (; i + 4 <= n; i += 4)
+		vst1q_u32 (pixels + i, vorrq_u32 (vmvnq_u32 (vld1q_u32 (pixels + i)), alpha));
+#endif
+	for (; i < n; i++)
+		pixels[i] = ~pixels[i] | 0xff000000;
+}
+
 void
 ev_document_misc_invert_surface (cairo_surface_t *surface) {
 	cairo_t *cr;
 
+	/* Same result as the DIFFERENCE paint below: inverted
+	 * premultiplied colors and opaque alpha */
+	if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE &&
+	    (cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32 ||
+	     cairo_image_surface_get_format (surface) == CAIRO_FORMAT_RGB24)) {
+		guchar *data;
+		gint    width, height, stride, y;
+
+		cairo_surface_flush (surface);
+		data = cairo_image_surface_get_data (surface);
+		width = cairo_image_surface_get_width (surface);
+		height = cairo_image_surface_get_height (surface);
+		stride = cairo_image_surface_get_stride (surface);
+		if (data) {
+			for (y = 0; y < height; y++)
+				invert_xrgb ((guint32 *) (data + (gsize) y * stride), width);
+			cairo_surface_mark_dirty (surface);
+			return;
+		}
+	}
+
 	cr = cairo_create (surface);
 
 	/* white + DIFFERENCE -> invert */
@@ -479,8 +806,9 @@ ev_document_misc_invert_surface (cairo_surface_t *surface) {
 void
 ev_document_misc_invert_pixbuf (GdkPixbuf *pixbuf)
 {
-	guchar *data, *p;
-	guint   width, height, x, y, rowstride, n_channels;
+	guchar  *data;
+	guint    width, height, y, rowstride, n_channels;
+	guint32  mask;
 
 	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
 	g_assert (gdk_pixbuf_get_colorspace (pixbuf) == GDK_COLORSPACE_RGB);
@@ -494,16 +822,109 @@ ev_document_misc_invert_pixbuf (GdkPixbuf *pixbuf)
 
 	width = gdk_pixbuf_get_width (pixbuf);
 	height = gdk_pixbuf_get_height (pixbuf);
-	for (x = 0; x < width; x++) {
-		for (y = 0; y < height; y++) {
-			/* Calculate pixel's offset into the data array. */
-			p = data + x * n_channels + y * rowstride;
-			/* Change the RGB values*/
-			p[0] = 255 - p[0];
-			p[1] = 255 - p[1];
-			p[2] = 255 - p[2];
-		}
+
+	/* Invert the RGB bytes, 255 - c is c ^ 0xff, and keep alpha */
+	mask = n_channels == 4 ? GUINT32_FROM_BE (0xffffff00) : 0xffffffff;
+	for (y = 0; y < height; y++)
+		xor_bytes (data + (gsize) y * rowstride, (gsize) width * n_channels, mask);
+}
+
+static void
+swap_red_blue_scalar (guint32       *dest,
+		      const guint32 *src,
+		      gsize          n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint32 pixel = src[i];
+
+		dest[i] = (pixel & 0xff00ff00) |
+			((pixel >> 16) & 0xff) |
+			((pixel & 0xff) << 16);
+	}
+}
+
+#ifdef HAVE_SWAP_RED_BLUE_SSSE3
+__attribute__((target("ssse3")))
+static void
+swap_red_blue_ssse3 (guint32       *dest,
+		     const guint32 *src,
+		     gsize          n_pixels)
+{
+	const __m128i mask = _mm_setr_epi8 (2, 1, 0, 3, 6, 5, 4, 7,
+					    10, 9, 8, 11, 14, 13, 12, 15);
+	gsize i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) (src + i));
+
+		_mm_storeu_si128 ((__m128i *) (dest + i), _mm_shuffle_epi8 (pixels, mask));
+	}
+	swap_red_blue_scalar (dest + i, src + i, n_pixels - i);
+}
+#endif
+
+#ifdef HAVE_SWAP_RED_BLUE_NEON
+static void
+swap_red_blue_neon (guint32       *dest,
+		    const guint32 *src,
+		    gsize          n_pixels)
+{
+	static const guint8 indices[16] = { 2, 1, 0, 3, 6, 5, 4, 7,
+					    10, 9, 8, 11, 14, 13, 12, 15 };
+	const uint8x16_t mask = vld1q_u8 (indices);
+	gsize i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4) {
+		uint8x16_t pixels = vld1q_u8 ((const guint8 *) (src + i));
+
+		vst1q_u8 ((guint8 *) (dest + i), vqtbl1q_u8 (pixels, mask));
 	}
+	swap_red_blue_scalar (dest + i, src + i, n_pixels - i);
+}
+#endif
+
+typedef void (* SwapRedBlueFunc) (guint32 *dest, const guint32 *src, gsize n_pixels);
+
+static SwapRedBlueFunc
+swap_red_blue_select (void)
+{
+#if defined (HAVE_SWAP_RED_BLUE_SSSE3)
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("ssse3"))
+		return swap_red_blue_ssse3;
+#elif defined (HAVE_SWAP_RED_BLUE_NEON)
+	return swap_red_blue_neon;
+#endif
+	return swap_red_blue_scalar;
+}
+
+/**
+ * ev_document_misc_convert_abgr_to_argb:
+ * @dest: the converted pixels
+ * @src: the pixels to convert
+ * @n_pixels: the number of pixels
+ *
+ * Converts pixels stored as 0xAABBGGRR 32-bit values, like those
+ * returned by libtiff or RGBA bytes on little-endian machines, to the
+ * 0xAARRGGBB values used by cairo image surfaces, by swapping the red
+ * and blue channels. The conversion is its own inverse. @dest and @src
+ * can be the same buffer, doing the conversion in place.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_misc_convert_abgr_to_argb (guint32       *dest,
+				       const guint32 *src,
+				       gsize          n_pixels)
+{
+	/* Selecting twice from concurrent threads is harmless */
+	static SwapRedBlueFunc swap_red_blue = NULL;
+
+	if (!swap_red_blue)
+		swap_red_blue = swap_red_blue_select ();
+	swap_red_blue (dest, src, n_pixels);
 }
 
 gdouble
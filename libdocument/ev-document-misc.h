@@ -79,6 +79,9 @@ cairo_surface_t *ev_document_misc_surface_rotate_and_scale (cairo_surface_t *sur
 							    gint             dest_rotation);
 void             ev_document_misc_invert_surface (cairo_surface_t *surface);
 void		 ev_document_misc_invert_pixbuf  (GdkPixbuf       *pixbuf);
+void             ev_document_misc_convert_abgr_to_argb (guint32       *dest,
+							const guint32 *src,
+							gsize          n_pixels);
 
 gdouble          ev_document_misc_get_screen_dpi (GdkScreen *screen);
 
@@ -21,8 +21,43 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "ev-document-text.h"
 
+/* Text cache budget of every document, in bytes */
+#define EV_TEXT_CACHE_SIZE (16 * 1024 * 1024)
+
+/* Extracting the text of a page means parsing its contents again in
+ * most backends, and the same pages are asked for by searches, the
+ * find sidebar, selections and caret navigation. So the text, the
+ * layout and the log attributes of the most recently used pages are
+ * kept in a cache attached to the document, and callers get copies.
+ * Backends are called with the cache unlocked, under the document
+ * lock held by the callers.
+ */
+typedef struct {
+	gint          page;
+	GList        *link;
+	gsize         size;
+
+	gchar        *text;
+	EvRectangle  *areas;
+	guint         n_areas;
+	gboolean      has_layout;
+	PangoLogAttr *log_attrs;
+	gulong        n_log_attrs;
+} EvTextCacheEntry;
+
+typedef struct {
+	GMutex      mutex;
+	GHashTable *entries; /* page index -> EvTextCacheEntry */
+	GQueue      lru;     /* Most recently used first */
+	gsize       usage;
+} EvTextCache;
+
+G_LOCK_DEFINE_STATIC (text_cache);
+
 G_DEFINE_INTERFACE (EvDocumentText, ev_document_text, 0)
 
 static void
@@ -30,18 +65,173 @@ ev_document_text_default_init (EvDocumentTextInterface *klass)
 {
 }
 
+static void
+ev_text_cache_entry_free (EvTextCacheEntry *entry)
+{
+	g_free (entry->text);
+	g_free (entry->areas);
+	g_free (entry->log_attrs);
+	g_slice_free (EvTextCacheEntry, entry);
+}
+
+static void
+ev_text_cache_free (EvTextCache *cache)
+{
+	g_hash_table_destroy (cache->entries);
+	g_queue_clear (&cache->lru);
+	g_mutex_clear (&cache->mutex);
+	g_slice_free (EvTextCache, cache);
+}
+
+static GQuark
+ev_text_cache_quark (void)
+{
+	static GQuark quark = 0;
+
+	if (G_UNLIKELY (quark == 0))
+		quark = g_quark_from_static_string ("ev-text-cache");
+
+	return quark;
+}
+
+static EvTextCache *
+ev_text_cache_get (EvDocumentText *document_text)
+{
+	EvTextCache *cache;
+
+	G_LOCK (text_cache);
+	cache = g_object_get_qdata (G_OBJECT (document_text), ev_text_cache_quark ());
+	if (!cache) {
+		cache = g_slice_new0 (EvTextCache);
+		g_mutex_init (&cache->mutex);
+		cache->entries = g_hash_table_new_full (NULL, NULL, NULL,
+							(GDestroyNotify) ev_text_cache_entry_free);
+		g_object_set_qdata_full (G_OBJECT (document_text), ev_text_cache_quark (),
+					 cache, (GDestroyNotify) ev_text_cache_free);
+	}
+	G_UNLOCK (text_cache);
+
+	return cache;
+}
+
+static EvTextCacheEntry *
+ev_text_cache_lookup_unlocked (EvTextCache *cache,
+			       gint         page)
+{
+	EvTextCacheEntry *entry;
+
+	entry = g_hash_table_lookup (cache->entries, GINT_TO_POINTER (page));
+	if (entry && entry->link != cache->lru.head) {
+		g_queue_unlink (&cache->lru, entry->link);
+		g_queue_push_head_link (&cache->lru, entry->link);
+	}
+
+	return entry;
+}
+
+static EvTextCacheEntry *
+ev_text_cache_ensure_unlocked (EvTextCache *cache,
+			       gint         page)
+{
+	EvTextCacheEntry *entry;
+
+	entry = ev_text_cache_lookup_unlocked (cache, page);
+	if (entry)
+		return entry;
+
+	entry = g_slice_new0 (EvTextCacheEntry);
+	entry->page = page;
+	g_queue_push_head (&cache->lru, entry);
+	entry->link = cache->lru.head;
+	g_hash_table_insert (cache->entries, GINT_TO_POINTER (page), entry);
+
+	return entry;
+}
+
+static void
+ev_text_cache_grow_unlocked (EvTextCache      *cache,
+			     EvTextCacheEntry *entry,
+			     gsize             size)
+{
+	entry->size += size;
+	cache->usage += size;
+
+	while (cache->usage > EV_TEXT_CACHE_SIZE && cache->lru.tail) {
+		EvTextCacheEntry *last = g_queue_peek_tail (&cache->lru);
+
+		g_queue_pop_tail (&cache->lru);
+		cache->usage -= last->size;
+		g_hash_table_remove (cache->entries, GINT_TO_POINTER (last->page));
+	}
+}
+
+static void
+ev_text_cache_store_text (EvTextCache *cache,
+			  gint         page,
+			  const gchar *text)
+{
+	EvTextCacheEntry *entry;
+
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_ensure_unlocked (cache, page);
+	if (!entry->text) {
+		gsize len = strlen (text);
+
+		entry->text = g_memdup (text, len + 1);
+		ev_text_cache_grow_unlocked (cache, entry, len + 1);
+	}
+	g_mutex_unlock (&cache->mutex);
+}
+
+static void
+ev_text_cache_store_layout (EvTextCache       *cache,
+			    gint               page,
+			    const EvRectangle *areas,
+			    guint              n_areas)
+{
+	EvTextCacheEntry *entry;
+
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_ensure_unlocked (cache, page);
+	if (!entry->has_layout) {
+		gsize size = n_areas * sizeof (EvRectangle);
+
+		entry->areas = g_memdup (areas, size);
+		entry->n_areas = n_areas;
+		entry->has_layout = TRUE;
+		ev_text_cache_grow_unlocked (cache, entry, size);
+	}
+	g_mutex_unlock (&cache->mutex);
+}
+
 gchar *
 ev_document_text_get_text (EvDocumentText   *document_text,
 			   EvPage           *page)
 {
 	EvDocumentTextInterface *iface = EV_DOCUMENT_TEXT_GET_IFACE (document_text);
+	EvTextCache             *cache;
+	EvTextCacheEntry        *entry;
+	gchar                   *text;
 
 	if (!iface->get_text)
 		return NULL;
 
-	return iface->get_text (document_text, page);
-}
+	cache = ev_text_cache_get (document_text);
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_lookup_unlocked (cache, page->index);
+	text = entry ? g_strdup (entry->text) : NULL;
+	g_mutex_unlock (&cache->mutex);
+	if (text)
+		return text;
+
+	text = iface->get_text (document_text, page);
+	if (!text)
+		return NULL;
 
+	ev_text_cache_store_text (cache, page->index, text);
+
+	return text;
+}
 
 gboolean
 ev_document_text_get_text_layout (EvDocumentText   *document_text,
@@ -50,11 +240,98 @@ ev_document_text_get_text_layout (EvDocumentText   *document_text,
 				  guint            *n_areas)
 {
 	EvDocumentTextInterface *iface = EV_DOCUMENT_TEXT_GET_IFACE (document_text);
+	EvTextCache             *cache;
+	EvTextCacheEntry        *entry;
 
 	if (!iface->get_text_layout)
 		return FALSE;
 
-	return iface->get_text_layout (document_text, page, areas, n_areas);
+	cache = ev_text_cache_get (document_text);
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_lookup_unlocked (cache, page->index);
+	if (entry && entry->has_layout) {
+		*areas = g_memdup (entry->areas, entry->n_areas * sizeof (EvRectangle));
+		*n_areas = entry->n_areas;
+		g_mutex_unlock (&cache->mutex);
+
+		return TRUE;
+	}
+	g_mutex_unlock (&cache->mutex);
+
+	if (!iface->get_text_layout (document_text, page, areas, n_areas))
+		return FALSE;
+
+	ev_text_cache_store_layout (cache, page->index, *areas, *n_areas);
+
+	return TRUE;
+}
+
+/**
+ * ev_document_text_get_text_log_attrs:
+ * @document_text: a #EvDocumentText
+ * @page: a #EvPage
+ * @log_attrs: (out) (transfer full) (array length=n_attrs): return
+ *   location for the #PangoLogAttr<!-- -->s of the text of @page, one
+ *   more than its number of characters
+ * @n_attrs: (out): return location for the number of characters
+ *
+ * Gets the logical attributes of the text of @page, like
+ * pango_get_log_attrs() does on the text returned by
+ * ev_document_text_get_text(), but computed only once per page.
+ *
+ * Returns: %TRUE if @page has text
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_text_get_text_log_attrs (EvDocumentText *document_text,
+				     EvPage         *page,
+				     PangoLogAttr  **log_attrs,
+				     gulong         *n_attrs)
+{
+	EvTextCache      *cache;
+	EvTextCacheEntry *entry;
+	PangoLogAttr     *attrs;
+	gchar            *text;
+	gulong            n;
+
+	cache = ev_text_cache_get (document_text);
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_lookup_unlocked (cache, page->index);
+	if (entry && entry->log_attrs) {
+		*log_attrs = g_memdup (entry->log_attrs, (entry->n_log_attrs + 1) * sizeof (PangoLogAttr));
+		*n_attrs = entry->n_log_attrs;
+		g_mutex_unlock (&cache->mutex);
+
+		return TRUE;
+	}
+	g_mutex_unlock (&cache->mutex);
+
+	text = ev_document_text_get_text (document_text, page);
+	if (!text)
+		return FALSE;
+
+	n = g_utf8_strlen (text, -1);
+	attrs = g_new0 (PangoLogAttr, n + 1);
+	/* FIXME: We need API to get the language of the document */
+	pango_get_log_attrs (text, -1, -1, NULL, attrs, n + 1);
+	g_free (text);
+
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_ensure_unlocked (cache, page->index);
+	if (!entry->log_attrs) {
+		gsize size = (n + 1) * sizeof (PangoLogAttr);
+
+		entry->log_attrs = g_memdup (attrs, size);
+		entry->n_log_attrs = n;
+		ev_text_cache_grow_unlocked (cache, entry, size);
+	}
+	g_mutex_unlock (&cache->mutex);
+
+	*log_attrs = attrs;
+	*n_attrs = n;
+
+	return TRUE;
 }
 
 cairo_region_t *
@@ -91,3 +368,99 @@ ev_document_text_get_text_attrs (EvDocumentText *document_text,
 
 	return iface->get_text_attrs (document_text, page);
 }
+
+/**
+ * ev_document_text_get_text_data:
+ * @document_text: a #EvDocumentText
+ * @page: a #EvPage
+ * @flags: the #EvDocumentTextDataFlags of the data to get
+ * @text: (out) (transfer full) (allow-none): return location for the
+ *   text of @page, or %NULL if %EV_DOCUMENT_TEXT_DATA_TEXT is not in @flags
+ * @areas: (out) (transfer full) (array length=n_areas) (allow-none):
+ *   return location for the text layout of @page
+ * @n_areas: (out) (allow-none): return location for the number of @areas
+ * @mapping: (out) (transfer full) (allow-none): return location for the
+ *   text mapping of @page
+ * @attrs: (out) (transfer full) (allow-none): return location for the
+ *   text attributes of @page
+ *
+ * Gets the text data of @page selected by @flags at once, like calling
+ * ev_document_text_get_text(), ev_document_text_get_text_layout(),
+ * ev_document_text_get_text_mapping() and ev_document_text_get_text_attrs()
+ * in turn, but letting backends extract the text of @page only once.
+ * The locations of the data not in @flags are left untouched.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_text_get_text_data (EvDocumentText         *document_text,
+				EvPage                 *page,
+				EvDocumentTextDataFlags flags,
+				gchar                 **text,
+				EvRectangle           **areas,
+				guint                  *n_areas,
+				cairo_region_t        **mapping,
+				PangoAttrList         **attrs)
+{
+	EvDocumentTextInterface *iface = EV_DOCUMENT_TEXT_GET_IFACE (document_text);
+	EvTextCache             *cache;
+	EvTextCacheEntry        *entry;
+	gchar                   *new_text = NULL;
+	EvRectangle             *new_areas = NULL;
+	guint                    new_n_areas = 0;
+
+	if (flags & EV_DOCUMENT_TEXT_DATA_TEXT)
+		*text = NULL;
+	if (flags & EV_DOCUMENT_TEXT_DATA_LAYOUT) {
+		*areas = NULL;
+		*n_areas = 0;
+	}
+	if (flags & EV_DOCUMENT_TEXT_DATA_MAPPING)
+		*mapping = NULL;
+	if (flags & EV_DOCUMENT_TEXT_DATA_ATTRS)
+		*attrs = NULL;
+
+	if (!iface->get_text_data) {
+		if (flags & EV_DOCUMENT_TEXT_DATA_TEXT)
+			*text = ev_document_text_get_text (document_text, page);
+		if (flags & EV_DOCUMENT_TEXT_DATA_LAYOUT)
+			ev_document_text_get_text_layout (document_text, page, areas, n_areas);
+		if (flags & EV_DOCUMENT_TEXT_DATA_MAPPING)
+			*mapping = ev_document_text_get_text_mapping (document_text, page);
+		if (flags & EV_DOCUMENT_TEXT_DATA_ATTRS)
+			*attrs = ev_document_text_get_text_attrs (document_text, page);
+		return;
+	}
+
+	/* Only ask the backend for what is not cached already */
+	cache = ev_text_cache_get (document_text);
+	g_mutex_lock (&cache->mutex);
+	entry = ev_text_cache_lookup_unlocked (cache, page->index);
+	if (entry && entry->text && (flags & EV_DOCUMENT_TEXT_DATA_TEXT)) {
+		*text = g_strdup (entry->text);
+		flags &= ~EV_DOCUMENT_TEXT_DATA_TEXT;
+	}
+	if (entry && entry->has_layout && (flags & EV_DOCUMENT_TEXT_DATA_LAYOUT)) {
+		*areas = g_memdup (entry->areas, entry->n_areas * sizeof (EvRectangle));
+		*n_areas = entry->n_areas;
+		flags &= ~EV_DOCUMENT_TEXT_DATA_LAYOUT;
+	}
+	g_mutex_unlock (&cache->mutex);
+
+	if (flags == EV_DOCUMENT_TEXT_DATA_NONE)
+		return;
+
+	iface->get_text_data (document_text, page, flags,
+			      &new_text, &new_areas, &new_n_areas,
+			      mapping, attrs);
+
+	if (new_text) {
+		ev_text_cache_store_text (cache, page->index, new_text);
+		*text = new_text;
+	}
+	if (new_areas) {
+		ev_text_cache_store_layout (cache, page->index, new_areas, new_n_areas);
+		*areas = new_areas;
+		*n_areas = new_n_areas;
+	}
+}
@@ -44,6 +44,14 @@ G_BEGIN_DECLS
 typedef struct _EvDocumentText          EvDocumentText;
 typedef struct _EvDocumentTextInterface EvDocumentTextInterface;
 
+typedef enum {
+	EV_DOCUMENT_TEXT_DATA_NONE    = 0,
+	EV_DOCUMENT_TEXT_DATA_TEXT    = 1 << 0,
+	EV_DOCUMENT_TEXT_DATA_LAYOUT  = 1 << 1,
+	EV_DOCUMENT_TEXT_DATA_MAPPING = 1 << 2,
+	EV_DOCUMENT_TEXT_DATA_ATTRS   = 1 << 3
+} EvDocumentTextDataFlags;
+
 struct _EvDocumentTextInterface
 {
         GTypeInterface base_iface;
@@ -59,6 +67,14 @@ struct _EvDocumentTextInterface
 					      guint            *n_areas);
 	PangoAttrList  *(* get_text_attrs)   (EvDocumentText   *document_text,
 					      EvPage           *page);
+	void            (* get_text_data)    (EvDocumentText   *document_text,
+					      EvPage           *page,
+					      EvDocumentTextDataFlags flags,
+					      gchar           **text,
+					      EvRectangle     **areas,
+					      guint            *n_areas,
+					      cairo_region_t  **mapping,
+					      PangoAttrList   **attrs);
 };
 
 GType           ev_document_text_get_type         (void) G_GNUC_CONST;
@@ -73,6 +89,18 @@ cairo_region_t *ev_document_text_get_text_mapping (EvDocumentText  *document_tex
 						   EvPage          *page);
 PangoAttrList  *ev_document_text_get_text_attrs   (EvDocumentText  *document_text,
 						   EvPage          *page);
+gboolean        ev_document_text_get_text_log_attrs (EvDocumentText *document_text,
+						     EvPage         *page,
+						     PangoLogAttr  **log_attrs,
+						     gulong         *n_attrs);
+void            ev_document_text_get_text_data    (EvDocumentText  *document_text,
+						   EvPage          *page,
+						   EvDocumentTextDataFlags flags,
+						   gchar          **text,
+						   EvRectangle    **areas,
+						   guint           *n_areas,
+						   cairo_region_t **mapping,
+						   PangoAttrList  **attrs);
 G_END_DECLS
 
 #endif /* EV_DOCUMENT_TEXT_H */
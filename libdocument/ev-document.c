@@ -24,9 +24,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ev-debug.h"
 #include "ev-document.h"
 #include "ev-document-misc.h"
-#include "synctex_parser.h"
+#include "ev-open-timings.h"
+#include "ev-synctex-index.h"
 
 #define EV_DOCUMENT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), EV_TYPE_DOCUMENT, EvDocumentPrivate))
 
@@ -35,6 +37,35 @@ enum {
 	PROP_MODIFIED
 };
 
+enum {
+	CACHE_UPDATED,
+	N_SIGNALS
+};
+
+/* Documents with more pages than this get most of their page sizes
+ * and labels in a thread, after the first EV_CACHE_SYNC_PAGES ones,
+ * so that they can be shown before all pages are probed. The pages
+ * given to ev_document_prioritize_page() are probed first.
+ */
+#define EV_CACHE_INCREMENTAL_MIN_PAGES 64
+#define EV_CACHE_SYNC_PAGES            16
+#define EV_CACHE_BATCH_PAGES           64
+#define EV_CACHE_PRIORITY_PAGES        8
+
+/* The sizes and labels of documents with at least this number of pages
+ * are saved in the user cache directory, to be reused when the
+ * document is opened again.
+ */
+#define EV_CACHE_PERSIST_MIN_PAGES     256
+#define EV_CACHE_FILE_VERSION          2
+#define EV_CACHE_FILE_FORMAT           "(uttsu(dddd)ba(dd)as)"
+#define EV_CACHE_CHECKSUM_CHUNK        65536
+
+/* Pages recently returned by ev_document_get_page(), the same pages are
+ * usually needed by several jobs in a row.
+ */
+#define EV_PAGE_POOL_SIZE              32
+
 typedef struct _EvPageSize
 {
 	gdouble width;
@@ -45,8 +76,13 @@ struct _EvDocumentPrivate
 {
 	gchar          *uri;
 	guint64         file_size;
+	gchar          *fingerprint;
+
+	/* Checksums of the pages, computed on demand */
+	GPtrArray      *page_digests;
 
 	gboolean        cache_loaded;
+	gint            n_probed_pages;
 	gint            n_pages;
 	gboolean        modified;
 
@@ -59,14 +95,60 @@ struct _EvDocumentPrivate
 	gdouble         min_width;
 	gdouble         min_height;
 	gint            max_label;
+	gboolean        custom_page_labels;
 
 	gchar         **page_labels;
 	EvPageSize     *page_sizes;
+
+	/* Index of the page labels, built on the first lookup */
+	GHashTable     *label_index;
+	gint           *sorted_labels;
+	gint            n_sorted_labels;
+
 	EvDocumentInfo *info;
 
-	synctex_scanner_t synctex_scanner;
+	/* The load in progress, see ev_document_load_with_progress().
+	 * Backends report the progress of their part, which goes from
+	 * load_progress_start to load_progress_end of the whole load. */
+	GCancellable   *load_cancellable;
+	EvDocumentLoadProgressFunc load_progress_func;
+	gpointer        load_progress_data;
+	gdouble         load_progress_start;
+	gdouble         load_progress_end;
+	gdouble         load_progress_reported;
+
+	/* Synctex data, indexed from a thread, see
+	 * ev_document_initialize_synctex() */
+	GMutex          synctex_mutex;
+	GCond           synctex_cond;
+	gboolean        has_synctex;
+	gboolean        synctex_indexing;
+	gint            synctex_generation;
+	EvSynctexIndex *synctex_index;
+
+	GMutex          mutex;
+	GThread        *lock_owner; /* Thread holding mutex, or NULL */
+
+	/* The cache is updated from a thread for large documents. Pages not
+	 * probed yet are assumed to have the size of the first one.
+	 */
+	GMutex          cache_mutex;
+	GMutex          probe_mutex;
+	volatile gint   cache_generation;
+	volatile gint   cache_updated_pending;
+	volatile gint   priority_page;
+
+	/* Most recently used first */
+	EvPage         *page_pool[EV_PAGE_POOL_SIZE];
+	guint           page_pool_len;
+	GMutex          page_pool_mutex;
 };
 
+typedef struct {
+	EvDocument *document;
+	gint        generation;
+} EvCacheProbe;
+
 static guint64         _ev_document_get_size_gfile  (GFile      *file);
 static guint64         _ev_document_get_size        (const char *uri);
 static gint            _ev_document_get_n_pages     (EvDocument *document);
@@ -79,9 +161,33 @@ static gchar          *_ev_document_get_page_label  (EvDocument *document,
 static EvDocumentInfo *_ev_document_get_info        (EvDocument *document);
 static gboolean        _ev_document_support_synctex (EvDocument *document);
 
+static void            ev_document_clear_page_pool  (EvDocument *document);
+
 static GMutex ev_doc_mutex;
 static GMutex ev_fc_mutex;
 
+/* How often the global mutexes had to be waited for, and for how
+ * long. Acquisitions are counted atomically, the rest is updated
+ * under stats_mutex: the waits when the mutex was contended, and
+ * since when and by which thread the mutex is held, to tell what
+ * blocks the main loop when it stalls.
+ */
+typedef struct {
+	gint     n_locked;
+	guint    n_contended;
+	gint64   wait_total;
+	gint64   wait_max;
+	/* 0 while unlocked */
+	gint64   locked_time;
+	gboolean main_thread;
+} EvMutexStats;
+
+static GMutex       stats_mutex;
+static EvMutexStats doc_mutex_stats;
+static EvMutexStats fc_mutex_stats;
+
+static guint signals[N_SIGNALS];
+
 G_DEFINE_ABSTRACT_TYPE (EvDocument, ev_document, G_TYPE_OBJECT)
 
 GQuark
@@ -117,11 +223,16 @@ ev_document_finalize (GObject *object)
 		document->priv->uri = NULL;
 	}
 
+	g_clear_pointer (&document->priv->fingerprint, g_free);
+	g_clear_pointer (&document->priv->page_digests, g_ptr_array_unref);
+
 	if (document->priv->page_sizes) {
 		g_free (document->priv->page_sizes);
 		document->priv->page_sizes = NULL;
 	}
 
+	g_clear_pointer (&document->priv->label_index, g_hash_table_destroy);
+	g_clear_pointer (&document->priv->sorted_labels, g_free);
 	g_clear_pointer (&document->priv->page_labels, g_strfreev);
 
 	if (document->priv->info) {
@@ -129,10 +240,16 @@ ev_document_finalize (GObject *object)
 		document->priv->info = NULL;
 	}
 
-	if (document->priv->synctex_scanner) {
-		synctex_scanner_free (document->priv->synctex_scanner);
-		document->priv->synctex_scanner = NULL;
-	}
+	g_clear_pointer (&document->priv->synctex_index, ev_synctex_index_free);
+
+	g_mutex_clear (&document->priv->mutex);
+	g_mutex_clear (&document->priv->synctex_mutex);
+	g_cond_clear (&document->priv->synctex_cond);
+	g_mutex_clear (&document->priv->cache_mutex);
+	g_mutex_clear (&document->priv->probe_mutex);
+
+	ev_document_clear_page_pool (document);
+	g_mutex_clear (&document->priv->page_pool_mutex);
 
 	G_OBJECT_CLASS (ev_document_parent_class)->finalize (object);
 }
@@ -177,8 +294,16 @@ ev_document_init (EvDocument *document)
 {
 	document->priv = EV_DOCUMENT_GET_PRIVATE (document);
 
+	g_mutex_init (&document->priv->mutex);
+	g_mutex_init (&document->priv->cache_mutex);
+	g_mutex_init (&document->priv->probe_mutex);
+	g_mutex_init (&document->priv->page_pool_mutex);
+	g_mutex_init (&document->priv->synctex_mutex);
+	g_cond_init (&document->priv->synctex_cond);
+
 	/* Assume all pages are the same size until proven otherwise */
 	document->priv->uniform = TRUE;
+	document->priv->priority_page = -1;
 }
 
 static void
@@ -204,6 +329,26 @@ ev_document_class_init (EvDocumentClass *klass)
 							       FALSE,
 							       G_PARAM_READWRITE |
 							       G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * EvDocument::cache-updated:
+	 * @document: the #EvDocument
+	 *
+	 * The sizes and labels of the pages of large documents are
+	 * retrieved in a thread after loading them. This signal is emitted,
+	 * in the main context, when the ones retrieved so far differ from
+	 * the estimated ones, so that the document layout can be updated.
+	 *
+	 * Since: 3.30
+	 */
+	signals[CACHE_UPDATED] =
+		g_signal_new ("cache-updated",
+			      EV_TYPE_DOCUMENT,
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 }
 
 /**
@@ -246,174 +391,1288 @@ ev_document_set_modified (EvDocument *document,
 	}
 }
 
+/* Called by the new owner of the mutex. The main thread is the one
+ * running the default main context. */
+static void
+ev_mutex_set_owner (EvMutexStats *stats)
+{
+	g_mutex_lock (&stats_mutex);
+	stats->locked_time = g_get_monotonic_time ();
+	stats->main_thread = g_main_context_is_owner (g_main_context_default ());
+	g_mutex_unlock (&stats_mutex);
+}
+
+static void
+ev_mutex_lock_counted (GMutex       *mutex,
+		       EvMutexStats *stats)
+{
+	gint64 start, wait;
+
+	g_atomic_int_inc (&stats->n_locked);
+	if (g_mutex_trylock (mutex)) {
+		ev_mutex_set_owner (stats);
+		return;
+	}
+
+	start = g_get_monotonic_time ();
+	g_mutex_lock (mutex);
+	wait = g_get_monotonic_time () - start;
+
+	g_mutex_lock (&stats_mutex);
+	stats->n_contended++;
+	stats->wait_total += wait;
+	stats->wait_max = MAX (stats->wait_max, wait);
+	g_mutex_unlock (&stats_mutex);
+
+	ev_mutex_set_owner (stats);
+}
+
+static gboolean
+ev_mutex_trylock_counted (GMutex       *mutex,
+			  EvMutexStats *stats)
+{
+	if (!g_mutex_trylock (mutex))
+		return FALSE;
+
+	g_atomic_int_inc (&stats->n_locked);
+	ev_mutex_set_owner (stats);
+
+	return TRUE;
+}
+
+static void
+ev_mutex_unlock_counted (GMutex       *mutex,
+			 EvMutexStats *stats)
+{
+	g_mutex_lock (&stats_mutex);
+	stats->locked_time = 0;
+	g_mutex_unlock (&stats_mutex);
+
+	g_mutex_unlock (mutex);
+}
+
+/**
+ * ev_document_doc_mutex_lock:
+ *
+ * Locks the global document mutex. Access to a document should be
+ * serialized with ev_document_lock() instead; the global mutex is
+ * only kept for backends whose underlying library has process-wide
+ * state that can not be used from several threads at the same time.
+ * Backends taking it must do so while the document lock is held
+ * and never the other way around.
+ */
 void
 ev_document_doc_mutex_lock (void)
 {
-	g_mutex_lock (&ev_doc_mutex);
+	ev_mutex_lock_counted (&ev_doc_mutex, &doc_mutex_stats);
 }
 
 void
 ev_document_doc_mutex_unlock (void)
 {
-	g_mutex_unlock (&ev_doc_mutex);
+	ev_mutex_unlock_counted (&ev_doc_mutex, &doc_mutex_stats);
 }
 
 gboolean
 ev_document_doc_mutex_trylock (void)
 {
-	return g_mutex_trylock (&ev_doc_mutex);
+	return ev_mutex_trylock_counted (&ev_doc_mutex, &doc_mutex_stats);
 }
 
 void
 ev_document_fc_mutex_lock (void)
 {
-	g_mutex_lock (&ev_fc_mutex);
+	ev_mutex_lock_counted (&ev_fc_mutex, &fc_mutex_stats);
 }
 
 void
 ev_document_fc_mutex_unlock (void)
 {
-	g_mutex_unlock (&ev_fc_mutex);
+	ev_mutex_unlock_counted (&ev_fc_mutex, &fc_mutex_stats);
 }
 
 gboolean
 ev_document_fc_mutex_trylock (void)
 {
-	return g_mutex_trylock (&ev_fc_mutex);
+	return ev_mutex_trylock_counted (&ev_fc_mutex, &fc_mutex_stats);
+}
+
+static GVariant *
+ev_mutex_stats_to_variant (EvMutexStats *stats)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "locked",
+			       g_variant_new_uint32 (g_atomic_int_get (&stats->n_locked)));
+	g_variant_builder_add (&builder, "{sv}", "contended", g_variant_new_uint32 (stats->n_contended));
+	g_variant_builder_add (&builder, "{sv}", "wait-total", g_variant_new_int64 (stats->wait_total));
+	g_variant_builder_add (&builder, "{sv}", "wait-max", g_variant_new_int64 (stats->wait_max));
+	g_variant_builder_add (&builder, "{sv}", "held",
+			       g_variant_new_int64 (stats->locked_time ?
+						    g_get_monotonic_time () - stats->locked_time : 0));
+	g_variant_builder_add (&builder, "{sv}", "held-by-main-thread",
+			       g_variant_new_boolean (stats->locked_time && stats->main_thread));
+
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * ev_document_get_mutex_stats:
+ *
+ * Returns how the global document mutex and the FontConfig mutex were
+ * used, as a dictionary with the keys "doc-mutex" and "fc-mutex". Each
+ * one is a dictionary with the number of times the mutex was "locked"
+ * and the number of times it was "contended", i.e. held by another
+ * thread, as uint32, and the "wait-total" and "wait-max" times spent
+ * waiting for it, in microseconds. "held" is how long the mutex has been
+ * held by its current owner, in microseconds, 0 if it's unlocked, and
+ * "held-by-main-thread" whether the owner is the thread running the
+ * default main context.
+ *
+ * Returns: (transfer full): a floating #GVariant of type a{sv}
+ *
+ * Since: 3.30
+ */
+GVariant *
+ev_document_get_mutex_stats (void)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+	g_mutex_lock (&stats_mutex);
+	g_variant_builder_add (&builder, "{sv}", "doc-mutex",
+			       ev_mutex_stats_to_variant (&doc_mutex_stats));
+	g_variant_builder_add (&builder, "{sv}", "fc-mutex",
+			       ev_mutex_stats_to_variant (&fc_mutex_stats));
+	g_mutex_unlock (&stats_mutex);
+
+	return g_variant_builder_end (&builder);
+}
+
+static gpointer
+ev_fc_warm_up_thread (gpointer data)
+{
+	cairo_surface_t     *surface;
+	cairo_t             *cr;
+	cairo_font_extents_t extents;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+	cr = cairo_create (surface);
+
+	/* Matching a font loads the FontConfig configuration and
+	 * scans the fonts, which is shared with the backends */
+	ev_document_fc_mutex_lock ();
+	cairo_select_font_face (cr, "sans-serif",
+				CAIRO_FONT_SLANT_NORMAL,
+				CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_font_extents (cr, &extents);
+	ev_document_fc_mutex_unlock ();
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+
+	ev_open_timings_mark ("fontconfig-ready");
+
+	return NULL;
+}
+
+/*
+ * _ev_document_warm_up_fontconfig:
+ *
+ * Initializes FontConfig in a thread, so that the first render of a
+ * document doesn't have to.
+ */
+void
+_ev_document_warm_up_fontconfig (void)
+{
+	GThread *thread;
+
+	thread = g_thread_try_new ("EvFcWarmUp", ev_fc_warm_up_thread, NULL, NULL);
+	if (thread)
+		g_thread_unref (thread);
+}
+
+/**
+ * ev_document_lock:
+ * @document: an #EvDocument
+ *
+ * Locks @document. Calls into the backend of @document that may run
+ * at the same time as jobs of the job scheduler must be done with
+ * the lock held. Unlike the global document mutex, this only
+ * serializes access to @document, so other documents are not blocked.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_lock (EvDocument *document)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	g_mutex_lock (&document->priv->mutex);
+	g_atomic_pointer_set (&document->priv->lock_owner, g_thread_self ());
+}
+
+/**
+ * ev_document_unlock:
+ * @document: an #EvDocument
+ *
+ * Unlocks @document, see ev_document_lock().
+ *
+ * Since: 3.30
+ */
+void
+ev_document_unlock (EvDocument *document)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	g_atomic_pointer_set (&document->priv->lock_owner, NULL);
+	g_mutex_unlock (&document->priv->mutex);
+}
+
+/**
+ * ev_document_trylock:
+ * @document: an #EvDocument
+ *
+ * Tries to lock @document without blocking, see ev_document_lock().
+ *
+ * Returns: %TRUE if @document was locked
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_trylock (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	if (!g_mutex_trylock (&document->priv->mutex))
+		return FALSE;
+
+	g_atomic_pointer_set (&document->priv->lock_owner, g_thread_self ());
+
+	return TRUE;
 }
 
+/**
+ * ev_document_is_locked:
+ * @document: an #EvDocument
+ *
+ * Tells whether the calling thread holds the lock of @document, for
+ * backends called both with the lock held and without it, like the
+ * renders of thread-safe backends.
+ *
+ * Returns: %TRUE if @document was locked by the calling thread
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_is_locked (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return g_atomic_pointer_get (&document->priv->lock_owner) == g_thread_self ();
+}
+
+/* Called with the cache mutex held, whenever the page labels change */
 static void
-ev_document_setup_cache (EvDocument *document)
+ev_document_clear_label_index (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	g_clear_pointer (&priv->label_index, g_hash_table_destroy);
+	g_clear_pointer (&priv->sorted_labels, g_free);
+	priv->n_sorted_labels = 0;
+}
+
+static gint
+compare_page_labels (gconstpointer a,
+		     gconstpointer b,
+		     gpointer      user_data)
+{
+	gchar **page_labels = user_data;
+	gint    page_a = *(const gint *)a;
+	gint    page_b = *(const gint *)b;
+	gint    retval;
+
+	retval = g_ascii_strcasecmp (page_labels[page_a], page_labels[page_b]);
+
+	return retval != 0 ? retval : page_a - page_b;
+}
+
+/* Called with the cache mutex held.
+ * The hash table maps every label to the first page using it, and the
+ * pages with a label are sorted case insensitively, lowest page first
+ * for equal labels, for case insensitive and prefix lookups.
+ */
+static void
+ev_document_ensure_label_index (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	gint               n_labels = 0;
+	gint               i;
+
+	if (priv->label_index || !priv->page_labels)
+		return;
+
+	priv->label_index = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->sorted_labels = g_new (gint, priv->n_pages);
+
+	for (i = 0; i < priv->n_pages; i++) {
+		if (priv->page_labels[i] == NULL)
+			continue;
+
+		if (!g_hash_table_contains (priv->label_index, priv->page_labels[i]))
+			g_hash_table_insert (priv->label_index,
+					     priv->page_labels[i],
+					     GINT_TO_POINTER (i));
+		priv->sorted_labels[n_labels++] = i;
+	}
+	priv->n_sorted_labels = n_labels;
+
+	g_qsort_with_data (priv->sorted_labels, n_labels, sizeof (gint),
+			   compare_page_labels, priv->page_labels);
+}
+
+/* Called with the cache mutex held. Returns the position in the sorted
+ * labels of the first label not lower than the first @len bytes of
+ * @label case insensitively, or all of it if @len is -1.
+ */
+static gint
+ev_document_label_index_lower_bound (EvDocument  *document,
+				     const gchar *label,
+				     gssize       len)
+{
+	EvDocumentPrivate *priv = document->priv;
+	gint               low = 0;
+	gint               high = priv->n_sorted_labels;
+
+	while (low < high) {
+		gint         mid = low + (high - low) / 2;
+		const gchar *mid_label = priv->page_labels[priv->sorted_labels[mid]];
+		gint         cmp;
+
+		if (len < 0)
+			cmp = g_ascii_strcasecmp (mid_label, label);
+		else
+			cmp = g_ascii_strncasecmp (mid_label, label, len);
+
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/* Called with the cache mutex held */
+static void
+ev_document_reset_cache (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	ev_document_clear_label_index (document);
+	g_clear_pointer (&priv->page_sizes, g_free);
+	g_clear_pointer (&priv->page_labels, g_strfreev);
+	priv->uniform = TRUE;
+	priv->uniform_width = priv->uniform_height = 0;
+	priv->max_width = priv->max_height = 0;
+	priv->min_width = priv->min_height = 0;
+	priv->max_label = 0;
+	priv->custom_page_labels = FALSE;
+	priv->n_probed_pages = 0;
+}
+
+/* Called with the cache mutex held, takes ownership of @page_label.
+ * Returns whether the page differs from the estimated one.
+ */
+static gboolean
+ev_document_cache_add_page (EvDocument *document,
+			    gint        i,
+			    gdouble     page_width,
+			    gdouble     page_height,
+			    gchar      *page_label)
 {
         EvDocumentPrivate *priv = document->priv;
-        gboolean custom_page_labels = FALSE;
-        gint i;
+        EvPageSize        *page_size;
+        gboolean           changed = FALSE;
+
+        if (i == 0) {
+                priv->uniform_width = page_width;
+                priv->uniform_height = page_height;
+                priv->max_width = priv->uniform_width;
+                priv->max_height = priv->uniform_height;
+                priv->min_width = priv->uniform_width;
+                priv->min_height = priv->uniform_height;
+        } else if (priv->uniform &&
+                   (priv->uniform_width != page_width ||
+                    priv->uniform_height != page_height)) {
+                /* It's a different page size.  Backfill the array,
+                 * pages not probed yet get the size of the first one.
+                 */
+                int j;
+
+                priv->page_sizes = g_new0 (EvPageSize, priv->n_pages);
+
+                for (j = 0; j < priv->n_pages; j++) {
+                        page_size = &(priv->page_sizes[j]);
+                        page_size->width = priv->uniform_width;
+                        page_size->height = priv->uniform_height;
+                }
+                priv->uniform = FALSE;
+        }
+        if (!priv->uniform) {
+                page_size = &(priv->page_sizes[i]);
+
+                changed = page_size->width != page_width ||
+                        page_size->height != page_height;
+
+                page_size->width = page_width;
+                page_size->height = page_height;
+
+                if (page_width > priv->max_width)
+                        priv->max_width = page_width;
+                if (page_width < priv->min_width)
+                        priv->min_width = page_width;
+
+                if (page_height > priv->max_height)
+                        priv->max_height = page_height;
+                if (page_height < priv->min_height)
+                        priv->min_height = page_height;
+        }
+
+        if (page_label) {
+                if (!priv->page_labels)
+                        priv->page_labels = g_new0 (gchar *, priv->n_pages + 1);
+
+                if (!priv->custom_page_labels) {
+                        gchar *real_page_label;
+
+                        real_page_label = g_strdup_printf ("%d", i + 1);
+                        priv->custom_page_labels = g_strcmp0 (real_page_label, page_label) != 0;
+                        changed |= priv->custom_page_labels;
+                        g_free (real_page_label);
+                }
+
+                ev_document_clear_label_index (document);
+                g_free (priv->page_labels[i]);
+                priv->page_labels[i] = page_label;
+                priv->max_label = MAX (priv->max_label,
+                                       g_utf8_strlen (page_label, 256));
+        }
+
+        return changed;
+}
+
+/* Called with the cache mutex held, once all pages are probed */
+static void
+ev_document_cache_finish (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	if (!priv->custom_page_labels) {
+		ev_document_clear_label_index (document);
+		g_clear_pointer (&priv->page_labels, g_strfreev);
+	}
+}
+
+static gchar *
+ev_document_get_cache_path (const gchar *uri)
+{
+	gchar *checksum;
+	gchar *filename;
+	gchar *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	filename = g_strconcat (checksum, ".pages", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "evince", "pages", filename, NULL);
+	g_free (filename);
+	g_free (checksum);
+
+	return path;
+}
+
+/* Adds the first, middle and last bytes of @stream to @sum, hashing
+ * the whole file could take as long as probing the pages.
+ */
+static gboolean
+ev_document_sample_stream (GInputStream *stream,
+			   guint64       size,
+			   GChecksum    *sum)
+{
+	guchar  *buffer;
+	guint64  offsets[3];
+	guint    n_offsets = 1;
+	guint    i;
+	gsize    n_read;
+	gboolean retval = TRUE;
+
+	offsets[0] = 0;
+	if (size > 3 * EV_CACHE_CHECKSUM_CHUNK) {
+		offsets[n_offsets++] = (size - EV_CACHE_CHECKSUM_CHUNK) / 2;
+		offsets[n_offsets++] = size - EV_CACHE_CHECKSUM_CHUNK;
+	}
+
+	buffer = g_malloc (EV_CACHE_CHECKSUM_CHUNK);
+	for (i = 0; i < n_offsets && retval; i++) {
+		retval = (i == 0 || g_seekable_seek (G_SEEKABLE (stream), offsets[i],
+						     G_SEEK_SET, NULL, NULL)) &&
+			g_input_stream_read_all (stream, buffer, EV_CACHE_CHECKSUM_CHUNK,
+						 &n_read, NULL, NULL);
+		if (retval)
+			g_checksum_update (sum, buffer, n_read);
+	}
+	g_free (buffer);
+
+	return retval;
+}
+
+/* Identifies the contents of the document file by its modification
+ * time, its size and a checksum of some of its bytes.
+ */
+static gboolean
+ev_document_get_file_stamp (const gchar *uri,
+			    guint64     *mtime,
+			    guint64     *size,
+			    gchar      **checksum)
+{
+	GFile            *file;
+	GFileInfo        *info;
+	GFileInputStream *stream;
+	GChecksum        *sum;
+	gboolean          retval = FALSE;
+
+	file = g_file_new_for_uri (uri);
+	if (!g_file_is_native (file)) {
+		g_object_unref (file);
+		return FALSE;
+	}
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (!info) {
+		g_object_unref (file);
+		return FALSE;
+	}
+
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	*size = g_file_info_get_size (info);
+	g_object_unref (info);
+
+	stream = g_file_read (file, NULL, NULL);
+	g_object_unref (file);
+	if (!stream)
+		return FALSE;
+
+	sum = g_checksum_new (G_CHECKSUM_SHA1);
+	if (ev_document_sample_stream (G_INPUT_STREAM (stream), *size, sum)) {
+		*checksum = g_strdup (g_checksum_get_string (sum));
+		retval = TRUE;
+	}
+	g_checksum_free (sum);
+	g_object_unref (stream);
+
+	return retval;
+}
+
+/* Called with the cache mutex held. The file is not trusted, the
+ * cache is only used if it has the expected number of items.
+ */
+static gboolean
+ev_document_load_cache (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	GVariant          *variant;
+	GVariant          *sizes;
+	GVariant          *labels;
+	GBytes            *bytes;
+	gchar             *path;
+	gchar             *contents;
+	gchar             *checksum;
+	const gchar       *saved_checksum;
+	gsize              length;
+	guint64            mtime, size;
+	guint64            saved_mtime, saved_size;
+	guint32            version, n_pages;
+	gboolean           uniform;
+	gboolean           valid;
+	gint               i;
+
+	if (!priv->uri || !ev_document_get_file_stamp (priv->uri, &mtime, &size, &checksum))
+		return FALSE;
+
+	path = ev_document_get_cache_path (priv->uri);
+	if (!g_file_get_contents (path, &contents, &length, NULL)) {
+		g_free (path);
+		g_free (checksum);
+		return FALSE;
+	}
+	g_free (path);
+
+	bytes = g_bytes_new_take (contents, length);
+	variant = g_variant_new_from_bytes (G_VARIANT_TYPE (EV_CACHE_FILE_FORMAT), bytes, FALSE);
+	g_bytes_unref (bytes);
+
+	g_variant_get (variant, "(utt&su(dddd)b@a(dd)@as)",
+		       &version, &saved_mtime, &saved_size, &saved_checksum, &n_pages,
+		       &priv->min_width, &priv->min_height,
+		       &priv->max_width, &priv->max_height,
+		       &uniform, &sizes, &labels);
+
+	valid = version == EV_CACHE_FILE_VERSION &&
+		saved_mtime == mtime && saved_size == size &&
+		strcmp (saved_checksum, checksum) == 0 &&
+		n_pages == (guint32) priv->n_pages &&
+		g_variant_n_children (sizes) == (uniform ? 1 : n_pages) &&
+		(g_variant_n_children (labels) == 0 || g_variant_n_children (labels) == n_pages);
+	g_free (checksum);
+
+	if (!valid) {
+		g_variant_unref (sizes);
+		g_variant_unref (labels);
+		g_variant_unref (variant);
+		ev_document_reset_cache (document);
+
+		return FALSE;
+	}
+
+	priv->uniform = uniform;
+	if (uniform) {
+		g_variant_get_child (sizes, 0, "(dd)", &priv->uniform_width, &priv->uniform_height);
+	} else {
+		priv->page_sizes = g_new (EvPageSize, n_pages);
+		for (i = 0; i < n_pages; i++) {
+			g_variant_get_child (sizes, i, "(dd)",
+					     &priv->page_sizes[i].width,
+					     &priv->page_sizes[i].height);
+		}
+		priv->uniform_width = priv->page_sizes[0].width;
+		priv->uniform_height = priv->page_sizes[0].height;
+	}
+
+	if (g_variant_n_children (labels) > 0) {
+		ev_document_clear_label_index (document);
+		priv->page_labels = g_new0 (gchar *, n_pages + 1);
+		for (i = 0; i < n_pages; i++) {
+			const gchar *label;
+
+			g_variant_get_child (labels, i, "&s", &label);
+			if (*label == '\0')
+				continue;
+
+			priv->page_labels[i] = g_strdup (label);
+			priv->max_label = MAX (priv->max_label, g_utf8_strlen (label, 256));
+		}
+		priv->custom_page_labels = TRUE;
+	}
+	priv->n_probed_pages = n_pages;
+
+	g_variant_unref (sizes);
+	g_variant_unref (labels);
+	g_variant_unref (variant);
+
+	return TRUE;
+}
+
+static void
+ev_document_save_cache (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	GVariantBuilder    sizes;
+	GVariantBuilder    labels;
+	GVariant          *variant;
+	gchar             *path;
+	gchar             *dir;
+	gchar             *checksum;
+	guint64            mtime, size;
+	gint               i;
+
+	if (!priv->uri || priv->n_pages < EV_CACHE_PERSIST_MIN_PAGES)
+		return;
+
+	if (!ev_document_get_file_stamp (priv->uri, &mtime, &size, &checksum))
+		return;
+
+	g_mutex_lock (&priv->cache_mutex);
+	g_variant_builder_init (&sizes, G_VARIANT_TYPE ("a(dd)"));
+	if (priv->uniform) {
+		g_variant_builder_add (&sizes, "(dd)", priv->uniform_width, priv->uniform_height);
+	} else {
+		for (i = 0; i < priv->n_pages; i++) {
+			g_variant_builder_add (&sizes, "(dd)",
+					       priv->page_sizes[i].width,
+					       priv->page_sizes[i].height);
+		}
+	}
+
+	g_variant_builder_init (&labels, G_VARIANT_TYPE ("as"));
+	for (i = 0; priv->page_labels && i < priv->n_pages; i++)
+		g_variant_builder_add (&labels, "s", priv->page_labels[i] ? priv->page_labels[i] : "");
+
+	variant = g_variant_new (EV_CACHE_FILE_FORMAT,
+				 EV_CACHE_FILE_VERSION, mtime, size, checksum,
+				 priv->n_pages,
+				 priv->min_width, priv->min_height,
+				 priv->max_width, priv->max_height,
+				 priv->uniform, &sizes, &labels);
+	g_variant_ref_sink (variant);
+	g_mutex_unlock (&priv->cache_mutex);
+	g_free (checksum);
+
+	path = ev_document_get_cache_path (priv->uri);
+	dir = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dir, 0700) == 0)
+		g_file_set_contents (path, g_variant_get_data (variant),
+				     g_variant_get_size (variant), NULL);
+
+	g_free (dir);
+	g_free (path);
+	g_variant_unref (variant);
+}
+
+static gboolean
+ev_document_emit_cache_updated (EvDocument *document)
+{
+	g_atomic_int_set (&document->priv->cache_updated_pending, 0);
+	g_signal_emit (document, signals[CACHE_UPDATED], 0);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Probes the pages from @first to @last and adds them to the cache.
+ * Pages probed in order extend the range of probed pages, the others
+ * are probed again when it's reached. Returns %FALSE when the document
+ * is being loaded again.
+ */
+static gboolean
+ev_document_probe_pages (EvCacheProbe *probe,
+			 gint          first,
+			 gint          last,
+			 gboolean      in_order)
+{
+	EvDocument        *document = probe->document;
+	EvDocumentPrivate *priv = document->priv;
+	EvPageSize         sizes[EV_CACHE_BATCH_PAGES];
+	gchar             *labels[EV_CACHE_BATCH_PAGES];
+	gboolean           changed = FALSE;
+	gint64             trace;
+	gint               i;
+
+	g_assert (last - first <= EV_CACHE_BATCH_PAGES);
+
+	/* Release the document between batches, for the pages to
+	 * be rendered meanwhile.
+	 */
+	ev_document_lock (document);
+	g_mutex_lock (&priv->probe_mutex);
+	if (g_atomic_int_get (&priv->cache_generation) != probe->generation) {
+		g_mutex_unlock (&priv->probe_mutex);
+		ev_document_unlock (document);
+		return FALSE;
+	}
+
+	trace = ev_trace_begin ();
+	for (i = first; i < last; i++) {
+		EvPage *page = ev_document_get_page (document, i);
+
+		sizes[i - first].width = sizes[i - first].height = 0;
+		_ev_document_get_page_size (document, page,
+					    &sizes[i - first].width,
+					    &sizes[i - first].height);
+		labels[i - first] = _ev_document_get_page_label (document, page);
+		g_object_unref (page);
+	}
+	ev_trace_end (trace, "setup-cache", "probe-pages", first);
+	g_mutex_unlock (&priv->probe_mutex);
+	ev_document_unlock (document);
+
+	g_mutex_lock (&priv->cache_mutex);
+	if (g_atomic_int_get (&priv->cache_generation) != probe->generation) {
+		g_mutex_unlock (&priv->cache_mutex);
+		for (i = first; i < last; i++)
+			g_free (labels[i - first]);
+		return FALSE;
+	}
+
+	for (i = first; i < last; i++) {
+		changed |= ev_document_cache_add_page (document, i,
+						       sizes[i - first].width,
+						       sizes[i - first].height,
+						       labels[i - first]);
+	}
+	if (in_order) {
+		priv->n_probed_pages = last;
+		if (last == priv->n_pages)
+			ev_document_cache_finish (document);
+	}
+	g_mutex_unlock (&priv->cache_mutex);
+
+	if (in_order && last == priv->n_pages)
+		ev_document_save_cache (document);
+
+	if (changed && g_atomic_int_compare_and_exchange (&priv->cache_updated_pending, 0, 1)) {
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				 (GSourceFunc)ev_document_emit_cache_updated,
+				 g_object_ref (document),
+				 (GDestroyNotify)g_object_unref);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+ev_document_unref_idle (EvDocument *document)
+{
+	g_object_unref (document);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer
+ev_document_probe_pages_thread (EvCacheProbe *probe)
+{
+	EvDocument        *document = probe->document;
+	EvDocumentPrivate *priv = document->priv;
+	gint               first = priv->n_probed_pages;
+
+	while (first < priv->n_pages) {
+		gint priority_page;
+		gint last;
+
+		/* Nobody else is using the document anymore */
+		if (g_atomic_int_get (&G_OBJECT (document)->ref_count) == 1)
+			break;
+
+		priority_page = g_atomic_int_get (&priv->priority_page);
+		if (priority_page != -1 &&
+		    g_atomic_int_compare_and_exchange (&priv->priority_page, priority_page, -1) &&
+		    priority_page >= first + EV_CACHE_BATCH_PAGES) {
+			last = MIN (priority_page + EV_CACHE_PRIORITY_PAGES, priv->n_pages);
+			if (!ev_document_probe_pages (probe, priority_page, last, FALSE))
+				break;
+			continue;
+		}
+
+		last = MIN (first + EV_CACHE_BATCH_PAGES, priv->n_pages);
+		if (!ev_document_probe_pages (probe, first, last, TRUE))
+			break;
+
+		first = last;
+	}
+
+	/* This may be the last reference, finalize the document
+	 * in the main context, like the other objects of the view */
+	g_idle_add ((GSourceFunc)ev_document_unref_idle, probe->document);
+	g_slice_free (EvCacheProbe, probe);
+
+	return NULL;
+}
+
+/* Stops the thread probing the pages of the document, if any. It
+ * must not use the backend while the document is being loaded again.
+ */
+static void
+ev_document_stop_probing_pages (EvDocument *document)
+{
+	g_atomic_int_inc (&document->priv->cache_generation);
+
+	/* Wait for the current batch */
+	g_mutex_lock (&document->priv->probe_mutex);
+	g_mutex_unlock (&document->priv->probe_mutex);
+
+	/* Pages of the previous load, if any */
+	ev_document_clear_page_pool (document);
+}
+
+/* Returns FALSE when the load was cancelled before the cache was filled */
+static gboolean
+ev_document_fill_cache (EvDocument *document,
+			gboolean    incremental)
+{
+        EvDocumentPrivate *priv = document->priv;
+        EvCacheProbe      *probe;
+        gint               n_sync_pages;
+        gint               i;
 
         /* Cache some info about the document to avoid
          * going to the backends since it requires locks
          */
 	priv->cache_loaded = TRUE;
 
-        for (i = 0; i < priv->n_pages; i++) {
-                EvPage     *page = ev_document_get_page (document, i);
+	g_mutex_lock (&priv->cache_mutex);
+	ev_document_reset_cache (document);
+	if (incremental && priv->n_pages >= EV_CACHE_PERSIST_MIN_PAGES &&
+	    ev_document_load_cache (document)) {
+		g_mutex_unlock (&priv->cache_mutex);
+		return TRUE;
+	}
+	g_mutex_unlock (&priv->cache_mutex);
+
+	n_sync_pages = priv->n_pages;
+	if (incremental && priv->n_pages > EV_CACHE_INCREMENTAL_MIN_PAGES)
+		n_sync_pages = EV_CACHE_SYNC_PAGES;
+
+        for (i = 0; i < n_sync_pages; i++) {
+                EvPage     *page;
                 gdouble     page_width = 0;
                 gdouble     page_height = 0;
-                EvPageSize *page_size;
                 gchar      *page_label;
 
+		if (g_cancellable_is_cancelled (priv->load_cancellable)) {
+			g_mutex_lock (&priv->cache_mutex);
+			ev_document_reset_cache (document);
+			g_mutex_unlock (&priv->cache_mutex);
+			priv->cache_loaded = FALSE;
+			return FALSE;
+		}
+		ev_document_set_load_progress (document, (gdouble) i / n_sync_pages);
+
+                page = ev_document_get_page (document, i);
+
                 _ev_document_get_page_size (document, page, &page_width, &page_height);
+                page_label = _ev_document_get_page_label (document, page);
 
-                if (i == 0) {
-                        priv->uniform_width = page_width;
-                        priv->uniform_height = page_height;
-                        priv->max_width = priv->uniform_width;
-                        priv->max_height = priv->uniform_height;
-                        priv->min_width = priv->uniform_width;
-                        priv->min_height = priv->uniform_height;
-                } else if (priv->uniform &&
-                            (priv->uniform_width != page_width ||
-                            priv->uniform_height != page_height)) {
-                        /* It's a different page size.  Backfill the array. */
-                        int j;
-
-                        priv->page_sizes = g_new0 (EvPageSize, priv->n_pages);
-
-                        for (j = 0; j < i; j++) {
-                                page_size = &(priv->page_sizes[j]);
-                                page_size->width = priv->uniform_width;
-                                page_size->height = priv->uniform_height;
-                        }
-                        priv->uniform = FALSE;
-                }
-                if (!priv->uniform) {
-                        page_size = &(priv->page_sizes[i]);
+                g_mutex_lock (&priv->cache_mutex);
+                ev_document_cache_add_page (document, i, page_width, page_height, page_label);
+                g_mutex_unlock (&priv->cache_mutex);
 
-                        page_size->width = page_width;
-                        page_size->height = page_height;
+                g_object_unref (page);
+        }
 
-                        if (page_width > priv->max_width)
-                                priv->max_width = page_width;
-                        if (page_width < priv->min_width)
-                                priv->min_width = page_width;
+	g_mutex_lock (&priv->cache_mutex);
+	priv->n_probed_pages = n_sync_pages;
+	if (n_sync_pages == priv->n_pages)
+		ev_document_cache_finish (document);
+	g_mutex_unlock (&priv->cache_mutex);
 
-                        if (page_height > priv->max_height)
-                                priv->max_height = page_height;
-                        if (page_height < priv->min_height)
-                                priv->min_height = page_height;
-                }
+	if (n_sync_pages == priv->n_pages) {
+		if (incremental)
+			ev_document_save_cache (document);
+		return TRUE;
+	}
 
-                page_label = _ev_document_get_page_label (document, page);
-                if (page_label) {
-                        if (!priv->page_labels)
-                                priv->page_labels = g_new0 (gchar *, priv->n_pages + 1);
+	probe = g_slice_new (EvCacheProbe);
+	probe->document = g_object_ref (document);
+	probe->generation = g_atomic_int_get (&priv->cache_generation);
+	g_thread_unref (g_thread_new ("EvDocumentCache",
+				      (GThreadFunc)ev_document_probe_pages_thread,
+				      probe));
 
-                        if (!custom_page_labels) {
-                                gchar *real_page_label;
+	return TRUE;
+}
 
-                                real_page_label = g_strdup_printf ("%d", i + 1);
-                                custom_page_labels = g_strcmp0 (real_page_label, page_label) != 0;
-                                g_free (real_page_label);
-                        }
+static gboolean
+ev_document_setup_cache (EvDocument *document,
+			 gboolean    incremental)
+{
+	gint64   trace = ev_trace_begin ();
+	gboolean retval;
 
-                        priv->page_labels[i] = page_label;
-                        priv->max_label = MAX (priv->max_label,
-                                                g_utf8_strlen (page_label, 256));
-                }
+	retval = ev_document_fill_cache (document, incremental);
+	ev_trace_end (trace, "setup-cache", G_OBJECT_TYPE_NAME (document), -1);
 
-                g_object_unref (page);
-        }
+	return retval;
+}
 
-	if (!custom_page_labels)
-		g_clear_pointer (&priv->page_labels, g_strfreev);
+typedef struct {
+	EvDocument     *document;
+	gchar          *filename;
+	gint            n_pages;
+	gint            generation;
+	EvSynctexIndex *previous;
+} EvSynctexIndexing;
+
+static gpointer
+ev_document_index_synctex_thread (EvSynctexIndexing *indexing)
+{
+	EvDocumentPrivate *priv = indexing->document->priv;
+	EvSynctexIndex    *index;
+
+	index = ev_synctex_index_new (indexing->filename, indexing->n_pages,
+				      indexing->previous);
+	if (indexing->previous)
+		ev_synctex_index_free (indexing->previous);
+
+	g_mutex_lock (&priv->synctex_mutex);
+	if (priv->synctex_generation == indexing->generation) {
+		priv->synctex_index = index;
+		priv->synctex_indexing = FALSE;
+		g_cond_broadcast (&priv->synctex_cond);
+	} else if (index) {
+		ev_synctex_index_free (index);
+	}
+	g_mutex_unlock (&priv->synctex_mutex);
+
+	g_object_unref (indexing->document);
+	g_free (indexing->filename);
+	g_slice_free (EvSynctexIndexing, indexing);
+
+	return NULL;
 }
 
+/* Parsing the synctex file of a large document takes long, so it's not
+ * done while loading: the file is only looked for, and the index used
+ * by the searches is built from a thread, or read from the user cache.
+ * Searches wait for it. On reload, the previous index is given to the
+ * thread so that the pages that didn't change aren't parsed again.
+ */
 static void
 ev_document_initialize_synctex (EvDocument  *document,
 				const gchar *uri)
 {
 	EvDocumentPrivate *priv = document->priv;
+	EvSynctexIndexing *indexing;
+	EvSynctexIndex    *previous;
+	gchar             *filename = NULL;
+	gchar             *synctex = NULL;
+
+	g_mutex_lock (&priv->synctex_mutex);
+	priv->synctex_generation++;
+	priv->synctex_indexing = FALSE;
+	priv->has_synctex = FALSE;
+	previous = priv->synctex_index;
+	priv->synctex_index = NULL;
+	g_cond_broadcast (&priv->synctex_cond);
+	g_mutex_unlock (&priv->synctex_mutex);
+
+	if (_ev_document_support_synctex (document))
+		filename = g_filename_from_uri (uri, NULL, NULL);
+	if (filename)
+		synctex = ev_synctex_index_find_file (filename);
+	if (!synctex) {
+		g_free (filename);
+		if (previous)
+			ev_synctex_index_free (previous);
+		return;
+	}
+	g_free (synctex);
 
-	if (_ev_document_support_synctex (document)) {
-		gchar *filename;
+	indexing = g_slice_new (EvSynctexIndexing);
+	indexing->document = g_object_ref (document);
+	indexing->filename = filename;
+	indexing->n_pages = priv->n_pages;
+	indexing->previous = previous;
 
-		filename = g_filename_from_uri (uri, NULL, NULL);
-		if (filename != NULL) {
-			priv->synctex_scanner =
-				synctex_scanner_new_with_output_file (filename, NULL, 1);
-			g_free (filename);
+	g_mutex_lock (&priv->synctex_mutex);
+	priv->has_synctex = TRUE;
+	priv->synctex_indexing = TRUE;
+	indexing->generation = priv->synctex_generation;
+	g_mutex_unlock (&priv->synctex_mutex);
+
+	g_thread_unref (g_thread_new ("EvDocumentSynctex",
+				      (GThreadFunc)ev_document_index_synctex_thread,
+				      indexing));
+}
+
+/* Returns the synctex index with the synctex mutex held, waiting for
+ * it to be built if needed.
+ */
+static EvSynctexIndex *
+ev_document_lock_synctex_index (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	g_mutex_lock (&priv->synctex_mutex);
+	while (priv->synctex_indexing)
+		g_cond_wait (&priv->synctex_cond, &priv->synctex_mutex);
+
+	return priv->synctex_index;
+}
+
+/* Called from the loading thread, reads the document file at most for
+ * the backends that can't identify their documents.
+ */
+static void
+ev_document_setup_fingerprint (EvDocument *document,
+			       GFile      *file)
+{
+	EvDocumentClass   *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentPrivate *priv = document->priv;
+	GChecksum         *sum;
+	gchar             *id = NULL;
+	gboolean           valid = FALSE;
+
+	g_clear_pointer (&priv->fingerprint, g_free);
+
+	sum = g_checksum_new (G_CHECKSUM_SHA1);
+	g_checksum_update (sum, (const guchar *) G_OBJECT_TYPE_NAME (document), -1);
+
+	if (klass->get_fingerprint)
+		id = klass->get_fingerprint (document);
+
+	if (id) {
+		g_checksum_update (sum, (const guchar *) "\n", 1);
+		g_checksum_update (sum, (const guchar *) id, -1);
+		g_free (id);
+		valid = TRUE;
+	} else if (file && g_file_is_native (file)) {
+		GFileInputStream *stream;
+		gchar            *size;
+
+		stream = g_file_read (file, NULL, NULL);
+		if (stream) {
+			size = g_strdup_printf ("\n%" G_GUINT64_FORMAT "\n", priv->file_size);
+			g_checksum_update (sum, (const guchar *) size, -1);
+			g_free (size);
+
+			valid = ev_document_sample_stream (G_INPUT_STREAM (stream),
+							   priv->file_size, sum);
+			g_object_unref (stream);
 		}
 	}
+
+	if (valid)
+		priv->fingerprint = g_strdup (g_checksum_get_string (sum));
+	g_checksum_free (sum);
+}
+
+/* The load starts with the backend parsing the document, then the
+ * first pages are probed to fill the cache */
+#define EV_LOAD_PROGRESS_BACKEND 0.8
+
+static void
+ev_document_begin_load (EvDocument                 *document,
+			GCancellable               *cancellable,
+			EvDocumentLoadProgressFunc  progress_func,
+			gpointer                    user_data)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	priv->load_cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	priv->load_progress_func = progress_func;
+	priv->load_progress_data = user_data;
+	priv->load_progress_reported = -1;
+}
+
+static void
+ev_document_end_load (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	g_clear_object (&priv->load_cancellable);
+	priv->load_progress_func = NULL;
+	priv->load_progress_data = NULL;
+}
+
+/* Makes the following progress reports go from start to end of the
+ * whole load */
+static void
+ev_document_load_phase (EvDocument *document,
+			gdouble     start,
+			gdouble     end)
+{
+	document->priv->load_progress_start = start;
+	document->priv->load_progress_end = end;
+	ev_document_set_load_progress (document, 0);
 }
 
 /**
- * ev_document_load_full:
+ * ev_document_get_load_cancellable:
+ * @document: a #EvDocument
+ *
+ * Gets the #GCancellable of the load of @document in progress, for
+ * backends to check between the pages of their long loops, and give up
+ * with %G_IO_ERROR_CANCELLED when it's cancelled.
+ *
+ * Returns: (transfer none) (allow-none): a #GCancellable, or %NULL
+ *
+ * Since: 3.30
+ */
+GCancellable *
+ev_document_get_load_cancellable (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	return document->priv->load_cancellable;
+}
+
+/**
+ * ev_document_set_load_progress:
+ * @document: a #EvDocument
+ * @fraction: the fraction of the work done, between 0 and 1
+ *
+ * Reports the progress of backends while they load @document, to be
+ * shown to the user. Does nothing when no one is interested.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_set_load_progress (EvDocument *document,
+			       gdouble     fraction)
+{
+	EvDocumentPrivate *priv;
+	gdouble            progress;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	priv = document->priv;
+	if (!priv->load_progress_func)
+		return;
+
+	progress = priv->load_progress_start +
+		CLAMP (fraction, 0, 1) * (priv->load_progress_end - priv->load_progress_start);
+
+	/* Per page loops report far more often than anyone can see */
+	if (progress < priv->load_progress_reported + 0.01 && progress < 1)
+		return;
+
+	priv->load_progress_reported = progress;
+	priv->load_progress_func (progress, priv->load_progress_data);
+}
+
+/**
+ * ev_document_load_with_progress:
  * @document: a #EvDocument
  * @uri: the document's URI
  * @flags: flags from #EvDocumentLoadFlags
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @progress_func: (scope call) (allow-none): function called with the
+ *   fraction of the load that has been done, or %NULL
+ * @user_data: data to pass to @progress_func
  * @error: a #GError location to store an error, or %NULL
  *
- * Loads @document from @uri.
- * 
- * On failure, %FALSE is returned and @error is filled in.
- * If the document is encrypted, EV_DEFINE_ERROR_ENCRYPTED is returned.
- * If the backend cannot load the specific document, EV_DOCUMENT_ERROR_INVALID
- * is returned. Other errors are possible too, depending on the backend
- * used to load the document and the URI, e.g. #GIOError, #GFileError, and
- * #GConvertError.
+ * Loads @document from @uri like ev_document_load_full(), but gives up
+ * with %G_IO_ERROR_CANCELLED as soon as possible when @cancellable is
+ * cancelled. @cancellable is checked between the phases of the load and
+ * in the loops over the pages of the document. @progress_func is called
+ * from the thread loading the document.
  *
  * Returns: %TRUE on success, or %FALSE on failure.
+ *
+ * Since: 3.30
  */
 gboolean
-ev_document_load_full (EvDocument           *document,
-		       const char           *uri,
-		       EvDocumentLoadFlags   flags,
-		       GError              **error)
+ev_document_load_with_progress (EvDocument                 *document,
+				const char                 *uri,
+				EvDocumentLoadFlags         flags,
+				GCancellable               *cancellable,
+				EvDocumentLoadProgressFunc  progress_func,
+				gpointer                    user_data,
+				GError                    **error)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
 	gboolean retval;
 	GError *err = NULL;
+	GFile *file;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	ev_document_stop_probing_pages (document);
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	ev_document_begin_load (document, cancellable, progress_func, user_data);
+	ev_document_load_phase (document, 0, EV_LOAD_PROGRESS_BACKEND);
 
 	retval = klass->load (document, uri, &err);
+	if (retval && g_cancellable_set_error_if_cancelled (cancellable, &err))
+		retval = FALSE;
+
 	if (!retval) {
 		if (err) {
 			g_propagate_error (error, err);
@@ -428,18 +1687,61 @@ ev_document_load_full (EvDocument           *document,
 					     "Internal error in backend");
 		}
 	} else {
+		ev_open_timings_mark ("document-load");
 		document->priv->info = _ev_document_get_info (document);
 		document->priv->n_pages = _ev_document_get_n_pages (document);
-		if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-			ev_document_setup_cache (document);
+		g_free (document->priv->uri);
 		document->priv->uri = g_strdup (uri);
 		document->priv->file_size = _ev_document_get_size (uri);
-		ev_document_initialize_synctex (document, uri);
+		file = g_file_new_for_uri (uri);
+		ev_document_setup_fingerprint (document, file);
+		g_object_unref (file);
+		ev_document_load_phase (document, EV_LOAD_PROGRESS_BACKEND, 1);
+		if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE)) {
+			retval = ev_document_setup_cache (document, TRUE);
+			ev_open_timings_mark ("document-cache");
+		}
+		if (retval) {
+			ev_document_initialize_synctex (document, uri);
+			ev_document_set_load_progress (document, 1);
+		} else {
+			g_cancellable_set_error_if_cancelled (cancellable, error);
+		}
         }
 
+	ev_document_end_load (document);
+
 	return retval;
 }
 
+/**
+ * ev_document_load_full:
+ * @document: a #EvDocument
+ * @uri: the document's URI
+ * @flags: flags from #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Loads @document from @uri.
+ * 
+ * On failure, %FALSE is returned and @error is filled in.
+ * If the document is encrypted, EV_DEFINE_ERROR_ENCRYPTED is returned.
+ * If the backend cannot load the specific document, EV_DOCUMENT_ERROR_INVALID
+ * is returned. Other errors are possible too, depending on the backend
+ * used to load the document and the URI, e.g. #GIOError, #GFileError, and
+ * #GConvertError.
+ *
+ * Returns: %TRUE on success, or %FALSE on failure.
+ */
+gboolean
+ev_document_load_full (EvDocument           *document,
+		       const char           *uri,
+		       EvDocumentLoadFlags   flags,
+		       GError              **error)
+{
+	return ev_document_load_with_progress (document, uri, flags,
+					       NULL, NULL, NULL, error);
+}
+
 /**
  * ev_document_load:
  * @document: a #EvDocument
@@ -489,6 +1791,7 @@ ev_document_load_stream (EvDocument         *document,
                          GError            **error)
 {
         EvDocumentClass *klass;
+        gboolean         retval;
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
         g_return_val_if_fail (G_IS_INPUT_STREAM (stream), FALSE);
@@ -502,16 +1805,26 @@ ev_document_load_stream (EvDocument         *document,
                 return FALSE;
         }
 
+        ev_document_stop_probing_pages (document);
+
         if (!klass->load_stream (document, stream, flags, cancellable, error))
                 return FALSE;
 
 	document->priv->info = _ev_document_get_info (document);
 	document->priv->n_pages = _ev_document_get_n_pages (document);
+	ev_document_setup_fingerprint (document, NULL);
 
-        if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-                ev_document_setup_cache (document);
+        if (flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE)
+                return TRUE;
 
-        return TRUE;
+        ev_document_begin_load (document, cancellable, NULL, NULL);
+        retval = ev_document_setup_cache (document, TRUE);
+        ev_document_end_load (document);
+
+        if (!retval)
+                g_cancellable_set_error_if_cancelled (cancellable, error);
+
+        return retval;
 }
 
 /**
@@ -537,6 +1850,7 @@ ev_document_load_gfile (EvDocument         *document,
                         GError            **error)
 {
         EvDocumentClass *klass;
+        gboolean         retval;
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
         g_return_val_if_fail (G_IS_FILE (file), FALSE);
@@ -550,17 +1864,32 @@ ev_document_load_gfile (EvDocument         *document,
                 return FALSE;
         }
 
+        ev_document_stop_probing_pages (document);
+
         if (!klass->load_gfile (document, file, flags, cancellable, error))
                 return FALSE;
+	ev_open_timings_mark ("document-load");
 
 	document->priv->info = _ev_document_get_info (document);
 	document->priv->n_pages = _ev_document_get_n_pages (document);
 
-        if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
-                ev_document_setup_cache (document);
-
+	g_free (document->priv->uri);
 	document->priv->uri = g_file_get_uri (file);
 	document->priv->file_size = _ev_document_get_size_gfile (file);
+	ev_document_setup_fingerprint (document, file);
+
+        if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE)) {
+                ev_document_begin_load (document, cancellable, NULL, NULL);
+                retval = ev_document_setup_cache (document, TRUE);
+                ev_document_end_load (document);
+                ev_open_timings_mark ("document-cache");
+
+                if (!retval) {
+                        g_cancellable_set_error_if_cancelled (cancellable, error);
+                        return FALSE;
+                }
+        }
+
 	ev_document_initialize_synctex (document, document->priv->uri);
 
         return TRUE;
@@ -586,20 +1915,126 @@ ev_document_save (EvDocument  *document,
 	return klass->save (document, uri, error);
 }
 
+/**
+ * ev_document_save_incremental:
+ * @document: a #EvDocument
+ * @uri: the URI @document was loaded from
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Saves the changes made to @document by appending them to the
+ * file at @uri, instead of writing the whole document again. Fails
+ * with %G_IO_ERROR_NOT_SUPPORTED when the backend can't do it, or
+ * can't do it for @uri, and then ev_document_save() should be used.
+ *
+ * Returns: %TRUE on success, or %FALSE on error with @error filled in
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_save_incremental (EvDocument  *document,
+			      const char  *uri,
+			      GError     **error)
+{
+	EvDocumentClass *klass;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	g_return_val_if_fail (uri != NULL, FALSE);
+
+	klass = EV_DOCUMENT_GET_CLASS (document);
+	if (!klass->save_incremental) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Backend does not support incremental saving");
+		return FALSE;
+	}
+
+	return klass->save_incremental (document, uri, error);
+}
+
+static void
+ev_document_clear_page_pool (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	guint              i;
+
+	g_mutex_lock (&priv->page_pool_mutex);
+	for (i = 0; i < priv->page_pool_len; i++)
+		g_clear_object (&priv->page_pool[i]);
+	priv->page_pool_len = 0;
+	g_mutex_unlock (&priv->page_pool_mutex);
+}
+
+/* Called with the page pool mutex held */
+static EvPage *
+ev_document_lookup_page_pool (EvDocument *document,
+			      gint        index)
+{
+	EvDocumentPrivate *priv = document->priv;
+	EvPage            *page;
+	guint              i;
+
+	for (i = 0; i < priv->page_pool_len; i++) {
+		if (priv->page_pool[i]->index == index)
+			break;
+	}
+	if (i == priv->page_pool_len)
+		return NULL;
+
+	page = priv->page_pool[i];
+	memmove (priv->page_pool + 1, priv->page_pool, i * sizeof (EvPage *));
+	priv->page_pool[0] = page;
+
+	return g_object_ref (page);
+}
+
 /**
  * ev_document_get_page:
  * @document: a #EvDocument
  * @index: index of page
  *
- * Returns: (transfer full): Newly created #EvPage for the given index.
+ * Returns: (transfer full): the #EvPage for the given index. Pages are
+ * shared with other callers and must not be modified.
  */
 EvPage *
 ev_document_get_page (EvDocument *document,
 		      gint        index)
 {
-	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentClass   *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentPrivate *priv = document->priv;
+	EvPage            *page;
+	EvPage            *pooled;
+	EvPage            *evicted = NULL;
+
+	g_mutex_lock (&priv->page_pool_mutex);
+	page = ev_document_lookup_page_pool (document, index);
+	g_mutex_unlock (&priv->page_pool_mutex);
+	if (page)
+		return page;
+
+	page = klass->get_page (document, index);
+	if (!page)
+		return NULL;
 
-	return klass->get_page (document, index);
+	g_mutex_lock (&priv->page_pool_mutex);
+	/* Another thread could have added it in the meantime */
+	pooled = ev_document_lookup_page_pool (document, index);
+	if (!pooled) {
+		if (priv->page_pool_len == EV_PAGE_POOL_SIZE)
+			evicted = priv->page_pool[--priv->page_pool_len];
+		memmove (priv->page_pool + 1, priv->page_pool,
+			 priv->page_pool_len * sizeof (EvPage *));
+		priv->page_pool[0] = g_object_ref (page);
+		priv->page_pool_len++;
+	}
+	g_mutex_unlock (&priv->page_pool_mutex);
+
+	if (evicted)
+		g_object_unref (evicted);
+	if (pooled) {
+		g_object_unref (page);
+		page = pooled;
+	}
+
+	return page;
 }
 
 static gboolean
@@ -613,9 +2048,15 @@ _ev_document_support_synctex (EvDocument *document)
 gboolean
 ev_document_has_synctex (EvDocument *document)
 {
+	gboolean retval;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
-	return document->priv->synctex_scanner != NULL;
+	g_mutex_lock (&document->priv->synctex_mutex);
+	retval = document->priv->has_synctex;
+	g_mutex_unlock (&document->priv->synctex_mutex);
+
+	return retval;
 }
 
 /**
@@ -639,32 +2080,20 @@ ev_document_synctex_backward_search (EvDocument *document,
                                      gfloat      x,
                                      gfloat      y)
 {
-        EvSourceLink *result = NULL;
-        synctex_scanner_t scanner;
+        EvSourceLink   *result = NULL;
+        EvSynctexIndex *index;
+        const gchar    *filename;
+        gint            line, column;
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 
-        scanner = document->priv->synctex_scanner;
-        if (!scanner)
-                return NULL;
-
-        if (synctex_edit_query (scanner, page_index + 1, x, y) > 0) {
-                synctex_node_t node;
-
-                /* We assume that a backward search returns either zero or one result_node */
-                node = synctex_next_result (scanner);
-                if (node != NULL) {
-			const gchar *filename;
-
-			filename = synctex_scanner_get_name (scanner, synctex_node_tag (node));
-			
-			if (filename) {
-				result = ev_source_link_new (filename,
-							     synctex_node_line (node),
-							     synctex_node_column (node));
-			}
-                }
+        index = ev_document_lock_synctex_index (document);
+        if (index &&
+            ev_synctex_index_backward_search (index, page_index, x, y,
+                                              &filename, &line, &column)) {
+                result = ev_source_link_new (filename, line, column);
         }
+        g_mutex_unlock (&document->priv->synctex_mutex);
 
         return result;
 }
@@ -684,33 +2113,22 @@ EvMapping *
 ev_document_synctex_forward_search (EvDocument   *document,
 				    EvSourceLink *link)
 {
-        EvMapping        *result = NULL;
-        synctex_scanner_t scanner;
+        EvMapping      *result = NULL;
+        EvSynctexIndex *index;
+        EvRectangle     area;
+        gint            page;
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 
-        scanner = document->priv->synctex_scanner;
-        if (!scanner)
-                return NULL;
-
-        if (synctex_display_query (scanner, link->filename, link->line, link->col) > 0) {
-                synctex_node_t node;
-                gint           page;
-
-                if ((node = synctex_next_result (scanner))) {
-                        result = g_new (EvMapping, 1);
-
-                        page = synctex_node_page (node) - 1;
-                        result->data = GINT_TO_POINTER (page);
-
-                        result->area.x1 = synctex_node_box_visible_h (node);
-                        result->area.y1 = synctex_node_box_visible_v (node) -
-                                synctex_node_box_visible_height (node);
-                        result->area.x2 = synctex_node_box_visible_width (node) + result->area.x1;
-                        result->area.y2 = synctex_node_box_visible_depth (node) +
-                                synctex_node_box_visible_height (node) + result->area.y1;
-                }
+        index = ev_document_lock_synctex_index (document);
+        if (index &&
+            ev_synctex_index_forward_search (index, link->filename, link->line, link->col,
+                                             &page, &area)) {
+                result = g_new (EvMapping, 1);
+                result->data = GINT_TO_POINTER (page);
+                result->area = area;
         }
+        g_mutex_unlock (&document->priv->synctex_mutex);
 
         return result;
 }
@@ -789,6 +2207,7 @@ ev_document_get_page_size (EvDocument *document,
 	priv = document->priv;
 
 	if (priv->cache_loaded) {
+		g_mutex_lock (&priv->cache_mutex);
 		if (width)
 			*width = priv->uniform ?
 				priv->uniform_width :
@@ -797,17 +2216,85 @@ ev_document_get_page_size (EvDocument *document,
 			*height = priv->uniform ?
 				priv->uniform_height :
 				priv->page_sizes[page_index].height;
+		g_mutex_unlock (&priv->cache_mutex);
 	} else {
 		EvPage *page;
 
-		g_mutex_lock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
 		page = ev_document_get_page (document, page_index);
 		_ev_document_get_page_size (document, page, width, height);
 		g_object_unref (page);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 }
 
+/**
+ * ev_document_prioritize_page:
+ * @document: an #EvDocument
+ * @page_index: the index of a page
+ *
+ * Documents with many pages are shown before the sizes and labels of
+ * all their pages are known, the pages not probed yet are assumed to
+ * be the size of the first one. This asks for the page at @page_index
+ * and the few following ones to be probed before the others, like
+ * when they are going to be shown. The #EvDocument::cache-updated
+ * signal is emitted if their sizes or labels turn out to be different.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_prioritize_page (EvDocument *document,
+			     gint        page_index)
+{
+	EvDocumentPrivate *priv;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	priv = document->priv;
+	g_return_if_fail (page_index >= 0 && page_index < priv->n_pages);
+
+	g_mutex_lock (&priv->cache_mutex);
+	if (priv->cache_loaded && page_index >= priv->n_probed_pages)
+		g_atomic_int_set (&priv->priority_page, page_index);
+	g_mutex_unlock (&priv->cache_mutex);
+}
+
+/**
+ * ev_document_probe_page:
+ * @document: an #EvDocument
+ * @page_index: the index of a page
+ *
+ * Probes the size and label of the page at @page_index right away if
+ * it hasn't been yet, for the callers that can't do with the estimated
+ * ones until #EvDocument::cache-updated is emitted, like when printing.
+ * This can block while the document is being rendered.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_probe_page (EvDocument *document,
+			gint        page_index)
+{
+	EvDocumentPrivate *priv;
+	EvCacheProbe       probe;
+	gboolean           probed;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	priv = document->priv;
+	g_return_if_fail (page_index >= 0 && page_index < priv->n_pages);
+
+	g_mutex_lock (&priv->cache_mutex);
+	probed = !priv->cache_loaded || page_index < priv->n_probed_pages;
+	probe.generation = g_atomic_int_get (&priv->cache_generation);
+	g_mutex_unlock (&priv->cache_mutex);
+	if (probed)
+		return;
+
+	probe.document = document;
+	ev_document_probe_pages (&probe, page_index, page_index + 1, FALSE);
+}
+
 static gchar *
 _ev_document_get_page_label (EvDocument *document,
 			     EvPage     *page)
@@ -822,25 +2309,122 @@ gchar *
 ev_document_get_page_label (EvDocument *document,
 			    gint        page_index)
 {
+	gchar *page_label = NULL;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 	g_return_val_if_fail (page_index >= 0 || page_index < document->priv->n_pages, NULL);
 
 	if (!document->priv->cache_loaded) {
 		EvPage *page;
-		gchar *page_label;
 
-		g_mutex_lock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
 		page = ev_document_get_page (document, page_index);
 		page_label = _ev_document_get_page_label (document, page);
 		g_object_unref (page);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_unlock (&document->priv->mutex);
 
 		return page_label ? page_label : g_strdup_printf ("%d", page_index + 1);
 	}
 
-	return (document->priv->page_labels && document->priv->page_labels[page_index]) ?
-		g_strdup (document->priv->page_labels[page_index]) :
-		g_strdup_printf ("%d", page_index + 1);
+	g_mutex_lock (&document->priv->cache_mutex);
+	if (document->priv->page_labels && document->priv->page_labels[page_index])
+		page_label = g_strdup (document->priv->page_labels[page_index]);
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return page_label ? page_label : g_strdup_printf ("%d", page_index + 1);
+}
+
+/**
+ * ev_document_get_page_digest:
+ * @document: an #EvDocument
+ * @page_index: the index of a page
+ *
+ * Gets a checksum of the contents of the page at @page_index, to tell
+ * the pages that didn't change between two versions of a document,
+ * like when it's reloaded after being modified. The backends make it
+ * from what they can find out cheaply about the page, see their
+ * implementations for the changes they could miss.
+ *
+ * It must be called with @document locked, see ev_document_lock().
+ *
+ * Returns: (nullable) (transfer full): a checksum made of hexadecimal
+ *   digits, or %NULL if the backend doesn't support it
+ *
+ * Since: 3.30
+ */
+gchar *
+ev_document_get_page_digest (EvDocument *document,
+			     gint        page_index)
+{
+	EvDocumentClass   *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentPrivate *priv;
+	EvPage            *page;
+	gchar             *digest = NULL;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	priv = document->priv;
+	g_return_val_if_fail (page_index >= 0 && page_index < priv->n_pages, NULL);
+
+	if (!klass->get_page_digest)
+		return NULL;
+
+	g_mutex_lock (&priv->cache_mutex);
+	if (priv->page_digests && (guint) page_index < priv->page_digests->len)
+		digest = g_strdup (g_ptr_array_index (priv->page_digests, page_index));
+	g_mutex_unlock (&priv->cache_mutex);
+
+	if (digest)
+		return digest;
+
+	page = ev_document_get_page (document, page_index);
+	digest = klass->get_page_digest (document, page);
+	g_object_unref (page);
+
+	if (!digest)
+		return NULL;
+
+	g_mutex_lock (&priv->cache_mutex);
+	if (!priv->page_digests)
+		priv->page_digests = g_ptr_array_new_with_free_func (g_free);
+	if (priv->page_digests->len < (guint) priv->n_pages)
+		g_ptr_array_set_size (priv->page_digests, priv->n_pages);
+	g_free (g_ptr_array_index (priv->page_digests, page_index));
+	g_ptr_array_index (priv->page_digests, page_index) = g_strdup (digest);
+	g_mutex_unlock (&priv->cache_mutex);
+
+	return digest;
+}
+
+/**
+ * ev_document_get_page_color_mode:
+ * @document: an #EvDocument
+ * @page: an #EvPage
+ *
+ * Gets whether @page only has shades of gray, or only black and white,
+ * as far as the backend can tell without rendering it. Renders of such
+ * pages can be kept in a smaller format.
+ *
+ * It must be called with @document locked, see ev_document_lock().
+ *
+ * Returns: the #EvPageColorMode of @page, %EV_PAGE_COLOR_MODE_COLOR
+ *   when the backend doesn't know
+ *
+ * Since: 3.30
+ */
+EvPageColorMode
+ev_document_get_page_color_mode (EvDocument *document,
+				 EvPage     *page)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), EV_PAGE_COLOR_MODE_COLOR);
+	g_return_val_if_fail (EV_IS_PAGE (page), EV_PAGE_COLOR_MODE_COLOR);
+
+	if (!klass->get_page_color_mode)
+		return EV_PAGE_COLOR_MODE_COLOR;
+
+	return klass->get_page_color_mode (document, page);
 }
 
 static EvDocumentInfo *
@@ -873,13 +2457,54 @@ ev_document_get_backend_info (EvDocument *document, EvDocumentBackendInfo *info)
 	return klass->get_backend_info (document, info);
 }
 
+static cairo_surface_t *
+ev_document_render_page_area (EvDocument      *document,
+			      EvRenderContext *rc)
+{
+	EvDocumentClass      *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t      *surface;
+	cairo_surface_t      *area_surface;
+	cairo_rectangle_int_t area;
+	cairo_t              *cr;
+
+	if (!ev_render_context_get_area (rc, &area) || ev_document_can_render_area (document))
+		return klass->render (document, rc);
+
+	/* The backend can only render whole pages, crop the result */
+	ev_render_context_set_area (rc, NULL);
+	surface = klass->render (document, rc);
+	ev_render_context_set_area (rc, &area);
+	if (!surface)
+		return NULL;
+
+	if (ev_render_context_is_cancelled (rc)) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+
+	area_surface = cairo_surface_create_similar_image (surface,
+							   cairo_image_surface_get_format (surface),
+							   area.width, area.height);
+	cr = cairo_create (area_surface);
+	cairo_set_source_surface (cr, surface, -area.x, -area.y);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+
+	return area_surface;
+}
+
 cairo_surface_t *
 ev_document_render (EvDocument      *document,
 		    EvRenderContext *rc)
 {
-	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t *surface;
+	gint64           trace = ev_trace_begin ();
 
-	return klass->render (document, rc);
+	surface = ev_document_render_page_area (document, rc);
+	ev_trace_end (trace, "render", G_OBJECT_TYPE_NAME (document), rc->page->index);
+
+	return surface;
 }
 
 static GdkPixbuf *
@@ -889,7 +2514,9 @@ _ev_document_get_thumbnail (EvDocument      *document,
 	cairo_surface_t *surface;
 	GdkPixbuf       *pixbuf = NULL;
 
-	surface = ev_document_render (document, rc);
+	/* Backends only need to provide surfaces, they are
+	 * converted once here for the callers that want a pixbuf */
+	surface = ev_document_get_thumbnail_surface (document, rc);
 	if (surface != NULL) {
 		pixbuf = ev_document_misc_pixbuf_from_surface (surface);
 		cairo_surface_destroy (surface);
@@ -947,6 +2574,28 @@ ev_document_get_uri (EvDocument *document)
 	return document->priv->uri;
 }
 
+/**
+ * ev_document_get_fingerprint:
+ * @document: an #EvDocument
+ *
+ * Gets a string identifying the contents of @document, to use as a key
+ * for data cached about it. It's the identifier of the document given
+ * by the backend, like the ID of PDF documents, or a checksum of parts
+ * of the document file. It's computed when the document is loaded.
+ *
+ * Returns: (nullable): a fingerprint made of hexadecimal digits, or
+ *   %NULL if the document can't be identified
+ *
+ * Since: 3.30
+ */
+const gchar *
+ev_document_get_fingerprint (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	return document->priv->fingerprint;
+}
+
 const gchar *
 ev_document_get_title (EvDocument *document)
 {
@@ -962,9 +2611,9 @@ ev_document_is_page_size_uniform (EvDocument *document)
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), TRUE);
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
 	return document->priv->uniform;
@@ -978,15 +2627,17 @@ ev_document_get_max_page_size (EvDocument *document,
 	g_return_if_fail (EV_IS_DOCUMENT (document));
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
+	g_mutex_lock (&document->priv->cache_mutex);
 	if (width)
 		*width = document->priv->max_width;
 	if (height)
 		*height = document->priv->max_height;
+	g_mutex_unlock (&document->priv->cache_mutex);
 }
 
 void
@@ -997,15 +2648,17 @@ ev_document_get_min_page_size (EvDocument *document,
 	g_return_if_fail (EV_IS_DOCUMENT (document));
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
+	g_mutex_lock (&document->priv->cache_mutex);
 	if (width)
 		*width = document->priv->min_width;
 	if (height)
 		*height = document->priv->min_height;
+	g_mutex_unlock (&document->priv->cache_mutex);
 }
 
 gboolean
@@ -1014,9 +2667,9 @@ ev_document_check_dimensions (EvDocument *document)
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
 	return (document->priv->max_width > 0 && document->priv->max_height > 0);
@@ -1036,9 +2689,9 @@ ev_document_get_max_label_len (EvDocument *document)
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), -1);
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
 	return document->priv->max_label;
@@ -1050,12 +2703,87 @@ ev_document_has_text_page_labels (EvDocument *document)
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
-	return document->priv->page_labels != NULL;
+	return document->priv->custom_page_labels;
+}
+
+/**
+ * ev_document_is_thread_safe:
+ * @document: an #EvDocument
+ *
+ * Whether the backend of @document supports running several jobs
+ * for @document at the same time from different threads. The job
+ * scheduler never runs two jobs for the same document in parallel
+ * unless this returns %TRUE.
+ *
+ * Returns: %TRUE if the backend of @document is thread-safe
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_is_thread_safe (EvDocument *document)
+{
+	EvDocumentClass *klass;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	klass = EV_DOCUMENT_GET_CLASS (document);
+
+	return klass->is_thread_safe ? klass->is_thread_safe (document) : FALSE;
+}
+
+/**
+ * ev_document_can_render_area:
+ * @document: an #EvDocument
+ *
+ * Whether the backend of @document honours the area of an
+ * #EvRenderContext, rendering only that part of the page. When it
+ * doesn't, ev_document_render() renders the whole page and crops it,
+ * so callers should not split pages into tiles for such documents.
+ *
+ * Returns: %TRUE if the backend can render parts of a page
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_can_render_area (EvDocument *document)
+{
+	EvDocumentClass *klass;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	klass = EV_DOCUMENT_GET_CLASS (document);
+
+	return klass->can_render_area ? klass->can_render_area (document) : FALSE;
+}
+
+/**
+ * ev_document_can_render_layers:
+ * @document: an #EvDocument
+ *
+ * Whether the backend of @document honours the layer of an
+ * #EvRenderContext, so that the annotations of a page can be rendered
+ * apart from its content. Other backends render the whole page for
+ * any layer, so callers should not ask them for layers.
+ *
+ * Returns: %TRUE if the backend can render the layers of a page
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_document_can_render_layers (EvDocument *document)
+{
+	EvDocumentClass *klass;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	klass = EV_DOCUMENT_GET_CLASS (document);
+
+	return klass->can_render_layers ? klass->can_render_layers (document) : FALSE;
 }
 
 gboolean
@@ -1073,29 +2801,36 @@ ev_document_find_page_by_label (EvDocument  *document,
 	g_return_val_if_fail (page_index != NULL, FALSE);
 
 	if (!document->priv->cache_loaded) {
-		g_mutex_lock (&ev_doc_mutex);
-		ev_document_setup_cache (document);
-		g_mutex_unlock (&ev_doc_mutex);
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
 	}
 
-        /* First, look for a literal label match */
-	for (i = 0; priv->page_labels && i < priv->n_pages; i ++) {
-		if (priv->page_labels[i] != NULL &&
-		    ! strcmp (page_label, priv->page_labels[i])) {
-			*page_index = i;
+	g_mutex_lock (&priv->cache_mutex);
+
+	ev_document_ensure_label_index (document);
+	if (priv->label_index) {
+		gpointer value;
+
+		/* First, look for a literal label match */
+		if (g_hash_table_lookup_extended (priv->label_index, page_label, NULL, &value)) {
+			*page_index = GPOINTER_TO_INT (value);
+			g_mutex_unlock (&priv->cache_mutex);
 			return TRUE;
 		}
-	}
 
-	/* Second, look for a match with case insensitively */
-	for (i = 0; priv->page_labels && i < priv->n_pages; i++) {
-		if (priv->page_labels[i] != NULL &&
-		    ! strcasecmp (page_label, priv->page_labels[i])) {
-			*page_index = i;
+		/* Second, look for a match with case insensitively */
+		i = ev_document_label_index_lower_bound (document, page_label, -1);
+		if (i < priv->n_sorted_labels &&
+		    !g_ascii_strcasecmp (page_label, priv->page_labels[priv->sorted_labels[i]])) {
+			*page_index = priv->sorted_labels[i];
+			g_mutex_unlock (&priv->cache_mutex);
 			return TRUE;
 		}
 	}
 
+	g_mutex_unlock (&priv->cache_mutex);
+
 	/* Next, parse the label, and see if the number fits */
 	value = strtol (page_label, &endptr, 10);
 	if (endptr[0] == '\0') {
@@ -1113,6 +2848,65 @@ ev_document_find_page_by_label (EvDocument  *document,
 	return FALSE;
 }
 
+/**
+ * ev_document_find_pages_by_label_prefix:
+ * @document: an #EvDocument
+ * @prefix: the beginning of a page label
+ * @page_indices: (out caller-allocates) (array length=max_pages): return
+ *   location for the pages found
+ * @max_pages: the maximum number of pages to return
+ *
+ * Finds the pages whose label starts with @prefix, ignoring the case,
+ * sorted by label, for instance to complete a page label being typed.
+ *
+ * Returns: the number of pages stored in @page_indices
+ *
+ * Since: 3.30
+ */
+gint
+ev_document_find_pages_by_label_prefix (EvDocument  *document,
+					const gchar *prefix,
+					gint        *page_indices,
+					gint         max_pages)
+{
+	EvDocumentPrivate *priv = document->priv;
+	gsize              len;
+	gint               n_found = 0;
+	gint               i;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), 0);
+	g_return_val_if_fail (prefix != NULL, 0);
+	g_return_val_if_fail (page_indices != NULL || max_pages == 0, 0);
+
+	if (!document->priv->cache_loaded) {
+		g_mutex_lock (&document->priv->mutex);
+		ev_document_setup_cache (document, FALSE);
+		g_mutex_unlock (&document->priv->mutex);
+	}
+
+	g_mutex_lock (&priv->cache_mutex);
+
+	ev_document_ensure_label_index (document);
+	if (!priv->label_index) {
+		g_mutex_unlock (&priv->cache_mutex);
+		return 0;
+	}
+
+	len = strlen (prefix);
+	for (i = ev_document_label_index_lower_bound (document, prefix, len);
+	     i < priv->n_sorted_labels && n_found < max_pages; i++) {
+		gint page = priv->sorted_labels[i];
+
+		if (g_ascii_strncasecmp (priv->page_labels[page], prefix, len) != 0)
+			break;
+		page_indices[n_found++] = page;
+	}
+
+	g_mutex_unlock (&priv->cache_mutex);
+
+	return n_found;
+}
+
 /* EvSourceLink */
 G_DEFINE_BOXED_TYPE (EvSourceLink, ev_source_link, ev_source_link_copy, ev_source_link_free)
 
@@ -59,12 +59,22 @@ typedef enum /*< flags >*/ {
         EV_DOCUMENT_LOAD_FLAG_NO_CACHE
 } EvDocumentLoadFlags;
 
+typedef void (* EvDocumentLoadProgressFunc) (gdouble  fraction,
+					     gpointer user_data);
+
 typedef enum
 {
         EV_DOCUMENT_ERROR_INVALID,
         EV_DOCUMENT_ERROR_ENCRYPTED
 } EvDocumentError;
 
+typedef enum
+{
+        EV_PAGE_COLOR_MODE_COLOR,
+        EV_PAGE_COLOR_MODE_GRAYSCALE,
+        EV_PAGE_COLOR_MODE_MONOCHROME
+} EvPageColorMode;
+
 typedef struct _EvPoint EvPoint;
 typedef struct _EvRectangle EvRectangle;
 typedef struct _EvMapping EvMapping;
@@ -131,6 +141,17 @@ struct _EvDocumentClass
 						     GError             **error);
 	cairo_surface_t * (* get_thumbnail_surface) (EvDocument          *document,
 						     EvRenderContext     *rc);
+	gboolean          (* is_thread_safe)        (EvDocument          *document);
+	gboolean          (* can_render_area)       (EvDocument          *document);
+	gchar           * (* get_fingerprint)       (EvDocument          *document);
+	gchar           * (* get_page_digest)       (EvDocument          *document,
+						     EvPage              *page);
+	gboolean          (* save_incremental)      (EvDocument          *document,
+						     const char          *uri,
+						     GError             **error);
+	EvPageColorMode   (* get_page_color_mode)   (EvDocument          *document,
+						     EvPage              *page);
+	gboolean          (* can_render_layers)     (EvDocument          *document);
 };
 
 GType            ev_document_get_type             (void) G_GNUC_CONST;
@@ -142,12 +163,21 @@ void             ev_document_doc_mutex_lock       (void);
 void             ev_document_doc_mutex_unlock     (void);
 gboolean         ev_document_doc_mutex_trylock    (void);
 
+/* Per-document lock */
+void             ev_document_lock                 (EvDocument      *document);
+void             ev_document_unlock               (EvDocument      *document);
+gboolean         ev_document_trylock              (EvDocument      *document);
+gboolean         ev_document_is_locked            (EvDocument      *document);
+
 /* FontConfig mutex */
 GMutex          *ev_document_get_fc_mutex         (void);
 void             ev_document_fc_mutex_lock        (void);
 void             ev_document_fc_mutex_unlock      (void);
 gboolean         ev_document_fc_mutex_trylock     (void);
 
+GVariant        *ev_document_get_mutex_stats      (void);
+void            _ev_document_warm_up_fontconfig   (void);
+
 EvDocumentInfo  *ev_document_get_info             (EvDocument      *document);
 gboolean         ev_document_get_backend_info     (EvDocument      *document,
 						   EvDocumentBackendInfo *info);
@@ -171,9 +201,22 @@ gboolean         ev_document_load_gfile           (EvDocument         *document,
                                                    EvDocumentLoadFlags flags,
                                                    GCancellable       *cancellable,
                                                    GError            **error);
+gboolean         ev_document_load_with_progress   (EvDocument                 *document,
+						   const char                 *uri,
+						   EvDocumentLoadFlags         flags,
+						   GCancellable               *cancellable,
+						   EvDocumentLoadProgressFunc  progress_func,
+						   gpointer                    user_data,
+						   GError                    **error);
+GCancellable    *ev_document_get_load_cancellable (EvDocument      *document);
+void             ev_document_set_load_progress    (EvDocument      *document,
+						   gdouble          fraction);
 gboolean         ev_document_save                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
+gboolean         ev_document_save_incremental     (EvDocument      *document,
+						   const char      *uri,
+						   GError         **error);
 gint             ev_document_get_n_pages          (EvDocument      *document);
 EvPage          *ev_document_get_page             (EvDocument      *document,
 						   gint             index);
@@ -183,6 +226,14 @@ void             ev_document_get_page_size        (EvDocument      *document,
 						   double          *height);
 gchar           *ev_document_get_page_label       (EvDocument      *document,
 						   gint             page_index);
+gchar           *ev_document_get_page_digest      (EvDocument      *document,
+						   gint             page_index);
+EvPageColorMode  ev_document_get_page_color_mode  (EvDocument      *document,
+						   EvPage          *page);
+void             ev_document_prioritize_page      (EvDocument      *document,
+						   gint             page_index);
+void             ev_document_probe_page           (EvDocument      *document,
+						   gint             page_index);
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
 GdkPixbuf       *ev_document_get_thumbnail        (EvDocument      *document,
@@ -191,6 +242,7 @@ cairo_surface_t *ev_document_get_thumbnail_surface (EvDocument      *document,
 						    EvRenderContext *rc);
 guint64          ev_document_get_size             (EvDocument      *document);
 const gchar     *ev_document_get_uri              (EvDocument      *document);
+const gchar     *ev_document_get_fingerprint      (EvDocument      *document);
 const gchar     *ev_document_get_title            (EvDocument      *document);
 gboolean         ev_document_is_page_size_uniform (EvDocument      *document);
 void             ev_document_get_max_page_size    (EvDocument      *document,
@@ -202,9 +254,17 @@ void             ev_document_get_min_page_size    (EvDocument      *document,
 gboolean         ev_document_check_dimensions     (EvDocument      *document);
 gint             ev_document_get_max_label_len    (EvDocument      *document);
 gboolean         ev_document_has_text_page_labels (EvDocument      *document);
+gboolean         ev_document_is_thread_safe       (EvDocument      *document);
+gboolean         ev_document_can_render_area      (EvDocument      *document);
+gboolean         ev_document_can_render_layers    (EvDocument      *document);
 gboolean         ev_document_find_page_by_label   (EvDocument      *document,
 						   const gchar     *page_label,
 						   gint            *page_index);
+gint             ev_document_find_pages_by_label_prefix
+                                                  (EvDocument      *document,
+                                                   const gchar     *prefix,
+                                                   gint            *page_indices,
+                                                   gint             max_pages);
 gboolean	 ev_document_has_synctex 	  (EvDocument      *document);
 
 EvSourceLink    *ev_document_synctex_backward_search
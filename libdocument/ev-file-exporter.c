@@ -82,3 +82,56 @@ ev_file_exporter_get_capabilities (EvFileExporter *exporter)
 
 	return iface->get_capabilities (exporter);
 }
+
+/**
+ * ev_file_exporter_render_page:
+ * @exporter: an #EvFileExporter
+ * @rc: an #EvRenderContext
+ *
+ * Renders the page of @rc to a recording surface, so that it can be
+ * exported later with ev_file_exporter_do_rendered_page(). Exporters
+ * with %EV_FILE_EXPORTER_CAN_RENDER_PAGES can render several pages at
+ * the same time, in any order, from any thread and without the
+ * document lock, also while exporting.
+ *
+ * Returns: (transfer full) (nullable): the rendered page, or %NULL
+ *
+ * Since: 3.30
+ */
+cairo_surface_t *
+ev_file_exporter_render_page (EvFileExporter  *exporter,
+			      EvRenderContext *rc)
+{
+	EvFileExporterInterface *iface = EV_FILE_EXPORTER_GET_IFACE (exporter);
+
+	if (!iface->render_page)
+		return NULL;
+
+	return iface->render_page (exporter, rc);
+}
+
+/**
+ * ev_file_exporter_do_rendered_page:
+ * @exporter: an #EvFileExporter
+ * @rc: an #EvRenderContext
+ * @page: the page of @rc rendered with ev_file_exporter_render_page()
+ *
+ * Like ev_file_exporter_do_page(), but exports @page instead of rendering
+ * the page of @rc again.
+ *
+ * Since: 3.30
+ */
+void
+ev_file_exporter_do_rendered_page (EvFileExporter  *exporter,
+				   EvRenderContext *rc,
+				   cairo_surface_t *page)
+{
+	EvFileExporterInterface *iface = EV_FILE_EXPORTER_GET_IFACE (exporter);
+
+	if (!iface->do_rendered_page || !page) {
+		iface->do_page (exporter, rc);
+		return;
+	}
+
+	iface->do_rendered_page (exporter, rc, page);
+}
@@ -48,7 +48,8 @@ typedef enum {
 	EV_FILE_EXPORTER_CAN_GENERATE_PDF = 1 << 5,
 	EV_FILE_EXPORTER_CAN_GENERATE_PS  = 1 << 6,
 	EV_FILE_EXPORTER_CAN_PREVIEW      = 1 << 7,
-	EV_FILE_EXPORTER_CAN_NUMBER_UP    = 1 << 8
+	EV_FILE_EXPORTER_CAN_NUMBER_UP    = 1 << 8,
+	EV_FILE_EXPORTER_CAN_RENDER_PAGES = 1 << 16
 } EvFileExporterCapabilities;
 
 typedef struct _EvFileExporterContext EvFileExporterContext;
@@ -86,6 +87,11 @@ struct _EvFileExporterInterface {
 	void                       (* end_page)         (EvFileExporter        *exporter);
         void                       (* end)              (EvFileExporter        *exporter);
 	EvFileExporterCapabilities (* get_capabilities) (EvFileExporter        *exporter);
+	cairo_surface_t *          (* render_page)      (EvFileExporter        *exporter,
+							 EvRenderContext       *rc);
+	void                       (* do_rendered_page) (EvFileExporter        *exporter,
+							 EvRenderContext       *rc,
+							 cairo_surface_t       *page);
 };
 
 GType                      ev_file_exporter_get_type         (void) G_GNUC_CONST;
@@ -97,6 +103,11 @@ void                       ev_file_exporter_do_page          (EvFileExporter
 void                       ev_file_exporter_end_page         (EvFileExporter        *exporter);
 void                       ev_file_exporter_end              (EvFileExporter        *exporter);
 EvFileExporterCapabilities ev_file_exporter_get_capabilities (EvFileExporter        *exporter);
+cairo_surface_t           *ev_file_exporter_render_page      (EvFileExporter        *exporter,
+							      EvRenderContext       *rc);
+void                       ev_file_exporter_do_rendered_page (EvFileExporter        *exporter,
+							      EvRenderContext       *rc,
+							      cairo_surface_t       *page);
 
 G_END_DECLS
 
@@ -19,11 +19,22 @@
 
 #include <config.h>
 
+#ifdef HAVE_COPY_FILE_RANGE
+/* copy_file_range() is only declared with _GNU_SOURCE */
+#define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -32,6 +43,7 @@
 #include "ev-file-helpers.h"
 
 static gchar *tmp_dir = NULL;
+static mode_t file_umask = 022;
 
 /*
  * ev_dir_ensure_exists:
@@ -102,6 +114,10 @@ _ev_tmp_dir (GError **error)
 void
 _ev_file_helpers_init (void)
 {
+	/* umask() can only be read by setting it, which isn't safe
+	 * once other threads create files */
+	file_umask = umask (0);
+	umask (file_umask);
 }
 
 void
@@ -157,6 +173,60 @@ ev_mkstemp (const char  *tmpl,
         return fd;
 }
 
+/**
+ * ev_mkstemp_sibling:
+ * @filename: the file the temp file will replace
+ * @file_name: a location to store the filename of the temp file
+ * @error: a location to store a #GError
+ *
+ * Creates a hidden temp file in the directory of @filename, with the
+ * permissions a new file would get, so that it can be renamed over
+ * @filename once written.
+ *
+ * Returns: a file descriptor to the newly created temp file name, or %-1
+ *   on error with @error filled in
+ *
+ * Since: 3.30
+ */
+int
+ev_mkstemp_sibling (const char  *filename,
+                    char       **file_name,
+                    GError     **error)
+{
+        gchar *dirname, *basename, *tmpl;
+        char *name;
+        int fd;
+
+        dirname = g_path_get_dirname (filename);
+        basename = g_path_get_basename (filename);
+        tmpl = g_strdup_printf (".%s.XXXXXX", basename);
+        name = g_build_filename (dirname, tmpl, NULL);
+        g_free (dirname);
+        g_free (basename);
+        g_free (tmpl);
+
+        fd = g_mkstemp (name);
+        if (fd == -1) {
+		int errsv = errno;
+
+                g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                             _("Failed to create a temporary file: %s"),
+                             g_strerror (errsv));
+
+                g_free (name);
+                return -1;
+        }
+
+        fchmod (fd, 0666 & ~file_umask);
+
+        if (file_name)
+                *file_name = name;
+        else
+                g_free (name);
+
+        return fd;
+}
+
 static void
 close_fd_cb (gpointer fdptr)
 {
@@ -427,6 +497,98 @@ ev_xfer_uri_simple (const char *from,
 	return result;
 }
 
+/* Copies the contents of @from_fd into @to_fd without reading them:
+ * the blocks are shared with FICLONE where the file system supports
+ * it, or copied by the kernel otherwise */
+static gboolean
+clone_fd (int from_fd,
+	  int to_fd)
+{
+#ifdef FICLONE
+	if (ioctl (to_fd, FICLONE, from_fd) == 0)
+		return TRUE;
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+	{
+		struct stat st;
+		off_t       left;
+
+		if (fstat (from_fd, &st) == -1)
+			return FALSE;
+
+		left = st.st_size;
+		while (left > 0) {
+			ssize_t n;
+
+			n = copy_file_range (from_fd, NULL, to_fd, NULL, left, 0);
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return FALSE;
+			left -= n;
+		}
+
+		return TRUE;
+	}
+#else
+	return FALSE;
+#endif
+}
+
+/**
+ * ev_file_clone_uri:
+ * @from: the source URI
+ * @to: the target URI
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Copies @from to @to like ev_xfer_uri_simple(), but when both are
+ * local files the data is shared with a reflink or copied by the
+ * kernel where possible instead of being read and written back.
+ *
+ * Returns: %TRUE on success, or %FALSE on error with @error filled in
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_file_clone_uri (const char *from,
+		   const char *to,
+		   GError    **error)
+{
+	gchar   *from_path;
+	gchar   *to_path;
+	int      from_fd = -1;
+	int      to_fd = -1;
+	gboolean cloned = FALSE;
+
+	if (!from)
+		return TRUE;
+
+        g_return_val_if_fail (to != NULL, TRUE);
+
+	from_path = g_filename_from_uri (from, NULL, NULL);
+	to_path = g_filename_from_uri (to, NULL, NULL);
+	if (from_path && to_path && strcmp (from_path, to_path) != 0) {
+		from_fd = g_open (from_path, O_RDONLY | O_CLOEXEC, 0);
+		if (from_fd != -1)
+			to_fd = g_open (to_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		if (to_fd != -1) {
+			cloned = clone_fd (from_fd, to_fd);
+			close (to_fd);
+		}
+		if (from_fd != -1)
+			close (from_fd);
+	}
+	g_free (from_path);
+	g_free (to_path);
+
+	if (cloned)
+		return TRUE;
+
+	/* Not local, or not supported by the file system */
+	return ev_xfer_uri_simple (from, to, error);
+}
+
 /**
  * ev_file_copy_metadata:
  * @from: the source URI
@@ -589,6 +751,66 @@ static const char *compressor_cmds[] = {
 #define N_ARGS      4
 #define BUFFER_SIZE 1024
 
+/* Gzip files are handled in-process with a zlib converter, instead of
+ * spawning gzip. GIO has no converter for the other formats.
+ */
+static gchar *
+compression_run_zlib (const gchar *uri,
+		      gboolean     compress,
+		      GError     **error)
+{
+	GFile             *file;
+	GFile             *file_dst;
+	GFileInputStream  *in;
+	GFileOutputStream *out;
+	GConverter        *converter;
+	GInputStream      *converter_in;
+	gchar             *uri_dst = NULL;
+	gssize             n_written;
+
+	file = g_file_new_for_uri (uri);
+	in = g_file_read (file, NULL, error);
+	g_object_unref (file);
+	if (!in)
+		return NULL;
+
+	file_dst = ev_mkstemp_file ("comp.XXXXXX", error);
+	if (!file_dst) {
+		g_object_unref (in);
+		return NULL;
+	}
+
+	out = g_file_replace (file_dst, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+	if (!out) {
+		g_object_unref (file_dst);
+		g_object_unref (in);
+		return NULL;
+	}
+
+	if (compress)
+		converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+	else
+		converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	converter_in = g_converter_input_stream_new (G_INPUT_STREAM (in), converter);
+	g_object_unref (converter);
+	g_object_unref (in);
+
+	n_written = g_output_stream_splice (G_OUTPUT_STREAM (out), converter_in,
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+					    NULL, error);
+	g_object_unref (converter_in);
+	g_object_unref (out);
+
+	if (n_written != -1)
+		uri_dst = g_file_get_uri (file_dst);
+	else
+		g_file_delete (file_dst, NULL, NULL);
+	g_object_unref (file_dst);
+
+	return uri_dst;
+}
+
 static gchar *
 compression_run (const gchar       *uri,
 		 EvCompressionType  type,
@@ -605,6 +827,9 @@ compression_run (const gchar       *uri,
 	if (type == EV_COMPRESSION_NONE)
 		return NULL;
 
+	if (type == EV_COMPRESSION_GZIP)
+		return compression_run_zlib (uri, compress, error);
+
 	cmd = g_find_program_in_path (compressor_cmds[type]);
 	if (!cmd) {
 		/* FIXME: better error codes! */
@@ -45,6 +45,9 @@ int          ev_mkstemp               (const char        *tmpl,
                                        GError           **error);
 GFile       *ev_mkstemp_file          (const char        *tmpl,
                                        GError           **error);
+int          ev_mkstemp_sibling       (const char        *filename,
+                                       char             **file_name,
+                                       GError           **error);
 gchar       *ev_mkdtemp               (const char        *tmpl,
                                        GError           **error);
 void         ev_tmp_filename_unlink   (const gchar       *filename);
@@ -54,6 +57,9 @@ gboolean     ev_file_is_temp          (GFile             *file);
 gboolean     ev_xfer_uri_simple       (const char        *from,
 				       const char        *to,
 				       GError           **error);
+gboolean     ev_file_clone_uri        (const char        *from,
+				       const char        *to,
+				       GError           **error);
 gboolean     ev_file_copy_metadata    (const char        *from,
                                        const char        *to,
                                        GError           **error);
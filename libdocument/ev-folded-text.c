@@ -0,0 +1,512 @@
+/* ev-folded-text.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON) && defined (__aarch64__)
+#include <arm_neon.h>
+#define HAVE_FIND_NEON
+#endif
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_FIND_AVX2
+#include <immintrin.h>
+#endif
+
+#include "ev-folded-text.h"
+
+/* The text of a page is folded once, and then searched for any number
+ * of folded queries with plain byte comparisons. Every character of
+ * the page text is folded on its own, so a folded query is found in
+ * the folded text wherever the query matches the page text ignoring
+ * case, diacritics and the length of the runs of spaces. The index of
+ * the page text character every folded byte comes from is kept, to
+ * map the matches back to the text layout.
+ */
+struct _EvFoldedText {
+	gchar       *text;
+	gsize        len;
+	guint32     *offsets; /* Folded byte -> page text character */
+	EvFoldFlags  flags;
+};
+
+static void
+ev_fold_append_char (GString    *str,
+		     GArray     *offsets,
+		     gunichar    c,
+		     EvFoldFlags flags,
+		     guint32     index)
+{
+	gsize len = str->len;
+
+	if (c < 0x80) {
+		g_string_append_c (str, (flags & EV_FOLD_CASE) ? g_ascii_tolower (c) : c);
+	} else if (flags & EV_FOLD_CASE) {
+		/* Simple case folding: one character for one, so that
+		 * final sigma and the like fold like their capitals */
+		g_string_append_unichar (str, g_unichar_tolower (g_unichar_toupper (c)));
+	} else {
+		g_string_append_unichar (str, c);
+	}
+
+	if (offsets) {
+		for (; len < str->len; len++)
+			g_array_append_val (offsets, index);
+	}
+}
+
+static void
+ev_fold_append (GString     *str,
+		GArray      *offsets,
+		const gchar *text,
+		EvFoldFlags  flags)
+{
+	const gchar *p;
+	guint32      index = 0;
+	gboolean     in_space = FALSE;
+
+	for (p = text; *p; p = g_utf8_next_char (p), index++) {
+		gunichar c = g_utf8_get_char (p);
+
+		/* Line breaks match spaces, like in the backends */
+		if (g_unichar_isspace (c)) {
+			if (!in_space)
+				ev_fold_append_char (str, offsets, ' ', flags, index);
+			in_space = TRUE;
+			continue;
+		}
+		in_space = FALSE;
+
+		if (flags & EV_FOLD_DIACRITICS) {
+			gunichar decomposition[G_UNICHAR_MAX_DECOMPOSITION_LENGTH];
+			gsize    n_chars, i;
+
+			n_chars = g_unichar_fully_decompose (c, FALSE, decomposition,
+							     G_UNICHAR_MAX_DECOMPOSITION_LENGTH);
+			for (i = 0; i < n_chars; i++) {
+				if (!g_unichar_ismark (decomposition[i]))
+					ev_fold_append_char (str, offsets, decomposition[i], flags, index);
+			}
+		} else {
+			ev_fold_append_char (str, offsets, c, flags, index);
+		}
+	}
+}
+
+/**
+ * ev_fold_text:
+ * @text: a valid UTF-8 string
+ * @flags: the #EvFoldFlags
+ *
+ * Folds @text like ev_folded_text_new() folds the text of a page,
+ * so that the result can be looked for in an #EvFoldedText.
+ *
+ * Returns: (transfer full): the folded text
+ *
+ * Since: 3.30
+ */
+gchar *
+ev_fold_text (const gchar *text,
+	      EvFoldFlags  flags)
+{
+	GString *str;
+
+	g_return_val_if_fail (text != NULL, NULL);
+
+	str = g_string_sized_new (strlen (text));
+	ev_fold_append (str, NULL, text, flags);
+
+	return g_string_free (str, FALSE);
+}
+
+/**
+ * ev_folded_text_new: (skip)
+ * @text: the text of a page
+ * @flags: the #EvFoldFlags
+ *
+ * Folds @text for searching it: with %EV_FOLD_CASE, characters are
+ * replaced by their simple case folding, and with %EV_FOLD_DIACRITICS,
+ * the combining marks of their canonical decomposition are removed.
+ * Runs of spaces and line breaks become a single space.
+ *
+ * Returns: a new #EvFoldedText, or %NULL if @text is not valid UTF-8
+ *
+ * Since: 3.30
+ */
+EvFoldedText *
+ev_folded_text_new (const gchar *text,
+		    EvFoldFlags  flags)
+{
+	EvFoldedText *folded;
+	GString      *str;
+	GArray       *offsets;
+	gsize         len;
+
+	g_return_val_if_fail (text != NULL, NULL);
+
+	if (!g_utf8_validate (text, -1, NULL))
+		return NULL;
+
+	len = strlen (text);
+	str = g_string_sized_new (len);
+	offsets = g_array_sized_new (FALSE, FALSE, sizeof (guint32), len);
+	ev_fold_append (str, offsets, text, flags);
+
+	folded = g_slice_new (EvFoldedText);
+	folded->len = str->len;
+	folded->text = g_string_free (str, FALSE);
+	folded->offsets = (guint32 *) g_array_free (offsets, FALSE);
+	folded->flags = flags;
+
+	return folded;
+}
+
+/**
+ * ev_folded_text_free:
+ * @folded: (allow-none): an #EvFoldedText
+ *
+ * Since: 3.30
+ */
+void
+ev_folded_text_free (EvFoldedText *folded)
+{
+	if (!folded)
+		return;
+
+	g_free (folded->text);
+	g_free (folded->offsets);
+	g_slice_free (EvFoldedText, folded);
+}
+
+/**
+ * ev_folded_text_get_text:
+ * @folded: an #EvFoldedText
+ *
+ * Returns: the folded text
+ *
+ * Since: 3.30
+ */
+const gchar *
+ev_folded_text_get_text (EvFoldedText *folded)
+{
+	g_return_val_if_fail (folded != NULL, NULL);
+
+	return folded->text;
+}
+
+/**
+ * ev_folded_text_get_flags:
+ * @folded: an #EvFoldedText
+ *
+ * Returns: the #EvFoldFlags @folded was folded with
+ *
+ * Since: 3.30
+ */
+EvFoldFlags
+ev_folded_text_get_flags (EvFoldedText *folded)
+{
+	g_return_val_if_fail (folded != NULL, EV_FOLD_NONE);
+
+	return folded->flags;
+}
+
+#if defined (HAVE_FIND_AVX2)
+/* Looks for needle from *pos, 32 positions at a time, and leaves *pos
+ * where the blocks left off */
+__attribute__((target("avx2")))
+static const gchar *
+ev_folded_text_search_avx2 (const gchar *haystack,
+			    gsize        len,
+			    const gchar *needle,
+			    gsize        n,
+			    gsize       *pos)
+{
+	const __m256i first = _mm256_set1_epi8 (needle[0]);
+	const __m256i last = _mm256_set1_epi8 (needle[n - 1]);
+	gsize         i;
+
+	for (i = *pos; i + n - 1 + 32 <= len; i += 32) {
+		__m256i block_first = _mm256_loadu_si256 ((const __m256i *) (haystack + i));
+		__m256i block_last = _mm256_loadu_si256 ((const __m256i *) (haystack + i + n - 1));
+		guint32 mask;
+
+		mask = (guint32) _mm256_movemask_epi8 (_mm256_and_si256 (_mm256_cmpeq_epi8 (block_first, first),
+									 _mm256_cmpeq_epi8 (block_last, last)));
+		while (mask) {
+			gint bit = g_bit_nth_lsf (mask, -1);
+
+			if (memcmp (haystack + i + bit + 1, needle + 1, n - 2) == 0) {
+				*pos = i;
+				return haystack + i + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+	*pos = i;
+
+	return NULL;
+}
+
+static gboolean
+ev_folded_text_use_avx2 (void)
+{
+	/* Checking twice from concurrent threads is harmless */
+	static gint use_avx2 = -1;
+
+	if (use_avx2 == -1) {
+		__builtin_cpu_init ();
+		use_avx2 = __builtin_cpu_supports ("avx2") != 0;
+	}
+
+	return use_avx2;
+}
+#endif
+
+/* Returns the first occurrence of needle in the len bytes of haystack.
+ * Candidates are the positions where both the first and the last byte
+ * of needle match, tested 16 at a time, or 32 when the CPU has AVX2,
+ * and only those are compared.
+ */
+static const gchar *
+ev_folded_text_search (const gchar *haystack,
+		       gsize        len,
+		       const gchar *needle,
+		       gsize        n)
+{
+	gsize i = 0;
+
+	if (len < n)
+		return NULL;
+
+#if defined (HAVE_FIND_AVX2)
+	/* The shorter blocks go on with the rest */
+	if (n > 1 && ev_folded_text_use_avx2 ()) {
+		const gchar *match;
+
+		match = ev_folded_text_search_avx2 (haystack, len, needle, n, &i);
+		if (match)
+			return match;
+	}
+#endif
+#if defined (__SSE2__)
+	if (n > 1) {
+		const __m128i first = _mm_set1_epi8 (needle[0]);
+		const __m128i last = _mm_set1_epi8 (needle[n - 1]);
+
+		for (; i + n - 1 + 16 <= len; i += 16) {
+			__m128i block_first = _mm_loadu_si128 ((const __m128i *) (haystack + i));
+			__m128i block_last = _mm_loadu_si128 ((const __m128i *) (haystack + i + n - 1));
+			guint   mask;
+
+			mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, first),
+								 _mm_cmpeq_epi8 (block_last, last)));
+			while (mask) {
+				gint bit = g_bit_nth_lsf (mask, -1);
+
+				if (memcmp (haystack + i + bit + 1, needle + 1, n - 2) == 0)
+					return haystack + i + bit;
+				mask &= mask - 1;
+			}
+		}
+	}
+#elif defined (HAVE_FIND_NEON)
+	if (n > 1) {
+		const uint8x16_t first = vdupq_n_u8 ((guint8) needle[0]);
+		const uint8x16_t last = vdupq_n_u8 ((guint8) needle[n - 1]);
+
+		for (; i + n - 1 + 16 <= len; i += 16) {
+			uint8x16_t eq;
+			guint8     lanes[16];
+			gint       j;
+
+			eq = vandq_u8 (vceqq_u8 (vld1q_u8 ((const guint8 *) haystack + i), first),
+				       vceqq_u8 (vld1q_u8 ((const guint8 *) haystack + i + n - 1), last));
+			if (vmaxvq_u8 (eq) == 0)
+				continue;
+
+			vst1q_u8 (lanes, eq);
+			for (j = 0; j < 16; j++) {
+				if (lanes[j] && memcmp (haystack + i + j + 1, needle + 1, n - 2) == 0)
+					return haystack + i + j;
+			}
+		}
+	}
+#endif
+	while (i + n <= len) {
+		const gchar *p;
+
+		p = memchr (haystack + i, needle[0], len - n + 1 - i);
+		if (!p)
+			return NULL;
+
+		if (memcmp (p + 1, needle + 1, n - 1) == 0)
+			return p;
+		i = p - haystack + 1;
+	}
+
+	return NULL;
+}
+
+static gboolean
+ev_folded_text_is_word_boundary (EvFoldedText *folded,
+				 gsize         start,
+				 gsize         end)
+{
+	if (start > 0) {
+		const gchar *prev = g_utf8_find_prev_char (folded->text, folded->text + start);
+
+		if (g_unichar_isalnum (g_utf8_get_char (prev)))
+			return FALSE;
+	}
+
+	return end >= folded->len || !g_unichar_isalnum (g_utf8_get_char (folded->text + end));
+}
+
+/**
+ * ev_folded_text_find: (skip)
+ * @folded: an #EvFoldedText
+ * @query: the text to look for, not folded
+ * @whole_words: whether only matches of whole words are found
+ * @areas: (allow-none): the text layout of the page @folded was folded
+ *   from, an area per character, or %NULL to only count the matches
+ * @n_areas: the number of areas
+ * @rects: (element-type EvRectangle) (allow-none): array the rectangles
+ *   of the matches are appended to, in order
+ * @matches: (element-type guint) (allow-none): array the index of the
+ *   match of every rectangle appended to @rects is appended to
+ *
+ * Looks for @query, folded with the flags of @folded, in @folded.
+ * Matches don't overlap.
+ *
+ * Returns: the number of matches
+ *
+ * Since: 3.30
+ */
+guint
+ev_folded_text_find (EvFoldedText *folded,
+		     const gchar  *query,
+		     gboolean      whole_words,
+		     EvRectangle  *areas,
+		     guint         n_areas,
+		     GArray       *rects,
+		     GArray       *matches)
+{
+	const gchar *p;
+	gchar       *needle;
+	gsize        n;
+	gsize        pos = 0;
+	guint        n_matches = 0;
+
+	g_return_val_if_fail (folded != NULL, 0);
+	g_return_val_if_fail (query != NULL, 0);
+	g_return_val_if_fail (!areas || (rects && matches), 0);
+
+	needle = ev_fold_text (query, folded->flags);
+	n = strlen (needle);
+	if (n == 0) {
+		g_free (needle);
+		return 0;
+	}
+
+	while ((p = ev_folded_text_search (folded->text + pos, folded->len - pos, needle, n))) {
+		gsize start = p - folded->text;
+		gsize end = start + n;
+
+		/* The first byte of needle only matches at the start
+		 * of a character, so the next one can be tried */
+		if (whole_words && !ev_folded_text_is_word_boundary (folded, start, end)) {
+			pos = start + 1;
+			continue;
+		}
+
+		if (areas) {
+			guint first = folded->offsets[start];
+			guint last = folded->offsets[end - 1] + 1;
+
+			if (first >= n_areas)
+				break;
+
+			ev_text_layout_add_match_rectangles (areas, first, MIN (last, n_areas),
+							     n_matches, rects, matches);
+		}
+		n_matches++;
+		pos = end;
+	}
+	g_free (needle);
+
+	return n_matches;
+}
+
+/**
+ * ev_text_layout_add_match_rectangles: (skip)
+ * @areas: a text layout, an area per character
+ * @start: the first character of the match
+ * @end: the character after the match
+ * @match: the index of the match
+ * @rects: (element-type EvRectangle): array the rectangles are appended to
+ * @matches: (element-type guint): array @match is appended to for
+ *   every rectangle appended to @rects
+ *
+ * Adds a rectangle for every line the characters from @start to @end
+ * span, like backends do for the matches they find.
+ *
+ * Since: 3.30
+ */
+void
+ev_text_layout_add_match_rectangles (EvRectangle *areas,
+				     guint        start,
+				     guint        end,
+				     guint        match,
+				     GArray      *rects,
+				     GArray      *matches)
+{
+	EvRectangle rect;
+	gboolean    has_rect = FALSE;
+	guint       i;
+
+	for (i = start; i < end; i++) {
+		EvRectangle *area = areas + i;
+
+		if (has_rect &&
+		    (area->y1 >= rect.y2 || area->y2 <= rect.y1 || area->x2 < rect.x1)) {
+			g_array_append_val (rects, rect);
+			g_array_append_val (matches, match);
+			has_rect = FALSE;
+		}
+
+		if (!has_rect) {
+			rect = *area;
+			has_rect = TRUE;
+			continue;
+		}
+
+		rect.x1 = MIN (rect.x1, area->x1);
+		rect.y1 = MIN (rect.y1, area->y1);
+		rect.x2 = MAX (rect.x2, area->x2);
+		rect.y2 = MAX (rect.y2, area->y2);
+	}
+
+	if (has_rect) {
+		g_array_append_val (rects, rect);
+		g_array_append_val (matches, match);
+	}
+}
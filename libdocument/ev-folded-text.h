@@ -0,0 +1,64 @@
+/* ev-folded-text.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_DOCUMENT_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-document.h> can be included directly."
+#endif
+
+#ifndef EV_FOLDED_TEXT_H
+#define EV_FOLDED_TEXT_H
+
+#include <glib.h>
+
+#include "ev-document.h"
+
+G_BEGIN_DECLS
+
+typedef struct _EvFoldedText EvFoldedText;
+
+typedef enum {
+	EV_FOLD_NONE       = 0,
+	EV_FOLD_CASE       = 1 << 0,
+	EV_FOLD_DIACRITICS = 1 << 1
+} EvFoldFlags;
+
+EvFoldedText *ev_folded_text_new                  (const gchar  *text,
+						   EvFoldFlags   flags);
+void          ev_folded_text_free                 (EvFoldedText *folded);
+const gchar  *ev_folded_text_get_text             (EvFoldedText *folded);
+EvFoldFlags   ev_folded_text_get_flags            (EvFoldedText *folded);
+guint         ev_folded_text_find                 (EvFoldedText *folded,
+						   const gchar  *query,
+						   gboolean      whole_words,
+						   EvRectangle  *areas,
+						   guint         n_areas,
+						   GArray       *rects,
+						   GArray       *matches);
+
+gchar        *ev_fold_text                        (const gchar  *text,
+						   EvFoldFlags   flags);
+void          ev_text_layout_add_match_rectangles (EvRectangle  *areas,
+						   guint         start,
+						   guint         end,
+						   guint         match,
+						   GArray       *rects,
+						   GArray       *matches);
+
+G_END_DECLS
+
+#endif /* EV_FOLDED_TEXT_H */
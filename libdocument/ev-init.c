@@ -27,6 +27,7 @@
 
 #include "ev-init.h"
 #include "ev-document-factory.h"
+#include "ev-document.h"
 #include "ev-debug.h"
 #include "ev-file-helpers.h"
 
@@ -117,6 +118,7 @@ ev_init (void)
         _ev_debug_init ();
         _ev_file_helpers_init ();
         have_backends = _ev_document_factory_init ();
+        _ev_document_warm_up_fontconfig ();
 
         return have_backends;
 }
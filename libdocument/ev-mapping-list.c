@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <math.h>
+
 #include "ev-mapping-list.h"
 
 /**
@@ -26,15 +28,76 @@
  *
  * Since: 3.8
  */
+
+/* Lists with fewer mappings are searched linearly */
+#define GRID_MIN_MAPPINGS 32
+#define GRID_MAX_SIZE     64
+
+/* Mappings are also kept in an array, in list order, and for hit
+ * testing, in a uniform grid over their bounding box. Every cell has
+ * the indices of the mappings overlapping it, packed in a single
+ * array, so that a point query only checks the mappings of its cell.
+ * Mappings spanning a large part of the grid, like page-sized form
+ * fields, are checked for every query instead of being added to most
+ * of the cells.
+ */
+typedef struct {
+	EvRectangle bounds;
+	guint       n_columns;
+	guint       n_rows;
+	gdouble     cell_width;
+	gdouble     cell_height;
+	guint      *cell_offsets; /* n_columns * n_rows + 1 offsets into items */
+	guint      *items;
+	GArray     *large;        /* Indices of the mappings in every cell */
+} EvMappingGrid;
+
+/* Mappings added, removed or moved after the list is created only
+ * mark the array and the grid stale, they are rebuilt on the next
+ * query, so that editing annotations doesn't index the page every
+ * time. The links of the list are indexed by data, on first use, to
+ * find and remove mappings without walking the list.
+ */
 struct _EvMappingList {
 	guint          page;
 	GList         *list;
+	GList         *last;
+	GHashTable    *links;
+	guint          n_repeated; /* Mappings sharing data with a previous one */
+	GPtrArray     *mappings;
+	EvMappingGrid *grid;
+	gboolean       stale;
 	GDestroyNotify data_destroy_func;
 	volatile gint  ref_count;
 };
 
 G_DEFINE_BOXED_TYPE (EvMappingList, ev_mapping_list, ev_mapping_list_ref, ev_mapping_list_unref)
 
+static void ev_mapping_list_update_index (EvMappingList *mapping_list);
+
+static GList *
+ev_mapping_list_find_link (EvMappingList *mapping_list,
+			   gconstpointer  data)
+{
+	GList *list;
+
+	if (!mapping_list->links) {
+		mapping_list->links = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+		mapping_list->n_repeated = 0;
+		for (list = mapping_list->list; list; list = list->next) {
+			EvMapping *mapping = list->data;
+
+			if (g_hash_table_contains (mapping_list->links, mapping->data))
+				mapping_list->n_repeated++;
+			else
+				g_hash_table_insert (mapping_list->links, mapping->data, list);
+		}
+	}
+
+	return g_hash_table_lookup (mapping_list->links, data);
+}
+
 /**
  * ev_mapping_list_find:
  * @mapping_list: an #EvMappingList
@@ -46,16 +109,13 @@ EvMapping *
 ev_mapping_list_find (EvMappingList *mapping_list,
 		      gconstpointer  data)
 {
-	GList *list;
+	GList *link;
 
-	for (list = mapping_list->list; list; list = list->next) {
-		EvMapping *mapping = list->data;
+	g_return_val_if_fail (mapping_list != NULL, NULL);
 
-		if (mapping->data == data)
-			return mapping;
-	}
+	link = ev_mapping_list_find_link (mapping_list, data);
 
-	return NULL;
+	return link ? link->data : NULL;
 }
 
 /**
@@ -96,7 +156,11 @@ ev_mapping_list_nth (EvMappingList *mapping_list,
 {
         g_return_val_if_fail (mapping_list != NULL, NULL);
 
-        return (EvMapping *)g_list_nth_data (mapping_list->list, n);
+        ev_mapping_list_update_index (mapping_list);
+        if (n >= mapping_list->mappings->len)
+                return NULL;
+
+        return g_ptr_array_index (mapping_list->mappings, n);
 }
 
 static gdouble
@@ -106,6 +170,200 @@ get_mapping_area_size (EvMapping *mapping)
 	       (mapping->area.y2 - mapping->area.y1);
 }
 
+static void
+ev_mapping_grid_free (EvMappingGrid *grid)
+{
+	if (!grid)
+		return;
+
+	g_free (grid->cell_offsets);
+	g_free (grid->items);
+	g_array_free (grid->large, TRUE);
+	g_slice_free (EvMappingGrid, grid);
+}
+
+static guint
+ev_mapping_grid_column (EvMappingGrid *grid,
+			gdouble        x)
+{
+	gint column = (gint) floor ((x - grid->bounds.x1) / grid->cell_width);
+
+	return CLAMP (column, 0, (gint) grid->n_columns - 1);
+}
+
+static guint
+ev_mapping_grid_row (EvMappingGrid *grid,
+		     gdouble        y)
+{
+	gint row = (gint) floor ((y - grid->bounds.y1) / grid->cell_height);
+
+	return CLAMP (row, 0, (gint) grid->n_rows - 1);
+}
+
+static gboolean
+ev_mapping_grid_get_cells (EvMappingGrid *grid,
+			   EvMapping     *mapping,
+			   guint         *column1,
+			   guint         *row1,
+			   guint         *column2,
+			   guint         *row2)
+{
+	/* Such areas never contain a point */
+	if (mapping->area.x1 > mapping->area.x2 || mapping->area.y1 > mapping->area.y2)
+		return FALSE;
+
+	*column1 = ev_mapping_grid_column (grid, mapping->area.x1);
+	*column2 = ev_mapping_grid_column (grid, mapping->area.x2);
+	*row1 = ev_mapping_grid_row (grid, mapping->area.y1);
+	*row2 = ev_mapping_grid_row (grid, mapping->area.y2);
+
+	return TRUE;
+}
+
+static EvMappingGrid *
+ev_mapping_grid_new (GPtrArray *mappings)
+{
+	EvMappingGrid *grid;
+	guint          n_cells, size, i;
+	guint         *counts;
+	gboolean      *large;
+
+	if (mappings->len < GRID_MIN_MAPPINGS)
+		return NULL;
+
+	grid = g_slice_new0 (EvMappingGrid);
+	grid->large = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	for (i = 0; i < mappings->len; i++) {
+		EvMapping *mapping = g_ptr_array_index (mappings, i);
+
+		if (i == 0) {
+			grid->bounds = mapping->area;
+			continue;
+		}
+		grid->bounds.x1 = MIN (grid->bounds.x1, mapping->area.x1);
+		grid->bounds.y1 = MIN (grid->bounds.y1, mapping->area.y1);
+		grid->bounds.x2 = MAX (grid->bounds.x2, mapping->area.x2);
+		grid->bounds.y2 = MAX (grid->bounds.y2, mapping->area.y2);
+	}
+
+	/* About one mapping per cell */
+	size = CLAMP ((guint) sqrt (mappings->len), 1, GRID_MAX_SIZE);
+	grid->n_columns = grid->n_rows = size;
+	grid->cell_width = MAX (grid->bounds.x2 - grid->bounds.x1, G_MINDOUBLE) / size;
+	grid->cell_height = MAX (grid->bounds.y2 - grid->bounds.y1, G_MINDOUBLE) / size;
+	n_cells = size * size;
+
+	/* Count the mappings of every cell first, then pack them */
+	counts = g_new0 (guint, n_cells + 1);
+	large = g_new0 (gboolean, mappings->len);
+	for (i = 0; i < mappings->len; i++) {
+		guint column, row, column1, row1, column2, row2;
+
+		if (!ev_mapping_grid_get_cells (grid, g_ptr_array_index (mappings, i),
+						&column1, &row1, &column2, &row2))
+			continue;
+
+		if ((column2 - column1 + 1) * (row2 - row1 + 1) > n_cells / 4) {
+			large[i] = TRUE;
+			g_array_append_val (grid->large, i);
+			continue;
+		}
+
+		for (row = row1; row <= row2; row++) {
+			for (column = column1; column <= column2; column++)
+				counts[row * size + column + 1]++;
+		}
+	}
+
+	grid->cell_offsets = counts;
+	for (i = 1; i <= n_cells; i++)
+		grid->cell_offsets[i] += grid->cell_offsets[i - 1];
+	grid->items = g_new (guint, MAX (grid->cell_offsets[n_cells], 1));
+
+	/* Mappings are added in list order, so that ties are solved
+	 * like when the list is searched */
+	counts = g_new0 (guint, n_cells);
+	for (i = 0; i < mappings->len; i++) {
+		guint column, row, column1, row1, column2, row2;
+
+		if (large[i] ||
+		    !ev_mapping_grid_get_cells (grid, g_ptr_array_index (mappings, i),
+						&column1, &row1, &column2, &row2))
+			continue;
+
+		for (row = row1; row <= row2; row++) {
+			for (column = column1; column <= column2; column++) {
+				guint cell = row * size + column;
+
+				grid->items[grid->cell_offsets[cell] + counts[cell]++] = i;
+			}
+		}
+	}
+	g_free (counts);
+	g_free (large);
+
+	return grid;
+}
+
+static void
+ev_mapping_list_update_index (EvMappingList *mapping_list)
+{
+	GList *l;
+
+	if (!mapping_list->stale)
+		return;
+
+	g_ptr_array_set_size (mapping_list->mappings, 0);
+	for (l = mapping_list->list; l; l = g_list_next (l))
+		g_ptr_array_add (mapping_list->mappings, l->data);
+	ev_mapping_grid_free (mapping_list->grid);
+	mapping_list->grid = ev_mapping_grid_new (mapping_list->mappings);
+	mapping_list->stale = FALSE;
+}
+
+static gboolean
+mapping_contains (EvMapping *mapping,
+		  gdouble    x,
+		  gdouble    y)
+{
+	return (x >= mapping->area.x1) &&
+	       (y >= mapping->area.y1) &&
+	       (x <= mapping->area.x2) &&
+	       (y <= mapping->area.y2);
+}
+
+/* In case of only one match choose that. Otherwise compare the area
+ * of the bounding boxes and return the smallest element, the first one
+ * in the list if several have the same size. In this way we allow most
+ * of the elements to be selectable by the user.
+ */
+static void
+update_found (GPtrArray *mappings,
+	      guint      index,
+	      gdouble    x,
+	      gdouble    y,
+	      gint      *found)
+{
+	EvMapping *mapping = g_ptr_array_index (mappings, index);
+	EvMapping *current;
+	gdouble    size, current_size;
+
+	if (!mapping_contains (mapping, x, y))
+		return;
+
+	if (*found == -1) {
+		*found = index;
+		return;
+	}
+
+	current = g_ptr_array_index (mappings, *found);
+	size = get_mapping_area_size (mapping);
+	current_size = get_mapping_area_size (current);
+	if (size < current_size || (size == current_size && (gint) index < *found))
+		*found = index;
+}
+
 /**
  * ev_mapping_list_get:
  * @mapping_list: an #EvMappingList
@@ -121,30 +379,29 @@ ev_mapping_list_get (EvMappingList *mapping_list,
 		     gdouble        x,
 		     gdouble        y)
 {
-	GList *list;
-	EvMapping *found = NULL;
+	EvMappingGrid *grid;
+	gint           found = -1;
+	guint          i;
 
 	g_return_val_if_fail (mapping_list != NULL, NULL);
-	
-	for (list = mapping_list->list; list; list = list->next) {
-		EvMapping *mapping = list->data;
 
-		if ((x >= mapping->area.x1) &&
-		    (y >= mapping->area.y1) &&
-		    (x <= mapping->area.x2) &&
-		    (y <= mapping->area.y2)) {
-
-			/* In case of only one match choose that. Otherwise
-			 * compare the area of the bounding boxes and return the
-			 * smallest element.
-			 * In this way we allow most of the elements to be selectable
-			 * by the user */
-			if(!found || (get_mapping_area_size(mapping) < get_mapping_area_size(found)))
-				found = mapping;
-		}
+	ev_mapping_list_update_index (mapping_list);
+	grid = mapping_list->grid;
+	if (!grid) {
+		for (i = 0; i < mapping_list->mappings->len; i++)
+			update_found (mapping_list->mappings, i, x, y, &found);
+	} else if (x >= grid->bounds.x1 && x <= grid->bounds.x2 &&
+		   y >= grid->bounds.y1 && y <= grid->bounds.y2) {
+		guint cell;
+
+		cell = ev_mapping_grid_row (grid, y) * grid->n_columns + ev_mapping_grid_column (grid, x);
+		for (i = grid->cell_offsets[cell]; i < grid->cell_offsets[cell + 1]; i++)
+			update_found (mapping_list->mappings, grid->items[i], x, y, &found);
+		for (i = 0; i < grid->large->len; i++)
+			update_found (mapping_list->mappings, g_array_index (grid->large, guint, i), x, y, &found);
 	}
 
-	return found;
+	return found != -1 ? g_ptr_array_index (mapping_list->mappings, found) : NULL;
 }
 
 /**
@@ -192,11 +449,95 @@ void
 ev_mapping_list_remove (EvMappingList *mapping_list,
 			EvMapping     *mapping)
 {
-	mapping_list->list = g_list_remove (mapping_list->list, mapping);
+	GList *link;
+
+	g_return_if_fail (mapping_list != NULL);
+	g_return_if_fail (mapping != NULL);
+
+	link = ev_mapping_list_find_link (mapping_list, mapping->data);
+	if (!link || link->data != mapping)
+		link = g_list_find (mapping_list->list, mapping);
+	if (!link)
+		return;
+
+	if (g_hash_table_lookup (mapping_list->links, mapping->data) == link) {
+		g_hash_table_remove (mapping_list->links, mapping->data);
+		/* Another mapping with the same data becomes the first
+		 * one, index the list again on next use */
+		if (G_UNLIKELY (mapping_list->n_repeated > 0)) {
+			g_hash_table_destroy (mapping_list->links);
+			mapping_list->links = NULL;
+		}
+	} else {
+		mapping_list->n_repeated--;
+	}
+
+	if (link == mapping_list->last)
+		mapping_list->last = link->prev;
+	mapping_list->list = g_list_delete_link (mapping_list->list, link);
+	mapping_list->stale = TRUE;
+
         mapping_list->data_destroy_func (mapping->data);
         g_free (mapping);
 }
 
+/**
+ * ev_mapping_list_add:
+ * @mapping_list: an #EvMappingList
+ * @mapping: (transfer full): #EvMapping to add
+ *
+ * Adds @mapping at the end of @mapping_list, which takes ownership of
+ * it and of its data.
+ *
+ * Since: 3.30
+ */
+void
+ev_mapping_list_add (EvMappingList *mapping_list,
+		     EvMapping     *mapping)
+{
+	GList *link;
+
+	g_return_if_fail (mapping_list != NULL);
+	g_return_if_fail (mapping != NULL);
+
+	link = g_list_alloc ();
+	link->data = mapping;
+	link->prev = mapping_list->last;
+	link->next = NULL;
+	if (mapping_list->last)
+		mapping_list->last->next = link;
+	else
+		mapping_list->list = link;
+	mapping_list->last = link;
+
+	if (mapping_list->links) {
+		if (g_hash_table_contains (mapping_list->links, mapping->data))
+			mapping_list->n_repeated++;
+		else
+			g_hash_table_insert (mapping_list->links, mapping->data, link);
+	}
+	mapping_list->stale = TRUE;
+}
+
+/**
+ * ev_mapping_list_update:
+ * @mapping_list: an #EvMappingList
+ * @mapping: an #EvMapping of @mapping_list
+ *
+ * Notifies @mapping_list that the area of @mapping has changed, so
+ * that it's found at its new position.
+ *
+ * Since: 3.30
+ */
+void
+ev_mapping_list_update (EvMappingList *mapping_list,
+			EvMapping     *mapping)
+{
+	g_return_if_fail (mapping_list != NULL);
+
+	mapping_list->stale = TRUE;
+}
+
 guint
 ev_mapping_list_get_page (EvMappingList *mapping_list)
 {
@@ -208,7 +549,9 @@ ev_mapping_list_length (EvMappingList *mapping_list)
 {
         g_return_val_if_fail (mapping_list != NULL, 0);
 
-        return g_list_length (mapping_list->list);
+        ev_mapping_list_update_index (mapping_list);
+
+        return mapping_list->mappings->len;
 }
 
 /**
@@ -217,6 +560,10 @@ ev_mapping_list_length (EvMappingList *mapping_list)
  * @list: (element-type EvMapping): a #GList of data for the page
  * @data_destroy_func: function to free a list element
  *
+ * Creates a mapping list for @page. The areas of the mappings are
+ * indexed for hit testing, when one of them changes the list must be
+ * notified with ev_mapping_list_update().
+ *
  * Returns: an #EvMappingList
  */
 EvMappingList *
@@ -225,12 +572,21 @@ ev_mapping_list_new (guint          page,
 		     GDestroyNotify data_destroy_func)
 {
 	EvMappingList *mapping_list;
+	GList         *l;
 
 	g_return_val_if_fail (data_destroy_func != NULL, NULL);
 
 	mapping_list = g_slice_new (EvMappingList);
 	mapping_list->page = page;
 	mapping_list->list = list;
+	mapping_list->last = g_list_last (list);
+	mapping_list->links = NULL;
+	mapping_list->n_repeated = 0;
+	mapping_list->stale = FALSE;
+	mapping_list->mappings = g_ptr_array_sized_new (g_list_length (list));
+	for (l = list; l; l = g_list_next (l))
+		g_ptr_array_add (mapping_list->mappings, l->data);
+	mapping_list->grid = ev_mapping_grid_new (mapping_list->mappings);
 	mapping_list->data_destroy_func = data_destroy_func;
 	mapping_list->ref_count = 1;
 
@@ -267,6 +623,10 @@ ev_mapping_list_unref (EvMappingList *mapping_list)
 				(GFunc)mapping_list_free_foreach,
 				mapping_list->data_destroy_func);
 		g_list_free (mapping_list->list);
+		if (mapping_list->links)
+			g_hash_table_destroy (mapping_list->links);
+		g_ptr_array_free (mapping_list->mappings, TRUE);
+		ev_mapping_grid_free (mapping_list->grid);
 		g_slice_free (EvMappingList, mapping_list);
 	}
 }
@@ -25,6 +25,11 @@ struct _EvMediaPrivate {
         guint    page;
         gchar   *uri;
         gboolean show_controls;
+
+        /* Embedded media are written by save_func, never by uri */
+        EvMediaSaveFunc save_func;
+        gpointer        save_data;
+        GDestroyNotify  save_data_destroy;
 };
 
 G_DEFINE_TYPE (EvMedia, ev_media, G_TYPE_OBJECT)
@@ -35,6 +40,9 @@ ev_media_finalize (GObject *object)
         EvMedia *media = EV_MEDIA (object);
 
         g_clear_pointer (&media->priv->uri, g_free);
+        if (media->priv->save_data_destroy)
+                media->priv->save_data_destroy (media->priv->save_data);
+        media->priv->save_data = NULL;
 
         G_OBJECT_CLASS (ev_media_parent_class)->finalize (object);
 }
@@ -71,6 +79,93 @@ ev_media_new_for_uri (EvPage      *page,
         return media;
 }
 
+/**
+ * ev_media_new_with_save_func:
+ * @page: the #EvPage of the media
+ * @save_func: (scope notified): the function that writes the contents
+ * @user_data: data to pass to @save_func
+ * @destroy_func: function to free @user_data when the media is
+ *   destroyed, or %NULL
+ *
+ * Creates a media embedded in the document, that has no URI. Its
+ * contents are only read when it's played, written by @save_func
+ * from the document to where the player reads them.
+ *
+ * Returns: (transfer full): a new #EvMedia
+ *
+ * Since: 3.30
+ */
+EvMedia *
+ev_media_new_with_save_func (EvPage         *page,
+                             EvMediaSaveFunc save_func,
+                             gpointer        user_data,
+                             GDestroyNotify  destroy_func)
+{
+        EvMedia *media;
+
+        g_return_val_if_fail (EV_IS_PAGE (page), NULL);
+        g_return_val_if_fail (save_func != NULL, NULL);
+
+        media = EV_MEDIA (g_object_new (EV_TYPE_MEDIA, NULL));
+        media->priv->page = page->index;
+        media->priv->save_func = save_func;
+        media->priv->save_data = user_data;
+        media->priv->save_data_destroy = destroy_func;
+
+        return media;
+}
+
+/**
+ * ev_media_save_to_stream:
+ * @media: an #EvMedia
+ * @stream: a #GOutputStream
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the contents of @media to @stream, without closing it. Media
+ * that are not embedded are read from their URI.
+ *
+ * Returns: %TRUE on success, %FALSE setting @error otherwise
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_media_save_to_stream (EvMedia       *media,
+                         GOutputStream *stream,
+                         GError       **error)
+{
+        GFile            *file;
+        GFileInputStream *input;
+        gssize            n_bytes;
+
+        g_return_val_if_fail (EV_IS_MEDIA (media), FALSE);
+        g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+
+        if (media->priv->save_func)
+                return media->priv->save_func (media, stream,
+                                               media->priv->save_data,
+                                               error);
+
+        file = g_file_new_for_uri (media->priv->uri);
+        input = g_file_read (file, NULL, error);
+        g_object_unref (file);
+        if (!input)
+                return FALSE;
+
+        n_bytes = g_output_stream_splice (stream, G_INPUT_STREAM (input),
+                                          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+                                          NULL, error);
+        g_object_unref (input);
+
+        return n_bytes != -1;
+}
+
+/**
+ * ev_media_get_uri:
+ * @media: an #EvMedia
+ *
+ * Returns: (allow-none): the URI of @media, or %NULL for media embedded
+ *   in the document, see ev_media_save_to_stream()
+ */
 const gchar *
 ev_media_get_uri (EvMedia *media)
 {
@@ -25,6 +25,7 @@
 #define __EV_MEDIA_H__
 
 #include <glib-object.h>
+#include <gio/gio.h>
 #include "ev-page.h"
 
 G_BEGIN_DECLS
@@ -50,10 +51,36 @@ struct _EvMediaClass {
         GObjectClass base_class;
 };
 
+/**
+ * EvMediaSaveFunc:
+ * @media: an #EvMedia
+ * @stream: the #GOutputStream to write the contents of @media to
+ * @user_data: the data passed to ev_media_new_with_save_func()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the contents of @media to @stream. It's called from a thread,
+ * and @stream may block until what was written is played.
+ *
+ * Returns: %TRUE on success, %FALSE setting @error otherwise
+ *
+ * Since: 3.30
+ */
+typedef gboolean (* EvMediaSaveFunc) (EvMedia       *media,
+                                      GOutputStream *stream,
+                                      gpointer       user_data,
+                                      GError       **error);
+
 GType        ev_media_get_type          (void) G_GNUC_CONST;
 
-EvMedia     *ev_media_new_for_uri       (EvPage      *page,
-                                         const gchar *uri);
+EvMedia     *ev_media_new_for_uri       (EvPage         *page,
+                                         const gchar    *uri);
+EvMedia     *ev_media_new_with_save_func (EvPage         *page,
+                                          EvMediaSaveFunc save_func,
+                                          gpointer        user_data,
+                                          GDestroyNotify  destroy_func);
+gboolean     ev_media_save_to_stream    (EvMedia        *media,
+                                         GOutputStream  *stream,
+                                         GError        **error);
 const gchar *ev_media_get_uri           (EvMedia     *media);
 guint        ev_media_get_page_index    (EvMedia     *media);
 gboolean     ev_media_get_show_controls (EvMedia     *media);
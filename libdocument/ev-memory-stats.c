@@ -0,0 +1,166 @@
+/* ev-memory-stats.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-memory-stats.h"
+
+/* The caches register a function reporting their memory, that is only
+ * called when the statistics are asked for, so keeping them costs
+ * nothing while rendering. The functions are called with stats_mutex
+ * held, so that unregistering waits for them to return, registering
+ * must not be done while holding a lock the functions take.
+ */
+typedef struct {
+	gchar             *subsystem;
+	EvMemoryStatsFunc  func;
+	gpointer           user_data;
+} EvMemoryStatsEntry;
+
+static GMutex  stats_mutex;
+static GSList *entries = NULL;
+
+/**
+ * ev_memory_stats_register:
+ * @subsystem: the name of the subsystem
+ * @func: (scope notified): the function reporting the memory used
+ * @user_data: data to pass to @func
+ *
+ * Registers @func to report the memory used by @subsystem, for
+ * ev_memory_stats_get(). A subsystem can be registered several times,
+ * with different @user_data, for example once per instance of a cache,
+ * and its values are the sum of all the registrations.
+ *
+ * @func is called from the thread calling ev_memory_stats_get().
+ *
+ * Since: 3.30
+ */
+void
+ev_memory_stats_register (const gchar       *subsystem,
+			  EvMemoryStatsFunc  func,
+			  gpointer           user_data)
+{
+	EvMemoryStatsEntry *entry;
+
+	g_return_if_fail (subsystem != NULL);
+	g_return_if_fail (func != NULL);
+
+	entry = g_slice_new (EvMemoryStatsEntry);
+	entry->subsystem = g_strdup (subsystem);
+	entry->func = func;
+	entry->user_data = user_data;
+
+	g_mutex_lock (&stats_mutex);
+	entries = g_slist_prepend (entries, entry);
+	g_mutex_unlock (&stats_mutex);
+}
+
+/**
+ * ev_memory_stats_unregister:
+ * @subsystem: the name of the subsystem
+ * @user_data: the data passed to ev_memory_stats_register()
+ *
+ * Removes the registration of @subsystem with @user_data. Once it
+ * returns the function of the registration is no longer called.
+ *
+ * Since: 3.30
+ */
+void
+ev_memory_stats_unregister (const gchar *subsystem,
+			    gpointer     user_data)
+{
+	GSList *l;
+
+	g_return_if_fail (subsystem != NULL);
+
+	g_mutex_lock (&stats_mutex);
+
+	for (l = entries; l; l = g_slist_next (l)) {
+		EvMemoryStatsEntry *entry = l->data;
+
+		if (entry->user_data == user_data &&
+		    strcmp (entry->subsystem, subsystem) == 0) {
+			entries = g_slist_delete_link (entries, l);
+			g_free (entry->subsystem);
+			g_slice_free (EvMemoryStatsEntry, entry);
+			break;
+		}
+	}
+
+	g_mutex_unlock (&stats_mutex);
+}
+
+/**
+ * ev_memory_stats_get:
+ *
+ * Asks every registered subsystem for the memory it uses.
+ *
+ * Returns: (transfer full): a floating #GVariant of type a{s(tu)},
+ *   with the bytes and the number of entries of each subsystem
+ *
+ * Since: 3.30
+ */
+GVariant *
+ev_memory_stats_get (void)
+{
+	GVariantBuilder builder;
+	GHashTable     *subsystems;
+	GHashTableIter  iter;
+	gpointer        key, value;
+	GSList         *l;
+
+	/* Subsystem -> the two guint64 of bytes and entries */
+	subsystems = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+	g_mutex_lock (&stats_mutex);
+
+	for (l = entries; l; l = g_slist_next (l)) {
+		EvMemoryStatsEntry *entry = l->data;
+		guint64            *totals;
+		guint64             bytes = 0;
+		guint               n_entries = 0;
+
+		entry->func (entry->user_data, &bytes, &n_entries);
+
+		totals = g_hash_table_lookup (subsystems, entry->subsystem);
+		if (!totals) {
+			totals = g_new0 (guint64, 2);
+			g_hash_table_insert (subsystems, entry->subsystem, totals);
+		}
+		totals[0] += bytes;
+		totals[1] += n_entries;
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(tu)}"));
+
+	g_hash_table_iter_init (&iter, subsystems);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		guint64 *totals = value;
+
+		g_variant_builder_add (&builder, "{s(tu)}", (const gchar *) key,
+				       totals[0], (guint32) totals[1]);
+	}
+
+	g_mutex_unlock (&stats_mutex);
+
+	g_hash_table_destroy (subsystems);
+
+	return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,52 @@
+/* ev-memory-stats.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_DOCUMENT_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-document.h> can be included directly."
+#endif
+
+#ifndef EV_MEMORY_STATS_H
+#define EV_MEMORY_STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EvMemoryStatsFunc:
+ * @user_data: the data passed to ev_memory_stats_register()
+ * @bytes: (inout): the bytes used by the subsystem
+ * @n_entries: (inout): the number of entries of the subsystem
+ *
+ * Adds the memory used by a subsystem to @bytes and @n_entries, that
+ * accumulate the values of all the registrations of the subsystem.
+ */
+typedef void (* EvMemoryStatsFunc) (gpointer  user_data,
+				    guint64  *bytes,
+				    guint    *n_entries);
+
+void      ev_memory_stats_register   (const gchar       *subsystem,
+				      EvMemoryStatsFunc  func,
+				      gpointer           user_data);
+void      ev_memory_stats_unregister (const gchar       *subsystem,
+				      gpointer           user_data);
+GVariant *ev_memory_stats_get        (void);
+
+G_END_DECLS
+
+#endif /* EV_MEMORY_STATS_H */
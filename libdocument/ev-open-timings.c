@@ -0,0 +1,124 @@
+/* ev-open-timings.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-open-timings.h"
+
+/* The phases are marked from the main thread and from the job threads,
+ * so they are protected by timings_mutex. Only the first time a phase
+ * is reached is recorded, the timings are those of opening the first
+ * document.
+ */
+typedef struct {
+	gchar  *phase;
+	gint64  time;
+} EvOpenTiming;
+
+static GMutex    timings_mutex;
+static GArray   *timings = NULL;
+static gboolean  log_timings = FALSE;
+
+static void
+ev_open_timings_init_unlocked (void)
+{
+	if (timings)
+		return;
+
+	timings = g_array_new (FALSE, FALSE, sizeof (EvOpenTiming));
+	log_timings = g_getenv ("EV_OPEN_TIMINGS") != NULL;
+}
+
+/**
+ * ev_open_timings_mark:
+ * @phase: the name of the phase reached
+ *
+ * Records the time at which @phase of opening a document is reached,
+ * unless it was already reached before. When the EV_OPEN_TIMINGS
+ * environment variable is set, it's also printed to stderr, as the
+ * time elapsed since the first phase recorded.
+ *
+ * Since: 3.30
+ */
+void
+ev_open_timings_mark (const gchar *phase)
+{
+	EvOpenTiming timing;
+	gint64       now = g_get_monotonic_time ();
+	guint        i;
+
+	g_return_if_fail (phase != NULL);
+
+	g_mutex_lock (&timings_mutex);
+	ev_open_timings_init_unlocked ();
+
+	for (i = 0; i < timings->len; i++) {
+		if (strcmp (g_array_index (timings, EvOpenTiming, i).phase, phase) == 0) {
+			g_mutex_unlock (&timings_mutex);
+			return;
+		}
+	}
+
+	timing.phase = g_strdup (phase);
+	timing.time = now;
+	g_array_append_val (timings, timing);
+
+	if (log_timings) {
+		gint64 start = g_array_index (timings, EvOpenTiming, 0).time;
+
+		g_printerr ("[ %s ] %.3f ms\n", phase, (now - start) / 1000.);
+	}
+
+	g_mutex_unlock (&timings_mutex);
+}
+
+/**
+ * ev_open_timings_get:
+ *
+ * Returns the phases recorded with ev_open_timings_mark(), in the
+ * order they were reached, with the time elapsed since the first
+ * one, in microseconds.
+ *
+ * Returns: (transfer full): a floating #GVariant of type a{sx}
+ *
+ * Since: 3.30
+ */
+GVariant *
+ev_open_timings_get (void)
+{
+	GVariantBuilder builder;
+	guint           i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sx}"));
+
+	g_mutex_lock (&timings_mutex);
+	ev_open_timings_init_unlocked ();
+
+	for (i = 0; i < timings->len; i++) {
+		EvOpenTiming *timing = &g_array_index (timings, EvOpenTiming, i);
+
+		g_variant_builder_add (&builder, "{sx}", timing->phase,
+				       timing->time - g_array_index (timings, EvOpenTiming, 0).time);
+	}
+
+	g_mutex_unlock (&timings_mutex);
+
+	return g_variant_builder_end (&builder);
+}
@@ -41,6 +41,8 @@ ev_render_context_dispose (GObject *object)
 		rc->page = NULL;
 	}
 
+	g_clear_object (&rc->cancellable);
+
 	(* G_OBJECT_CLASS (ev_render_context_parent_class)->dispose) (object);
 }
 
@@ -113,6 +115,176 @@ ev_render_context_set_target_size (EvRenderContext *rc,
 	rc->target_height = target_height;
 }
 
+/**
+ * ev_render_context_set_area:
+ * @rc: an #EvRenderContext
+ * @area: (allow-none): the area of the page to render, or %NULL
+ *
+ * Restricts rendering to @area, given in device pixels of the scaled
+ * and rotated page. The rendered surface then has the size of @area.
+ * Passing %NULL renders the whole page again.
+ *
+ * Since: 3.30
+ */
+void
+ev_render_context_set_area (EvRenderContext             *rc,
+			    const cairo_rectangle_int_t *area)
+{
+	g_return_if_fail (rc != NULL);
+
+	if (area) {
+		rc->area = *area;
+	} else {
+		rc->area.x = rc->area.y = 0;
+		rc->area.width = rc->area.height = 0;
+	}
+}
+
+/**
+ * ev_render_context_get_area:
+ * @rc: an #EvRenderContext
+ * @area: (out) (allow-none): return location for the area
+ *
+ * Returns: %TRUE if rendering is restricted to an area of the page
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_render_context_get_area (EvRenderContext       *rc,
+			    cairo_rectangle_int_t *area)
+{
+	g_return_val_if_fail (rc != NULL, FALSE);
+
+	if (rc->area.width <= 0 || rc->area.height <= 0)
+		return FALSE;
+
+	if (area)
+		*area = rc->area;
+
+	return TRUE;
+}
+
+/**
+ * ev_render_context_set_cancellable:
+ * @rc: an #EvRenderContext
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ *
+ * Sets the #GCancellable backends check while rendering @rc, so that
+ * a cancelled render stops as soon as possible instead of running to
+ * completion. A cancelled render returns %NULL.
+ *
+ * Since: 3.30
+ */
+void
+ev_render_context_set_cancellable (EvRenderContext *rc,
+				   GCancellable    *cancellable)
+{
+	g_return_if_fail (rc != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	if (cancellable)
+		g_object_ref (cancellable);
+	if (rc->cancellable)
+		g_object_unref (rc->cancellable);
+	rc->cancellable = cancellable;
+}
+
+/**
+ * ev_render_context_is_cancelled:
+ * @rc: an #EvRenderContext
+ *
+ * Backends call this between rendering steps to find out whether
+ * they should give up.
+ *
+ * Returns: %TRUE if the render of @rc has been cancelled
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_render_context_is_cancelled (EvRenderContext *rc)
+{
+	g_return_val_if_fail (rc != NULL, FALSE);
+
+	return rc->cancellable && g_cancellable_is_cancelled (rc->cancellable);
+}
+
+/**
+ * ev_render_context_set_draft:
+ * @rc: an #EvRenderContext
+ * @draft: whether to render a draft
+ *
+ * Asks backends to render @rc as fast as they can rather than as well
+ * as they can, for small renders like thumbnails: with less or no
+ * antialiasing, cheaper scaling, and without annotations and form
+ * fields. Backends without a cheaper way to render ignore it.
+ *
+ * Since: 3.30
+ */
+void
+ev_render_context_set_draft (EvRenderContext *rc,
+			     gboolean         draft)
+{
+	g_return_if_fail (rc != NULL);
+
+	rc->draft = draft != FALSE;
+}
+
+/**
+ * ev_render_context_get_draft:
+ * @rc: an #EvRenderContext
+ *
+ * Returns: %TRUE if @rc should be rendered as a draft
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_render_context_get_draft (EvRenderContext *rc)
+{
+	g_return_val_if_fail (rc != NULL, FALSE);
+
+	return rc->draft;
+}
+
+/**
+ * ev_render_context_set_layer:
+ * @rc: an #EvRenderContext
+ * @layer: the #EvRenderLayer to render
+ *
+ * Asks backends that can render layers, see
+ * ev_document_can_render_layers(), for a part of the page only.
+ * %EV_RENDER_LAYER_CONTENT leaves the annotations and form fields out.
+ * %EV_RENDER_LAYER_ANNOTATIONS gives a surface that is transparent but
+ * for the areas of the annotations and form fields, where it is what
+ * %EV_RENDER_LAYER_ALL would give, or %NULL when the page has none.
+ * Drawn over the content, it gives the whole page.
+ *
+ * Since: 3.30
+ */
+void
+ev_render_context_set_layer (EvRenderContext *rc,
+			     EvRenderLayer    layer)
+{
+	g_return_if_fail (rc != NULL);
+
+	rc->layer = layer;
+}
+
+/**
+ * ev_render_context_get_layer:
+ * @rc: an #EvRenderContext
+ *
+ * Returns: the #EvRenderLayer of the page to render
+ *
+ * Since: 3.30
+ */
+EvRenderLayer
+ev_render_context_get_layer (EvRenderContext *rc)
+{
+	g_return_val_if_fail (rc != NULL, EV_RENDER_LAYER_ALL);
+
+	return rc->layer;
+}
+
 void
 ev_render_context_compute_scaled_size (EvRenderContext *rc,
 				       double		width_points,
@@ -25,6 +25,8 @@
 #define EV_RENDER_CONTEXT_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
+#include <cairo.h>
 
 #include "ev-page.h"
 
@@ -33,6 +35,13 @@ G_BEGIN_DECLS
 typedef struct _EvRenderContext EvRenderContext;
 typedef struct _EvRenderContextClass EvRenderContextClass;
 
+typedef enum
+{
+        EV_RENDER_LAYER_ALL,
+        EV_RENDER_LAYER_CONTENT,
+        EV_RENDER_LAYER_ANNOTATIONS
+} EvRenderLayer;
+
 #define EV_TYPE_RENDER_CONTEXT		(ev_render_context_get_type())
 #define EV_RENDER_CONTEXT(object)	(G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_RENDER_CONTEXT, EvRenderContext))
 #define EV_RENDER_CONTEXT_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_RENDER_CONTEXT, EvRenderContextClass))
@@ -52,6 +61,19 @@ struct _EvRenderContext
 	gdouble scale;
 	gint	target_width;
 	gint	target_height;
+
+	/* Area of the transformed page to render, in device pixels.
+	 * An empty area means the whole page. */
+	cairo_rectangle_int_t area;
+
+	/* Backends stop rendering early when this is cancelled */
+	GCancellable *cancellable;
+
+	/* Quality can be traded for speed, see ev_render_context_set_draft() */
+	gboolean draft;
+
+	/* Part of the page to render, see ev_render_context_set_layer() */
+	EvRenderLayer layer;
 };
 
 
@@ -68,6 +90,19 @@ void             ev_render_context_set_scale       (EvRenderContext *rc,
 void             ev_render_context_set_target_size (EvRenderContext *rc,
                                                     int              target_width,
                                                     int              target_height);
+void             ev_render_context_set_area        (EvRenderContext *rc,
+						    const cairo_rectangle_int_t *area);
+gboolean         ev_render_context_get_area        (EvRenderContext *rc,
+						    cairo_rectangle_int_t *area);
+void             ev_render_context_set_cancellable (EvRenderContext *rc,
+						    GCancellable    *cancellable);
+gboolean         ev_render_context_is_cancelled    (EvRenderContext *rc);
+void             ev_render_context_set_draft       (EvRenderContext *rc,
+						    gboolean         draft);
+gboolean         ev_render_context_get_draft       (EvRenderContext *rc);
+void             ev_render_context_set_layer       (EvRenderContext *rc,
+						    EvRenderLayer    layer);
+EvRenderLayer    ev_render_context_get_layer       (EvRenderContext *rc);
 void             ev_render_context_compute_scaled_size      (EvRenderContext *rc,
                                                              double           width_points,
                                                              double           height_points,
@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include "ev-debug.h"
 #include "ev-selection.h"
 
 G_DEFINE_INTERFACE (EvSelection, ev_selection, 0)
@@ -40,15 +41,18 @@ ev_selection_render_selection (EvSelection      *selection,
 			       GdkColor         *base)
 {
 	EvSelectionInterface *iface = EV_SELECTION_GET_IFACE (selection);
+	gint64                trace;
 
 	if (!iface->render_selection)
 		return;
-	
+
+	trace = ev_trace_begin ();
 	iface->render_selection (selection, rc,
 				 surface,
 				 points, old_points,
 				 style,
 				 text, base);
+	ev_trace_end (trace, "selection", "render-selection", rc->page->index);
 }
 
 gchar *
@@ -69,9 +73,15 @@ ev_selection_get_selection_region (EvSelection     *selection,
 				   EvRectangle     *points)
 {
 	EvSelectionInterface *iface = EV_SELECTION_GET_IFACE (selection);
+	cairo_region_t       *region;
+	gint64                trace;
 
 	if (!iface->get_selection_region)
 		return NULL;
-	
-	return iface->get_selection_region (selection, rc, style, points);
+
+	trace = ev_trace_begin ();
+	region = iface->get_selection_region (selection, rc, style, points);
+	ev_trace_end (trace, "selection", "get-selection-region", rc->page->index);
+
+	return region;
 }
@@ -0,0 +1,321 @@
+/* ev-surface-pool.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-memory-stats.h"
+#include "ev-surface-pool.h"
+
+/* Pool size used when EV_SURFACE_POOL is not set, in megabytes */
+#define EV_SURFACE_POOL_DEFAULT_LIMIT 64
+
+/* Surfaces are created by backends in the render threads and recycled
+ * from the main thread, so the pool is protected by pool_mutex. Free
+ * surfaces are kept in a bucket per format and size, and in a global
+ * list to drop the least recently recycled ones first.
+ */
+typedef struct {
+	cairo_format_t format;
+	gint           width;
+	gint           height;
+} EvSurfacePoolKey;
+
+static GMutex      pool_mutex;
+static GHashTable *buckets = NULL; /* EvSurfacePoolKey -> GQueue of surfaces */
+static GQueue      lru = G_QUEUE_INIT; /* Most recently recycled first */
+static gsize       pool_usage = 0;
+static gsize       pool_limit = 0;
+
+/* Marks the surfaces created by the pool, the only ones it takes back */
+static const cairo_user_data_key_t pool_key;
+
+static guint
+ev_surface_pool_key_hash (gconstpointer data)
+{
+	const EvSurfacePoolKey *key = data;
+
+	return (key->width * 33 + key->height) * 33 + key->format;
+}
+
+static gboolean
+ev_surface_pool_key_equal (gconstpointer a,
+			   gconstpointer b)
+{
+	const EvSurfacePoolKey *key_a = a;
+	const EvSurfacePoolKey *key_b = b;
+
+	return key_a->format == key_b->format &&
+		key_a->width == key_b->width &&
+		key_a->height == key_b->height;
+}
+
+static void
+ev_surface_pool_key_free (gpointer data)
+{
+	g_slice_free (EvSurfacePoolKey, data);
+}
+
+static void
+ev_surface_pool_bucket_free (gpointer data)
+{
+	g_queue_free ((GQueue *)data);
+}
+
+static void
+ev_surface_pool_init_unlocked (void)
+{
+	const gchar *env;
+	gint64       megabytes = EV_SURFACE_POOL_DEFAULT_LIMIT;
+
+	if (buckets)
+		return;
+
+	buckets = g_hash_table_new_full (ev_surface_pool_key_hash,
+					 ev_surface_pool_key_equal,
+					 ev_surface_pool_key_free,
+					 ev_surface_pool_bucket_free);
+
+	env = g_getenv ("EV_SURFACE_POOL");
+	if (env) {
+		gint64 value = g_ascii_strtoll (env, NULL, 10);
+
+		if (value >= 0)
+			megabytes = value;
+	}
+
+	pool_limit = (gsize) megabytes * 1024 * 1024;
+}
+
+static gsize
+surface_size (cairo_surface_t *surface)
+{
+	return (gsize) cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+}
+
+static void
+ev_surface_pool_get_memory_stats (gpointer  user_data,
+				  guint64  *bytes,
+				  guint    *n_entries)
+{
+	g_mutex_lock (&pool_mutex);
+	*bytes += pool_usage;
+	*n_entries += g_queue_get_length (&lru);
+	g_mutex_unlock (&pool_mutex);
+}
+
+static GQueue *
+ev_surface_pool_lookup_bucket_unlocked (cairo_format_t format,
+					gint           width,
+					gint           height)
+{
+	EvSurfacePoolKey key;
+
+	key.format = format;
+	key.width = width;
+	key.height = height;
+
+	return g_hash_table_lookup (buckets, &key);
+}
+
+/* Returns the surfaces to destroy, outside of the lock */
+static GList *
+ev_surface_pool_trim_unlocked (void)
+{
+	GList *evicted = NULL;
+
+	while (pool_usage > pool_limit && !g_queue_is_empty (&lru)) {
+		cairo_surface_t *surface = g_queue_pop_tail (&lru);
+		GQueue          *bucket;
+
+		bucket = ev_surface_pool_lookup_bucket_unlocked (cairo_image_surface_get_format (surface),
+								 cairo_image_surface_get_width (surface),
+								 cairo_image_surface_get_height (surface));
+		g_queue_remove (bucket, surface);
+		pool_usage -= surface_size (surface);
+		evicted = g_list_prepend (evicted, surface);
+	}
+
+	return evicted;
+}
+
+/**
+ * ev_surface_pool_create_surface:
+ * @format: the format of the surface
+ * @width: the width of the surface
+ * @height: the height of the surface
+ *
+ * Creates an image surface like cairo_image_surface_create(), cleared,
+ * reusing the memory of a surface given back with
+ * ev_surface_pool_recycle() when there is one with the same format and
+ * size. Backends should use it for the surfaces they render pages to.
+ *
+ * Returns: (transfer full): a new image surface
+ *
+ * Since: 3.30
+ */
+cairo_surface_t *
+ev_surface_pool_create_surface (cairo_format_t format,
+				gint           width,
+				gint           height)
+{
+	static gsize     stats_registered = 0;
+	cairo_surface_t *surface = NULL;
+	GQueue          *bucket;
+
+	/* Outside of pool_mutex, that the stats function takes */
+	if (g_once_init_enter (&stats_registered)) {
+		ev_memory_stats_register ("surface-pool", ev_surface_pool_get_memory_stats, NULL);
+		g_once_init_leave (&stats_registered, 1);
+	}
+
+	g_mutex_lock (&pool_mutex);
+	ev_surface_pool_init_unlocked ();
+	bucket = ev_surface_pool_lookup_bucket_unlocked (format, width, height);
+	if (bucket && !g_queue_is_empty (bucket)) {
+		surface = g_queue_pop_head (bucket);
+		g_queue_remove (&lru, surface);
+		pool_usage -= surface_size (surface);
+	}
+	g_mutex_unlock (&pool_mutex);
+
+	if (surface) {
+		cairo_surface_flush (surface);
+		memset (cairo_image_surface_get_data (surface), 0, surface_size (surface));
+		cairo_surface_mark_dirty (surface);
+
+		return surface;
+	}
+
+	surface = cairo_image_surface_create (format, width, height);
+	if (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS)
+		cairo_surface_set_user_data (surface, &pool_key, GINT_TO_POINTER (1), NULL);
+
+	return surface;
+}
+
+/**
+ * ev_surface_pool_recycle:
+ * @surface: (transfer full): a cairo surface
+ *
+ * Drops the caller's reference to @surface. If @surface was created
+ * by ev_surface_pool_create_surface() and this was its last reference,
+ * it's kept to be reused by a later render instead of being freed.
+ * The pool holds up to 64 megabytes by default, which can be changed
+ * with the EV_SURFACE_POOL environment variable, in megabytes.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_pool_recycle (cairo_surface_t *surface)
+{
+	GQueue           *bucket;
+	GList            *evicted;
+	EvSurfacePoolKey *key;
+	cairo_format_t    format;
+	gint              width, height;
+
+	if (!surface)
+		return;
+
+	if (!cairo_surface_get_user_data (surface, &pool_key) ||
+	    cairo_surface_get_reference_count (surface) != 1) {
+		cairo_surface_destroy (surface);
+		return;
+	}
+
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_set_device_scale (surface, 1, 1);
+#endif
+	cairo_surface_set_device_offset (surface, 0, 0);
+
+	format = cairo_image_surface_get_format (surface);
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+
+	g_mutex_lock (&pool_mutex);
+	ev_surface_pool_init_unlocked ();
+	if (surface_size (surface) > pool_limit) {
+		g_mutex_unlock (&pool_mutex);
+		cairo_surface_destroy (surface);
+		return;
+	}
+
+	bucket = ev_surface_pool_lookup_bucket_unlocked (format, width, height);
+	if (!bucket) {
+		key = g_slice_new (EvSurfacePoolKey);
+		key->format = format;
+		key->width = width;
+		key->height = height;
+		bucket = g_queue_new ();
+		g_hash_table_insert (buckets, key, bucket);
+	}
+	g_queue_push_head (bucket, surface);
+	g_queue_push_head (&lru, surface);
+	pool_usage += surface_size (surface);
+	evicted = ev_surface_pool_trim_unlocked ();
+	g_mutex_unlock (&pool_mutex);
+
+	g_list_free_full (evicted, (GDestroyNotify) cairo_surface_destroy);
+}
+
+/**
+ * ev_surface_pool_get_limit:
+ *
+ * Returns: the maximum size in bytes of the surfaces kept for reuse
+ *
+ * Since: 3.30
+ */
+gsize
+ev_surface_pool_get_limit (void)
+{
+	gsize retval;
+
+	g_mutex_lock (&pool_mutex);
+	ev_surface_pool_init_unlocked ();
+	retval = pool_limit;
+	g_mutex_unlock (&pool_mutex);
+
+	return retval;
+}
+
+/**
+ * ev_surface_pool_set_limit:
+ * @limit: the new limit in bytes
+ *
+ * Sets the maximum size of the surfaces kept for reuse, freeing
+ * surfaces right away if the pool is above it. A limit of 0 disables
+ * the pool.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_pool_set_limit (gsize limit)
+{
+	GList *evicted;
+
+	g_mutex_lock (&pool_mutex);
+	ev_surface_pool_init_unlocked ();
+	pool_limit = limit;
+	evicted = ev_surface_pool_trim_unlocked ();
+	g_mutex_unlock (&pool_mutex);
+
+	g_list_free_full (evicted, (GDestroyNotify) cairo_surface_destroy);
+}
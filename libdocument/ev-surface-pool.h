@@ -0,0 +1,40 @@
+/* ev-surface-pool.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_DOCUMENT_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-document.h> can be included directly."
+#endif
+
+#ifndef EV_SURFACE_POOL_H
+#define EV_SURFACE_POOL_H
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+cairo_surface_t *ev_surface_pool_create_surface (cairo_format_t   format,
+						 gint             width,
+						 gint             height);
+void             ev_surface_pool_recycle        (cairo_surface_t *surface);
+gsize            ev_surface_pool_get_limit      (void);
+void             ev_surface_pool_set_limit      (gsize            limit);
+
+G_END_DECLS
+
+#endif /* EV_SURFACE_POOL_H */
@@ -0,0 +1,1018 @@
+/* ev-synctex-index.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "ev-synctex-index.h"
+#include "synctex_parser.h"
+
+/* The synctex file of a large document takes seconds to parse and its
+ * node tree takes hundreds of megabytes, so it's only parsed once, into
+ * this index, saved in the user cache. The index keeps, for every page,
+ * the boxes where backward searches look for the clicked point, and the
+ * nodes of every box, merged when they come from the same source
+ * position. Forward searches use the nodes sorted by source line.
+ *
+ * When the document is compiled again, the pages whose synctex records
+ * didn't change are taken from the previous index, and only the others
+ * are parsed, see ev_synctex_index_update().
+ */
+
+#define EV_SYNCTEX_INDEX_VERSION           2
+#define EV_SYNCTEX_INDEX_FORMAT            "(uttitata(is)a(uiiidddd)a(uuiiiddd))"
+#define EV_SYNCTEX_INDEX_PERSIST_MIN_SIZE  (256 * 1024)
+#define EV_SYNCTEX_NO_BOX                  G_MAXUINT32
+
+/* The layouts match the GVariant serialization of the index arrays */
+typedef struct {
+	guint32 page;
+	gint32  tag;
+	gint32  line;
+	gint32  column;
+	gdouble x1;
+	gdouble y1;
+	gdouble x2;
+	gdouble y2;
+} EvSynctexBox;
+
+typedef struct {
+	guint32 page;
+	guint32 box;
+	gint32  tag;
+	gint32  line;
+	gint32  column;
+	gdouble x1;
+	gdouble x2;
+	gdouble y;
+} EvSynctexNode;
+
+struct _EvSynctexIndex {
+	gint        n_pages;
+	GHashTable *names;      /* Tag to input file name */
+	GArray     *boxes;      /* Sorted by page */
+	GArray     *nodes;      /* Sorted by page */
+	guint      *page_boxes; /* First box of every page, and the end */
+	guint      *page_nodes;
+	guint      *lines;      /* Nodes sorted by tag, line and page */
+
+	/* Hashes of the synctex records, NULL if unknown */
+	guint64     header_hash;
+	guint64    *page_hashes;
+};
+
+static EvSynctexIndex *
+ev_synctex_index_alloc (gint n_pages)
+{
+	EvSynctexIndex *index;
+
+	index = g_slice_new0 (EvSynctexIndex);
+	index->n_pages = n_pages;
+	index->names = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	index->boxes = g_array_new (FALSE, FALSE, sizeof (EvSynctexBox));
+	index->nodes = g_array_new (FALSE, FALSE, sizeof (EvSynctexNode));
+
+	return index;
+}
+
+void
+ev_synctex_index_free (EvSynctexIndex *index)
+{
+	g_hash_table_destroy (index->names);
+	g_array_free (index->boxes, TRUE);
+	g_array_free (index->nodes, TRUE);
+	g_free (index->page_boxes);
+	g_free (index->page_nodes);
+	g_free (index->lines);
+	g_free (index->page_hashes);
+	g_slice_free (EvSynctexIndex, index);
+}
+
+/* Returns the synctex file of the document @output, if any */
+gchar *
+ev_synctex_index_find_file (const gchar *output)
+{
+	synctex_scanner_t scanner;
+	gchar            *retval;
+
+	/* This only opens the file, it's not parsed */
+	scanner = synctex_scanner_new_with_output_file (output, NULL, 0);
+	if (!scanner)
+		return NULL;
+
+	retval = g_strdup (synctex_scanner_get_synctex (scanner));
+	synctex_scanner_free (scanner);
+
+	return retval;
+}
+
+static gchar *
+ev_synctex_index_get_cache_path (const gchar *synctex)
+{
+	gchar *checksum;
+	gchar *filename;
+	gchar *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, synctex, -1);
+	filename = g_strconcat (checksum, ".index", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "evince", "synctex", filename, NULL);
+	g_free (filename);
+	g_free (checksum);
+
+	return path;
+}
+
+static gboolean
+ev_synctex_index_get_file_stamp (const gchar *synctex,
+				 guint64     *mtime,
+				 guint64     *size)
+{
+	GStatBuf statbuf;
+
+	if (g_stat (synctex, &statbuf) != 0)
+		return FALSE;
+
+	*mtime = statbuf.st_mtime;
+	*size = statbuf.st_size;
+
+	return TRUE;
+}
+
+static gint
+compare_lines (gconstpointer a,
+	       gconstpointer b,
+	       gpointer      user_data)
+{
+	EvSynctexIndex      *index = user_data;
+	const EvSynctexNode *node_a = &g_array_index (index->nodes, EvSynctexNode, *(const guint *) a);
+	const EvSynctexNode *node_b = &g_array_index (index->nodes, EvSynctexNode, *(const guint *) b);
+
+	if (node_a->tag != node_b->tag)
+		return node_a->tag < node_b->tag ? -1 : 1;
+	if (node_a->line != node_b->line)
+		return node_a->line < node_b->line ? -1 : 1;
+	if (node_a->page != node_b->page)
+		return node_a->page < node_b->page ? -1 : 1;
+
+	return *(const guint *) a < *(const guint *) b ? -1 : *(const guint *) a > *(const guint *) b;
+}
+
+/* Builds the page ranges and the line index, once the boxes and the
+ * nodes are there. They are checked, since they may come from the cache.
+ */
+static gboolean
+ev_synctex_index_finish (EvSynctexIndex *index)
+{
+	guint page;
+	guint i;
+
+	index->page_boxes = g_new0 (guint, index->n_pages + 1);
+	index->page_nodes = g_new0 (guint, index->n_pages + 1);
+
+	for (i = 0, page = 0; i < index->boxes->len; i++) {
+		EvSynctexBox *box = &g_array_index (index->boxes, EvSynctexBox, i);
+
+		if (box->page >= (guint) index->n_pages || box->page < page)
+			return FALSE;
+		while (page < box->page)
+			index->page_boxes[++page] = i;
+	}
+	while (page < (guint) index->n_pages)
+		index->page_boxes[++page] = index->boxes->len;
+
+	for (i = 0, page = 0; i < index->nodes->len; i++) {
+		EvSynctexNode *node = &g_array_index (index->nodes, EvSynctexNode, i);
+
+		if (node->page >= (guint) index->n_pages || node->page < page ||
+		    node->box >= index->boxes->len)
+			return FALSE;
+		while (page < node->page)
+			index->page_nodes[++page] = i;
+	}
+	while (page < (guint) index->n_pages)
+		index->page_nodes[++page] = index->nodes->len;
+
+	index->lines = g_new (guint, index->nodes->len);
+	for (i = 0; i < index->nodes->len; i++)
+		index->lines[i] = i;
+	g_qsort_with_data (index->lines, index->nodes->len, sizeof (guint),
+			   compare_lines, index);
+
+	return TRUE;
+}
+
+static void
+ev_synctex_index_add_node (EvSynctexIndex *index,
+			   guint           page,
+			   guint           box,
+			   synctex_node_t  node,
+			   gdouble         x1,
+			   gdouble         x2)
+{
+	EvSynctexNode  new_node;
+	gint           tag = synctex_node_tag (node);
+	gint           line = synctex_node_line (node);
+	gint           column = synctex_node_column (node);
+	gdouble        y = synctex_node_visible_v (node);
+
+	if (box == EV_SYNCTEX_NO_BOX || tag <= 0 || line <= 0)
+		return;
+
+	if (index->nodes->len > 0) {
+		EvSynctexNode *last;
+
+		last = &g_array_index (index->nodes, EvSynctexNode, index->nodes->len - 1);
+		if (last->box == box && last->tag == tag && last->line == line &&
+		    last->column == column && last->y == y) {
+			last->x1 = MIN (last->x1, x1);
+			last->x2 = MAX (last->x2, x2);
+			return;
+		}
+	}
+
+	new_node.page = page;
+	new_node.box = box;
+	new_node.tag = tag;
+	new_node.line = line;
+	new_node.column = column;
+	new_node.x1 = x1;
+	new_node.x2 = x2;
+	new_node.y = y;
+	g_array_append_val (index->nodes, new_node);
+}
+
+static void
+ev_synctex_index_add_nodes (EvSynctexIndex *index,
+			    guint           page,
+			    guint           parent,
+			    synctex_node_t  node)
+{
+	for (; node; node = synctex_node_sibling (node)) {
+		EvSynctexBox box;
+		gdouble      x;
+
+		switch (synctex_node_type (node)) {
+		case synctex_node_type_vbox:
+		case synctex_node_type_hbox:
+			box.page = page;
+			box.tag = synctex_node_tag (node);
+			box.line = synctex_node_line (node);
+			box.column = synctex_node_column (node);
+			box.x1 = synctex_node_box_visible_h (node);
+			box.x2 = box.x1 + synctex_node_box_visible_width (node);
+			box.y1 = synctex_node_box_visible_v (node) - synctex_node_box_visible_height (node);
+			box.y2 = synctex_node_box_visible_v (node) + synctex_node_box_visible_depth (node);
+			if (box.x1 > box.x2) {
+				x = box.x1;
+				box.x1 = box.x2;
+				box.x2 = x;
+			}
+			if (box.y1 > box.y2) {
+				x = box.y1;
+				box.y1 = box.y2;
+				box.y2 = x;
+			}
+			g_array_append_val (index->boxes, box);
+
+			ev_synctex_index_add_node (index, page, parent, node, box.x1, box.x2);
+			ev_synctex_index_add_nodes (index, page, index->boxes->len - 1,
+						    synctex_node_child (node));
+			break;
+		case synctex_node_type_void_vbox:
+		case synctex_node_type_void_hbox:
+		case synctex_node_type_kern:
+		case synctex_node_type_glue:
+		case synctex_node_type_math:
+		case synctex_node_type_boundary:
+			x = synctex_node_visible_h (node);
+			ev_synctex_index_add_node (index, page, parent, node,
+						   MIN (x, x + synctex_node_visible_width (node)),
+						   MAX (x, x + synctex_node_visible_width (node)));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static EvSynctexIndex *
+ev_synctex_index_new_from_scanner (synctex_scanner_t scanner,
+				   gint              n_pages)
+{
+	EvSynctexIndex *index;
+	synctex_node_t  input;
+	gint            page;
+
+	index = ev_synctex_index_alloc (n_pages);
+
+	for (input = synctex_scanner_input (scanner); input; input = synctex_node_sibling (input)) {
+		gint         tag = synctex_node_tag (input);
+		const gchar *name = synctex_scanner_get_name (scanner, tag);
+
+		if (name)
+			g_hash_table_insert (index->names, GINT_TO_POINTER (tag), g_strdup (name));
+	}
+
+	/* Synctex pages start at 1 */
+	for (page = 0; page < n_pages; page++) {
+		ev_synctex_index_add_nodes (index, page, EV_SYNCTEX_NO_BOX,
+					    synctex_sheet_content (scanner, page + 1));
+	}
+
+	if (!ev_synctex_index_finish (index)) {
+		ev_synctex_index_free (index);
+		return NULL;
+	}
+
+	return index;
+}
+
+/* Loads the saved index of @synctex. With @n_pages -1 it's loaded even
+ * if it's out of date, to update it.
+ */
+static EvSynctexIndex *
+ev_synctex_index_load (const gchar *synctex,
+		       gint         n_pages)
+{
+	EvSynctexIndex *index;
+	GVariant       *variant;
+	GVariant       *hashes, *names, *boxes, *nodes;
+	GVariantIter    iter;
+	GBytes         *bytes;
+	gchar          *path;
+	gchar          *contents;
+	const gchar    *name;
+	gconstpointer   data;
+	gsize           length, n_items;
+	guint64         mtime, size;
+	guint64         saved_mtime, saved_size, header_hash;
+	guint32         version;
+	gint32          saved_n_pages, tag;
+	gboolean        valid;
+
+	if (!ev_synctex_index_get_file_stamp (synctex, &mtime, &size))
+		return NULL;
+
+	path = ev_synctex_index_get_cache_path (synctex);
+	if (!g_file_get_contents (path, &contents, &length, NULL)) {
+		g_free (path);
+		return NULL;
+	}
+	g_free (path);
+
+	bytes = g_bytes_new_take (contents, length);
+	variant = g_variant_new_from_bytes (G_VARIANT_TYPE (EV_SYNCTEX_INDEX_FORMAT), bytes, FALSE);
+	g_bytes_unref (bytes);
+
+	g_variant_get (variant, "(utti@at@a(is)@a(uiiidddd)@a(uuiiiddd))",
+		       &version, &saved_mtime, &saved_size, &saved_n_pages,
+		       &header_hash, &hashes, &names, &boxes, &nodes);
+	if (n_pages == -1) {
+		valid = version == EV_SYNCTEX_INDEX_VERSION && saved_n_pages >= 0;
+		n_pages = saved_n_pages;
+	} else {
+		valid = version == EV_SYNCTEX_INDEX_VERSION &&
+			saved_mtime == mtime && saved_size == size &&
+			saved_n_pages == n_pages;
+	}
+
+	index = NULL;
+	if (valid) {
+		index = ev_synctex_index_alloc (n_pages);
+
+		index->header_hash = header_hash;
+		data = g_variant_get_fixed_array (hashes, &n_items, sizeof (guint64));
+		if (n_items == (gsize) n_pages)
+			index->page_hashes = g_memdup (data, n_pages * sizeof (guint64));
+
+		g_variant_iter_init (&iter, names);
+		while (g_variant_iter_next (&iter, "(i&s)", &tag, &name))
+			g_hash_table_insert (index->names, GINT_TO_POINTER (tag), g_strdup (name));
+
+		data = g_variant_get_fixed_array (boxes, &n_items, sizeof (EvSynctexBox));
+		g_array_append_vals (index->boxes, data, n_items);
+		data = g_variant_get_fixed_array (nodes, &n_items, sizeof (EvSynctexNode));
+		g_array_append_vals (index->nodes, data, n_items);
+
+		if (!ev_synctex_index_finish (index))
+			g_clear_pointer (&index, ev_synctex_index_free);
+	}
+
+	g_variant_unref (hashes);
+	g_variant_unref (names);
+	g_variant_unref (boxes);
+	g_variant_unref (nodes);
+	g_variant_unref (variant);
+
+	return index;
+}
+
+static void
+ev_synctex_index_save (EvSynctexIndex *index,
+		       const gchar    *synctex)
+{
+	GVariantBuilder names;
+	GHashTableIter  iter;
+	GVariant       *variant;
+	gpointer        tag, name;
+	guint64         mtime, size;
+	gchar          *path;
+	gchar          *dir;
+
+	if (!ev_synctex_index_get_file_stamp (synctex, &mtime, &size) ||
+	    size < EV_SYNCTEX_INDEX_PERSIST_MIN_SIZE)
+		return;
+
+	g_variant_builder_init (&names, G_VARIANT_TYPE ("a(is)"));
+	g_hash_table_iter_init (&iter, index->names);
+	while (g_hash_table_iter_next (&iter, &tag, &name))
+		g_variant_builder_add (&names, "(is)", GPOINTER_TO_INT (tag), (const gchar *) name);
+
+	variant = g_variant_new ("(utti@at@a(is)@a(uiiidddd)@a(uuiiiddd))",
+				 EV_SYNCTEX_INDEX_VERSION, mtime, size, index->n_pages,
+				 index->header_hash,
+				 g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+							    index->page_hashes,
+							    index->page_hashes ? index->n_pages : 0,
+							    sizeof (guint64)),
+				 g_variant_builder_end (&names),
+				 g_variant_new_fixed_array (G_VARIANT_TYPE ("(uiiidddd)"),
+							    index->boxes->data, index->boxes->len,
+							    sizeof (EvSynctexBox)),
+				 g_variant_new_fixed_array (G_VARIANT_TYPE ("(uuiiiddd)"),
+							    index->nodes->data, index->nodes->len,
+							    sizeof (EvSynctexNode)));
+	g_variant_ref_sink (variant);
+
+	path = ev_synctex_index_get_cache_path (synctex);
+	dir = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dir, 0700) == 0)
+		g_file_set_contents (path, g_variant_get_data (variant),
+				     g_variant_get_size (variant), NULL);
+
+	g_free (dir);
+	g_free (path);
+	g_variant_unref (variant);
+}
+
+#define FNV_OFFSET_BASIS G_GUINT64_CONSTANT (14695981039346656037)
+#define FNV_PRIME        G_GUINT64_CONSTANT (1099511628211)
+
+static guint64
+hash_line (guint64      hash,
+	   const gchar *line,
+	   gsize        length)
+{
+	gsize i;
+
+	for (i = 0; i < length; i++) {
+		hash ^= (guchar) line[i];
+		hash *= FNV_PRIME;
+	}
+	hash ^= '\n';
+	hash *= FNV_PRIME;
+
+	return hash;
+}
+
+static gboolean
+ev_synctex_index_can_reuse_page (EvSynctexIndex *base,
+				 gint            page,
+				 guint64         hash)
+{
+	return base && base->page_hashes &&
+		page >= 0 && page < base->n_pages &&
+		base->page_hashes[page] == hash;
+}
+
+static gboolean
+write_line (GOutputStream *stream,
+	    const gchar   *line,
+	    gsize          length)
+{
+	return g_output_stream_write_all (stream, line, length, NULL, NULL, NULL) &&
+		g_output_stream_write_all (stream, "\n", 1, NULL, NULL, NULL);
+}
+
+/* Reads the records of @synctex, hashing every sheet and the rest of the
+ * file apart from the input names, the anchors and the record count,
+ * which change whenever any sheet does. When @changed is given, it gets
+ * a copy of the file without the sheets that can be taken from @base.
+ */
+static gboolean
+ev_synctex_index_scan (const gchar    *synctex,
+		       EvSynctexIndex *index,
+		       EvSynctexIndex *base,
+		       GOutputStream  *changed)
+{
+	GFile            *file;
+	GInputStream     *stream;
+	GDataInputStream *data;
+	GString          *sheet = NULL;
+	gchar            *line;
+	gsize             length;
+	gint              page = -1;
+	guint64           hash = FNV_OFFSET_BASIS;
+	gboolean          retval = TRUE;
+	GError           *error = NULL;
+
+	file = g_file_new_for_path (synctex);
+	stream = G_INPUT_STREAM (g_file_read (file, NULL, NULL));
+	g_object_unref (file);
+	if (!stream)
+		return FALSE;
+
+	if (g_str_has_suffix (synctex, ".gz")) {
+		GConverter   *decompressor;
+		GInputStream *compressed = stream;
+
+		decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+		stream = g_converter_input_stream_new (compressed, decompressor);
+		g_object_unref (decompressor);
+		g_object_unref (compressed);
+	}
+
+	data = g_data_input_stream_new (stream);
+	g_object_unref (stream);
+
+	index->header_hash = FNV_OFFSET_BASIS;
+	index->page_hashes = g_new (guint64, index->n_pages);
+	for (page = 0; page < index->n_pages; page++)
+		index->page_hashes[page] = FNV_OFFSET_BASIS;
+
+	while (retval && (line = g_data_input_stream_read_line (data, &length, NULL, &error))) {
+		if (sheet) {
+			if (line[0] != '!') {
+				hash = hash_line (hash, line, length);
+				g_string_append_len (sheet, line, length);
+				g_string_append_c (sheet, '\n');
+			}
+
+			if (line[0] == '}') {
+				if (page >= 0 && page < index->n_pages)
+					index->page_hashes[page] = hash;
+				if (changed && !ev_synctex_index_can_reuse_page (base, page, hash))
+					retval = g_output_stream_write_all (changed, sheet->str, sheet->len,
+									    NULL, NULL, NULL);
+				g_string_free (sheet, TRUE);
+				sheet = NULL;
+			}
+		} else if (line[0] == '{') {
+			/* Synctex pages start at 1 */
+			page = g_ascii_strtoll (line + 1, NULL, 10) - 1;
+			hash = hash_line (FNV_OFFSET_BASIS, line, length);
+			sheet = g_string_new_len (line, length);
+			g_string_append_c (sheet, '\n');
+		} else {
+			if (g_str_has_prefix (line, "Input:")) {
+				gchar *name;
+				gint   tag;
+
+				tag = g_ascii_strtoll (line + strlen ("Input:"), &name, 10);
+				if (*name == ':')
+					g_hash_table_insert (index->names, GINT_TO_POINTER (tag),
+							     g_strdup (name + 1));
+			} else if (line[0] != '!' && !g_str_has_prefix (line, "Count:")) {
+				index->header_hash = hash_line (index->header_hash, line, length);
+			}
+
+			if (changed)
+				retval = write_line (changed, line, length);
+		}
+		g_free (line);
+	}
+
+	if (error) {
+		retval = FALSE;
+		g_error_free (error);
+	}
+	if (sheet)
+		g_string_free (sheet, TRUE);
+	g_object_unref (data);
+
+	return retval;
+}
+
+/* Pages can only be reused if the rest of the file, where the units and
+ * offsets are, didn't change, and if their input tags still name the
+ * same files.
+ */
+static gboolean
+ev_synctex_index_is_compatible (EvSynctexIndex *index,
+				EvSynctexIndex *base)
+{
+	GHashTableIter iter;
+	gpointer       tag, name;
+
+	if (!base->page_hashes || base->header_hash != index->header_hash)
+		return FALSE;
+
+	g_hash_table_iter_init (&iter, index->names);
+	while (g_hash_table_iter_next (&iter, &tag, &name)) {
+		const gchar *base_name = g_hash_table_lookup (base->names, tag);
+
+		if (base_name && strcmp (base_name, name) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+ev_synctex_index_copy_page (EvSynctexIndex *index,
+			    EvSynctexIndex *source,
+			    gint            page)
+{
+	guint first_box = source->page_boxes[page];
+	guint offset = index->boxes->len;
+	guint i;
+
+	g_array_append_vals (index->boxes,
+			     &g_array_index (source->boxes, EvSynctexBox, first_box),
+			     source->page_boxes[page + 1] - first_box);
+
+	for (i = source->page_nodes[page]; i < source->page_nodes[page + 1]; i++) {
+		EvSynctexNode node = g_array_index (source->nodes, EvSynctexNode, i);
+
+		node.box = node.box - first_box + offset;
+		g_array_append_val (index->nodes, node);
+	}
+}
+
+/* Parses the sheets of @synctex that changed since @base was built, and
+ * takes the others from @base. Returns %NULL if @base can't be used.
+ */
+static EvSynctexIndex *
+ev_synctex_index_update (const gchar    *synctex,
+			 gint            n_pages,
+			 EvSynctexIndex *base)
+{
+	EvSynctexIndex   *index;
+	EvSynctexIndex   *changed = NULL;
+	synctex_scanner_t scanner;
+	GFile            *file;
+	GOutputStream    *stream;
+	gchar            *tmp_dir;
+	gchar            *tmp_synctex;
+	gchar            *tmp_output;
+	gboolean          scanned;
+	gint              page;
+
+	tmp_dir = g_dir_make_tmp ("evince-synctex-XXXXXX", NULL);
+	if (!tmp_dir)
+		return NULL;
+
+	/* The parser finds the synctex file from the output file name */
+	tmp_synctex = g_build_filename (tmp_dir, "doc.synctex", NULL);
+	tmp_output = g_build_filename (tmp_dir, "doc.pdf", NULL);
+
+	index = ev_synctex_index_alloc (n_pages);
+
+	file = g_file_new_for_path (tmp_synctex);
+	stream = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, NULL));
+	g_object_unref (file);
+	scanned = stream && ev_synctex_index_scan (synctex, index, base, stream);
+	if (stream) {
+		scanned = g_output_stream_close (stream, NULL, NULL) && scanned;
+		g_object_unref (stream);
+	}
+
+	if (scanned && ev_synctex_index_is_compatible (index, base)) {
+		scanner = synctex_scanner_new_with_output_file (tmp_output, NULL, 1);
+		if (scanner) {
+			changed = ev_synctex_index_new_from_scanner (scanner, n_pages);
+			synctex_scanner_free (scanner);
+		}
+	}
+
+	if (changed) {
+		GHashTable *names = index->names;
+
+		index->names = changed->names;
+		changed->names = names;
+
+		for (page = 0; page < n_pages; page++) {
+			if (ev_synctex_index_can_reuse_page (base, page, index->page_hashes[page]))
+				ev_synctex_index_copy_page (index, base, page);
+			else
+				ev_synctex_index_copy_page (index, changed, page);
+		}
+		ev_synctex_index_free (changed);
+
+		if (!ev_synctex_index_finish (index))
+			g_clear_pointer (&index, ev_synctex_index_free);
+	} else {
+		g_clear_pointer (&index, ev_synctex_index_free);
+	}
+
+	g_unlink (tmp_synctex);
+	g_rmdir (tmp_dir);
+	g_free (tmp_output);
+	g_free (tmp_synctex);
+	g_free (tmp_dir);
+
+	return index;
+}
+
+/* Loads the synctex index of the document @output from the user cache,
+ * or parses its synctex file to build it. The pages that didn't change
+ * since @previous, or the index in the cache, was built are not parsed
+ * again. That can take long anyway, so this should be called from a
+ * thread. Returns %NULL when there's no usable synctex file.
+ */
+EvSynctexIndex *
+ev_synctex_index_new (const gchar    *output,
+		      gint            n_pages,
+		      EvSynctexIndex *previous)
+{
+	synctex_scanner_t scanner;
+	EvSynctexIndex   *index;
+	EvSynctexIndex   *stale = NULL;
+	gchar            *synctex;
+
+	synctex = ev_synctex_index_find_file (output);
+	if (!synctex)
+		return NULL;
+
+	index = ev_synctex_index_load (synctex, n_pages);
+	if (index) {
+		g_free (synctex);
+		return index;
+	}
+
+	if (!previous)
+		previous = stale = ev_synctex_index_load (synctex, -1);
+	if (previous)
+		index = ev_synctex_index_update (synctex, n_pages, previous);
+	if (stale)
+		ev_synctex_index_free (stale);
+
+	if (!index) {
+		scanner = synctex_scanner_new_with_output_file (output, NULL, 1);
+		if (scanner) {
+			index = ev_synctex_index_new_from_scanner (scanner, n_pages);
+			synctex_scanner_free (scanner);
+		}
+
+		/* Hashed for the next update */
+		if (index && !ev_synctex_index_scan (synctex, index, NULL, NULL))
+			g_clear_pointer (&index->page_hashes, g_free);
+	}
+
+	if (index)
+		ev_synctex_index_save (index, synctex);
+	g_free (synctex);
+
+	return index;
+}
+
+static const gchar *
+skip_dot_slash (const gchar *name)
+{
+	while (name[0] == '.' && name[1] == G_DIR_SEPARATOR)
+		name += 2;
+
+	return name;
+}
+
+/* Input names are the ones given to TeX, relative to where it ran, so
+ * they are also matched by their trailing path components, and then
+ * by their basename, like synctex does.
+ */
+static gboolean
+ev_synctex_index_get_tag (EvSynctexIndex *index,
+			  const gchar    *filename,
+			  gint           *tag)
+{
+	GHashTableIter iter;
+	gpointer       key, value;
+	const gchar   *basename;
+	gint           pass;
+
+	filename = skip_dot_slash (filename);
+	basename = strrchr (filename, G_DIR_SEPARATOR);
+	basename = basename ? basename + 1 : filename;
+
+	for (pass = 0; pass < 2; pass++) {
+		g_hash_table_iter_init (&iter, index->names);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			const gchar *name = skip_dot_slash (value);
+			const gchar *name_basename;
+			gsize        len = strlen (name);
+			gsize        filename_len = strlen (filename);
+
+			if (pass == 0) {
+				if (strcmp (name, filename) == 0 ||
+				    (len < filename_len &&
+				     filename[filename_len - len - 1] == G_DIR_SEPARATOR &&
+				     strcmp (filename + filename_len - len, name) == 0) ||
+				    (filename_len < len &&
+				     name[len - filename_len - 1] == G_DIR_SEPARATOR &&
+				     strcmp (name + len - filename_len, filename) == 0)) {
+					*tag = GPOINTER_TO_INT (key);
+					return TRUE;
+				}
+				continue;
+			}
+
+			name_basename = strrchr (name, G_DIR_SEPARATOR);
+			name_basename = name_basename ? name_basename + 1 : name;
+			if (strcmp (name_basename, basename) == 0) {
+				*tag = GPOINTER_TO_INT (key);
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+static gdouble
+distance_to_span (gdouble x,
+		  gdouble y,
+		  gdouble x1,
+		  gdouble x2,
+		  gdouble y1,
+		  gdouble y2)
+{
+	gdouble dx = x < x1 ? x1 - x : (x > x2 ? x - x2 : 0);
+	gdouble dy = y < y1 ? y1 - y : (y > y2 ? y - y2 : 0);
+
+	return dx * dx + dy * dy;
+}
+
+/* Like synctex, finds the smallest box containing the point, or the
+ * closest one, and then its closest node.
+ */
+gboolean
+ev_synctex_index_backward_search (EvSynctexIndex *index,
+				  gint            page,
+				  gdouble         x,
+				  gdouble         y,
+				  const gchar   **filename,
+				  gint           *line,
+				  gint           *column)
+{
+	const EvSynctexBox  *best_box = NULL;
+	const EvSynctexNode *best_node = NULL;
+	gdouble              best = G_MAXDOUBLE;
+	guint                best_index = 0;
+	gint                 tag;
+	guint                i;
+
+	if (page < 0 || page >= index->n_pages)
+		return FALSE;
+
+	for (i = index->page_boxes[page]; i < index->page_boxes[page + 1]; i++) {
+		const EvSynctexBox *box = &g_array_index (index->boxes, EvSynctexBox, i);
+		gdouble             area;
+
+		if (x < box->x1 || x > box->x2 || y < box->y1 || y > box->y2)
+			continue;
+
+		area = (box->x2 - box->x1) * (box->y2 - box->y1);
+		if (area < best) {
+			best = area;
+			best_box = box;
+			best_index = i;
+		}
+	}
+
+	if (!best_box) {
+		for (i = index->page_boxes[page]; i < index->page_boxes[page + 1]; i++) {
+			const EvSynctexBox *box = &g_array_index (index->boxes, EvSynctexBox, i);
+			gdouble             distance;
+
+			distance = distance_to_span (x, y, box->x1, box->x2, box->y1, box->y2);
+			if (distance < best) {
+				best = distance;
+				best_box = box;
+				best_index = i;
+			}
+		}
+	}
+
+	if (!best_box)
+		return FALSE;
+
+	best = G_MAXDOUBLE;
+	for (i = index->page_nodes[page]; i < index->page_nodes[page + 1]; i++) {
+		const EvSynctexNode *node = &g_array_index (index->nodes, EvSynctexNode, i);
+		gdouble              distance;
+
+		if (node->box != best_index)
+			continue;
+
+		distance = distance_to_span (x, y, node->x1, node->x2, node->y, node->y);
+		if (distance < best) {
+			best = distance;
+			best_node = node;
+		}
+	}
+
+	if (best_node) {
+		tag = best_node->tag;
+		*line = best_node->line;
+		*column = best_node->column;
+	} else if (best_box->tag > 0 && best_box->line > 0) {
+		tag = best_box->tag;
+		*line = best_box->line;
+		*column = best_box->column;
+	} else {
+		return FALSE;
+	}
+
+	*filename = g_hash_table_lookup (index->names, GINT_TO_POINTER (tag));
+
+	return *filename != NULL;
+}
+
+/* Finds the first node of the line, or of the closest line of the
+ * file with nodes, in the first page where it appears.
+ */
+gboolean
+ev_synctex_index_forward_search (EvSynctexIndex *index,
+				 const gchar    *filename,
+				 gint            line,
+				 gint            column,
+				 gint           *page,
+				 EvRectangle    *area)
+{
+	const EvSynctexNode *node = NULL;
+	const EvSynctexBox  *box;
+	guint                low, high;
+	gint                 tag;
+
+	if (!ev_synctex_index_get_tag (index, filename, &tag))
+		return FALSE;
+
+	/* The first node at (tag, line) or after it */
+	low = 0;
+	high = index->nodes->len;
+	while (low < high) {
+		guint                middle = low + (high - low) / 2;
+		const EvSynctexNode *middle_node;
+
+		middle_node = &g_array_index (index->nodes, EvSynctexNode, index->lines[middle]);
+		if (middle_node->tag < tag || (middle_node->tag == tag && middle_node->line < line))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low < index->nodes->len) {
+		node = &g_array_index (index->nodes, EvSynctexNode, index->lines[low]);
+		if (node->tag != tag)
+			node = NULL;
+	}
+
+	if ((!node || node->line != line) && low > 0) {
+		const EvSynctexNode *previous;
+
+		previous = &g_array_index (index->nodes, EvSynctexNode, index->lines[low - 1]);
+		if (previous->tag == tag &&
+		    (!node || line - previous->line < node->line - line)) {
+			/* The first node of the previous line */
+			while (low > 1) {
+				const EvSynctexNode *other;
+
+				other = &g_array_index (index->nodes, EvSynctexNode, index->lines[low - 2]);
+				if (other->tag != tag || other->line != previous->line)
+					break;
+				previous = other;
+				low--;
+			}
+			node = previous;
+		}
+	}
+
+	if (!node)
+		return FALSE;
+
+	box = &g_array_index (index->boxes, EvSynctexBox, node->box);
+	*page = node->page;
+	area->x1 = box->x1;
+	area->y1 = box->y1;
+	area->x2 = box->x2;
+	area->y2 = box->y2;
+
+	return TRUE;
+}
@@ -0,0 +1,55 @@
+/* ev-synctex-index.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef __EV_SYNCTEX_INDEX_H__
+#define __EV_SYNCTEX_INDEX_H__
+
+#include <glib.h>
+
+#include "ev-document.h"
+
+G_BEGIN_DECLS
+
+typedef struct _EvSynctexIndex EvSynctexIndex;
+
+gchar          *ev_synctex_index_find_file       (const gchar    *output);
+EvSynctexIndex *ev_synctex_index_new             (const gchar    *output,
+						  gint            n_pages,
+						  EvSynctexIndex *previous);
+void            ev_synctex_index_free            (EvSynctexIndex *index);
+gboolean        ev_synctex_index_backward_search (EvSynctexIndex *index,
+						  gint            page,
+						  gdouble         x,
+						  gdouble         y,
+						  const gchar   **filename,
+						  gint           *line,
+						  gint           *column);
+gboolean        ev_synctex_index_forward_search  (EvSynctexIndex *index,
+						  const gchar    *filename,
+						  gint            line,
+						  gint            column,
+						  gint           *page,
+						  EvRectangle    *area);
+
+G_END_DECLS
+
+#endif /* __EV_SYNCTEX_INDEX_H__ */
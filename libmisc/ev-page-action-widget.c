@@ -30,6 +30,8 @@
 /* Widget we pass back */
 static void  ev_page_action_widget_init       (EvPageActionWidget      *action_widget);
 static void  ev_page_action_widget_class_init (EvPageActionWidgetClass *action_widget);
+static void  ev_page_action_widget_ensure_completion (EvPageActionWidget *proxy);
+static void  entry_changed_cb                 (EvPageActionWidget      *proxy);
 
 enum
 {
@@ -47,7 +49,8 @@ struct _EvPageActionWidget
 	GtkWidget *entry;
 	GtkWidget *label;
 	guint signal_id;
-	GtkTreeModel *filter_model;
+	GtkTreeModel *completion_model;
+	gint n_label_completions;
 	GtkTreeModel *model;
 };
 
@@ -231,6 +234,10 @@ ev_page_action_widget_init (EvPageActionWidget *action_widget)
         g_signal_connect_swapped (action_widget->entry, "focus-out-event",
                                   G_CALLBACK (focus_out_cb),
                                   action_widget);
+	/* Before the completion, to update it for the new text */
+	g_signal_connect_swapped (action_widget->entry, "changed",
+				  G_CALLBACK (entry_changed_cb),
+				  action_widget);
 
 	obj = gtk_widget_get_accessible (action_widget->entry);
 	atk_object_set_name (obj, "page-label-entry");
@@ -281,6 +288,9 @@ ev_page_action_widget_set_document (EvPageActionWidget *action_widget,
                                   G_CALLBACK (page_changed_cb),
                                   action_widget);
 
+        if (ev_document_has_text_page_labels (action_widget->document))
+                ev_page_action_widget_ensure_completion (action_widget);
+
         ev_page_action_widget_set_current_page (action_widget,
                                                 ev_document_model_get_page (action_widget->doc_model));
         ev_page_action_widget_update_max_width (action_widget);
@@ -329,6 +339,7 @@ ev_page_action_widget_finalize (GObject *object)
 	}
 
         ev_page_action_widget_set_document (action_widget, NULL);
+	g_clear_object (&action_widget->completion_model);
 
 	G_OBJECT_CLASS (ev_page_action_widget_parent_class)->finalize (object);
 }
@@ -371,18 +382,40 @@ ev_page_action_widget_class_init (EvPageActionWidgetClass *klass)
 
 }
 
+/* The completion offers the pages whose label starts with the text
+ * typed, for documents with text page labels, then the outline items
+ * whose title contains it. */
+#define MAX_LABEL_COMPLETIONS 10
+
+enum {
+	COMPLETION_COLUMN_LINK_ITER,
+	COMPLETION_COLUMN_PAGE,
+	COMPLETION_COLUMN_TEXT,
+	COMPLETION_N_COLUMNS
+};
+
 static gboolean
 match_selected_cb (GtkEntryCompletion *completion,
-		   GtkTreeModel       *filter_model,
-		   GtkTreeIter        *filter_iter,
+		   GtkTreeModel       *completion_model,
+		   GtkTreeIter        *completion_iter,
 		   EvPageActionWidget *proxy)
 {
 	EvLink *link;
 	GtkTreeIter *iter;
+	gint page;
 
-	gtk_tree_model_get (filter_model, filter_iter,
-			    0, &iter,
+	gtk_tree_model_get (completion_model, completion_iter,
+			    COMPLETION_COLUMN_LINK_ITER, &iter,
+			    COMPLETION_COLUMN_PAGE, &page,
 			    -1);
+
+	if (page >= 0) {
+		ev_document_model_set_page (proxy->doc_model, page);
+		ev_page_action_widget_set_current_page (proxy, page);
+
+		return TRUE;
+	}
+
 	gtk_tree_model_get (proxy->model, iter,
 			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
 			    -1);
@@ -401,54 +434,42 @@ match_selected_cb (GtkEntryCompletion *completion,
 static void
 display_completion_text (GtkCellLayout      *cell_layout,
 			 GtkCellRenderer    *renderer,
-			 GtkTreeModel       *filter_model,
-			 GtkTreeIter        *filter_iter,
+			 GtkTreeModel       *completion_model,
+			 GtkTreeIter        *completion_iter,
 			 EvPageActionWidget *proxy)
 {
-	EvLink *link;
-	GtkTreeIter *iter;
+	gchar *text;
 
-	gtk_tree_model_get (filter_model, filter_iter,
-			    0, &iter,
-			    -1);
-	gtk_tree_model_get (proxy->model, iter,
-			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+	gtk_tree_model_get (completion_model, completion_iter,
+			    COMPLETION_COLUMN_TEXT, &text,
 			    -1);
 
-	g_object_set (renderer, "text", ev_link_get_title (link), NULL);
+	g_object_set (renderer, "text", text, NULL);
 
-	if (link)
-		g_object_unref (link);
-	
-	gtk_tree_iter_free (iter);
+	g_free (text);
 }
 
 static gboolean
 match_completion (GtkEntryCompletion *completion,
 		  const gchar        *key,
-		  GtkTreeIter        *filter_iter,
+		  GtkTreeIter        *completion_iter,
 		  EvPageActionWidget *proxy)
 {
-	EvLink *link;
-	GtkTreeIter *iter;
-	const gchar *text = NULL;
+	gchar *text = NULL;
+	gint page;
 
 	gtk_tree_model_get (gtk_entry_completion_get_model (completion),
-			    filter_iter,
-			    0, &iter,
-			    -1);
-	gtk_tree_model_get (proxy->model, iter,
-			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+			    completion_iter,
+			    COMPLETION_COLUMN_PAGE, &page,
+			    COMPLETION_COLUMN_TEXT, &text,
 			    -1);
 
-
-	if (link) {
-		text = ev_link_get_title (link);
-		g_object_unref (link);
+	/* The page labels are looked up for the text typed */
+	if (page >= 0) {
+		g_free (text);
+		return TRUE;
 	}
 
-	gtk_tree_iter_free (iter);
-
 	if (text && key) {
 		gchar *normalized_text;
 		gchar *normalized_key;
@@ -468,15 +489,100 @@ match_completion (GtkEntryCompletion *completion,
 		g_free (normalized_key);
 		g_free (case_normalized_text);
 		g_free (case_normalized_key);
+		g_free (text);
 
 		return retval;
 	}
 
+	g_free (text);
+
 	return FALSE;
 }
 
-/* user data to set on the widget. */
-#define EPA_FILTER_MODEL_DATA "epa-filter-model"
+/* Replaces the page label rows, at the start of the completion model,
+ * by the pages whose label starts with the text of the entry */
+static void
+ev_page_action_widget_update_label_completions (EvPageActionWidget *proxy)
+{
+	GtkListStore *store = GTK_LIST_STORE (proxy->completion_model);
+	GtkTreeIter   iter;
+	const gchar  *text;
+	gint          pages[MAX_LABEL_COMPLETIONS];
+	gint          n_pages = 0;
+	gint          i;
+
+	for (i = 0; i < proxy->n_label_completions; i++) {
+		gtk_tree_model_get_iter_first (proxy->completion_model, &iter);
+		gtk_list_store_remove (store, &iter);
+	}
+
+	text = gtk_entry_get_text (GTK_ENTRY (proxy->entry));
+	if (proxy->document && text[0] != '\0' &&
+	    ev_document_has_text_page_labels (proxy->document)) {
+		n_pages = ev_document_find_pages_by_label_prefix (proxy->document, text,
+								  pages, MAX_LABEL_COMPLETIONS);
+	}
+
+	for (i = n_pages - 1; i >= 0; i--) {
+		gchar *page_label;
+
+		page_label = ev_document_get_page_label (proxy->document, pages[i]);
+		gtk_list_store_insert_with_values (store, NULL, 0,
+						   COMPLETION_COLUMN_PAGE, pages[i],
+						   COMPLETION_COLUMN_TEXT, page_label,
+						   -1);
+		g_free (page_label);
+	}
+	proxy->n_label_completions = n_pages;
+}
+
+static void
+entry_changed_cb (EvPageActionWidget *proxy)
+{
+	if (proxy->completion_model)
+		ev_page_action_widget_update_label_completions (proxy);
+}
+
+static void
+ev_page_action_widget_ensure_completion (EvPageActionWidget *proxy)
+{
+	GtkEntryCompletion *completion;
+	GtkCellRenderer *renderer;
+
+	if (proxy->completion_model)
+		return;
+
+	proxy->completion_model = GTK_TREE_MODEL (gtk_list_store_new (COMPLETION_N_COLUMNS,
+								      GTK_TYPE_TREE_ITER,
+								      G_TYPE_INT,
+								      G_TYPE_STRING));
+
+	completion = gtk_entry_completion_new ();
+	g_object_set (G_OBJECT (completion),
+		      "popup-set-width", FALSE,
+		      "model", proxy->completion_model,
+		      NULL);
+
+	g_signal_connect (completion, "match-selected", G_CALLBACK (match_selected_cb), proxy);
+	gtk_entry_completion_set_match_func (completion,
+					     (GtkEntryCompletionMatchFunc) match_completion,
+					     proxy, NULL);
+
+	/* Set up the layout */
+	renderer = (GtkCellRenderer *)
+		g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+			      "ellipsize", PANGO_ELLIPSIZE_END,
+			      "width_chars", 30,
+			      NULL);
+	gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (completion), renderer, TRUE);
+	gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (completion),
+					    renderer,
+					    (GtkCellLayoutDataFunc) display_completion_text,
+					    proxy, NULL);
+	gtk_entry_set_completion (GTK_ENTRY (proxy->entry), completion);
+
+	g_object_unref (completion);
+}
 
 static gboolean
 build_new_tree_cb (GtkTreeModel *model,
@@ -484,7 +590,7 @@ build_new_tree_cb (GtkTreeModel *model,
 		   GtkTreeIter  *iter,
 		   gpointer      data)
 {
-	GtkTreeModel *filter_model = GTK_TREE_MODEL (data);
+	GtkListStore *completion_store = GTK_LIST_STORE (data);
 	EvLink *link;
 	EvLinkAction *action;
 	EvLinkActionType type;
@@ -505,12 +611,11 @@ build_new_tree_cb (GtkTreeModel *model,
 	type = ev_link_action_get_action_type (action);
 
 	if (type == EV_LINK_ACTION_TYPE_GOTO_DEST) {
-		GtkTreeIter filter_iter;
-
-		gtk_list_store_append (GTK_LIST_STORE (filter_model), &filter_iter);
-		gtk_list_store_set (GTK_LIST_STORE (filter_model), &filter_iter,
-				    0, iter,
-				    -1);
+		gtk_list_store_insert_with_values (completion_store, NULL, -1,
+						   COMPLETION_COLUMN_LINK_ITER, iter,
+						   COMPLETION_COLUMN_PAGE, -1,
+						   COMPLETION_COLUMN_TEXT, ev_link_get_title (link),
+						   -1);
 	}
 	
 	g_object_unref (link);
@@ -518,65 +623,22 @@ build_new_tree_cb (GtkTreeModel *model,
 	return FALSE;
 }
 
-static GtkTreeModel *
-get_filter_model_from_model (GtkTreeModel *model)
-{
-	GtkTreeModel *filter_model;
-
-	filter_model =
-		(GtkTreeModel *) g_object_get_data (G_OBJECT (model), EPA_FILTER_MODEL_DATA);
-	if (filter_model == NULL) {
-		filter_model = (GtkTreeModel *) gtk_list_store_new (1, GTK_TYPE_TREE_ITER);
-
-		gtk_tree_model_foreach (model,
-					build_new_tree_cb,
-					filter_model);
-		g_object_set_data_full (G_OBJECT (model), EPA_FILTER_MODEL_DATA, filter_model, g_object_unref);
-	}
-
-	return filter_model;
-}
-
-
 void
 ev_page_action_widget_update_links_model (EvPageActionWidget *proxy, GtkTreeModel *model)
 {
-	GtkTreeModel *filter_model;
-	GtkEntryCompletion *completion;
-	GtkCellRenderer *renderer;
-
 	if (!model || model == proxy->model)
 		return;
 
 	/* Magik */
 	proxy->model = model;
-	filter_model = get_filter_model_from_model (model);
-
-	completion = gtk_entry_completion_new ();
-	g_object_set (G_OBJECT (completion),
-		      "popup-set-width", FALSE,
-		      "model", filter_model,
-		      NULL);
-
-	g_signal_connect (completion, "match-selected", G_CALLBACK (match_selected_cb), proxy);
-	gtk_entry_completion_set_match_func (completion,
-					     (GtkEntryCompletionMatchFunc) match_completion,
-					     proxy, NULL);
 
-	/* Set up the layout */
-	renderer = (GtkCellRenderer *)
-		g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
-			      "ellipsize", PANGO_ELLIPSIZE_END,
-			      "width_chars", 30,
-			      NULL);
-	gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (completion), renderer, TRUE);
-	gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (completion),
-					    renderer,
-					    (GtkCellLayoutDataFunc) display_completion_text,
-					    proxy, NULL);
-	gtk_entry_set_completion (GTK_ENTRY (proxy->entry), completion);
+	ev_page_action_widget_ensure_completion (proxy);
 
-	g_object_unref (completion);
+	/* The outline items go after the page labels */
+	gtk_list_store_clear (GTK_LIST_STORE (proxy->completion_model));
+	proxy->n_label_completions = 0;
+	gtk_tree_model_foreach (model, build_new_tree_cb, proxy->completion_model);
+	ev_page_action_widget_update_label_completions (proxy);
 }
 
 void
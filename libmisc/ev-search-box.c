@@ -46,6 +46,7 @@ enum
 struct _EvSearchBoxPrivate {
         EvDocumentModel *model;
         EvJob           *job;
+        EvJob           *last_job;
         EvFindOptions    options;
         EvFindOptions    supported_options;
 
@@ -88,10 +89,20 @@ ev_search_box_clear_job (EvSearchBox *box)
         priv->job = NULL;
 }
 
+static void
+ev_search_box_clear_last_job (EvSearchBox *box)
+{
+        g_clear_object (&box->priv->last_job);
+}
+
 static void
 find_job_finished_cb (EvJobFind   *job,
                       EvSearchBox *box)
 {
+        /* Kept so that the next search can refine its results */
+        ev_search_box_clear_last_job (box);
+        box->priv->last_job = g_object_ref (EV_JOB (job));
+
         g_signal_emit (box, signals[FINISHED], 0);
         ev_search_box_clear_job (box);
         ev_search_box_update_progress (box);
@@ -190,6 +201,9 @@ search_changed_cb (GtkSearchEntry *entry,
                                              search_string,
                                              FALSE);
                 ev_job_find_set_options (EV_JOB_FIND (priv->job), priv->options);
+                if (priv->last_job)
+                        ev_job_find_refine (EV_JOB_FIND (priv->job), EV_JOB_FIND (priv->last_job));
+                ev_search_box_clear_last_job (box);
                 g_signal_connect (priv->job, "finished",
                                   G_CALLBACK (find_job_finished_cb),
                                   box);
@@ -200,6 +214,7 @@ search_changed_cb (GtkSearchEntry *entry,
                 g_signal_emit (box, signals[STARTED], 0, priv->job);
                 ev_job_scheduler_push_job (priv->job, EV_JOB_PRIORITY_NONE);
         } else {
+                ev_search_box_clear_last_job (box);
                 g_signal_emit (box, signals[CLEARED], 0);
         }
 }
@@ -241,13 +256,21 @@ static void
 ev_search_box_setup_document (EvSearchBox *box,
                               EvDocument  *document)
 {
+        EvFindOptions options;
+
+        ev_search_box_clear_last_job (box);
+
         if (!document || !EV_IS_DOCUMENT_FIND (document)) {
                 ev_search_box_set_supported_options (box, EV_FIND_DEFAULT);
                 gtk_widget_set_sensitive (GTK_WIDGET (box), FALSE);
                 return;
         }
 
-        ev_search_box_set_supported_options (box, ev_document_find_get_supported_options (EV_DOCUMENT_FIND (document)));
+        options = ev_document_find_get_supported_options (EV_DOCUMENT_FIND (document));
+        /* Patterns are matched on the text of the pages by the job */
+        if (EV_IS_DOCUMENT_TEXT (document))
+                options |= EV_FIND_REGEX | EV_FIND_ANY_TERM;
+        ev_search_box_set_supported_options (box, options);
         gtk_widget_set_sensitive (GTK_WIDGET (box), ev_document_get_n_pages (document) > 0);
 }
 
@@ -298,12 +321,64 @@ case_sensitive_toggled_cb (GtkCheckMenuItem *menu_item,
         ev_search_box_set_options (box, options);
 }
 
+static void
+regex_toggled_cb (GtkCheckMenuItem *menu_item,
+                  EvSearchBox      *box)
+{
+        EvFindOptions options = box->priv->options;
+
+        if (gtk_check_menu_item_get_active (menu_item))
+                options = (options & ~EV_FIND_ANY_TERM) | EV_FIND_REGEX;
+        else
+                options &= ~EV_FIND_REGEX;
+        ev_search_box_set_options (box, options);
+}
+
+static void
+any_term_toggled_cb (GtkCheckMenuItem *menu_item,
+                     EvSearchBox      *box)
+{
+        EvFindOptions options = box->priv->options;
+
+        if (gtk_check_menu_item_get_active (menu_item))
+                options = (options & ~EV_FIND_REGEX) | EV_FIND_ANY_TERM;
+        else
+                options &= ~EV_FIND_ANY_TERM;
+        ev_search_box_set_options (box, options);
+}
+
 static void
 ev_search_box_entry_populate_popup (EvSearchBox *box,
                                     GtkWidget   *menu)
 {
         EvSearchBoxPrivate *priv = box->priv;
 
+        if (priv->supported_options & EV_FIND_ANY_TERM) {
+                GtkWidget *menu_item;
+
+                menu_item = gtk_check_menu_item_new_with_mnemonic (_("Match Any _Term Separated by “|”"));
+                g_signal_connect (menu_item, "toggled",
+                                  G_CALLBACK (any_term_toggled_cb),
+                                  box);
+                gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (menu_item),
+                                                priv->options & EV_FIND_ANY_TERM);
+                gtk_menu_shell_prepend (GTK_MENU_SHELL (menu), menu_item);
+                gtk_widget_show (menu_item);
+        }
+
+        if (priv->supported_options & EV_FIND_REGEX) {
+                GtkWidget *menu_item;
+
+                menu_item = gtk_check_menu_item_new_with_mnemonic (_("_Regular Expression"));
+                g_signal_connect (menu_item, "toggled",
+                                  G_CALLBACK (regex_toggled_cb),
+                                  box);
+                gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (menu_item),
+                                                priv->options & EV_FIND_REGEX);
+                gtk_menu_shell_prepend (GTK_MENU_SHELL (menu), menu_item);
+                gtk_widget_show (menu_item);
+        }
+
         if (priv->supported_options & EV_FIND_WHOLE_WORDS_ONLY) {
                 GtkWidget *menu_item;
 
@@ -410,6 +485,7 @@ ev_search_box_dispose (GObject *object)
         EvSearchBox *box = EV_SEARCH_BOX (object);
 
         ev_search_box_clear_job (box);
+        ev_search_box_clear_last_job (box);
 
         G_OBJECT_CLASS (ev_search_box_parent_class)->dispose (object);
 }
@@ -44,6 +44,10 @@ struct _EvDocumentModel
 
 	gdouble max_scale;
 	gdouble min_scale;
+
+	/* page-changed is emitted once, on thaw, while frozen */
+	guint freeze_count;
+	gint  frozen_page;
 };
 
 enum {
@@ -402,7 +406,8 @@ ev_document_model_set_page (EvDocumentModel *model,
 
 	old_page = model->page;
 	model->page = page;
-	g_signal_emit (model, signals[PAGE_CHANGED], 0, old_page, page);
+	if (model->freeze_count == 0)
+		g_signal_emit (model, signals[PAGE_CHANGED], 0, old_page, page);
 
 	g_object_notify (G_OBJECT (model), "page");
 }
@@ -743,3 +748,55 @@ ev_document_model_get_fullscreen (EvDocumentModel *model)
 
 	return model->fullscreen;
 }
+
+/**
+ * ev_document_model_freeze:
+ * @model: a #EvDocumentModel
+ *
+ * Starts a batch of changes to @model. Notifications of the changed
+ * properties, and #EvDocumentModel::page-changed, are held back until
+ * the matching ev_document_model_thaw(), so that views update their
+ * layout and render the pages only once for all the changes.
+ *
+ * Calls can be nested.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_model_freeze (EvDocumentModel *model)
+{
+	g_return_if_fail (EV_IS_DOCUMENT_MODEL (model));
+
+	if (model->freeze_count++ == 0)
+		model->frozen_page = model->page;
+
+	g_object_freeze_notify (G_OBJECT (model));
+}
+
+/**
+ * ev_document_model_thaw:
+ * @model: a #EvDocumentModel
+ *
+ * Ends a batch of changes started with ev_document_model_freeze(),
+ * emitting the notifications held back by the outermost one.
+ *
+ * Since: 3.30
+ */
+void
+ev_document_model_thaw (EvDocumentModel *model)
+{
+	g_return_if_fail (EV_IS_DOCUMENT_MODEL (model));
+	g_return_if_fail (model->freeze_count > 0);
+
+	g_object_ref (model);
+
+	/* Let views pick up the new scale, rotation and layout before
+	 * moving to the new page */
+	g_object_thaw_notify (G_OBJECT (model));
+
+	if (--model->freeze_count == 0 && model->page != model->frozen_page)
+		g_signal_emit (model, signals[PAGE_CHANGED], 0,
+			       model->frozen_page, model->page);
+
+	g_object_unref (model);
+}
@@ -96,6 +96,8 @@ gboolean         ev_document_model_get_dual_page_odd_pages_left (EvDocumentModel
 void             ev_document_model_set_fullscreen    (EvDocumentModel *model,
 						      gboolean         fullscreen);
 gboolean         ev_document_model_get_fullscreen    (EvDocumentModel *model);
+void             ev_document_model_freeze            (EvDocumentModel *model);
+void             ev_document_model_thaw              (EvDocumentModel *model);
 
 /* deprecated */
 
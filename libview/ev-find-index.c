@@ -0,0 +1,1003 @@
+/* ev-find-index.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "ev-debug.h"
+#include "ev-find-index.h"
+
+/* Bump when the way words are extracted changes */
+#define EV_FIND_INDEX_VERSION   2
+#define EV_FIND_INDEX_FORMAT    "(uttua(sau)as)"
+
+/* Indexes kept loaded for searches over several documents */
+#define EV_FIND_INDEX_CACHE_SIZE 32
+
+/* Characters of the page text shown around a match */
+#define EV_FIND_INDEX_SNIPPET_BEFORE 40
+#define EV_FIND_INDEX_SNIPPET_AFTER  80
+
+/* Smaller documents are searched fast enough without an index */
+#define EV_FIND_INDEX_MIN_PAGES 50
+
+/* The index maps every word of the document, case folded, to the
+ * pages containing it. Words are runs of non-space characters, as
+ * the text is split by the backends, so a query can only match on
+ * the pages where each of its words is part of a word of the page.
+ * Searches use it to skip the other pages, the backend still finds
+ * the actual matches. The index is built from the text of the pages
+ * the first time a document is opened, and saved in the user cache,
+ * indexed by the document URI and checked against the modification
+ * time and size of the file. The text of the pages is saved too, so
+ * that the indexes of documents that aren't loaded can be searched,
+ * see ev_find_index_search_uris_async().
+ */
+struct _EvFindIndex {
+	GObject   parent;
+
+	gchar    *uri;
+	guint64   mtime;
+	guint64   size;
+	gint      n_pages;
+	GVariant *words; /* a(sau) */
+	GVariant *texts; /* as */
+};
+
+G_DEFINE_TYPE (EvFindIndex, ev_find_index, G_TYPE_OBJECT)
+
+G_DEFINE_BOXED_TYPE (EvFindIndexHit, ev_find_index_hit, ev_find_index_hit_copy, ev_find_index_hit_free)
+
+static GMutex      cache_mutex;
+static GHashTable *cache_indexes;
+
+typedef void (* EvFindIndexWordFunc) (const gchar *word,
+				      gsize        len,
+				      gpointer     user_data);
+
+static void
+ev_find_index_finalize (GObject *object)
+{
+	EvFindIndex *index = EV_FIND_INDEX (object);
+
+	g_clear_pointer (&index->words, g_variant_unref);
+	g_clear_pointer (&index->texts, g_variant_unref);
+	g_free (index->uri);
+
+	G_OBJECT_CLASS (ev_find_index_parent_class)->finalize (object);
+}
+
+static void
+ev_find_index_init (EvFindIndex *index)
+{
+}
+
+static void
+ev_find_index_class_init (EvFindIndexClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = ev_find_index_finalize;
+}
+
+static gchar *
+ev_find_index_get_cache_path (const gchar *uri)
+{
+	gchar *checksum;
+	gchar *filename;
+	gchar *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	filename = g_strconcat (checksum, ".index", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "evince", "find-index", filename, NULL);
+	g_free (filename);
+	g_free (checksum);
+
+	return path;
+}
+
+static gboolean
+ev_find_index_get_file_stamp (const gchar *uri,
+			      guint64     *mtime,
+			      guint64     *size)
+{
+	GFile     *file;
+	GFileInfo *info;
+
+	file = g_file_new_for_uri (uri);
+	if (!g_file_is_native (file)) {
+		g_object_unref (file);
+		return FALSE;
+	}
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref (file);
+	if (!info)
+		return FALSE;
+
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	*size = g_file_info_get_size (info);
+	g_object_unref (info);
+
+	return TRUE;
+}
+
+/* Calls @func for every run of non-space characters of @text */
+static void
+ev_find_index_split (const gchar         *text,
+		     EvFindIndexWordFunc  func,
+		     gpointer             user_data)
+{
+	const gchar *p = text;
+	const gchar *word = NULL;
+
+	while (*p) {
+		gboolean is_space = g_unichar_isspace (g_utf8_get_char (p));
+
+		if (is_space && word) {
+			func (word, p - word, user_data);
+			word = NULL;
+		} else if (!is_space && !word) {
+			word = p;
+		}
+
+		p = g_utf8_next_char (p);
+	}
+
+	if (word)
+		func (word, p - word, user_data);
+}
+
+/* The text of encrypted documents is never written to disk */
+static gboolean
+ev_find_index_document_is_secure (EvDocument *document)
+{
+	return EV_IS_DOCUMENT_SECURITY (document) &&
+		ev_document_security_has_document_security (EV_DOCUMENT_SECURITY (document));
+}
+
+/**
+ * ev_find_index_is_supported:
+ * @document: an #EvDocument
+ *
+ * Whether searches in @document can use an index. Only large documents
+ * loaded from local files whose text can be extracted are indexed,
+ * unless they have document security, since the index keeps the text
+ * of the pages in the user cache. Indexing can be disabled by setting EV_FIND_INDEX to 0.
+ *
+ * Returns: %TRUE if an index can be built for @document
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_find_index_is_supported (EvDocument *document)
+{
+	const gchar *env;
+	const gchar *uri;
+	guint64      mtime, size;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	env = g_getenv ("EV_FIND_INDEX");
+	if (env && g_ascii_strtoll (env, NULL, 10) == 0)
+		return FALSE;
+
+	if (!EV_IS_DOCUMENT_FIND (document) || !EV_IS_DOCUMENT_TEXT (document))
+		return FALSE;
+
+	if (ev_document_get_n_pages (document) < EV_FIND_INDEX_MIN_PAGES)
+		return FALSE;
+
+	if (ev_find_index_document_is_secure (document))
+		return FALSE;
+
+	uri = ev_document_get_uri (document);
+
+	return uri && ev_find_index_get_file_stamp (uri, &mtime, &size);
+}
+
+/* Loads the index saved for @uri, if the file hasn't changed since */
+static EvFindIndex *
+ev_find_index_load_uri (const gchar *uri)
+{
+	EvFindIndex *index = NULL;
+	GMappedFile *mapped;
+	GVariant    *variant;
+	GVariant    *words;
+	GVariant    *texts;
+	GBytes      *bytes;
+	gchar       *path;
+	guint64      mtime, size;
+	guint64      saved_mtime, saved_size;
+	guint32      version, n_pages;
+
+	if (!ev_find_index_get_file_stamp (uri, &mtime, &size))
+		return NULL;
+
+	path = ev_find_index_get_cache_path (uri);
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+	if (!mapped)
+		return NULL;
+
+	/* Not trusted, a broken file gives empty values */
+	bytes = g_mapped_file_get_bytes (mapped);
+	g_mapped_file_unref (mapped);
+	variant = g_variant_new_from_bytes (G_VARIANT_TYPE (EV_FIND_INDEX_FORMAT), bytes, FALSE);
+	g_bytes_unref (bytes);
+
+	g_variant_get (variant, "(uttu@a(sau)@as)",
+		       &version, &saved_mtime, &saved_size, &n_pages, &words, &texts);
+	g_variant_unref (variant);
+
+	if (version == EV_FIND_INDEX_VERSION &&
+	    saved_mtime == mtime && saved_size == size &&
+	    g_variant_n_children (texts) == n_pages) {
+		index = g_object_new (EV_TYPE_FIND_INDEX, NULL);
+		index->uri = g_strdup (uri);
+		index->mtime = mtime;
+		index->size = size;
+		index->n_pages = n_pages;
+		index->words = words;
+		index->texts = texts;
+	} else {
+		g_variant_unref (words);
+		g_variant_unref (texts);
+	}
+
+	ev_debug_message (DEBUG_JOBS, "%s: %s", uri, index ? "loaded" : "stale");
+
+	return index;
+}
+
+/**
+ * ev_find_index_load:
+ * @document: an #EvDocument
+ *
+ * Loads the index of @document saved by a previous ev_find_index_build(),
+ * if @document hasn't changed since then.
+ *
+ * Returns: (transfer full) (allow-none): the index of @document, or %NULL
+ *
+ * Since: 3.30
+ */
+EvFindIndex *
+ev_find_index_load (EvDocument *document)
+{
+	EvFindIndex *index;
+	const gchar *uri;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	uri = ev_document_get_uri (document);
+	if (!uri)
+		return NULL;
+
+	/* Removes the index saved before the document was encrypted,
+	 * so that the recent view can't search it either */
+	if (ev_find_index_document_is_secure (document)) {
+		gchar *path = ev_find_index_get_cache_path (uri);
+
+		g_unlink (path);
+		g_free (path);
+
+		return NULL;
+	}
+
+	index = ev_find_index_load_uri (uri);
+	if (index && index->n_pages != ev_document_get_n_pages (document))
+		g_clear_object (&index);
+
+	return index;
+}
+
+static void
+ev_find_index_save (EvFindIndex *index,
+		    const gchar *uri)
+{
+	GVariant *variant;
+	gchar    *path;
+	gchar    *dir;
+	guint64   mtime, size;
+
+	if (!ev_find_index_get_file_stamp (uri, &mtime, &size))
+		return;
+
+	index->uri = g_strdup (uri);
+	index->mtime = mtime;
+	index->size = size;
+
+	variant = g_variant_new ("(uttu@a(sau)@as)",
+				 EV_FIND_INDEX_VERSION, mtime, size,
+				 index->n_pages, index->words, index->texts);
+	g_variant_ref_sink (variant);
+
+	path = ev_find_index_get_cache_path (uri);
+	dir = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dir, 0700) == 0)
+		g_file_set_contents (path, g_variant_get_data (variant),
+				     g_variant_get_size (variant), NULL);
+
+	g_free (dir);
+	g_free (path);
+	g_variant_unref (variant);
+}
+
+typedef struct {
+	GHashTable *words;
+	guint32     page;
+} EvFindIndexBuilder;
+
+static void
+ev_find_index_add_word (const gchar *word,
+			gsize        len,
+			gpointer     user_data)
+{
+	EvFindIndexBuilder *builder = (EvFindIndexBuilder *)user_data;
+	gchar              *key;
+	GArray             *pages;
+
+	key = g_strndup (word, len);
+	pages = g_hash_table_lookup (builder->words, key);
+	if (!pages) {
+		pages = g_array_new (FALSE, FALSE, sizeof (guint32));
+		g_hash_table_insert (builder->words, key, pages);
+	} else {
+		g_free (key);
+	}
+
+	/* Pages are added in order */
+	if (pages->len == 0 || g_array_index (pages, guint32, pages->len - 1) != builder->page)
+		g_array_append_val (pages, builder->page);
+}
+
+/**
+ * ev_find_index_build:
+ * @document: an #EvDocument
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ *
+ * Extracts the text of every page of @document to build its index,
+ * and saves it, unless @document has document security, so that
+ * ev_find_index_load() finds it next time. This
+ * takes a long time for large documents and must not be called from
+ * the main thread. The document lock is taken for every page.
+ *
+ * Returns: (transfer full) (allow-none): the index of @document, or
+ *   %NULL if it was cancelled
+ *
+ * Since: 3.30
+ */
+EvFindIndex *
+ev_find_index_build (EvDocument   *document,
+		     GCancellable *cancellable)
+{
+	EvFindIndex        *index;
+	EvFindIndexBuilder  builder;
+	GVariantBuilder     words;
+	GVariantBuilder     texts;
+	GHashTableIter      iter;
+	gpointer            key, value;
+	const gchar        *uri;
+	gint                n_pages;
+	gint                i;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT_TEXT (document), NULL);
+
+	n_pages = ev_document_get_n_pages (document);
+	builder.words = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					       (GDestroyNotify) g_array_unref);
+	g_variant_builder_init (&texts, G_VARIANT_TYPE ("as"));
+
+	for (i = 0; i < n_pages; i++) {
+		EvPage *page;
+		gchar  *text;
+
+		if (g_cancellable_is_cancelled (cancellable)) {
+			g_hash_table_destroy (builder.words);
+			g_variant_builder_clear (&texts);
+			return NULL;
+		}
+
+		ev_document_lock (document);
+		page = ev_document_get_page (document, i);
+		text = ev_document_text_get_text (EV_DOCUMENT_TEXT (document), page);
+		g_object_unref (page);
+		ev_document_unlock (document);
+
+		if (text && g_utf8_validate (text, -1, NULL)) {
+			gchar *folded = g_utf8_casefold (text, -1);
+
+			builder.page = i;
+			ev_find_index_split (folded, ev_find_index_add_word, &builder);
+			g_free (folded);
+			g_variant_builder_add (&texts, "s", text);
+		} else {
+			g_variant_builder_add (&texts, "s", "");
+		}
+		g_free (text);
+	}
+
+	g_variant_builder_init (&words, G_VARIANT_TYPE ("a(sau)"));
+	g_hash_table_iter_init (&iter, builder.words);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GArray *pages = (GArray *)value;
+
+		g_variant_builder_add (&words, "(s@au)", (const gchar *)key,
+				       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+								  pages->data, pages->len,
+								  sizeof (guint32)));
+	}
+
+	ev_debug_message (DEBUG_JOBS, "%d pages, %u words", n_pages,
+			  g_hash_table_size (builder.words));
+	g_hash_table_destroy (builder.words);
+
+	index = g_object_new (EV_TYPE_FIND_INDEX, NULL);
+	index->n_pages = n_pages;
+	index->words = g_variant_ref_sink (g_variant_builder_end (&words));
+	index->texts = g_variant_ref_sink (g_variant_builder_end (&texts));
+
+	uri = ev_document_get_uri (document);
+	if (uri && !ev_find_index_document_is_secure (document))
+		ev_find_index_save (index, uri);
+
+	return index;
+}
+
+/**
+ * ev_find_index_get_n_pages:
+ * @index: an #EvFindIndex
+ *
+ * Returns: the number of pages of the indexed document
+ *
+ * Since: 3.30
+ */
+gint
+ev_find_index_get_n_pages (EvFindIndex *index)
+{
+	g_return_val_if_fail (EV_IS_FIND_INDEX (index), 0);
+
+	return index->n_pages;
+}
+
+static void
+ev_find_index_add_token (const gchar *word,
+			 gsize        len,
+			 gpointer     user_data)
+{
+	g_ptr_array_add ((GPtrArray *)user_data, g_strndup (word, len));
+}
+
+/**
+ * ev_find_index_get_candidate_pages:
+ * @index: an #EvFindIndex
+ * @text: the text to search
+ *
+ * Finds the pages where @text may be found, whatever the find options.
+ * Other pages are known not to contain @text. @index is not modified
+ * once it's built, so this can be called from any thread.
+ *
+ * Returns: (transfer full) (allow-none): an array with a boolean for
+ *   every page, %TRUE if @text may be found in that page, or %NULL if
+ *   it may be found in any page. Free it with g_free().
+ *
+ * Since: 3.30
+ */
+gboolean *
+ev_find_index_get_candidate_pages (EvFindIndex *index,
+				   const gchar *text)
+{
+	GPtrArray *tokens;
+	gboolean  *pages = NULL;
+	gboolean  *token_pages;
+	gchar     *folded;
+	guint      i;
+	gint       j;
+
+	g_return_val_if_fail (EV_IS_FIND_INDEX (index), NULL);
+	g_return_val_if_fail (text != NULL, NULL);
+
+	if (!g_utf8_validate (text, -1, NULL))
+		return NULL;
+
+	tokens = g_ptr_array_new_with_free_func (g_free);
+	folded = g_utf8_casefold (text, -1);
+	ev_find_index_split (folded, ev_find_index_add_token, tokens);
+	g_free (folded);
+
+	if (tokens->len == 0) {
+		g_ptr_array_free (tokens, TRUE);
+		return NULL;
+	}
+
+	token_pages = g_new (gboolean, index->n_pages);
+	for (i = 0; i < tokens->len; i++) {
+		const gchar  *token = g_ptr_array_index (tokens, i);
+		const gchar  *word;
+		GVariant     *word_pages;
+		GVariantIter  iter;
+
+		memset (token_pages, 0, sizeof (gboolean) * index->n_pages);
+
+		g_variant_iter_init (&iter, index->words);
+		while (g_variant_iter_next (&iter, "(&s@au)", &word, &word_pages)) {
+			if (strstr (word, token)) {
+				const guint32 *elements;
+				gsize          n_elements, k;
+
+				elements = g_variant_get_fixed_array (word_pages, &n_elements,
+								      sizeof (guint32));
+				for (k = 0; k < n_elements; k++) {
+					if (elements[k] < (guint32) index->n_pages)
+						token_pages[elements[k]] = TRUE;
+				}
+			}
+			g_variant_unref (word_pages);
+		}
+
+		if (!pages) {
+			pages = token_pages;
+			token_pages = g_new (gboolean, index->n_pages);
+			continue;
+		}
+
+		for (j = 0; j < index->n_pages; j++)
+			pages[j] = pages[j] && token_pages[j];
+	}
+
+	g_free (token_pages);
+	g_ptr_array_free (tokens, TRUE);
+
+	return pages;
+}
+
+static GQuark
+ev_find_index_quark (void)
+{
+	static GQuark quark = 0;
+
+	if (G_UNLIKELY (quark == 0))
+		quark = g_quark_from_static_string ("ev-find-index");
+
+	return quark;
+}
+
+/**
+ * ev_find_index_get_for_document:
+ * @document: an #EvDocument
+ *
+ * Returns: (transfer none) (allow-none): the index set for @document
+ *   with ev_find_index_set_for_document(), or %NULL
+ *
+ * Since: 3.30
+ */
+EvFindIndex *
+ev_find_index_get_for_document (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	return g_object_get_qdata (G_OBJECT (document), ev_find_index_quark ());
+}
+
+/**
+ * ev_find_index_set_for_document:
+ * @document: an #EvDocument
+ * @index: (allow-none): the index of @document, or %NULL
+ *
+ * Sets the index used by the find jobs created for @document from now
+ * on. Must be called from the main thread.
+ *
+ * Since: 3.30
+ */
+void
+ev_find_index_set_for_document (EvDocument  *document,
+				EvFindIndex *index)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	g_return_if_fail (index == NULL || EV_IS_FIND_INDEX (index));
+
+	g_object_set_qdata_full (G_OBJECT (document), ev_find_index_quark (),
+				 index ? g_object_ref (index) : NULL,
+				 g_object_unref);
+}
+
+/**
+ * ev_find_index_hit_copy:
+ * @hit: an #EvFindIndexHit
+ *
+ * Returns: (transfer full): a copy of @hit
+ *
+ * Since: 3.30
+ */
+EvFindIndexHit *
+ev_find_index_hit_copy (EvFindIndexHit *hit)
+{
+	EvFindIndexHit *copy;
+
+	g_return_val_if_fail (hit != NULL, NULL);
+
+	copy = g_slice_new (EvFindIndexHit);
+	copy->uri = g_strdup (hit->uri);
+	copy->page = hit->page;
+	copy->score = hit->score;
+	copy->snippet = g_strdup (hit->snippet);
+
+	return copy;
+}
+
+/**
+ * ev_find_index_hit_free:
+ * @hit: an #EvFindIndexHit
+ *
+ * Since: 3.30
+ */
+void
+ev_find_index_hit_free (EvFindIndexHit *hit)
+{
+	if (!hit)
+		return;
+
+	g_free (hit->uri);
+	g_free (hit->snippet);
+	g_slice_free (EvFindIndexHit, hit);
+}
+
+static gint
+ev_find_index_hit_compare (gconstpointer a,
+			   gconstpointer b)
+{
+	const EvFindIndexHit *hit_a = a;
+	const EvFindIndexHit *hit_b = b;
+
+	if (hit_a->score != hit_b->score)
+		return hit_a->score > hit_b->score ? -1 : 1;
+
+	return hit_a->page - hit_b->page;
+}
+
+/* Returns the text around @word, from the page @text, on a single line */
+static gchar *
+ev_find_index_get_snippet (const gchar *text,
+			   const gchar *word)
+{
+	const gchar *start = word;
+	const gchar *end = word;
+	GString     *snippet;
+	gboolean     space = FALSE;
+	gint         i;
+
+	for (i = 0; i < EV_FIND_INDEX_SNIPPET_BEFORE && start > text; i++)
+		start = g_utf8_prev_char (start);
+	/* Don't start in the middle of a word */
+	if (start > text) {
+		while (start < word && !g_unichar_isspace (g_utf8_get_char (start)))
+			start = g_utf8_next_char (start);
+	}
+
+	for (i = 0; i < EV_FIND_INDEX_SNIPPET_AFTER && *end; i++)
+		end = g_utf8_next_char (end);
+
+	snippet = g_string_new (start > text ? "…" : NULL);
+	for (; start < end; start = g_utf8_next_char (start)) {
+		gunichar c = g_utf8_get_char (start);
+
+		if (g_unichar_isspace (c)) {
+			space = TRUE;
+			continue;
+		}
+		if (space && snippet->len > 0)
+			g_string_append_c (snippet, ' ');
+		space = FALSE;
+		g_string_append_unichar (snippet, c);
+	}
+	if (*end)
+		g_string_append (snippet, "…");
+
+	return g_string_free (snippet, FALSE);
+}
+
+typedef struct {
+	GPtrArray   *tokens;
+	const gchar *text;
+	const gchar *first_match;
+	guint        score;
+} EvFindIndexScorer;
+
+static void
+ev_find_index_score_word (const gchar *word,
+			  gsize        len,
+			  gpointer     user_data)
+{
+	EvFindIndexScorer *scorer = (EvFindIndexScorer *)user_data;
+	gchar             *folded;
+	guint              i;
+
+	folded = g_utf8_casefold (word, len);
+	for (i = 0; i < scorer->tokens->len; i++) {
+		if (!strstr (folded, g_ptr_array_index (scorer->tokens, i)))
+			continue;
+
+		scorer->score++;
+		if (!scorer->first_match)
+			scorer->first_match = word;
+	}
+	g_free (folded);
+}
+
+/**
+ * ev_find_index_search:
+ * @index: an #EvFindIndex
+ * @text: the text to search
+ * @max_hits: the maximum number of hits returned
+ *
+ * Searches @text in the saved page text of @index, without the indexed
+ * document. Pages are ranked by the number of words containing a word
+ * of @text. Can be called from any thread.
+ *
+ * Returns: (transfer full) (element-type EvFindIndexHit): the hits of
+ *   @text in the best ranked pages, the best first
+ *
+ * Since: 3.30
+ */
+GList *
+ev_find_index_search (EvFindIndex *index,
+		      const gchar *text,
+		      guint        max_hits)
+{
+	EvFindIndexScorer scorer;
+	GList            *hits = NULL;
+	gboolean         *pages;
+	gchar            *folded;
+	gint              i;
+
+	g_return_val_if_fail (EV_IS_FIND_INDEX (index), NULL);
+	g_return_val_if_fail (text != NULL, NULL);
+
+	if (!index->texts || max_hits == 0)
+		return NULL;
+
+	pages = ev_find_index_get_candidate_pages (index, text);
+	if (!pages)
+		return NULL;
+
+	scorer.tokens = g_ptr_array_new_with_free_func (g_free);
+	folded = g_utf8_casefold (text, -1);
+	ev_find_index_split (folded, ev_find_index_add_token, scorer.tokens);
+	g_free (folded);
+
+	for (i = 0; i < index->n_pages; i++) {
+		EvFindIndexHit *hit;
+
+		if (!pages[i])
+			continue;
+
+		g_variant_get_child (index->texts, i, "&s", &scorer.text);
+		scorer.first_match = NULL;
+		scorer.score = 0;
+		ev_find_index_split (scorer.text, ev_find_index_score_word, &scorer);
+		if (scorer.score == 0)
+			continue;
+
+		hit = g_slice_new (EvFindIndexHit);
+		hit->uri = g_strdup (index->uri);
+		hit->page = i;
+		hit->score = scorer.score;
+		hit->snippet = ev_find_index_get_snippet (scorer.text, scorer.first_match);
+		hits = g_list_prepend (hits, hit);
+	}
+
+	g_ptr_array_free (scorer.tokens, TRUE);
+	g_free (pages);
+
+	hits = g_list_sort (hits, ev_find_index_hit_compare);
+	while (g_list_length (hits) > max_hits) {
+		GList *last = g_list_last (hits);
+
+		ev_find_index_hit_free (last->data);
+		hits = g_list_delete_link (hits, last);
+	}
+
+	return hits;
+}
+
+/* Returns the saved index of @uri, loaded once for all the searches
+ * as long as the document doesn't change */
+static EvFindIndex *
+ev_find_index_lookup_uri (const gchar *uri)
+{
+	EvFindIndex *index;
+	guint64      mtime, size;
+
+	if (!ev_find_index_get_file_stamp (uri, &mtime, &size))
+		return NULL;
+
+	g_mutex_lock (&cache_mutex);
+	if (!cache_indexes)
+		cache_indexes = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, g_object_unref);
+	index = g_hash_table_lookup (cache_indexes, uri);
+	if (index && (index->mtime != mtime || index->size != size)) {
+		g_hash_table_remove (cache_indexes, uri);
+		index = NULL;
+	}
+	if (index)
+		g_object_ref (index);
+	g_mutex_unlock (&cache_mutex);
+
+	if (index)
+		return index;
+
+	index = ev_find_index_load_uri (uri);
+	if (!index)
+		return NULL;
+
+	g_mutex_lock (&cache_mutex);
+	if (g_hash_table_size (cache_indexes) >= EV_FIND_INDEX_CACHE_SIZE)
+		g_hash_table_remove_all (cache_indexes);
+	g_hash_table_replace (cache_indexes, g_strdup (uri), g_object_ref (index));
+	g_mutex_unlock (&cache_mutex);
+
+	return index;
+}
+
+typedef struct {
+	gchar        **uris;
+	gchar         *text;
+	guint          max_hits;
+	GCancellable  *cancellable;
+
+	GMutex         mutex;
+	GList         *hits;
+} EvFindIndexSearch;
+
+static void
+ev_find_index_search_free (EvFindIndexSearch *search)
+{
+	g_strfreev (search->uris);
+	g_free (search->text);
+	g_clear_object (&search->cancellable);
+	g_mutex_clear (&search->mutex);
+	g_list_free_full (search->hits, (GDestroyNotify) ev_find_index_hit_free);
+	g_free (search);
+}
+
+static void
+ev_find_index_search_uri (gpointer data,
+			  gpointer user_data)
+{
+	EvFindIndexSearch *search = (EvFindIndexSearch *)user_data;
+	const gchar       *uri = (const gchar *)data;
+	EvFindIndex       *index;
+	GList             *hits;
+
+	if (g_cancellable_is_cancelled (search->cancellable))
+		return;
+
+	index = ev_find_index_lookup_uri (uri);
+	if (!index)
+		return;
+
+	hits = ev_find_index_search (index, search->text, search->max_hits);
+	g_object_unref (index);
+
+	g_mutex_lock (&search->mutex);
+	search->hits = g_list_concat (search->hits, hits);
+	g_mutex_unlock (&search->mutex);
+}
+
+static void
+ev_find_index_search_thread (GTask        *task,
+			     gpointer      source_object,
+			     gpointer      task_data,
+			     GCancellable *cancellable)
+{
+	EvFindIndexSearch *search = (EvFindIndexSearch *)task_data;
+	GThreadPool       *pool;
+	GList             *hits;
+	guint              i;
+
+	pool = g_thread_pool_new (ev_find_index_search_uri, search,
+				  g_get_num_processors (), FALSE, NULL);
+	for (i = 0; search->uris[i]; i++)
+		g_thread_pool_push (pool, search->uris[i], NULL);
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	if (g_task_return_error_if_cancelled (task))
+		return;
+
+	hits = g_list_sort (search->hits, ev_find_index_hit_compare);
+	search->hits = NULL;
+	while (g_list_length (hits) > search->max_hits) {
+		GList *last = g_list_last (hits);
+
+		ev_find_index_hit_free (last->data);
+		hits = g_list_delete_link (hits, last);
+	}
+
+	g_task_return_pointer (task, hits, NULL);
+}
+
+/**
+ * ev_find_index_search_uris_async:
+ * @uris: (array zero-terminated=1): the URIs of the documents to search
+ * @text: the text to search
+ * @max_hits: the maximum number of hits returned
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: the function called when the search is done
+ * @user_data: data passed to @callback
+ *
+ * Searches @text in the saved indexes of the documents at @uris,
+ * without loading them, see ev_find_index_search(). The indexes are
+ * searched in parallel threads, and kept loaded for the next searches.
+ * Documents that haven't been indexed are not searched.
+ *
+ * Since: 3.30
+ */
+void
+ev_find_index_search_uris_async (const gchar * const *uris,
+				 const gchar         *text,
+				 guint                max_hits,
+				 GCancellable        *cancellable,
+				 GAsyncReadyCallback  callback,
+				 gpointer             user_data)
+{
+	EvFindIndexSearch *search;
+	GTask             *task;
+
+	g_return_if_fail (uris != NULL);
+	g_return_if_fail (text != NULL);
+
+	search = g_new0 (EvFindIndexSearch, 1);
+	search->uris = g_strdupv ((gchar **) uris);
+	search->text = g_strdup (text);
+	search->max_hits = max_hits;
+	search->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	g_mutex_init (&search->mutex);
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, ev_find_index_search_uris_async);
+	g_task_set_task_data (task, search, (GDestroyNotify) ev_find_index_search_free);
+	g_task_run_in_thread (task, ev_find_index_search_thread);
+	g_object_unref (task);
+}
+
+/**
+ * ev_find_index_search_uris_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: (allow-none): return location for an error, or %NULL
+ *
+ * Returns: (transfer full) (element-type EvFindIndexHit): the hits of
+ *   the search, the best first, or %NULL if there's none or the search
+ *   was cancelled
+ *
+ * Since: 3.30
+ */
+GList *
+ev_find_index_search_uris_finish (GAsyncResult  *result,
+				  GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
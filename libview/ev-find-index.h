@@ -0,0 +1,74 @@
+/* ev-find-index.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_FIND_INDEX_H
+#define EV_FIND_INDEX_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_FIND_INDEX (ev_find_index_get_type ())
+G_DECLARE_FINAL_TYPE (EvFindIndex, ev_find_index, EV, FIND_INDEX, GObject)
+
+#define EV_TYPE_FIND_INDEX_HIT (ev_find_index_hit_get_type ())
+
+typedef struct _EvFindIndexHit EvFindIndexHit;
+
+struct _EvFindIndexHit {
+	gchar *uri;
+	gint   page;
+	guint  score;
+	gchar *snippet;
+};
+
+gboolean     ev_find_index_is_supported          (EvDocument   *document);
+EvFindIndex *ev_find_index_load                  (EvDocument   *document);
+EvFindIndex *ev_find_index_build                 (EvDocument   *document,
+						  GCancellable *cancellable);
+gint         ev_find_index_get_n_pages           (EvFindIndex  *index);
+gboolean    *ev_find_index_get_candidate_pages   (EvFindIndex  *index,
+						  const gchar  *text);
+EvFindIndex *ev_find_index_get_for_document      (EvDocument   *document);
+void         ev_find_index_set_for_document      (EvDocument   *document,
+						  EvFindIndex  *index);
+GList       *ev_find_index_search                (EvFindIndex  *index,
+						  const gchar  *text,
+						  guint         max_hits);
+void         ev_find_index_search_uris_async     (const gchar * const *uris,
+						  const gchar  *text,
+						  guint         max_hits,
+						  GCancellable *cancellable,
+						  GAsyncReadyCallback callback,
+						  gpointer      user_data);
+GList       *ev_find_index_search_uris_finish    (GAsyncResult *result,
+						  GError      **error);
+
+GType           ev_find_index_hit_get_type       (void) G_GNUC_CONST;
+EvFindIndexHit *ev_find_index_hit_copy           (EvFindIndexHit *hit);
+void            ev_find_index_hit_free           (EvFindIndexHit *hit);
+
+G_END_DECLS
+
+#endif /* EV_FIND_INDEX_H */
@@ -0,0 +1,390 @@
+/* ev-find-pattern.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "ev-find-pattern.h"
+
+/* A find pattern is compiled once for a search and matched against
+ * the text of every page in a single pass: a GRegex for regular
+ * expressions, and an Aho-Corasick automaton for lists of terms, so
+ * that looking for many terms costs about the same as looking for
+ * one. Matches are character ranges of the page text, mapped to
+ * rectangles with the text layout, which has an area per character.
+ * Patterns are not modified once compiled, so they can be matched
+ * from several search threads.
+ */
+
+typedef struct {
+	GHashTable *next;        /* gunichar -> node index */
+	guint       fail;
+	guint       output;      /* Nearest node ending a term, following fail links */
+	guint       term_length; /* Length of the term ending here, or 0 */
+} EvFindPatternNode;
+
+typedef struct {
+	guint start;
+	guint end;
+} EvFindPatternMatch;
+
+struct _EvFindPattern {
+	gboolean  case_sensitive;
+	gboolean  whole_words;
+
+	GRegex   *regex;
+
+	gchar   **terms;
+	GArray   *nodes;         /* The root is the first node */
+};
+
+#define NODE(pattern, i) (&g_array_index ((pattern)->nodes, EvFindPatternNode, (i)))
+
+static gunichar
+ev_find_pattern_normalize (EvFindPattern *pattern,
+			   gunichar       c)
+{
+	/* Line breaks match spaces, after the text of the page */
+	if (g_unichar_isspace (c))
+		return ' ';
+
+	return pattern->case_sensitive ? c : g_unichar_tolower (c);
+}
+
+static guint
+ev_find_pattern_goto (EvFindPattern *pattern,
+		      guint          node,
+		      gunichar       c)
+{
+	GHashTable *next = NODE (pattern, node)->next;
+
+	return next ? GPOINTER_TO_UINT (g_hash_table_lookup (next, GUINT_TO_POINTER (c))) : 0;
+}
+
+static void
+ev_find_pattern_add_term (EvFindPattern *pattern,
+			  const gchar   *term)
+{
+	gunichar *chars;
+	glong     n_chars, i;
+	guint     node = 0;
+
+	chars = g_utf8_to_ucs4_fast (term, -1, &n_chars);
+	for (i = 0; i < n_chars; i++) {
+		gunichar c = ev_find_pattern_normalize (pattern, chars[i]);
+		guint    child;
+
+		child = ev_find_pattern_goto (pattern, node, c);
+		if (!child) {
+			EvFindPatternNode new_node = { NULL, 0, 0, 0 };
+
+			child = pattern->nodes->len;
+			g_array_append_val (pattern->nodes, new_node);
+			if (!NODE (pattern, node)->next)
+				NODE (pattern, node)->next = g_hash_table_new (NULL, NULL);
+			g_hash_table_insert (NODE (pattern, node)->next,
+					     GUINT_TO_POINTER (c),
+					     GUINT_TO_POINTER (child));
+		}
+		node = child;
+	}
+	g_free (chars);
+
+	if (node != 0)
+		NODE (pattern, node)->term_length = n_chars;
+}
+
+/* Sets the fail links breadth first, so that the fail link of a
+ * node, which is shorter, is always set before the node itself */
+static void
+ev_find_pattern_build_links (EvFindPattern *pattern)
+{
+	GQueue queue = G_QUEUE_INIT;
+
+	g_queue_push_tail (&queue, GUINT_TO_POINTER (0));
+	while (!g_queue_is_empty (&queue)) {
+		guint          node = GPOINTER_TO_UINT (g_queue_pop_head (&queue));
+		GHashTableIter iter;
+		gpointer       key, value;
+
+		if (!NODE (pattern, node)->next)
+			continue;
+
+		g_hash_table_iter_init (&iter, NODE (pattern, node)->next);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			gunichar c = GPOINTER_TO_UINT (key);
+			guint    child = GPOINTER_TO_UINT (value);
+			guint    fail = 0;
+
+			if (node != 0) {
+				fail = NODE (pattern, node)->fail;
+				while (fail != 0 && !ev_find_pattern_goto (pattern, fail, c))
+					fail = NODE (pattern, fail)->fail;
+				fail = ev_find_pattern_goto (pattern, fail, c);
+			}
+
+			NODE (pattern, child)->fail = fail;
+			NODE (pattern, child)->output = NODE (pattern, child)->term_length > 0 ?
+				child : NODE (pattern, fail)->output;
+			g_queue_push_tail (&queue, GUINT_TO_POINTER (child));
+		}
+	}
+}
+
+EvFindPattern *
+ev_find_pattern_new (const gchar   *text,
+		     EvFindOptions  options,
+		     GError       **error)
+{
+	EvFindPattern *pattern;
+
+	g_return_val_if_fail (text != NULL, NULL);
+	g_return_val_if_fail (options & EV_FIND_PATTERN_OPTIONS, NULL);
+
+	pattern = g_slice_new0 (EvFindPattern);
+	pattern->case_sensitive = (options & EV_FIND_CASE_SENSITIVE) != 0;
+	pattern->whole_words = (options & EV_FIND_WHOLE_WORDS_ONLY) != 0;
+
+	if (options & EV_FIND_REGEX) {
+		GRegexCompileFlags flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+		gchar             *regex;
+
+		if (!pattern->case_sensitive)
+			flags |= G_REGEX_CASELESS;
+
+		regex = pattern->whole_words ?
+			g_strdup_printf ("\\b(?:%s)\\b", text) : g_strdup (text);
+		pattern->regex = g_regex_new (regex, flags, 0, error);
+		g_free (regex);
+		if (!pattern->regex) {
+			ev_find_pattern_free (pattern);
+			return NULL;
+		}
+	} else {
+		EvFindPatternNode root = { NULL, 0, 0, 0 };
+		GPtrArray        *terms;
+		gchar           **split;
+		gint              i;
+
+		pattern->nodes = g_array_new (FALSE, FALSE, sizeof (EvFindPatternNode));
+		g_array_append_val (pattern->nodes, root);
+
+		terms = g_ptr_array_new ();
+		split = g_strsplit (text, "|", -1);
+		for (i = 0; split[i]; i++) {
+			gchar *term = g_strstrip (split[i]);
+
+			if (*term == '\0' || !g_utf8_validate (term, -1, NULL))
+				continue;
+
+			ev_find_pattern_add_term (pattern, term);
+			g_ptr_array_add (terms, g_strdup (term));
+		}
+		g_strfreev (split);
+		g_ptr_array_add (terms, NULL);
+		pattern->terms = (gchar **) g_ptr_array_free (terms, FALSE);
+
+		ev_find_pattern_build_links (pattern);
+	}
+
+	return pattern;
+}
+
+void
+ev_find_pattern_free (EvFindPattern *pattern)
+{
+	if (!pattern)
+		return;
+
+	if (pattern->regex)
+		g_regex_unref (pattern->regex);
+
+	if (pattern->nodes) {
+		guint i;
+
+		for (i = 0; i < pattern->nodes->len; i++) {
+			if (NODE (pattern, i)->next)
+				g_hash_table_destroy (NODE (pattern, i)->next);
+		}
+		g_array_free (pattern->nodes, TRUE);
+	}
+
+	g_strfreev (pattern->terms);
+	g_slice_free (EvFindPattern, pattern);
+}
+
+/* Returns the terms of an EV_FIND_ANY_TERM pattern, or %NULL */
+const gchar * const *
+ev_find_pattern_get_terms (EvFindPattern *pattern)
+{
+	g_return_val_if_fail (pattern != NULL, NULL);
+
+	return (const gchar * const *) pattern->terms;
+}
+
+static gboolean
+ev_find_pattern_is_word_boundary (const gunichar *chars,
+				  glong           n_chars,
+				  glong           start,
+				  glong           end)
+{
+	if (start > 0 && g_unichar_isalnum (chars[start - 1]))
+		return FALSE;
+
+	return end >= n_chars || !g_unichar_isalnum (chars[end]);
+}
+
+static void
+ev_find_pattern_match_terms (EvFindPattern *pattern,
+			     const gchar   *text,
+			     GArray        *matches)
+{
+	gunichar *chars;
+	glong     n_chars, i;
+	guint     node = 0;
+
+	chars = g_utf8_to_ucs4_fast (text, -1, &n_chars);
+	for (i = 0; i < n_chars; i++) {
+		gunichar c = ev_find_pattern_normalize (pattern, chars[i]);
+		guint    next;
+		guint    output;
+
+		while (node != 0 && !ev_find_pattern_goto (pattern, node, c))
+			node = NODE (pattern, node)->fail;
+		next = ev_find_pattern_goto (pattern, node, c);
+		node = next;
+
+		/* Every term ending here */
+		for (output = NODE (pattern, node)->output; output != 0;
+		     output = NODE (pattern, NODE (pattern, output)->fail)->output) {
+			EvFindPatternMatch match;
+
+			match.end = i + 1;
+			match.start = match.end - NODE (pattern, output)->term_length;
+			if (pattern->whole_words &&
+			    !ev_find_pattern_is_word_boundary (chars, n_chars, match.start, match.end))
+				continue;
+
+			g_array_append_val (matches, match);
+		}
+	}
+	g_free (chars);
+}
+
+static void
+ev_find_pattern_match_regex (EvFindPattern *pattern,
+			     const gchar   *text,
+			     GArray        *matches)
+{
+	GMatchInfo *match_info;
+	gint        last_byte = 0;
+	glong       last_char = 0;
+
+	g_regex_match (pattern->regex, text, 0, &match_info);
+	while (g_match_info_matches (match_info)) {
+		EvFindPatternMatch match;
+		gint               start, end;
+
+		if (g_match_info_fetch_pos (match_info, 0, &start, &end) && end > start) {
+			/* Matches come in order, so offsets are counted
+			 * from the previous one */
+			last_char += g_utf8_strlen (text + last_byte, start - last_byte);
+			last_byte = start;
+			match.start = last_char;
+			match.end = last_char + g_utf8_strlen (text + start, end - start);
+			g_array_append_val (matches, match);
+		}
+
+		g_match_info_next (match_info, NULL);
+	}
+	g_match_info_free (match_info);
+}
+
+static gint
+compare_matches (gconstpointer a,
+		 gconstpointer b)
+{
+	const EvFindPatternMatch *match_a = a;
+	const EvFindPatternMatch *match_b = b;
+
+	if (match_a->start != match_b->start)
+		return match_a->start < match_b->start ? -1 : 1;
+
+	/* Longest first */
+	if (match_a->end != match_b->end)
+		return match_a->end > match_b->end ? -1 : 1;
+
+	return 0;
+}
+
+/**
+ * ev_find_pattern_find:
+ * @pattern: an #EvFindPattern
+ * @text: the text of a page
+ * @areas: the text layout of the page, an area per character of @text
+ * @n_areas: the number of areas
+ * @rects: (element-type EvRectangle): array the rectangles of the
+ *   matches of @pattern in @text are appended to, in order
+ * @matches: (element-type guint): array the index of the match of
+ *   every rectangle appended to @rects is appended to
+ *
+ * Overlapping matches are reported once, as the leftmost and longest one.
+ *
+ * Returns: the number of matches
+ */
+guint
+ev_find_pattern_find (EvFindPattern *pattern,
+		      const gchar   *text,
+		      EvRectangle   *areas,
+		      guint          n_areas,
+		      GArray        *rects,
+		      GArray        *matches)
+{
+	GArray *found;
+	guint   last_end = 0;
+	guint   n_matches = 0;
+	guint   i;
+
+	g_return_val_if_fail (pattern != NULL, 0);
+
+	if (!text || !g_utf8_validate (text, -1, NULL))
+		return 0;
+
+	found = g_array_new (FALSE, FALSE, sizeof (EvFindPatternMatch));
+	if (pattern->regex)
+		ev_find_pattern_match_regex (pattern, text, found);
+	else
+		ev_find_pattern_match_terms (pattern, text, found);
+	g_array_sort (found, compare_matches);
+
+	for (i = 0; i < found->len; i++) {
+		EvFindPatternMatch *match = &g_array_index (found, EvFindPatternMatch, i);
+
+		if (match->start < last_end || match->start >= n_areas)
+			continue;
+
+		if (match->end <= match->start)
+			continue;
+
+		ev_text_layout_add_match_rectangles (areas, match->start, MIN (match->end, n_areas),
+						     n_matches++, rects, matches);
+		last_end = match->end;
+	}
+	g_array_free (found, TRUE);
+
+	return n_matches;
+}
@@ -0,0 +1,49 @@
+/* ev-find-pattern.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_FIND_PATTERN_H
+#define EV_FIND_PATTERN_H
+
+#include <glib.h>
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvFindPattern EvFindPattern;
+
+#define EV_FIND_PATTERN_OPTIONS (EV_FIND_REGEX | EV_FIND_ANY_TERM)
+
+EvFindPattern       *ev_find_pattern_new       (const gchar   *text,
+						EvFindOptions  options,
+						GError       **error);
+void                 ev_find_pattern_free      (EvFindPattern *pattern);
+const gchar * const *ev_find_pattern_get_terms (EvFindPattern *pattern);
+guint                ev_find_pattern_find      (EvFindPattern *pattern,
+						const gchar   *text,
+						EvRectangle   *areas,
+						guint          n_areas,
+						GArray        *rects,
+						GArray        *matches);
+
+G_END_DECLS
+
+#endif /* EV_FIND_PATTERN_H */
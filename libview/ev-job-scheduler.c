@@ -18,38 +18,222 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <stdlib.h>
+
 #include "ev-debug.h"
 #include "ev-job-scheduler.h"
+#include "ev-power-monitor.h"
+
+/* Upper bound for the number of worker threads picked by default */
+#define EV_JOB_SCHEDULER_DEFAULT_MAX_WORKERS 8
+
+/* Default share of the workers given to a client, and the largest one */
+#define EV_JOB_CLIENT_DEFAULT_WEIGHT 1
+#define EV_JOB_CLIENT_MAX_WEIGHT     64
+
+/* Bucket i of the time histograms counts the durations shorter than
+ * 2^i milliseconds, the last one everything longer */
+#define EV_JOB_STATS_N_BUCKETS 14
 
+/* While saving power, background jobs wait until no other job has
+ * been queued nor run for this long, in microseconds */
+#define EV_JOB_SCHEDULER_IDLE_TIME (5 * G_TIME_SPAN_SECOND)
+
+/* Scheduler jobs are linked into the job list and the queue of their
+ * client through links embedded in them, so that pushing, dequeuing
+ * and dropping a job doesn't allocate nor walk any list.
+ */
 typedef struct _EvSchedulerJob {
 	EvJob         *job;
 	EvJobPriority  priority;
-	GSList        *job_link;
+	GList          job_link;
+	GList          queue_link;
+
+	/* Client the job was pushed for, a lookup key only */
+	gpointer       client;
+	gboolean       queued;
+
+	/* Document the job was dequeued for, used as the
+	 * lane key while the job is running. Not a reference.
+	 */
+	EvDocument    *document;
+
+	gint64         queued_time;
+	gint64         started_time;
 } EvSchedulerJob;
 
-G_LOCK_DEFINE_STATIC(job_list);
-static GSList *job_list = NULL;
+/* The queued jobs of a client. Clients are served in order of
+ * virtual time within a priority, and every job started for a client
+ * advances its virtual time by an amount inversely proportional to its
+ * weight. A client stops existing when it has no queued jobs.
+ */
+typedef struct _EvJobClient {
+	gpointer client;
+	guint64  vtime;
+	guint    n_queued;
+	GQueue   queue[EV_JOB_N_PRIORITIES];
+} EvJobClient;
+
+/* Statistics of the thread jobs of a given type */
+typedef struct _EvJobTypeStats {
+	guint  n_pushed;
+	guint  n_finished;
+	guint  n_cancelled;
+	gint64 wait_total;
+	gint64 wait_max;
+	gint64 run_total;
+	gint64 run_max;
+	guint  wait_histogram[EV_JOB_STATS_N_BUCKETS];
+	guint  run_histogram[EV_JOB_STATS_N_BUCKETS];
+} EvJobTypeStats;
 
-static volatile EvJob *running_job = NULL;
+G_LOCK_DEFINE_STATIC(job_list);
+static GQueue job_list = G_QUEUE_INIT;
 
 static gpointer ev_job_thread_proxy               (gpointer        data);
 static void     ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 						   GCancellable   *cancellable);
 
 /* EvJobQueue */
-static GQueue queue_urgent = G_QUEUE_INIT;
-static GQueue queue_high = G_QUEUE_INIT;
-static GQueue queue_low = G_QUEUE_INIT;
-static GQueue queue_none = G_QUEUE_INIT;
 static GCond job_queue_cond;
 static GMutex job_queue_mutex;
 
-static GQueue *job_queue[EV_JOB_N_PRIORITIES] = {
-	&queue_urgent,
-	&queue_high,
-	&queue_low,
-	&queue_none
-};
+/* Clients with queued jobs and the weights set for clients, protected
+ * by job_queue_mutex. The virtual time is the one of the last job
+ * started, new clients start from it so that they can't claim the
+ * time they were idle.
+ */
+static GHashTable *job_clients = NULL;
+static GHashTable *client_weights = NULL;
+static guint64     job_queue_vtime = 0;
+static guint       queue_length[EV_JOB_N_PRIORITIES];
+
+/* Worker pool, protected by job_queue_mutex */
+static guint       n_workers = 0;
+static guint       n_idle_workers = 0;
+static guint       max_workers = 0;
+static GSList     *running_jobs = NULL;
+static GHashTable *busy_documents = NULL;
+
+/* Power saving state, protected by job_queue_mutex. While saving
+ * power a single job runs at a time, and background jobs are deferred
+ * until the other jobs have stopped for EV_JOB_SCHEDULER_IDLE_TIME.
+ */
+static gboolean    power_saving = FALSE;
+static guint       n_running_foreground = 0;
+static gint64      foreground_time = 0;
+
+/* Jobs cancelled while still queued, which never had to run */
+static guint       n_dropped_jobs = 0;
+
+/* Statistics, protected by job_queue_mutex */
+static GHashTable *job_stats = NULL;
+static guint       queue_peak[EV_JOB_N_PRIORITIES];
+
+static EvJobTypeStats *
+ev_job_stats_lookup_unlocked (EvJob *job)
+{
+	const gchar    *type_name = EV_GET_TYPE_NAME (job);
+	EvJobTypeStats *stats;
+
+	stats = g_hash_table_lookup (job_stats, type_name);
+	if (!stats) {
+		stats = g_new0 (EvJobTypeStats, 1);
+		/* Type names are interned, they don't need to be copied */
+		g_hash_table_insert (job_stats, (gpointer) type_name, stats);
+	}
+
+	return stats;
+}
+
+static void
+ev_job_stats_add_time (guint  *histogram,
+		       gint64 *total,
+		       gint64 *max,
+		       gint64  usecs)
+{
+	gint64 msecs = usecs / 1000;
+	gint   bucket = 0;
+
+	while (bucket < EV_JOB_STATS_N_BUCKETS - 1 && msecs >= ((gint64) 1 << bucket))
+		bucket++;
+
+	histogram[bucket]++;
+	*total += usecs;
+	*max = MAX (*max, usecs);
+}
+
+static guint
+ev_job_queue_get_max_running_unlocked (void)
+{
+	return power_saving ? 1 : max_workers;
+}
+
+static void
+ev_job_queue_spawn_worker_unlocked (void)
+{
+	GThread *thread;
+	guint    max_running = ev_job_queue_get_max_running_unlocked ();
+
+	if (n_idle_workers > 0 || n_workers >= max_running)
+		return;
+
+	ev_debug_message (DEBUG_JOBS, "Spawning worker %u of %u", n_workers + 1, max_running);
+
+	n_workers++;
+	thread = g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL);
+	g_thread_unref (thread);
+}
+
+static guint
+ev_job_client_get_weight_unlocked (gpointer client)
+{
+	guint weight;
+
+	weight = GPOINTER_TO_UINT (g_hash_table_lookup (client_weights, client));
+
+	return weight ? weight : EV_JOB_CLIENT_DEFAULT_WEIGHT;
+}
+
+static void
+ev_job_queue_add_unlocked (EvSchedulerJob *job)
+{
+	EvJobClient *client;
+
+	client = g_hash_table_lookup (job_clients, job->client);
+	if (!client) {
+		client = g_new0 (EvJobClient, 1);
+		client->client = job->client;
+		client->vtime = job_queue_vtime;
+		g_hash_table_insert (job_clients, job->client, client);
+	}
+
+	g_queue_push_tail_link (&client->queue[job->priority], &job->queue_link);
+	client->n_queued++;
+	job->queued = TRUE;
+
+	if (!job->job->background)
+		foreground_time = g_get_monotonic_time ();
+
+	queue_length[job->priority]++;
+	queue_peak[job->priority] = MAX (queue_peak[job->priority], queue_length[job->priority]);
+}
+
+static void
+ev_job_queue_remove_unlocked (EvSchedulerJob *job)
+{
+	EvJobClient *client;
+
+	client = g_hash_table_lookup (job_clients, job->client);
+	g_assert (client != NULL);
+
+	g_queue_unlink (&client->queue[job->priority], &job->queue_link);
+	job->queued = FALSE;
+	queue_length[job->priority]--;
+
+	if (--client->n_queued == 0)
+		g_hash_table_remove (job_clients, job->client);
+}
 
 static void
 ev_job_queue_push (EvSchedulerJob *job,
@@ -59,22 +243,84 @@ ev_job_queue_push (EvSchedulerJob *job,
 	
 	g_mutex_lock (&job_queue_mutex);
 
-	g_queue_push_tail (job_queue[priority], job);
+	job->queued_time = g_get_monotonic_time ();
+	ev_job_stats_lookup_unlocked (job->job)->n_pushed++;
+
+	ev_job_queue_add_unlocked (job);
+	ev_job_queue_spawn_worker_unlocked ();
 	g_cond_broadcast (&job_queue_cond);
 	
 	g_mutex_unlock (&job_queue_mutex);
 }
 
+static gboolean
+ev_job_queue_is_idle_unlocked (void)
+{
+	return n_running_foreground == 0 &&
+		g_get_monotonic_time () - foreground_time >= EV_JOB_SCHEDULER_IDLE_TIME;
+}
+
+/* Jobs for the same document run one at a time, unless
+ * the backend says it can cope with concurrent jobs.
+ */
+static gboolean
+ev_job_queue_job_is_runnable_unlocked (EvSchedulerJob *job)
+{
+	EvDocument *document = job->job->document;
+
+	if (power_saving && job->job->background && !ev_job_queue_is_idle_unlocked ())
+		return FALSE;
+
+	if (!document)
+		return TRUE;
+
+	if (!g_hash_table_contains (busy_documents, document))
+		return TRUE;
+
+	return ev_document_is_thread_safe (document);
+}
+
+/* Priorities are strict: a job is only started when no client has a
+ * runnable job of a higher priority, so the visible pages of any window
+ * go before the prefetching of every other one. Within a priority, the
+ * client that has been served least relative to its weight goes first.
+ */
 static EvSchedulerJob *
 ev_job_queue_get_next_unlocked (void)
 {
 	gint i;
 	EvSchedulerJob *job = NULL;
 	
-	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES; i++) {
-		job = (EvSchedulerJob *) g_queue_pop_head (job_queue[i]);
-		if (job)
-			break;
+	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES && !job; i++) {
+		GHashTableIter iter;
+		EvJobClient   *client, *best = NULL;
+		GList         *best_link = NULL;
+
+		if (queue_length[i] == 0)
+			continue;
+
+		g_hash_table_iter_init (&iter, job_clients);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &client)) {
+			GList *l;
+
+			if (best && client->vtime >= best->vtime)
+				continue;
+
+			for (l = client->queue[i].head; l; l = g_list_next (l)) {
+				if (ev_job_queue_job_is_runnable_unlocked ((EvSchedulerJob *) l->data)) {
+					best = client;
+					best_link = l;
+					break;
+				}
+			}
+		}
+
+		if (best) {
+			job = (EvSchedulerJob *) best_link->data;
+			job_queue_vtime = MAX (job_queue_vtime, best->vtime);
+			best->vtime += EV_JOB_CLIENT_MAX_WEIGHT / ev_job_client_get_weight_unlocked (best->client);
+			ev_job_queue_remove_unlocked (job);
+		}
 	}
 
 	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs in queue");
@@ -82,10 +328,157 @@ ev_job_queue_get_next_unlocked (void)
 	return job;
 }
 
+static void
+ev_job_queue_job_started_unlocked (EvSchedulerJob *job)
+{
+	EvJobTypeStats *stats = ev_job_stats_lookup_unlocked (job->job);
+
+	running_jobs = g_slist_prepend (running_jobs, job->job);
+	if (!job->job->background)
+		n_running_foreground++;
+
+	job->started_time = g_get_monotonic_time ();
+	ev_job_stats_add_time (stats->wait_histogram, &stats->wait_total, &stats->wait_max,
+			       job->started_time - job->queued_time);
+
+	job->document = job->job->document;
+	if (job->document) {
+		guint count;
+
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (busy_documents, job->document));
+		g_hash_table_insert (busy_documents, job->document, GUINT_TO_POINTER (count + 1));
+	}
+}
+
+static void
+ev_job_queue_job_stopped_unlocked (EvSchedulerJob *job)
+{
+	running_jobs = g_slist_remove (running_jobs, job->job);
+	if (!job->job->background) {
+		n_running_foreground--;
+		foreground_time = g_get_monotonic_time ();
+	}
+
+	/* Another job can take the only slot */
+	if (power_saving)
+		g_cond_broadcast (&job_queue_cond);
+
+	if (job->document) {
+		guint count;
+
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (busy_documents, job->document));
+		if (count > 1)
+			g_hash_table_insert (busy_documents, job->document, GUINT_TO_POINTER (count - 1));
+		else
+			g_hash_table_remove (busy_documents, job->document);
+		job->document = NULL;
+
+		/* Jobs waiting for this document's lane can run now */
+		g_cond_broadcast (&job_queue_cond);
+	}
+}
+
+static void
+ev_job_queue_job_finished (EvSchedulerJob *job)
+{
+	EvJobTypeStats *stats;
+
+	g_mutex_lock (&job_queue_mutex);
+
+	stats = ev_job_stats_lookup_unlocked (job->job);
+	if (g_cancellable_is_cancelled (job->job->cancellable))
+		stats->n_cancelled++;
+	else
+		stats->n_finished++;
+	ev_job_stats_add_time (stats->run_histogram, &stats->run_total, &stats->run_max,
+			       g_get_monotonic_time () - job->started_time);
+
+	ev_job_queue_job_stopped_unlocked (job);
+
+	g_mutex_unlock (&job_queue_mutex);
+}
+
+/* A job that runs in steps gives way between them to the jobs of a
+ * higher priority queued meanwhile, it's queued again behind them.
+ * Otherwise a long job would keep its document's lane, and the worker,
+ * until it's done. While saving power, a background job is deferred
+ * again as soon as any other job is queued.
+ */
+static gboolean
+ev_job_queue_job_yield (EvSchedulerJob *job)
+{
+	gboolean yield = FALSE;
+	gint     i;
+
+	g_mutex_lock (&job_queue_mutex);
+
+	for (i = EV_JOB_PRIORITY_URGENT; i < job->priority && !yield; i++)
+		yield = queue_length[i] > 0;
+	if (power_saving && job->job->background)
+		yield = yield || !ev_job_queue_is_idle_unlocked ();
+
+	if (yield) {
+		ev_debug_message (DEBUG_JOBS, "%s yields", EV_GET_TYPE_NAME (job->job));
+
+		ev_job_queue_job_stopped_unlocked (job);
+		job->queued_time = g_get_monotonic_time ();
+		ev_job_queue_add_unlocked (job);
+		g_cond_broadcast (&job_queue_cond);
+	}
+
+	g_mutex_unlock (&job_queue_mutex);
+
+	return yield;
+}
+
+static void
+power_changed_cb (EvPowerMonitor *monitor)
+{
+	gint i;
+
+	g_mutex_lock (&job_queue_mutex);
+
+	power_saving = ev_power_monitor_get_power_saving (monitor);
+	ev_debug_message (DEBUG_JOBS, "Power saving %s", power_saving ? "on" : "off");
+
+	/* Deferred jobs and the jobs waiting for a slot
+	 * can run now, on more workers if needed */
+	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES && !power_saving; i++) {
+		if (queue_length[i] > 0) {
+			ev_job_queue_spawn_worker_unlocked ();
+			break;
+		}
+	}
+	g_cond_broadcast (&job_queue_cond);
+
+	g_mutex_unlock (&job_queue_mutex);
+}
+
+/* The power monitor is created here, the first time a job is pushed
+ * from the main thread, so that its signals are emitted in the main loop */
 static gpointer
 ev_job_scheduler_init (gpointer data)
 {
-	g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL);
+	EvPowerMonitor *power_monitor;
+	const gchar *env;
+
+	busy_documents = g_hash_table_new (g_direct_hash, g_direct_equal);
+	job_clients = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	client_weights = g_hash_table_new (g_direct_hash, g_direct_equal);
+	job_stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+	env = g_getenv ("EV_JOB_SCHEDULER_WORKERS");
+	if (env)
+		max_workers = CLAMP (atoi (env), 1, 64);
+	else if (max_workers == 0)
+		max_workers = CLAMP (g_get_num_processors (), 1, EV_JOB_SCHEDULER_DEFAULT_MAX_WORKERS);
+
+	ev_debug_message (DEBUG_JOBS, "Using up to %u workers", max_workers);
+
+	power_monitor = ev_power_monitor_get_default ();
+	g_signal_connect (power_monitor, "changed",
+			  G_CALLBACK (power_changed_cb), NULL);
+	power_saving = ev_power_monitor_get_power_saving (power_monitor);
 
 	return NULL;
 }
@@ -97,8 +490,7 @@ ev_scheduler_job_list_add (EvSchedulerJob *job)
 	
 	G_LOCK (job_list);
 
-	job_list = g_slist_prepend (job_list, job);
-	job->job_link = job_list;
+	g_queue_push_head_link (&job_list, &job->job_link);
 	
 	G_UNLOCK (job_list);
 }
@@ -110,7 +502,7 @@ ev_scheduler_job_list_remove (EvSchedulerJob *job)
 	
 	G_LOCK (job_list);
 
-	job_list = g_slist_delete_link (job_list, job->job_link);
+	g_queue_unlink (&job_list, &job->job_link);
 	
 	G_UNLOCK (job_list);
 }
@@ -122,7 +514,7 @@ ev_scheduler_job_free (EvSchedulerJob *job)
 		return;
 
 	g_object_unref (job->job);
-	g_free (job);
+	g_slice_free (EvSchedulerJob, job);
 }
 
 static void
@@ -148,8 +540,6 @@ static void
 ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 				   GCancellable   *cancellable)
 {
-	GList   *list;
-	
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 
 	g_mutex_lock (&job_queue_mutex);
@@ -159,9 +549,12 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	 * If the job is currently running, it will be
 	 * destroyed as soon as it finishes. 
 	 */
-	list = g_queue_find (job_queue[job->priority], job);
-	if (list) {
-		g_queue_delete_link (job_queue[job->priority], list);
+	if (job->queued) {
+		ev_job_queue_remove_unlocked (job);
+		ev_job_stats_lookup_unlocked (job->job)->n_cancelled++;
+		n_dropped_jobs++;
+		ev_debug_message (DEBUG_JOBS, "Dropped %s before running it, %u jobs dropped so far",
+				  EV_GET_TYPE_NAME (job->job), n_dropped_jobs);
 		g_mutex_unlock (&job_queue_mutex);
 		ev_scheduler_job_destroy (job);
 	} else {
@@ -169,9 +562,11 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	}
 }
 
-static void
-ev_job_thread (EvJob *job)
+/* Returns TRUE if the job was queued again before finishing */
+static gboolean
+ev_job_thread (EvSchedulerJob *s_job)
 {
+	EvJob   *job = s_job->job;
 	gboolean result;
 
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job));
@@ -179,13 +574,14 @@ ev_job_thread (EvJob *job)
 	do {
 		if (g_cancellable_is_cancelled (job->cancellable))
 			result = FALSE;
-		else {
-                        g_atomic_pointer_set (&running_job, job);
+		else
 			result = ev_job_run (job);
-                }
+
+		if (result && ev_job_queue_job_yield (s_job))
+			return TRUE;
 	} while (result);
 
-        g_atomic_pointer_set (&running_job, NULL);
+	return FALSE;
 }
 
 static gboolean
@@ -206,35 +602,79 @@ ev_job_thread_proxy (gpointer data)
 		EvSchedulerJob *job;
 
 		g_mutex_lock (&job_queue_mutex);
-		job = ev_job_queue_get_next_unlocked ();
+		if (g_slist_length (running_jobs) < ev_job_queue_get_max_running_unlocked ())
+			job = ev_job_queue_get_next_unlocked ();
+		else
+			job = NULL;
 		if (!job) {
-			g_cond_wait (&job_queue_cond, &job_queue_mutex);
+			gint64 idle_time = foreground_time + EV_JOB_SCHEDULER_IDLE_TIME;
+
+			n_idle_workers++;
+			/* Wake up when the deferred jobs can run */
+			if (power_saving && idle_time > g_get_monotonic_time ())
+				g_cond_wait_until (&job_queue_cond, &job_queue_mutex, idle_time);
+			else
+				g_cond_wait (&job_queue_cond, &job_queue_mutex);
+			n_idle_workers--;
 			g_mutex_unlock (&job_queue_mutex);
 			continue;
 		}
+		ev_job_queue_job_started_unlocked (job);
 		g_mutex_unlock (&job_queue_mutex);
 		
-		ev_job_thread (job->job);
+		if (ev_job_thread (job))
+			continue;
+
+		ev_job_queue_job_finished (job);
 		ev_scheduler_job_destroy (job);
 	}
 
 	return NULL;
 }
 
+static GOnce once_init = G_ONCE_INIT;
+
 void
 ev_job_scheduler_push_job (EvJob         *job,
 			   EvJobPriority  priority)
 {
-	static GOnce once_init = G_ONCE_INIT;
+	ev_job_scheduler_push_job_for_client (job, priority, NULL);
+}
+
+/**
+ * ev_job_scheduler_push_job_for_client:
+ * @job: an #EvJob
+ * @priority: an #EvJobPriority
+ * @client: (allow-none): the object the job is done for, or %NULL
+ *
+ * Pushes @job like ev_job_scheduler_push_job(), on behalf of @client.
+ * Thread jobs of the same priority are shared between clients in
+ * proportion to their weight, see ev_job_scheduler_set_client_weight(),
+ * so that a client pushing many jobs doesn't delay the others. Higher
+ * priorities still always go first. Jobs pushed without a client share
+ * the %NULL client.
+ *
+ * @client is only used as a key, it is not referenced.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_scheduler_push_job_for_client (EvJob         *job,
+				      EvJobPriority  priority,
+				      gpointer       client)
+{
 	EvSchedulerJob *s_job;
 
 	g_once (&once_init, ev_job_scheduler_init, NULL);
 
 	ev_debug_message (DEBUG_JOBS, "%s pirority %d", EV_GET_TYPE_NAME (job), priority);
 
-	s_job = g_new0 (EvSchedulerJob, 1);
+	s_job = g_slice_new0 (EvSchedulerJob);
 	s_job->job = g_object_ref (job);
+	s_job->job_link.data = s_job;
+	s_job->queue_link.data = s_job;
 	s_job->priority = priority;
+	s_job->client = client;
 
 	ev_scheduler_job_list_add (s_job);
 	
@@ -266,7 +706,7 @@ void
 ev_job_scheduler_update_job (EvJob         *job,
 			     EvJobPriority  priority)
 {
-	GSList         *l;
+	GList          *l;
 	EvSchedulerJob *s_job = NULL;
 	gboolean        need_resort = FALSE;
 
@@ -278,7 +718,7 @@ ev_job_scheduler_update_job (EvJob         *job,
 	
 	G_LOCK (job_list);
 
-	for (l = job_list; l; l = l->next) {
+	for (l = job_list.head; l; l = l->next) {
 		s_job = (EvSchedulerJob *)l->data;
 
 		if (s_job->job == job) {
@@ -290,16 +730,23 @@ ev_job_scheduler_update_job (EvJob         *job,
 	G_UNLOCK (job_list);
 
 	if (need_resort) {
-		GList *list;
-	
+		EvJobClient *client;
+
 		g_mutex_lock (&job_queue_mutex);
 		
-		list = g_queue_find (job_queue[s_job->priority], s_job);
-		if (list) {
+		if (s_job->queued) {
 			ev_debug_message (DEBUG_JOBS, "Moving job %s from pirority %d to %d",
 					  EV_GET_TYPE_NAME (job), s_job->priority, priority);
-			g_queue_delete_link (job_queue[s_job->priority], list);
-			g_queue_push_tail (job_queue[priority], s_job);
+			/* Move the job within its client, so that
+			 * the client keeps its virtual time.
+			 */
+			client = g_hash_table_lookup (job_clients, s_job->client);
+			g_queue_unlink (&client->queue[s_job->priority], &s_job->queue_link);
+			queue_length[s_job->priority]--;
+			s_job->priority = priority;
+			g_queue_push_tail_link (&client->queue[priority], &s_job->queue_link);
+			queue_length[priority]++;
+			queue_peak[priority] = MAX (queue_peak[priority], queue_length[priority]);
 			g_cond_broadcast (&job_queue_cond);
 		}
 		
@@ -307,13 +754,234 @@ ev_job_scheduler_update_job (EvJob         *job,
 	}
 }
 
+/**
+ * ev_job_scheduler_set_client_weight:
+ * @client: (allow-none): a client passed to ev_job_scheduler_push_job_for_client()
+ * @weight: the weight of @client, or 0 to use the default one
+ *
+ * Sets the share of the worker threads given to @client when several
+ * clients have queued jobs of the same priority. A client with weight 4
+ * gets four jobs started for every job of a client with the default
+ * weight of 1. Weights are clamped to 64.
+ *
+ * Weights are kept until they are reset to 0, so the client should do
+ * that when it goes away.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_scheduler_set_client_weight (gpointer client,
+				    guint    weight)
+{
+	g_once (&once_init, ev_job_scheduler_init, NULL);
+
+	g_mutex_lock (&job_queue_mutex);
+	if (weight == 0)
+		g_hash_table_remove (client_weights, client);
+	else
+		g_hash_table_insert (client_weights, client,
+				     GUINT_TO_POINTER (MIN (weight, EV_JOB_CLIENT_MAX_WEIGHT)));
+	g_mutex_unlock (&job_queue_mutex);
+}
+
 /**
  * ev_job_scheduler_get_running_thread_job:
  *
+ * Since the scheduler can run several thread jobs at the same time,
+ * this only returns the most recently started one. Use
+ * ev_job_scheduler_is_job_running() to check a particular job.
+ *
  * Returns: (transfer none): an #EvJob
  */
 EvJob *
 ev_job_scheduler_get_running_thread_job (void)
 {
-        return g_atomic_pointer_get (&running_job);
+	EvJob *job;
+
+	g_mutex_lock (&job_queue_mutex);
+	job = running_jobs ? EV_JOB (running_jobs->data) : NULL;
+	g_mutex_unlock (&job_queue_mutex);
+
+	return job;
+}
+
+/**
+ * ev_job_scheduler_is_job_running:
+ * @job: an #EvJob
+ *
+ * Returns: %TRUE if @job is currently being run by a worker thread
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_job_scheduler_is_job_running (EvJob *job)
+{
+	gboolean retval;
+
+	g_mutex_lock (&job_queue_mutex);
+	retval = g_slist_find (running_jobs, job) != NULL;
+	g_mutex_unlock (&job_queue_mutex);
+
+	return retval;
+}
+
+/**
+ * ev_job_scheduler_set_max_workers:
+ * @n_workers: the maximum number of worker threads
+ *
+ * Sets the maximum number of threads used to run thread jobs.
+ * Workers are spawned on demand, so lowering the limit does not
+ * stop workers that are already running. The EV_JOB_SCHEDULER_WORKERS
+ * environment variable takes precedence over this value.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_scheduler_set_max_workers (guint n_workers)
+{
+	g_return_if_fail (n_workers > 0);
+
+	g_mutex_lock (&job_queue_mutex);
+	if (!g_getenv ("EV_JOB_SCHEDULER_WORKERS"))
+		max_workers = n_workers;
+	g_mutex_unlock (&job_queue_mutex);
+}
+
+/**
+ * ev_job_scheduler_get_n_dropped_jobs:
+ *
+ * Returns the number of thread jobs that were cancelled while waiting
+ * in the queue, for example render jobs superseded by a newer request
+ * for the same page, so they never had to run.
+ *
+ * Returns: the number of jobs dropped from the queue so far
+ *
+ * Since: 3.30
+ */
+guint
+ev_job_scheduler_get_n_dropped_jobs (void)
+{
+	guint retval;
+
+	g_mutex_lock (&job_queue_mutex);
+	retval = n_dropped_jobs;
+	g_mutex_unlock (&job_queue_mutex);
+
+	return retval;
+}
+
+static GVariant *
+ev_job_stats_histogram_to_variant (const guint *histogram)
+{
+	GVariantBuilder builder;
+	gint            i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("au"));
+	for (i = 0; i < EV_JOB_STATS_N_BUCKETS; i++)
+		g_variant_builder_add (&builder, "u", histogram[i]);
+
+	return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+ev_job_stats_to_variant (const EvJobTypeStats *stats)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "pushed", g_variant_new_uint32 (stats->n_pushed));
+	g_variant_builder_add (&builder, "{sv}", "finished", g_variant_new_uint32 (stats->n_finished));
+	g_variant_builder_add (&builder, "{sv}", "cancelled", g_variant_new_uint32 (stats->n_cancelled));
+	g_variant_builder_add (&builder, "{sv}", "wait-total", g_variant_new_int64 (stats->wait_total));
+	g_variant_builder_add (&builder, "{sv}", "wait-max", g_variant_new_int64 (stats->wait_max));
+	g_variant_builder_add (&builder, "{sv}", "wait-histogram",
+			       ev_job_stats_histogram_to_variant (stats->wait_histogram));
+	g_variant_builder_add (&builder, "{sv}", "run-total", g_variant_new_int64 (stats->run_total));
+	g_variant_builder_add (&builder, "{sv}", "run-max", g_variant_new_int64 (stats->run_max));
+	g_variant_builder_add (&builder, "{sv}", "run-histogram",
+			       ev_job_stats_histogram_to_variant (stats->run_histogram));
+
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * ev_job_scheduler_get_stats:
+ *
+ * Returns a snapshot of the scheduler statistics for thread jobs, as
+ * a dictionary with the following keys:
+ *
+ * - "workers", "max-workers": the number of worker threads, as uint32
+ * - "power-saving": whether the device saves power, so that a single
+ *   job runs at a time and background jobs are deferred, as boolean
+ * - "queue-length", "queue-peak": the current and the largest number of
+ *   queued jobs for each #EvJobPriority, as an array of uint32
+ * - "dropped-jobs": see ev_job_scheduler_get_n_dropped_jobs()
+ * - "clients": the number of clients with queued jobs, as uint32
+ * - "running-jobs": the type names of the jobs being run, most recently
+ *   started first, as an array of strings
+ * - "job-types": a dictionary with the statistics of each job type,
+ *   indexed by type name. They are dictionaries with the number of jobs
+ *   "pushed", "finished" and "cancelled", and the "wait-" and "run-"
+ *   "total" and "max" times in the queue and running, in microseconds,
+ *   with the matching "histogram". Bucket i of the histograms counts
+ *   the times shorter than 2^i milliseconds, the last bucket everything
+ *   longer.
+ *
+ * Returns: (transfer full): a floating #GVariant of type a{sv}
+ *
+ * Since: 3.30
+ */
+GVariant *
+ev_job_scheduler_get_stats (void)
+{
+	GVariantBuilder builder;
+	GVariantBuilder length_builder;
+	GVariantBuilder peak_builder;
+	GVariantBuilder types_builder;
+	GVariantBuilder running_builder;
+	GHashTableIter  iter;
+	gpointer        key, value;
+	GSList         *l;
+	gint            i;
+
+	g_once (&once_init, ev_job_scheduler_init, NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_init (&length_builder, G_VARIANT_TYPE ("au"));
+	g_variant_builder_init (&peak_builder, G_VARIANT_TYPE ("au"));
+	g_variant_builder_init (&types_builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_init (&running_builder, G_VARIANT_TYPE_STRING_ARRAY);
+
+	g_mutex_lock (&job_queue_mutex);
+
+	/* Running jobs are referenced by the scheduler until they stop,
+	 * which makes this safe from any thread */
+	for (l = running_jobs; l; l = l->next)
+		g_variant_builder_add (&running_builder, "s", EV_GET_TYPE_NAME (l->data));
+
+	for (i = 0; i < EV_JOB_N_PRIORITIES; i++) {
+		g_variant_builder_add (&length_builder, "u", queue_length[i]);
+		g_variant_builder_add (&peak_builder, "u", queue_peak[i]);
+	}
+
+	g_hash_table_iter_init (&iter, job_stats);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		g_variant_builder_add (&types_builder, "{sv}", (const gchar *) key,
+				       ev_job_stats_to_variant ((EvJobTypeStats *) value));
+	}
+
+	g_variant_builder_add (&builder, "{sv}", "workers", g_variant_new_uint32 (n_workers));
+	g_variant_builder_add (&builder, "{sv}", "max-workers", g_variant_new_uint32 (max_workers));
+	g_variant_builder_add (&builder, "{sv}", "power-saving", g_variant_new_boolean (power_saving));
+	g_variant_builder_add (&builder, "{sv}", "dropped-jobs", g_variant_new_uint32 (n_dropped_jobs));
+	g_variant_builder_add (&builder, "{sv}", "clients", g_variant_new_uint32 (g_hash_table_size (job_clients)));
+
+	g_mutex_unlock (&job_queue_mutex);
+
+	g_variant_builder_add (&builder, "{sv}", "queue-length", g_variant_builder_end (&length_builder));
+	g_variant_builder_add (&builder, "{sv}", "queue-peak", g_variant_builder_end (&peak_builder));
+	g_variant_builder_add (&builder, "{sv}", "job-types", g_variant_builder_end (&types_builder));
+	g_variant_builder_add (&builder, "{sv}", "running-jobs", g_variant_builder_end (&running_builder));
+
+	return g_variant_builder_end (&builder);
 }
@@ -38,11 +38,20 @@ typedef enum {
 	EV_JOB_N_PRIORITIES
 } EvJobPriority;
 
-void   ev_job_scheduler_push_job               (EvJob        *job,
-                                                EvJobPriority priority);
-void   ev_job_scheduler_update_job             (EvJob        *job,
-                                                EvJobPriority priority);
-EvJob *ev_job_scheduler_get_running_thread_job (void);
+void     ev_job_scheduler_push_job               (EvJob        *job,
+                                                  EvJobPriority priority);
+void     ev_job_scheduler_push_job_for_client    (EvJob        *job,
+                                                  EvJobPriority priority,
+                                                  gpointer      client);
+void     ev_job_scheduler_update_job             (EvJob        *job,
+                                                  EvJobPriority priority);
+void     ev_job_scheduler_set_client_weight      (gpointer      client,
+                                                  guint         weight);
+EvJob   *ev_job_scheduler_get_running_thread_job (void);
+gboolean ev_job_scheduler_is_job_running         (EvJob        *job);
+void     ev_job_scheduler_set_max_workers        (guint         n_workers);
+guint    ev_job_scheduler_get_n_dropped_jobs     (void);
+GVariant *ev_job_scheduler_get_stats             (void);
 
 G_END_DECLS
 
@@ -37,9 +37,14 @@
 #include "ev-document-attachments.h"
 #include "ev-document-media.h"
 #include "ev-document-text.h"
+#include "ev-find-pattern.h"
+#include "ev-surface-pool.h"
+#include "ev-render-stats.h"
+#include "ev-view-marshal.h"
 #include "ev-debug.h"
 
 #include <errno.h>
+#include <string.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 #include <unistd.h>
@@ -58,16 +63,22 @@ static void ev_job_page_data_init         (EvJobPageData         *job);
 static void ev_job_page_data_class_init   (EvJobPageDataClass    *class);
 static void ev_job_thumbnail_init         (EvJobThumbnail        *job);
 static void ev_job_thumbnail_class_init   (EvJobThumbnailClass   *class);
+static void ev_job_thumbnail_batch_init   (EvJobThumbnailBatch   *job);
+static void ev_job_thumbnail_batch_class_init (EvJobThumbnailBatchClass *class);
 static void ev_job_load_init    	  (EvJobLoad	         *job);
 static void ev_job_load_class_init 	  (EvJobLoadClass	 *class);
 static void ev_job_save_init              (EvJobSave             *job);
 static void ev_job_save_class_init        (EvJobSaveClass        *class);
 static void ev_job_find_init              (EvJobFind             *job);
 static void ev_job_find_class_init        (EvJobFindClass        *class);
+static void ev_job_find_index_init        (EvJobFindIndex        *job);
+static void ev_job_find_index_class_init  (EvJobFindIndexClass   *class);
 static void ev_job_layers_init            (EvJobLayers           *job);
 static void ev_job_layers_class_init      (EvJobLayersClass      *class);
 static void ev_job_export_init            (EvJobExport           *job);
 static void ev_job_export_class_init      (EvJobExportClass      *class);
+static void ev_job_export_render_init     (EvJobExportRender     *job);
+static void ev_job_export_render_class_init (EvJobExportRenderClass *class);
 static void ev_job_print_init             (EvJobPrint            *job);
 static void ev_job_print_class_init       (EvJobPrintClass       *class);
 
@@ -87,28 +98,71 @@ enum {
 	FIND_LAST_SIGNAL
 };
 
+enum {
+	SELECTED_TEXT_UPDATED,
+	SELECTED_TEXT_LAST_SIGNAL
+};
+
+enum {
+	LOAD_UPDATED,
+	LOAD_LAST_SIGNAL
+};
+
+enum {
+	THUMBNAIL_READY,
+	THUMBNAIL_BATCH_LAST_SIGNAL
+};
+
+enum {
+	ANNOTS_READY,
+	ANNOTS_LAST_SIGNAL
+};
+
 static guint job_signals[LAST_SIGNAL] = { 0 };
 static guint job_fonts_signals[FONTS_LAST_SIGNAL] = { 0 };
 static guint job_find_signals[FIND_LAST_SIGNAL] = { 0 };
+static guint job_selected_text_signals[SELECTED_TEXT_LAST_SIGNAL] = { 0 };
+static guint job_load_signals[LOAD_LAST_SIGNAL] = { 0 };
+static guint job_thumbnail_batch_signals[THUMBNAIL_BATCH_LAST_SIGNAL] = { 0 };
+static guint job_annots_signals[ANNOTS_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_ABSTRACT_TYPE (EvJob, ev_job, G_TYPE_OBJECT)
 G_DEFINE_TYPE (EvJobLinks, ev_job_links, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobAttachments, ev_job_attachments, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobAnnots, ev_job_annots, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobRender, ev_job_render, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobSelection, ev_job_selection, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobPageData, ev_job_page_data, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobThumbnail, ev_job_thumbnail, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobThumbnailBatch, ev_job_thumbnail_batch, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobFonts, ev_job_fonts, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobSelectedText, ev_job_selected_text, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoad, ev_job_load, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoadStream, ev_job_load_stream, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoadGFile, ev_job_load_gfile, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobSave, ev_job_save, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobFind, ev_job_find, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobFindIndex, ev_job_find_index, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLayers, ev_job_layers, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobExport, ev_job_export, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobExportRender, ev_job_export_render, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobPrint, ev_job_print, EV_TYPE_JOB)
 
 /* EvJob */
+typedef struct {
+	EvJobThenFunc  func;
+	gpointer       user_data;
+	GDestroyNotify destroy;
+} EvJobContinuation;
+
+static void
+ev_job_continuation_free (EvJobContinuation *continuation)
+{
+	if (continuation->destroy)
+		continuation->destroy (continuation->user_data);
+	g_slice_free (EvJobContinuation, continuation);
+}
+
 static void
 ev_job_init (EvJob *job)
 {
@@ -137,6 +191,11 @@ ev_job_dispose (GObject *object)
 		job->error = NULL;
 	}
 
+	if (job->continuations) {
+		g_slist_free_full (job->continuations, (GDestroyNotify) ev_job_continuation_free);
+		job->continuations = NULL;
+	}
+
 	(* G_OBJECT_CLASS (ev_job_parent_class)->dispose) (object);
 }
 
@@ -184,6 +243,109 @@ emit_finished (EvJob *job)
 	return FALSE;
 }
 
+/* Jobs finished in threads are queued and delivered to the main loop
+ * together, at most once per frame, instead of one idle per job.
+ * Listeners that want to react to the whole batch at once, like the
+ * pixbuf cache redrawing the view, register a one shot notify with
+ * _ev_job_notify_after_batch() from their finished handler.
+ */
+#define COMPLETION_INTERVAL_MS 16
+
+typedef struct {
+	GFunc    func;
+	gpointer user_data;
+} BatchNotify;
+
+static GMutex   completion_mutex;
+static GQueue   completion_queue = G_QUEUE_INIT;
+static guint    completion_source_id = 0;
+static gint64   completion_last_time = 0;
+static gboolean completion_in_batch = FALSE;
+static GSList  *completion_notifies = NULL;
+
+static gboolean
+deliver_finished_jobs (gpointer user_data)
+{
+	GQueue  jobs = G_QUEUE_INIT;
+	GSList *notifies, *l;
+	EvJob  *job;
+
+	g_mutex_lock (&completion_mutex);
+	jobs = completion_queue;
+	g_queue_init (&completion_queue);
+	completion_source_id = 0;
+	completion_last_time = g_get_monotonic_time ();
+	g_mutex_unlock (&completion_mutex);
+
+	ev_debug_message (DEBUG_JOBS, "delivering %u finished jobs", jobs.length);
+
+	completion_in_batch = TRUE;
+	while ((job = g_queue_pop_head (&jobs))) {
+		emit_finished (job);
+		g_object_unref (job);
+	}
+	completion_in_batch = FALSE;
+
+	notifies = g_slist_reverse (completion_notifies);
+	completion_notifies = NULL;
+	for (l = notifies; l; l = g_slist_next (l)) {
+		BatchNotify *notify = (BatchNotify *) l->data;
+
+		notify->func (notify->user_data, NULL);
+		g_slice_free (BatchNotify, notify);
+	}
+	g_slist_free (notifies);
+
+	return FALSE;
+}
+
+static void
+queue_finished_job (EvJob *job)
+{
+	g_mutex_lock (&completion_mutex);
+	g_queue_push_tail (&completion_queue, g_object_ref (job));
+	if (completion_source_id == 0) {
+		gint64 elapsed;
+		guint  delay = 0;
+
+		elapsed = (g_get_monotonic_time () - completion_last_time) / 1000;
+		if (elapsed >= 0 && elapsed < COMPLETION_INTERVAL_MS)
+			delay = COMPLETION_INTERVAL_MS - elapsed;
+		completion_source_id = g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE,
+							   delay,
+							   deliver_finished_jobs,
+							   NULL, NULL);
+	}
+	job->idle_finished_id = completion_source_id;
+	g_mutex_unlock (&completion_mutex);
+}
+
+/*
+ * _ev_job_notify_after_batch:
+ * @func: function called once the current batch has been delivered
+ * @user_data: data passed to @func
+ *
+ * Called from a "finished" handler, @func runs after the finished
+ * signal of every job in the same batch has been emitted. Outside of
+ * a batch @func is called right away.
+ */
+void
+_ev_job_notify_after_batch (GFunc    func,
+			    gpointer user_data)
+{
+	BatchNotify *notify;
+
+	if (!completion_in_batch) {
+		func (user_data, NULL);
+		return;
+	}
+
+	notify = g_slice_new (BatchNotify);
+	notify->func = func;
+	notify->user_data = user_data;
+	completion_notifies = g_slist_prepend (completion_notifies, notify);
+}
+
 static void
 ev_job_emit_finished (EvJob *job)
 {
@@ -195,13 +357,24 @@ ev_job_emit_finished (EvJob *job)
 	}
 	
 	job->finished = TRUE;
+
+	/* Continuations run before the main loop hears about the job,
+	 * the jobs they push can be started by the worker right away */
+	if (!job->failed && job->continuations) {
+		GSList *continuations, *l;
+
+		continuations = g_slist_reverse (job->continuations);
+		job->continuations = NULL;
+		for (l = continuations; l; l = g_slist_next (l)) {
+			EvJobContinuation *continuation = (EvJobContinuation *) l->data;
+
+			continuation->func (job, continuation->user_data);
+		}
+		g_slist_free_full (continuations, (GDestroyNotify) ev_job_continuation_free);
+	}
 	
 	if (job->run_mode == EV_JOB_RUN_THREAD) {
-		job->idle_finished_id =
-			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-					 (GSourceFunc)emit_finished,
-					 g_object_ref (job),
-					 (GDestroyNotify)g_object_unref);
+		queue_finished_job (job);
 	} else {
 		ev_profiler_stop (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 		g_signal_emit (job, job_signals[FINISHED], 0);
@@ -308,6 +481,44 @@ ev_job_is_failed (EvJob *job)
 	return job->failed;
 }
 
+/**
+ * ev_job_then:
+ * @job: an #EvJob
+ * @func: (scope notified): function to call when @job succeeds
+ * @user_data: data to pass to @func
+ * @destroy: (allow-none): function to free @user_data
+ *
+ * Chains @func to @job. @func is called in the thread that runs @job,
+ * as soon as it succeeds and before #EvJob::finished is emitted in the
+ * main loop, so that jobs depending on the result of @job, like
+ * rendering the first page of a document that has just been loaded,
+ * can be pushed to the scheduler without waiting for the main loop.
+ *
+ * @func is not called if @job fails or is cancelled. It must not call
+ * into GTK+.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_then (EvJob         *job,
+	     EvJobThenFunc  func,
+	     gpointer       user_data,
+	     GDestroyNotify destroy)
+{
+	EvJobContinuation *continuation;
+
+	g_return_if_fail (EV_IS_JOB (job));
+	g_return_if_fail (func != NULL);
+	g_return_if_fail (!job->finished);
+
+	continuation = g_slice_new (EvJobContinuation);
+	continuation->func = func;
+	continuation->user_data = user_data;
+	continuation->destroy = destroy;
+
+	job->continuations = g_slist_prepend (job->continuations, continuation);
+}
+
 EvJobRunMode
 ev_job_get_run_mode (EvJob *job)
 {
@@ -321,6 +532,45 @@ ev_job_set_run_mode (EvJob       *job,
 	job->run_mode = run_mode;
 }
 
+/**
+ * ev_job_is_background:
+ * @job: an #EvJob
+ *
+ * Returns: %TRUE if @job was marked as background work with
+ *   ev_job_set_background()
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_job_is_background (EvJob *job)
+{
+	g_return_val_if_fail (EV_IS_JOB (job), FALSE);
+
+	return job->background;
+}
+
+/**
+ * ev_job_set_background:
+ * @job: an #EvJob
+ * @background: whether @job is background work
+ *
+ * Marks @job as work nobody is waiting for, like prefetching pages or
+ * indexing the document. While the device saves power, the scheduler
+ * defers background jobs until it has had nothing else to do for a
+ * while, or the device is plugged in. It must be set before @job is
+ * pushed.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_set_background (EvJob   *job,
+		       gboolean background)
+{
+	g_return_if_fail (EV_IS_JOB (job));
+
+	job->background = background != FALSE;
+}
+
 /* EvJobLinks */
 static void
 ev_job_links_init (EvJobLinks *job)
@@ -385,9 +635,9 @@ ev_job_links_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	job_links->model = ev_document_links_get_links_model (EV_DOCUMENT_LINKS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	gtk_tree_model_foreach (job_links->model, (GtkTreeModelForeachFunc)fill_page_labels, job);
 
@@ -468,10 +718,10 @@ ev_job_attachments_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	job_attachments->attachments =
 		ev_document_attachments_get_attachments (EV_DOCUMENT_ATTACHMENTS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -502,10 +752,17 @@ ev_job_attachments_new (EvDocument *document)
 }
 
 /* EvJobAnnots */
+
+/* Pages whose annotations are loaded with the document locked once */
+#define EV_JOB_ANNOTS_GROUP_SIZE 32
+
 static void
 ev_job_annots_init (EvJobAnnots *job)
 {
 	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+
+	g_mutex_init (&job->mutex);
+	g_queue_init (&job->ready);
 }
 
 static void
@@ -517,44 +774,105 @@ ev_job_annots_dispose (GObject *object)
 
 	job = EV_JOB_ANNOTS (object);
 
-	if (job->annots) {
-		g_list_foreach (job->annots, (GFunc)ev_mapping_list_unref, NULL);
-		g_list_free (job->annots);
-		job->annots = NULL;
-	}
+	g_mutex_lock (&job->mutex);
+	g_queue_foreach (&job->ready, (GFunc) ev_mapping_list_unref, NULL);
+	g_queue_clear (&job->ready);
+	g_mutex_unlock (&job->mutex);
 
 	G_OBJECT_CLASS (ev_job_annots_parent_class)->dispose (object);
 }
 
+static void
+ev_job_annots_finalize (GObject *object)
+{
+	EvJobAnnots *job = EV_JOB_ANNOTS (object);
+
+	g_mutex_clear (&job->mutex);
+
+	G_OBJECT_CLASS (ev_job_annots_parent_class)->finalize (object);
+}
+
+/* Emits annots-ready for the pages loaded since the last time */
+static gboolean
+ev_job_annots_emit_ready (EvJobAnnots *job_annots)
+{
+	EvJob    *job = EV_JOB (job_annots);
+	GQueue    ready;
+	gboolean  done;
+
+	g_mutex_lock (&job_annots->mutex);
+	job_annots->idle_ready_id = 0;
+	ready = job_annots->ready;
+	g_queue_init (&job_annots->ready);
+	done = job_annots->done;
+	g_mutex_unlock (&job_annots->mutex);
+
+	while (!g_queue_is_empty (&ready)) {
+		EvMappingList *mapping_list = g_queue_pop_head (&ready);
+
+		if (!job->cancelled)
+			g_signal_emit (job_annots, job_annots_signals[ANNOTS_READY], 0,
+				       mapping_list);
+		ev_mapping_list_unref (mapping_list);
+	}
+
+	if (done && !job->cancelled)
+		ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_annots_queue_ready_unlocked (EvJobAnnots *job)
+{
+	if (job->idle_ready_id > 0)
+		return;
+
+	job->idle_ready_id =
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				 (GSourceFunc)ev_job_annots_emit_ready,
+				 g_object_ref (job),
+				 (GDestroyNotify)g_object_unref);
+}
+
 static gboolean
 ev_job_annots_run (EvJob *job)
 {
 	EvJobAnnots *job_annots = EV_JOB_ANNOTS (job);
+	GQueue       group = G_QUEUE_INIT;
 	gint         i;
 
-	ev_debug_message (DEBUG_JOBS, NULL);
+	ev_debug_message (DEBUG_JOBS, "%d pages from %d", EV_JOB_ANNOTS_GROUP_SIZE,
+			  (job_annots->start_page + job_annots->n_visited) % MAX (job_annots->n_pages, 1));
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
-	for (i = 0; i < ev_document_get_n_pages (job->document); i++) {
+	ev_document_lock (job->document);
+	for (i = 0; i < EV_JOB_ANNOTS_GROUP_SIZE && job_annots->n_visited < job_annots->n_pages; i++) {
 		EvMappingList *mapping_list;
 		EvPage        *page;
+		gint           index;
 
-		page = ev_document_get_page (job->document, i);
+		index = (job_annots->start_page + job_annots->n_visited) % job_annots->n_pages;
+		job_annots->n_visited++;
+
+		page = ev_document_get_page (job->document, index);
 		mapping_list = ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (job->document),
 									page);
 		g_object_unref (page);
 
 		if (mapping_list)
-			job_annots->annots = g_list_prepend (job_annots->annots, mapping_list);
+			g_queue_push_tail (&group, mapping_list);
 	}
-	ev_document_doc_mutex_unlock ();
-
-	job_annots->annots = g_list_reverse (job_annots->annots);
+	ev_document_unlock (job->document);
 
-	ev_job_succeeded (job);
+	g_mutex_lock (&job_annots->mutex);
+	while (!g_queue_is_empty (&group))
+		g_queue_push_tail (&job_annots->ready, g_queue_pop_head (&group));
+	job_annots->done = job_annots->n_visited == job_annots->n_pages;
+	ev_job_annots_queue_ready_unlocked (job_annots);
+	g_mutex_unlock (&job_annots->mutex);
 
-	return FALSE;
+	return !job_annots->done;
 }
 
 static void
@@ -564,20 +882,73 @@ ev_job_annots_class_init (EvJobAnnotsClass *class)
 	EvJobClass   *job_class = EV_JOB_CLASS (class);
 
 	oclass->dispose = ev_job_annots_dispose;
+	oclass->finalize = ev_job_annots_finalize;
 	job_class->run = ev_job_annots_run;
+
+	/**
+	 * EvJobAnnots::annots-ready:
+	 * @job: the #EvJobAnnots
+	 * @mapping_list: the #EvMappingList of the annotations of a page
+	 *
+	 * Emitted in the main thread for every page with annotations,
+	 * in groups. The job doesn't keep @mapping_list afterwards.
+	 *
+	 * Since: 3.30
+	 */
+	job_annots_signals[ANNOTS_READY] =
+		g_signal_new ("annots-ready",
+			      EV_TYPE_JOB_ANNOTS,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobAnnotsClass, annots_ready),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1, G_TYPE_POINTER);
 }
 
+/**
+ * ev_job_annots_new:
+ * @document: an #EvDocument implementing #EvDocumentAnnotations
+ *
+ * Creates a job that loads the annotations of all the pages of
+ * @document. #EvJobAnnots::annots-ready is emitted while they are
+ * loaded, starting at the page set with ev_job_annots_set_start_page()
+ * and wrapping around at the end of the document.
+ *
+ * Returns: (transfer full): a new #EvJobAnnots
+ */
 EvJob *
 ev_job_annots_new (EvDocument *document)
 {
-	EvJob *job;
+	EvJobAnnots *job;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 
 	job = g_object_new (EV_TYPE_JOB_ANNOTS, NULL);
-	job->document = g_object_ref (document);
+	EV_JOB (job)->document = g_object_ref (document);
+	job->n_pages = ev_document_get_n_pages (document);
+	job->done = job->n_pages == 0;
 
-	return job;
+	return EV_JOB (job);
+}
+
+/**
+ * ev_job_annots_set_start_page:
+ * @job: an #EvJobAnnots
+ * @start_page: the page to load first
+ *
+ * Sets the page the annotations are loaded from. It must be set
+ * before @job is scheduled.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_annots_set_start_page (EvJobAnnots *job,
+			      gint         start_page)
+{
+	g_return_if_fail (EV_IS_JOB_ANNOTS (job));
+
+	job->start_page = CLAMP (start_page, 0, MAX (job->n_pages - 1, 0));
 }
 
 /* EvJobRender */
@@ -601,6 +972,11 @@ ev_job_render_dispose (GObject *object)
 		job->surface = NULL;
 	}
 
+	if (job->annotations) {
+		cairo_surface_destroy (job->annotations);
+		job->annotations = NULL;
+	}
+
 	if (job->selection) {
 		cairo_surface_destroy (job->selection);
 		job->selection = NULL;
@@ -614,33 +990,162 @@ ev_job_render_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_render_parent_class)->dispose) (object);
 }
 
+/* Makes a mask of the ink of an opaque rendered page, the alpha of
+ * every pixel being how dark it is. A1 masks keep the pixels darker
+ * than half gray. */
+static cairo_surface_t *
+ev_job_render_make_mask (cairo_surface_t *surface,
+			 cairo_format_t   format)
+{
+	cairo_surface_t *mask;
+	guchar          *src_data, *dest_data;
+	gint             src_stride, dest_stride;
+	gint             width, height;
+	gint             x, y;
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+	    (cairo_image_surface_get_format (surface) != CAIRO_FORMAT_RGB24 &&
+	     cairo_image_surface_get_format (surface) != CAIRO_FORMAT_ARGB32))
+		return NULL;
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	mask = ev_surface_pool_create_surface (format, width, height);
+	if (cairo_surface_status (mask) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (mask);
+		return NULL;
+	}
+
+	cairo_surface_flush (surface);
+	cairo_surface_flush (mask);
+	src_data = cairo_image_surface_get_data (surface);
+	src_stride = cairo_image_surface_get_stride (surface);
+	dest_data = cairo_image_surface_get_data (mask);
+	dest_stride = cairo_image_surface_get_stride (mask);
+
+	for (y = 0; y < height; y++) {
+		guint32 *src = (guint32 *) (src_data + (gsize) y * src_stride);
+		guchar  *dest = dest_data + (gsize) y * dest_stride;
+
+		for (x = 0; x < width; x++) {
+			guint32 pixel = src[x];
+			guint   ink;
+
+			ink = 255 - ((((pixel >> 16) & 0xff) * 77 +
+				      ((pixel >> 8) & 0xff) * 151 +
+				      (pixel & 0xff) * 28) >> 8);
+
+			if (format == CAIRO_FORMAT_A8) {
+				dest[x] = ink;
+			} else if (ink >= 128) {
+				guint32 *word = (guint32 *) dest + x / 32;
+
+				/* A1 pixels are the bits of native endian words */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+				*word |= 1u << (x & 31);
+#else
+				*word |= 1u << (31 - (x & 31));
+#endif
+			}
+		}
+	}
+	cairo_surface_mark_dirty (mask);
+
+	return mask;
+}
+
+/* Renders the page, or its content and its annotations apart. The
+ * annotations are NULL for pages without any. */
+static void
+ev_job_render_render_layers (EvJobRender     *job_render,
+			     EvRenderContext *rc)
+{
+	EvDocument *document = EV_JOB (job_render)->document;
+
+	if (job_render->layer != EV_RENDER_LAYER_ANNOTATIONS) {
+		ev_render_context_set_layer (rc, job_render->layer);
+		job_render->surface = ev_document_render (document, rc);
+	}
+
+	if (job_render->layer != EV_RENDER_LAYER_ALL &&
+	    !ev_render_context_is_cancelled (rc)) {
+		ev_render_context_set_layer (rc, EV_RENDER_LAYER_ANNOTATIONS);
+		job_render->annotations = ev_document_render (document, rc);
+	}
+}
+
 static gboolean
 ev_job_render_run (EvJob *job)
 {
 	EvJobRender     *job_render = EV_JOB_RENDER (job);
 	EvPage          *ev_page;
 	EvRenderContext *rc;
+	EvPageColorMode  color_mode = EV_PAGE_COLOR_MODE_COLOR;
+	gboolean         thread_safe;
+	gint64           start;
 
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 
 	ev_profiler_start (EV_PROFILE_JOBS, "Rendering page %d", job_render->page);
-		
-	ev_document_fc_mutex_lock ();
+
+	/* Thread-safe backends render without the document lock,
+	 * so that several pages can be rendered at the same time.
+	 * They take care of their own locking, fontconfig included.
+	 */
+	thread_safe = ev_document_is_thread_safe (job->document);
+	if (!thread_safe)
+		ev_document_fc_mutex_lock ();
 
 	ev_page = ev_document_get_page (job->document, job_render->page);
 	rc = ev_render_context_new (ev_page, job_render->rotation, job_render->scale);
 	ev_render_context_set_target_size (rc,
 					   job_render->target_width, job_render->target_height);
+	if (job_render->area.width > 0 && job_render->area.height > 0)
+		ev_render_context_set_area (rc, &job_render->area);
+	ev_render_context_set_draft (rc, job_render->draft);
+	ev_render_context_set_cancellable (rc, job->cancellable);
+	if (job_render->mask_monochrome && job_render->area.width == 0)
+		color_mode = ev_document_get_page_color_mode (job->document, ev_page);
 	g_object_unref (ev_page);
 
-	job_render->surface = ev_document_render (job->document, rc);
+	start = g_get_monotonic_time ();
+	if (thread_safe) {
+		ev_document_unlock (job->document);
+		ev_job_render_render_layers (job_render, rc);
+		ev_document_lock (job->document);
+		ev_document_fc_mutex_lock ();
+	} else {
+		ev_job_render_render_layers (job_render, rc);
+	}
+
+	job_render->render_time = g_get_monotonic_time () - start;
+	if (job_render->surface && !g_cancellable_is_cancelled (job->cancellable) &&
+	    cairo_surface_get_type (job_render->surface) == CAIRO_SURFACE_TYPE_IMAGE) {
+		ev_render_stats_add_render (EV_GET_TYPE_NAME (job->document),
+					    cairo_image_surface_get_width (job_render->surface),
+					    cairo_image_surface_get_height (job_render->surface),
+					    job_render->scale,
+					    job_render->render_time);
+	}
+
+	/* If job was cancelled during the page rendering,
+	 * we return now, so that the thread is finished ASAP.
+	 * Backends give up early and return no surface then.
+	 */
+	if (g_cancellable_is_cancelled (job->cancellable)) {
+		ev_document_fc_mutex_unlock ();
+		ev_document_unlock (job->document);
+		g_object_unref (rc);
+
+		return FALSE;
+	}
 
-	if (job_render->surface == NULL) {
+	if (job_render->surface == NULL && job_render->layer != EV_RENDER_LAYER_ANNOTATIONS) {
 		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (job->document);
 		g_object_unref (rc);
 
 		ev_job_failed (job,
@@ -652,15 +1157,16 @@ ev_job_render_run (EvJob *job)
 		return FALSE;
 	}
 
-	/* If job was cancelled during the page rendering,
-	 * we return now, so that the thread is finished ASAP
-	 */
-	if (g_cancellable_is_cancelled (job->cancellable)) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
-		g_object_unref (rc);
+	if (job_render->surface && color_mode != EV_PAGE_COLOR_MODE_COLOR) {
+		cairo_surface_t *mask;
 
-		return FALSE;
+		mask = ev_job_render_make_mask (job_render->surface,
+						color_mode == EV_PAGE_COLOR_MODE_MONOCHROME ?
+						CAIRO_FORMAT_A1 : CAIRO_FORMAT_A8);
+		if (mask) {
+			ev_surface_pool_recycle (job_render->surface);
+			job_render->surface = mask;
+		}
 	}
 
 	if (job_render->include_selection && EV_IS_SELECTION (job->document)) {
@@ -681,7 +1187,7 @@ ev_job_render_run (EvJob *job)
 	g_object_unref (rc);
 
 	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 	
 	ev_job_succeeded (job);
 	
@@ -737,83 +1243,317 @@ ev_job_render_set_selection_info (EvJobRender     *job,
 	job->base = *base;
 }
 
-/* EvJobPageData */
-static void
-ev_job_page_data_init (EvJobPageData *job)
+/**
+ * ev_job_render_set_area:
+ * @job: an #EvJobRender
+ * @area: the area of the page to render, in device pixels
+ *
+ * Makes @job render only @area of the page, as a surface of the
+ * size of @area. Selections are not rendered for partial pages.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_render_set_area (EvJobRender                 *job,
+			const cairo_rectangle_int_t *area)
 {
-	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+	job->area = *area;
+	job->include_selection = FALSE;
 }
 
-static gboolean
-ev_job_page_data_run (EvJob *job)
+/**
+ * ev_job_render_set_draft:
+ * @job: an #EvJobRender
+ * @draft: whether to render a draft
+ *
+ * Makes @job render the page as fast as possible instead of as well as
+ * possible, see ev_render_context_set_draft().
+ *
+ * Since: 3.30
+ */
+void
+ev_job_render_set_draft (EvJobRender *job,
+			 gboolean     draft)
 {
-	EvJobPageData *job_pd = EV_JOB_PAGE_DATA (job);
-	EvPage        *ev_page;
-
-	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_pd->page, job);
-	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
-
-	ev_document_doc_mutex_lock ();
-	ev_page = ev_document_get_page (job->document, job_pd->page);
-
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING) && EV_IS_DOCUMENT_TEXT (job->document))
-		job_pd->text_mapping =
-			ev_document_text_get_text_mapping (EV_DOCUMENT_TEXT (job->document), ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT) && EV_IS_DOCUMENT_TEXT (job->document))
-		job_pd->text =
-			ev_document_text_get_text (EV_DOCUMENT_TEXT (job->document), ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) && EV_IS_DOCUMENT_TEXT (job->document))
-		ev_document_text_get_text_layout (EV_DOCUMENT_TEXT (job->document),
-						  ev_page,
-						  &(job_pd->text_layout),
-						  &(job_pd->text_layout_length));
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS) && EV_IS_DOCUMENT_TEXT (job->document))
-		job_pd ->text_attrs =
-			ev_document_text_get_text_attrs (EV_DOCUMENT_TEXT (job->document),
-							 ev_page);
-        if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) && job_pd->text) {
-                job_pd->text_log_attrs_length = g_utf8_strlen (job_pd->text, -1);
-                job_pd->text_log_attrs = g_new0 (PangoLogAttr, job_pd->text_log_attrs_length + 1);
+	job->draft = draft != FALSE;
+}
 
-                /* FIXME: We need API to get the language of the document */
-                pango_get_log_attrs (job_pd->text, -1, -1, NULL, job_pd->text_log_attrs, job_pd->text_log_attrs_length + 1);
-        }
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_LINKS) && EV_IS_DOCUMENT_LINKS (job->document))
-		job_pd->link_mapping =
-			ev_document_links_get_links (EV_DOCUMENT_LINKS (job->document), ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_FORMS) && EV_IS_DOCUMENT_FORMS (job->document))
-		job_pd->form_field_mapping =
-			ev_document_forms_get_form_fields (EV_DOCUMENT_FORMS (job->document),
-							   ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_IMAGES) && EV_IS_DOCUMENT_IMAGES (job->document))
-		job_pd->image_mapping =
-			ev_document_images_get_image_mapping (EV_DOCUMENT_IMAGES (job->document),
-							      ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_ANNOTS) && EV_IS_DOCUMENT_ANNOTATIONS (job->document))
-		job_pd->annot_mapping =
-			ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (job->document),
-								 ev_page);
-        if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_MEDIA) && EV_IS_DOCUMENT_MEDIA (job->document))
-                job_pd->media_mapping =
-                        ev_document_media_get_media_mapping (EV_DOCUMENT_MEDIA (job->document),
-                                                             ev_page);
-	g_object_unref (ev_page);
-	ev_document_doc_mutex_unlock ();
+/**
+ * ev_job_render_set_mask_monochrome:
+ * @job: an #EvJobRender
+ * @mask_monochrome: whether to give grayscale and monochrome pages as masks
+ *
+ * Makes @job give the pages that the document reports as grayscale or
+ * monochrome, see ev_document_get_page_color_mode(), as an
+ * %CAIRO_FORMAT_A8 or %CAIRO_FORMAT_A1 surface instead of an RGB one.
+ * The alpha of the mask is the ink of the page, to be drawn in black
+ * over white. They take 4 or 32 times less memory. Partial pages are
+ * always given in RGB.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_render_set_mask_monochrome (EvJobRender *job,
+				   gboolean     mask_monochrome)
+{
+	job->mask_monochrome = mask_monochrome != FALSE;
+}
 
-	ev_job_succeeded (job);
+/**
+ * ev_job_render_set_layer:
+ * @job: an #EvJobRender
+ * @layer: the #EvRenderLayer to render
+ *
+ * Makes @job render the page in layers, for documents that can render
+ * them, see ev_document_can_render_layers(). With
+ * %EV_RENDER_LAYER_CONTENT, the surface of @job is the page without its
+ * annotations, and its annotations surface what goes over it. With
+ * %EV_RENDER_LAYER_ANNOTATIONS, only the annotations surface is
+ * rendered, so that annotation changes don't need the content again.
+ * The annotations surface is %NULL for pages without annotations.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_render_set_layer (EvJobRender  *job,
+			 EvRenderLayer layer)
+{
+	job->layer = layer;
+}
 
-	return FALSE;
+/* EvJobSelection */
+static void
+ev_job_selection_init (EvJobSelection *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
 }
 
 static void
-ev_job_page_data_class_init (EvJobPageDataClass *class)
+ev_job_selection_dispose (GObject *object)
 {
-	EvJobClass *job_class = EV_JOB_CLASS (class);
+	EvJobSelection *job;
 
-	job_class->run = ev_job_page_data_run;
-}
+	job = EV_JOB_SELECTION (object);
 
-EvJob *
+	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job->page, job);
+
+	if (job->selection) {
+		cairo_surface_destroy (job->selection);
+		job->selection = NULL;
+	}
+
+	if (job->selection_region) {
+		cairo_region_destroy (job->selection_region);
+		job->selection_region = NULL;
+	}
+
+	(* G_OBJECT_CLASS (ev_job_selection_parent_class)->dispose) (object);
+}
+
+static gboolean
+ev_job_selection_run (EvJob *job)
+{
+	EvJobSelection  *job_selection = EV_JOB_SELECTION (job);
+	EvPage          *ev_page;
+	EvRenderContext *rc;
+
+	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_selection->page, job);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	ev_document_lock (job->document);
+	ev_document_fc_mutex_lock ();
+
+	ev_page = ev_document_get_page (job->document, job_selection->page);
+	rc = ev_render_context_new (ev_page, 0, job_selection->scale);
+	ev_render_context_set_target_size (rc,
+					   job_selection->target_width,
+					   job_selection->target_height);
+	g_object_unref (ev_page);
+
+	if (job_selection->render_surface) {
+		ev_selection_render_selection (EV_SELECTION (job->document),
+					       rc,
+					       &(job_selection->selection),
+					       &(job_selection->points),
+					       NULL,
+					       job_selection->style,
+					       &(job_selection->text), &(job_selection->base));
+	} else {
+		job_selection->selection_region =
+			ev_selection_get_selection_region (EV_SELECTION (job->document),
+							   rc,
+							   job_selection->style,
+							   &(job_selection->points));
+	}
+
+	g_object_unref (rc);
+
+	ev_document_fc_mutex_unlock ();
+	ev_document_unlock (job->document);
+
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_selection_class_init (EvJobSelectionClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_selection_dispose;
+	job_class->run = ev_job_selection_run;
+}
+
+/**
+ * ev_job_selection_new:
+ * @document: an #EvDocument implementing #EvSelection
+ * @page: the page of the selection
+ * @scale: the scale of the page
+ * @width: the width of the page at @scale
+ * @height: the height of the page at @scale
+ * @points: the selected area, in document coordinates
+ * @style: the #EvSelectionStyle of the selection
+ *
+ * Creates a job computing the region covered by the selection
+ * at @scale.
+ *
+ * Returns: (transfer full): a new #EvJobSelection
+ *
+ * Since: 3.30
+ */
+EvJob *
+ev_job_selection_new (EvDocument      *document,
+		      gint             page,
+		      gdouble          scale,
+		      gint             width,
+		      gint             height,
+		      EvRectangle     *points,
+		      EvSelectionStyle style)
+{
+	EvJobSelection *job;
+
+	g_return_val_if_fail (EV_IS_SELECTION (document), NULL);
+
+	ev_debug_message (DEBUG_JOBS, "page: %d", page);
+
+	job = g_object_new (EV_TYPE_JOB_SELECTION, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+	job->page = page;
+	job->scale = scale;
+	job->target_width = width;
+	job->target_height = height;
+	job->points = *points;
+	job->style = style;
+
+	return EV_JOB (job);
+}
+
+/**
+ * ev_job_selection_set_render_surface:
+ * @job: an #EvJobSelection
+ * @text: the color of the selected text
+ * @base: the color of the selection background
+ *
+ * Makes @job render the selection as a surface of the size of
+ * the page instead of computing its region.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_selection_set_render_surface (EvJobSelection *job,
+				     GdkColor       *text,
+				     GdkColor       *base)
+{
+	job->render_surface = TRUE;
+	job->text = *text;
+	job->base = *base;
+}
+
+/* EvJobPageData */
+static void
+ev_job_page_data_init (EvJobPageData *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+static gboolean
+ev_job_page_data_run (EvJob *job)
+{
+	EvJobPageData *job_pd = EV_JOB_PAGE_DATA (job);
+	EvPage        *ev_page;
+
+	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_pd->page, job);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	ev_document_lock (job->document);
+	ev_page = ev_document_get_page (job->document, job_pd->page);
+
+	if (EV_IS_DOCUMENT_TEXT (job->document)) {
+		EvDocumentTextDataFlags text_flags = EV_DOCUMENT_TEXT_DATA_NONE;
+
+		if (job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING)
+			text_flags |= EV_DOCUMENT_TEXT_DATA_MAPPING;
+		if (job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT)
+			text_flags |= EV_DOCUMENT_TEXT_DATA_TEXT;
+		if (job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT)
+			text_flags |= EV_DOCUMENT_TEXT_DATA_LAYOUT;
+		if (job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS)
+			text_flags |= EV_DOCUMENT_TEXT_DATA_ATTRS;
+
+		if (text_flags != EV_DOCUMENT_TEXT_DATA_NONE)
+			ev_document_text_get_text_data (EV_DOCUMENT_TEXT (job->document),
+							ev_page, text_flags,
+							&(job_pd->text),
+							&(job_pd->text_layout),
+							&(job_pd->text_layout_length),
+							&(job_pd->text_mapping),
+							&(job_pd->text_attrs));
+	}
+        if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) && job_pd->text) {
+                ev_document_text_get_text_log_attrs (EV_DOCUMENT_TEXT (job->document),
+                                                     ev_page,
+                                                     &(job_pd->text_log_attrs),
+                                                     &(job_pd->text_log_attrs_length));
+        }
+	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_LINKS) && EV_IS_DOCUMENT_LINKS (job->document))
+		job_pd->link_mapping =
+			ev_document_links_get_links (EV_DOCUMENT_LINKS (job->document), ev_page);
+	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_FORMS) && EV_IS_DOCUMENT_FORMS (job->document))
+		job_pd->form_field_mapping =
+			ev_document_forms_get_form_fields (EV_DOCUMENT_FORMS (job->document),
+							   ev_page);
+	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_IMAGES) && EV_IS_DOCUMENT_IMAGES (job->document))
+		job_pd->image_mapping =
+			ev_document_images_get_image_mapping (EV_DOCUMENT_IMAGES (job->document),
+							      ev_page);
+	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_ANNOTS) && EV_IS_DOCUMENT_ANNOTATIONS (job->document))
+		job_pd->annot_mapping =
+			ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (job->document),
+								 ev_page);
+        if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_MEDIA) && EV_IS_DOCUMENT_MEDIA (job->document))
+                job_pd->media_mapping =
+                        ev_document_media_get_media_mapping (EV_DOCUMENT_MEDIA (job->document),
+                                                             ev_page);
+	g_object_unref (ev_page);
+	ev_document_unlock (job->document);
+
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_page_data_class_init (EvJobPageDataClass *class)
+{
+	EvJobClass *job_class = EV_JOB_CLASS (class);
+
+	job_class->run = ev_job_page_data_run;
+}
+
+EvJob *
 ev_job_page_data_new (EvDocument        *document,
 		      gint               page,
 		      EvJobPageDataFlags flags)
@@ -871,12 +1611,13 @@ ev_job_thumbnail_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "%d (%p)", job_thumb->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 
 	page = ev_document_get_page (job->document, job_thumb->page);
 	rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
 	ev_render_context_set_target_size (rc,
 					   job_thumb->target_width, job_thumb->target_height);
+	ev_render_context_set_draft (rc, TRUE);
 	g_object_unref (page);
 
         if (job_thumb->format == EV_JOB_THUMBNAIL_PIXBUF)
@@ -884,7 +1625,7 @@ ev_job_thumbnail_run (EvJob *job)
         else
                 job_thumb->thumbnail_surface = ev_document_get_thumbnail_surface (job->document, rc);
 	g_object_unref (rc);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
         /* EV_JOB_THUMBNAIL_SURFACE is not compatible with has_frame = TRUE */
         if (job_thumb->format == EV_JOB_THUMBNAIL_PIXBUF && pixbuf) {
@@ -894,7 +1635,7 @@ ev_job_thumbnail_run (EvJob *job)
         }
 
 	if ((job_thumb->format == EV_JOB_THUMBNAIL_PIXBUF && pixbuf == NULL) ||
-	     job_thumb->thumbnail_surface == NULL) {
+	    (job_thumb->format == EV_JOB_THUMBNAIL_SURFACE && job_thumb->thumbnail_surface == NULL)) {
 		ev_job_failed (job,
 			       EV_DOCUMENT_ERROR,
 			       EV_DOCUMENT_ERROR_INVALID,
@@ -987,86 +1728,757 @@ ev_job_thumbnail_set_output_format (EvJobThumbnail      *job,
         job->format = format;
 }
 
+/* EvJobThumbnailBatch */
+
+/* Pages rendered with the document locked at once. Other jobs, like
+ * the ones of the view, only wait for a group of thumbnails.
+ */
+#define EV_JOB_THUMBNAIL_BATCH_GROUP_SIZE 8
+
+typedef struct {
+	gint             page;
+	gint             target_width;
+	gint             target_height;
+	cairo_surface_t *surface;
+} EvThumbnailBatchItem;
+
+static void
+ev_thumbnail_batch_item_free (EvThumbnailBatchItem *item)
+{
+	if (item->surface)
+		cairo_surface_destroy (item->surface);
+	g_slice_free (EvThumbnailBatchItem, item);
+}
+
+static void
+ev_job_thumbnail_batch_init (EvJobThumbnailBatch *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+
+	g_mutex_init (&job->mutex);
+	g_queue_init (&job->pending);
+	g_queue_init (&job->ready);
+}
+
+static void
+ev_job_thumbnail_batch_dispose (GObject *object)
+{
+	EvJobThumbnailBatch *job = EV_JOB_THUMBNAIL_BATCH (object);
+
+	ev_debug_message (DEBUG_JOBS, "%p", job);
+
+	g_mutex_lock (&job->mutex);
+	g_queue_foreach (&job->pending, (GFunc) ev_thumbnail_batch_item_free, NULL);
+	g_queue_clear (&job->pending);
+	g_queue_foreach (&job->ready, (GFunc) ev_thumbnail_batch_item_free, NULL);
+	g_queue_clear (&job->ready);
+	g_mutex_unlock (&job->mutex);
+
+	(* G_OBJECT_CLASS (ev_job_thumbnail_batch_parent_class)->dispose) (object);
+}
+
+static void
+ev_job_thumbnail_batch_finalize (GObject *object)
+{
+	EvJobThumbnailBatch *job = EV_JOB_THUMBNAIL_BATCH (object);
+
+	g_mutex_clear (&job->mutex);
+
+	(* G_OBJECT_CLASS (ev_job_thumbnail_batch_parent_class)->finalize) (object);
+}
+
+/* Emits thumbnail-ready for the pages rendered since the last time */
+static gboolean
+ev_job_thumbnail_batch_emit_ready (EvJobThumbnailBatch *job_batch)
+{
+	EvJob    *job = EV_JOB (job_batch);
+	GQueue    ready;
+	gboolean  done;
+
+	g_mutex_lock (&job_batch->mutex);
+	job_batch->idle_ready_id = 0;
+	ready = job_batch->ready;
+	g_queue_init (&job_batch->ready);
+	done = job_batch->done;
+	g_mutex_unlock (&job_batch->mutex);
+
+	while (!g_queue_is_empty (&ready)) {
+		EvThumbnailBatchItem *item = g_queue_pop_head (&ready);
+
+		if (!job->cancelled)
+			g_signal_emit (job_batch, job_thumbnail_batch_signals[THUMBNAIL_READY], 0,
+				       item->page, item->surface);
+		ev_thumbnail_batch_item_free (item);
+	}
+
+	if (done && !job->cancelled)
+		ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_thumbnail_batch_queue_ready_unlocked (EvJobThumbnailBatch *job)
+{
+	if (job->idle_ready_id > 0)
+		return;
+
+	job->idle_ready_id =
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				 (GSourceFunc)ev_job_thumbnail_batch_emit_ready,
+				 g_object_ref (job),
+				 (GDestroyNotify)g_object_unref);
+}
+
+static gboolean
+ev_job_thumbnail_batch_run (EvJob *job)
+{
+	EvJobThumbnailBatch *job_batch = EV_JOB_THUMBNAIL_BATCH (job);
+	GQueue               group = G_QUEUE_INIT;
+	GList               *l;
+
+	g_mutex_lock (&job_batch->mutex);
+	while (g_queue_get_length (&group) < EV_JOB_THUMBNAIL_BATCH_GROUP_SIZE &&
+	       !g_queue_is_empty (&job_batch->pending))
+		g_queue_push_tail (&group, g_queue_pop_head (&job_batch->pending));
+
+	if (g_queue_is_empty (&group)) {
+		/* Pages can't be added anymore */
+		job_batch->done = TRUE;
+		ev_job_thumbnail_batch_queue_ready_unlocked (job_batch);
+		g_mutex_unlock (&job_batch->mutex);
+
+		return FALSE;
+	}
+	g_mutex_unlock (&job_batch->mutex);
+
+	ev_debug_message (DEBUG_JOBS, "%d pages from %d (%p)",
+			  g_queue_get_length (&group),
+			  ((EvThumbnailBatchItem *) g_queue_peek_head (&group))->page, job);
+
+	ev_document_lock (job->document);
+	for (l = group.head; l && !g_cancellable_is_cancelled (job->cancellable); l = l->next) {
+		EvThumbnailBatchItem *item = l->data;
+		EvRenderContext      *rc;
+		EvPage               *page;
+
+		page = ev_document_get_page (job->document, item->page);
+		rc = ev_render_context_new (page, job_batch->rotation, 1.);
+		ev_render_context_set_target_size (rc, item->target_width, item->target_height);
+		ev_render_context_set_draft (rc, TRUE);
+		g_object_unref (page);
+
+		item->surface = ev_document_get_thumbnail_surface (job->document, rc);
+		g_object_unref (rc);
+	}
+	ev_document_unlock (job->document);
+
+	g_mutex_lock (&job_batch->mutex);
+	while (!g_queue_is_empty (&group))
+		g_queue_push_tail (&job_batch->ready, g_queue_pop_head (&group));
+	ev_job_thumbnail_batch_queue_ready_unlocked (job_batch);
+	g_mutex_unlock (&job_batch->mutex);
+
+	return TRUE;
+}
+
+static void
+ev_job_thumbnail_batch_class_init (EvJobThumbnailBatchClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_thumbnail_batch_dispose;
+	oclass->finalize = ev_job_thumbnail_batch_finalize;
+	job_class->run = ev_job_thumbnail_batch_run;
+
+	/**
+	 * EvJobThumbnailBatch::thumbnail-ready:
+	 * @job: the #EvJobThumbnailBatch
+	 * @page: the page index
+	 * @surface: (allow-none): the thumbnail surface, or %NULL if
+	 *   rendering the page failed
+	 *
+	 * Emitted in the main thread for every page rendered, in groups.
+	 *
+	 * Since: 3.30
+	 */
+	job_thumbnail_batch_signals[THUMBNAIL_READY] =
+		g_signal_new ("thumbnail-ready",
+			      EV_TYPE_JOB_THUMBNAIL_BATCH,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobThumbnailBatchClass, thumbnail_ready),
+			      NULL, NULL,
+			      ev_view_marshal_VOID__INT_POINTER,
+			      G_TYPE_NONE,
+			      2, G_TYPE_INT, G_TYPE_POINTER);
+}
+
+/**
+ * ev_job_thumbnail_batch_new:
+ * @document: an #EvDocument
+ * @rotation: the rotation of the thumbnails
+ *
+ * Creates a job that renders the thumbnail surfaces of the pages added
+ * with ev_job_thumbnail_batch_add_page(), in the order they are added.
+ * Pages are rendered in groups with the document locked once, and
+ * #EvJobThumbnailBatch::thumbnail-ready is emitted for every group. The
+ * job finishes when there are no pages left.
+ *
+ * Returns: (transfer full): a new #EvJobThumbnailBatch
+ *
+ * Since: 3.30
+ */
+EvJob *
+ev_job_thumbnail_batch_new (EvDocument *document,
+			    gint        rotation)
+{
+	EvJobThumbnailBatch *job;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	job = g_object_new (EV_TYPE_JOB_THUMBNAIL_BATCH, NULL);
+	EV_JOB (job)->document = g_object_ref (document);
+	job->rotation = rotation;
+
+	return EV_JOB (job);
+}
+
+/**
+ * ev_job_thumbnail_batch_add_page:
+ * @job: an #EvJobThumbnailBatch
+ * @page: the page index
+ * @target_width: the width of the thumbnail
+ * @target_height: the height of the thumbnail
+ *
+ * Adds @page to the pages rendered by @job. This can be done while
+ * the job is running, until it has rendered all of its pages.
+ *
+ * Returns: %TRUE if @page was added, %FALSE if @job is done and a
+ *   new job is needed
+ *
+ * Since: 3.30
+ */
+gboolean
+ev_job_thumbnail_batch_add_page (EvJobThumbnailBatch *job,
+				 gint                 page,
+				 gint                 target_width,
+				 gint                 target_height)
+{
+	EvThumbnailBatchItem *item;
+	gboolean              retval = FALSE;
+
+	g_return_val_if_fail (EV_IS_JOB_THUMBNAIL_BATCH (job), FALSE);
+
+	g_mutex_lock (&job->mutex);
+	if (!job->done && !EV_JOB (job)->cancelled) {
+		item = g_slice_new0 (EvThumbnailBatchItem);
+		item->page = page;
+		item->target_width = target_width;
+		item->target_height = target_height;
+		g_queue_push_tail (&job->pending, item);
+		retval = TRUE;
+	}
+	g_mutex_unlock (&job->mutex);
+
+	return retval;
+}
+
+/**
+ * ev_job_thumbnail_batch_remove_pages:
+ * @job: an #EvJobThumbnailBatch
+ * @start_page: the first page to remove
+ * @end_page: the last page to remove
+ *
+ * Removes the pages from @start_page to @end_page that @job hasn't
+ * rendered yet, when they are not needed anymore. Pages already being
+ * rendered are still reported.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_thumbnail_batch_remove_pages (EvJobThumbnailBatch *job,
+				     gint                 start_page,
+				     gint                 end_page)
+{
+	GList *l, *next;
+
+	g_return_if_fail (EV_IS_JOB_THUMBNAIL_BATCH (job));
+
+	g_mutex_lock (&job->mutex);
+	for (l = job->pending.head; l; l = next) {
+		EvThumbnailBatchItem *item = l->data;
+
+		next = l->next;
+		if (item->page >= start_page && item->page <= end_page) {
+			ev_thumbnail_batch_item_free (item);
+			g_queue_delete_link (&job->pending, l);
+		}
+	}
+	g_mutex_unlock (&job->mutex);
+}
+
 /* EvJobFonts */
+
+/* Pages scanned with the document locked once */
+#define EV_JOB_FONTS_CHUNK_SIZE 10
+
 static void
 ev_job_fonts_init (EvJobFonts *job)
 {
-	EV_JOB (job)->run_mode = EV_JOB_RUN_MAIN_LOOP;
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+
+	g_mutex_init (&job->mutex);
+	g_queue_init (&job->ready);
+	job->model = gtk_list_store_new (EV_DOCUMENT_FONTS_COLUMN_NUM_COLUMNS,
+					 G_TYPE_STRING, G_TYPE_STRING);
+}
+
+static void
+ev_job_fonts_dispose (GObject *object)
+{
+	EvJobFonts *job = EV_JOB_FONTS (object);
+
+	g_mutex_lock (&job->mutex);
+	g_queue_foreach (&job->ready, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&job->ready);
+	g_mutex_unlock (&job->mutex);
+
+	g_clear_object (&job->model);
+
+	G_OBJECT_CLASS (ev_job_fonts_parent_class)->dispose (object);
+}
+
+static void
+ev_job_fonts_finalize (GObject *object)
+{
+	EvJobFonts *job = EV_JOB_FONTS (object);
+
+	g_mutex_clear (&job->mutex);
+
+	G_OBJECT_CLASS (ev_job_fonts_parent_class)->finalize (object);
+}
+
+static void
+ev_job_fonts_append_rows (EvJobFonts   *job,
+			  GtkListStore *chunk)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL (chunk);
+	GtkTreeIter   iter;
+	gboolean      valid;
+
+	for (valid = gtk_tree_model_get_iter_first (model, &iter);
+	     valid;
+	     valid = gtk_tree_model_iter_next (model, &iter)) {
+		GtkTreeIter  list_iter;
+		gchar       *name;
+		gchar       *details;
+
+		gtk_tree_model_get (model, &iter,
+				    EV_DOCUMENT_FONTS_COLUMN_NAME, &name,
+				    EV_DOCUMENT_FONTS_COLUMN_DETAILS, &details,
+				    -1);
+		gtk_list_store_append (job->model, &list_iter);
+		gtk_list_store_set (job->model, &list_iter,
+				    EV_DOCUMENT_FONTS_COLUMN_NAME, name,
+				    EV_DOCUMENT_FONTS_COLUMN_DETAILS, details,
+				    -1);
+		g_free (name);
+		g_free (details);
+	}
+}
+
+/* Moves the fonts found since the last time to the model */
+static gboolean
+ev_job_fonts_emit_ready (EvJobFonts *job_fonts)
+{
+	EvJob    *job = EV_JOB (job_fonts);
+	GQueue    ready;
+	gdouble   progress;
+	gboolean  done;
+
+	g_mutex_lock (&job_fonts->mutex);
+	job_fonts->idle_ready_id = 0;
+	ready = job_fonts->ready;
+	g_queue_init (&job_fonts->ready);
+	progress = job_fonts->progress;
+	done = job_fonts->scan_completed;
+	g_mutex_unlock (&job_fonts->mutex);
+
+	while (!g_queue_is_empty (&ready)) {
+		GtkListStore *chunk = g_queue_pop_head (&ready);
+
+		if (!job->cancelled)
+			ev_job_fonts_append_rows (job_fonts, chunk);
+		g_object_unref (chunk);
+	}
+
+	if (job->cancelled)
+		return FALSE;
+
+	g_signal_emit (job_fonts, job_fonts_signals[FONTS_UPDATED], 0, progress);
+
+	if (done)
+		ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static gboolean
+ev_job_fonts_run (EvJob *job)
+{
+	EvJobFonts      *job_fonts = EV_JOB_FONTS (job);
+	EvDocumentFonts *fonts = EV_DOCUMENT_FONTS (job->document);
+	GtkListStore    *chunk;
+	gboolean         completed;
+	gdouble          progress;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	/* The rows are made here, with the document locked, and moved
+	 * to the model in the main thread. The store isn't shared until
+	 * then.
+	 */
+	chunk = gtk_list_store_new (EV_DOCUMENT_FONTS_COLUMN_NUM_COLUMNS,
+				    G_TYPE_STRING, G_TYPE_STRING);
+
+	ev_document_lock (job->document);
+	ev_document_fc_mutex_lock ();
+
+#ifdef EV_ENABLE_DEBUG
+	/* We use the #ifdef in this case because of the if */
+	if (ev_document_fonts_get_progress (fonts) == 0)
+		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+#endif
+
+	completed = !ev_document_fonts_scan (fonts, EV_JOB_FONTS_CHUNK_SIZE);
+	ev_document_fonts_fill_model (fonts, GTK_TREE_MODEL (chunk));
+	progress = ev_document_fonts_get_progress (fonts);
+
+	ev_document_fc_mutex_unlock ();
+	ev_document_unlock (job->document);
+
+	g_mutex_lock (&job_fonts->mutex);
+	g_queue_push_tail (&job_fonts->ready, chunk);
+	job_fonts->progress = progress;
+	job_fonts->scan_completed = completed;
+	if (job_fonts->idle_ready_id == 0) {
+		job_fonts->idle_ready_id =
+			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					 (GSourceFunc)ev_job_fonts_emit_ready,
+					 g_object_ref (job_fonts),
+					 (GDestroyNotify)g_object_unref);
+	}
+	g_mutex_unlock (&job_fonts->mutex);
+
+	return !completed;
+}
+
+static void
+ev_job_fonts_class_init (EvJobFontsClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_fonts_dispose;
+	oclass->finalize = ev_job_fonts_finalize;
+	job_class->run = ev_job_fonts_run;
+	
+	job_fonts_signals[FONTS_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_FONTS,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobFontsClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__DOUBLE,
+			      G_TYPE_NONE,
+			      1, G_TYPE_DOUBLE);
+}
+
+/**
+ * ev_job_fonts_new:
+ * @document: an #EvDocument implementing #EvDocumentFonts
+ *
+ * Creates a job that scans the fonts of @document in a thread, a few
+ * pages at a time. The fonts found are added to the model of the job
+ * in the main thread before #EvJobFonts::updated is emitted.
+ *
+ * Returns: (transfer full): a new #EvJobFonts
+ */
+EvJob *
+ev_job_fonts_new (EvDocument *document)
+{
+	EvJobFonts *job;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+	
+	job = g_object_new (EV_TYPE_JOB_FONTS, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+
+	return EV_JOB (job);
+}
+
+/**
+ * ev_job_fonts_get_model:
+ * @job: an #EvJobFonts
+ *
+ * Gets the model the fonts are added to, with the columns of
+ * #EvDocumentFonts. It keeps the rows added when the job is gone.
+ *
+ * Returns: (transfer none): a #GtkTreeModel
+ *
+ * Since: 3.30
+ */
+GtkTreeModel *
+ev_job_fonts_get_model (EvJobFonts *job)
+{
+	g_return_val_if_fail (EV_IS_JOB_FONTS (job), NULL);
+
+	return GTK_TREE_MODEL (job->model);
+}
+
+/* EvJobSelectedText */
+
+/* Pages whose text is read with the document locked once */
+#define EV_JOB_SELECTED_TEXT_CHUNK_SIZE 10
+
+typedef struct {
+	gint             page;
+	EvSelectionStyle style;
+	EvRectangle      points;
+} EvJobSelectedTextPage;
+
+static void
+ev_job_selected_text_init (EvJobSelectedText *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+
+	g_mutex_init (&job->mutex);
+	job->selections = g_array_new (FALSE, FALSE, sizeof (EvJobSelectedTextPage));
+	job->buffer = g_string_new (NULL);
+}
+
+static void
+ev_job_selected_text_finalize (GObject *object)
+{
+	EvJobSelectedText *job = EV_JOB_SELECTED_TEXT (object);
+
+	g_array_free (job->selections, TRUE);
+	if (job->buffer)
+		g_string_free (job->buffer, TRUE);
+	g_free (job->text);
+	g_mutex_clear (&job->mutex);
+
+	G_OBJECT_CLASS (ev_job_selected_text_parent_class)->finalize (object);
+}
+
+static gboolean
+ev_job_selected_text_emit_updated (EvJobSelectedText *job_text)
+{
+	EvJob   *job = EV_JOB (job_text);
+	gdouble  progress;
+
+	g_mutex_lock (&job_text->mutex);
+	job_text->idle_updated_id = 0;
+	progress = job_text->progress;
+	g_mutex_unlock (&job_text->mutex);
+
+	if (!job->cancelled && !job->finished)
+		g_signal_emit (job_text, job_selected_text_signals[SELECTED_TEXT_UPDATED], 0, progress);
+
+	return FALSE;
 }
 
 static gboolean
-ev_job_fonts_run (EvJob *job)
+ev_job_selected_text_run (EvJob *job)
 {
-	EvJobFonts      *job_fonts = EV_JOB_FONTS (job);
-	EvDocumentFonts *fonts = EV_DOCUMENT_FONTS (job->document);
+	EvJobSelectedText *job_text = EV_JOB_SELECTED_TEXT (job);
+	guint              last;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
-	
-	/* Do not block the main loop */
-	if (!ev_document_doc_mutex_trylock ())
-		return TRUE;
-	
-	if (!ev_document_fc_mutex_trylock ())
-		return TRUE;
 
 #ifdef EV_ENABLE_DEBUG
 	/* We use the #ifdef in this case because of the if */
-	if (ev_document_fonts_get_progress (fonts) == 0)
+	if (job_text->next_selection == 0)
 		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 #endif
 
-	job_fonts->scan_completed = !ev_document_fonts_scan (fonts, 20);
-	g_signal_emit (job_fonts, job_fonts_signals[FONTS_UPDATED], 0,
-		       ev_document_fonts_get_progress (fonts));
+	/* The document is unlocked between chunks, so that renders of
+	 * the visible pages don't wait for the whole selection */
+	last = MIN (job_text->next_selection + EV_JOB_SELECTED_TEXT_CHUNK_SIZE,
+		    job_text->selections->len);
+
+	ev_document_lock (job->document);
+	for (; job_text->next_selection < last; job_text->next_selection++) {
+		EvJobSelectedTextPage *selection;
+		EvPage                *page;
+		gchar                 *text;
+
+		if (g_cancellable_is_cancelled (job->cancellable))
+			break;
+
+		selection = &g_array_index (job_text->selections, EvJobSelectedTextPage,
+					    job_text->next_selection);
+		page = ev_document_get_page (job->document, selection->page);
+		text = ev_selection_get_selected_text (EV_SELECTION (job->document),
+						       page, selection->style,
+						       &selection->points);
+		g_object_unref (page);
+		if (text)
+			g_string_append (job_text->buffer, text);
+		g_free (text);
+	}
+	ev_document_unlock (job->document);
 
-	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	if (g_cancellable_is_cancelled (job->cancellable))
+		return FALSE;
 
-	if (job_fonts->scan_completed)
-		ev_job_succeeded (job);
-	
-	return !job_fonts->scan_completed;
+	if (job_text->next_selection < job_text->selections->len) {
+		g_mutex_lock (&job_text->mutex);
+		job_text->progress = (gdouble) job_text->next_selection / job_text->selections->len;
+		if (job_text->idle_updated_id == 0) {
+			job_text->idle_updated_id =
+				g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+						 (GSourceFunc)ev_job_selected_text_emit_updated,
+						 g_object_ref (job_text),
+						 (GDestroyNotify)g_object_unref);
+		}
+		g_mutex_unlock (&job_text->mutex);
+
+		return TRUE;
+	}
+
+	job_text->text = g_utf8_normalize (job_text->buffer->str, job_text->buffer->len,
+					   G_NORMALIZE_NFKC);
+	g_string_free (job_text->buffer, TRUE);
+	job_text->buffer = NULL;
+
+	ev_job_succeeded (job);
+
+	return FALSE;
 }
 
 static void
-ev_job_fonts_class_init (EvJobFontsClass *class)
+ev_job_selected_text_class_init (EvJobSelectedTextClass *class)
 {
-	EvJobClass *job_class = EV_JOB_CLASS (class);
-	
-	job_class->run = ev_job_fonts_run;
-	
-	job_fonts_signals[FONTS_UPDATED] =
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->finalize = ev_job_selected_text_finalize;
+	job_class->run = ev_job_selected_text_run;
+
+	/**
+	 * EvJobSelectedText::updated:
+	 * @job: the object which received the signal
+	 * @progress: the fraction of the pages whose text has been read
+	 *
+	 * Since: 3.30
+	 */
+	job_selected_text_signals[SELECTED_TEXT_UPDATED] =
 		g_signal_new ("updated",
-			      EV_TYPE_JOB_FONTS,
+			      EV_TYPE_JOB_SELECTED_TEXT,
 			      G_SIGNAL_RUN_LAST,
-			      G_STRUCT_OFFSET (EvJobFontsClass, updated),
+			      G_STRUCT_OFFSET (EvJobSelectedTextClass, updated),
 			      NULL, NULL,
 			      g_cclosure_marshal_VOID__DOUBLE,
 			      G_TYPE_NONE,
 			      1, G_TYPE_DOUBLE);
 }
 
+/**
+ * ev_job_selected_text_new:
+ * @document: an #EvDocument implementing #EvSelection
+ *
+ * Creates a job that reads the text selected in the pages added with
+ * ev_job_selected_text_add_page(), a few pages at a time, and joins it
+ * in the order the pages were added. #EvJobSelectedText::updated is
+ * emitted as the pages are read.
+ *
+ * Returns: (transfer full): a new #EvJobSelectedText
+ *
+ * Since: 3.30
+ */
 EvJob *
-ev_job_fonts_new (EvDocument *document)
+ev_job_selected_text_new (EvDocument *document)
 {
-	EvJobFonts *job;
+	EvJob *job;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
-	
-	job = g_object_new (EV_TYPE_JOB_FONTS, NULL);
 
-	EV_JOB (job)->document = g_object_ref (document);
+	job = g_object_new (EV_TYPE_JOB_SELECTED_TEXT, NULL);
+	job->document = g_object_ref (document);
 
-	return EV_JOB (job);
+	return job;
+}
+
+/**
+ * ev_job_selected_text_add_page:
+ * @job: an #EvJobSelectedText
+ * @page: the page index
+ * @style: the #EvSelectionStyle of the selection
+ * @points: the start and end points of the selection in @page
+ *
+ * Adds the selection of @page to @job. Pages must be added before the
+ * job is scheduled.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_selected_text_add_page (EvJobSelectedText *job,
+			       gint               page,
+			       EvSelectionStyle   style,
+			       EvRectangle       *points)
+{
+	EvJobSelectedTextPage selection;
+
+	g_return_if_fail (EV_IS_JOB_SELECTED_TEXT (job));
+	g_return_if_fail (points != NULL);
+
+	selection.page = page;
+	selection.style = style;
+	selection.points = *points;
+	g_array_append_val (job->selections, selection);
+}
+
+/**
+ * ev_job_selected_text_get_text:
+ * @job: an #EvJobSelectedText
+ *
+ * Gets the selected text, once @job has finished.
+ *
+ * Returns: (transfer none) (nullable): the text, normalized
+ *
+ * Since: 3.30
+ */
+const gchar *
+ev_job_selected_text_get_text (EvJobSelectedText *job)
+{
+	g_return_val_if_fail (EV_IS_JOB_SELECTED_TEXT (job), NULL);
+
+	return job->text;
 }
 
 /* EvJobLoad */
 static void
 ev_job_load_init (EvJobLoad *job)
 {
+	job->flags = EV_DOCUMENT_LOAD_FLAG_NONE;
+	g_mutex_init (&job->mutex);
+
 	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
 }
 
+static void
+ev_job_load_finalize (GObject *object)
+{
+	EvJobLoad *job = EV_JOB_LOAD (object);
+
+	g_mutex_clear (&job->mutex);
+
+	(* G_OBJECT_CLASS (ev_job_load_parent_class)->finalize) (object);
+}
+
 static void
 ev_job_load_dispose (GObject *object)
 {
@@ -1087,6 +2499,41 @@ ev_job_load_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_load_parent_class)->dispose) (object);
 }
 
+static gboolean
+ev_job_load_emit_updated (EvJobLoad *job_load)
+{
+	EvJob   *job = EV_JOB (job_load);
+	gdouble  progress;
+
+	g_mutex_lock (&job_load->mutex);
+	job_load->idle_updated_id = 0;
+	progress = job_load->progress;
+	g_mutex_unlock (&job_load->mutex);
+
+	if (!job->cancelled && !job->finished)
+		g_signal_emit (job_load, job_load_signals[LOAD_UPDATED], 0, progress);
+
+	return FALSE;
+}
+
+/* Called from the loading thread; the progress is sent to the main
+ * thread at most once per main loop iteration */
+static void
+ev_job_load_progress_cb (gdouble    fraction,
+			 EvJobLoad *job_load)
+{
+	g_mutex_lock (&job_load->mutex);
+	job_load->progress = fraction;
+	if (job_load->idle_updated_id == 0) {
+		job_load->idle_updated_id =
+			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					 (GSourceFunc)ev_job_load_emit_updated,
+					 g_object_ref (job_load),
+					 (GDestroyNotify)g_object_unref);
+	}
+	g_mutex_unlock (&job_load->mutex);
+}
+
 static gboolean
 ev_job_load_run (EvJob *job)
 {
@@ -1115,12 +2562,20 @@ ev_job_load_run (EvJob *job)
 
 		uncompressed_uri = g_object_get_data (G_OBJECT (job->document),
 						      "uri-uncompressed");
-		ev_document_load (job->document,
-				  uncompressed_uri ? uncompressed_uri : job_load->uri,
-				  &error);
+		ev_document_load_with_progress (job->document,
+						uncompressed_uri ? uncompressed_uri : job_load->uri,
+						job_load->flags,
+						job->cancellable,
+						(EvDocumentLoadProgressFunc)ev_job_load_progress_cb,
+						job_load,
+						&error);
 	} else {
-		job->document = ev_document_factory_get_document (job_load->uri,
-								  &error);
+		job->document = ev_document_factory_get_document_with_progress (job_load->uri,
+										job_load->flags,
+										job->cancellable,
+										(EvDocumentLoadProgressFunc)ev_job_load_progress_cb,
+										job_load,
+										&error);
 	}
 
 	ev_document_fc_mutex_unlock ();
@@ -1142,7 +2597,25 @@ ev_job_load_class_init (EvJobLoadClass *class)
 	EvJobClass   *job_class = EV_JOB_CLASS (class);
 
 	oclass->dispose = ev_job_load_dispose;
+	oclass->finalize = ev_job_load_finalize;
 	job_class->run = ev_job_load_run;
+
+	/**
+	 * EvJobLoad::updated:
+	 * @job: the object which received the signal
+	 * @progress: the fraction of the document that has been loaded
+	 *
+	 * Since: 3.30
+	 */
+	job_load_signals[LOAD_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_LOAD,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobLoadClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__DOUBLE,
+			      G_TYPE_NONE,
+			      1, G_TYPE_DOUBLE);
 }
 
 EvJob *
@@ -1178,6 +2651,26 @@ ev_job_load_set_password (EvJobLoad *job, const gchar *password)
 	job->password = password ? g_strdup (password) : NULL;
 }
 
+/**
+ * ev_job_load_set_load_flags:
+ * @job: an #EvJobLoad
+ * @flags: an #EvDocumentLoadFlags
+ *
+ * Sets the flags used to load the document. %EV_DOCUMENT_LOAD_FLAG_NO_CACHE
+ * is useful when only the first page is needed, because it skips querying
+ * the size and label of every page.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_load_set_load_flags (EvJobLoad          *job,
+			    EvDocumentLoadFlags flags)
+{
+	g_return_if_fail (EV_IS_JOB_LOAD (job));
+
+	job->flags = flags;
+}
+
 /* EvJobLoadStream */
 
 /**
@@ -1209,6 +2702,8 @@ ev_job_load_stream_dispose (GObject *object)
         g_free (job->password);
         job->password = NULL;
 
+        g_clear_pointer (&job->mime_type, g_free);
+
         G_OBJECT_CLASS (ev_job_load_stream_parent_class)->dispose (object);
 }
 
@@ -1244,7 +2739,7 @@ ev_job_load_stream_run (EvJob *job)
                                          &error);
         } else {
                 job->document = ev_document_factory_get_document_for_stream (job_load_stream->stream,
-                                                                             NULL /* mime-type FIXME? */,
+                                                                             job_load_stream->mime_type,
                                                                              job_load_stream->flags,
                                                                              job->cancellable,
                                                                              &error);
@@ -1322,6 +2817,26 @@ ev_job_load_stream_set_password (EvJobLoadStream *job,
         g_free (old_password);
 }
 
+/**
+ * ev_job_load_stream_set_mime_type:
+ * @job: an #EvJobLoadStream
+ * @mime_type: (allow-none): the mime type of the stream, or %NULL
+ *
+ * Sets the mime type of the document, needed to load streams that
+ * aren't files, like the ones received from the network.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_load_stream_set_mime_type (EvJobLoadStream *job,
+                                  const char      *mime_type)
+{
+        g_return_if_fail (EV_IS_JOB_LOAD_STREAM (job));
+
+        g_free (job->mime_type);
+        job->mime_type = g_strdup (mime_type);
+}
+
 /* EvJobLoadGFile */
 
 /**
@@ -1496,23 +3011,58 @@ ev_job_save_run (EvJob *job)
 {
 	EvJobSave *job_save = EV_JOB_SAVE (job);
 	gint       fd;
+	gchar     *filename;
 	gchar     *tmp_filename = NULL;
 	gchar     *local_uri;
+	gboolean   renamed = FALSE;
 	GError    *error = NULL;
 	
 	ev_debug_message (DEBUG_JOBS, "uri: %s, document_uri: %s", job_save->uri, job_save->document_uri);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-        fd = ev_mkstemp ("saveacopy.XXXXXX", &tmp_filename, &error);
+	/* Saving over the loaded file only needs the changes appended */
+	if (g_strcmp0 (job_save->uri, job_save->document_uri) == 0 &&
+	    !g_object_get_data (G_OBJECT (job->document), "uri-uncompressed")) {
+		gboolean saved;
+
+		ev_document_lock (job->document);
+		saved = ev_document_save_incremental (job->document, job_save->uri, &error);
+		ev_document_unlock (job->document);
+
+		if (saved) {
+			ev_job_succeeded (job);
+			return FALSE;
+		}
+
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+			ev_job_failed_from_error (job, error);
+			g_error_free (error);
+			return FALSE;
+		}
+
+		ev_debug_message (DEBUG_JOBS, "saving the whole document: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	/* Local files are written next to the destination and renamed
+	 * over it, instead of being copied there from the temp dir.
+	 * Symlinks are written through, as before. */
+	filename = g_filename_from_uri (job_save->uri, NULL, NULL);
+	if (filename && g_file_test (filename, G_FILE_TEST_IS_SYMLINK))
+		g_clear_pointer (&filename, g_free);
+	fd = filename ? ev_mkstemp_sibling (filename, &tmp_filename, NULL) : -1;
+	if (fd == -1)
+		fd = ev_mkstemp ("saveacopy.XXXXXX", &tmp_filename, &error);
         if (fd == -1) {
                 ev_job_failed_from_error (job, error);
                 g_error_free (error);
+		g_free (filename);
 
 		return FALSE;
 	}
 	close (fd);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 
 	/* Save document to temp filename */
 	local_uri = g_filename_to_uri (tmp_filename, NULL, &error);
@@ -1520,9 +3070,12 @@ ev_job_save_run (EvJob *job)
                 ev_document_save (job->document, local_uri, &error);
         }
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	if (error) {
+		g_unlink (tmp_filename);
+		g_free (tmp_filename);
+		g_free (filename);
 		g_free (local_uri);
 		ev_job_failed_from_error (job, error);
 		g_error_free (error);
@@ -1560,6 +3113,7 @@ ev_job_save_run (EvJob *job)
 	g_free (tmp_filename);
 
 	if (error) {
+		g_free (filename);
 		g_free (local_uri);
 		ev_job_failed_from_error (job, error);
 		g_error_free (error);
@@ -1567,11 +3121,26 @@ ev_job_save_run (EvJob *job)
 		return FALSE;
 	}
 
-	if (!local_uri)
+	if (!local_uri) {
+		g_free (filename);
 		return FALSE;
+	}
+
+	/* The compressed copy is in the temp dir, a different file
+	 * system maybe; the rename fails and it's copied as before */
+	if (filename) {
+		gchar *local_filename = g_filename_from_uri (local_uri, NULL, NULL);
+
+		renamed = local_filename && g_rename (local_filename, filename) == 0;
+		g_free (local_filename);
+	}
 
-	ev_xfer_uri_simple (local_uri, job_save->uri, &error);
-	ev_tmp_uri_unlink (local_uri);
+	if (!renamed) {
+		ev_xfer_uri_simple (local_uri, job_save->uri, &error);
+		ev_tmp_uri_unlink (local_uri);
+	}
+	g_free (local_uri);
+	g_free (filename);
 
         /* Copy the metadata from the original file */
         if (!error) {
@@ -1590,108 +3159,510 @@ ev_job_save_run (EvJob *job)
 }
 
 static void
-ev_job_save_class_init (EvJobSaveClass *class)
+ev_job_save_class_init (EvJobSaveClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_save_dispose;
+	job_class->run = ev_job_save_run;
+}
+
+EvJob *
+ev_job_save_new (EvDocument  *document,
+		 const gchar *uri,
+		 const gchar *document_uri)
+{
+	EvJobSave *job;
+
+	ev_debug_message (DEBUG_JOBS, "uri: %s, document_uri: %s", uri, document_uri);
+
+	job = g_object_new (EV_TYPE_JOB_SAVE, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+	job->uri = g_strdup (uri);
+	job->document_uri = g_strdup (document_uri);
+
+	return EV_JOB (job);
+}
+
+/* EvJobFind */
+
+/* Pages are handed out to the search threads in chunks, in the order
+ * they are reported, so that the pages following the current one are
+ * searched first. Results are reported in order from the main thread,
+ * once every page before them has been searched.
+ */
+#define EV_JOB_FIND_CHUNK_SIZE  8
+#define EV_JOB_FIND_MAX_THREADS 8
+
+static void
+ev_job_find_init (EvJobFind *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+	g_mutex_init (&job->mutex);
+}
+
+static void
+ev_job_find_free_results (EvFindResults *results,
+			  gint           n_pages)
+{
+	gint i;
+
+	for (i = 0; i < n_pages; i++) {
+		g_free (results[i].areas);
+		g_free (results[i].matches);
+	}
+
+	g_free (results);
+}
+
+/* Packs the rectangles returned by a backend, a match each */
+static void
+ev_job_find_pack_results (EvFindResults *results,
+			  GList         *matches)
+{
+	GList *l;
+	guint  i;
+
+	results->n_areas = results->n_matches = g_list_length (matches);
+	if (results->n_areas == 0)
+		return;
+
+	results->areas = g_new (EvRectangle, results->n_areas);
+	results->matches = g_new (guint, results->n_areas);
+	for (l = matches, i = 0; l; l = g_list_next (l), i++) {
+		results->areas[i] = *(EvRectangle *) l->data;
+		results->matches[i] = i;
+	}
+
+	g_list_free_full (matches, (GDestroyNotify) ev_rectangle_free);
+}
+
+static void
+ev_job_find_dispose (GObject *object)
+{
+	EvJobFind *job = EV_JOB_FIND (object);
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	if (job->text) {
+		g_free (job->text);
+		job->text = NULL;
+	}
+
+	if (job->pages) {
+		gint i;
+
+		/* The lists point into the results */
+		for (i = 0; i < job->n_pages; i++)
+			g_list_free (job->pages[i]);
+		g_free (job->pages);
+		job->pages = NULL;
+	}
+
+	if (job->results) {
+		ev_job_find_free_results (job->results, job->n_pages);
+		job->results = NULL;
+	}
+
+	if (job->found) {
+		ev_job_find_free_results (job->found, job->n_pages);
+		job->found = NULL;
+	}
+
+	g_clear_pointer (&job->searched, g_free);
+	g_clear_object (&job->index);
+	g_clear_pointer (&job->refine_pages, g_free);
+	g_clear_pointer (&job->folded_text, g_free);
+
+	if (job->texts) {
+		gint i;
+
+		for (i = 0; i < job->n_pages; i++)
+			ev_folded_text_free (job->texts[i]);
+		g_free (job->texts);
+		job->texts = NULL;
+	}
+
+	(* G_OBJECT_CLASS (ev_job_find_parent_class)->dispose) (object);
+}
+
+static void
+ev_job_find_finalize (GObject *object)
+{
+	EvJobFind *job = EV_JOB_FIND (object);
+
+	g_mutex_clear (&job->mutex);
+
+	(* G_OBJECT_CLASS (ev_job_find_parent_class)->finalize) (object);
+}
+
+/* Emits updated for the pages searched since the last time, in order */
+static gboolean
+ev_job_find_emit_updated (EvJobFind *job_find)
+{
+	EvJob *job = EV_JOB (job_find);
+	gint   n_ready;
+
+	g_mutex_lock (&job_find->mutex);
+	job_find->idle_updated_id = 0;
+	for (n_ready = job_find->n_updated; n_ready < job_find->n_pages; n_ready++) {
+		gint page = (job_find->start_page + n_ready) % job_find->n_pages;
+
+		if (!job_find->searched[n_ready])
+			break;
+
+		job_find->results[page] = job_find->found[page];
+		memset (&job_find->found[page], 0, sizeof (EvFindResults));
+	}
+	g_mutex_unlock (&job_find->mutex);
+
+	while (job_find->n_updated < n_ready && !job->cancelled) {
+		gint page = job_find->current_page;
+
+		if (!job_find->has_results)
+			job_find->has_results = (job_find->results[page].n_areas > 0);
+
+		job_find->n_updated++;
+		g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, page);
+		job_find->current_page = (page + 1) % job_find->n_pages;
+	}
+
+	if (job_find->n_updated == job_find->n_pages && !job->cancelled)
+		ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_find_queue_updated_unlocked (EvJobFind *job_find)
+{
+	if (job_find->idle_updated_id > 0)
+		return;
+
+	job_find->idle_updated_id =
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				 (GSourceFunc)ev_job_find_emit_updated,
+				 g_object_ref (job_find),
+				 (GDestroyNotify)g_object_unref);
+}
+
+/* Must be called with the document lock held. The text is case
+ * folded with the runs of spaces collapsed, so that looking for the
+ * folded query in it gives every page where the backend may find it,
+ * including matches across lines.
+ */
+static EvFoldedText *
+ev_job_find_get_page_text (EvJobFind *job_find,
+			   EvPage    *ev_page)
+{
+	gchar        *text;
+	EvFoldedText *folded;
+
+	text = ev_document_text_get_text (EV_DOCUMENT_TEXT (EV_JOB (job_find)->document), ev_page);
+	if (!text)
+		return NULL;
+
+	folded = ev_folded_text_new (text, EV_FOLD_CASE);
+	g_free (text);
+
+	return folded;
+}
+
+/* State shared by the search threads, not modified while searching */
+typedef struct {
+	gboolean      *candidates;
+	EvFindPattern *pattern;
+	gboolean       fold;
+	EvFindOptions  options;
+} EvJobFindSearch;
+
+/* Must be called with the document lock held */
+static void
+ev_job_find_match_pattern (EvJobFind     *job_find,
+			   EvFindPattern *pattern,
+			   EvPage        *ev_page,
+			   EvFindResults *results)
 {
-	GObjectClass *oclass = G_OBJECT_CLASS (class);
-	EvJobClass   *job_class = EV_JOB_CLASS (class);
-
-	oclass->dispose = ev_job_save_dispose;
-	job_class->run = ev_job_save_run;
+	EvDocumentText *document_text = EV_DOCUMENT_TEXT (EV_JOB (job_find)->document);
+	gchar          *text;
+	EvRectangle    *areas = NULL;
+	guint           n_areas;
+
+	text = ev_document_text_get_text (document_text, ev_page);
+	if (text && ev_document_text_get_text_layout (document_text, ev_page, &areas, &n_areas)) {
+		GArray *rects, *matches;
+
+		rects = g_array_new (FALSE, FALSE, sizeof (EvRectangle));
+		matches = g_array_new (FALSE, FALSE, sizeof (guint));
+
+		/* Matching doesn't need the document */
+		ev_document_unlock (EV_JOB (job_find)->document);
+		results->n_matches = ev_find_pattern_find (pattern, text, areas, n_areas,
+							   rects, matches);
+		ev_document_lock (EV_JOB (job_find)->document);
+
+		/* Pages without matches keep NULL arrays */
+		results->n_areas = rects->len;
+		results->areas = (EvRectangle *) g_array_free (rects, rects->len == 0);
+		results->matches = (guint *) g_array_free (matches, matches->len == 0);
+	}
+	g_free (text);
+	g_free (areas);
 }
 
-EvJob *
-ev_job_save_new (EvDocument  *document,
-		 const gchar *uri,
-		 const gchar *document_uri)
+/* Must be called with the document lock held. Case insensitive
+ * searches are matched on the folded text of the page, kept from one
+ * refined search to the next, instead of asking the backend to
+ * extract and normalize the text again for every query. Returns
+ * FALSE when the page has no usable text, for the backend to search
+ * it then.
+ */
+static gboolean
+ev_job_find_match_folded (EvJobFind     *job_find,
+			  EvPage        *ev_page,
+			  gint           page,
+			  EvFindResults *results)
 {
-	EvJobSave *job;
-
-	ev_debug_message (DEBUG_JOBS, "uri: %s, document_uri: %s", uri, document_uri);
+	EvDocumentText *document_text = EV_DOCUMENT_TEXT (EV_JOB (job_find)->document);
+	EvFoldedText   *folded;
+	gboolean        whole_words;
+	EvRectangle    *areas = NULL;
+	guint           n_areas;
+	guint           n_matches = 0;
+
+	folded = job_find->texts ? job_find->texts[page] : NULL;
+	if (!folded) {
+		folded = ev_job_find_get_page_text (job_find, ev_page);
+		if (!folded)
+			return FALSE;
+		if (job_find->texts)
+			job_find->texts[page] = folded;
+	}
 
-	job = g_object_new (EV_TYPE_JOB_SAVE, NULL);
+	/* Most pages have no matches, and their layout isn't needed */
+	whole_words = (job_find->options & EV_FIND_WHOLE_WORDS_ONLY) != 0;
+	ev_document_unlock (EV_JOB (job_find)->document);
+	n_matches = ev_folded_text_find (folded, job_find->text, whole_words,
+					 NULL, 0, NULL, NULL);
+	ev_document_lock (EV_JOB (job_find)->document);
+
+	if (n_matches > 0 &&
+	    ev_document_text_get_text_layout (document_text, ev_page, &areas, &n_areas)) {
+		GArray *rects, *matches;
+
+		rects = g_array_new (FALSE, FALSE, sizeof (EvRectangle));
+		matches = g_array_new (FALSE, FALSE, sizeof (guint));
+
+		ev_document_unlock (EV_JOB (job_find)->document);
+		results->n_matches = ev_folded_text_find (folded, job_find->text, whole_words,
+							  areas, n_areas, rects, matches);
+		ev_document_lock (EV_JOB (job_find)->document);
+
+		/* Pages without matches keep NULL arrays */
+		results->n_areas = rects->len;
+		results->areas = (EvRectangle *) g_array_free (rects, rects->len == 0);
+		results->matches = (guint *) g_array_free (matches, matches->len == 0);
+		g_free (areas);
+	}
 
-	EV_JOB (job)->document = g_object_ref (document);
-	job->uri = g_strdup (uri);
-	job->document_uri = g_strdup (document_uri);
+	if (!job_find->texts)
+		ev_folded_text_free (folded);
 
-	return EV_JOB (job);
+	return TRUE;
 }
 
-/* EvJobFind */
 static void
-ev_job_find_init (EvJobFind *job)
+ev_job_find_search_chunks (EvJobFind       *job_find,
+			   EvJobFindSearch *search)
 {
-	EV_JOB (job)->run_mode = EV_JOB_RUN_MAIN_LOOP;
+	EvJob          *job = EV_JOB (job_find);
+	EvDocumentFind *find = EV_DOCUMENT_FIND (job->document);
+	gboolean        thread_safe;
+
+	/* Thread-safe backends search without the document lock,
+	 * like they render, see ev_job_render_run() */
+	thread_safe = ev_document_is_thread_safe (job->document);
+
+	while (!g_cancellable_is_cancelled (job->cancellable)) {
+		gint first, last, offset;
+
+		first = g_atomic_int_add (&job_find->next_offset, EV_JOB_FIND_CHUNK_SIZE);
+		if (first >= job_find->n_pages)
+			break;
+		last = MIN (first + EV_JOB_FIND_CHUNK_SIZE, job_find->n_pages);
+
+		for (offset = first; offset < last; offset++) {
+			EvFindResults results = { NULL, NULL, 0, 0 };
+			EvPage       *ev_page;
+			GList        *matches = NULL;
+			gint          page;
+
+			if (g_cancellable_is_cancelled (job->cancellable))
+				return;
+
+			page = (job_find->start_page + offset) % job_find->n_pages;
+
+			if ((search->candidates && !search->candidates[page]) ||
+			    (job_find->refine_pages && !job_find->refine_pages[page])) {
+				g_mutex_lock (&job_find->mutex);
+				job_find->searched[offset] = TRUE;
+				g_mutex_unlock (&job_find->mutex);
+				continue;
+			}
+
+			ev_document_lock (job->document);
+			ev_page = ev_document_get_page (job->document, page);
+
+			/* The text of the pages matching the previous query
+			 * is kept, and checked before asking the backend */
+			if (!search->fold && job_find->texts && !job_find->texts[page])
+				job_find->texts[page] = ev_job_find_get_page_text (job_find, ev_page);
+
+			if (search->pattern) {
+				ev_job_find_match_pattern (job_find, search->pattern, ev_page, &results);
+			} else if (search->fold &&
+				   ev_job_find_match_folded (job_find, ev_page, page, &results)) {
+				matches = NULL;
+			} else if (job_find->texts && job_find->texts[page] &&
+				   !strstr (ev_folded_text_get_text (job_find->texts[page]),
+					    job_find->folded_text)) {
+				matches = NULL;
+			} else if (thread_safe) {
+				ev_document_unlock (job->document);
+				matches = ev_document_find_find_text_with_options (find, ev_page, job_find->text,
+										   search->options);
+				ev_document_lock (job->document);
+			} else {
+				matches = ev_document_find_find_text_with_options (find, ev_page, job_find->text,
+										   search->options);
+			}
+			g_object_unref (ev_page);
+			ev_document_unlock (job->document);
+
+			if (matches)
+				ev_job_find_pack_results (&results, matches);
+
+			g_mutex_lock (&job_find->mutex);
+			job_find->found[page] = results;
+			job_find->searched[offset] = TRUE;
+			g_mutex_unlock (&job_find->mutex);
+		}
+
+		/* Report the chunk as a whole */
+		g_mutex_lock (&job_find->mutex);
+		ev_job_find_queue_updated_unlocked (job_find);
+		g_mutex_unlock (&job_find->mutex);
+	}
 }
 
 static void
-ev_job_find_dispose (GObject *object)
+ev_job_find_search_thread (EvJobFind *job_find,
+			   gpointer   search)
 {
-	EvJobFind *job = EV_JOB_FIND (object);
+	ev_job_find_search_chunks (job_find, search);
+}
 
-	ev_debug_message (DEBUG_JOBS, NULL);
+/* A page may contain any of the terms */
+static gboolean *
+ev_job_find_get_terms_candidate_pages (EvJobFind           *job_find,
+				       const gchar * const *terms)
+{
+	gboolean *candidates = NULL;
+	gint      i, j;
 
-	if (job->text) {
-		g_free (job->text);
-		job->text = NULL;
-	}
+	for (i = 0; terms[i]; i++) {
+		gboolean *term_candidates;
 
-	if (job->pages) {
-		gint i;
+		term_candidates = ev_find_index_get_candidate_pages (job_find->index, terms[i]);
+		if (!term_candidates) {
+			g_free (candidates);
+			return NULL;
+		}
 
-		for (i = 0; i < job->n_pages; i++) {
-			g_list_foreach (job->pages[i], (GFunc)ev_rectangle_free, NULL);
-			g_list_free (job->pages[i]);
+		if (!candidates) {
+			candidates = term_candidates;
+			continue;
 		}
 
-		g_free (job->pages);
-		job->pages = NULL;
+		for (j = 0; j < job_find->n_pages; j++)
+			candidates[j] |= term_candidates[j];
+		g_free (term_candidates);
 	}
-	
-	(* G_OBJECT_CLASS (ev_job_find_parent_class)->dispose) (object);
+
+	return candidates;
 }
 
 static gboolean
 ev_job_find_run (EvJob *job)
 {
-	EvJobFind      *job_find = EV_JOB_FIND (job);
-	EvDocumentFind *find = EV_DOCUMENT_FIND (job->document);
-	EvPage         *ev_page;
-	GList          *matches;
+	EvJobFind       *job_find = EV_JOB_FIND (job);
+	EvJobFindSearch  search = { NULL, NULL, FALSE, job_find->options };
+	guint            n_threads = 1;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
-	
-	/* Do not block the main loop */
-	if (!ev_document_doc_mutex_trylock ())
-		return TRUE;
-	
-#ifdef EV_ENABLE_DEBUG
-	/* We use the #ifdef in this case because of the if */
-	if (job_find->current_page == job_find->start_page)
-		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
-#endif
-
-	ev_page = ev_document_get_page (job->document, job_find->current_page);
-	matches = ev_document_find_find_text_with_options (find, ev_page, job_find->text,
-                                                           job_find->options);
-	g_object_unref (ev_page);
-	
-	ev_document_doc_mutex_unlock ();
-
-	if (!job_find->has_results)
-		job_find->has_results = (matches != NULL);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	job_find->pages[job_find->current_page] = matches;
-	g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, job_find->current_page);
-		       
-	job_find->current_page = (job_find->current_page + 1) % job_find->n_pages;
-	if (job_find->current_page == job_find->start_page) {
+	if (job_find->n_pages == 0) {
 		ev_job_succeeded (job);
 
 		return FALSE;
 	}
 
-	return TRUE;
+	/* Regular expressions and lists of terms are compiled once and
+	 * matched on the text of the pages, backends don't know them */
+	search.options &= ~EV_FIND_PATTERN_OPTIONS;
+	if ((job_find->options & EV_FIND_PATTERN_OPTIONS) && EV_IS_DOCUMENT_TEXT (job->document)) {
+		GError *error = NULL;
+
+		search.pattern = ev_find_pattern_new (job_find->text, job_find->options, &error);
+		if (!search.pattern) {
+			ev_job_failed_from_error (job, error);
+			g_error_free (error);
+
+			return FALSE;
+		}
+	}
+
+	search.fold = !search.pattern &&
+		!(job_find->options & EV_FIND_CASE_SENSITIVE) &&
+		EV_IS_DOCUMENT_TEXT (job->document);
+
+	/* Only the pages where the index says the text may be
+	 * are searched, the others have no results */
+	if (job_find->index &&
+	    ev_find_index_get_n_pages (job_find->index) == job_find->n_pages) {
+		if (!search.pattern)
+			search.candidates = ev_find_index_get_candidate_pages (job_find->index, job_find->text);
+		else if (ev_find_pattern_get_terms (search.pattern))
+			search.candidates = ev_job_find_get_terms_candidate_pages (job_find,
+										   ev_find_pattern_get_terms (search.pattern));
+	}
+
+	if (ev_document_is_thread_safe (job->document)) {
+		n_threads = CLAMP (g_get_num_processors (), 1, EV_JOB_FIND_MAX_THREADS);
+		n_threads = MIN (n_threads, (job_find->n_pages + EV_JOB_FIND_CHUNK_SIZE - 1) / EV_JOB_FIND_CHUNK_SIZE);
+	}
+
+	if (n_threads > 1) {
+		GThreadPool *pool;
+		guint        i;
+
+		pool = g_thread_pool_new ((GFunc) ev_job_find_search_thread, &search,
+					  n_threads, TRUE, NULL);
+		for (i = 0; i < n_threads; i++)
+			g_thread_pool_push (pool, job_find, NULL);
+		/* Waits for all the chunks to be searched */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	} else {
+		ev_job_find_search_chunks (job_find, &search);
+	}
+
+	g_free (search.candidates);
+	ev_find_pattern_free (search.pattern);
+
+	return FALSE;
 }
 
 static void
@@ -1702,6 +3673,7 @@ ev_job_find_class_init (EvJobFindClass *class)
 	
 	job_class->run = ev_job_find_run;
 	gobject_class->dispose = ev_job_find_dispose;
+	gobject_class->finalize = ev_job_find_finalize;
 	
 	job_find_signals[FIND_UPDATED] =
 		g_signal_new ("updated",
@@ -1731,8 +3703,13 @@ ev_job_find_new (EvDocument  *document,
 	job->start_page = start_page;
 	job->current_page = start_page;
 	job->n_pages = n_pages;
-	job->pages = g_new0 (GList *, n_pages);
+	job->results = g_new0 (EvFindResults, n_pages);
+	job->found = g_new0 (EvFindResults, n_pages);
+	job->searched = g_new0 (gboolean, n_pages);
 	job->text = g_strdup (text);
+	job->index = ev_find_index_get_for_document (document);
+	if (job->index)
+		g_object_ref (job->index);
         /* Keep for compatibility */
 	job->case_sensitive = case_sensitive;
 	job->has_results = FALSE;
@@ -1772,30 +3749,86 @@ ev_job_find_get_options (EvJobFind *job)
         return job->options;
 }
 
+/**
+ * ev_job_find_refine:
+ * @job: an #EvJobFind that hasn't been scheduled yet
+ * @previous: a finished #EvJobFind for the same document
+ *
+ * Makes @job reuse the results of @previous, when the text of @job
+ * contains the text of @previous with the same options, like when a
+ * character is typed in the search entry. Pages where @previous found
+ * nothing are skipped then, and the text of the other pages is kept
+ * from one job to the next, so that case insensitive searches match
+ * it directly, and other pages are only searched by the backend when
+ * their text contains the new query. The text kept by @previous is
+ * moved to @job.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_find_refine (EvJobFind *job,
+		    EvJobFind *previous)
+{
+	gchar *folded_previous;
+	gint   i;
+
+	g_return_if_fail (EV_IS_JOB_FIND (job));
+	g_return_if_fail (EV_IS_JOB_FIND (previous));
+
+	if (!ev_job_is_finished (EV_JOB (previous)) || ev_job_is_failed (EV_JOB (previous)))
+		return;
+
+	if (EV_JOB (previous)->document != EV_JOB (job)->document ||
+	    previous->n_pages != job->n_pages ||
+	    previous->options != job->options)
+		return;
+
+	/* A whole word match of the new query doesn't contain
+	 * a whole word match of the previous one, and neither do
+	 * matches of patterns */
+	if (job->options & (EV_FIND_WHOLE_WORDS_ONLY | EV_FIND_PATTERN_OPTIONS))
+		return;
+
+	job->folded_text = ev_fold_text (job->text, EV_FOLD_CASE);
+	folded_previous = ev_fold_text (previous->text, EV_FOLD_CASE);
+	if (job->options & EV_FIND_CASE_SENSITIVE ?
+	    !strstr (job->text, previous->text) :
+	    !strstr (job->folded_text, folded_previous)) {
+		g_free (folded_previous);
+		g_clear_pointer (&job->folded_text, g_free);
+		return;
+	}
+	g_free (folded_previous);
+
+	job->refine_pages = g_new (gboolean, job->n_pages);
+	for (i = 0; i < job->n_pages; i++)
+		job->refine_pages[i] = previous->results[i].n_areas > 0;
+
+	if (!EV_IS_DOCUMENT_TEXT (EV_JOB (job)->document))
+		return;
+
+	job->texts = previous->texts ? previous->texts : g_new0 (EvFoldedText *, job->n_pages);
+	previous->texts = NULL;
+	for (i = 0; i < job->n_pages; i++) {
+		if (!job->refine_pages[i])
+			g_clear_pointer (&job->texts[i], ev_folded_text_free);
+	}
+}
+
 gint
 ev_job_find_get_n_results (EvJobFind *job,
 			   gint       page)
 {
-	return g_list_length (job->pages[page]);
+	return job->results[page].n_areas;
 }
 
 gdouble
 ev_job_find_get_progress (EvJobFind *job)
 {
-	gint pages_done;
-
 	if (ev_job_is_finished (EV_JOB (job)))
 		return 1.0;
-	
-	if (job->current_page > job->start_page) {
-		pages_done = job->current_page - job->start_page + 1;
-	} else if (job->current_page == job->start_page) {
-		pages_done = job->n_pages;
-	} else {
-		pages_done = job->n_pages - job->start_page + job->current_page;
-	}
 
-	return pages_done / (gdouble) job->n_pages;
+	return job->n_updated / (gdouble) job->n_pages;
 }
 
 gboolean
@@ -1808,14 +3841,146 @@ ev_job_find_has_results (EvJobFind *job)
  * ev_job_find_get_results: (skip)
  * @job: an #EvJobFind
  *
+ * The lists are built from the results of the pages searched so far,
+ * and point into them. Use ev_job_find_get_page_results() instead.
+ *
  * Returns: a #GList of #GList<!-- -->s containing #EvRectangle<!-- -->s
  */
 GList **
 ev_job_find_get_results (EvJobFind *job)
 {
+	gint i;
+
+	if (!job->pages)
+		job->pages = g_new0 (GList *, job->n_pages);
+
+	for (i = 0; i < job->n_pages; i++) {
+		EvFindResults *results = &job->results[i];
+		gint           j;
+
+		if (job->pages[i] || results->n_areas == 0)
+			continue;
+
+		for (j = results->n_areas - 1; j >= 0; j--)
+			job->pages[i] = g_list_prepend (job->pages[i], &results->areas[j]);
+	}
+
 	return job->pages;
 }
 
+/**
+ * ev_job_find_get_page_results: (skip)
+ * @job: an #EvJobFind
+ * @page: a page index
+ *
+ * Returns: the results of @page, or %NULL if it has none or
+ *   hasn't been searched yet
+ *
+ * Since: 3.30
+ */
+const EvFindResults *
+ev_job_find_get_page_results (EvJobFind *job,
+			      gint       page)
+{
+	g_return_val_if_fail (EV_IS_JOB_FIND (job), NULL);
+	g_return_val_if_fail (page >= 0 && page < job->n_pages, NULL);
+
+	return job->results[page].n_areas > 0 ? &job->results[page] : NULL;
+}
+
+/* EvJobFindIndex */
+static void
+ev_job_find_index_init (EvJobFindIndex *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+static void
+ev_job_find_index_dispose (GObject *object)
+{
+	EvJobFindIndex *job = EV_JOB_FIND_INDEX (object);
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	g_clear_object (&job->index);
+
+	(* G_OBJECT_CLASS (ev_job_find_index_parent_class)->dispose) (object);
+}
+
+static gboolean
+ev_job_find_index_run (EvJob *job)
+{
+	EvJobFindIndex *job_index = EV_JOB_FIND_INDEX (job);
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	job_index->index = ev_find_index_load (job->document);
+	if (!job_index->index)
+		job_index->index = ev_find_index_build (job->document, job->cancellable);
+
+	if (job_index->index)
+		ev_job_succeeded (job);
+	else if (!g_cancellable_is_cancelled (job->cancellable))
+		ev_job_failed (job,
+			       EV_DOCUMENT_ERROR,
+			       EV_DOCUMENT_ERROR_INVALID,
+			       "Failed to index document");
+
+	return FALSE;
+}
+
+static void
+ev_job_find_index_class_init (EvJobFindIndexClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_find_index_dispose;
+	job_class->run = ev_job_find_index_run;
+}
+
+/**
+ * ev_job_find_index_new:
+ * @document: an #EvDocument
+ *
+ * Creates a job that loads the index of @document from the cache,
+ * or builds it if there's none, see ev_find_index_is_supported().
+ *
+ * Returns: (transfer full): a new #EvJobFindIndex
+ *
+ * Since: 3.30
+ */
+EvJob *
+ev_job_find_index_new (EvDocument *document)
+{
+	EvJob *job;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	job = g_object_new (EV_TYPE_JOB_FIND_INDEX, NULL);
+	job->document = g_object_ref (document);
+
+	return job;
+}
+
+/**
+ * ev_job_find_index_get_index:
+ * @job: an #EvJobFindIndex
+ *
+ * Returns: (transfer none) (allow-none): the index, once @job has
+ *   succeeded
+ *
+ * Since: 3.30
+ */
+EvFindIndex *
+ev_job_find_index_get_index (EvJobFindIndex *job)
+{
+	g_return_val_if_fail (EV_IS_JOB_FIND_INDEX (job), NULL);
+
+	return job->index;
+}
+
 /* EvJobLayers */
 static void
 ev_job_layers_init (EvJobLayers *job)
@@ -1848,9 +4013,9 @@ ev_job_layers_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	job_layers->model = ev_document_layers_get_layers (EV_DOCUMENT_LAYERS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 	
 	ev_job_succeeded (job);
 	
@@ -1902,6 +4067,8 @@ ev_job_export_dispose (GObject *object)
 		job->rc = NULL;
 	}
 
+	g_clear_pointer (&job->rendered_page, cairo_surface_destroy);
+
 	(* G_OBJECT_CLASS (ev_job_export_parent_class)->dispose) (object);
 }
 
@@ -1916,7 +4083,7 @@ ev_job_export_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	
 	ev_page = ev_document_get_page (job->document, job_export->page);
 	if (job_export->rc) {
@@ -1930,9 +4097,16 @@ ev_job_export_run (EvJob *job)
 	}
 	g_object_unref (ev_page);
 	
-	ev_file_exporter_do_page (EV_FILE_EXPORTER (job->document), job_export->rc);
+	if (job_export->rendered_page) {
+		ev_file_exporter_do_rendered_page (EV_FILE_EXPORTER (job->document),
+						   job_export->rc,
+						   job_export->rendered_page);
+		g_clear_pointer (&job_export->rendered_page, cairo_surface_destroy);
+	} else {
+		ev_file_exporter_do_page (EV_FILE_EXPORTER (job->document), job_export->rc);
+	}
 	
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 	
 	ev_job_succeeded (job);
 	
@@ -1969,6 +4143,120 @@ ev_job_export_set_page (EvJobExport *job,
 	job->page = page;
 }
 
+/**
+ * ev_job_export_set_rendered_page:
+ * @job: an #EvJobExport
+ * @page: (nullable): the page of @job rendered by an #EvJobExportRender
+ *
+ * Makes the next run of @job export @page instead of rendering
+ * the page again. It's only used once.
+ *
+ * Since: 3.30
+ */
+void
+ev_job_export_set_rendered_page (EvJobExport     *job,
+				 cairo_surface_t *page)
+{
+	g_clear_pointer (&job->rendered_page, cairo_surface_destroy);
+	if (page)
+		job->rendered_page = cairo_surface_reference (page);
+}
+
+/* EvJobExportRender */
+static void
+ev_job_export_render_init (EvJobExportRender *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+	job->page = -1;
+}
+
+static void
+ev_job_export_render_dispose (GObject *object)
+{
+	EvJobExportRender *job = EV_JOB_EXPORT_RENDER (object);
+
+	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job->page, job);
+
+	g_clear_pointer (&job->surface, cairo_surface_destroy);
+
+	(* G_OBJECT_CLASS (ev_job_export_render_parent_class)->dispose) (object);
+}
+
+/* Only the page lookup needs the document lock, exporters
+ * that can render pages do it concurrently with the export.
+ */
+static gboolean
+ev_job_export_render_run (EvJob *job)
+{
+	EvJobExportRender *job_render = EV_JOB_EXPORT_RENDER (job);
+	EvPage            *ev_page;
+	EvRenderContext   *rc;
+
+	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	ev_document_lock (job->document);
+	ev_page = ev_document_get_page (job->document, job_render->page);
+	ev_document_unlock (job->document);
+
+	rc = ev_render_context_new (ev_page, 0, 1.0);
+	g_object_unref (ev_page);
+
+	job_render->surface = ev_file_exporter_render_page (EV_FILE_EXPORTER (job->document), rc);
+	g_object_unref (rc);
+
+	if (!job_render->surface) {
+		ev_job_failed (job,
+			       EV_DOCUMENT_ERROR,
+			       EV_DOCUMENT_ERROR_INVALID,
+			       _("Failed to render page %d"),
+			       job_render->page);
+		return FALSE;
+	}
+
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_export_render_class_init (EvJobExportRenderClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_export_render_dispose;
+	job_class->run = ev_job_export_render_run;
+}
+
+/**
+ * ev_job_export_render_new:
+ * @document: an #EvDocument implementing an #EvFileExporter with
+ *   %EV_FILE_EXPORTER_CAN_RENDER_PAGES
+ * @page: the index of the page to render
+ *
+ * Creates a job rendering @page with ev_file_exporter_render_page(),
+ * so that it can be exported later with ev_job_export_set_rendered_page().
+ *
+ * Returns: (transfer full): a new #EvJobExportRender
+ *
+ * Since: 3.30
+ */
+EvJob *
+ev_job_export_render_new (EvDocument *document,
+			  gint        page)
+{
+	EvJobExportRender *job;
+
+	ev_debug_message (DEBUG_JOBS, "page: %d", page);
+
+	job = g_object_new (EV_TYPE_JOB_EXPORT_RENDER, NULL);
+	EV_JOB (job)->document = g_object_ref (document);
+	job->page = page;
+
+	return EV_JOB (job);
+}
+
 /* EvJobPrint */
 static void
 ev_job_print_init (EvJobPrint *job)
@@ -2011,14 +4299,14 @@ ev_job_print_run (EvJob *job)
 	job->finished = FALSE;
 	g_clear_error (&job->error);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_print->page);
 	ev_document_print_print_page (EV_DOCUMENT_PRINT (job->document),
 				      ev_page, job_print->cr);
 	g_object_unref (ev_page);
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
         if (g_cancellable_is_cancelled (job->cancellable))
                 return FALSE;
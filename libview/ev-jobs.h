@@ -31,6 +31,8 @@
 
 #include <evince-document.h>
 
+#include "ev-find-index.h"
+
 G_BEGIN_DECLS
 
 typedef struct _EvJob EvJob;
@@ -39,12 +41,18 @@ typedef struct _EvJobClass EvJobClass;
 typedef struct _EvJobRender EvJobRender;
 typedef struct _EvJobRenderClass EvJobRenderClass;
 
+typedef struct _EvJobSelection EvJobSelection;
+typedef struct _EvJobSelectionClass EvJobSelectionClass;
+
 typedef struct _EvJobPageData EvJobPageData;
 typedef struct _EvJobPageDataClass EvJobPageDataClass;
 
 typedef struct _EvJobThumbnail EvJobThumbnail;
 typedef struct _EvJobThumbnailClass EvJobThumbnailClass;
 
+typedef struct _EvJobThumbnailBatch EvJobThumbnailBatch;
+typedef struct _EvJobThumbnailBatchClass EvJobThumbnailBatchClass;
+
 typedef struct _EvJobLinks EvJobLinks;
 typedef struct _EvJobLinksClass EvJobLinksClass;
 
@@ -57,6 +65,9 @@ typedef struct _EvJobAnnotsClass EvJobAnnotsClass;
 typedef struct _EvJobFonts EvJobFonts;
 typedef struct _EvJobFontsClass EvJobFontsClass;
 
+typedef struct _EvJobSelectedText EvJobSelectedText;
+typedef struct _EvJobSelectedTextClass EvJobSelectedTextClass;
+
 typedef struct _EvJobLoad EvJobLoad;
 typedef struct _EvJobLoadClass EvJobLoadClass;
 
@@ -72,12 +83,18 @@ typedef struct _EvJobSaveClass EvJobSaveClass;
 typedef struct _EvJobFind EvJobFind;
 typedef struct _EvJobFindClass EvJobFindClass;
 
+typedef struct _EvJobFindIndex EvJobFindIndex;
+typedef struct _EvJobFindIndexClass EvJobFindIndexClass;
+
 typedef struct _EvJobLayers EvJobLayers;
 typedef struct _EvJobLayersClass EvJobLayersClass;
 
 typedef struct _EvJobExport EvJobExport;
 typedef struct _EvJobExportClass EvJobExportClass;
 
+typedef struct _EvJobExportRender EvJobExportRender;
+typedef struct _EvJobExportRenderClass EvJobExportRenderClass;
+
 typedef struct _EvJobPrint EvJobPrint;
 typedef struct _EvJobPrintClass EvJobPrintClass;
 
@@ -116,6 +133,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_RENDER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_RENDER))
 #define EV_JOB_RENDER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_RENDER, EvJobRenderClass))
 
+#define EV_TYPE_JOB_SELECTION            (ev_job_selection_get_type())
+#define EV_JOB_SELECTION(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_SELECTION, EvJobSelection))
+#define EV_IS_JOB_SELECTION(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_SELECTION))
+#define EV_JOB_SELECTION_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_SELECTION, EvJobSelectionClass))
+#define EV_IS_JOB_SELECTION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_SELECTION))
+#define EV_JOB_SELECTION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_SELECTION, EvJobSelectionClass))
+
 #define EV_TYPE_JOB_PAGE_DATA            (ev_job_page_data_get_type())
 #define EV_JOB_PAGE_DATA(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_PAGE_DATA, EvJobPageData))
 #define EV_IS_JOB_PAGE_DATA(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_PAGE_DATA))
@@ -130,6 +154,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_THUMBNAIL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_THUMBNAIL))
 #define EV_JOB_THUMBNAIL_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_THUMBNAIL, EvJobThumbnailClass))
 
+#define EV_TYPE_JOB_THUMBNAIL_BATCH            (ev_job_thumbnail_batch_get_type())
+#define EV_JOB_THUMBNAIL_BATCH(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_THUMBNAIL_BATCH, EvJobThumbnailBatch))
+#define EV_IS_JOB_THUMBNAIL_BATCH(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_THUMBNAIL_BATCH))
+#define EV_JOB_THUMBNAIL_BATCH_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_THUMBNAIL_BATCH, EvJobThumbnailBatchClass))
+#define EV_IS_JOB_THUMBNAIL_BATCH_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_THUMBNAIL_BATCH))
+#define EV_JOB_THUMBNAIL_BATCH_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_THUMBNAIL_BATCH, EvJobThumbnailBatchClass))
+
 #define EV_TYPE_JOB_FONTS            (ev_job_fonts_get_type())
 #define EV_JOB_FONTS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_FONTS, EvJobFonts))
 #define EV_IS_JOB_FONTS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_FONTS))
@@ -137,6 +168,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_FONTS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_FONTS))
 #define EV_JOB_FONTS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_FONTS, EvJobFontsClass))
 
+#define EV_TYPE_JOB_SELECTED_TEXT            (ev_job_selected_text_get_type())
+#define EV_JOB_SELECTED_TEXT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_SELECTED_TEXT, EvJobSelectedText))
+#define EV_IS_JOB_SELECTED_TEXT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_SELECTED_TEXT))
+#define EV_JOB_SELECTED_TEXT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_SELECTED_TEXT, EvJobSelectedTextClass))
+#define EV_IS_JOB_SELECTED_TEXT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_SELECTED_TEXT))
+#define EV_JOB_SELECTED_TEXT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_SELECTED_TEXT, EvJobSelectedTextClass))
+
 
 #define EV_TYPE_JOB_LOAD            (ev_job_load_get_type())
 #define EV_JOB_LOAD(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_LOAD, EvJobLoad))
@@ -173,6 +211,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_FIND_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_FIND))
 #define EV_JOB_FIND_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_FIND, EvJobFindClass))
 
+#define EV_TYPE_JOB_FIND_INDEX            (ev_job_find_index_get_type())
+#define EV_JOB_FIND_INDEX(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_FIND_INDEX, EvJobFindIndex))
+#define EV_IS_JOB_FIND_INDEX(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_FIND_INDEX))
+#define EV_JOB_FIND_INDEX_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_FIND_INDEX, EvJobFindIndexClass))
+#define EV_IS_JOB_FIND_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_FIND_INDEX))
+#define EV_JOB_FIND_INDEX_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_FIND_INDEX, EvJobFindIndexClass))
+
 #define EV_TYPE_JOB_LAYERS            (ev_job_layers_get_type())
 #define EV_JOB_LAYERS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_LAYERS, EvJobLayers))
 #define EV_IS_JOB_LAYERS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_LAYERS))
@@ -187,6 +232,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_EXPORT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_EXPORT))
 #define EV_JOB_EXPORT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_EXPORT, EvJobExportClass))
 
+#define EV_TYPE_JOB_EXPORT_RENDER            (ev_job_export_render_get_type())
+#define EV_JOB_EXPORT_RENDER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_EXPORT_RENDER, EvJobExportRender))
+#define EV_IS_JOB_EXPORT_RENDER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_EXPORT_RENDER))
+#define EV_JOB_EXPORT_RENDER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_EXPORT_RENDER, EvJobExportRenderClass))
+#define EV_IS_JOB_EXPORT_RENDER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_EXPORT_RENDER))
+#define EV_JOB_EXPORT_RENDER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_EXPORT_RENDER, EvJobExportRenderClass))
+
 #define EV_TYPE_JOB_PRINT            (ev_job_print_get_type())
 #define EV_JOB_PRINT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_PRINT, EvJobPrint))
 #define EV_IS_JOB_PRINT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_PRINT))
@@ -194,6 +246,18 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_PRINT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_PRINT))
 #define EV_JOB_PRINT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_PRINT, EvJobPrintClass))
 
+/**
+ * EvJobThenFunc:
+ * @job: the #EvJob that succeeded
+ * @user_data: the data given to ev_job_then()
+ *
+ * Called in the thread that ran @job, right after it succeeded.
+ *
+ * Since: 3.30
+ */
+typedef void (*EvJobThenFunc) (EvJob   *job,
+			       gpointer user_data);
+
 typedef enum {
 	EV_JOB_RUN_THREAD,
 	EV_JOB_RUN_MAIN_LOOP
@@ -210,12 +274,15 @@ struct _EvJob
 	guint cancelled : 1;
 	guint finished : 1;
 	guint failed : 1;
+	guint background : 1;
 	
 	GError *error;
 	GCancellable *cancellable;
 
 	guint idle_finished_id;
 	guint idle_cancelled_id;
+
+	GSList *continuations;
 };
 
 struct _EvJobClass
@@ -257,12 +324,24 @@ struct _EvJobAnnots
 {
 	EvJob parent;
 
-	GList *annots;
+	gint start_page;
+	gint n_pages;
+	gint n_visited;
+
+	/* Protected by mutex */
+	GMutex mutex;
+	GQueue ready;
+	gboolean done;
+	guint idle_ready_id;
 };
 
 struct _EvJobAnnotsClass
 {
 	EvJobClass parent_class;
+
+	/* Signals */
+	void (* annots_ready) (EvJobAnnots   *job,
+			       EvMappingList *mapping_list);
 };
 
 struct _EvJobRender
@@ -285,6 +364,16 @@ struct _EvJobRender
 	EvSelectionStyle selection_style;
 	GdkColor base;
 	GdkColor text;
+
+	cairo_rectangle_int_t area;
+	gboolean draft;
+	gboolean mask_monochrome;
+
+	EvRenderLayer layer;
+	cairo_surface_t *annotations;
+
+	/* In microseconds */
+	gint64 render_time;
 };
 
 struct _EvJobRenderClass
@@ -292,6 +381,31 @@ struct _EvJobRenderClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobSelection
+{
+	EvJob parent;
+
+	gint page;
+	gdouble scale;
+	gint target_width;
+	gint target_height;
+
+	EvRectangle points;
+	EvSelectionStyle style;
+
+	gboolean render_surface;
+	GdkColor base;
+	GdkColor text;
+
+	cairo_surface_t *selection;
+	cairo_region_t *selection_region;
+};
+
+struct _EvJobSelectionClass
+{
+	EvJobClass parent_class;
+};
+
 typedef enum {
         EV_PAGE_DATA_INCLUDE_NONE           = 0,
         EV_PAGE_DATA_INCLUDE_LINKS          = 1 << 0,
@@ -360,10 +474,42 @@ struct _EvJobThumbnailClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobThumbnailBatch
+{
+	EvJob parent;
+
+	gint rotation;
+
+	/* Protected by mutex */
+	GMutex mutex;
+	GQueue pending;
+	GQueue ready;
+	gboolean done;
+	guint idle_ready_id;
+};
+
+struct _EvJobThumbnailBatchClass
+{
+	EvJobClass parent_class;
+
+	/* Signals */
+	void (* thumbnail_ready) (EvJobThumbnailBatch *job,
+				  gint                 page,
+				  cairo_surface_t     *surface);
+};
+
 struct _EvJobFonts
 {
 	EvJob parent;
+
+	GtkListStore *model;
+
+	/* Protected by mutex */
+	GMutex mutex;
+	GQueue ready;
+	gdouble progress;
 	gboolean scan_completed;
+	guint idle_ready_id;
 };
 
 struct _EvJobFontsClass
@@ -375,17 +521,51 @@ struct _EvJobFontsClass
 			   gdouble     progress);
 };
 
+struct _EvJobSelectedText
+{
+	EvJob parent;
+
+	GArray *selections;
+	guint next_selection;
+	GString *buffer;
+	gchar *text;
+
+	/* Protected by mutex */
+	GMutex mutex;
+	gdouble progress;
+	guint idle_updated_id;
+};
+
+struct _EvJobSelectedTextClass
+{
+	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated) (EvJobSelectedText *job,
+			  gdouble            progress);
+};
+
 struct _EvJobLoad
 {
 	EvJob parent;
 
 	gchar *uri;
 	gchar *password;
+	EvDocumentLoadFlags flags;
+
+	/* Protected by mutex */
+	GMutex mutex;
+	gdouble progress;
+	guint idle_updated_id;
 };
 
 struct _EvJobLoadClass
 {
 	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated) (EvJobLoad *job,
+			  gdouble    progress);
 };
 
 struct _EvJobLoadStream
@@ -395,6 +575,7 @@ struct _EvJobLoadStream
         char *password;
         GInputStream *stream;
         EvDocumentLoadFlags flags;
+        char *mime_type;
 };
 
 struct _EvJobLoadStreamClass
@@ -429,6 +610,25 @@ struct _EvJobSaveClass
 	EvJobClass parent_class;
 };
 
+/**
+ * EvFindResults:
+ * @areas: the rectangles of the matches in a page, in order
+ * @matches: the index of the match of every rectangle, matches
+ *   spanning several lines have a rectangle per line
+ * @n_areas: the number of @areas, 0 when the page has no results
+ * @n_matches: the number of matches
+ *
+ * The find results of a page.
+ *
+ * Since: 3.30
+ */
+typedef struct {
+	EvRectangle *areas;
+	guint       *matches;
+	guint        n_areas;
+	guint        n_matches;
+} EvFindResults;
+
 struct _EvJobFind
 {
 	EvJob parent;
@@ -436,11 +636,28 @@ struct _EvJobFind
 	gint start_page;
 	gint current_page;
 	gint n_pages;
+	EvFindResults *results;
+	/* Built by ev_job_find_get_results(), for compatibility */
 	GList **pages;
 	gchar *text;
 	gboolean case_sensitive;
 	gboolean has_results;
         EvFindOptions options;
+
+	/* Search threads state, protected by mutex */
+	GMutex mutex;
+	EvFindResults *found;
+	gboolean *searched;
+	gint next_offset;
+	guint idle_updated_id;
+	gint n_updated;
+
+	EvFindIndex *index;
+
+	/* Set by ev_job_find_refine() */
+	gboolean *refine_pages;
+	EvFoldedText **texts;
+	gchar *folded_text;
 };
 
 struct _EvJobFindClass
@@ -452,6 +669,18 @@ struct _EvJobFindClass
 			   gint       page);
 };
 
+struct _EvJobFindIndex
+{
+	EvJob parent;
+
+	EvFindIndex *index;
+};
+
+struct _EvJobFindIndexClass
+{
+	EvJobClass parent_class;
+};
+
 struct _EvJobLayers
 {
 	EvJob parent;
@@ -470,6 +699,7 @@ struct _EvJobExport
 
 	gint page;
 	EvRenderContext *rc;
+	cairo_surface_t *rendered_page;
 };
 
 struct _EvJobExportClass
@@ -477,6 +707,19 @@ struct _EvJobExportClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobExportRender
+{
+	EvJob parent;
+
+	gint page;
+	cairo_surface_t *surface;
+};
+
+struct _EvJobExportRenderClass
+{
+	EvJobClass parent_class;
+};
+
 struct _EvJobPrint
 {
 	EvJob parent;
@@ -507,6 +750,15 @@ gboolean        ev_job_is_failed          (EvJob          *job);
 EvJobRunMode    ev_job_get_run_mode       (EvJob          *job);
 void            ev_job_set_run_mode       (EvJob          *job,
 					   EvJobRunMode    run_mode);
+gboolean        ev_job_is_background      (EvJob          *job);
+void            ev_job_set_background     (EvJob          *job,
+					   gboolean        background);
+void            ev_job_then               (EvJob          *job,
+					   EvJobThenFunc   func,
+					   gpointer        user_data,
+					   GDestroyNotify  destroy);
+void            _ev_job_notify_after_batch (GFunc          func,
+					    gpointer       user_data);
 
 /* EvJobLinks */
 GType           ev_job_links_get_type     (void) G_GNUC_CONST;
@@ -520,6 +772,8 @@ EvJob          *ev_job_attachments_new      (EvDocument     *document);
 /* EvJobAnnots */
 GType           ev_job_annots_get_type      (void) G_GNUC_CONST;
 EvJob          *ev_job_annots_new           (EvDocument     *document);
+void            ev_job_annots_set_start_page (EvJobAnnots   *job,
+					      gint           start_page);
 
 /* EvJobRender */
 GType           ev_job_render_get_type    (void) G_GNUC_CONST;
@@ -534,6 +788,27 @@ void     ev_job_render_set_selection_info (EvJobRender     *job,
 					   EvSelectionStyle selection_style,
 					   GdkColor        *text,
 					   GdkColor        *base);
+void     ev_job_render_set_area           (EvJobRender     *job,
+					   const cairo_rectangle_int_t *area);
+void     ev_job_render_set_draft          (EvJobRender     *job,
+					   gboolean         draft);
+void     ev_job_render_set_layer          (EvJobRender     *job,
+					   EvRenderLayer    layer);
+void     ev_job_render_set_mask_monochrome (EvJobRender    *job,
+					    gboolean        mask_monochrome);
+
+/* EvJobSelection */
+GType           ev_job_selection_get_type (void) G_GNUC_CONST;
+EvJob          *ev_job_selection_new      (EvDocument      *document,
+					   gint             page,
+					   gdouble          scale,
+					   gint             width,
+					   gint             height,
+					   EvRectangle     *points,
+					   EvSelectionStyle style);
+void     ev_job_selection_set_render_surface (EvJobSelection *job,
+					      GdkColor       *text,
+					      GdkColor       *base);
 /* EvJobPageData */
 GType           ev_job_page_data_get_type (void) G_GNUC_CONST;
 EvJob          *ev_job_page_data_new      (EvDocument      *document,
@@ -555,9 +830,31 @@ void            ev_job_thumbnail_set_has_frame (EvJobThumbnail  *job,
                                                 gboolean         has_frame);
 void            ev_job_thumbnail_set_output_format (EvJobThumbnail      *job,
                                                     EvJobThumbnailFormat format);
+
+/* EvJobThumbnailBatch */
+GType           ev_job_thumbnail_batch_get_type     (void) G_GNUC_CONST;
+EvJob          *ev_job_thumbnail_batch_new          (EvDocument          *document,
+						     gint                 rotation);
+gboolean        ev_job_thumbnail_batch_add_page     (EvJobThumbnailBatch *job,
+						     gint                 page,
+						     gint                 target_width,
+						     gint                 target_height);
+void            ev_job_thumbnail_batch_remove_pages (EvJobThumbnailBatch *job,
+						     gint                 start_page,
+						     gint                 end_page);
 /* EvJobFonts */
 GType 		ev_job_fonts_get_type 	  (void) G_GNUC_CONST;
 EvJob 	       *ev_job_fonts_new 	  (EvDocument      *document);
+GtkTreeModel   *ev_job_fonts_get_model    (EvJobFonts      *job);
+
+/* EvJobSelectedText */
+GType           ev_job_selected_text_get_type (void) G_GNUC_CONST;
+EvJob          *ev_job_selected_text_new      (EvDocument        *document);
+void            ev_job_selected_text_add_page (EvJobSelectedText *job,
+					       gint               page,
+					       EvSelectionStyle   style,
+					       EvRectangle       *points);
+const gchar    *ev_job_selected_text_get_text (EvJobSelectedText *job);
 
 /* EvJobLoad */
 GType 		ev_job_load_get_type 	  (void) G_GNUC_CONST;
@@ -566,6 +863,8 @@ void            ev_job_load_set_uri       (EvJobLoad       *load,
 					   const gchar     *uri);
 void            ev_job_load_set_password  (EvJobLoad       *job,
 					   const gchar     *password);
+void            ev_job_load_set_load_flags (EvJobLoad      *job,
+					    EvDocumentLoadFlags flags);
 
 /* EvJobLoadStream */
 GType           ev_job_load_stream_get_type       (void) G_GNUC_CONST;
@@ -577,6 +876,8 @@ void            ev_job_load_stream_set_load_flags (EvJobLoadStream    *job,
                                                    EvDocumentLoadFlags flags);
 void            ev_job_load_stream_set_password   (EvJobLoadStream    *job,
                                                    const gchar        *password);
+void            ev_job_load_stream_set_mime_type  (EvJobLoadStream    *job,
+                                                   const gchar        *mime_type);
 
 /* EvJobLoadGFile */
 GType           ev_job_load_gfile_get_type        (void) G_GNUC_CONST;
@@ -604,11 +905,20 @@ EvJob          *ev_job_find_new           (EvDocument      *document,
 void            ev_job_find_set_options   (EvJobFind       *job,
                                            EvFindOptions    options);
 EvFindOptions   ev_job_find_get_options   (EvJobFind       *job);
+void            ev_job_find_refine        (EvJobFind       *job,
+					   EvJobFind       *previous);
 gint            ev_job_find_get_n_results (EvJobFind       *job,
 					   gint             pages);
 gdouble         ev_job_find_get_progress  (EvJobFind       *job);
 gboolean        ev_job_find_has_results   (EvJobFind       *job);
 GList         **ev_job_find_get_results   (EvJobFind       *job);
+const EvFindResults *ev_job_find_get_page_results (EvJobFind *job,
+						    gint       page);
+
+/* EvJobFindIndex */
+GType           ev_job_find_index_get_type  (void) G_GNUC_CONST;
+EvJob          *ev_job_find_index_new       (EvDocument      *document);
+EvFindIndex    *ev_job_find_index_get_index (EvJobFindIndex  *job);
 
 /* EvJobLayers */
 GType           ev_job_layers_get_type    (void) G_GNUC_CONST;
@@ -619,6 +929,14 @@ GType           ev_job_export_get_type    (void) G_GNUC_CONST;
 EvJob          *ev_job_export_new         (EvDocument     *document);
 void            ev_job_export_set_page    (EvJobExport    *job,
 					   gint            page);
+void            ev_job_export_set_rendered_page (EvJobExport     *job,
+						 cairo_surface_t *page);
+
+/* EvJobExportRender */
+GType           ev_job_export_render_get_type (void) G_GNUC_CONST;
+EvJob          *ev_job_export_render_new      (EvDocument     *document,
+					       gint            page);
+
 /* EvJobPrint */
 GType           ev_job_print_get_type    (void) G_GNUC_CONST;
 EvJob          *ev_job_print_new         (EvDocument     *document);
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include "ev-media-player.h"
+#include "ev-file-helpers.h"
 
 #include <gst/video/videooverlay.h>
 
@@ -54,6 +55,10 @@ struct _EvMediaPlayer {
         gdouble          position;
 
         guint            position_timeout_id;
+
+        /* The contents of embedded media */
+        GFile           *media_file;
+        GCancellable    *cancellable;
 };
 
 struct _EvMediaPlayerClass {
@@ -62,6 +67,90 @@ struct _EvMediaPlayerClass {
 
 G_DEFINE_TYPE (EvMediaPlayer, ev_media_player, GTK_TYPE_BOX)
 
+/* Embedded media have no URI, their contents are written from the
+ * document to a temporary file when they are played, so that the
+ * player can seek in them. The file is removed with the player. */
+static void
+spool_media_thread (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+        EvMedia           *media = EV_MEDIA (task_data);
+        GFile             *file;
+        GFileOutputStream *stream;
+        GError            *error = NULL;
+
+        file = ev_mkstemp_file ("media.XXXXXX", &error);
+        if (!file) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
+                                 cancellable, &error);
+        if (stream) {
+                if (ev_media_save_to_stream (media, G_OUTPUT_STREAM (stream), &error))
+                        g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, &error);
+                g_object_unref (stream);
+        }
+
+        if (error) {
+                ev_tmp_file_unlink (file);
+                g_object_unref (file);
+                g_task_return_error (task, error);
+                return;
+        }
+
+        g_task_return_pointer (task, file, g_object_unref);
+}
+
+static void
+spool_media_finished_cb (EvMediaPlayer *player,
+                         GAsyncResult  *result,
+                         gpointer       user_data)
+{
+        GFile  *file;
+        GError *error = NULL;
+        gchar  *uri;
+
+        file = g_task_propagate_pointer (G_TASK (result), &error);
+        if (!file) {
+                if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                        g_warning ("Failed to read media: %s\n", error->message);
+                g_error_free (error);
+                return;
+        }
+
+        /* The player was destroyed while the media was written */
+        if (!player->pipeline) {
+                ev_tmp_file_unlink (file);
+                g_object_unref (file);
+                return;
+        }
+
+        player->media_file = file;
+        uri = g_file_get_uri (file);
+        g_object_set (player->pipeline, "uri", uri, NULL);
+        g_free (uri);
+        gst_element_set_state (player->pipeline, GST_STATE_PLAYING);
+}
+
+static void
+ev_media_player_spool_media (EvMediaPlayer *player)
+{
+        GTask *task;
+
+        player->cancellable = g_cancellable_new ();
+        task = g_task_new (player, player->cancellable,
+                           (GAsyncReadyCallback) spool_media_finished_cb, NULL);
+        /* The file is removed by the callback once cancelled */
+        g_task_set_check_cancellable (task, FALSE);
+        g_task_set_task_data (task, g_object_ref (player->media), g_object_unref);
+        g_task_run_in_thread (task, spool_media_thread);
+        g_object_unref (task);
+}
+
 static void
 ev_media_player_update_position (EvMediaPlayer *player)
 {
@@ -161,6 +250,10 @@ ev_media_player_toggle_state (EvMediaPlayer *player)
         if (!player->pipeline)
                 return;
 
+        /* Embedded media are still being written */
+        if (!ev_media_get_uri (player->media) && !player->media_file)
+                return;
+
         gst_element_get_state (player->pipeline, &current, &pending, 0);
         new_state = current == GST_STATE_PLAYING ? GST_STATE_PAUSED : GST_STATE_PLAYING;
         if (pending != new_state)
@@ -345,6 +438,16 @@ ev_media_player_dispose (GObject *object)
                 player->pipeline = NULL;
         }
 
+        if (player->cancellable) {
+                g_cancellable_cancel (player->cancellable);
+                g_clear_object (&player->cancellable);
+        }
+
+        if (player->media_file) {
+                ev_tmp_file_unlink (player->media_file);
+                g_clear_object (&player->media_file);
+        }
+
         g_clear_object (&player->media);
 
         G_OBJECT_CLASS (ev_media_player_parent_class)->dispose (object);
@@ -453,6 +556,11 @@ ev_media_player_constructed (GObject *object)
         if (!player->pipeline)
                 return;
 
+        if (!ev_media_get_uri (player->media)) {
+                ev_media_player_spool_media (player);
+                return;
+        }
+
         g_object_set (player->pipeline, "uri", ev_media_get_uri (player->media), NULL);
         gst_element_set_state (player->pipeline, GST_STATE_PLAYING);
 }
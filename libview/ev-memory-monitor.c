@@ -0,0 +1,251 @@
+/* ev-memory-monitor.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <gio/gio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib-unix.h>
+#endif
+
+#include "ev-debug.h"
+#include "ev-memory-monitor.h"
+
+/* Seconds without warnings after which the pressure goes down a level */
+#define EV_MEMORY_PRESSURE_RELAX_TIME 10
+
+#if !GLIB_CHECK_VERSION (2, 64, 0) && defined (__linux__)
+#define USE_PSI 1
+/* Notify when tasks stall on memory for 150ms within 2s. Unprivileged
+ * triggers must use a window that is a multiple of 2s. */
+#define EV_PSI_TRIGGER "some 150000 2000000"
+#endif
+
+struct _EvMemoryMonitor {
+	GObject          parent;
+
+	EvMemoryPressure pressure;
+	guint            relax_id;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor  *monitor;
+#elif defined (USE_PSI)
+	gint             psi_fd;
+	guint            psi_id;
+#endif
+};
+
+struct _EvMemoryMonitorClass {
+	GObjectClass parent_class;
+};
+
+enum {
+	PRESSURE_CHANGED,
+	N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+G_DEFINE_TYPE (EvMemoryMonitor, ev_memory_monitor, G_TYPE_OBJECT)
+
+static void
+ev_memory_monitor_set_pressure (EvMemoryMonitor *monitor,
+				EvMemoryPressure pressure)
+{
+	if (monitor->pressure == pressure)
+		return;
+
+	ev_debug_message (DEBUG_JOBS, "memory pressure %d -> %d", monitor->pressure, pressure);
+
+	monitor->pressure = pressure;
+	g_signal_emit (monitor, signals[PRESSURE_CHANGED], 0);
+}
+
+static gboolean
+ev_memory_monitor_relax (EvMemoryMonitor *monitor)
+{
+	ev_memory_monitor_set_pressure (monitor, monitor->pressure - 1);
+	if (monitor->pressure > EV_MEMORY_PRESSURE_NONE)
+		return G_SOURCE_CONTINUE;
+
+	monitor->relax_id = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Warnings are events, the pressure is kept while they keep coming
+ * and lowered a level at a time when they stop.
+ */
+static void
+ev_memory_monitor_warning (EvMemoryMonitor *monitor,
+			   EvMemoryPressure pressure)
+{
+	if (monitor->relax_id)
+		g_source_remove (monitor->relax_id);
+	monitor->relax_id = g_timeout_add_seconds (EV_MEMORY_PRESSURE_RELAX_TIME,
+						   (GSourceFunc) ev_memory_monitor_relax,
+						   monitor);
+
+	if (pressure > monitor->pressure)
+		ev_memory_monitor_set_pressure (monitor, pressure);
+}
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+static void
+low_memory_warning_cb (GMemoryMonitor            *memory_monitor,
+		       GMemoryMonitorWarningLevel level,
+		       EvMemoryMonitor           *monitor)
+{
+	EvMemoryPressure pressure;
+
+	if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL)
+		pressure = EV_MEMORY_PRESSURE_CRITICAL;
+	else if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+		pressure = EV_MEMORY_PRESSURE_MEDIUM;
+	else
+		pressure = EV_MEMORY_PRESSURE_LOW;
+
+	ev_memory_monitor_warning (monitor, pressure);
+}
+#elif defined (USE_PSI)
+/* The pressure file of our cgroup, so that the limits of a container
+ * or a systemd slice are honored, or the system wide one */
+static gint
+ev_memory_monitor_open_psi (void)
+{
+	gchar *contents = NULL;
+	gchar *path = NULL;
+	gint   fd = -1;
+
+	if (g_file_get_contents ("/proc/self/cgroup", &contents, NULL, NULL)) {
+		gchar **lines = g_strsplit (contents, "\n", -1);
+		gint    i;
+
+		for (i = 0; lines[i]; i++) {
+			if (g_str_has_prefix (lines[i], "0::")) {
+				path = g_build_filename ("/sys/fs/cgroup", lines[i] + 3,
+							 "memory.pressure", NULL);
+				break;
+			}
+		}
+		g_strfreev (lines);
+		g_free (contents);
+	}
+
+	if (path) {
+		fd = open (path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		g_free (path);
+	}
+	if (fd == -1)
+		fd = open ("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+
+	if (write (fd, EV_PSI_TRIGGER, strlen (EV_PSI_TRIGGER) + 1) < 0) {
+		ev_debug_message (DEBUG_JOBS, "can't set memory pressure trigger: %s",
+				  g_strerror (errno));
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Every trigger raises the pressure a level, a trigger
+ * repeated before the pressure relaxes escalates it.
+ */
+static gboolean
+psi_event_cb (gint             fd,
+	      GIOCondition     condition,
+	      EvMemoryMonitor *monitor)
+{
+	if (condition & (G_IO_ERR | G_IO_HUP)) {
+		monitor->psi_id = 0;
+
+		return G_SOURCE_REMOVE;
+	}
+
+	ev_memory_monitor_warning (monitor, MIN (monitor->pressure + 1,
+						 EV_MEMORY_PRESSURE_CRITICAL));
+
+	return G_SOURCE_CONTINUE;
+}
+#endif
+
+static void
+ev_memory_monitor_init (EvMemoryMonitor *monitor)
+{
+	monitor->pressure = EV_MEMORY_PRESSURE_NONE;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	monitor->monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (monitor->monitor, "low-memory-warning",
+			  G_CALLBACK (low_memory_warning_cb),
+			  monitor);
+#elif defined (USE_PSI)
+	monitor->psi_fd = ev_memory_monitor_open_psi ();
+	if (monitor->psi_fd != -1) {
+		monitor->psi_id = g_unix_fd_add (monitor->psi_fd,
+						 G_IO_PRI | G_IO_ERR | G_IO_HUP,
+						 (GUnixFDSourceFunc) psi_event_cb,
+						 monitor);
+	}
+#endif
+}
+
+static void
+ev_memory_monitor_class_init (EvMemoryMonitorClass *klass)
+{
+	signals[PRESSURE_CHANGED] =
+		g_signal_new ("pressure-changed",
+			      EV_TYPE_MEMORY_MONITOR,
+			      G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+/*
+ * ev_memory_monitor_get_default:
+ *
+ * Returns: (transfer none): the monitor of the memory pressure of the
+ *   process, created on first use. It's never destroyed.
+ */
+EvMemoryMonitor *
+ev_memory_monitor_get_default (void)
+{
+	static EvMemoryMonitor *monitor = NULL;
+
+	if (G_UNLIKELY (!monitor))
+		monitor = g_object_new (EV_TYPE_MEMORY_MONITOR, NULL);
+
+	return monitor;
+}
+
+EvMemoryPressure
+ev_memory_monitor_get_pressure (EvMemoryMonitor *monitor)
+{
+	g_return_val_if_fail (EV_IS_MEMORY_MONITOR (monitor), EV_MEMORY_PRESSURE_NONE);
+
+	return monitor->pressure;
+}
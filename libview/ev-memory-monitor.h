@@ -0,0 +1,50 @@
+/* ev-memory-monitor.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_MEMORY_MONITOR_H
+#define EV_MEMORY_MONITOR_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+	EV_MEMORY_PRESSURE_NONE,
+	EV_MEMORY_PRESSURE_LOW,      /* Drop what is cheap to get again */
+	EV_MEMORY_PRESSURE_MEDIUM,   /* Drop everything that isn't visible */
+	EV_MEMORY_PRESSURE_CRITICAL  /* Keep as little as possible */
+} EvMemoryPressure;
+
+#define EV_TYPE_MEMORY_MONITOR         (ev_memory_monitor_get_type ())
+#define EV_MEMORY_MONITOR(object)      (G_TYPE_CHECK_INSTANCE_CAST ((object), EV_TYPE_MEMORY_MONITOR, EvMemoryMonitor))
+#define EV_IS_MEMORY_MONITOR(object)   (G_TYPE_CHECK_INSTANCE_TYPE ((object), EV_TYPE_MEMORY_MONITOR))
+
+typedef struct _EvMemoryMonitor      EvMemoryMonitor;
+typedef struct _EvMemoryMonitorClass EvMemoryMonitorClass;
+
+GType            ev_memory_monitor_get_type     (void) G_GNUC_CONST;
+EvMemoryMonitor *ev_memory_monitor_get_default  (void);
+EvMemoryPressure ev_memory_monitor_get_pressure (EvMemoryMonitor *monitor);
+
+G_END_DECLS
+
+#endif /* EV_MEMORY_MONITOR_H */
@@ -734,13 +734,13 @@ ev_page_accessible_get_selection (AtkText *text,
 
 			page = ev_document_get_page (view->document, selection->page);
 
-			ev_document_doc_mutex_lock ();
+			ev_document_lock (view->document);
 			selected_text = ev_selection_get_selected_text (EV_SELECTION (view->document),
 									page,
 									selection->style,
 									&(selection->rect));
 
-			ev_document_doc_mutex_unlock ();
+			ev_document_unlock (view->document);
 
 			g_object_unref (page);
 
@@ -978,7 +978,9 @@ ev_page_accessible_get_offset_at_point (AtkText      *text,
 	ev_view_get_page_extents (view, self->priv->page, &page_area, &border);
 	_ev_view_transform_view_point_to_doc_point (view, &view_point, &page_area, &border, &doc_x, &doc_y);
 
-	for (i = 0; i < n_areas; i++) {
+	for (i = ev_page_cache_find_text_line_at (view->page_cache, self->priv->page, doc_y, 0);
+	     i < n_areas;
+	     i = ev_page_cache_find_text_line_at (view->page_cache, self->priv->page, doc_y, i + 1)) {
 		rect = areas + i;
 		if (doc_x >= rect->x1 && doc_x <= rect->x2 &&
 		    doc_y >= rect->y1 && doc_y <= rect->y2)
@@ -1213,8 +1215,11 @@ page_cached_cb (EvPageCache *cache,
 		gint page,
 		EvPageAccessible *self)
 {
-	if (page == self->priv->page)
-		ev_page_accessible_initialize_children (self);
+	if (page != self->priv->page)
+		return;
+
+	ev_page_accessible_initialize_children (self);
+	g_signal_handlers_disconnect_by_func (cache, page_cached_cb, self);
 }
 
 EvPageAccessible *
@@ -1236,9 +1241,9 @@ ev_page_accessible_new (EvViewAccessible *view_accessible,
 	if (ev_page_cache_is_page_cached (view->page_cache, page))
 		ev_page_accessible_initialize_children (EV_PAGE_ACCESSIBLE (atk_page));
 	else
-		g_signal_connect (view->page_cache, "page-cached",
-				  G_CALLBACK (page_cached_cb),
-				  atk_page);
+		g_signal_connect_object (view->page_cache, "page-cached",
+					 G_CALLBACK (page_cached_cb),
+					 atk_page, 0);
 
         return EV_PAGE_ACCESSIBLE (atk_page);
 }
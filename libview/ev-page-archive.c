@@ -0,0 +1,617 @@
+/* ev-page-archive.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-debug.h"
+#include "ev-memory-stats.h"
+#include "ev-surface-pool.h"
+#include "ev-page-archive.h"
+
+/* Rendered pages that went out of the pixbuf cache, kept compressed
+ * so that going back to them doesn't need them rendered again. Pages
+ * are mostly runs of the background color, so the surfaces are stored
+ * as runs of 32 bit words: a header with RUN_FLAG set followed by the
+ * repeated word, or a header followed by as many literal words. Rows
+ * of every cairo format are a whole number of words.
+ *
+ * The archive is used from the main thread, surfaces are compressed
+ * and decompressed in threads.
+ */
+#define RUN_FLAG    0x80000000u
+#define MAX_LENGTH  (RUN_FLAG - 1)
+#define MIN_RUN     3
+
+/* Pages that don't compress to this fraction of their size, like
+ * photos, are not worth keeping */
+#define MIN_COMPRESSION_RATIO 2
+
+typedef struct {
+	gint             page;
+	gint             rotation;
+	gint             width;
+	gint             height;
+	gint             stride;
+	gdouble          device_scale;
+	cairo_format_t   format;
+	GBytes          *data;
+
+	/* Surface being compressed */
+	cairo_surface_t *surface;
+	/* Removed or cleared while being compressed */
+	gboolean         discarded;
+} ArchiveEntry;
+
+struct _EvPageArchive {
+	GObject       parent;
+
+	/* ArchiveEntry, most recently stored first */
+	GQueue        entries;
+	gsize         size;
+	gsize         max_size;
+
+	/* Pages kept even when the archive is full */
+	GArray       *pinned;
+
+	/* Of the pending compressions, cancelled by clear */
+	GCancellable *cancellable;
+	/* ArchiveEntry being compressed */
+	GList        *compressing;
+};
+
+struct _EvPageArchiveClass {
+	GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (EvPageArchive, ev_page_archive, G_TYPE_OBJECT)
+
+static void
+archive_entry_free (ArchiveEntry *entry)
+{
+	g_clear_pointer (&entry->data, g_bytes_unref);
+	if (entry->surface)
+		ev_surface_pool_recycle (entry->surface);
+	g_slice_free (ArchiveEntry, entry);
+}
+
+static void
+append_literal (GArray        *out,
+		const guint32 *words,
+		gsize          n_words)
+{
+	while (n_words > 0) {
+		guint32 length = MIN (n_words, MAX_LENGTH);
+
+		g_array_append_val (out, length);
+		g_array_append_vals (out, words, length);
+		words += length;
+		n_words -= length;
+	}
+}
+
+static GBytes *
+compress_words (const guint32 *words,
+		gsize          n_words)
+{
+	GArray *out;
+	gsize   literal = 0;
+	gsize   i = 0;
+	gsize   size;
+
+	out = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n_words / 16 + 2);
+	while (i < n_words) {
+		guint32 header;
+		gsize   run = 1;
+
+		while (i + run < n_words && run < MAX_LENGTH && words[i + run] == words[i])
+			run++;
+
+		if (run < MIN_RUN) {
+			i += run;
+			continue;
+		}
+
+		append_literal (out, words + literal, i - literal);
+		header = RUN_FLAG | run;
+		g_array_append_val (out, header);
+		g_array_append_val (out, words[i]);
+		i += run;
+		literal = i;
+	}
+	append_literal (out, words + literal, n_words - literal);
+
+	size = out->len * sizeof (guint32);
+	return g_bytes_new_take (g_array_free (out, FALSE), size);
+}
+
+static gboolean
+decompress_words (const guint32 *in,
+		  gsize          n_in,
+		  guint32       *out,
+		  gsize          n_out)
+{
+	gsize i = 0, o = 0;
+
+	while (i < n_in) {
+		guint32 header = in[i++];
+		gsize   length = header & MAX_LENGTH;
+
+		if (length > n_out - o)
+			return FALSE;
+
+		if (header & RUN_FLAG) {
+			guint32 value;
+			gsize   j;
+
+			if (i >= n_in)
+				return FALSE;
+
+			value = in[i++];
+			for (j = 0; j < length; j++)
+				out[o++] = value;
+		} else {
+			if (length > n_in - i)
+				return FALSE;
+
+			memcpy (out + o, in + i, length * sizeof (guint32));
+			i += length;
+			o += length;
+		}
+	}
+
+	return o == n_out;
+}
+
+static void
+remove_link (EvPageArchive *archive,
+	     GList         *link)
+{
+	ArchiveEntry *entry = (ArchiveEntry *) link->data;
+
+	archive->size -= g_bytes_get_size (entry->data);
+	g_queue_delete_link (&archive->entries, link);
+	archive_entry_free (entry);
+}
+
+static GList *
+find_page (EvPageArchive *archive,
+	   gint           page)
+{
+	GList *l;
+
+	for (l = archive->entries.head; l; l = l->next) {
+		if (((ArchiveEntry *) l->data)->page == page)
+			return l;
+	}
+
+	return NULL;
+}
+
+static gboolean
+is_pinned (EvPageArchive *archive,
+	   gint           page)
+{
+	guint i;
+
+	for (i = 0; i < archive->pinned->len; i++) {
+		if (g_array_index (archive->pinned, gint, i) == page)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Drops the least recently stored pages that aren't pinned until
+ * the archive fits */
+static void
+trim (EvPageArchive *archive)
+{
+	GList *l = archive->entries.tail;
+
+	while (archive->size > archive->max_size && l) {
+		GList *prev = l->prev;
+
+		if (!is_pinned (archive, ((ArchiveEntry *) l->data)->page))
+			remove_link (archive, l);
+		l = prev;
+	}
+}
+
+static void
+get_memory_stats (gpointer  user_data,
+		  guint64  *bytes,
+		  guint    *n_entries)
+{
+	EvPageArchive *archive = EV_PAGE_ARCHIVE (user_data);
+
+	*bytes += archive->size;
+	*n_entries += archive->entries.length;
+}
+
+static void
+ev_page_archive_finalize (GObject *object)
+{
+	EvPageArchive *archive = EV_PAGE_ARCHIVE (object);
+
+	ev_memory_stats_unregister ("page-archive", archive);
+	g_queue_foreach (&archive->entries, (GFunc) archive_entry_free, NULL);
+	g_queue_clear (&archive->entries);
+	g_array_free (archive->pinned, TRUE);
+	g_object_unref (archive->cancellable);
+
+	G_OBJECT_CLASS (ev_page_archive_parent_class)->finalize (object);
+}
+
+static void
+ev_page_archive_init (EvPageArchive *archive)
+{
+	g_queue_init (&archive->entries);
+	archive->pinned = g_array_new (FALSE, FALSE, sizeof (gint));
+	archive->cancellable = g_cancellable_new ();
+	ev_memory_stats_register ("page-archive", get_memory_stats, archive);
+}
+
+static void
+ev_page_archive_class_init (EvPageArchiveClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = ev_page_archive_finalize;
+}
+
+EvPageArchive *
+ev_page_archive_new (gsize max_size)
+{
+	EvPageArchive *archive;
+
+	archive = EV_PAGE_ARCHIVE (g_object_new (EV_TYPE_PAGE_ARCHIVE, NULL));
+	archive->max_size = max_size;
+
+	return archive;
+}
+
+static void
+compress_thread (GTask        *task,
+		 gpointer      source_object,
+		 gpointer      task_data,
+		 GCancellable *cancellable)
+{
+	ArchiveEntry *entry = (ArchiveEntry *) task_data;
+	gsize         size = (gsize) entry->stride * entry->height;
+
+	if (g_task_return_error_if_cancelled (task))
+		return;
+
+	cairo_surface_flush (entry->surface);
+	entry->data = compress_words ((const guint32 *) cairo_image_surface_get_data (entry->surface),
+				      size / sizeof (guint32));
+	ev_debug_message (DEBUG_JOBS, "page %d: archived %" G_GSIZE_FORMAT " bytes in %" G_GSIZE_FORMAT,
+			  entry->page, size, g_bytes_get_size (entry->data));
+
+	g_task_return_boolean (task, g_bytes_get_size (entry->data) * MIN_COMPRESSION_RATIO <= size);
+}
+
+static void
+store_finished_cb (GObject      *source_object,
+		   GAsyncResult *result,
+		   gpointer      user_data)
+{
+	EvPageArchive *archive = EV_PAGE_ARCHIVE (source_object);
+	ArchiveEntry  *entry;
+	GList         *link;
+	gboolean       compressed;
+
+	entry = (ArchiveEntry *) g_task_get_task_data (G_TASK (result));
+	g_clear_pointer (&entry->surface, ev_surface_pool_recycle);
+	archive->compressing = g_list_remove (archive->compressing, entry);
+	if (entry->discarded)
+		return;
+
+	/* Pinned pages are kept even if they don't compress well */
+	compressed = g_task_propagate_boolean (G_TASK (result), NULL);
+	if (!entry->data || (!compressed && !is_pinned (archive, entry->page)))
+		return;
+
+	/* An older version of the page */
+	link = find_page (archive, entry->page);
+	if (link)
+		remove_link (archive, link);
+
+	/* The task data is freed with the task, without the data */
+	entry = g_slice_dup (ArchiveEntry, entry);
+	((ArchiveEntry *) g_task_get_task_data (G_TASK (result)))->data = NULL;
+
+	g_queue_push_head (&archive->entries, entry);
+	archive->size += g_bytes_get_size (entry->data);
+
+	trim (archive);
+}
+
+/**
+ * ev_page_archive_store:
+ * @archive: an #EvPageArchive
+ * @page: the page of @surface
+ * @rotation: the rotation @surface is rendered with
+ * @device_scale: device pixels per pixel of the view of @surface
+ * @surface: (transfer full): a rendered page
+ *
+ * Compresses @surface in a thread, and keeps it until the archive is
+ * full or cleared. @surface is recycled once it's compressed, the
+ * caller must not use it anymore.
+ */
+void
+ev_page_archive_store (EvPageArchive   *archive,
+		       gint             page,
+		       gint             rotation,
+		       gdouble          device_scale,
+		       cairo_surface_t *surface)
+{
+	ArchiveEntry *entry;
+	GTask        *task;
+
+	g_return_if_fail (EV_IS_PAGE_ARCHIVE (archive));
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+	    archive->max_size == 0) {
+		ev_surface_pool_recycle (surface);
+		return;
+	}
+
+	entry = g_slice_new0 (ArchiveEntry);
+	entry->page = page;
+	entry->rotation = rotation;
+	entry->width = cairo_image_surface_get_width (surface);
+	entry->height = cairo_image_surface_get_height (surface);
+	entry->stride = cairo_image_surface_get_stride (surface);
+	entry->format = cairo_image_surface_get_format (surface);
+	entry->device_scale = device_scale;
+	entry->surface = surface;
+
+	archive->compressing = g_list_prepend (archive->compressing, entry);
+
+	task = g_task_new (archive, archive->cancellable, store_finished_cb, NULL);
+	g_task_set_task_data (task, entry, (GDestroyNotify) archive_entry_free);
+	g_task_run_in_thread (task, compress_thread);
+	g_object_unref (task);
+}
+
+/**
+ * ev_page_archive_contains:
+ * @archive: an #EvPageArchive
+ * @page: a page
+ * @rotation: the rotation of the page
+ * @width: the width of the surface, in device pixels
+ * @height: the height of the surface, in device pixels
+ * @device_scale: device pixels per pixel of the view
+ *
+ * Returns: whether ev_page_archive_restore_async() would restore
+ *   @page with the given rotation and size
+ */
+gboolean
+ev_page_archive_contains (EvPageArchive *archive,
+			  gint           page,
+			  gint           rotation,
+			  gint           width,
+			  gint           height,
+			  gdouble        device_scale)
+{
+	ArchiveEntry *entry;
+	GList        *link;
+
+	g_return_val_if_fail (EV_IS_PAGE_ARCHIVE (archive), FALSE);
+
+	link = find_page (archive, page);
+	if (!link)
+		return FALSE;
+
+	entry = (ArchiveEntry *) link->data;
+
+	return entry->rotation == rotation &&
+		entry->width == width &&
+		entry->height == height &&
+		entry->device_scale == device_scale;
+}
+
+/**
+ * ev_page_archive_set_pinned_pages:
+ * @archive: an #EvPageArchive
+ * @pages: (array length=n_pages): the pages to pin
+ * @n_pages: the number of @pages
+ *
+ * Keeps the archived surfaces of @pages, for the pages the user is
+ * likely to go back to, when other pages are stored in a full archive.
+ * The pages pinned before are unpinned. They are still dropped by
+ * ev_page_archive_clear().
+ */
+void
+ev_page_archive_set_pinned_pages (EvPageArchive *archive,
+				  const gint    *pages,
+				  guint          n_pages)
+{
+	g_return_if_fail (EV_IS_PAGE_ARCHIVE (archive));
+
+	g_array_set_size (archive->pinned, 0);
+	g_array_append_vals (archive->pinned, pages, n_pages);
+	trim (archive);
+}
+
+static void
+decompress_thread (GTask        *task,
+		   gpointer      source_object,
+		   gpointer      task_data,
+		   GCancellable *cancellable)
+{
+	ArchiveEntry    *entry = (ArchiveEntry *) task_data;
+	cairo_surface_t *surface;
+	gconstpointer    data;
+	gsize            size;
+
+	if (g_task_return_error_if_cancelled (task))
+		return;
+
+	surface = ev_surface_pool_create_surface (entry->format, entry->width, entry->height);
+	data = g_bytes_get_data (entry->data, &size);
+	if (cairo_image_surface_get_stride (surface) != entry->stride ||
+	    !decompress_words ((const guint32 *) data, size / sizeof (guint32),
+			       (guint32 *) cairo_image_surface_get_data (surface),
+			       (gsize) entry->stride * entry->height / sizeof (guint32))) {
+		ev_surface_pool_recycle (surface);
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					 "Invalid archived page %d", entry->page);
+		return;
+	}
+	cairo_surface_mark_dirty (surface);
+
+	g_task_return_pointer (task, surface, (GDestroyNotify) cairo_surface_destroy);
+}
+
+/**
+ * ev_page_archive_restore_async:
+ * @archive: an #EvPageArchive
+ * @page: the page to restore
+ * @rotation: the rotation of the page
+ * @width: the width of the surface, in device pixels
+ * @height: the height of the surface, in device pixels
+ * @device_scale: device pixels per pixel of the view
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called once the page is restored
+ * @user_data: data for @callback
+ *
+ * Decompresses the surface of @page in a thread, when the archive has
+ * one rendered with the given rotation and size. The page is taken out
+ * of the archive, to be stored again when it leaves the cache.
+ *
+ * Returns: %TRUE if the page is being restored, %FALSE if it must be
+ *   rendered and @callback won't be called
+ */
+gboolean
+ev_page_archive_restore_async (EvPageArchive       *archive,
+			       gint                 page,
+			       gint                 rotation,
+			       gint                 width,
+			       gint                 height,
+			       gdouble              device_scale,
+			       GCancellable        *cancellable,
+			       GAsyncReadyCallback  callback,
+			       gpointer             user_data)
+{
+	ArchiveEntry *entry;
+	GList        *link;
+	GTask        *task;
+
+	g_return_val_if_fail (EV_IS_PAGE_ARCHIVE (archive), FALSE);
+
+	link = find_page (archive, page);
+	if (!link)
+		return FALSE;
+
+	/* Pages of other sizes are never restored, they would be
+	 * replaced by a render anyway */
+	entry = (ArchiveEntry *) link->data;
+	if (entry->rotation != rotation ||
+	    entry->width != width ||
+	    entry->height != height ||
+	    entry->device_scale != device_scale) {
+		remove_link (archive, link);
+		return FALSE;
+	}
+
+	archive->size -= g_bytes_get_size (entry->data);
+	g_queue_delete_link (&archive->entries, link);
+
+	task = g_task_new (archive, cancellable, callback, user_data);
+	g_task_set_task_data (task, entry, (GDestroyNotify) archive_entry_free);
+	g_task_run_in_thread (task, decompress_thread);
+	g_object_unref (task);
+
+	return TRUE;
+}
+
+/**
+ * ev_page_archive_restore_finish:
+ * @archive: an #EvPageArchive
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: (transfer full): the restored surface, or %NULL if the
+ *   restore was cancelled or failed
+ */
+cairo_surface_t *
+ev_page_archive_restore_finish (EvPageArchive *archive,
+				GAsyncResult  *result,
+				GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, archive), NULL);
+
+	return (cairo_surface_t *) g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * ev_page_archive_remove:
+ * @archive: an #EvPageArchive
+ * @page: a page
+ *
+ * Drops the archived versions of @page, and the ones being compressed,
+ * like when the page changed.
+ */
+void
+ev_page_archive_remove (EvPageArchive *archive,
+			gint           page)
+{
+	GList *link;
+
+	g_return_if_fail (EV_IS_PAGE_ARCHIVE (archive));
+
+	for (link = archive->compressing; link; link = link->next) {
+		ArchiveEntry *entry = (ArchiveEntry *) link->data;
+
+		if (entry->page == page)
+			entry->discarded = TRUE;
+	}
+
+	link = find_page (archive, page);
+	if (link)
+		remove_link (archive, link);
+}
+
+/**
+ * ev_page_archive_clear:
+ * @archive: an #EvPageArchive
+ *
+ * Drops the archived pages, and the ones being compressed.
+ */
+void
+ev_page_archive_clear (EvPageArchive *archive)
+{
+	GList *l;
+
+	g_return_if_fail (EV_IS_PAGE_ARCHIVE (archive));
+
+	/* Pinned pages would be kept even when cancelled */
+	for (l = archive->compressing; l; l = l->next)
+		((ArchiveEntry *) l->data)->discarded = TRUE;
+
+	g_cancellable_cancel (archive->cancellable);
+	g_object_unref (archive->cancellable);
+	archive->cancellable = g_cancellable_new ();
+
+	while (archive->entries.head)
+		remove_link (archive, archive->entries.head);
+}
@@ -0,0 +1,72 @@
+/* ev-page-archive.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_PAGE_ARCHIVE_H
+#define EV_PAGE_ARCHIVE_H
+
+#include <gio/gio.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_PAGE_ARCHIVE            (ev_page_archive_get_type ())
+#define EV_PAGE_ARCHIVE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_PAGE_ARCHIVE, EvPageArchive))
+#define EV_IS_PAGE_ARCHIVE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_PAGE_ARCHIVE))
+
+typedef struct _EvPageArchive      EvPageArchive;
+typedef struct _EvPageArchiveClass EvPageArchiveClass;
+
+GType            ev_page_archive_get_type       (void) G_GNUC_CONST;
+EvPageArchive   *ev_page_archive_new            (gsize                max_size);
+void             ev_page_archive_store          (EvPageArchive       *archive,
+						 gint                 page,
+						 gint                 rotation,
+						 gdouble              device_scale,
+						 cairo_surface_t     *surface);
+gboolean         ev_page_archive_restore_async  (EvPageArchive       *archive,
+						 gint                 page,
+						 gint                 rotation,
+						 gint                 width,
+						 gint                 height,
+						 gdouble              device_scale,
+						 GCancellable        *cancellable,
+						 GAsyncReadyCallback  callback,
+						 gpointer             user_data);
+cairo_surface_t *ev_page_archive_restore_finish (EvPageArchive       *archive,
+						 GAsyncResult        *result,
+						 GError             **error);
+gboolean         ev_page_archive_contains       (EvPageArchive       *archive,
+						 gint                 page,
+						 gint                 rotation,
+						 gint                 width,
+						 gint                 height,
+						 gdouble              device_scale);
+void             ev_page_archive_set_pinned_pages (EvPageArchive     *archive,
+						 const gint          *pages,
+						 guint                n_pages);
+void             ev_page_archive_remove         (EvPageArchive       *archive,
+						 gint                 page);
+void             ev_page_archive_clear          (EvPageArchive       *archive);
+
+G_END_DECLS
+
+#endif /* EV_PAGE_ARCHIVE_H */
@@ -19,9 +19,12 @@
 
 #include <config.h>
 
+#include <string.h>
 #include <glib.h>
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
+#include "ev-memory-monitor.h"
+#include "ev-memory-stats.h"
 #include "ev-mapping-list.h"
 #include "ev-selection.h"
 #include "ev-document-links.h"
@@ -39,12 +42,65 @@ enum {
 
 static guint ev_page_cache_signals[LAST_SIGNAL] = {0};
 
+/* Lines of the text layout, runs of consecutive areas overlapping
+ * vertically with the previous one, so that every run of areas
+ * containing a given y is in a single line. They are sorted by y
+ * too, for the lines containing a point to be found with a binary
+ * search.
+ */
+typedef struct {
+	guint   start;
+	guint   end;
+	gdouble y1;
+	gdouble y2;
+} EvTextLine;
+
+typedef struct {
+	GArray  *lines;       /* EvTextLine, in layout order */
+	guint   *sorted;      /* Indices of lines, sorted by y1 */
+	gdouble  max_height;
+} EvTextLineIndex;
+
+/* Text attributes as runs of the distinct sets of attributes in the
+ * page, which usually are a few font styles repeated all over it.
+ */
+typedef struct {
+	guint start;
+	guint end;
+	guint style;
+} EvTextAttrRun;
+
+typedef struct {
+	GPtrArray *styles;    /* GSList of PangoAttribute */
+	GArray    *runs;      /* EvTextAttrRun */
+} EvPackedTextAttrs;
+
+/* Log attributes as runs of equal values, consecutive characters
+ * of a word have the same ones. The values are the distinct log
+ * attributes in the page, there are very few of them.
+ */
+typedef struct {
+	guint32 *values;
+	guint8  *runs;        /* Pairs of index in values and length */
+	guint    n_runs;
+	gulong   n_attrs;
+} EvPackedLogAttrs;
+
+#define MAX_LOG_ATTR_VALUES (G_MAXUINT8 + 1)
+
+G_STATIC_ASSERT (sizeof (PangoLogAttr) == sizeof (guint32));
+
 typedef struct _EvPageCacheData {
 	EvJob             *job;
 	gboolean           done : 1;
 	gboolean           dirty : 1;
 	EvJobPageDataFlags flags;
 
+	/* Text data is fetched by its own job, on first access */
+	EvJob             *text_job;
+	EvJobPriority      text_priority;
+	EvJobPageDataFlags text_flags; /* Text data cached or being fetched */
+
 	EvMappingList     *link_mapping;
 	EvMappingList     *image_mapping;
 	EvMappingList     *form_field_mapping;
@@ -53,7 +109,13 @@ typedef struct _EvPageCacheData {
 	cairo_region_t    *text_mapping;
 	EvRectangle       *text_layout;
 	guint              text_layout_length;
+	EvTextLineIndex   *text_lines;
 	gchar             *text;
+	EvPackedTextAttrs *packed_text_attrs;
+	EvPackedLogAttrs  *packed_log_attrs;
+
+	/* Built from the packed data when used, for pages around the
+	 * current range only */
 	PangoAttrList     *text_attrs;
         PangoLogAttr      *text_log_attrs;
         gulong             text_log_attrs_length;
@@ -71,6 +133,10 @@ struct _EvPageCache {
 	gint               end_page;
 
 	EvJobPageDataFlags flags;
+	gboolean           prefetch_text;
+
+	/* Client the jobs are pushed for, see ev_job_scheduler_push_job_for_client() */
+	gpointer           client;
 };
 
 struct _EvPageCacheClass {
@@ -85,15 +151,353 @@ struct _EvPageCacheClass {
 	EV_PAGE_DATA_INCLUDE_ANNOTS       | \
         EV_PAGE_DATA_INCLUDE_MEDIA)
 
+/* Data that is expensive to get, only fetched when it's used */
+#define EV_PAGE_DATA_TEXT_FLAGS (              \
+	EV_PAGE_DATA_INCLUDE_TEXT            | \
+	EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT     | \
+	EV_PAGE_DATA_INCLUDE_TEXT_ATTRS      | \
+	EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS)
+
 #define PRE_CACHE_SIZE 1
 
+/* Link and form field mappings of the pages of a document, shared by
+ * all its page caches, so that their pages aren't converted again by
+ * another view of the document, like the presentation, or by a new
+ * page cache. The least recently used pages are dropped when there
+ * are more than MAX_STORED_MAPPINGS mappings. It's only used from the
+ * main thread, and goes away with the document.
+ */
+typedef struct {
+	gint           page;
+	EvMappingList *link_mapping;
+	EvMappingList *form_field_mapping;
+	GList          link;
+} EvStoredMappings;
+
+typedef struct {
+	GHashTable *pages;      /* Page index to EvStoredMappings */
+	GQueue      lru;        /* Most recently used first */
+	guint       n_mappings;
+} EvMappingStore;
+
+#define MAX_STORED_MAPPINGS 50000
+#define MAPPING_STORE_KEY "ev-page-cache-mapping-store"
+
 static void job_page_data_finished_cb (EvJob       *job,
 				       EvPageCache *cache);
 static void job_page_data_cancelled_cb (EvJob       *job,
 					EvPageCacheData *data);
+static void job_page_text_finished_cb (EvJob       *job,
+				       EvPageCache *cache);
+static void job_page_text_cancelled_cb (EvJob           *job,
+					EvPageCacheData *data);
 
 G_DEFINE_TYPE (EvPageCache, ev_page_cache, G_TYPE_OBJECT)
 
+static void
+ev_text_line_index_free (EvTextLineIndex *index)
+{
+	g_array_free (index->lines, TRUE);
+	g_free (index->sorted);
+	g_slice_free (EvTextLineIndex, index);
+}
+
+static gint
+compare_lines (gconstpointer a,
+	       gconstpointer b,
+	       gpointer      user_data)
+{
+	GArray     *lines = (GArray *)user_data;
+	EvTextLine *line_a = &g_array_index (lines, EvTextLine, *(const guint *)a);
+	EvTextLine *line_b = &g_array_index (lines, EvTextLine, *(const guint *)b);
+
+	if (line_a->y1 != line_b->y1)
+		return line_a->y1 < line_b->y1 ? -1 : 1;
+
+	return line_a->start < line_b->start ? -1 : 1;
+}
+
+static EvTextLineIndex *
+ev_text_line_index_new (EvRectangle *areas,
+			guint        n_areas)
+{
+	EvTextLineIndex *index;
+	EvTextLine       line = { 0, 0, 0, 0 };
+	guint            i;
+
+	index = g_slice_new0 (EvTextLineIndex);
+	index->lines = g_array_new (FALSE, FALSE, sizeof (EvTextLine));
+
+	for (i = 0; i < n_areas; i++) {
+		EvRectangle *area = areas + i;
+
+		if (i > 0 && area->y1 <= areas[i - 1].y2 && area->y2 >= areas[i - 1].y1) {
+			line.end = i + 1;
+			line.y1 = MIN (line.y1, area->y1);
+			line.y2 = MAX (line.y2, area->y2);
+			continue;
+		}
+
+		if (i > 0) {
+			g_array_append_val (index->lines, line);
+			index->max_height = MAX (index->max_height, line.y2 - line.y1);
+		}
+
+		line.start = i;
+		line.end = i + 1;
+		line.y1 = area->y1;
+		line.y2 = area->y2;
+	}
+
+	if (n_areas > 0) {
+		g_array_append_val (index->lines, line);
+		index->max_height = MAX (index->max_height, line.y2 - line.y1);
+	}
+
+	index->sorted = g_new (guint, MAX (index->lines->len, 1));
+	for (i = 0; i < index->lines->len; i++)
+		index->sorted[i] = i;
+	g_qsort_with_data (index->sorted, index->lines->len, sizeof (guint),
+			   compare_lines, index->lines);
+
+	return index;
+}
+
+/* Returns the position of the first line in index->sorted with y1 >= y */
+static guint
+ev_text_line_index_lower_bound (EvTextLineIndex *index,
+				gdouble          y)
+{
+	guint low = 0, high = index->lines->len;
+
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+
+		if (g_array_index (index->lines, EvTextLine, index->sorted[mid]).y1 < y)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static void
+attr_set_free (GSList *attrs)
+{
+	g_slist_free_full (attrs, (GDestroyNotify)pango_attribute_destroy);
+}
+
+static gboolean
+attr_sets_equal (GSList *a,
+		 GSList *b)
+{
+	GSList *l, *m;
+
+	if (g_slist_length (a) != g_slist_length (b))
+		return FALSE;
+
+	for (l = a; l; l = g_slist_next (l)) {
+		for (m = b; m; m = g_slist_next (m)) {
+			if (pango_attribute_equal (l->data, m->data))
+				break;
+		}
+
+		if (!m)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static EvPackedTextAttrs *
+ev_packed_text_attrs_new (PangoAttrList *attrs)
+{
+	EvPackedTextAttrs *packed;
+	PangoAttrIterator *iter;
+
+	packed = g_slice_new (EvPackedTextAttrs);
+	packed->styles = g_ptr_array_new_with_free_func ((GDestroyNotify)attr_set_free);
+	packed->runs = g_array_new (FALSE, FALSE, sizeof (EvTextAttrRun));
+
+	iter = pango_attr_list_get_iterator (attrs);
+	do {
+		EvTextAttrRun run;
+		GSList       *set;
+		gint          start, end;
+		guint         i;
+
+		set = pango_attr_iterator_get_attrs (iter);
+		if (!set)
+			continue;
+
+		pango_attr_iterator_range (iter, &start, &end);
+
+		/* Styles alternate, look for the most recent ones first */
+		for (i = packed->styles->len; i > 0; i--) {
+			if (attr_sets_equal (g_ptr_array_index (packed->styles, i - 1), set))
+				break;
+		}
+
+		if (i > 0) {
+			attr_set_free (set);
+			run.style = i - 1;
+		} else {
+			g_ptr_array_add (packed->styles, set);
+			run.style = packed->styles->len - 1;
+		}
+
+		if (packed->runs->len > 0) {
+			EvTextAttrRun *last;
+
+			last = &g_array_index (packed->runs, EvTextAttrRun, packed->runs->len - 1);
+			if (last->style == run.style && last->end == start) {
+				last->end = end;
+				continue;
+			}
+		}
+
+		run.start = start;
+		run.end = end;
+		g_array_append_val (packed->runs, run);
+	} while (pango_attr_iterator_next (iter));
+	pango_attr_iterator_destroy (iter);
+
+	return packed;
+}
+
+static PangoAttrList *
+ev_packed_text_attrs_to_list (EvPackedTextAttrs *packed)
+{
+	PangoAttrList *list;
+	guint          i;
+
+	list = pango_attr_list_new ();
+	for (i = 0; i < packed->runs->len; i++) {
+		EvTextAttrRun *run = &g_array_index (packed->runs, EvTextAttrRun, i);
+		GSList        *l;
+
+		for (l = g_ptr_array_index (packed->styles, run->style); l; l = g_slist_next (l)) {
+			PangoAttribute *attr = pango_attribute_copy (l->data);
+
+			attr->start_index = run->start;
+			attr->end_index = run->end;
+			pango_attr_list_insert (list, attr);
+		}
+	}
+
+	return list;
+}
+
+static void
+ev_packed_text_attrs_free (EvPackedTextAttrs *packed)
+{
+	g_ptr_array_free (packed->styles, TRUE);
+	g_array_free (packed->runs, TRUE);
+	g_slice_free (EvPackedTextAttrs, packed);
+}
+
+/* Returns %NULL if there are too many distinct values to pack them */
+static EvPackedLogAttrs *
+ev_packed_log_attrs_new (PangoLogAttr *attrs,
+			 gulong        n_attrs)
+{
+	EvPackedLogAttrs *packed;
+	GHashTable       *indices;
+	GArray           *values;
+	GByteArray       *runs;
+	guint8            run[2] = { 0, 0 };
+	guint32           run_value = 0;
+	gulong            i;
+
+	indices = g_hash_table_new (NULL, NULL);
+	values = g_array_new (FALSE, FALSE, sizeof (guint32));
+	runs = g_byte_array_new ();
+
+	/* There's one more log attr than characters */
+	for (i = 0; i <= n_attrs; i++) {
+		guint32  value;
+		gpointer value_index;
+
+		memcpy (&value, &attrs[i], sizeof (guint32));
+		if (run[1] > 0 && value == run_value && run[1] < G_MAXUINT8) {
+			run[1]++;
+			continue;
+		}
+
+		if (run[1] > 0)
+			g_byte_array_append (runs, run, 2);
+
+		if (!g_hash_table_lookup_extended (indices, GUINT_TO_POINTER (value), NULL, &value_index)) {
+			if (values->len == MAX_LOG_ATTR_VALUES) {
+				g_hash_table_destroy (indices);
+				g_array_free (values, TRUE);
+				g_byte_array_free (runs, TRUE);
+
+				return NULL;
+			}
+
+			value_index = GUINT_TO_POINTER (values->len);
+			g_hash_table_insert (indices, GUINT_TO_POINTER (value), value_index);
+			g_array_append_val (values, value);
+		}
+
+		run_value = value;
+		run[0] = GPOINTER_TO_UINT (value_index);
+		run[1] = 1;
+	}
+	g_byte_array_append (runs, run, 2);
+	g_hash_table_destroy (indices);
+
+	packed = g_slice_new (EvPackedLogAttrs);
+	packed->n_attrs = n_attrs;
+	packed->n_runs = runs->len / 2;
+	packed->runs = g_byte_array_free (runs, FALSE);
+	packed->values = (guint32 *)g_array_free (values, FALSE);
+
+	return packed;
+}
+
+static PangoLogAttr *
+ev_packed_log_attrs_to_array (EvPackedLogAttrs *packed)
+{
+	PangoLogAttr *attrs;
+	gulong        n = 0;
+	guint         i, j;
+
+	attrs = g_new (PangoLogAttr, packed->n_attrs + 1);
+	for (i = 0; i < packed->n_runs; i++) {
+		PangoLogAttr attr;
+
+		memcpy (&attr, &packed->values[packed->runs[2 * i]], sizeof (PangoLogAttr));
+		for (j = 0; j < packed->runs[2 * i + 1]; j++)
+			attrs[n++] = attr;
+	}
+
+	return attrs;
+}
+
+static void
+ev_packed_log_attrs_free (EvPackedLogAttrs *packed)
+{
+	g_free (packed->values);
+	g_free (packed->runs);
+	g_slice_free (EvPackedLogAttrs, packed);
+}
+
+/* Frees the structures that can be built again from packed data */
+static void
+ev_page_cache_data_release_text_attrs (EvPageCacheData *data)
+{
+	if (data->packed_text_attrs)
+		g_clear_pointer (&data->text_attrs, pango_attr_list_unref);
+
+	if (data->packed_log_attrs) {
+		g_clear_pointer (&data->text_log_attrs, g_free);
+		data->text_log_attrs_length = 0;
+	}
+}
+
 static void
 ev_page_cache_data_free (EvPageCacheData *data)
 {
@@ -102,6 +506,11 @@ ev_page_cache_data_free (EvPageCacheData *data)
 		data->job = NULL;
 	}
 
+	if (data->text_job) {
+		g_object_unref (data->text_job);
+		data->text_job = NULL;
+	}
+
 	if (data->link_mapping) {
 		ev_mapping_list_unref (data->link_mapping);
 		data->link_mapping = NULL;
@@ -138,6 +547,8 @@ ev_page_cache_data_free (EvPageCacheData *data)
 		data->text_layout_length = 0;
 	}
 
+	g_clear_pointer (&data->text_lines, ev_text_line_index_free);
+
 	if (data->text) {
 		g_free (data->text);
 		data->text = NULL;
@@ -153,6 +564,53 @@ ev_page_cache_data_free (EvPageCacheData *data)
                 data->text_log_attrs = NULL;
                 data->text_log_attrs_length = 0;
         }
+
+	g_clear_pointer (&data->packed_text_attrs, ev_packed_text_attrs_free);
+	g_clear_pointer (&data->packed_log_attrs, ev_packed_log_attrs_free);
+}
+
+/* Frees the text data of a page, it's fetched again when requested */
+static void
+ev_page_cache_data_release_text (EvPageCacheData *data)
+{
+	if (data->text_job || data->text_flags == EV_PAGE_DATA_INCLUDE_NONE)
+		return;
+
+	g_clear_pointer (&data->text_layout, g_free);
+	data->text_layout_length = 0;
+	g_clear_pointer (&data->text_lines, ev_text_line_index_free);
+	g_clear_pointer (&data->text, g_free);
+	g_clear_pointer (&data->text_attrs, pango_attr_list_unref);
+	g_clear_pointer (&data->text_log_attrs, g_free);
+	data->text_log_attrs_length = 0;
+	g_clear_pointer (&data->packed_text_attrs, ev_packed_text_attrs_free);
+	g_clear_pointer (&data->packed_log_attrs, ev_packed_log_attrs_free);
+
+	data->text_flags = EV_PAGE_DATA_INCLUDE_NONE;
+}
+
+/* Under low pressure the unpacked text attributes of every page but the
+ * visible ones are dropped, above it the whole text of those pages.
+ */
+static void
+memory_pressure_changed_cb (EvMemoryMonitor *monitor,
+			    EvPageCache     *cache)
+{
+	EvMemoryPressure pressure = ev_memory_monitor_get_pressure (monitor);
+	gint             i;
+
+	if (pressure == EV_MEMORY_PRESSURE_NONE)
+		return;
+
+	for (i = 0; i < cache->n_pages; i++) {
+		if (i >= cache->start_page && i <= cache->end_page)
+			continue;
+
+		if (pressure >= EV_MEMORY_PRESSURE_MEDIUM)
+			ev_page_cache_data_release_text (&cache->page_list[i]);
+		else
+			ev_page_cache_data_release_text_attrs (&cache->page_list[i]);
+	}
 }
 
 static void
@@ -161,6 +619,10 @@ ev_page_cache_finalize (GObject *object)
 	EvPageCache *cache = EV_PAGE_CACHE (object);
 	gint         i;
 
+	g_signal_handlers_disconnect_by_data (ev_memory_monitor_get_default (), cache);
+	ev_memory_stats_unregister ("page-text", cache);
+	ev_memory_stats_unregister ("page-mappings", cache);
+
 	if (cache->page_list) {
 		for (i = 0; i < cache->n_pages; i++) {
 			EvPageCacheData *data;
@@ -175,6 +637,14 @@ ev_page_cache_finalize (GObject *object)
 								      G_CALLBACK (job_page_data_cancelled_cb),
 								      data);
 			}
+			if (data->text_job) {
+				g_signal_handlers_disconnect_by_func (data->text_job,
+								      G_CALLBACK (job_page_text_finished_cb),
+								      cache);
+				g_signal_handlers_disconnect_by_func (data->text_job,
+								      G_CALLBACK (job_page_text_cancelled_cb),
+								      data);
+			}
 			ev_page_cache_data_free (data);
 		}
 
@@ -220,7 +690,7 @@ ev_page_cache_get_flags_for_data (EvPageCache     *cache,
 	EvJobPageDataFlags flags = EV_PAGE_DATA_INCLUDE_NONE;
 
 	if (data->flags == cache->flags && !data->dirty)
-		return cache->flags;
+		return cache->flags & ~EV_PAGE_DATA_TEXT_FLAGS;
 
 	/* Flags changed or data is dirty */
 	if (cache->flags & EV_PAGE_DATA_INCLUDE_LINKS) {
@@ -259,31 +729,218 @@ ev_page_cache_get_flags_for_data (EvPageCache     *cache,
 			flags | EV_PAGE_DATA_INCLUDE_TEXT_MAPPING;
 	}
 
-	if (cache->flags & EV_PAGE_DATA_INCLUDE_TEXT) {
-		flags = (data->text) ?
-			flags & ~EV_PAGE_DATA_INCLUDE_TEXT :
-			flags | EV_PAGE_DATA_INCLUDE_TEXT;
+	return flags;
+}
+
+static guint64
+ev_page_cache_data_get_text_size (EvPageCacheData *data)
+{
+	guint64 size = 0;
+
+	if (data->text)
+		size += strlen (data->text) + 1;
+	if (data->text_layout)
+		size += data->text_layout_length * sizeof (EvRectangle);
+	if (data->text_lines)
+		size += data->text_lines->lines->len * (sizeof (EvTextLine) + sizeof (guint));
+	if (data->text_mapping)
+		size += cairo_region_num_rectangles (data->text_mapping) * sizeof (cairo_rectangle_int_t);
+	if (data->packed_text_attrs)
+		size += data->packed_text_attrs->runs->len * sizeof (EvTextAttrRun);
+	if (data->packed_log_attrs)
+		size += data->packed_log_attrs->n_runs * 2;
+	if (data->text_log_attrs)
+		size += data->text_log_attrs_length * sizeof (PangoLogAttr);
+
+	return size;
+}
+
+/* The cache is only used from the main thread, where the statistics
+ * are asked for by the viewer. Text attributes are not counted. */
+static void
+get_text_memory_stats (gpointer  user_data,
+		       guint64  *bytes,
+		       guint    *n_entries)
+{
+	EvPageCache *cache = EV_PAGE_CACHE (user_data);
+	gint         i;
+
+	for (i = 0; i < cache->n_pages; i++) {
+		guint64 size = ev_page_cache_data_get_text_size (&cache->page_list[i]);
+
+		if (size > 0) {
+			*bytes += size;
+			*n_entries += 1;
+		}
 	}
+}
+
+static guint
+mapping_list_length (EvMappingList *mapping_list)
+{
+	return mapping_list ? ev_mapping_list_length (mapping_list) : 0;
+}
+
+static guint
+ev_stored_mappings_length (EvStoredMappings *stored)
+{
+	return mapping_list_length (stored->link_mapping) +
+		mapping_list_length (stored->form_field_mapping);
+}
+
+static void
+ev_stored_mappings_free (EvStoredMappings *stored)
+{
+	g_clear_pointer (&stored->link_mapping, ev_mapping_list_unref);
+	g_clear_pointer (&stored->form_field_mapping, ev_mapping_list_unref);
+	g_free (stored);
+}
+
+static void
+ev_mapping_store_free (EvMappingStore *store)
+{
+	g_hash_table_destroy (store->pages);
+	g_free (store);
+}
+
+static EvMappingStore *
+ev_mapping_store_get (EvDocument *document)
+{
+	EvMappingStore *store;
+
+	store = g_object_get_data (G_OBJECT (document), MAPPING_STORE_KEY);
+	if (store)
+		return store;
+
+	store = g_new0 (EvMappingStore, 1);
+	store->pages = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+					      (GDestroyNotify) ev_stored_mappings_free);
+	g_queue_init (&store->lru);
+	g_object_set_data_full (G_OBJECT (document), MAPPING_STORE_KEY, store,
+				(GDestroyNotify) ev_mapping_store_free);
+
+	return store;
+}
+
+static EvStoredMappings *
+ev_mapping_store_lookup (EvMappingStore *store,
+			 gint            page)
+{
+	EvStoredMappings *stored;
 
-	if (cache->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) {
-		flags = (data->text_layout_length > 0) ?
-			flags & ~EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT :
-			flags | EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT;
+	stored = g_hash_table_lookup (store->pages, GINT_TO_POINTER (page));
+	if (stored) {
+		g_queue_unlink (&store->lru, &stored->link);
+		g_queue_push_head_link (&store->lru, &stored->link);
 	}
 
-        if (cache->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS) {
-                flags = (data->text_attrs) ?
-                        flags & ~EV_PAGE_DATA_INCLUDE_TEXT_ATTRS :
-                        flags | EV_PAGE_DATA_INCLUDE_TEXT_ATTRS;
-        }
+	return stored;
+}
 
-        if (cache->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) {
-                flags = (data->text_log_attrs) ?
-                        flags & ~EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS :
-                        flags | EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS;
-        }
+static void
+ev_mapping_store_remove (EvMappingStore *store,
+			 gint            page)
+{
+	EvStoredMappings *stored;
 
-	return flags;
+	stored = g_hash_table_lookup (store->pages, GINT_TO_POINTER (page));
+	if (!stored)
+		return;
+
+	g_queue_unlink (&store->lru, &stored->link);
+	store->n_mappings -= ev_stored_mappings_length (stored);
+	g_hash_table_remove (store->pages, GINT_TO_POINTER (page));
+}
+
+static void
+ev_mapping_store_set_mapping (EvMappingStore *store,
+			      EvMappingList **stored_mapping,
+			      EvMappingList  *mapping)
+{
+	if (!mapping || mapping == *stored_mapping)
+		return;
+
+	store->n_mappings -= mapping_list_length (*stored_mapping);
+	g_clear_pointer (stored_mapping, ev_mapping_list_unref);
+	*stored_mapping = ev_mapping_list_ref (mapping);
+	store->n_mappings += mapping_list_length (mapping);
+}
+
+static void
+ev_mapping_store_add (EvMappingStore *store,
+		      gint            page,
+		      EvMappingList  *link_mapping,
+		      EvMappingList  *form_field_mapping)
+{
+	EvStoredMappings *stored;
+
+	if (!link_mapping && !form_field_mapping)
+		return;
+
+	stored = ev_mapping_store_lookup (store, page);
+	if (!stored) {
+		stored = g_new0 (EvStoredMappings, 1);
+		stored->page = page;
+		stored->link.data = stored;
+		g_hash_table_insert (store->pages, GINT_TO_POINTER (page), stored);
+		g_queue_push_head_link (&store->lru, &stored->link);
+	}
+
+	ev_mapping_store_set_mapping (store, &stored->link_mapping, link_mapping);
+	ev_mapping_store_set_mapping (store, &stored->form_field_mapping, form_field_mapping);
+
+	/* The page just added is kept even when it's over the budget alone */
+	while (store->n_mappings > MAX_STORED_MAPPINGS && store->lru.tail != &stored->link) {
+		EvStoredMappings *last = store->lru.tail->data;
+
+		ev_mapping_store_remove (store, last->page);
+	}
+}
+
+/* Takes the mappings of @page converted for another page cache */
+static void
+ev_page_cache_restore_mappings (EvPageCache *cache,
+				gint         page)
+{
+	EvPageCacheData  *data = &cache->page_list[page];
+	EvStoredMappings *stored;
+
+	if (!(cache->flags & (EV_PAGE_DATA_INCLUDE_LINKS | EV_PAGE_DATA_INCLUDE_FORMS)))
+		return;
+
+	stored = ev_mapping_store_lookup (ev_mapping_store_get (cache->document), page);
+	if (!stored)
+		return;
+
+	if ((cache->flags & EV_PAGE_DATA_INCLUDE_LINKS) && !data->link_mapping && stored->link_mapping)
+		data->link_mapping = ev_mapping_list_ref (stored->link_mapping);
+	if ((cache->flags & EV_PAGE_DATA_INCLUDE_FORMS) && !data->form_field_mapping &&
+	    stored->form_field_mapping)
+		data->form_field_mapping = ev_mapping_list_ref (stored->form_field_mapping);
+}
+
+/* Counts the mappings, not the objects they map */
+static void
+get_mappings_memory_stats (gpointer  user_data,
+			   guint64  *bytes,
+			   guint    *n_entries)
+{
+	EvPageCache *cache = EV_PAGE_CACHE (user_data);
+	gint         i;
+
+	for (i = 0; i < cache->n_pages; i++) {
+		EvPageCacheData *data = &cache->page_list[i];
+		guint            n_mappings;
+
+		n_mappings = mapping_list_length (data->link_mapping) +
+			mapping_list_length (data->image_mapping) +
+			mapping_list_length (data->form_field_mapping) +
+			mapping_list_length (data->annot_mapping) +
+			mapping_list_length (data->media_mapping);
+
+		*bytes += n_mappings * (sizeof (EvMapping) + sizeof (GList));
+		*n_entries += n_mappings;
+	}
 }
 
 EvPageCache *
@@ -298,10 +955,27 @@ ev_page_cache_new (EvDocument *document)
 	cache->n_pages = ev_document_get_n_pages (document);
 	cache->flags = EV_PAGE_DATA_FLAGS_DEFAULT;
 	cache->page_list = g_new0 (EvPageCacheData, cache->n_pages);
+	cache->client = cache;
+
+	g_signal_connect (ev_memory_monitor_get_default (), "pressure-changed",
+			  G_CALLBACK (memory_pressure_changed_cb),
+			  cache);
+
+	ev_memory_stats_register ("page-text", get_text_memory_stats, cache);
+	ev_memory_stats_register ("page-mappings", get_mappings_memory_stats, cache);
 
 	return cache;
 }
 
+void
+ev_page_cache_set_scheduler_client (EvPageCache *cache,
+				    gpointer     client)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+
+	cache->client = client;
+}
+
 static void
 job_page_data_finished_cb (EvJob       *job,
 			   EvPageCache *cache)
@@ -311,34 +985,31 @@ job_page_data_finished_cb (EvJob       *job,
 
 	data = &cache->page_list[job_data->page];
 
-	if (job_data->flags & EV_PAGE_DATA_INCLUDE_LINKS)
+	/* The restored mappings are replaced if the job got them too */
+	if (job_data->flags & EV_PAGE_DATA_INCLUDE_LINKS) {
+		g_clear_pointer (&data->link_mapping, ev_mapping_list_unref);
 		data->link_mapping = job_data->link_mapping;
+	}
 	if (job_data->flags & EV_PAGE_DATA_INCLUDE_IMAGES)
 		data->image_mapping = job_data->image_mapping;
-	if (job_data->flags & EV_PAGE_DATA_INCLUDE_FORMS)
+	if (job_data->flags & EV_PAGE_DATA_INCLUDE_FORMS) {
+		g_clear_pointer (&data->form_field_mapping, ev_mapping_list_unref);
 		data->form_field_mapping = job_data->form_field_mapping;
+	}
 	if (job_data->flags & EV_PAGE_DATA_INCLUDE_ANNOTS)
 		data->annot_mapping = job_data->annot_mapping;
         if (job_data->flags & EV_PAGE_DATA_INCLUDE_MEDIA)
                 data->media_mapping = job_data->media_mapping;
 	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING)
 		data->text_mapping = job_data->text_mapping;
-	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) {
-		data->text_layout = job_data->text_layout;
-		data->text_layout_length = job_data->text_layout_length;
-	}
-	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT)
-		data->text = job_data->text;
-	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS)
-		data->text_attrs = job_data->text_attrs;
-        if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) {
-                data->text_log_attrs = job_data->text_log_attrs;
-                data->text_log_attrs_length = job_data->text_log_attrs_length;
-        }
 
 	data->done = TRUE;
 	data->dirty = FALSE;
 
+	ev_mapping_store_add (ev_mapping_store_get (cache->document), job_data->page,
+			      job_data->flags & EV_PAGE_DATA_INCLUDE_LINKS ? data->link_mapping : NULL,
+			      job_data->flags & EV_PAGE_DATA_INCLUDE_FORMS ? data->form_field_mapping : NULL);
+
 	g_object_unref (data->job);
 	data->job = NULL;
 
@@ -354,8 +1025,57 @@ job_page_data_cancelled_cb (EvJob           *job,
 }
 
 static void
-ev_page_cache_schedule_job_if_needed (EvPageCache *cache,
-				      gint page)
+job_page_text_finished_cb (EvJob       *job,
+			   EvPageCache *cache)
+{
+	EvJobPageData   *job_data = EV_JOB_PAGE_DATA (job);
+	EvPageCacheData *data;
+
+	data = &cache->page_list[job_data->page];
+
+	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) {
+		g_clear_pointer (&data->text_lines, ev_text_line_index_free);
+		data->text_layout = job_data->text_layout;
+		data->text_layout_length = job_data->text_layout_length;
+	}
+	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT)
+		data->text = job_data->text;
+	if ((job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS) && job_data->text_attrs) {
+		data->packed_text_attrs = ev_packed_text_attrs_new (job_data->text_attrs);
+		g_clear_pointer (&job_data->text_attrs, pango_attr_list_unref);
+	}
+        if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) {
+                if (job_data->text_log_attrs)
+                        data->packed_log_attrs = ev_packed_log_attrs_new (job_data->text_log_attrs,
+                                                                          job_data->text_log_attrs_length);
+                if (data->packed_log_attrs) {
+                        g_clear_pointer (&job_data->text_log_attrs, g_free);
+                } else {
+                        data->text_log_attrs = job_data->text_log_attrs;
+                        data->text_log_attrs_length = job_data->text_log_attrs_length;
+                }
+        }
+
+	g_object_unref (data->text_job);
+	data->text_job = NULL;
+
+        g_signal_emit (cache, ev_page_cache_signals[PAGE_CACHED], 0, job_data->page);
+}
+
+static void
+job_page_text_cancelled_cb (EvJob           *job,
+			    EvPageCacheData *data)
+{
+	data->text_flags &= ~EV_JOB_PAGE_DATA (job)->flags;
+
+	g_object_unref (data->text_job);
+	data->text_job = NULL;
+}
+
+static void
+ev_page_cache_schedule_job_if_needed (EvPageCache  *cache,
+				      gint          page,
+				      EvJobPriority priority)
 {
 	EvPageCacheData   *data = &cache->page_list[page];
 	EvJobPageDataFlags flags;
@@ -366,9 +1086,17 @@ ev_page_cache_schedule_job_if_needed (EvPageCache *cache,
 	if (data->job)
 		ev_job_cancel (data->job);
 
+	ev_page_cache_restore_mappings (cache, page);
 	flags = ev_page_cache_get_flags_for_data (cache, data);
 
 	data->flags = cache->flags;
+	if (flags == EV_PAGE_DATA_INCLUDE_NONE) {
+		/* Only text data is missing, if any */
+		data->done = TRUE;
+		data->dirty = FALSE;
+		return;
+	}
+
 	data->job = ev_job_page_data_new (cache->document, page, flags);
 	g_signal_connect (data->job, "finished",
 			  G_CALLBACK (job_page_data_finished_cb),
@@ -376,8 +1104,64 @@ ev_page_cache_schedule_job_if_needed (EvPageCache *cache,
 	g_signal_connect (data->job, "cancelled",
 			  G_CALLBACK (job_page_data_cancelled_cb),
 			  data);
-	ev_job_scheduler_push_job (data->job, EV_JOB_PRIORITY_NONE);
+	ev_job_scheduler_push_job_for_client (data->job, priority, cache->client);
+}
 
+static void
+ev_page_cache_schedule_text_job_if_needed (EvPageCache  *cache,
+					   gint          page,
+					   EvJobPriority priority)
+{
+	EvPageCacheData   *data = &cache->page_list[page];
+	EvJobPageDataFlags flags;
+
+	flags = cache->flags & EV_PAGE_DATA_TEXT_FLAGS & ~data->text_flags;
+	if (flags == EV_PAGE_DATA_INCLUDE_NONE) {
+		/* Text is already being fetched, make it sooner if needed */
+		if (data->text_job && priority < data->text_priority) {
+			data->text_priority = priority;
+			ev_job_scheduler_update_job (data->text_job, priority);
+		}
+		return;
+	}
+
+	if (data->text_job) {
+		flags |= EV_JOB_PAGE_DATA (data->text_job)->flags;
+		priority = MIN (priority, data->text_priority);
+		ev_job_cancel (data->text_job);
+	}
+
+	data->text_flags |= flags;
+	data->text_priority = priority;
+	data->text_job = ev_job_page_data_new (cache->document, page, flags);
+	g_signal_connect (data->text_job, "finished",
+			  G_CALLBACK (job_page_text_finished_cb),
+			  cache);
+	g_signal_connect (data->text_job, "cancelled",
+			  G_CALLBACK (job_page_text_cancelled_cb),
+			  data);
+	ev_job_scheduler_push_job_for_client (data->text_job, priority, cache->client);
+}
+
+/* Returns the job fetching @flag for @data, if it's not cached yet */
+static EvJobPageData *
+ev_page_cache_data_get_text_job (EvPageCacheData   *data,
+				 EvJobPageDataFlags flag)
+{
+	if (data->text_job && (EV_JOB_PAGE_DATA (data->text_job)->flags & flag))
+		return EV_JOB_PAGE_DATA (data->text_job);
+
+	return NULL;
+}
+
+static void
+ev_page_cache_ensure_page_data (EvPageCache  *cache,
+				gint          page,
+				EvJobPriority priority)
+{
+	ev_page_cache_schedule_job_if_needed (cache, page, priority);
+	if (cache->prefetch_text)
+		ev_page_cache_schedule_text_job_if_needed (cache, page, EV_JOB_PRIORITY_NONE);
 }
 
 void
@@ -391,8 +1175,15 @@ ev_page_cache_set_page_range (EvPageCache *cache,
 	if (cache->flags == EV_PAGE_DATA_INCLUDE_NONE)
 		return;
 
+	/* Only keep the unpacked text attributes of pages around the range */
+	for (i = MAX (cache->start_page - PRE_CACHE_SIZE * 2, 0);
+	     i <= MIN (cache->end_page + PRE_CACHE_SIZE * 2, cache->n_pages - 1); i++) {
+		if (i < start - PRE_CACHE_SIZE * 2 || i > end + PRE_CACHE_SIZE * 2)
+			ev_page_cache_data_release_text_attrs (&cache->page_list[i]);
+	}
+
 	for (i = start; i <= end; i++)
-		ev_page_cache_schedule_job_if_needed (cache, i);
+		ev_page_cache_ensure_page_data (cache, i, EV_JOB_PRIORITY_HIGH);
 
 	cache->start_page = start;
 	cache->end_page = end;
@@ -401,13 +1192,13 @@ ev_page_cache_set_page_range (EvPageCache *cache,
         pages_to_pre_cache = PRE_CACHE_SIZE * 2;
         while ((start - i > 0) || (end + i < cache->n_pages)) {
                 if (end + i < cache->n_pages) {
-                        ev_page_cache_schedule_job_if_needed (cache, end + i);
+                        ev_page_cache_ensure_page_data (cache, end + i, EV_JOB_PRIORITY_LOW);
                         if (--pages_to_pre_cache == 0)
                                 break;
                 }
 
                 if (start - i > 0) {
-                        ev_page_cache_schedule_job_if_needed (cache, start - i);
+                        ev_page_cache_ensure_page_data (cache, start - i, EV_JOB_PRIORITY_LOW);
                         if (--pages_to_pre_cache == 0)
                                 break;
                 }
@@ -434,6 +1225,33 @@ ev_page_cache_set_flags (EvPageCache       *cache,
 	ev_page_cache_set_page_range (cache, cache->start_page, cache->end_page);
 }
 
+/**
+ * ev_page_cache_set_prefetch_text:
+ * @cache: a #EvPageCache
+ * @prefetch_text: whether to fetch the text of pages in range
+ *
+ * Text data (%EV_PAGE_DATA_INCLUDE_TEXT, %EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT,
+ * %EV_PAGE_DATA_INCLUDE_TEXT_ATTRS and %EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS)
+ * is only fetched for a page the first time it's requested, unless
+ * @prefetch_text is %TRUE. In that case it's fetched, after the other
+ * data, for the pages in the current range too.
+ *
+ * Since: 3.30
+ */
+void
+ev_page_cache_set_prefetch_text (EvPageCache *cache,
+				 gboolean     prefetch_text)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+
+	if (cache->prefetch_text == prefetch_text)
+		return;
+
+	cache->prefetch_text = prefetch_text;
+	if (cache->prefetch_text)
+		ev_page_cache_set_page_range (cache, cache->start_page, cache->end_page);
+}
+
 void
 ev_page_cache_mark_dirty (EvPageCache       *cache,
 			  gint               page,
@@ -444,7 +1262,18 @@ ev_page_cache_mark_dirty (EvPageCache       *cache,
 	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
 
 	data = &cache->page_list[page];
-	data->dirty = TRUE;
+	if (flags & ~EV_PAGE_DATA_TEXT_FLAGS)
+		data->dirty = TRUE;
+
+	/* Otherwise the old mappings would be restored */
+	if (flags & (EV_PAGE_DATA_INCLUDE_LINKS | EV_PAGE_DATA_INCLUDE_FORMS))
+		ev_mapping_store_remove (ev_mapping_store_get (cache->document), page);
+
+	if (flags & EV_PAGE_DATA_TEXT_FLAGS) {
+		if (ev_page_cache_data_get_text_job (data, flags))
+			ev_job_cancel (data->text_job);
+		data->text_flags &= ~flags;
+	}
 
         if (flags & EV_PAGE_DATA_INCLUDE_LINKS)
                 g_clear_pointer (&data->link_mapping, ev_mapping_list_unref);
@@ -469,14 +1298,18 @@ ev_page_cache_mark_dirty (EvPageCache       *cache,
 
 	if (flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) {
                 g_clear_pointer (&data->text_layout, g_free);
+                g_clear_pointer (&data->text_lines, ev_text_line_index_free);
                 data->text_layout_length = 0;
         }
 
-        if (flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS)
+        if (flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS) {
                 g_clear_pointer (&data->text_attrs, pango_attr_list_unref);
+                g_clear_pointer (&data->packed_text_attrs, ev_packed_text_attrs_free);
+        }
 
         if (flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) {
                 g_clear_pointer (&data->text_log_attrs, g_free);
+                g_clear_pointer (&data->packed_log_attrs, ev_packed_log_attrs_free);
                 data->text_log_attrs_length = 0;
         }
 
@@ -484,6 +1317,105 @@ ev_page_cache_mark_dirty (EvPageCache       *cache,
 	ev_page_cache_set_page_range (cache, cache->start_page, cache->end_page);
 }
 
+/* Annotations edited in the view update the cached mappings in place,
+ * instead of fetching the annotations of the page again. The list is
+ * usually the one of the backend, already updated, otherwise it's
+ * updated here. Pages not fetched yet get the annotations from the
+ * backend anyway.
+ */
+static EvPageCacheData *
+ev_page_cache_get_annots_data (EvPageCache  *cache,
+			       EvAnnotation *annot)
+{
+	EvPageCacheData *data;
+	gint             page;
+
+	if (!(cache->flags & EV_PAGE_DATA_INCLUDE_ANNOTS))
+		return NULL;
+
+	page = ev_annotation_get_page_index (annot);
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, NULL);
+
+	data = &cache->page_list[page];
+	if (!data->done || data->dirty) {
+		ev_page_cache_mark_dirty (cache, page, EV_PAGE_DATA_INCLUDE_ANNOTS);
+		return NULL;
+	}
+
+	return data;
+}
+
+void
+ev_page_cache_add_annot (EvPageCache  *cache,
+			 EvAnnotation *annot)
+{
+	EvPageCacheData *data;
+	EvMapping       *mapping;
+
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (EV_IS_ANNOTATION (annot));
+
+	data = ev_page_cache_get_annots_data (cache, annot);
+	if (!data)
+		return;
+
+	if (data->annot_mapping && ev_mapping_list_find (data->annot_mapping, annot))
+		return;
+
+	mapping = g_new (EvMapping, 1);
+	ev_annotation_get_area (annot, &mapping->area);
+	mapping->data = g_object_ref (annot);
+
+	if (data->annot_mapping) {
+		ev_mapping_list_add (data->annot_mapping, mapping);
+	} else {
+		data->annot_mapping = ev_mapping_list_new (ev_annotation_get_page_index (annot),
+							   g_list_prepend (NULL, mapping),
+							   (GDestroyNotify) g_object_unref);
+	}
+}
+
+void
+ev_page_cache_update_annot (EvPageCache  *cache,
+			    EvAnnotation *annot)
+{
+	EvPageCacheData *data;
+	EvMapping       *mapping;
+
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (EV_IS_ANNOTATION (annot));
+
+	data = ev_page_cache_get_annots_data (cache, annot);
+	if (!data || !data->annot_mapping)
+		return;
+
+	mapping = ev_mapping_list_find (data->annot_mapping, annot);
+	if (!mapping)
+		return;
+
+	ev_annotation_get_area (annot, &mapping->area);
+	ev_mapping_list_update (data->annot_mapping, mapping);
+}
+
+void
+ev_page_cache_remove_annot (EvPageCache  *cache,
+			    EvAnnotation *annot)
+{
+	EvPageCacheData *data;
+	EvMapping       *mapping;
+
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (EV_IS_ANNOTATION (annot));
+
+	data = ev_page_cache_get_annots_data (cache, annot);
+	if (!data || !data->annot_mapping)
+		return;
+
+	mapping = ev_mapping_list_find (data->annot_mapping, annot);
+	if (mapping)
+		ev_mapping_list_remove (data->annot_mapping, mapping);
+}
+
 EvMappingList *
 ev_page_cache_get_link_mapping (EvPageCache *cache,
 				gint         page)
@@ -621,6 +1553,7 @@ ev_page_cache_get_text (EvPageCache *cache,
 			     gint         page)
 {
 	EvPageCacheData *data;
+	EvJobPageData   *job_data;
 
 	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), NULL);
 	g_return_val_if_fail (page >= 0 && page < cache->n_pages, NULL);
@@ -628,12 +1561,12 @@ ev_page_cache_get_text (EvPageCache *cache,
 	if (!(cache->flags & EV_PAGE_DATA_INCLUDE_TEXT))
 		return NULL;
 
-	data = &cache->page_list[page];
-	if (data->done)
-		return data->text;
+	ev_page_cache_schedule_text_job_if_needed (cache, page, EV_JOB_PRIORITY_LOW);
 
-	if (data->job)
-		return EV_JOB_PAGE_DATA (data->job)->text;
+	data = &cache->page_list[page];
+	job_data = ev_page_cache_data_get_text_job (data, EV_PAGE_DATA_INCLUDE_TEXT);
+	if (job_data)
+		return job_data->text;
 
 	return data->text;
 }
@@ -645,6 +1578,7 @@ ev_page_cache_get_text_layout (EvPageCache  *cache,
 			       guint        *n_areas)
 {
 	EvPageCacheData *data;
+	EvJobPageData   *job_data;
 
 	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), FALSE);
 	g_return_val_if_fail (page >= 0 && page < cache->n_pages, FALSE);
@@ -652,22 +1586,78 @@ ev_page_cache_get_text_layout (EvPageCache  *cache,
 	if (!(cache->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT))
 		return FALSE;
 
+	ev_page_cache_schedule_text_job_if_needed (cache, page, EV_JOB_PRIORITY_LOW);
+
 	data = &cache->page_list[page];
-	if (data->done)	{
-		*areas = data->text_layout;
-		*n_areas = data->text_layout_length;
+	job_data = ev_page_cache_data_get_text_job (data, EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT);
+	if (job_data) {
+		*areas = job_data->text_layout;
+		*n_areas = job_data->text_layout_length;
 
 		return TRUE;
 	}
 
-	if (data->job) {
-		*areas = EV_JOB_PAGE_DATA (data->job)->text_layout;
-		*n_areas = EV_JOB_PAGE_DATA (data->job)->text_layout_length;
+	*areas = data->text_layout;
+	*n_areas = data->text_layout_length;
 
-		return TRUE;
+	return TRUE;
+}
+
+/**
+ * ev_page_cache_find_text_line_at:
+ * @cache: a #EvPageCache
+ * @page: a page index
+ * @y: a y coordinate in document units
+ * @from: an index in the text layout of @page
+ *
+ * Finds the first area of the text layout of @page, starting at
+ * @from, that may contain @y: areas not returned before the next
+ * one don't contain @y. The index of the lines of the layout is built
+ * on the first call for a page.
+ *
+ * Returns: the index of the area, or the number of areas if there's
+ *   none. @from if the text layout of @page isn't cached yet.
+ */
+guint
+ev_page_cache_find_text_line_at (EvPageCache *cache,
+				 gint         page,
+				 gdouble      y,
+				 guint        from)
+{
+	EvPageCacheData *data;
+	EvTextLineIndex *index;
+	guint            retval;
+	guint            i;
+
+	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), from);
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, from);
+
+	data = &cache->page_list[page];
+	if (!data->text_layout ||
+	    ev_page_cache_data_get_text_job (data, EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT))
+		return from;
+
+	if (!data->text_lines)
+		data->text_lines = ev_text_line_index_new (data->text_layout,
+							   data->text_layout_length);
+	index = data->text_lines;
+
+	/* Lines containing y start at most max_height above it */
+	retval = data->text_layout_length;
+	for (i = ev_text_line_index_lower_bound (index, y - index->max_height);
+	     i < index->lines->len; i++) {
+		EvTextLine *line = &g_array_index (index->lines, EvTextLine, index->sorted[i]);
+
+		if (line->y1 > y)
+			break;
+
+		if (line->y2 < y || line->end <= from)
+			continue;
+
+		retval = MIN (retval, MAX (line->start, from));
 	}
 
-	return FALSE;
+	return retval;
 }
 
 /**
@@ -684,6 +1674,7 @@ ev_page_cache_get_text_attrs (EvPageCache    *cache,
 			      gint            page)
 {
 	EvPageCacheData *data;
+	EvJobPageData   *job_data;
 
 	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), NULL);
 	g_return_val_if_fail (page >= 0 && page < cache->n_pages, NULL);
@@ -691,12 +1682,15 @@ ev_page_cache_get_text_attrs (EvPageCache    *cache,
 	if (!(cache->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS))
 	    return NULL;
 
+	ev_page_cache_schedule_text_job_if_needed (cache, page, EV_JOB_PRIORITY_LOW);
+
 	data = &cache->page_list[page];
-	if (data->done)
-		return data->text_attrs;
+	job_data = ev_page_cache_data_get_text_job (data, EV_PAGE_DATA_INCLUDE_TEXT_ATTRS);
+	if (job_data)
+		return job_data->text_attrs;
 
-	if (data->job)
-		return EV_JOB_PAGE_DATA(data->job)->text_attrs;
+	if (!data->text_attrs && data->packed_text_attrs)
+		data->text_attrs = ev_packed_text_attrs_to_list (data->packed_text_attrs);
 
 	return data->text_attrs;
 }
@@ -721,6 +1715,7 @@ ev_page_cache_get_text_log_attrs (EvPageCache   *cache,
                                   gulong        *n_attrs)
 {
         EvPageCacheData *data;
+        EvJobPageData   *job_data;
 
         g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), FALSE);
         g_return_val_if_fail (page >= 0 && page < cache->n_pages, FALSE);
@@ -728,22 +1723,26 @@ ev_page_cache_get_text_log_attrs (EvPageCache   *cache,
         if (!(cache->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS))
                 return FALSE;
 
+        ev_page_cache_schedule_text_job_if_needed (cache, page, EV_JOB_PRIORITY_LOW);
+
         data = &cache->page_list[page];
-        if (data->done) {
-                *log_attrs = data->text_log_attrs;
-                *n_attrs = data->text_log_attrs_length;
+        job_data = ev_page_cache_data_get_text_job (data, EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS);
+        if (job_data) {
+                *log_attrs = job_data->text_log_attrs;
+                *n_attrs = job_data->text_log_attrs_length;
 
                 return TRUE;
         }
 
-        if (data->job) {
-                *log_attrs = EV_JOB_PAGE_DATA (data->job)->text_log_attrs;
-                *n_attrs = EV_JOB_PAGE_DATA (data->job)->text_log_attrs_length;
-
-                return TRUE;
+        if (!data->text_log_attrs && data->packed_log_attrs) {
+                data->text_log_attrs = ev_packed_log_attrs_to_array (data->packed_log_attrs);
+                data->text_log_attrs_length = data->packed_log_attrs->n_attrs;
         }
 
-        return FALSE;
+        *log_attrs = data->text_log_attrs;
+        *n_attrs = data->text_log_attrs_length;
+
+        return TRUE;
 }
 
 void
@@ -753,7 +1752,8 @@ ev_page_cache_ensure_page (EvPageCache *cache,
         g_return_if_fail (EV_IS_PAGE_CACHE (cache));
         g_return_if_fail (page >= 0 && page < cache->n_pages);
 
-        ev_page_cache_schedule_job_if_needed (cache, page);
+        ev_page_cache_schedule_job_if_needed (cache, page, EV_JOB_PRIORITY_LOW);
+        ev_page_cache_schedule_text_job_if_needed (cache, page, EV_JOB_PRIORITY_LOW);
 }
 
 gboolean
@@ -50,9 +50,19 @@ void               ev_page_cache_set_page_range         (EvPageCache       *cach
 EvJobPageDataFlags ev_page_cache_get_flags              (EvPageCache       *cache);
 void               ev_page_cache_set_flags              (EvPageCache       *cache,
 							 EvJobPageDataFlags flags);
+void               ev_page_cache_set_prefetch_text      (EvPageCache       *cache,
+							 gboolean           prefetch_text);
+void               ev_page_cache_set_scheduler_client   (EvPageCache       *cache,
+							 gpointer           client);
 void               ev_page_cache_mark_dirty             (EvPageCache       *cache,
 							 gint               page,
                                                          EvJobPageDataFlags flags);
+void               ev_page_cache_add_annot              (EvPageCache       *cache,
+							 EvAnnotation      *annot);
+void               ev_page_cache_update_annot           (EvPageCache       *cache,
+							 EvAnnotation      *annot);
+void               ev_page_cache_remove_annot           (EvPageCache       *cache,
+							 EvAnnotation      *annot);
 EvMappingList     *ev_page_cache_get_link_mapping       (EvPageCache       *cache,
 							 gint               page);
 EvMappingList     *ev_page_cache_get_image_mapping      (EvPageCache       *cache,
@@ -71,6 +81,10 @@ gboolean           ev_page_cache_get_text_layout        (EvPageCache       *cach
 							 gint               page,
 							 EvRectangle      **areas,
 							 guint             *n_areas);
+guint              ev_page_cache_find_text_line_at      (EvPageCache       *cache,
+                                                         gint               page,
+                                                         gdouble            y,
+                                                         guint              from);
 PangoAttrList     *ev_page_cache_get_text_attrs         (EvPageCache       *cache,
                                                          gint               page);
 gboolean           ev_page_cache_get_text_log_attrs     (EvPageCache       *cache,
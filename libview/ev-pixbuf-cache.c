@@ -1,26 +1,65 @@
 #include <config.h>
+#include <math.h>
+#include "ev-debug.h"
+#include "ev-document-misc.h"
 #include "ev-pixbuf-cache.h"
 #include "ev-job-scheduler.h"
+#include "ev-memory-monitor.h"
+#include "ev-power-monitor.h"
+#include "ev-memory-stats.h"
+#include "ev-page-archive.h"
+#include "ev-document-security.h"
+#include "ev-render-pack.h"
+#include "ev-render-stats.h"
+#include "ev-surface-budget.h"
 #include "ev-view-private.h"
+#include "ev-view-marshal.h"
 
 typedef enum {
         SCROLL_DIRECTION_DOWN,
         SCROLL_DIRECTION_UP
 } ScrollDirection;
 
+typedef struct _CacheTile
+{
+	EvJob *job;
+	cairo_surface_t *surface;
+	gboolean draft;
+	/* The surface was scaled from a thumbnail, with the annotations
+	 * and form fields of the page in it */
+	gboolean from_thumbnail;
+} CacheTile;
+
 typedef struct _CacheJobInfo
 {
 	EvJob *job;
 	gboolean page_ready;
 
-	/* Region of the page that needs to be drawn */
+	/* Low resolution render shown until job finishes */
+	EvJob *preview_job;
+
+	/* Region of the page that needs to be drawn, in pixels
+	 * of the page at the scale of the view */
 	cairo_region_t  *region;
 
 	/* Data we get from rendering */
 	cairo_surface_t *surface;
+	gboolean draft;
+
+	/* Annotations drawn over surface, for documents rendered in
+	 * layers, and the job rendering them again when they change */
+	cairo_surface_t *annotations;
+	EvJob           *annotations_job;
+
+	/* Render of a part of the page that changed, like a form
+	 * field, drawn over surface when it finishes */
+	EvJob           *area_job;
 
 	/* Device scale factor of target widget */
-	int device_scale;
+	gdouble device_scale;
+
+	/* Restore of the surface from the archive, instead of a render */
+	GCancellable *restore_cancellable;
 
 	/* Selection data. 
 	 * Selection_points are the coordinates encapsulated in selection.
@@ -36,6 +75,16 @@ typedef struct _CacheJobInfo
 	cairo_region_t *selection_region;
 	gdouble         selection_region_scale;
 	EvRectangle     selection_region_points;
+
+	/* Selections for target_points, rendered in threads */
+	EvJob          *selection_job;
+	EvJob          *selection_region_job;
+
+	/* Tiles of the page, used instead of surface when the page
+	 * is too big to be rendered at once. */
+	GHashTable     *tiles;
+	gdouble         tiles_scale;
+	gint            tiles_rotation;
 } CacheJobInfo;
 
 struct _EvPixbufCache
@@ -49,9 +98,30 @@ struct _EvPixbufCache
 	int start_page;
 	int end_page;
         ScrollDirection scroll_direction;
-	gboolean inverted_colors;
+
+	/* Keep only the regions of selections, without surfaces */
+	gboolean selection_region_only;
+
+	/* Device pixels per pixel of the view, 0 to use the
+	 * scale factor of the view */
+	gdouble device_scale;
+
+	/* Estimated scrolling speed, in pages per second */
+	gdouble scroll_velocity;
+	gint64  scroll_time;
+
+	/* While the view is scrolled fast or zoomed pages are rendered
+	 * as drafts, refined once it stops for REFINE_TIMEOUT */
+	gboolean in_motion;
+	gdouble  motion_scale;
+	guint    refine_id;
 
 	gsize max_size;
+	/* Smaller max_size used to preload pages while the view is in
+	 * the background, 0 if unset. No page is preloaded under memory
+	 * pressure. */
+	gsize size_limit;
+	gboolean under_pressure;
 
 	/* preload_cache_size is the number of pages prior to the current
 	 * visible area that we cache.  It's normally 1, but could be 2 in the
@@ -63,13 +133,43 @@ struct _EvPixbufCache
 	CacheJobInfo *prev_job;
 	CacheJobInfo *job_list;
 	CacheJobInfo *next_job;
+
+	/* Rendered elsewhere, used instead of the preview job of the
+	 * page with the same rotation, see ev_pixbuf_cache_set_page_preview() */
+	cairo_surface_t *seed_preview;
+	gint             seed_page;
+	gint             seed_rotation;
+
+	/* Damage of the jobs finished in the current batch, by page,
+	 * NULL for the whole page. Emitted once the batch is over. */
+	GHashTable *pending_damage;
+
+	/* Pages that left the cache, kept compressed */
+	EvPageArchive *archive;
+
+	/* Pages out of the range likely to be shown next, like link
+	 * destinations, rendered at the lowest priority straight into
+	 * the archive. Most urgent first, and the render of the first. */
+	GQueue  prefetch_pages;
+	EvJob  *prefetch_job;
+
+	/* Renders that were slow, saved on disk for the next time the
+	 * document is opened. Opened when first needed, and given up
+	 * once the document is modified or its layers change, since its
+	 * pages don't match the file anymore, and for encrypted
+	 * documents. render_pack_size is 0 to disable it. */
+	EvRenderPack *render_pack;
+	gsize         render_pack_size;
+	gboolean      render_pack_disabled;
 };
 
 struct _EvPixbufCacheClass
 {
 	GObjectClass parent_class;
 
-	void (* job_finished) (EvPixbufCache *pixbuf_cache);
+	void (* job_finished) (EvPixbufCache  *pixbuf_cache,
+			       gint            page,
+			       cairo_region_t *region);
 };
 
 
@@ -81,18 +181,39 @@ enum
 
 static guint signals[N_SIGNALS] = {0, };
 
+static gboolean first_job_queued = FALSE;
+
 static void          ev_pixbuf_cache_init       (EvPixbufCache      *pixbuf_cache);
 static void          ev_pixbuf_cache_class_init (EvPixbufCacheClass *pixbuf_cache);
 static void          ev_pixbuf_cache_finalize   (GObject            *object);
 static void          ev_pixbuf_cache_dispose    (GObject            *object);
 static void          job_finished_cb            (EvJob              *job,
 						 EvPixbufCache      *pixbuf_cache);
+static void          tile_job_finished_cb       (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
+static void          preview_job_finished_cb    (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
+static void          annotations_job_finished_cb (EvJob             *job,
+						  EvPixbufCache     *pixbuf_cache);
+static void          prefetch_job_finished_cb   (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
+static void          area_job_finished_cb       (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
+static void          selection_job_finished_cb  (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
+static void          selection_region_job_finished_cb (EvJob        *job,
+						       EvPixbufCache *pixbuf_cache);
 static CacheJobInfo *find_job_cache             (EvPixbufCache      *pixbuf_cache,
 						 int                 page);
+static gboolean      evict_surface_cb           (cairo_surface_t    *surface,
+						 gpointer            data);
 static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cache,
 						  CacheJobInfo       *job_info,
 						  gint                page,
 						  gfloat              scale);
+static void          ev_pixbuf_cache_add_jobs_if_needed (EvPixbufCache *pixbuf_cache,
+							 gint           rotation,
+							 gfloat         scale);
 
 
 /* These are used for iterating through the prev and next arrays */
@@ -103,7 +224,53 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 #define PAGE_CACHE_LEN(pixbuf_cache) \
 	((pixbuf_cache->end_page - pixbuf_cache->start_page) + 1)
 
-#define MAX_PRELOADED_PAGES 3
+/* Pages preloaded on each side while reading, and while scrolling
+ * as fast as we can keep up with. Only the minimum is preloaded while
+ * the device saves power. */
+#define MIN_PRELOADED_PAGES 1
+#define MAX_PRELOADED_PAGES 12
+
+/* Enough pages are preloaded to keep up with this much scrolling at
+ * the current speed, and the ones reached in the first part of it are
+ * more urgent */
+#define PRELOAD_TIME 0.5
+#define PRELOAD_HIGH_PRIORITY_TIME 0.2
+
+/* Above this speed, in pages per second, pages left behind are not
+ * rendered anymore */
+#define FAST_SCROLL_VELOCITY 2.0
+
+/* The speed is forgotten when the range doesn't change for this long */
+#define SCROLL_VELOCITY_TIMEOUT (G_USEC_PER_SEC / 2)
+
+/* Pages bigger than this, in device pixels, are rendered in tiles */
+#define MAX_UNTILED_PAGE_PIXELS (2048 * 2048)
+/* Tiles this close to the visible area are rendered in advance */
+#define TILE_PRELOAD_MARGIN EV_PIXBUF_CACHE_TILE_SIZE
+
+/* Previews are rendered at this fraction of the page size */
+#define PREVIEW_SCALE_FACTOR 0.25
+
+/* Compressed pages kept after they leave the cache, in bytes */
+#define ARCHIVE_MAX_SIZE (64 * 1024 * 1024)
+/* Pages waiting to be prefetched into the archive */
+#define MAX_PREFETCH_PAGES 8
+/* Pages taking longer to render are saved in the render pack, in
+ * microseconds */
+#define RENDER_PACK_MIN_TIME (500 * 1000)
+
+/* Drafts are rendered at this fraction of the page size */
+#define DRAFT_SCALE_FACTOR 0.5
+
+/* How much thumbnails can be enlarged to stand in for renders of the
+ * page, at very low zoom levels */
+#define THUMBNAIL_MAX_UPSCALE 1.25
+/* Milliseconds without scrolling or zooming before drafts are refined */
+#define REFINE_TIMEOUT 150
+
+#define TILE_KEY(x, y) GUINT_TO_POINTER (((guint)(y) << 16) | (guint)(x))
+#define TILE_KEY_X(key) (GPOINTER_TO_UINT (key) & 0xffff)
+#define TILE_KEY_Y(key) (GPOINTER_TO_UINT (key) >> 16)
 
 G_DEFINE_TYPE (EvPixbufCache, ev_pixbuf_cache, G_TYPE_OBJECT)
 
@@ -112,6 +279,8 @@ ev_pixbuf_cache_init (EvPixbufCache *pixbuf_cache)
 {
 	pixbuf_cache->start_page = -1;
 	pixbuf_cache->end_page = -1;
+	pixbuf_cache->archive = ev_page_archive_new (ARCHIVE_MAX_SIZE);
+	g_queue_init (&pixbuf_cache->prefetch_pages);
 }
 
 static void
@@ -130,8 +299,9 @@ ev_pixbuf_cache_class_init (EvPixbufCacheClass *class)
 			      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
 			      G_STRUCT_OFFSET (EvPixbufCacheClass, job_finished),
 			      NULL, NULL,
-			      g_cclosure_marshal_VOID__POINTER,
-			      G_TYPE_NONE, 1,
+			      ev_view_marshal_VOID__INT_POINTER,
+			      G_TYPE_NONE, 2,
+			      G_TYPE_INT,
 			      G_TYPE_POINTER);
 }
 
@@ -159,6 +329,8 @@ ev_pixbuf_cache_finalize (GObject *object)
 	}
 
 	g_object_unref (pixbuf_cache->model);
+	g_object_unref (pixbuf_cache->archive);
+	g_clear_object (&pixbuf_cache->render_pack);
 
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->finalize (object);
 }
@@ -175,6 +347,162 @@ end_job (CacheJobInfo *job_info,
 	job_info->job = NULL;
 }
 
+static void
+end_preview_job (CacheJobInfo *job_info,
+		 gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->preview_job,
+					      G_CALLBACK (preview_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->preview_job);
+	g_object_unref (job_info->preview_job);
+	job_info->preview_job = NULL;
+}
+
+static void
+end_annotations_job (CacheJobInfo *job_info,
+		     gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->annotations_job,
+					      G_CALLBACK (annotations_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->annotations_job);
+	g_object_unref (job_info->annotations_job);
+	job_info->annotations_job = NULL;
+}
+
+static void
+end_area_job (CacheJobInfo *job_info,
+	      gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->area_job,
+					      G_CALLBACK (area_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->area_job);
+	g_object_unref (job_info->area_job);
+	job_info->area_job = NULL;
+}
+
+/* The annotations go with the surface they were rendered for */
+static void
+clear_annotations (CacheJobInfo *job_info,
+		   gpointer      data)
+{
+	if (job_info->annotations_job)
+		end_annotations_job (job_info, data);
+	g_clear_pointer (&job_info->annotations, cairo_surface_destroy);
+}
+
+static void
+end_selection_job (CacheJobInfo *job_info,
+		   gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->selection_job,
+					      G_CALLBACK (selection_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->selection_job);
+	g_object_unref (job_info->selection_job);
+	job_info->selection_job = NULL;
+}
+
+static void
+end_selection_region_job (CacheJobInfo *job_info,
+			  gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->selection_region_job,
+					      G_CALLBACK (selection_region_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->selection_region_job);
+	g_object_unref (job_info->selection_region_job);
+	job_info->selection_region_job = NULL;
+}
+
+static void
+end_selection_jobs (CacheJobInfo *job_info,
+		    gpointer      data)
+{
+	if (job_info->selection_job)
+		end_selection_job (job_info, data);
+	if (job_info->selection_region_job)
+		end_selection_region_job (job_info, data);
+}
+
+static void
+end_tile_job (CacheTile *tile,
+	      gpointer   data)
+{
+	g_signal_handlers_disconnect_by_func (tile->job,
+					      G_CALLBACK (tile_job_finished_cb),
+					      data);
+	ev_job_cancel (tile->job);
+	g_object_unref (tile->job);
+	tile->job = NULL;
+}
+
+/* Hands a rendered surface back to the backends once we hold its only
+ * reference, so that the next render of the same size reuses it.
+ */
+static void
+recycle_surface (cairo_surface_t *surface)
+{
+	if (cairo_surface_get_reference_count (surface) == 1)
+		ev_surface_budget_remove (surface);
+	ev_surface_pool_recycle (surface);
+}
+
+/* Moves the surface of a page leaving the cache to the archive, when
+ * it's the final render of the whole page and nobody else uses it.
+ */
+static void
+archive_surface (EvPixbufCache *pixbuf_cache,
+		 CacheJobInfo  *job_info,
+		 gint           page)
+{
+	cairo_surface_t *surface = job_info->surface;
+
+	if (!surface || job_info->annotations || !job_info->page_ready || job_info->draft ||
+	    job_info->from_thumbnail || job_info->tiles ||
+	    cairo_surface_get_reference_count (surface) != 1)
+		return;
+
+	ev_surface_budget_remove (surface);
+	job_info->surface = NULL;
+	ev_page_archive_store (pixbuf_cache->archive, page,
+			       ev_document_model_get_rotation (pixbuf_cache->model),
+			       job_info->device_scale, surface);
+}
+
+static void
+dispose_cache_tile (CacheTile *tile,
+		    gpointer   data)
+{
+	if (tile->job)
+		end_tile_job (tile, data);
+
+	if (tile->surface)
+		recycle_surface (tile->surface);
+
+	g_slice_free (CacheTile, tile);
+}
+
+static void
+dispose_tiles (CacheJobInfo *job_info,
+	       gpointer      data)
+{
+	GHashTableIter iter;
+	gpointer       value;
+
+	if (job_info->tiles == NULL)
+		return;
+
+	g_hash_table_iter_init (&iter, job_info->tiles);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		dispose_cache_tile ((CacheTile *)value, data);
+
+	g_hash_table_destroy (job_info->tiles);
+	job_info->tiles = NULL;
+}
+
 static void
 dispose_cache_job_info (CacheJobInfo *job_info,
 			gpointer      data)
@@ -185,10 +513,27 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 	if (job_info->job)
 		end_job (job_info, data);
 
+	if (job_info->preview_job)
+		end_preview_job (job_info, data);
+
+	if (job_info->area_job)
+		end_area_job (job_info, data);
+
+	end_selection_jobs (job_info, data);
+	dispose_tiles (job_info, data);
+	clear_annotations (job_info, data);
+
+	if (job_info->restore_cancellable) {
+		g_cancellable_cancel (job_info->restore_cancellable);
+		g_clear_object (&job_info->restore_cancellable);
+	}
+
 	if (job_info->surface) {
-		cairo_surface_destroy (job_info->surface);
+		recycle_surface (job_info->surface);
 		job_info->surface = NULL;
 	}
+	job_info->draft = FALSE;
+	job_info->from_thumbnail = FALSE;
 	if (job_info->region) {
 		cairo_region_destroy (job_info->region);
 		job_info->region = NULL;
@@ -205,6 +550,21 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 	job_info->points_set = FALSE;
 }
 
+static void
+ev_pixbuf_cache_cancel_prefetch (EvPixbufCache *pixbuf_cache)
+{
+	g_queue_clear (&pixbuf_cache->prefetch_pages);
+
+	if (!pixbuf_cache->prefetch_job)
+		return;
+
+	g_signal_handlers_disconnect_by_func (pixbuf_cache->prefetch_job,
+					      G_CALLBACK (prefetch_job_finished_cb),
+					      pixbuf_cache);
+	ev_job_cancel (pixbuf_cache->prefetch_job);
+	g_clear_object (&pixbuf_cache->prefetch_job);
+}
+
 static void
 ev_pixbuf_cache_dispose (GObject *object)
 {
@@ -213,6 +573,16 @@ ev_pixbuf_cache_dispose (GObject *object)
 
 	pixbuf_cache = EV_PIXBUF_CACHE (object);
 
+	ev_surface_budget_remove_by_data (pixbuf_cache);
+	g_signal_handlers_disconnect_by_data (ev_memory_monitor_get_default (), pixbuf_cache);
+	ev_memory_stats_unregister ("pixbuf-cache", pixbuf_cache);
+	ev_memory_stats_unregister ("selection-surfaces", pixbuf_cache);
+
+	if (pixbuf_cache->refine_id) {
+		g_source_remove (pixbuf_cache->refine_id);
+		pixbuf_cache->refine_id = 0;
+	}
+
 	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
 		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
 		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
@@ -222,10 +592,176 @@ ev_pixbuf_cache_dispose (GObject *object)
 		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
 	}
 
+	g_clear_pointer (&pixbuf_cache->seed_preview, cairo_surface_destroy);
+
+	ev_pixbuf_cache_cancel_prefetch (pixbuf_cache);
+	ev_page_archive_clear (pixbuf_cache->archive);
+
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->dispose (object);
 }
 
 
+/* Drops the pages preloaded around the visible ones, with their
+ * selection surfaces. They are preloaded again by the next range
+ * update, if the preload size allows it.
+ */
+static void
+ev_pixbuf_cache_drop_preloaded (EvPixbufCache *pixbuf_cache)
+{
+	int i;
+
+	if (!pixbuf_cache->job_list)
+		return;
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
+		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
+	}
+}
+
+static void
+memory_pressure_changed_cb (EvMemoryMonitor *monitor,
+			    EvPixbufCache   *pixbuf_cache)
+{
+	pixbuf_cache->under_pressure =
+		ev_memory_monitor_get_pressure (monitor) >= EV_MEMORY_PRESSURE_MEDIUM;
+	if (pixbuf_cache->under_pressure) {
+		ev_pixbuf_cache_drop_preloaded (pixbuf_cache);
+		ev_pixbuf_cache_cancel_prefetch (pixbuf_cache);
+		ev_page_archive_clear (pixbuf_cache->archive);
+	}
+}
+
+static void
+document_modified_cb (EvDocument    *document,
+		      GParamSpec    *pspec,
+		      EvPixbufCache *pixbuf_cache)
+{
+	if (!ev_document_get_modified (document))
+		return;
+
+	/* Saving doesn't make the pack match again, it was made
+	 * for the version of the file that was opened */
+	g_clear_object (&pixbuf_cache->render_pack);
+	pixbuf_cache->render_pack_disabled = TRUE;
+}
+
+/* The pages of encrypted documents are not written to disk */
+static gboolean
+document_is_secure (EvDocument *document)
+{
+	return EV_IS_DOCUMENT_SECURITY (document) &&
+		ev_document_security_has_document_security (EV_DOCUMENT_SECURITY (document));
+}
+
+static EvRenderPack *
+get_render_pack (EvPixbufCache *pixbuf_cache)
+{
+	if (pixbuf_cache->render_pack_size == 0 || pixbuf_cache->render_pack_disabled)
+		return NULL;
+
+	if (!pixbuf_cache->render_pack) {
+		if (!ev_document_get_modified (pixbuf_cache->document) &&
+		    !document_is_secure (pixbuf_cache->document))
+			pixbuf_cache->render_pack = ev_render_pack_new (pixbuf_cache->document,
+									pixbuf_cache->render_pack_size);
+		/* Not tried again for every page */
+		if (!pixbuf_cache->render_pack)
+			pixbuf_cache->render_pack_disabled = TRUE;
+	}
+
+	return pixbuf_cache->render_pack;
+}
+
+static guint64
+image_surface_size (cairo_surface_t *surface)
+{
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return 0;
+
+	return (guint64) cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+}
+
+static void
+add_job_info_memory_stats (CacheJobInfo *job_info,
+			   gboolean      selections,
+			   guint64      *bytes,
+			   guint        *n_entries)
+{
+	GHashTableIter iter;
+	gpointer       value;
+
+	if (selections) {
+		if (job_info->selection) {
+			*bytes += image_surface_size (job_info->selection);
+			*n_entries += 1;
+		}
+		return;
+	}
+
+	if (job_info->surface) {
+		*bytes += image_surface_size (job_info->surface);
+		*n_entries += 1;
+	}
+
+	if (job_info->annotations) {
+		*bytes += image_surface_size (job_info->annotations);
+		*n_entries += 1;
+	}
+
+	if (!job_info->tiles)
+		return;
+
+	g_hash_table_iter_init (&iter, job_info->tiles);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		CacheTile *tile = (CacheTile *) value;
+
+		if (tile->surface) {
+			*bytes += image_surface_size (tile->surface);
+			*n_entries += 1;
+		}
+	}
+}
+
+static void
+get_memory_stats (EvPixbufCache *pixbuf_cache,
+		  gboolean       selections,
+		  guint64       *bytes,
+		  guint         *n_entries)
+{
+	int i;
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		add_job_info_memory_stats (pixbuf_cache->prev_job + i, selections, bytes, n_entries);
+		add_job_info_memory_stats (pixbuf_cache->next_job + i, selections, bytes, n_entries);
+	}
+
+	if (!pixbuf_cache->job_list)
+		return;
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++)
+		add_job_info_memory_stats (pixbuf_cache->job_list + i, selections, bytes, n_entries);
+}
+
+/* The cache is only used from the main thread, where the statistics
+ * are asked for by the viewer */
+static void
+get_surfaces_memory_stats (gpointer  user_data,
+			   guint64  *bytes,
+			   guint    *n_entries)
+{
+	get_memory_stats (EV_PIXBUF_CACHE (user_data), FALSE, bytes, n_entries);
+}
+
+static void
+get_selections_memory_stats (gpointer  user_data,
+			     guint64  *bytes,
+			     guint    *n_entries)
+{
+	get_memory_stats (EV_PIXBUF_CACHE (user_data), TRUE, bytes, n_entries);
+}
+
 EvPixbufCache *
 ev_pixbuf_cache_new (GtkWidget       *view,
 		     EvDocumentModel *model,
@@ -240,6 +776,18 @@ ev_pixbuf_cache_new (GtkWidget       *view,
 	pixbuf_cache->document = ev_document_model_get_document (model);
 	pixbuf_cache->max_size = max_size;
 
+	g_signal_connect_object (pixbuf_cache->document, "notify::modified",
+				 G_CALLBACK (document_modified_cb),
+				 pixbuf_cache, 0);
+
+	g_signal_connect (ev_memory_monitor_get_default (), "pressure-changed",
+			  G_CALLBACK (memory_pressure_changed_cb),
+			  pixbuf_cache);
+	memory_pressure_changed_cb (ev_memory_monitor_get_default (), pixbuf_cache);
+
+	ev_memory_stats_register ("pixbuf-cache", get_surfaces_memory_stats, pixbuf_cache);
+	ev_memory_stats_register ("selection-surfaces", get_selections_memory_stats, pixbuf_cache);
+
 	return pixbuf_cache;
 }
 
@@ -255,19 +803,62 @@ ev_pixbuf_cache_set_max_size (EvPixbufCache *pixbuf_cache,
 	pixbuf_cache->max_size = max_size;
 }
 
-static int
+/* Limits the size of the preloaded pages without changing max_size,
+ * which also bounds the zoom level. 0 removes the limit.
+ */
+void
+ev_pixbuf_cache_set_size_limit (EvPixbufCache *pixbuf_cache,
+				gsize          size_limit)
+{
+	if (pixbuf_cache->size_limit == size_limit)
+		return;
+
+	if (size_limit != 0 &&
+	    (pixbuf_cache->size_limit == 0 || size_limit < pixbuf_cache->size_limit))
+		ev_pixbuf_cache_drop_preloaded (pixbuf_cache);
+	pixbuf_cache->size_limit = size_limit;
+}
+
+static gdouble
 get_device_scale (EvPixbufCache *pixbuf_cache)
 {
 #ifdef HAVE_HIDPI_SUPPORT
-        return gtk_widget_get_scale_factor (pixbuf_cache->view);
+	if (pixbuf_cache->device_scale <= 0)
+		return gtk_widget_get_scale_factor (pixbuf_cache->view);
+
+	/* Rounded so that tiles are a whole number of device pixels */
+	return MAX (1, round (pixbuf_cache->device_scale * EV_PIXBUF_CACHE_TILE_SIZE)) /
+		EV_PIXBUF_CACHE_TILE_SIZE;
 #else
         return 1;
 #endif
 }
 
+/* Size in device pixels of @size pixels of the view, rounded up
+ * so that surfaces cover the whole page with fractional scales */
+static gint
+get_device_size (gint    size,
+		 gdouble device_scale)
+{
+	return (gint) ceil (size * device_scale);
+}
+
+/* Device pixels per pixel of the view of renders. The device scale
+ * of the surfaces tells the view the size of drafts */
+static gdouble
+get_render_scale (gdouble  device_scale,
+		  gboolean draft)
+{
+#ifdef HAVE_HIDPI_SUPPORT
+	if (draft)
+		return device_scale * DRAFT_SCALE_FACTOR;
+#endif
+	return device_scale;
+}
+
 static void
 set_device_scale_on_surface (cairo_surface_t *surface,
-                             int              device_scale)
+                             gdouble          device_scale)
 {
 #ifdef HAVE_HIDPI_SUPPORT
         cairo_surface_set_device_scale (surface, device_scale, device_scale);
@@ -276,18 +867,98 @@ set_device_scale_on_surface (cairo_surface_t *surface,
 #endif
 }
 
+/* The view redraws only the damaged part of @page, the whole
+ * page when @region is %NULL.
+ */
+static void
+flush_job_finished (EvPixbufCache *pixbuf_cache)
+{
+	GHashTable     *pending = pixbuf_cache->pending_damage;
+	GHashTableIter  iter;
+	gpointer        key, value;
+
+	pixbuf_cache->pending_damage = NULL;
+
+	if (g_hash_table_contains (pending, GINT_TO_POINTER (-1))) {
+		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, -1, NULL);
+	} else {
+		g_hash_table_iter_init (&iter, pending);
+		while (g_hash_table_iter_next (&iter, &key, &value))
+			g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0,
+				       GPOINTER_TO_INT (key), value);
+	}
+
+	g_hash_table_destroy (pending);
+	g_object_unref (pixbuf_cache);
+}
+
+/* The damage of all the jobs delivered in the same batch is merged,
+ * so that the view is told about every page only once.
+ */
+static void
+emit_job_finished (EvPixbufCache  *pixbuf_cache,
+		   gint            page,
+		   cairo_region_t *region)
+{
+	gpointer key = GINT_TO_POINTER (page);
+	gpointer value;
+
+	if (!pixbuf_cache->pending_damage) {
+		pixbuf_cache->pending_damage =
+			g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+					       (GDestroyNotify) cairo_region_destroy);
+		g_hash_table_insert (pixbuf_cache->pending_damage, key,
+				     region ? cairo_region_copy (region) : NULL);
+		_ev_job_notify_after_batch ((GFunc) flush_job_finished,
+					    g_object_ref (pixbuf_cache));
+		return;
+	}
+
+	if (!g_hash_table_lookup_extended (pixbuf_cache->pending_damage, key, NULL, &value)) {
+		g_hash_table_insert (pixbuf_cache->pending_damage, key,
+				     region ? cairo_region_copy (region) : NULL);
+	} else if (value && region) {
+		cairo_region_union ((cairo_region_t *) value, region);
+	} else if (value) {
+		g_hash_table_insert (pixbuf_cache->pending_damage, key, NULL);
+	}
+}
+
+static cairo_region_t *
+get_tile_region (EvJobRender  *job_render,
+		 CacheJobInfo *job_info)
+{
+	cairo_rectangle_int_t rect;
+	gdouble               device_scale = job_info->device_scale;
+
+	rect.x = floor (job_render->area.x / device_scale);
+	rect.y = floor (job_render->area.y / device_scale);
+	rect.width = ceil ((job_render->area.x + job_render->area.width) / device_scale) - rect.x;
+	rect.height = ceil ((job_render->area.y + job_render->area.height) / device_scale) - rect.y;
+
+	return cairo_region_create_rectangle (&rect);
+}
+
 static void
 copy_job_to_job_info (EvJobRender   *job_render,
 		      CacheJobInfo  *job_info,
 		      EvPixbufCache *pixbuf_cache)
 {
 	if (job_info->surface) {
-		cairo_surface_destroy (job_info->surface);
+		recycle_surface (job_info->surface);
 	}
 	job_info->surface = cairo_surface_reference (job_render->surface);
-	set_device_scale_on_surface (job_info->surface, job_info->device_scale);
-	if (pixbuf_cache->inverted_colors) {
-		ev_document_misc_invert_surface (job_info->surface);
+	job_info->draft = job_render->draft;
+	job_info->from_thumbnail = FALSE;
+	set_device_scale_on_surface (job_info->surface,
+				     get_render_scale (job_info->device_scale, job_info->draft));
+	ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+
+	clear_annotations (job_info, pixbuf_cache);
+	if (job_render->annotations) {
+		job_info->annotations = cairo_surface_reference (job_render->annotations);
+		set_device_scale_on_surface (job_info->annotations,
+					     get_render_scale (job_info->device_scale, job_info->draft));
 	}
 
 	job_info->points_set = FALSE;
@@ -318,9 +989,75 @@ copy_job_to_job_info (EvJobRender   *job_render,
 	if (job_info->job)
 		end_job (job_info, pixbuf_cache);
 
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
+
 	job_info->page_ready = TRUE;
 }
 
+static void
+area_job_finished_cb (EvJob         *job,
+		      EvPixbufCache *pixbuf_cache)
+{
+	EvJobRender    *job_render = EV_JOB_RENDER (job);
+	CacheJobInfo   *job_info;
+	cairo_region_t *region;
+	cairo_t        *cr;
+	gdouble         sx, sy;
+
+	job_info = find_job_cache (pixbuf_cache, job_render->page);
+	if (job_info == NULL || job_info->area_job != job)
+		return;
+
+	/* The surface may have been replaced by a render of another size */
+	if (ev_job_is_failed (job) || !job_info->surface ||
+	    cairo_image_surface_get_width (job_info->surface) != job_render->target_width ||
+	    cairo_image_surface_get_height (job_info->surface) != job_render->target_height) {
+		end_area_job (job_info, pixbuf_cache);
+		return;
+	}
+
+	cr = cairo_create (job_info->surface);
+	cairo_surface_get_device_scale (job_info->surface, &sx, &sy);
+	cairo_scale (cr, 1. / sx, 1. / sy);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface (cr, job_render->surface,
+				  job_render->area.x, job_render->area.y);
+	cairo_rectangle (cr, job_render->area.x, job_render->area.y,
+			 job_render->area.width, job_render->area.height);
+	cairo_fill (cr);
+	cairo_destroy (cr);
+
+	region = get_tile_region (job_render, job_info);
+	end_area_job (job_info, pixbuf_cache);
+	emit_job_finished (pixbuf_cache, job_render->page, region);
+	cairo_region_destroy (region);
+}
+
+/* Saves the pages that were slow to render in the render pack. Like
+ * in the archive, only the ones without a separate annotations layer
+ * are kept. */
+static void
+save_slow_render (EvPixbufCache *pixbuf_cache,
+		  EvJobRender   *job_render,
+		  gdouble        device_scale)
+{
+	EvRenderPack *pack;
+
+	if (job_render->draft || job_render->annotations || !job_render->surface ||
+	    job_render->render_time < RENDER_PACK_MIN_TIME)
+		return;
+
+	pack = get_render_pack (pixbuf_cache);
+	if (!pack)
+		return;
+
+	ev_debug_message (DEBUG_JOBS, "page %d: rendered in %" G_GINT64_FORMAT " ms, saving it",
+			  job_render->page, job_render->render_time / 1000);
+	ev_render_pack_store (pack, job_render->page, job_render->rotation,
+			      device_scale, job_render->layer, job_render->surface);
+}
+
 static void
 job_finished_cb (EvJob         *job,
 		 EvPixbufCache *pixbuf_cache)
@@ -343,20 +1080,106 @@ job_finished_cb (EvJob         *job,
 		return;
 	}
 
+	save_slow_render (pixbuf_cache, job_render, job_info->device_scale);
 	copy_job_to_job_info (job_render, job_info, pixbuf_cache);
-	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+	emit_job_finished (pixbuf_cache, job_render->page, job_info->region);
 }
 
-/* This checks a job to see if the job would generate the right sized pixbuf
- * given a scale.  If it won't, it removes the job and clears it to NULL.
- */
+static void
+preview_job_finished_cb (EvJob         *job,
+			 EvPixbufCache *pixbuf_cache)
+{
+	EvJobRender  *job_render = EV_JOB_RENDER (job);
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, job_render->page);
+	if (job_info == NULL || job_info->preview_job != job)
+		return;
+
+	/* Never replace a surface that is already on screen */
+	if (ev_job_is_failed (job) || job_info->surface) {
+		end_preview_job (job_info, pixbuf_cache);
+		return;
+	}
+
+	job_info->surface = cairo_surface_reference (job_render->surface);
+	set_device_scale_on_surface (job_info->surface, job_info->device_scale);
+	ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+
+	end_preview_job (job_info, pixbuf_cache);
+	emit_job_finished (pixbuf_cache, job_render->page, NULL);
+}
+
+static CacheTile *
+find_tile_for_job (CacheJobInfo *job_info,
+		   EvJobRender  *job_render)
+{
+	CacheTile *tile;
+	gint       tile_size;
+
+	if (job_info == NULL || job_info->tiles == NULL)
+		return NULL;
+
+	tile_size = get_device_size (EV_PIXBUF_CACHE_TILE_SIZE, job_info->device_scale);
+	tile = g_hash_table_lookup (job_info->tiles,
+				    TILE_KEY (job_render->area.x / tile_size,
+					      job_render->area.y / tile_size));
+
+	return tile && tile->job == EV_JOB (job_render) ? tile : NULL;
+}
+
+static void
+copy_job_to_tile (EvJobRender   *job_render,
+		  CacheJobInfo  *job_info,
+		  CacheTile     *tile,
+		  EvPixbufCache *pixbuf_cache)
+{
+	if (tile->surface)
+		recycle_surface (tile->surface);
+	tile->surface = cairo_surface_reference (job_render->surface);
+	tile->draft = job_render->draft;
+	set_device_scale_on_surface (tile->surface, job_info->device_scale);
+	ev_surface_budget_add (tile->surface, evict_surface_cb, pixbuf_cache);
+
+	end_tile_job (tile, pixbuf_cache);
+}
+
+static void
+tile_job_finished_cb (EvJob         *job,
+		      EvPixbufCache *pixbuf_cache)
+{
+	EvJobRender    *job_render = EV_JOB_RENDER (job);
+	CacheJobInfo   *job_info;
+	CacheTile      *tile;
+	cairo_region_t *region;
+	gint            page = job_render->page;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	tile = find_tile_for_job (job_info, job_render);
+	if (tile == NULL)
+		return;
+
+	if (ev_job_is_failed (job)) {
+		end_tile_job (tile, pixbuf_cache);
+		return;
+	}
+
+	region = get_tile_region (job_render, job_info);
+	copy_job_to_tile (job_render, job_info, tile, pixbuf_cache);
+	emit_job_finished (pixbuf_cache, page, region);
+	cairo_region_destroy (region);
+}
+
+/* This checks a job to see if the job would generate the right sized pixbuf
+ * given a scale.  If it won't, it removes the job and clears it to NULL.
+ */
 static void
 check_job_size_and_unref (EvPixbufCache *pixbuf_cache,
 			  CacheJobInfo  *job_info,
 			  gfloat         scale)
 {
 	gint width, height;
-	gint device_scale;
+	gdouble device_scale;
 
 	g_assert (job_info);
 
@@ -365,13 +1188,16 @@ check_job_size_and_unref (EvPixbufCache *pixbuf_cache,
 
         device_scale = get_device_scale (pixbuf_cache);
 	if (job_info->device_scale == device_scale) {
+		EvJobRender *job_render = EV_JOB_RENDER (job_info->job);
+		gdouble      render_scale = get_render_scale (device_scale, job_render->draft);
+
 		_get_page_size_for_scale_and_rotation (job_info->job->document,
-						       EV_JOB_RENDER (job_info->job)->page,
+						       job_render->page,
 						       scale,
-						       EV_JOB_RENDER (job_info->job)->rotation,
+						       job_render->rotation,
 						       &width, &height);
-		if (width * device_scale == EV_JOB_RENDER (job_info->job)->target_width &&
-		    height * device_scale == EV_JOB_RENDER (job_info->job)->target_height)
+		if (get_device_size (width, render_scale) == job_render->target_width &&
+		    get_device_size (height, render_scale) == job_render->target_height)
 			return;
 	}
 
@@ -399,6 +1225,7 @@ move_one_job (CacheJobInfo  *job_info,
 
 	if (page < (start_page - new_preload_cache_size) ||
 	    page > (end_page + new_preload_cache_size)) {
+		archive_surface (pixbuf_cache, job_info, page);
 		dispose_cache_job_info (job_info, pixbuf_cache);
 		return;
 	}
@@ -428,14 +1255,41 @@ move_one_job (CacheJobInfo  *job_info,
 
 	*target_page = *job_info;
 	job_info->job = NULL;
+	job_info->preview_job = NULL;
+	job_info->selection_job = NULL;
+	job_info->selection_region_job = NULL;
 	job_info->region = NULL;
 	job_info->surface = NULL;
+	job_info->annotations = NULL;
+	job_info->annotations_job = NULL;
+	job_info->tiles = NULL;
+	job_info->restore_cancellable = NULL;
 
 	if (new_priority != priority && target_page->job) {
 		ev_job_scheduler_update_job (target_page->job, new_priority);
 	}
 }
 
+static gboolean
+page_needs_tiles (EvPixbufCache *pixbuf_cache,
+		  gint           page,
+		  gdouble        scale,
+		  gint           rotation)
+{
+	gint width, height;
+	gdouble device_scale;
+
+	if (!ev_document_can_render_area (pixbuf_cache->document))
+		return FALSE;
+
+	device_scale = get_device_scale (pixbuf_cache);
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale, rotation,
+					       &width, &height);
+
+	return (gdouble) width * height * device_scale * device_scale > MAX_UNTILED_PAGE_PIXELS;
+}
+
 static gsize
 ev_pixbuf_cache_get_page_size (EvPixbufCache *pixbuf_cache,
 			       gint           page_index,
@@ -444,6 +1298,10 @@ ev_pixbuf_cache_get_page_size (EvPixbufCache *pixbuf_cache,
 {
 	gint width, height;
 
+	/* Tiled pages only keep the tiles around the visible area */
+	if (page_needs_tiles (pixbuf_cache, page_index, scale, rotation))
+		return MAX_UNTILED_PAGE_PIXELS * 4;
+
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page_index, scale, rotation,
 					       &width, &height);
@@ -459,27 +1317,40 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 {
 	gsize range_size = 0;
 	gint  new_preload_cache_size = 0;
+	gsize max_size = pixbuf_cache->max_size;
+	gint  max_preload;
 	gint  i;
 	guint n_pages = ev_document_get_n_pages (pixbuf_cache->document);
 
+	if (pixbuf_cache->under_pressure)
+		return 0;
+	if (pixbuf_cache->size_limit)
+		max_size = MIN (max_size, pixbuf_cache->size_limit);
+
+	if (ev_power_monitor_get_power_saving (ev_power_monitor_get_default ()))
+		max_preload = MIN_PRELOADED_PAGES;
+	else
+		max_preload = CLAMP ((gint) ceil (pixbuf_cache->scroll_velocity * PRELOAD_TIME),
+				     MIN_PRELOADED_PAGES, MAX_PRELOADED_PAGES);
+
 	/* Get the size of the current range */
 	for (i = start_page; i <= end_page; i++) {
 		range_size += ev_pixbuf_cache_get_page_size (pixbuf_cache, i, scale, rotation);
 	}
 
-	if (range_size >= pixbuf_cache->max_size)
+	if (range_size >= max_size)
 		return new_preload_cache_size;
 
 	i = 1;
 	while (((start_page - i > 0) || (end_page + i < n_pages)) &&
-	       new_preload_cache_size < MAX_PRELOADED_PAGES) {
+	       new_preload_cache_size < max_preload) {
 		gsize    page_size;
 		gboolean updated = FALSE;
 
 		if (end_page + i < n_pages) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, end_page + i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size + range_size <= max_size) {
 				range_size += page_size;
 				new_preload_cache_size++;
 				updated = TRUE;
@@ -491,7 +1362,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		if (start_page - i > 0) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, start_page - i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size + range_size <= max_size) {
 				range_size += page_size;
 				if (!updated)
 					new_preload_cache_size++;
@@ -667,6 +1538,68 @@ get_selection_colors (EvView *view, GdkColor *text, GdkColor *base)
         base->blue = CLAMP ((guint) (bg.blue * 65535), 0, 65535);
 }
 
+/* Schedules a cheap low resolution render of the page, so that there is
+ * something on screen while the page is rendered at full resolution.
+ * Previews are never bigger than an untiled page.
+ */
+static void
+add_preview_job (EvPixbufCache *pixbuf_cache,
+		 CacheJobInfo  *job_info,
+		 gint           width,
+		 gint           height,
+		 gint           page,
+		 gint           rotation,
+		 gfloat         scale)
+{
+	gdouble factor = PREVIEW_SCALE_FACTOR;
+	gdouble pixels;
+
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
+
+	if (pixbuf_cache->seed_preview &&
+	    pixbuf_cache->seed_page == page && pixbuf_cache->seed_rotation == rotation) {
+		job_info->surface = pixbuf_cache->seed_preview;
+		pixbuf_cache->seed_preview = NULL;
+		set_device_scale_on_surface (job_info->surface, job_info->device_scale);
+		ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+		return;
+	}
+
+	pixels = (gdouble) width * height * job_info->device_scale * job_info->device_scale;
+	factor = MIN (factor, sqrt (MAX_UNTILED_PAGE_PIXELS / pixels));
+
+	job_info->preview_job = ev_job_render_new (pixbuf_cache->document,
+						   page, rotation,
+						   scale * job_info->device_scale * factor,
+						   MAX (1, (gint) (width * job_info->device_scale * factor + 0.5)),
+						   MAX (1, (gint) (height * job_info->device_scale * factor + 0.5)));
+	ev_job_render_set_draft (EV_JOB_RENDER (job_info->preview_job), TRUE);
+
+	g_signal_connect (job_info->preview_job, "finished",
+			  G_CALLBACK (preview_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job_for_client (job_info->preview_job, EV_JOB_PRIORITY_URGENT,
+					      pixbuf_cache->view);
+}
+
+/* Whether pages are rendered without their annotations, drawn over
+ * them from a separate surface, so that annotation changes only need
+ * the annotations rendered again */
+static gboolean
+renders_layers (EvPixbufCache *pixbuf_cache)
+{
+	return EV_IS_DOCUMENT_ANNOTATIONS (pixbuf_cache->document) &&
+		ev_document_can_render_layers (pixbuf_cache->document);
+}
+
+/* The layer of the pages rendered by add_job() */
+static EvRenderLayer
+get_render_layer (EvPixbufCache *pixbuf_cache)
+{
+	return renders_layers (pixbuf_cache) ? EV_RENDER_LAYER_CONTENT : EV_RENDER_LAYER_ALL;
+}
+
 static void
 add_job (EvPixbufCache  *pixbuf_cache,
 	 CacheJobInfo   *job_info,
@@ -678,6 +1611,9 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	 gfloat          scale,
 	 EvJobPriority   priority)
 {
+	gboolean draft = pixbuf_cache->in_motion;
+	gdouble  render_scale;
+
 	job_info->device_scale = get_device_scale (pixbuf_cache);
 	job_info->page_ready = FALSE;
 
@@ -688,13 +1624,22 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	if (job_info->job)
 		end_job (job_info, pixbuf_cache);
 
+	render_scale = get_render_scale (job_info->device_scale, draft);
 	job_info->job = ev_job_render_new (pixbuf_cache->document,
 					   page, rotation,
-                                           scale * job_info->device_scale,
-					   width * job_info->device_scale,
-                                           height * job_info->device_scale);
-
-	if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
+                                           scale * render_scale,
+					   get_device_size (width, render_scale),
+                                           get_device_size (height, render_scale));
+	ev_job_render_set_draft (EV_JOB_RENDER (job_info->job), draft);
+	/* Drafts leave the annotations out anyway */
+	if (!draft && renders_layers (pixbuf_cache))
+		ev_job_render_set_layer (EV_JOB_RENDER (job_info->job), EV_RENDER_LAYER_CONTENT);
+	/* Monochrome pages are kept as masks, drawn by the view */
+	ev_job_render_set_mask_monochrome (EV_JOB_RENDER (job_info->job), TRUE);
+
+	/* Selections are rendered again for the refined page */
+	if (!draft && !pixbuf_cache->selection_region_only &&
+	    new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
 		GdkColor text, base;
 
 		get_selection_colors (EV_VIEW (pixbuf_cache->view), &text, &base);
@@ -707,7 +1652,376 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	g_signal_connect (job_info->job, "finished",
 			  G_CALLBACK (job_finished_cb),
 			  pixbuf_cache);
-	ev_job_scheduler_push_job (job_info->job, priority);
+
+	/* Visible pages with nothing to show get a preview first */
+	if (!job_info->surface && priority == EV_JOB_PRIORITY_URGENT)
+		add_preview_job (pixbuf_cache, job_info,
+				 width, height, page, rotation, scale);
+
+	if (G_UNLIKELY (!first_job_queued)) {
+		ev_open_timings_mark ("first-render-queued");
+		first_job_queued = TRUE;
+	}
+
+	ev_job_scheduler_push_job_for_client (job_info->job, priority, pixbuf_cache->view);
+}
+
+static void
+add_tile_job (EvPixbufCache *pixbuf_cache,
+	      CacheJobInfo  *job_info,
+	      CacheTile     *tile,
+	      gint           tile_x,
+	      gint           tile_y,
+	      gint           width,
+	      gint           height,
+	      gint           page,
+	      gint           rotation,
+	      gfloat         scale,
+	      EvJobPriority  priority)
+{
+	cairo_rectangle_int_t area;
+	gint                  tile_size;
+
+	if (tile->job)
+		end_tile_job (tile, pixbuf_cache);
+
+	tile_size = get_device_size (EV_PIXBUF_CACHE_TILE_SIZE, job_info->device_scale);
+	width = get_device_size (width, job_info->device_scale);
+	height = get_device_size (height, job_info->device_scale);
+	area.x = tile_x * tile_size;
+	area.y = tile_y * tile_size;
+	area.width = MIN (tile_size, width - area.x);
+	area.height = MIN (tile_size, height - area.y);
+
+	tile->job = ev_job_render_new (pixbuf_cache->document,
+				       page, rotation,
+				       scale * job_info->device_scale,
+				       width, height);
+	ev_job_render_set_area (EV_JOB_RENDER (tile->job), &area);
+	/* Tiles are drawn next to each other, so their drafts are only
+	 * rendered faster, at the same size */
+	ev_job_render_set_draft (EV_JOB_RENDER (tile->job), pixbuf_cache->in_motion);
+
+	g_signal_connect (tile->job, "finished",
+			  G_CALLBACK (tile_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job_for_client (tile->job, priority, pixbuf_cache->view);
+}
+
+static gboolean
+tile_intersects_area (gpointer      key,
+		      GdkRectangle *area)
+{
+	GdkRectangle tile_area, unused;
+
+	tile_area.x = TILE_KEY_X (key) * EV_PIXBUF_CACHE_TILE_SIZE;
+	tile_area.y = TILE_KEY_Y (key) * EV_PIXBUF_CACHE_TILE_SIZE;
+	tile_area.width = EV_PIXBUF_CACHE_TILE_SIZE;
+	tile_area.height = EV_PIXBUF_CACHE_TILE_SIZE;
+
+	return gdk_rectangle_intersect (&tile_area, area, &unused);
+}
+
+/* Whether tile has, or will have, a surface good enough for now */
+static gboolean
+tile_is_rendered (EvPixbufCache *pixbuf_cache,
+		  CacheTile     *tile)
+{
+	if (tile->job)
+		return pixbuf_cache->in_motion || !EV_JOB_RENDER (tile->job)->draft;
+	if (tile->surface)
+		return pixbuf_cache->in_motion || !tile->draft;
+
+	return FALSE;
+}
+
+/* Schedules the tiles of page that are visible, or close to the
+ * visible area, and drops the ones that have been scrolled away.
+ * Tiles are only kept for a single scale and rotation.
+ */
+static void
+add_tile_jobs_if_needed (EvPixbufCache *pixbuf_cache,
+			 CacheJobInfo  *job_info,
+			 gint           page,
+			 gint           rotation,
+			 gfloat         scale,
+			 EvJobPriority  priority)
+{
+	gdouble        device_scale = get_device_scale (pixbuf_cache);
+	GdkRectangle   area, visible_area;
+	GHashTableIter iter;
+	gpointer       key, value;
+	gint           width, height;
+	gint           x, y;
+
+	if (job_info->tiles &&
+	    (job_info->tiles_scale != scale ||
+	     job_info->tiles_rotation != rotation ||
+	     job_info->device_scale != device_scale))
+		dispose_tiles (job_info, pixbuf_cache);
+
+	/* The whole page surface, rendered at a smaller scale or as a
+	 * preview, is kept to be drawn where tiles are still missing */
+	if (job_info->job)
+		end_job (job_info, pixbuf_cache);
+	job_info->page_ready = FALSE;
+
+	if (job_info->tiles == NULL) {
+		job_info->tiles = g_hash_table_new (NULL, NULL);
+		job_info->tiles_scale = scale;
+		job_info->tiles_rotation = rotation;
+		job_info->device_scale = device_scale;
+	}
+
+	if (!_ev_view_get_visible_page_area (EV_VIEW (pixbuf_cache->view), page,
+					     TILE_PRELOAD_MARGIN, &area))
+		area.width = area.height = 0;
+
+	g_hash_table_iter_init (&iter, job_info->tiles);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (!tile_intersects_area (key, &area)) {
+			dispose_cache_tile ((CacheTile *)value, pixbuf_cache);
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+
+	if (area.width <= 0 || area.height <= 0)
+		return;
+
+	if (!_ev_view_get_visible_page_area (EV_VIEW (pixbuf_cache->view), page,
+					     0, &visible_area))
+		visible_area.width = visible_area.height = 0;
+
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale, rotation,
+					       &width, &height);
+
+	if (!job_info->surface && !job_info->preview_job &&
+	    priority == EV_JOB_PRIORITY_URGENT)
+		add_preview_job (pixbuf_cache, job_info,
+				 width, height, page, rotation, scale);
+
+	for (y = area.y / EV_PIXBUF_CACHE_TILE_SIZE;
+	     y <= (area.y + area.height - 1) / EV_PIXBUF_CACHE_TILE_SIZE; y++) {
+		for (x = area.x / EV_PIXBUF_CACHE_TILE_SIZE;
+		     x <= (area.x + area.width - 1) / EV_PIXBUF_CACHE_TILE_SIZE; x++) {
+			CacheTile *tile;
+
+			tile = g_hash_table_lookup (job_info->tiles, TILE_KEY (x, y));
+			if (tile && tile_is_rendered (pixbuf_cache, tile))
+				continue;
+
+			if (tile == NULL) {
+				tile = g_slice_new0 (CacheTile);
+				g_hash_table_insert (job_info->tiles, TILE_KEY (x, y), tile);
+			}
+			add_tile_job (pixbuf_cache, job_info, tile, x, y,
+				      width, height, page, rotation, scale,
+				      tile_intersects_area (TILE_KEY (x, y), &visible_area) ?
+				      priority : EV_JOB_PRIORITY_LOW);
+		}
+	}
+}
+
+/* Whether a pending render no longer matches what is needed for its
+ * page. Jobs already running are left to finish, their result is
+ * still better than nothing until the new one arrives.
+ */
+static gboolean
+job_is_superseded (EvJob *job,
+		   gint   width,
+		   gint   height,
+		   gint   rotation)
+{
+	EvJobRender *job_render = EV_JOB_RENDER (job);
+
+	if (job_render->target_width == width &&
+	    job_render->target_height == height &&
+	    job_render->rotation == rotation)
+		return FALSE;
+
+	return !ev_job_scheduler_is_job_running (job);
+}
+
+typedef struct {
+	EvPixbufCache *pixbuf_cache;
+	GCancellable  *cancellable;
+	gint           page;
+} RestoreData;
+
+static void
+restore_data_free (RestoreData *data)
+{
+	g_object_unref (data->pixbuf_cache);
+	g_object_unref (data->cancellable);
+	g_slice_free (RestoreData, data);
+}
+
+static void
+restore_finished_cb (GObject      *source_object,
+		     GAsyncResult *result,
+		     gpointer      user_data)
+{
+	RestoreData     *data = (RestoreData *) user_data;
+	EvPixbufCache   *pixbuf_cache = data->pixbuf_cache;
+	CacheJobInfo    *job_info;
+	cairo_surface_t *surface;
+
+	if (EV_IS_PAGE_ARCHIVE (source_object))
+		surface = ev_page_archive_restore_finish (EV_PAGE_ARCHIVE (source_object), result, NULL);
+	else
+		surface = ev_render_pack_lookup_finish (EV_RENDER_PACK (source_object), result, NULL);
+
+	/* Cancelled when the page left the cache */
+	job_info = find_job_cache (pixbuf_cache, data->page);
+	if (!job_info || job_info->restore_cancellable != data->cancellable) {
+		if (surface)
+			ev_surface_pool_recycle (surface);
+		restore_data_free (data);
+		return;
+	}
+	g_clear_object (&job_info->restore_cancellable);
+
+	if (surface) {
+		ev_debug_message (DEBUG_JOBS, "page %d: restored from the %s", data->page,
+				  EV_IS_PAGE_ARCHIVE (source_object) ? "archive" : "render pack");
+
+		if (job_info->surface)
+			recycle_surface (job_info->surface);
+		clear_annotations (job_info, pixbuf_cache);
+		job_info->surface = surface;
+		job_info->draft = FALSE;
+		job_info->from_thumbnail = FALSE;
+		job_info->page_ready = TRUE;
+		set_device_scale_on_surface (job_info->surface,
+					     get_render_scale (job_info->device_scale, FALSE));
+		ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+
+		if (job_info->preview_job)
+			end_preview_job (job_info, pixbuf_cache);
+
+		emit_job_finished (pixbuf_cache, data->page, NULL);
+	}
+
+	/* Rendered if the restore failed, or the view changed meanwhile */
+	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache,
+					    ev_document_model_get_rotation (pixbuf_cache->model),
+					    ev_document_model_get_scale (pixbuf_cache->model));
+	restore_data_free (data);
+}
+
+/* At zoom levels close to the size of the thumbnails, the page is
+ * scaled from its thumbnail, when there's one, instead of rendered.
+ * Returns whether the thumbnail was used.
+ */
+static gboolean
+use_thumbnail (EvPixbufCache *pixbuf_cache,
+	       CacheJobInfo  *job_info,
+	       gint           page,
+	       gint           rotation,
+	       gint           width,
+	       gint           height)
+{
+	gdouble          device_scale = get_device_scale (pixbuf_cache);
+	cairo_surface_t *thumbnail;
+	cairo_surface_t *surface;
+	cairo_t         *cr;
+	gint             thumbnail_width, thumbnail_height;
+
+	width = get_device_size (width, device_scale);
+	height = get_device_size (height, device_scale);
+
+	thumbnail = _ev_view_get_page_thumbnail (EV_VIEW (pixbuf_cache->view), page, rotation);
+	if (!thumbnail)
+		return FALSE;
+
+	/* With the aspect ratio of the page in this rotation */
+	thumbnail_width = cairo_image_surface_get_width (thumbnail);
+	thumbnail_height = cairo_image_surface_get_height (thumbnail);
+	if (width > thumbnail_width * THUMBNAIL_MAX_UPSCALE ||
+	    height > thumbnail_height * THUMBNAIL_MAX_UPSCALE ||
+	    ABS ((gdouble) thumbnail_width / thumbnail_height - (gdouble) width / height) > 0.02) {
+		cairo_surface_destroy (thumbnail);
+		return FALSE;
+	}
+
+	/* Scaled to the size of a render */
+	surface = ev_surface_pool_create_surface (CAIRO_FORMAT_RGB24, width, height);
+	cr = cairo_create (surface);
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_paint (cr);
+	cairo_scale (cr,
+		     (gdouble) width / thumbnail_width,
+		     (gdouble) height / thumbnail_height);
+	cairo_set_source_surface (cr, thumbnail, 0, 0);
+	cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (thumbnail);
+
+	ev_debug_message (DEBUG_JOBS, "page %d: scaled from its thumbnail", page);
+
+	if (job_info->surface)
+		recycle_surface (job_info->surface);
+	clear_annotations (job_info, pixbuf_cache);
+	job_info->surface = surface;
+	job_info->draft = FALSE;
+	job_info->from_thumbnail = TRUE;
+	job_info->page_ready = TRUE;
+	job_info->device_scale = device_scale;
+	set_device_scale_on_surface (job_info->surface, device_scale);
+	ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
+
+	emit_job_finished (pixbuf_cache, page, NULL);
+
+	return TRUE;
+}
+
+/* Restores the page from the archive when it was compressed with
+ * the given size, or from the render pack when it was saved there,
+ * returns whether it's being restored.
+ */
+static gboolean
+restore_surface (EvPixbufCache *pixbuf_cache,
+		 CacheJobInfo  *job_info,
+		 gint           page,
+		 gint           rotation,
+		 gint           width,
+		 gint           height)
+{
+	gdouble       device_scale = get_device_scale (pixbuf_cache);
+	gdouble       render_scale = get_render_scale (device_scale, FALSE);
+	EvRenderPack *pack;
+	RestoreData  *data;
+
+	data = g_slice_new (RestoreData);
+	data->pixbuf_cache = g_object_ref (pixbuf_cache);
+	data->cancellable = g_cancellable_new ();
+	data->page = page;
+
+	width = get_device_size (width, render_scale);
+	height = get_device_size (height, render_scale);
+	pack = get_render_pack (pixbuf_cache);
+	if (!ev_page_archive_restore_async (pixbuf_cache->archive, page, rotation,
+					    width, height, device_scale,
+					    data->cancellable,
+					    restore_finished_cb, data) &&
+	    (!pack || !ev_render_pack_lookup_async (pack, page, rotation,
+						     width, height, device_scale,
+						     get_render_layer (pixbuf_cache),
+						     data->cancellable,
+						     restore_finished_cb, data))) {
+		restore_data_free (data);
+		return FALSE;
+	}
+
+	job_info->restore_cancellable = g_object_ref (data->cancellable);
+	job_info->device_scale = device_scale;
+
+	return TRUE;
 }
 
 static void
@@ -718,28 +2032,76 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		   gfloat         scale,
 		   EvJobPriority  priority)
 {
-	gint device_scale = get_device_scale (pixbuf_cache);
+	gdouble device_scale = get_device_scale (pixbuf_cache);
+	gdouble render_scale;
 	gint width, height;
 
-	if (job_info->job)
+	if (page_needs_tiles (pixbuf_cache, page, scale, rotation)) {
+		add_tile_jobs_if_needed (pixbuf_cache, job_info,
+					 page, rotation, scale,
+					 priority);
 		return;
+	}
+
+	dispose_tiles (job_info, pixbuf_cache);
 
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
 
+	if (job_info->job) {
+		EvJobRender *job_render = EV_JOB_RENDER (job_info->job);
+
+		render_scale = get_render_scale (device_scale, job_render->draft);
+		if (job_render->draft && !pixbuf_cache->in_motion) {
+			/* Drafts are replaced as soon as the view stops,
+			 * even when they are already being rendered */
+			ev_debug_message (DEBUG_JOBS, "page %d: refining draft", page);
+			end_job (job_info, pixbuf_cache);
+		} else if (!job_is_superseded (job_info->job,
+					       get_device_size (width, render_scale),
+					       get_device_size (height, render_scale),
+					       rotation)) {
+			return;
+		} else {
+			/* While zooming, pending renders for the intermediate
+			 * scales are dropped from the queue instead of running
+			 * before the one for the final scale */
+			ev_debug_message (DEBUG_JOBS, "page %d: superseded render %dx%d by %dx%d", page,
+					  job_render->target_width,
+					  job_render->target_height,
+					  get_device_size (width, render_scale),
+					  get_device_size (height, render_scale));
+			end_job (job_info, pixbuf_cache);
+		}
+	}
+
+	/* Drafts are good enough only while the view moves */
+	render_scale = get_render_scale (device_scale, job_info->draft);
 	if (job_info->surface &&
 	    job_info->device_scale == device_scale &&
-	    cairo_image_surface_get_width (job_info->surface) == width * device_scale &&
-	    cairo_image_surface_get_height (job_info->surface) == height * device_scale)
+	    (!job_info->draft || pixbuf_cache->in_motion) &&
+	    cairo_image_surface_get_width (job_info->surface) == get_device_size (width, render_scale) &&
+	    cairo_image_surface_get_height (job_info->surface) == get_device_size (height, render_scale))
+		return;
+
+	/* Being restored, checked again once it is */
+	if (job_info->restore_cancellable)
+		return;
+
+	if (restore_surface (pixbuf_cache, job_info, page, rotation, width, height))
+		return;
+
+	if (use_thumbnail (pixbuf_cache, job_info, page, rotation, width, height))
 		return;
 
 	/* Free old surfaces for non visible pages */
 	if (priority == EV_JOB_PRIORITY_LOW) {
 		if (job_info->surface) {
-			cairo_surface_destroy (job_info->surface);
+			recycle_surface (job_info->surface);
 			job_info->surface = NULL;
 		}
+		clear_annotations (job_info, pixbuf_cache);
 
 		if (job_info->selection) {
 			cairo_surface_destroy (job_info->selection);
@@ -752,6 +2114,55 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		 priority);
 }
 
+/* Whether the preloaded page at distance pages from the visible range
+ * should be rendered, and how urgently. Pages ahead are preloaded as
+ * far as the scrolling speed requires; pages left behind are dropped
+ * once scrolling gets fast.
+ */
+static gboolean
+get_preload_priority (EvPixbufCache *pixbuf_cache,
+		      gint           distance,
+		      gboolean       ahead,
+		      EvJobPriority *priority)
+{
+	gdouble velocity = pixbuf_cache->scroll_velocity;
+
+	*priority = EV_JOB_PRIORITY_LOW;
+
+	if (!ahead)
+		return velocity < FAST_SCROLL_VELOCITY && distance <= MIN_PRELOADED_PAGES;
+
+	if (distance <= ceil (velocity * PRELOAD_HIGH_PRIORITY_TIME))
+		*priority = EV_JOB_PRIORITY_HIGH;
+
+	return TRUE;
+}
+
+static void
+add_preload_job_if_needed (EvPixbufCache *pixbuf_cache,
+			   CacheJobInfo  *job_info,
+			   gint           page,
+			   gint           distance,
+			   gboolean       ahead,
+			   gint           rotation,
+			   gfloat         scale)
+{
+	EvJobPriority priority;
+
+	if (!get_preload_priority (pixbuf_cache, distance, ahead, &priority)) {
+		/* Cancel prefetches that fell behind the viewport */
+		if (job_info->job)
+			end_job (job_info, pixbuf_cache);
+		if (job_info->preview_job)
+			end_preview_job (job_info, pixbuf_cache);
+		return;
+	}
+
+	add_job_if_needed (pixbuf_cache, job_info,
+			   page, rotation, scale,
+			   priority);
+}
+
 static void
 add_prev_jobs_if_needed (EvPixbufCache *pixbuf_cache,
                          gint           rotation,
@@ -765,9 +2176,10 @@ add_prev_jobs_if_needed (EvPixbufCache *pixbuf_cache,
                 job_info = (pixbuf_cache->prev_job + i);
                 page = pixbuf_cache->start_page - pixbuf_cache->preload_cache_size + i;
 
-                add_job_if_needed (pixbuf_cache, job_info,
-                                   page, rotation, scale,
-                                   EV_JOB_PRIORITY_LOW);
+                add_preload_job_if_needed (pixbuf_cache, job_info, page,
+                                           pixbuf_cache->start_page - page,
+                                           pixbuf_cache->scroll_direction == SCROLL_DIRECTION_UP,
+                                           rotation, scale);
         }
 }
 
@@ -784,9 +2196,10 @@ add_next_jobs_if_needed (EvPixbufCache *pixbuf_cache,
                 job_info = (pixbuf_cache->next_job + i);
                 page = pixbuf_cache->end_page + 1 + i;
 
-                add_job_if_needed (pixbuf_cache, job_info,
-                                   page, rotation, scale,
-                                   EV_JOB_PRIORITY_LOW);
+                add_preload_job_if_needed (pixbuf_cache, job_info, page,
+                                           page - pixbuf_cache->end_page,
+                                           pixbuf_cache->scroll_direction == SCROLL_DIRECTION_DOWN,
+                                           rotation, scale);
         }
 }
 
@@ -834,213 +2247,935 @@ ev_pixbuf_cache_get_scroll_direction (EvPixbufCache *pixbuf_cache,
         if (end_page < pixbuf_cache->end_page)
                 return SCROLL_DIRECTION_UP;
 
-        return pixbuf_cache->scroll_direction;
+        return pixbuf_cache->scroll_direction;
+}
+
+/* Estimates the scrolling speed from how fast the visible range moves */
+static void
+ev_pixbuf_cache_update_scroll_velocity (EvPixbufCache *pixbuf_cache,
+					gint           start_page)
+{
+	gint64  now = g_get_monotonic_time ();
+	gdouble elapsed;
+	gdouble velocity;
+
+	if (pixbuf_cache->start_page == -1 || pixbuf_cache->scroll_time == 0) {
+		pixbuf_cache->scroll_time = now;
+		return;
+	}
+
+	if (start_page == pixbuf_cache->start_page) {
+		if (now - pixbuf_cache->scroll_time > SCROLL_VELOCITY_TIMEOUT)
+			pixbuf_cache->scroll_velocity = 0;
+		return;
+	}
+
+	elapsed = MAX ((gdouble) (now - pixbuf_cache->scroll_time) / G_USEC_PER_SEC, 0.01);
+	velocity = ABS (start_page - pixbuf_cache->start_page) / elapsed;
+	if (elapsed * G_USEC_PER_SEC > SCROLL_VELOCITY_TIMEOUT)
+		pixbuf_cache->scroll_velocity = 0;
+
+	/* Smooth out the jitter of page granularity */
+	pixbuf_cache->scroll_velocity = (pixbuf_cache->scroll_velocity + velocity) / 2;
+	pixbuf_cache->scroll_time = now;
+
+	ev_debug_message (DEBUG_JOBS, "scrolling at %.1f pages/s", pixbuf_cache->scroll_velocity);
+}
+
+static gboolean
+refine_timeout_cb (EvPixbufCache *pixbuf_cache)
+{
+	pixbuf_cache->refine_id = 0;
+	pixbuf_cache->in_motion = FALSE;
+
+	ev_debug_message (DEBUG_JOBS, "refining drafts");
+	if (pixbuf_cache->job_list)
+		ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache,
+						    ev_document_model_get_rotation (pixbuf_cache->model),
+						    ev_document_model_get_scale (pixbuf_cache->model));
+
+	return G_SOURCE_REMOVE;
+}
+
+/* The view is in motion while it's being zoomed or scrolled faster
+ * than the pages can be rendered, and until it stops for a while */
+static void
+ev_pixbuf_cache_update_motion (EvPixbufCache *pixbuf_cache,
+			       gdouble        scale)
+{
+	gboolean moving;
+
+	moving = (pixbuf_cache->motion_scale > 0 && scale != pixbuf_cache->motion_scale) ||
+		pixbuf_cache->scroll_velocity >= FAST_SCROLL_VELOCITY;
+	pixbuf_cache->motion_scale = scale;
+
+	if (!moving && !pixbuf_cache->in_motion)
+		return;
+
+	pixbuf_cache->in_motion = TRUE;
+	if (pixbuf_cache->refine_id)
+		g_source_remove (pixbuf_cache->refine_id);
+	pixbuf_cache->refine_id = g_timeout_add (REFINE_TIMEOUT,
+						 (GSourceFunc) refine_timeout_cb,
+						 pixbuf_cache);
+}
+
+void
+ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
+				gint            start_page,
+				gint            end_page,
+				GList          *selection_list)
+{
+	gdouble scale = ev_document_model_get_scale (pixbuf_cache->model);
+	gint    rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	g_return_if_fail (start_page >= 0 && start_page < ev_document_get_n_pages (pixbuf_cache->document));
+	g_return_if_fail (end_page >= 0 && end_page < ev_document_get_n_pages (pixbuf_cache->document));
+	g_return_if_fail (end_page >= start_page);
+
+        pixbuf_cache->scroll_direction = ev_pixbuf_cache_get_scroll_direction (pixbuf_cache, start_page, end_page);
+	ev_pixbuf_cache_update_scroll_velocity (pixbuf_cache, start_page);
+	ev_pixbuf_cache_update_motion (pixbuf_cache, scale);
+
+	/* First, resize the page_range as needed.  We cull old pages
+	 * mercilessly. */
+	ev_pixbuf_cache_update_range (pixbuf_cache, start_page, end_page, rotation, scale);
+
+	/* Then, we update the current jobs to see if any of them are the wrong
+	 * size, we remove them if we need to. */
+	ev_pixbuf_cache_clear_job_sizes (pixbuf_cache, scale);
+
+	/* Next, we update the target selection for our pages */
+	ev_pixbuf_cache_set_selection_list (pixbuf_cache, selection_list);
+
+	/* Finally, we add the new jobs for all the sizes that don't have a
+	 * pixbuf */
+	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache, rotation, scale);
+}
+
+cairo_surface_t *
+ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
+			     gint           page)
+{
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL) {
+		ev_render_stats_add_cache_lookup (FALSE);
+		return NULL;
+	}
+
+	if (job_info->page_ready) {
+		ev_render_stats_add_cache_lookup (TRUE);
+		ev_surface_budget_touch (job_info->surface);
+		return job_info->surface;
+	}
+
+	/* We don't need to wait for the idle to handle the callback */
+	if (job_info->job &&
+	    EV_JOB_RENDER (job_info->job)->page_ready) {
+		copy_job_to_job_info (EV_JOB_RENDER (job_info->job), job_info, pixbuf_cache);
+		emit_job_finished (pixbuf_cache, page, job_info->region);
+	}
+
+	/* A preview or a draft shown meanwhile is a miss */
+	ev_render_stats_add_cache_lookup (job_info->page_ready);
+	if (job_info->surface)
+		ev_surface_budget_touch (job_info->surface);
+
+	return job_info->surface;
+}
+
+/* Shows @surface, a rendering of @page at any scale, while the page is
+ * rendered, instead of a preview. If the page isn't wanted yet, it's
+ * kept until it's scheduled, only the last one given is kept.
+ */
+void
+ev_pixbuf_cache_set_page_preview (EvPixbufCache   *pixbuf_cache,
+				  gint             page,
+				  gint             rotation,
+				  cairo_surface_t *surface)
+{
+	CacheJobInfo *job_info;
+
+	g_clear_pointer (&pixbuf_cache->seed_preview, cairo_surface_destroy);
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info && (job_info->job || job_info->surface)) {
+		EvJobRender *job_render = job_info->job ? EV_JOB_RENDER (job_info->job) : NULL;
+
+		if (job_info->surface || !job_render || job_render->rotation != rotation)
+			return;
+
+		if (job_info->preview_job)
+			end_preview_job (job_info, pixbuf_cache);
+
+		job_info->surface = cairo_surface_reference (surface);
+		set_device_scale_on_surface (job_info->surface, job_info->device_scale);
+		ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+		emit_job_finished (pixbuf_cache, page, NULL);
+		return;
+	}
+
+	pixbuf_cache->seed_preview = cairo_surface_reference (surface);
+	pixbuf_cache->seed_page = page;
+	pixbuf_cache->seed_rotation = rotation;
+}
+
+/* Returns the surface of page only if it's completely rendered, without
+ * scheduling anything. Tiled pages have no surface of the whole page.
+ */
+cairo_surface_t *
+ev_pixbuf_cache_peek_surface (EvPixbufCache *pixbuf_cache,
+			      gint           page)
+{
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || !job_info->page_ready || job_info->tiles)
+		return NULL;
+
+	return job_info->surface;
+}
+
+/* Returns the annotations to draw over the surface of page, for pages
+ * rendered in layers that have annotations.
+ */
+cairo_surface_t *
+ev_pixbuf_cache_get_annotations_surface (EvPixbufCache *pixbuf_cache,
+					 gint           page)
+{
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || !job_info->surface)
+		return NULL;
+
+	return job_info->annotations;
+}
+
+gboolean
+ev_pixbuf_cache_is_page_tiled (EvPixbufCache *pixbuf_cache,
+			       gint           page)
+{
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+
+	return job_info && job_info->tiles;
+}
+
+/* Returns the surface of the tile at column tile_x and row tile_y
+ * of a tiled page. Tiles are EV_PIXBUF_CACHE_TILE_SIZE pixels wide
+ * and high, except for the ones on the right and bottom edges.
+ */
+cairo_surface_t *
+ev_pixbuf_cache_get_tile_surface (EvPixbufCache *pixbuf_cache,
+				  gint           page,
+				  gint           tile_x,
+				  gint           tile_y)
+{
+	CacheJobInfo *job_info;
+	CacheTile    *tile;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || job_info->tiles == NULL)
+		return NULL;
+
+	tile = g_hash_table_lookup (job_info->tiles, TILE_KEY (tile_x, tile_y));
+	if (tile == NULL)
+		return NULL;
+
+	/* We don't need to wait for the idle to handle the callback */
+	if (tile->job &&
+	    EV_JOB_RENDER (tile->job)->page_ready) {
+		cairo_region_t *region;
+
+		region = get_tile_region (EV_JOB_RENDER (tile->job), job_info);
+		copy_job_to_tile (EV_JOB_RENDER (tile->job), job_info, tile, pixbuf_cache);
+		emit_job_finished (pixbuf_cache, page, region);
+		cairo_region_destroy (region);
+	}
+
+	ev_render_stats_add_cache_lookup (tile->surface != NULL);
+	if (tile->surface)
+		ev_surface_budget_touch (tile->surface);
+
+	return tile->surface;
+}
+
+static gboolean
+evict_tile (EvPixbufCache   *pixbuf_cache,
+	    CacheJobInfo    *job_info,
+	    gint             page,
+	    cairo_surface_t *surface,
+	    gboolean        *evicted)
+{
+	GHashTableIter iter;
+	gpointer       key, value;
+
+	g_hash_table_iter_init (&iter, job_info->tiles);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GdkRectangle visible_area;
+
+		if (((CacheTile *)value)->surface != surface)
+			continue;
+
+		if (_ev_view_get_visible_page_area (EV_VIEW (pixbuf_cache->view), page,
+						    0, &visible_area) &&
+		    tile_intersects_area (key, &visible_area)) {
+			*evicted = FALSE;
+		} else {
+			dispose_cache_tile ((CacheTile *)value, pixbuf_cache);
+			g_hash_table_iter_remove (&iter);
+			*evicted = TRUE;
+		}
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Called by the surface budget when it's exceeded. Surfaces of the
+ * visible pages, and visible tiles, are never given up.
+ */
+static gboolean
+evict_surface_cb (cairo_surface_t *surface,
+		  gpointer         data)
+{
+	EvPixbufCache *pixbuf_cache = EV_PIXBUF_CACHE (data);
+	gboolean       evicted;
+	gint           page;
+
+	if (!pixbuf_cache->job_list)
+		return TRUE;
+
+	for (page = MAX (0, pixbuf_cache->start_page - pixbuf_cache->preload_cache_size);
+	     page <= pixbuf_cache->end_page + pixbuf_cache->preload_cache_size;
+	     page++) {
+		CacheJobInfo *job_info;
+
+		job_info = find_job_cache (pixbuf_cache, page);
+		if (job_info == NULL)
+			continue;
+
+		if (job_info->surface == surface) {
+			if (page >= pixbuf_cache->start_page && page <= pixbuf_cache->end_page)
+				return FALSE;
+
+			archive_surface (pixbuf_cache, job_info, page);
+			if (job_info->surface) {
+				recycle_surface (job_info->surface);
+				job_info->surface = NULL;
+			}
+			clear_annotations (job_info, pixbuf_cache);
+			job_info->page_ready = FALSE;
+
+			return TRUE;
+		}
+
+		if (job_info->tiles &&
+		    evict_tile (pixbuf_cache, job_info, page, surface, &evicted))
+			return evicted;
+	}
+
+	/* Not ours anymore */
+	return TRUE;
+}
+
+static gboolean
+new_selection_surface_needed (EvPixbufCache *pixbuf_cache,
+			      CacheJobInfo  *job_info,
+			      gint           page,
+			      gfloat         scale)
+{
+	if (job_info->selection)
+		return job_info->selection_scale != scale;
+	return job_info->points_set;
+}
+
+/* Clears the cache of jobs and pixbufs.
+ */
+void
+ev_pixbuf_cache_clear (EvPixbufCache *pixbuf_cache)
+{
+	int i;
+
+	ev_page_archive_clear (pixbuf_cache->archive);
+	/* Opened again when needed, which drops the renders of an
+	 * older version of the file */
+	g_clear_object (&pixbuf_cache->render_pack);
+
+	if (!pixbuf_cache->job_list)
+		return;
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
+		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
+	}
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
+	}
+}
+
+static void
+rotate_cache_job_info (EvPixbufCache *pixbuf_cache,
+		       CacheJobInfo  *job_info,
+		       gint           delta,
+		       gboolean       exact)
+{
+	cairo_surface_t *surface = NULL;
+	cairo_surface_t *rotated;
+	gboolean         draft = job_info->draft;
+
+	/* Previews and tiles are rendered again */
+	if (job_info->page_ready && job_info->surface && !job_info->tiles) {
+		surface = job_info->surface;
+		job_info->surface = NULL;
+	}
+
+	dispose_cache_job_info (job_info, pixbuf_cache);
+	job_info->page_ready = FALSE;
+	if (!surface)
+		return;
+
+	rotated = ev_document_misc_surface_rotate_and_scale (surface,
+							     cairo_image_surface_get_width (surface),
+							     cairo_image_surface_get_height (surface),
+							     delta);
+	recycle_surface (surface);
+	if (!rotated)
+		return;
+
+	/* Kept as a draft, to be replaced by a render, unless it's
+	 * what the render would give */
+	job_info->surface = rotated;
+	job_info->draft = draft || !exact;
+	job_info->page_ready = TRUE;
+	set_device_scale_on_surface (job_info->surface,
+				     get_render_scale (job_info->device_scale, draft));
+	ev_surface_budget_add (job_info->surface, evict_surface_cb, pixbuf_cache);
+}
+
+/* Rotates the surfaces of the cached pages by @delta degrees when the
+ * rotation changes, so that they are shown right away. Documents that
+ * can't select text are made of images, and their rotated pages are
+ * the same a render would give. Pages of the other documents are
+ * kept as drafts and rendered again.
+ */
+void
+ev_pixbuf_cache_rotate (EvPixbufCache *pixbuf_cache,
+			gint           delta)
+{
+	gboolean exact;
+	int i;
+
+	if (!pixbuf_cache->job_list)
+		return;
+
+	delta = ((delta % 360) + 360) % 360;
+	exact = !EV_IS_SELECTION (pixbuf_cache->document);
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		rotate_cache_job_info (pixbuf_cache, pixbuf_cache->prev_job + i, delta, exact);
+		rotate_cache_job_info (pixbuf_cache, pixbuf_cache->next_job + i, delta, exact);
+	}
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+		rotate_cache_job_info (pixbuf_cache, pixbuf_cache->job_list + i, delta, exact);
+	}
+
+	g_clear_pointer (&pixbuf_cache->seed_preview, cairo_surface_destroy);
+}
+
+
+/* Stops the jobs of a page rendered by the previous document, keeping
+ * the surfaces already rendered.
+ */
+static void
+keep_cache_job_info (CacheJobInfo *job_info,
+		     gpointer      data)
+{
+	if (job_info->job)
+		end_job (job_info, data);
+
+	if (job_info->preview_job)
+		end_preview_job (job_info, data);
+
+	end_selection_jobs (job_info, data);
+
+	if (job_info->annotations_job)
+		end_annotations_job (job_info, data);
+
+	if (job_info->restore_cancellable) {
+		g_cancellable_cancel (job_info->restore_cancellable);
+		g_clear_object (&job_info->restore_cancellable);
+	}
+
+	if (job_info->tiles) {
+		GHashTableIter iter;
+		gpointer       value;
+
+		g_hash_table_iter_init (&iter, job_info->tiles);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			CacheTile *tile = (CacheTile *)value;
+
+			if (tile->job)
+				end_tile_job (tile, data);
+		}
+	}
+
+	if (job_info->selection) {
+		cairo_surface_destroy (job_info->selection);
+		job_info->selection = NULL;
+	}
+	if (job_info->selection_region) {
+		cairo_region_destroy (job_info->selection_region);
+		job_info->selection_region = NULL;
+	}
+
+	job_info->points_set = FALSE;
+}
+
+static void
+ev_pixbuf_cache_set_document_for_job_info (EvPixbufCache            *pixbuf_cache,
+					   CacheJobInfo             *job_info,
+					   gint                      page,
+					   EvPixbufCacheKeepPageFunc keep_page,
+					   gpointer                  user_data)
+{
+	if (page >= 0 && page < ev_document_get_n_pages (pixbuf_cache->document) &&
+	    keep_page (page, user_data))
+		keep_cache_job_info (job_info, pixbuf_cache);
+	else
+		dispose_cache_job_info (job_info, pixbuf_cache);
+}
+
+/**
+ * ev_pixbuf_cache_set_document:
+ * @pixbuf_cache: an #EvPixbufCache
+ * @document: the new version of the document of @pixbuf_cache
+ * @keep_page: function telling the pages that didn't change
+ * @user_data: data for @keep_page
+ *
+ * Switches to @document, like when the document is reloaded, keeping
+ * what's been rendered of the pages @keep_page returns %TRUE for.
+ * Everything else is cleared, and rendered again from @document.
+ */
+void
+ev_pixbuf_cache_set_document (EvPixbufCache            *pixbuf_cache,
+			      EvDocument               *document,
+			      EvPixbufCacheKeepPageFunc keep_page,
+			      gpointer                  user_data)
+{
+	gint i, page;
+
+	g_signal_handlers_disconnect_by_func (pixbuf_cache->document,
+					      G_CALLBACK (document_modified_cb),
+					      pixbuf_cache);
+	pixbuf_cache->document = document;
+	g_signal_connect_object (pixbuf_cache->document, "notify::modified",
+				 G_CALLBACK (document_modified_cb),
+				 pixbuf_cache, 0);
+	g_clear_object (&pixbuf_cache->render_pack);
+	pixbuf_cache->render_pack_disabled = FALSE;
+	g_clear_pointer (&pixbuf_cache->seed_preview, cairo_surface_destroy);
+	ev_pixbuf_cache_cancel_prefetch (pixbuf_cache);
+	ev_page_archive_clear (pixbuf_cache->archive);
+
+	if (!pixbuf_cache->job_list)
+		return;
+
+	page = pixbuf_cache->start_page - pixbuf_cache->preload_cache_size;
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++, page++)
+		ev_pixbuf_cache_set_document_for_job_info (pixbuf_cache, pixbuf_cache->prev_job + i,
+							   page, keep_page, user_data);
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++, page++)
+		ev_pixbuf_cache_set_document_for_job_info (pixbuf_cache, pixbuf_cache->job_list + i,
+							   page, keep_page, user_data);
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++, page++)
+		ev_pixbuf_cache_set_document_for_job_info (pixbuf_cache, pixbuf_cache->next_job + i,
+							   page, keep_page, user_data);
+}
+
+
+/* Starts the render of the first page to prefetch that isn't in the
+ * cache or the archive already. Tiled pages are left out, only the
+ * tiles around the visible area are rendered for them anyway.
+ */
+static void
+prefetch_next_page (EvPixbufCache *pixbuf_cache)
+{
+	gdouble scale = ev_document_model_get_scale (pixbuf_cache->model);
+	gint    rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+	gdouble device_scale = get_device_scale (pixbuf_cache);
+
+	if (pixbuf_cache->prefetch_job)
+		return;
+
+	while (!g_queue_is_empty (&pixbuf_cache->prefetch_pages)) {
+		EvRenderPack *pack;
+		gint width, height;
+		gint page;
+
+		page = GPOINTER_TO_INT (g_queue_pop_head (&pixbuf_cache->prefetch_pages));
+		if (page < 0 || page >= ev_document_get_n_pages (pixbuf_cache->document) ||
+		    find_job_cache (pixbuf_cache, page) ||
+		    page_needs_tiles (pixbuf_cache, page, scale, rotation))
+			continue;
+
+		_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+						       page, scale, rotation,
+						       &width, &height);
+		width = get_device_size (width, device_scale);
+		height = get_device_size (height, device_scale);
+		if (ev_page_archive_contains (pixbuf_cache->archive, page, rotation,
+					      width, height, device_scale))
+			continue;
+
+		pack = get_render_pack (pixbuf_cache);
+		if (pack && ev_render_pack_contains (pack, page, rotation, width, height,
+						     device_scale, get_render_layer (pixbuf_cache)))
+			continue;
+
+		ev_debug_message (DEBUG_JOBS, "page %d: prefetching", page);
+
+		pixbuf_cache->prefetch_job = ev_job_render_new (pixbuf_cache->document,
+								page, rotation,
+								scale * device_scale,
+								width, height);
+		if (renders_layers (pixbuf_cache))
+			ev_job_render_set_layer (EV_JOB_RENDER (pixbuf_cache->prefetch_job),
+						 EV_RENDER_LAYER_CONTENT);
+		ev_job_render_set_mask_monochrome (EV_JOB_RENDER (pixbuf_cache->prefetch_job), TRUE);
+		ev_job_set_background (pixbuf_cache->prefetch_job, TRUE);
+		g_signal_connect (pixbuf_cache->prefetch_job, "finished",
+				  G_CALLBACK (prefetch_job_finished_cb),
+				  pixbuf_cache);
+		ev_job_scheduler_push_job_for_client (pixbuf_cache->prefetch_job,
+						      EV_JOB_PRIORITY_NONE,
+						      pixbuf_cache->view);
+		return;
+	}
+}
+
+static void
+prefetch_job_finished_cb (EvJob         *job,
+			  EvPixbufCache *pixbuf_cache)
+{
+	EvJobRender *job_render = EV_JOB_RENDER (job);
+
+	/* Like pages leaving the cache, only pages without a separate
+	 * annotations layer are archived */
+	if (!ev_job_is_failed (job) && job_render->surface && !job_render->annotations &&
+	    job_render->rotation == ev_document_model_get_rotation (pixbuf_cache->model)) {
+		save_slow_render (pixbuf_cache, job_render, get_device_scale (pixbuf_cache));
+		ev_page_archive_store (pixbuf_cache->archive, job_render->page,
+				       job_render->rotation,
+				       get_device_scale (pixbuf_cache),
+				       cairo_surface_reference (job_render->surface));
+	}
+
+	g_signal_handlers_disconnect_by_func (job, G_CALLBACK (prefetch_job_finished_cb),
+					      pixbuf_cache);
+	g_clear_object (&pixbuf_cache->prefetch_job);
+
+	prefetch_next_page (pixbuf_cache);
 }
 
+/**
+ * ev_pixbuf_cache_prefetch_page:
+ * @pixbuf_cache: an #EvPixbufCache
+ * @page: a page likely to be shown soon
+ *
+ * Renders @page at the current scale and rotation at the lowest
+ * priority, and keeps it in the archive so that going to it doesn't
+ * wait for a render. Pages prefetched last are rendered first.
+ */
 void
-ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
-				gint            start_page,
-				gint            end_page,
-				GList          *selection_list)
+ev_pixbuf_cache_prefetch_page (EvPixbufCache *pixbuf_cache,
+			       gint           page)
 {
-	gdouble scale = ev_document_model_get_scale (pixbuf_cache->model);
-	gint    rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+	GList *link;
 
 	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
 
-	g_return_if_fail (start_page >= 0 && start_page < ev_document_get_n_pages (pixbuf_cache->document));
-	g_return_if_fail (end_page >= 0 && end_page < ev_document_get_n_pages (pixbuf_cache->document));
-	g_return_if_fail (end_page >= start_page);
-
-        pixbuf_cache->scroll_direction = ev_pixbuf_cache_get_scroll_direction (pixbuf_cache, start_page, end_page);
-
-	/* First, resize the page_range as needed.  We cull old pages
-	 * mercilessly. */
-	ev_pixbuf_cache_update_range (pixbuf_cache, start_page, end_page, rotation, scale);
+	if (pixbuf_cache->under_pressure || pixbuf_cache->max_size == 0)
+		return;
 
-	/* Then, we update the current jobs to see if any of them are the wrong
-	 * size, we remove them if we need to. */
-	ev_pixbuf_cache_clear_job_sizes (pixbuf_cache, scale);
+	if (pixbuf_cache->prefetch_job &&
+	    EV_JOB_RENDER (pixbuf_cache->prefetch_job)->page == page)
+		return;
 
-	/* Next, we update the target selection for our pages */
-	ev_pixbuf_cache_set_selection_list (pixbuf_cache, selection_list);
+	link = g_queue_find (&pixbuf_cache->prefetch_pages, GINT_TO_POINTER (page));
+	if (link)
+		g_queue_delete_link (&pixbuf_cache->prefetch_pages, link);
+	g_queue_push_head (&pixbuf_cache->prefetch_pages, GINT_TO_POINTER (page));
+	while (pixbuf_cache->prefetch_pages.length > MAX_PREFETCH_PAGES)
+		g_queue_pop_tail (&pixbuf_cache->prefetch_pages);
 
-	/* Finally, we add the new jobs for all the sizes that don't have a
-	 * pixbuf */
-	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache, rotation, scale);
+	prefetch_next_page (pixbuf_cache);
 }
 
+/**
+ * ev_pixbuf_cache_set_pinned_pages:
+ * @pixbuf_cache: an #EvPixbufCache
+ * @pages: (array length=n_pages): the pages to pin, most important first
+ * @n_pages: the number of @pages
+ *
+ * Keeps the rendered @pages in the archive when they leave the cache,
+ * and prefetches the ones that aren't there, for the pages the user
+ * is likely to go back to.
+ */
 void
-ev_pixbuf_cache_set_inverted_colors (EvPixbufCache *pixbuf_cache,
-				     gboolean       inverted_colors)
+ev_pixbuf_cache_set_pinned_pages (EvPixbufCache *pixbuf_cache,
+				  const gint    *pages,
+				  guint          n_pages)
 {
-	gint i;
-
-	if (pixbuf_cache->inverted_colors == inverted_colors)
-		return;
+	guint i;
 
-	pixbuf_cache->inverted_colors = inverted_colors;
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
 
-	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
-		CacheJobInfo *job_info;
+	ev_page_archive_set_pinned_pages (pixbuf_cache->archive, pages, n_pages);
 
-		job_info = pixbuf_cache->prev_job + i;
-		if (job_info && job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+	if (pixbuf_cache->under_pressure || pixbuf_cache->max_size == 0)
+		return;
 
-		job_info = pixbuf_cache->next_job + i;
-		if (job_info && job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+	/* After the pages prefetched before, the most important first */
+	for (i = 0; i < n_pages && pixbuf_cache->prefetch_pages.length < MAX_PREFETCH_PAGES; i++) {
+		if (!g_queue_find (&pixbuf_cache->prefetch_pages, GINT_TO_POINTER (pages[i])))
+			g_queue_push_tail (&pixbuf_cache->prefetch_pages, GINT_TO_POINTER (pages[i]));
 	}
 
-	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
-		CacheJobInfo *job_info;
+	prefetch_next_page (pixbuf_cache);
+}
+
+static void
+clear_selection_surface (CacheJobInfo  *job_info,
+			 EvPixbufCache *pixbuf_cache)
+{
+	if (job_info->selection_job)
+		end_selection_job (job_info, pixbuf_cache);
 
-		job_info = pixbuf_cache->job_list + i;
-		if (job_info && job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+	if (job_info->selection) {
+		cairo_surface_destroy (job_info->selection);
+		job_info->selection = NULL;
+		job_info->selection_points.x1 = -1;
 	}
 }
 
-cairo_surface_t *
-ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
-			     gint           page)
+static void
+clear_selection_surfaces (EvPixbufCache *pixbuf_cache)
 {
-	CacheJobInfo *job_info;
-
-	job_info = find_job_cache (pixbuf_cache, page);
-	if (job_info == NULL)
-		return NULL;
+	gint i;
 
-	if (job_info->page_ready)
-		return job_info->surface;
+	if (!pixbuf_cache->job_list)
+		return;
 
-	/* We don't need to wait for the idle to handle the callback */
-	if (job_info->job &&
-	    EV_JOB_RENDER (job_info->job)->page_ready) {
-		copy_job_to_job_info (EV_JOB_RENDER (job_info->job), job_info, pixbuf_cache);
-		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		clear_selection_surface (pixbuf_cache->prev_job + i, pixbuf_cache);
+		clear_selection_surface (pixbuf_cache->next_job + i, pixbuf_cache);
 	}
 
-	return job_info->surface;
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++)
+		clear_selection_surface (pixbuf_cache->job_list + i, pixbuf_cache);
 }
 
-static gboolean
-new_selection_surface_needed (EvPixbufCache *pixbuf_cache,
-			      CacheJobInfo  *job_info,
-			      gint           page,
-			      gfloat         scale)
+void
+ev_pixbuf_cache_style_changed (EvPixbufCache *pixbuf_cache)
 {
-	if (job_info->selection)
-		return job_info->selection_scale != scale;
-	return job_info->points_set;
+	/* FIXME: doesn't update running render jobs. */
+	clear_selection_surfaces (pixbuf_cache);
 }
 
-static gboolean
-new_selection_region_needed (EvPixbufCache *pixbuf_cache,
-			     CacheJobInfo  *job_info,
-			     gint           page,
-			     gfloat         scale)
+/* A selection surface is as big as its page, selecting many pages at
+ * a high zoom level keeps a lot of them. With @region_only the cache
+ * keeps just the regions of the selections instead, and the view
+ * paints the highlight over the page.
+ */
+void
+ev_pixbuf_cache_set_selection_region_only (EvPixbufCache *pixbuf_cache,
+					   gboolean       region_only)
 {
-	if (job_info->selection_region)
-		return job_info->selection_region_scale != scale;
-	return job_info->points_set;
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	if (pixbuf_cache->selection_region_only == region_only)
+		return;
+
+	pixbuf_cache->selection_region_only = region_only;
+	if (region_only)
+		clear_selection_surfaces (pixbuf_cache);
 }
 
-static void
-clear_selection_surface_if_needed (EvPixbufCache *pixbuf_cache,
-                                   CacheJobInfo  *job_info,
-                                   gint           page,
-                                   gfloat         scale)
+/**
+ * ev_pixbuf_cache_set_device_scale:
+ * @pixbuf_cache: an #EvPixbufCache
+ * @device_scale: device pixels per pixel of the view, or 0
+ *
+ * Pages are rendered at @device_scale instead of the integer scale
+ * factor of the view, so that they are rasterized at the exact size
+ * in physical pixels on displays with fractional scales.
+ */
+void
+ev_pixbuf_cache_set_device_scale (EvPixbufCache *pixbuf_cache,
+				  gdouble        device_scale)
 {
-	if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
-		if (job_info->selection)
-			cairo_surface_destroy (job_info->selection);
-		job_info->selection = NULL;
-		job_info->selection_points.x1 = -1;
-	}
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	pixbuf_cache->device_scale = MAX (device_scale, 0);
 }
 
-static void
-clear_selection_region_if_needed (EvPixbufCache *pixbuf_cache,
-                                  CacheJobInfo  *job_info,
-                                  gint           page,
-                                  gfloat         scale)
+/**
+ * ev_pixbuf_cache_set_render_pack_size:
+ * @pixbuf_cache: an #EvPixbufCache
+ * @size: the size of the render packs on disk, in bytes, or 0
+ *
+ * Pages that are slow to render are saved in a pack file of the user
+ * cache, and restored from it instead of rendered again, even once
+ * the document is opened again. @size bounds the packs of all the
+ * documents together, 0 disables them.
+ */
+void
+ev_pixbuf_cache_set_render_pack_size (EvPixbufCache *pixbuf_cache,
+				      gsize          size)
 {
-	if (new_selection_region_needed (pixbuf_cache, job_info, page, scale)) {
-		if (job_info->selection_region)
-			cairo_region_destroy (job_info->selection_region);
-		job_info->selection_region = NULL;
-		job_info->selection_region_points.x1 = -1;
-	}
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	if (pixbuf_cache->render_pack_size == size)
+		return;
+
+	/* Opened again with the new size when needed */
+	pixbuf_cache->render_pack_size = size;
+	g_clear_object (&pixbuf_cache->render_pack);
 }
 
-/* Clears the cache of jobs and pixbufs.
+/**
+ * ev_pixbuf_cache_disable_render_pack:
+ * @pixbuf_cache: an #EvPixbufCache
+ *
+ * Stops restoring and saving renders in the render pack until the
+ * document changes, like when layers were shown or hidden: the pack
+ * only has the pages as they are rendered with the default layers.
  */
 void
-ev_pixbuf_cache_clear (EvPixbufCache *pixbuf_cache)
+ev_pixbuf_cache_disable_render_pack (EvPixbufCache *pixbuf_cache)
 {
-	int i;
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
 
-	if (!pixbuf_cache->job_list)
-		return;
+	g_clear_object (&pixbuf_cache->render_pack);
+	pixbuf_cache->render_pack_disabled = TRUE;
+}
 
-	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
-		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
-		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
-	}
+static gboolean
+selection_job_is_for (EvJob        *job,
+		      CacheJobInfo *job_info,
+		      gdouble       scale)
+{
+	EvJobSelection *job_selection = EV_JOB_SELECTION (job);
 
-	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
-		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
-	}
+	return job_selection->scale == scale &&
+		job_selection->style == job_info->selection_style &&
+		!ev_rect_cmp (&(job_selection->points), &(job_info->target_points));
 }
 
+static EvJob *
+selection_job_new (EvPixbufCache *pixbuf_cache,
+		   CacheJobInfo  *job_info,
+		   gint           page,
+		   gdouble        scale)
+{
+	gint width, height;
 
-void
-ev_pixbuf_cache_style_changed (EvPixbufCache *pixbuf_cache)
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale, 0,
+					       &width, &height);
+
+	return ev_job_selection_new (pixbuf_cache->document, page, scale,
+				     width, height,
+				     &(job_info->target_points),
+				     job_info->selection_style);
+}
+
+static void
+selection_job_finished_cb (EvJob         *job,
+			   EvPixbufCache *pixbuf_cache)
 {
-	gint i;
+	EvJobSelection *job_selection = EV_JOB_SELECTION (job);
+	CacheJobInfo   *job_info;
+	gint            page = job_selection->page;
 
-	if (!pixbuf_cache->job_list)
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || job_info->selection_job != job)
 		return;
 
-	/* FIXME: doesn't update running jobs. */
-	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
-		CacheJobInfo *job_info;
+	if (job_info->selection)
+		cairo_surface_destroy (job_info->selection);
+	job_info->selection = job_selection->selection;
+	job_selection->selection = NULL;
+	if (job_info->selection)
+		set_device_scale_on_surface (job_info->selection, job_info->device_scale);
+	job_info->selection_points = job_selection->points;
+	job_info->selection_scale = job_selection->scale;
 
-		job_info = pixbuf_cache->prev_job + i;
-		if (job_info->selection) {
-			cairo_surface_destroy (job_info->selection);
-			job_info->selection = NULL;
-			job_info->selection_points.x1 = -1;
-		}
+	end_selection_job (job_info, pixbuf_cache);
+	emit_job_finished (pixbuf_cache, page, NULL);
+}
 
-		job_info = pixbuf_cache->next_job + i;
-		if (job_info->selection) {
-			cairo_surface_destroy (job_info->selection);
-			job_info->selection = NULL;
-			job_info->selection_points.x1 = -1;
-		}
-	}
+static void
+selection_region_job_finished_cb (EvJob         *job,
+				  EvPixbufCache *pixbuf_cache)
+{
+	EvJobSelection *job_selection = EV_JOB_SELECTION (job);
+	CacheJobInfo   *job_info;
+	cairo_region_t *damage = NULL;
+	gint            page = job_selection->page;
 
-	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
-		CacheJobInfo *job_info;
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || job_info->selection_region_job != job)
+		return;
 
-		job_info = pixbuf_cache->job_list + i;
-		if (job_info->selection) {
-			cairo_surface_destroy (job_info->selection);
-			job_info->selection = NULL;
-			job_info->selection_points.x1 = -1;
-		}
+	/* Both the old and the new highlight change, unless the
+	 * view is drawing the old one at another scale */
+	if (job_selection->selection_region &&
+	    (!job_info->selection_region ||
+	     job_info->selection_region_scale == job_selection->scale)) {
+		damage = cairo_region_copy (job_selection->selection_region);
+		if (job_info->selection_region)
+			cairo_region_union (damage, job_info->selection_region);
 	}
+
+	if (job_info->selection_region)
+		cairo_region_destroy (job_info->selection_region);
+	job_info->selection_region = job_selection->selection_region;
+	job_selection->selection_region = NULL;
+	job_info->selection_region_points = job_selection->points;
+	job_info->selection_region_scale = job_selection->scale;
+
+	end_selection_region_job (job_info, pixbuf_cache);
+	emit_job_finished (pixbuf_cache, page, damage);
+	if (damage)
+		cairo_region_destroy (damage);
 }
 
+/* Selections are rendered in urgent jobs, the main thread never waits
+ * for the document lock. Until the job finishes, the surface rendered
+ * for the previous selection or scale is returned, it's scaled when
+ * drawn, so dragging a selection never blocks the view.
+ */
 cairo_surface_t *
 ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 				       gint             page,
 				       gfloat           scale)
 {
 	CacheJobInfo *job_info;
+	gdouble       surface_scale;
+	GdkColor      text, base;
 
 	/* the document does not implement the selection interface */
 	if (!EV_IS_SELECTION (pixbuf_cache->document))
@@ -1054,64 +3189,48 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 	if (!job_info->points_set)
 		return NULL;
 
+	/* A selection surface as big as a tiled page is what tiles are
+	 * meant to avoid, the selection region is drawn instead */
+	if (job_info->tiles || pixbuf_cache->selection_region_only)
+		return NULL;
+
 	/* If we have a running job, we just return what we have under the
 	 * assumption that it'll be updated later and we can scale it as need
 	 * be */
 	if (job_info->job && EV_JOB_RENDER (job_info->job)->include_selection)
 		return job_info->selection;
 
-	/* Now, lets see if we need to resize the image.  If we do, we clear the
-	 * old one. */
-	clear_selection_surface_if_needed (pixbuf_cache, job_info, page, scale);
-
-	/* Finally, we see if the two scales are the same, and get a new pixbuf
-	 * if needed.  We do this synchronously for now.  At some point, we
-	 * _should_ be able to get rid of the doc_mutex, so the synchronicity
-	 * doesn't kill us.  Rendering a few glyphs should really be fast.
-	 */
-	if (ev_rect_cmp (&(job_info->target_points), &(job_info->selection_points))) {
-		EvRectangle *old_points;
-		GdkColor text, base;
-		EvRenderContext *rc;
-		EvPage *ev_page;
-		gint width, height;
+	surface_scale = scale * job_info->device_scale;
+	if (job_info->selection &&
+	    job_info->selection_scale == surface_scale &&
+	    !ev_rect_cmp (&(job_info->target_points), &(job_info->selection_points)))
+		return job_info->selection;
 
-		/* we need to get a new selection pixbuf */
-		ev_document_doc_mutex_lock ();
-		if (job_info->selection_points.x1 < 0) {
-			g_assert (job_info->selection == NULL);
-			old_points = NULL;
-		} else {
-			old_points = &(job_info->selection_points);
-		}
+	if (job_info->selection_job &&
+	    selection_job_is_for (job_info->selection_job, job_info, surface_scale))
+		return job_info->selection;
 
-		ev_page = ev_document_get_page (pixbuf_cache->document, page);
-                _get_page_size_for_scale_and_rotation (pixbuf_cache->document,
-                                                       page,
-						       scale * job_info->device_scale,
-						       0, &width, &height);
+	if (job_info->selection_job)
+		end_selection_job (job_info, pixbuf_cache);
 
-		rc = ev_render_context_new (ev_page, 0, scale * job_info->device_scale);
-                ev_render_context_set_target_size (rc, width, height);
-		g_object_unref (ev_page);
+	job_info->selection_job = selection_job_new (pixbuf_cache, job_info, page, surface_scale);
+	get_selection_colors (EV_VIEW (pixbuf_cache->view), &text, &base);
+	ev_job_selection_set_render_surface (EV_JOB_SELECTION (job_info->selection_job),
+					     &text, &base);
+	g_signal_connect (job_info->selection_job, "finished",
+			  G_CALLBACK (selection_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job_for_client (job_info->selection_job,
+					      EV_JOB_PRIORITY_URGENT,
+					      pixbuf_cache->view);
 
-		get_selection_colors (EV_VIEW (pixbuf_cache->view), &text, &base);
-		ev_selection_render_selection (EV_SELECTION (pixbuf_cache->document),
-					       rc, &(job_info->selection),
-					       &(job_info->target_points),
-					       old_points,
-					       job_info->selection_style,
-					       &text, &base);
-                if (job_info->selection)
-                        set_device_scale_on_surface (job_info->selection, job_info->device_scale);
-		job_info->selection_points = job_info->target_points;
-		job_info->selection_scale = scale * job_info->device_scale;
-		g_object_unref (rc);
-		ev_document_doc_mutex_unlock ();
-	}
 	return job_info->selection;
 }
 
+/* Like the surface, the region is computed in a job. The previous
+ * region is returned meanwhile only if it's at @scale, since it's used
+ * for hit tests too, so they can briefly see the previous selection.
+ */
 cairo_region_t *
 ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 				      gint           page,
@@ -1138,40 +3257,28 @@ ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 		return job_info->selection_region && !cairo_region_is_empty(job_info->selection_region) ?
                         job_info->selection_region : NULL;
 
-	/* Now, lets see if we need to resize the region.  If we do, we clear the
-	 * old one. */
-	clear_selection_region_if_needed (pixbuf_cache, job_info, page, scale);
-
-	/* Finally, we see if the two scales are the same, and get a new region
-	 * if needed.
-	 */
-	if (ev_rect_cmp (&(job_info->target_points), &(job_info->selection_region_points))) {
-		EvRenderContext *rc;
-		EvPage *ev_page;
-		gint width, height;
-
-		ev_document_doc_mutex_lock ();
-		ev_page = ev_document_get_page (pixbuf_cache->document, page);
-
-		_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
-						       page, scale, 0,
-						       &width, &height);
+	if (!job_info->selection_region ||
+	    job_info->selection_region_scale != scale ||
+	    ev_rect_cmp (&(job_info->target_points), &(job_info->selection_region_points))) {
+		if (job_info->selection_region_job &&
+		    !selection_job_is_for (job_info->selection_region_job, job_info, scale))
+			end_selection_region_job (job_info, pixbuf_cache);
+
+		if (!job_info->selection_region_job) {
+			job_info->selection_region_job = selection_job_new (pixbuf_cache, job_info,
+									    page, scale);
+			g_signal_connect (job_info->selection_region_job, "finished",
+					  G_CALLBACK (selection_region_job_finished_cb),
+					  pixbuf_cache);
+			ev_job_scheduler_push_job_for_client (job_info->selection_region_job,
+							      EV_JOB_PRIORITY_URGENT,
+							      pixbuf_cache->view);
+		}
+	}
 
-		rc = ev_render_context_new (ev_page, 0, 0.);
-		ev_render_context_set_target_size (rc, width, height);
-		g_object_unref (ev_page);
+	if (job_info->selection_region_scale != scale)
+		return NULL;
 
-		if (job_info->selection_region)
-			cairo_region_destroy (job_info->selection_region);
-		job_info->selection_region =
-			ev_selection_get_selection_region (EV_SELECTION (pixbuf_cache->document),
-							   rc, job_info->selection_style,
-							   &(job_info->target_points));
-		job_info->selection_region_points = job_info->target_points;
-		job_info->selection_region_scale = scale;
-		g_object_unref (rc);
-		ev_document_doc_mutex_unlock ();
-	}
 	return job_info->selection_region && !cairo_region_is_empty(job_info->selection_region) ?
                 job_info->selection_region : NULL;
 }
@@ -1180,17 +3287,30 @@ static void
 update_job_selection (CacheJobInfo    *job_info,
 		      EvViewSelection *selection)
 {
-	job_info->points_set = TRUE;		
+	if (job_info->points_set &&
+	    job_info->selection_style == selection->style &&
+	    ev_rect_cmp (&job_info->target_points, &selection->rect) == 0)
+		return;
+
+	job_info->points_set = TRUE;
 	job_info->target_points = selection->rect;
 	job_info->selection_style = selection->style;
 }
 
 static void
-clear_job_selection (CacheJobInfo *job_info)
+clear_job_selection (CacheJobInfo  *job_info,
+		     EvPixbufCache *pixbuf_cache)
 {
 	job_info->points_set = FALSE;
 	job_info->selection_points.x1 = -1;
 
+	/* Nothing else to clear on pages that weren't selected */
+	if (!job_info->selection && !job_info->selection_region &&
+	    !job_info->selection_job && !job_info->selection_region_job)
+		return;
+
+	end_selection_jobs (job_info, pixbuf_cache);
+
 	if (job_info->selection) {
 		cairo_surface_destroy (job_info->selection);
 		job_info->selection = NULL;
@@ -1244,7 +3364,7 @@ ev_pixbuf_cache_set_selection_list (EvPixbufCache *pixbuf_cache,
 		if (selection)
 			update_job_selection (pixbuf_cache->prev_job + i, selection);
 		else
-			clear_job_selection (pixbuf_cache->prev_job + i);
+			clear_job_selection (pixbuf_cache->prev_job + i, pixbuf_cache);
 		page ++;
 	}
 
@@ -1263,7 +3383,7 @@ ev_pixbuf_cache_set_selection_list (EvPixbufCache *pixbuf_cache,
 		if (selection)
 			update_job_selection (pixbuf_cache->job_list + i, selection);
 		else
-			clear_job_selection (pixbuf_cache->job_list + i);
+			clear_job_selection (pixbuf_cache->job_list + i, pixbuf_cache);
 		page ++;
 	}
 
@@ -1284,7 +3404,7 @@ ev_pixbuf_cache_set_selection_list (EvPixbufCache *pixbuf_cache,
 		if (selection)
 			update_job_selection (pixbuf_cache->next_job + i, selection);
 		else
-			clear_job_selection (pixbuf_cache->next_job + i);
+			clear_job_selection (pixbuf_cache->next_job + i, pixbuf_cache);
 		page ++;
 	}
 }
@@ -1358,6 +3478,77 @@ ev_pixbuf_cache_get_selection_list (EvPixbufCache *pixbuf_cache)
 	return g_list_reverse (retval);
 }
 
+/* Renders again only the extents of region, to be drawn over the
+ * surface of the page, when the surface is the final render of the
+ * page at the current scale. Returns FALSE when the whole page has to
+ * be rendered again instead.
+ */
+static gboolean
+reload_page_area (EvPixbufCache  *pixbuf_cache,
+		  CacheJobInfo   *job_info,
+		  cairo_region_t *region,
+		  gint            page,
+		  gint            rotation,
+		  gdouble         scale,
+		  gint            width,
+		  gint            height)
+{
+	cairo_rectangle_int_t extents, area;
+	cairo_format_t        format;
+	gdouble               device_scale = job_info->device_scale;
+
+	if (!region || cairo_region_is_empty (region) ||
+	    !ev_document_can_render_area (pixbuf_cache->document) ||
+	    renders_layers (pixbuf_cache))
+		return FALSE;
+
+	if (!job_info->page_ready || job_info->draft || job_info->from_thumbnail ||
+	    job_info->job || !job_info->surface ||
+	    job_info->device_scale != get_device_scale (pixbuf_cache))
+		return FALSE;
+
+	/* Monochrome pages are kept as masks, which can't take a render */
+	format = cairo_image_surface_get_format (job_info->surface);
+	if (format != CAIRO_FORMAT_RGB24 && format != CAIRO_FORMAT_ARGB32)
+		return FALSE;
+
+	width = get_device_size (width, device_scale);
+	height = get_device_size (height, device_scale);
+	if (cairo_image_surface_get_width (job_info->surface) != width ||
+	    cairo_image_surface_get_height (job_info->surface) != height)
+		return FALSE;
+
+	/* With a pixel of margin for antialiased borders */
+	cairo_region_get_extents (region, &extents);
+	area.x = MAX (0, floor ((extents.x - 1) * device_scale));
+	area.y = MAX (0, floor ((extents.y - 1) * device_scale));
+	area.width = MIN (width, ceil ((extents.x + extents.width + 1) * device_scale)) - area.x;
+	area.height = MIN (height, ceil ((extents.y + extents.height + 1) * device_scale)) - area.y;
+	if (area.width <= 0 || area.height <= 0)
+		return FALSE;
+
+	/* A pending area is rendered again with the new one */
+	if (job_info->area_job) {
+		EvJobRender *job_render = EV_JOB_RENDER (job_info->area_job);
+
+		gdk_rectangle_union (&area, &job_render->area, &area);
+		end_area_job (job_info, pixbuf_cache);
+	}
+
+	job_info->area_job = ev_job_render_new (pixbuf_cache->document,
+						page, rotation,
+						scale * device_scale,
+						width, height);
+	ev_job_render_set_area (EV_JOB_RENDER (job_info->area_job), &area);
+	g_signal_connect (job_info->area_job, "finished",
+			  G_CALLBACK (area_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job_for_client (job_info->area_job, EV_JOB_PRIORITY_URGENT,
+					      pixbuf_cache->view);
+
+	return TRUE;
+}
+
 void
 ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 			     cairo_region_t *region,
@@ -1368,6 +3559,10 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 	CacheJobInfo *job_info;
         gint width, height;
 
+	/* Also when the page isn't in the cache, its archived render
+	 * would be restored when it's shown again */
+	ev_page_archive_remove (pixbuf_cache->archive, page);
+
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return;
@@ -1375,9 +3570,127 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
+
+	if (page_needs_tiles (pixbuf_cache, page, scale, rotation)) {
+		if (job_info->region)
+			cairo_region_destroy (job_info->region);
+		job_info->region = region ? cairo_region_reference (region) : NULL;
+
+		if (job_info->tiles &&
+		    job_info->tiles_scale == scale &&
+		    job_info->tiles_rotation == rotation) {
+			GHashTableIter iter;
+			gpointer       key, value;
+
+			/* Keep the old tiles on screen until the new ones are ready */
+			g_hash_table_iter_init (&iter, job_info->tiles);
+			while (g_hash_table_iter_next (&iter, &key, &value)) {
+				add_tile_job (pixbuf_cache, job_info, (CacheTile *)value,
+					      TILE_KEY_X (key), TILE_KEY_Y (key),
+					      width, height, page, rotation, scale,
+					      EV_JOB_PRIORITY_URGENT);
+			}
+		}
+
+		add_tile_jobs_if_needed (pixbuf_cache, job_info,
+					 page, rotation, scale,
+					 EV_JOB_PRIORITY_URGENT);
+		return;
+	}
+
+	if (reload_page_area (pixbuf_cache, job_info, region,
+			      page, rotation, scale, width, height))
+		return;
+
+	dispose_tiles (job_info, pixbuf_cache);
+	if (job_info->area_job)
+		end_area_job (job_info, pixbuf_cache);
         add_job (pixbuf_cache, job_info, region,
 		 width, height, page, rotation, scale,
 		 EV_JOB_PRIORITY_URGENT);
 }
 
 
+
+static void
+annotations_job_finished_cb (EvJob         *job,
+			     EvPixbufCache *pixbuf_cache)
+{
+	EvJobRender  *job_render = EV_JOB_RENDER (job);
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, job_render->page);
+	if (job_info == NULL || job_info->annotations_job != job)
+		return;
+
+	if (ev_job_is_failed (job)) {
+		end_annotations_job (job_info, pixbuf_cache);
+		return;
+	}
+
+	g_clear_pointer (&job_info->annotations, cairo_surface_destroy);
+	if (job_render->annotations) {
+		job_info->annotations = cairo_surface_reference (job_render->annotations);
+		set_device_scale_on_surface (job_info->annotations,
+					     get_render_scale (job_info->device_scale, FALSE));
+	}
+
+	end_annotations_job (job_info, pixbuf_cache);
+	emit_job_finished (pixbuf_cache, job_render->page, NULL);
+}
+
+/* Renders again the annotations of page after they changed. When the
+ * page is rendered in layers, only its annotations are rendered, and
+ * its content is kept. Otherwise region of the page is reloaded.
+ */
+void
+ev_pixbuf_cache_reload_annotations (EvPixbufCache  *pixbuf_cache,
+				    cairo_region_t *region,
+				    gint            page,
+				    gint            rotation,
+				    gdouble         scale)
+{
+	CacheJobInfo *job_info;
+	EvJobRender  *job_render;
+	gint          width, height;
+
+	/* Archived pages are rendered with their annotations */
+	ev_page_archive_remove (pixbuf_cache->archive, page);
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL)
+		return;
+
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale, rotation,
+					       &width, &height);
+	width = get_device_size (width, job_info->device_scale);
+	height = get_device_size (height, job_info->device_scale);
+
+	/* The content must be the final render of the page as it is now */
+	if (!renders_layers (pixbuf_cache) ||
+	    !job_info->page_ready || job_info->draft || job_info->from_thumbnail ||
+	    job_info->tiles || job_info->job || !job_info->surface ||
+	    job_info->device_scale != get_device_scale (pixbuf_cache) ||
+	    cairo_image_surface_get_width (job_info->surface) != width ||
+	    cairo_image_surface_get_height (job_info->surface) != height) {
+		ev_pixbuf_cache_reload_page (pixbuf_cache, region, page, rotation, scale);
+		return;
+	}
+
+	if (job_info->annotations_job)
+		end_annotations_job (job_info, pixbuf_cache);
+
+	job_info->annotations_job = ev_job_render_new (pixbuf_cache->document,
+						       page, rotation,
+						       scale * job_info->device_scale,
+						       width, height);
+	job_render = EV_JOB_RENDER (job_info->annotations_job);
+	ev_job_render_set_layer (job_render, EV_RENDER_LAYER_ANNOTATIONS);
+
+	g_signal_connect (job_info->annotations_job, "finished",
+			  G_CALLBACK (annotations_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job_for_client (job_info->annotations_job, EV_JOB_PRIORITY_URGENT,
+					      pixbuf_cache->view);
+}
@@ -53,31 +53,76 @@ struct _EvViewSelection {
 	EvSelectionStyle style;
 };
 
+/* Size of the tiles of pages too big to be rendered at once, in pixels
+ * at the scale of the view.
+ */
+#define EV_PIXBUF_CACHE_TILE_SIZE 256
+
 typedef struct _EvPixbufCache       EvPixbufCache;
 typedef struct _EvPixbufCacheClass  EvPixbufCacheClass;
 
+typedef gboolean (* EvPixbufCacheKeepPageFunc) (gint     page,
+						gpointer user_data);
+
 GType          ev_pixbuf_cache_get_type             (void) G_GNUC_CONST;
 EvPixbufCache *ev_pixbuf_cache_new                  (GtkWidget     *view,
 						     EvDocumentModel *model,
 						     gsize            max_size);
 void           ev_pixbuf_cache_set_max_size         (EvPixbufCache   *pixbuf_cache,
 						     gsize            max_size);
+void           ev_pixbuf_cache_set_size_limit       (EvPixbufCache   *pixbuf_cache,
+						     gsize            size_limit);
 void           ev_pixbuf_cache_set_page_range       (EvPixbufCache *pixbuf_cache,
 						     gint           start_page,
 						     gint           end_page,
 						     GList          *selection_list);
 cairo_surface_t *ev_pixbuf_cache_get_surface        (EvPixbufCache *pixbuf_cache,
 						     gint           page);
+cairo_surface_t *ev_pixbuf_cache_peek_surface       (EvPixbufCache *pixbuf_cache,
+						     gint           page);
+cairo_surface_t *ev_pixbuf_cache_get_annotations_surface (EvPixbufCache *pixbuf_cache,
+							  gint           page);
+gboolean       ev_pixbuf_cache_is_page_tiled        (EvPixbufCache *pixbuf_cache,
+						     gint           page);
+void           ev_pixbuf_cache_set_page_preview     (EvPixbufCache   *pixbuf_cache,
+						     gint             page,
+						     gint             rotation,
+						     cairo_surface_t *surface);
+cairo_surface_t *ev_pixbuf_cache_get_tile_surface   (EvPixbufCache *pixbuf_cache,
+						     gint           page,
+						     gint           tile_x,
+						     gint           tile_y);
 void           ev_pixbuf_cache_clear                (EvPixbufCache *pixbuf_cache);
+void           ev_pixbuf_cache_rotate               (EvPixbufCache *pixbuf_cache,
+						     gint           delta);
+void           ev_pixbuf_cache_set_document         (EvPixbufCache            *pixbuf_cache,
+						     EvDocument               *document,
+						     EvPixbufCacheKeepPageFunc keep_page,
+						     gpointer                  user_data);
 void           ev_pixbuf_cache_style_changed        (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_reload_page 	    (EvPixbufCache  *pixbuf_cache,
 						     cairo_region_t *region,
                     				     gint            page,
 			                             gint            rotation,
 						     gdouble         scale);
-void           ev_pixbuf_cache_set_inverted_colors  (EvPixbufCache *pixbuf_cache,
-						     gboolean       inverted_colors);
+void           ev_pixbuf_cache_reload_annotations   (EvPixbufCache  *pixbuf_cache,
+						     cairo_region_t *region,
+						     gint            page,
+						     gint            rotation,
+						     gdouble         scale);
+void           ev_pixbuf_cache_set_device_scale    (EvPixbufCache  *pixbuf_cache,
+						     gdouble         device_scale);
+void           ev_pixbuf_cache_set_render_pack_size (EvPixbufCache *pixbuf_cache,
+						      gsize          size);
+void           ev_pixbuf_cache_disable_render_pack  (EvPixbufCache *pixbuf_cache);
+void           ev_pixbuf_cache_prefetch_page       (EvPixbufCache  *pixbuf_cache,
+						     gint            page);
+void           ev_pixbuf_cache_set_pinned_pages    (EvPixbufCache  *pixbuf_cache,
+						     const gint     *pages,
+						     guint           n_pages);
 /* Selection */
+void           ev_pixbuf_cache_set_selection_region_only (EvPixbufCache *pixbuf_cache,
+							  gboolean       region_only);
 cairo_surface_t *ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 							gint             page,
 							gfloat           scale);
@@ -0,0 +1,201 @@
+/* ev-power-monitor.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <gio/gio.h>
+
+#include "ev-debug.h"
+#include "ev-power-monitor.h"
+
+#define UPOWER_NAME      "org.freedesktop.UPower"
+#define UPOWER_PATH      "/org/freedesktop/UPower"
+#define UPOWER_INTERFACE "org.freedesktop.UPower"
+
+/* The device saves power when it runs on battery, as told by UPower,
+ * or when the user picked the power saver profile.
+ */
+struct _EvPowerMonitor {
+	GObject               parent;
+
+	gboolean              on_battery;
+	gboolean              power_saver;
+	gboolean              power_saving;
+
+	GDBusProxy           *upower;
+
+#if GLIB_CHECK_VERSION (2, 70, 0)
+	GPowerProfileMonitor *profile_monitor;
+#endif
+};
+
+struct _EvPowerMonitorClass {
+	GObjectClass parent_class;
+};
+
+enum {
+	CHANGED,
+	N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+G_DEFINE_TYPE (EvPowerMonitor, ev_power_monitor, G_TYPE_OBJECT)
+
+static void
+ev_power_monitor_update (EvPowerMonitor *monitor)
+{
+	gboolean power_saving = monitor->on_battery || monitor->power_saver;
+
+	if (monitor->power_saving == power_saving)
+		return;
+
+	ev_debug_message (DEBUG_JOBS, "power saving %s (on battery: %d, power saver: %d)",
+			  power_saving ? "on" : "off", monitor->on_battery, monitor->power_saver);
+
+	monitor->power_saving = power_saving;
+	g_signal_emit (monitor, signals[CHANGED], 0);
+}
+
+static void
+ev_power_monitor_update_on_battery (EvPowerMonitor *monitor)
+{
+	GVariant *value;
+
+	value = g_dbus_proxy_get_cached_property (monitor->upower, "OnBattery");
+	if (value && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+		monitor->on_battery = g_variant_get_boolean (value);
+	else
+		monitor->on_battery = FALSE;
+	g_clear_pointer (&value, g_variant_unref);
+
+	ev_power_monitor_update (monitor);
+}
+
+static void
+upower_properties_changed_cb (GDBusProxy     *proxy,
+			      GVariant       *changed_properties,
+			      GStrv           invalidated_properties,
+			      EvPowerMonitor *monitor)
+{
+	ev_power_monitor_update_on_battery (monitor);
+}
+
+/* Without UPower, a desktop without battery most likely,
+ * the device is taken to be on AC */
+static void
+upower_proxy_ready_cb (GObject        *source,
+		       GAsyncResult   *result,
+		       EvPowerMonitor *monitor)
+{
+	GDBusProxy *proxy;
+	GError     *error = NULL;
+
+	proxy = g_dbus_proxy_new_for_bus_finish (result, &error);
+	if (!proxy) {
+		ev_debug_message (DEBUG_JOBS, "can't watch UPower: %s", error->message);
+		g_error_free (error);
+
+		return;
+	}
+
+	monitor->upower = proxy;
+	g_signal_connect (monitor->upower, "g-properties-changed",
+			  G_CALLBACK (upower_properties_changed_cb),
+			  monitor);
+	ev_power_monitor_update_on_battery (monitor);
+}
+
+#if GLIB_CHECK_VERSION (2, 70, 0)
+static void
+power_saver_enabled_changed_cb (GPowerProfileMonitor *profile_monitor,
+				GParamSpec           *pspec,
+				EvPowerMonitor       *monitor)
+{
+	monitor->power_saver = g_power_profile_monitor_get_power_saver_enabled (profile_monitor);
+	ev_power_monitor_update (monitor);
+}
+#endif
+
+static void
+ev_power_monitor_init (EvPowerMonitor *monitor)
+{
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+				  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+				  NULL,
+				  UPOWER_NAME,
+				  UPOWER_PATH,
+				  UPOWER_INTERFACE,
+				  NULL,
+				  (GAsyncReadyCallback) upower_proxy_ready_cb,
+				  monitor);
+
+#if GLIB_CHECK_VERSION (2, 70, 0)
+	monitor->profile_monitor = g_power_profile_monitor_dup_default ();
+	g_signal_connect (monitor->profile_monitor, "notify::power-saver-enabled",
+			  G_CALLBACK (power_saver_enabled_changed_cb),
+			  monitor);
+	power_saver_enabled_changed_cb (monitor->profile_monitor, NULL, monitor);
+#endif
+}
+
+static void
+ev_power_monitor_class_init (EvPowerMonitorClass *klass)
+{
+	signals[CHANGED] =
+		g_signal_new ("changed",
+			      EV_TYPE_POWER_MONITOR,
+			      G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+/*
+ * ev_power_monitor_get_default:
+ *
+ * Returns: (transfer none): the monitor of the power source and the
+ *   power profile of the device, created on first use from the main
+ *   thread. It's never destroyed.
+ */
+EvPowerMonitor *
+ev_power_monitor_get_default (void)
+{
+	static EvPowerMonitor *monitor = NULL;
+
+	if (G_UNLIKELY (!monitor))
+		monitor = g_object_new (EV_TYPE_POWER_MONITOR, NULL);
+
+	return monitor;
+}
+
+/*
+ * ev_power_monitor_get_power_saving:
+ * @monitor: an #EvPowerMonitor
+ *
+ * Returns: %TRUE while the device runs on battery or in the power
+ *   saver profile, when background work should be kept to a minimum
+ */
+gboolean
+ev_power_monitor_get_power_saving (EvPowerMonitor *monitor)
+{
+	g_return_val_if_fail (EV_IS_POWER_MONITOR (monitor), FALSE);
+
+	return monitor->power_saving;
+}
@@ -0,0 +1,43 @@
+/* ev-power-monitor.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_POWER_MONITOR_H
+#define EV_POWER_MONITOR_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_POWER_MONITOR         (ev_power_monitor_get_type ())
+#define EV_POWER_MONITOR(object)      (G_TYPE_CHECK_INSTANCE_CAST ((object), EV_TYPE_POWER_MONITOR, EvPowerMonitor))
+#define EV_IS_POWER_MONITOR(object)   (G_TYPE_CHECK_INSTANCE_TYPE ((object), EV_TYPE_POWER_MONITOR))
+
+typedef struct _EvPowerMonitor      EvPowerMonitor;
+typedef struct _EvPowerMonitorClass EvPowerMonitorClass;
+
+GType           ev_power_monitor_get_type         (void) G_GNUC_CONST;
+EvPowerMonitor *ev_power_monitor_get_default      (void);
+gboolean        ev_power_monitor_get_power_saving (EvPowerMonitor *monitor);
+
+G_END_DECLS
+
+#endif /* EV_POWER_MONITOR_H */
@@ -410,6 +410,18 @@ struct _EvPrintOperationExport {
 	gchar *job_name;
 	gboolean embed_page_setup;
 
+	/* Sheets are sent to the printer in chunks, each one while
+	 * the next is exported, instead of all at the end */
+	gboolean spool_chunks;
+	gint n_chunk_sheets;
+	gint n_spooled_jobs;
+	gboolean finished;
+
+	/* Pages rendered ahead on other threads, by exporters that
+	 * can render pages, indexed by page number */
+	GHashTable *prerender_jobs;
+	EvJob *waiting_job;
+
 	guint idle_id;
 	
 	/* Context */
@@ -434,6 +446,13 @@ struct _EvPrintOperationExportClass {
 
 G_DEFINE_TYPE (EvPrintOperationExport, ev_print_operation_export, EV_TYPE_PRINT_OPERATION)
 
+/* Sheets of each file sent to the printer when spooling in chunks.
+ * Even, so that duplex printing isn't affected */
+#define EV_PRINT_SPOOL_CHUNK_SHEETS 32
+
+/* Pages rendered ahead of the one being exported */
+#define EV_PRINT_PRERENDER_PAGES 8
+
 /* Internal print queue */
 static GHashTable *print_queue = NULL;
 
@@ -735,7 +754,7 @@ export_print_inc_page (EvPrintOperationExport *export)
 				    (export->page_count - 1) % export->pages_per_sheet != 0) {
 
 					EvPrintOperation *op = EV_PRINT_OPERATION (export);
-					ev_document_doc_mutex_lock ();
+					ev_document_lock (op->document);
 
 					/* keep track of all blanks but only actualise those
 					 * which are in the current odd / even sheet set */
@@ -745,8 +764,9 @@ export_print_inc_page (EvPrintOperationExport *export)
 						(export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 						(export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1) ) {
 						ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
+						export->n_chunk_sheets++;
 					}
-					ev_document_doc_mutex_unlock ();
+					ev_document_unlock (op->document);
 					export->sheet = 1 + (export->page_count - 1) / export->pages_per_sheet;
 				}
 
@@ -795,6 +815,88 @@ ev_print_operation_export_run_next (EvPrintOperationExport *export)
 		ev_print_operation_export_begin (EV_PRINT_OPERATION_EXPORT (next));
 }
 
+static void export_stop (EvPrintOperationExport *export);
+
+static void
+prerender_job_free (EvJob *job)
+{
+	if (!ev_job_is_finished (job))
+		ev_job_cancel (job);
+	g_object_unref (job);
+}
+
+static void prerender_job_finished (EvJob                  *job,
+				    EvPrintOperationExport *export);
+
+static void
+ev_print_operation_export_clear_prerender (EvPrintOperationExport *export)
+{
+	if (export->waiting_job) {
+		g_signal_handlers_disconnect_by_func (export->waiting_job,
+						      prerender_job_finished,
+						      export);
+		g_object_unref (export->waiting_job);
+		export->waiting_job = NULL;
+	}
+
+	if (export->prerender_jobs) {
+		g_hash_table_destroy (export->prerender_jobs);
+		export->prerender_jobs = NULL;
+	}
+}
+
+/* Makes sure the current page and the ones following it are being
+ * rendered, and drops the ones already exported. Pages are walked in
+ * export order, without going over to the next copy.
+ */
+static void
+ev_print_operation_export_prerender (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	GHashTable       *window;
+	GHashTableIter    iter;
+	gpointer          key;
+	gint              page, range, end;
+	gint              i;
+
+	window = g_hash_table_new (NULL, NULL);
+
+	page = export->page;
+	range = export->range;
+	end = export->end;
+	for (i = 0; i < EV_PRINT_PRERENDER_PAGES; i++) {
+		GtkPageRange *r;
+
+		g_hash_table_add (window, GINT_TO_POINTER (page));
+		if (!g_hash_table_contains (export->prerender_jobs, GINT_TO_POINTER (page))) {
+			EvJob *job;
+
+			job = ev_job_export_render_new (op->document, page);
+			g_hash_table_insert (export->prerender_jobs, GINT_TO_POINTER (page), job);
+			ev_job_scheduler_push_job (job, EV_JOB_PRIORITY_NONE);
+		}
+
+		page += export->inc;
+		if (page != end)
+			continue;
+
+		range += export->inc;
+		if (range < 0 || range >= export->n_ranges)
+			break;
+
+		r = &export->ranges[range];
+		page = export->inc < 0 ? r->end : r->start;
+		end = export->inc < 0 ? r->start - 1 : r->end + 1;
+	}
+
+	g_hash_table_iter_init (&iter, export->prerender_jobs);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (!g_hash_table_contains (window, key))
+			g_hash_table_iter_remove (&iter);
+	}
+	g_hash_table_destroy (window);
+}
+
 static void
 gtk_print_job_finished (GtkPrintJob            *print_job,
 			EvPrintOperationExport *export,
@@ -802,38 +904,47 @@ gtk_print_job_finished (GtkPrintJob            *print_job,
 {
 	EvPrintOperation *op = EV_PRINT_OPERATION (export);
 
-	if (error) {
+	/* The spool file of the job is removed with it */
+	export->n_spooled_jobs--;
+	g_object_unref (print_job);
+
+	if (error && !export->error) {
 		g_set_error_literal (&export->error,
 				     GTK_PRINT_ERROR,
 				     GTK_PRINT_ERROR_GENERAL,
 				     error->message);
-		g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_ERROR);
-	} else {
-		g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_APPLY);
+
+		/* Don't export the chunks that can't be printed */
+		if (export->temp_file)
+			export_stop (export);
 	}
 
-	ev_print_operation_export_clear_temp_file (export);
-	g_object_unref (print_job);
+	/* Done when the whole document has been printed */
+	if (export->finished || export->n_spooled_jobs > 0 || export->temp_file)
+		return;
+
+	export->finished = TRUE;
+	g_signal_emit (op, signals[DONE], 0,
+		       export->error ?
+		       GTK_PRINT_OPERATION_RESULT_ERROR :
+		       GTK_PRINT_OPERATION_RESULT_APPLY);
 
 	ev_print_operation_export_run_next (export);
 }
 
-static void
-export_print_done (EvPrintOperationExport *export)
+/* Some printers take into account some print settings,
+ * and others don't. However we have exported the document
+ * to a ps or pdf file according to such print settings. So,
+ * we want to send the exported file to printer with those
+ * settings set to default values.
+ */
+static GtkPrintSettings *
+ev_print_operation_export_get_job_settings (EvPrintOperationExport *export)
 {
 	EvPrintOperation *op = EV_PRINT_OPERATION (export);
 	GtkPrintSettings *settings;
 	EvFileExporterCapabilities capabilities;
-	GError *error = NULL;
 
-	g_assert (export->temp_file != NULL);
-	
-	/* Some printers take into account some print settings,
-	 * and others don't. However we have exported the document
-	 * to a ps or pdf file according to such print settings. So,
-	 * we want to send the exported file to printer with those
-	 * settings set to default values.
-	 */
 	settings = gtk_print_settings_copy (export->print_settings);
 	capabilities = ev_file_exporter_get_capabilities (EV_FILE_EXPORTER (op->document));
 
@@ -854,86 +965,234 @@ export_print_done (EvPrintOperationExport *export)
 		gtk_print_settings_set_int (settings, "cups-"GTK_PRINT_SETTINGS_NUMBER_UP, 1);
 	}
 
-	if (op->print_preview) {
-		GKeyFile *key_file;
-		gchar    *data = NULL;
-		gsize     data_len;
-		gchar    *print_settings_file = NULL;
-
-		key_file = g_key_file_new ();
-
-		gtk_print_settings_to_key_file (settings, key_file, NULL);
-		gtk_page_setup_to_key_file (export->page_setup, key_file, NULL);
-		g_key_file_set_string (key_file, "Print Job", "title", export->job_name);
-
-		data = g_key_file_to_data (key_file, &data_len, &error);
-		if (data) {
-			gint fd;
-			
-			fd = g_file_open_tmp ("print-settingsXXXXXX", &print_settings_file, &error);
-			if (!error)
-				g_file_set_contents (print_settings_file, data, data_len, &error);
-			close (fd);
-			
-			g_free (data);
+	return settings;
+}
+
+/* Chunks are printed as separate jobs, so the document can only be
+ * split when the printer has nothing to apply to it as a whole */
+static gboolean
+ev_print_operation_export_can_spool_chunks (EvPrintOperationExport *export)
+{
+	GtkPrintSettings *settings;
+	gboolean          retval;
+
+	if (EV_PRINT_OPERATION (export)->print_preview)
+		return FALSE;
+
+	settings = ev_print_operation_export_get_job_settings (export);
+	retval = gtk_print_settings_get_n_copies (settings) <= 1 &&
+		gtk_print_settings_get_page_set (settings) == GTK_PAGE_SET_ALL &&
+		!gtk_print_settings_get_reverse (settings) &&
+		gtk_print_settings_get_number_up (settings) <= 1;
+	g_object_unref (settings);
+
+	return retval;
+}
+
+static void
+spool_file_free (gchar *filename)
+{
+	g_unlink (filename);
+	g_free (filename);
+}
+
+/* Sends the exported file to the printer. The file belongs to the
+ * print job from now on */
+static gboolean
+ev_print_operation_export_send (EvPrintOperationExport *export,
+				GError                **error)
+{
+	GtkPrintSettings *settings;
+	GtkPrintJob      *job;
+
+	settings = ev_print_operation_export_get_job_settings (export);
+	job = gtk_print_job_new (export->job_name,
+				 export->printer,
+				 settings,
+				 export->page_setup);
+	g_object_unref (settings);
+
+	if (!gtk_print_job_set_source_file (job, export->temp_file, error)) {
+		g_object_unref (job);
+
+		return FALSE;
+	}
+
+	g_object_set_data_full (G_OBJECT (job), "ev-spool-file",
+				export->temp_file,
+				(GDestroyNotify) spool_file_free);
+	export->temp_file = NULL;
+
+	export->n_spooled_jobs++;
+	gtk_print_job_send (job,
+			    (GtkPrintJobCompleteFunc)gtk_print_job_finished,
+			    g_object_ref (export),
+			    (GDestroyNotify)g_object_unref);
+
+	return TRUE;
+}
+
+static gboolean
+ev_print_operation_export_open_temp_file (EvPrintOperationExport *export,
+					  GError                **error)
+{
+	gchar *filename;
+
+	filename = g_strdup_printf ("evince_print.%s.XXXXXX",
+				    export->fc.format == EV_FILE_FORMAT_PDF ? "pdf" : "ps");
+	export->fd = g_file_open_tmp (filename, &export->temp_file, error);
+	g_free (filename);
+
+	export->fc.filename = export->temp_file;
+
+	return export->fd > -1;
+}
+
+/* Sends the sheets exported so far to the printer, and goes on
+ * exporting the next ones to a new file */
+static gboolean
+ev_print_operation_export_spool_chunk (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	GError           *error = NULL;
+
+	ev_document_lock (op->document);
+	ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
+	ev_document_unlock (op->document);
+
+	close (export->fd);
+	export->fd = -1;
+
+	if (!ev_print_operation_export_send (export, &error) ||
+	    !ev_print_operation_export_open_temp_file (export, &error)) {
+		g_set_error_literal (&export->error,
+				     GTK_PRINT_ERROR,
+				     GTK_PRINT_ERROR_GENERAL,
+				     error->message);
+		g_error_free (error);
+		export_stop (export);
+
+		/* Sent chunks report the error when they are done */
+		if (export->n_spooled_jobs == 0) {
+			export->finished = TRUE;
+			g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_ERROR);
+			ev_print_operation_export_run_next (export);
 		}
 
-		g_key_file_free (key_file);
+		return FALSE;
+	}
 
-		if (!error) {
-			gchar  *cmd;
-			gchar  *quoted_filename;
-			gchar  *quoted_settings_filename;
-                        GAppInfo *app;
-                        GdkAppLaunchContext *ctx;
+	ev_document_lock (op->document);
+	ev_file_exporter_begin (EV_FILE_EXPORTER (op->document), &export->fc);
+	ev_document_unlock (op->document);
 
-			quoted_filename = g_shell_quote (export->temp_file);
-			quoted_settings_filename = g_shell_quote (print_settings_file);
-			cmd = g_strdup_printf ("evince-previewer --unlink-tempfile --print-settings %s %s",
-					       quoted_settings_filename, quoted_filename);
+	export->n_chunk_sheets = 0;
 
-			g_free (quoted_filename);
-			g_free (quoted_settings_filename);
+	return TRUE;
+}
 
-			app = g_app_info_create_from_commandline (cmd, NULL, 0, &error);
+/* Runs the previewer on @filename with the print settings. @option
+ * tells what the file is: the exported file, which the previewer
+ * deletes, or the document itself, laid out by the previewer. */
+static gboolean
+ev_print_operation_export_run_previewer (EvPrintOperationExport *export,
+					 GtkPrintSettings       *settings,
+					 const gchar            *option,
+					 const gchar            *filename,
+					 GError                **error)
+{
+	GKeyFile *key_file;
+	gchar    *data = NULL;
+	gsize     data_len;
+	gchar    *print_settings_file = NULL;
+	GError   *tmp_error = NULL;
+
+	key_file = g_key_file_new ();
+
+	gtk_print_settings_to_key_file (settings, key_file, NULL);
+	gtk_page_setup_to_key_file (export->page_setup, key_file, NULL);
+	g_key_file_set_string (key_file, "Print Job", "title", export->job_name);
+
+	data = g_key_file_to_data (key_file, &data_len, &tmp_error);
+	if (data) {
+		gint fd;
+
+		fd = g_file_open_tmp ("print-settingsXXXXXX", &print_settings_file, &tmp_error);
+		if (!tmp_error)
+			g_file_set_contents (print_settings_file, data, data_len, &tmp_error);
+		close (fd);
+
+		g_free (data);
+	}
 
-			if (app != NULL) {
-				ctx = gdk_display_get_app_launch_context (gtk_widget_get_display (GTK_WIDGET (export->parent_window)));
-				gdk_app_launch_context_set_screen (ctx, gtk_window_get_screen (export->parent_window));
+	g_key_file_free (key_file);
 
-				g_app_info_launch (app, NULL, G_APP_LAUNCH_CONTEXT (ctx), &error);
+	if (!tmp_error) {
+		gchar  *cmd;
+		gchar  *quoted_filename;
+		gchar  *quoted_settings_filename;
+		GAppInfo *app;
+		GdkAppLaunchContext *ctx;
 
-				g_object_unref (app);
-				g_object_unref (ctx);
-                        }
+		quoted_filename = g_shell_quote (filename);
+		quoted_settings_filename = g_shell_quote (print_settings_file);
+		cmd = g_strdup_printf ("evince-previewer %s --print-settings %s %s",
+				       option, quoted_settings_filename, quoted_filename);
 
-			g_free (cmd);
-                }
+		g_free (quoted_filename);
+		g_free (quoted_settings_filename);
 
-		if (error) {
-			if (print_settings_file)
-				g_unlink (print_settings_file);
-			g_free (print_settings_file);
-		} else {
+		app = g_app_info_create_from_commandline (cmd, NULL, 0, &tmp_error);
+
+		if (app != NULL) {
+			ctx = gdk_display_get_app_launch_context (gtk_widget_get_display (GTK_WIDGET (export->parent_window)));
+			gdk_app_launch_context_set_screen (ctx, gtk_window_get_screen (export->parent_window));
+
+			g_app_info_launch (app, NULL, G_APP_LAUNCH_CONTEXT (ctx), &tmp_error);
+
+			g_object_unref (app);
+			g_object_unref (ctx);
+		}
+
+		g_free (cmd);
+	}
+
+	if (tmp_error) {
+		if (print_settings_file)
+			g_unlink (print_settings_file);
+		g_free (print_settings_file);
+		g_propagate_error (error, tmp_error);
+
+		return FALSE;
+	}
+
+	/* print_settings_file will be deleted by the previewer */
+	g_free (print_settings_file);
+
+	return TRUE;
+}
+
+static void
+export_print_done (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	GtkPrintSettings *settings;
+	GError *error = NULL;
+
+	g_assert (export->temp_file != NULL);
+
+	settings = ev_print_operation_export_get_job_settings (export);
+
+	if (op->print_preview) {
+		if (ev_print_operation_export_run_previewer (export, settings, "--unlink-tempfile",
+							     export->temp_file, &error)) {
 			g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_APPLY);
 			/* temp_file will be deleted by the previewer */
 
 			ev_print_operation_export_run_next (export);
 		}
 	} else {
-		GtkPrintJob *job;
-		
-		job = gtk_print_job_new (export->job_name,
-					 export->printer,
-					 settings,
-					 export->page_setup);
-		gtk_print_job_set_source_file (job, export->temp_file, &error);
-		if (!error){
-			gtk_print_job_send (job,
-					    (GtkPrintJobCompleteFunc)gtk_print_job_finished,
-					    g_object_ref (export),
-					    (GDestroyNotify)g_object_unref);
-		}
+		ev_print_operation_export_send (export, &error);
 	}
 	g_object_unref (settings);
 
@@ -944,6 +1203,12 @@ export_print_done (EvPrintOperationExport *export)
 				     error->message);
 		g_error_free (error);
 		ev_print_operation_export_clear_temp_file (export);
+
+		/* Sent chunks report the error when they are done */
+		if (export->n_spooled_jobs > 0)
+			return;
+
+		export->finished = TRUE;
 		g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_ERROR);
 
 		ev_print_operation_export_run_next (export);
@@ -968,9 +1233,10 @@ export_job_finished (EvJobExport            *job,
 	   ( export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0 ) ||
 	   ( export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1 ) ) ) ) {
 
-		ev_document_doc_mutex_lock ();
+		ev_document_lock (op->document);
 		ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (op->document);
+		export->n_chunk_sheets++;
 	}
 
 	/* Reschedule */
@@ -987,11 +1253,10 @@ export_job_cancelled (EvJobExport            *job,
 	export_cancel (export);
 }
 
+/* Stops exporting, the chunks already sent are still printed */
 static void
-export_cancel (EvPrintOperationExport *export)
+export_stop (EvPrintOperationExport *export)
 {
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
-
 	if (export->idle_id > 0)
 		g_source_remove (export->idle_id);
 	export->idle_id = 0;
@@ -1006,6 +1271,8 @@ export_cancel (EvPrintOperationExport *export)
 		g_object_unref (export->job_export);
 		export->job_export = NULL;
 	}
+
+	ev_print_operation_export_clear_prerender (export);
 	
 	if (export->fd != -1) {
 		close (export->fd);
@@ -1013,7 +1280,16 @@ export_cancel (EvPrintOperationExport *export)
 	}
 
 	ev_print_operation_export_clear_temp_file (export);
+}
+
+static void
+export_cancel (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+
+	export_stop (export);
 
+	export->finished = TRUE;
 	g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_CANCEL);
 
 	ev_print_operation_export_run_next (export);
@@ -1029,6 +1305,54 @@ update_progress (EvPrintOperationExport *export)
 					  export->total / (gdouble)export->n_pages_to_print);
 }
 
+/* Exports the current page, once it has been rendered
+ * when it's rendered ahead */
+static void
+export_push_page (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	EvJob            *prerender = NULL;
+
+	if (export->prerender_jobs) {
+		ev_print_operation_export_prerender (export);
+		prerender = g_hash_table_lookup (export->prerender_jobs,
+						 GINT_TO_POINTER (export->page));
+		if (!ev_job_is_finished (prerender)) {
+			export->waiting_job = g_object_ref (prerender);
+			g_signal_connect (prerender, "finished",
+					  G_CALLBACK (prerender_job_finished),
+					  (gpointer)export);
+			return;
+		}
+	}
+
+	if (!export->job_export) {
+		export->job_export = ev_job_export_new (op->document);
+		g_signal_connect (export->job_export, "finished",
+				  G_CALLBACK (export_job_finished),
+				  (gpointer)export);
+		g_signal_connect (export->job_export, "cancelled",
+				  G_CALLBACK (export_job_cancelled),
+				  (gpointer)export);
+	}
+
+	ev_job_export_set_page (EV_JOB_EXPORT (export->job_export), export->page);
+	/* Failed renders are exported the usual way */
+	ev_job_export_set_rendered_page (EV_JOB_EXPORT (export->job_export),
+					 prerender ? EV_JOB_EXPORT_RENDER (prerender)->surface : NULL);
+	ev_job_scheduler_push_job (export->job_export, EV_JOB_PRIORITY_NONE);
+}
+
+static void
+prerender_job_finished (EvJob                  *job,
+			EvPrintOperationExport *export)
+{
+	g_signal_handlers_disconnect_by_func (job, prerender_job_finished, export);
+	g_clear_object (&export->waiting_job);
+
+	export_push_page (export);
+}
+
 static gboolean
 export_print_page (EvPrintOperationExport *export)
 {
@@ -1049,9 +1373,11 @@ export_print_page (EvPrintOperationExport *export)
 	if (export->collated == export->collated_copies) {
 		export->collated = 0;
 		if (!export_print_inc_page (export)) {
-			ev_document_doc_mutex_lock ();
+			ev_print_operation_export_clear_prerender (export);
+
+			ev_document_lock (op->document);
 			ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-			ev_document_doc_mutex_unlock ();
+			ev_document_unlock (op->document);
 
 			close (export->fd);
 			export->fd = -1;
@@ -1076,9 +1402,11 @@ export_print_page (EvPrintOperationExport *export)
 				export->collated = 0;
 
 				if (!export_print_inc_page (export)) {
-					ev_document_doc_mutex_lock ();
+					ev_print_operation_export_clear_prerender (export);
+
+					ev_document_lock (op->document);
 					ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-					ev_document_doc_mutex_unlock ();
+					ev_document_unlock (op->document);
 
 					close (export->fd);
 					export->fd = -1;
@@ -1100,23 +1428,17 @@ export_print_page (EvPrintOperationExport *export)
 	    (export->page_set == GTK_PAGE_SET_ALL ||
 	    (export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 	    (export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1)))) {
-		ev_document_doc_mutex_lock ();
-		ev_file_exporter_begin_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
-	}
+		if (export->spool_chunks &&
+		    export->n_chunk_sheets >= EV_PRINT_SPOOL_CHUNK_SHEETS &&
+		    !ev_print_operation_export_spool_chunk (export))
+			return FALSE;
 
-	if (!export->job_export) {
-		export->job_export = ev_job_export_new (op->document);
-		g_signal_connect (export->job_export, "finished",
-				  G_CALLBACK (export_job_finished),
-				  (gpointer)export);
-		g_signal_connect (export->job_export, "cancelled",
-				  G_CALLBACK (export_job_cancelled),
-				  (gpointer)export);
+		ev_document_lock (op->document);
+		ev_file_exporter_begin_page (EV_FILE_EXPORTER (op->document));
+		ev_document_unlock (op->document);
 	}
 
-	ev_job_export_set_page (EV_JOB_EXPORT (export->job_export), export->page);
-	ev_job_scheduler_push_job (export->job_export, EV_JOB_PRIORITY_NONE);
+	export_push_page (export);
 
 	update_progress (export);
 	
@@ -1131,9 +1453,9 @@ ev_print_operation_export_begin (EvPrintOperationExport *export)
 	if (!export->temp_file)
 		return; /* cancelled */
 	
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (op->document);
 	ev_file_exporter_begin (EV_FILE_EXPORTER (op->document), &export->fc);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (op->document);
 
 	export->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
 					   (GSourceFunc)export_print_page,
@@ -1163,6 +1485,63 @@ get_file_exporter_format (EvFileExporter   *exporter,
 	return format;
 }
 
+/* An unmodified local document is previewed from its own file, the
+ * previewer lays the pages out on the sheets as they are shown, so
+ * that nothing has to be exported first. Returns FALSE when the
+ * document has to be exported to be previewed.
+ */
+static gboolean
+ev_print_operation_export_preview_source (EvPrintOperationExport *export,
+					  GtkDialog              *dialog)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	EvDocument       *document = op->document;
+	GtkPrintSettings *settings;
+	const gchar      *uri;
+	gchar            *path;
+	GError           *error = NULL;
+
+	if (ev_document_get_modified (document))
+		return FALSE;
+
+	/* The previewer couldn't open it without the password */
+	if (EV_IS_DOCUMENT_SECURITY (document) &&
+	    ev_document_security_has_document_security (EV_DOCUMENT_SECURITY (document)))
+		return FALSE;
+
+	uri = ev_document_get_uri (document);
+	path = uri ? g_filename_from_uri (uri, NULL, NULL) : NULL;
+	if (!path)
+		return FALSE;
+
+	settings = gtk_print_settings_copy (export->print_settings);
+	if (gtk_print_settings_get_print_pages (settings) == GTK_PRINT_PAGES_CURRENT) {
+		GtkPageRange range;
+
+		range.start = range.end = gtk_print_unix_dialog_get_current_page (GTK_PRINT_UNIX_DIALOG (dialog));
+		gtk_print_settings_set_print_pages (settings, GTK_PRINT_PAGES_RANGES);
+		gtk_print_settings_set_page_ranges (settings, &range, 1);
+	}
+
+	if (!ev_print_operation_export_run_previewer (export, settings, "--print-source",
+						      path, &error)) {
+		g_warning ("Failed to preview %s, exporting it: %s", uri, error->message);
+		g_error_free (error);
+		g_object_unref (settings);
+		g_free (path);
+
+		return FALSE;
+	}
+
+	g_object_unref (settings);
+	g_free (path);
+
+	gtk_widget_destroy (GTK_WIDGET (dialog));
+	g_signal_emit (op, signals[DONE], 0, GTK_PRINT_OPERATION_RESULT_APPLY);
+
+	return TRUE;
+}
+
 static void
 ev_print_operation_export_print_dialog_response_cb (GtkDialog              *dialog,
 						    gint                    response,
@@ -1177,7 +1556,6 @@ ev_print_operation_export_print_dialog_response_cb (GtkDialog              *dial
 	gdouble               height;
 	gint                  first_page;
 	gint                  last_page;
-	gchar                *filename;
 	GError               *error = NULL;
 	EvPrintOperation     *op = EV_PRINT_OPERATION (export);
 	EvFileExporterFormat  format;
@@ -1201,6 +1579,9 @@ ev_print_operation_export_print_dialog_response_cb (GtkDialog              *dial
 	page_setup = gtk_print_unix_dialog_get_page_setup (GTK_PRINT_UNIX_DIALOG (dialog));
 	ev_print_operation_export_set_default_page_setup (op, page_setup);
 
+	if (op->print_preview && ev_print_operation_export_preview_source (export, dialog))
+		return;
+
 	format = get_file_exporter_format (EV_FILE_EXPORTER (op->document),
 					   print_settings);
 
@@ -1217,10 +1598,8 @@ ev_print_operation_export_print_dialog_response_cb (GtkDialog              *dial
 		return;
 	}
 
-	filename = g_strdup_printf ("evince_print.%s.XXXXXX", format == EV_FILE_FORMAT_PDF ? "pdf" : "ps");
-	export->fd = g_file_open_tmp (filename, &export->temp_file, &error);
-	g_free (filename);
-	if (export->fd <= -1) {
+	export->fc.format = format;
+	if (!ev_print_operation_export_open_temp_file (export, &error)) {
 		gtk_widget_destroy (GTK_WIDGET (dialog));
 		
 		g_set_error_literal (&export->error,
@@ -1322,8 +1701,6 @@ ev_print_operation_export_print_dialog_response_cb (GtkDialog              *dial
 
 	get_first_and_last_page (export, &first_page, &last_page);
 
-	export->fc.format = format;
-	export->fc.filename = export->temp_file;
 	export->fc.first_page = MIN (first_page, last_page);
 	export->fc.last_page = MAX (first_page, last_page);
 	export->fc.paper_width = width;
@@ -1331,6 +1708,16 @@ ev_print_operation_export_print_dialog_response_cb (GtkDialog              *dial
 	export->fc.duplex = FALSE;
 	export->fc.pages_per_sheet = export->pages_per_sheet;
 
+	export->spool_chunks = ev_print_operation_export_can_spool_chunks (export);
+
+	/* Skipped pages of odd or even sheets aren't known ahead */
+	if (export->page_set == GTK_PAGE_SET_ALL &&
+	    (ev_file_exporter_get_capabilities (EV_FILE_EXPORTER (op->document)) &
+	     EV_FILE_EXPORTER_CAN_RENDER_PAGES)) {
+		export->prerender_jobs = g_hash_table_new_full (NULL, NULL, NULL,
+								(GDestroyNotify) prerender_job_free);
+	}
+
 	if (ev_print_queue_is_empty (op->document))
 		ev_print_operation_export_begin (export);
 
@@ -1359,7 +1746,8 @@ ev_print_operation_export_run (EvPrintOperation *op,
 	gtk_window_set_modal (GTK_WINDOW (dialog), TRUE);
 	
 	capabilities = GTK_PRINT_CAPABILITY_PREVIEW |
-		ev_file_exporter_get_capabilities (EV_FILE_EXPORTER (op->document));
+		(ev_file_exporter_get_capabilities (EV_FILE_EXPORTER (op->document)) &
+		 ~EV_FILE_EXPORTER_CAN_RENDER_PAGES);
 	gtk_print_unix_dialog_set_manual_capabilities (GTK_PRINT_UNIX_DIALOG (dialog),
 						       capabilities);
 
@@ -1468,6 +1856,8 @@ ev_print_operation_export_finalize (GObject *object)
 		export->job_export = NULL;
 	}
 
+	ev_print_operation_export_clear_prerender (export);
+
 	if (export->error) {
 		g_error_free (export->error);
 		export->error = NULL;
@@ -1572,6 +1962,10 @@ struct _EvPrintOperationPrint {
 	EvJob             *job_print;
 	gchar             *job_name;
 
+	/* Preview page being recorded by job_print */
+	cairo_surface_t   *preview_page;
+	cairo_t           *preview_cr;
+
         /* Page handling tab */
         GtkWidget   *scale_combo;
         EvPrintScale page_scale;
@@ -1587,6 +1981,83 @@ struct _EvPrintOperationPrintClass {
 
 G_DEFINE_TYPE (EvPrintOperationPrint, ev_print_operation_print, EV_TYPE_PRINT_OPERATION)
 
+/* Pages drawn for print previews are recorded and kept with the
+ * document, so that previewing again only replays them, whatever
+ * the page setup, scaling or any other option. A page is recorded
+ * untransformed, so it's the only key needed.
+ */
+#define EV_PRINT_PREVIEW_CACHE_KEY   "ev-print-preview-cache"
+#define EV_PRINT_PREVIEW_CACHE_PAGES 32
+
+typedef struct {
+	GHashTable *pages; /* page -> recording surface */
+	GQueue      lru;   /* pages, most recently used first */
+} EvPrintPreviewCache;
+
+static void
+ev_print_preview_cache_free (EvPrintPreviewCache *cache)
+{
+	g_hash_table_destroy (cache->pages);
+	g_queue_clear (&cache->lru);
+	g_free (cache);
+}
+
+/* Pages can't be reused once the document has been modified,
+ * since there is no way to know which ones changed.
+ */
+static EvPrintPreviewCache *
+ev_print_preview_cache_get (EvDocument *document)
+{
+	EvPrintPreviewCache *cache;
+
+	if (ev_document_get_modified (document)) {
+		g_object_set_data (G_OBJECT (document), EV_PRINT_PREVIEW_CACHE_KEY, NULL);
+		return NULL;
+	}
+
+	cache = g_object_get_data (G_OBJECT (document), EV_PRINT_PREVIEW_CACHE_KEY);
+	if (cache)
+		return cache;
+
+	cache = g_new0 (EvPrintPreviewCache, 1);
+	cache->pages = g_hash_table_new_full (NULL, NULL, NULL,
+					      (GDestroyNotify) cairo_surface_destroy);
+	g_queue_init (&cache->lru);
+	g_object_set_data_full (G_OBJECT (document), EV_PRINT_PREVIEW_CACHE_KEY,
+				cache, (GDestroyNotify) ev_print_preview_cache_free);
+
+	return cache;
+}
+
+static cairo_surface_t *
+ev_print_preview_cache_lookup (EvPrintPreviewCache *cache,
+			       gint                 page)
+{
+	cairo_surface_t *surface;
+
+	surface = g_hash_table_lookup (cache->pages, GINT_TO_POINTER (page));
+	if (surface) {
+		g_queue_remove (&cache->lru, GINT_TO_POINTER (page));
+		g_queue_push_head (&cache->lru, GINT_TO_POINTER (page));
+	}
+
+	return surface;
+}
+
+static void
+ev_print_preview_cache_insert (EvPrintPreviewCache *cache,
+			       gint                 page,
+			       cairo_surface_t     *surface)
+{
+	if (!g_hash_table_contains (cache->pages, GINT_TO_POINTER (page)))
+		g_queue_push_head (&cache->lru, GINT_TO_POINTER (page));
+	g_hash_table_insert (cache->pages, GINT_TO_POINTER (page),
+			     cairo_surface_reference (surface));
+
+	while (g_queue_get_length (&cache->lru) > EV_PRINT_PREVIEW_CACHE_PAGES)
+		g_hash_table_remove (cache->pages, g_queue_pop_tail (&cache->lru));
+}
+
 static void
 ev_print_operation_print_set_current_page (EvPrintOperation *op,
 					   gint              current_page)
@@ -1741,24 +2212,52 @@ ev_print_operation_print_status_changed (EvPrintOperationPrint *print)
 }
 
 static void
-print_job_finished (EvJobPrint            *job,
-		    EvPrintOperationPrint *print)
+ev_print_operation_print_page_drawn (EvPrintOperationPrint *print)
 {
 	EvPrintOperation *op = EV_PRINT_OPERATION (print);
 
-	gtk_print_operation_draw_page_finish (print->op);
-
 	print->total++;
 	ev_print_operation_update_status (op, print->total,
 					  print->n_pages_to_print,
 					  print->total / (gdouble)print->n_pages_to_print);
+}
+
+static void
+ev_print_operation_print_clear_preview_page (EvPrintOperationPrint *print)
+{
+	g_clear_pointer (&print->preview_page, cairo_surface_destroy);
+	g_clear_pointer (&print->preview_cr, cairo_destroy);
+}
+
+static void
+print_job_finished (EvJobPrint            *job,
+		    EvPrintOperationPrint *print)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (print);
+
 	ev_job_print_set_cairo (job, NULL);
+
+	if (print->preview_page) {
+		EvPrintPreviewCache *cache;
+
+		cairo_set_source_surface (print->preview_cr, print->preview_page, 0, 0);
+		cairo_paint (print->preview_cr);
+
+		cache = ev_print_preview_cache_get (op->document);
+		if (cache && !ev_job_is_failed (EV_JOB (job)))
+			ev_print_preview_cache_insert (cache, job->page, print->preview_page);
+		ev_print_operation_print_clear_preview_page (print);
+	}
+
+	gtk_print_operation_draw_page_finish (print->op);
+
+	ev_print_operation_print_page_drawn (print);
 }
 
 static gboolean
 draw_page_finish_idle (EvPrintOperationPrint *print)
 {
-        if (ev_job_scheduler_get_running_thread_job () == print->job_print)
+        if (ev_job_scheduler_is_job_running (print->job_print))
                 return TRUE;
 
         gtk_print_operation_draw_page_finish (print->op);
@@ -1775,12 +2274,26 @@ print_job_cancelled (EvJobPrint            *job,
          * print operation. If the job is still
          * running, wait until it finishes.
          */
-        if (ev_job_scheduler_get_running_thread_job () == print->job_print)
+        ev_print_operation_print_clear_preview_page (print);
+
+        if (ev_job_scheduler_is_job_running (print->job_print))
                 g_idle_add ((GSourceFunc)draw_page_finish_idle, print);
         else
                 gtk_print_operation_draw_page_finish (print->op);
 }
 
+/* The sizes of the pages of large documents that haven't been probed
+ * yet are estimated, the printed pages need their actual size */
+static void
+ev_print_operation_get_page_size (EvPrintOperation *op,
+				  gint              page,
+				  gdouble          *width,
+				  gdouble          *height)
+{
+	ev_document_probe_page (op->document, page);
+	ev_document_get_page_size (op->document, page, width, height);
+}
+
 static void
 ev_print_operation_print_request_page_setup (EvPrintOperationPrint *print,
 					     GtkPrintContext       *context,
@@ -1791,8 +2304,7 @@ ev_print_operation_print_request_page_setup (EvPrintOperationPrint *print,
 	gdouble           width, height;
 	GtkPaperSize     *paper_size;
 
-	ev_document_get_page_size (op->document, page_nr,
-				   &width, &height);
+	ev_print_operation_get_page_size (op, page_nr, &width, &height);
 
 	if (print->use_source_size) {
 		paper_size = gtk_paper_size_new_custom ("custom", "custom",
@@ -1843,8 +2355,8 @@ ev_print_operation_print_get_scaled_page_size (EvPrintOperationPrint *print,
 {
         GtkPrintSettings *settings;
 
-        ev_document_get_page_size (EV_PRINT_OPERATION (print)->document,
-                                   page, width, height);
+        ev_print_operation_get_page_size (EV_PRINT_OPERATION (print),
+                                          page, width, height);
 
         settings = gtk_print_operation_get_print_settings (print->op);
         *manual_scale = gtk_print_settings_get_scale (settings) / 100.0;
@@ -1861,6 +2373,8 @@ ev_print_operation_print_draw_page (EvPrintOperationPrint *print,
 				    gint                   page)
 {
 	EvPrintOperation *op = EV_PRINT_OPERATION (print);
+	EvPrintPreviewCache *cache = NULL;
+	cairo_surface_t  *cached_page = NULL;
 	cairo_t          *cr;
 	gdouble           cr_width, cr_height;
 	gdouble           width, height, manual_scale, scale;
@@ -1868,7 +2382,14 @@ ev_print_operation_print_draw_page (EvPrintOperationPrint *print,
         gdouble           x_offset, y_offset;
 	gdouble           top, bottom, left, right;
 
-	gtk_print_operation_set_defer_drawing (print->op);
+	if (op->print_preview) {
+		cache = ev_print_preview_cache_get (op->document);
+		if (cache)
+			cached_page = ev_print_preview_cache_lookup (cache, page);
+	}
+
+	if (!cached_page)
+		gtk_print_operation_set_defer_drawing (print->op);
 
 	if (!print->job_print) {
 		print->job_print = ev_job_print_new (op->document);
@@ -1939,7 +2460,32 @@ ev_print_operation_print_draw_page (EvPrintOperationPrint *print,
 		}
 	}
 
-	ev_job_print_set_cairo (EV_JOB_PRINT (print->job_print), cr);
+	if (cached_page) {
+		cairo_set_source_surface (cr, cached_page, 0, 0);
+		cairo_paint (cr);
+		ev_print_operation_print_page_drawn (print);
+
+		return;
+	}
+
+	/* The page is recorded unscaled and replayed into the preview */
+	if (cache) {
+		cairo_rectangle_t extents;
+
+		extents.x = 0;
+		extents.y = 0;
+		ev_print_operation_get_page_size (op, page,
+						  &extents.width, &extents.height);
+
+		print->preview_cr = cairo_reference (cr);
+		print->preview_page = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+								      &extents);
+		cr = cairo_create (print->preview_page);
+		ev_job_print_set_cairo (EV_JOB_PRINT (print->job_print), cr);
+		cairo_destroy (cr);
+	} else {
+		ev_job_print_set_cairo (EV_JOB_PRINT (print->job_print), cr);
+	}
 	ev_job_scheduler_push_job (print->job_print, EV_JOB_PRIORITY_NONE);
 }
 
@@ -2059,6 +2605,8 @@ ev_print_operation_print_finalize (GObject *object)
 		print->job_print = NULL;
 	}
 
+	ev_print_operation_print_clear_preview_page (print);
+
 	(* G_OBJECT_CLASS (ev_print_operation_print_parent_class)->finalize) (object);
 
         application = g_application_get_default ();
@@ -0,0 +1,798 @@
+/* ev-render-pack.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "ev-debug.h"
+#include "ev-surface-pool.h"
+#include "ev-render-pack.h"
+
+/* Renders of the pages that were slow to render, kept on disk so that
+ * they aren't rendered again when the document is opened again. It
+ * works like the thumbnail pack of the shell: one file per document
+ * fingerprint, with a header followed by the records appended as the
+ * pages are rendered:
+ *
+ *	EvRenderPackHeader
+ *	EvRenderRecord, stride * height bytes of pixels
+ *	...
+ *
+ * A record is found by the page, its rotation, its size in device
+ * pixels, which is the scale it was rendered at, the device scale and
+ * the layer rendered. The file is not trusted, records are checked
+ * before being used and the file is cut at the first broken one.
+ *
+ * Unlike thumbnails, renders are drawn over and recycled by the pixbuf
+ * cache, so their pixels are copied out of the mapped file, in a
+ * thread. Stores are written in a thread too, with the file locked
+ * since several processes may append to the same pack.
+ */
+
+#define EV_RENDER_PACK_MAGIC   "EVRENDR1"
+#define EV_RENDER_RECORD_MAGIC 0x45565252
+#define EV_RENDER_MAX_SIZE     32767
+
+typedef struct {
+	gchar   magic[8];
+	guint64 mtime;
+	guint64 size;
+	guint32 n_pages;
+	guint32 reserved;
+} EvRenderPackHeader;
+
+typedef struct {
+	guint32 magic;
+	guint32 page;
+	guint32 rotation;
+	/* In thousandths */
+	guint32 device_scale;
+	guint32 layer;
+	guint32 format;
+	guint32 width;
+	guint32 height;
+	guint32 stride;
+	guint32 reserved;
+} EvRenderRecord;
+
+struct _EvRenderPack {
+	GObject      parent;
+
+	gint         fd;
+	/* Largest size of the file */
+	gsize        max_size;
+
+	/* Protects the fields below, used from the lookup and
+	 * store threads */
+	GMutex       lock;
+	GMappedFile *mapped;
+	gsize        length;
+	gboolean     full;
+	/* Offsets of the records by their key */
+	GHashTable  *records;
+
+	/* Serializes the appends of the store threads, the file lock
+	 * is shared by the threads of the process */
+	GMutex       write_lock;
+};
+
+struct _EvRenderPackClass {
+	GObjectClass parent_class;
+};
+
+typedef struct {
+	EvRenderRecord record;
+	gchar         *key;
+	GBytes        *data;
+	gsize          offset;
+} RenderPackTask;
+
+G_DEFINE_TYPE (EvRenderPack, ev_render_pack, G_TYPE_OBJECT)
+
+static guint32
+device_scale_to_record (gdouble device_scale)
+{
+	return (guint32) (device_scale * 1000 + 0.5);
+}
+
+static gchar *
+get_record_key (gint          page,
+		gint          rotation,
+		gint          width,
+		gint          height,
+		guint32       device_scale,
+		EvRenderLayer layer)
+{
+	return g_strdup_printf ("%d:%d:%dx%d@%u:%d", page, rotation,
+				width, height, device_scale, layer);
+}
+
+static gsize
+record_get_size (const EvRenderRecord *record)
+{
+	return sizeof (EvRenderRecord) + (gsize) record->stride * record->height;
+}
+
+/* Whether the record at @offset fits in the @length first bytes of
+ * @data and describes a surface cairo can use.
+ */
+static const EvRenderRecord *
+check_record (const gchar *data,
+	      gsize        length,
+	      gsize        offset)
+{
+	const EvRenderRecord *record;
+
+	if (offset + sizeof (EvRenderRecord) > length)
+		return NULL;
+
+	record = (const EvRenderRecord *) (data + offset);
+	if (record->magic != EV_RENDER_RECORD_MAGIC)
+		return NULL;
+	if (record->format != CAIRO_FORMAT_ARGB32 && record->format != CAIRO_FORMAT_RGB24 &&
+	    record->format != CAIRO_FORMAT_A8 && record->format != CAIRO_FORMAT_A1)
+		return NULL;
+	if (record->width == 0 || record->width > EV_RENDER_MAX_SIZE ||
+	    record->height == 0 || record->height > EV_RENDER_MAX_SIZE)
+		return NULL;
+	if (record->stride != (guint32) cairo_format_stride_for_width (record->format, record->width))
+		return NULL;
+	if (offset + record_get_size (record) > length)
+		return NULL;
+
+	return record;
+}
+
+static gboolean
+remap_unlocked (EvRenderPack *pack)
+{
+	g_clear_pointer (&pack->mapped, g_mapped_file_unref);
+	pack->mapped = g_mapped_file_new_from_fd (pack->fd, FALSE, NULL);
+
+	return pack->mapped != NULL;
+}
+
+static const EvRenderRecord *
+get_record_unlocked (EvRenderPack *pack,
+		     gsize         offset)
+{
+	if (!pack->mapped)
+		return NULL;
+
+	return check_record (g_mapped_file_get_contents (pack->mapped),
+			     g_mapped_file_get_length (pack->mapped),
+			     offset);
+}
+
+/* Called with the file locked, before the pack is shared */
+static void
+scan (EvRenderPack *pack)
+{
+	const gchar *data;
+	gsize        length;
+	gsize        offset = sizeof (EvRenderPackHeader);
+
+	if (!remap_unlocked (pack))
+		return;
+
+	data = g_mapped_file_get_contents (pack->mapped);
+	length = g_mapped_file_get_length (pack->mapped);
+	while (offset < length) {
+		const EvRenderRecord *record;
+
+		record = check_record (data, length, offset);
+		if (!record)
+			break;
+
+		g_hash_table_insert (pack->records,
+				     get_record_key (record->page,
+						     record->rotation,
+						     record->width,
+						     record->height,
+						     record->device_scale,
+						     record->layer),
+				     GSIZE_TO_POINTER (offset));
+		offset += record_get_size (record);
+	}
+
+	/* Drop what a crash left half written */
+	if (offset < length && ftruncate (pack->fd, offset) < 0)
+		pack->full = TRUE;
+	pack->length = offset;
+
+	if (pack->length >= pack->max_size)
+		pack->full = TRUE;
+}
+
+static void
+get_stamp (EvDocument         *document,
+	   EvRenderPackHeader *header)
+{
+	const gchar *uri = ev_document_get_uri (document);
+	GFile       *file;
+	GFileInfo   *info = NULL;
+
+	memset (header, 0, sizeof (EvRenderPackHeader));
+	memcpy (header->magic, EV_RENDER_PACK_MAGIC, sizeof (header->magic));
+	header->n_pages = ev_document_get_n_pages (document);
+
+	if (!uri)
+		return;
+
+	file = g_file_new_for_uri (uri);
+	if (g_file_is_native (file)) {
+		info = g_file_query_info (file,
+					  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	}
+	g_object_unref (file);
+
+	if (info) {
+		header->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		header->size = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+}
+
+typedef struct {
+	gchar  *path;
+	goffset size;
+	gint64  mtime;
+} PackFile;
+
+static gint
+compare_pack_files (gconstpointer a,
+		    gconstpointer b)
+{
+	const PackFile *file_a = a;
+	const PackFile *file_b = b;
+
+	return (file_a->mtime > file_b->mtime) - (file_a->mtime < file_b->mtime);
+}
+
+/* Removes the least recently opened packs when the cache is bigger
+ * than @max_size */
+static void
+prune (const gchar *dir,
+       gsize        max_size)
+{
+	GDir        *gdir;
+	GArray      *files;
+	const gchar *name;
+	goffset      total = 0;
+	guint        i;
+
+	gdir = g_dir_open (dir, 0, NULL);
+	if (!gdir)
+		return;
+
+	files = g_array_new (FALSE, FALSE, sizeof (PackFile));
+	while ((name = g_dir_read_name (gdir))) {
+		PackFile file;
+		GStatBuf st;
+
+		if (!g_str_has_suffix (name, ".pack"))
+			continue;
+
+		file.path = g_build_filename (dir, name, NULL);
+		if (g_stat (file.path, &st) < 0) {
+			g_free (file.path);
+			continue;
+		}
+
+		file.size = st.st_size;
+		file.mtime = st.st_mtime;
+		total += file.size;
+		g_array_append_val (files, file);
+	}
+	g_dir_close (gdir);
+
+	if (total > (goffset) max_size) {
+		g_array_sort (files, compare_pack_files);
+		for (i = 0; i < files->len && total > (goffset) max_size * 3 / 4; i++) {
+			PackFile *file = &g_array_index (files, PackFile, i);
+
+			if (g_unlink (file->path) == 0)
+				total -= file->size;
+		}
+	}
+
+	for (i = 0; i < files->len; i++)
+		g_free (g_array_index (files, PackFile, i).path);
+	g_array_free (files, TRUE);
+}
+
+static gint
+open_file (const gchar              *path,
+	   const EvRenderPackHeader *header)
+{
+	EvRenderPackHeader saved;
+	gint               fd;
+
+	fd = g_open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd == -1)
+		return -1;
+
+	if (flock (fd, LOCK_EX) < 0) {
+		close (fd);
+		return -1;
+	}
+
+	if (pread (fd, &saved, sizeof (saved), 0) == sizeof (saved)) {
+		if (memcmp (&saved, header, sizeof (saved)) == 0)
+			return fd;
+
+		/* The document changed. The file is replaced instead of
+		 * truncated, since other processes may have it mapped.
+		 */
+		g_unlink (path);
+		close (fd);
+
+		fd = g_open (path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd == -1 || flock (fd, LOCK_EX) < 0) {
+			if (fd != -1)
+				close (fd);
+			return -1;
+		}
+	}
+
+	if (ftruncate (fd, 0) < 0 ||
+	    pwrite (fd, header, sizeof (*header), 0) != sizeof (*header)) {
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void
+render_pack_task_free (RenderPackTask *data)
+{
+	g_free (data->key);
+	g_clear_pointer (&data->data, g_bytes_unref);
+	g_slice_free (RenderPackTask, data);
+}
+
+static void
+ev_render_pack_finalize (GObject *object)
+{
+	EvRenderPack *pack = EV_RENDER_PACK (object);
+
+	if (pack->fd != -1)
+		close (pack->fd);
+	g_clear_pointer (&pack->mapped, g_mapped_file_unref);
+	g_hash_table_destroy (pack->records);
+	g_mutex_clear (&pack->lock);
+	g_mutex_clear (&pack->write_lock);
+
+	G_OBJECT_CLASS (ev_render_pack_parent_class)->finalize (object);
+}
+
+static void
+ev_render_pack_init (EvRenderPack *pack)
+{
+	pack->fd = -1;
+	pack->length = sizeof (EvRenderPackHeader);
+	pack->records = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_mutex_init (&pack->lock);
+	g_mutex_init (&pack->write_lock);
+}
+
+static void
+ev_render_pack_class_init (EvRenderPackClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = ev_render_pack_finalize;
+}
+
+/**
+ * ev_render_pack_new:
+ * @document: an #EvDocument
+ * @max_size: the size of the render packs of all the documents, in bytes
+ *
+ * Opens the render pack of @document, dropping the renders saved for
+ * an older version of it. The least recently opened packs are removed
+ * when all of them use more than @max_size, and a single pack uses at
+ * most half of it.
+ *
+ * Returns: (transfer full) (allow-none): the render pack of @document,
+ *   or %NULL if @document can't be identified or the cache can't be
+ *   written
+ */
+EvRenderPack *
+ev_render_pack_new (EvDocument *document,
+		    gsize       max_size)
+{
+	EvRenderPack       *pack;
+	EvRenderPackHeader  header;
+	const gchar        *fingerprint;
+	gchar              *dir;
+	gchar              *filename;
+	gchar              *path;
+	gint                fd;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	fingerprint = ev_document_get_fingerprint (document);
+	if (!fingerprint || max_size == 0)
+		return NULL;
+
+	dir = g_build_filename (g_get_user_cache_dir (), "evince", "renders", NULL);
+	if (g_mkdir_with_parents (dir, 0700) < 0) {
+		g_free (dir);
+		return NULL;
+	}
+	prune (dir, max_size);
+
+	filename = g_strconcat (fingerprint, ".pack", NULL);
+	path = g_build_filename (dir, filename, NULL);
+	g_free (filename);
+	g_free (dir);
+
+	get_stamp (document, &header);
+	fd = open_file (path, &header);
+	if (fd == -1) {
+		g_free (path);
+		return NULL;
+	}
+
+	/* Keeps the pack from being pruned */
+	g_utime (path, NULL);
+	g_free (path);
+
+	pack = EV_RENDER_PACK (g_object_new (EV_TYPE_RENDER_PACK, NULL));
+	pack->fd = fd;
+	pack->max_size = max_size / 2;
+	scan (pack);
+	flock (fd, LOCK_UN);
+
+	ev_debug_message (DEBUG_JOBS, "render pack of %u renders, %" G_GSIZE_FORMAT " bytes",
+			  g_hash_table_size (pack->records), pack->length);
+
+	return pack;
+}
+
+/**
+ * ev_render_pack_contains:
+ * @pack: an #EvRenderPack
+ * @page: a page
+ * @rotation: the rotation of the page
+ * @width: the width of the surface, in device pixels
+ * @height: the height of the surface, in device pixels
+ * @device_scale: device pixels per pixel of the view
+ * @layer: the layer of the page rendered
+ *
+ * Returns: whether ev_render_pack_lookup_async() would restore @page
+ *   with the given rotation, size and layer
+ */
+gboolean
+ev_render_pack_contains (EvRenderPack *pack,
+			 gint          page,
+			 gint          rotation,
+			 gint          width,
+			 gint          height,
+			 gdouble       device_scale,
+			 EvRenderLayer layer)
+{
+	gchar   *key;
+	gboolean retval;
+
+	g_return_val_if_fail (EV_IS_RENDER_PACK (pack), FALSE);
+
+	key = get_record_key (page, rotation, width, height,
+			      device_scale_to_record (device_scale), layer);
+	g_mutex_lock (&pack->lock);
+	retval = g_hash_table_contains (pack->records, key);
+	g_mutex_unlock (&pack->lock);
+	g_free (key);
+
+	return retval;
+}
+
+static void
+lookup_thread (GTask        *task,
+	       gpointer      source_object,
+	       gpointer      task_data,
+	       GCancellable *cancellable)
+{
+	EvRenderPack         *pack = EV_RENDER_PACK (source_object);
+	RenderPackTask       *data = (RenderPackTask *) task_data;
+	const EvRenderRecord *record;
+	GMappedFile          *mapped = NULL;
+	cairo_surface_t      *surface;
+	const guchar         *src;
+	guchar               *dest;
+	gint                  dest_stride;
+	guint                 y;
+
+	if (g_task_return_error_if_cancelled (task))
+		return;
+
+	g_mutex_lock (&pack->lock);
+
+	/* Records appended after the file was mapped need a new mapping */
+	record = get_record_unlocked (pack, data->offset);
+	if (!record && remap_unlocked (pack))
+		record = get_record_unlocked (pack, data->offset);
+
+	/* Another process may have replaced the file */
+	if (record &&
+	    record->page == data->record.page &&
+	    record->rotation == data->record.rotation &&
+	    record->width == data->record.width &&
+	    record->height == data->record.height &&
+	    record->device_scale == data->record.device_scale &&
+	    record->layer == data->record.layer) {
+		mapped = g_mapped_file_ref (pack->mapped);
+	} else {
+		g_hash_table_remove (pack->records, data->key);
+	}
+
+	g_mutex_unlock (&pack->lock);
+
+	if (!mapped) {
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					 "Invalid saved render of page %u", data->record.page);
+		return;
+	}
+
+	surface = ev_surface_pool_create_surface (record->format, record->width, record->height);
+	dest = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+	src = (const guchar *) (record + 1);
+	for (y = 0; y < record->height; y++)
+		memcpy (dest + (gsize) y * dest_stride, src + (gsize) y * record->stride, record->stride);
+	cairo_surface_mark_dirty (surface);
+	g_mapped_file_unref (mapped);
+
+	g_task_return_pointer (task, surface, (GDestroyNotify) cairo_surface_destroy);
+}
+
+/**
+ * ev_render_pack_lookup_async:
+ * @pack: an #EvRenderPack
+ * @page: the page to restore
+ * @rotation: the rotation of the page
+ * @width: the width of the surface, in device pixels
+ * @height: the height of the surface, in device pixels
+ * @device_scale: device pixels per pixel of the view
+ * @layer: the layer of the page rendered
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called once the page is restored
+ * @user_data: data for @callback
+ *
+ * Reads the saved render of @page in a thread, when the pack has one
+ * with the given rotation, size and layer.
+ *
+ * Returns: %TRUE if the page is being restored, %FALSE if it must be
+ *   rendered and @callback won't be called
+ */
+gboolean
+ev_render_pack_lookup_async (EvRenderPack        *pack,
+			     gint                 page,
+			     gint                 rotation,
+			     gint                 width,
+			     gint                 height,
+			     gdouble              device_scale,
+			     EvRenderLayer        layer,
+			     GCancellable        *cancellable,
+			     GAsyncReadyCallback  callback,
+			     gpointer             user_data)
+{
+	RenderPackTask *data;
+	GTask          *task;
+	gpointer        value;
+	gchar          *key;
+
+	g_return_val_if_fail (EV_IS_RENDER_PACK (pack), FALSE);
+
+	key = get_record_key (page, rotation, width, height,
+			      device_scale_to_record (device_scale), layer);
+	g_mutex_lock (&pack->lock);
+	if (!g_hash_table_lookup_extended (pack->records, key, NULL, &value)) {
+		g_mutex_unlock (&pack->lock);
+		g_free (key);
+		return FALSE;
+	}
+	g_mutex_unlock (&pack->lock);
+
+	data = g_slice_new0 (RenderPackTask);
+	data->key = key;
+	data->offset = GPOINTER_TO_SIZE (value);
+	data->record.page = page;
+	data->record.rotation = rotation;
+	data->record.width = width;
+	data->record.height = height;
+	data->record.device_scale = device_scale_to_record (device_scale);
+	data->record.layer = layer;
+
+	task = g_task_new (pack, cancellable, callback, user_data);
+	g_task_set_task_data (task, data, (GDestroyNotify) render_pack_task_free);
+	g_task_run_in_thread (task, lookup_thread);
+	g_object_unref (task);
+
+	return TRUE;
+}
+
+/**
+ * ev_render_pack_lookup_finish:
+ * @pack: an #EvRenderPack
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: (transfer full): the restored surface, or %NULL if the
+ *   lookup was cancelled or failed
+ */
+cairo_surface_t *
+ev_render_pack_lookup_finish (EvRenderPack  *pack,
+			      GAsyncResult  *result,
+			      GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, pack), NULL);
+
+	return (cairo_surface_t *) g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+store_thread (GTask        *task,
+	      gpointer      source_object,
+	      gpointer      task_data,
+	      GCancellable *cancellable)
+{
+	EvRenderPack   *pack = EV_RENDER_PACK (source_object);
+	RenderPackTask *data = (RenderPackTask *) task_data;
+	struct stat     st;
+	gconstpointer   pixels;
+	gsize           data_size;
+	goffset         offset;
+
+	pixels = g_bytes_get_data (data->data, &data_size);
+
+	g_mutex_lock (&pack->write_lock);
+
+	g_mutex_lock (&pack->lock);
+	if (pack->full || g_hash_table_contains (pack->records, data->key)) {
+		g_mutex_unlock (&pack->lock);
+		g_mutex_unlock (&pack->write_lock);
+		return;
+	}
+	if (pack->length + sizeof (EvRenderRecord) + data_size > pack->max_size) {
+		pack->full = TRUE;
+		g_mutex_unlock (&pack->lock);
+		g_mutex_unlock (&pack->write_lock);
+		return;
+	}
+	g_mutex_unlock (&pack->lock);
+
+	if (flock (pack->fd, LOCK_EX) < 0) {
+		g_mutex_unlock (&pack->write_lock);
+		return;
+	}
+
+	/* Other processes may have appended their own records */
+	if (fstat (pack->fd, &st) < 0) {
+		flock (pack->fd, LOCK_UN);
+		g_mutex_unlock (&pack->write_lock);
+		return;
+	}
+	offset = st.st_size;
+
+	if (pwrite (pack->fd, &data->record, sizeof (EvRenderRecord), offset) == sizeof (EvRenderRecord) &&
+	    pwrite (pack->fd, pixels, data_size, offset + sizeof (EvRenderRecord)) == (gssize) data_size) {
+		ev_debug_message (DEBUG_JOBS, "page %u: saved render of %" G_GSIZE_FORMAT " bytes",
+				  data->record.page, data_size);
+
+		g_mutex_lock (&pack->lock);
+		g_hash_table_insert (pack->records, data->key, GSIZE_TO_POINTER ((gsize) offset));
+		data->key = NULL;
+		pack->length = offset + sizeof (EvRenderRecord) + data_size;
+		g_mutex_unlock (&pack->lock);
+	} else {
+		/* Most likely out of space, don't try again */
+		if (ftruncate (pack->fd, offset) < 0)
+			g_warning ("Failed to truncate the render pack: %s", g_strerror (errno));
+
+		g_mutex_lock (&pack->lock);
+		pack->full = TRUE;
+		g_mutex_unlock (&pack->lock);
+	}
+
+	flock (pack->fd, LOCK_UN);
+	g_mutex_unlock (&pack->write_lock);
+}
+
+/**
+ * ev_render_pack_store:
+ * @pack: an #EvRenderPack
+ * @page: the page of @surface
+ * @rotation: the rotation @surface is rendered with
+ * @device_scale: device pixels per pixel of the view of @surface
+ * @layer: the layer of the page rendered in @surface
+ * @surface: a rendered page
+ *
+ * Appends @surface to the pack file in a thread, so that
+ * ev_render_pack_lookup_async() finds it even after the document is
+ * closed. The pixels are copied, the caller keeps using @surface.
+ * Only image surfaces are stored.
+ */
+void
+ev_render_pack_store (EvRenderPack    *pack,
+		      gint             page,
+		      gint             rotation,
+		      gdouble          device_scale,
+		      EvRenderLayer    layer,
+		      cairo_surface_t *surface)
+{
+	RenderPackTask *data;
+	EvRenderRecord  record;
+	GTask          *task;
+	gchar          *key;
+	gboolean        skip;
+
+	g_return_if_fail (EV_IS_RENDER_PACK (pack));
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return;
+
+	memset (&record, 0, sizeof (record));
+	record.magic = EV_RENDER_RECORD_MAGIC;
+	record.page = page;
+	record.rotation = rotation;
+	record.device_scale = device_scale_to_record (device_scale);
+	record.layer = layer;
+	record.format = cairo_image_surface_get_format (surface);
+	record.width = cairo_image_surface_get_width (surface);
+	record.height = cairo_image_surface_get_height (surface);
+	record.stride = cairo_image_surface_get_stride (surface);
+
+	if (!check_record ((const gchar *) &record, G_MAXSIZE, 0))
+		return;
+
+	key = get_record_key (page, rotation, record.width, record.height,
+			      record.device_scale, layer);
+	g_mutex_lock (&pack->lock);
+	skip = pack->full || g_hash_table_contains (pack->records, key);
+	g_mutex_unlock (&pack->lock);
+	if (skip) {
+		g_free (key);
+		return;
+	}
+
+	/* The surface may be drawn over before the thread writes it */
+	cairo_surface_flush (surface);
+	data = g_slice_new0 (RenderPackTask);
+	data->record = record;
+	data->key = key;
+	data->data = g_bytes_new (cairo_image_surface_get_data (surface),
+				  (gsize) record.stride * record.height);
+
+	task = g_task_new (pack, NULL, NULL, NULL);
+	g_task_set_task_data (task, data, (GDestroyNotify) render_pack_task_free);
+	g_task_run_in_thread (task, store_thread);
+	g_object_unref (task);
+}
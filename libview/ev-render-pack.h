@@ -0,0 +1,72 @@
+/* ev-render-pack.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_RENDER_PACK_H
+#define EV_RENDER_PACK_H
+
+#include <gio/gio.h>
+#include <cairo.h>
+
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_RENDER_PACK            (ev_render_pack_get_type ())
+#define EV_RENDER_PACK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_RENDER_PACK, EvRenderPack))
+#define EV_IS_RENDER_PACK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_RENDER_PACK))
+
+typedef struct _EvRenderPack      EvRenderPack;
+typedef struct _EvRenderPackClass EvRenderPackClass;
+
+GType            ev_render_pack_get_type      (void) G_GNUC_CONST;
+EvRenderPack    *ev_render_pack_new           (EvDocument          *document,
+					       gsize                max_size);
+gboolean         ev_render_pack_contains      (EvRenderPack        *pack,
+					       gint                 page,
+					       gint                 rotation,
+					       gint                 width,
+					       gint                 height,
+					       gdouble              device_scale,
+					       EvRenderLayer        layer);
+gboolean         ev_render_pack_lookup_async  (EvRenderPack        *pack,
+					       gint                 page,
+					       gint                 rotation,
+					       gint                 width,
+					       gint                 height,
+					       gdouble              device_scale,
+					       EvRenderLayer        layer,
+					       GCancellable        *cancellable,
+					       GAsyncReadyCallback  callback,
+					       gpointer             user_data);
+cairo_surface_t *ev_render_pack_lookup_finish (EvRenderPack        *pack,
+					       GAsyncResult        *result,
+					       GError             **error);
+void             ev_render_pack_store         (EvRenderPack        *pack,
+					       gint                 page,
+					       gint                 rotation,
+					       gdouble              device_scale,
+					       EvRenderLayer        layer,
+					       cairo_surface_t     *surface);
+
+G_END_DECLS
+
+#endif /* EV_RENDER_PACK_H */
@@ -0,0 +1,219 @@
+/* ev-render-stats.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "ev-render-stats.h"
+
+/* Render times are kept per backend type, size of the rendered surface
+ * and scale, in histograms like the ones of the job scheduler: bucket i
+ * counts the times shorter than 2^i milliseconds, the last bucket
+ * everything longer. Renders finish in the job threads, so the stats
+ * are protected by stats_mutex.
+ */
+#define EV_RENDER_STATS_N_BUCKETS 14
+
+/* Upper bounds of the size and scale classes, the last class has
+ * everything bigger */
+static const gdouble megapixel_bounds[] = { 0.25, 1, 4, 16 };
+static const gdouble scale_bounds[] = { 0.5, 1, 2, 4 };
+
+#define N_MEGAPIXEL_CLASSES (G_N_ELEMENTS (megapixel_bounds) + 1)
+#define N_SCALE_CLASSES (G_N_ELEMENTS (scale_bounds) + 1)
+
+typedef struct {
+	guint  n_renders;
+	gint64 total;
+	gint64 max;
+	guint  histogram[EV_RENDER_STATS_N_BUCKETS];
+} EvRenderClassStats;
+
+typedef struct {
+	EvRenderClassStats classes[N_MEGAPIXEL_CLASSES][N_SCALE_CLASSES];
+} EvRenderBackendStats;
+
+static GMutex        stats_mutex;
+static GHashTable   *backends = NULL; /* Type name -> EvRenderBackendStats */
+static volatile gint n_cache_hits = 0;
+static volatile gint n_cache_misses = 0;
+
+static guint
+get_class (const gdouble *bounds,
+	   guint          n_bounds,
+	   gdouble        value)
+{
+	guint i = 0;
+
+	while (i < n_bounds && value >= bounds[i])
+		i++;
+
+	return i;
+}
+
+/**
+ * ev_render_stats_add_render:
+ * @backend: the type name of the document
+ * @width: the width of the rendered surface, in pixels
+ * @height: the height of the rendered surface, in pixels
+ * @scale: the scale of the render
+ * @usecs: the time the render took, in microseconds
+ *
+ * Records a render for ev_render_stats_get(). Renders of the view are
+ * recorded by #EvJobRender.
+ *
+ * Since: 3.30
+ */
+void
+ev_render_stats_add_render (const gchar *backend,
+			    gint         width,
+			    gint         height,
+			    gdouble      scale,
+			    gint64       usecs)
+{
+	EvRenderBackendStats *backend_stats;
+	EvRenderClassStats   *stats;
+	gint64                msecs = usecs / 1000;
+	gint                  bucket = 0;
+
+	g_return_if_fail (backend != NULL);
+
+	while (bucket < EV_RENDER_STATS_N_BUCKETS - 1 && msecs >= ((gint64) 1 << bucket))
+		bucket++;
+
+	g_mutex_lock (&stats_mutex);
+
+	if (!backends)
+		backends = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	backend_stats = g_hash_table_lookup (backends, backend);
+	if (!backend_stats) {
+		backend_stats = g_new0 (EvRenderBackendStats, 1);
+		g_hash_table_insert (backends, g_strdup (backend), backend_stats);
+	}
+
+	stats = &backend_stats->classes[get_class (megapixel_bounds, G_N_ELEMENTS (megapixel_bounds),
+						   (gdouble) width * height / 1e6)]
+		[get_class (scale_bounds, G_N_ELEMENTS (scale_bounds), scale)];
+	stats->n_renders++;
+	stats->total += usecs;
+	stats->max = MAX (stats->max, usecs);
+	stats->histogram[bucket]++;
+
+	g_mutex_unlock (&stats_mutex);
+}
+
+/**
+ * ev_render_stats_add_cache_lookup:
+ * @hit: whether the page was already rendered
+ *
+ * Records a lookup of a rendered page, by the view when it draws it.
+ *
+ * Since: 3.30
+ */
+void
+ev_render_stats_add_cache_lookup (gboolean hit)
+{
+	if (hit)
+		g_atomic_int_inc (&n_cache_hits);
+	else
+		g_atomic_int_inc (&n_cache_misses);
+}
+
+static GVariant *
+bounds_to_variant (const gdouble *bounds,
+		   guint          n_bounds)
+{
+	return g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE, bounds, n_bounds, sizeof (gdouble));
+}
+
+/**
+ * ev_render_stats_get:
+ *
+ * Returns a snapshot of the render statistics, as a dictionary with
+ * the following keys:
+ *
+ * - "renders": the renders of each class, as an array of
+ *   (backend, megapixel class, scale class, number of renders,
+ *   total time, max time, histogram), of type a(suuuxxau). Times are
+ *   in microseconds, bucket i of the histograms counts the times
+ *   shorter than 2^i milliseconds, the last bucket everything longer.
+ * - "megapixel-classes", "scale-classes": the upper bounds of the
+ *   classes, as an array of doubles, the last class has everything
+ *   bigger
+ * - "cache-hits", "cache-misses": the number of pages drawn by the
+ *   view that were already rendered or not, as uint32
+ *
+ * Returns: (transfer full): a floating #GVariant of type a{sv}
+ *
+ * Since: 3.30
+ */
+GVariant *
+ev_render_stats_get (void)
+{
+	GVariantBuilder builder;
+	GVariantBuilder renders_builder;
+	GHashTableIter  iter;
+	gpointer        key, value;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_init (&renders_builder, G_VARIANT_TYPE ("a(suuuxxau)"));
+
+	g_mutex_lock (&stats_mutex);
+
+	if (backends) {
+		g_hash_table_iter_init (&iter, backends);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			EvRenderBackendStats *backend_stats = value;
+			guint                 i, j;
+
+			for (i = 0; i < N_MEGAPIXEL_CLASSES; i++) {
+				for (j = 0; j < N_SCALE_CLASSES; j++) {
+					EvRenderClassStats *stats = &backend_stats->classes[i][j];
+
+					if (stats->n_renders == 0)
+						continue;
+
+					g_variant_builder_add_value (
+						&renders_builder,
+						g_variant_new ("(suuuxx@au)",
+							       (const gchar *) key, i, j,
+							       stats->n_renders,
+							       stats->total, stats->max,
+							       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+											  stats->histogram,
+											  EV_RENDER_STATS_N_BUCKETS,
+											  sizeof (guint))));
+				}
+			}
+		}
+	}
+
+	g_mutex_unlock (&stats_mutex);
+
+	g_variant_builder_add (&builder, "{sv}", "renders", g_variant_builder_end (&renders_builder));
+	g_variant_builder_add (&builder, "{sv}", "megapixel-classes",
+			       bounds_to_variant (megapixel_bounds, G_N_ELEMENTS (megapixel_bounds)));
+	g_variant_builder_add (&builder, "{sv}", "scale-classes",
+			       bounds_to_variant (scale_bounds, G_N_ELEMENTS (scale_bounds)));
+	g_variant_builder_add (&builder, "{sv}", "cache-hits",
+			       g_variant_new_uint32 (g_atomic_int_get (&n_cache_hits)));
+	g_variant_builder_add (&builder, "{sv}", "cache-misses",
+			       g_variant_new_uint32 (g_atomic_int_get (&n_cache_misses)));
+
+	return g_variant_builder_end (&builder);
+}
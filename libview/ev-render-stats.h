@@ -0,0 +1,40 @@
+/* ev-render-stats.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_RENDER_STATS_H
+#define EV_RENDER_STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void      ev_render_stats_add_render       (const gchar *backend,
+					    gint         width,
+					    gint         height,
+					    gdouble      scale,
+					    gint64       usecs);
+void      ev_render_stats_add_cache_lookup (gboolean     hit);
+GVariant *ev_render_stats_get              (void);
+
+G_END_DECLS
+
+#endif /* EV_RENDER_STATS_H */
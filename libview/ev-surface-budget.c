@@ -0,0 +1,367 @@
+/* ev-surface-budget.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include "ev-debug.h"
+#include "ev-memory-monitor.h"
+#include "ev-surface-budget.h"
+
+/* Budget used when EV_SURFACE_BUDGET is not set, in megabytes */
+#define EV_SURFACE_BUDGET_DEFAULT_LIMIT 512
+
+/* The budget doesn't own the surfaces, entries are freed when the
+ * surface is destroyed. Surfaces are added, touched and evicted from
+ * the main thread, but the last reference can be dropped by a job in
+ * any thread, so the state is protected by budget_mutex.
+ */
+typedef struct _EvSurfaceBudgetEntry {
+	cairo_surface_t          *surface;
+	gsize                     size;
+	EvSurfaceBudgetEvictFunc  evict_func;
+	gpointer                  user_data;
+	GList                    *link;
+	guint                     pass;
+} EvSurfaceBudgetEntry;
+
+static GMutex      budget_mutex;
+static GHashTable *entries = NULL;
+static GQueue      lru = G_QUEUE_INIT; /* Most recently shown first */
+static gsize       budget_usage = 0;
+static gsize       budget_limit = 0;
+static guint       evict_pass = 0;
+static gboolean    monitoring_pressure = FALSE;
+static guint       budget_pressure = EV_MEMORY_PRESSURE_NONE;
+
+static const cairo_user_data_key_t budget_key;
+
+static void
+ev_surface_budget_init_unlocked (void)
+{
+	const gchar *env;
+	gint64       megabytes = EV_SURFACE_BUDGET_DEFAULT_LIMIT;
+
+	if (entries)
+		return;
+
+	entries = g_hash_table_new (NULL, NULL);
+
+	env = g_getenv ("EV_SURFACE_BUDGET");
+	if (env) {
+		gint64 value = g_ascii_strtoll (env, NULL, 10);
+
+		if (value > 0)
+			megabytes = value;
+	}
+
+	budget_limit = (gsize) megabytes * 1024 * 1024;
+}
+
+static void
+ev_surface_budget_unlink_unlocked (EvSurfaceBudgetEntry *entry)
+{
+	g_hash_table_remove (entries, entry->surface);
+	g_queue_delete_link (&lru, entry->link);
+	entry->link = NULL;
+	budget_usage -= entry->size;
+}
+
+static void
+ev_surface_budget_entry_destroy (gpointer data)
+{
+	EvSurfaceBudgetEntry *entry = (EvSurfaceBudgetEntry *)data;
+
+	g_mutex_lock (&budget_mutex);
+	if (entries && g_hash_table_lookup (entries, entry->surface) == entry)
+		ev_surface_budget_unlink_unlocked (entry);
+	g_mutex_unlock (&budget_mutex);
+
+	g_slice_free (EvSurfaceBudgetEntry, entry);
+}
+
+/* The limit shrinks to 3/4, 1/2 and 1/4 of the budget as memory
+ * pressure grows. */
+static gsize
+ev_surface_budget_get_effective_limit_unlocked (void)
+{
+	return budget_limit / 4 * (4 - budget_pressure);
+}
+
+/* Evicts the least recently shown surfaces until the usage is below
+ * the limit, or no owner accepts to drop its surfaces.
+ */
+static void
+ev_surface_budget_enforce (cairo_surface_t *keep)
+{
+	g_mutex_lock (&budget_mutex);
+
+	evict_pass++;
+
+	while (budget_usage > ev_surface_budget_get_effective_limit_unlocked ()) {
+		EvSurfaceBudgetEntry     *candidate = NULL;
+		EvSurfaceBudgetEvictFunc  evict_func;
+		cairo_surface_t          *surface;
+		gpointer                  user_data;
+		GList                    *l;
+		gboolean                  evicted;
+
+		for (l = lru.tail; l; l = g_list_previous (l)) {
+			EvSurfaceBudgetEntry *entry = (EvSurfaceBudgetEntry *)l->data;
+
+			if (entry->surface == keep || !entry->evict_func ||
+			    entry->pass == evict_pass)
+				continue;
+
+			candidate = entry;
+			break;
+		}
+
+		if (!candidate)
+			break;
+
+		candidate->pass = evict_pass;
+		surface = candidate->surface;
+		evict_func = candidate->evict_func;
+		user_data = candidate->user_data;
+
+		/* The owner drops its reference from the callback, which
+		 * might destroy the surface and the entry. */
+		g_mutex_unlock (&budget_mutex);
+		evicted = evict_func (surface, user_data);
+		g_mutex_lock (&budget_mutex);
+
+		if (evicted) {
+			EvSurfaceBudgetEntry *entry;
+
+			entry = g_hash_table_lookup (entries, surface);
+			if (entry)
+				ev_surface_budget_unlink_unlocked (entry);
+		}
+	}
+
+	ev_debug_message (DEBUG_JOBS, "usage: %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes",
+			  budget_usage, ev_surface_budget_get_effective_limit_unlocked ());
+
+	g_mutex_unlock (&budget_mutex);
+}
+
+static void
+memory_pressure_changed_cb (EvMemoryMonitor *monitor)
+{
+	g_mutex_lock (&budget_mutex);
+	budget_pressure = ev_memory_monitor_get_pressure (monitor);
+	g_mutex_unlock (&budget_mutex);
+
+	ev_surface_budget_enforce (NULL);
+}
+
+/**
+ * ev_surface_budget_add:
+ * @surface: a cairo image surface
+ * @evict_func: (allow-none): function asked to drop @surface, or %NULL
+ *   if @surface is accounted but can't be evicted
+ * @user_data: data passed to @evict_func
+ *
+ * Accounts @surface in the process-wide budget for rendered surfaces,
+ * shared by every view, and marks it as the most recently shown one.
+ * When the budget is exceeded, the least recently shown surfaces are
+ * evicted through their @evict_func. Under memory pressure the budget
+ * is temporarily reduced, down to a quarter of it. @surface is removed
+ * from the budget when it's destroyed.
+ *
+ * Must be called from the main thread.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_budget_add (cairo_surface_t          *surface,
+		       EvSurfaceBudgetEvictFunc  evict_func,
+		       gpointer                  user_data)
+{
+	EvSurfaceBudgetEntry *entry;
+
+	g_return_if_fail (surface != NULL);
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return;
+
+	if (G_UNLIKELY (!monitoring_pressure)) {
+		g_signal_connect (ev_memory_monitor_get_default (), "pressure-changed",
+				  G_CALLBACK (memory_pressure_changed_cb), NULL);
+		monitoring_pressure = TRUE;
+	}
+
+	entry = cairo_surface_get_user_data (surface, &budget_key);
+	if (!entry) {
+		entry = g_slice_new0 (EvSurfaceBudgetEntry);
+		entry->surface = surface;
+		entry->size = (gsize) cairo_image_surface_get_stride (surface) *
+			cairo_image_surface_get_height (surface);
+		cairo_surface_set_user_data (surface, &budget_key, entry,
+					     ev_surface_budget_entry_destroy);
+	}
+
+	g_mutex_lock (&budget_mutex);
+	ev_surface_budget_init_unlocked ();
+	if (g_hash_table_lookup (entries, surface) == entry) {
+		g_mutex_unlock (&budget_mutex);
+		ev_surface_budget_touch (surface);
+		return;
+	}
+
+	entry->evict_func = evict_func;
+	entry->user_data = user_data;
+	g_hash_table_insert (entries, surface, entry);
+	g_queue_push_head (&lru, entry);
+	entry->link = lru.head;
+	budget_usage += entry->size;
+	g_mutex_unlock (&budget_mutex);
+
+	ev_surface_budget_enforce (surface);
+}
+
+/**
+ * ev_surface_budget_touch:
+ * @surface: a cairo surface
+ *
+ * Marks @surface as the most recently shown one, if it's accounted
+ * in the budget.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_budget_touch (cairo_surface_t *surface)
+{
+	EvSurfaceBudgetEntry *entry;
+
+	g_return_if_fail (surface != NULL);
+
+	g_mutex_lock (&budget_mutex);
+	entry = entries ? g_hash_table_lookup (entries, surface) : NULL;
+	if (entry && entry->link != lru.head) {
+		g_queue_unlink (&lru, entry->link);
+		g_queue_push_head_link (&lru, entry->link);
+	}
+	g_mutex_unlock (&budget_mutex);
+}
+
+/**
+ * ev_surface_budget_remove:
+ * @surface: a cairo surface
+ *
+ * Stops accounting @surface in the budget.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_budget_remove (cairo_surface_t *surface)
+{
+	g_return_if_fail (surface != NULL);
+
+	if (cairo_surface_get_user_data (surface, &budget_key))
+		cairo_surface_set_user_data (surface, &budget_key, NULL, NULL);
+}
+
+/**
+ * ev_surface_budget_remove_by_data:
+ * @user_data: the data passed to ev_surface_budget_add()
+ *
+ * Stops accounting all the surfaces added with @user_data. Owners
+ * must call this before they are destroyed.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_budget_remove_by_data (gpointer user_data)
+{
+	GList *l, *next;
+
+	g_mutex_lock (&budget_mutex);
+	for (l = lru.head; l; l = next) {
+		EvSurfaceBudgetEntry *entry = (EvSurfaceBudgetEntry *)l->data;
+
+		next = g_list_next (l);
+		if (entry->user_data == user_data && entry->evict_func)
+			ev_surface_budget_unlink_unlocked (entry);
+	}
+	g_mutex_unlock (&budget_mutex);
+}
+
+/**
+ * ev_surface_budget_get_usage:
+ *
+ * Returns: the size in bytes of all the rendered surfaces currently
+ *   accounted in the budget
+ *
+ * Since: 3.30
+ */
+gsize
+ev_surface_budget_get_usage (void)
+{
+	gsize retval;
+
+	g_mutex_lock (&budget_mutex);
+	retval = budget_usage;
+	g_mutex_unlock (&budget_mutex);
+
+	return retval;
+}
+
+/**
+ * ev_surface_budget_get_limit:
+ *
+ * Returns: the budget in bytes. It defaults to 512 megabytes, and can
+ *   be changed with the EV_SURFACE_BUDGET environment variable, in
+ *   megabytes.
+ *
+ * Since: 3.30
+ */
+gsize
+ev_surface_budget_get_limit (void)
+{
+	gsize retval;
+
+	g_mutex_lock (&budget_mutex);
+	ev_surface_budget_init_unlocked ();
+	retval = budget_limit;
+	g_mutex_unlock (&budget_mutex);
+
+	return retval;
+}
+
+/**
+ * ev_surface_budget_set_limit:
+ * @limit: the new budget in bytes
+ *
+ * Sets the budget for rendered surfaces, evicting surfaces right away
+ * if the current usage is above it.
+ *
+ * Since: 3.30
+ */
+void
+ev_surface_budget_set_limit (gsize limit)
+{
+	g_mutex_lock (&budget_mutex);
+	ev_surface_budget_init_unlocked ();
+	budget_limit = limit;
+	g_mutex_unlock (&budget_mutex);
+
+	ev_surface_budget_enforce (NULL);
+}
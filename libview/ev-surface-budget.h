@@ -0,0 +1,57 @@
+/* ev-surface-budget.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_SURFACE_BUDGET_H
+#define EV_SURFACE_BUDGET_H
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EvSurfaceBudgetEvictFunc:
+ * @surface: the surface to evict
+ * @user_data: the data passed to ev_surface_budget_add()
+ *
+ * Asks the owner of @surface to drop its reference, because the
+ * budget is exceeded. Owners may refuse, for example for surfaces
+ * that are on screen.
+ *
+ * Returns: %TRUE if the owner no longer holds @surface
+ */
+typedef gboolean (* EvSurfaceBudgetEvictFunc) (cairo_surface_t *surface,
+					       gpointer         user_data);
+
+void     ev_surface_budget_add            (cairo_surface_t          *surface,
+					   EvSurfaceBudgetEvictFunc  evict_func,
+					   gpointer                  user_data);
+void     ev_surface_budget_touch          (cairo_surface_t          *surface);
+void     ev_surface_budget_remove         (cairo_surface_t          *surface);
+void     ev_surface_budget_remove_by_data (gpointer                  user_data);
+gsize    ev_surface_budget_get_usage      (void);
+gsize    ev_surface_budget_get_limit      (void);
+void     ev_surface_budget_set_limit      (gsize                     limit);
+
+G_END_DECLS
+
+#endif /* EV_SURFACE_BUDGET_H */
@@ -19,13 +19,20 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <config.h>
+
 #include <cairo.h>
 #include <gdk/gdk.h>
 #include "ev-transition-animation.h"
 #include "ev-timeline.h"
+#ifdef ENABLE_GL_TRANSITIONS
+#include "ev-transition-gl.h"
+#endif
 
 #define EV_TRANSITION_ANIMATION_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), EV_TYPE_TRANSITION_ANIMATION, EvTransitionAnimationPriv))
 #define N_BLINDS 6
+/* The slide below and a layer for every blind */
+#define EV_TRANSITION_MAX_LAYERS (N_BLINDS + 1)
 
 typedef struct EvTransitionAnimationPriv EvTransitionAnimationPriv;
 
@@ -35,6 +42,11 @@ struct EvTransitionAnimationPriv {
 	cairo_surface_t *dest_surface;
 };
 
+typedef struct {
+	EvTransitionLayer layers[EV_TRANSITION_MAX_LAYERS];
+	guint             n_layers;
+} EvTransitionFrame;
+
 enum {
 	PROP_0,
 	PROP_EFFECT,
@@ -185,31 +197,70 @@ ev_transition_animation_class_init (EvTransitionAnimationClass *klass)
 }
 
 static void
-paint_surface (cairo_t         *cr,
-	       cairo_surface_t *surface,
-	       gdouble          x_offset,
-	       gdouble          y_offset,
-	       gdouble          alpha,
-	       GdkRectangle     page_area)
+add_layer (EvTransitionFrame *frame,
+	   cairo_surface_t   *surface,
+	   gdouble            x_offset,
+	   gdouble            y_offset,
+	   gdouble            alpha,
+	   gdouble            clip_x,
+	   gdouble            clip_y,
+	   gdouble            clip_width,
+	   gdouble            clip_height)
+{
+	EvTransitionLayer *layer;
+
+	g_assert (frame->n_layers < EV_TRANSITION_MAX_LAYERS);
+
+	layer = &frame->layers[frame->n_layers++];
+	layer->surface = surface;
+	layer->x_offset = x_offset;
+	layer->y_offset = y_offset;
+	layer->alpha = alpha;
+	layer->clip.x = clip_x;
+	layer->clip.y = clip_y;
+	layer->clip.width = clip_width;
+	layer->clip.height = clip_height;
+}
+
+static void
+add_page_layer (EvTransitionFrame *frame,
+		cairo_surface_t   *surface,
+		gdouble            x_offset,
+		gdouble            y_offset,
+		gdouble            alpha,
+		GdkRectangle       page_area)
+{
+	add_layer (frame, surface, x_offset, y_offset, alpha,
+		   page_area.x, page_area.y, page_area.width, page_area.height);
+}
+
+static void
+paint_layer (cairo_t                 *cr,
+	     const EvTransitionLayer *layer,
+	     GdkRectangle             page_area)
 {
+	cairo_surface_t *surface = layer->surface;
+
 	cairo_save (cr);
 
 	gdk_cairo_rectangle (cr, &page_area);
 	cairo_clip (cr);
-	cairo_surface_set_device_offset (surface, x_offset, y_offset);
+	cairo_rectangle (cr, layer->clip.x, layer->clip.y, layer->clip.width, layer->clip.height);
+	cairo_clip (cr);
+	cairo_surface_set_device_offset (surface, layer->x_offset, layer->y_offset);
 	cairo_set_source_surface (cr, surface, 0, 0);
 
-	if (alpha == 1.)
+	if (layer->alpha == 1.)
 		cairo_paint (cr);
 	else
-		cairo_paint_with_alpha (cr, alpha);
+		cairo_paint_with_alpha (cr, layer->alpha);
 
 	cairo_restore (cr);
 }
 
 /* animations */
 static void
-ev_transition_animation_split (cairo_t               *cr,
+ev_transition_animation_split (EvTransitionFrame     *frame,
 			       EvTransitionAnimation *animation,
 			       EvTransitionEffect    *effect,
 			       gdouble                progress,
@@ -230,50 +281,42 @@ ev_transition_animation_split (cairo_t               *cr,
 		      NULL);
 
 	if (direction == EV_TRANSITION_DIRECTION_INWARD) {
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
 
 		if (alignment == EV_TRANSITION_ALIGNMENT_HORIZONTAL) {
-			cairo_rectangle (cr,
-					 0,
-					 height * progress / 2,
-					 width,
-					 height * (1 - progress));
+			add_layer (frame, priv->origin_surface, 0, 0, 1.,
+				   0,
+				   height * progress / 2,
+				   width,
+				   height * (1 - progress));
 		} else {
-			cairo_rectangle (cr,
-					 width * progress / 2,
-					 0,
-					 width * (1 - progress),
-					 height);
+			add_layer (frame, priv->origin_surface, 0, 0, 1.,
+				   width * progress / 2,
+				   0,
+				   width * (1 - progress),
+				   height);
 		}
-
-		cairo_clip (cr);
-
-		paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
 	} else {
-		paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
 
 		if (alignment == EV_TRANSITION_ALIGNMENT_HORIZONTAL) {
-			cairo_rectangle (cr,
-					 0,
-					 (height / 2) - (height * progress / 2),
-					 width,
-					 height * progress);
+			add_layer (frame, priv->dest_surface, 0, 0, 1.,
+				   0,
+				   (height / 2) - (height * progress / 2),
+				   width,
+				   height * progress);
 		} else {
-			cairo_rectangle (cr,
-					 (width / 2) - (width * progress / 2),
-					 0,
-					 width * progress,
-					 height);
+			add_layer (frame, priv->dest_surface, 0, 0, 1.,
+				   (width / 2) - (width * progress / 2),
+				   0,
+				   width * progress,
+				   height);
 		}
-
-		cairo_clip (cr);
-
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
 	}
 }
 
 static void
-ev_transition_animation_blinds (cairo_t               *cr,
+ev_transition_animation_blinds (EvTransitionFrame     *frame,
 				EvTransitionAnimation *animation,
 				EvTransitionEffect    *effect,
 				gdouble                progress,
@@ -291,33 +334,27 @@ ev_transition_animation_blinds (cairo_t               *cr,
 		      "alignment", &alignment,
 		      NULL);
 
-	paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
+	add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
 
 	for (i = 0; i < N_BLINDS; i++) {
-		cairo_save (cr);
-
 		if (alignment == EV_TRANSITION_ALIGNMENT_HORIZONTAL) {
-			cairo_rectangle (cr,
-					 0,
-					 height / N_BLINDS * i,
-					 width,
-					 height / N_BLINDS * progress);
+			add_layer (frame, priv->dest_surface, 0, 0, 1.,
+				   0,
+				   height / N_BLINDS * i,
+				   width,
+				   height / N_BLINDS * progress);
 		} else {
-			cairo_rectangle (cr,
-					 width / N_BLINDS * i,
-					 0,
-					 width / N_BLINDS * progress,
-					 height);
+			add_layer (frame, priv->dest_surface, 0, 0, 1.,
+				   width / N_BLINDS * i,
+				   0,
+				   width / N_BLINDS * progress,
+				   height);
 		}
-
-		cairo_clip (cr);
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
-		cairo_restore (cr);
 	}
 }
 
 static void
-ev_transition_animation_box (cairo_t               *cr,
+ev_transition_animation_box (EvTransitionFrame     *frame,
 			     EvTransitionAnimation *animation,
 			     EvTransitionEffect    *effect,
 			     gdouble                progress,
@@ -336,32 +373,24 @@ ev_transition_animation_box (cairo_t               *cr,
 		      NULL);
 
 	if (direction == EV_TRANSITION_DIRECTION_INWARD) {
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
-
-		cairo_rectangle (cr,
-				 width * progress / 2,
-				 height * progress / 2,
-				 width * (1 - progress),
-				 height * (1 - progress));
-		cairo_clip (cr);
-
-		paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
+		add_layer (frame, priv->origin_surface, 0, 0, 1.,
+			   width * progress / 2,
+			   height * progress / 2,
+			   width * (1 - progress),
+			   height * (1 - progress));
 	} else {
-		paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
-
-		cairo_rectangle (cr,
-				 (width / 2) - (width * progress / 2),
-				 (height / 2) - (height * progress / 2),
-				 width * progress,
-				 height * progress);
-		cairo_clip (cr);
-
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
+		add_layer (frame, priv->dest_surface, 0, 0, 1.,
+			   (width / 2) - (width * progress / 2),
+			   (height / 2) - (height * progress / 2),
+			   width * progress,
+			   height * progress);
 	}
 }
 
 static void
-ev_transition_animation_wipe (cairo_t               *cr,
+ev_transition_animation_wipe (EvTransitionFrame     *frame,
 			      EvTransitionAnimation *animation,
 			      EvTransitionEffect    *effect,
 			      gdouble                progress,
@@ -379,43 +408,41 @@ ev_transition_animation_wipe (cairo_t               *cr,
 		      "angle", &angle,
 		      NULL);
 
-	paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
+	add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
 
 	if (angle == 0) {
 		/* left to right */
-		cairo_rectangle (cr,
-				 0, 0,
-				 width * progress,
-				 height);
+		add_layer (frame, priv->dest_surface, 0, 0, 1.,
+			   0, 0,
+			   width * progress,
+			   height);
 	} else if (angle <= 90) {
 		/* bottom to top */
-		cairo_rectangle (cr,
-				 0,
-				 height * (1 - progress),
-				 width,
-				 height * progress);
+		add_layer (frame, priv->dest_surface, 0, 0, 1.,
+			   0,
+			   height * (1 - progress),
+			   width,
+			   height * progress);
 	} else if (angle <= 180) {
 		/* right to left */
-		cairo_rectangle (cr,
-				 width * (1 - progress),
-				 0,
-				 width * progress,
-				 height);
+		add_layer (frame, priv->dest_surface, 0, 0, 1.,
+			   width * (1 - progress),
+			   0,
+			   width * progress,
+			   height);
 	} else if (angle <= 270) {
 		/* top to bottom */
-		cairo_rectangle (cr,
-				 0, 0,
-				 width,
-				 height * progress);
+		add_layer (frame, priv->dest_surface, 0, 0, 1.,
+			   0, 0,
+			   width,
+			   height * progress);
+	} else {
+		add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
 	}
-
-	cairo_clip (cr);
-
-	paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
 }
 
 static void
-ev_transition_animation_dissolve (cairo_t               *cr,
+ev_transition_animation_dissolve (EvTransitionFrame     *frame,
 				  EvTransitionAnimation *animation,
 				  EvTransitionEffect    *effect,
 				  gdouble                progress,
@@ -425,12 +452,12 @@ ev_transition_animation_dissolve (cairo_t               *cr,
 
 	priv = EV_TRANSITION_ANIMATION_GET_PRIVATE (animation);
 
-	paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
-	paint_surface (cr, priv->origin_surface, 0, 0, 1 - progress, page_area);
+	add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
+	add_page_layer (frame, priv->origin_surface, 0, 0, 1 - progress, page_area);
 }
 
 static void
-ev_transition_animation_push (cairo_t               *cr,
+ev_transition_animation_push (EvTransitionFrame     *frame,
 			      EvTransitionAnimation *animation,
 			      EvTransitionEffect    *effect,
 			      gdouble                progress,
@@ -450,17 +477,17 @@ ev_transition_animation_push (cairo_t               *cr,
 
 	if (angle == 0) {
 		/* left to right */
-		paint_surface (cr, priv->origin_surface, - (width * progress), 0, 1., page_area);
-		paint_surface (cr, priv->dest_surface, width * (1 - progress), 0, 1., page_area);
+		add_page_layer (frame, priv->origin_surface, - (width * progress), 0, 1., page_area);
+		add_page_layer (frame, priv->dest_surface, width * (1 - progress), 0, 1., page_area);
 	} else {
 		/* top to bottom */
-		paint_surface (cr, priv->origin_surface, 0, - (height * progress), 1., page_area);
-		paint_surface (cr, priv->dest_surface, 0, height * (1 - progress), 1., page_area);
+		add_page_layer (frame, priv->origin_surface, 0, - (height * progress), 1., page_area);
+		add_page_layer (frame, priv->dest_surface, 0, height * (1 - progress), 1., page_area);
 	}
 }
 
 static void
-ev_transition_animation_cover (cairo_t               *cr,
+ev_transition_animation_cover (EvTransitionFrame     *frame,
 			       EvTransitionAnimation *animation,
 			       EvTransitionEffect    *effect,
 			       gdouble                progress,
@@ -478,19 +505,19 @@ ev_transition_animation_cover (cairo_t               *cr,
 		      "angle", &angle,
 		      NULL);
 
-	paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
+	add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
 
 	if (angle == 0) {
 		/* left to right */
-		paint_surface (cr, priv->dest_surface, width * (1 - progress), 0, 1., page_area);
+		add_page_layer (frame, priv->dest_surface, width * (1 - progress), 0, 1., page_area);
 	} else {
 		/* top to bottom */
-		paint_surface (cr, priv->dest_surface, 0, height * (1 - progress), 1., page_area);
+		add_page_layer (frame, priv->dest_surface, 0, height * (1 - progress), 1., page_area);
 	}
 }
 
 static void
-ev_transition_animation_uncover (cairo_t               *cr,
+ev_transition_animation_uncover (EvTransitionFrame     *frame,
 				 EvTransitionAnimation *animation,
 				 EvTransitionEffect    *effect,
 				 gdouble                progress,
@@ -508,19 +535,19 @@ ev_transition_animation_uncover (cairo_t               *cr,
 		      "angle", &angle,
 		      NULL);
 
-	paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
+	add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
 
 	if (angle == 0) {
 		/* left to right */
-		paint_surface (cr, priv->origin_surface, - (width * progress), 0, 1., page_area);
+		add_page_layer (frame, priv->origin_surface, - (width * progress), 0, 1., page_area);
 	} else {
 		/* top to bottom */
-		paint_surface (cr, priv->origin_surface, 0, - (height * progress), 1., page_area);
+		add_page_layer (frame, priv->origin_surface, 0, - (height * progress), 1., page_area);
 	}
 }
 
 static void
-ev_transition_animation_fade (cairo_t               *cr,
+ev_transition_animation_fade (EvTransitionFrame     *frame,
 			      EvTransitionAnimation *animation,
 			      EvTransitionEffect    *effect,
 			      gdouble                progress,
@@ -530,26 +557,26 @@ ev_transition_animation_fade (cairo_t               *cr,
 
 	priv = EV_TRANSITION_ANIMATION_GET_PRIVATE (animation);
 
-	paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
-	paint_surface (cr, priv->dest_surface, 0, 0, progress, page_area);
+	add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
+	add_page_layer (frame, priv->dest_surface, 0, 0, progress, page_area);
 }
 
-void
-ev_transition_animation_paint (EvTransitionAnimation *animation,
-			       cairo_t               *cr,
-			       GdkRectangle           page_area)
+/* The layers painted, in order, for the current progress of the animation */
+static void
+ev_transition_animation_get_frame (EvTransitionAnimation *animation,
+				   GdkRectangle           page_area,
+				   EvTransitionFrame     *frame)
 {
 	EvTransitionAnimationPriv *priv;
 	EvTransitionEffectType type;
 	gdouble progress;
 
-	g_return_if_fail (EV_IS_TRANSITION_ANIMATION (animation));
-
 	priv = EV_TRANSITION_ANIMATION_GET_PRIVATE (animation);
+	frame->n_layers = 0;
 
 	if (!priv->dest_surface) {
 		/* animation is still not ready, paint the origin surface */
-		paint_surface (cr, priv->origin_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->origin_surface, 0, 0, 1., page_area);
 		return;
 	}
 
@@ -559,34 +586,34 @@ ev_transition_animation_paint (EvTransitionAnimation *animation,
 	switch (type) {
 	case EV_TRANSITION_EFFECT_REPLACE:
 		/* just paint the destination slide */
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
 		break;
 	case EV_TRANSITION_EFFECT_SPLIT:
-		ev_transition_animation_split (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_split (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_BLINDS:
-		ev_transition_animation_blinds (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_blinds (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_BOX:
-		ev_transition_animation_box (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_box (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_WIPE:
-		ev_transition_animation_wipe (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_wipe (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_DISSOLVE:
-		ev_transition_animation_dissolve (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_dissolve (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_PUSH:
-		ev_transition_animation_push (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_push (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_COVER:
-		ev_transition_animation_cover (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_cover (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_UNCOVER:
-		ev_transition_animation_uncover (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_uncover (frame, animation, priv->effect, progress, page_area);
 		break;
 	case EV_TRANSITION_EFFECT_FADE:
-		ev_transition_animation_fade (cr, animation, priv->effect, progress, page_area);
+		ev_transition_animation_fade (frame, animation, priv->effect, progress, page_area);
 		break;
 	default: {
 		GEnumValue *enum_value;
@@ -599,11 +626,47 @@ ev_transition_animation_paint (EvTransitionAnimation *animation,
 			   enum_value->value_nick);
 
 		/* just paint the destination slide */
-		paint_surface (cr, priv->dest_surface, 0, 0, 1., page_area);
+		add_page_layer (frame, priv->dest_surface, 0, 0, 1., page_area);
 		}
 	}
 }
 
+void
+ev_transition_animation_paint (EvTransitionAnimation *animation,
+			       cairo_t               *cr,
+			       GdkRectangle           page_area)
+{
+	EvTransitionFrame frame;
+	guint             i;
+
+	g_return_if_fail (EV_IS_TRANSITION_ANIMATION (animation));
+
+	ev_transition_animation_get_frame (animation, page_area, &frame);
+	for (i = 0; i < frame.n_layers; i++)
+		paint_layer (cr, &frame.layers[i], page_area);
+}
+
+#ifdef ENABLE_GL_TRANSITIONS
+/* Like ev_transition_animation_paint(), compositing the slides on the
+ * GPU. Returns %FALSE when the frame can't be painted with GL, the
+ * animation is then painted with cairo.
+ */
+gboolean
+ev_transition_animation_paint_gl (EvTransitionAnimation *animation,
+				  EvTransitionGL        *gl,
+				  cairo_t               *cr,
+				  GdkRectangle           page_area)
+{
+	EvTransitionFrame frame;
+
+	g_return_val_if_fail (EV_IS_TRANSITION_ANIMATION (animation), FALSE);
+
+	ev_transition_animation_get_frame (animation, page_area, &frame);
+
+	return ev_transition_gl_paint (gl, cr, frame.layers, frame.n_layers, page_area);
+}
+#endif
+
 EvTransitionAnimation *
 ev_transition_animation_new (EvTransitionEffect *effect)
 {
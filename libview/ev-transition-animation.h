@@ -42,6 +42,18 @@ G_BEGIN_DECLS
 typedef struct _EvTransitionAnimation      EvTransitionAnimation;
 typedef struct _EvTransitionAnimationClass EvTransitionAnimationClass;
 
+/* A slide painted with an offset and an opacity, clipped to a
+ * rectangle of the page area */
+typedef struct {
+	cairo_surface_t  *surface;
+	gdouble           x_offset;
+	gdouble           y_offset;
+	gdouble           alpha;
+	cairo_rectangle_t clip;
+} EvTransitionLayer;
+
+typedef struct _EvTransitionGL EvTransitionGL;
+
 struct _EvTransitionAnimation {
 	EvTimeline parent_instance;
 };
@@ -66,6 +78,12 @@ void                    ev_transition_animation_paint              (EvTransition
 								    cairo_t               *cr,
 								    GdkRectangle           page_area);
 gboolean                ev_transition_animation_ready              (EvTransitionAnimation *animation);
+#ifdef ENABLE_GL_TRANSITIONS
+gboolean                ev_transition_animation_paint_gl           (EvTransitionAnimation *animation,
+								    EvTransitionGL        *gl,
+								    cairo_t               *cr,
+								    GdkRectangle           page_area);
+#endif
 
 
 G_END_DECLS
@@ -0,0 +1,458 @@
+/* ev-transition-gl.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <math.h>
+#include <epoxy/gl.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+#include "ev-debug.h"
+#include "ev-transition-gl.h"
+
+/* Transition layers are drawn as textured quads into a texture of the
+ * size of the slide, which GDK then composites into the window. The
+ * slides are uploaded as textures the first time they are drawn and
+ * kept until the animation finishes, so every frame only costs a few
+ * quads on the GPU instead of blending full screen images on the CPU.
+ */
+struct _EvTransitionGL {
+	GdkWindow    *window;
+	GdkGLContext *context;
+
+	GLuint        program;
+	GLint         viewport_location;
+	GLint         alpha_location;
+	GLint         opaque_location;
+	GLuint        vao;
+	GLuint        vbo;
+
+	GLuint        framebuffer;
+	GLuint        target;
+	gint          target_width;
+	gint          target_height;
+
+	/* cairo_surface_t -> texture */
+	GHashTable   *textures;
+};
+
+static const gchar *vertex_shader_source =
+	"#version 150\n"
+	"uniform vec2 viewport;\n"
+	"in vec2 position;\n"
+	"in vec2 uv;\n"
+	"out vec2 tex_coord;\n"
+	"void main () {\n"
+	"  tex_coord = uv;\n"
+	"  gl_Position = vec4 (position.x / viewport.x * 2.0 - 1.0,\n"
+	"                      1.0 - position.y / viewport.y * 2.0, 0.0, 1.0);\n"
+	"}\n";
+
+/* Textures keep the premultiplied colors of cairo */
+static const gchar *fragment_shader_source =
+	"#version 150\n"
+	"uniform sampler2D source;\n"
+	"uniform float alpha;\n"
+	"uniform bool opaque;\n"
+	"in vec2 tex_coord;\n"
+	"out vec4 color;\n"
+	"void main () {\n"
+	"  vec4 texel = texture (source, tex_coord);\n"
+	"  if (opaque)\n"
+	"    texel.a = 1.0;\n"
+	"  color = texel * alpha;\n"
+	"}\n";
+
+static GLuint
+compile_shader (GLenum        type,
+		const gchar  *source,
+		GError      **error)
+{
+	GLuint shader;
+	GLint  status;
+
+	shader = glCreateShader (type);
+	glShaderSource (shader, 1, &source, NULL);
+	glCompileShader (shader);
+
+	glGetShaderiv (shader, GL_COMPILE_STATUS, &status);
+	if (status == GL_FALSE) {
+		gchar log[512];
+
+		glGetShaderInfoLog (shader, sizeof (log), NULL, log);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     "Failed to compile transition shader: %s", log);
+		glDeleteShader (shader);
+
+		return 0;
+	}
+
+	return shader;
+}
+
+static gboolean
+ev_transition_gl_init_program (EvTransitionGL *gl,
+			       GError        **error)
+{
+	GLuint vertex_shader, fragment_shader;
+	GLint  status;
+
+	vertex_shader = compile_shader (GL_VERTEX_SHADER, vertex_shader_source, error);
+	if (!vertex_shader)
+		return FALSE;
+
+	fragment_shader = compile_shader (GL_FRAGMENT_SHADER, fragment_shader_source, error);
+	if (!fragment_shader) {
+		glDeleteShader (vertex_shader);
+		return FALSE;
+	}
+
+	gl->program = glCreateProgram ();
+	glAttachShader (gl->program, vertex_shader);
+	glAttachShader (gl->program, fragment_shader);
+	glBindAttribLocation (gl->program, 0, "position");
+	glBindAttribLocation (gl->program, 1, "uv");
+	glLinkProgram (gl->program);
+	glDeleteShader (vertex_shader);
+	glDeleteShader (fragment_shader);
+
+	glGetProgramiv (gl->program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "Failed to link transition shaders");
+		return FALSE;
+	}
+
+	gl->viewport_location = glGetUniformLocation (gl->program, "viewport");
+	gl->alpha_location = glGetUniformLocation (gl->program, "alpha");
+	gl->opaque_location = glGetUniformLocation (gl->program, "opaque");
+
+	glUseProgram (gl->program);
+	glUniform1i (glGetUniformLocation (gl->program, "source"), 0);
+
+	return TRUE;
+}
+
+/*
+ * ev_transition_gl_new:
+ * @window: the #GdkWindow transitions are painted on
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full): a new #EvTransitionGL, or %NULL if the
+ *   window doesn't support the OpenGL needed by transitions
+ */
+EvTransitionGL *
+ev_transition_gl_new (GdkWindow *window,
+		      GError   **error)
+{
+	EvTransitionGL *gl;
+	GdkGLContext   *context;
+
+	g_return_val_if_fail (GDK_IS_WINDOW (window), NULL);
+
+	context = gdk_window_create_gl_context (window, error);
+	if (!context)
+		return NULL;
+
+	gdk_gl_context_set_required_version (context, 3, 2);
+	if (!gdk_gl_context_realize (context, error)) {
+		g_object_unref (context);
+		return NULL;
+	}
+
+#if GTK_CHECK_VERSION(3, 22, 0)
+	/* The slides are uploaded in the BGRA order of cairo */
+	if (gdk_gl_context_get_use_es (context)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Transitions aren't supported with OpenGL ES");
+		g_object_unref (context);
+		return NULL;
+	}
+#endif
+
+	gl = g_new0 (EvTransitionGL, 1);
+	gl->window = window;
+	gl->context = context;
+	gl->textures = g_hash_table_new_full (NULL, NULL,
+					      (GDestroyNotify) cairo_surface_destroy,
+					      NULL);
+
+	gdk_gl_context_make_current (context);
+
+	if (!ev_transition_gl_init_program (gl, error)) {
+		ev_transition_gl_free (gl);
+		return NULL;
+	}
+
+	glGenVertexArrays (1, &gl->vao);
+	glBindVertexArray (gl->vao);
+	glGenBuffers (1, &gl->vbo);
+	glBindBuffer (GL_ARRAY_BUFFER, gl->vbo);
+	glEnableVertexAttribArray (0);
+	glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (GLfloat), NULL);
+	glEnableVertexAttribArray (1);
+	glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (GLfloat),
+			       (GLvoid *) (2 * sizeof (GLfloat)));
+
+	glGenFramebuffers (1, &gl->framebuffer);
+
+	return gl;
+}
+
+static void
+delete_texture (gpointer key,
+		gpointer value,
+		gpointer user_data)
+{
+	GLuint texture = GPOINTER_TO_UINT (value);
+
+	glDeleteTextures (1, &texture);
+}
+
+void
+ev_transition_gl_clear_textures (EvTransitionGL *gl)
+{
+	if (g_hash_table_size (gl->textures) == 0)
+		return;
+
+	gdk_gl_context_make_current (gl->context);
+	g_hash_table_foreach (gl->textures, delete_texture, NULL);
+	g_hash_table_remove_all (gl->textures);
+}
+
+/* Frees the GL resources, call it before the window is destroyed */
+void
+ev_transition_gl_free (EvTransitionGL *gl)
+{
+	if (!gl)
+		return;
+
+	gdk_gl_context_make_current (gl->context);
+
+	g_hash_table_foreach (gl->textures, delete_texture, NULL);
+	g_hash_table_destroy (gl->textures);
+
+	if (gl->target)
+		glDeleteTextures (1, &gl->target);
+	if (gl->framebuffer)
+		glDeleteFramebuffers (1, &gl->framebuffer);
+	if (gl->vbo)
+		glDeleteBuffers (1, &gl->vbo);
+	if (gl->vao)
+		glDeleteVertexArrays (1, &gl->vao);
+	if (gl->program)
+		glDeleteProgram (gl->program);
+
+	gdk_gl_context_clear_current ();
+	g_object_unref (gl->context);
+	g_free (gl);
+}
+
+static GLuint
+ev_transition_gl_get_texture (EvTransitionGL  *gl,
+			      cairo_surface_t *surface)
+{
+	gpointer texture_ptr;
+	GLuint   texture;
+	GLint    max_size;
+	gint     width, height;
+
+	if (g_hash_table_lookup_extended (gl->textures, surface, NULL, &texture_ptr))
+		return GPOINTER_TO_UINT (texture_ptr);
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return 0;
+
+	switch (cairo_image_surface_get_format (surface)) {
+	case CAIRO_FORMAT_ARGB32:
+	case CAIRO_FORMAT_RGB24:
+		break;
+	default:
+		return 0;
+	}
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	glGetIntegerv (GL_MAX_TEXTURE_SIZE, &max_size);
+	if (width > max_size || height > max_size)
+		return 0;
+
+	cairo_surface_flush (surface);
+
+	glGenTextures (1, &texture);
+	glBindTexture (GL_TEXTURE_2D, texture);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei (GL_UNPACK_ROW_LENGTH, cairo_image_surface_get_stride (surface) / 4);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+		      GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+		      cairo_image_surface_get_data (surface));
+	glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+
+	ev_debug_message (DEBUG_JOBS, "uploaded %dx%d transition texture", width, height);
+
+	g_hash_table_insert (gl->textures, cairo_surface_reference (surface),
+			     GUINT_TO_POINTER (texture));
+
+	return texture;
+}
+
+static gboolean
+ev_transition_gl_ensure_target (EvTransitionGL *gl,
+				gint            width,
+				gint            height)
+{
+	if (gl->target && gl->target_width == width && gl->target_height == height)
+		return TRUE;
+
+	if (!gl->target)
+		glGenTextures (1, &gl->target);
+	glBindTexture (GL_TEXTURE_2D, gl->target);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+		      GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+
+	glBindFramebuffer (GL_FRAMEBUFFER, gl->framebuffer);
+	glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				GL_TEXTURE_2D, gl->target, 0);
+	if (glCheckFramebufferStatus (GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer (GL_FRAMEBUFFER, 0);
+		return FALSE;
+	}
+
+	gl->target_width = width;
+	gl->target_height = height;
+
+	return TRUE;
+}
+
+static gboolean
+ev_transition_gl_draw_layer (EvTransitionGL          *gl,
+			     const EvTransitionLayer *layer,
+			     gint                     scale)
+{
+	GLuint  texture;
+	gdouble device_scale_x = 1, device_scale_y = 1;
+	gdouble x, y, width, height;
+	gint    clip_x, clip_y, clip_x2, clip_y2;
+	GLfloat vertices[16];
+
+	texture = ev_transition_gl_get_texture (gl, layer->surface);
+	if (!texture)
+		return FALSE;
+
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_get_device_scale (layer->surface, &device_scale_x, &device_scale_y);
+#endif
+
+	/* Same placement cairo gives the surface with its device offset */
+	x = - layer->x_offset / device_scale_x * scale;
+	y = - layer->y_offset / device_scale_y * scale;
+	width = cairo_image_surface_get_width (layer->surface) / device_scale_x * scale;
+	height = cairo_image_surface_get_height (layer->surface) / device_scale_y * scale;
+
+	vertices[0] = x;          vertices[1] = y;           vertices[2] = 0;  vertices[3] = 0;
+	vertices[4] = x + width;  vertices[5] = y;           vertices[6] = 1;  vertices[7] = 0;
+	vertices[8] = x;          vertices[9] = y + height;  vertices[10] = 0; vertices[11] = 1;
+	vertices[12] = x + width; vertices[13] = y + height; vertices[14] = 1; vertices[15] = 1;
+
+	/* The scissor box starts at the bottom of the target */
+	clip_x = floor (layer->clip.x * scale);
+	clip_y = floor (layer->clip.y * scale);
+	clip_x2 = ceil ((layer->clip.x + layer->clip.width) * scale);
+	clip_y2 = ceil ((layer->clip.y + layer->clip.height) * scale);
+	if (clip_x2 <= clip_x || clip_y2 <= clip_y)
+		return TRUE;
+	glScissor (clip_x, gl->target_height - clip_y2,
+		   clip_x2 - clip_x, clip_y2 - clip_y);
+
+	glBindTexture (GL_TEXTURE_2D, texture);
+	glUniform1f (gl->alpha_location, layer->alpha);
+	glUniform1i (gl->opaque_location,
+		     cairo_image_surface_get_format (layer->surface) == CAIRO_FORMAT_RGB24);
+	glBufferData (GL_ARRAY_BUFFER, sizeof (vertices), vertices, GL_STREAM_DRAW);
+	glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+
+	return TRUE;
+}
+
+/*
+ * ev_transition_gl_paint:
+ * @gl: an #EvTransitionGL
+ * @cr: the cairo context of the window, translated to the slide
+ * @layers: the layers of the frame, painted in order
+ * @n_layers: the number of layers
+ * @page_area: the slide, with its origin at 0,0
+ *
+ * Returns: %FALSE if the layers couldn't be drawn with GL
+ */
+gboolean
+ev_transition_gl_paint (EvTransitionGL          *gl,
+			cairo_t                 *cr,
+			const EvTransitionLayer *layers,
+			guint                    n_layers,
+			GdkRectangle             page_area)
+{
+	gint     scale = gdk_window_get_scale_factor (gl->window);
+	gint     width = page_area.width * scale;
+	gint     height = page_area.height * scale;
+	gboolean retval = TRUE;
+	guint    i;
+
+	if (width <= 0 || height <= 0)
+		return TRUE;
+
+	gdk_gl_context_make_current (gl->context);
+
+	if (!ev_transition_gl_ensure_target (gl, width, height))
+		return FALSE;
+
+	glBindFramebuffer (GL_FRAMEBUFFER, gl->framebuffer);
+	glViewport (0, 0, width, height);
+	glDisable (GL_SCISSOR_TEST);
+	glClearColor (0, 0, 0, 0);
+	glClear (GL_COLOR_BUFFER_BIT);
+
+	glUseProgram (gl->program);
+	glUniform2f (gl->viewport_location, width, height);
+	glBindVertexArray (gl->vao);
+	glBindBuffer (GL_ARRAY_BUFFER, gl->vbo);
+	glActiveTexture (GL_TEXTURE0);
+	glEnable (GL_BLEND);
+	glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable (GL_SCISSOR_TEST);
+
+	for (i = 0; i < n_layers && retval; i++)
+		retval = ev_transition_gl_draw_layer (gl, &layers[i], scale);
+
+	glDisable (GL_SCISSOR_TEST);
+	glDisable (GL_BLEND);
+	glBindFramebuffer (GL_FRAMEBUFFER, 0);
+
+	if (!retval)
+		return FALSE;
+
+	gdk_cairo_draw_from_gl (cr, gl->window, gl->target, GL_TEXTURE, scale,
+				0, 0, width, height);
+
+	return TRUE;
+}
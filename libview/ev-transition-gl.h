@@ -0,0 +1,44 @@
+/* ev-transition-gl.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef EV_TRANSITION_GL_H
+#define EV_TRANSITION_GL_H
+
+#include <gdk/gdk.h>
+
+#include "ev-transition-animation.h"
+
+G_BEGIN_DECLS
+
+EvTransitionGL *ev_transition_gl_new            (GdkWindow               *window,
+						 GError                 **error);
+void            ev_transition_gl_free           (EvTransitionGL          *gl);
+gboolean        ev_transition_gl_paint          (EvTransitionGL          *gl,
+						 cairo_t                 *cr,
+						 const EvTransitionLayer *layers,
+						 guint                    n_layers,
+						 GdkRectangle             page_area);
+void            ev_transition_gl_clear_textures (EvTransitionGL          *gl);
+
+G_END_DECLS
+
+#endif /* EV_TRANSITION_GL_H */
@@ -65,9 +65,18 @@ struct _EvViewAccessiblePrivate {
 	gint end_page;
 	AtkObject *focused_element;
 
+	/* Pages are created when they are asked for, children holds a
+	 * weak pointer to every page alive and kept a reference to the
+	 * ones close to the visible range. The others live as long as
+	 * the assistive technologies hold them.
+	 */
 	GPtrArray *children;
+	GPtrArray *kept;
 };
 
+/* Pages around the visible range that are kept once created */
+#define KEEP_PAGES 5
+
 G_DEFINE_TYPE_WITH_CODE (EvViewAccessible, ev_view_accessible, GTK_TYPE_CONTAINER_ACCESSIBLE,
 			 G_IMPLEMENT_INTERFACE (ATK_TYPE_ACTION, ev_view_accessible_action_iface_init)
 			 G_IMPLEMENT_INTERFACE (ATK_TYPE_DOCUMENT, ev_view_accessible_document_iface_init)
@@ -90,12 +99,62 @@ clear_children (EvViewAccessible *self)
 
 	for (i = 0; i < self->priv->children->len; i++) {
 		child = g_ptr_array_index (self->priv->children, i);
+		if (!child)
+			continue;
+
 		atk_object_notify_state_change (child, ATK_STATE_DEFUNCT, TRUE);
+		g_object_remove_weak_pointer (G_OBJECT (child),
+					      &g_ptr_array_index (self->priv->children, i));
 	}
 
+	g_clear_pointer (&self->priv->kept, g_ptr_array_unref);
 	g_clear_pointer (&self->priv->children, g_ptr_array_unref);
 }
 
+static gboolean
+is_page_kept (EvViewAccessible *self,
+	      gint              page)
+{
+	return page >= self->priv->start_page - KEEP_PAGES &&
+		page <= self->priv->end_page + KEEP_PAGES;
+}
+
+/* Returns the accessible of @page if it's alive, without creating it */
+static AtkObject *
+peek_page (EvViewAccessible *self,
+	   gint              page)
+{
+	if (self->priv->children == NULL || page < 0 || page >= self->priv->children->len)
+		return NULL;
+
+	return g_ptr_array_index (self->priv->children, page);
+}
+
+/* Returns a new reference to the accessible of @page, creating it if needed */
+static AtkObject *
+ref_page (EvViewAccessible *self,
+	  gint              page)
+{
+	AtkObject *child;
+
+	if (self->priv->children == NULL || page < 0 || page >= self->priv->children->len)
+		return NULL;
+
+	child = g_ptr_array_index (self->priv->children, page);
+	if (child)
+		return g_object_ref (child);
+
+	child = ATK_OBJECT (ev_page_accessible_new (self, page));
+	g_ptr_array_index (self->priv->children, page) = child;
+	g_object_add_weak_pointer (G_OBJECT (child),
+				   &g_ptr_array_index (self->priv->children, page));
+
+	if (is_page_kept (self, page))
+		g_ptr_array_add (self->priv->kept, g_object_ref (child));
+
+	return child;
+}
+
 static void
 ev_view_accessible_finalize (GObject *object)
 {
@@ -156,7 +215,7 @@ ev_view_accessible_ref_child (AtkObject *obj,
 	if (view->page_cache)
 		ev_page_cache_ensure_page (view->page_cache, i);
 
-	return g_object_ref (g_ptr_array_index (self->priv->children, i));
+	return ref_page (self, i);
 }
 
 static gint
@@ -330,12 +389,15 @@ ev_view_accessible_cursor_moved (EvView *view,
 		AtkObject *previous_page = NULL;
 		AtkObject *current_page = NULL;
 
-		previous_page = g_ptr_array_index (priv->children,
-						   priv->previous_cursor_page);
-		atk_object_notify_state_change (previous_page, ATK_STATE_FOCUSED, FALSE);
+		previous_page = peek_page (accessible, priv->previous_cursor_page);
+		if (previous_page)
+			atk_object_notify_state_change (previous_page, ATK_STATE_FOCUSED, FALSE);
 		priv->previous_cursor_page = page;
-		current_page = g_ptr_array_index (priv->children, page);
-		atk_object_notify_state_change (current_page, ATK_STATE_FOCUSED, TRUE);
+		current_page = ref_page (accessible, page);
+		if (current_page) {
+			atk_object_notify_state_change (current_page, ATK_STATE_FOCUSED, TRUE);
+			g_object_unref (current_page);
+		}
 
 #if ATK_CHECK_VERSION (2, 11, 2)
 		/* +1 as user start to count on 1, but evince starts on 0 */
@@ -343,8 +405,11 @@ ev_view_accessible_cursor_moved (EvView *view,
 #endif
 	}
 
-	page_accessible = g_ptr_array_index (priv->children, page);
+	page_accessible = EV_PAGE_ACCESSIBLE (ref_page (accessible, page));
+	if (!page_accessible)
+		return;
 	g_signal_emit_by_name (page_accessible, "text-caret-moved", offset);
+	g_object_unref (page_accessible);
 }
 
 static void
@@ -353,9 +418,11 @@ ev_view_accessible_selection_changed (EvView *view,
 {
 	AtkObject *page_accessible;
 
-	page_accessible = g_ptr_array_index (view_accessible->priv->children,
-					     get_relevant_page (view));
+	page_accessible = ref_page (view_accessible, get_relevant_page (view));
+	if (!page_accessible)
+		return;
 	g_signal_emit_by_name (page_accessible, "text-selection-changed");
+	g_object_unref (page_accessible);
 }
 
 static void
@@ -376,19 +443,17 @@ page_changed_cb (EvDocumentModel  *model,
 static void
 initialize_children (EvViewAccessible *self)
 {
-	gint i;
-	EvPageAccessible *child;
 	gint n_pages;
 	EvDocument *ev_document;
 
 	ev_document = ev_document_model_get_document (self->priv->model);
 	n_pages = ev_document_get_n_pages (ev_document);
 
-	self->priv->children = g_ptr_array_new_full (n_pages, (GDestroyNotify) g_object_unref);
-	for (i = 0; i < n_pages; i++) {
-		child = ev_page_accessible_new (self, i);
-		g_ptr_array_add (self->priv->children, child);
-	}
+	/* The array doesn't grow from here, so that the weak
+	 * pointers to its elements stay valid */
+	self->priv->children = g_ptr_array_sized_new (n_pages);
+	g_ptr_array_set_size (self->priv->children, n_pages);
+	self->priv->kept = g_ptr_array_new_with_free_func (g_object_unref);
 
         /* When a document is reloaded, it may have less pages.
          * We need to update the end page accordingly to avoid
@@ -461,10 +526,12 @@ ev_view_accessible_focus_changed (GtkWidget        *widget,
 	if (self->priv->children == NULL || self->priv->children->len == 0)
 		return FALSE;
 
-	page_accessible = g_ptr_array_index (self->priv->children,
-					     get_relevant_page (EV_VIEW (widget)));
+	page_accessible = ref_page (self, get_relevant_page (EV_VIEW (widget)));
+	if (!page_accessible)
+		return FALSE;
 	atk_object_notify_state_change (page_accessible,
 					ATK_STATE_FOCUSED, event->in);
+	g_object_unref (page_accessible);
 
 	return FALSE;
 }
@@ -585,22 +652,34 @@ ev_view_accessible_set_page_range (EvViewAccessible *accessible,
 
 	g_return_if_fail (EV_IS_VIEW_ACCESSIBLE (accessible));
 
+	/* Pages that haven't been created have no state to update */
 	for (i = accessible->priv->start_page; i <= accessible->priv->end_page; i++) {
 		if (i < start || i > end) {
-			page = g_ptr_array_index (accessible->priv->children, i);
-			atk_object_notify_state_change (page, ATK_STATE_SHOWING, FALSE);
+			page = peek_page (accessible, i);
+			if (page)
+				atk_object_notify_state_change (page, ATK_STATE_SHOWING, FALSE);
 		}
 	}
 
 	for (i = start; i <= end; i++) {
 		if (i < accessible->priv->start_page || i > accessible->priv->end_page) {
-			page = g_ptr_array_index (accessible->priv->children, i);
-			atk_object_notify_state_change (page, ATK_STATE_SHOWING, TRUE);
+			page = peek_page (accessible, i);
+			if (page)
+				atk_object_notify_state_change (page, ATK_STATE_SHOWING, TRUE);
 		}
 	}
 
 	accessible->priv->start_page = start;
 	accessible->priv->end_page = end;
+
+	/* Drop the pages far from the new range */
+	if (accessible->priv->kept) {
+		for (i = accessible->priv->kept->len - 1; i >= 0; i--) {
+			page = g_ptr_array_index (accessible->priv->kept, i);
+			if (!is_page_kept (accessible, ev_page_accessible_get_page (EV_PAGE_ACCESSIBLE (page))))
+				g_ptr_array_remove_index_fast (accessible->priv->kept, i);
+		}
+	}
 }
 
 void
@@ -618,10 +697,13 @@ ev_view_accessible_set_focused_element (EvViewAccessible *accessible,
 	if (!new_focus || new_focus_page == -1)
 		return;
 
-	page = g_ptr_array_index (accessible->priv->children, new_focus_page);
+	page = EV_PAGE_ACCESSIBLE (ref_page (accessible, new_focus_page));
+	if (!page)
+		return;
 	accessible->priv->focused_element = ev_page_accessible_get_accessible_for_mapping (page, new_focus);
 	if (accessible->priv->focused_element)
 		atk_object_notify_state_change (accessible->priv->focused_element, ATK_STATE_FOCUSED, TRUE);
+	g_object_unref (page);
 }
 
 void
@@ -631,6 +713,8 @@ ev_view_accessible_update_element_state (EvViewAccessible *accessible,
 {
 	EvPageAccessible *page;
 
-	page = g_ptr_array_index (accessible->priv->children, element_page);
-	ev_page_accessible_update_element_state (page, element);
+	/* Elements of pages not created yet get their state when they are */
+	page = EV_PAGE_ACCESSIBLE (peek_page (accessible, element_page));
+	if (page)
+		ev_page_accessible_update_element_state (page, element);
 }
@@ -27,7 +27,11 @@
 #include "ev-view-presentation.h"
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
+#include "ev-surface-budget.h"
 #include "ev-transition-animation.h"
+#ifdef ENABLE_GL_TRANSITIONS
+#include "ev-transition-gl.h"
+#endif
 #include "ev-view-cursor.h"
 #include "ev-page-cache.h"
 
@@ -36,7 +40,8 @@ enum {
 	PROP_DOCUMENT,
 	PROP_CURRENT_PAGE,
 	PROP_ROTATION,
-	PROP_INVERTED_COLORS
+	PROP_INVERTED_COLORS,
+	PROP_PRERENDER_SIZE
 };
 
 enum {
@@ -82,13 +87,19 @@ struct _EvViewPresentation
 	/* Animations */
 	gboolean               enable_animations;
 	EvTransitionAnimation *animation;
+#ifdef ENABLE_GL_TRANSITIONS
+	EvTransitionGL        *transition_gl;
+	gboolean               transition_gl_failed;
+#endif
 
 	/* Links */
 	EvPageCache           *page_cache;
 
-	EvJob *prev_job;
-	EvJob *curr_job;
-	EvJob *next_job;
+	/* Slides rendered around the current one, by page */
+	GHashTable            *jobs;
+	guint                  prerender_size;
+	gint                   direction;
+	gboolean               advance_pending;
 };
 
 struct _EvViewPresentationClass
@@ -111,6 +122,14 @@ static void ev_view_presentation_set_cursor_for_location (EvViewPresentation *pv
 
 #define HIDE_CURSOR_TIMEOUT 5
 
+/* Slides kept ahead of the current one by default */
+#define DEFAULT_PRERENDER_SIZE 2
+/* Link targets of the current slide that are prerendered */
+#define MAX_PRERENDERED_LINKS 4
+
+static EvJob *ev_view_presentation_get_job (EvViewPresentation *pview,
+					    gint                page);
+
 G_DEFINE_TYPE (EvViewPresentation, ev_view_presentation, GTK_TYPE_WIDGET)
 
 #if !GTK_CHECK_VERSION(3, 20, 0)
@@ -233,6 +252,18 @@ ev_view_presentation_get_page_area (EvViewPresentation *pview,
 static gboolean
 transition_next_page (EvViewPresentation *pview)
 {
+	EvJob *job;
+
+	pview->trans_timeout_id = 0;
+
+	/* Wait for the next slide, so that the change and its
+	 * animation don't start on a blank slide */
+	job = ev_view_presentation_get_job (pview, pview->current_page + 1);
+	if (job && !ev_job_is_finished (job)) {
+		pview->advance_pending = TRUE;
+		return FALSE;
+	}
+
 	ev_view_presentation_next_page (pview);
 
 	return FALSE;
@@ -244,6 +275,7 @@ ev_view_presentation_transition_stop (EvViewPresentation *pview)
 	if (pview->trans_timeout_id > 0)
 		g_source_remove (pview->trans_timeout_id);
 	pview->trans_timeout_id = 0;
+	pview->advance_pending = FALSE;
 }
 
 static void
@@ -274,8 +306,49 @@ ev_view_presentation_animation_cancel (EvViewPresentation *pview)
 		g_object_unref (pview->animation);
 		pview->animation = NULL;
 	}
+
+#ifdef ENABLE_GL_TRANSITIONS
+	/* The slides are uploaded again for the next animation */
+	if (pview->transition_gl)
+		ev_transition_gl_clear_textures (pview->transition_gl);
+#endif
 }
 
+#ifdef ENABLE_GL_TRANSITIONS
+static gboolean
+ev_view_presentation_paint_animation_gl (EvViewPresentation *pview,
+					 cairo_t            *cr,
+					 GdkRectangle        page_area)
+{
+	if (pview->transition_gl_failed)
+		return FALSE;
+
+	if (!pview->transition_gl) {
+		GError *error = NULL;
+
+		pview->transition_gl = ev_transition_gl_new (gtk_widget_get_window (GTK_WIDGET (pview)),
+							     &error);
+		if (!pview->transition_gl) {
+			g_message ("Transitions are painted without OpenGL: %s", error->message);
+			g_error_free (error);
+			pview->transition_gl_failed = TRUE;
+
+			return FALSE;
+		}
+	}
+
+	if (ev_transition_animation_paint_gl (pview->animation, pview->transition_gl,
+					      cr, page_area))
+		return TRUE;
+
+	/* Slides GL can't draw, like ones too big for a texture */
+	g_clear_pointer (&pview->transition_gl, ev_transition_gl_free);
+	pview->transition_gl_failed = TRUE;
+
+	return FALSE;
+}
+#endif
+
 static void
 ev_view_presentation_transition_animation_finish (EvViewPresentation *pview)
 {
@@ -319,9 +392,8 @@ ev_view_presentation_animation_start (EvViewPresentation *pview,
 				      gint                new_page)
 {
 	EvTransitionEffect *effect = NULL;
-	EvJob		   *job;
 	cairo_surface_t    *surface;
-	gint                jump;
+	EvJob		   *job;
 
 	if (!pview->enable_animations)
 		return;
@@ -336,19 +408,14 @@ ev_view_presentation_animation_start (EvViewPresentation *pview,
 
 	pview->animation = ev_transition_animation_new (effect);
 
-	surface = pview->curr_job ? EV_JOB_RENDER (pview->curr_job)->surface : NULL;
+	job = ev_view_presentation_get_job (pview, pview->current_page);
+	surface = job ? EV_JOB_RENDER (job)->surface : NULL;
 	ev_transition_animation_set_origin_surface (pview->animation,
 						    surface != NULL ?
 						    surface : pview->current_surface);
 
-	jump = new_page - pview->current_page;
-	if (jump == -1)
-		job = pview->prev_job;
-	else if (jump == 1)
-		job = pview->next_job;
-	else
-		job = NULL;
-	surface = get_surface_from_job (pview, job);
+	/* Any prerendered slide is a ready destination */
+	surface = get_surface_from_job (pview, ev_view_presentation_get_job (pview, new_page));
 	if (surface)
 		ev_transition_animation_set_dest_surface (pview->animation, surface);
 
@@ -370,7 +437,18 @@ job_finished_cb (EvJob              *job,
 	if (pview->inverted_colors)
 		ev_document_misc_invert_surface (job_render->surface);
 
-	if (job != pview->curr_job)
+	/* Slides are always about to be shown, they are accounted
+	 * in the budget but never evicted */
+	if (job_render->surface)
+		ev_surface_budget_add (job_render->surface, NULL, NULL);
+
+	if (pview->advance_pending && job_render->page == pview->current_page + 1) {
+		pview->advance_pending = FALSE;
+		ev_view_presentation_next_page (pview);
+		return;
+	}
+
+	if (job_render->page != pview->current_page)
 		return;
 
 	if (pview->animation) {
@@ -406,7 +484,7 @@ ev_view_presentation_schedule_new_job (EvViewPresentation *pview,
 	g_signal_connect (job, "finished",
 			  G_CALLBACK (job_finished_cb),
 			  pview);
-	ev_job_scheduler_push_job (job, priority);
+	ev_job_scheduler_push_job_for_client (job, priority, pview);
 
 	return job;
 }
@@ -423,118 +501,179 @@ ev_view_presentation_delete_job (EvViewPresentation *pview,
 	g_object_unref (job);
 }
 
+static EvJob *
+ev_view_presentation_get_job (EvViewPresentation *pview,
+			      gint                page)
+{
+	if (!pview->jobs)
+		return NULL;
+
+	return g_hash_table_lookup (pview->jobs, GINT_TO_POINTER (page));
+}
+
+static void
+ev_view_presentation_ensure_job (EvViewPresentation *pview,
+				 gint                page,
+				 EvJobPriority       priority)
+{
+	EvJob *job;
+
+	if (page < 0 || page >= ev_document_get_n_pages (pview->document))
+		return;
+
+	job = ev_view_presentation_get_job (pview, page);
+	if (job) {
+		ev_job_scheduler_update_job (job, priority);
+		return;
+	}
+
+	job = ev_view_presentation_schedule_new_job (pview, page, priority);
+	g_hash_table_insert (pview->jobs, GINT_TO_POINTER (page), job);
+}
+
 static void
 ev_view_presentation_reset_jobs (EvViewPresentation *pview)
 {
-        if (pview->curr_job) {
-                ev_view_presentation_delete_job (pview, pview->curr_job);
-                pview->curr_job = NULL;
-        }
+	GHashTableIter iter;
+	gpointer       job;
 
-        if (pview->prev_job) {
-                ev_view_presentation_delete_job (pview, pview->prev_job);
-                pview->prev_job = NULL;
-        }
+	if (!pview->jobs)
+		return;
 
-        if (pview->next_job) {
-                ev_view_presentation_delete_job (pview, pview->next_job);
-                pview->next_job = NULL;
-        }
+	g_hash_table_iter_init (&iter, pview->jobs);
+	while (g_hash_table_iter_next (&iter, NULL, &job)) {
+		ev_view_presentation_delete_job (pview, EV_JOB (job));
+		g_hash_table_iter_remove (&iter);
+	}
+}
+
+/* Pages the links of the current slide go to, once its links are cached */
+static GList *
+ev_view_presentation_get_link_targets (EvViewPresentation *pview)
+{
+	EvMappingList *link_mapping;
+	GList         *targets = NULL;
+	GList         *l;
+	guint          n_targets = 0;
+
+	if (!pview->page_cache)
+		return NULL;
+
+	link_mapping = ev_page_cache_get_link_mapping (pview->page_cache, pview->current_page);
+	if (!link_mapping)
+		return NULL;
+
+	for (l = ev_mapping_list_get_list (link_mapping); l && n_targets < MAX_PRERENDERED_LINKS; l = g_list_next (l)) {
+		EvLink       *link = EV_LINK (((EvMapping *) l->data)->data);
+		EvLinkAction *action = ev_link_get_action (link);
+		EvLinkDest   *dest;
+		gint          page;
+
+		if (!action || ev_link_action_get_action_type (action) != EV_LINK_ACTION_TYPE_GOTO_DEST)
+			continue;
+
+		dest = ev_link_action_get_dest (action);
+		if (!dest)
+			continue;
+
+		page = ev_document_links_get_dest_page (EV_DOCUMENT_LINKS (pview->document), dest);
+		if (page < 0 || page == pview->current_page ||
+		    g_list_find (targets, GINT_TO_POINTER (page)))
+			continue;
+
+		targets = g_list_prepend (targets, GINT_TO_POINTER (page));
+		n_targets++;
+	}
+
+	return targets;
+}
+
+/* Keeps the current slide, prerender_size slides in the direction the
+ * presentation goes, one slide back and the targets of the links of the
+ * current slide. The rest are dropped.
+ */
+static void
+ev_view_presentation_update_jobs (EvViewPresentation *pview)
+{
+	GHashTableIter iter;
+	gpointer       key, job;
+	GList         *targets, *l;
+	gint           page = pview->current_page;
+	gint           first, last;
+	guint          i;
+
+	if (!pview->jobs)
+		pview->jobs = g_hash_table_new (NULL, NULL);
+
+	if (pview->direction >= 0) {
+		first = page - 1;
+		last = page + pview->prerender_size;
+	} else {
+		first = page - pview->prerender_size;
+		last = page + 1;
+	}
+
+	targets = ev_view_presentation_get_link_targets (pview);
+
+	g_hash_table_iter_init (&iter, pview->jobs);
+	while (g_hash_table_iter_next (&iter, &key, &job)) {
+		gint job_page = GPOINTER_TO_INT (key);
+
+		if ((job_page >= first && job_page <= last) ||
+		    g_list_find (targets, key))
+			continue;
+
+		ev_view_presentation_delete_job (pview, EV_JOB (job));
+		g_hash_table_iter_remove (&iter);
+	}
+
+	ev_view_presentation_ensure_job (pview, page, EV_JOB_PRIORITY_URGENT);
+	for (i = 1; i <= pview->prerender_size; i++) {
+		ev_view_presentation_ensure_job (pview, page + i * (pview->direction >= 0 ? 1 : -1),
+						 i == 1 ? EV_JOB_PRIORITY_HIGH : EV_JOB_PRIORITY_LOW);
+	}
+	ev_view_presentation_ensure_job (pview, page - (pview->direction >= 0 ? 1 : -1),
+					 EV_JOB_PRIORITY_LOW);
+
+	for (l = targets; l; l = g_list_next (l))
+		ev_view_presentation_ensure_job (pview, GPOINTER_TO_INT (l->data), EV_JOB_PRIORITY_LOW);
+	g_list_free (targets);
+}
+
+static void
+page_cached_cb (EvPageCache        *page_cache,
+		gint                page,
+		EvViewPresentation *pview)
+{
+	if (page == pview->current_page)
+		ev_view_presentation_update_jobs (pview);
 }
 
 static void
 ev_view_presentation_update_current_page (EvViewPresentation *pview,
 					  guint               page)
 {
-	gint jump;
+	EvJob *job;
+	gint   jump;
 
 	if (page < 0 || page >= ev_document_get_n_pages (pview->document))
 		return;
 
 	ev_view_presentation_animation_cancel (pview);
 	ev_view_presentation_animation_start (pview, page);
+	pview->advance_pending = FALSE;
 
 	jump = page - pview->current_page;
-
-	switch (jump) {
-	case 0:
-		if (!pview->curr_job)
-			pview->curr_job = ev_view_presentation_schedule_new_job (pview, page, EV_JOB_PRIORITY_URGENT);
-		if (!pview->next_job)
-			pview->next_job = ev_view_presentation_schedule_new_job (pview, page + 1, EV_JOB_PRIORITY_HIGH);
-		if (!pview->prev_job)
-			pview->prev_job = ev_view_presentation_schedule_new_job (pview, page - 1, EV_JOB_PRIORITY_LOW);
-		break;
-	case -1:
-		ev_view_presentation_delete_job (pview, pview->next_job);
-		pview->next_job = pview->curr_job;
-		pview->curr_job = pview->prev_job;
-
-		if (!pview->curr_job)
-			pview->curr_job = ev_view_presentation_schedule_new_job (pview, page, EV_JOB_PRIORITY_URGENT);
-		else
-			ev_job_scheduler_update_job (pview->curr_job, EV_JOB_PRIORITY_URGENT);
-		pview->prev_job = ev_view_presentation_schedule_new_job (pview, page - 1, EV_JOB_PRIORITY_HIGH);
-		ev_job_scheduler_update_job (pview->next_job, EV_JOB_PRIORITY_LOW);
-
-		break;
-	case 1:
-		ev_view_presentation_delete_job (pview, pview->prev_job);
-		pview->prev_job = pview->curr_job;
-		pview->curr_job = pview->next_job;
-
-		if (!pview->curr_job)
-			pview->curr_job = ev_view_presentation_schedule_new_job (pview, page, EV_JOB_PRIORITY_URGENT);
-		else
-			ev_job_scheduler_update_job (pview->curr_job, EV_JOB_PRIORITY_URGENT);
-		pview->next_job = ev_view_presentation_schedule_new_job (pview, page + 1, EV_JOB_PRIORITY_HIGH);
-		ev_job_scheduler_update_job (pview->prev_job, EV_JOB_PRIORITY_LOW);
-
-		break;
-	case -2:
-		ev_view_presentation_delete_job (pview, pview->next_job);
-		ev_view_presentation_delete_job (pview, pview->curr_job);
-		pview->next_job = pview->prev_job;
-
-		pview->curr_job = ev_view_presentation_schedule_new_job (pview, page, EV_JOB_PRIORITY_URGENT);
-		pview->prev_job = ev_view_presentation_schedule_new_job (pview, page - 1, EV_JOB_PRIORITY_HIGH);
-		if (!pview->next_job)
-			pview->next_job = ev_view_presentation_schedule_new_job (pview, page + 1, EV_JOB_PRIORITY_LOW);
-		else
-			ev_job_scheduler_update_job (pview->next_job, EV_JOB_PRIORITY_LOW);
-		break;
-	case 2:
-		ev_view_presentation_delete_job (pview, pview->prev_job);
-		ev_view_presentation_delete_job (pview, pview->curr_job);
-		pview->prev_job = pview->next_job;
-
-		pview->curr_job = ev_view_presentation_schedule_new_job (pview, page, EV_JOB_PRIORITY_URGENT);
-		pview->next_job = ev_view_presentation_schedule_new_job (pview, page + 1, EV_JOB_PRIORITY_HIGH);
-		if (!pview->prev_job)
-			pview->prev_job = ev_view_presentation_schedule_new_job (pview, page - 1, EV_JOB_PRIORITY_LOW);
-		else
-			ev_job_scheduler_update_job (pview->prev_job, EV_JOB_PRIORITY_LOW);
-		break;
-	default:
-		ev_view_presentation_delete_job (pview, pview->prev_job);
-		ev_view_presentation_delete_job (pview, pview->curr_job);
-		ev_view_presentation_delete_job (pview, pview->next_job);
-
-		pview->curr_job = ev_view_presentation_schedule_new_job (pview, page, EV_JOB_PRIORITY_URGENT);
-		if (jump > 0) {
-			pview->next_job = ev_view_presentation_schedule_new_job (pview, page + 1, EV_JOB_PRIORITY_HIGH);
-			pview->prev_job = ev_view_presentation_schedule_new_job (pview, page - 1, EV_JOB_PRIORITY_LOW);
-		} else {
-			pview->prev_job = ev_view_presentation_schedule_new_job (pview, page - 1, EV_JOB_PRIORITY_HIGH);
-			pview->next_job = ev_view_presentation_schedule_new_job (pview, page + 1, EV_JOB_PRIORITY_LOW);
-		}
-	}
+	if (jump != 0)
+		pview->direction = jump > 0 ? 1 : -1;
 
 	if (pview->current_page != page) {
 		pview->current_page = page;
 		g_object_notify (G_OBJECT (pview), "current-page");
 	}
 
+	ev_view_presentation_update_jobs (pview);
+
 	if (pview->page_cache)
 		ev_page_cache_set_page_range (pview->page_cache, page, page);
 
@@ -545,7 +684,8 @@ ev_view_presentation_update_current_page (EvViewPresentation *pview,
 		ev_view_presentation_set_cursor_for_location (pview, x, y);
 	}
 
-	if (EV_JOB_RENDER (pview->curr_job)->surface)
+	job = ev_view_presentation_get_job (pview, page);
+	if (EV_JOB_RENDER (job)->surface)
 		gtk_widget_queue_draw (GTK_WIDGET (pview));
 }
 
@@ -1008,6 +1148,7 @@ ev_view_presentation_dispose (GObject *object)
 	ev_view_presentation_transition_stop (pview);
 	ev_view_presentation_hide_cursor_timeout_stop (pview);
         ev_view_presentation_reset_jobs (pview);
+	g_clear_pointer (&pview->jobs, g_hash_table_destroy);
 
 	if (pview->current_surface) {
 		cairo_surface_destroy (pview->current_surface);
@@ -1015,6 +1156,8 @@ ev_view_presentation_dispose (GObject *object)
 	}
 
 	if (pview->page_cache) {
+		g_signal_handlers_disconnect_by_func (pview->page_cache,
+						      page_cached_cb, pview);
 		g_object_unref (pview->page_cache);
 		pview->page_cache = NULL;
 	}
@@ -1119,7 +1262,10 @@ ev_view_presentation_draw (GtkWidget *widget,
 			/* Try to fix rounding errors */
 			page_area.width--;
 
-			ev_transition_animation_paint (pview->animation, cr, page_area);
+#ifdef ENABLE_GL_TRANSITIONS
+			if (!ev_view_presentation_paint_animation_gl (pview, cr, page_area))
+#endif
+				ev_transition_animation_paint (pview->animation, cr, page_area);
 
                         cairo_restore (cr);
 		}
@@ -1127,7 +1273,7 @@ ev_view_presentation_draw (GtkWidget *widget,
 		return TRUE;
 	}
 
-	surface = get_surface_from_job (pview, pview->curr_job);
+	surface = get_surface_from_job (pview, ev_view_presentation_get_job (pview, pview->current_page));
 	if (surface) {
 		ev_view_presentation_update_current_surface (pview, surface);
 	} else if (pview->current_surface) {
@@ -1349,6 +1495,19 @@ ev_view_presentation_realize (GtkWidget *widget)
 	g_idle_add ((GSourceFunc)init_presentation, widget);
 }
 
+static void
+ev_view_presentation_unrealize (GtkWidget *widget)
+{
+#ifdef ENABLE_GL_TRANSITIONS
+	EvViewPresentation *pview = EV_VIEW_PRESENTATION (widget);
+
+	g_clear_pointer (&pview->transition_gl, ev_transition_gl_free);
+	pview->transition_gl_failed = FALSE;
+#endif
+
+	GTK_WIDGET_CLASS (ev_view_presentation_parent_class)->unrealize (widget);
+}
+
 static void
 ev_view_presentation_change_page (EvViewPresentation *pview,
 				  GtkScrollType       scroll)
@@ -1431,6 +1590,9 @@ ev_view_presentation_set_property (GObject      *object,
 	case PROP_INVERTED_COLORS:
 		pview->inverted_colors = g_value_get_boolean (value);
 		break;
+	case PROP_PRERENDER_SIZE:
+		ev_view_presentation_set_prerender_size (pview, g_value_get_uint (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 	}
@@ -1451,6 +1613,9 @@ ev_view_presentation_get_property (GObject    *object,
         case PROP_ROTATION:
                 g_value_set_uint (value, ev_view_presentation_get_rotation (pview));
                 break;
+        case PROP_PRERENDER_SIZE:
+                g_value_set_uint (value, ev_view_presentation_get_prerender_size (pview));
+                break;
         default:
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         }
@@ -1480,7 +1645,10 @@ ev_view_presentation_constructor (GType                  type,
 
 	if (EV_IS_DOCUMENT_LINKS (pview->document)) {
 		pview->page_cache = ev_page_cache_new (pview->document);
+		ev_page_cache_set_scheduler_client (pview->page_cache, pview);
 		ev_page_cache_set_flags (pview->page_cache, EV_PAGE_DATA_INCLUDE_LINKS);
+		g_signal_connect (pview->page_cache, "page-cached",
+				  G_CALLBACK (page_cached_cb), pview);
 	}
 
         g_signal_connect (object, "notify::scale-factor",
@@ -1503,6 +1671,7 @@ ev_view_presentation_class_init (EvViewPresentationClass *klass)
 	widget_class->get_preferred_width = ev_view_presentation_get_preferred_width;
 	widget_class->get_preferred_height = ev_view_presentation_get_preferred_height;
 	widget_class->realize = ev_view_presentation_realize;
+	widget_class->unrealize = ev_view_presentation_unrealize;
         widget_class->draw = ev_view_presentation_draw;
 	widget_class->key_press_event = ev_view_presentation_key_press_event;
 	widget_class->button_release_event = ev_view_presentation_button_release_event;
@@ -1554,6 +1723,21 @@ ev_view_presentation_class_init (EvViewPresentationClass *klass)
 							       G_PARAM_WRITABLE |
 							       G_PARAM_CONSTRUCT_ONLY |
                                                                G_PARAM_STATIC_STRINGS));
+	/**
+	 * EvViewPresentation:prerender-size:
+	 *
+	 * The number of slides rendered ahead of the current one.
+	 *
+	 * Since: 3.30
+	 */
+	g_object_class_install_property (gobject_class,
+					 PROP_PRERENDER_SIZE,
+					 g_param_spec_uint ("prerender-size",
+							    "Prerender Size",
+							    "Number of slides rendered ahead of the current one",
+							    1, G_MAXUINT, DEFAULT_PRERENDER_SIZE,
+							    G_PARAM_READWRITE |
+                                                            G_PARAM_STATIC_STRINGS));
 
 	signals[CHANGE_PAGE] =
 		g_signal_new ("change_page",
@@ -1645,6 +1829,8 @@ ev_view_presentation_init (EvViewPresentation *pview)
 {
 	gtk_widget_set_can_focus (GTK_WIDGET (pview), TRUE);
         pview->is_constructing = TRUE;
+	pview->prerender_size = DEFAULT_PRERENDER_SIZE;
+	pview->direction = 1;
 #if !GTK_CHECK_VERSION(3, 20, 0)
         ev_view_presentation_init_css();
 #endif
@@ -1699,3 +1885,48 @@ ev_view_presentation_get_rotation (EvViewPresentation *pview)
 {
         return pview->rotation;
 }
+
+/**
+ * ev_view_presentation_set_prerender_size:
+ * @pview: a #EvViewPresentation
+ * @prerender_size: the number of slides to render ahead
+ *
+ * Sets the number of slides rendered ahead of the current one, in the
+ * direction the presentation goes, so that changing slides quickly
+ * doesn't show blank slides. Every slide uses as much memory as a
+ * full screen surface.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_presentation_set_prerender_size (EvViewPresentation *pview,
+					 guint               prerender_size)
+{
+	g_return_if_fail (EV_IS_VIEW_PRESENTATION (pview));
+
+	prerender_size = MAX (prerender_size, 1);
+	if (pview->prerender_size == prerender_size)
+		return;
+
+	pview->prerender_size = prerender_size;
+	g_object_notify (G_OBJECT (pview), "prerender-size");
+
+	if (pview->jobs)
+		ev_view_presentation_update_jobs (pview);
+}
+
+/**
+ * ev_view_presentation_get_prerender_size:
+ * @pview: a #EvViewPresentation
+ *
+ * Returns: the number of slides rendered ahead of the current one
+ *
+ * Since: 3.30
+ */
+guint
+ev_view_presentation_get_prerender_size (EvViewPresentation *pview)
+{
+	g_return_val_if_fail (EV_IS_VIEW_PRESENTATION (pview), DEFAULT_PRERENDER_SIZE);
+
+	return pview->prerender_size;
+}
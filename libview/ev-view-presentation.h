@@ -53,6 +53,9 @@ void            ev_view_presentation_previous_page    (EvViewPresentation *pview
 void            ev_view_presentation_set_rotation     (EvViewPresentation *pview,
                                                        gint                rotation);
 guint           ev_view_presentation_get_rotation     (EvViewPresentation *pview);
+void            ev_view_presentation_set_prerender_size (EvViewPresentation *pview,
+                                                         guint               prerender_size);
+guint           ev_view_presentation_get_prerender_size (EvViewPresentation *pview);
 
 G_END_DECLS
 
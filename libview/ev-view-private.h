@@ -43,10 +43,13 @@ typedef struct {
 	GdkPoint start;
 	gdouble hadj;
 	gdouble vadj;
-	guint drag_timeout_id;
-	guint release_timeout_id;
+	gboolean kinetic;
 	GdkPoint buffer[DRAG_HISTORY];
-	GdkPoint momentum;
+	gint64 buffer_time[DRAG_HISTORY];
+	struct {
+		gdouble x;
+		gdouble y;
+	} momentum;
 } DragInfo;
 
 /* Autoscrolling */
@@ -54,7 +57,7 @@ typedef struct {
 	gboolean autoscrolling;
 	guint last_y;
 	guint start_y;
-	guint timeout_id;	
+	gboolean running;
 } AutoScrollInfo;
 
 /* Information for handling selection */
@@ -106,11 +109,21 @@ typedef enum {
 	SCROLL_TO_FIND_LOCATION,
 } PendingScroll;
 
+/* Heights of the pages, and of the rows of pages in dual mode, in
+ * document units, with Fenwick trees to get the height of the pages
+ * before a given one and to update the height of a single page.
+ */
 typedef struct _EvHeightToPageCache {
 	gint rotation;
 	gboolean dual_even_left;
-	gdouble *height_to_page;
-	gdouble *dual_height_to_page;
+	gint n_pages;
+	gint n_rows;
+	gdouble *heights;
+	gdouble *height_tree;
+	gdouble *dual_heights;
+	gdouble *dual_height_tree;
+	gdouble total_height;
+	gdouble dual_total_height;
 } EvHeightToPageCache;
 
 /* Information for handling annotations */
@@ -148,7 +161,14 @@ struct _EvView {
 
 	EvDocumentModel *model;
 	EvPixbufCache *pixbuf_cache;
+	EvViewThumbnailFunc thumbnail_func;
+	gpointer thumbnail_func_data;
+	GDestroyNotify thumbnail_func_destroy;
 	gsize pixbuf_cache_size;
+	gsize pixbuf_cache_limit;
+	gsize render_pack_size;
+	gboolean vector_selection;
+	gdouble device_scale;
 	EvPageCache *page_cache;
 	EvHeightToPageCache *height_to_page_cache;
 	EvViewCursor cursor;
@@ -211,13 +231,23 @@ struct _EvView {
 	/* Selection */
 	GdkPoint motion;
 	guint selection_update_id;
-	guint selection_scroll_id;
+	gboolean selection_scrolling;
+
+	/* Scrolling animations, run once per frame */
+	guint scroll_tick_id;
+	gint64 last_scroll_tick;
+	gboolean batch_scroll;
+	gboolean range_update_pending;
 
 	SelectionInfo selection_info;
 
 	/* Copy link address selection */
 	EvLinkAction *link_selected;
 
+	/* Selected text being copied, and the one in the clipboard */
+	EvJob *copy_job;
+	gchar *copy_text;
+
 	/* Image DND */
 	ImageDNDInfo image_dnd_info;
 
@@ -314,6 +344,13 @@ void _ev_view_transform_doc_rect_to_view_rect (EvView       *view,
 void _ev_view_get_selection_colors (EvView  *view,
 				    GdkRGBA *bg_color,
 				    GdkRGBA *fg_color);
+gboolean _ev_view_get_visible_page_area (EvView       *view,
+					 gint          page,
+					 gint          margin,
+					 GdkRectangle *area);
+cairo_surface_t *_ev_view_get_page_thumbnail (EvView *view,
+					      gint    page,
+					      gint    rotation);
 gint _ev_view_get_caret_cursor_offset_at_doc_point (EvView *view,
 						    gint    page,
 						    gdouble doc_x,
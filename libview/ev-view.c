@@ -37,6 +37,7 @@
 #include "ev-document-misc.h"
 #include "ev-pixbuf-cache.h"
 #include "ev-page-cache.h"
+#include "ev-job-scheduler.h"
 #include "ev-view-marshal.h"
 #include "ev-document-annotations.h"
 #include "ev-annotation-window.h"
@@ -60,6 +61,7 @@ enum {
 	SIGNAL_ANNOT_ADDED,
 	SIGNAL_ANNOT_REMOVED,
 	SIGNAL_LAYERS_CHANGED,
+	SIGNAL_PAGE_EDITED,
 	SIGNAL_MOVE_CURSOR,
 	SIGNAL_CURSOR_MOVED,
 	SIGNAL_ACTIVATE,
@@ -103,6 +105,7 @@ typedef struct {
 } EvViewChild;
 
 #define MIN_SCALE 0.2
+#define MAX_TILED_SCALE 64.0
 #define ZOOM_IN_FACTOR  1.2
 #define ZOOM_OUT_FACTOR (1.0/ZOOM_IN_FACTOR)
 
@@ -128,6 +131,8 @@ static void       compute_border                             (EvView
 static void       get_page_y_offset                          (EvView             *view,
 							      int                 page,
 							      int                *y_offset);
+static gint       get_page_at_y_offset                       (EvView             *view,
+							      gint                y);
 static void       find_page_at_location                      (EvView             *view,
 							      gdouble             x,
 							      gdouble             y,
@@ -216,6 +221,13 @@ static void       draw_one_page                              (EvView
 static void       ev_view_reload_page                        (EvView             *view,
 							      gint                page,
 							      cairo_region_t     *region);
+static void       ev_view_reload_page_annotations            (EvView             *view,
+							      gint                page,
+							      cairo_region_t     *region);
+static void       ev_view_reload_annot_area                  (EvView             *view,
+							      gint                page,
+							      const EvRectangle  *old_area,
+							      const EvRectangle  *new_area);
 /*** Callbacks ***/
 static void       ev_view_change_page                        (EvView             *view,
 							      gint                new_page);
@@ -280,6 +292,11 @@ static void       ev_view_handle_cursor_over_xy              (EvView *view,
 							      gint x,
 							      gint y);
 
+/*** Scrolling ***/
+static void       ev_view_ensure_scroll_tick                 (EvView             *view);
+static void       ev_view_begin_scroll_batch                 (EvView             *view);
+static void       ev_view_end_scroll_batch                   (EvView             *view);
+
 /*** Find ***/
 static gint         ev_view_find_get_n_results               (EvView             *view,
 							      gint                page);
@@ -309,6 +326,7 @@ static void       ev_view_primary_get_cb                     (GtkClipboard
 static void       ev_view_primary_clear_cb                   (GtkClipboard       *clipboard,
 							      gpointer            data);
 static void       ev_view_update_primary_selection           (EvView             *ev_view);
+static void       ev_view_copy_cancel                        (EvView             *view);
 
 /*** Caret navigation ***/
 static void       ev_view_check_cursor_blink                 (EvView             *ev_view);
@@ -320,109 +338,170 @@ G_DEFINE_TYPE_WITH_CODE (EvView, ev_view, GTK_TYPE_CONTAINER,
 #define EV_HEIGHT_TO_PAGE_CACHE_KEY "ev-height-to-page-cache"
 
 static void
-ev_view_build_height_to_page_cache (EvView		*view,
-                                    EvHeightToPageCache *cache)
+height_tree_build (gdouble       *tree,
+		   const gdouble *values,
+		   gint           n)
 {
-	gboolean swap, uniform;
-	int i;
-	double uniform_height, page_height, next_page_height;
-	double saved_height;
-	gdouble u_width, u_height;
-	gint n_pages;
-	EvDocument *document = view->document;
+	gint i;
+
+	tree[0] = 0;
+	memcpy (tree + 1, values, n * sizeof (gdouble));
+	for (i = 1; i <= n; i++) {
+		gint parent = i + (i & -i);
+
+		if (parent <= n)
+			tree[parent] += tree[i];
+	}
+}
+
+/* Sum of the first @n values */
+static gdouble
+height_tree_get_sum (const gdouble *tree,
+		     gint           n)
+{
+	gdouble sum = 0;
+
+	for (; n > 0; n -= n & -n)
+		sum += tree[n];
+
+	return sum;
+}
+
+static void
+height_tree_add (gdouble *tree,
+		 gint     n,
+		 gint     i,
+		 gdouble  delta)
+{
+	for (i++; i <= n; i += i & -i)
+		tree[i] += delta;
+}
+
+static gdouble
+get_page_height_for_cache (EvView *view,
+			   gint    page)
+{
+	gdouble w, h;
+
+	ev_document_get_page_size (view->document, page, &w, &h);
+
+	return (view->rotation == 90 || view->rotation == 270) ? w : h;
+}
+
+/* Rows of pages in dual mode, the first page is alone in the first row
+ * when even pages are on the left.
+ */
+static gint
+height_to_page_cache_get_row (EvHeightToPageCache *cache,
+			      gint                 page)
+{
+	return (page + cache->dual_even_left) / 2;
+}
 
-	swap = (view->rotation == 90 || view->rotation == 270);
+static gdouble
+height_to_page_cache_get_row_height (EvHeightToPageCache *cache,
+				     gint                 row)
+{
+	gint    page = 2 * row - cache->dual_even_left;
+	gdouble height = 0;
+
+	if (page >= 0)
+		height = cache->heights[page];
+	if (page + 1 < cache->n_pages)
+		height = MAX (height, cache->heights[page + 1]);
 
-	uniform = ev_document_is_page_size_uniform (document);
-	n_pages = ev_document_get_n_pages (document);
+	return height;
+}
 
-	g_free (cache->height_to_page);
-	g_free (cache->dual_height_to_page);
+static void
+ev_view_build_height_to_page_cache (EvView		*view,
+                                    EvHeightToPageCache *cache)
+{
+	gint i;
 
 	cache->rotation = view->rotation;
 	cache->dual_even_left = view->dual_even_left;
-	cache->height_to_page = g_new0 (gdouble, n_pages + 1);
-	cache->dual_height_to_page = g_new0 (gdouble, n_pages + 2);
-
-	if (uniform)
-		ev_document_get_page_size (document, 0, &u_width, &u_height);
 
-	saved_height = 0;
-	for (i = 0; i <= n_pages; i++) {
-		if (uniform) {
-			uniform_height = swap ? u_width : u_height;
-			cache->height_to_page[i] = i * uniform_height;
-		} else {
-			if (i < n_pages) {
-				gdouble w, h;
+	if (cache->n_pages != ev_document_get_n_pages (view->document)) {
+		g_free (cache->heights);
+		g_free (cache->height_tree);
+		g_free (cache->dual_heights);
+		g_free (cache->dual_height_tree);
 
-				ev_document_get_page_size (document, i, &w, &h);
-				page_height = swap ? w : h;
-			} else {
-				page_height = 0;
-			}
-			cache->height_to_page[i] = saved_height;
-			saved_height += page_height;
-		}
+		cache->n_pages = ev_document_get_n_pages (view->document);
+		cache->heights = g_new0 (gdouble, cache->n_pages);
+		cache->height_tree = g_new0 (gdouble, cache->n_pages + 1);
+		/* One more row when the first page is alone */
+		cache->dual_heights = g_new0 (gdouble, cache->n_pages / 2 + 1);
+		cache->dual_height_tree = g_new0 (gdouble, cache->n_pages / 2 + 2);
 	}
 
-	if (cache->dual_even_left && !uniform) {
-		gdouble w, h;
+	if (ev_document_is_page_size_uniform (view->document)) {
+		gdouble height = cache->n_pages > 0 ? get_page_height_for_cache (view, 0) : 0;
 
-		ev_document_get_page_size (document, 0, &w, &h);
-		saved_height = swap ? w : h;
+		for (i = 0; i < cache->n_pages; i++)
+			cache->heights[i] = height;
 	} else {
-		saved_height = 0;
+		for (i = 0; i < cache->n_pages; i++)
+			cache->heights[i] = get_page_height_for_cache (view, i);
 	}
+	height_tree_build (cache->height_tree, cache->heights, cache->n_pages);
 
-	for (i = cache->dual_even_left; i < n_pages + 2; i += 2) {
-    		if (uniform) {
-			uniform_height = swap ? u_width : u_height;
-			cache->dual_height_to_page[i] = ((i + cache->dual_even_left) / 2) * uniform_height;
-			if (i + 1 < n_pages + 2)
-				cache->dual_height_to_page[i + 1] = ((i + cache->dual_even_left) / 2) * uniform_height;
-		} else {
-			if (i + 1 < n_pages) {
-				gdouble w, h;
+	cache->n_rows = cache->n_pages > 0 ?
+		height_to_page_cache_get_row (cache, cache->n_pages - 1) + 1 : 0;
+	for (i = 0; i < cache->n_rows; i++)
+		cache->dual_heights[i] = height_to_page_cache_get_row_height (cache, i);
+	height_tree_build (cache->dual_height_tree, cache->dual_heights, cache->n_rows);
 
-				ev_document_get_page_size (document, i + 1, &w, &h);
-				next_page_height = swap ? w : h;
-			} else {
-				next_page_height = 0;
-			}
+	cache->total_height = height_tree_get_sum (cache->height_tree, cache->n_pages);
+	cache->dual_total_height = height_tree_get_sum (cache->dual_height_tree, cache->n_rows);
+}
 
-			if (i < n_pages) {
-				gdouble w, h;
+/* Updates the heights of the pages whose size changed, without
+ * rebuilding the trees.
+ */
+static void
+ev_view_update_height_to_page_cache (EvView              *view,
+				     EvHeightToPageCache *cache)
+{
+	gint i;
 
-				ev_document_get_page_size (document, i, &w, &h);
-				page_height = swap ? w : h;
-			} else {
-				page_height = 0;
-			}
+	if (cache->rotation != view->rotation ||
+	    cache->dual_even_left != view->dual_even_left ||
+	    cache->n_pages != ev_document_get_n_pages (view->document)) {
+		ev_view_build_height_to_page_cache (view, cache);
+		return;
+	}
 
-			if (i + 1 < n_pages + 2) {
-				cache->dual_height_to_page[i] = saved_height;
-				cache->dual_height_to_page[i + 1] = saved_height;
-				saved_height += MAX(page_height, next_page_height);
-			} else {
-				cache->dual_height_to_page[i] = saved_height;
-			}
-		}
+	for (i = 0; i < cache->n_pages; i++) {
+		gdouble height = get_page_height_for_cache (view, i);
+		gdouble row_height;
+		gint    row;
+
+		if (height == cache->heights[i])
+			continue;
+
+		height_tree_add (cache->height_tree, cache->n_pages, i,
+				 height - cache->heights[i]);
+		cache->total_height += height - cache->heights[i];
+		cache->heights[i] = height;
+
+		row = height_to_page_cache_get_row (cache, i);
+		row_height = height_to_page_cache_get_row_height (cache, row);
+		height_tree_add (cache->dual_height_tree, cache->n_rows, row,
+				 row_height - cache->dual_heights[row]);
+		cache->dual_total_height += row_height - cache->dual_heights[row];
+		cache->dual_heights[row] = row_height;
 	}
 }
 
 static void
 ev_height_to_page_cache_free (EvHeightToPageCache *cache)
 {
-	if (cache->height_to_page) {
-		g_free (cache->height_to_page);
-		cache->height_to_page = NULL;
-	}
-
-	if (cache->dual_height_to_page) {
-		g_free (cache->dual_height_to_page);
-		cache->dual_height_to_page = NULL;
-	}
+	g_free (cache->heights);
+	g_free (cache->height_tree);
+	g_free (cache->dual_heights);
+	g_free (cache->dual_height_tree);
 	g_free (cache);
 }
 
@@ -465,13 +544,24 @@ ev_view_get_height_to_page (EvView *view,
 		ev_view_build_height_to_page_cache (view, cache);
 	}
 
+	/* The size request asks for the height of all pages on every
+	 * allocation and zoom change, so keep it constant time.
+	 */
 	if (height) {
-		h = cache->height_to_page[page];
+		if (page >= cache->n_pages)
+			h = cache->total_height;
+		else
+			h = height_tree_get_sum (cache->height_tree, page);
 		*height = (gint)(h * view->scale + 0.5);
     }
 
 	if (dual_height) {
-		dh = cache->dual_height_to_page[page];
+		gint row = height_to_page_cache_get_row (cache, page);
+
+		if (row >= cache->n_rows)
+			dh = cache->dual_total_height;
+		else
+			dh = height_tree_get_sum (cache->dual_height_tree, row);
 		*dual_height = (gint)(dh * view->scale + 0.5);
 	}
 }
@@ -736,10 +826,15 @@ view_update_range_and_current_page (EvView *view)
 		current_area.y = gtk_adjustment_get_value (view->vadjustment);
 		current_area.height = gtk_adjustment_get_page_size (view->vadjustment);
 
-		for (i = 0; i < ev_document_get_n_pages (view->document); i++) {
+		for (i = get_page_at_y_offset (view, current_area.y);
+		     i < ev_document_get_n_pages (view->document); i++) {
 
 			ev_view_get_page_extents (view, i, &page_area, &border);
 
+			/* Pages are sorted by their offset */
+			if (page_area.y >= current_area.y + current_area.height)
+				break;
+
 			if (gdk_rectangle_intersect (&current_area, &page_area, &unused)) {
 				area = unused.width * unused.height;
 
@@ -942,11 +1037,11 @@ compute_scroll_increment (EvView        *view,
 		doc_rect.x1 = doc_rect.x2 = rect.x + 0.5;
 		doc_rect.y1 = doc_rect.y2 = rect.y + 0.5;
 
-		ev_document_doc_mutex_lock ();
+		ev_document_lock (view->document);
 		sel_region = ev_selection_get_selection_region (EV_SELECTION (view->document),
 								rc, EV_SELECTION_STYLE_LINE,
 								&doc_rect);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (view->document);
 
 		g_object_unref (rc);
 
@@ -1250,6 +1345,34 @@ get_page_y_offset (EvView *view, int page, int *y_offset)
 	return;
 }
 
+/* Returns the first page that can be visible at @y, pages before it
+ * end above @y. Only valid in continuous mode.
+ */
+static gint
+get_page_at_y_offset (EvView *view,
+		      gint    y)
+{
+	gint low = 0;
+	gint high = ev_document_get_n_pages (view->document) - 1;
+
+	while (low < high) {
+		gint mid = low + (high - low + 1) / 2;
+		gint offset;
+
+		get_page_y_offset (view, mid, &offset);
+		if (offset <= y)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	/* Pages of the same row have the same offset */
+	if (is_dual_page (view, NULL))
+		low = MAX (0, low - 1);
+
+	return low;
+}
+
 gboolean
 ev_view_get_page_extents (EvView       *view,
 			  gint          page,
@@ -1348,6 +1471,140 @@ ev_view_get_page_extents (EvView       *view,
 	return TRUE;
 }
 
+/**
+ * ev_view_get_page_surface:
+ * @view: an #EvView
+ * @page: the page index
+ *
+ * Gets the rendered contents of @page if the whole page is in the
+ * cache of @view, so that it can be reused instead of rendering the
+ * page again. The surface has the current rotation of @view, its
+ * colors are the ones of the document even when the model has
+ * inverted colors, they are only inverted when drawn. Grayscale and
+ * monochrome pages kept in a smaller format, and pages whose
+ * annotations are kept apart, aren't returned.
+ *
+ * Returns: (transfer none) (allow-none): the surface of @page, or %NULL
+ *
+ * Since: 3.30
+ */
+cairo_surface_t *
+ev_view_get_page_surface (EvView *view,
+			  gint    page)
+{
+	cairo_surface_t *surface;
+
+	g_return_val_if_fail (EV_IS_VIEW (view), NULL);
+
+	if (!view->pixbuf_cache)
+		return NULL;
+
+	/* Pages kept as masks, or without their annotations, aren't
+	 * images of the page */
+	surface = ev_pixbuf_cache_peek_surface (view->pixbuf_cache, page);
+	if (surface && cairo_surface_get_content (surface) == CAIRO_CONTENT_ALPHA)
+		return NULL;
+	if (surface && ev_pixbuf_cache_get_annotations_surface (view->pixbuf_cache, page))
+		return NULL;
+
+	return surface;
+}
+
+/**
+ * ev_view_set_page_preview:
+ * @view: an #EvView
+ * @page: the page index
+ * @rotation: the rotation @surface was rendered with
+ * @surface: a rendering of @page
+ *
+ * Gives @view a rendering of @page, at any scale, to show while
+ * the page is rendered for the view if it doesn't have anything better
+ * yet, like the first page rendered while the document is set up.
+ * @surface is ignored if @rotation is not the one of the view by then.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_page_preview (EvView          *view,
+			  gint             page,
+			  gint             rotation,
+			  cairo_surface_t *surface)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+	g_return_if_fail (surface != NULL);
+
+	if (!view->pixbuf_cache)
+		return;
+
+	ev_pixbuf_cache_set_page_preview (view->pixbuf_cache, page,
+					  rotation, surface);
+}
+
+/**
+ * EvViewThumbnailFunc:
+ * @view: an #EvView
+ * @page: the page index
+ * @rotation: the rotation of the view
+ * @user_data: the data passed to ev_view_set_thumbnail_func()
+ *
+ * Looks up an existing thumbnail of @page with @rotation, without
+ * rendering anything.
+ *
+ * Returns: (transfer full) (allow-none): an image surface of @page, or
+ *   %NULL if there's no thumbnail of it
+ *
+ * Since: 3.30
+ */
+
+/**
+ * ev_view_set_thumbnail_func:
+ * @view: an #EvView
+ * @func: (allow-none): a #EvViewThumbnailFunc, or %NULL
+ * @user_data: data to pass to @func
+ * @destroy: (allow-none): destroy notifier for @user_data
+ *
+ * Sets the function @view uses to get the thumbnails of the pages. At
+ * zoom levels where the pages are about the size of their thumbnails,
+ * they are scaled from the thumbnails instead of rendered, so that the
+ * overview of long documents shows up at once.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_thumbnail_func (EvView              *view,
+			    EvViewThumbnailFunc  func,
+			    gpointer             user_data,
+			    GDestroyNotify       destroy)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	if (view->thumbnail_func_destroy)
+		view->thumbnail_func_destroy (view->thumbnail_func_data);
+
+	view->thumbnail_func = func;
+	view->thumbnail_func_data = user_data;
+	view->thumbnail_func_destroy = destroy;
+}
+
+cairo_surface_t *
+_ev_view_get_page_thumbnail (EvView *view,
+			     gint    page,
+			     gint    rotation)
+{
+	cairo_surface_t *surface;
+
+	if (!view->thumbnail_func)
+		return NULL;
+
+	surface = view->thumbnail_func (view, page, rotation, view->thumbnail_func_data);
+	if (surface && cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+
+	return surface;
+}
+
 static void
 get_doc_page_size (EvView  *view,
 		   gint     page,
@@ -1989,7 +2246,7 @@ ev_view_handle_link (EvView *view, EvLink *link)
 			break;
 	        case EV_LINK_ACTION_TYPE_LAYERS_STATE: {
 			GList            *show, *hide, *toggle;
-			GList            *l;
+			GList            *l, *layers;
 			EvDocumentLayers *document_layers;
 
 			document_layers = EV_DOCUMENT_LAYERS (view->document);
@@ -2016,7 +2273,11 @@ ev_view_handle_link (EvView *view, EvLink *link)
 			}
 
 			g_signal_emit (view, signals[SIGNAL_LAYERS_CHANGED], 0);
-			ev_view_reload (view);
+
+			layers = g_list_concat (g_list_copy (show), g_list_copy (hide));
+			layers = g_list_concat (layers, g_list_copy (toggle));
+			ev_view_reload_layers (view, layers);
+			g_list_free (layers);
 		}
 			break;
 	        case EV_LINK_ACTION_TYPE_GOTO_REMOTE:
@@ -2104,6 +2365,43 @@ tip_from_link (EvView *view, EvLink *link)
 	return msg;
 }
 
+/* The destination of a hovered link is likely to be shown next */
+static void
+prefetch_link_dest (EvView *view,
+		    EvLink *link)
+{
+	EvLinkAction *action;
+	EvLinkDest   *dest;
+	gint          page = -1;
+
+	action = ev_link_get_action (link);
+	if (!action || ev_link_action_get_action_type (action) != EV_LINK_ACTION_TYPE_GOTO_DEST)
+		return;
+
+	dest = ev_link_action_get_dest (action);
+	if (!dest)
+		return;
+
+	switch (ev_link_dest_get_dest_type (dest)) {
+	case EV_LINK_DEST_TYPE_NAMED:
+		if (EV_IS_DOCUMENT_LINKS (view->document))
+			page = ev_document_links_find_link_page (EV_DOCUMENT_LINKS (view->document),
+								 ev_link_dest_get_named_dest (dest));
+		break;
+	case EV_LINK_DEST_TYPE_PAGE_LABEL:
+		ev_document_find_page_by_label (view->document,
+						ev_link_dest_get_page_label (dest),
+						&page);
+		break;
+	default:
+		page = ev_link_dest_get_page (dest);
+		break;
+	}
+
+	if (page >= 0)
+		ev_pixbuf_cache_prefetch_page (view->pixbuf_cache, page);
+}
+
 static void
 ev_view_handle_cursor_over_xy (EvView *view, gint x, gint y)
 {
@@ -2139,6 +2437,7 @@ ev_view_handle_cursor_over_xy (EvView *view, gint x, gint y)
 	link = ev_view_get_link_at_location (view, x, y);
         if (link) {
 		ev_view_set_cursor (view, EV_VIEW_CURSOR_LINK);
+		prefetch_link_dest (view, link);
 	} else if ((field = ev_view_get_form_field_at_location (view, x, y))) {
 		if (field->is_read_only) {
 			if (view->cursor == EV_VIEW_CURSOR_LINK ||
@@ -2377,7 +2676,7 @@ ev_view_form_field_button_toggle (EvView      *view,
 							 ev_mapping_list_find (forms_mapping, field),
 							 field->page->index);
 
-	ev_view_reload_page (view, field->page->index, region);
+	ev_view_reload_page_annotations (view, field->page->index, region);
 	cairo_region_destroy (region);
 }
 
@@ -2420,7 +2719,7 @@ ev_view_form_field_text_save (EvView    *view,
 		ev_document_forms_form_field_text_set_text (EV_DOCUMENT_FORMS (view->document),
 							    field, field_text->text);
 		field->changed = FALSE;
-		ev_view_reload_page (view, field->page->index, field_region);
+		ev_view_reload_page_annotations (view, field->page->index, field_region);
 		cairo_region_destroy (field_region);
 	}
 }
@@ -2553,7 +2852,7 @@ ev_view_form_field_choice_save (EvView    *view,
 			}
 		}
 		field->changed = FALSE;
-		ev_view_reload_page (view, field->page->index, field_region);
+		ev_view_reload_page_annotations (view, field->page->index, field_region);
 		cairo_region_destroy (field_region);
 	}
 }
@@ -3115,10 +3414,10 @@ ev_view_annotation_save_contents (EvView       *view,
 	if (!view->document)
 		return;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (view->document);
 	ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 						 annot, EV_ANNOTATIONS_SAVE_CONTENTS);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (view->document);
 }
 
 static GtkWidget *
@@ -3159,6 +3458,11 @@ ev_view_create_annotation_window (EvView       *view,
 	return window;
 }
 
+/* Windows are only created for the popups that are open, the others
+ * get theirs the first time they are opened, see
+ * ev_view_handle_annotation(). Documents with many annotations would
+ * otherwise create a toplevel for each of them while scrolling.
+ */
 static void
 show_annotation_windows (EvView *view,
 			 gint    page)
@@ -3186,7 +3490,7 @@ show_annotation_windows (EvView *view,
 		window = get_window_for_annot (view, annot);
 		if (window) {
 			ev_view_window_child_move_with_parent (view, window);
-		} else {
+		} else if (ev_annotation_markup_get_popup_is_open (EV_ANNOTATION_MARKUP (annot))) {
 			ev_view_create_annotation_window (view, annot, parent);
 		}
 	}
@@ -3280,7 +3584,12 @@ ev_view_handle_annotation (EvView       *view,
 		GtkWidget *window;
 
 		window = get_window_for_annot (view, annot);
-		if (!window && ev_annotation_markup_can_have_popup (EV_ANNOTATION_MARKUP (annot))) {
+		if (!window && ev_annotation_markup_has_popup (EV_ANNOTATION_MARKUP (annot))) {
+			GtkWindow *parent;
+
+			parent = GTK_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (view)));
+			window = ev_view_create_annotation_window (view, annot, parent);
+		} else if (!window && ev_annotation_markup_can_have_popup (EV_ANNOTATION_MARKUP (annot))) {
 			EvRectangle    popup_rect;
 			GtkWindow     *parent;
 			EvMappingList *annots;
@@ -3336,10 +3645,8 @@ ev_view_create_annotation_real (EvView *view,
 	EvRectangle     doc_rect, popup_rect;
 	EvPage         *page;
 	GdkColor        color = { 0, 65535, 65535, 0 };
-	GdkRectangle    view_rect;
-	cairo_region_t *region;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (view->document);
 	page = ev_document_get_page (view->document, annot_page);
         switch (view->adding_annot_info.type) {
         case EV_ANNOTATION_TYPE_TEXT:
@@ -3359,7 +3666,7 @@ ev_view_create_annotation_real (EvView *view,
 	case EV_ANNOTATION_TYPE_ATTACHMENT:
 		/* TODO */
 		g_object_unref (page);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (view->document);
 		return;
 	default:
 		g_assert_not_reached ();
@@ -3386,18 +3693,10 @@ ev_view_create_annotation_real (EvView *view,
 						annot, &doc_rect);
 	/* Re-fetch area as eg. adding Text Markup annots updates area for its bounding box */
 	ev_annotation_get_area (annot, &doc_rect);
-	ev_document_doc_mutex_unlock ();
-
-	/* If the page didn't have annots, mark the cache as dirty */
-	if (!ev_page_cache_get_annot_mapping (view->page_cache, annot_page))
-		ev_page_cache_mark_dirty (view->page_cache, annot_page, EV_PAGE_DATA_INCLUDE_ANNOTS);
+	ev_document_unlock (view->document);
 
-	_ev_view_transform_doc_rect_to_view_rect (view, annot_page, &doc_rect, &view_rect);
-	view_rect.x -= view->scroll_x;
-	view_rect.y -= view->scroll_y;
-	region = cairo_region_create_rectangle (&view_rect);
-	ev_view_reload_page (view, annot_page, region);
-	cairo_region_destroy (region);
+	ev_page_cache_add_annot (view->page_cache, annot);
+	ev_view_reload_annot_area (view, annot_page, NULL, &doc_rect);
 
 	view->adding_annot_info.annot = annot;
 }
@@ -3486,7 +3785,8 @@ void
 ev_view_remove_annotation (EvView       *view,
                            EvAnnotation *annot)
 {
-        guint page;
+        guint       page;
+        EvRectangle area;
 
         g_return_if_fail (EV_IS_VIEW (view));
         g_return_if_fail (EV_IS_ANNOTATION (annot));
@@ -3494,6 +3794,7 @@ ev_view_remove_annotation (EvView       *view,
 	g_object_ref (annot);
 
         page = ev_annotation_get_page_index (annot);
+        ev_annotation_get_area (annot, &area);
 
         if (EV_IS_ANNOTATION_MARKUP (annot))
 		ev_view_remove_window_child_for_annot (view, page, annot);
@@ -3502,15 +3803,13 @@ ev_view_remove_annotation (EvView       *view,
 
         _ev_view_set_focused_element (view, NULL, -1);
 
-        ev_document_doc_mutex_lock ();
+        ev_document_lock (view->document);
         ev_document_annotations_remove_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
                                                    annot);
-        ev_document_doc_mutex_unlock ();
-
-        ev_page_cache_mark_dirty (view->page_cache, page, EV_PAGE_DATA_INCLUDE_ANNOTS);
+        ev_document_unlock (view->document);
 
-	/* FIXME: only redraw the annot area */
-        ev_view_reload_page (view, page, NULL);
+        ev_page_cache_remove_annot (view->page_cache, annot);
+        ev_view_reload_annot_area (view, page, &area, NULL);
 
 	g_signal_emit (view, signals[SIGNAL_ANNOT_REMOVED], 0, annot);
 	g_object_unref (annot);
@@ -3825,6 +4124,8 @@ ev_view_set_caret_navigation_enabled (EvView   *view,
 
 	if (view->caret_enabled != enabled) {
 		view->caret_enabled = enabled;
+		if (view->page_cache)
+			ev_page_cache_set_prefetch_text (view->page_cache, enabled);
 		if (view->caret_enabled)
 			preload_pages_for_caret_navigation (view);
 
@@ -4604,6 +4905,7 @@ ev_view_draw (GtkWidget *widget,
 	EvView      *view = EV_VIEW (widget);
 	gint         i;
 	GdkRectangle clip_rect;
+	gint64       trace;
 
 	gtk_render_background (gtk_widget_get_style_context (widget),
 			       cr,
@@ -4617,10 +4919,13 @@ ev_view_draw (GtkWidget *widget,
         if (!gdk_cairo_get_clip_rectangle (cr, &clip_rect))
                 return FALSE;
 
+	trace = ev_trace_begin ();
+
 	for (i = view->start_page; i >= 0 && i <= view->end_page; i++) {
 		GdkRectangle page_area;
 		GtkBorder border;
 		gboolean page_ready = TRUE;
+		gint64 page_trace;
 
 		if (!ev_view_get_page_extents (view, i, &page_area, &border))
 			continue;
@@ -4628,11 +4933,13 @@ ev_view_draw (GtkWidget *widget,
 		page_area.x -= view->scroll_x;
 		page_area.y -= view->scroll_y;
 
+		page_trace = ev_trace_begin ();
 		draw_one_page (view, i, cr, &page_area, &border, &clip_rect, &page_ready);
+		ev_trace_end (page_trace, "draw", "draw-page", i);
 
 		if (page_ready && should_draw_caret_cursor (view, i))
 			draw_caret_cursor (view, cr);
-		if (page_ready && view->find_pages && view->highlight_find_results)
+		if (page_ready && (view->find_job || view->find_pages) && view->highlight_find_results)
 			highlight_find_results (view, cr, i);
 		if (page_ready && EV_IS_DOCUMENT_ANNOTATIONS (view->document))
 			show_annotation_windows (view, i);
@@ -4649,6 +4956,8 @@ ev_view_draw (GtkWidget *widget,
         if (GTK_WIDGET_CLASS (ev_view_parent_class)->draw)
                 GTK_WIDGET_CLASS (ev_view_parent_class)->draw (widget, cr);
 
+	ev_trace_end (trace, "draw", "ev_view_draw", -1);
+
 	return FALSE;
 }
 
@@ -4858,12 +5167,13 @@ _ev_view_get_caret_cursor_offset_at_doc_point (EvView *view,
 	if (!areas)
 		return -1;
 
-	i = 0;
+	/* Areas that can't contain doc_y are skipped with the line index */
+	i = ev_page_cache_find_text_line_at (view->page_cache, page, doc_y, 0);
 	while (i < n_areas && offset == -1) {
 		rect = areas + i;
 
 		first_line_offset = -1;
-		while (doc_y >= rect->y1 && doc_y <= rect->y2) {
+		while (i < n_areas && doc_y >= rect->y1 && doc_y <= rect->y2) {
 			if (first_line_offset == -1) {
 				if (doc_x <= rect->x1) {
 					/* Location is before the start of the line */
@@ -4908,7 +5218,7 @@ _ev_view_get_caret_cursor_offset_at_doc_point (EvView *view,
 		}
 
 		if (first_line_offset == -1)
-			i++;
+			i = ev_page_cache_find_text_line_at (view->page_cache, page, doc_y, i + 1);
 	}
 
 	if (last_line_offset == -1)
@@ -5023,6 +5333,8 @@ ev_view_button_press_event (GtkWidget      *widget,
 	
 	view->pressed_button = event->button;
 	view->selection_info.in_drag = FALSE;
+	/* Grabbing the document stops the kinetic scrolling */
+	view->drag_info.kinetic = FALSE;
 
 	if (view->scroll_info.autoscrolling)
 		return TRUE;
@@ -5210,10 +5522,10 @@ ev_view_drag_data_get (GtkWidget        *widget,
 			if (view->image_dnd_info.image) {
 				GdkPixbuf *pixbuf;
 
-				ev_document_doc_mutex_lock ();
+				ev_document_lock (view->document);
 				pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (view->document),
 								       view->image_dnd_info.image);
-				ev_document_doc_mutex_unlock ();
+				ev_document_unlock (view->document);
 				
 				gtk_selection_data_set_pixbuf (selection_data, pixbuf);
 				g_object_unref (pixbuf);
@@ -5225,10 +5537,10 @@ ev_view_drag_data_get (GtkWidget        *widget,
 				const gchar *tmp_uri;
 				gchar       *uris[2];
 
-				ev_document_doc_mutex_lock ();
+				ev_document_lock (view->document);
 				pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (view->document),
 								       view->image_dnd_info.image);
-				ev_document_doc_mutex_unlock ();
+				ev_document_unlock (view->document);
 				
 				tmp_uri = ev_image_save_tmp (view->image_dnd_info.image, pixbuf);
 				g_object_unref (pixbuf);
@@ -5266,10 +5578,16 @@ selection_update_idle_cb (EvView *view)
 	return FALSE;
 }
 
-static gboolean
-selection_scroll_timeout_cb (EvView *view)
-{	
-	gint x, y, shift = 0;
+/* Scrolls by half the distance of the pointer out of the view
+ * every SCROLL_TIME ms, @interval is the time elapsed in µs.
+ */
+static void
+selection_scroll_step (EvView *view,
+		       gint64  interval)
+{
+	gint x, y;
+	gdouble shift = 0;
+	gdouble factor = (gdouble) interval / (SCROLL_TIME * 1000);
 	GtkWidget *widget = GTK_WIDGET (view);
 	GtkAllocation allocation;
 
@@ -5277,9 +5595,9 @@ selection_scroll_timeout_cb (EvView *view)
 	ev_document_misc_get_pointer_position (widget, &x, &y);
 
 	if (y > allocation.height) {
-		shift = (y - allocation.height) / 2;
+		shift = (y - allocation.height) / 2. * factor;
 	} else if (y < 0) {
-		shift = y / 2;
+		shift = y / 2. * factor;
 	}
 
 	if (shift)
@@ -5289,10 +5607,11 @@ selection_scroll_timeout_cb (EvView *view)
 						 gtk_adjustment_get_upper (view->vadjustment) -
 						 gtk_adjustment_get_page_size (view->vadjustment)));
 
+	shift = 0;
 	if (x > allocation.width) {
-		shift = (x - allocation.width) / 2;
+		shift = (x - allocation.width) / 2. * factor;
 	} else if (x < 0) {
-		shift = x / 2;
+		shift = x / 2. * factor;
 	}
 
 	if (shift)
@@ -5301,43 +5620,51 @@ selection_scroll_timeout_cb (EvView *view)
 						 gtk_adjustment_get_lower (view->hadjustment),
 						 gtk_adjustment_get_upper (view->hadjustment) -
 						 gtk_adjustment_get_page_size (view->hadjustment)));
-
-	return TRUE;
 }
 
-static gboolean
-ev_view_drag_update_momentum (EvView *view)
+static void
+ev_view_drag_update_momentum (EvView *view,
+			      gint64  frame_time)
 {
+	gint64 span;
 	int i;
-	if (!view->drag_info.in_drag)
-		return FALSE;
-	
+
 	for (i = DRAG_HISTORY - 1; i > 0; i--) {
 		view->drag_info.buffer[i].x = view->drag_info.buffer[i-1].x;
 		view->drag_info.buffer[i].y = view->drag_info.buffer[i-1].y;
+		view->drag_info.buffer_time[i] = view->drag_info.buffer_time[i-1];
 	}
+	view->drag_info.buffer_time[0] = frame_time;
 
-	/* Momentum is a moving average of 10ms granularity over
-	 * the last 100ms with each 10ms stored in buffer. 
+	/* Momentum is the distance moved in the last 100ms, the buffer
+	 * keeps a position per frame, so it can span more than that.
 	 */
-	
-	view->drag_info.momentum.x = (view->drag_info.buffer[DRAG_HISTORY - 1].x - view->drag_info.buffer[0].x);
-	view->drag_info.momentum.y = (view->drag_info.buffer[DRAG_HISTORY - 1].y - view->drag_info.buffer[0].y);
-
-	return TRUE;
+	span = MAX (view->drag_info.buffer_time[0] - view->drag_info.buffer_time[DRAG_HISTORY - 1],
+		    100000);
+	view->drag_info.momentum.x = (gdouble)(view->drag_info.buffer[DRAG_HISTORY - 1].x - view->drag_info.buffer[0].x) *
+		100000 / span;
+	view->drag_info.momentum.y = (gdouble)(view->drag_info.buffer[DRAG_HISTORY - 1].y - view->drag_info.buffer[0].y) *
+		100000 / span;
 }
 
+/* The momentum goes down by 1.2 and is applied every 20ms,
+ * @interval is the time elapsed in µs.
+ */
 static gboolean
-ev_view_scroll_drag_release (EvView *view)
+ev_view_scroll_drag_release (EvView *view,
+			     gint64  interval)
 {
 	gdouble dhadj_value, dvadj_value;
 	gdouble oldhadjustment, oldvadjustment;
 	gdouble h_page_size, v_page_size;
 	gdouble h_upper, v_upper;
+	gdouble steps = (gdouble) interval / 20000;
+	gdouble friction;
 	GtkAllocation allocation;
 
-	view->drag_info.momentum.x /= 1.2;
-	view->drag_info.momentum.y /= 1.2; /* Alter these constants to change "friction" */
+	friction = pow (1.2, steps); /* Alter these constants to change "friction" */
+	view->drag_info.momentum.x /= friction;
+	view->drag_info.momentum.y /= friction;
 
 	gtk_widget_get_allocation (GTK_WIDGET (view), &allocation);
 
@@ -5345,9 +5672,9 @@ ev_view_scroll_drag_release (EvView *view)
 	v_page_size = gtk_adjustment_get_page_size (view->vadjustment);
 
 	dhadj_value = h_page_size *
-		      (gdouble)view->drag_info.momentum.x / allocation.width;
+		      view->drag_info.momentum.x * steps / allocation.width;
 	dvadj_value = v_page_size *
-		      (gdouble)view->drag_info.momentum.y / allocation.height;
+		      view->drag_info.momentum.y * steps / allocation.height;
 
 	oldhadjustment = gtk_adjustment_get_value (view->hadjustment);
 	oldvadjustment = gtk_adjustment_get_value (view->vadjustment);
@@ -5498,17 +5825,17 @@ ev_view_motion_notify_event (GtkWidget      *widget,
 
 			/* Take the mutex before set_area, because the notify signal
 			 * updates the mappings in the backend */
-			ev_document_doc_mutex_lock ();
+			ev_document_lock (view->document);
 			if (ev_annotation_set_area (view->adding_annot_info.annot, &rect)) {
 				ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 									 view->adding_annot_info.annot,
 									 EV_ANNOTATIONS_SAVE_AREA);
 			}
-			ev_document_doc_mutex_unlock ();
-
+			ev_document_unlock (view->document);
 
-			/* FIXME: reload only annotation area */
-			ev_view_reload_page (view, annot_page, NULL);
+			ev_annotation_get_area (view->adding_annot_info.annot, &rect);
+			ev_page_cache_update_annot (view->page_cache, view->adding_annot_info.annot);
+			ev_view_reload_annot_area (view, annot_page, &current_area, &rect);
 		} else if (view->moving_annot_info.annot_clicked) {
 			EvRectangle  rect;
 			EvRectangle  current_area;
@@ -5562,25 +5889,26 @@ ev_view_motion_notify_event (GtkWidget      *widget,
 
 			/* Take the mutex before set_area, because the notify signal
 			 * updates the mappings in the backend */
-			ev_document_doc_mutex_lock ();
+			ev_document_lock (view->document);
 			if (ev_annotation_set_area (view->moving_annot_info.annot, &rect)) {
 				ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 									 view->moving_annot_info.annot,
 									 EV_ANNOTATIONS_SAVE_AREA);
 			}
-			ev_document_doc_mutex_unlock ();
+			ev_document_unlock (view->document);
 
-			/* FIXME: reload only annotation area */
-			ev_view_reload_page (view, annot_page, NULL);
+			ev_annotation_get_area (view->moving_annot_info.annot, &rect);
+			ev_page_cache_update_annot (view->page_cache, view->moving_annot_info.annot);
+			ev_view_reload_annot_area (view, annot_page, &current_area, &rect);
 		} else {
-			/* Schedule timeout to scroll during selection and additionally
+			/* Scroll every frame during selection and additionally
 			 * scroll once to allow arbitrary speed. */
-			if (!view->selection_scroll_id)
-				view->selection_scroll_id = g_timeout_add (SCROLL_TIME,
-									   (GSourceFunc)selection_scroll_timeout_cb,
-									   view);
-			else
-				selection_scroll_timeout_cb (view);
+			if (!view->selection_scrolling) {
+				view->selection_scrolling = TRUE;
+				ev_view_ensure_scroll_tick (view);
+			} else {
+				selection_scroll_step (view, SCROLL_TIME * 1000);
+			}
 
 			view->motion.x = x + view->scroll_x;
 			view->motion.y = y + view->scroll_y;
@@ -5606,13 +5934,13 @@ ev_view_motion_notify_event (GtkWidget      *widget,
 							  event->x_root,
 							  event->y_root);
 			view->drag_info.in_drag = start;
-			view->drag_info.drag_timeout_id = g_timeout_add (10,
-				(GSourceFunc)ev_view_drag_update_momentum, view);
-			/* Set 100 to choose how long it takes to build up momentum */
+			if (start)
+				ev_view_ensure_scroll_tick (view);
 			/* Clear out previous momentum info: */
 			for (i = 0; i < DRAG_HISTORY; i++) {
 				view->drag_info.buffer[i].x = event->x;
 				view->drag_info.buffer[i].y = event->y;
+				view->drag_info.buffer_time[i] = g_get_monotonic_time ();
 			}
 			view->drag_info.momentum.x = 0;
 			view->drag_info.momentum.y = 0;
@@ -5637,6 +5965,7 @@ ev_view_motion_notify_event (GtkWidget      *widget,
 				      (gdouble)dy / allocation.height;
 
 			/* clamp scrolling to visible area */
+			ev_view_begin_scroll_batch (view);
 			gtk_adjustment_set_value (view->hadjustment,
 						  MIN (view->drag_info.hadj - dhadj_value,
 						       gtk_adjustment_get_upper (view->hadjustment) -
@@ -5645,6 +5974,7 @@ ev_view_motion_notify_event (GtkWidget      *widget,
 						  MIN (view->drag_info.vadj - dvadj_value,
 						       gtk_adjustment_get_upper (view->vadjustment) -
 						       gtk_adjustment_get_page_size (view->vadjustment)));
+			ev_view_end_scroll_batch (view);
 
 			return TRUE;
 		}
@@ -5725,9 +6055,8 @@ ev_view_button_release_event (GtkWidget      *widget,
 	}
 
 	if (view->drag_info.in_drag) {
-		view->drag_info.release_timeout_id =
-			g_timeout_add (20,
-				       (GSourceFunc)ev_view_scroll_drag_release, view);
+		view->drag_info.kinetic = TRUE;
+		ev_view_ensure_scroll_tick (view);
 	}
 
 	if (view->document && !view->drag_info.in_drag && view->pressed_button != 3) {
@@ -5756,14 +6085,15 @@ ev_view_button_release_event (GtkWidget      *widget,
 				/* Do not create empty annots */
 				annot_added = FALSE;
 
-				ev_document_doc_mutex_lock ();
+				g_object_ref (view->adding_annot_info.annot);
+				ev_document_lock (view->document);
 				ev_document_annotations_remove_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 									   view->adding_annot_info.annot);
-				ev_document_doc_mutex_unlock ();
+				ev_document_unlock (view->document);
 
-				ev_page_cache_mark_dirty (view->page_cache,
-							  ev_annotation_get_page_index (view->adding_annot_info.annot),
-							  EV_PAGE_DATA_INCLUDE_ANNOTS);
+				ev_page_cache_remove_annot (view->page_cache,
+							    view->adding_annot_info.annot);
+				g_object_unref (view->adding_annot_info.annot);
 			} else {
 				popup_rect.x1 = area.x2;
 				popup_rect.x2 = popup_rect.x1 + ANNOT_POPUP_WINDOW_DEFAULT_WIDTH;
@@ -5772,11 +6102,11 @@ ev_view_button_release_event (GtkWidget      *widget,
 
 				if (ev_annotation_markup_set_rectangle (EV_ANNOTATION_MARKUP (view->adding_annot_info.annot),
 									&popup_rect)) {
-					ev_document_doc_mutex_lock ();
+					ev_document_lock (view->document);
 					ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 										 view->adding_annot_info.annot,
 										 EV_ANNOTATIONS_SAVE_POPUP_RECT);
-					ev_document_doc_mutex_unlock ();
+					ev_document_unlock (view->document);
 				}
 				/* the annotation window might already exist */
 				window = get_window_for_annot (view, view->adding_annot_info.annot);
@@ -5831,10 +6161,7 @@ ev_view_button_release_event (GtkWidget      *widget,
 
 	view->pressed_button = -1;
 
-	if (view->selection_scroll_id) {
-	    g_source_remove (view->selection_scroll_id);
-	    view->selection_scroll_id = 0;
-	}
+	view->selection_scrolling = FALSE;
 	if (view->selection_update_id) {
 	    g_source_remove (view->selection_update_id);
 	    view->selection_update_id = 0;
@@ -6493,63 +6820,123 @@ ev_view_activate (EvView *view)
 	}
 }
 
-static gboolean
-ev_view_autoscroll_cb (EvView *view)
+/* The speed is in pixels every 20ms, @interval is the time elapsed in µs */
+static void
+ev_view_autoscroll_step (EvView *view,
+			 gint64  interval)
 {
 	gdouble speed, value;
 
-	/* If the user stops autoscrolling, autoscrolling will be
-	 * set to false but the timeout will continue; stop the timeout: */
-	if (!view->scroll_info.autoscrolling) {
-		view->scroll_info.timeout_id = 0;
-		return FALSE;
-	}
-
 	/* Replace 100 with your speed of choice: The lower the faster.
 	 * Replace 3 with another speed of choice: The higher, the faster it accelerated
-	 * 	based on the distance of the starting point from the mouse
-	 * (All also effected by the timeout interval of this callback) */
+	 * 	based on the distance of the starting point from the mouse */
 
 	if (view->scroll_info.start_y > view->scroll_info.last_y)
 		speed = -pow ((((gdouble)view->scroll_info.start_y - view->scroll_info.last_y) / 100), 3);
 	else
 		speed = pow ((((gdouble)view->scroll_info.last_y - view->scroll_info.start_y) / 100), 3);
+	speed *= (gdouble) interval / 20000;
 
 	value = gtk_adjustment_get_value (view->vadjustment);
 	value = CLAMP (value + speed, 0,
 		       gtk_adjustment_get_upper (view->vadjustment) -
 		       gtk_adjustment_get_page_size (view->vadjustment));
 	gtk_adjustment_set_value (view->vadjustment, value);
+}
 
-	return TRUE;
-
+/* Adjustments changed while the batch is open update the visible
+ * range and the prefetching of the caches only once, when it's closed.
+ */
+static void
+ev_view_begin_scroll_batch (EvView *view)
+{
+	view->batch_scroll = TRUE;
 }
 
 static void
-ev_view_autoscroll_resume (EvView *view)
+ev_view_end_scroll_batch (EvView *view)
 {
-	if (!view->scroll_info.autoscrolling)
+	view->batch_scroll = FALSE;
+	if (!view->range_update_pending)
 		return;
 
-	if (view->scroll_info.timeout_id > 0)
+	view->range_update_pending = FALSE;
+	if (view->document)
+		view_update_range_and_current_page (view);
+}
+
+/* Kinetic scrolling, autoscroll and scrolling while selecting are
+ * animated from the frame clock, in sync with the display, and the
+ * visible range is updated once per frame.
+ */
+static gboolean
+ev_view_scroll_tick_cb (GtkWidget     *widget,
+			GdkFrameClock *frame_clock,
+			gpointer       user_data)
+{
+	EvView *view = EV_VIEW (widget);
+	gint64  frame_time, interval;
+
+	frame_time = gdk_frame_clock_get_frame_time (frame_clock);
+	/* The first frame, or after being unmapped for a while */
+	interval = view->last_scroll_tick ? frame_time - view->last_scroll_tick : 0;
+	interval = CLAMP (interval, 0, 100000);
+	view->last_scroll_tick = frame_time;
+
+	ev_view_begin_scroll_batch (view);
+
+	if (view->drag_info.in_drag)
+		ev_view_drag_update_momentum (view, frame_time);
+
+	if (view->drag_info.kinetic && interval > 0)
+		view->drag_info.kinetic = ev_view_scroll_drag_release (view, interval);
+
+	if (view->scroll_info.running && interval > 0)
+		ev_view_autoscroll_step (view, interval);
+
+	if (view->selection_scrolling && interval > 0)
+		selection_scroll_step (view, interval);
+
+	ev_view_end_scroll_batch (view);
+
+	if (view->drag_info.in_drag || view->drag_info.kinetic ||
+	    view->scroll_info.running || view->selection_scrolling)
+		return G_SOURCE_CONTINUE;
+
+	view->scroll_tick_id = 0;
+	view->last_scroll_tick = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+ev_view_ensure_scroll_tick (EvView *view)
+{
+	if (view->scroll_tick_id)
 		return;
 
-	view->scroll_info.timeout_id =
-		g_timeout_add (20, (GSourceFunc)ev_view_autoscroll_cb,
-			       view);
+	view->scroll_tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (view),
+							     ev_view_scroll_tick_cb,
+							     NULL, NULL);
 }
 
 static void
-ev_view_autoscroll_pause (EvView *view)
+ev_view_autoscroll_resume (EvView *view)
 {
 	if (!view->scroll_info.autoscrolling)
 		return;
 
-	if (view->scroll_info.timeout_id == 0)
+	view->scroll_info.running = TRUE;
+	ev_view_ensure_scroll_tick (view);
+}
+
+static void
+ev_view_autoscroll_pause (EvView *view)
+{
+	if (!view->scroll_info.autoscrolling)
 		return;
 
-	g_source_remove (view->scroll_info.timeout_id);
-	view->scroll_info.timeout_id = 0;
+	view->scroll_info.running = FALSE;
 }
 
 static gint
@@ -6649,29 +7036,92 @@ draw_rubberband (EvView             *view,
 
 
 static void
-highlight_find_results (EvView *view,
-                        cairo_t *cr,
-                        int page)
+add_find_result_path (EvView            *view,
+		      cairo_t           *cr,
+		      gint               page,
+		      EvRectangle       *rectangle)
 {
-	gint i, n_results = 0;
+	GdkRectangle view_rectangle;
 
-	n_results = ev_view_find_get_n_results (view, page);
+	_ev_view_transform_doc_rect_to_view_rect (view, page, rectangle, &view_rectangle);
+	cairo_rectangle (cr,
+			 view_rectangle.x - view->scroll_x,
+			 view_rectangle.y - view->scroll_y,
+			 view_rectangle.width, view_rectangle.height);
+}
 
-	for (i = 0; i < n_results; i++) {
-		EvRectangle *rectangle;
-		GdkRectangle view_rectangle;
-		gdouble      alpha;
+static void
+fill_find_results_path (cairo_t       *cr,
+			const GdkRGBA *color,
+			gdouble        alpha)
+{
+	cairo_set_source_rgba (cr, color->red, color->green, color->blue, alpha);
+	cairo_fill_preserve (cr);
+	cairo_set_line_width (cr, 0.5);
+	cairo_set_source_rgb (cr, color->red, color->green, color->blue);
+	cairo_stroke (cr);
+}
 
-		if (i == view->find_result && page == view->find_page) {
-			alpha = 0.6;
-		} else {
-			alpha = 0.3;
+/* All the results of the page are filled at once, like rubberbands,
+ * and then the rectangles of the current match over them */
+static void
+highlight_find_results (EvView *view,
+                        cairo_t *cr,
+                        int page)
+{
+	const EvFindResults *results;
+	GtkStyleContext     *context;
+	GdkRGBA              color;
+	guint                current_match = G_MAXUINT;
+	guint                i;
+
+	if (!view->find_job) {
+		gint n_results = ev_view_find_get_n_results (view, page);
+		gint j;
+
+		for (j = 0; j < n_results; j++) {
+			GdkRectangle view_rectangle;
+
+			_ev_view_transform_doc_rect_to_view_rect (view, page,
+								  ev_view_find_get_result (view, page, j),
+								  &view_rectangle);
+			draw_rubberband (view, cr, &view_rectangle,
+					 j == view->find_result && page == view->find_page ? 0.6 : 0.3);
 		}
+		return;
+	}
 
-		rectangle = ev_view_find_get_result (view, page, i);
-		_ev_view_transform_doc_rect_to_view_rect (view, page, rectangle, &view_rectangle);
-		draw_rubberband (view, cr, &view_rectangle, alpha);
-        }
+	results = ev_job_find_get_page_results (view->find_job, page);
+	if (!results)
+		return;
+
+	if (page == view->find_page && view->find_result >= 0 &&
+	    (guint) view->find_result < results->n_areas)
+		current_match = results->matches[view->find_result];
+
+	context = gtk_widget_get_style_context (GTK_WIDGET (view));
+	gtk_style_context_save (context);
+	gtk_style_context_get_background_color (context, GTK_STATE_FLAG_SELECTED, &color);
+	gtk_style_context_restore (context);
+
+	cairo_save (cr);
+
+	cairo_new_path (cr);
+	for (i = 0; i < results->n_areas; i++) {
+		if (results->matches[i] != current_match)
+			add_find_result_path (view, cr, page, &results->areas[i]);
+	}
+	fill_find_results_path (cr, &color, 0.3);
+
+	if (current_match != G_MAXUINT) {
+		for (i = 0; i < results->n_areas; i++) {
+			if (results->matches[i] == current_match)
+				add_find_result_path (view, cr, page, &results->areas[i]);
+		}
+		fill_find_results_path (cr, &color, 0.6);
+	}
+
+	cairo_restore (cr);
 }
 
 static void
@@ -6697,6 +7147,80 @@ highlight_forward_search_results (EvView *view,
 	cairo_restore (cr);
 }
 
+static const cairo_user_data_key_t device_surface_key;
+
+static gboolean
+device_surfaces_enabled (void)
+{
+	static gint enabled = -1;
+
+	if (G_UNLIKELY (enabled == -1)) {
+		const gchar *env = g_getenv ("EV_VIEW_DEVICE_SURFACES");
+
+		enabled = env && g_ascii_strtoll (env, NULL, 10) != 0;
+	}
+
+	return enabled;
+}
+
+/* With EV_VIEW_DEVICE_SURFACES=1, the image surfaces of the cache are
+ * copied once to surfaces of the windowing system, pixmaps with X11,
+ * that the server keeps as textures and composites, scales and inverts
+ * on the GPU when it can, instead of receiving the pixels of the images
+ * again in every frame. The copy lives as long as the image, the cache
+ * replaces its surfaces instead of modifying them. Image targets, like
+ * with Wayland, gain nothing from it and get @surface itself.
+ */
+static cairo_surface_t *
+get_device_surface (cairo_t         *cr,
+		    cairo_surface_t *surface)
+{
+	cairo_surface_t *target = cairo_get_target (cr);
+	cairo_surface_t *device_surface;
+	cairo_t         *copy_cr;
+	gdouble          device_scale_x = 1, device_scale_y = 1;
+	gdouble          target_scale_x = 1, target_scale_y = 1;
+
+	if (!device_surfaces_enabled () ||
+	    cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+	    cairo_surface_get_type (target) == CAIRO_SURFACE_TYPE_IMAGE)
+		return surface;
+
+	device_surface = cairo_surface_get_user_data (surface, &device_surface_key);
+	if (device_surface &&
+	    cairo_surface_get_device (device_surface) == cairo_surface_get_device (target))
+		return device_surface;
+
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_get_device_scale (surface, &device_scale_x, &device_scale_y);
+	cairo_surface_get_device_scale (target, &target_scale_x, &target_scale_y);
+#endif
+	if (device_scale_x != target_scale_x || device_scale_y != target_scale_y)
+		return surface;
+
+	/* The size is in units of the target, scaled by its device scale */
+	device_surface = cairo_surface_create_similar (target,
+						       cairo_surface_get_content (surface),
+						       cairo_image_surface_get_width (surface) / device_scale_x,
+						       cairo_image_surface_get_height (surface) / device_scale_y);
+	if (cairo_surface_status (device_surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (device_surface);
+		return surface;
+	}
+
+	cairo_surface_set_device_offset (surface, 0, 0);
+	copy_cr = cairo_create (device_surface);
+	cairo_set_operator (copy_cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface (copy_cr, surface, 0, 0);
+	cairo_paint (copy_cr);
+	cairo_destroy (copy_cr);
+
+	cairo_surface_set_user_data (surface, &device_surface_key, device_surface,
+				     (cairo_destroy_func_t) cairo_surface_destroy);
+
+	return device_surface;
+}
+
 static void
 draw_surface (cairo_t 	      *cr,
 	      cairo_surface_t *surface,
@@ -6707,14 +7231,21 @@ draw_surface (cairo_t 	      *cr,
 	      gint             target_width,
 	      gint             target_height)
 {
+	static gboolean first_surface_drawn = FALSE;
 	gdouble width, height;
 	gdouble device_scale_x = 1, device_scale_y = 1;
 
+	if (G_UNLIKELY (!first_surface_drawn)) {
+		ev_open_timings_mark ("first-surface-drawn");
+		first_surface_drawn = TRUE;
+	}
+
 #ifdef HAVE_HIDPI_SUPPORT
 	cairo_surface_get_device_scale (surface, &device_scale_x, &device_scale_y);
 #endif
 	width = cairo_image_surface_get_width (surface) / device_scale_x;
 	height = cairo_image_surface_get_height (surface) / device_scale_y;
+	surface = get_device_surface (cr, surface);
 
 	cairo_save (cr);
 	cairo_translate (cr, x, y);
@@ -6735,8 +7266,18 @@ draw_surface (cairo_t 	      *cr,
 	cairo_surface_set_device_offset (surface,
 					 offset_x * device_scale_x,
 					 offset_y * device_scale_y);
-	cairo_set_source_surface (cr, surface, 0, 0);
-	cairo_paint (cr);
+	if (cairo_surface_get_content (surface) == CAIRO_CONTENT_ALPHA) {
+		/* Grayscale and monochrome pages are masks of their ink,
+		 * see ev_job_render_set_mask_monochrome() */
+		cairo_rectangle (cr, -offset_x, -offset_y, width, height);
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_fill (cr);
+		cairo_set_source_rgb (cr, 0., 0., 0.);
+		cairo_mask_surface (cr, surface, 0, 0);
+	} else {
+		cairo_set_source_surface (cr, surface, 0, 0);
+		cairo_paint (cr);
+	}
 	cairo_restore (cr);
 }
 
@@ -6764,6 +7305,69 @@ _ev_view_get_selection_colors (EvView  *view,
 	gtk_style_context_restore (context);
 }
 
+/* Returns the part of @page within @margin pixels of the visible
+ * area, relative to the top left corner of the page contents.
+ */
+gboolean
+_ev_view_get_visible_page_area (EvView       *view,
+				gint          page,
+				gint          margin,
+				GdkRectangle *area)
+{
+	GdkRectangle visible_area;
+	GdkRectangle page_area;
+	GtkBorder    border;
+
+	if (view->hadjustment && view->vadjustment) {
+		visible_area.x = gtk_adjustment_get_value (view->hadjustment);
+		visible_area.width = gtk_adjustment_get_page_size (view->hadjustment);
+		visible_area.y = gtk_adjustment_get_value (view->vadjustment);
+		visible_area.height = gtk_adjustment_get_page_size (view->vadjustment);
+	} else {
+		GtkAllocation allocation;
+
+		gtk_widget_get_allocation (GTK_WIDGET (view), &allocation);
+		visible_area.x = visible_area.y = 0;
+		visible_area.width = allocation.width;
+		visible_area.height = allocation.height;
+	}
+
+	visible_area.x -= margin;
+	visible_area.y -= margin;
+	visible_area.width += 2 * margin;
+	visible_area.height += 2 * margin;
+
+	ev_view_get_page_extents (view, page, &page_area, &border);
+	page_area.x += border.left;
+	page_area.y += border.top;
+	page_area.width -= (border.left + border.right);
+	page_area.height -= (border.top + border.bottom);
+
+	if (!gdk_rectangle_intersect (&page_area, &visible_area, area))
+		return FALSE;
+
+	area->x -= page_area.x;
+	area->y -= page_area.y;
+
+	return TRUE;
+}
+
+/* Inverting the colors when drawing keeps the surfaces of the cache
+ * the same in both modes, toggling the mode costs nothing then. The
+ * area has to be covered by opaque surfaces already.
+ */
+static void
+invert_area (cairo_t            *cr,
+	     const GdkRectangle *area)
+{
+	cairo_save (cr);
+	gdk_cairo_rectangle (cr, area);
+	cairo_set_operator (cr, CAIRO_OPERATOR_DIFFERENCE);
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_fill (cr);
+	cairo_restore (cr);
+}
+
 static void
 draw_selection_region (cairo_t        *cr,
 		       cairo_region_t *region,
@@ -6784,6 +7388,94 @@ draw_selection_region (cairo_t        *cr,
 	cairo_restore (cr);
 }
 
+static void
+draw_page_tiles (EvView       *view,
+		 gint          page,
+		 cairo_t      *cr,
+		 GdkRectangle *real_page_area,
+		 GdkRectangle *overlap,
+		 gboolean     *page_ready)
+{
+	cairo_surface_t *backdrop;
+	cairo_region_t  *region;
+	gboolean         missing_tiles = FALSE;
+	gboolean         has_tiles = FALSE;
+	gint             first_x, first_y, last_x, last_y;
+	gint             x, y;
+
+	first_x = (overlap->x - real_page_area->x) / EV_PIXBUF_CACHE_TILE_SIZE;
+	first_y = (overlap->y - real_page_area->y) / EV_PIXBUF_CACHE_TILE_SIZE;
+	last_x = (overlap->x + overlap->width - 1 - real_page_area->x) / EV_PIXBUF_CACHE_TILE_SIZE;
+	last_y = (overlap->y + overlap->height - 1 - real_page_area->y) / EV_PIXBUF_CACHE_TILE_SIZE;
+
+	for (y = first_y; y <= last_y && !missing_tiles; y++) {
+		for (x = first_x; x <= last_x && !missing_tiles; x++) {
+			if (!ev_pixbuf_cache_get_tile_surface (view->pixbuf_cache, page, x, y))
+				missing_tiles = TRUE;
+		}
+	}
+
+	/* Missing tiles show the low resolution page meanwhile */
+	backdrop = missing_tiles ? ev_pixbuf_cache_get_surface (view->pixbuf_cache, page) : NULL;
+	if (backdrop) {
+		gint width, height;
+
+		ev_view_get_page_size (view, page, &width, &height);
+		draw_surface (cr, backdrop, overlap->x, overlap->y,
+			      overlap->x - real_page_area->x,
+			      overlap->y - real_page_area->y,
+			      width, height);
+	}
+
+	cairo_save (cr);
+	gdk_cairo_rectangle (cr, overlap);
+	cairo_clip (cr);
+
+	for (y = first_y; y <= last_y; y++) {
+		for (x = first_x; x <= last_x; x++) {
+			cairo_surface_t *surface;
+
+			surface = ev_pixbuf_cache_get_tile_surface (view->pixbuf_cache, page, x, y);
+			if (!surface)
+				continue;
+
+			cairo_set_source_surface (cr, get_device_surface (cr, surface),
+						  real_page_area->x + x * EV_PIXBUF_CACHE_TILE_SIZE,
+						  real_page_area->y + y * EV_PIXBUF_CACHE_TILE_SIZE);
+			cairo_paint (cr);
+			has_tiles = TRUE;
+		}
+	}
+
+	cairo_restore (cr);
+
+	if (!has_tiles && !backdrop)
+		*page_ready = FALSE;
+	else if (ev_document_model_get_inverted_colors (view->model))
+		invert_area (cr, overlap);
+
+	if (page == ev_document_model_get_page (view->model))
+		ev_view_set_loading (view, !*page_ready);
+
+	if (!*page_ready)
+		return;
+
+	if (!find_selection_for_page (view, page))
+		return;
+
+	/* Tiles are rendered at the scale of the view */
+	region = ev_pixbuf_cache_get_selection_region (view->pixbuf_cache,
+						       page,
+						       view->scale);
+	if (region) {
+		GdkRGBA color;
+
+		_ev_view_get_selection_colors (view, &color, NULL);
+		draw_selection_region (cr, region, &color, real_page_area->x, real_page_area->y,
+				       1.0, 1.0);
+	}
+}
+
 static void
 draw_one_page (EvView       *view,
 	       gint          page,
@@ -6797,6 +7489,7 @@ draw_one_page (EvView       *view,
 	GdkRectangle     overlap;
 	GdkRectangle     real_page_area;
 	gint             current_page;
+	cairo_surface_t *cached_surface;
 
 	g_assert (view->document);
 
@@ -6823,17 +7516,36 @@ draw_one_page (EvView       *view,
 	if (view->continuous && page == current_page)
 		gtk_style_context_set_state (context, GTK_STATE_FLAG_ACTIVE);
 
-	gtk_render_background (context, cr, page_area->x, page_area->y, page_area->width, page_area->height);
+	/* An opaque page covers the background, only the border
+	 * around it needs to be painted */
+	cached_surface = ev_pixbuf_cache_peek_surface (view->pixbuf_cache, page);
+	if (cached_surface && cairo_surface_get_content (cached_surface) == CAIRO_CONTENT_COLOR) {
+		cairo_save (cr);
+		cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+		gdk_cairo_rectangle (cr, page_area);
+		gdk_cairo_rectangle (cr, &real_page_area);
+		cairo_clip (cr);
+		gtk_render_background (context, cr, page_area->x, page_area->y, page_area->width, page_area->height);
+		cairo_restore (cr);
+	} else {
+		gtk_render_background (context, cr, page_area->x, page_area->y, page_area->width, page_area->height);
+	}
 	gtk_render_frame (context, cr, page_area->x, page_area->y, page_area->width, page_area->height);
 	gtk_style_context_restore (context);
 
 	if (gdk_rectangle_intersect (&real_page_area, expose_area, &overlap)) {
 		gint             width, height;
 		cairo_surface_t *page_surface = NULL;
+		cairo_surface_t *annotations_surface;
 		cairo_surface_t *selection_surface = NULL;
 		gint offset_x, offset_y;
 		cairo_region_t *region = NULL;
 
+		if (ev_pixbuf_cache_is_page_tiled (view->pixbuf_cache, page)) {
+			draw_page_tiles (view, page, cr, &real_page_area, &overlap, page_ready);
+			return;
+		}
+
 		page_surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, page);
 
 		if (!page_surface) {
@@ -6853,6 +7565,12 @@ draw_one_page (EvView       *view,
 		offset_y = overlap.y - real_page_area.y;
 
 		draw_surface (cr, page_surface, overlap.x, overlap.y, offset_x, offset_y, width, height);
+		annotations_surface = ev_pixbuf_cache_get_annotations_surface (view->pixbuf_cache, page);
+		if (annotations_surface)
+			draw_surface (cr, annotations_surface, overlap.x, overlap.y, offset_x, offset_y,
+				      width, height);
+		if (ev_document_model_get_inverted_colors (view->model))
+			invert_area (cr, &overlap);
 
 		/* Get the selection pixbuf iff we have something to draw */
 		if (!find_selection_for_page (view, page))
@@ -6904,6 +7622,7 @@ ev_view_finalize (GObject *object)
 		view->selection_info.selections = NULL;
 	}
 	clear_link_selected (view);
+	g_free (view->copy_text);
 
 	if (view->synctex_result) {
 		g_free (view->synctex_result);
@@ -6938,6 +7657,7 @@ ev_view_dispose (GObject *object)
 	}
 
 	if (view->document) {
+		g_signal_handlers_disconnect_by_data (view->document, view);
 		g_object_unref (view->document);
 		view->document = NULL;
 	}
@@ -6948,32 +7668,19 @@ ev_view_dispose (GObject *object)
 	}
 
 	ev_view_find_cancel (view);
+	ev_view_copy_cancel (view);
+	ev_view_set_thumbnail_func (view, NULL, NULL, NULL);
 
 	ev_view_window_children_free (view);
 
-	if (view->selection_scroll_id) {
-	    g_source_remove (view->selection_scroll_id);
-	    view->selection_scroll_id = 0;
-	}
-
 	if (view->selection_update_id) {
 	    g_source_remove (view->selection_update_id);
 	    view->selection_update_id = 0;
 	}
 
-	if (view->scroll_info.timeout_id) {
-	    g_source_remove (view->scroll_info.timeout_id);
-	    view->scroll_info.timeout_id = 0;
-	}
-
-	if (view->drag_info.drag_timeout_id) {
-		g_source_remove (view->drag_info.drag_timeout_id);
-		view->drag_info.drag_timeout_id = 0;
-	}
-
-	if (view->drag_info.release_timeout_id) {
-		g_source_remove (view->drag_info.release_timeout_id);
-		view->drag_info.release_timeout_id = 0;
+	if (view->scroll_tick_id) {
+		gtk_widget_remove_tick_callback (GTK_WIDGET (view), view->scroll_tick_id);
+		view->scroll_tick_id = 0;
 	}
 
 	if (view->cursor_blink_timeout_id) {
@@ -7141,6 +7848,10 @@ view_update_scale_limits (EvView *view)
 	height = (rotation == 0 || rotation == 180) ? min_height : min_width;
 	max_scale = sqrt (view->pixbuf_cache_size / (width * dpi * 4 * height * dpi));
 
+	/* Pages are rendered in tiles when they don't fit in the cache */
+	if (ev_document_can_render_area (view->document))
+		max_scale = MAX (max_scale, MAX_TILED_SCALE);
+
 	ev_document_model_set_min_scale (view->model, MIN_SCALE * dpi);
 	ev_document_model_set_max_scale (view->model, max_scale * dpi);
 }
@@ -7598,6 +8309,15 @@ ev_view_class_init (EvViewClass *class)
 		         g_cclosure_marshal_VOID__VOID,
 		         G_TYPE_NONE, 0,
 			 G_TYPE_NONE);
+	/* Forms or annotations of the page were changed in the view */
+	signals[SIGNAL_PAGE_EDITED] = g_signal_new ("page-edited",
+			 G_TYPE_FROM_CLASS (object_class),
+			 G_SIGNAL_RUN_LAST,
+			 0,
+			 NULL, NULL,
+			 g_cclosure_marshal_VOID__INT,
+			 G_TYPE_NONE, 1,
+			 G_TYPE_INT);
 	signals[SIGNAL_MOVE_CURSOR] = g_signal_new ("move-cursor",
 		         G_TYPE_FROM_CLASS (object_class),
 		         G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
@@ -7826,6 +8546,11 @@ ev_view_change_page (EvView *view,
 	view->current_page = new_page;
 	view->pending_scroll = SCROLL_TO_PAGE_POSITION;
 
+	/* Get the real size of the page before scrolling to it */
+	if (view->document && new_page >= 0 &&
+	    new_page < ev_document_get_n_pages (view->document))
+		ev_document_prioritize_page (view->document, new_page);
+
 	ev_view_set_loading (view, FALSE);
 
 	ev_document_misc_get_pointer_position (GTK_WIDGET (view), &x, &y);
@@ -7834,16 +8559,61 @@ ev_view_change_page (EvView *view,
 	gtk_widget_queue_resize (GTK_WIDGET (view));
 }
 
+/* The contents of @page, in widget coordinates */
+static void
+get_page_widget_area (EvView       *view,
+		      gint          page,
+		      GdkRectangle *area)
+{
+	GtkBorder border;
+
+	ev_view_get_page_extents (view, page, area, &border);
+	area->x += border.left - view->scroll_x;
+	area->y += border.top - view->scroll_y;
+	area->width -= border.left + border.right;
+	area->height -= border.top + border.bottom;
+}
+
+static void
+ev_view_queue_draw_page (EvView *view,
+			 gint    page)
+{
+	GdkRectangle page_area;
+
+	get_page_widget_area (view, page, &page_area);
+	gtk_widget_queue_draw_area (GTK_WIDGET (view),
+				    page_area.x, page_area.y,
+				    page_area.width, page_area.height);
+}
+
 static void
 job_finished_cb (EvPixbufCache  *pixbuf_cache,
+		 gint            page,
 		 cairo_region_t *region,
 		 EvView         *view)
 {
-	if (region) {
-		gdk_window_invalidate_region (gtk_widget_get_window (GTK_WIDGET (view)), region, TRUE);
-	} else {
+	GdkRectangle    page_area;
+	cairo_region_t *damage_region;
+
+	if (page < 0) {
 		gtk_widget_queue_draw (GTK_WIDGET (view));
+		return;
 	}
+
+	/* Only the damaged part of the page is drawn again, not
+	 * every visible page with its frame and overlays */
+	if (!region) {
+		ev_view_queue_draw_page (view, page);
+		return;
+	}
+
+	get_page_widget_area (view, page, &page_area);
+	damage_region = cairo_region_copy (region);
+	cairo_region_translate (damage_region, page_area.x, page_area.y);
+	cairo_region_intersect_rectangle (damage_region, &page_area);
+	gdk_window_invalidate_region (gtk_widget_get_window (GTK_WIDGET (view)),
+				      damage_region, TRUE);
+	cairo_region_destroy (damage_region);
 }
 
 static void
@@ -7917,7 +8687,9 @@ on_adjustment_value_changed (GtkAdjustment *adjustment,
 	ev_document_misc_get_pointer_position (widget, &x, &y);
 	ev_view_handle_cursor_over_xy (view, x, y);
 
-	if (view->document)
+	if (view->batch_scroll)
+		view->range_update_pending = TRUE;
+	else if (view->document)
 		view_update_range_and_current_page (view);
 }
 
@@ -7934,11 +8706,17 @@ ev_view_new (void)
 static void
 setup_caches (EvView *view)
 {
-	gboolean inverted_colors;
-
 	view->height_to_page_cache = ev_view_get_height_to_page_cache (view);
-	view->pixbuf_cache = ev_pixbuf_cache_new (GTK_WIDGET (view), view->model, view->pixbuf_cache_size);
+	if (!view->pixbuf_cache) {
+		view->pixbuf_cache = ev_pixbuf_cache_new (GTK_WIDGET (view), view->model, view->pixbuf_cache_size);
+		ev_pixbuf_cache_set_size_limit (view->pixbuf_cache, view->pixbuf_cache_limit);
+		ev_pixbuf_cache_set_selection_region_only (view->pixbuf_cache, view->vector_selection);
+		ev_pixbuf_cache_set_device_scale (view->pixbuf_cache, view->device_scale);
+		ev_pixbuf_cache_set_render_pack_size (view->pixbuf_cache, view->render_pack_size);
+		g_signal_connect (view->pixbuf_cache, "job-finished", G_CALLBACK (job_finished_cb), view);
+	}
 	view->page_cache = ev_page_cache_new (view->document);
+	ev_page_cache_set_scheduler_client (view->page_cache, view);
 
 	ev_page_cache_set_flags (view->page_cache,
 				 ev_page_cache_get_flags (view->page_cache) |
@@ -7946,10 +8724,9 @@ setup_caches (EvView *view)
 				 EV_PAGE_DATA_INCLUDE_TEXT |
 				 EV_PAGE_DATA_INCLUDE_TEXT_ATTRS |
 		                 EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS);
-
-	inverted_colors = ev_document_model_get_inverted_colors (view->model);
-	ev_pixbuf_cache_set_inverted_colors (view->pixbuf_cache, inverted_colors);
-	g_signal_connect (view->pixbuf_cache, "job-finished", G_CALLBACK (job_finished_cb), view);
+	/* Caret navigation needs the text of visible pages, otherwise
+	 * it's fetched when used */
+	ev_page_cache_set_prefetch_text (view->page_cache, view->caret_enabled);
 }
 
 static void
@@ -7993,6 +8770,144 @@ ev_view_set_page_cache_size (EvView *view,
 	view_update_scale_limits (view);
 }
 
+/**
+ * ev_view_set_page_cache_limit:
+ * @view: #EvView instance
+ * @limit: size in bytes, or 0
+ *
+ * Limits the rendered pages kept around the visible ones to @limit
+ * bytes, dropping the ones above it. Unlike ev_view_set_page_cache_size()
+ * this doesn't change the maximum zoom level, so it can be used to
+ * shrink the cache of a view in the background, for example while its
+ * window is not focused. Use 0 to remove the limit.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_page_cache_limit (EvView *view,
+			      gsize   limit)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	if (view->pixbuf_cache_limit == limit)
+		return;
+
+	view->pixbuf_cache_limit = limit;
+	if (view->pixbuf_cache)
+		ev_pixbuf_cache_set_size_limit (view->pixbuf_cache, limit);
+}
+
+/**
+ * ev_view_set_vector_selection:
+ * @view: #EvView instance
+ * @vector_selection: whether to paint selections over the pages
+ *
+ * Sets whether selections are highlighted by painting their region
+ * over the rendered pages instead of rendering a surface of the size
+ * of the page for each selected page. This keeps almost no memory per
+ * selected page, but the selected text keeps its color.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_vector_selection (EvView  *view,
+			      gboolean vector_selection)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	vector_selection = vector_selection != FALSE;
+	if (view->vector_selection == vector_selection)
+		return;
+
+	view->vector_selection = vector_selection;
+	if (view->pixbuf_cache) {
+		ev_pixbuf_cache_set_selection_region_only (view->pixbuf_cache, vector_selection);
+		gtk_widget_queue_draw (GTK_WIDGET (view));
+	}
+}
+
+/**
+ * ev_view_set_device_scale:
+ * @view: #EvView instance
+ * @device_scale: the number of physical pixels per pixel of the view,
+ *   or 0 to use the scale factor of the widget
+ *
+ * Sets the scale at which pages are rasterized. The scale factor of
+ * the widget is always an integer, on displays with fractional scales
+ * the pages are otherwise rendered at the next integer scale and
+ * downscaled by the compositor, using many more pixels than needed.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_device_scale (EvView  *view,
+			  gdouble  device_scale)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	device_scale = MAX (device_scale, 0);
+	if (view->device_scale == device_scale)
+		return;
+
+	view->device_scale = device_scale;
+	if (view->pixbuf_cache) {
+		ev_pixbuf_cache_set_device_scale (view->pixbuf_cache, device_scale);
+		if (view->document)
+			view_update_range_and_current_page (view);
+	}
+}
+
+/**
+ * ev_view_set_render_cache_size:
+ * @view: #EvView instance
+ * @cache_size: size in bytes, or 0
+ *
+ * Sets the maximum size in bytes of the renders saved on disk, of
+ * all the documents together. Pages that take long to render are
+ * saved in the user cache, and shown from there instead of rendered
+ * again, also the next time the document is opened, until it changes.
+ * Use 0 to disable saving rendered pages.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_render_cache_size (EvView *view,
+			       gsize   cache_size)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	if (view->render_pack_size == cache_size)
+		return;
+
+	view->render_pack_size = cache_size;
+	if (view->pixbuf_cache)
+		ev_pixbuf_cache_set_render_pack_size (view->pixbuf_cache, cache_size);
+}
+
+/**
+ * ev_view_set_pinned_pages:
+ * @view: #EvView instance
+ * @pages: (array length=n_pages): pages of the document, most important first
+ * @n_pages: the number of @pages
+ *
+ * Keeps the rendered @pages around when they are scrolled out of the
+ * view, and renders them in advance when they aren't, so that going
+ * to them is instant. Meant for the pages of the navigation history
+ * around the current one. The pages pinned before are unpinned.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_set_pinned_pages (EvView     *view,
+			  const gint *pages,
+			  guint       n_pages)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	if (view->pixbuf_cache)
+		ev_pixbuf_cache_set_pinned_pages (view->pixbuf_cache, pages, n_pages);
+}
+
 /**
  * ev_view_set_loading:
  * @view:
@@ -8052,13 +8967,104 @@ ev_view_autoscroll_stop (EvView *view)
 	if (!view->scroll_info.autoscrolling)
 		return;
 
-	view->scroll_info.autoscrolling = FALSE;
 	ev_view_autoscroll_pause (view);
+	view->scroll_info.autoscrolling = FALSE;
 
 	ev_document_misc_get_pointer_position (GTK_WIDGET (view), &x, &y);
 	ev_view_handle_cursor_over_xy (view, x, y);
 }
 
+static void
+ev_view_document_cache_updated_cb (EvDocument *document,
+				   EvView     *view)
+{
+	if (!view->height_to_page_cache)
+		return;
+
+	/* Sizes of pages probed after loading the document */
+	ev_view_update_height_to_page_cache (view, view->height_to_page_cache);
+	view->pending_scroll = SCROLL_TO_PAGE_POSITION;
+	gtk_widget_queue_resize (GTK_WIDGET (view));
+}
+
+typedef struct {
+	EvDocument *old_document;
+	EvDocument *document;
+	gint        start_page;
+	gint        end_page;
+} EvViewReloadData;
+
+static gchar *
+get_page_digest_if_idle (EvDocument *document,
+			 gint        page)
+{
+	gchar *digest;
+
+	/* Don't wait for the jobs still running */
+	if (!ev_document_trylock (document))
+		return NULL;
+
+	digest = ev_document_get_page_digest (document, page);
+	ev_document_unlock (document);
+
+	return digest;
+}
+
+static gboolean
+page_unchanged_on_reload (gint     page,
+			  gpointer user_data)
+{
+	EvViewReloadData *data = (EvViewReloadData *)user_data;
+	gchar            *old_digest;
+	gchar            *digest = NULL;
+	gboolean          unchanged;
+
+	/* Only the visible pages are worth the time taken
+	 * to compare them */
+	if (page < data->start_page || page > data->end_page ||
+	    page >= ev_document_get_n_pages (data->old_document))
+		return FALSE;
+
+	old_digest = get_page_digest_if_idle (data->old_document, page);
+	if (old_digest)
+		digest = get_page_digest_if_idle (data->document, page);
+
+	unchanged = digest && strcmp (old_digest, digest) == 0;
+	g_free (old_digest);
+	g_free (digest);
+
+	return unchanged;
+}
+
+/* When the document is reloaded, the rendered pages that didn't
+ * change are kept instead of rendering them again.
+ */
+static EvPixbufCache *
+ev_view_steal_pixbuf_cache_for_reload (EvView     *view,
+				       EvDocument *document)
+{
+	EvPixbufCache    *pixbuf_cache;
+	EvViewReloadData  data;
+
+	if (!view->pixbuf_cache || !view->document || !document ||
+	    g_strcmp0 (ev_document_get_uri (view->document),
+		       ev_document_get_uri (document)) != 0 ||
+	    ev_document_get_n_pages (document) <= 0)
+		return NULL;
+
+	data.old_document = view->document;
+	data.document = document;
+	data.start_page = view->start_page;
+	data.end_page = view->end_page;
+
+	pixbuf_cache = view->pixbuf_cache;
+	view->pixbuf_cache = NULL;
+	ev_pixbuf_cache_set_document (pixbuf_cache, document,
+				      page_unchanged_on_reload, &data);
+
+	return pixbuf_cache;
+}
+
 static void
 ev_view_document_changed_cb (EvDocumentModel *model,
 			     GParamSpec      *pspec,
@@ -8067,12 +9073,18 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 	EvDocument *document = ev_document_model_get_document (model);
 
 	if (document != view->document) {
-		gint current_page;
+		EvPixbufCache *pixbuf_cache;
+		gint           current_page;
 
 		ev_view_remove_all (view);
+		ev_view_copy_cancel (view);
+		pixbuf_cache = ev_view_steal_pixbuf_cache_for_reload (view, document);
 		clear_caches (view);
 
 		if (view->document) {
+			g_signal_handlers_disconnect_by_func (view->document,
+							      ev_view_document_cache_updated_cb,
+							      view);
 			g_object_unref (view->document);
                 }
 
@@ -8081,11 +9093,17 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 		view->find_result = 0;
 
 		if (view->document) {
+			g_signal_connect (view->document, "cache-updated",
+					  G_CALLBACK (ev_view_document_cache_updated_cb),
+					  view);
 			if (ev_document_get_n_pages (view->document) <= 0 ||
-			    !ev_document_check_dimensions (view->document))
+			    !ev_document_check_dimensions (view->document)) {
+				g_clear_object (&pixbuf_cache);
 				return;
+			}
 
 			ev_view_set_loading (view, FALSE);
+			view->pixbuf_cache = pixbuf_cache;
 			setup_caches (view);
 
 			if (view->caret_enabled)
@@ -8096,6 +9114,8 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 		if (view->current_page != current_page) {
 			ev_view_change_page (view, current_page);
 		} else {
+			if (view->document && current_page > 0)
+				ev_document_prioritize_page (view->document, current_page);
 			view->pending_scroll = SCROLL_TO_KEEP_POSITION;
 			gtk_widget_queue_resize (GTK_WIDGET (view));
 		}
@@ -8109,11 +9129,12 @@ ev_view_rotation_changed_cb (EvDocumentModel *model,
 			     EvView          *view)
 {
 	gint rotation = ev_document_model_get_rotation (model);
+	gint delta = rotation - view->rotation;
 
 	view->rotation = rotation;
 
 	if (view->pixbuf_cache) {
-		ev_pixbuf_cache_clear (view->pixbuf_cache);
+		ev_pixbuf_cache_rotate (view->pixbuf_cache, delta);
 		if (!ev_document_is_page_size_uniform (view->document))
 			view->pending_scroll = SCROLL_TO_PAGE_POSITION;
 		gtk_widget_queue_resize (GTK_WIDGET (view));
@@ -8131,13 +9152,8 @@ ev_view_inverted_colors_changed_cb (EvDocumentModel *model,
 				    GParamSpec      *pspec,
 				    EvView          *view)
 {
-	if (view->pixbuf_cache) {
-		gboolean inverted_colors;
-
-		inverted_colors = ev_document_model_get_inverted_colors (model);
-		ev_pixbuf_cache_set_inverted_colors (view->pixbuf_cache, inverted_colors);
+	if (view->pixbuf_cache)
 		gtk_widget_queue_draw (GTK_WIDGET (view));
-	}
 }
 
 static void
@@ -8208,7 +9224,9 @@ ev_view_scale_changed_cb (EvDocumentModel *model,
 	view->scale = scale;
 
 	view->pending_resize = TRUE;
-	if (view->sizing_mode == EV_SIZING_FREE)
+	/* The sizing mode could be changed in the same batch of changes
+	 * of the model, with its notification still to come */
+	if (ev_document_model_get_sizing_mode (model) == EV_SIZING_FREE)
 		gtk_widget_queue_resize (GTK_WIDGET (view));
 
 	update_can_zoom (view);
@@ -8343,16 +9361,97 @@ ev_view_set_model (EvView          *view,
 					      view->model);
 }
 
+/* The cache keeps the region relative to the page, the view
+ * could be scrolled when the page has been rendered again */
+static cairo_region_t *
+ev_view_get_page_region (EvView         *view,
+			 gint            page,
+			 cairo_region_t *region)
+{
+	cairo_region_t *page_region;
+	GdkRectangle    page_area;
+	GtkBorder       border;
+
+	if (!region)
+		return NULL;
+
+	ev_view_get_page_extents (view, page, &page_area, &border);
+	page_region = cairo_region_copy (region);
+	cairo_region_translate (page_region,
+				view->scroll_x - page_area.x - border.left,
+				view->scroll_y - page_area.y - border.top);
+
+	return page_region;
+}
+
 static void
 ev_view_reload_page (EvView         *view,
 		     gint            page,
 		     cairo_region_t *region)
 {
+	cairo_region_t *page_region;
+
+	page_region = ev_view_get_page_region (view, page, region);
 	ev_pixbuf_cache_reload_page (view->pixbuf_cache,
-				     region,
+				     page_region,
 				     page,
 				     view->rotation,
 				     view->scale);
+	if (page_region)
+		cairo_region_destroy (page_region);
+}
+
+/* Only the annotations are rendered again when the pages are rendered
+ * in layers. Called after the forms or annotations of the page were
+ * edited, which other views showing the document are told about. */
+static void
+ev_view_reload_page_annotations (EvView         *view,
+				 gint            page,
+				 cairo_region_t *region)
+{
+	cairo_region_t *page_region;
+
+	page_region = ev_view_get_page_region (view, page, region);
+	ev_pixbuf_cache_reload_annotations (view->pixbuf_cache,
+					    page_region,
+					    page,
+					    view->rotation,
+					    view->scale);
+	if (page_region)
+		cairo_region_destroy (page_region);
+
+	g_signal_emit (view, signals[SIGNAL_PAGE_EDITED], 0, page);
+}
+
+/* Renders again the part of the page covered by an annotation before
+ * and after it changed, with a pixel of margin for the borders */
+static void
+ev_view_reload_annot_area (EvView            *view,
+			   gint               page,
+			   const EvRectangle *old_area,
+			   const EvRectangle *new_area)
+{
+	const EvRectangle *areas[] = { old_area, new_area };
+	cairo_region_t    *region;
+	guint              i;
+
+	region = cairo_region_create ();
+	for (i = 0; i < G_N_ELEMENTS (areas); i++) {
+		GdkRectangle view_rect;
+
+		if (!areas[i])
+			continue;
+
+		_ev_view_transform_doc_rect_to_view_rect (view, page, (EvRectangle *) areas[i], &view_rect);
+		view_rect.x -= view->scroll_x + 1;
+		view_rect.y -= view->scroll_y + 1;
+		view_rect.width += 2;
+		view_rect.height += 2;
+		cairo_region_union_rectangle (region, &view_rect);
+	}
+
+	ev_view_reload_page_annotations (view, page, region);
+	cairo_region_destroy (region);
 }
 
 void
@@ -8362,6 +9461,72 @@ ev_view_reload (EvView *view)
 	view_update_range_and_current_page (view);
 }
 
+/**
+ * ev_view_reload_edited_page:
+ * @view: an #EvView
+ * @page: a page of the document of @view
+ *
+ * Reads again the forms and annotations of @page and renders them
+ * again, after they were edited by another view showing the same
+ * document, see #EvView::page-edited.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_reload_edited_page (EvView *view,
+			    gint    page)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	if (!view->document || page < 0 ||
+	    page >= ev_document_get_n_pages (view->document))
+		return;
+
+	ev_page_cache_mark_dirty (view->page_cache, page,
+				  EV_PAGE_DATA_INCLUDE_FORMS |
+				  EV_PAGE_DATA_INCLUDE_ANNOTS);
+	ev_pixbuf_cache_reload_annotations (view->pixbuf_cache,
+					    NULL,
+					    page,
+					    view->rotation,
+					    view->scale);
+}
+
+/**
+ * ev_view_reload_layers:
+ * @view: an #EvView
+ * @layers: (element-type EvLayer): the layers shown or hidden
+ *
+ * Renders again the pages using @layers, or every page if the document
+ * doesn't know which ones use them.
+ *
+ * Since: 3.30
+ */
+void
+ev_view_reload_layers (EvView *view,
+		       GList  *layers)
+{
+	GArray *pages;
+	guint   i;
+
+	g_return_if_fail (EV_IS_VIEW (view));
+	g_return_if_fail (EV_IS_DOCUMENT_LAYERS (view->document));
+
+	/* The saved renders are of the default layers */
+	if (view->pixbuf_cache)
+		ev_pixbuf_cache_disable_render_pack (view->pixbuf_cache);
+
+	pages = ev_document_layers_get_pages (EV_DOCUMENT_LAYERS (view->document), layers);
+	if (!pages) {
+		ev_view_reload (view);
+		return;
+	}
+
+	for (i = 0; i < pages->len; i++)
+		ev_view_reload_page (view, g_array_index (pages, gint, i), NULL);
+	g_array_free (pages, TRUE);
+}
+
 /*** Zoom and sizing mode ***/
 
 static gboolean
@@ -8721,18 +9886,108 @@ ev_view_page_fits (EvView         *view,
 }
 
 /*** Find ***/
+/* The results of the find job, or the lists given by the deprecated
+ * ev_view_find_changed() */
 static gint
 ev_view_find_get_n_results (EvView *view, gint page)
 {
+	if (view->find_job)
+		return ev_job_find_get_n_results (view->find_job, page);
+
 	return view->find_pages ? g_list_length (view->find_pages[page]) : 0;
 }
 
 static EvRectangle *
 ev_view_find_get_result (EvView *view, gint page, gint result)
 {
+	if (view->find_job) {
+		const EvFindResults *results = ev_job_find_get_page_results (view->find_job, page);
+
+		return results && result >= 0 && (guint) result < results->n_areas ?
+			&results->areas[result] : NULL;
+	}
+
 	return view->find_pages ? (EvRectangle *) g_list_nth_data (view->find_pages[page], result) : NULL;
 }
 
+static gboolean
+ev_view_find_page_has_results (EvView *view, gint page)
+{
+	if (view->find_job)
+		return ev_job_find_get_page_results (view->find_job, page) != NULL;
+
+	return view->find_pages && view->find_pages[page];
+}
+
+static void
+queue_draw_find_result (EvView *view,
+			gint    page,
+			gint    result)
+{
+	EvRectangle *rect;
+	GdkRectangle view_rect;
+
+	if (page < 0 || result < 0 || result >= ev_view_find_get_n_results (view, page))
+		return;
+
+	/* The outline of the highlight is drawn over its border */
+	rect = ev_view_find_get_result (view, page, result);
+	_ev_view_transform_doc_rect_to_view_rect (view, page, rect, &view_rect);
+	gtk_widget_queue_draw_area (GTK_WIDGET (view),
+				    view_rect.x - view->scroll_x - 1,
+				    view_rect.y - view->scroll_y - 1,
+				    view_rect.width + 2, view_rect.height + 2);
+}
+
+/* The nearest page other than the find page with results, in
+ * @direction, wrapping around the document, or -1 */
+static gint
+find_page_with_results (EvView             *view,
+			EvViewFindDirection direction)
+{
+	gint n_pages, i;
+
+	if (!view->find_job && !view->find_pages)
+		return -1;
+
+	n_pages = ev_document_get_n_pages (view->document);
+	for (i = 1; i < n_pages; i++) {
+		gint page;
+
+		page = direction == EV_VIEW_FIND_NEXT ? view->find_page + i : view->find_page - i;
+		if (page >= n_pages)
+			page -= n_pages;
+		else if (page < 0)
+			page += n_pages;
+
+		if (ev_view_find_page_has_results (view, page))
+			return page;
+	}
+
+	return -1;
+}
+
+/* The pages of the previous and next results are likely to be jumped
+ * to next, and are usually far from the visible ones. That of the
+ * next result comes first.
+ */
+static void
+prefetch_find_pages (EvView *view)
+{
+	gint page;
+
+	if (!view->pixbuf_cache)
+		return;
+
+	page = find_page_with_results (view, EV_VIEW_FIND_PREV);
+	if (page >= 0)
+		ev_pixbuf_cache_prefetch_page (view->pixbuf_cache, page);
+
+	page = find_page_with_results (view, EV_VIEW_FIND_NEXT);
+	if (page >= 0)
+		ev_pixbuf_cache_prefetch_page (view->pixbuf_cache, page);
+}
+
 static void
 jump_to_find_result (EvView *view)
 {
@@ -8752,6 +10007,7 @@ jump_to_find_result (EvView *view)
 			position_caret_cursor_at_doc_point (view, page, rect->x1, rect->y1);
 
 		view->jump_to_find_result = FALSE;
+		prefetch_find_pages (view);
 	}
 }
 
@@ -8786,7 +10042,7 @@ jump_to_find_page (EvView *view, EvViewFindDirection direction, gint shift)
 		else if (page < 0)
 			page = page + n_pages;
 
-		if (view->find_pages && view->find_pages[page]) {
+		if (ev_view_find_page_has_results (view, page)) {
 			view->find_page = page;
 			break;
 		}
@@ -8796,10 +10052,27 @@ jump_to_find_page (EvView *view, EvViewFindDirection direction, gint shift)
 		ev_document_model_set_page (view->model, view->find_page);
 }
 
+static void
+find_results_changed (EvView *view, gint page)
+{
+	if (view->find_page == -1)
+		view->find_page = view->current_page;
+
+	if (view->jump_to_find_result == TRUE) {
+		jump_to_find_page (view, EV_VIEW_FIND_NEXT, 0);
+		jump_to_find_result (view);
+	}
+
+	if (view->find_page == page)
+		ev_view_queue_draw_page (view, page);
+}
+
 static void
 find_job_updated_cb (EvJobFind *job, gint page, EvView *view)
 {
-	ev_view_find_changed (view, ev_job_find_get_results (job), page);
+	g_return_if_fail (view->current_page >= 0);
+
+	find_results_changed (view, page);
 }
 
 /**
@@ -8837,16 +10110,7 @@ ev_view_find_changed (EvView *view, GList **results, gint page)
 	g_return_if_fail (view->current_page >= 0);
 
 	view->find_pages = results;
-	if (view->find_page == -1)
-		view->find_page = view->current_page;
-
-	if (view->jump_to_find_result == TRUE) {
-		jump_to_find_page (view, EV_VIEW_FIND_NEXT, 0);
-		jump_to_find_result (view);
-	}
-
-	if (view->find_page == page)
-		gtk_widget_queue_draw (GTK_WIDGET (view));
+	find_results_changed (view, page);
 }
 
 /**
@@ -8877,6 +10141,7 @@ ev_view_find_next (EvView *view)
 {
 	gint n_results;
 
+	queue_draw_find_result (view, view->find_page, view->find_result);
 	n_results = ev_view_find_get_n_results (view, view->find_page);
 	view->find_result++;
 
@@ -8888,12 +10153,13 @@ ev_view_find_next (EvView *view)
 	}
 
 	jump_to_find_result (view);
-	gtk_widget_queue_draw (GTK_WIDGET (view));
+	queue_draw_find_result (view, view->find_page, view->find_result);
 }
 
 void
 ev_view_find_previous (EvView *view)
 {
+	queue_draw_find_result (view, view->find_page, view->find_result);
 	view->find_result--;
 
 	if (view->find_result < 0) {
@@ -8904,7 +10170,7 @@ ev_view_find_previous (EvView *view)
 	}
 
 	jump_to_find_result (view);
-	gtk_widget_queue_draw (GTK_WIDGET (view));
+	queue_draw_find_result (view, view->find_page, view->find_result);
 }
 
 /**
@@ -8920,11 +10186,12 @@ ev_view_find_previous (EvView *view)
 void
 ev_view_find_set_result (EvView *view, gint page, gint result)
 {
+	queue_draw_find_result (view, view->find_page, view->find_result);
 	view->find_page = page;
 	view->find_result = result;
 	jump_to_find_page (view, EV_VIEW_FIND_NEXT, 0);
 	jump_to_find_result (view);
-	gtk_widget_queue_draw (GTK_WIDGET (view));
+	queue_draw_find_result (view, view->find_page, view->find_result);
 }
 
 void
@@ -9092,6 +10359,13 @@ compute_new_selection (EvView          *view,
 		selection->rect.x2 = width;
 		selection->rect.y2 = height;
 
+		/* Pages in the middle of the selection are selected as a
+		 * whole, there's nothing else to compute for them. */
+		if (i != first && i != last) {
+			list = g_list_prepend (list, selection);
+			continue;
+		}
+
 		ev_view_get_page_extents (view, i, &page_area, &border);
 		if (gdk_rectangle_point_in (&page_area, start))
 			point = start;
@@ -9179,6 +10453,18 @@ merge_selection_region (EvView *view,
 		if (cur_page < view->start_page || cur_page > view->end_page)
 			continue;
 
+		/* The selection didn't change on this page, so neither did
+		 * its region; keep it and don't redraw anything. This is the
+		 * common case while dragging, where only the pages of the
+		 * start and end points change. */
+		if (old_sel && new_sel &&
+		    old_sel->covered_region &&
+		    old_sel->style == new_sel->style &&
+		    ev_rect_cmp (&old_sel->rect, &new_sel->rect) == 0) {
+			new_sel->covered_region = cairo_region_reference (old_sel->covered_region);
+			continue;
+		}
+
 		/* seed the cache with a new page.  We are going to need the new
 		 * region too. */
 		if (new_sel) {
@@ -9340,7 +10626,7 @@ get_selected_text (EvView *view)
 
 	text = g_string_new (NULL);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (view->document);
 
 	for (l = view->selection_info.selections; l != NULL; l = l->next) {
 		EvViewSelection *selection = (EvViewSelection *)l->data;
@@ -9356,7 +10642,7 @@ get_selected_text (EvView *view)
 		g_free (tmp);
 	}
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (view->document);
 	
 	normalized_text = g_utf8_normalize (text->str, text->len, G_NORMALIZE_NFKC);
 	g_string_free (text, TRUE);
@@ -9374,17 +10660,97 @@ ev_view_clipboard_copy (EvView      *view,
 	gtk_clipboard_set_text (clipboard, text, -1);
 }
 
+static void
+ev_view_copy_cancel (EvView *view)
+{
+	if (!view->copy_job)
+		return;
+
+	g_signal_handlers_disconnect_by_data (view->copy_job, view);
+	ev_job_cancel (view->copy_job);
+	g_clear_object (&view->copy_job);
+}
+
+static void
+ev_view_clipboard_get_cb (GtkClipboard     *clipboard,
+			  GtkSelectionData *selection_data,
+			  guint             info,
+			  gpointer          data)
+{
+	EvView *view = EV_VIEW (data);
+
+	if (view->copy_text)
+		gtk_selection_data_set_text (selection_data, view->copy_text, -1);
+}
+
+static void
+ev_view_clipboard_clear_cb (GtkClipboard *clipboard,
+			    gpointer      data)
+{
+	EvView *view = EV_VIEW (data);
+
+	g_clear_pointer (&view->copy_text, g_free);
+}
+
+static void
+copy_job_finished_cb (EvJob  *job,
+		      EvView *view)
+{
+	GtkClipboard   *clipboard;
+	GtkTargetList  *target_list;
+	GtkTargetEntry *targets;
+	gint            n_targets;
+	gchar          *text;
+
+	text = g_strdup (ev_job_selected_text_get_text (EV_JOB_SELECTED_TEXT (job)));
+	g_signal_handlers_disconnect_by_data (job, view);
+	g_clear_object (&view->copy_job);
+	if (!text)
+		return;
+
+	target_list = gtk_target_list_new (NULL, 0);
+	gtk_target_list_add_text_targets (target_list, 0);
+	targets = gtk_target_table_new_from_list (target_list, &n_targets);
+	gtk_target_list_unref (target_list);
+
+	/* Taking the clipboard clears the text we owned before */
+	clipboard = gtk_widget_get_clipboard (GTK_WIDGET (view),
+					      GDK_SELECTION_CLIPBOARD);
+	if (gtk_clipboard_set_with_owner (clipboard,
+					  targets, n_targets,
+					  ev_view_clipboard_get_cb,
+					  ev_view_clipboard_clear_cb,
+					  G_OBJECT (view)))
+		view->copy_text = text;
+	else
+		g_free (text);
+
+	gtk_target_table_free (targets, n_targets);
+}
+
 void
 ev_view_copy (EvView *ev_view)
 {
-	char *text;
+	GList *l;
 
 	if (!EV_IS_SELECTION (ev_view->document))
 		return;
 
-	text = get_selected_text (ev_view);
-	ev_view_clipboard_copy (ev_view, text);
-	g_free (text);
+	/* Reading the text of a large selection takes a while, so it's
+	 * done in a thread and the clipboard is taken once it's ready */
+	ev_view_copy_cancel (ev_view);
+	ev_view->copy_job = ev_job_selected_text_new (ev_view->document);
+	for (l = ev_view->selection_info.selections; l != NULL; l = l->next) {
+		EvViewSelection *selection = (EvViewSelection *)l->data;
+
+		ev_job_selected_text_add_page (EV_JOB_SELECTED_TEXT (ev_view->copy_job),
+					       selection->page, selection->style,
+					       &selection->rect);
+	}
+	g_signal_connect (ev_view->copy_job, "finished",
+			  G_CALLBACK (copy_job_finished_cb),
+			  ev_view);
+	ev_job_scheduler_push_job (ev_view->copy_job, EV_JOB_PRIORITY_HIGH);
 }
 
 static void
@@ -53,8 +53,23 @@ void 		ev_view_set_loading         (EvView 	     *view,
 					     gboolean         loading);
 gboolean        ev_view_is_loading          (EvView          *view);
 void            ev_view_reload              (EvView          *view);
+void            ev_view_reload_layers       (EvView          *view,
+					     GList           *layers);
+void            ev_view_reload_edited_page  (EvView          *view,
+					     gint             page);
 void            ev_view_set_page_cache_size (EvView          *view,
 					     gsize            cache_size);
+void            ev_view_set_page_cache_limit (EvView         *view,
+					      gsize           limit);
+void            ev_view_set_vector_selection (EvView         *view,
+					      gboolean        vector_selection);
+void            ev_view_set_device_scale     (EvView         *view,
+					      gdouble         device_scale);
+void            ev_view_set_render_cache_size (EvView        *view,
+					       gsize          cache_size);
+void            ev_view_set_pinned_pages     (EvView         *view,
+					      const gint     *pages,
+					      guint           n_pages);
 
 void            ev_view_set_allow_links_change_zoom (EvView  *view,
                                                      gboolean allowed);
@@ -117,6 +132,20 @@ gboolean       ev_view_get_page_extents   (EvView       *view,
                                            gint          page,
                                            GdkRectangle *page_area,
                                            GtkBorder    *border);
+cairo_surface_t *ev_view_get_page_surface (EvView       *view,
+                                           gint          page);
+void           ev_view_set_page_preview   (EvView          *view,
+                                           gint             page,
+                                           gint             rotation,
+                                           cairo_surface_t *surface);
+typedef cairo_surface_t *(* EvViewThumbnailFunc) (EvView   *view,
+                                                  gint      page,
+                                                  gint      rotation,
+                                                  gpointer  user_data);
+void           ev_view_set_thumbnail_func (EvView              *view,
+                                           EvViewThumbnailFunc  func,
+                                           gpointer             user_data,
+                                           GDestroyNotify       destroy);
 /* Annotations */
 void           ev_view_focus_annotation      (EvView          *view,
 					      EvMapping       *annot_mapping);
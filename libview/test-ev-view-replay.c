@@ -0,0 +1,598 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "ev-init.h"
+#include "ev-document-factory.h"
+#include "ev-job-scheduler.h"
+#include "ev-surface-budget.h"
+#include "ev-view.h"
+#include "ev-view-private.h"
+#include "ev-pixbuf-cache.h"
+
+/* Replays a script of scrolls, page jumps, zoom steps and dual page
+ * toggles on an EvView in an offscreen window of a fixed size, one
+ * step per frame, and prints per step and overall statistics as JSON:
+ * the draw times, the frames that showed a page still loading, the
+ * render jobs issued and cancelled and the peak memory of the pixbuf
+ * cache. Times are in milliseconds. With --metrics, the overall
+ * figures checked by evince-perf-gate are also added to a key file,
+ * in a group for the document.
+ *
+ * A script has a command per line, # starts a comment:
+ *
+ *   scroll <px per frame> <frames>   scrolls continuously
+ *   page <index>                     jumps to a page
+ *   zoom <factor per frame> <frames> zooms in steps, as a pinch
+ *   dual                             toggles the dual page layout
+ *   wait <frames>                    lets the view settle
+ */
+
+#define FRAME_INTERVAL 16
+#define RENDER_JOB_TYPE "EvJobRender"
+
+static const gchar *default_script =
+	"scroll 40 120\n"
+	"page 10\n"
+	"wait 30\n"
+	"scroll -80 30\n"
+	"zoom 1.1 10\n"
+	"wait 30\n"
+	"zoom 0.9 10\n"
+	"dual\n"
+	"scroll 40 60\n"
+	"dual\n"
+	"wait 30\n";
+
+typedef enum {
+	STEP_SCROLL,
+	STEP_PAGE,
+	STEP_ZOOM,
+	STEP_DUAL,
+	STEP_WAIT
+} StepType;
+
+typedef struct {
+	StepType type;
+	gchar   *command;
+	gdouble  value;
+	gint     n_frames;
+
+	/* Results */
+	gint     frames;
+	gint     loading_frames;
+	gint     slow_frames;
+	gdouble  draw_total;
+	gdouble  draw_max;
+	guint    jobs_pushed;
+	guint    jobs_cancelled;
+	gsize    peak_cache_size;
+} Step;
+
+typedef struct {
+	GMainLoop       *loop;
+	EvDocumentModel *model;
+	EvView          *view;
+	GPtrArray       *steps;
+	guint            current;
+	gint             frame;
+	guint            jobs_pushed;
+	guint            jobs_cancelled;
+} Replay;
+
+static gchar *script_path = NULL;
+static gint width = 800;
+static gint height = 600;
+static gchar *metrics_path = NULL;
+static const gchar **file_arguments;
+
+static const GOptionEntry goption_options[] = {
+	{ "script", 's', 0, G_OPTION_ARG_FILENAME, &script_path, "Script to replay instead of the default one", "FILE" },
+	{ "width", 0, 0, G_OPTION_ARG_INT, &width, "Width of the window (800 by default)", "WIDTH" },
+	{ "height", 0, 0, G_OPTION_ARG_INT, &height, "Height of the window (600 by default)", "HEIGHT" },
+	{ "metrics", 'm', 0, G_OPTION_ARG_FILENAME, &metrics_path, "Add the metrics of the regression gate to the key file FILE", "FILE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<document>" },
+	{ NULL }
+};
+
+static void
+step_free (Step *step)
+{
+	g_free (step->command);
+	g_free (step);
+}
+
+static GPtrArray *
+parse_script (const gchar *script,
+	      GError     **error)
+{
+	GPtrArray *steps;
+	gchar    **lines;
+	gint       i;
+
+	steps = g_ptr_array_new_with_free_func ((GDestroyNotify) step_free);
+	lines = g_strsplit (script, "\n", -1);
+
+	for (i = 0; lines[i]; i++) {
+		gchar  **tokens;
+		Step    *step;
+		gchar   *line = g_strstrip (lines[i]);
+		guint    n_tokens;
+		gboolean valid;
+
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		tokens = g_strsplit_set (line, " \t", -1);
+		n_tokens = g_strv_length (tokens);
+
+		step = g_new0 (Step, 1);
+		step->command = g_strdup (line);
+		step->n_frames = 1;
+
+		if (g_strcmp0 (tokens[0], "scroll") == 0 || g_strcmp0 (tokens[0], "zoom") == 0) {
+			step->type = tokens[0][0] == 's' ? STEP_SCROLL : STEP_ZOOM;
+			valid = n_tokens == 3;
+			if (valid) {
+				step->value = g_ascii_strtod (tokens[1], NULL);
+				step->n_frames = atoi (tokens[2]);
+				valid = step->n_frames > 0 && (step->type == STEP_SCROLL || step->value > 0);
+			}
+		} else if (g_strcmp0 (tokens[0], "page") == 0) {
+			step->type = STEP_PAGE;
+			valid = n_tokens == 2;
+			if (valid)
+				step->value = atoi (tokens[1]);
+		} else if (g_strcmp0 (tokens[0], "dual") == 0) {
+			step->type = STEP_DUAL;
+			valid = n_tokens == 1;
+		} else if (g_strcmp0 (tokens[0], "wait") == 0) {
+			step->type = STEP_WAIT;
+			valid = n_tokens == 2;
+			if (valid) {
+				step->n_frames = atoi (tokens[1]);
+				valid = step->n_frames > 0;
+			}
+		} else {
+			valid = FALSE;
+		}
+
+		g_strfreev (tokens);
+
+		if (!valid) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Invalid command at line %d: %s", i + 1, line);
+			step_free (step);
+			g_strfreev (lines);
+			g_ptr_array_free (steps, TRUE);
+
+			return NULL;
+		}
+
+		g_ptr_array_add (steps, step);
+	}
+
+	g_strfreev (lines);
+
+	return steps;
+}
+
+static void
+get_render_job_counts (guint *pushed,
+		       guint *cancelled)
+{
+	GVariant *stats;
+	GVariant *types;
+	GVariant *render;
+
+	*pushed = *cancelled = 0;
+
+	stats = g_variant_ref_sink (ev_job_scheduler_get_stats ());
+	types = g_variant_lookup_value (stats, "job-types", G_VARIANT_TYPE_VARDICT);
+	render = types ? g_variant_lookup_value (types, RENDER_JOB_TYPE, G_VARIANT_TYPE_VARDICT) : NULL;
+	if (render) {
+		g_variant_lookup (render, "pushed", "u", pushed);
+		g_variant_lookup (render, "cancelled", "u", cancelled);
+		g_variant_unref (render);
+	}
+
+	if (types)
+		g_variant_unref (types);
+	g_variant_unref (stats);
+}
+
+/* Whether any of the visible pages is drawn as still loading */
+static gboolean
+view_is_loading (EvView *view)
+{
+	gint i;
+
+	if (view->start_page < 0)
+		return TRUE;
+
+	for (i = view->start_page; i <= view->end_page; i++) {
+		if (!ev_pixbuf_cache_peek_surface (view->pixbuf_cache, i) &&
+		    !ev_pixbuf_cache_is_page_tiled (view->pixbuf_cache, i))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gdouble
+draw_frame (EvView *view)
+{
+	cairo_surface_t *surface;
+	cairo_t         *cr;
+	gint64           start;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					      gtk_widget_get_allocated_width (GTK_WIDGET (view)),
+					      gtk_widget_get_allocated_height (GTK_WIDGET (view)));
+	cr = cairo_create (surface);
+
+	start = g_get_monotonic_time ();
+	gtk_widget_draw (GTK_WIDGET (view), cr);
+	cairo_surface_flush (surface);
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+
+	return (g_get_monotonic_time () - start) / 1000.;
+}
+
+static void
+apply_step (Replay *replay,
+	    Step   *step)
+{
+	GtkAdjustment *vadjustment;
+	gdouble        scale;
+
+	switch (step->type) {
+	case STEP_SCROLL:
+		vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (replay->view));
+		gtk_adjustment_set_value (vadjustment,
+					  gtk_adjustment_get_value (vadjustment) + step->value);
+		break;
+	case STEP_PAGE:
+		ev_document_model_set_page (replay->model,
+					    CLAMP ((gint) step->value, 0,
+						   ev_document_get_n_pages (ev_document_model_get_document (replay->model)) - 1));
+		break;
+	case STEP_ZOOM:
+		scale = ev_document_model_get_scale (replay->model) * step->value;
+		ev_document_model_set_sizing_mode (replay->model, EV_SIZING_FREE);
+		ev_document_model_set_scale (replay->model,
+					     CLAMP (scale,
+						    ev_document_model_get_min_scale (replay->model),
+						    ev_document_model_get_max_scale (replay->model)));
+		break;
+	case STEP_DUAL:
+		ev_document_model_set_page_layout (replay->model,
+						   ev_document_model_get_page_layout (replay->model) == EV_PAGE_LAYOUT_DUAL ?
+						   EV_PAGE_LAYOUT_SINGLE : EV_PAGE_LAYOUT_DUAL);
+		break;
+	case STEP_WAIT:
+		break;
+	}
+}
+
+/* Draws the frame of the previous step and applies the next one, the
+ * main loop runs the layout and the finished jobs in between */
+static gboolean
+replay_frame (Replay *replay)
+{
+	Step   *step;
+	gdouble draw_time;
+	guint   pushed, cancelled;
+
+	if (replay->current > 0 || replay->frame > 0) {
+		step = g_ptr_array_index (replay->steps, replay->frame > 0 ?
+					  replay->current : replay->current - 1);
+
+		draw_time = draw_frame (replay->view);
+		step->frames++;
+		step->draw_total += draw_time;
+		step->draw_max = MAX (step->draw_max, draw_time);
+		if (draw_time > FRAME_INTERVAL)
+			step->slow_frames++;
+		if (view_is_loading (replay->view))
+			step->loading_frames++;
+		step->peak_cache_size = MAX (step->peak_cache_size, ev_surface_budget_get_usage ());
+
+		get_render_job_counts (&pushed, &cancelled);
+		step->jobs_pushed += pushed - replay->jobs_pushed;
+		step->jobs_cancelled += cancelled - replay->jobs_cancelled;
+		replay->jobs_pushed = pushed;
+		replay->jobs_cancelled = cancelled;
+	}
+
+	if (replay->current == replay->steps->len) {
+		g_main_loop_quit (replay->loop);
+
+		return G_SOURCE_REMOVE;
+	}
+
+	step = g_ptr_array_index (replay->steps, replay->current);
+	apply_step (replay, step);
+
+	if (++replay->frame == step->n_frames) {
+		replay->current++;
+		replay->frame = 0;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+json_append_string (GString     *json,
+		    const gchar *str)
+{
+	const gchar *p;
+
+	g_string_append_c (json, '"');
+	for (p = str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			g_string_append_c (json, '\\');
+		if ((guchar) *p < 0x20)
+			g_string_append_printf (json, "\\u%04x", (guchar) *p);
+		else
+			g_string_append_c (json, *p);
+	}
+	g_string_append_c (json, '"');
+}
+
+static void
+json_append_results (GString     *json,
+		     const Step  *step)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+	g_string_append_printf (json, "\"frames\": %d, \"loading-frames\": %d, \"slow-frames\": %d",
+				step->frames, step->loading_frames, step->slow_frames);
+	g_string_append_printf (json, ", \"draw-total\": %s",
+				g_ascii_formatd (buffer, sizeof (buffer), "%.3f", step->draw_total));
+	g_string_append_printf (json, ", \"draw-max\": %s",
+				g_ascii_formatd (buffer, sizeof (buffer), "%.3f", step->draw_max));
+	g_string_append_printf (json, ", \"jobs-pushed\": %u, \"jobs-cancelled\": %u",
+				step->jobs_pushed, step->jobs_cancelled);
+	g_string_append_printf (json, ", \"peak-cache-size\": %" G_GSIZE_FORMAT,
+				step->peak_cache_size);
+}
+
+static void
+replay_get_total (Replay *replay,
+		  Step   *total)
+{
+	guint i;
+
+	memset (total, 0, sizeof (Step));
+	for (i = 0; i < replay->steps->len; i++) {
+		Step *step = g_ptr_array_index (replay->steps, i);
+
+		total->frames += step->frames;
+		total->loading_frames += step->loading_frames;
+		total->slow_frames += step->slow_frames;
+		total->draw_total += step->draw_total;
+		total->draw_max = MAX (total->draw_max, step->draw_max);
+		total->jobs_pushed += step->jobs_pushed;
+		total->jobs_cancelled += step->jobs_cancelled;
+		total->peak_cache_size = MAX (total->peak_cache_size, step->peak_cache_size);
+	}
+}
+
+static gchar *
+replay_to_json (Replay      *replay,
+		const gchar *uri)
+{
+	GString *json;
+	Step     total;
+	guint    i;
+
+	json = g_string_new ("{\"uri\": ");
+	json_append_string (json, uri);
+	g_string_append_printf (json, ", \"width\": %d, \"height\": %d, \"steps\": [", width, height);
+
+	for (i = 0; i < replay->steps->len; i++) {
+		Step *step = g_ptr_array_index (replay->steps, i);
+
+		g_string_append (json, i > 0 ? ",\n  {\"command\": " : "\n  {\"command\": ");
+		json_append_string (json, step->command);
+		g_string_append (json, ", ");
+		json_append_results (json, step);
+		g_string_append_c (json, '}');
+	}
+
+	replay_get_total (replay, &total);
+	g_string_append (json, "],\n \"total\": {");
+	json_append_results (json, &total);
+	g_string_append (json, "}}\n");
+
+	return g_string_free (json, FALSE);
+}
+
+/* Adds the overall figures to the key file at metrics_path, which
+ * may have the metrics of other documents and harnesses already */
+static gboolean
+replay_write_metrics (Replay      *replay,
+		      const gchar *document_path,
+		      GError     **error)
+{
+	GKeyFile *metrics;
+	GError   *load_error = NULL;
+	Step      total;
+	gchar    *basename;
+	gchar    *group;
+	gchar    *data;
+	gsize     length;
+	gboolean  retval;
+
+	metrics = g_key_file_new ();
+	if (!g_key_file_load_from_file (metrics, metrics_path, G_KEY_FILE_KEEP_COMMENTS, &load_error)) {
+		if (!g_error_matches (load_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			g_propagate_error (error, load_error);
+			g_key_file_free (metrics);
+
+			return FALSE;
+		}
+		g_error_free (load_error);
+	}
+
+	replay_get_total (replay, &total);
+	basename = g_path_get_basename (document_path);
+	group = g_strdup_printf ("replay %s", basename);
+	g_free (basename);
+
+	g_key_file_set_double (metrics, group, "draw-total", total.draw_total);
+	g_key_file_set_double (metrics, group, "draw-max", total.draw_max);
+	g_key_file_set_integer (metrics, group, "loading-frames", total.loading_frames);
+	g_key_file_set_uint64 (metrics, group, "peak-cache-size", total.peak_cache_size);
+	g_free (group);
+
+	data = g_key_file_to_data (metrics, &length, NULL);
+	retval = g_file_set_contents (metrics_path, data, length, error);
+	g_free (data);
+	g_key_file_free (metrics);
+
+	return retval;
+}
+
+static void
+document_loaded_cb (EvDocumentModel *model,
+		    GParamSpec      *pspec,
+		    Replay          *replay)
+{
+	g_timeout_add (FRAME_INTERVAL, (GSourceFunc) replay_frame, replay);
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GtkWidget      *window;
+	GtkWidget      *swindow;
+	EvDocument     *document;
+	GFile          *file;
+	GError         *error = NULL;
+	Replay          replay = { 0, };
+	gchar          *script;
+	gchar          *uri;
+	gchar          *json;
+	gint            retval = 0;
+
+	context = g_option_context_new ("- replays scrolling and zooming on a document");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+	g_option_context_add_group (context, gtk_get_option_group (TRUE));
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+
+		return 1;
+	}
+	g_option_context_free (context);
+
+	if (!file_arguments || g_strv_length ((gchar **) file_arguments) != 1) {
+		g_printerr ("A document is required\n");
+		return 1;
+	}
+
+	if (script_path) {
+		if (!g_file_get_contents (script_path, &script, NULL, &error)) {
+			g_printerr ("%s\n", error->message);
+			g_error_free (error);
+
+			return 1;
+		}
+	} else {
+		script = g_strdup (default_script);
+	}
+
+	replay.steps = parse_script (script, &error);
+	g_free (script);
+	if (!replay.steps) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+
+		return 1;
+	}
+
+	if (!ev_init ())
+		return 1;
+
+	file = g_file_new_for_commandline_arg (file_arguments[0]);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	document = ev_document_factory_get_document (uri, &error);
+	if (!document) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_free (uri);
+		ev_shutdown ();
+
+		return 1;
+	}
+
+	replay.loop = g_main_loop_new (NULL, FALSE);
+	replay.model = ev_document_model_new ();
+	replay.view = EV_VIEW (ev_view_new ());
+	ev_view_set_model (replay.view, replay.model);
+
+	window = gtk_offscreen_window_new ();
+	gtk_window_set_default_size (GTK_WINDOW (window), width, height);
+	swindow = gtk_scrolled_window_new (NULL, NULL);
+	gtk_container_add (GTK_CONTAINER (swindow), GTK_WIDGET (replay.view));
+	gtk_container_add (GTK_CONTAINER (window), swindow);
+	gtk_widget_show_all (window);
+
+	get_render_job_counts (&replay.jobs_pushed, &replay.jobs_cancelled);
+
+	g_signal_connect (replay.model, "notify::document",
+			  G_CALLBACK (document_loaded_cb), &replay);
+	ev_document_model_set_document (replay.model, document);
+	g_object_unref (document);
+
+	g_main_loop_run (replay.loop);
+
+	json = replay_to_json (&replay, uri);
+	g_print ("%s", json);
+	g_free (json);
+
+	if (metrics_path && !replay_write_metrics (&replay, file_arguments[0], &error)) {
+		g_printerr ("Error writing metrics: %s\n", error->message);
+		g_clear_error (&error);
+		retval = 1;
+	}
+
+	gtk_widget_destroy (window);
+	g_object_unref (replay.model);
+	g_main_loop_unref (replay.loop);
+	g_ptr_array_free (replay.steps, TRUE);
+	g_free (uri);
+
+	ev_shutdown ();
+
+	return retval;
+}
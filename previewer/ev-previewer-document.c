@@ -0,0 +1,523 @@
+/* ev-previewer-document.c:
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The sheets a document prints on, laid out from the document itself
+ * with the print settings: the selected pages, the page set, the
+ * pages per sheet and the scale. Sheets are drawn when they're
+ * rendered or printed, so previewing doesn't need the whole document
+ * to be exported first.
+ */
+
+#include <config.h>
+
+#include <math.h>
+
+#include "ev-previewer-document.h"
+
+#define MAX_PAGES_PER_SHEET 16
+
+struct _EvPreviewerDocument {
+	EvDocument  parent_instance;
+
+	EvDocument *source;
+
+	/* Source pages to print, in order */
+	GArray     *pages;
+	GtkPageSet  page_set;
+	gint        n_sheets;
+
+	gint        pages_per_sheet;
+	gint        columns;
+	gint        rows;
+	GtkNumberLayout layout;
+	gdouble     scale;
+
+	/* Sheet size and margins, in points */
+	gdouble     paper_width;
+	gdouble     paper_height;
+	gdouble     top_margin;
+	gdouble     bottom_margin;
+	gdouble     left_margin;
+	gdouble     right_margin;
+};
+
+struct _EvPreviewerDocumentClass {
+	EvDocumentClass parent_class;
+};
+
+G_DEFINE_TYPE (EvPreviewerDocument, ev_previewer_document, EV_TYPE_DOCUMENT)
+
+static void
+ev_previewer_document_finalize (GObject *object)
+{
+	EvPreviewerDocument *document = EV_PREVIEWER_DOCUMENT (object);
+
+	g_clear_object (&document->source);
+	g_clear_pointer (&document->pages, g_array_unref);
+
+	G_OBJECT_CLASS (ev_previewer_document_parent_class)->finalize (object);
+}
+
+/* The source is already loaded */
+static gboolean
+ev_previewer_document_load (EvDocument  *document,
+			    const char  *uri,
+			    GError     **error)
+{
+	return TRUE;
+}
+
+static gint
+ev_previewer_document_get_n_pages (EvDocument *document)
+{
+	return EV_PREVIEWER_DOCUMENT (document)->n_sheets;
+}
+
+static void
+ev_previewer_document_get_page_size (EvDocument *document,
+				     EvPage     *page,
+				     double     *width,
+				     double     *height)
+{
+	EvPreviewerDocument *self = EV_PREVIEWER_DOCUMENT (document);
+
+	*width = self->paper_width;
+	*height = self->paper_height;
+}
+
+static cairo_surface_t *
+ev_previewer_document_render (EvDocument      *document,
+			      EvRenderContext *rc)
+{
+	EvPreviewerDocument *self = EV_PREVIEWER_DOCUMENT (document);
+	cairo_surface_t     *surface;
+	cairo_t             *cr;
+	gint                 width, height;
+	gdouble              xscale, yscale;
+
+	ev_render_context_compute_transformed_size (rc, self->paper_width, self->paper_height,
+						    &width, &height);
+	surface = ev_surface_pool_create_surface (CAIRO_FORMAT_RGB24, width, height);
+	cr = cairo_create (surface);
+
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_paint (cr);
+
+	switch (rc->rotation) {
+	case 90:
+		cairo_translate (cr, width, 0);
+		break;
+	case 180:
+		cairo_translate (cr, width, height);
+		break;
+	case 270:
+		cairo_translate (cr, 0, height);
+		break;
+	default:
+		break;
+	}
+
+	ev_render_context_compute_scales (rc, self->paper_width, self->paper_height,
+					  &xscale, &yscale);
+	cairo_scale (cr, xscale, yscale);
+	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
+
+	ev_previewer_document_draw_sheet (self, rc->page->index, cr);
+	cairo_destroy (cr);
+
+	if (ev_render_context_is_cancelled (rc)) {
+		ev_surface_pool_recycle (surface);
+		return NULL;
+	}
+
+	return surface;
+}
+
+/* The source is locked while its pages are drawn */
+static gboolean
+ev_previewer_document_is_thread_safe (EvDocument *document)
+{
+	return TRUE;
+}
+
+/* Sheets change with the settings, unlike the source file */
+static gchar *
+ev_previewer_document_get_fingerprint (EvDocument *document)
+{
+	EvPreviewerDocument *self = EV_PREVIEWER_DOCUMENT (document);
+	const gchar         *id;
+	GString             *str;
+	guint                i;
+
+	id = ev_document_get_fingerprint (self->source);
+	if (!id)
+		id = ev_document_get_uri (self->source);
+	if (!id)
+		return NULL;
+
+	str = g_string_new (id);
+	g_string_append_printf (str, " %d %d %d %g %gx%g %g %g %g %g",
+				self->page_set, self->pages_per_sheet, self->layout,
+				self->scale, self->paper_width, self->paper_height,
+				self->top_margin, self->bottom_margin,
+				self->left_margin, self->right_margin);
+	for (i = 0; i < self->pages->len; i++)
+		g_string_append_printf (str, " %d", g_array_index (self->pages, gint, i));
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+ev_previewer_document_init (EvPreviewerDocument *document)
+{
+	document->pages = g_array_new (FALSE, FALSE, sizeof (gint));
+	document->pages_per_sheet = 1;
+	document->columns = 1;
+	document->rows = 1;
+	document->scale = 1.0;
+}
+
+static void
+ev_previewer_document_class_init (EvPreviewerDocumentClass *klass)
+{
+	GObjectClass    *gobject_class = G_OBJECT_CLASS (klass);
+	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
+
+	gobject_class->finalize = ev_previewer_document_finalize;
+
+	ev_document_class->load = ev_previewer_document_load;
+	ev_document_class->get_n_pages = ev_previewer_document_get_n_pages;
+	ev_document_class->get_page_size = ev_previewer_document_get_page_size;
+	ev_document_class->render = ev_previewer_document_render;
+	ev_document_class->is_thread_safe = ev_previewer_document_is_thread_safe;
+	ev_document_class->get_fingerprint = ev_previewer_document_get_fingerprint;
+}
+
+static void
+ev_previewer_document_set_pages (EvPreviewerDocument *self,
+				 GtkPrintSettings    *print_settings)
+{
+	gint n_pages = ev_document_get_n_pages (self->source);
+	gint n_selected;
+	gint i;
+
+	if (gtk_print_settings_get_print_pages (print_settings) == GTK_PRINT_PAGES_RANGES) {
+		GtkPageRange *ranges;
+		gint          n_ranges;
+
+		ranges = gtk_print_settings_get_page_ranges (print_settings, &n_ranges);
+		for (i = 0; i < n_ranges; i++) {
+			gint start = CLAMP (ranges[i].start, 0, n_pages - 1);
+			gint end = ranges[i].end < 0 ? n_pages - 1 : CLAMP (ranges[i].end, 0, n_pages - 1);
+			gint page;
+
+			for (page = start; page <= end; page++)
+				g_array_append_val (self->pages, page);
+		}
+		g_free (ranges);
+	}
+
+	/* All the pages when there isn't any valid range */
+	if (self->pages->len == 0) {
+		for (i = 0; i < n_pages; i++)
+			g_array_append_val (self->pages, i);
+	}
+
+	n_selected = (self->pages->len + self->pages_per_sheet - 1) / self->pages_per_sheet;
+
+	switch (self->page_set) {
+	case GTK_PAGE_SET_EVEN:
+		self->n_sheets = n_selected / 2;
+		break;
+	case GTK_PAGE_SET_ODD:
+		self->n_sheets = (n_selected + 1) / 2;
+		break;
+	default:
+		self->n_sheets = n_selected;
+	}
+}
+
+static void
+ev_previewer_document_set_layout (EvPreviewerDocument *self,
+				  GtkPrintSettings    *print_settings)
+{
+	gint pages_per_sheet;
+
+	pages_per_sheet = CLAMP (gtk_print_settings_get_number_up (print_settings),
+				 1, MAX_PAGES_PER_SHEET);
+
+	/* The grids of the print dialog, with more rows than columns
+	 * on portrait sheets */
+	switch (pages_per_sheet) {
+	case 2:
+		self->columns = 1;
+		self->rows = 2;
+		break;
+	case 4:
+		self->columns = 2;
+		self->rows = 2;
+		break;
+	case 6:
+		self->columns = 2;
+		self->rows = 3;
+		break;
+	case 9:
+		self->columns = 3;
+		self->rows = 3;
+		break;
+	case 16:
+		self->columns = 4;
+		self->rows = 4;
+		break;
+	default:
+		pages_per_sheet = 1;
+		self->columns = 1;
+		self->rows = 1;
+	}
+	self->pages_per_sheet = pages_per_sheet;
+
+	if (self->paper_width > self->paper_height) {
+		gint tmp = self->columns;
+
+		self->columns = self->rows;
+		self->rows = tmp;
+	}
+
+	self->layout = gtk_print_settings_get_number_up_layout (print_settings);
+}
+
+EvDocument *
+ev_previewer_document_new (EvDocument        *source,
+			   GtkPrintSettings  *print_settings,
+			   GtkPageSetup      *page_setup,
+			   GError           **error)
+{
+	EvPreviewerDocument *self;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (source), NULL);
+	g_return_val_if_fail (GTK_IS_PRINT_SETTINGS (print_settings), NULL);
+	g_return_val_if_fail (GTK_IS_PAGE_SETUP (page_setup), NULL);
+
+	self = g_object_new (EV_TYPE_PREVIEWER_DOCUMENT, NULL);
+	self->source = g_object_ref (source);
+
+	self->paper_width = gtk_page_setup_get_paper_width (page_setup, GTK_UNIT_POINTS);
+	self->paper_height = gtk_page_setup_get_paper_height (page_setup, GTK_UNIT_POINTS);
+	self->top_margin = gtk_page_setup_get_top_margin (page_setup, GTK_UNIT_POINTS);
+	self->bottom_margin = gtk_page_setup_get_bottom_margin (page_setup, GTK_UNIT_POINTS);
+	self->left_margin = gtk_page_setup_get_left_margin (page_setup, GTK_UNIT_POINTS);
+	self->right_margin = gtk_page_setup_get_right_margin (page_setup, GTK_UNIT_POINTS);
+
+	self->page_set = gtk_print_settings_get_page_set (print_settings);
+	self->scale = gtk_print_settings_get_scale (print_settings) / 100.0;
+	if (self->scale <= 0)
+		self->scale = 1.0;
+
+	ev_previewer_document_set_layout (self, print_settings);
+	ev_previewer_document_set_pages (self, print_settings);
+
+	if (!ev_document_load_full (EV_DOCUMENT (self), ev_document_get_uri (source),
+				    EV_DOCUMENT_LOAD_FLAG_NONE, error)) {
+		g_object_unref (self);
+		return NULL;
+	}
+
+	return EV_DOCUMENT (self);
+}
+
+static void
+ev_previewer_document_get_slot (EvPreviewerDocument *self,
+				gint                 slot,
+				gint                *column,
+				gint                *row)
+{
+	gboolean down_first = FALSE;
+	gboolean right_to_left = FALSE;
+	gboolean bottom_to_top = FALSE;
+
+	switch (self->layout) {
+	case GTK_NUMBER_UP_LAYOUT_LEFT_TO_RIGHT_BOTTOM_TO_TOP:
+		bottom_to_top = TRUE;
+		break;
+	case GTK_NUMBER_UP_LAYOUT_RIGHT_TO_LEFT_TOP_TO_BOTTOM:
+		right_to_left = TRUE;
+		break;
+	case GTK_NUMBER_UP_LAYOUT_RIGHT_TO_LEFT_BOTTOM_TO_TOP:
+		right_to_left = bottom_to_top = TRUE;
+		break;
+	case GTK_NUMBER_UP_LAYOUT_TOP_TO_BOTTOM_LEFT_TO_RIGHT:
+		down_first = TRUE;
+		break;
+	case GTK_NUMBER_UP_LAYOUT_TOP_TO_BOTTOM_RIGHT_TO_LEFT:
+		down_first = right_to_left = TRUE;
+		break;
+	case GTK_NUMBER_UP_LAYOUT_BOTTOM_TO_TOP_LEFT_TO_RIGHT:
+		down_first = bottom_to_top = TRUE;
+		break;
+	case GTK_NUMBER_UP_LAYOUT_BOTTOM_TO_TOP_RIGHT_TO_LEFT:
+		down_first = right_to_left = bottom_to_top = TRUE;
+		break;
+	default:
+		break;
+	}
+
+	if (down_first) {
+		*column = slot / self->rows;
+		*row = slot % self->rows;
+	} else {
+		*column = slot % self->columns;
+		*row = slot / self->columns;
+	}
+
+	if (right_to_left)
+		*column = self->columns - 1 - *column;
+	if (bottom_to_top)
+		*row = self->rows - 1 - *row;
+}
+
+static void
+ev_previewer_document_draw_page (EvPreviewerDocument *self,
+				 gint                 index,
+				 gdouble              width,
+				 gdouble              height,
+				 cairo_t             *cr)
+{
+	EvPage          *page;
+	EvRenderContext *rc;
+	cairo_surface_t *surface;
+	gdouble          dx = 1, dy = 0;
+
+	ev_document_lock (self->source);
+	page = ev_document_get_page (self->source, index);
+
+	if (EV_IS_DOCUMENT_PRINT (self->source)) {
+		ev_document_print_print_page (EV_DOCUMENT_PRINT (self->source), page, cr);
+		ev_document_unlock (self->source);
+		g_object_unref (page);
+		return;
+	}
+
+	/* Backends that can't draw to a context are rendered at the
+	 * resolution of the target */
+	cairo_user_to_device_distance (cr, &dx, &dy);
+	rc = ev_render_context_new (page, 0, MAX (sqrt (dx * dx + dy * dy), 0.01));
+	if (!ev_document_is_thread_safe (self->source))
+		ev_document_fc_mutex_lock ();
+	surface = ev_document_render (self->source, rc);
+	if (!ev_document_is_thread_safe (self->source))
+		ev_document_fc_mutex_unlock ();
+	ev_document_unlock (self->source);
+
+	if (surface) {
+		cairo_scale (cr,
+			     width / cairo_image_surface_get_width (surface),
+			     height / cairo_image_surface_get_height (surface));
+		cairo_set_source_surface (cr, surface, 0, 0);
+		cairo_paint (cr);
+		cairo_surface_destroy (surface);
+	}
+	g_object_unref (rc);
+	g_object_unref (page);
+}
+
+/**
+ * ev_previewer_document_draw_sheet:
+ * @document: an #EvPreviewerDocument
+ * @sheet: the sheet index
+ * @cr: a cairo context in points of the sheet
+ *
+ * Draws the source pages that go on @sheet, locking the source
+ * document while they're drawn.
+ */
+void
+ev_previewer_document_draw_sheet (EvPreviewerDocument *document,
+				  gint                 sheet,
+				  cairo_t             *cr)
+{
+	gdouble x, y, width, height;
+	gdouble cell_width, cell_height;
+	gint    first;
+	gint    slot;
+
+	g_return_if_fail (EV_IS_PREVIEWER_DOCUMENT (document));
+	g_return_if_fail (sheet >= 0 && sheet < document->n_sheets);
+
+	switch (document->page_set) {
+	case GTK_PAGE_SET_EVEN:
+		sheet = 2 * sheet + 1;
+		break;
+	case GTK_PAGE_SET_ODD:
+		sheet = 2 * sheet;
+		break;
+	default:
+		break;
+	}
+
+	/* The printable area, the whole sheet without margins */
+	x = document->left_margin;
+	y = document->top_margin;
+	width = document->paper_width - document->left_margin - document->right_margin;
+	height = document->paper_height - document->top_margin - document->bottom_margin;
+	if (width <= 0 || height <= 0) {
+		x = y = 0;
+		width = document->paper_width;
+		height = document->paper_height;
+	}
+
+	cell_width = width / document->columns;
+	cell_height = height / document->rows;
+
+	first = sheet * document->pages_per_sheet;
+	for (slot = 0; slot < document->pages_per_sheet; slot++) {
+		gdouble page_width, page_height;
+		gdouble scale;
+		gint    index;
+		gint    column, row;
+
+		if (first + slot >= (gint) document->pages->len)
+			break;
+
+		index = g_array_index (document->pages, gint, first + slot);
+		ev_document_get_page_size (document->source, index, &page_width, &page_height);
+		if (page_width <= 0 || page_height <= 0)
+			continue;
+
+		/* Pages are shrunk to fit like the print operation
+		 * does, and fill their cell when there are several */
+		scale = MIN (cell_width / page_width, cell_height / page_height);
+		if (document->pages_per_sheet == 1)
+			scale = MIN (scale, 1.0);
+		scale *= document->scale;
+
+		ev_previewer_document_get_slot (document, slot, &column, &row);
+
+		cairo_save (cr);
+		cairo_rectangle (cr, x + column * cell_width, y + row * cell_height,
+				 cell_width, cell_height);
+		cairo_clip (cr);
+		cairo_translate (cr,
+				 x + column * cell_width + (cell_width - page_width * scale) / 2,
+				 y + row * cell_height + (cell_height - page_height * scale) / 2);
+		cairo_scale (cr, scale, scale);
+		cairo_rectangle (cr, 0, 0, page_width, page_height);
+		cairo_clip (cr);
+		ev_previewer_document_draw_page (document, index, page_width, page_height, cr);
+		cairo_restore (cr);
+	}
+}
@@ -0,0 +1,46 @@
+/* ev-previewer-document.h:
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EV_PREVIEWER_DOCUMENT_H
+#define EV_PREVIEWER_DOCUMENT_H
+
+#include <gtk/gtk.h>
+
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_PREVIEWER_DOCUMENT                  (ev_previewer_document_get_type())
+#define EV_PREVIEWER_DOCUMENT(object)               (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_PREVIEWER_DOCUMENT, EvPreviewerDocument))
+#define EV_IS_PREVIEWER_DOCUMENT(object)            (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_PREVIEWER_DOCUMENT))
+
+typedef struct _EvPreviewerDocument      EvPreviewerDocument;
+typedef struct _EvPreviewerDocumentClass EvPreviewerDocumentClass;
+
+GType       ev_previewer_document_get_type   (void) G_GNUC_CONST;
+EvDocument *ev_previewer_document_new        (EvDocument          *source,
+					      GtkPrintSettings    *print_settings,
+					      GtkPageSetup        *page_setup,
+					      GError             **error);
+void        ev_previewer_document_draw_sheet (EvPreviewerDocument *document,
+					      gint                 sheet,
+					      cairo_t             *cr);
+
+G_END_DECLS
+
+#endif /* EV_PREVIEWER_DOCUMENT_H */
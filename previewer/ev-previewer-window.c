@@ -27,6 +27,7 @@
 #include <evince-view.h>
 #include "ev-page-action.h"
 
+#include "ev-previewer-document.h"
 #include "ev-previewer-window.h"
 
 struct _EvPreviewerWindow {
@@ -185,12 +186,69 @@ ev_previewer_window_print_finished (GtkPrintJob       *print_job,
 	gtk_widget_destroy (GTK_WIDGET (window));
 }
 
+/* The sheets are laid out already, the printer prints them as they are */
+static void
+ev_previewer_window_print_sheets (EvPreviewerWindow *window)
+{
+	EvPreviewerDocument *document = EV_PREVIEWER_DOCUMENT (window->document);
+	GtkPrintSettings    *settings;
+	GtkPrintJob         *job;
+	cairo_surface_t     *surface;
+	GError              *error = NULL;
+	gint                 n_sheets, i;
+
+	settings = gtk_print_settings_copy (window->print_settings);
+	gtk_print_settings_set_print_pages (settings, GTK_PRINT_PAGES_ALL);
+	gtk_print_settings_set_page_ranges (settings, NULL, 0);
+	gtk_print_settings_set_page_set (settings, GTK_PAGE_SET_ALL);
+	gtk_print_settings_set_scale (settings, 100);
+	gtk_print_settings_set_number_up (settings, 1);
+	gtk_print_settings_set (settings, "cups-number-up", "1");
+
+	job = gtk_print_job_new (window->print_job_title ?
+				 window->print_job_title :
+				 window->source_file,
+				 window->printer,
+				 settings,
+				 window->print_page_setup);
+	g_object_unref (settings);
+
+	surface = gtk_print_job_get_surface (job, &error);
+	if (!surface) {
+		ev_previewer_window_error_dialog_run (window, error);
+		g_error_free (error);
+		g_object_unref (job);
+		return;
+	}
+
+	n_sheets = ev_document_get_n_pages (window->document);
+	for (i = 0; i < n_sheets; i++) {
+		cairo_t *cr = cairo_create (surface);
+
+		ev_previewer_document_draw_sheet (document, i, cr);
+
+		cairo_show_page (cr);
+		cairo_destroy (cr);
+	}
+	cairo_surface_finish (surface);
+
+	gtk_print_job_send (job,
+			    (GtkPrintJobCompleteFunc)ev_previewer_window_print_finished,
+			    window, NULL);
+	gtk_widget_hide (GTK_WIDGET (window));
+}
+
 static void
 ev_previewer_window_do_print (EvPreviewerWindow *window)
 {
 	GtkPrintJob *job;
 	GError      *error = NULL;
 
+	if (EV_IS_PREVIEWER_DOCUMENT (window->document)) {
+		ev_previewer_window_print_sheets (window);
+		return;
+	}
+
 	job = gtk_print_job_new (window->print_job_title ?
 				 window->print_job_title :
 				 window->source_file,
@@ -725,3 +783,30 @@ ev_previewer_window_set_source_file (EvPreviewerWindow *window,
 		g_free (window->source_file);
 	window->source_file = g_strdup (source_file);
 }
+
+/* Previews @source as it's printed, laid out with the print settings */
+void
+ev_previewer_window_set_print_source (EvPreviewerWindow *window,
+				      EvDocument        *source)
+{
+	EvDocument *document;
+	GError     *error = NULL;
+
+	if (!window->print_settings)
+		window->print_settings = gtk_print_settings_new ();
+	if (!window->print_page_setup)
+		window->print_page_setup = gtk_page_setup_new ();
+
+	document = ev_previewer_document_new (source,
+					      window->print_settings,
+					      window->print_page_setup,
+					      &error);
+	if (!document) {
+		g_warning ("Failed to lay out the document: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	ev_document_model_set_document (window->model, document);
+	g_object_unref (document);
+}
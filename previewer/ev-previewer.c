@@ -38,12 +38,14 @@
 #endif
 
 static gboolean unlink_temp_file = FALSE;
+static gboolean print_source = FALSE;
 static gchar *print_settings = NULL;
 static EvPreviewerWindow *window = NULL;
 
 static const GOptionEntry goption_options[] = {
 	{ "unlink-tempfile", 'u', 0, G_OPTION_ARG_NONE, &unlink_temp_file, N_("Delete the temporary file"), NULL },
 	{ "print-settings", 'p', 0, G_OPTION_ARG_FILENAME, &print_settings, N_("File specifying print settings"), N_("FILE") },
+	{ "print-source", 's', 0, G_OPTION_ARG_NONE, &print_source, N_("Preview the document as it will be printed with the print settings"), NULL },
 	{ NULL }
 };
 
@@ -71,7 +73,12 @@ ev_previewer_load_job_finished (EvJob           *job,
 		g_object_unref (job);
 		return;
 	}
-	ev_document_model_set_document (model, job->document);
+
+	/* The document is laid out on the sheets it prints on */
+	if (print_source)
+		ev_previewer_window_set_print_source (window, job->document);
+	else
+		ev_document_model_set_document (model, job->document);
 	g_object_unref (job);
 }
 
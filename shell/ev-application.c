@@ -37,6 +37,10 @@
 
 #include "ev-application.h"
 #include "ev-file-helpers.h"
+#include "ev-job-scheduler.h"
+#include "ev-memory-stats.h"
+#include "ev-open-timings.h"
+#include "ev-render-stats.h"
 #include "ev-stock-icons.h"
 
 #ifdef ENABLE_DBUS
@@ -51,19 +55,51 @@ struct _EvApplication {
 
 	gchar *dot_dir;
 
+	/* The documents loaded, by URI, see ev_application_share_document() */
+	GHashTable *documents;
+
+	/* The other documents to open, see ev_application_queue_spawn() */
+	GQueue pending_spawns;
+	guint  spawn_source_id;
+
 #ifdef ENABLE_DBUS
         EvEvinceApplication *skeleton;
 	EvMediaPlayerKeys *keys;
 	gboolean doc_registered;
+	gboolean prewarmed;
 #endif
 };
 
+typedef struct {
+	EvApplication *application;
+	gchar         *uri;
+	EvDocument    *document;
+	gboolean       has_stamp;
+	guint64        mtime;
+	guint64        size;
+} EvSharedDocument;
+
 struct _EvApplicationClass {
 	GtkApplicationClass base_class;
 };
 
+typedef struct {
+	gchar          *uri;
+	GdkScreen      *screen;
+	EvLinkDest     *dest;
+	EvWindowRunMode mode;
+	gchar          *search_string;
+	guint           timestamp;
+} EvPendingSpawn;
+
 G_DEFINE_TYPE (EvApplication, ev_application, GTK_TYPE_APPLICATION)
 
+/* Each document is opened by its own evince process; when many are
+ * opened at once they are launched a few at a time, so that they don't
+ * all load, render and thumbnail at the same time */
+#define EV_SPAWN_INTERVAL_MS 500
+#define EV_MAX_SPAWNS_PER_INTERVAL 4
+
 #ifdef ENABLE_DBUS
 #define APPLICATION_DBUS_OBJECT_PATH "/org/gnome/evince/Evince"
 #define APPLICATION_DBUS_INTERFACE   "org.gnome.evince.Application"
@@ -249,6 +285,84 @@ ev_spawn (const char     *uri,
 	g_free (cmdline);
 }
 
+static void
+ev_pending_spawn_free (EvPendingSpawn *spawn)
+{
+	g_free (spawn->uri);
+	g_clear_object (&spawn->screen);
+	g_clear_object (&spawn->dest);
+	g_free (spawn->search_string);
+	g_slice_free (EvPendingSpawn, spawn);
+}
+
+static gboolean
+ev_application_is_loading (EvApplication *application)
+{
+	GList *l;
+
+	for (l = gtk_application_get_windows (GTK_APPLICATION (application)); l; l = g_list_next (l)) {
+		if (EV_IS_WINDOW (l->data) && ev_window_is_loading (EV_WINDOW (l->data)))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean
+ev_application_spawn_pending_cb (EvApplication *application)
+{
+	guint n_spawns;
+	guint i;
+
+	/* The document of this process goes first */
+	if (ev_application_is_loading (application))
+		return G_SOURCE_CONTINUE;
+
+	n_spawns = CLAMP (g_get_num_processors () / 2, 1, EV_MAX_SPAWNS_PER_INTERVAL);
+	for (i = 0; i < n_spawns && !g_queue_is_empty (&application->pending_spawns); i++) {
+		EvPendingSpawn *spawn = g_queue_pop_head (&application->pending_spawns);
+
+		ev_spawn (spawn->uri, spawn->screen, spawn->dest, spawn->mode,
+			  spawn->search_string, spawn->timestamp);
+		ev_pending_spawn_free (spawn);
+	}
+
+	if (!g_queue_is_empty (&application->pending_spawns))
+		return G_SOURCE_CONTINUE;
+
+	application->spawn_source_id = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+ev_application_queue_spawn (EvApplication  *application,
+			    const char     *uri,
+			    GdkScreen      *screen,
+			    EvLinkDest     *dest,
+			    EvWindowRunMode mode,
+			    const gchar    *search_string,
+			    guint           timestamp)
+{
+	EvPendingSpawn *spawn;
+
+	spawn = g_slice_new0 (EvPendingSpawn);
+	spawn->uri = g_strdup (uri);
+	spawn->screen = screen ? g_object_ref (screen) : NULL;
+	spawn->dest = dest ? g_object_ref (dest) : NULL;
+	spawn->mode = mode;
+	spawn->search_string = g_strdup (search_string);
+	spawn->timestamp = timestamp;
+	g_queue_push_tail (&application->pending_spawns, spawn);
+
+	if (application->spawn_source_id == 0) {
+		application->spawn_source_id =
+			g_timeout_add (EV_SPAWN_INTERVAL_MS,
+				       (GSourceFunc) ev_application_spawn_pending_cb,
+				       application);
+	}
+}
+
 static EvWindow *
 ev_application_get_empty_window (EvApplication *application,
 				 GdkScreen     *screen)
@@ -325,6 +439,138 @@ on_reload_cb (GObject      *source_object,
 	gdk_notify_startup_complete ();
 }
 
+/* Asks @owner to show the document of @data. With @with_uri, @owner is
+ * an idle viewer that was handed the document by the daemon.
+ */
+static void
+ev_application_send_reload (EvApplication     *application,
+			    GDBusConnection   *connection,
+			    const gchar       *owner,
+			    EvRegisterDocData *data,
+			    gboolean           with_uri)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("(a{sv}u)"));
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+        g_variant_builder_add (&builder, "{sv}",
+                               "display",
+                               g_variant_new_string (gdk_display_get_name (gdk_screen_get_display (data->screen))));
+	if (with_uri) {
+                g_variant_builder_add (&builder, "{sv}",
+                                       "uri",
+                                       g_variant_new_string (data->uri));
+	}
+	if (data->dest) {
+                switch (ev_link_dest_get_dest_type (data->dest)) {
+                case EV_LINK_DEST_TYPE_PAGE_LABEL:
+                        g_variant_builder_add (&builder, "{sv}", "page-label",
+                                               g_variant_new_string (ev_link_dest_get_page_label (data->dest)));
+                        break;
+                case EV_LINK_DEST_TYPE_PAGE:
+                        g_variant_builder_add (&builder, "{sv}", "page-index",
+                                               g_variant_new_uint32 (ev_link_dest_get_page (data->dest)));
+                        break;
+                case EV_LINK_DEST_TYPE_NAMED:
+                        g_variant_builder_add (&builder, "{sv}", "named-dest",
+                                               g_variant_new_string (ev_link_dest_get_named_dest (data->dest)));
+                        break;
+                default:
+                        break;
+                }
+	}
+	if (data->search_string) {
+                g_variant_builder_add (&builder, "{sv}",
+                                       "find-string",
+                                       g_variant_new_string (data->search_string));
+	}
+	if (data->mode != EV_WINDOW_MODE_NORMAL) {
+                g_variant_builder_add (&builder, "{sv}",
+                                       "mode",
+                                       g_variant_new_uint32 (data->mode));
+	}
+        g_variant_builder_close (&builder);
+
+        g_variant_builder_add (&builder, "u", data->timestamp);
+
+        g_dbus_connection_call (connection,
+				owner,
+				APPLICATION_DBUS_OBJECT_PATH,
+				APPLICATION_DBUS_INTERFACE,
+				"Reload",
+				g_variant_builder_end (&builder),
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				on_reload_cb,
+				NULL);
+        g_application_hold (G_APPLICATION (application));
+}
+
+static void
+on_hand_off_document_cb (GObject      *source_object,
+			 GAsyncResult *res,
+			 gpointer      user_data)
+{
+	GDBusConnection   *connection = G_DBUS_CONNECTION (source_object);
+	EvRegisterDocData *data = (EvRegisterDocData *)user_data;
+	EvApplication     *application = EV_APP;
+	GVariant          *value;
+	const gchar       *owner = "";
+	GError            *error = NULL;
+
+        g_application_release (G_APPLICATION (application));
+
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value) {
+		g_variant_get (value, "(&s)", &owner);
+	} else {
+		g_printerr ("Error handing off document: %s\n", error->message);
+		g_error_free (error);
+	}
+
+	if (owner[0] == '\0') {
+		_ev_application_open_uri_at_dest (application,
+						  data->uri,
+						  data->screen,
+						  data->dest,
+						  data->mode,
+						  data->search_string,
+						  data->timestamp);
+	} else {
+		/* The idle viewer owns the document now */
+		application->doc_registered = FALSE;
+		ev_application_send_reload (application, connection, owner, data, TRUE);
+	}
+
+	if (value)
+		g_variant_unref (value);
+	ev_register_doc_data_free (data);
+}
+
+/* Takes ownership of @data */
+static void
+ev_application_hand_off_document (EvApplication     *application,
+				  GDBusConnection   *connection,
+				  EvRegisterDocData *data)
+{
+        g_dbus_connection_call (connection,
+				EVINCE_DAEMON_SERVICE,
+				EVINCE_DAEMON_OBJECT_PATH,
+				EVINCE_DAEMON_INTERFACE,
+				"HandOffDocument",
+				g_variant_new ("(s)", data->uri),
+				G_VARIANT_TYPE ("(s)"),
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				on_hand_off_document_cb,
+				data);
+
+        g_application_hold (G_APPLICATION (application));
+}
+
 static void
 on_register_uri_cb (GObject      *source_object,
 		    GAsyncResult *res,
@@ -335,7 +581,6 @@ on_register_uri_cb (GObject      *source_object,
 	EvApplication     *application = EV_APP;
 	GVariant          *value;
 	const gchar       *owner;
-	GVariantBuilder    builder;
 	GError            *error = NULL;
 
         g_application_release (G_APPLICATION (application));
@@ -367,6 +612,13 @@ on_register_uri_cb (GObject      *source_object,
 
 		application->doc_registered = TRUE;
 
+		/* Nothing has been shown yet, let an idle viewer
+		 * started in advance show the document instead */
+		if (!application->prewarmed && !ev_application_has_window (application)) {
+			ev_application_hand_off_document (application, connection, data);
+			return;
+		}
+
 		_ev_application_open_uri_at_dest (application,
 						  data->uri,
 						  data->screen,
@@ -380,56 +632,7 @@ on_register_uri_cb (GObject      *source_object,
         }
 
 	/* Already registered */
-	g_variant_builder_init (&builder, G_VARIANT_TYPE ("(a{sv}u)"));
-        g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
-        g_variant_builder_add (&builder, "{sv}",
-                               "display",
-                               g_variant_new_string (gdk_display_get_name (gdk_screen_get_display (data->screen))));
-	if (data->dest) {
-                switch (ev_link_dest_get_dest_type (data->dest)) {
-                case EV_LINK_DEST_TYPE_PAGE_LABEL:
-                        g_variant_builder_add (&builder, "{sv}", "page-label",
-                                               g_variant_new_string (ev_link_dest_get_page_label (data->dest)));
-                        break;
-                case EV_LINK_DEST_TYPE_PAGE:
-                        g_variant_builder_add (&builder, "{sv}", "page-index",
-                                               g_variant_new_uint32 (ev_link_dest_get_page (data->dest)));
-                        break;
-                case EV_LINK_DEST_TYPE_NAMED:
-                        g_variant_builder_add (&builder, "{sv}", "named-dest",
-                                               g_variant_new_string (ev_link_dest_get_named_dest (data->dest)));
-                        break;
-                default:
-                        break;
-                }
-	}
-	if (data->search_string) {
-                g_variant_builder_add (&builder, "{sv}",
-                                       "find-string",
-                                       g_variant_new_string (data->search_string));
-	}
-	if (data->mode != EV_WINDOW_MODE_NORMAL) {
-                g_variant_builder_add (&builder, "{sv}",
-                                       "mode",
-                                       g_variant_new_uint32 (data->mode));
-	}
-        g_variant_builder_close (&builder);
-
-        g_variant_builder_add (&builder, "u", data->timestamp);
-
-        g_dbus_connection_call (connection,
-				owner,
-				APPLICATION_DBUS_OBJECT_PATH,
-				APPLICATION_DBUS_INTERFACE,
-				"Reload",
-				g_variant_builder_end (&builder),
-				NULL,
-				G_DBUS_CALL_FLAGS_NONE,
-				-1,
-				NULL,
-				on_reload_cb,
-				NULL);
-        g_application_hold (G_APPLICATION (application));
+	ev_application_send_reload (application, connection, owner, data, FALSE);
 	g_variant_unref (value);
 	ev_register_doc_data_free (data);
 }
@@ -627,9 +830,12 @@ ev_application_open_uri_at_dest (EvApplication  *application,
 {
 	g_return_if_fail (uri != NULL);
 
+	ev_open_timings_mark ("open-uri");
+
 	if (application->uri && strcmp (application->uri, uri) != 0) {
 		/* spawn a new evince process */
-		ev_spawn (uri, screen, dest, mode, search_string, timestamp);
+		ev_application_queue_spawn (application, uri, screen, dest, mode,
+					    search_string, timestamp);
 		return;
 	} else if (!application->uri) {
 		application->uri = g_strdup (uri);
@@ -725,6 +931,61 @@ handle_get_window_list_cb (EvEvinceApplication   *object,
         return TRUE;
 }
 
+static gboolean
+handle_get_scheduler_stats_cb (EvEvinceApplication   *object,
+                               GDBusMethodInvocation *invocation,
+                               EvApplication         *application)
+{
+        ev_evince_application_complete_get_scheduler_stats (object, invocation,
+                                                            ev_job_scheduler_get_stats ());
+
+        return TRUE;
+}
+
+static gboolean
+handle_get_open_timings_cb (EvEvinceApplication   *object,
+                            GDBusMethodInvocation *invocation,
+                            EvApplication         *application)
+{
+        ev_evince_application_complete_get_open_timings (object, invocation,
+                                                         ev_open_timings_get ());
+
+        return TRUE;
+}
+
+static gboolean
+handle_get_mutex_stats_cb (EvEvinceApplication   *object,
+                           GDBusMethodInvocation *invocation,
+                           EvApplication         *application)
+{
+        ev_evince_application_complete_get_mutex_stats (object, invocation,
+                                                        ev_document_get_mutex_stats ());
+
+        return TRUE;
+}
+
+static gboolean
+handle_get_memory_stats_cb (EvEvinceApplication   *object,
+                            GDBusMethodInvocation *invocation,
+                            EvApplication         *application)
+{
+        ev_evince_application_complete_get_memory_stats (object, invocation,
+                                                         ev_memory_stats_get ());
+
+        return TRUE;
+}
+
+static gboolean
+handle_get_render_stats_cb (EvEvinceApplication   *object,
+                            GDBusMethodInvocation *invocation,
+                            EvApplication         *application)
+{
+        ev_evince_application_complete_get_render_stats (object, invocation,
+                                                         ev_render_stats_get ());
+
+        return TRUE;
+}
+
 static gboolean
 handle_reload_cb (EvEvinceApplication   *object,
                   GDBusMethodInvocation *invocation,
@@ -740,6 +1001,7 @@ handle_reload_cb (EvEvinceApplication   *object,
         EvLinkDest      *dest = NULL;
         EvWindowRunMode  mode = EV_WINDOW_MODE_NORMAL;
         const gchar     *search_string = NULL;
+        const gchar     *uri = NULL;
         GdkScreen       *screen = NULL;
 
         g_variant_iter_init (&iter, args);
@@ -757,6 +1019,8 @@ handle_reload_cb (EvEvinceApplication   *object,
                         dest = ev_link_dest_new_page (g_variant_get_uint32 (value));
                 } else if (strcmp (key, "find-string") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
                         search_string = g_variant_get_string (value, NULL);
+                } else if (strcmp (key, "uri") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
+                        uri = g_variant_get_string (value, NULL);
                 }
         }
 
@@ -765,6 +1029,25 @@ handle_reload_cb (EvEvinceApplication   *object,
         else
                 screen = gdk_screen_get_default ();
 
+        /* An idle viewer being handed a document, the daemon
+         * has already registered it for us.
+         */
+        if (uri && application->prewarmed && !application->uri) {
+                application->uri = g_strdup (uri);
+                application->doc_registered = TRUE;
+                application->prewarmed = FALSE;
+
+                _ev_application_open_uri_at_dest (application, uri, screen,
+                                                  dest, mode, search_string,
+                                                  timestamp);
+                if (dest)
+                        g_object_unref (dest);
+
+                ev_evince_application_complete_reload (object, invocation);
+
+                return TRUE;
+        }
+
         windows = gtk_application_get_windows (GTK_APPLICATION ((application)));
         for (l = windows; l != NULL; l = g_list_next (l)) {
                 if (!EV_IS_WINDOW (l->data))
@@ -1098,6 +1381,21 @@ ev_application_shutdown (GApplication *gapplication)
 
 	ev_application_accel_map_save (application);
 
+	/* The documents that weren't opened yet are still opened */
+	if (application->spawn_source_id) {
+		g_source_remove (application->spawn_source_id);
+		application->spawn_source_id = 0;
+	}
+	while (!g_queue_is_empty (&application->pending_spawns)) {
+		EvPendingSpawn *spawn = g_queue_pop_head (&application->pending_spawns);
+
+		ev_spawn (spawn->uri, spawn->screen, spawn->dest, spawn->mode,
+			  spawn->search_string, spawn->timestamp);
+		ev_pending_spawn_free (spawn);
+	}
+
+	g_clear_pointer (&application->documents, g_hash_table_destroy);
+
         g_free (application->dot_dir);
         application->dot_dir = NULL;
 
@@ -1149,6 +1447,21 @@ ev_application_dbus_register (GApplication    *gapplication,
         g_signal_connect (skeleton, "handle-get-window-list",
                           G_CALLBACK (handle_get_window_list_cb),
                           application);
+        g_signal_connect (skeleton, "handle-get-scheduler-stats",
+                          G_CALLBACK (handle_get_scheduler_stats_cb),
+                          application);
+        g_signal_connect (skeleton, "handle-get-open-timings",
+                          G_CALLBACK (handle_get_open_timings_cb),
+                          application);
+        g_signal_connect (skeleton, "handle-get-mutex-stats",
+                          G_CALLBACK (handle_get_mutex_stats_cb),
+                          application);
+        g_signal_connect (skeleton, "handle-get-memory-stats",
+                          G_CALLBACK (handle_get_memory_stats_cb),
+                          application);
+        g_signal_connect (skeleton, "handle-get-render-stats",
+                          G_CALLBACK (handle_get_render_stats_cb),
+                          application);
         g_signal_connect (skeleton, "handle-reload",
                           G_CALLBACK (handle_reload_cb),
                           application);
@@ -1196,9 +1509,33 @@ ev_application_class_init (EvApplicationClass *ev_application_class)
 #endif
 }
 
+static void
+ev_shared_document_finalized_cb (EvSharedDocument *shared,
+				 GObject          *document)
+{
+	shared->document = NULL;
+	g_hash_table_remove (shared->application->documents, shared->uri);
+}
+
+static void
+ev_shared_document_free (EvSharedDocument *shared)
+{
+	if (shared->document)
+		g_object_weak_unref (G_OBJECT (shared->document),
+				     (GWeakNotify) ev_shared_document_finalized_cb,
+				     shared);
+	g_free (shared->uri);
+	g_free (shared);
+}
+
 static void
 ev_application_init (EvApplication *ev_application)
 {
+	ev_application->documents =
+		g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+				       (GDestroyNotify) ev_shared_document_free);
+	g_queue_init (&ev_application->pending_spawns);
+
         ev_application->dot_dir = g_build_filename (g_get_user_config_dir (),
                                                     "evince", NULL);
         if (!g_file_test (ev_application->dot_dir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))
@@ -1207,6 +1544,74 @@ ev_application_init (EvApplication *ev_application)
 	ev_application_accel_map_load (ev_application);
 }
 
+#ifdef ENABLE_DBUS
+static void
+on_register_idle_viewer_cb (GObject      *source_object,
+			    GAsyncResult *res,
+			    gpointer      user_data)
+{
+	EvApplication *application = EV_APPLICATION (user_data);
+	GVariant      *value;
+	GError        *error = NULL;
+
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+					       res, &error);
+	if (!value) {
+		/* Nobody will ever hand us a document */
+		g_printerr ("Error registering idle viewer: %s\n", error->message);
+		g_error_free (error);
+		g_application_quit (G_APPLICATION (application));
+		return;
+	}
+
+	g_variant_unref (value);
+}
+#endif /* ENABLE_DBUS */
+
+/**
+ * ev_application_prewarm:
+ * @application: The instance of the application.
+ *
+ * Prepares an empty window without showing it and offers this process
+ * to the daemon as an idle viewer, so that it can be handed the next
+ * document opened instead of starting a new process for it.
+ */
+void
+ev_application_prewarm (EvApplication *application)
+{
+#ifdef ENABLE_DBUS
+	GDBusConnection *connection;
+	EvWindow        *ev_window;
+
+	connection = g_application_get_dbus_connection (G_APPLICATION (application));
+	if (!connection) {
+		g_application_quit (G_APPLICATION (application));
+		return;
+	}
+
+	application->prewarmed = TRUE;
+
+	/* Build the window now, it's what takes most of the startup time */
+	ev_window = EV_WINDOW (ev_window_new ());
+	gtk_widget_realize (GTK_WIDGET (ev_window));
+
+	g_dbus_connection_call (connection,
+				EVINCE_DAEMON_SERVICE,
+				EVINCE_DAEMON_OBJECT_PATH,
+				EVINCE_DAEMON_INTERFACE,
+				"RegisterIdleViewer",
+				NULL,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				on_register_idle_viewer_cb,
+				application);
+#else
+	g_application_quit (G_APPLICATION (application));
+#endif /* ENABLE_DBUS */
+}
+
 gboolean
 ev_application_has_window (EvApplication *application)
 {
@@ -1246,6 +1651,157 @@ ev_application_get_uri (EvApplication *application)
 	return application->uri;
 }
 
+static gboolean
+ev_application_get_file_stamp (const gchar *uri,
+			       guint64     *mtime,
+			       guint64     *size)
+{
+	GFile     *file;
+	GFileInfo *info = NULL;
+
+	file = g_file_new_for_uri (uri);
+	if (g_file_is_native (file)) {
+		info = g_file_query_info (file,
+					  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	}
+	g_object_unref (file);
+
+	if (!info)
+		return FALSE;
+
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	*size = g_file_info_get_size (info);
+	g_object_unref (info);
+
+	return TRUE;
+}
+
+/**
+ * ev_application_share_document:
+ * @application: The instance of the application.
+ * @uri: the uri @document was loaded from
+ * @document: a loaded #EvDocument
+ *
+ * Makes @document available to the other windows opening @uri, with
+ * ev_application_get_shared_document(), for as long as it's alive.
+ * Only documents of local files are shared: the copies of remote ones
+ * and temporary files are removed with the window that opened them,
+ * while the document may still read from them.
+ */
+void
+ev_application_share_document (EvApplication *application,
+			       const gchar   *uri,
+			       EvDocument    *document)
+{
+	EvSharedDocument *shared;
+	GFile            *file;
+	gboolean          shareable;
+
+	g_return_if_fail (uri != NULL);
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (!application->documents)
+		return;
+
+	file = g_file_new_for_uri (uri);
+	shareable = g_file_is_native (file) && !ev_file_is_temp (file);
+	g_object_unref (file);
+	if (!shareable)
+		return;
+
+	shared = g_hash_table_lookup (application->documents, uri);
+	if (shared && shared->document == document)
+		return;
+
+	shared = g_new0 (EvSharedDocument, 1);
+	shared->application = application;
+	shared->uri = g_strdup (uri);
+	shared->document = document;
+	shared->has_stamp = ev_application_get_file_stamp (uri, &shared->mtime, &shared->size);
+	g_object_weak_ref (G_OBJECT (document),
+			   (GWeakNotify) ev_shared_document_finalized_cb,
+			   shared);
+
+	g_hash_table_replace (application->documents, shared->uri, shared);
+}
+
+/**
+ * ev_application_get_shared_document:
+ * @application: The instance of the application.
+ * @uri: the uri of the document
+ * @fingerprint: (allow-none): the fingerprint of the document
+ *
+ * Looks for a document loaded from @uri by another window. With a
+ * @fingerprint, the document found must have the same one, see
+ * ev_document_get_fingerprint(). Otherwise, the file must not have
+ * changed since the document was loaded from it.
+ *
+ * Returns: (transfer full) (allow-none): the #EvDocument or %NULL
+ */
+EvDocument *
+ev_application_get_shared_document (EvApplication *application,
+				    const gchar   *uri,
+				    const gchar   *fingerprint)
+{
+	EvSharedDocument *shared;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	if (!application->documents)
+		return NULL;
+
+	shared = g_hash_table_lookup (application->documents, uri);
+	if (!shared)
+		return NULL;
+
+	if (fingerprint) {
+		if (g_strcmp0 (ev_document_get_fingerprint (shared->document), fingerprint) != 0)
+			return NULL;
+	} else {
+		guint64 mtime, size;
+
+		if (!shared->has_stamp ||
+		    !ev_application_get_file_stamp (uri, &mtime, &size) ||
+		    mtime != shared->mtime || size != shared->size)
+			return NULL;
+	}
+
+	return g_object_ref (shared->document);
+}
+
+/**
+ * ev_application_page_edited:
+ * @application: The instance of the application.
+ * @window: the #EvWindow where @page was edited
+ * @document: the document of @window
+ * @page: the page edited
+ *
+ * Tells the other windows showing @document, shared with
+ * ev_application_share_document(), that the forms or annotations of
+ * @page were edited in @window.
+ */
+void
+ev_application_page_edited (EvApplication *application,
+			    EvWindow      *window,
+			    EvDocument    *document,
+			    gint           page)
+{
+	GList *l;
+
+	for (l = gtk_application_get_windows (GTK_APPLICATION (application)); l; l = g_list_next (l)) {
+		EvWindow *ev_window;
+
+		if (!EV_IS_WINDOW (l->data) || l->data == window)
+			continue;
+
+		ev_window = EV_WINDOW (l->data);
+		if (ev_document_model_get_document (ev_window_get_document_model (ev_window)) == document)
+			ev_window_reload_edited_page (ev_window, page);
+	}
+}
+
 /**
  * ev_application_get_media_keys:
  * @application: The instance of the application.
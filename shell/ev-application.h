@@ -63,9 +63,20 @@ void	          ev_application_open_uri_list       (EvApplication   *application,
 		  			              GSList          *uri_list,
 						      GdkScreen       *screen,
     						      guint32          timestamp);
+void              ev_application_prewarm             (EvApplication   *application);
 gboolean	  ev_application_has_window	     (EvApplication   *application);
 guint             ev_application_get_n_windows       (EvApplication   *application);
 const gchar *     ev_application_get_uri             (EvApplication   *application);
+void              ev_application_share_document      (EvApplication   *application,
+						      const gchar     *uri,
+						      EvDocument      *document);
+EvDocument       *ev_application_get_shared_document (EvApplication   *application,
+						      const gchar     *uri,
+						      const gchar     *fingerprint);
+void              ev_application_page_edited         (EvApplication   *application,
+						      EvWindow        *window,
+						      EvDocument      *document,
+						      gint             page);
 GObject		 *ev_application_get_media_keys	     (EvApplication   *application);
 
 const gchar      *ev_application_get_dot_dir         (EvApplication   *application,
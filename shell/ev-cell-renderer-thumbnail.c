@@ -0,0 +1,357 @@
+/* ev-cell-renderer-thumbnail.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Draws a thumbnail surface with the page frame around it. The
+ * thumbnails are kept unframed, and the frames are drawn once per
+ * size, so the rows don't need a framed copy of every thumbnail.
+ * The frame follows the "page-thumbnail" style of the style widget.
+ */
+
+#include <config.h>
+
+#include <cairo-gobject.h>
+
+#include "ev-cell-renderer-thumbnail.h"
+
+struct _EvCellRendererThumbnail {
+	GtkCellRenderer  parent_instance;
+
+	cairo_surface_t *surface;
+	gboolean         inverted_colors;
+
+	GtkWidget       *style_widget;
+
+	/* Frames by size and scale */
+	GHashTable      *frames;
+};
+
+struct _EvCellRendererThumbnailClass {
+	GtkCellRendererClass parent_class;
+};
+
+enum {
+	PROP_0,
+	PROP_SURFACE,
+	PROP_INVERTED_COLORS
+};
+
+G_DEFINE_TYPE (EvCellRendererThumbnail, ev_cell_renderer_thumbnail, GTK_TYPE_CELL_RENDERER)
+
+static void
+ev_cell_renderer_thumbnail_finalize (GObject *object)
+{
+	EvCellRendererThumbnail *renderer = EV_CELL_RENDERER_THUMBNAIL (object);
+
+	g_clear_pointer (&renderer->surface, cairo_surface_destroy);
+	g_hash_table_destroy (renderer->frames);
+	if (renderer->style_widget)
+		g_object_remove_weak_pointer (G_OBJECT (renderer->style_widget),
+					      (gpointer *) &renderer->style_widget);
+
+	G_OBJECT_CLASS (ev_cell_renderer_thumbnail_parent_class)->finalize (object);
+}
+
+static void
+ev_cell_renderer_thumbnail_get_property (GObject    *object,
+					 guint       prop_id,
+					 GValue     *value,
+					 GParamSpec *pspec)
+{
+	EvCellRendererThumbnail *renderer = EV_CELL_RENDERER_THUMBNAIL (object);
+
+	switch (prop_id) {
+	case PROP_SURFACE:
+		g_value_set_boxed (value, renderer->surface);
+		break;
+	case PROP_INVERTED_COLORS:
+		g_value_set_boolean (value, renderer->inverted_colors);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+ev_cell_renderer_thumbnail_set_property (GObject      *object,
+					 guint         prop_id,
+					 const GValue *value,
+					 GParamSpec   *pspec)
+{
+	EvCellRendererThumbnail *renderer = EV_CELL_RENDERER_THUMBNAIL (object);
+
+	switch (prop_id) {
+	case PROP_SURFACE:
+		g_clear_pointer (&renderer->surface, cairo_surface_destroy);
+		renderer->surface = g_value_dup_boxed (value);
+		break;
+	case PROP_INVERTED_COLORS:
+		if (renderer->inverted_colors != g_value_get_boolean (value)) {
+			renderer->inverted_colors = g_value_get_boolean (value);
+			ev_cell_renderer_thumbnail_clear_cache (renderer);
+		}
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static GtkStyleContext *
+ev_cell_renderer_thumbnail_get_style (EvCellRendererThumbnail *renderer,
+				      GtkWidget               *widget)
+{
+	GtkStyleContext *context;
+
+	context = gtk_widget_get_style_context (renderer->style_widget ? renderer->style_widget : widget);
+	gtk_style_context_save (context);
+	gtk_style_context_add_class (context, "page-thumbnail");
+	if (renderer->inverted_colors)
+		gtk_style_context_add_class (context, "inverted");
+
+	return context;
+}
+
+static void
+ev_cell_renderer_thumbnail_get_border (EvCellRendererThumbnail *renderer,
+				       GtkWidget               *widget,
+				       GtkBorder               *border)
+{
+	GtkStyleContext *context;
+
+	context = ev_cell_renderer_thumbnail_get_style (renderer, widget);
+	gtk_style_context_get_border (context, gtk_style_context_get_state (context), border);
+	gtk_style_context_restore (context);
+}
+
+/* Size of the surface in widget pixels */
+static void
+ev_cell_renderer_thumbnail_get_surface_size (EvCellRendererThumbnail *renderer,
+					     gint                    *width,
+					     gint                    *height)
+{
+	gdouble device_scale_x = 1;
+	gdouble device_scale_y = 1;
+
+	if (!renderer->surface || cairo_surface_get_type (renderer->surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+		*width = *height = 0;
+		return;
+	}
+
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_get_device_scale (renderer->surface, &device_scale_x, &device_scale_y);
+#endif
+	*width = cairo_image_surface_get_width (renderer->surface) / device_scale_x;
+	*height = cairo_image_surface_get_height (renderer->surface) / device_scale_y;
+}
+
+static void
+ev_cell_renderer_thumbnail_get_frame_size (EvCellRendererThumbnail *renderer,
+					   GtkWidget               *widget,
+					   gint                    *width,
+					   gint                    *height,
+					   GtkBorder               *border)
+{
+	ev_cell_renderer_thumbnail_get_surface_size (renderer, width, height);
+	ev_cell_renderer_thumbnail_get_border (renderer, widget, border);
+
+	*width += border->left + border->right;
+	*height += border->top + border->bottom;
+}
+
+static cairo_surface_t *
+ev_cell_renderer_thumbnail_get_frame (EvCellRendererThumbnail *renderer,
+				      GtkWidget               *widget,
+				      gint                     width,
+				      gint                     height)
+{
+	cairo_surface_t *frame;
+	GtkStyleContext *context;
+	cairo_t         *cr;
+	gchar           *key;
+	gint             device_scale = 1;
+
+#ifdef HAVE_HIDPI_SUPPORT
+	device_scale = gtk_widget_get_scale_factor (widget);
+#endif
+
+	key = g_strdup_printf ("%dx%d@%d", width, height, device_scale);
+	frame = g_hash_table_lookup (renderer->frames, key);
+	if (frame) {
+		g_free (key);
+		return frame;
+	}
+
+	frame = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					    width * device_scale,
+					    height * device_scale);
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_set_device_scale (frame, device_scale, device_scale);
+#endif
+
+	cr = cairo_create (frame);
+	context = ev_cell_renderer_thumbnail_get_style (renderer, widget);
+	gtk_render_frame (context, cr, 0, 0, width, height);
+	gtk_style_context_restore (context);
+	cairo_destroy (cr);
+
+	g_hash_table_insert (renderer->frames, key, frame);
+
+	return frame;
+}
+
+static void
+ev_cell_renderer_thumbnail_get_preferred_width (GtkCellRenderer *cell,
+						GtkWidget       *widget,
+						gint            *minimum,
+						gint            *natural)
+{
+	EvCellRendererThumbnail *renderer = EV_CELL_RENDERER_THUMBNAIL (cell);
+	GtkBorder                border;
+	gint                     width, height;
+	gint                     xpad;
+
+	gtk_cell_renderer_get_padding (cell, &xpad, NULL);
+	ev_cell_renderer_thumbnail_get_frame_size (renderer, widget, &width, &height, &border);
+
+	if (minimum)
+		*minimum = width + 2 * xpad;
+	if (natural)
+		*natural = width + 2 * xpad;
+}
+
+static void
+ev_cell_renderer_thumbnail_get_preferred_height (GtkCellRenderer *cell,
+						 GtkWidget       *widget,
+						 gint            *minimum,
+						 gint            *natural)
+{
+	EvCellRendererThumbnail *renderer = EV_CELL_RENDERER_THUMBNAIL (cell);
+	GtkBorder                border;
+	gint                     width, height;
+	gint                     ypad;
+
+	gtk_cell_renderer_get_padding (cell, NULL, &ypad);
+	ev_cell_renderer_thumbnail_get_frame_size (renderer, widget, &width, &height, &border);
+
+	if (minimum)
+		*minimum = height + 2 * ypad;
+	if (natural)
+		*natural = height + 2 * ypad;
+}
+
+static void
+ev_cell_renderer_thumbnail_render (GtkCellRenderer      *cell,
+				   cairo_t              *cr,
+				   GtkWidget            *widget,
+				   const GdkRectangle   *background_area,
+				   const GdkRectangle   *cell_area,
+				   GtkCellRendererState  flags)
+{
+	EvCellRendererThumbnail *renderer = EV_CELL_RENDERER_THUMBNAIL (cell);
+	GtkBorder                border;
+	gint                     width, height;
+	gint                     xpad, ypad;
+	gfloat                   xalign, yalign;
+	gdouble                  x, y;
+
+	if (!renderer->surface)
+		return;
+
+	ev_cell_renderer_thumbnail_get_frame_size (renderer, widget, &width, &height, &border);
+	if (width <= 0 || height <= 0)
+		return;
+
+	gtk_cell_renderer_get_padding (cell, &xpad, &ypad);
+	gtk_cell_renderer_get_alignment (cell, &xalign, &yalign);
+	if (gtk_widget_get_direction (widget) == GTK_TEXT_DIR_RTL)
+		xalign = 1.0 - xalign;
+
+	x = cell_area->x + xpad + MAX (xalign * (cell_area->width - 2 * xpad - width), 0);
+	y = cell_area->y + ypad + MAX (yalign * (cell_area->height - 2 * ypad - height), 0);
+
+	cairo_save (cr);
+	cairo_set_source_surface (cr, renderer->surface, x + border.left, y + border.top);
+	cairo_paint (cr);
+	cairo_set_source_surface (cr, ev_cell_renderer_thumbnail_get_frame (renderer, widget, width, height),
+				  x, y);
+	cairo_paint (cr);
+	cairo_restore (cr);
+}
+
+static void
+ev_cell_renderer_thumbnail_init (EvCellRendererThumbnail *renderer)
+{
+	renderer->frames = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  (GDestroyNotify) g_free,
+						  (GDestroyNotify) cairo_surface_destroy);
+}
+
+static void
+ev_cell_renderer_thumbnail_class_init (EvCellRendererThumbnailClass *klass)
+{
+	GObjectClass         *gobject_class = G_OBJECT_CLASS (klass);
+	GtkCellRendererClass *cell_class = GTK_CELL_RENDERER_CLASS (klass);
+
+	gobject_class->finalize = ev_cell_renderer_thumbnail_finalize;
+	gobject_class->get_property = ev_cell_renderer_thumbnail_get_property;
+	gobject_class->set_property = ev_cell_renderer_thumbnail_set_property;
+
+	cell_class->get_preferred_width = ev_cell_renderer_thumbnail_get_preferred_width;
+	cell_class->get_preferred_height = ev_cell_renderer_thumbnail_get_preferred_height;
+	cell_class->render = ev_cell_renderer_thumbnail_render;
+
+	g_object_class_install_property (gobject_class,
+					 PROP_SURFACE,
+					 g_param_spec_boxed ("surface",
+							     "Surface",
+							     "The unframed thumbnail",
+							     CAIRO_GOBJECT_TYPE_SURFACE,
+							     G_PARAM_READWRITE |
+							     G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (gobject_class,
+					 PROP_INVERTED_COLORS,
+					 g_param_spec_boolean ("inverted-colors",
+							       "Inverted Colors",
+							       "Whether the frame is drawn with inverted colors",
+							       FALSE,
+							       G_PARAM_READWRITE |
+							       G_PARAM_STATIC_STRINGS));
+}
+
+GtkCellRenderer *
+ev_cell_renderer_thumbnail_new (GtkWidget *style_widget)
+{
+	EvCellRendererThumbnail *renderer;
+
+	renderer = g_object_new (EV_TYPE_CELL_RENDERER_THUMBNAIL, NULL);
+	renderer->style_widget = style_widget;
+	if (style_widget)
+		g_object_add_weak_pointer (G_OBJECT (style_widget),
+					   (gpointer *) &renderer->style_widget);
+
+	return GTK_CELL_RENDERER (renderer);
+}
+
+/* Frames are drawn again after the style or the scale changed */
+void
+ev_cell_renderer_thumbnail_clear_cache (EvCellRendererThumbnail *renderer)
+{
+	g_return_if_fail (EV_IS_CELL_RENDERER_THUMBNAIL (renderer));
+
+	g_hash_table_remove_all (renderer->frames);
+}
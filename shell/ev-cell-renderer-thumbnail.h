@@ -0,0 +1,39 @@
+/* ev-cell-renderer-thumbnail.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EV_CELL_RENDERER_THUMBNAIL_H
+#define EV_CELL_RENDERER_THUMBNAIL_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_CELL_RENDERER_THUMBNAIL            (ev_cell_renderer_thumbnail_get_type ())
+#define EV_CELL_RENDERER_THUMBNAIL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_CELL_RENDERER_THUMBNAIL, EvCellRendererThumbnail))
+#define EV_IS_CELL_RENDERER_THUMBNAIL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_CELL_RENDERER_THUMBNAIL))
+
+typedef struct _EvCellRendererThumbnail      EvCellRendererThumbnail;
+typedef struct _EvCellRendererThumbnailClass EvCellRendererThumbnailClass;
+
+GType            ev_cell_renderer_thumbnail_get_type    (void) G_GNUC_CONST;
+GtkCellRenderer *ev_cell_renderer_thumbnail_new         (GtkWidget               *style_widget);
+void             ev_cell_renderer_thumbnail_clear_cache (EvCellRendererThumbnail *renderer);
+
+G_END_DECLS
+
+#endif /* EV_CELL_RENDERER_THUMBNAIL_H */
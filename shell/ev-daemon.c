@@ -41,6 +41,8 @@
 
 #define DAEMON_TIMEOUT (30) /* seconds */
 
+#define EV_SETTINGS_SCHEMA              "org.gnome.Evince"
+
 #define LOG g_debug
 
 #define EV_TYPE_DAEMON_APPLICATION              (ev_daemon_application_get_type ())
@@ -64,6 +66,9 @@ struct _EvDaemonApplication
         EvDaemon   *daemon;
         GHashTable *pending_invocations;
         GList      *docs;
+
+        /* Viewers started in advance, waiting for a document */
+        GList      *idle_viewers;
 };
 
 static GType ev_daemon_application_get_type (void);
@@ -90,6 +95,24 @@ ev_doc_free (EvDoc *doc)
 	g_free (doc);
 }
 
+typedef struct {
+        gchar *dbus_name;
+        guint  watch_id;
+} EvIdleViewer;
+
+static void
+ev_idle_viewer_free (EvIdleViewer *viewer)
+{
+        if (!viewer)
+                return;
+
+        g_free (viewer->dbus_name);
+        if (viewer->watch_id)
+                g_bus_unwatch_name (viewer->watch_id);
+
+        g_free (viewer);
+}
+
 static EvDoc *
 ev_daemon_application_find_doc (EvDaemonApplication *application,
                                 const gchar *uri)
@@ -129,6 +152,49 @@ spawn_evince (const gchar *uri)
 	return retval;
 }
 
+static gboolean
+spawn_idle_viewer (void)
+{
+	gchar   *argv[3];
+	gboolean retval;
+	GError  *error = NULL;
+
+	argv[0] = g_build_filename (BINDIR, "evince", NULL);
+	argv[1] = (gchar *) "--prewarm";
+	argv[2] = NULL;
+
+	retval = g_spawn_async (NULL /* wd */, argv, NULL /* env */,
+				0, NULL, NULL, NULL, &error);
+	if (!retval) {
+		g_printerr ("Error spawning idle evince: %s\n", error->message);
+		g_error_free (error);
+	}
+	g_free (argv[0]);
+
+	return retval;
+}
+
+static guint
+get_n_prewarmed_viewers (void)
+{
+        GSettingsSchema *schema;
+        GSettings       *settings;
+        guint            n_viewers;
+
+        /* Don't abort when running uninstalled */
+        schema = g_settings_schema_source_lookup (g_settings_schema_source_get_default (),
+                                                  EV_SETTINGS_SCHEMA, TRUE);
+        if (!schema)
+                return 0;
+
+        settings = g_settings_new_full (schema, NULL, NULL);
+        n_viewers = g_settings_get_uint (settings, "prewarmed-viewers");
+        g_object_unref (settings);
+        g_settings_schema_unref (schema);
+
+        return n_viewers;
+}
+
 static void
 name_appeared_cb (GDBusConnection *connection,
                   const gchar     *name,
@@ -148,6 +214,22 @@ name_vanished_cb (GDBusConnection *connection,
 
         LOG ("Watch name'%s' disappeared", name);
 
+        for (l = application->idle_viewers; l != NULL; l = l->next) {
+                EvIdleViewer *viewer = (EvIdleViewer *) l->data;
+
+                if (strcmp (viewer->dbus_name, name) != 0)
+                        continue;
+
+                LOG ("Idle viewer '%s' is gone", name);
+
+                application->idle_viewers = g_list_delete_link (application->idle_viewers, l);
+                ev_idle_viewer_free (viewer);
+
+                g_application_release (G_APPLICATION (application));
+
+                return;
+        }
+
         for (l = application->docs; l != NULL; l = l->next) {
                 EvDoc *doc = (EvDoc *) l->data;
 
@@ -362,6 +444,107 @@ handle_find_document_cb (EvDaemon              *object,
         return TRUE;
 }
 
+static gboolean
+handle_register_idle_viewer_cb (EvDaemon              *object,
+                                GDBusMethodInvocation *invocation,
+                                EvDaemonApplication   *application)
+{
+        GDBusConnection *connection;
+        EvIdleViewer    *viewer;
+        const char      *sender;
+
+        sender = g_dbus_method_invocation_get_sender (invocation);
+        connection = g_dbus_method_invocation_get_connection (invocation);
+
+        LOG ("RegisterIdleViewer '%s'", sender);
+
+        viewer = g_new (EvIdleViewer, 1);
+        viewer->dbus_name = g_strdup (sender);
+        viewer->watch_id = g_bus_watch_name_on_connection (connection,
+                                                           sender,
+                                                           G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                           name_appeared_cb,
+                                                           name_vanished_cb,
+                                                           application, NULL);
+
+        application->idle_viewers = g_list_append (application->idle_viewers, viewer);
+
+        ev_daemon_complete_register_idle_viewer (object, invocation);
+
+        g_application_hold (G_APPLICATION (application));
+
+        return TRUE;
+}
+
+static gboolean
+handle_hand_off_document_cb (EvDaemon              *object,
+                             GDBusMethodInvocation *invocation,
+                             const gchar           *uri,
+                             EvDaemonApplication   *application)
+{
+        GDBusConnection *connection;
+        EvIdleViewer    *viewer;
+        EvDoc           *doc;
+        const char      *sender;
+
+        LOG ("HandOffDocument URI '%s'", uri);
+
+        sender = g_dbus_method_invocation_get_sender (invocation);
+        doc = ev_daemon_application_find_doc (application, uri);
+        if (doc == NULL || strcmp (doc->dbus_name, sender) != 0) {
+                g_dbus_method_invocation_return_error_literal (invocation,
+                                                               G_DBUS_ERROR,
+                                                               G_DBUS_ERROR_BAD_ADDRESS,
+                                                               "Only owner can call this method");
+                return TRUE;
+        }
+
+        if (application->idle_viewers == NULL) {
+                /* The sender keeps the document */
+                ev_daemon_complete_hand_off_document (object, invocation, "");
+
+                return TRUE;
+        }
+
+        viewer = (EvIdleViewer *) application->idle_viewers->data;
+        application->idle_viewers = g_list_delete_link (application->idle_viewers,
+                                                        application->idle_viewers);
+
+        LOG ("HandOffDocument owner '%s' for URI '%s'", viewer->dbus_name, uri);
+
+        connection = g_dbus_method_invocation_get_connection (invocation);
+
+        /* The document now belongs to the viewer, watch it instead */
+        if (doc->loaded_id != 0)
+                g_dbus_connection_signal_unsubscribe (connection, doc->loaded_id);
+        g_bus_unwatch_name (doc->watch_id);
+
+        g_free (doc->dbus_name);
+        doc->dbus_name = viewer->dbus_name;
+        viewer->dbus_name = NULL;
+        doc->watch_id = viewer->watch_id;
+        viewer->watch_id = 0;
+        ev_idle_viewer_free (viewer);
+
+        doc->loaded_id = g_dbus_connection_signal_subscribe (connection,
+                                                             doc->dbus_name,
+                                                             EV_DBUS_WINDOW_INTERFACE_NAME,
+                                                             "DocumentLoaded",
+                                                             NULL,
+                                                             NULL,
+                                                             0,
+                                                             document_loaded_cb,
+                                                             application, NULL);
+
+        ev_daemon_complete_hand_off_document (object, invocation, doc->dbus_name);
+
+        /* The document already holds the daemon */
+        g_application_release (G_APPLICATION (application));
+        spawn_idle_viewer ();
+
+        return TRUE;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static gboolean
@@ -372,6 +555,7 @@ ev_daemon_application_dbus_register (GApplication    *gapplication,
 {
         EvDaemonApplication *application = EV_DAEMON_APPLICATION (gapplication);
         EvDaemon *skeleton;
+        guint     i, n_viewers;
 
         if (!G_APPLICATION_CLASS (ev_daemon_application_parent_class)->dbus_register (gapplication,
                                                                                       connection,
@@ -395,6 +579,15 @@ ev_daemon_application_dbus_register (GApplication    *gapplication,
                           G_CALLBACK (handle_unregister_document_cb), application);
         g_signal_connect (skeleton, "handle-find-document",
                           G_CALLBACK (handle_find_document_cb), application);
+        g_signal_connect (skeleton, "handle-register-idle-viewer",
+                          G_CALLBACK (handle_register_idle_viewer_cb), application);
+        g_signal_connect (skeleton, "handle-hand-off-document",
+                          G_CALLBACK (handle_hand_off_document_cb), application);
+
+        n_viewers = get_n_prewarmed_viewers ();
+        for (i = 0; i < n_viewers; i++)
+                spawn_idle_viewer ();
+
         return TRUE;
 }
 
@@ -434,6 +627,7 @@ ev_daemon_application_finalize (GObject *object)
         g_hash_table_destroy (application->pending_invocations);
 
         g_list_free_full (application->docs, (GDestroyNotify) ev_doc_free);
+        g_list_free_full (application->idle_viewers, (GDestroyNotify) ev_idle_viewer_free);
 
         G_OBJECT_CLASS (ev_daemon_application_parent_class)->finalize (object);
 }
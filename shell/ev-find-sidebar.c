@@ -36,9 +36,12 @@ struct _EvFindSidebarPrivate {
         gint         first_match_page;
 
         EvJobFind *job;
-        gint       job_current_page;
         gint       current_page;
         gint       insert_position;
+        gint       n_updated;
+        gint       n_processed;
+
+        GCancellable *snippets_cancellable;
 };
 
 enum {
@@ -68,6 +71,10 @@ ev_find_sidebar_cancel (EvFindSidebar *sidebar)
                 g_source_remove (priv->process_matches_idle_id);
                 priv->process_matches_idle_id = 0;
         }
+        if (priv->snippets_cancellable) {
+                g_cancellable_cancel (priv->snippets_cancellable);
+                g_clear_object (&priv->snippets_cancellable);
+        }
         g_clear_object (&priv->job);
 }
 
@@ -208,7 +215,12 @@ ev_find_sidebar_init (EvFindSidebar *sidebar)
         gtk_box_pack_start (GTK_BOX (sidebar), swindow, TRUE, TRUE, 0);
         gtk_widget_show (swindow);
 
+        /* Rows all have the same height, so that only the visible ones
+         * are measured and rendered, however many results there are */
+        gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (priv->tree_view), TRUE);
+
         column = gtk_tree_view_column_new ();
+        gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
         gtk_tree_view_column_set_expand (GTK_TREE_VIEW_COLUMN (column), TRUE);
         gtk_tree_view_append_column (GTK_TREE_VIEW (priv->tree_view), column);
 
@@ -341,7 +353,8 @@ get_surrounding_text_markup (const gchar  *text,
                              gboolean      case_sensitive,
                              PangoLogAttr *log_attrs,
                              gint          log_attrs_length,
-                             gint          offset)
+                             gint          offset,
+                             gint          match_length)
 {
         gint   iter;
         gchar *prec = NULL;
@@ -357,8 +370,8 @@ get_surrounding_text_markup (const gchar  *text,
         prec = sanitized_substring (text, iter, offset);
 
         iter = offset;
-        offset += g_utf8_strlen (find_text, -1);
-        if (!case_sensitive)
+        offset += match_length;
+        if (!case_sensitive || !find_text)
                 match = g_utf8_substring (text, iter, offset);
 
         iter = MIN (log_attrs_length, offset + 1);
@@ -395,10 +408,10 @@ get_page_text (EvDocument   *document,
         gchar   *text;
         gboolean success;
 
-        ev_document_doc_mutex_lock ();
+        ev_document_lock (document);
         text = ev_document_text_get_text (EV_DOCUMENT_TEXT (document), page);
         success = ev_document_text_get_text_layout (EV_DOCUMENT_TEXT (document), page, areas, n_areas);
-        ev_document_doc_mutex_unlock ();
+        ev_document_unlock (document);
 
         if (!success) {
                 g_free (text);
@@ -436,104 +449,301 @@ get_match_offset (EvRectangle *areas,
         return -1;
 }
 
-static gboolean
-process_matches_idle (EvFindSidebar *sidebar)
+/* Number of characters of a match at offset, for patterns whose matches
+ * don't have the length of the text searched */
+static gint
+get_match_length (EvRectangle *areas,
+                  guint        n_areas,
+                  EvRectangle *match,
+                  gint         offset)
 {
-        EvFindSidebarPrivate *priv = sidebar->priv;
-        GtkTreeModel         *model;
-        gint                  current_page;
-        EvDocument           *document;
+        guint i;
 
-        priv->process_matches_idle_id = 0;
+        for (i = offset + 1; i < n_areas; i++) {
+                EvRectangle *area = areas + i;
+                gdouble      x, y;
 
-        if (!ev_job_find_has_results (priv->job)) {
-                if (ev_job_is_finished (EV_JOB (priv->job)))
-                        g_clear_object (&priv->job);
-                return FALSE;
+                x = (area->x1 + area->x2) / 2;
+                y = (area->y1 + area->y2) / 2;
+                if (x < match->x1 || x > match->x2 ||
+                    y < match->y1 || y > match->y2)
+                        break;
         }
 
-        document = EV_JOB (priv->job)->document;
-        model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->tree_view));
+        return i - offset;
+}
 
-        do {
-                GList        *matches, *l;
-                EvPage       *page;
-                gint          result;
-                gchar        *page_label;
-                gchar        *page_text;
-                EvRectangle  *areas = NULL;
-                guint         n_areas;
-                PangoLogAttr *text_log_attrs;
-                gulong        text_log_attrs_length;
-                gint          offset;
-
-                current_page = priv->current_page;
-                priv->current_page = (priv->current_page + 1) % priv->job->n_pages;
+/* Snippets are built in a thread, for batches of pages with about
+ * this many results, and added to the list in order */
+#define SNIPPETS_BATCH_SIZE 256
+
+typedef struct {
+        gint         page;
+        EvRectangle *matches;
+        guint        n_matches;
+} SnippetsPage;
+
+typedef struct {
+        EvDocument *document;
+        gchar      *text;
+        gboolean    case_sensitive;
+        gboolean    is_pattern;
+        gint        start_page;
+        GArray     *pages;
+} SnippetsData;
+
+typedef struct {
+        gint   page;
+        gint   result;
+        gchar *markup;
+        gchar *page_label;
+} Snippet;
 
-                matches = priv->job->pages[current_page];
-                if (!matches)
-                        continue;
+static void
+snippets_data_free (SnippetsData *data)
+{
+        guint i;
+
+        for (i = 0; i < data->pages->len; i++) {
+                SnippetsPage *page = &g_array_index (data->pages, SnippetsPage, i);
 
-                page = ev_document_get_page (document, current_page);
-		page_label = ev_document_get_page_label (document, current_page);
-                page_text = get_page_text (document, page, &areas, &n_areas);
+                g_free (page->matches);
+        }
+        g_array_free (data->pages, TRUE);
+        g_object_unref (data->document);
+        g_free (data->text);
+        g_slice_free (SnippetsData, data);
+}
+
+static void
+snippet_free (Snippet *snippet)
+{
+        g_free (snippet->markup);
+        g_free (snippet->page_label);
+        g_slice_free (Snippet, snippet);
+}
+
+static void
+build_page_snippets (SnippetsData *data,
+                     SnippetsPage *snippets_page,
+                     GPtrArray    *snippets)
+{
+        EvDocument   *document = data->document;
+        EvPage       *page;
+        guint         result;
+        gchar        *page_label;
+        gchar        *page_text;
+        EvRectangle  *areas = NULL;
+        guint         n_areas;
+        PangoLogAttr *text_log_attrs;
+        gulong        text_log_attrs_length;
+        gint          offset;
+
+        ev_document_lock (document);
+        page = ev_document_get_page (document, snippets_page->page);
+        page_label = ev_document_get_page_label (document, snippets_page->page);
+        ev_document_unlock (document);
+
+        page_text = get_page_text (document, page, &areas, &n_areas);
+        if (!page_text) {
                 g_object_unref (page);
-                if (!page_text)
-                        continue;
+                g_free (page_label);
+                return;
+        }
 
-                text_log_attrs_length = g_utf8_strlen (page_text, -1);
-                text_log_attrs = g_new0 (PangoLogAttr, text_log_attrs_length + 1);
-                pango_get_log_attrs (page_text, -1, -1, NULL, text_log_attrs, text_log_attrs_length + 1);
+        ev_document_lock (document);
+        ev_document_text_get_text_log_attrs (EV_DOCUMENT_TEXT (document), page,
+                                             &text_log_attrs, &text_log_attrs_length);
+        ev_document_unlock (document);
+        g_object_unref (page);
 
-                if (priv->first_match_page == -1)
-                        priv->first_match_page = current_page;
+        offset = 0;
 
-                offset = 0;
+        for (result = 0; result < snippets_page->n_matches; result++) {
+                EvRectangle *match = &snippets_page->matches[result];
+                Snippet     *snippet;
+                gint         match_length;
 
-                for (l = matches, result = 0; l; l = g_list_next (l), result++) {
-                        EvRectangle *match = (EvRectangle *)l->data;
-                        gchar       *markup;
-                        GtkTreeIter  iter;
+                offset = get_match_offset (areas, n_areas, match, offset);
+                if (offset == -1) {
+                        g_warning ("No offset found for match \"%s\" at page %d after processing %u results\n",
+                                   data->text, snippets_page->page, result);
+                        break;
+                }
 
-                        offset = get_match_offset (areas, n_areas, match, offset);
-                        if (offset == -1) {
-                                g_warning ("No offset found for match \"%s\" at page %d after processing %d results\n",
-                                           priv->job->text, current_page, result);
-                                break;
-                        }
+                match_length = data->is_pattern ?
+                        get_match_length (areas, n_areas, match, offset) :
+                        g_utf8_strlen (data->text, -1);
+
+                snippet = g_slice_new (Snippet);
+                snippet->page = snippets_page->page;
+                snippet->result = result;
+                snippet->page_label = g_strdup (page_label);
+                snippet->markup = get_surrounding_text_markup (page_text,
+                                                               data->is_pattern ? NULL : data->text,
+                                                               data->case_sensitive,
+                                                               text_log_attrs,
+                                                               text_log_attrs_length,
+                                                               offset,
+                                                               match_length);
+                g_ptr_array_add (snippets, snippet);
+        }
 
-                        if (current_page >= priv->job->start_page) {
-                                gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-                        } else {
-                                gtk_list_store_insert (GTK_LIST_STORE (model), &iter,
-                                                       priv->insert_position);
-                                priv->insert_position++;
-                        }
+        g_free (page_label);
+        g_free (page_text);
+        g_free (text_log_attrs);
+        g_free (areas);
+}
 
-                        markup = get_surrounding_text_markup (page_text,
-                                                              priv->job->text,
-                                                              priv->job->case_sensitive,
-                                                              text_log_attrs,
-                                                              text_log_attrs_length,
-                                                              offset);
-
-                        gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-                                            TEXT_COLUMN, markup,
-					    PAGE_LABEL_COLUMN, page_label,
-                                            PAGE_COLUMN, current_page + 1,
-                                            RESULT_COLUMN, result,
-                                            -1);
-                        g_free (markup);
+static void
+build_snippets_thread (GTask         *task,
+                       EvFindSidebar *sidebar,
+                       SnippetsData  *data,
+                       GCancellable  *cancellable)
+{
+        GPtrArray *snippets;
+        guint      i;
+
+        snippets = g_ptr_array_new_with_free_func ((GDestroyNotify)snippet_free);
+        for (i = 0; i < data->pages->len; i++) {
+                if (g_task_return_error_if_cancelled (task)) {
+                        g_ptr_array_unref (snippets);
+                        return;
                 }
 
-                g_free (page_label);
-                g_free (page_text);
-                g_free (text_log_attrs);
-                g_free (areas);
-        } while (current_page != priv->job_current_page);
+                build_page_snippets (data, &g_array_index (data->pages, SnippetsPage, i), snippets);
+        }
+
+        g_task_return_pointer (task, snippets, (GDestroyNotify)g_ptr_array_unref);
+}
 
-        if (ev_job_is_finished (EV_JOB (priv->job)) && priv->current_page == priv->job->start_page)
+static void ev_find_sidebar_process_matches (EvFindSidebar *sidebar);
+
+static void
+ev_find_sidebar_highlight_first_match_if_done (EvFindSidebar *sidebar)
+{
+        EvFindSidebarPrivate *priv = sidebar->priv;
+
+        if (priv->n_processed == priv->job->n_pages &&
+            ev_job_is_finished (EV_JOB (priv->job)) &&
+            priv->first_match_page != -1)
                 ev_find_sidebar_highlight_first_match_of_page (sidebar, priv->first_match_page);
+}
+
+static void
+snippets_ready_cb (EvFindSidebar *sidebar,
+                   GAsyncResult  *result,
+                   gpointer       user_data)
+{
+        EvFindSidebarPrivate *priv = sidebar->priv;
+        SnippetsData         *data = g_task_get_task_data (G_TASK (result));
+        GPtrArray            *snippets;
+        GtkListStore         *model;
+        guint                 i;
+
+        /* Cancelled, a new batch may be running already */
+        snippets = g_task_propagate_pointer (G_TASK (result), NULL);
+        if (!snippets)
+                return;
+
+        g_clear_object (&priv->snippets_cancellable);
+
+        model = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (priv->tree_view)));
+        for (i = 0; i < snippets->len; i++) {
+                Snippet     *snippet = g_ptr_array_index (snippets, i);
+                GtkTreeIter  iter;
+                gint         position = -1;
+
+                /* Results of the pages before the start page go first */
+                if (snippet->page < data->start_page)
+                        position = priv->insert_position++;
+
+                gtk_list_store_insert_with_values (model, &iter, position,
+                                                   TEXT_COLUMN, snippet->markup,
+                                                   PAGE_LABEL_COLUMN, snippet->page_label,
+                                                   PAGE_COLUMN, snippet->page + 1,
+                                                   RESULT_COLUMN, snippet->result,
+                                                   -1);
+        }
+        g_ptr_array_unref (snippets);
+
+        ev_find_sidebar_process_matches (sidebar);
+}
+
+/* Starts building the snippets of the next pages searched, unless
+ * a batch is being built already */
+static void
+ev_find_sidebar_process_matches (EvFindSidebar *sidebar)
+{
+        EvFindSidebarPrivate *priv = sidebar->priv;
+        SnippetsData         *data;
+        GTask                *task;
+        guint                 n_results = 0;
+
+        if (!priv->job || priv->snippets_cancellable)
+                return;
+
+        if (!ev_job_find_has_results (priv->job)) {
+                if (ev_job_is_finished (EV_JOB (priv->job)))
+                        g_clear_object (&priv->job);
+                return;
+        }
+
+        if (priv->n_processed == priv->job->n_pages) {
+                ev_find_sidebar_highlight_first_match_if_done (sidebar);
+                return;
+        }
+
+        data = g_slice_new0 (SnippetsData);
+        data->document = g_object_ref (EV_JOB (priv->job)->document);
+        data->text = g_strdup (priv->job->text);
+        data->case_sensitive = priv->job->case_sensitive;
+        data->is_pattern = (ev_job_find_get_options (priv->job) & (EV_FIND_REGEX | EV_FIND_ANY_TERM)) != 0;
+        data->start_page = priv->job->start_page;
+        data->pages = g_array_new (FALSE, FALSE, sizeof (SnippetsPage));
+
+        while (priv->n_processed < priv->n_updated && n_results < SNIPPETS_BATCH_SIZE) {
+                gint                 current_page = priv->current_page;
+                const EvFindResults *results;
+                SnippetsPage         page;
+
+                priv->current_page = (priv->current_page + 1) % priv->job->n_pages;
+                priv->n_processed++;
+
+                results = ev_job_find_get_page_results (priv->job, current_page);
+                if (!results)
+                        continue;
+
+                if (priv->first_match_page == -1)
+                        priv->first_match_page = current_page;
+
+                /* The job may be gone by the time the thread runs */
+                page.page = current_page;
+                page.matches = g_memdup (results->areas, results->n_areas * sizeof (EvRectangle));
+                page.n_matches = results->n_areas;
+                n_results += results->n_areas;
+                g_array_append_val (data->pages, page);
+        }
+
+        if (data->pages->len == 0) {
+                snippets_data_free (data);
+                ev_find_sidebar_highlight_first_match_if_done (sidebar);
+                return;
+        }
+
+        priv->snippets_cancellable = g_cancellable_new ();
+        task = g_task_new (sidebar, priv->snippets_cancellable,
+                           (GAsyncReadyCallback)snippets_ready_cb, NULL);
+        g_task_set_task_data (task, data, (GDestroyNotify)snippets_data_free);
+        g_task_run_in_thread (task, (GTaskThreadFunc)build_snippets_thread);
+        g_object_unref (task);
+}
+
+static gboolean
+process_matches_idle (EvFindSidebar *sidebar)
+{
+        sidebar->priv->process_matches_idle_id = 0;
+        ev_find_sidebar_process_matches (sidebar);
 
         return FALSE;
 }
@@ -543,7 +753,7 @@ find_job_updated_cb (EvJobFind     *job,
                      gint           page,
                      EvFindSidebar *sidebar)
 {
-        sidebar->priv->job_current_page = page;
+        sidebar->priv->n_updated++;
 }
 
 static void
@@ -570,10 +780,11 @@ ev_find_sidebar_start (EvFindSidebar *sidebar,
         g_signal_connect_object (job, "cancelled",
                                  G_CALLBACK (find_job_cancelled_cb),
                                  sidebar, 0);
-        priv->job_current_page = -1;
         priv->first_match_page = -1;
         priv->current_page = job->start_page;
         priv->insert_position = 0;
+        priv->n_updated = 0;
+        priv->n_processed = 0;
 }
 
 void
@@ -595,7 +806,7 @@ ev_find_sidebar_restart (EvFindSidebar *sidebar,
                 if (index >= priv->job->n_pages)
                         index -= priv->job->n_pages;
 
-                if (priv->job->pages[index]) {
+                if (ev_job_find_get_page_results (priv->job, index)) {
                         first_match_page = index;
                         break;
                 }
@@ -354,17 +354,13 @@ ev_history_thaw (EvHistory *history)
 }
 
 static gint
-ev_history_get_current_page (EvHistory *history)
+ev_history_get_link_page (EvHistory *history,
+                          EvLink    *link)
 {
-        EvLink       *link;
         EvDocument   *document;
         EvLinkDest   *dest;
         EvLinkAction *action;
 
-        if (!history->priv->current)
-                return -1;
-
-        link = history->priv->current->data;
         action = ev_link_get_action (link);
         if (!action)
                 return -1;
@@ -398,6 +394,82 @@ ev_history_get_current_page (EvHistory *history)
         return -1;
 }
 
+static gint
+ev_history_get_current_page (EvHistory *history)
+{
+        if (!history->priv->current)
+                return -1;
+
+        return ev_history_get_link_page (history, history->priv->current->data);
+}
+
+static void
+ev_history_append_link_page (EvHistory *history,
+                             GArray    *pages,
+                             EvLink    *link)
+{
+        gint  page;
+        guint i;
+
+        page = ev_history_get_link_page (history, link);
+        if (page < 0)
+                return;
+
+        for (i = 0; i < pages->len; i++) {
+                if (g_array_index (pages, gint, i) == page)
+                        return;
+        }
+
+        g_array_append_val (pages, page);
+}
+
+/**
+ * ev_history_get_pages:
+ * @history: a #EvHistory
+ * @max_pages: the maximum number of pages
+ * @n_pages: (out): return location for the number of pages
+ *
+ * Returns: (transfer full) (array length=n_pages): the pages of the
+ *   history entries nearest to the current one, the current one first,
+ *   without repetitions
+ */
+gint *
+ev_history_get_pages (EvHistory *history,
+                      guint      max_pages,
+                      guint     *n_pages)
+{
+        GArray *pages;
+        GList  *back, *forward;
+
+        g_return_val_if_fail (EV_IS_HISTORY (history), NULL);
+
+        pages = g_array_sized_new (FALSE, FALSE, sizeof (gint), max_pages);
+
+        if (history->priv->current) {
+                ev_history_append_link_page (history, pages, history->priv->current->data);
+                back = history->priv->current->prev;
+                forward = history->priv->current->next;
+        } else {
+                back = forward = NULL;
+        }
+
+        /* Alternately back and forward */
+        while ((back || forward) && pages->len < max_pages) {
+                if (back) {
+                        ev_history_append_link_page (history, pages, back->data);
+                        back = back->prev;
+                }
+                if (forward && pages->len < max_pages) {
+                        ev_history_append_link_page (history, pages, forward->data);
+                        forward = forward->next;
+                }
+        }
+
+        *n_pages = pages->len;
+
+        return (gint *) g_array_free (pages, FALSE);
+}
+
 static void
 ev_history_add_link_for_page (EvHistory *history,
                               gint       page)
@@ -66,6 +66,9 @@ gboolean        ev_history_go_to_link       (EvHistory       *history,
                                              EvLink          *link);
 GList          *ev_history_get_back_list    (EvHistory       *history);
 GList          *ev_history_get_forward_list (EvHistory       *history);
+gint           *ev_history_get_pages        (EvHistory       *history,
+                                             guint            max_pages,
+                                             guint           *n_pages);
 
 void            ev_history_freeze           (EvHistory       *history);
 void            ev_history_thaw             (EvHistory       *history);
@@ -28,6 +28,7 @@ struct _EvLoadingMessage {
         GtkBox     base_instance;
 
         GtkWidget *spinner;
+        GtkWidget *progress_bar;
 };
 
 struct _EvLoadingMessageClass {
@@ -47,6 +48,11 @@ ev_loading_message_init (EvLoadingMessage *message)
         gtk_box_pack_start (GTK_BOX (message), message->spinner, FALSE, FALSE, 0);
         gtk_widget_show (message->spinner);
 
+        /* Replaces the spinner once the load reports its progress */
+        message->progress_bar = gtk_progress_bar_new ();
+        gtk_widget_set_valign (message->progress_bar, GTK_ALIGN_CENTER);
+        gtk_box_pack_start (GTK_BOX (message), message->progress_bar, FALSE, FALSE, 0);
+
         label = gtk_label_new (_("Loading…"));
         gtk_box_pack_start (GTK_BOX (message), label, FALSE, FALSE, 0);
         gtk_widget_show (label);
@@ -174,3 +180,30 @@ ev_loading_message_new (void)
         return message;
 }
 
+/**
+ * ev_loading_message_set_fraction:
+ * @message: a #EvLoadingMessage
+ * @fraction: the fraction of the document loaded, or -1 when unknown
+ *
+ * Shows a progress bar filled to @fraction instead of the spinner, or
+ * the spinner again when @fraction is negative.
+ */
+void
+ev_loading_message_set_fraction (EvLoadingMessage *message,
+                                 gdouble           fraction)
+{
+        g_return_if_fail (EV_IS_LOADING_MESSAGE (message));
+
+        if (fraction < 0) {
+                gtk_widget_hide (message->progress_bar);
+                gtk_widget_show (message->spinner);
+                gtk_spinner_start (GTK_SPINNER (message->spinner));
+                return;
+        }
+
+        gtk_spinner_stop (GTK_SPINNER (message->spinner));
+        gtk_widget_hide (message->spinner);
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (message->progress_bar),
+                                       CLAMP (fraction, 0, 1));
+        gtk_widget_show (message->progress_bar);
+}
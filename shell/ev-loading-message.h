@@ -38,6 +38,8 @@ typedef struct _EvLoadingMessageClass EvLoadingMessageClass;
 GType      ev_loading_message_get_type (void) G_GNUC_CONST;
 
 GtkWidget *ev_loading_message_new      (void);
+void       ev_loading_message_set_fraction (EvLoadingMessage *message,
+                                            gdouble           fraction);
 
 G_END_DECLS
 
@@ -29,6 +29,10 @@ struct _EvMetadata {
 
 	GFile      *file;
 	GHashTable *items;
+
+	/* Changes not written yet */
+	GFileInfo  *pending;
+	guint       flush_id;
 };
 
 struct _EvMetadataClass {
@@ -39,11 +43,39 @@ G_DEFINE_TYPE (EvMetadata, ev_metadata, G_TYPE_OBJECT)
 
 #define EV_METADATA_NAMESPACE "metadata::evince"
 
+/* Scrolling and zooming change the metadata continuously, write
+ * the changes at most once per interval */
+#define EV_METADATA_FLUSH_INTERVAL 2 /* seconds */
+
+static void
+ev_metadata_write_sync (EvMetadata *metadata,
+			GFileInfo  *info)
+{
+	GError *error = NULL;
+
+	if (!g_file_set_attributes_from_info (metadata->file, info, 0, NULL, &error)) {
+		g_warning ("%s", error->message);
+		g_error_free (error);
+	}
+}
+
 static void
 ev_metadata_finalize (GObject *object)
 {
 	EvMetadata *metadata = EV_METADATA (object);
 
+	if (metadata->flush_id > 0) {
+		g_source_remove (metadata->flush_id);
+		metadata->flush_id = 0;
+	}
+
+	/* The document is being closed, don't lose the last changes */
+	if (metadata->pending) {
+		ev_metadata_write_sync (metadata, metadata->pending);
+		g_object_unref (metadata->pending);
+		metadata->pending = NULL;
+	}
+
 	if (metadata->items) {
 		g_hash_table_destroy (metadata->items);
 		metadata->items = NULL;
@@ -138,6 +170,53 @@ ev_metadata_new (GFile *file)
 	return metadata;
 }
 
+static void
+ev_metadata_new_thread (GTask        *task,
+			GFile        *file,
+			gpointer      task_data,
+			GCancellable *cancellable)
+{
+	/* Both are blocking file system queries, slow on network mounts */
+	if (!ev_is_metadata_supported_for_file (file)) {
+		g_task_return_pointer (task, NULL, NULL);
+		return;
+	}
+
+	if (g_task_return_error_if_cancelled (task))
+		return;
+
+	g_task_return_pointer (task, ev_metadata_new (file), g_object_unref);
+}
+
+/* Reads the metadata of @file in a thread, so that opening a document
+ * doesn't wait for it */
+void
+ev_metadata_new_async (GFile               *file,
+		       GCancellable        *cancellable,
+		       GAsyncReadyCallback  callback,
+		       gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (G_IS_FILE (file));
+
+	task = g_task_new (file, cancellable, callback, user_data);
+	g_task_set_source_tag (task, ev_metadata_new_async);
+	g_task_run_in_thread (task, (GTaskThreadFunc) ev_metadata_new_thread);
+	g_object_unref (task);
+}
+
+/* Returns %NULL when the file doesn't support metadata, or with @error
+ * set when the read was cancelled */
+EvMetadata *
+ev_metadata_new_finish (GAsyncResult *result,
+			GError      **error)
+{
+	g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 gboolean
 ev_metadata_is_empty (EvMetadata *metadata)
 {
@@ -162,7 +241,7 @@ ev_metadata_get_string (EvMetadata  *metadata,
 static void
 metadata_set_callback (GObject      *file,
 		       GAsyncResult *result,
-		       EvMetadata   *metadata)
+		       gpointer      user_data)
 {
 	GError *error = NULL;
 
@@ -172,38 +251,76 @@ metadata_set_callback (GObject      *file,
 	}
 }
 
+/* Writes the changes made since the last write */
+static void
+ev_metadata_flush (EvMetadata *metadata)
+{
+	if (metadata->flush_id > 0) {
+		g_source_remove (metadata->flush_id);
+		metadata->flush_id = 0;
+	}
+
+	if (!metadata->pending)
+		return;
+
+	/* The callback doesn't use @metadata, since it can be
+	 * finalized before the write completes */
+	g_file_set_attributes_async (metadata->file,
+				     metadata->pending,
+				     0,
+				     G_PRIORITY_DEFAULT,
+				     NULL,
+				     metadata_set_callback,
+				     NULL);
+	g_object_unref (metadata->pending);
+	metadata->pending = NULL;
+}
+
+static gboolean
+ev_metadata_flush_timeout_cb (EvMetadata *metadata)
+{
+	metadata->flush_id = 0;
+	ev_metadata_flush (metadata);
+
+	return G_SOURCE_REMOVE;
+}
+
 gboolean
 ev_metadata_set_string (EvMetadata  *metadata,
 			const gchar *key,
 			const gchar *value)
 {
-	GFileInfo *info;
-	gchar     *gio_key;
+	gpointer  old_value;
+	gchar    *gio_key;
+
+	if (g_hash_table_lookup_extended (metadata->items, key, NULL, &old_value) &&
+	    g_strcmp0 (old_value, value) == 0)
+		return TRUE;
 
         g_hash_table_insert (metadata->items, g_strdup (key), g_strdup (value));
         if (!metadata->file)
                 return TRUE;
 
-	info = g_file_info_new ();
+	if (!metadata->pending)
+		metadata->pending = g_file_info_new ();
 
+	/* A later change of the same key replaces the pending one */
 	gio_key = g_strconcat (EV_METADATA_NAMESPACE"::", key, NULL);
 	if (value) {
-		g_file_info_set_attribute_string (info, gio_key, value);
+		g_file_info_set_attribute_string (metadata->pending, gio_key, value);
 	} else {
-		g_file_info_set_attribute (info, gio_key,
+		g_file_info_set_attribute (metadata->pending, gio_key,
 					   G_FILE_ATTRIBUTE_TYPE_INVALID,
 					   NULL);
 	}
 	g_free (gio_key);
 
-	g_file_set_attributes_async (metadata->file,
-				     info,
-				     0,
-				     G_PRIORITY_DEFAULT,
-				     NULL,
-				     (GAsyncReadyCallback)metadata_set_callback,
-				     metadata);
-	g_object_unref (info);
+	if (metadata->flush_id == 0) {
+		metadata->flush_id =
+			g_timeout_add_seconds (EV_METADATA_FLUSH_INTERVAL,
+					       (GSourceFunc)ev_metadata_flush_timeout_cb,
+					       metadata);
+	}
 
 	return TRUE;
 }
@@ -36,6 +36,12 @@ typedef struct _EvMetadataClass EvMetadataClass;
 
 GType       ev_metadata_get_type              (void) G_GNUC_CONST;
 EvMetadata *ev_metadata_new                   (GFile       *file);
+void        ev_metadata_new_async             (GFile               *file,
+					       GCancellable        *cancellable,
+					       GAsyncReadyCallback  callback,
+					       gpointer             user_data);
+EvMetadata *ev_metadata_new_finish            (GAsyncResult        *result,
+					       GError             **error);
 gboolean    ev_metadata_is_empty              (EvMetadata  *metadata);
 
 gboolean    ev_metadata_get_string            (EvMetadata  *metadata,
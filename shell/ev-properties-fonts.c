@@ -45,25 +45,84 @@ struct _EvPropertiesFontsClass {
 	GtkBoxClass base_class;
 };
 
+/* Fonts of the documents scanned last, by fingerprint, so that
+ * showing the properties of a document again doesn't scan it again.
+ */
+#define EV_PROPERTIES_FONTS_CACHE_SIZE 4
+
+typedef struct {
+	gchar        *fingerprint;
+	GtkTreeModel *model;
+	gchar        *summary;
+} EvFontsCacheEntry;
+
+static GQueue fonts_cache = G_QUEUE_INIT;
+
 static void
-job_fonts_finished_cb (EvJob *job, EvPropertiesFonts *properties);
+ev_fonts_cache_entry_free (EvFontsCacheEntry *entry)
+{
+	g_free (entry->fingerprint);
+	g_object_unref (entry->model);
+	g_free (entry->summary);
+	g_slice_free (EvFontsCacheEntry, entry);
+}
 
-G_DEFINE_TYPE (EvPropertiesFonts, ev_properties_fonts, GTK_TYPE_BOX)
+static EvFontsCacheEntry *
+ev_fonts_cache_lookup (const gchar *fingerprint)
+{
+	GList *l;
+
+	for (l = fonts_cache.head; l; l = g_list_next (l)) {
+		EvFontsCacheEntry *entry = l->data;
+
+		if (g_str_equal (entry->fingerprint, fingerprint))
+			return entry;
+	}
+
+	return NULL;
+}
 
 static void
-ev_properties_fonts_dispose (GObject *object)
+ev_fonts_cache_add (const gchar  *fingerprint,
+		    GtkTreeModel *model,
+		    const gchar  *summary)
 {
-	EvPropertiesFonts *properties = EV_PROPERTIES_FONTS (object);
+	EvFontsCacheEntry *entry;
+
+	if (ev_fonts_cache_lookup (fingerprint))
+		return;
+
+	entry = g_slice_new (EvFontsCacheEntry);
+	entry->fingerprint = g_strdup (fingerprint);
+	entry->model = g_object_ref (model);
+	entry->summary = g_strdup (summary);
+	g_queue_push_head (&fonts_cache, entry);
+
+	if (g_queue_get_length (&fonts_cache) > EV_PROPERTIES_FONTS_CACHE_SIZE)
+		ev_fonts_cache_entry_free (g_queue_pop_tail (&fonts_cache));
+}
+
+G_DEFINE_TYPE (EvPropertiesFonts, ev_properties_fonts, GTK_TYPE_BOX)
 
+static void
+ev_properties_fonts_cancel_job (EvPropertiesFonts *properties)
+{
 	if (properties->fonts_job) {
-		g_signal_handlers_disconnect_by_func (properties->fonts_job, 
-						      job_fonts_finished_cb, 
+		g_signal_handlers_disconnect_by_data (properties->fonts_job,
 						      properties);
 		ev_job_cancel (properties->fonts_job);
 
 		g_object_unref (properties->fonts_job);		
 		properties->fonts_job = NULL;
 	}
+}
+
+static void
+ev_properties_fonts_dispose (GObject *object)
+{
+	EvPropertiesFonts *properties = EV_PROPERTIES_FONTS (object);
+
+	ev_properties_fonts_cancel_job (properties);
 
 	G_OBJECT_CLASS (ev_properties_fonts_parent_class)->dispose (object);
 }
@@ -177,16 +236,9 @@ update_progress_label (GtkWidget *label, double progress)
 }
 
 static void
-job_fonts_finished_cb (EvJob *job, EvPropertiesFonts *properties)
+set_fonts_summary (EvPropertiesFonts *properties,
+		   const gchar       *font_summary)
 {
-	EvDocumentFonts *document_fonts = EV_DOCUMENT_FONTS (properties->document);
-	const gchar     *font_summary;
-
-	g_signal_handlers_disconnect_by_func (job, job_fonts_finished_cb, properties);
-	g_object_unref (properties->fonts_job);
-	properties->fonts_job = NULL;
-
-	font_summary = ev_document_fonts_get_fonts_summary (document_fonts);
 	if (font_summary) {
 		gtk_label_set_text (GTK_LABEL (properties->fonts_summary),
 				    font_summary);
@@ -197,32 +249,57 @@ job_fonts_finished_cb (EvJob *job, EvPropertiesFonts *properties)
 }
 
 static void
-job_fonts_updated_cb (EvJobFonts *job, gdouble progress, EvPropertiesFonts *properties)
+job_fonts_finished_cb (EvJob *job, EvPropertiesFonts *properties)
 {
-	GtkTreeModel *model;
 	EvDocumentFonts *document_fonts = EV_DOCUMENT_FONTS (properties->document);
+	const gchar     *font_summary;
+	const gchar     *fingerprint;
 
-	update_progress_label (properties->fonts_progress_label, progress);
+	g_signal_handlers_disconnect_by_func (job, job_fonts_finished_cb, properties);
+
+	font_summary = ev_document_fonts_get_fonts_summary (document_fonts);
+	set_fonts_summary (properties, font_summary);
+
+	fingerprint = ev_document_get_fingerprint (properties->document);
+	if (fingerprint && !ev_job_is_failed (job))
+		ev_fonts_cache_add (fingerprint,
+				    ev_job_fonts_get_model (EV_JOB_FONTS (job)),
+				    font_summary);
 
-	model = gtk_tree_view_get_model (GTK_TREE_VIEW (properties->fonts_treeview));
-	/* Documen lock is already held by the jop */
-	ev_document_fonts_fill_model (document_fonts, model);
+	g_object_unref (properties->fonts_job);
+	properties->fonts_job = NULL;
+}
+
+static void
+job_fonts_updated_cb (EvJobFonts *job, gdouble progress, EvPropertiesFonts *properties)
+{
+	update_progress_label (properties->fonts_progress_label, progress);
 }
 
 void
 ev_properties_fonts_set_document (EvPropertiesFonts *properties,
 				  EvDocument        *document)
 {
-	GtkTreeView *tree_view = GTK_TREE_VIEW (properties->fonts_treeview);
-	GtkListStore *list_store;
+	GtkTreeView       *tree_view = GTK_TREE_VIEW (properties->fonts_treeview);
+	EvFontsCacheEntry *entry = NULL;
+	const gchar       *fingerprint;
 
+	ev_properties_fonts_cancel_job (properties);
 	properties->document = document;
 
-	list_store = gtk_list_store_new (EV_DOCUMENT_FONTS_COLUMN_NUM_COLUMNS,
-					 G_TYPE_STRING, G_TYPE_STRING);
-	gtk_tree_view_set_model (tree_view, GTK_TREE_MODEL (list_store));
+	fingerprint = ev_document_get_fingerprint (document);
+	if (fingerprint)
+		entry = ev_fonts_cache_lookup (fingerprint);
+	if (entry) {
+		gtk_tree_view_set_model (tree_view, entry->model);
+		set_fonts_summary (properties, entry->summary);
+
+		return;
+	}
 
 	properties->fonts_job = ev_job_fonts_new (properties->document);
+	gtk_tree_view_set_model (tree_view,
+				 ev_job_fonts_get_model (EV_JOB_FONTS (properties->fonts_job)));
 	g_signal_connect (properties->fonts_job, "updated",
 			  G_CALLBACK (job_fonts_updated_cb),
 			  properties);
@@ -32,6 +32,7 @@
 #include "ev-document-model.h"
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
+#include "ev-find-index.h"
 
 #ifdef HAVE_LIBGNOME_DESKTOP
 #define GNOME_DESKTOP_USE_UNSTABLE_API
@@ -44,6 +45,7 @@ typedef enum {
         EV_RECENT_VIEW_COLUMN_SECONDARY_TEXT,
         EV_RECENT_VIEW_COLUMN_ICON,
         EV_RECENT_VIEW_COLUMN_ASYNC_DATA,
+        EV_RECENT_VIEW_COLUMN_PAGE,
         NUM_COLUMNS
 } EvRecentViewColumns;
 
@@ -54,6 +56,15 @@ struct _EvRecentViewPrivate {
         GtkTreePath      *pressed_item_tree_path;
         guint             recent_manager_changed_handler_id;
 
+        /* Documents waiting to be loaded, and the number being loaded */
+        GQueue            pending_loads;
+        guint             n_loads;
+
+        /* Pages of the recent documents matching the search text,
+         * shown instead of the documents while searching */
+        GtkListStore     *search_model;
+        GCancellable     *search_cancellable;
+
 #ifdef HAVE_LIBGNOME_DESKTOP
         GnomeDesktopThumbnailFactory *thumbnail_factory;
 #endif
@@ -61,6 +72,7 @@ struct _EvRecentViewPrivate {
 
 enum {
         ITEM_ACTIVATED,
+        HIT_ACTIVATED,
         NUM_SIGNALS
 };
 
@@ -70,6 +82,11 @@ G_DEFINE_TYPE (EvRecentView, ev_recent_view, GTK_TYPE_SCROLLED_WINDOW)
 
 #define ICON_VIEW_SIZE 128
 #define MAX_RECENT_VIEW_ITEMS 20
+/* Loading a document can be slow for remote files, don't let the recent
+ * view take all the scheduler threads.
+ */
+#define MAX_CONCURRENT_LOADS 2
+#define MAX_SEARCH_HITS 50
 
 typedef struct {
         EvRecentView        *ev_recent_view;
@@ -126,11 +143,22 @@ ev_recent_view_clear_async_data (GtkTreeModel *model,
         return FALSE;
 }
 
+static void
+ev_recent_view_drop_pending_loads (EvRecentView *ev_recent_view)
+{
+        EvRecentViewPrivate      *priv = ev_recent_view->priv;
+        GetDocumentInfoAsyncData *data;
+
+        while ((data = g_queue_pop_head (&priv->pending_loads)))
+                get_document_info_async_data_free (data);
+}
+
 static void
 ev_recent_view_clear_model (EvRecentView *ev_recent_view)
 {
         EvRecentViewPrivate *priv = ev_recent_view->priv;
 
+        ev_recent_view_drop_pending_loads (ev_recent_view);
         gtk_tree_model_foreach (GTK_TREE_MODEL (priv->model),
                                 (GtkTreeModelForeachFunc)ev_recent_view_clear_async_data,
                                 ev_recent_view);
@@ -144,6 +172,12 @@ ev_recent_view_dispose (GObject *obj)
         EvRecentView        *ev_recent_view = EV_RECENT_VIEW (obj);
         EvRecentViewPrivate *priv = ev_recent_view->priv;
 
+        if (priv->search_cancellable) {
+                g_cancellable_cancel (priv->search_cancellable);
+                g_clear_object (&priv->search_cancellable);
+        }
+        g_clear_object (&priv->search_model);
+
         if (priv->model) {
                 ev_recent_view_clear_model (ev_recent_view);
                 g_object_unref (priv->model);
@@ -210,7 +244,7 @@ on_query_tooltip_event (GtkWidget     *widget,
                                                 &model, &path, &iter))
                 return FALSE;
 
-        gtk_tree_model_get (GTK_TREE_MODEL (priv->model), &iter,
+        gtk_tree_model_get (model, &iter,
                             EV_RECENT_VIEW_COLUMN_URI, &uri,
                             -1);
 
@@ -276,17 +310,22 @@ on_icon_view_item_activated (GtkIconView  *iconview,
                              GtkTreePath  *path,
                              EvRecentView *ev_recent_view)
 {
-        EvRecentViewPrivate *priv = ev_recent_view->priv;
+        GtkTreeModel        *model = gtk_icon_view_get_model (iconview);
         GtkTreeIter          iter;
         gchar               *uri;
+        gint                 page;
 
-        if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->model), &iter, path))
+        if (!gtk_tree_model_get_iter (model, &iter, path))
                 return;
 
-        gtk_tree_model_get (GTK_TREE_MODEL (priv->model), &iter,
+        gtk_tree_model_get (model, &iter,
                             EV_RECENT_VIEW_COLUMN_URI, &uri,
+                            EV_RECENT_VIEW_COLUMN_PAGE, &page,
                             -1);
-        g_signal_emit (ev_recent_view, signals[ITEM_ACTIVATED], 0, uri);
+        if (page >= 0)
+                g_signal_emit (ev_recent_view, signals[HIT_ACTIVATED], 0, uri, page);
+        else
+                g_signal_emit (ev_recent_view, signals[ITEM_ACTIVATED], 0, uri);
         g_free (uri);
 }
 
@@ -394,6 +433,8 @@ thumbnail_job_completed_callback (EvJobThumbnail           *job,
         save_document_thumbnail_in_cache (data);
 }
 
+static void ev_recent_view_start_loads (EvRecentView *ev_recent_view);
+
 static void
 document_load_job_completed_callback (EvJobLoad                *job_load,
                                       GetDocumentInfoAsyncData *data)
@@ -401,6 +442,9 @@ document_load_job_completed_callback (EvJobLoad                *job_load,
         EvRecentViewPrivate *priv = data->ev_recent_view->priv;
         EvDocument          *document = EV_JOB (job_load)->document;
 
+        priv->n_loads--;
+        ev_recent_view_start_loads (data->ev_recent_view);
+
         if (g_cancellable_is_cancelled (data->cancellable) ||
             ev_job_is_failed (EV_JOB (job_load))) {
                 get_document_info_async_data_free (data);
@@ -428,7 +472,8 @@ document_load_job_completed_callback (EvJobLoad                *job_load,
                 g_signal_connect (data->job, "finished",
                                   G_CALLBACK (thumbnail_job_completed_callback),
                                   data);
-                ev_job_scheduler_push_job (data->job, EV_JOB_PRIORITY_HIGH);
+                ev_job_scheduler_push_job_for_client (data->job, EV_JOB_PRIORITY_HIGH,
+                                                      data->ev_recent_view);
         }
 
         if (data->needs_metadata) {
@@ -475,14 +520,77 @@ document_load_job_completed_callback (EvJobLoad                *job_load,
                 get_document_info_async_data_free (data);
 }
 
+static gboolean
+ev_recent_view_row_is_visible (EvRecentView             *ev_recent_view,
+                               GetDocumentInfoAsyncData *data)
+{
+        GtkTreePath *path, *start, *end;
+        gboolean     retval = FALSE;
+
+        path = gtk_tree_row_reference_get_path (data->row);
+        if (!path)
+                return FALSE;
+
+        if (gtk_icon_view_get_visible_range (GTK_ICON_VIEW (ev_recent_view->priv->view),
+                                             &start, &end)) {
+                retval = gtk_tree_path_compare (path, start) >= 0 &&
+                        gtk_tree_path_compare (path, end) <= 0;
+                gtk_tree_path_free (start);
+                gtk_tree_path_free (end);
+        }
+        gtk_tree_path_free (path);
+
+        return retval;
+}
+
+/* Documents shown in the view are loaded first, the others in the
+ * order they were requested.
+ */
+static void
+ev_recent_view_start_loads (EvRecentView *ev_recent_view)
+{
+        EvRecentViewPrivate *priv = ev_recent_view->priv;
+
+        while (priv->n_loads < MAX_CONCURRENT_LOADS &&
+               !g_queue_is_empty (&priv->pending_loads)) {
+                GetDocumentInfoAsyncData *data = NULL;
+                gboolean                  visible = FALSE;
+                GList                    *l;
+
+                for (l = priv->pending_loads.head; l; l = g_list_next (l)) {
+                        if (ev_recent_view_row_is_visible (ev_recent_view, l->data)) {
+                                data = l->data;
+                                visible = TRUE;
+                                g_queue_delete_link (&priv->pending_loads, l);
+                                break;
+                        }
+                }
+                if (!data)
+                        data = g_queue_pop_head (&priv->pending_loads);
+
+                /* Only the first page is needed, don't set up the page cache */
+                data->job = EV_JOB (ev_job_load_new (data->uri));
+                ev_job_load_set_load_flags (EV_JOB_LOAD (data->job),
+                                            EV_DOCUMENT_LOAD_FLAG_NO_CACHE);
+                /* Rows scrolled out of view can wait while saving power */
+                ev_job_set_background (data->job, !visible);
+                g_signal_connect (data->job, "finished",
+                                  G_CALLBACK (document_load_job_completed_callback),
+                                  data);
+                priv->n_loads++;
+                ev_job_scheduler_push_job_for_client (data->job,
+                                                      visible ? EV_JOB_PRIORITY_HIGH : EV_JOB_PRIORITY_LOW,
+                                                      ev_recent_view);
+        }
+}
+
 static void
 load_document_and_get_document_info (GetDocumentInfoAsyncData *data)
 {
-        data->job = EV_JOB (ev_job_load_new (data->uri));
-        g_signal_connect (data->job, "finished",
-                          G_CALLBACK (document_load_job_completed_callback),
-                          data);
-        ev_job_scheduler_push_job (data->job, EV_JOB_PRIORITY_HIGH);
+        EvRecentView *ev_recent_view = data->ev_recent_view;
+
+        g_queue_push_tail (&ev_recent_view->priv->pending_loads, data);
+        ev_recent_view_start_loads (ev_recent_view);
 }
 
 #ifdef HAVE_LIBGNOME_DESKTOP
@@ -736,6 +844,7 @@ ev_recent_view_refresh (EvRecentView *ev_recent_view)
         items = gtk_recent_manager_get_items (priv->recent_manager);
         items = g_list_sort (items, (GCompareFunc) compare_recent_items);
 
+        ev_recent_view_drop_pending_loads (ev_recent_view);
         gtk_list_store_clear (priv->model);
 
         for (l = items; l && l->data; l = g_list_next (l)) {
@@ -773,6 +882,7 @@ ev_recent_view_refresh (EvRecentView *ev_recent_view)
                                     EV_RECENT_VIEW_COLUMN_SECONDARY_TEXT, NULL,
                                     EV_RECENT_VIEW_COLUMN_ICON, thumbnail,
                                     EV_RECENT_VIEW_COLUMN_ASYNC_DATA, data,
+                                    EV_RECENT_VIEW_COLUMN_PAGE, -1,
                                     -1);
 
                 if (thumbnail != NULL)
@@ -858,7 +968,15 @@ ev_recent_view_init (EvRecentView *ev_recent_view)
                                           G_TYPE_STRING,
                                           G_TYPE_STRING,
                                           CAIRO_GOBJECT_TYPE_SURFACE,
-                                          G_TYPE_POINTER);
+                                          G_TYPE_POINTER,
+                                          G_TYPE_INT);
+        priv->search_model = gtk_list_store_new (NUM_COLUMNS,
+                                                 G_TYPE_STRING,
+                                                 G_TYPE_STRING,
+                                                 G_TYPE_STRING,
+                                                 CAIRO_GOBJECT_TYPE_SURFACE,
+                                                 G_TYPE_POINTER,
+                                                 G_TYPE_INT);
 
         gtk_widget_set_hexpand (GTK_WIDGET (ev_recent_view), TRUE);
         gtk_widget_set_vexpand (GTK_WIDGET (ev_recent_view), TRUE);
@@ -888,6 +1006,15 @@ ev_recent_view_class_init (EvRecentViewClass *klass)
                                 g_cclosure_marshal_generic,
                                 G_TYPE_NONE, 1,
                                 G_TYPE_STRING);
+        signals[HIT_ACTIVATED] =
+                  g_signal_new ("hit-activated",
+                                EV_TYPE_RECENT_VIEW,
+                                G_SIGNAL_RUN_LAST,
+                                0, NULL, NULL,
+                                g_cclosure_marshal_generic,
+                                G_TYPE_NONE, 2,
+                                G_TYPE_STRING,
+                                G_TYPE_INT);
 
         g_type_class_add_private (klass, sizeof (EvRecentViewPrivate));
 }
@@ -897,3 +1024,152 @@ ev_recent_view_new (void)
 {
         return GTK_WIDGET (g_object_new (EV_TYPE_RECENT_VIEW, NULL));
 }
+
+/* Fills the row of @hit with the name and the thumbnail of its document */
+static void
+ev_recent_view_add_hit (EvRecentView   *ev_recent_view,
+                        EvFindIndexHit *hit)
+{
+        EvRecentViewPrivate *priv = ev_recent_view->priv;
+        GtkTreeModel        *model = GTK_TREE_MODEL (priv->model);
+        GtkTreeIter          iter;
+        gchar               *name = NULL;
+        gchar               *secondary;
+        cairo_surface_t     *thumbnail = NULL;
+        gboolean             valid;
+
+        for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+             valid = gtk_tree_model_iter_next (model, &iter)) {
+                gchar *uri;
+
+                gtk_tree_model_get (model, &iter,
+                                    EV_RECENT_VIEW_COLUMN_URI, &uri,
+                                    -1);
+                if (g_strcmp0 (uri, hit->uri) == 0) {
+                        gtk_tree_model_get (model, &iter,
+                                            EV_RECENT_VIEW_COLUMN_PRIMARY_TEXT, &name,
+                                            EV_RECENT_VIEW_COLUMN_ICON, &thumbnail,
+                                            -1);
+                        g_free (uri);
+                        break;
+                }
+                g_free (uri);
+        }
+
+        if (!name) {
+                GtkRecentInfo *info;
+
+                info = gtk_recent_manager_lookup_item (priv->recent_manager, hit->uri, NULL);
+                if (info) {
+                        name = g_strdup (gtk_recent_info_get_display_name (info));
+                        gtk_recent_info_unref (info);
+                } else {
+                        name = g_strdup (hit->uri);
+                }
+        }
+
+        secondary = g_strdup_printf (_("Page %d: %s"), hit->page + 1, hit->snippet);
+
+        gtk_list_store_insert_with_values (priv->search_model, NULL, -1,
+                                           EV_RECENT_VIEW_COLUMN_URI, hit->uri,
+                                           EV_RECENT_VIEW_COLUMN_PRIMARY_TEXT, name,
+                                           EV_RECENT_VIEW_COLUMN_SECONDARY_TEXT, secondary,
+                                           EV_RECENT_VIEW_COLUMN_ICON, thumbnail,
+                                           EV_RECENT_VIEW_COLUMN_ASYNC_DATA, NULL,
+                                           EV_RECENT_VIEW_COLUMN_PAGE, hit->page,
+                                           -1);
+
+        if (thumbnail)
+                cairo_surface_destroy (thumbnail);
+        g_free (secondary);
+        g_free (name);
+}
+
+static void
+ev_recent_view_search_cb (GObject      *source_object,
+                          GAsyncResult *result,
+                          EvRecentView *ev_recent_view)
+{
+        EvRecentViewPrivate *priv;
+        GError              *error = NULL;
+        GList               *hits, *l;
+
+        hits = ev_find_index_search_uris_finish (result, &error);
+        if (error) {
+                g_error_free (error);
+                return;
+        }
+
+        priv = ev_recent_view->priv;
+        g_clear_object (&priv->search_cancellable);
+
+        gtk_list_store_clear (priv->search_model);
+        for (l = hits; l; l = g_list_next (l))
+                ev_recent_view_add_hit (ev_recent_view, l->data);
+        g_list_free_full (hits, (GDestroyNotify) ev_find_index_hit_free);
+
+        gtk_icon_view_set_model (GTK_ICON_VIEW (priv->view),
+                                 GTK_TREE_MODEL (priv->search_model));
+}
+
+static gchar **
+ev_recent_view_get_uris (EvRecentView *ev_recent_view)
+{
+        GList       *items, *l;
+        GPtrArray   *uris;
+        const gchar *evince = g_get_application_name ();
+
+        uris = g_ptr_array_new ();
+        items = gtk_recent_manager_get_items (ev_recent_view->priv->recent_manager);
+        for (l = items; l && l->data; l = g_list_next (l)) {
+                GtkRecentInfo *info = (GtkRecentInfo *) l->data;
+
+                if (!gtk_recent_info_has_application (info, evince))
+                        continue;
+
+                if (!gtk_recent_info_is_local (info) || !gtk_recent_info_exists (info))
+                        continue;
+
+                g_ptr_array_add (uris, g_strdup (gtk_recent_info_get_uri (info)));
+        }
+        g_list_free_full (items, (GDestroyNotify)gtk_recent_info_unref);
+        g_ptr_array_add (uris, NULL);
+
+        return (gchar **) g_ptr_array_free (uris, FALSE);
+}
+
+/* Shows the pages of the recent documents containing @text, found in
+ * their saved find indexes without loading them, or all the recent
+ * documents again if @text is %NULL or empty.
+ */
+void
+ev_recent_view_set_search_text (EvRecentView *ev_recent_view,
+                                const gchar  *text)
+{
+        EvRecentViewPrivate *priv;
+        gchar              **uris;
+
+        g_return_if_fail (EV_IS_RECENT_VIEW (ev_recent_view));
+
+        priv = ev_recent_view->priv;
+        if (priv->search_cancellable) {
+                g_cancellable_cancel (priv->search_cancellable);
+                g_clear_object (&priv->search_cancellable);
+        }
+
+        if (!text || *text == '\0') {
+                gtk_icon_view_set_model (GTK_ICON_VIEW (priv->view),
+                                         GTK_TREE_MODEL (priv->model));
+                gtk_list_store_clear (priv->search_model);
+                return;
+        }
+
+        uris = ev_recent_view_get_uris (ev_recent_view);
+        priv->search_cancellable = g_cancellable_new ();
+        ev_find_index_search_uris_async ((const gchar * const *) uris, text,
+                                         MAX_SEARCH_HITS,
+                                         priv->search_cancellable,
+                                         (GAsyncReadyCallback) ev_recent_view_search_cb,
+                                         ev_recent_view);
+        g_strfreev (uris);
+}
@@ -50,6 +50,8 @@ struct _EvRecentViewClass
 
 GType      ev_recent_view_get_type (void) G_GNUC_CONST;
 GtkWidget *ev_recent_view_new      (void);
+void       ev_recent_view_set_search_text (EvRecentView *ev_recent_view,
+                                           const gchar  *text);
 
 G_END_DECLS
 
@@ -48,16 +48,33 @@ enum {
 
 struct _EvSidebarAnnotationsPrivate {
 	EvDocument  *document;
+	EvDocumentModel *doc_model;
 
         GtkWidget   *swindow;
 	GtkWidget   *tree_view;
 
 	EvJob       *job;
 	guint        selection_changed_id;
+
+	/* Pages are loaded from start_page to the end and then from
+	 * the beginning, wrap_iter is the last page row added before
+	 * start_page */
+	GtkTreeStore *store;
+	gint          start_page;
+	GtkTreeIter   wrap_iter;
+	gboolean      has_wrap_iter;
+
+	GdkPixbuf   *text_icon;
+	GdkPixbuf   *attachment_icon;
+	GdkPixbuf   *highlight_icon;
+	GdkPixbuf   *strike_out_icon;
+	GdkPixbuf   *underline_icon;
+	GdkPixbuf   *squiggly_icon;
 };
 
 static void ev_sidebar_annotations_page_iface_init (EvSidebarPageInterface *iface);
 static void ev_sidebar_annotations_load            (EvSidebarAnnotations   *sidebar_annots);
+static void ev_sidebar_annotations_clear_job       (EvSidebarAnnotations   *sidebar_annots);
 
 static guint signals[N_SIGNALS];
 
@@ -77,9 +94,20 @@ ev_sidebar_annotations_dispose (GObject *object)
 	EvSidebarAnnotations *sidebar_annots = EV_SIDEBAR_ANNOTATIONS (object);
 	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
+	ev_sidebar_annotations_clear_job (sidebar_annots);
+	g_clear_object (&priv->store);
+
+	g_clear_object (&priv->text_icon);
+	g_clear_object (&priv->attachment_icon);
+	g_clear_object (&priv->highlight_icon);
+	g_clear_object (&priv->strike_out_icon);
+	g_clear_object (&priv->underline_icon);
+	g_clear_object (&priv->squiggly_icon);
+
 	if (priv->document) {
 		g_object_unref (priv->document);
 		priv->document = NULL;
+		priv->doc_model = NULL;
 	}
 
 	G_OBJECT_CLASS (ev_sidebar_annotations_parent_class)->dispose (object);
@@ -276,36 +304,78 @@ sidebar_tree_button_press_cb (GtkTreeView    *view,
         return FALSE;
 }
 
-static void
-job_finished_callback (EvJobAnnots          *job,
-		       EvSidebarAnnotations *sidebar_annots)
+static GdkPixbuf *
+ev_sidebar_annotations_get_icon (EvSidebarAnnotations *sidebar_annots,
+				 GdkPixbuf           **icon,
+				 const gchar          *stock_id)
 {
-	EvSidebarAnnotationsPrivate *priv;
-	GtkTreeStore *model;
-	GtkTreeSelection *selection;
-	GList *l;
-	GdkPixbuf *text_icon = NULL;
-	GdkPixbuf *attachment_icon = NULL;
-        GdkPixbuf *highlight_icon = NULL;
-        GdkPixbuf *strike_out_icon = NULL;
-        GdkPixbuf *underline_icon = NULL;
-        GdkPixbuf *squiggly_icon = NULL;
+	if (!*icon) {
+		*icon = gtk_widget_render_icon_pixbuf (sidebar_annots->priv->tree_view,
+						       stock_id,
+						       GTK_ICON_SIZE_BUTTON);
+	}
 
-	priv = sidebar_annots->priv;
+	return *icon;
+}
 
-	if (!job->annots) {
-		GtkTreeModel *list;
+static GdkPixbuf *
+ev_sidebar_annotations_get_annot_icon (EvSidebarAnnotations *sidebar_annots,
+				       EvAnnotation         *annot)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
-		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
-		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
-		g_object_unref (list);
+	if (EV_IS_ANNOTATION_TEXT (annot)) {
+		/* FIXME: use a better icon than EDIT */
+		return ev_sidebar_annotations_get_icon (sidebar_annots, &priv->text_icon,
+							GTK_STOCK_EDIT);
+	} else if (EV_IS_ANNOTATION_ATTACHMENT (annot)) {
+		return ev_sidebar_annotations_get_icon (sidebar_annots, &priv->attachment_icon,
+							EV_STOCK_ATTACHMENT);
+	} else if (EV_IS_ANNOTATION_TEXT_MARKUP (annot)) {
+		switch (ev_annotation_text_markup_get_markup_type (EV_ANNOTATION_TEXT_MARKUP (annot))) {
+		case EV_ANNOTATION_TEXT_MARKUP_HIGHLIGHT:
+			/* FIXME: use better icon than select all */
+			return ev_sidebar_annotations_get_icon (sidebar_annots, &priv->highlight_icon,
+								GTK_STOCK_SELECT_ALL);
+		case EV_ANNOTATION_TEXT_MARKUP_STRIKE_OUT:
+			return ev_sidebar_annotations_get_icon (sidebar_annots, &priv->strike_out_icon,
+								GTK_STOCK_STRIKETHROUGH);
+		case EV_ANNOTATION_TEXT_MARKUP_UNDERLINE:
+			return ev_sidebar_annotations_get_icon (sidebar_annots, &priv->underline_icon,
+								GTK_STOCK_UNDERLINE);
+		case EV_ANNOTATION_TEXT_MARKUP_SQUIGGLY:
+			return ev_sidebar_annotations_get_icon (sidebar_annots, &priv->squiggly_icon,
+								GTK_STOCK_UNDERLINE);
+		}
+	}
 
-		g_object_unref (job);
-		priv->job = NULL;
+	return NULL;
+}
 
-		return;
+static gboolean
+mapping_list_has_markup_annots (EvMappingList *mapping_list)
+{
+	GList *l;
+
+	for (l = ev_mapping_list_get_list (mapping_list); l; l = g_list_next (l)) {
+		if (EV_IS_ANNOTATION_MARKUP (((EvMapping *)(l->data))->data))
+			return TRUE;
 	}
 
+	return FALSE;
+}
+
+/* The rows are added as pages arrive, the first ones replace
+ * the loading message */
+static void
+ev_sidebar_annotations_ensure_store (EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+	GtkTreeSelection *selection;
+
+	if (priv->store)
+		return;
+
 	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
 	gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
 	if (priv->selection_changed_id == 0) {
@@ -313,140 +383,121 @@ job_finished_callback (EvJobAnnots          *job,
 			g_signal_connect (selection, "changed",
 					  G_CALLBACK (selection_changed_cb),
 					  sidebar_annots);
+		g_signal_connect (priv->tree_view, "button-press-event",
+				  G_CALLBACK (sidebar_tree_button_press_cb),
+				  sidebar_annots);
 	}
-    g_signal_connect (priv->tree_view, "button-press-event",
-                      G_CALLBACK (sidebar_tree_button_press_cb),
-                      sidebar_annots);
-
-
-	model = gtk_tree_store_new (N_COLUMNS,
-				    G_TYPE_STRING,
-				    GDK_TYPE_PIXBUF,
-				    G_TYPE_POINTER);
-
-	for (l = job->annots; l; l = g_list_next (l)) {
-		EvMappingList *mapping_list;
-		GList         *ll;
-		gchar         *page_label;
-		GtkTreeIter    iter;
-		gboolean       found = FALSE;
-
-		mapping_list = (EvMappingList *)l->data;
-		page_label = g_strdup_printf (_("Page %d"),
-					      ev_mapping_list_get_page (mapping_list) + 1);
-		gtk_tree_store_append (model, &iter, NULL);
-		gtk_tree_store_set (model, &iter,
-				    COLUMN_MARKUP, page_label,
-				    -1);
-		g_free (page_label);
-
-		for (ll = ev_mapping_list_get_list (mapping_list); ll; ll = g_list_next (ll)) {
-			EvAnnotation *annot;
-			const gchar  *label;
-			const gchar  *modified;
-			gchar        *markup;
-			GtkTreeIter   child_iter;
-			GdkPixbuf    *pixbuf = NULL;
-
-			annot = ((EvMapping *)(ll->data))->data;
-			if (!EV_IS_ANNOTATION_MARKUP (annot))
-				continue;
-
-			label = ev_annotation_markup_get_label (EV_ANNOTATION_MARKUP (annot));
-			modified = ev_annotation_get_modified (annot);
-			if (modified) {
-				markup = g_strdup_printf ("<span weight=\"bold\">%s</span>\n%s",
-							  label, modified);
-			} else {
-				markup = g_strdup_printf ("<span weight=\"bold\">%s</span>", label);
-			}
-
-			if (EV_IS_ANNOTATION_TEXT (annot)) {
-				if (!text_icon) {
-					/* FIXME: use a better icon than EDIT */
-					text_icon = gtk_widget_render_icon_pixbuf (priv->tree_view,
-                                                                                   GTK_STOCK_EDIT,
-                                                                                   GTK_ICON_SIZE_BUTTON);
-				}
-				pixbuf = text_icon;
-			} else if (EV_IS_ANNOTATION_ATTACHMENT (annot)) {
-				if (!attachment_icon) {
-					attachment_icon = gtk_widget_render_icon_pixbuf (priv->tree_view,
-                                                                                         EV_STOCK_ATTACHMENT,
-                                                                                         GTK_ICON_SIZE_BUTTON);
-				}
-				pixbuf = attachment_icon;
-			} else if (EV_IS_ANNOTATION_TEXT_MARKUP (annot)) {
-                                switch (ev_annotation_text_markup_get_markup_type (EV_ANNOTATION_TEXT_MARKUP (annot))) {
-                                case EV_ANNOTATION_TEXT_MARKUP_HIGHLIGHT:
-                                        if (!highlight_icon) {
-                                                /* FIXME: use better icon than select all */
-                                                highlight_icon = gtk_widget_render_icon_pixbuf (priv->tree_view,
-                                                                                                GTK_STOCK_SELECT_ALL,
-                                                                                                GTK_ICON_SIZE_BUTTON);
-                                        }
-                                        pixbuf = highlight_icon;
-
-                                        break;
-                                case EV_ANNOTATION_TEXT_MARKUP_STRIKE_OUT:
-                                        if (!strike_out_icon) {
-                                                strike_out_icon = gtk_widget_render_icon_pixbuf (priv->tree_view,
-                                                                                                 GTK_STOCK_STRIKETHROUGH,
-                                                                                                 GTK_ICON_SIZE_BUTTON);
-                                        }
-                                        pixbuf = strike_out_icon;
-                                        break;
-                                case EV_ANNOTATION_TEXT_MARKUP_UNDERLINE:
-                                        if (!underline_icon) {
-                                                underline_icon = gtk_widget_render_icon_pixbuf (priv->tree_view,
-                                                                                                GTK_STOCK_UNDERLINE,
-                                                                                                GTK_ICON_SIZE_BUTTON);
-                                        }
-                                        pixbuf = underline_icon;
-                                        break;
-                                case EV_ANNOTATION_TEXT_MARKUP_SQUIGGLY:
-                                        if (!squiggly_icon) {
-                                                squiggly_icon = gtk_widget_render_icon_pixbuf (priv->tree_view,
-                                                                                               GTK_STOCK_UNDERLINE,
-                                                                                               GTK_ICON_SIZE_BUTTON);
-                                        }
-                                        pixbuf = squiggly_icon;
-                                        break;
-                                }
-                        }
-
-			gtk_tree_store_append (model, &child_iter, &iter);
-			gtk_tree_store_set (model, &child_iter,
-					    COLUMN_MARKUP, markup,
-					    COLUMN_ICON, pixbuf,
-					    COLUMN_ANNOT_MAPPING, ll->data,
-					    -1);
-			g_free (markup);
-			found = TRUE;
+
+	priv->store = gtk_tree_store_new (N_COLUMNS,
+					  G_TYPE_STRING,
+					  GDK_TYPE_PIXBUF,
+					  G_TYPE_POINTER);
+	priv->has_wrap_iter = FALSE;
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
+				 GTK_TREE_MODEL (priv->store));
+}
+
+static void
+job_annots_ready_callback (EvJobAnnots          *job,
+			   EvMappingList        *mapping_list,
+			   EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+	GList       *l;
+	gchar       *page_label;
+	GtkTreeIter  iter;
+	gint         page;
+
+	if (!mapping_list_has_markup_annots (mapping_list))
+		return;
+
+	ev_sidebar_annotations_ensure_store (sidebar_annots);
+
+	/* Keep the rows in page order */
+	page = ev_mapping_list_get_page (mapping_list);
+	if (page >= priv->start_page) {
+		gtk_tree_store_append (priv->store, &iter, NULL);
+	} else {
+		if (priv->has_wrap_iter)
+			gtk_tree_store_insert_after (priv->store, &iter, NULL, &priv->wrap_iter);
+		else
+			gtk_tree_store_prepend (priv->store, &iter, NULL);
+		priv->wrap_iter = iter;
+		priv->has_wrap_iter = TRUE;
+	}
+
+	page_label = g_strdup_printf (_("Page %d"), page + 1);
+	gtk_tree_store_set (priv->store, &iter,
+			    COLUMN_MARKUP, page_label,
+			    -1);
+	g_free (page_label);
+
+	for (l = ev_mapping_list_get_list (mapping_list); l; l = g_list_next (l)) {
+		EvAnnotation *annot;
+		const gchar  *label;
+		const gchar  *modified;
+		gchar        *markup;
+		GtkTreeIter   child_iter;
+
+		annot = ((EvMapping *)(l->data))->data;
+		if (!EV_IS_ANNOTATION_MARKUP (annot))
+			continue;
+
+		label = ev_annotation_markup_get_label (EV_ANNOTATION_MARKUP (annot));
+		modified = ev_annotation_get_modified (annot);
+		if (modified) {
+			markup = g_strdup_printf ("<span weight=\"bold\">%s</span>\n%s",
+						  label, modified);
+		} else {
+			markup = g_strdup_printf ("<span weight=\"bold\">%s</span>", label);
 		}
 
-		if (!found)
-			gtk_tree_store_remove (model, &iter);
+		gtk_tree_store_append (priv->store, &child_iter, &iter);
+		gtk_tree_store_set (priv->store, &child_iter,
+				    COLUMN_MARKUP, markup,
+				    COLUMN_ICON, ev_sidebar_annotations_get_annot_icon (sidebar_annots, annot),
+				    COLUMN_ANNOT_MAPPING, l->data,
+				    -1);
+		g_free (markup);
 	}
+}
 
-	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
-				 GTK_TREE_MODEL (model));
-	g_object_unref (model);
-
-	if (text_icon)
-		g_object_unref (text_icon);
-	if (attachment_icon)
-		g_object_unref (attachment_icon);
-        if (highlight_icon)
-                g_object_unref (highlight_icon);
-        if (strike_out_icon)
-                g_object_unref (strike_out_icon);
-        if (underline_icon)
-                g_object_unref (underline_icon);
-        if (squiggly_icon)
-                g_object_unref (squiggly_icon);
-
-	g_object_unref (job);
+static void
+job_finished_callback (EvJobAnnots          *job,
+		       EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+
+	if (!priv->store) {
+		GtkTreeModel *list;
+
+		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
+		g_object_unref (list);
+	}
+
+	ev_sidebar_annotations_clear_job (sidebar_annots);
+}
+
+static void
+ev_sidebar_annotations_clear_job (EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+
+	if (!priv->job)
+		return;
+
+	if (!ev_job_is_finished (priv->job))
+		ev_job_cancel (priv->job);
+
+	g_signal_handlers_disconnect_by_func (priv->job,
+					      job_annots_ready_callback,
+					      sidebar_annots);
+	g_signal_handlers_disconnect_by_func (priv->job,
+					      job_finished_callback,
+					      sidebar_annots);
+	g_object_unref (priv->job);
 	priv->job = NULL;
 }
 
@@ -455,14 +506,19 @@ ev_sidebar_annotations_load (EvSidebarAnnotations *sidebar_annots)
 {
 	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
-	if (priv->job) {
-		g_signal_handlers_disconnect_by_func (priv->job,
-						      job_finished_callback,
-						      sidebar_annots);
-		g_object_unref (priv->job);
-	}
+	ev_sidebar_annotations_clear_job (sidebar_annots);
+
+	/* The rows of the previous load stay until the new ones arrive */
+	g_clear_object (&priv->store);
+
+	priv->start_page = priv->doc_model ? ev_document_model_get_page (priv->doc_model) : 0;
 
 	priv->job = ev_job_annots_new (priv->document);
+	ev_job_annots_set_start_page (EV_JOB_ANNOTS (priv->job), priv->start_page);
+	priv->start_page = EV_JOB_ANNOTS (priv->job)->start_page;
+	g_signal_connect (priv->job, "annots-ready",
+			  G_CALLBACK (job_annots_ready_callback),
+			  sidebar_annots);
 	g_signal_connect (priv->job, "finished",
 			  G_CALLBACK (job_finished_callback),
 			  sidebar_annots);
@@ -493,6 +549,8 @@ static void
 ev_sidebar_annotations_set_model (EvSidebarPage   *sidebar_page,
 				  EvDocumentModel *model)
 {
+	EV_SIDEBAR_ANNOTATIONS (sidebar_page)->priv->doc_model = model;
+
 	g_signal_connect (model, "notify::document",
 			  G_CALLBACK (ev_sidebar_annotations_document_changed_cb),
 			  sidebar_page);
@@ -227,7 +227,8 @@ ev_sidebar_layers_visibility_changed (GtkCellRendererToggle *cell,
 	
 	gtk_tree_path_free (path);
 
-	g_signal_emit (ev_layers, signals[LAYERS_VISIBILITY_CHANGED], 0);
+	g_signal_emit (ev_layers, signals[LAYERS_VISIBILITY_CHANGED], 0, layer);
+	g_object_unref (layer);
 }
 
 static GtkTreeView *
@@ -319,8 +320,8 @@ ev_sidebar_layers_class_init (EvSidebarLayersClass *ev_layers_class)
 			      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
 			      G_STRUCT_OFFSET (EvSidebarLayersClass, layers_visibility_changed),
 			      NULL, NULL,
-			      g_cclosure_marshal_VOID__VOID,
-			      G_TYPE_NONE, 0, G_TYPE_NONE);
+			      g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, EV_TYPE_LAYER);
 }
 
 GtkWidget *
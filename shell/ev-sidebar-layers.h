@@ -24,6 +24,8 @@
 #include <gtk/gtk.h>
 #include <glib-object.h>
 
+#include "ev-layer.h"
+
 G_BEGIN_DECLS
 
 typedef struct _EvSidebarLayers        EvSidebarLayers;
@@ -47,7 +49,8 @@ struct _EvSidebarLayersClass {
 	GtkBoxClass base_class;
 
 	/* Signals */
-	void (* layers_visibility_changed) (EvSidebarLayers *ev_layers);
+	void (* layers_visibility_changed) (EvSidebarLayers *ev_layers,
+					    EvLayer         *layer);
 };
 
 GType      ev_sidebar_layers_get_type            (void) G_GNUC_CONST;
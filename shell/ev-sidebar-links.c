@@ -48,9 +48,17 @@ struct _EvSidebarLinksPrivate {
 	EvDocument *document;
 	EvDocumentModel *doc_model;
 
-	GTree *page_link_tree;
+	/* The first link to every page with links, sorted by page */
+	GArray *page_links;
+	/* Index in page_links of the row last selected for a page */
+	gint current_link;
 };
 
+typedef struct {
+	gint         page;
+	GtkTreePath *path;
+} EvSidebarPageLink;
+
 enum {
 	PROP_0,
 	PROP_MODEL,
@@ -73,6 +81,10 @@ static void ev_sidebar_links_set_links_model            (EvSidebarLinks *links,
 							 GtkTreeModel   *model);
 static void job_finished_callback 			(EvJobLinks     *job,
 				    		         EvSidebarLinks *sidebar_links);
+static gboolean test_expand_row_cb                      (GtkTreeView    *tree_view,
+							 GtkTreeIter    *iter,
+							 GtkTreePath    *path,
+							 EvSidebarLinks *sidebar_links);
 static void ev_sidebar_links_set_current_page           (EvSidebarLinks *sidebar_links,
 							 gint            current_page);
 static void ev_sidebar_links_page_iface_init 		(EvSidebarPageInterface *iface);
@@ -154,9 +166,9 @@ ev_sidebar_links_dispose (GObject *object)
 		sidebar->priv->model = NULL;
 	}
 
-	if (sidebar->priv->page_link_tree) {
-		g_tree_unref (sidebar->priv->page_link_tree);
-		sidebar->priv->page_link_tree = NULL;
+	if (sidebar->priv->page_links) {
+		g_array_unref (sidebar->priv->page_links);
+		sidebar->priv->page_links = NULL;
 	}
 
 	if (sidebar->priv->document) {
@@ -178,6 +190,7 @@ ev_sidebar_links_map (GtkWidget *widget)
 	GTK_WIDGET_CLASS (ev_sidebar_links_parent_class)->map (widget);
 
 	if (links->priv->model) {
+		links->priv->current_link = -1;
 		ev_sidebar_links_set_current_page (links,
 						   ev_document_model_get_page (links->priv->doc_model));
 	}
@@ -240,6 +253,9 @@ selection_changed_callback (GtkTreeSelection   *selection,
 		if (link == NULL)
 			return;
 
+		/* Select the link of the page again on the next page change */
+		ev_sidebar_links->priv->current_link = -1;
+
 		g_signal_handler_block (ev_sidebar_links->priv->doc_model,
 					ev_sidebar_links->priv->page_changed_id);
 		g_signal_emit (ev_sidebar_links, signals[LINK_ACTIVATED], 0, link);
@@ -454,12 +470,17 @@ ev_sidebar_links_construct (EvSidebarLinks *ev_sidebar_links)
 			  "popup_menu",
 			  G_CALLBACK (popup_menu_cb),
 			  ev_sidebar_links);
+	g_signal_connect (priv->tree_view,
+			  "test-expand-row",
+			  G_CALLBACK (test_expand_row_cb),
+			  ev_sidebar_links);
 }
 
 static void
 ev_sidebar_links_init (EvSidebarLinks *ev_sidebar_links)
 {
 	ev_sidebar_links->priv = EV_SIDEBAR_LINKS_GET_PRIVATE (ev_sidebar_links);
+	ev_sidebar_links->priv->current_link = -1;
 
 	ev_sidebar_links_construct (ev_sidebar_links);
 }
@@ -478,45 +499,67 @@ ev_sidebar_links_new (void)
 	return ev_sidebar_links;
 }
 
-typedef struct EvSidebarLinkPageSearch {
-	gint page;
-	gint best_existing;
-} EvSidebarLinkPageSearch;
-
-static gint
-page_link_tree_search_best_page (gpointer page_ptr, EvSidebarLinkPageSearch* data)
+/* Binary search of the position of @page in @page_links, the position
+ * it would be inserted at if it's not there */
+static guint
+page_links_find (GArray   *page_links,
+		 gint      page,
+		 gboolean *found)
 {
-	gint page = GPOINTER_TO_INT (page_ptr);
+	guint low = 0, high = page_links->len;
+
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+		gint  mid_page = g_array_index (page_links, EvSidebarPageLink, mid).page;
 
-	if (page <= data->page && page > data->best_existing)
-		data->best_existing = page;
+		if (mid_page == page) {
+			*found = TRUE;
+			return mid;
+		}
+
+		if (mid_page < page)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-	return data->page - page;
+	*found = FALSE;
+
+	return low;
 }
 
 static void
 ev_sidebar_links_set_current_page (EvSidebarLinks *sidebar_links,
 				   gint            current_page)
 {
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
 	GtkTreeSelection *selection;
 	GtkTreePath *path;
-	EvSidebarLinkPageSearch search_data;
+	gboolean found;
+	guint index;
 
 	/* Widget is not currently visible */
 	if (!gtk_widget_is_visible (GTK_WIDGET (sidebar_links)))
 		return;
 
-	search_data.page = current_page;
-	search_data.best_existing = G_MININT;
+	if (!priv->page_links)
+		return;
 
-	path = g_tree_search (sidebar_links->priv->page_link_tree, (GCompareFunc) page_link_tree_search_best_page, &search_data);
-	/* No direct hit, try a lookup on the best match. */
-	if (!path)
-		path = g_tree_lookup (sidebar_links->priv->page_link_tree, GINT_TO_POINTER (search_data.best_existing));
+	/* The link of the page, or of the closest page before it */
+	index = page_links_find (priv->page_links, current_page, &found);
+	if (!found) {
+		/* No link before the page, give up. */
+		if (index == 0)
+			return;
+		index--;
+	}
 
-	/* Still no hit, give up. */
-	if (!path)
+	/* The row is already selected */
+	if ((gint) index == priv->current_link)
 		return;
+	priv->current_link = index;
+
+	path = g_array_index (priv->page_links, EvSidebarPageLink, index).path;
 
 	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (sidebar_links->priv->tree_view));
 
@@ -578,23 +621,30 @@ expand_open_links (GtkTreeView *tree_view, GtkTreeModel *model, GtkTreeIter *par
 }
 
 
+static void
+page_link_clear (EvSidebarPageLink *page_link)
+{
+	gtk_tree_path_free (page_link->path);
+}
+
 static gint
-page_link_tree_sort (gconstpointer a, gconstpointer b, void *data)
+page_link_compare (const EvSidebarPageLink *a,
+		   const EvSidebarPageLink *b)
 {
-	return GPOINTER_TO_INT (a) - GPOINTER_TO_INT (b);
+	return a->page - b->page;
 }
 
 static gboolean
-update_page_link_tree_foreach (GtkTreeModel *model,
-			       GtkTreePath  *path,
-			       GtkTreeIter  *iter,
-			       gpointer      data)
+collect_page_links_foreach (GtkTreeModel *model,
+			    GtkTreePath  *path,
+			    GtkTreeIter  *iter,
+			    gpointer      data)
 {
 	EvSidebarLinks *sidebar_links = data;
 	EvSidebarLinksPrivate *priv = sidebar_links->priv;
 	EvDocumentLinks *document_links = EV_DOCUMENT_LINKS (priv->document);
+	EvSidebarPageLink page_link;
 	EvLink *link;
-	int page;
 
 	gtk_tree_model_get (model, iter,
 			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
@@ -603,12 +653,139 @@ update_page_link_tree_foreach (GtkTreeModel *model,
 	if (!link)
 		return FALSE;
 
-	page = ev_document_links_get_link_page (document_links, link);
+	page_link.page = ev_document_links_get_link_page (document_links, link);
+	page_link.path = gtk_tree_path_copy (path);
+	g_array_append_val (priv->page_links, page_link);
+	g_object_unref (link);
+
+	return FALSE;
+}
+
+/* Builds the page index of the whole outline at once: the links are
+ * collected in outline order, sorted by page with a stable sort, and
+ * only the first link of every page is kept.
+ */
+static void
+build_page_links (EvSidebarLinks *sidebar_links,
+		  GtkTreeModel   *model)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+	guint i, n_kept = 0;
+
+	if (priv->page_links)
+		g_array_unref (priv->page_links);
+	priv->page_links = g_array_new (FALSE, FALSE, sizeof (EvSidebarPageLink));
+	priv->current_link = -1;
+
+	gtk_tree_model_foreach (model, collect_page_links_foreach, sidebar_links);
+
+	g_array_sort (priv->page_links, (GCompareFunc) page_link_compare);
+
+	for (i = 0; i < priv->page_links->len; i++) {
+		EvSidebarPageLink *page_link = &g_array_index (priv->page_links, EvSidebarPageLink, i);
+
+		if (n_kept > 0 &&
+		    g_array_index (priv->page_links, EvSidebarPageLink, n_kept - 1).page == page_link->page) {
+			page_link_clear (page_link);
+			continue;
+		}
+
+		g_array_index (priv->page_links, EvSidebarPageLink, n_kept++) = *page_link;
+	}
+	g_array_set_size (priv->page_links, n_kept);
+	g_array_set_clear_func (priv->page_links, (GDestroyNotify) page_link_clear);
+}
+
+/* Adds the link of a row loaded after the index was built */
+static void
+add_page_link (GtkTreeModel   *model,
+	       GtkTreePath    *path,
+	       GtkTreeIter    *iter,
+	       EvSidebarLinks *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+	EvDocumentLinks *document_links = EV_DOCUMENT_LINKS (priv->document);
+	EvSidebarPageLink page_link;
+	EvLink *link;
+	gboolean found;
+	guint index;
+
+	gtk_tree_model_get (model, iter,
+			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+			    -1);
+
+	if (!link)
+		return;
+
+	page_link.page = ev_document_links_get_link_page (document_links, link);
 	g_object_unref (link);
 
 	/* Only save the first link we find per page. */
-	if (!g_tree_lookup (priv->page_link_tree, GINT_TO_POINTER (page)))
-		g_tree_insert (priv->page_link_tree, GINT_TO_POINTER (page), gtk_tree_path_copy (path));
+	index = page_links_find (priv->page_links, page_link.page, &found);
+	if (found)
+		return;
+
+	page_link.path = gtk_tree_path_copy (path);
+	g_array_insert_val (priv->page_links, index, page_link);
+	if (priv->current_link >= (gint) index)
+		priv->current_link++;
+}
+
+/* Fills the page labels and adds the pages of the children loaded */
+static void
+update_loaded_children (EvSidebarLinks *sidebar_links,
+			GtkTreeModel   *model,
+			GtkTreeIter    *parent)
+{
+	EvDocumentLinks *document_links = EV_DOCUMENT_LINKS (sidebar_links->priv->document);
+	GtkTreeIter      iter;
+
+	if (!gtk_tree_model_iter_children (model, &iter, parent))
+		return;
+
+	do {
+		GtkTreePath *path;
+		EvLink      *link;
+		gchar       *page_label;
+
+		gtk_tree_model_get (model, &iter,
+				    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+				    -1);
+		if (!link)
+			continue;
+
+		page_label = ev_document_links_get_link_page_label (document_links, link);
+		if (page_label) {
+			gtk_tree_store_set (GTK_TREE_STORE (model), &iter,
+					    EV_DOCUMENT_LINKS_COLUMN_PAGE_LABEL, page_label,
+					    -1);
+			g_free (page_label);
+		}
+		g_object_unref (link);
+
+		path = gtk_tree_model_get_path (model, &iter);
+		add_page_link (model, path, &iter, sidebar_links);
+		gtk_tree_path_free (path);
+
+		update_loaded_children (sidebar_links, model, &iter);
+	} while (gtk_tree_model_iter_next (model, &iter));
+}
+
+static gboolean
+test_expand_row_cb (GtkTreeView    *tree_view,
+		    GtkTreeIter    *iter,
+		    GtkTreePath    *path,
+		    EvSidebarLinks *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+
+	if (!priv->document || !priv->model)
+		return FALSE;
+
+	/* Children of closed items of large outlines are loaded on demand */
+	if (ev_document_links_load_links_children (EV_DOCUMENT_LINKS (priv->document),
+						   priv->model, iter))
+		update_loaded_children (sidebar_links, priv->model, iter);
 
 	return FALSE;
 }
@@ -626,14 +803,8 @@ ev_sidebar_links_set_links_model (EvSidebarLinks *sidebar_links,
 		g_object_unref (priv->model);
 	priv->model = g_object_ref (model);
 
-	/* Rebuild the binary search tree for finding links on pages. */
-	if (priv->page_link_tree)
-		g_tree_unref (priv->page_link_tree);
-	priv->page_link_tree = g_tree_new_full (page_link_tree_sort, NULL, NULL, (GDestroyNotify) gtk_tree_path_free);
-
-	gtk_tree_model_foreach (model,
-				update_page_link_tree_foreach,
-				sidebar_links);
+	/* Rebuild the index for finding links on pages. */
+	build_page_links (sidebar_links, model);
 
 	g_object_notify (G_OBJECT (sidebar_links), "model");
 }
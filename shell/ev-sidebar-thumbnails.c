@@ -33,10 +33,16 @@
 
 #include <cairo-gobject.h>
 
+#include "ev-cell-renderer-thumbnail.h"
+#include "ev-document-layers.h"
 #include "ev-document-misc.h"
 #include "ev-job-scheduler.h"
+#include "ev-memory-stats.h"
 #include "ev-sidebar-page.h"
 #include "ev-sidebar-thumbnails.h"
+#include "ev-surface-budget.h"
+#include "ev-thumbnail-pack.h"
+#include "ev-thumbnails-model.h"
 #include "ev-utils.h"
 #include "ev-window.h"
 
@@ -56,6 +62,7 @@ typedef struct _EvThumbsSizeCache {
 	gboolean uniform;
 	gint uniform_width;
 	gint uniform_height;
+	EvDocument *document;
 	EvThumbsSize *sizes;
 } EvThumbsSizeCache;
 
@@ -63,12 +70,16 @@ struct _EvSidebarThumbnailsPrivate {
 	GtkWidget *swindow;
 	GtkWidget *icon_view;
 	GtkWidget *tree_view;
+	GtkCellRenderer *thumbnail_renderer;
 	GtkAdjustment *vadjustment;
-	GtkListStore *list_store;
+	EvThumbnailsModel *thumbnails_model;
 	GHashTable *loading_icons;
 	EvDocument *document;
 	EvDocumentModel *model;
+	EvView *view;
 	EvThumbsSizeCache *size_cache;
+	EvThumbnailPack *pack;
+	EvJobThumbnailBatch *batch_job;
         gint width;
 
 	gint n_pages, pages_done;
@@ -76,16 +87,20 @@ struct _EvSidebarThumbnailsPrivate {
 	int rotation;
 	gboolean inverted_colors;
 
+	/* Pages rendered with layers shown or hidden by the user, their
+	 * thumbnails can't be taken from the pack or from the view */
+	GHashTable *layer_pages;
+	gboolean layers_changed;
+
 	/* Visible pages */
 	gint start_page, end_page;
 };
 
 enum {
-	COLUMN_PAGE_STRING,
-	COLUMN_SURFACE,
-	COLUMN_THUMBNAIL_SET,
-	COLUMN_JOB,
-	NUM_COLUMNS
+	COLUMN_PAGE_STRING = EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING,
+	COLUMN_SURFACE = EV_THUMBNAILS_MODEL_COLUMN_SURFACE,
+	COLUMN_THUMBNAIL_SET = EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET,
+	COLUMN_JOB = EV_THUMBNAILS_MODEL_COLUMN_JOB
 };
 
 enum {
@@ -94,16 +109,30 @@ enum {
 };
 
 static void         ev_sidebar_thumbnails_clear_model      (EvSidebarThumbnails     *sidebar);
+static void         ev_sidebar_thumbnails_row_changed      (GtkTreeModel            *model,
+							    GtkTreePath             *path,
+							    GtkTreeIter             *iter,
+							    gpointer                 data);
 static gboolean     ev_sidebar_thumbnails_support_document (EvSidebarPage           *sidebar_page,
 							    EvDocument              *document);
 static void         ev_sidebar_thumbnails_page_iface_init  (EvSidebarPageInterface  *iface);
 static const gchar* ev_sidebar_thumbnails_get_label        (EvSidebarPage           *sidebar_page);
 static void         ev_sidebar_thumbnails_set_current_page (EvSidebarThumbnails *sidebar,
 							    gint     page);
-static void         thumbnail_job_completed_callback       (EvJobThumbnail          *job,
+static void         thumbnail_ready_cb                     (EvJobThumbnailBatch     *job,
+							    gint                     page,
+							    cairo_surface_t         *surface,
 							    EvSidebarThumbnails     *sidebar_thumbnails);
+static gboolean     thumbnail_evict_cb                     (cairo_surface_t         *surface,
+							    gpointer                 user_data);
 static void         ev_sidebar_thumbnails_reload           (EvSidebarThumbnails     *sidebar_thumbnails);
 static void         adjustment_changed_cb                  (EvSidebarThumbnails     *sidebar_thumbnails);
+static void         get_size_for_page                      (EvSidebarThumbnails     *sidebar_thumbnails,
+							    gint                     page,
+							    gint                    *width_return,
+							    gint                    *height_return);
+static gboolean     ev_sidebar_thumbnails_page_has_default_layers (EvSidebarThumbnails *sidebar_thumbnails,
+								   gint                 page);
 
 G_DEFINE_TYPE_EXTENDED (EvSidebarThumbnails, 
                         ev_sidebar_thumbnails, 
@@ -134,32 +163,35 @@ get_thumbnail_size_for_page (EvDocument *document,
 	*height = MAX ((gint)(h * scale + 0.5), 1);
 }
 
-static EvThumbsSizeCache *
-ev_thumbnails_size_cache_new (EvDocument *document)
+/* Sizes of non uniform documents are computed on demand, so opening a
+ * long document doesn't query the size of every page up front.
+ */
+static void
+ev_thumbnails_size_cache_update (EvThumbsSizeCache *cache,
+				 EvDocument        *document)
 {
-	EvThumbsSizeCache *cache;
-	gint               i, n_pages;
-	EvThumbsSize      *thumb_size;
+	g_clear_pointer (&cache->sizes, g_free);
 
-	cache = g_new0 (EvThumbsSizeCache, 1);
-
-	if (ev_document_is_page_size_uniform (document)) {
-		cache->uniform = TRUE;
+	cache->uniform = ev_document_is_page_size_uniform (document);
+	if (cache->uniform) {
 		get_thumbnail_size_for_page (document, 0,
 					     &cache->uniform_width,
 					     &cache->uniform_height);
-		return cache;
+		return;
 	}
 
-	n_pages = ev_document_get_n_pages (document);
-	cache->sizes = g_new0 (EvThumbsSize, n_pages);
+	/* The cache is owned by the document, don't take a reference */
+	cache->document = document;
+	cache->sizes = g_new0 (EvThumbsSize, ev_document_get_n_pages (document));
+}
 
-	for (i = 0; i < n_pages; i++) {
-		thumb_size = &(cache->sizes[i]);
-		get_thumbnail_size_for_page (document, i,
-					     &thumb_size->width,
-					     &thumb_size->height);
-	}
+static EvThumbsSizeCache *
+ev_thumbnails_size_cache_new (EvDocument *document)
+{
+	EvThumbsSizeCache *cache;
+
+	cache = g_new0 (EvThumbsSizeCache, 1);
+	ev_thumbnails_size_cache_update (cache, document);
 
 	return cache;
 }
@@ -180,6 +212,10 @@ ev_thumbnails_size_cache_get_size (EvThumbsSizeCache *cache,
 		EvThumbsSize *thumb_size;
 
 		thumb_size = &(cache->sizes[page]);
+		if (thumb_size->width == 0)
+			get_thumbnail_size_for_page (cache->document, page,
+						     &thumb_size->width,
+						     &thumb_size->height);
 
 		w = thumb_size->width;
 		h = thumb_size->height;
@@ -238,7 +274,7 @@ ev_sidebar_thumbnails_page_is_in_visible_range (EvSidebarThumbnails *sidebar,
                 if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
                         return FALSE;
 
-                path = gtk_tree_model_get_path (GTK_TREE_MODEL (sidebar->priv->list_store), &iter);
+                path = gtk_tree_model_get_path (GTK_TREE_MODEL (sidebar->priv->thumbnails_model), &iter);
                 if (!gtk_tree_view_get_visible_range (GTK_TREE_VIEW (sidebar->priv->tree_view), &start, &end)) {
                         gtk_tree_path_free (path);
                         return FALSE;
@@ -274,17 +310,26 @@ static void
 ev_sidebar_thumbnails_dispose (GObject *object)
 {
 	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (object);
+
+	ev_surface_budget_remove_by_data (sidebar_thumbnails);
+	ev_memory_stats_unregister ("thumbnails", sidebar_thumbnails);
+
+	if (sidebar_thumbnails->priv->view) {
+		ev_view_set_thumbnail_func (sidebar_thumbnails->priv->view, NULL, NULL, NULL);
+		g_object_remove_weak_pointer (G_OBJECT (sidebar_thumbnails->priv->view),
+					      (gpointer *) &sidebar_thumbnails->priv->view);
+		sidebar_thumbnails->priv->view = NULL;
+	}
 	
 	if (sidebar_thumbnails->priv->loading_icons) {
 		g_hash_table_destroy (sidebar_thumbnails->priv->loading_icons);
 		sidebar_thumbnails->priv->loading_icons = NULL;
 	}
+
+	g_clear_pointer (&sidebar_thumbnails->priv->layer_pages, g_hash_table_destroy);
 	
-	if (sidebar_thumbnails->priv->list_store) {
+	if (sidebar_thumbnails->priv->thumbnails_model)
 		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
-		g_object_unref (sidebar_thumbnails->priv->list_store);
-		sidebar_thumbnails->priv->list_store = NULL;
-	}
 
 	G_OBJECT_CLASS (ev_sidebar_thumbnails_parent_class)->dispose (object);
 }
@@ -400,6 +445,60 @@ ev_sidebar_thumbnails_new (void)
 	return ev_sidebar_thumbnails;
 }
 
+/* The view scales the thumbnails in the pack at very low zoom levels */
+static cairo_surface_t *
+ev_sidebar_thumbnails_get_thumbnail_for_view (EvView   *view,
+					      gint      page,
+					      gint      rotation,
+					      gpointer  user_data)
+{
+	EvSidebarThumbnails        *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (user_data);
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	gint                        width, height;
+
+	if (!priv->pack || !priv->document || rotation != priv->rotation ||
+	    page < 0 || page >= ev_document_get_n_pages (priv->document) ||
+	    !ev_sidebar_thumbnails_page_has_default_layers (sidebar_thumbnails, page))
+		return NULL;
+
+	get_size_for_page (sidebar_thumbnails, page, &width, &height);
+
+	return ev_thumbnail_pack_lookup (priv->pack, page, rotation, width, height);
+}
+
+/**
+ * ev_sidebar_thumbnails_set_view:
+ * @sidebar_thumbnails: an #EvSidebarThumbnails
+ * @view: the #EvView showing the same document
+ *
+ * Pages already rendered by @view are downscaled to get their
+ * thumbnails instead of rendering them again, and @view scales the
+ * stored thumbnails when zoomed out that far.
+ */
+void
+ev_sidebar_thumbnails_set_view (EvSidebarThumbnails *sidebar_thumbnails,
+				EvView              *view)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	if (priv->view == view)
+		return;
+
+	if (priv->view) {
+		ev_view_set_thumbnail_func (priv->view, NULL, NULL, NULL);
+		g_object_remove_weak_pointer (G_OBJECT (priv->view), (gpointer *) &priv->view);
+	}
+	priv->view = view;
+	if (priv->view) {
+		g_object_add_weak_pointer (G_OBJECT (priv->view), (gpointer *) &priv->view);
+		ev_view_set_thumbnail_func (priv->view,
+					    ev_sidebar_thumbnails_get_thumbnail_for_view,
+					    sidebar_thumbnails, NULL);
+	}
+}
+
+/* Placeholders are unframed like the thumbnails, the renderer draws
+ * the frame around them */
 static cairo_surface_t *
 ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 					gint                 width,
@@ -412,18 +511,32 @@ ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 	key = g_strdup_printf ("%dx%d", width, height);
 	icon = g_hash_table_lookup (priv->loading_icons, key);
 	if (!icon) {
-		gboolean inverted_colors;
+		GtkStyleContext *context;
+		cairo_t         *cr;
                 gint device_scale = 1;
 
 #ifdef HAVE_HIDPI_SUPPORT
                 device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (sidebar_thumbnails));
 #endif
 
-		inverted_colors = ev_document_model_get_inverted_colors (priv->model);
-                icon = ev_document_misc_render_loading_thumbnail_surface (GTK_WIDGET (sidebar_thumbnails),
-                                                                          width * device_scale,
-                                                                          height * device_scale,
-                                                                          inverted_colors);
+		icon = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						   width * device_scale,
+						   height * device_scale);
+#ifdef HAVE_HIDPI_SUPPORT
+		cairo_surface_set_device_scale (icon, device_scale, device_scale);
+#endif
+
+		context = gtk_widget_get_style_context (GTK_WIDGET (sidebar_thumbnails));
+		gtk_style_context_save (context);
+		gtk_style_context_add_class (context, "page-thumbnail");
+		if (ev_document_model_get_inverted_colors (priv->model))
+			gtk_style_context_add_class (context, "inverted");
+
+		cr = cairo_create (icon);
+		gtk_render_background (context, cr, 0, 0, width, height);
+		cairo_destroy (cr);
+		gtk_style_context_restore (context);
+
 		g_hash_table_insert (priv->loading_icons, key, icon);
 	} else {
 		g_free (key);
@@ -445,13 +558,13 @@ cancel_running_jobs (EvSidebarThumbnails *sidebar_thumbnails,
 	g_assert (start_page <= end_page);
 
 	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
+	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->thumbnails_model), &iter, path);
 	     result && start_page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), start_page ++) {
-		EvJobThumbnail *job;
+	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->thumbnails_model), &iter), start_page ++) {
+		EvJobThumbnailBatch *job;
 		gboolean thumbnail_set;
 
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store),
+		gtk_tree_model_get (GTK_TREE_MODEL (priv->thumbnails_model),
 				    &iter,
 				    COLUMN_JOB, &job,
 				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
@@ -462,16 +575,13 @@ cancel_running_jobs (EvSidebarThumbnails *sidebar_thumbnails,
 			continue;
 		}
 
+		/* The job goes on with the other pages */
 		if (job) {
-			g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
-			ev_job_cancel (EV_JOB (job));
+			ev_job_thumbnail_batch_remove_pages (job, start_page, start_page);
 			g_object_unref (job);
 		}
 
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_JOB, NULL,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
+		ev_thumbnails_model_set_job (priv->thumbnails_model, start_page, NULL);
 	}
 	gtk_tree_path_free (path);
 }
@@ -502,6 +612,105 @@ get_size_for_page (EvSidebarThumbnails *sidebar_thumbnails,
         }
 }
 
+/* The thumbnail is kept unframed, the renderer draws the frame */
+static void
+ev_sidebar_thumbnails_set_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+				     gint                 page,
+				     cairo_surface_t     *thumbnail)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+        cairo_surface_t            *surface;
+#ifdef HAVE_HIDPI_SUPPORT
+        gint                        device_scale;
+
+        device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (sidebar_thumbnails));
+        cairo_surface_set_device_scale (thumbnail, device_scale, device_scale);
+#endif
+
+	/* The thumbnail may be shared with the job, it's inverted in a copy */
+	if (priv->inverted_colors) {
+		cairo_t *cr;
+
+		surface = cairo_surface_create_similar_image (thumbnail,
+							      cairo_image_surface_get_format (thumbnail),
+							      cairo_image_surface_get_width (thumbnail),
+							      cairo_image_surface_get_height (thumbnail));
+#ifdef HAVE_HIDPI_SUPPORT
+		cairo_surface_set_device_scale (surface, device_scale, device_scale);
+#endif
+		cr = cairo_create (surface);
+		cairo_set_source_surface (cr, thumbnail, 0, 0);
+		cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+		cairo_paint (cr);
+		cairo_destroy (cr);
+
+		ev_document_misc_invert_surface (surface);
+	} else {
+		surface = cairo_surface_reference (thumbnail);
+	}
+
+	ev_thumbnails_model_set_thumbnail (priv->thumbnails_model, page, surface);
+	ev_surface_budget_add (surface, thumbnail_evict_cb, sidebar_thumbnails);
+        cairo_surface_destroy (surface);
+}
+
+/* Downscales the surface of page in the view, if it's rendered. */
+static cairo_surface_t *
+ev_sidebar_thumbnails_get_view_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+					  gint                 page,
+					  gint                 width,
+					  gint                 height)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	cairo_surface_t            *source;
+	cairo_surface_t            *thumbnail;
+	cairo_t                    *cr;
+	gint                        source_width, source_height;
+	gdouble                     device_scale_x = 1, device_scale_y = 1;
+
+	if (!priv->view)
+		return NULL;
+
+	source = ev_view_get_page_surface (priv->view, page);
+	if (!source || cairo_surface_get_type (source) != CAIRO_SURFACE_TYPE_IMAGE)
+		return NULL;
+
+	source_width = cairo_image_surface_get_width (source);
+	source_height = cairo_image_surface_get_height (source);
+
+	/* Smaller than the thumbnail, or rendered with another rotation */
+	if (source_width < width || source_height < height ||
+	    ABS ((gdouble) source_width / source_height - (gdouble) width / height) > 0.05)
+		return NULL;
+
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_get_device_scale (source, &device_scale_x, &device_scale_y);
+#endif
+
+	thumbnail = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	cr = cairo_create (thumbnail);
+	cairo_scale (cr,
+		     width * device_scale_x / source_width,
+		     height * device_scale_y / source_height);
+	cairo_set_source_surface (cr, source, 0, 0);
+	/* Pixman downscales with a box filter */
+	cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	return thumbnail;
+}
+
+static gboolean
+ev_sidebar_thumbnails_page_has_default_layers (EvSidebarThumbnails *sidebar_thumbnails,
+					       gint                 page)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	return !priv->layers_changed &&
+		!(priv->layer_pages && g_hash_table_contains (priv->layer_pages, GINT_TO_POINTER (page)));
+}
+
 static void
 add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	   gint                 start_page,
@@ -512,48 +721,86 @@ add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	GtkTreeIter iter;
 	gboolean result;
 	gint page = start_page;
+	EvJob *new_job = NULL;
 
 	g_assert (start_page <= end_page);
 
 	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
+	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->thumbnails_model), &iter, path);
 	     result && page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), page ++) {
+	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->thumbnails_model), &iter), page ++) {
 		EvJob *job;
 		gboolean thumbnail_set;
 
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store), &iter,
+		gtk_tree_model_get (GTK_TREE_MODEL (priv->thumbnails_model), &iter,
 				    COLUMN_JOB, &job,
 				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
 				    -1);
 
 		if (job == NULL && !thumbnail_set) {
 			gint thumbnail_width, thumbnail_height;
+			cairo_surface_t *thumbnail = NULL;
+			gboolean default_layers;
+
 			get_size_for_page (sidebar_thumbnails, page, &thumbnail_width, &thumbnail_height);
 
-			job = ev_job_thumbnail_new_with_target_size (priv->document,
-								     page, priv->rotation,
-								     thumbnail_width, thumbnail_height);
-                        ev_job_thumbnail_set_has_frame (EV_JOB_THUMBNAIL (job), FALSE);
-                        ev_job_thumbnail_set_output_format (EV_JOB_THUMBNAIL (job), EV_JOB_THUMBNAIL_SURFACE);
-			g_object_set_data_full (G_OBJECT (job), "tree_iter",
-						gtk_tree_iter_copy (&iter),
-						(GDestroyNotify) gtk_tree_iter_free);
-			g_signal_connect (job, "finished",
-					  G_CALLBACK (thumbnail_job_completed_callback),
-					  sidebar_thumbnails);
-			gtk_list_store_set (priv->list_store, &iter,
-					    COLUMN_JOB, job,
-					    -1);
-			ev_job_scheduler_push_job (EV_JOB (job), EV_JOB_PRIORITY_HIGH);
-			
-			/* The queue and the list own a ref to the job now */
-			g_object_unref (job);
+			/* Otherwise they'd show the layers as they were */
+			default_layers = ev_sidebar_thumbnails_page_has_default_layers (sidebar_thumbnails, page);
+
+			if (priv->pack && default_layers)
+				thumbnail = ev_thumbnail_pack_lookup (priv->pack, page, priv->rotation,
+								      thumbnail_width, thumbnail_height);
+			if (!thumbnail && default_layers) {
+				thumbnail = ev_sidebar_thumbnails_get_view_thumbnail (sidebar_thumbnails, page,
+										      thumbnail_width,
+										      thumbnail_height);
+				if (thumbnail && priv->pack)
+					ev_thumbnail_pack_store (priv->pack, page, priv->rotation,
+								 thumbnail_width, thumbnail_height,
+								 thumbnail);
+			}
+			if (thumbnail) {
+				ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, page, thumbnail);
+				cairo_surface_destroy (thumbnail);
+				continue;
+			}
+
+			/* The running job takes the page unless it's done */
+			if (!priv->batch_job ||
+			    !ev_job_thumbnail_batch_add_page (priv->batch_job, page,
+							      thumbnail_width, thumbnail_height)) {
+				g_clear_object (&priv->batch_job);
+				new_job = ev_job_thumbnail_batch_new (priv->document, priv->rotation);
+				g_signal_connect (new_job, "thumbnail-ready",
+						  G_CALLBACK (thumbnail_ready_cb),
+						  sidebar_thumbnails);
+				priv->batch_job = EV_JOB_THUMBNAIL_BATCH (new_job);
+				ev_job_thumbnail_batch_add_page (priv->batch_job, page,
+								 thumbnail_width, thumbnail_height);
+			}
+
+			ev_thumbnails_model_set_job (priv->thumbnails_model, page,
+						     EV_JOB (priv->batch_job));
 		} else if (job) {
 			g_object_unref (job);
+		} else {
+			cairo_surface_t *surface;
+
+			gtk_tree_model_get (GTK_TREE_MODEL (priv->thumbnails_model), &iter,
+					    COLUMN_SURFACE, &surface,
+					    -1);
+			if (surface) {
+				ev_surface_budget_touch (surface);
+				cairo_surface_destroy (surface);
+			}
 		}
 	}
 	gtk_tree_path_free (path);
+
+	/* Pushed once it has all of its pages, so that it doesn't finish
+	 * before they are added */
+	if (new_job)
+		ev_job_scheduler_push_job_for_client (new_job, EV_JOB_PRIORITY_HIGH, sidebar_thumbnails);
 }
 
 /* This modifies start */
@@ -650,44 +897,44 @@ adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 	gtk_tree_path_free (path2);
 }
 
+static cairo_surface_t *
+ev_sidebar_thumbnails_get_page_loading_icon (gint     page,
+					     gpointer user_data)
+{
+	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (user_data);
+	gint                 width, height;
+
+	ev_thumbnails_size_cache_get_size (sidebar_thumbnails->priv->size_cache, page,
+					  sidebar_thumbnails->priv->rotation,
+					  &width, &height);
+
+	return ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails, width, height);
+}
+
+/* The model has no data by itself, a new one is used for every document,
+ * rotation or colors, instead of filling it again.
+ */
 static void
 ev_sidebar_thumbnails_fill_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter iter;
-	int i;
-	gint prev_width = -1;
-	gint prev_height = -1;
-
-	for (i = 0; i < sidebar_thumbnails->priv->n_pages; i++) {
-		gchar     *page_label;
-		gchar     *page_string;
-		cairo_surface_t *loading_icon = NULL;
-		gint       width, height;
-
-		page_label = ev_document_get_page_label (priv->document, i);
-		page_string = g_markup_printf_escaped ("<i>%s</i>", page_label);
-		ev_thumbnails_size_cache_get_size (sidebar_thumbnails->priv->size_cache, i,
-						  sidebar_thumbnails->priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
+	guint signal_id;
 
-		prev_width = width;
-		prev_height = height;
-		
-		gtk_list_store_append (priv->list_store, &iter);
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_PAGE_STRING, page_string,
-				    COLUMN_SURFACE, loading_icon,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
-		g_free (page_label);
-		g_free (page_string);
-	}
+	priv->thumbnails_model = ev_thumbnails_model_new (priv->document,
+							  ev_sidebar_thumbnails_get_page_loading_icon,
+							  sidebar_thumbnails);
+
+	signal_id = g_signal_lookup ("row-changed", GTK_TYPE_TREE_MODEL);
+	g_signal_connect (priv->thumbnails_model, "row-changed",
+			  G_CALLBACK (ev_sidebar_thumbnails_row_changed),
+			  GUINT_TO_POINTER (signal_id));
+
+	if (priv->icon_view)
+		gtk_icon_view_set_model (GTK_ICON_VIEW (priv->icon_view),
+					 GTK_TREE_MODEL (priv->thumbnails_model));
+	if (priv->tree_view)
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
+					 GTK_TREE_MODEL (priv->thumbnails_model));
 }
 
 static void
@@ -702,7 +949,7 @@ ev_sidebar_tree_selection_changed (GtkTreeSelection *selection,
 	if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
 		return;
 
-	path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->list_store),
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->thumbnails_model),
 					&iter);
 	page = gtk_tree_path_get_indices (path)[0];
 	gtk_tree_path_free (path);
@@ -743,16 +990,19 @@ ev_sidebar_init_tree_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 	GtkCellRenderer *renderer;
 
 	priv = ev_sidebar_thumbnails->priv;
-	priv->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
+	priv->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->thumbnails_model));
 
 	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
 	g_signal_connect (selection, "changed",
 			  G_CALLBACK (ev_sidebar_tree_selection_changed), ev_sidebar_thumbnails);
 	gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (priv->tree_view), FALSE);
-	renderer = g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF,
-				 "xpad", 2,
-				 "ypad", 2,
-				 NULL);
+	renderer = ev_cell_renderer_thumbnail_new (GTK_WIDGET (ev_sidebar_thumbnails));
+	g_object_set (renderer,
+		      "xpad", 2,
+		      "ypad", 2,
+		      "inverted-colors", priv->inverted_colors,
+		      NULL);
+	priv->thumbnail_renderer = renderer;
 	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->tree_view), -1,
 						     NULL, renderer,
 						     "surface", 1,
@@ -772,12 +1022,15 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 
 	priv = ev_sidebar_thumbnails->priv;
 
-	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
+	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->thumbnails_model));
 
-        renderer = g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF,
-                                 "xalign", 0.5,
-                                 "yalign", 1.0,
-                                 NULL);
+        renderer = ev_cell_renderer_thumbnail_new (GTK_WIDGET (ev_sidebar_thumbnails));
+        g_object_set (renderer,
+                      "xalign", 0.5,
+                      "yalign", 1.0,
+                      "inverted-colors", priv->inverted_colors,
+                      NULL);
+        priv->thumbnail_renderer = renderer;
         gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (priv->icon_view), renderer, FALSE);
         gtk_cell_layout_set_attributes (GTK_CELL_LAYOUT (priv->icon_view),
                                         renderer, "surface", 1, NULL);
@@ -832,25 +1085,52 @@ ev_sidebar_thumbnails_row_changed (GtkTreeModel *model,
 	g_signal_stop_emission (model, signal_id, 0);
 }
 
+static gboolean
+add_thumbnail_memory_stats (GtkTreeModel *model,
+			    GtkTreePath  *path,
+			    GtkTreeIter  *iter,
+			    gpointer      data)
+{
+	guint64         *stats = data;
+	cairo_surface_t *surface;
+
+	gtk_tree_model_get (model, iter, COLUMN_SURFACE, &surface, -1);
+	if (!surface)
+		return FALSE;
+
+	if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE)
+		stats[0] += (guint64) cairo_image_surface_get_stride (surface) *
+			cairo_image_surface_get_height (surface);
+	stats[1]++;
+	cairo_surface_destroy (surface);
+
+	return FALSE;
+}
+
+static void
+get_memory_stats (gpointer  user_data,
+		  guint64  *bytes,
+		  guint    *n_entries)
+{
+	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (user_data);
+	guint64              stats[2] = { 0, 0 };
+
+	if (!sidebar_thumbnails->priv->thumbnails_model)
+		return;
+
+	gtk_tree_model_foreach (GTK_TREE_MODEL (sidebar_thumbnails->priv->thumbnails_model),
+				add_thumbnail_memory_stats, stats);
+	*bytes += stats[0];
+	*n_entries += stats[1];
+}
+
 static void
 ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv;
-	guint signal_id;
 
 	priv = ev_sidebar_thumbnails->priv = EV_SIDEBAR_THUMBNAILS_GET_PRIVATE (ev_sidebar_thumbnails);
 
-	priv->list_store = gtk_list_store_new (NUM_COLUMNS,
-					       G_TYPE_STRING,
-					       CAIRO_GOBJECT_TYPE_SURFACE,
-					       G_TYPE_BOOLEAN,
-					       EV_TYPE_JOB_THUMBNAIL);
-
-	signal_id = g_signal_lookup ("row-changed", GTK_TYPE_TREE_MODEL);
-	g_signal_connect (GTK_TREE_MODEL (priv->list_store), "row-changed",
-			  G_CALLBACK (ev_sidebar_thumbnails_row_changed),
-			  GUINT_TO_POINTER (signal_id));
-
 	priv->swindow = gtk_scrolled_window_new (NULL, NULL);
 
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (priv->swindow),
@@ -868,6 +1148,9 @@ ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 	g_signal_connect (ev_sidebar_thumbnails, "notify::scale-factor",
 			  G_CALLBACK (ev_sidebar_thumbnails_device_scale_factor_changed_cb), NULL);
 
+	ev_memory_stats_register ("thumbnails", get_memory_stats,
+				  ev_sidebar_thumbnails);
+
 	/* Put it all together */
 	gtk_widget_show_all (priv->swindow);
 }
@@ -918,6 +1201,21 @@ refresh (EvSidebarThumbnails *sidebar_thumbnails)
 	return FALSE;
 }
 
+/* The frames are drawn again with the current colors and scale */
+static void
+ev_sidebar_thumbnails_update_renderer (EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	if (!priv->thumbnail_renderer)
+		return;
+
+	g_object_set (priv->thumbnail_renderer,
+		      "inverted-colors", priv->inverted_colors,
+		      NULL);
+	ev_cell_renderer_thumbnail_clear_cache (EV_CELL_RENDERER_THUMBNAIL (priv->thumbnail_renderer));
+}
+
 static void
 ev_sidebar_thumbnails_reload (EvSidebarThumbnails *sidebar_thumbnails)
 {
@@ -925,6 +1223,7 @@ ev_sidebar_thumbnails_reload (EvSidebarThumbnails *sidebar_thumbnails)
 
 	if (sidebar_thumbnails->priv->loading_icons)
 		g_hash_table_remove_all (sidebar_thumbnails->priv->loading_icons);
+	ev_sidebar_thumbnails_update_renderer (sidebar_thumbnails);
 
 	if (sidebar_thumbnails->priv->document == NULL ||
 	    sidebar_thumbnails->priv->n_pages <= 0)
@@ -943,6 +1242,63 @@ ev_sidebar_thumbnails_reload (EvSidebarThumbnails *sidebar_thumbnails)
 	g_idle_add ((GSourceFunc)refresh, sidebar_thumbnails);
 }
 
+/**
+ * ev_sidebar_thumbnails_reload_layers:
+ * @sidebar_thumbnails: an #EvSidebarThumbnails
+ * @layers: (element-type EvLayer) (allow-none): the layers shown or hidden
+ *
+ * Renders again the thumbnails of the pages using @layers, or all of
+ * them if @layers is %NULL or the document doesn't know which pages
+ * use them.
+ */
+void
+ev_sidebar_thumbnails_reload_layers (EvSidebarThumbnails *sidebar_thumbnails,
+				     GList               *layers)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GArray                     *pages;
+	guint                       i;
+
+	if (!priv->thumbnails_model || !EV_IS_DOCUMENT_LAYERS (priv->document))
+		return;
+
+	pages = layers ? ev_document_layers_get_pages (EV_DOCUMENT_LAYERS (priv->document), layers) : NULL;
+	if (!pages) {
+		priv->layers_changed = TRUE;
+		ev_sidebar_thumbnails_reload (sidebar_thumbnails);
+		return;
+	}
+
+	if (!priv->layer_pages)
+		priv->layer_pages = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < pages->len; i++) {
+		gint   page = g_array_index (pages, gint, i);
+		EvJob *job = NULL;
+		GtkTreeIter iter;
+
+		g_hash_table_add (priv->layer_pages, GINT_TO_POINTER (page));
+
+		if (!gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (priv->thumbnails_model), &iter, NULL, page))
+			continue;
+
+		/* A running job could render it with the old layers */
+		gtk_tree_model_get (GTK_TREE_MODEL (priv->thumbnails_model), &iter,
+				    COLUMN_JOB, &job,
+				    -1);
+		if (job) {
+			ev_job_thumbnail_batch_remove_pages (EV_JOB_THUMBNAIL_BATCH (job), page, page);
+			ev_thumbnails_model_set_job (priv->thumbnails_model, page, NULL);
+			g_object_unref (job);
+		}
+		ev_thumbnails_model_set_thumbnail (priv->thumbnails_model, page, NULL);
+	}
+	g_array_free (pages, TRUE);
+
+	if (priv->start_page >= 0 && priv->end_page >= priv->start_page)
+		add_range (sidebar_thumbnails, priv->start_page, priv->end_page);
+}
+
 static void
 ev_sidebar_thumbnails_rotation_changed_cb (EvDocumentModel     *model,
 					   GParamSpec          *pspec,
@@ -965,44 +1321,91 @@ ev_sidebar_thumbnails_inverted_colors_changed_cb (EvDocumentModel     *model,
 	ev_sidebar_thumbnails_reload (sidebar_thumbnails);
 }
 
-static void
-thumbnail_job_completed_callback (EvJobThumbnail      *job,
-				  EvSidebarThumbnails *sidebar_thumbnails)
+/* Called by the surface budget when it's exceeded. Thumbnails in the
+ * visible range are kept, others get the loading icon back and are
+ * rendered again when they are scrolled into view.
+ */
+static gboolean
+thumbnail_evict_cb (cairo_surface_t *surface,
+		    gpointer         user_data)
 {
-        GtkWidget                  *widget = GTK_WIDGET (sidebar_thumbnails);
+	EvSidebarThumbnails        *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (user_data);
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter                *iter;
-        cairo_surface_t            *surface;
-#ifdef HAVE_HIDPI_SUPPORT
-        gint                        device_scale;
-#endif
+	gint                        page;
 
-        if (ev_job_is_failed (EV_JOB (job)))
-          return;
+	if (!priv->thumbnails_model)
+		return TRUE;
 
-#ifdef HAVE_HIDPI_SUPPORT
-        device_scale = gtk_widget_get_scale_factor (widget);
-        cairo_surface_set_device_scale (job->thumbnail_surface, device_scale, device_scale);
-#endif
+	page = ev_thumbnails_model_find_surface (priv->thumbnails_model, surface);
+	if (page == -1)
+		return TRUE;
 
-        surface = ev_document_misc_render_thumbnail_surface_with_frame (widget,
-                                                                        job->thumbnail_surface,
-                                                                        -1, -1);
+	if (page >= priv->start_page && page <= priv->end_page)
+		return FALSE;
 
-	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
-	if (priv->inverted_colors)
-		ev_document_misc_invert_surface (surface);
-	gtk_list_store_set (priv->list_store,
-			    iter,
-			    COLUMN_SURFACE, surface,
-			    COLUMN_THUMBNAIL_SET, TRUE,
-			    COLUMN_JOB, NULL,
+	ev_thumbnails_model_set_thumbnail (priv->thumbnails_model, page, NULL);
+
+	return TRUE;
+}
+
+static void
+thumbnail_ready_cb (EvJobThumbnailBatch *job,
+		    gint                 page,
+		    cairo_surface_t     *surface,
+		    EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GtkTreeIter                 iter;
+	EvJob                      *row_job;
+	gint                        width, height;
+
+	if (!gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (priv->thumbnails_model), &iter, NULL, page))
+		return;
+
+	gtk_tree_model_get (GTK_TREE_MODEL (priv->thumbnails_model), &iter,
+			    COLUMN_JOB, &row_job,
 			    -1);
-        cairo_surface_destroy (surface);
+	if (row_job)
+		g_object_unref (row_job);
+
+	/* Scrolled out of view while it was being rendered */
+	if (row_job != EV_JOB (job))
+		return;
+
+	/* Failed, the job stays in the row so that it's not retried */
+	if (!surface)
+		return;
+
+	/* Saved before the frame and the colors are applied */
+	if (priv->pack && ev_sidebar_thumbnails_page_has_default_layers (sidebar_thumbnails, page)) {
+		get_size_for_page (sidebar_thumbnails, page, &width, &height);
+		ev_thumbnail_pack_store (priv->pack, page, job->rotation,
+					 width, height, surface);
+	}
+
+	ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, page, surface);
 
         gtk_widget_queue_draw (priv->icon_view);
 }
 
+static void
+ev_sidebar_thumbnails_document_cache_updated_cb (EvDocument          *document,
+						 EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	/* Still connected to the documents shown before */
+	if (document != priv->document)
+		return;
+
+	/* Sizes and labels of pages probed after loading the document.
+	 * The cache is shared by the sidebars of the document, updating
+	 * it again is cheap. */
+	ev_thumbnails_size_cache_update (priv->size_cache, priv->document);
+	if (priv->thumbnails_model)
+		ev_thumbnails_model_pages_changed (priv->thumbnails_model);
+}
+
 static void
 ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 					   GParamSpec          *pspec,
@@ -1016,7 +1419,15 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 		return;
 	}
 
+	g_signal_connect_object (document, "cache-updated",
+				 G_CALLBACK (ev_sidebar_thumbnails_document_cache_updated_cb),
+				 sidebar_thumbnails, 0);
+
 	priv->size_cache = ev_thumbnails_size_cache_get (document);
+	priv->pack = ev_thumbnail_pack_get (document);
+	if (priv->layer_pages)
+		g_hash_table_remove_all (priv->layer_pages);
+	priv->layers_changed = FALSE;
 	priv->document = document;
 	priv->n_pages = ev_document_get_n_pages (document);
 	priv->rotation = ev_document_model_get_rotation (model);
@@ -1038,6 +1449,7 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 		if (priv->tree_view) {
 			gtk_container_remove (GTK_CONTAINER (priv->swindow), priv->tree_view);
 			priv->tree_view = NULL;
+			priv->thumbnail_renderer = NULL;
 		}
 
 		if (! priv->icon_view) {
@@ -1050,6 +1462,7 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 		if (priv->icon_view) {
 			gtk_container_remove (GTK_CONTAINER (priv->swindow), priv->icon_view);
 			priv->icon_view = NULL;
+			priv->thumbnail_renderer = NULL;
 		}
 
 		if (! priv->tree_view) {
@@ -1057,6 +1470,7 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 			g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
 		}
 	}
+	ev_sidebar_thumbnails_update_renderer (sidebar_thumbnails);
 
 	/* Connect to the signal and trigger a fake callback */
 	g_signal_connect_swapped (priv->model, "page-changed",
@@ -1094,32 +1508,34 @@ ev_sidebar_thumbnails_set_model (EvSidebarPage   *sidebar_page,
 			  sidebar_page);
 }
 
-static gboolean
-ev_sidebar_thumbnails_clear_job (GtkTreeModel *model,                                             
-			         GtkTreePath *path,
-			         GtkTreeIter *iter,
-				 gpointer data)
+static void
+ev_sidebar_thumbnails_clear_job (EvJob    *job,
+				 gpointer  data)
 {
-	EvJob *job;
-	
-	gtk_tree_model_get (model, iter, COLUMN_JOB, &job, -1);
-	
-	if (job != NULL) {
-		ev_job_cancel (job);
-		g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, data);
-		g_object_unref (job);
-	}
-	
-	return FALSE;    
+	ev_job_cancel (job);
+	g_signal_handlers_disconnect_by_func (job, thumbnail_ready_cb, data);
 }
 
 static void 
 ev_sidebar_thumbnails_clear_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	
-	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->list_store), ev_sidebar_thumbnails_clear_job, sidebar_thumbnails);
-	gtk_list_store_clear (priv->list_store);
+
+	if (priv->thumbnails_model) {
+		ev_thumbnails_model_foreach_job (priv->thumbnails_model,
+						 (GFunc) ev_sidebar_thumbnails_clear_job,
+						 sidebar_thumbnails);
+		g_signal_handlers_disconnect_by_func (priv->thumbnails_model,
+						      ev_sidebar_thumbnails_row_changed,
+						      GUINT_TO_POINTER (g_signal_lookup ("row-changed", GTK_TYPE_TREE_MODEL)));
+		g_clear_object (&priv->thumbnails_model);
+	}
+
+	if (priv->batch_job) {
+		ev_job_cancel (EV_JOB (priv->batch_job));
+		g_signal_handlers_disconnect_by_func (priv->batch_job, thumbnail_ready_cb, sidebar_thumbnails);
+		g_clear_object (&priv->batch_job);
+	}
 }
 
 static gboolean
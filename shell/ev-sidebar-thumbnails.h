@@ -26,6 +26,8 @@
 
 #include <gtk/gtk.h>
 
+#include "ev-view.h"
+
 G_BEGIN_DECLS
 
 typedef struct _EvSidebarThumbnails EvSidebarThumbnails;
@@ -51,6 +53,10 @@ struct _EvSidebarThumbnailsClass {
 
 GType      ev_sidebar_thumbnails_get_type     (void) G_GNUC_CONST;
 GtkWidget *ev_sidebar_thumbnails_new          (void);
+void       ev_sidebar_thumbnails_set_view     (EvSidebarThumbnails *sidebar_thumbnails,
+					       EvView              *view);
+void       ev_sidebar_thumbnails_reload_layers (EvSidebarThumbnails *sidebar_thumbnails,
+					        GList               *layers);
 
 G_END_DECLS
 
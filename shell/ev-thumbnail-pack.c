@@ -0,0 +1,548 @@
+/* ev-thumbnail-pack.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Cache of the sidebar thumbnails of a document, so that reopening it
+ * doesn't render every page again. There's one pack file per document
+ * fingerprint, with a header followed by the records appended as the
+ * thumbnails are rendered:
+ *
+ *	EvThumbnailPackHeader
+ *	EvThumbnailRecord, stride * height bytes of pixels
+ *	...
+ *
+ * The file is mapped, and the thumbnails found are image surfaces
+ * pointing to the mapped pixels. The file is not trusted, records are
+ * checked before being used and the file is cut at the first broken
+ * one. Several processes may append to the same pack, writes and
+ * scans are done with the file locked.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "ev-thumbnail-pack.h"
+
+#define EV_THUMBNAIL_PACK_KEY     "ev-thumbnail-pack"
+#define EV_THUMBNAIL_PACK_MAGIC   "EVTHUMB1"
+#define EV_THUMBNAIL_RECORD_MAGIC 0x45565452
+#define EV_THUMBNAIL_MAX_SIZE     4096
+
+/* Thumbnails are small, these are only reached by huge documents */
+#define EV_THUMBNAIL_PACK_MAX_SIZE  (64 * 1024 * 1024)
+#define EV_THUMBNAIL_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
+typedef struct {
+	gchar   magic[8];
+	guint64 mtime;
+	guint64 size;
+	guint32 n_pages;
+	guint32 reserved;
+} EvThumbnailPackHeader;
+
+typedef struct {
+	guint32 magic;
+	guint32 page;
+	guint32 rotation;
+	guint32 target_width;
+	guint32 target_height;
+	guint32 format;
+	guint32 width;
+	guint32 height;
+	guint32 stride;
+	guint32 reserved;
+} EvThumbnailRecord;
+
+struct _EvThumbnailPack {
+	gint         fd;
+	GMappedFile *mapped;
+	gsize        length;
+	gboolean     full;
+
+	/* Offsets of the records by their key */
+	GHashTable  *records;
+};
+
+static cairo_user_data_key_t mapped_file_key;
+
+static gchar *
+ev_thumbnail_pack_get_record_key (gint page,
+				  gint rotation,
+				  gint width,
+				  gint height)
+{
+	return g_strdup_printf ("%d:%d:%dx%d", page, rotation, width, height);
+}
+
+static gsize
+ev_thumbnail_record_get_size (const EvThumbnailRecord *record)
+{
+	return sizeof (EvThumbnailRecord) + (gsize) record->stride * record->height;
+}
+
+/* Whether the record at @offset fits in the @length first bytes of
+ * @data and describes a surface cairo can use.
+ */
+static const EvThumbnailRecord *
+ev_thumbnail_pack_check_record (const gchar *data,
+				gsize        length,
+				gsize        offset)
+{
+	const EvThumbnailRecord *record;
+
+	if (offset + sizeof (EvThumbnailRecord) > length)
+		return NULL;
+
+	record = (const EvThumbnailRecord *) (data + offset);
+	if (record->magic != EV_THUMBNAIL_RECORD_MAGIC)
+		return NULL;
+	if (record->format != CAIRO_FORMAT_ARGB32 && record->format != CAIRO_FORMAT_RGB24)
+		return NULL;
+	if (record->width == 0 || record->width > EV_THUMBNAIL_MAX_SIZE ||
+	    record->height == 0 || record->height > EV_THUMBNAIL_MAX_SIZE)
+		return NULL;
+	if (record->stride != (guint32) cairo_format_stride_for_width (record->format, record->width))
+		return NULL;
+	if (offset + ev_thumbnail_record_get_size (record) > length)
+		return NULL;
+
+	return record;
+}
+
+static void
+ev_thumbnail_pack_free (EvThumbnailPack *pack)
+{
+	if (pack->fd != -1)
+		close (pack->fd);
+	g_clear_pointer (&pack->mapped, g_mapped_file_unref);
+	g_hash_table_destroy (pack->records);
+	g_slice_free (EvThumbnailPack, pack);
+}
+
+static gboolean
+ev_thumbnail_pack_remap (EvThumbnailPack *pack)
+{
+	g_clear_pointer (&pack->mapped, g_mapped_file_unref);
+	pack->mapped = g_mapped_file_new_from_fd (pack->fd, FALSE, NULL);
+
+	return pack->mapped != NULL;
+}
+
+static const EvThumbnailRecord *
+ev_thumbnail_pack_get_record (EvThumbnailPack *pack,
+			      gsize            offset)
+{
+	if (!pack->mapped)
+		return NULL;
+
+	return ev_thumbnail_pack_check_record (g_mapped_file_get_contents (pack->mapped),
+					       g_mapped_file_get_length (pack->mapped),
+					       offset);
+}
+
+/* Called with the file locked */
+static void
+ev_thumbnail_pack_scan (EvThumbnailPack *pack)
+{
+	const gchar *data;
+	gsize        length;
+	gsize        offset = sizeof (EvThumbnailPackHeader);
+
+	if (!ev_thumbnail_pack_remap (pack))
+		return;
+
+	data = g_mapped_file_get_contents (pack->mapped);
+	length = g_mapped_file_get_length (pack->mapped);
+	while (offset < length) {
+		const EvThumbnailRecord *record;
+
+		record = ev_thumbnail_pack_check_record (data, length, offset);
+		if (!record)
+			break;
+
+		g_hash_table_insert (pack->records,
+				     ev_thumbnail_pack_get_record_key (record->page,
+								       record->rotation,
+								       record->target_width,
+								       record->target_height),
+				     GSIZE_TO_POINTER (offset));
+		offset += ev_thumbnail_record_get_size (record);
+	}
+
+	/* Drop what a crash left half written */
+	if (offset < length && ftruncate (pack->fd, offset) < 0)
+		pack->full = TRUE;
+	pack->length = offset;
+}
+
+static void
+ev_thumbnail_pack_get_stamp (EvDocument            *document,
+			     EvThumbnailPackHeader *header)
+{
+	const gchar *uri = ev_document_get_uri (document);
+	GFile       *file;
+	GFileInfo   *info = NULL;
+
+	memset (header, 0, sizeof (EvThumbnailPackHeader));
+	memcpy (header->magic, EV_THUMBNAIL_PACK_MAGIC, sizeof (header->magic));
+	header->n_pages = ev_document_get_n_pages (document);
+
+	if (!uri)
+		return;
+
+	file = g_file_new_for_uri (uri);
+	if (g_file_is_native (file)) {
+		info = g_file_query_info (file,
+					  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	}
+	g_object_unref (file);
+
+	if (info) {
+		header->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		header->size = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+}
+
+typedef struct {
+	gchar  *path;
+	goffset size;
+	gint64  mtime;
+} EvThumbnailPackFile;
+
+static gint
+compare_pack_files (gconstpointer a,
+		    gconstpointer b)
+{
+	const EvThumbnailPackFile *file_a = a;
+	const EvThumbnailPackFile *file_b = b;
+
+	return (file_a->mtime > file_b->mtime) - (file_a->mtime < file_b->mtime);
+}
+
+/* Removes the least recently opened packs when the cache is too big */
+static void
+ev_thumbnail_pack_prune (const gchar *dir)
+{
+	GDir        *gdir;
+	GArray      *files;
+	const gchar *name;
+	goffset      total = 0;
+	guint        i;
+
+	gdir = g_dir_open (dir, 0, NULL);
+	if (!gdir)
+		return;
+
+	files = g_array_new (FALSE, FALSE, sizeof (EvThumbnailPackFile));
+	while ((name = g_dir_read_name (gdir))) {
+		EvThumbnailPackFile file;
+		GStatBuf            st;
+
+		if (!g_str_has_suffix (name, ".pack"))
+			continue;
+
+		file.path = g_build_filename (dir, name, NULL);
+		if (g_stat (file.path, &st) < 0) {
+			g_free (file.path);
+			continue;
+		}
+
+		file.size = st.st_size;
+		file.mtime = st.st_mtime;
+		total += file.size;
+		g_array_append_val (files, file);
+	}
+	g_dir_close (gdir);
+
+	if (total > EV_THUMBNAIL_CACHE_MAX_SIZE) {
+		g_array_sort (files, compare_pack_files);
+		for (i = 0; i < files->len && total > EV_THUMBNAIL_CACHE_MAX_SIZE * 3 / 4; i++) {
+			EvThumbnailPackFile *file = &g_array_index (files, EvThumbnailPackFile, i);
+
+			if (g_unlink (file->path) == 0)
+				total -= file->size;
+		}
+	}
+
+	for (i = 0; i < files->len; i++)
+		g_free (g_array_index (files, EvThumbnailPackFile, i).path);
+	g_array_free (files, TRUE);
+}
+
+static gint
+ev_thumbnail_pack_open_file (const gchar                 *path,
+			     const EvThumbnailPackHeader *header)
+{
+	EvThumbnailPackHeader saved;
+	gint                  fd;
+
+	fd = g_open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd == -1)
+		return -1;
+
+	if (flock (fd, LOCK_EX) < 0) {
+		close (fd);
+		return -1;
+	}
+
+	if (pread (fd, &saved, sizeof (saved), 0) == sizeof (saved)) {
+		if (memcmp (&saved, header, sizeof (saved)) == 0)
+			return fd;
+
+		/* The document changed. The file is replaced instead of
+		 * truncated, since other processes may have it mapped.
+		 */
+		g_unlink (path);
+		close (fd);
+
+		fd = g_open (path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd == -1 || flock (fd, LOCK_EX) < 0) {
+			if (fd != -1)
+				close (fd);
+			return -1;
+		}
+	}
+
+	if (ftruncate (fd, 0) < 0 ||
+	    pwrite (fd, header, sizeof (*header), 0) != sizeof (*header)) {
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * ev_thumbnail_pack_get:
+ * @document: an #EvDocument
+ *
+ * Returns: (transfer none) (allow-none): the thumbnail pack of
+ *   @document, or %NULL if @document can't be identified or the
+ *   cache can't be written
+ */
+EvThumbnailPack *
+ev_thumbnail_pack_get (EvDocument *document)
+{
+	EvThumbnailPack       *pack;
+	EvThumbnailPackHeader  header;
+	const gchar           *fingerprint;
+	gchar                 *dir;
+	gchar                 *filename;
+	gchar                 *path;
+	gint                   fd;
+
+	pack = g_object_get_data (G_OBJECT (document), EV_THUMBNAIL_PACK_KEY);
+	if (pack)
+		return pack;
+
+	fingerprint = ev_document_get_fingerprint (document);
+	if (!fingerprint)
+		return NULL;
+
+	dir = g_build_filename (g_get_user_cache_dir (), "evince", "thumbnails", NULL);
+	if (g_mkdir_with_parents (dir, 0700) < 0) {
+		g_free (dir);
+		return NULL;
+	}
+	ev_thumbnail_pack_prune (dir);
+
+	filename = g_strconcat (fingerprint, ".pack", NULL);
+	path = g_build_filename (dir, filename, NULL);
+	g_free (filename);
+	g_free (dir);
+
+	ev_thumbnail_pack_get_stamp (document, &header);
+	fd = ev_thumbnail_pack_open_file (path, &header);
+	if (fd == -1) {
+		g_free (path);
+		return NULL;
+	}
+
+	/* Keeps the pack from being pruned */
+	g_utime (path, NULL);
+	g_free (path);
+
+	pack = g_slice_new0 (EvThumbnailPack);
+	pack->fd = fd;
+	pack->length = sizeof (EvThumbnailPackHeader);
+	pack->records = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	ev_thumbnail_pack_scan (pack);
+	flock (fd, LOCK_UN);
+
+	g_object_set_data_full (G_OBJECT (document), EV_THUMBNAIL_PACK_KEY,
+				pack, (GDestroyNotify) ev_thumbnail_pack_free);
+
+	return pack;
+}
+
+/**
+ * ev_thumbnail_pack_lookup:
+ * @pack: an #EvThumbnailPack
+ * @page: the page index
+ * @rotation: the rotation of the thumbnail
+ * @width: the width the thumbnail was requested with
+ * @height: the height the thumbnail was requested with
+ *
+ * Returns: (transfer full) (allow-none): a surface with the saved
+ *   thumbnail, or %NULL if it wasn't stored. The surface must not be
+ *   modified, its pixels are in the pack file.
+ */
+cairo_surface_t *
+ev_thumbnail_pack_lookup (EvThumbnailPack *pack,
+			  gint             page,
+			  gint             rotation,
+			  gint             width,
+			  gint             height)
+{
+	const EvThumbnailRecord *record;
+	cairo_surface_t         *surface;
+	gchar                   *key;
+	gpointer                 value;
+	gsize                    offset;
+
+	key = ev_thumbnail_pack_get_record_key (page, rotation, width, height);
+	if (!g_hash_table_lookup_extended (pack->records, key, NULL, &value)) {
+		g_free (key);
+		return NULL;
+	}
+	offset = GPOINTER_TO_SIZE (value);
+
+	/* Records appended after the file was mapped need a new mapping */
+	record = ev_thumbnail_pack_get_record (pack, offset);
+	if (!record && ev_thumbnail_pack_remap (pack))
+		record = ev_thumbnail_pack_get_record (pack, offset);
+
+	/* Another process may have replaced the file */
+	if (!record ||
+	    record->page != (guint32) page || record->rotation != (guint32) rotation ||
+	    record->target_width != (guint32) width || record->target_height != (guint32) height) {
+		g_hash_table_remove (pack->records, key);
+		g_free (key);
+		return NULL;
+	}
+	g_free (key);
+
+	surface = cairo_image_surface_create_for_data ((guchar *) (record + 1),
+						       record->format,
+						       record->width,
+						       record->height,
+						       record->stride);
+	cairo_surface_set_user_data (surface, &mapped_file_key,
+				     g_mapped_file_ref (pack->mapped),
+				     (cairo_destroy_func_t) g_mapped_file_unref);
+
+	return surface;
+}
+
+/**
+ * ev_thumbnail_pack_store:
+ * @pack: an #EvThumbnailPack
+ * @page: the page index
+ * @rotation: the rotation of the thumbnail
+ * @width: the width the thumbnail was requested with
+ * @height: the height the thumbnail was requested with
+ * @surface: the rendered thumbnail
+ *
+ * Appends @surface to the pack file, so that ev_thumbnail_pack_lookup()
+ * finds it even after the document is closed. The size of the surface
+ * may differ from the requested one. Only image surfaces are stored.
+ */
+void
+ev_thumbnail_pack_store (EvThumbnailPack *pack,
+			 gint             page,
+			 gint             rotation,
+			 gint             width,
+			 gint             height,
+			 cairo_surface_t *surface)
+{
+	EvThumbnailRecord record;
+	struct stat       st;
+	gchar            *key;
+	gsize             data_size;
+	goffset           offset;
+
+	if (pack->full || cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return;
+
+	cairo_surface_flush (surface);
+	memset (&record, 0, sizeof (record));
+	record.magic = EV_THUMBNAIL_RECORD_MAGIC;
+	record.page = page;
+	record.rotation = rotation;
+	record.target_width = width;
+	record.target_height = height;
+	record.format = cairo_image_surface_get_format (surface);
+	record.width = cairo_image_surface_get_width (surface);
+	record.height = cairo_image_surface_get_height (surface);
+	record.stride = cairo_image_surface_get_stride (surface);
+
+	if (!ev_thumbnail_pack_check_record ((const gchar *) &record, G_MAXSIZE, 0))
+		return;
+
+	key = ev_thumbnail_pack_get_record_key (page, rotation, width, height);
+	if (g_hash_table_contains (pack->records, key)) {
+		g_free (key);
+		return;
+	}
+
+	data_size = (gsize) record.stride * record.height;
+	if (pack->length + sizeof (record) + data_size > EV_THUMBNAIL_PACK_MAX_SIZE) {
+		pack->full = TRUE;
+		g_free (key);
+		return;
+	}
+
+	if (flock (pack->fd, LOCK_EX) < 0) {
+		g_free (key);
+		return;
+	}
+
+	/* Other processes may have appended their own records */
+	if (fstat (pack->fd, &st) < 0) {
+		flock (pack->fd, LOCK_UN);
+		g_free (key);
+		return;
+	}
+	offset = st.st_size;
+
+	if (pwrite (pack->fd, &record, sizeof (record), offset) == sizeof (record) &&
+	    pwrite (pack->fd, cairo_image_surface_get_data (surface), data_size,
+		    offset + sizeof (record)) == (gssize) data_size) {
+		g_hash_table_insert (pack->records, key, GSIZE_TO_POINTER ((gsize) offset));
+		pack->length = offset + sizeof (record) + data_size;
+	} else {
+		/* Most likely out of space, don't try again */
+		if (ftruncate (pack->fd, offset) < 0)
+			g_warning ("Failed to truncate the thumbnail pack: %s", g_strerror (errno));
+		pack->full = TRUE;
+		g_free (key);
+	}
+
+	flock (pack->fd, LOCK_UN);
+}
@@ -0,0 +1,44 @@
+/* ev-thumbnail-pack.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EV_THUMBNAIL_PACK_H
+#define EV_THUMBNAIL_PACK_H
+
+#include <cairo.h>
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvThumbnailPack EvThumbnailPack;
+
+EvThumbnailPack *ev_thumbnail_pack_get    (EvDocument      *document);
+cairo_surface_t *ev_thumbnail_pack_lookup (EvThumbnailPack *pack,
+					   gint             page,
+					   gint             rotation,
+					   gint             width,
+					   gint             height);
+void             ev_thumbnail_pack_store  (EvThumbnailPack *pack,
+					   gint             page,
+					   gint             rotation,
+					   gint             width,
+					   gint             height,
+					   cairo_surface_t *surface);
+
+G_END_DECLS
+
+#endif /* EV_THUMBNAIL_PACK_H */
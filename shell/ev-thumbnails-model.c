@@ -0,0 +1,474 @@
+/* ev-thumbnails-model.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * List model of the thumbnails sidebar, with a row per page of the
+ * document. Rows are virtual: the page label and the loading icon are
+ * produced when the view asks for them, and only the pages with a
+ * thumbnail or a job have data, so that documents with many pages
+ * don't need a store filled in advance.
+ */
+
+#include <config.h>
+
+#include <cairo-gobject.h>
+
+#include "ev-thumbnails-model.h"
+
+typedef struct {
+	cairo_surface_t *surface;
+	EvJob           *job;
+} EvThumbnailsRow;
+
+struct _EvThumbnailsModel {
+	GObject base;
+
+	gint        stamp;
+	EvDocument *document;
+	gint        n_pages;
+
+	EvThumbnailsModelLoadingFunc loading_func;
+	gpointer                     loading_data;
+
+	/* Rows with data, by page */
+	GHashTable *rows;
+};
+
+struct _EvThumbnailsModelClass {
+	GObjectClass base_class;
+};
+
+static void ev_thumbnails_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EvThumbnailsModel, ev_thumbnails_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						ev_thumbnails_model_tree_model_init))
+
+#define ITER_PAGE(iter) GPOINTER_TO_INT ((iter)->user_data)
+
+static void
+ev_thumbnails_row_free (EvThumbnailsRow *row)
+{
+	if (row->surface)
+		cairo_surface_destroy (row->surface);
+	g_clear_object (&row->job);
+	g_slice_free (EvThumbnailsRow, row);
+}
+
+static void
+ev_thumbnails_model_finalize (GObject *object)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (object);
+
+	g_hash_table_destroy (model->rows);
+	g_object_unref (model->document);
+
+	G_OBJECT_CLASS (ev_thumbnails_model_parent_class)->finalize (object);
+}
+
+static void
+ev_thumbnails_model_init (EvThumbnailsModel *model)
+{
+	model->stamp = g_random_int ();
+	model->rows = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+					     (GDestroyNotify) ev_thumbnails_row_free);
+}
+
+static void
+ev_thumbnails_model_class_init (EvThumbnailsModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = ev_thumbnails_model_finalize;
+}
+
+static GtkTreeModelFlags
+ev_thumbnails_model_get_flags (GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+ev_thumbnails_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return EV_THUMBNAILS_MODEL_N_COLUMNS;
+}
+
+static GType
+ev_thumbnails_model_get_column_type (GtkTreeModel *tree_model,
+				     gint          column)
+{
+	switch (column) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING:
+		return G_TYPE_STRING;
+	case EV_THUMBNAILS_MODEL_COLUMN_SURFACE:
+		return CAIRO_GOBJECT_TYPE_SURFACE;
+	case EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET:
+		return G_TYPE_BOOLEAN;
+	case EV_THUMBNAILS_MODEL_COLUMN_JOB:
+		return EV_TYPE_JOB;
+	default:
+		g_assert_not_reached ();
+		return G_TYPE_INVALID;
+	}
+}
+
+static gboolean
+ev_thumbnails_model_set_iter (EvThumbnailsModel *model,
+			      GtkTreeIter       *iter,
+			      gint               page)
+{
+	if (page < 0 || page >= model->n_pages) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->stamp = model->stamp;
+	iter->user_data = GINT_TO_POINTER (page);
+
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_get_iter (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter,
+			      GtkTreePath  *path)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	if (gtk_tree_path_get_depth (path) != 1)
+		return FALSE;
+
+	return ev_thumbnails_model_set_iter (model, iter, gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+ev_thumbnails_model_get_path (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter)
+{
+	g_return_val_if_fail (iter->stamp == EV_THUMBNAILS_MODEL (tree_model)->stamp, NULL);
+
+	return gtk_tree_path_new_from_indices (ITER_PAGE (iter), -1);
+}
+
+static void
+ev_thumbnails_model_get_value (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter,
+			       gint          column,
+			       GValue       *value)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+	EvThumbnailsRow   *row;
+	gint               page = ITER_PAGE (iter);
+
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+	g_value_init (value, ev_thumbnails_model_get_column_type (tree_model, column));
+
+	switch (column) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING: {
+		gchar *page_label;
+
+		page_label = ev_document_get_page_label (model->document, page);
+		g_value_take_string (value, g_markup_printf_escaped ("<i>%s</i>", page_label));
+		g_free (page_label);
+	}
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_SURFACE:
+		if (row && row->surface)
+			g_value_set_boxed (value, row->surface);
+		else
+			g_value_set_boxed (value, model->loading_func (page, model->loading_data));
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET:
+		g_value_set_boolean (value, row && row->surface);
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_JOB:
+		g_value_set_object (value, row ? row->job : NULL);
+		break;
+	}
+}
+
+static gboolean
+ev_thumbnails_model_iter_next (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter)
+{
+	return ev_thumbnails_model_set_iter (EV_THUMBNAILS_MODEL (tree_model), iter,
+					     ITER_PAGE (iter) + 1);
+}
+
+static gboolean
+ev_thumbnails_model_iter_previous (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter)
+{
+	return ev_thumbnails_model_set_iter (EV_THUMBNAILS_MODEL (tree_model), iter,
+					     ITER_PAGE (iter) - 1);
+}
+
+static gboolean
+ev_thumbnails_model_iter_children (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreeIter  *parent)
+{
+	if (parent) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return ev_thumbnails_model_set_iter (EV_THUMBNAILS_MODEL (tree_model), iter, 0);
+}
+
+static gboolean
+ev_thumbnails_model_iter_has_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter)
+{
+	return FALSE;
+}
+
+static gint
+ev_thumbnails_model_iter_n_children (GtkTreeModel *tree_model,
+				     GtkTreeIter  *iter)
+{
+	return iter ? 0 : EV_THUMBNAILS_MODEL (tree_model)->n_pages;
+}
+
+static gboolean
+ev_thumbnails_model_iter_nth_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    GtkTreeIter  *parent,
+				    gint          n)
+{
+	if (parent) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return ev_thumbnails_model_set_iter (EV_THUMBNAILS_MODEL (tree_model), iter, n);
+}
+
+static gboolean
+ev_thumbnails_model_iter_parent (GtkTreeModel *tree_model,
+				 GtkTreeIter  *iter,
+				 GtkTreeIter  *child)
+{
+	iter->stamp = 0;
+
+	return FALSE;
+}
+
+static void
+ev_thumbnails_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = ev_thumbnails_model_get_flags;
+	iface->get_n_columns = ev_thumbnails_model_get_n_columns;
+	iface->get_column_type = ev_thumbnails_model_get_column_type;
+	iface->get_iter = ev_thumbnails_model_get_iter;
+	iface->get_path = ev_thumbnails_model_get_path;
+	iface->get_value = ev_thumbnails_model_get_value;
+	iface->iter_next = ev_thumbnails_model_iter_next;
+	iface->iter_previous = ev_thumbnails_model_iter_previous;
+	iface->iter_children = ev_thumbnails_model_iter_children;
+	iface->iter_has_child = ev_thumbnails_model_iter_has_child;
+	iface->iter_n_children = ev_thumbnails_model_iter_n_children;
+	iface->iter_nth_child = ev_thumbnails_model_iter_nth_child;
+	iface->iter_parent = ev_thumbnails_model_iter_parent;
+}
+
+EvThumbnailsModel *
+ev_thumbnails_model_new (EvDocument                  *document,
+			 EvThumbnailsModelLoadingFunc loading_func,
+			 gpointer                     user_data)
+{
+	EvThumbnailsModel *model;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+	g_return_val_if_fail (loading_func != NULL, NULL);
+
+	model = g_object_new (EV_TYPE_THUMBNAILS_MODEL, NULL);
+	model->document = g_object_ref (document);
+	model->n_pages = ev_document_get_n_pages (document);
+	model->loading_func = loading_func;
+	model->loading_data = user_data;
+
+	return model;
+}
+
+static EvThumbnailsRow *
+ev_thumbnails_model_ensure_row (EvThumbnailsModel *model,
+				gint               page)
+{
+	EvThumbnailsRow *row;
+
+	row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+	if (!row) {
+		row = g_slice_new0 (EvThumbnailsRow);
+		g_hash_table_insert (model->rows, GINT_TO_POINTER (page), row);
+	}
+
+	return row;
+}
+
+static void
+ev_thumbnails_model_row_changed (EvThumbnailsModel *model,
+				 gint               page,
+				 EvThumbnailsRow   *row)
+{
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+
+	if (!row->surface && !row->job)
+		g_hash_table_remove (model->rows, GINT_TO_POINTER (page));
+
+	ev_thumbnails_model_set_iter (model, &iter, page);
+	path = gtk_tree_path_new_from_indices (page, -1);
+	gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+/**
+ * ev_thumbnails_model_set_thumbnail:
+ * @model: an #EvThumbnailsModel
+ * @page: the page index
+ * @surface: (allow-none): the thumbnail of @page, or %NULL to show
+ *   the loading icon again
+ *
+ * Sets the thumbnail of @page, which is done when its job is, so the
+ * job of the row is cleared.
+ */
+void
+ev_thumbnails_model_set_thumbnail (EvThumbnailsModel *model,
+				   gint               page,
+				   cairo_surface_t   *surface)
+{
+	EvThumbnailsRow *row;
+
+	g_return_if_fail (page >= 0 && page < model->n_pages);
+
+	row = ev_thumbnails_model_ensure_row (model, page);
+	if (row->surface)
+		cairo_surface_destroy (row->surface);
+	row->surface = surface ? cairo_surface_reference (surface) : NULL;
+	if (surface)
+		g_clear_object (&row->job);
+
+	ev_thumbnails_model_row_changed (model, page, row);
+}
+
+/**
+ * ev_thumbnails_model_set_job:
+ * @model: an #EvThumbnailsModel
+ * @page: the page index
+ * @job: (allow-none): the job rendering the thumbnail of @page, or %NULL
+ */
+void
+ev_thumbnails_model_set_job (EvThumbnailsModel *model,
+			     gint               page,
+			     EvJob             *job)
+{
+	EvThumbnailsRow *row;
+
+	g_return_if_fail (page >= 0 && page < model->n_pages);
+
+	row = ev_thumbnails_model_ensure_row (model, page);
+	if (row->job == job)
+		return;
+
+	g_clear_object (&row->job);
+	row->job = job ? g_object_ref (job) : NULL;
+
+	ev_thumbnails_model_row_changed (model, page, row);
+}
+
+/**
+ * ev_thumbnails_model_find_surface:
+ * @model: an #EvThumbnailsModel
+ * @surface: a thumbnail surface
+ *
+ * Returns: the page with @surface as thumbnail, or -1
+ */
+gint
+ev_thumbnails_model_find_surface (EvThumbnailsModel *model,
+				  cairo_surface_t   *surface)
+{
+	GHashTableIter iter;
+	gpointer       key, value;
+
+	g_hash_table_iter_init (&iter, model->rows);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		EvThumbnailsRow *row = value;
+
+		if (row->surface == surface)
+			return GPOINTER_TO_INT (key);
+	}
+
+	return -1;
+}
+
+/**
+ * ev_thumbnails_model_foreach_job:
+ * @model: an #EvThumbnailsModel
+ * @func: the function called with every job
+ * @user_data: data passed to @func
+ *
+ * Calls @func for the job of every row that has one. The same job may
+ * be used by several rows.
+ */
+void
+ev_thumbnails_model_foreach_job (EvThumbnailsModel *model,
+				 GFunc              func,
+				 gpointer           user_data)
+{
+	GHashTableIter iter;
+	gpointer       value;
+
+	g_hash_table_iter_init (&iter, model->rows);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		EvThumbnailsRow *row = value;
+
+		if (row->job)
+			func (row->job, user_data);
+	}
+}
+
+/**
+ * ev_thumbnails_model_pages_changed:
+ * @model: an #EvThumbnailsModel
+ *
+ * Emits #GtkTreeModel::row-changed for every page, whose label and
+ * loading icon are asked again, like when the sizes and labels of the
+ * pages probed after loading the document differ from the estimated
+ * ones.
+ */
+void
+ev_thumbnails_model_pages_changed (EvThumbnailsModel *model)
+{
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+	gint         page;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	path = gtk_tree_path_new_first ();
+	for (page = 0; page < model->n_pages; page++) {
+		ev_thumbnails_model_set_iter (model, &iter, page);
+		gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+		gtk_tree_path_next (path);
+	}
+	gtk_tree_path_free (path);
+}
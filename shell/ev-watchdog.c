@@ -0,0 +1,251 @@
+/* ev-watchdog.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Watches the main loop from a thread, and tells what the viewer was
+ * doing when the loop didn't turn over for longer than the timeout:
+ * the jobs running in the worker threads, which thread holds the
+ * global document and FontConfig mutexes and for how long, the queued
+ * jobs, and a backtrace of the main thread. A synchronous backend call
+ * from the main thread, like rendering a selection, shows up as a
+ * mutex held by the main thread and in the backtrace.
+ *
+ * It's enabled by setting EV_WATCHDOG to the timeout in milliseconds,
+ * the reports are written to stderr.
+ */
+
+#include <config.h>
+
+#include <unistd.h>
+
+#include <evince-document.h>
+#include <evince-view.h>
+
+#include "ev-watchdog.h"
+
+#if defined (G_OS_UNIX) && defined (HAVE_EXECINFO_H)
+#define EV_WATCHDOG_BACKTRACE 1
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#define MIN_TIMEOUT_MS       50
+#define MIN_HEARTBEAT_MS     10
+#define MAX_BACKTRACE_FRAMES 64
+
+static GThread *watchdog_thread = NULL;
+static guint    heartbeat_id = 0;
+static gint64   timeout;
+
+/* Protects heartbeat and stopping */
+static GMutex   watchdog_mutex;
+static GCond    watchdog_cond;
+static gint64   heartbeat;
+static gboolean stopping;
+
+#ifdef EV_WATCHDOG_BACKTRACE
+static pthread_t main_thread;
+
+/* Not strictly async-signal-safe, but backtrace() only allocates the
+ * first time it's called, which ev_watchdog_init() does */
+static void
+backtrace_handler (int signum)
+{
+	void *frames[MAX_BACKTRACE_FRAMES];
+	int   n_frames;
+
+	n_frames = backtrace (frames, MAX_BACKTRACE_FRAMES);
+	backtrace_symbols_fd (frames, n_frames, STDERR_FILENO);
+}
+#endif
+
+static gboolean
+heartbeat_cb (gpointer user_data)
+{
+	gint64 now = g_get_monotonic_time ();
+	gint64 stalled;
+
+	g_mutex_lock (&watchdog_mutex);
+	stalled = now - heartbeat;
+	heartbeat = now;
+	g_mutex_unlock (&watchdog_mutex);
+
+	if (stalled >= timeout)
+		g_printerr ("Main loop of %s[%d] resumed after %" G_GINT64_FORMAT " ms\n",
+			    g_get_prgname (), (gint) getpid (), stalled / 1000);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+report_mutex (GVariant    *stats,
+	      const gchar *name)
+{
+	GVariant *mutex_stats;
+	gint64    held = 0;
+	gboolean  main_thread_owner = FALSE;
+
+	mutex_stats = g_variant_lookup_value (stats, name, G_VARIANT_TYPE_VARDICT);
+	if (mutex_stats) {
+		g_variant_lookup (mutex_stats, "held", "x", &held);
+		g_variant_lookup (mutex_stats, "held-by-main-thread", "b", &main_thread_owner);
+		g_variant_unref (mutex_stats);
+	}
+
+	if (held == 0)
+		g_printerr ("  %s: unlocked\n", name);
+	else
+		g_printerr ("  %s: held for %" G_GINT64_FORMAT " ms by %s\n", name, held / 1000,
+			    main_thread_owner ? "the main thread" : "a worker thread");
+}
+
+static void
+report_stall (gint64 stalled)
+{
+	static const gchar *priorities[] = { "urgent", "high", "low", "none" };
+	GVariant           *stats;
+	GVariant           *value;
+	GVariantIter        iter;
+	guint32             length;
+	guint               i = 0;
+
+	G_STATIC_ASSERT (G_N_ELEMENTS (priorities) == EV_JOB_N_PRIORITIES);
+
+	g_printerr ("Main loop of %s[%d] stalled for %" G_GINT64_FORMAT " ms\n",
+		    g_get_prgname (), (gint) getpid (), stalled / 1000);
+
+	stats = g_variant_ref_sink (ev_job_scheduler_get_stats ());
+
+	value = g_variant_lookup_value (stats, "running-jobs", G_VARIANT_TYPE_STRING_ARRAY);
+	if (value && g_variant_n_children (value) > 0) {
+		const gchar **jobs = g_variant_get_strv (value, NULL);
+		gchar        *list = g_strjoinv (", ", (gchar **) jobs);
+
+		g_printerr ("  running jobs: %s\n", list);
+		g_free (list);
+		g_free (jobs);
+	} else {
+		g_printerr ("  running jobs: none\n");
+	}
+	g_clear_pointer (&value, g_variant_unref);
+
+	value = g_variant_lookup_value (stats, "queue-length", G_VARIANT_TYPE ("au"));
+	if (value) {
+		g_printerr ("  queued jobs:");
+		g_variant_iter_init (&iter, value);
+		while (g_variant_iter_next (&iter, "u", &length) && i < G_N_ELEMENTS (priorities))
+			g_printerr (" %u %s", length, priorities[i++]);
+		g_printerr ("\n");
+		g_variant_unref (value);
+	}
+
+	g_variant_unref (stats);
+
+	stats = g_variant_ref_sink (ev_document_get_mutex_stats ());
+	report_mutex (stats, "doc-mutex");
+	report_mutex (stats, "fc-mutex");
+	g_variant_unref (stats);
+
+#ifdef EV_WATCHDOG_BACKTRACE
+	g_printerr ("  main thread backtrace:\n");
+	pthread_kill (main_thread, SIGURG);
+#endif
+}
+
+static gpointer
+watchdog_thread_func (gpointer data)
+{
+	gint64 reported = 0;
+
+	g_mutex_lock (&watchdog_mutex);
+	while (!stopping) {
+		gint64 stalled;
+
+		g_cond_wait_until (&watchdog_cond, &watchdog_mutex,
+				   g_get_monotonic_time () + timeout / 2);
+		if (stopping)
+			break;
+
+		/* Each stall is reported once */
+		stalled = g_get_monotonic_time () - heartbeat;
+		if (stalled < timeout || heartbeat == reported)
+			continue;
+		reported = heartbeat;
+
+		g_mutex_unlock (&watchdog_mutex);
+		report_stall (stalled);
+		g_mutex_lock (&watchdog_mutex);
+	}
+	g_mutex_unlock (&watchdog_mutex);
+
+	return NULL;
+}
+
+/* Starts the watchdog when EV_WATCHDOG is set, from the main thread */
+void
+ev_watchdog_init (void)
+{
+	const gchar *env = g_getenv ("EV_WATCHDOG");
+	gint64       timeout_ms;
+
+	if (!env || !*env || watchdog_thread)
+		return;
+
+	timeout_ms = MAX (g_ascii_strtoll (env, NULL, 10), MIN_TIMEOUT_MS);
+	timeout = timeout_ms * G_TIME_SPAN_MILLISECOND;
+
+#ifdef EV_WATCHDOG_BACKTRACE
+	{
+		struct sigaction action;
+		void            *frame;
+
+		backtrace (&frame, 1);
+		main_thread = pthread_self ();
+
+		/* SIGURG is ignored by default, a late one is harmless */
+		action.sa_handler = backtrace_handler;
+		action.sa_flags = SA_RESTART;
+		sigemptyset (&action.sa_mask);
+		sigaction (SIGURG, &action, NULL);
+	}
+#endif
+
+	heartbeat = g_get_monotonic_time ();
+	stopping = FALSE;
+	heartbeat_id = g_timeout_add (MAX (timeout_ms / 4, MIN_HEARTBEAT_MS), heartbeat_cb, NULL);
+	watchdog_thread = g_thread_new ("ev-watchdog", watchdog_thread_func, NULL);
+}
+
+void
+ev_watchdog_shutdown (void)
+{
+	if (!watchdog_thread)
+		return;
+
+	g_mutex_lock (&watchdog_mutex);
+	stopping = TRUE;
+	g_cond_signal (&watchdog_cond);
+	g_mutex_unlock (&watchdog_mutex);
+
+	g_thread_join (watchdog_thread);
+	watchdog_thread = NULL;
+
+	g_source_remove (heartbeat_id);
+	heartbeat_id = 0;
+}
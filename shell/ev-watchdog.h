@@ -0,0 +1,31 @@
+/* ev-watchdog.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EV_WATCHDOG_H
+#define EV_WATCHDOG_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void ev_watchdog_init     (void);
+void ev_watchdog_shutdown (void);
+
+G_END_DECLS
+
+#endif /* EV_WATCHDOG_H */
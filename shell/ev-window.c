@@ -28,6 +28,11 @@
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
+
+#ifdef HAVE_MEMFD_CREATE
+/* memfd_create() is only declared with _GNU_SOURCE */
+#define _GNU_SOURCE
+#endif
 #endif
 
 #include <errno.h>
@@ -91,6 +96,10 @@
 #include "ev-search-box.h"
 
 #ifdef ENABLE_DBUS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <gio/gunixfdlist.h>
+
 #include "ev-gdbus-generated.h"
 #include "ev-media-player-keys.h"
 #endif /* ENABLE_DBUS */
@@ -103,6 +112,9 @@
 #define MOUSE_BACK_BUTTON 8
 #define MOUSE_FORWARD_BUTTON 9
 
+/* History entries whose pages are kept rendered, the current one included */
+#define HISTORY_PINNED_PAGES 4
+
 typedef enum {
 	PAGE_MODE_DOCUMENT,
 	PAGE_MODE_PASSWORD
@@ -194,6 +206,7 @@ struct _EvWindowPrivate {
 
 	/* For bookshelf view of recent items*/
 	EvRecentView *recent_view;
+	GtkWidget    *recent_search_bar;
 
 	/* Document */
 	EvDocumentModel *model;
@@ -201,6 +214,7 @@ struct _EvWindowPrivate {
 	glong uri_mtime;
 	char *local_uri;
 	gboolean in_reload;
+	gboolean remote_streamed;
 	EvFileMonitor *monitor;
 	guint setup_document_idle;
 	
@@ -212,14 +226,21 @@ struct _EvWindowPrivate {
 	EvBookmarks *bookmarks;
 	GMenu *bookmarks_menu;
 
+	/* The metadata is read while the document loads; the document
+	 * is shown once both are done */
+	GCancellable *metadata_cancellable;
+	EvDocument   *pending_document;
+
 	/* Load params */
 	EvLinkDest       *dest;
 	gchar            *search_string;
 	EvWindowRunMode   window_mode;
 
 	EvJob            *load_job;
+	EvJob            *stream_load_job;
 	EvJob            *reload_job;
 	EvJob            *save_job;
+	EvJob            *find_index_job;
 
 	/* Printing */
 	GQueue           *print_queue;
@@ -260,12 +281,19 @@ struct _EvWindowPrivate {
 #define GS_SCHEMA_NAME           "org.gnome.Evince"
 #define GS_OVERRIDE_RESTRICTIONS "override-restrictions"
 #define GS_PAGE_CACHE_SIZE       "page-cache-size"
+#define GS_INACTIVE_PAGE_CACHE_SIZE "inactive-page-cache-size"
 #define GS_AUTO_RELOAD           "auto-reload"
 #define GS_LAST_DOCUMENT_DIRECTORY "document-directory"
 #define GS_LAST_PICTURES_DIRECTORY "pictures-directory"
 #define GS_ALLOW_LINKS_CHANGE_ZOOM "allow-links-change-zoom"
+#define GS_VECTOR_SELECTION      "vector-selection"
+#define GS_DEVICE_SCALE          "device-scale"
+#define GS_RENDER_CACHE_SIZE     "render-cache-size"
+#define GS_PRESENTATION_PRERENDER_SIZE "presentation-prerender-size"
 
 #define SIDEBAR_DEFAULT_SIZE    132
+/* Share of the scheduler workers given to the focused window */
+#define ACTIVE_WINDOW_JOB_WEIGHT 4
 #define LINKS_SIDEBAR_ID "links"
 #define THUMBNAILS_SIDEBAR_ID "thumbnails"
 #define ATTACHMENTS_SIDEBAR_ID "attachments"
@@ -376,6 +404,10 @@ static void     ev_window_show_find_bar                 (EvWindow         *ev_wi
 							 gboolean          restart);
 static void     ev_window_close_find_bar                (EvWindow         *ev_window);
 static void     ev_window_destroy_recent_view           (EvWindow         *ev_window);
+static void     recent_view_hit_activated_cb            (EvRecentView     *recent_view,
+							 const char       *uri,
+							 gint              page,
+							 EvWindow         *ev_window);
 static void     recent_view_item_activated_cb           (EvRecentView     *recent_view,
                                                          const char       *uri,
                                                          EvWindow         *ev_window);
@@ -702,7 +734,24 @@ ev_window_is_empty (const EvWindow *ev_window)
 	g_return_val_if_fail (EV_IS_WINDOW (ev_window), FALSE);
 
 	return (ev_window->priv->document == NULL) && 
-		(ev_window->priv->load_job == NULL);
+		(ev_window->priv->load_job == NULL) &&
+		(ev_window->priv->pending_document == NULL);
+}
+
+/**
+ * ev_window_is_loading:
+ * @ev_window: The instance of the #EvWindow.
+ *
+ * Returns: %TRUE while the document of @ev_window is being loaded and
+ *          the load doesn't wait for a password.
+ */
+gboolean
+ev_window_is_loading (EvWindow *ev_window)
+{
+	g_return_val_if_fail (EV_IS_WINDOW (ev_window), FALSE);
+
+	return ev_window->priv->load_job != NULL &&
+		!ev_job_is_finished (ev_window->priv->load_job);
 }
 
 static void
@@ -827,6 +876,7 @@ ev_window_hide_loading_message (EvWindow *window)
 	}
 
 	gtk_widget_hide (window->priv->loading_message);
+	ev_loading_message_set_fraction (EV_LOADING_MESSAGE (window->priv->loading_message), -1);
 }
 
 typedef struct _LinkTitleData {
@@ -936,6 +986,8 @@ view_layers_changed_cb (EvView   *view,
 			EvWindow *window)
 {
 	ev_sidebar_layers_update_layers_state (EV_SIDEBAR_LAYERS (window->priv->sidebar_layers));
+	/* The view doesn't tell which layers */
+	ev_sidebar_thumbnails_reload_layers (EV_SIDEBAR_THUMBNAILS (window->priv->sidebar_thumbs), NULL);
 }
 
 static void
@@ -1167,6 +1219,8 @@ setup_model_from_metadata (EvWindow *window)
 	if (!window->priv->metadata)
 		return;
 
+	ev_document_model_freeze (window->priv->model);
+
 	/* Current page */
 	if (!window->priv->dest &&
 	    ev_metadata_get_int (window->priv->metadata, "page", &page)) {
@@ -1229,6 +1283,8 @@ setup_model_from_metadata (EvWindow *window)
 		ev_document_model_set_dual_page_odd_pages_left (window->priv->model, dual_page_odd_left);
 	}
 
+	ev_document_model_thaw (window->priv->model);
+
 	/* Fullscreen */
 	if (ev_metadata_get_boolean (window->priv->metadata, "fullscreen", &fullscreen)) {
 		if (fullscreen)
@@ -1387,6 +1443,36 @@ allow_links_change_zoom_changed (GSettings *settings,
 	ev_view_set_allow_links_change_zoom (EV_VIEW (ev_window->priv->view), allow_links_change_zoom);
 }
 
+static void
+vector_selection_changed (GSettings *settings,
+			  gchar     *key,
+			  EvWindow  *ev_window)
+{
+	ev_view_set_vector_selection (EV_VIEW (ev_window->priv->view),
+				      g_settings_get_boolean (settings, GS_VECTOR_SELECTION));
+}
+
+static void
+device_scale_changed (GSettings *settings,
+		      gchar     *key,
+		      EvWindow  *ev_window)
+{
+	ev_view_set_device_scale (EV_VIEW (ev_window->priv->view),
+				  g_settings_get_double (settings, GS_DEVICE_SCALE));
+}
+
+static void
+render_cache_size_changed (GSettings *settings,
+			   gchar     *key,
+			   EvWindow  *ev_window)
+{
+	guint render_cache_mb;
+
+	render_cache_mb = g_settings_get_uint (settings, GS_RENDER_CACHE_SIZE);
+	ev_view_set_render_cache_size (EV_VIEW (ev_window->priv->view),
+				       (gsize) render_cache_mb * 1024 * 1024);
+}
+
 static void
 ev_window_setup_default (EvWindow *ev_window)
 {
@@ -1403,6 +1489,7 @@ ev_window_setup_default (EvWindow *ev_window)
 				g_settings_get_int (settings, "sidebar-size"));
 
 	/* Document model */
+	ev_document_model_freeze (model);
 	ev_document_model_set_continuous (model, g_settings_get_boolean (settings, "continuous"));
 	ev_document_model_set_dual_page (model, g_settings_get_boolean (settings, "dual-page"));
 	ev_document_model_set_dual_page_odd_pages_left (model, g_settings_get_boolean (settings, "dual-page-odd-left"));
@@ -1410,6 +1497,7 @@ ev_window_setup_default (EvWindow *ev_window)
 	ev_document_model_set_sizing_mode (model, g_settings_get_enum (settings, "sizing-mode"));
 	if (ev_document_model_get_sizing_mode (model) == EV_SIZING_FREE)
 		ev_document_model_set_scale (model, g_settings_get_double (settings, "zoom"));
+	ev_document_model_thaw (model);
 }
 
 static void
@@ -1451,10 +1539,71 @@ ev_window_ensure_settings (EvWindow *ev_window)
 			  "changed::"GS_ALLOW_LINKS_CHANGE_ZOOM,
 			  G_CALLBACK (allow_links_change_zoom_changed),
 			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_VECTOR_SELECTION,
+			  G_CALLBACK (vector_selection_changed),
+			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_DEVICE_SCALE,
+			  G_CALLBACK (device_scale_changed),
+			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_RENDER_CACHE_SIZE,
+			  G_CALLBACK (render_cache_size_changed),
+			  ev_window);
 
         return priv->settings;
 }
 
+static void
+ev_window_find_index_job_cb (EvJob    *job,
+			     EvWindow *ev_window)
+{
+	EvFindIndex *index;
+
+	index = ev_job_find_index_get_index (EV_JOB_FIND_INDEX (job));
+	if (index)
+		ev_find_index_set_for_document (job->document, index);
+}
+
+static void
+ev_window_clear_find_index_job (EvWindow *ev_window)
+{
+	if (ev_window->priv->find_index_job != NULL) {
+		if (!ev_job_is_finished (ev_window->priv->find_index_job))
+			ev_job_cancel (ev_window->priv->find_index_job);
+
+		g_signal_handlers_disconnect_by_func (ev_window->priv->find_index_job,
+						      ev_window_find_index_job_cb, ev_window);
+		g_object_unref (ev_window->priv->find_index_job);
+		ev_window->priv->find_index_job = NULL;
+	}
+}
+
+/* Searches fall back to scanning every page until the index is ready.
+ * Remote documents are copied to a different temporary file every time,
+ * so they are not indexed.
+ */
+static void
+ev_window_start_find_index_job (EvWindow *ev_window)
+{
+	EvDocument *document = ev_window->priv->document;
+
+	ev_window_clear_find_index_job (ev_window);
+
+	if (ev_window->priv->local_uri ||
+	    ev_find_index_get_for_document (document) ||
+	    !ev_find_index_is_supported (document))
+		return;
+
+	ev_window->priv->find_index_job = ev_job_find_index_new (document);
+	ev_job_set_background (ev_window->priv->find_index_job, TRUE);
+	g_signal_connect (ev_window->priv->find_index_job, "finished",
+			  G_CALLBACK (ev_window_find_index_job_cb),
+			  ev_window);
+	ev_job_scheduler_push_job (ev_window->priv->find_index_job, EV_JOB_PRIORITY_NONE);
+}
+
 static gboolean
 ev_window_setup_document (EvWindow *ev_window)
 {
@@ -1490,6 +1639,8 @@ ev_window_setup_document (EvWindow *ev_window)
 	info = ev_document_get_info (document);
 	update_document_mode (ev_window, info->mode);
 
+	ev_window_start_find_index_job (ev_window);
+
 	if (ev_window->priv->search_string && EV_IS_DOCUMENT_FIND (document) &&
 	    !EV_WINDOW_IS_PRESENTATION (ev_window)) {
 		GtkSearchEntry *entry;
@@ -1535,6 +1686,8 @@ ev_window_set_document (EvWindow *ev_window, EvDocument *document)
 	if (ev_window->priv->document == document)
 		return;
 
+	ev_window_clear_find_index_job (ev_window);
+
 	if (ev_window->priv->document)
 		g_object_unref (ev_window->priv->document);
 	ev_window->priv->document = g_object_ref (document);
@@ -1598,14 +1751,27 @@ ev_window_password_view_unlock (EvWindow *ev_window)
 	ev_job_scheduler_push_job (ev_window->priv->load_job, EV_JOB_PRIORITY_NONE);
 }
 
+static void ev_window_load_stream_job_cb (EvJob    *job,
+					  EvWindow *ev_window);
+
 static void
 ev_window_clear_load_job (EvWindow *ev_window)
 {
+	if (ev_window->priv->stream_load_job != NULL) {
+		if (!ev_job_is_finished (ev_window->priv->stream_load_job))
+			ev_job_cancel (ev_window->priv->stream_load_job);
+
+		g_signal_handlers_disconnect_by_func (ev_window->priv->stream_load_job, ev_window_load_stream_job_cb, ev_window);
+		g_object_unref (ev_window->priv->stream_load_job);
+		ev_window->priv->stream_load_job = NULL;
+	}
+
 	if (ev_window->priv->load_job != NULL) {
 		if (!ev_job_is_finished (ev_window->priv->load_job))
 			ev_job_cancel (ev_window->priv->load_job);
 		
 		g_signal_handlers_disconnect_by_func (ev_window->priv->load_job, ev_window_load_job_cb, ev_window);
+		g_signal_handlers_disconnect_by_func (ev_window->priv->load_job, ev_window_load_job_updated_cb, ev_window);
 		g_object_unref (ev_window->priv->load_job);
 		ev_window->priv->load_job = NULL;
 	}
@@ -1658,6 +1824,64 @@ ev_window_handle_link (EvWindow *ev_window,
  * ev_window->priv->password_{uri,document}, and thus people who call this
  * function should _not_ necessarily expect those to exist after being
  * called. */
+static void
+ev_window_document_loaded (EvWindow    *ev_window,
+			   EvDocument  *document,
+			   const gchar *password)
+{
+	ev_document_model_set_document (ev_window->priv->model, document);
+
+#ifdef ENABLE_DBUS
+	ev_window_emit_doc_loaded (ev_window);
+#endif
+	setup_chrome_from_metadata (ev_window);
+	setup_document_from_metadata (ev_window);
+	setup_view_from_metadata (ev_window);
+
+	ev_window_add_recent (ev_window, ev_window->priv->uri);
+
+	ev_window_title_set_type (ev_window->priv->title,
+				  EV_WINDOW_TITLE_DOCUMENT);
+	if (password) {
+		GPasswordSave flags;
+
+		flags = ev_password_view_get_password_save_flags (
+			EV_PASSWORD_VIEW (ev_window->priv->password_view));
+		ev_keyring_save_password (ev_window->priv->uri,
+					  password,
+					  flags);
+	}
+
+	ev_window_handle_link (ev_window, ev_window->priv->dest);
+	g_clear_object (&ev_window->priv->dest);
+
+	switch (ev_window->priv->window_mode) {
+	        case EV_WINDOW_MODE_FULLSCREEN:
+			ev_window_run_fullscreen (ev_window);
+			break;
+	        case EV_WINDOW_MODE_PRESENTATION:
+			ev_window_run_presentation (ev_window);
+			break;
+	        default:
+			break;
+	}
+
+	/* Create a monitor for the document */
+	ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
+	g_signal_connect_swapped (ev_window->priv->monitor, "changed",
+				  G_CALLBACK (ev_window_file_changed),
+				  ev_window);
+}
+
+static void
+ev_window_load_job_updated_cb (EvJobLoad *job,
+			       gdouble    progress,
+			       EvWindow  *ev_window)
+{
+	ev_loading_message_set_fraction (EV_LOADING_MESSAGE (ev_window->priv->loading_message),
+					 progress);
+}
+
 static void
 ev_window_load_job_cb (EvJob *job,
 		       gpointer data)
@@ -1670,54 +1894,32 @@ ev_window_load_job_cb (EvJob *job,
 
 	g_assert (job_load->uri);
 
+	/* Handled once the metadata has been read */
+	if (ev_window->priv->metadata_cancellable)
+		return;
+
 	ev_window_hide_loading_message (ev_window);
 
 	/* Success! */
 	if (!ev_job_is_failed (job)) {
-		ev_document_model_set_document (ev_window->priv->model, document);
-
-#ifdef ENABLE_DBUS
-		ev_window_emit_doc_loaded (ev_window);
-#endif
-		setup_chrome_from_metadata (ev_window);
-		setup_document_from_metadata (ev_window);
-		setup_view_from_metadata (ev_window);
-
-		ev_window_add_recent (ev_window, ev_window->priv->uri);
-
-		ev_window_title_set_type (ev_window->priv->title,
-					  EV_WINDOW_TITLE_DOCUMENT);
-		if (job_load->password) {
-			GPasswordSave flags;
-
-			flags = ev_password_view_get_password_save_flags (
-				EV_PASSWORD_VIEW (ev_window->priv->password_view));
-			ev_keyring_save_password (ev_window->priv->uri,
-						  job_load->password,
-						  flags);
-		}
-
-		ev_window_handle_link (ev_window, ev_window->priv->dest);
-		g_clear_object (&ev_window->priv->dest);
+		EvDocument *shared = NULL;
 
-		switch (ev_window->priv->window_mode) {
-		        case EV_WINDOW_MODE_FULLSCREEN:
-				ev_window_run_fullscreen (ev_window);
-				break;
-		        case EV_WINDOW_MODE_PRESENTATION:
-				ev_window_run_presentation (ev_window);
-				break;
-		        default:
-				break;
+		/* Documents unlocked with a password are not shared.
+		 * Prefer the document of another window showing the
+		 * same contents, so that only one is kept in memory.
+		 */
+		if (!job_load->password) {
+			shared = ev_application_get_shared_document (EV_APP, ev_window->priv->uri,
+								     ev_document_get_fingerprint (document));
+			if (!shared)
+				ev_application_share_document (EV_APP, ev_window->priv->uri, document);
 		}
 
-		/* Create a monitor for the document */
-		ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
-		g_signal_connect_swapped (ev_window->priv->monitor, "changed",
-					  G_CALLBACK (ev_window_file_changed),
-					  ev_window);
-		
+		ev_window_document_loaded (ev_window, shared ? shared : document,
+					   job_load->password);
 		ev_window_clear_load_job (ev_window);
+		if (shared)
+			g_object_unref (shared);
 		return;
 	}
 
@@ -1769,6 +1971,25 @@ ev_window_load_job_cb (EvJob *job,
 	}	
 }
 
+static void
+ev_window_document_reloaded (EvWindow   *ev_window,
+			     EvDocument *document)
+{
+	ev_document_model_set_document (ev_window->priv->model,
+					document);
+	if (ev_window->priv->dest) {
+		ev_window_handle_link (ev_window, ev_window->priv->dest);
+		g_clear_object (&ev_window->priv->dest);
+	}
+
+	/* Restart the search after reloading */
+	if (gtk_search_bar_get_search_mode (GTK_SEARCH_BAR (ev_window->priv->search_bar)))
+		ev_search_box_restart (EV_SEARCH_BOX (ev_window->priv->search_box));
+
+	ev_window_clear_reload_job (ev_window);
+	ev_window->priv->in_reload = FALSE;
+}
+
 static void
 ev_window_reload_job_cb (EvJob    *job,
 			 EvWindow *ev_window)
@@ -1784,19 +2005,8 @@ ev_window_reload_job_cb (EvJob    *job,
 		return;
 	}
 
-	ev_document_model_set_document (ev_window->priv->model,
-					job->document);
-	if (ev_window->priv->dest) {
-		ev_window_handle_link (ev_window, ev_window->priv->dest);
-		g_clear_object (&ev_window->priv->dest);
-	}
-
-	/* Restart the search after reloading */
-	if (gtk_search_bar_get_search_mode (GTK_SEARCH_BAR (ev_window->priv->search_bar)))
-		ev_search_box_restart (EV_SEARCH_BOX (ev_window->priv->search_box));
-
-	ev_window_clear_reload_job (ev_window);
-	ev_window->priv->in_reload = FALSE;
+	ev_application_share_document (EV_APP, ev_window->priv->uri, job->document);
+	ev_window_document_reloaded (ev_window, job->document);
 }
 
 /**
@@ -2105,6 +2315,252 @@ ev_window_load_file_remote (EvWindow *ev_window,
 					 (GSourceFunc)show_loading_progress);
 }
 
+/* Remote documents that the backend can read with seeks, like PDF
+ * files over HTTP with range requests, are loaded directly from the
+ * remote file, so that the first pages are shown before the whole
+ * document is downloaded. Other documents, or encrypted ones, are
+ * copied to a temporary file first.
+ */
+static void
+ev_window_load_stream_job_cb (EvJob    *job,
+			      EvWindow *ev_window)
+{
+	GFile *source_file;
+
+	if (!ev_job_is_failed (job)) {
+		ev_window_hide_loading_message (ev_window);
+		ev_window->priv->remote_streamed = TRUE;
+		ev_window_document_loaded (ev_window, job->document, NULL);
+		ev_window_clear_load_job (ev_window);
+		return;
+	}
+
+	if (g_error_matches (job->error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		ev_window_hide_loading_message (ev_window);
+		ev_window_clear_load_job (ev_window);
+		return;
+	}
+
+	source_file = g_object_ref (EV_JOB_LOAD_GFILE (job)->gfile);
+	g_signal_handlers_disconnect_by_func (job, ev_window_load_stream_job_cb, ev_window);
+	g_object_unref (ev_window->priv->stream_load_job);
+	ev_window->priv->stream_load_job = NULL;
+
+	ev_window_hide_loading_message (ev_window);
+	ev_window_load_file_remote (ev_window, source_file);
+}
+
+static void
+ev_window_load_file_remote_stream (EvWindow *ev_window,
+				   GFile    *source_file)
+{
+	ev_window->priv->stream_load_job = ev_job_load_gfile_new (source_file,
+								  EV_DOCUMENT_LOAD_FLAG_NONE);
+	g_signal_connect (ev_window->priv->stream_load_job, "finished",
+			  G_CALLBACK (ev_window_load_stream_job_cb),
+			  ev_window);
+	g_object_unref (source_file);
+
+	ev_window_show_loading_message (ev_window);
+	ev_job_scheduler_push_job (ev_window->priv->stream_load_job, EV_JOB_PRIORITY_NONE);
+}
+
+/* The first page is rendered by the worker that loaded the document,
+ * right after loading it, while the main loop sets up the window. The
+ * scale is guessed from the size of the view, the page is shown as a
+ * preview until the view renders it at its actual scale.
+ */
+typedef struct {
+	volatile gint ref_count;
+	GWeakRef      window;
+	gint          page;
+	gint          rotation;
+	EvSizingMode  sizing_mode;
+	gdouble       scale;
+	gint          width;
+	gint          height;
+} EvFirstRender;
+
+static EvFirstRender *
+ev_first_render_ref (EvFirstRender *first)
+{
+	g_atomic_int_inc (&first->ref_count);
+
+	return first;
+}
+
+static void
+ev_first_render_unref (EvFirstRender *first)
+{
+	if (!g_atomic_int_dec_and_test (&first->ref_count))
+		return;
+
+	g_weak_ref_clear (&first->window);
+	g_slice_free (EvFirstRender, first);
+}
+
+static void
+ev_window_first_page_rendered_cb (EvJobRender   *job,
+				  EvFirstRender *first)
+{
+	EvWindow   *ev_window;
+	EvDocument *document;
+
+	ev_window = g_weak_ref_get (&first->window);
+	if (!ev_window)
+		return;
+
+	/* The document could have been replaced by the one of another
+	 * window with the same contents */
+	document = ev_window->priv->document;
+	if (!ev_job_is_failed (EV_JOB (job)) && document &&
+	    g_strcmp0 (ev_document_get_uri (document),
+		       ev_document_get_uri (EV_JOB (job)->document)) == 0) {
+		ev_view_set_page_preview (EV_VIEW (ev_window->priv->view),
+					  job->page, job->rotation,
+					  job->surface);
+	}
+
+	g_object_unref (ev_window);
+}
+
+/* Runs in the worker, it must not touch the window */
+static void
+ev_window_render_first_page (EvJob         *job,
+			     EvFirstRender *first)
+{
+	EvDocument *document = job->document;
+	EvJob      *render;
+	gdouble     page_width, page_height;
+	gdouble     scale;
+	gint        width, height;
+
+	if (first->page >= ev_document_get_n_pages (document))
+		return;
+
+	ev_document_get_page_size (document, first->page, &page_width, &page_height);
+	if (first->rotation == 90 || first->rotation == 270) {
+		gdouble tmp = page_width;
+
+		page_width = page_height;
+		page_height = tmp;
+	}
+
+	switch (first->sizing_mode) {
+	case EV_SIZING_FREE:
+		scale = first->scale;
+		break;
+	case EV_SIZING_FIT_PAGE:
+		scale = MIN (first->width / page_width, first->height / page_height);
+		break;
+	case EV_SIZING_AUTOMATIC:
+		scale = MIN (first->width / page_width, first->scale);
+		break;
+	case EV_SIZING_FIT_WIDTH:
+	default:
+		scale = first->width / page_width;
+		break;
+	}
+
+	width = MAX (1, (gint) (page_width * scale + 0.5));
+	height = MAX (1, (gint) (page_height * scale + 0.5));
+
+	render = ev_job_render_new (document, first->page, first->rotation,
+				    scale, width, height);
+	g_signal_connect_data (render, "finished",
+			       G_CALLBACK (ev_window_first_page_rendered_cb),
+			       ev_first_render_ref (first),
+			       (GClosureNotify) ev_first_render_unref, 0);
+	ev_job_scheduler_push_job (render, EV_JOB_PRIORITY_URGENT);
+	g_object_unref (render);
+}
+
+static void
+ev_window_chain_first_render (EvWindow *ev_window,
+			      EvJob    *load_job)
+{
+	EvFirstRender *first;
+	gint           width, height;
+
+	width = gtk_widget_get_allocated_width (ev_window->priv->view);
+	height = gtk_widget_get_allocated_height (ev_window->priv->view);
+	if (width <= 1 || height <= 1)
+		gtk_window_get_size (GTK_WINDOW (ev_window), &width, &height);
+
+	first = g_slice_new (EvFirstRender);
+	first->ref_count = 1;
+	g_weak_ref_init (&first->window, ev_window);
+	first->page = MAX (0, ev_document_model_get_page (ev_window->priv->model));
+	first->rotation = ev_document_model_get_rotation (ev_window->priv->model);
+	first->sizing_mode = ev_document_model_get_sizing_mode (ev_window->priv->model);
+	first->scale = first->sizing_mode == EV_SIZING_FREE ?
+		ev_document_model_get_scale (ev_window->priv->model) :
+		get_screen_dpi (ev_window) / 72.0;
+	first->width = width;
+	first->height = height;
+
+	ev_job_then (load_job, (EvJobThenFunc) ev_window_render_first_page,
+		     first, (GDestroyNotify) ev_first_render_unref);
+}
+
+static void
+ev_window_clear_metadata_query (EvWindow *ev_window)
+{
+	if (ev_window->priv->metadata_cancellable) {
+		g_cancellable_cancel (ev_window->priv->metadata_cancellable);
+		g_clear_object (&ev_window->priv->metadata_cancellable);
+	}
+	g_clear_object (&ev_window->priv->pending_document);
+}
+
+static void
+ev_window_metadata_ready_cb (GFile        *file,
+			     GAsyncResult *result,
+			     EvWindow     *ev_window)
+{
+	EvMetadata *metadata;
+	GError     *error = NULL;
+
+	metadata = ev_metadata_new_finish (result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The window may be gone already */
+		g_error_free (error);
+		return;
+	}
+	g_clear_error (&error);
+
+	g_clear_object (&ev_window->priv->metadata_cancellable);
+
+	ev_window->priv->metadata = metadata;
+	if (metadata) {
+		ev_window_init_metadata_with_default_values (ev_window);
+
+		ev_window->priv->bookmarks = ev_bookmarks_new (metadata);
+		ev_sidebar_bookmarks_set_bookmarks (EV_SIDEBAR_BOOKMARKS (ev_window->priv->sidebar_bookmarks),
+						    ev_window->priv->bookmarks);
+		g_signal_connect_swapped (ev_window->priv->bookmarks, "changed",
+					  G_CALLBACK (ev_window_setup_bookmarks),
+					  ev_window);
+		ev_window_setup_bookmarks (ev_window);
+	}
+
+	/* Applied in a single model update */
+	setup_size_from_metadata (ev_window);
+	setup_model_from_metadata (ev_window);
+
+	/* The document was ready first */
+	if (ev_window->priv->pending_document) {
+		EvDocument *document = ev_window->priv->pending_document;
+
+		ev_window->priv->pending_document = NULL;
+		ev_window_document_loaded (ev_window, document, NULL);
+		g_object_unref (document);
+	} else if (ev_window->priv->load_job &&
+		   ev_job_is_finished (ev_window->priv->load_job)) {
+		ev_window_load_job_cb (ev_window->priv->load_job, ev_window);
+	}
+}
+
 void
 ev_window_open_uri (EvWindow       *ev_window,
 		    const char     *uri,
@@ -2134,6 +2590,7 @@ ev_window_open_uri (EvWindow       *ev_window,
 	ev_window_close_dialogs (ev_window);
 	ev_window_clear_load_job (ev_window);
 	ev_window_clear_local_uri (ev_window);
+	ev_window_clear_metadata_query (ev_window);
 
 	ev_window->priv->window_mode = mode;
 
@@ -2141,46 +2598,49 @@ ev_window_open_uri (EvWindow       *ev_window,
 		g_free (ev_window->priv->uri);
 	ev_window->priv->uri = g_strdup (uri);
 
-	if (ev_window->priv->metadata)
-		g_object_unref (ev_window->priv->metadata);
-	if (ev_window->priv->bookmarks)
-		g_object_unref (ev_window->priv->bookmarks);
-
-	source_file = g_file_new_for_uri (uri);
-	if (ev_is_metadata_supported_for_file (source_file)) {
-		ev_window->priv->metadata = ev_metadata_new (source_file);
-		ev_window_init_metadata_with_default_values (ev_window);
-	} else {
-		ev_window->priv->metadata = NULL;
-	}
-
-	if (ev_window->priv->metadata) {
-		ev_window->priv->bookmarks = ev_bookmarks_new (ev_window->priv->metadata);
-		ev_sidebar_bookmarks_set_bookmarks (EV_SIDEBAR_BOOKMARKS (ev_window->priv->sidebar_bookmarks),
-						    ev_window->priv->bookmarks);
-		g_signal_connect_swapped (ev_window->priv->bookmarks, "changed",
-					  G_CALLBACK (ev_window_setup_bookmarks),
-					  ev_window);
-		ev_window_setup_bookmarks (ev_window);
-	} else {
-		ev_window->priv->bookmarks = NULL;
-	}
+	g_clear_object (&ev_window->priv->metadata);
+	g_clear_object (&ev_window->priv->bookmarks);
 
 	if (ev_window->priv->dest)
 		g_object_unref (ev_window->priv->dest);
 	ev_window->priv->dest = dest ? g_object_ref (dest) : NULL;
 
-	setup_size_from_metadata (ev_window);
-	setup_model_from_metadata (ev_window);
+	/* The metadata is read while the document loads */
+	source_file = g_file_new_for_uri (uri);
+	ev_window->priv->metadata_cancellable = g_cancellable_new ();
+	ev_metadata_new_async (source_file,
+			       ev_window->priv->metadata_cancellable,
+			       (GAsyncReadyCallback) ev_window_metadata_ready_cb,
+			       ev_window);
+
+	/* Reuse the document if another window has already loaded it */
+	if (g_file_is_native (source_file)) {
+		EvDocument *document;
+
+		document = ev_application_get_shared_document (EV_APP, uri, NULL);
+		if (document) {
+			g_object_unref (source_file);
+			ev_window->priv->pending_document = document;
+			return;
+		}
+	}
 
 	ev_window->priv->load_job = ev_job_load_new (uri);
 	g_signal_connect (ev_window->priv->load_job,
 			  "finished",
 			  G_CALLBACK (ev_window_load_job_cb),
 			  ev_window);
+	g_signal_connect (ev_window->priv->load_job,
+			  "updated",
+			  G_CALLBACK (ev_window_load_job_updated_cb),
+			  ev_window);
+	/* Without a destination the page to open is already known */
+	if (!ev_window->priv->dest)
+		ev_window_chain_first_render (ev_window, ev_window->priv->load_job);
 
+	ev_window->priv->remote_streamed = FALSE;
 	if (!g_file_is_native (source_file) && !ev_window->priv->local_uri) {
-		ev_window_load_file_remote (ev_window, source_file);
+		ev_window_load_file_remote_stream (ev_window, source_file);
 	} else {
 		ev_window_show_loading_message (ev_window);
 		g_object_unref (source_file);
@@ -2201,6 +2661,7 @@ ev_window_open_document (EvWindow       *ev_window,
 	ev_window_close_dialogs (ev_window);
 	ev_window_clear_load_job (ev_window);
 	ev_window_clear_local_uri (ev_window);
+	ev_window_clear_metadata_query (ev_window);
 
 	if (ev_window->priv->monitor) {
 		g_object_unref (ev_window->priv->monitor);
@@ -2210,6 +2671,7 @@ ev_window_open_document (EvWindow       *ev_window,
 	if (ev_window->priv->uri)
 		g_free (ev_window->priv->uri);
 	ev_window->priv->uri = g_strdup (ev_document_get_uri (document));
+	ev_window->priv->remote_streamed = FALSE;
 
 	setup_size_from_metadata (ev_window);
 	setup_model_from_metadata (ev_window);
@@ -2257,9 +2719,19 @@ ev_window_open_document (EvWindow       *ev_window,
 				  ev_window);
 }
 
+static void
+recent_search_entry_changed_cb (GtkSearchEntry *entry,
+				EvRecentView   *recent_view)
+{
+	ev_recent_view_set_search_text (recent_view,
+					gtk_entry_get_text (GTK_ENTRY (entry)));
+}
+
 void
 ev_window_open_recent_view (EvWindow *ev_window)
 {
+	GtkWidget *search_entry;
+
 	if (ev_window->priv->recent_view)
 		return;
 
@@ -2270,6 +2742,29 @@ ev_window_open_recent_view (EvWindow *ev_window)
 				 "item-activated",
 				 G_CALLBACK (recent_view_item_activated_cb),
 				 ev_window, 0);
+	g_signal_connect_object (ev_window->priv->recent_view,
+				 "hit-activated",
+				 G_CALLBACK (recent_view_hit_activated_cb),
+				 ev_window, 0);
+
+	/* Typing searches the indexes of the recent documents */
+	search_entry = gtk_search_entry_new ();
+	gtk_entry_set_width_chars (GTK_ENTRY (search_entry), 32);
+	g_signal_connect_object (search_entry, "search-changed",
+				 G_CALLBACK (recent_search_entry_changed_cb),
+				 ev_window->priv->recent_view, 0);
+	gtk_widget_show (search_entry);
+
+	ev_window->priv->recent_search_bar = gtk_search_bar_new ();
+	gtk_search_bar_set_show_close_button (GTK_SEARCH_BAR (ev_window->priv->recent_search_bar), TRUE);
+	gtk_container_add (GTK_CONTAINER (ev_window->priv->recent_search_bar), search_entry);
+	gtk_search_bar_connect_entry (GTK_SEARCH_BAR (ev_window->priv->recent_search_bar),
+				      GTK_ENTRY (search_entry));
+	gtk_box_pack_start (GTK_BOX (ev_window->priv->main_box),
+			    ev_window->priv->recent_search_bar,
+			    FALSE, TRUE, 0);
+	gtk_widget_show (ev_window->priv->recent_search_bar);
+
 	gtk_box_pack_start (GTK_BOX (ev_window->priv->main_box),
 			    GTK_WIDGET (ev_window->priv->recent_view),
 			    TRUE, TRUE, 0);
@@ -2290,6 +2785,8 @@ ev_window_destroy_recent_view (EvWindow *ev_window)
 
 	gtk_widget_destroy (GTK_WIDGET (ev_window->priv->recent_view));
 	ev_window->priv->recent_view = NULL;
+	gtk_widget_destroy (ev_window->priv->recent_search_bar);
+	ev_window->priv->recent_search_bar = NULL;
 	gtk_widget_show (ev_window->priv->hpaned);
 }
 
@@ -2299,7 +2796,30 @@ ev_window_reload_local (EvWindow *ev_window)
 	const gchar *uri;
 	
 	uri = ev_window->priv->local_uri ? ev_window->priv->local_uri : ev_window->priv->uri;
-	ev_window->priv->reload_job = ev_job_load_new (uri);
+
+	/* Another window showing the document may have already
+	 * reloaded it after the same change */
+	if (!ev_window->priv->local_uri) {
+		EvDocument *document;
+
+		document = ev_application_get_shared_document (EV_APP, uri, NULL);
+		if (document && document != ev_window->priv->document) {
+			ev_window_document_reloaded (ev_window, document);
+			g_object_unref (document);
+			return;
+		}
+		if (document)
+			g_object_unref (document);
+	}
+
+	if (ev_window->priv->remote_streamed) {
+		GFile *file = g_file_new_for_uri (uri);
+
+		ev_window->priv->reload_job = ev_job_load_gfile_new (file, EV_DOCUMENT_LOAD_FLAG_NONE);
+		g_object_unref (file);
+	} else {
+		ev_window->priv->reload_job = ev_job_load_new (uri);
+	}
 	g_signal_connect (ev_window->priv->reload_job, "finished",
 			  G_CALLBACK (ev_window_reload_job_cb),
 			  ev_window);
@@ -3870,9 +4390,11 @@ ev_window_cmd_view_zoom (GSimpleAction *action,
 	EvWindow *ev_window = user_data;
 	gdouble zoom = g_variant_get_double (parameter);
 
+	ev_document_model_freeze (ev_window->priv->model);
 	ev_document_model_set_sizing_mode (ev_window->priv->model, EV_SIZING_FREE);
 	ev_document_model_set_scale (ev_window->priv->model,
 				     zoom * get_screen_dpi (ev_window) / 72.0);
+	ev_document_model_thaw (ev_window->priv->model);
 }
 
 static void
@@ -4319,6 +4841,9 @@ ev_window_run_presentation (EvWindow *window)
 								    current_page,
 								    rotation,
 								    inverted_colors);
+	ev_view_presentation_set_prerender_size (EV_VIEW_PRESENTATION (window->priv->presentation_view),
+						 g_settings_get_uint (ev_window_ensure_settings (window),
+								      GS_PRESENTATION_PRERENDER_SIZE));
 	g_signal_connect_swapped (window->priv->presentation_view, "finished",
 				  G_CALLBACK (ev_window_view_presentation_finished),
 				  window);
@@ -5169,6 +5694,25 @@ find_sidebar_result_activated_cb (EvFindSidebar *find_sidebar,
 	ev_view_find_set_result (EV_VIEW (window->priv->view), page, result);
 }
 
+static void
+recent_view_hit_activated_cb (EvRecentView *recent_view,
+                              const char   *uri,
+                              gint          page,
+                              EvWindow     *ev_window)
+{
+	GtkWidget  *entry;
+	EvLinkDest *dest;
+
+	entry = gtk_bin_get_child (GTK_BIN (ev_window->priv->recent_search_bar));
+	dest = ev_link_dest_new_page (page);
+	ev_application_open_uri_at_dest (EV_APP, uri,
+					 gtk_window_get_screen (GTK_WINDOW (ev_window)),
+					 dest, 0,
+					 gtk_entry_get_text (GTK_ENTRY (entry)),
+					 gtk_get_current_event_time ());
+	g_object_unref (dest);
+}
+
 static void
 recent_view_item_activated_cb (EvRecentView *recent_view,
                                const char   *uri,
@@ -5476,6 +6020,8 @@ ev_window_dispose (GObject *object)
 	}
 #endif /* ENABLE_DBUS */
 
+	ev_window_clear_metadata_query (window);
+
 	if (priv->bookmarks) {
 		g_object_unref (priv->bookmarks);
 		priv->bookmarks = NULL;
@@ -5546,6 +6092,7 @@ ev_window_dispose (GObject *object)
 	}
 	
 	if (priv->view) {
+		ev_job_scheduler_set_client_weight (priv->view, 0);
 		g_object_unref (priv->view);
 		priv->view = NULL;
 	}
@@ -5567,6 +6114,8 @@ ev_window_dispose (GObject *object)
 		ev_window_clear_save_job (window);
 	}
 
+	ev_window_clear_find_index_job (window);
+
 	if (priv->local_uri) {
 		ev_window_clear_local_uri (window);
 		priv->local_uri = NULL;
@@ -5658,6 +6207,12 @@ ev_window_key_press_event (GtkWidget   *widget,
 	if (gtk_window_activate_key (window, event))
 		return TRUE;
 
+	/* Typing in the recent view starts a search */
+	if (EV_WINDOW (widget)->priv->recent_search_bar &&
+	    gtk_search_bar_handle_event (GTK_SEARCH_BAR (EV_WINDOW (widget)->priv->recent_search_bar),
+					 (GdkEvent *) event))
+		return TRUE;
+
         /* Chain up, invokes binding set on window */
 	return GTK_WIDGET_CLASS (grand_parent_class)->key_press_event (widget, event);
 }
@@ -5783,6 +6338,19 @@ activate_link_cb (GObject *object, EvLink *link, EvWindow *window)
 	gtk_widget_grab_focus (window->priv->view);
 }
 
+/* Going back and forth in the history is instant when the pages of
+ * the nearest entries are kept rendered */
+static void
+ev_window_pin_history_pages (EvWindow *window)
+{
+	gint  *pages;
+	guint  n_pages;
+
+	pages = ev_history_get_pages (window->priv->history, HISTORY_PINNED_PAGES, &n_pages);
+	ev_view_set_pinned_pages (EV_VIEW (window->priv->view), pages, n_pages);
+	g_free (pages);
+}
+
 static void
 history_changed_cb (EvHistory *history,
                     EvWindow  *window)
@@ -5791,13 +6359,19 @@ history_changed_cb (EvHistory *history,
 				      ev_history_can_go_back (window->priv->history));
 	ev_window_set_action_enabled (window, "go-forward-history",
 				      ev_history_can_go_forward (window->priv->history));
+
+	ev_window_pin_history_pages (window);
 }
 
 static void
 sidebar_layers_visibility_changed (EvSidebarLayers *layers,
+				   EvLayer         *layer,
 				   EvWindow        *window)
 {
-	ev_view_reload (EV_VIEW (window->priv->view));
+	GList list = { layer, NULL, NULL };
+
+	ev_view_reload_layers (EV_VIEW (window->priv->view), &list);
+	ev_sidebar_thumbnails_reload_layers (EV_SIDEBAR_THUMBNAILS (window->priv->sidebar_thumbs), &list);
 }
 
 static void
@@ -5833,6 +6407,14 @@ view_annot_removed (EvView       *view,
 	ev_sidebar_annotations_annot_removed (EV_SIDEBAR_ANNOTATIONS (window->priv->sidebar_annots));
 }
 
+static void
+view_page_edited_cb (EvView   *view,
+		     gint      page,
+		     EvWindow *window)
+{
+	ev_application_page_edited (EV_APP, window, window->priv->document, page);
+}
+
 static void
 ev_window_cancel_add_annot(EvWindow *window)
 {
@@ -5895,6 +6477,30 @@ window_state_event_cb (EvWindow *window, GdkEventWindowState *event, gpointer du
 	return FALSE;
 }
 
+/* Windows in the background get a smaller share of the scheduler
+ * workers, and keep fewer rendered pages around the visible ones */
+static void
+window_is_active_changed_cb (EvWindow   *window,
+			     GParamSpec *pspec,
+			     gpointer    dummy)
+{
+	gboolean is_active;
+	guint    inactive_cache_mb = 0;
+
+	if (!window->priv->view)
+		return;
+
+	is_active = gtk_window_is_active (GTK_WINDOW (window));
+	ev_job_scheduler_set_client_weight (window->priv->view,
+					    is_active ? ACTIVE_WINDOW_JOB_WEIGHT : 0);
+
+	if (!is_active)
+		inactive_cache_mb = g_settings_get_uint (ev_window_ensure_settings (window),
+							 GS_INACTIVE_PAGE_CACHE_SIZE);
+	ev_view_set_page_cache_limit (EV_VIEW (window->priv->view),
+				      (gsize) inactive_cache_mb * 1024 * 1024);
+}
+
 static gboolean
 window_configure_event_cb (EvWindow *window, GdkEventConfigure *event, gpointer dummy)
 {
@@ -6206,6 +6812,20 @@ create_file_from_uri_for_format (const gchar     *uri,
 	return target_file;
 }
 
+static gboolean
+pixbuf_format_has_mime_type (GdkPixbufFormat *format,
+			     const gchar     *mime_type)
+{
+	gchar  **mime_types;
+	gboolean retval;
+
+	mime_types = gdk_pixbuf_format_get_mime_types (format);
+	retval = g_strv_contains ((const gchar * const *) mime_types, mime_type);
+	g_strfreev (mime_types);
+
+	return retval;
+}
+
 static void
 image_save_dialog_response_cb (GtkWidget *fc,
 			       gint       response_id,
@@ -6220,6 +6840,8 @@ image_save_dialog_response_cb (GtkWidget *fc,
 	gchar           *file_format;
 	GdkPixbufFormat *format;
 	GtkFileFilter   *filter;
+	GBytes          *data = NULL;
+	gchar           *mime_type = NULL;
 	
 	if (response_id != GTK_RESPONSE_OK) {
 		gtk_widget_destroy (fc);
@@ -6268,15 +6890,32 @@ image_save_dialog_response_cb (GtkWidget *fc,
                         goto has_error;
 	}
 
-	ev_document_doc_mutex_lock ();
-	pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (ev_window->priv->document),
-					       ev_window->priv->image);
-	ev_document_doc_mutex_unlock ();
+	ev_document_lock (ev_window->priv->document);
+	data = ev_document_images_get_image_data (EV_DOCUMENT_IMAGES (ev_window->priv->document),
+						  ev_window->priv->image,
+						  &mime_type);
+	ev_document_unlock (ev_window->priv->document);
 
-	file_format = gdk_pixbuf_format_get_name (format);
-	gdk_pixbuf_save (pixbuf, filename, file_format, &error, NULL);
-	g_free (file_format);
-	g_object_unref (pixbuf);
+	/* Save the image as it's in the document when it's already
+	 * in the chosen format, instead of encoding it again */
+	if (data && pixbuf_format_has_mime_type (format, mime_type)) {
+		g_file_set_contents (filename,
+				     (const gchar *) g_bytes_get_data (data, NULL),
+				     g_bytes_get_size (data),
+				     &error);
+	} else {
+		ev_document_lock (ev_window->priv->document);
+		pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (ev_window->priv->document),
+						       ev_window->priv->image);
+		ev_document_unlock (ev_window->priv->document);
+
+		file_format = gdk_pixbuf_format_get_name (format);
+		gdk_pixbuf_save (pixbuf, filename, file_format, &error, NULL);
+		g_free (file_format);
+		g_object_unref (pixbuf);
+	}
+	g_clear_pointer (&data, g_bytes_unref);
+	g_free (mime_type);
 	
     has_error:
 	if (error) {
@@ -6345,24 +6984,117 @@ ev_window_popup_cmd_save_image_as (GSimpleAction *action,
 	gtk_widget_show (fc);
 }
 
+typedef struct {
+	EvDocument *document;
+	EvImage    *image;
+	GBytes     *data;
+	GdkPixbuf  *pixbuf;
+} EvClipboardImage;
+
+enum {
+	CLIPBOARD_IMAGE_TARGET_DATA,
+	CLIPBOARD_IMAGE_TARGET_PIXBUF
+};
+
+static void
+clipboard_image_get_cb (GtkClipboard     *clipboard,
+			GtkSelectionData *selection_data,
+			guint             info,
+			gpointer          user_data)
+{
+	EvClipboardImage *clipboard_image = user_data;
+
+	if (info == CLIPBOARD_IMAGE_TARGET_DATA) {
+		gtk_selection_data_set (selection_data,
+					gtk_selection_data_get_target (selection_data),
+					8,
+					(const guchar *) g_bytes_get_data (clipboard_image->data, NULL),
+					g_bytes_get_size (clipboard_image->data));
+		return;
+	}
+
+	/* Other formats are only decoded when they are asked for */
+	if (!clipboard_image->pixbuf) {
+		ev_document_lock (clipboard_image->document);
+		clipboard_image->pixbuf =
+			ev_document_images_get_image (EV_DOCUMENT_IMAGES (clipboard_image->document),
+						      clipboard_image->image);
+		ev_document_unlock (clipboard_image->document);
+	}
+
+	if (clipboard_image->pixbuf)
+		gtk_selection_data_set_pixbuf (selection_data, clipboard_image->pixbuf);
+}
+
+static void
+clipboard_image_clear_cb (GtkClipboard *clipboard,
+			  gpointer      user_data)
+{
+	EvClipboardImage *clipboard_image = user_data;
+
+	g_object_unref (clipboard_image->document);
+	g_object_unref (clipboard_image->image);
+	g_bytes_unref (clipboard_image->data);
+	g_clear_object (&clipboard_image->pixbuf);
+	g_slice_free (EvClipboardImage, clipboard_image);
+}
+
 static void
 ev_window_popup_cmd_copy_image (GSimpleAction *action,
 				GVariant      *parameter,
 				gpointer       user_data)
 {
-	GtkClipboard *clipboard;
-	GdkPixbuf    *pixbuf;
-	EvWindow     *window = user_data;
+	GtkClipboard     *clipboard;
+	GdkPixbuf        *pixbuf;
+	GBytes           *data;
+	gchar            *mime_type;
+	EvWindow         *window = user_data;
+	EvClipboardImage *clipboard_image;
+	GtkTargetList    *target_list;
+	GtkTargetEntry   *targets;
+	gint              n_targets;
 
 	if (!window->priv->image)
 		return;
 	
 	clipboard = gtk_widget_get_clipboard (GTK_WIDGET (window),
 					      GDK_SELECTION_CLIPBOARD);
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (window->priv->document);
+	data = ev_document_images_get_image_data (EV_DOCUMENT_IMAGES (window->priv->document),
+						  window->priv->image,
+						  &mime_type);
+	ev_document_unlock (window->priv->document);
+
+	/* Offer the image as it's in the document, and leave the
+	 * decoding for the applications asking for other formats */
+	if (data) {
+		clipboard_image = g_slice_new0 (EvClipboardImage);
+		clipboard_image->document = EV_DOCUMENT (g_object_ref (window->priv->document));
+		clipboard_image->image = EV_IMAGE (g_object_ref (window->priv->image));
+		clipboard_image->data = data;
+
+		target_list = gtk_target_list_new (NULL, 0);
+		gtk_target_list_add (target_list, gdk_atom_intern (mime_type, FALSE),
+				     0, CLIPBOARD_IMAGE_TARGET_DATA);
+		g_free (mime_type);
+		gtk_target_list_add_image_targets (target_list, CLIPBOARD_IMAGE_TARGET_PIXBUF, TRUE);
+		targets = gtk_target_table_new_from_list (target_list, &n_targets);
+		gtk_target_list_unref (target_list);
+
+		if (!gtk_clipboard_set_with_data (clipboard, targets, n_targets,
+						  clipboard_image_get_cb,
+						  clipboard_image_clear_cb,
+						  clipboard_image))
+			clipboard_image_clear_cb (clipboard, clipboard_image);
+		gtk_target_table_free (targets, n_targets);
+
+		return;
+	}
+
+	ev_document_lock (window->priv->document);
 	pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (window->priv->document),
 					       window->priv->image);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (window->priv->document);
 	
 	gtk_clipboard_set_image (clipboard, pixbuf);
 	g_object_unref (pixbuf);
@@ -6427,14 +7159,16 @@ ev_window_popup_cmd_annot_properties (GSimpleAction *action,
 	}
 
 	if (mask != EV_ANNOTATIONS_SAVE_NONE) {
-		ev_document_doc_mutex_lock ();
+		ev_document_lock (window->priv->document);
 		ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (window->priv->document),
 							 window->priv->annot,
 							 mask);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (window->priv->document);
 
 		/* FIXME: update annot region only */
 		ev_view_reload (EV_VIEW (window->priv->view));
+		ev_application_page_edited (EV_APP, window, window->priv->document,
+					    ev_annotation_get_page_index (window->priv->annot));
 	}
 
 	gtk_widget_destroy (GTK_WIDGET (dialog));
@@ -6732,6 +7466,226 @@ handle_sync_view_cb (EvEvinceWindow        *object,
 
 	return TRUE;
 }
+
+typedef struct {
+	EvEvinceWindow        *skeleton;
+	GDBusMethodInvocation *invocation;
+} EvRenderPageRequest;
+
+static gint
+ev_window_create_shared_memory (gsize    size,
+				GError **error)
+{
+	gint fd;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create ("evince-page", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd == -1) {
+		gint errsv = errno;
+
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "Failed to create shared memory: %s",
+			     g_strerror (errsv));
+		return -1;
+	}
+#else
+	gchar *path = NULL;
+
+	/* Nobody else can open the file once it has been unlinked, so
+	 * it ends up as private as a memfd.
+	 */
+	fd = g_file_open_tmp ("evince-page-XXXXXX", &path, error);
+	if (fd == -1)
+		return -1;
+	g_unlink (path);
+	g_free (path);
+#endif
+
+	if (ftruncate (fd, size) == -1) {
+		gint errsv = errno;
+
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "Failed to resize shared memory: %s",
+			     g_strerror (errsv));
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void
+ev_window_complete_render_page (EvEvinceWindow        *skeleton,
+				GDBusMethodInvocation *invocation,
+				cairo_surface_t       *surface,
+				gboolean               cached)
+{
+	GUnixFDList     *fd_list;
+	GVariantBuilder  metadata;
+	GError          *error = NULL;
+	guchar          *data;
+	gsize            size;
+	gint             width, height, stride;
+	gint             fd;
+
+	/* Both the pixbuf cache and render jobs hand out image surfaces */
+	cairo_surface_flush (surface);
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	stride = cairo_image_surface_get_stride (surface);
+	data = cairo_image_surface_get_data (surface);
+	size = (gsize) stride * height;
+
+	fd = ev_window_create_shared_memory (size, &error);
+	if (fd == -1) {
+		g_dbus_method_invocation_take_error (invocation, error);
+		return;
+	}
+
+	if (size > 0) {
+		guchar *map;
+
+		map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED) {
+			gint errsv = errno;
+
+			g_dbus_method_invocation_return_error (invocation, G_IO_ERROR,
+							       g_io_error_from_errno (errsv),
+							       "Failed to map shared memory: %s",
+							       g_strerror (errsv));
+			close (fd);
+			return;
+		}
+		memcpy (map, data, size);
+		munmap (map, size);
+	}
+
+#if defined (HAVE_MEMFD_CREATE) && defined (F_ADD_SEALS)
+	/* Let the caller mmap the buffer without trusting us not to
+	 * shrink it under its feet.
+	 */
+	fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+
+	fd_list = g_unix_fd_list_new_from_array (&fd, 1);
+
+	g_variant_builder_init (&metadata, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&metadata, "{sv}", "width", g_variant_new_int32 (width));
+	g_variant_builder_add (&metadata, "{sv}", "height", g_variant_new_int32 (height));
+	g_variant_builder_add (&metadata, "{sv}", "stride", g_variant_new_int32 (stride));
+	g_variant_builder_add (&metadata, "{sv}", "format",
+			       g_variant_new_uint32 (cairo_image_surface_get_format (surface)));
+	g_variant_builder_add (&metadata, "{sv}", "cached", g_variant_new_boolean (cached));
+
+	ev_evince_window_complete_render_page (skeleton, invocation, fd_list,
+					       g_variant_new_handle (0),
+					       g_variant_builder_end (&metadata));
+	g_object_unref (fd_list);
+}
+
+static void
+render_page_job_finished_cb (EvJobRender         *job,
+			     EvRenderPageRequest *request)
+{
+	if (ev_job_is_failed (EV_JOB (job))) {
+		g_dbus_method_invocation_return_gerror (request->invocation,
+							EV_JOB (job)->error);
+	} else {
+		ev_window_complete_render_page (request->skeleton,
+						request->invocation,
+						job->surface, FALSE);
+	}
+
+	g_object_unref (request->skeleton);
+	g_slice_free (EvRenderPageRequest, request);
+	g_object_unref (job);
+}
+
+static gboolean
+handle_render_page_cb (EvEvinceWindow        *object,
+		       GDBusMethodInvocation *invocation,
+		       GUnixFDList           *fd_list,
+		       gint                   page,
+		       gdouble                scale,
+		       gint                   rotation,
+		       EvWindow              *window)
+{
+	EvDocument          *document = window->priv->document;
+	EvRenderPageRequest *request;
+	EvJob               *job;
+	gdouble              page_width, page_height;
+	gint                 width, height;
+
+	if (!document || page < 0 || page >= ev_document_get_n_pages (document)) {
+		g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+						       G_DBUS_ERROR_INVALID_ARGS,
+						       "No page %d in the document", page);
+		return TRUE;
+	}
+
+	if (scale <= 0 || scale > ev_document_model_get_max_scale (window->priv->model)) {
+		g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+						       G_DBUS_ERROR_INVALID_ARGS,
+						       "Invalid scale %f", scale);
+		return TRUE;
+	}
+
+	if (rotation % 90 != 0) {
+		g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+						       G_DBUS_ERROR_INVALID_ARGS,
+						       "Invalid rotation %d", rotation);
+		return TRUE;
+	}
+	rotation = ((rotation % 360) + 360) % 360;
+
+	ev_document_get_page_size (document, page, &page_width, &page_height);
+	width = (gint)(page_width * scale + 0.5);
+	height = (gint)(page_height * scale + 0.5);
+	if (rotation == 90 || rotation == 270) {
+		gint tmp = width;
+
+		width = height;
+		height = tmp;
+	}
+
+	/* The pixbuf cache only holds pages at the scale and rotation
+	 * of the view, so anything else has to be rendered.
+	 */
+	if (scale == ev_document_model_get_scale (window->priv->model) &&
+	    rotation == ev_document_model_get_rotation (window->priv->model)) {
+		cairo_surface_t *surface;
+
+		surface = ev_view_get_page_surface (EV_VIEW (window->priv->view), page);
+		if (surface) {
+			gdouble device_scale_x = 1, device_scale_y = 1;
+
+#ifdef HAVE_HIDPI_SUPPORT
+			cairo_surface_get_device_scale (surface, &device_scale_x, &device_scale_y);
+#endif
+			/* Only hand out the cached page if it is exactly
+			 * what a render job would have produced.
+			 */
+			if (device_scale_x == 1 && device_scale_y == 1 &&
+			    cairo_image_surface_get_width (surface) == width &&
+			    cairo_image_surface_get_height (surface) == height) {
+				ev_window_complete_render_page (object, invocation, surface, TRUE);
+				return TRUE;
+			}
+		}
+	}
+
+	request = g_slice_new (EvRenderPageRequest);
+	request->skeleton = g_object_ref (object);
+	request->invocation = invocation;
+
+	job = ev_job_render_new (document, page, rotation, scale, width, height);
+	g_signal_connect (job, "finished",
+			  G_CALLBACK (render_page_job_finished_cb),
+			  request);
+	ev_job_scheduler_push_job (job, EV_JOB_PRIORITY_HIGH);
+
+	return TRUE;
+}
 #endif /* ENABLE_DBUS */
 
 static gboolean
@@ -6800,6 +7754,8 @@ ev_window_init (EvWindow *ev_window)
 			  G_CALLBACK (window_configure_event_cb), NULL);
 	g_signal_connect (ev_window, "window_state_event",
 			  G_CALLBACK (window_state_event_cb), NULL);
+	g_signal_connect (ev_window, "notify::is-active",
+			  G_CALLBACK (window_is_active_changed_cb), NULL);
 
 	ev_window->priv = EV_WINDOW_GET_PRIVATE (ev_window);
 
@@ -6819,6 +7775,9 @@ ev_window_init (EvWindow *ev_window)
 			g_signal_connect (skeleton, "handle-sync-view",
 					  G_CALLBACK (handle_sync_view_cb),
 					  ev_window);
+			g_signal_connect (skeleton, "handle-render-page",
+					  G_CALLBACK (handle_render_page_cb),
+					  ev_window);
                 } else {
                         g_printerr ("Failed to register bus object %s: %s\n",
 				    ev_window->priv->dbus_object_path, error->message);
@@ -7028,6 +7987,8 @@ ev_window_init (EvWindow *ev_window)
 	gtk_widget_show (ev_window->priv->view_box);
 
 	ev_window->priv->view = ev_view_new ();
+	ev_sidebar_thumbnails_set_view (EV_SIDEBAR_THUMBNAILS (ev_window->priv->sidebar_thumbs),
+					EV_VIEW (ev_window->priv->view));
 	page_cache_mb = g_settings_get_uint (ev_window_ensure_settings (ev_window),
 					     GS_PAGE_CACHE_SIZE);
 	ev_view_set_page_cache_size (EV_VIEW (ev_window->priv->view),
@@ -7036,6 +7997,15 @@ ev_window_init (EvWindow *ev_window)
 				     GS_ALLOW_LINKS_CHANGE_ZOOM);
 	ev_view_set_allow_links_change_zoom (EV_VIEW (ev_window->priv->view),
 				     allow_links_change_zoom);
+	ev_view_set_vector_selection (EV_VIEW (ev_window->priv->view),
+				      g_settings_get_boolean (ev_window_ensure_settings (ev_window),
+							      GS_VECTOR_SELECTION));
+	ev_view_set_device_scale (EV_VIEW (ev_window->priv->view),
+				  g_settings_get_double (ev_window_ensure_settings (ev_window),
+							 GS_DEVICE_SCALE));
+	ev_view_set_render_cache_size (EV_VIEW (ev_window->priv->view),
+				       (gsize) g_settings_get_uint (ev_window_ensure_settings (ev_window),
+								    GS_RENDER_CACHE_SIZE) * 1024 * 1024);
 	ev_view_set_model (EV_VIEW (ev_window->priv->view), ev_window->priv->model);
 
 	ev_window->priv->password_view = ev_password_view_new (GTK_WINDOW (ev_window));
@@ -7067,6 +8037,9 @@ ev_window_init (EvWindow *ev_window)
 	g_signal_connect_object (ev_window->priv->view, "layers-changed",
 				 G_CALLBACK (view_layers_changed_cb),
 				 ev_window, 0);
+	g_signal_connect_object (ev_window->priv->view, "page-edited",
+				 G_CALLBACK (view_page_edited_cb),
+				 ev_window, 0);
 	g_signal_connect_object (ev_window->priv->view, "notify::is-loading",
 				 G_CALLBACK (view_is_loading_changed_cb),
 				 ev_window, 0);
@@ -7277,3 +8250,15 @@ ev_window_focus_view (EvWindow *ev_window)
 
 	gtk_widget_grab_focus (ev_window->priv->view);
 }
+
+/* The document is shared with another window, where the forms or
+ * annotations of page were edited */
+void
+ev_window_reload_edited_page (EvWindow *ev_window,
+			      gint      page)
+{
+	g_return_if_fail (EV_WINDOW (ev_window));
+
+	ev_view_reload_edited_page (EV_VIEW (ev_window->priv->view), page);
+	ev_sidebar_annotations_annot_removed (EV_SIDEBAR_ANNOTATIONS (ev_window->priv->sidebar_annots));
+}
@@ -32,6 +32,15 @@
 #include "ev-file-helpers.h"
 #include "ev-stock-icons.h"
 #include "ev-metadata.h"
+#include "ev-memory-stats.h"
+#include "ev-open-timings.h"
+#include "ev-watchdog.h"
+
+#ifdef G_OS_UNIX
+#include <signal.h>
+#include <unistd.h>
+#include <glib-unix.h>
+#endif
 
 #ifdef G_OS_WIN32
 #include <io.h>
@@ -50,6 +59,7 @@ static gboolean preview_mode = FALSE;
 static gboolean fullscreen_mode = FALSE;
 static gboolean presentation_mode = FALSE;
 static gboolean unlink_temp_file = FALSE;
+static gboolean prewarm_mode = FALSE;
 static gchar   *print_settings;
 static const char **file_arguments = NULL;
 
@@ -77,6 +87,7 @@ static const GOptionEntry goption_options[] =
 	{ "find", 'l', 0, G_OPTION_ARG_STRING, &ev_find_string, N_("The word or phrase to find in the document"), N_("STRING")},
 	{ "unlink-tempfile", 'u', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &unlink_temp_file, NULL, NULL },
 	{ "print-settings", 't', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME, &print_settings, NULL, NULL },
+	{ "prewarm", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &prewarm_mode, NULL, NULL },
 	{ "version", 0, G_OPTION_FLAG_NO_ARG | G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_CALLBACK, option_version_cb, NULL, NULL },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, N_("[FILE…]") },
 	{ NULL }
@@ -226,6 +237,35 @@ load_files (const char **files)
         }
 }
 
+#ifdef G_OS_UNIX
+/* Prints the memory used by every subsystem to stderr, so that memory
+ * growth can be attributed with kill -USR1 */
+static gboolean
+dump_memory_stats_cb (gpointer user_data)
+{
+	GVariant     *stats;
+	GVariantIter  iter;
+	const gchar  *subsystem;
+	guint64       bytes, total = 0;
+	guint32       n_entries;
+
+	stats = g_variant_ref_sink (ev_memory_stats_get ());
+
+	g_printerr ("Memory used by %s[%d]:\n", g_get_prgname (), (gint) getpid ());
+	g_variant_iter_init (&iter, stats);
+	while (g_variant_iter_next (&iter, "{&s(tu)}", &subsystem, &bytes, &n_entries)) {
+		g_printerr ("  %-24s %12" G_GUINT64_FORMAT " bytes in %u entries\n",
+			    subsystem, bytes, n_entries);
+		total += bytes;
+	}
+	g_printerr ("  %-24s %12" G_GUINT64_FORMAT " bytes\n", "total", total);
+
+	g_variant_unref (stats);
+
+	return G_SOURCE_CONTINUE;
+}
+#endif
+
 int
 main (int argc, char *argv[])
 {
@@ -234,6 +274,8 @@ main (int argc, char *argv[])
 	GError         *error = NULL;
         int             status;
 
+	ev_open_timings_mark ("process-start");
+
 #ifdef G_OS_WIN32
 
     if (fileno (stdout) != -1 &&
@@ -306,7 +348,16 @@ main (int argc, char *argv[])
                 goto done;
         }
 
-	load_files (file_arguments);
+#ifdef G_OS_UNIX
+	g_unix_signal_add (SIGUSR1, dump_memory_stats_cb, NULL);
+#endif
+	ev_watchdog_init ();
+
+	/* Started by the daemon to wait for a document */
+	if (prewarm_mode)
+		ev_application_prewarm (application);
+	else
+		load_files (file_arguments);
 
 	/* Change directory so we don't prevent unmounting in case the initial cwd
 	 * is on an external device (see bug #575436)
@@ -316,6 +367,7 @@ main (int argc, char *argv[])
 	status = g_application_run (G_APPLICATION (application), 0, NULL);
 
     done:
+	ev_watchdog_shutdown ();
 	ev_shutdown ();
 	ev_stock_icons_shutdown ();
 
@@ -0,0 +1,544 @@
+/*
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <gio/gio.h>
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Times the operations the viewer does on the documents of a corpus,
+ * through the installed backends, and writes the results as JSON, one
+ * object per document, so that they can be compared between releases.
+ * Times are in seconds. With --metrics, the figures checked by
+ * evince-perf-gate are also added to a key file, in a group per
+ * document.
+ */
+
+#define DEFAULT_SCALES "0.5,1,2"
+#define DEFAULT_FIND_TEXT "the"
+#define THUMBNAIL_SIZE 128
+
+static gchar *scales_option = NULL;
+static gchar *find_text = NULL;
+static gint max_pages = 0;
+static gchar *output_path = NULL;
+static gchar *metrics_path = NULL;
+static const gchar **file_arguments;
+static GKeyFile *metrics = NULL;
+
+static const GOptionEntry goption_options[] = {
+	{ "scales", 's', 0, G_OPTION_ARG_STRING, &scales_option, "Comma separated scales of the render sweeps (" DEFAULT_SCALES " by default)", "SCALES" },
+	{ "find", 'f', 0, G_OPTION_ARG_STRING, &find_text, "Text to find (\"" DEFAULT_FIND_TEXT "\" by default)", "TEXT" },
+	{ "pages", 'p', 0, G_OPTION_ARG_INT, &max_pages, "Maximum number of pages of the sweeps, all by default", "N" },
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path, "Write the results to FILE instead of stdout", "FILE" },
+	{ "metrics", 'm', 0, G_OPTION_ARG_FILENAME, &metrics_path, "Add the metrics of the regression gate to the key file FILE", "FILE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<file or directory>..." },
+	{ NULL }
+};
+
+static void
+json_append_string (GString     *json,
+		    const gchar *str)
+{
+	const gchar *p;
+
+	if (!str) {
+		g_string_append (json, "null");
+		return;
+	}
+
+	g_string_append_c (json, '"');
+	for (p = str; *p; p++) {
+		switch (*p) {
+		case '"':
+			g_string_append (json, "\\\"");
+			break;
+		case '\\':
+			g_string_append (json, "\\\\");
+			break;
+		case '\n':
+			g_string_append (json, "\\n");
+			break;
+		case '\t':
+			g_string_append (json, "\\t");
+			break;
+		default:
+			if ((guchar) *p < 0x20)
+				g_string_append_printf (json, "\\u%04x", (guchar) *p);
+			else
+				g_string_append_c (json, *p);
+		}
+	}
+	g_string_append_c (json, '"');
+}
+
+static void
+json_append_double (GString *json,
+		    gdouble  value)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+	g_string_append (json, g_ascii_formatd (buffer, sizeof (buffer), "%.6f", value));
+}
+
+/* Returns the time appended */
+static gdouble
+json_append_time (GString     *json,
+		  const gchar *name,
+		  gint64       start)
+{
+	gdouble time = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+	g_string_append_printf (json, ", \"%s\": ", name);
+	json_append_double (json, time);
+
+	return time;
+}
+
+static void
+metrics_set (const gchar *group,
+	     const gchar *key,
+	     gdouble      value)
+{
+	if (metrics)
+		g_key_file_set_double (metrics, group, key, value);
+}
+
+static cairo_surface_t *
+render_page (EvDocument *document,
+	     gint        index,
+	     gdouble     scale)
+{
+	EvPage          *page;
+	EvRenderContext *rc;
+	cairo_surface_t *surface;
+
+	ev_document_lock (document);
+	page = ev_document_get_page (document, index);
+	rc = ev_render_context_new (page, 0, scale);
+	surface = ev_document_render (document, rc);
+	g_object_unref (rc);
+	g_object_unref (page);
+	ev_document_unlock (document);
+
+	return surface;
+}
+
+/* Returns the pages rendered per second over all the sweeps */
+static gdouble
+benchmark_renders (GString    *json,
+		   EvDocument *document,
+		   gint        n_pages,
+		   gdouble    *scales,
+		   guint       n_scales)
+{
+	gdouble total = 0;
+	gint    n_rendered = 0;
+	guint   i;
+	gint    j;
+
+	g_string_append (json, ", \"render\": [");
+	for (i = 0; i < n_scales; i++) {
+		gint64 start = g_get_monotonic_time ();
+		gint   n_failed = 0;
+
+		for (j = 0; j < n_pages; j++) {
+			cairo_surface_t *surface = render_page (document, j, scales[i]);
+
+			if (surface)
+				cairo_surface_destroy (surface);
+			else
+				n_failed++;
+		}
+		n_rendered += n_pages - n_failed;
+
+		g_string_append (json, i > 0 ? ", {\"scale\": " : "{\"scale\": ");
+		json_append_double (json, scales[i]);
+		g_string_append_printf (json, ", \"pages\": %d, \"failed\": %d", n_pages, n_failed);
+		total += json_append_time (json, "time", start);
+		g_string_append_c (json, '}');
+	}
+	g_string_append_c (json, ']');
+
+	return total > 0 ? n_rendered / total : 0;
+}
+
+static void
+benchmark_thumbnails (GString    *json,
+		      EvDocument *document,
+		      gint        n_pages)
+{
+	gint64 start = g_get_monotonic_time ();
+	gint   i;
+
+	for (i = 0; i < n_pages; i++) {
+		EvRenderContext *rc;
+		EvPage          *page;
+		GdkPixbuf       *pixbuf;
+		gdouble          width, height;
+
+		ev_document_get_page_size (document, i, &width, &height);
+
+		ev_document_lock (document);
+		page = ev_document_get_page (document, i);
+		rc = ev_render_context_new (page, 0, THUMBNAIL_SIZE / MAX (width, height));
+		ev_render_context_set_draft (rc, TRUE);
+		pixbuf = ev_document_get_thumbnail (document, rc);
+		g_object_unref (rc);
+		g_object_unref (page);
+		ev_document_unlock (document);
+
+		if (pixbuf)
+			g_object_unref (pixbuf);
+	}
+
+	g_string_append_printf (json, ", \"thumbnails\": {\"pages\": %d", n_pages);
+	json_append_time (json, "time", start);
+	g_string_append_c (json, '}');
+}
+
+static void
+benchmark_text (GString    *json,
+		EvDocument *document,
+		gint        n_pages)
+{
+	gint64 start = g_get_monotonic_time ();
+	gsize  length = 0;
+	gint   i;
+
+	for (i = 0; i < n_pages; i++) {
+		EvPage *page;
+		gchar  *text;
+
+		ev_document_lock (document);
+		page = ev_document_get_page (document, i);
+		text = ev_document_text_get_text (EV_DOCUMENT_TEXT (document), page);
+		g_object_unref (page);
+		ev_document_unlock (document);
+
+		if (text)
+			length += strlen (text);
+		g_free (text);
+	}
+
+	g_string_append_printf (json, ", \"text\": {\"pages\": %d, \"bytes\": %" G_GSIZE_FORMAT,
+				n_pages, length);
+	json_append_time (json, "time", start);
+	g_string_append_c (json, '}');
+}
+
+static void
+benchmark_find (GString    *json,
+		EvDocument *document,
+		gint        n_pages)
+{
+	gint64 start = g_get_monotonic_time ();
+	guint  n_matches = 0;
+	gint   i;
+
+	for (i = 0; i < n_pages; i++) {
+		EvPage *page;
+		GList  *matches;
+
+		ev_document_lock (document);
+		page = ev_document_get_page (document, i);
+		matches = ev_document_find_find_text_with_options (EV_DOCUMENT_FIND (document),
+								   page, find_text,
+								   EV_FIND_DEFAULT);
+		g_object_unref (page);
+		ev_document_unlock (document);
+
+		n_matches += g_list_length (matches);
+		g_list_free_full (matches, (GDestroyNotify) ev_rectangle_free);
+	}
+
+	g_string_append (json, ", \"find\": {\"text\": ");
+	json_append_string (json, find_text);
+	g_string_append_printf (json, ", \"pages\": %d, \"matches\": %u", n_pages, n_matches);
+	json_append_time (json, "time", start);
+	g_string_append_c (json, '}');
+}
+
+static void
+benchmark_document (GString     *json,
+		    const gchar *path,
+		    gdouble     *scales,
+		    guint        n_scales)
+{
+	EvDocument           *document;
+	EvDocumentBackendInfo info;
+	cairo_surface_t      *surface;
+	GFile                *file;
+	GError               *error = NULL;
+	gchar                *uri;
+	gchar                *basename;
+	gchar                *group;
+	gint64                start, load_start;
+	gdouble               load_time;
+	gint                  n_pages, n_swept;
+	gint                  i;
+
+	file = g_file_new_for_commandline_arg (path);
+	uri = g_file_get_uri (file);
+	basename = g_file_get_basename (file);
+	group = g_strdup_printf ("benchmark %s", basename);
+	g_free (basename);
+	g_object_unref (file);
+
+	g_string_append (json, "{\"uri\": ");
+	json_append_string (json, uri);
+
+	load_start = g_get_monotonic_time ();
+	document = ev_document_factory_get_document (uri, &error);
+	g_free (uri);
+	if (!document) {
+		g_string_append (json, ", \"error\": ");
+		json_append_string (json, error->message);
+		g_string_append_c (json, '}');
+		g_error_free (error);
+		g_free (group);
+
+		return;
+	}
+	load_time = json_append_time (json, "load", load_start);
+	metrics_set (group, "load", load_time);
+
+	if (ev_document_get_backend_info (document, &info)) {
+		g_string_append (json, ", \"backend\": ");
+		json_append_string (json, info.name);
+	}
+
+	n_pages = ev_document_get_n_pages (document);
+	n_swept = max_pages > 0 ? MIN (max_pages, n_pages) : n_pages;
+	g_string_append_printf (json, ", \"pages\": %d", n_pages);
+
+	/* Asks for all the page sizes as the view does to lay the pages
+	 * out. The sizes of large documents are probed in the background
+	 * after loading, so this only has to wait for the cache lock */
+	start = g_get_monotonic_time ();
+	for (i = 0; i < n_pages; i++) {
+		gdouble width, height;
+
+		ev_document_get_page_size (document, i, &width, &height);
+	}
+	ev_document_check_dimensions (document);
+	json_append_time (json, "cache", start);
+
+	if (n_pages > 0) {
+		start = g_get_monotonic_time ();
+		surface = render_page (document, 0, 1.0);
+		json_append_time (json, "first_page", start);
+		if (surface)
+			cairo_surface_destroy (surface);
+		/* From the start of the load, including the page sizes */
+		metrics_set (group, "time-to-first-page",
+			     (g_get_monotonic_time () - load_start) / (gdouble) G_USEC_PER_SEC);
+
+		metrics_set (group, "render-pages-per-second",
+			     benchmark_renders (json, document, n_swept, scales, n_scales));
+		benchmark_thumbnails (json, document, n_swept);
+		if (EV_IS_DOCUMENT_TEXT (document))
+			benchmark_text (json, document, n_swept);
+		if (EV_IS_DOCUMENT_FIND (document))
+			benchmark_find (json, document, n_swept);
+	}
+
+	g_string_append_c (json, '}');
+	g_object_unref (document);
+	g_free (group);
+}
+
+static void
+collect_files (const gchar *path,
+	       GPtrArray   *files)
+{
+	GDir        *dir;
+	const gchar *name;
+	GPtrArray   *children;
+	guint        i;
+
+	if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+		g_ptr_array_add (files, g_strdup (path));
+		return;
+	}
+
+	dir = g_dir_open (path, 0, NULL);
+	if (!dir)
+		return;
+
+	/* Sorted, so that runs can be compared */
+	children = g_ptr_array_new_with_free_func (g_free);
+	while ((name = g_dir_read_name (dir))) {
+		if (name[0] != '.')
+			g_ptr_array_add (children, g_build_filename (path, name, NULL));
+	}
+	g_dir_close (dir);
+
+	g_ptr_array_sort (children, (GCompareFunc) g_strcmp0);
+	for (i = 0; i < children->len; i++)
+		collect_files (g_ptr_array_index (children, i), files);
+	g_ptr_array_free (children, TRUE);
+}
+
+static gdouble *
+parse_scales (const gchar *option,
+	      guint       *n_scales)
+{
+	gchar  **values;
+	gdouble *scales;
+	guint    i;
+
+	values = g_strsplit (option, ",", -1);
+	*n_scales = g_strv_length (values);
+	scales = g_new (gdouble, *n_scales);
+	for (i = 0; i < *n_scales; i++) {
+		gchar *end;
+
+		scales[i] = g_ascii_strtod (values[i], &end);
+		if (end == values[i] || *end != '\0' || scales[i] <= 0) {
+			g_strfreev (values);
+			g_free (scales);
+			return NULL;
+		}
+	}
+	g_strfreev (values);
+
+	return scales;
+}
+
+static void
+print_usage (GOptionContext *context)
+{
+	gchar *help;
+
+	help = g_option_context_get_help (context, TRUE, NULL);
+	g_print ("%s", help);
+	g_free (help);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GPtrArray      *files;
+	GString        *json;
+	GError         *error = NULL;
+	gdouble        *scales;
+	guint           n_scales;
+	guint           i;
+	gboolean        written;
+
+	setlocale (LC_ALL, "");
+
+	context = g_option_context_new ("- Benchmark the document backends");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	if (!file_arguments || !file_arguments[0]) {
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+	g_option_context_free (context);
+
+	scales = parse_scales (scales_option ? scales_option : DEFAULT_SCALES, &n_scales);
+	if (!scales) {
+		g_printerr ("Invalid scales: %s\n", scales_option);
+		return -1;
+	}
+	if (!find_text)
+		find_text = g_strdup (DEFAULT_FIND_TEXT);
+
+	if (!ev_init ())
+		return -1;
+
+	/* Metrics are added to the file, which may have others already */
+	if (metrics_path) {
+		metrics = g_key_file_new ();
+		if (!g_key_file_load_from_file (metrics, metrics_path, G_KEY_FILE_KEEP_COMMENTS, &error)) {
+			if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+				g_printerr ("Error reading metrics: %s\n", error->message);
+				g_error_free (error);
+				g_key_file_free (metrics);
+				ev_shutdown ();
+
+				return -1;
+			}
+			g_clear_error (&error);
+		}
+	}
+
+	files = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; file_arguments[i]; i++)
+		collect_files (file_arguments[i], files);
+
+	json = g_string_new ("{\"version\": ");
+	json_append_string (json, VERSION);
+	g_string_append (json, ", \"documents\": [\n");
+	for (i = 0; i < files->len; i++) {
+		if (i > 0)
+			g_string_append (json, ",\n");
+		g_string_append (json, "  ");
+		benchmark_document (json, g_ptr_array_index (files, i), scales, n_scales);
+	}
+	g_string_append (json, "\n]}\n");
+
+	if (output_path) {
+		written = g_file_set_contents (output_path, json->str, json->len, &error);
+		if (!written) {
+			g_printerr ("Error writing results: %s\n", error->message);
+			g_error_free (error);
+		}
+	} else {
+		written = fwrite (json->str, 1, json->len, stdout) == json->len;
+	}
+
+	if (metrics) {
+		gchar *data;
+		gsize  length;
+
+		data = g_key_file_to_data (metrics, &length, NULL);
+		if (!g_file_set_contents (metrics_path, data, length, &error)) {
+			g_printerr ("Error writing metrics: %s\n", error->message);
+			g_error_free (error);
+			written = FALSE;
+		}
+		g_free (data);
+		g_key_file_free (metrics);
+	}
+
+	g_string_free (json, TRUE);
+	g_ptr_array_free (files, TRUE);
+	g_free (scales);
+	ev_shutdown ();
+
+	return written ? 0 : -2;
+}
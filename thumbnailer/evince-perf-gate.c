@@ -0,0 +1,269 @@
+/*
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+
+#include <glib.h>
+
+#include <locale.h>
+#include <string.h>
+
+/* Compares the metrics written by evince-benchmark and
+ * test-ev-view-replay with --metrics to a baseline with the same
+ * layout, and fails when any of them regressed by more than the
+ * threshold. Metrics ending in -per-second are better when higher,
+ * the others, times, frames and memory, when lower. The [gate] group
+ * of the baseline may set the threshold of a metric, in percent, by
+ * its name. Metrics of the baseline missing from the results are
+ * regressions too, like a document that failed to load, and a
+ * baseline without any metrics fails the check. With --update, the
+ * results are written to the baseline instead, keeping its comments
+ * and thresholds.
+ */
+
+#define DEFAULT_THRESHOLD 10.0
+#define GATE_GROUP "gate"
+
+static gdouble threshold = DEFAULT_THRESHOLD;
+static gboolean update = FALSE;
+static const gchar **file_arguments;
+
+static const GOptionEntry goption_options[] = {
+	{ "threshold", 't', 0, G_OPTION_ARG_DOUBLE, &threshold, "Regression allowed, in percent (10 by default)", "PERCENT" },
+	{ "update", 'u', 0, G_OPTION_ARG_NONE, &update, "Write the results to the baseline", NULL },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<baseline> <results>" },
+	{ NULL }
+};
+
+static GKeyFile *
+load_metrics (const gchar *path)
+{
+	GKeyFile *metrics;
+	GError   *error = NULL;
+
+	metrics = g_key_file_new ();
+	if (!g_key_file_load_from_file (metrics, path, G_KEY_FILE_KEEP_COMMENTS, &error)) {
+		g_printerr ("Error reading %s: %s\n", path, error->message);
+		g_error_free (error);
+		g_key_file_free (metrics);
+
+		return NULL;
+	}
+
+	return metrics;
+}
+
+static gdouble
+get_threshold (GKeyFile    *baseline,
+	       const gchar *key)
+{
+	GError *error = NULL;
+	gdouble value;
+
+	value = g_key_file_get_double (baseline, GATE_GROUP, key, &error);
+	if (error) {
+		g_error_free (error);
+		return threshold;
+	}
+
+	return value;
+}
+
+/* Returns the number of regressions of the metrics of group */
+static guint
+check_group (GKeyFile    *baseline,
+	     GKeyFile    *results,
+	     const gchar *group)
+{
+	gchar **keys;
+	guint   n_regressions = 0;
+	guint   i;
+
+	keys = g_key_file_get_keys (baseline, group, NULL, NULL);
+	for (i = 0; keys && keys[i]; i++) {
+		GError  *error = NULL;
+		gdouble  reference, value, change, allowed;
+		gboolean higher_is_better;
+		gboolean regressed;
+
+		reference = g_key_file_get_double (baseline, group, keys[i], &error);
+		if (error) {
+			g_printerr ("Invalid baseline of %s in [%s]: %s\n", keys[i], group, error->message);
+			g_clear_error (&error);
+			continue;
+		}
+
+		value = g_key_file_get_double (results, group, keys[i], &error);
+		if (error) {
+			g_print ("%-32s %-24s %14g %14s %9s  REGRESSED\n",
+				 group, keys[i], reference, "missing", "");
+			g_clear_error (&error);
+			n_regressions++;
+			continue;
+		}
+
+		higher_is_better = g_str_has_suffix (keys[i], "-per-second");
+		allowed = get_threshold (baseline, keys[i]) / 100.0;
+		if (higher_is_better)
+			regressed = value < reference * (1 - allowed);
+		else
+			regressed = value > reference * (1 + allowed);
+
+		change = reference != 0 ? (value - reference) / ABS (reference) * 100 : 0;
+		g_print ("%-32s %-24s %14g %14g %+8.1f%%  %s\n",
+			 group, keys[i], reference, value, change,
+			 regressed ? "REGRESSED" : "ok");
+		if (regressed)
+			n_regressions++;
+	}
+	g_strfreev (keys);
+
+	return n_regressions;
+}
+
+static gboolean
+update_baseline (GKeyFile    *baseline,
+		 GKeyFile    *results,
+		 const gchar *path)
+{
+	GError  *error = NULL;
+	gchar  **groups;
+	gchar   *data;
+	gsize    length;
+	gboolean retval;
+	guint    i, j;
+
+	groups = g_key_file_get_groups (results, NULL);
+	for (i = 0; groups[i]; i++) {
+		gchar **keys;
+
+		if (strcmp (groups[i], GATE_GROUP) == 0)
+			continue;
+
+		keys = g_key_file_get_keys (results, groups[i], NULL, NULL);
+		for (j = 0; keys && keys[j]; j++) {
+			gchar *value = g_key_file_get_value (results, groups[i], keys[j], NULL);
+
+			g_key_file_set_value (baseline, groups[i], keys[j], value);
+			g_free (value);
+		}
+		g_strfreev (keys);
+	}
+	g_strfreev (groups);
+
+	data = g_key_file_to_data (baseline, &length, NULL);
+	retval = g_file_set_contents (path, data, length, &error);
+	if (!retval) {
+		g_printerr ("Error writing %s: %s\n", path, error->message);
+		g_error_free (error);
+	}
+	g_free (data);
+
+	return retval;
+}
+
+static void
+print_usage (GOptionContext *context)
+{
+	gchar *help;
+
+	help = g_option_context_get_help (context, TRUE, NULL);
+	g_print ("%s", help);
+	g_free (help);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GKeyFile       *baseline, *results;
+	GError         *error = NULL;
+	gchar         **groups;
+	guint           n_checked = 0;
+	guint           n_regressions = 0;
+	guint           i;
+
+	setlocale (LC_ALL, "");
+
+	context = g_option_context_new ("- Check performance metrics against a baseline");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	if (!file_arguments || g_strv_length ((gchar **) file_arguments) != 2) {
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+	g_option_context_free (context);
+
+	baseline = load_metrics (file_arguments[0]);
+	if (!baseline)
+		return -1;
+
+	results = load_metrics (file_arguments[1]);
+	if (!results) {
+		g_key_file_free (baseline);
+		return -1;
+	}
+
+	if (update) {
+		gboolean updated;
+
+		updated = update_baseline (baseline, results, file_arguments[0]);
+		g_key_file_free (results);
+		g_key_file_free (baseline);
+
+		return updated ? 0 : -2;
+	}
+
+	groups = g_key_file_get_groups (baseline, NULL);
+	for (i = 0; groups[i]; i++) {
+		if (strcmp (groups[i], GATE_GROUP) == 0)
+			continue;
+
+		n_regressions += check_group (baseline, results, groups[i]);
+		n_checked++;
+	}
+	g_strfreev (groups);
+
+	/* New documents are reported, for the baseline to be updated */
+	groups = g_key_file_get_groups (results, NULL);
+	for (i = 0; groups[i]; i++) {
+		if (!g_key_file_has_group (baseline, groups[i]))
+			g_print ("%-32s not in the baseline\n", groups[i]);
+	}
+	g_strfreev (groups);
+
+	/* An empty baseline would let any regression through */
+	if (n_checked == 0)
+		g_printerr ("The baseline is empty, record one with \"make perf-baseline\"\n");
+	else if (n_regressions > 0)
+		g_print ("%u metrics regressed by more than the threshold\n", n_regressions);
+
+	g_key_file_free (results);
+	g_key_file_free (baseline);
+
+	return n_regressions > 0 || n_checked == 0 ? 1 : 0;
+}
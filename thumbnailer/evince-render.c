@@ -0,0 +1,447 @@
+/*
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <gio/gio.h>
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_DPI 150.0
+
+static gint first_page = 1;
+static gint last_page = 0;
+static gdouble dpi = DEFAULT_DPI;
+static gint n_jobs = 0;
+static gboolean raw_output = FALSE;
+static gboolean draft = FALSE;
+static const gchar **file_arguments;
+
+static const GOptionEntry goption_options[] = {
+	{ "first-page", 'f', 0, G_OPTION_ARG_INT, &first_page, "First page to render, starting at 1", "PAGE" },
+	{ "last-page", 'l', 0, G_OPTION_ARG_INT, &last_page, "Last page to render, the last one of the document by default", "PAGE" },
+	{ "dpi", 'r', 0, G_OPTION_ARG_DOUBLE, &dpi, "Resolution, for 72 page units per inch (150 by default)", "DPI" },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Number of pages rendered at the same time", "N" },
+	{ "raw", 0, 0, G_OPTION_ARG_NONE, &raw_output, "Write the pages to stdout as binary PPM frames, in order", NULL },
+	{ "draft", 0, 0, G_OPTION_ARG_NONE, &draft, "Trade quality for speed", NULL },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> [<output>]" },
+	{ NULL }
+};
+
+/* Pages are rendered by a pool of threads, from the first one on. Raw
+ * frames are written in page order, so rendered pages wait for the ones
+ * before them, and threads don't start a page too far ahead of the last
+ * page written, to keep a bound on the memory used.
+ */
+typedef struct {
+	EvDocument  *document;
+	const gchar *output;
+	gdouble      scale;
+
+	GMutex       mutex;
+	GCond        cond;
+	gint         next_page;
+	gint         last_page;
+	gint         next_frame;
+	gint         max_ahead;
+	GHashTable  *frames;
+	gboolean     failed;
+} RenderState;
+
+/* Replaces the %d of @pattern, with its flags and width if any, by the
+ * page number. %% stands for a single %. Returns %NULL if @pattern has
+ * anything else after a %, or more than one number.
+ */
+static gchar *
+format_output_name (const gchar *pattern,
+		    gint         page,
+		    gboolean    *has_number)
+{
+	GString     *name;
+	const gchar *p;
+
+	*has_number = FALSE;
+	name = g_string_new (NULL);
+
+	for (p = pattern; *p; p++) {
+		const gchar *spec;
+		gboolean     zero = FALSE;
+		gint         width = 0;
+
+		if (*p != '%') {
+			g_string_append_c (name, *p);
+			continue;
+		}
+
+		spec = p + 1;
+		if (*spec == '%') {
+			g_string_append_c (name, '%');
+			p = spec;
+			continue;
+		}
+
+		if (*spec == '0') {
+			zero = TRUE;
+			spec++;
+		}
+		while (g_ascii_isdigit (*spec) && width < 100)
+			width = width * 10 + *spec++ - '0';
+
+		if (*spec != 'd' || *has_number) {
+			g_string_free (name, TRUE);
+			return NULL;
+		}
+
+		g_string_append_printf (name, zero ? "%0*d" : "%*d", width, page);
+		*has_number = TRUE;
+		p = spec;
+	}
+
+	return g_string_free (name, FALSE);
+}
+
+static cairo_surface_t *
+render_page (EvDocument *document,
+	     gint        index,
+	     gdouble     scale)
+{
+	EvPage          *page;
+	EvRenderContext *rc;
+	cairo_surface_t *surface;
+	gboolean         thread_safe;
+
+	ev_document_lock (document);
+
+	/* Like the render jobs, thread-safe backends render without
+	 * the document lock, so that pages are rendered in parallel */
+	thread_safe = ev_document_is_thread_safe (document);
+	if (!thread_safe)
+		ev_document_fc_mutex_lock ();
+
+	page = ev_document_get_page (document, index);
+	rc = ev_render_context_new (page, 0, scale);
+	ev_render_context_set_draft (rc, draft);
+	g_object_unref (page);
+
+	if (thread_safe) {
+		ev_document_unlock (document);
+		surface = ev_document_render (document, rc);
+		ev_document_lock (document);
+	} else {
+		surface = ev_document_render (document, rc);
+		ev_document_fc_mutex_unlock ();
+	}
+
+	ev_document_unlock (document);
+	g_object_unref (rc);
+
+	return surface;
+}
+
+/* Binary PPM, with the page painted over white */
+static gboolean
+write_ppm_frame (cairo_surface_t *surface,
+		 FILE            *stream)
+{
+	guchar  *data;
+	guchar  *row;
+	gint     width, height, stride;
+	gboolean has_alpha;
+	gint     x, y;
+
+	cairo_surface_flush (surface);
+	data = cairo_image_surface_get_data (surface);
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	stride = cairo_image_surface_get_stride (surface);
+	has_alpha = cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32;
+
+	if (fprintf (stream, "P6\n%d %d\n255\n", width, height) < 0)
+		return FALSE;
+
+	row = g_malloc ((gsize) width * 3);
+	for (y = 0; y < height; y++) {
+		const guint32 *src = (const guint32 *) (data + (gsize) y * stride);
+
+		for (x = 0; x < width; x++) {
+			guint32 pixel = src[x];
+			guint   white = has_alpha ? 255 - (pixel >> 24) : 0;
+
+			row[x * 3] = ((pixel >> 16) & 0xff) + white;
+			row[x * 3 + 1] = ((pixel >> 8) & 0xff) + white;
+			row[x * 3 + 2] = (pixel & 0xff) + white;
+		}
+
+		if (fwrite (row, 3, width, stream) != (gsize) width) {
+			g_free (row);
+			return FALSE;
+		}
+	}
+	g_free (row);
+
+	return TRUE;
+}
+
+/* Called with the state mutex held */
+static void
+write_ready_frames (RenderState *state)
+{
+	cairo_surface_t *surface;
+
+	while ((surface = g_hash_table_lookup (state->frames, GINT_TO_POINTER (state->next_frame)))) {
+		if (!state->failed && !write_ppm_frame (surface, stdout)) {
+			g_printerr ("Error writing page %d\n", state->next_frame + 1);
+			state->failed = TRUE;
+		}
+		g_hash_table_remove (state->frames, GINT_TO_POINTER (state->next_frame));
+		state->next_frame++;
+	}
+	fflush (stdout);
+}
+
+static gboolean
+save_png (cairo_surface_t *surface,
+	  const gchar     *pattern,
+	  gint             index)
+{
+	cairo_status_t status;
+	gboolean       has_number;
+	gchar         *filename;
+
+	filename = format_output_name (pattern, index + 1, &has_number);
+	status = cairo_surface_write_to_png (surface, filename);
+	if (status != CAIRO_STATUS_SUCCESS)
+		g_printerr ("Error writing %s: %s\n", filename, cairo_status_to_string (status));
+	g_free (filename);
+
+	return status == CAIRO_STATUS_SUCCESS;
+}
+
+static gpointer
+render_thread (RenderState *state)
+{
+	for (;;) {
+		cairo_surface_t *surface;
+		gint             index;
+
+		g_mutex_lock (&state->mutex);
+		while (raw_output && !state->failed && state->next_page <= state->last_page &&
+		       state->next_page >= state->next_frame + state->max_ahead)
+			g_cond_wait (&state->cond, &state->mutex);
+
+		if (state->failed || state->next_page > state->last_page) {
+			g_mutex_unlock (&state->mutex);
+			break;
+		}
+		index = state->next_page++;
+		g_mutex_unlock (&state->mutex);
+
+		surface = render_page (state->document, index, state->scale);
+		if (!surface) {
+			g_printerr ("Error rendering page %d\n", index + 1);
+			g_mutex_lock (&state->mutex);
+			state->failed = TRUE;
+			g_cond_broadcast (&state->cond);
+			g_mutex_unlock (&state->mutex);
+			break;
+		}
+
+		if (!raw_output) {
+			gboolean saved;
+
+			saved = save_png (surface, state->output, index);
+			cairo_surface_destroy (surface);
+			if (!saved) {
+				g_mutex_lock (&state->mutex);
+				state->failed = TRUE;
+				g_mutex_unlock (&state->mutex);
+				break;
+			}
+			continue;
+		}
+
+		g_mutex_lock (&state->mutex);
+		g_hash_table_insert (state->frames, GINT_TO_POINTER (index), surface);
+		write_ready_frames (state);
+		g_cond_broadcast (&state->cond);
+		g_mutex_unlock (&state->mutex);
+	}
+
+	return NULL;
+}
+
+static EvDocument *
+load_document (const gchar *input)
+{
+	EvDocument *document;
+	GFile      *file;
+	gchar      *uri;
+	GError     *error = NULL;
+
+	file = g_file_new_for_commandline_arg (input);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	document = ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NO_CACHE, &error);
+	g_free (uri);
+	if (!document) {
+		g_printerr ("Error loading document: %s\n", error->message);
+		g_error_free (error);
+	}
+
+	return document;
+}
+
+/* Backends that can render several pages at the same time only do so
+ * when asked, and the user's choice, if any, is kept */
+static void
+setup_render_contexts (gint n)
+{
+	gchar *value;
+
+	value = g_strdup_printf ("%d", n);
+	g_setenv ("EV_PDF_RENDER_REPLICAS", value, FALSE);
+	g_setenv ("EV_DVI_RENDER_CONTEXTS", value, FALSE);
+	g_setenv ("EV_PS_RENDER_PROCESSES", value, FALSE);
+	g_free (value);
+}
+
+static void
+print_usage (GOptionContext *context)
+{
+	gchar *help;
+
+	help = g_option_context_get_help (context, TRUE, NULL);
+	g_print ("%s", help);
+	g_free (help);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	RenderState     state;
+	const gchar    *input;
+	const gchar    *output;
+	GThread       **threads;
+	GError         *error = NULL;
+	gboolean        has_number = FALSE;
+	gchar          *name;
+	gint            n_pages;
+	gint            i;
+
+	setlocale (LC_ALL, "");
+
+	context = g_option_context_new ("- Render document pages");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	input = file_arguments ? file_arguments[0] : NULL;
+	output = input ? file_arguments[1] : NULL;
+	if (!input || (!output && !raw_output) || (output && raw_output)) {
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+	g_option_context_free (context);
+
+	if (dpi <= 0) {
+		g_printerr ("The resolution must be positive\n");
+		return -1;
+	}
+
+	if (output) {
+		name = format_output_name (output, 1, &has_number);
+		if (!name) {
+			g_printerr ("The output can only have one %%d for the page number\n");
+			return -1;
+		}
+		g_free (name);
+	}
+
+	if (n_jobs <= 0)
+		n_jobs = g_get_num_processors ();
+	setup_render_contexts (n_jobs);
+
+	if (!ev_init ())
+		return -1;
+
+	state.document = load_document (input);
+	if (!state.document) {
+		ev_shutdown ();
+		return -2;
+	}
+
+	n_pages = ev_document_get_n_pages (state.document);
+	if (last_page <= 0 || last_page > n_pages)
+		last_page = n_pages;
+	if (first_page < 1 || first_page > last_page) {
+		g_printerr ("Invalid page range, the document has %d pages\n", n_pages);
+		g_object_unref (state.document);
+		ev_shutdown ();
+		return -1;
+	}
+
+	if (output && !has_number && last_page > first_page) {
+		g_printerr ("The output needs a %%d for the page number to render several pages\n");
+		g_object_unref (state.document);
+		ev_shutdown ();
+		return -1;
+	}
+
+	state.output = output;
+	state.scale = dpi / 72.0;
+	state.next_page = first_page - 1;
+	state.last_page = last_page - 1;
+	state.next_frame = first_page - 1;
+	state.max_ahead = 2 * n_jobs;
+	state.failed = FALSE;
+	state.frames = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+					      (GDestroyNotify) cairo_surface_destroy);
+	g_mutex_init (&state.mutex);
+	g_cond_init (&state.cond);
+
+	n_jobs = MIN (n_jobs, last_page - first_page + 1);
+	threads = g_new (GThread *, n_jobs);
+	for (i = 0; i < n_jobs; i++)
+		threads[i] = g_thread_new ("EvRender", (GThreadFunc) render_thread, &state);
+	for (i = 0; i < n_jobs; i++)
+		g_thread_join (threads[i]);
+	g_free (threads);
+
+	g_hash_table_destroy (state.frames);
+	g_mutex_clear (&state.mutex);
+	g_cond_clear (&state.cond);
+
+	g_object_unref (state.document);
+	ev_shutdown ();
+
+	return state.failed ? -2 : 0;
+}
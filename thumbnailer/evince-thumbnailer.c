@@ -23,6 +23,7 @@
 #include <gio/gio.h>
 
 #include <locale.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -42,11 +43,15 @@ static gboolean finished = TRUE;
 
 static gint size = THUMBNAIL_SIZE;
 static gboolean time_limit = TRUE;
+static gboolean batch_mode = FALSE;
+static gint n_jobs = 0;
 static const gchar **file_arguments;
 
 static const GOptionEntry goption_options[] = {
 	{ "size", 's', 0, G_OPTION_ARG_INT, &size, NULL, "SIZE" },
         { "no-limit", 'l', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &time_limit, "Don't limit the thumbnailing time to 15 seconds", NULL },
+	{ "batch", 'b', 0, G_OPTION_ARG_NONE, &batch_mode, "Read tab separated <input> <output> [<size>] lines from stdin", NULL },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Number of documents processed at the same time in batch mode", "N" },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> <ouput>" },
 	{ NULL }
 };
@@ -126,6 +131,38 @@ get_local_path (GFile *file)
 	return g_file_get_path (file);
 }
 
+/* Backends that can load a document from a GFile, like the PDF one,
+ * read only the parts they need, instead of the whole file. Returns
+ * %FALSE when the document has to be copied to be loaded instead.
+ */
+static gboolean
+evince_thumbnailer_get_remote_document (GFile       *file,
+					EvDocument **document)
+{
+	GError *error = NULL;
+
+	*document = ev_document_factory_get_document_for_gfile (file,
+								EV_DOCUMENT_LOAD_FLAG_NO_CACHE,
+								NULL, &error);
+	if (!error)
+		return TRUE;
+
+	if (error->domain == EV_DOCUMENT_ERROR &&
+	    error->code == EV_DOCUMENT_ERROR_ENCRYPTED) {
+		/* FIXME: Create a thumb for cryp docs */
+		g_clear_object (document);
+		g_error_free (error);
+		return TRUE;
+	}
+
+	/* The backend can't load from a GFile, or the content type
+	 * can only be found out from the contents */
+	g_clear_object (document);
+	g_error_free (error);
+
+	return FALSE;
+}
+
 static EvDocument *
 evince_thumbnailer_get_document (GFile *file)
 {
@@ -139,6 +176,9 @@ evince_thumbnailer_get_document (GFile *file)
 	if (!path) {
 		gchar *base_name, *template;
 
+		if (evince_thumbnailer_get_remote_document (file, &document))
+			return document;
+
 		base_name = g_file_get_basename (file);
 		template = g_strdup_printf ("document.XXXXXX-%s", base_name);
 		g_free (base_name);
@@ -207,6 +247,7 @@ evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int si
 	ev_document_get_page_size (document, 0, &width, &height);
 
 	rc = ev_render_context_new (page, 0, size / MAX (height, width));
+	ev_render_context_set_draft (rc, TRUE);
 	pixbuf = ev_document_get_thumbnail (document, rc);
 	g_object_unref (rc);
 	g_object_unref (page);
@@ -226,17 +267,247 @@ evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int si
 static gpointer
 evince_thumbnail_pngenc_get_async (struct AsyncData *data)
 {
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (data->document);
 	data->success = evince_thumbnail_pngenc_get (data->document,
 						     data->output,
 						     data->size);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (data->document);
 	
 	g_idle_add ((GSourceFunc)gtk_main_quit, NULL);
 	
 	return NULL;
 }
 
+/* Batch mode: documents are read from stdin as lines with the input,
+ * the output and optionally the size, separated by tabs, and processed
+ * by a pool of threads. A line is written to stdout for each document
+ * once it's done, "ok", "error" or "timeout", a tab and the input.
+ *
+ * A document taking too long can't be interrupted, its thread is given
+ * up and replaced, the process only exits when too many threads are
+ * stuck that way.
+ */
+#define BATCH_MAX_STUCK_THREADS 8
+
+enum {
+	BATCH_ITEM_RUNNING,
+	BATCH_ITEM_DONE,
+	BATCH_ITEM_TIMED_OUT
+};
+
+typedef struct {
+	gint     ref_count;
+	gint     state;
+	gchar   *input;
+	gchar   *output;
+	gint     size;
+	GSource *timeout;
+} BatchItem;
+
+static GMainLoop   *batch_loop;
+static GThreadPool *batch_pool;
+static GMutex       batch_output_mutex;
+static gint         batch_n_threads;
+static gint         batch_n_stuck = 0;
+static gint         batch_n_pending = 1; /* Until the end of the input */
+
+static BatchItem *
+batch_item_ref (BatchItem *item)
+{
+	g_atomic_int_inc (&item->ref_count);
+
+	return item;
+}
+
+static void
+batch_item_unref (BatchItem *item)
+{
+	if (!g_atomic_int_dec_and_test (&item->ref_count))
+		return;
+
+	g_free (item->input);
+	g_free (item->output);
+	g_free (item);
+}
+
+static void
+batch_pending_done (void)
+{
+	if (g_atomic_int_dec_and_test (&batch_n_pending))
+		g_idle_add ((GSourceFunc) g_main_loop_quit, batch_loop);
+}
+
+static void
+batch_report (const gchar *status,
+	      BatchItem   *item)
+{
+	g_mutex_lock (&batch_output_mutex);
+	g_print ("%s\t%s\n", status, item->input);
+	fflush (stdout);
+	g_mutex_unlock (&batch_output_mutex);
+
+	batch_pending_done ();
+}
+
+static gboolean
+batch_item_timeout_cb (BatchItem *item)
+{
+	if (!g_atomic_int_compare_and_exchange (&item->state,
+						BATCH_ITEM_RUNNING,
+						BATCH_ITEM_TIMED_OUT))
+		return G_SOURCE_REMOVE;
+
+	batch_report ("timeout", item);
+
+	if (++batch_n_stuck > BATCH_MAX_STUCK_THREADS) {
+		g_printerr ("Too many documents took too much time to process\n");
+		exit (1);
+	}
+
+	/* Keep the same number of threads working */
+	g_thread_pool_set_max_threads (batch_pool, batch_n_threads + batch_n_stuck, NULL);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+batch_process_item (BatchItem *item,
+		    gpointer   user_data)
+{
+	EvDocument *document;
+	GFile      *file;
+	gboolean    success = FALSE;
+
+	if (time_limit) {
+		item->timeout = g_timeout_source_new_seconds (DEFAULT_SLEEP_TIME / G_USEC_PER_SEC);
+		g_source_set_callback (item->timeout,
+				       (GSourceFunc) batch_item_timeout_cb,
+				       batch_item_ref (item),
+				       (GDestroyNotify) batch_item_unref);
+		g_source_attach (item->timeout, NULL);
+	}
+
+	/* Backends share global state, fontconfig included, between
+	 * their documents, so documents are loaded one at a time, and
+	 * only rendered at the same time by thread-safe backends */
+	file = g_file_new_for_commandline_arg (item->input);
+	ev_document_doc_mutex_lock ();
+	ev_document_fc_mutex_lock ();
+	document = evince_thumbnailer_get_document (file);
+	ev_document_fc_mutex_unlock ();
+	ev_document_doc_mutex_unlock ();
+	g_object_unref (file);
+
+	if (document) {
+		gboolean thread_safe;
+
+		ev_document_lock (document);
+		thread_safe = ev_document_is_thread_safe (document);
+		if (!thread_safe) {
+			ev_document_doc_mutex_lock ();
+			ev_document_fc_mutex_lock ();
+		}
+		success = evince_thumbnail_pngenc_get (document, item->output, item->size);
+		if (!thread_safe) {
+			ev_document_fc_mutex_unlock ();
+			ev_document_doc_mutex_unlock ();
+		}
+		ev_document_unlock (document);
+		g_object_unref (document);
+	}
+
+	if (item->timeout) {
+		g_source_destroy (item->timeout);
+		g_source_unref (item->timeout);
+		item->timeout = NULL;
+	}
+
+	if (g_atomic_int_compare_and_exchange (&item->state,
+					       BATCH_ITEM_RUNNING,
+					       BATCH_ITEM_DONE))
+		batch_report (success ? "ok" : "error", item);
+
+	batch_item_unref (item);
+}
+
+static BatchItem *
+batch_item_new_from_line (gchar *line)
+{
+	BatchItem *item;
+	gchar    **fields;
+	gint       item_size = size;
+
+	g_strchomp (line);
+	if (line[0] == '\0')
+		return NULL;
+
+	fields = g_strsplit (line, "\t", 3);
+	if (!fields[1] || fields[1][0] == '\0' ||
+	    (fields[2] && (item_size = atoi (fields[2])) < 1)) {
+		g_printerr ("Invalid line: '%s'\n", line);
+		g_strfreev (fields);
+
+		return NULL;
+	}
+
+	item = g_new0 (BatchItem, 1);
+	item->ref_count = 1;
+	item->state = BATCH_ITEM_RUNNING;
+	item->input = g_strdup (fields[0]);
+	item->output = g_strdup (fields[1]);
+	item->size = item_size;
+	g_strfreev (fields);
+
+	return item;
+}
+
+static gpointer
+batch_read_input (gpointer data)
+{
+	gchar line[4096 * 3];
+
+	while (fgets (line, sizeof (line), stdin)) {
+		BatchItem *item;
+
+		item = batch_item_new_from_line (line);
+		if (!item)
+			continue;
+
+		g_atomic_int_inc (&batch_n_pending);
+		g_thread_pool_push (batch_pool, item, NULL);
+	}
+
+	batch_pending_done ();
+
+	return NULL;
+}
+
+static int
+evince_thumbnailer_run_batch (void)
+{
+	GThread *reader;
+
+	batch_n_threads = n_jobs > 0 ? n_jobs : g_get_num_processors ();
+	batch_pool = g_thread_pool_new ((GFunc) batch_process_item, NULL,
+					batch_n_threads, FALSE, NULL);
+	batch_loop = g_main_loop_new (NULL, FALSE);
+
+	reader = g_thread_new ("ThmbnlrBatchInput", batch_read_input, NULL);
+	g_main_loop_run (batch_loop);
+	g_thread_join (reader);
+
+	g_main_loop_unref (batch_loop);
+
+	/* Threads stuck on a document can't be waited for */
+	if (batch_n_stuck > 0)
+		return 0;
+
+	g_thread_pool_free (batch_pool, FALSE, TRUE);
+	ev_shutdown ();
+
+	return 0;
+}
+
 static void
 print_usage (GOptionContext *context)
 {
@@ -271,6 +542,21 @@ main (int argc, char *argv[])
 		return -1;
 	}
 
+	if (batch_mode) {
+		g_option_context_free (context);
+
+		if (size < 1) {
+			g_printerr ("Size cannot be smaller than 1 pixel\n");
+			return -1;
+		}
+
+		if (!ev_init ())
+			return -1;
+
+		/* The backends stay loaded for all the documents */
+		return evince_thumbnailer_run_batch ();
+	}
+
 	input = file_arguments ? file_arguments[0] : NULL;
 	output = input ? file_arguments[1] : NULL;
 	if (!input || !output) {